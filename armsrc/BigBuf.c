@@ -33,6 +33,25 @@ static uint32_t s_bigbuf_size = 0;
 // High memory mark
 static uint32_t s_bigbuf_hi = 0;
 
+// the chunks above s_bigbuf_hi. A chunk released in the middle stays as a hole for the next
+// allocation that fits, the lowest ones give their memory back to s_bigbuf_hi
+#define BIGBUF_MAX_CHUNKS   48
+#define BIGBUF_ARENA_HOLE   0xFF
+
+typedef struct {
+    uint32_t offset;
+    uint32_t size;
+    uint8_t arena;
+} bigbuf_chunk_t;
+
+static bigbuf_chunk_t s_chunks[BIGBUF_MAX_CHUNKS];
+static uint8_t s_chunk_count = 0;
+
+// statistics for BigBuf_print_status
+static uint32_t s_arena_used[BIGBUF_ARENA_COUNT];
+static uint32_t s_arena_peak[BIGBUF_ARENA_COUNT];
+static uint32_t s_bigbuf_lowest = 0;
+
 // pointer to the emulator memory.
 static uint8_t *emulator_memory = NULL;
 
@@ -67,11 +86,21 @@ static dmabuf8_t dma_8 = {
 static uint32_t trace_len = 0;
 static bool tracing = true;
 
+// ring mode, when the trace is full it wraps around and overwrites the oldest records.
+// Once wrapped the newest records are [0, trace_len) and the older ones [trace_start, trace_wrap)
+static bool trace_ring = false;
+static uint32_t trace_start = 0;
+static uint32_t trace_wrap = 0;
+
 // compute the available size for BigBuf
 void BigBuf_initialize(void) {
     s_bigbuf_size = (uint32_t)&_stack_start - (uint32_t)&__bss_end__;
     s_bigbuf_hi = s_bigbuf_size;
+    s_bigbuf_lowest = s_bigbuf_size;
+    s_chunk_count = 0;
     trace_len = 0;
+    trace_start = 0;
+    trace_wrap = 0;
 }
 
 // get the address of BigBuf
@@ -87,7 +116,7 @@ uint32_t BigBuf_get_size(void) {
 uint8_t *BigBuf_get_EM_addr(void) {
     // not yet allocated
     if (emulator_memory == NULL)
-        emulator_memory = BigBuf_malloc(CARD_MEMORY_SIZE);
+        emulator_memory = BigBuf_malloc_arena(CARD_MEMORY_SIZE, BIGBUF_ARENA_EM);
 
     return emulator_memory;
 }
@@ -120,18 +149,132 @@ void BigBuf_Clear_keep_EM(void) {
 
 // allocate a chunk of memory from BigBuf. We allocate high memory first. The unallocated memory
 // at the beginning of BigBuf is always for traces/samples
-uint8_t *BigBuf_malloc(uint16_t chunksize) {
-    if (s_bigbuf_hi < chunksize)
-        return NULL; // no memory left
+uint8_t *BigBuf_malloc(uint32_t chunksize) {
+    return BigBuf_malloc_arena(chunksize, BIGBUF_ARENA_MISC);
+}
+
+uint8_t *BigBuf_malloc_arena(uint32_t chunksize, uint8_t arena) {
+
+    if (arena >= BIGBUF_ARENA_COUNT)
+        return NULL;
+
+    chunksize = (chunksize + 3) & ~3u; // round to next multiple of 4
+
+    bigbuf_chunk_t *c = NULL;
+
+    // smallest hole it fits in
+    for (uint8_t i = 0; i < s_chunk_count; i++) {
+        bigbuf_chunk_t *h = &s_chunks[i];
+        if (h->arena == BIGBUF_ARENA_HOLE && h->size >= chunksize && (c == NULL || h->size < c->size))
+            c = h;
+    }
+
+    if (c) {
+        // the rest of the hole stays one when there is room to note it
+        if (c->size > chunksize && s_chunk_count < BIGBUF_MAX_CHUNKS) {
+            s_chunks[s_chunk_count++] = (bigbuf_chunk_t) {
+                .offset = c->offset + chunksize,
+                .size = c->size - chunksize,
+                .arena = BIGBUF_ARENA_HOLE,
+            };
+            c->size = chunksize;
+        }
+    } else {
+        if (s_bigbuf_hi < chunksize)
+            return NULL; // no memory left
+
+        s_bigbuf_hi -= chunksize;  // aligned to 4 Byte boundary
+        if (s_bigbuf_hi < s_bigbuf_lowest)
+            s_bigbuf_lowest = s_bigbuf_hi;
+
+        if (s_chunk_count == BIGBUF_MAX_CHUNKS) {
+            // no entry left, the lowest chunk grows down and is released together with it
+            for (uint8_t i = 0; i < s_chunk_count; i++) {
+                if (s_chunks[i].offset == s_bigbuf_hi + chunksize) {
+                    s_chunks[i].offset = s_bigbuf_hi;
+                    s_chunks[i].size += chunksize;
+                    s_arena_used[s_chunks[i].arena] += chunksize;
+                    break;
+                }
+            }
+            return (uint8_t *)BigBuf + s_bigbuf_hi;
+        }
+
+        c = &s_chunks[s_chunk_count++];
+        c->offset = s_bigbuf_hi;
+        c->size = chunksize;
+    }
+
+    c->arena = arena;
+
+    s_arena_used[arena] += c->size;
+    if (s_arena_used[arena] > s_arena_peak[arena])
+        s_arena_peak[arena] = s_arena_used[arena];
+
+    return (uint8_t *)BigBuf + c->offset;
+}
+
+// the buffers handed out by get_tosend, get_dma8 / get_dma16 and BigBuf_get_EM_addr
+static void bigbuf_forget(uint32_t offset) {
+    uint8_t *p = (uint8_t *)BigBuf + offset;
+    if (toSend.buf == p)
+        toSend.buf = NULL;
+    if ((uint8_t *)dma_16.buf == p)
+        dma_16.buf = NULL;
+    if (dma_8.buf == p)
+        dma_8.buf = NULL;
+    if (emulator_memory == p)
+        emulator_memory = NULL;
+}
+
+static void bigbuf_release_chunk(bigbuf_chunk_t *c) {
+    s_arena_used[c->arena] -= c->size;
+    bigbuf_forget(c->offset);
+    c->arena = BIGBUF_ARENA_HOLE;
+}
+
+// gives the holes at the bottom back to s_bigbuf_hi
+static void bigbuf_compact(void) {
+    bool again = true;
+    while (again) {
+        again = false;
+        for (uint8_t i = 0; i < s_chunk_count; i++) {
+            if (s_chunks[i].arena == BIGBUF_ARENA_HOLE && s_chunks[i].offset == s_bigbuf_hi) {
+                s_bigbuf_hi += s_chunks[i].size;
+                s_chunks[i] = s_chunks[--s_chunk_count];
+                again = true;
+                break;
+            }
+        }
+    }
+}
+
+// release one chunk of BigBuf_malloc / BigBuf_malloc_arena
+void BigBuf_release(const void *chunk) {
+    uint32_t offset = (const uint8_t *)chunk - (const uint8_t *)BigBuf;
+    for (uint8_t i = 0; i < s_chunk_count; i++) {
+        if (s_chunks[i].offset == offset && s_chunks[i].arena != BIGBUF_ARENA_HOLE) {
+            bigbuf_release_chunk(&s_chunks[i]);
+            bigbuf_compact();
+            return;
+        }
+    }
+}
 
-    chunksize = (chunksize + 3) & 0xfffc; // round to next multiple of 4
-    s_bigbuf_hi -= chunksize;  // aligned to 4 Byte boundary
-    return (uint8_t *)BigBuf + s_bigbuf_hi;
+// release all chunks of one arena
+void BigBuf_free_arena(uint8_t arena) {
+    for (uint8_t i = 0; i < s_chunk_count; i++) {
+        if (s_chunks[i].arena == arena)
+            bigbuf_release_chunk(&s_chunks[i]);
+    }
+    bigbuf_compact();
 }
 
 // free ALL allocated chunks. The whole BigBuf is available for traces or samples again.
 void BigBuf_free(void) {
     s_bigbuf_hi = s_bigbuf_size;
+    s_chunk_count = 0;
+    memset(s_arena_used, 0, sizeof(s_arena_used));
     emulator_memory = NULL;
     // shouldn't this empty BigBuf also?
     toSend.buf = NULL;
@@ -139,42 +282,94 @@ void BigBuf_free(void) {
     dma_8.buf = NULL;
 }
 
-// free allocated chunks EXCEPT the emulator memory
+// free allocated chunks EXCEPT the emulator memory and the ones above it, allocated before it
 void BigBuf_free_keep_EM(void) {
-    if (emulator_memory != NULL)
-        s_bigbuf_hi = emulator_memory - (uint8_t *)BigBuf;
-    else
-        s_bigbuf_hi = s_bigbuf_size;
 
-    toSend.buf = NULL;
-    dma_16.buf = NULL;
-    dma_8.buf = NULL;
+    if (emulator_memory == NULL) {
+        BigBuf_free();
+        return;
+    }
+
+    uint32_t em_offset = emulator_memory - (uint8_t *)BigBuf;
+    for (uint8_t i = 0; i < s_chunk_count; i++) {
+        if (s_chunks[i].arena != BIGBUF_ARENA_HOLE && s_chunks[i].offset < em_offset)
+            bigbuf_release_chunk(&s_chunks[i]);
+    }
+    bigbuf_compact();
 }
 
 void BigBuf_print_status(void) {
     DbpString(_CYAN_("Memory"));
     Dbprintf("  BigBuf_size.............%d", s_bigbuf_size);
     Dbprintf("  Available memory........%d", s_bigbuf_hi);
+    Dbprintf("  Max allocated...........%d", s_bigbuf_size - s_bigbuf_lowest);
+    Dbprintf("  Chunks..................%d / %d", s_chunk_count, BIGBUF_MAX_CHUNKS);
+    static const char *arenas[BIGBUF_ARENA_COUNT] = {"misc.....", "dma......", "emulator.", "scratch.."};
+    for (uint8_t i = 0; i < BIGBUF_ARENA_COUNT; i++)
+        Dbprintf("  %s used / peak....%d / %d", arenas[i], s_arena_used[i], s_arena_peak[i]);
     DbpString(_CYAN_("Tracing"));
     Dbprintf("  tracing ................%d", tracing);
-    Dbprintf("  traceLen ...............%d", trace_len);
+    Dbprintf("  traceLen ...............%d", BigBuf_get_traceLen());
+    Dbprintf("  trace ring .............%d (%s)", trace_ring, trace_wrap ? "wrapped" : "linear");
 
     Dbprintf("  dma8 memory.............%d", dma_8.buf - BigBuf_get_addr());
     Dbprintf("  dma16 memory............%d", (uint8_t *)dma_16.buf - BigBuf_get_addr());
     Dbprintf("  toSend memory...........%d", toSend.buf - BigBuf_get_addr());
 }
 
+// the most that was allocated at once since power on
+uint32_t BigBuf_get_peak(void) {
+    return s_bigbuf_size - s_bigbuf_lowest;
+}
+
 // return the maximum trace length (i.e. the unallocated size of BigBuf)
-uint16_t BigBuf_max_traceLen(void) {
+uint32_t BigBuf_max_traceLen(void) {
     return s_bigbuf_hi;
 }
 
 void clear_trace(void) {
     trace_len = 0;
+    trace_start = 0;
+    trace_wrap = 0;
 }
 
 void set_tracelen(uint32_t value) {
     trace_len = value;
+    trace_start = 0;
+    trace_wrap = 0;
+}
+
+// the mode survives clear_trace,  callers switch it off again when done sniffing
+void set_tracing_ring(bool enable) {
+    trace_ring = enable;
+}
+
+static void reverse_bytes(uint8_t *p, uint32_t len) {
+    for (uint32_t i = 0, j = len - 1; i < j; i++, j--) {
+        uint8_t t = p[i];
+        p[i] = p[j];
+        p[j] = t;
+    }
+}
+
+// move a wrapped trace in place so it starts with the oldest record,
+// the layout the client expects. Logging may carry on afterwards.
+void BigBuf_linearize_trace(void) {
+    if (trace_wrap == 0)
+        return;
+
+    uint8_t *trace = BigBuf_get_addr();
+    uint32_t older = trace_wrap - trace_start;
+
+    // close the gap, then rotate [newer | older] into [older | newer]
+    memmove(trace + trace_len, trace + trace_start, older);
+    reverse_bytes(trace, trace_len);
+    reverse_bytes(trace + trace_len, older);
+    reverse_bytes(trace, trace_len + older);
+
+    trace_len += older;
+    trace_start = 0;
+    trace_wrap = 0;
 }
 
 void set_tracing(bool enable) {
@@ -190,7 +385,7 @@ bool get_tracing(void) {
  * @return
  */
 uint32_t BigBuf_get_traceLen(void) {
-    return trace_len;
+    return trace_len + (trace_wrap - trace_start);
 }
 
 /**
@@ -205,16 +400,33 @@ bool RAMFUNC LogTrace(const uint8_t *btBytes, uint16_t iLen, uint32_t timestamp_
     }
 
     uint8_t *trace = BigBuf_get_addr();
-    tracelog_hdr_t *hdr = (tracelog_hdr_t *)(trace + trace_len);
 
     uint32_t num_paritybytes = (iLen - 1) / 8 + 1; // number of valid paritybytes in *parity
+    uint32_t needed = TRACELOG_HDR_LEN + iLen + num_paritybytes;
 
-    // Return when trace is full
-    if (TRACELOG_HDR_LEN + iLen + num_paritybytes >= BigBuf_max_traceLen() - trace_len) {
-        tracing = false;
-        return false;
+    // Return when trace is full, or start over at the beginning in ring mode
+    if (needed >= BigBuf_max_traceLen() - trace_len) {
+        if (trace_ring == false || needed >= BigBuf_max_traceLen()) {
+            tracing = false;
+            return false;
+        }
+        trace_wrap = trace_len;
+        trace_start = 0;
+        trace_len = 0;
     }
 
+    // drop the oldest records this one is about to overwrite
+    while (trace_wrap && trace_start < trace_len + needed) {
+        tracelog_hdr_t *old = (tracelog_hdr_t *)(trace + trace_start);
+        trace_start += TRACELOG_HDR_LEN + old->data_len + TRACELOG_PARITY_LEN(old);
+        if (trace_start >= trace_wrap) {
+            trace_start = 0;
+            trace_wrap = 0;
+        }
+    }
+
+    tracelog_hdr_t *hdr = (tracelog_hdr_t *)(trace + trace_len);
+
     uint32_t duration;
     if (timestamp_end > timestamp_start) {
         duration = timestamp_end - timestamp_start;
@@ -267,7 +479,7 @@ bool LogTrace_ISO15693(const uint8_t *bytes, uint16_t len, uint32_t ts_start, ui
 // Emulator memory
 uint8_t emlSet(uint8_t *data, uint32_t offset, uint32_t length) {
     uint8_t *mem = BigBuf_get_EM_addr();
-    if (offset + length < CARD_MEMORY_SIZE) {
+    if (offset + length <= CARD_MEMORY_SIZE) {
         memcpy(mem + offset, data, length);
         return 0;
     }
@@ -281,7 +493,7 @@ uint8_t emlSet(uint8_t *data, uint32_t offset, uint32_t length) {
 tosend_t *get_tosend(void) {
 
     if (toSend.buf == NULL)
-        toSend.buf = BigBuf_malloc(TOSEND_BUFFER_SIZE);
+        toSend.buf = BigBuf_malloc_arena(TOSEND_BUFFER_SIZE, BIGBUF_ARENA_DMA);
 
     return &toSend;
 }
@@ -310,14 +522,14 @@ void tosend_stuffbit(int b) {
 
 dmabuf16_t *get_dma16(void) {
     if (dma_16.buf == NULL)
-        dma_16.buf = (uint16_t *)BigBuf_malloc(DMA_BUFFER_SIZE * sizeof(uint16_t));
+        dma_16.buf = (uint16_t *)BigBuf_malloc_arena(DMA_BUFFER_SIZE * sizeof(uint16_t), BIGBUF_ARENA_DMA);
 
     return &dma_16;
 }
 
 dmabuf8_t *get_dma8(void) {
     if (dma_8.buf == NULL)
-        dma_8.buf = BigBuf_malloc(DMA_BUFFER_SIZE);
+        dma_8.buf = BigBuf_malloc_arena(DMA_BUFFER_SIZE, BIGBUF_ARENA_DMA);
 
     return &dma_8;
 }
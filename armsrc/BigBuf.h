@@ -21,19 +21,30 @@
 #define CARD_MEMORY_SIZE        4096
 #define DMA_BUFFER_SIZE         256
 
+// BigBuf_malloc_arena, a module can give back its own chunks without BigBuf_free
+#define BIGBUF_ARENA_MISC       0   // BigBuf_malloc
+#define BIGBUF_ARENA_DMA        1   // toSend / dma8 / dma16
+#define BIGBUF_ARENA_EM         2   // emulator memory
+#define BIGBUF_ARENA_SCRATCH    3   // working sets of sniffers / attacks
+#define BIGBUF_ARENA_COUNT      4
+
 // 8 data bits and 1 parity bit per payload byte, 1 correction bit, 1 SOC bit, 2 EOC bits
 #define TOSEND_BUFFER_SIZE (9 * MAX_FRAME_SIZE + 1 + 1 + 2)
 
 uint8_t *BigBuf_get_addr(void);
 uint32_t BigBuf_get_size(void);
 uint8_t *BigBuf_get_EM_addr(void);
-uint16_t BigBuf_max_traceLen(void);
+uint32_t BigBuf_max_traceLen(void);
+uint32_t BigBuf_get_peak(void);
 void BigBuf_initialize(void);
 void BigBuf_Clear(void);
 void BigBuf_Clear_ext(bool verbose);
 void BigBuf_Clear_keep_EM(void);
 void BigBuf_Clear_EM(void);
-uint8_t *BigBuf_malloc(uint16_t);
+uint8_t *BigBuf_malloc(uint32_t chunksize);
+uint8_t *BigBuf_malloc_arena(uint32_t chunksize, uint8_t arena);
+void BigBuf_release(const void *chunk);
+void BigBuf_free_arena(uint8_t arena);
 void BigBuf_free(void);
 void BigBuf_free_keep_EM(void);
 void BigBuf_print_status(void);
@@ -41,6 +52,8 @@ uint32_t BigBuf_get_traceLen(void);
 void clear_trace(void);
 void set_tracing(bool enable);
 void set_tracelen(uint32_t value);
+void set_tracing_ring(bool enable);
+void BigBuf_linearize_trace(void);
 bool get_tracing(void);
 
 bool RAMFUNC LogTrace(const uint8_t *btBytes, uint16_t iLen, uint32_t timestamp_start, uint32_t timestamp_end, uint8_t *parity, bool readerToTag);
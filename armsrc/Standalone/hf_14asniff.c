@@ -15,11 +15,14 @@
  * This module is similar to hf_bog (which only logs ULC/NTAG/ULEV1 auth).
  *
  * On entering stand-alone mode, this module will start sniffing ISO14a frames.
- * This will be stored in the normal trace buffer (ie: in RAM -- will be lost
- * at power-off).
+ * This will be stored in the normal trace buffer (ie: in RAM), and moved on
+ * to a file in flash (hf_14asniff.trc) whenever the field is quiet for a
+ * moment or the trace buffer gets full. Flash writes only happen between
+ * frames, and in whole SPIFFS pages. Every write is a chunk with a header so
+ * a power loss only costs the records not written yet.
  *
- * Short-pressing the button again will stop sniffing, and at _this_ point
- * append trace data from RAM to a file in flash (hf_14asniff.trc) and unmount.
+ * Short-pressing the button again will stop sniffing, append the rest of the
+ * trace data from RAM to the file and unmount.
  *
  * Once the data is saved, standalone mode will exit.
  *
@@ -27,14 +30,15 @@
  * - LED1: sniffing
  * - LED2: sniffed tag command, turns off when finished sniffing reader command
  * - LED3: sniffed reader command, turns off when finished sniffing tag command
+ * - LED2 (alone): writing to flash
  * - LED4: unmounting/sync'ing flash (normally < 100ms)
  *
  * To retrieve trace data from flash:
  *
- * 1. mem spiffs dump o hf_14asniff.trc f trace.trc
- *    Copies trace data file from flash to your PC.
+ * 1. mem spiffs dump o hf_14asniff.trc f trace
+ *    Copies trace data file from flash to your PC (trace.bin).
  *
- * 2. trace load trace.trc
+ * 2. trace load trace.bin
  *    Loads trace data from a file into PC-side buffers.
  *
  * 3. For ISO14a: trace list 14a 1
@@ -50,29 +54,77 @@
  * Caveats / notes:
  * - Trace buffer will be cleared on starting stand-alone mode. Data in flash
  *   will remain unless explicitly deleted.
- * - This module will terminate if the trace buffer is full (and save data to
- *   flash).
+ * - A reader talking without pause can fill the trace buffer, then it goes
+ *   to flash anyway and the frames during the write are lost.
+ * - Files written before the chunk headers are appended like before.
  * - Like normal sniffing mode, timestamps overflow after 5 min 16 sec.
  *   However, the trace buffer is sequential, so will be in the correct order.
  */
 
 #include "standalone.h" // standalone definitions
+#include "standalone_services.h"
 #include "proxmark3_arm.h"
 #include "iso14443a.h"
 #include "util.h"
-#include "spiffs.h"
 #include "appmain.h"
 #include "dbprint.h"
 #include "ticks.h"
 #include "BigBuf.h"
 
 #define HF_14ASNIFF_LOGFILE "hf_14asniff.trc"
+// no new frame for this long, the trace goes to flash
+#define HF_14ASNIFF_QUIET_MS    50
+// what is left in the log buffer (less than two pages) goes after this long
+#define HF_14ASNIFF_IDLE_MS     2000
+
+static sa_log_t sniff_log;
+static uint32_t sniff_stored;       // trace bytes already in sniff_log
+static uint32_t sniff_tracelen;     // trace length at the last hook call
+static uint32_t sniff_changed;      // when the trace last grew
+static uint32_t sniff_total;        // trace bytes logged since the start
+
+static void sniff_store_trace(void) {
+    uint32_t trace_len = BigBuf_get_traceLen();
+    uint8_t *trace = BigBuf_get_addr();
+    while (sniff_stored < trace_len) {
+        uint16_t n = MIN(trace_len - sniff_stored, 0x8000);
+        sa_log_write(&sniff_log, trace + sniff_stored, n);
+        sniff_stored += n;
+        sniff_total += n;
+    }
+}
+
+// between frames while sniffing
+static bool sniff_hook(void) {
+    uint32_t trace_len = BigBuf_get_traceLen();
+    bool full = trace_len > (BigBuf_max_traceLen() / 4) * 3;
+
+    if (trace_len != sniff_tracelen) {
+        sniff_tracelen = trace_len;
+        sniff_changed = GetTickCount();
+        if (full == false)
+            return false;
+    }
+
+    if (full == false && GetTickCountDelta(sniff_changed) < HF_14ASNIFF_QUIET_MS)
+        return false;
+
+    if (trace_len > sniff_stored) {
+        sniff_store_trace();
+        clear_trace();
+        sniff_stored = 0;
+        sniff_tracelen = 0;
+        return true;
+    }
+
+    return sa_log_idle(&sniff_log, HF_14ASNIFF_IDLE_MS);
+}
 
 static void DownloadTraceInstructions(void) {
     Dbprintf("");
     Dbprintf("To get the trace from flash and display it:");
-    Dbprintf("1. mem spiffs dump o "HF_14ASNIFF_LOGFILE" f trace.trc");
-    Dbprintf("2. trace load trace.trc");
+    Dbprintf("1. mem spiffs dump o "HF_14ASNIFF_LOGFILE" f trace");
+    Dbprintf("2. trace load trace.bin");
     Dbprintf("3. trace list 14a 1");
 }
 
@@ -85,34 +137,30 @@ void RunMod(void) {
     StandAloneMode();
 
     Dbprintf("Starting standalone mode: hf_14asniff");
-    rdv40_spiffs_lazy_mount();
+    sa_log_open(&sniff_log, HF_14ASNIFF_LOGFILE, SA_LOG_FRAMED);
+    sniff_stored = 0;
+    sniff_tracelen = 0;
+    sniff_total = 0;
+    sniff_changed = GetTickCount();
 
+    iso14a_set_sniff_hook(sniff_hook);
     SniffIso14443a(0);
+    iso14a_set_sniff_hook(NULL);
 
     Dbprintf("Stopped sniffing");
     SpinDelay(200);
 
-    // Write stuff to spiffs logfile
-    uint32_t trace_len = BigBuf_get_traceLen();
-    if (trace_len > 0) {
-        Dbprintf("[!] Trace length (bytes) = %u", trace_len);
-
-        uint8_t *trace_buffer = BigBuf_get_addr();
-        if (!exists_in_spiffs(HF_14ASNIFF_LOGFILE)) {
-            rdv40_spiffs_write(
-                HF_14ASNIFF_LOGFILE, trace_buffer, trace_len, RDV40_SPIFFS_SAFETY_SAFE);
-            Dbprintf("[!] Wrote trace to "HF_14ASNIFF_LOGFILE);
-        } else {
-            rdv40_spiffs_append(
-                HF_14ASNIFF_LOGFILE, trace_buffer, trace_len, RDV40_SPIFFS_SAFETY_SAFE);
-            Dbprintf("[!] Appended trace to "HF_14ASNIFF_LOGFILE);
-        }
+    // Write the rest to the spiffs logfile
+    sniff_store_trace();
+    if (sniff_total > 0) {
+        Dbprintf("[!] Trace length (bytes) = %u", sniff_total);
+        Dbprintf("[!] Wrote trace to "HF_14ASNIFF_LOGFILE);
     } else {
         Dbprintf("[!] Trace buffer is empty, nothing to write!");
     }
 
     LED_D_ON();
-    rdv40_spiffs_lazy_unmount();
+    sa_log_close(&sniff_log);
     LED_D_OFF();
 
     SpinErr(LED_A, 200, 5);
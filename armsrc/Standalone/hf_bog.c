@@ -30,6 +30,7 @@ from the client to view the stored quadlets.
 #include "dbprint.h"
 #include "ticks.h"
 #include "BigBuf.h"
+#include "profiling.h"
 #include "string.h"
 
 #define DELAY_READER_AIR2ARM_AS_SNIFFER (2 + 3 + 8)
@@ -115,6 +116,7 @@ static void RAMFUNC SniffAndStore(uint8_t param) {
 
         // test for length of buffer
         if (dataLen > DMA_BUFFER_SIZE) { // TODO: Check if this works properly
+            profiling_dma_overrun();
             Dbprintf("[!] blew circular buffer! | datalen %u", dataLen);
             break;
         }
@@ -10,6 +10,7 @@
 //-----------------------------------------------------------------------------
 
 #include "standalone.h" // standalone definitions
+#include "standalone_services.h"
 
 #include "hf_colin.h"
 #include "proxmark3_arm.h"
@@ -454,7 +455,6 @@ void RunMod(void) {
         }
     }
 
-    int key = -1;
     bool err = 0;
     bool trapped = 0;
     bool allKeysFound = true;
@@ -559,27 +559,31 @@ failtag:
     // -----------------------------------------------------------------------------
     // also we could avoid first UID check for every block
 
+    // the fast chk engine does the whole card at once: the keys above, then the dictionary in
+    // flash (SA_MF_DICT_FILE) for what is left. A found key goes on every sector straight away
+    mf_chkkeys_spiffs_resp_t chk;
+    if (sa_mf_chk_dict(keyBlock, size, sectorsCnt, &chk) != PM3_SUCCESS) {
+        err = 1; // Can't select card.
+        allKeysFound = false;
+        // reply_old(CMD_CJB_FSMSTATE_MENU, 0, 0, 0, 0, 0);
+    }
+
     // then let's expose this optimal case of well known vigik schemes :
     for (uint8_t type = 0; type < 2 && !err && !trapped; type++) {
         for (int sec = 0; sec < sectorsCnt && !err && !trapped; ++sec) {
-            key = cjat91_saMifareChkKeys(sec * 4, type, NULL, size, &keyBlock[0], &key64);
 
-            if (key == -1) {
-                err = 1;
+            if (sa_mf_chk_found(&chk, sec, type) == false) {
+                // a known scheme can still fill it in
                 allKeysFound = false;
                 // used in portable imlementation on microcontroller: it reports back the fail and open the
                 // standalone lock reply_old(CMD_CJB_FSMSTATE_MENU, 0, 0, 0, 0, 0);
-                break;
-            } else if (key == -2) {
-                err = 1; // Can't select card.
-                allKeysFound = false;
-                // reply_old(CMD_CJB_FSMSTATE_MENU, 0, 0, 0, 0, 0);
-                break;
+                continue;
             } else {
                 /*  BRACE YOURSELF : AS LONG AS WE TRAP A KNOWN KEY, WE STOP CHECKING AND ENFORCE KNOWN SCHEMES */
                 // uint8_t tosendkey[13];
                 char tosendkey[13];
-                num_to_bytes(key64, 6, foundKey[type][sec]);
+                memcpy(foundKey[type][sec], chk.keys + sec * 12 + type * 6, 6);
+                key64 = bytes_to_num(foundKey[type][sec], 6);
                 cjSetCursRight();
                 DbprintfEx(FLAG_NEWLINE, "SEC: %02x ; KEY : %012" PRIx64 " ; TYP: %i", sec, key64, type);
                 /*reply_old(CMD_CJB_INFORM_CLIENT_KEY, 12, sec, type, tosendkey, 12);*/
@@ -628,6 +632,10 @@ failtag:
         }
     }
 
+    // the scheme has all the keys
+    if (trapped)
+        allKeysFound = true;
+
     if (!allKeysFound) {
         cjSetCursLeft();
         cjTabulize();
@@ -657,14 +665,14 @@ failtag:
     cjSetCursLeft();
 
     DbprintfEx(FLAG_NEWLINE, "%s>>%s Filling Emulator <- from A keys...", _XYELLOW_, _XWHITE_);
-    filled = e_MifareECardLoad(sectorsCnt, 0);
+    filled = sa_mf_ecard_load(cjuid, &p_card, &cjcuid, sectorsCnt, 0);
     if (filled != PM3_SUCCESS) {
         cjSetCursLeft();
 
         DbprintfEx(FLAG_NEWLINE, "%s>>%s W_FAILURE ! %sTrying fallback B keys....", _XRED_, _XORANGE_, _XWHITE_);
 
         // no trace, no dbg
-        filled = e_MifareECardLoad(sectorsCnt, 1);
+        filled = sa_mf_ecard_load(cjuid, &p_card, &cjcuid, sectorsCnt, 1);
         if (filled != PM3_SUCCESS) {
             cjSetCursLeft();
             DbprintfEx(FLAG_NEWLINE, "FATAL:EML_FALLBACKFILL_B");
@@ -778,110 +786,6 @@ readysim:
     return;
 }
 
-/* Abusive microgain on original MifareECardLoad :
- * - *datain used as error return
- * - tracing is falsed
- */
-int e_MifareECardLoad(uint32_t numofsectors, uint8_t keytype) {
-    uint8_t numSectors = numofsectors;
-    uint8_t keyType = keytype;
-
-    struct Crypto1State mpcs = {0, 0};
-    struct Crypto1State *pcs;
-    pcs = &mpcs;
-
-    uint8_t dataoutbuf[16];
-    uint8_t dataoutbuf2[16];
-
-    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
-    clear_trace();
-    set_tracing(false);
-
-    bool isOK = true;
-
-    if (!iso14443a_select_card(cjuid, &p_card, &cjcuid, true, 0, true)) {
-        isOK = false;
-    }
-
-    for (uint8_t s = 0; isOK && s < numSectors; s++) {
-        uint64_t ui64Key = emlGetKey(s, keyType);
-        if (s == 0) {
-            if (isOK && mifare_classic_auth(pcs, cjcuid, FirstBlockOfSector(s), keyType, ui64Key, AUTH_FIRST)) {
-                break;
-            }
-        } else {
-            if (isOK && mifare_classic_auth(pcs, cjcuid, FirstBlockOfSector(s), keyType, ui64Key, AUTH_NESTED)) {
-                isOK = false;
-                break;
-            }
-        }
-
-        for (uint8_t blockNo = 0; isOK && blockNo < NumBlocksPerSector(s); blockNo++) {
-            if (isOK && mifare_classic_readblock(pcs, cjcuid, FirstBlockOfSector(s) + blockNo, dataoutbuf)) {
-                isOK = false;
-                break;
-            };
-            if (isOK) {
-                if (blockNo < NumBlocksPerSector(s) - 1) {
-                    emlSetMem(dataoutbuf, FirstBlockOfSector(s) + blockNo, 1);
-                } else {
-                    // sector trailer, keep the keys, set only the AC
-                    emlGetMem(dataoutbuf2, FirstBlockOfSector(s) + blockNo, 1);
-                    memcpy(&dataoutbuf2[6], &dataoutbuf[6], 4);
-                    emlSetMem(dataoutbuf2, FirstBlockOfSector(s) + blockNo, 1);
-                }
-            }
-        }
-    }
-
-    int res = mifare_classic_halt(pcs, cjcuid);
-    (void)res;
-
-    crypto1_deinit(pcs);
-    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
-    return (isOK) ? PM3_SUCCESS : PM3_EUNDEF;
-}
-
-/* the chk function is a piwi'ed(tm) check that will try all keys for
-a particular sector. also no tracing no dbg */
-int cjat91_saMifareChkKeys(uint8_t blockNo, uint8_t keyType, bool clearTrace,
-                           uint8_t keyCount, uint8_t *datain, uint64_t *key) {
-    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
-    set_tracing(false);
-
-    struct Crypto1State mpcs = {0, 0};
-    struct Crypto1State *pcs;
-    pcs = &mpcs;
-
-    int retval = -1;
-
-    for (uint8_t i = 0; i < keyCount; i++) {
-
-        /* no need for anticollision. just verify tag is still here */
-        // if (!iso14443a_fast_select_card(cjuid, 0)) {
-        if (!iso14443a_select_card(cjuid, &p_card, &cjcuid, true, 0, true)) {
-            cjSetCursLeft();
-            DbprintfEx(FLAG_NEWLINE, "%sFATAL%s : E_MF_LOSTTAG", _XRED_, _XWHITE_);
-            break;
-        }
-
-        uint64_t ui64Key = bytes_to_num(datain + i * 6, 6);
-        if (mifare_classic_auth(pcs, cjcuid, blockNo, keyType, ui64Key, AUTH_FIRST)) {
-            uint8_t dummy_answer = 0;
-            ReaderTransmit(&dummy_answer, 1, NULL);
-            // wait for the card to become ready again
-            SpinDelayUs(AUTHENTICATION_TIMEOUT);
-            continue;
-        }
-        *key = ui64Key;
-        retval = i;
-        break;
-    }
-    crypto1_deinit(pcs);
-    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
-    return retval;
-}
-
 void saMifareMakeTag(void) {
     uint8_t cfail = 0;
     cjSetCursLeft();
@@ -22,8 +22,13 @@ then it will load the keys into the emulator memory and also the
 content of the victim tag, to finally simulate it and make a clone
 on a blank card.
 
+The keys are checked with the fast chk engine, the hardcoded keys first,
+then a dictionary in flash (mfc_keys.bin) if there is one. 1k and 4k.
+
+When only some keys are known, the nonces of the missing ones are saved to
+flash for `hf mf hardnested r f <file>` on the client.
+
 #### TODO:
-- Nested attack in the case not all keys are known.
 - Dump into magic card in case of needed replication.
 
 #### ~ Basically automates commands without user intervention.
@@ -33,7 +38,9 @@ on a blank card.
 ## Spanish full description of the project [here](http://bit.ly/2c9nZXR).
 */
 
+#include <inttypes.h>
 #include "standalone.h" // standalone definitions
+#include "standalone_services.h"
 #include "proxmark3_arm.h"
 #include "appmain.h"
 #include "fpgaloader.h"
@@ -41,6 +48,7 @@ on a blank card.
 #include "dbprint.h"
 #include "ticks.h"
 #include "string.h"
+#include "printf.h"
 #include "commonutil.h"
 #include "iso14443a.h"
 #include "mifarecmd.h"
@@ -174,117 +182,6 @@ static int saMifareCSetBlock(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_
     return isOK;
 }
 
-/* the chk function is a piwi’ed(tm) check that will try all keys for
-a particular sector. also no tracing no dbg */
-static int saMifareChkKeys(uint8_t blockNo, uint8_t keyType, bool clearTrace,
-                           uint8_t keyCount, uint8_t *datain, uint64_t *key) {
-    DBGLEVEL = DBG_NONE;
-    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
-    set_tracing(false);
-
-    struct Crypto1State mpcs = {0, 0};
-    struct Crypto1State *pcs;
-    pcs = &mpcs;
-
-    int retval = -1;
-
-    for (uint8_t i = 0; i < keyCount; i++) {
-
-        /* no need for anticollision. just verify tag is still here */
-        // if (!iso14443a_fast_select_card(cjuid, 0)) {
-        if (!iso14443a_select_card(uid, &p_card, &cuid, true, 0, true)) {
-            DbprintfEx(FLAG_NEWLINE, "FATAL : E_MF_LOSTTAG");
-            break;
-        }
-
-        uint64_t ui64Key = bytes_to_num(datain + i * 6, 6);
-        if (mifare_classic_auth(pcs, cuid, blockNo, keyType, ui64Key, AUTH_FIRST)) {
-            uint8_t dummy_answer = 0;
-            ReaderTransmit(&dummy_answer, 1, NULL);
-            // wait for the card to become ready again
-            SpinDelayUs(AUTHENTICATION_TIMEOUT);
-            continue;
-        }
-        *key = ui64Key;
-        retval = i;
-        break;
-    }
-    crypto1_deinit(pcs);
-    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
-    return retval;
-}
-
-/* Abusive microgain on original MifareECardLoad :
- * - *datain used as error return
- * - tracing is falsed
- */
-static int saMifareECardLoad(uint32_t numofsectors, uint8_t keytype) {
-    DBGLEVEL = DBG_NONE;
-
-    uint8_t numSectors = numofsectors;
-    uint8_t keyType = keytype;
-
-    struct Crypto1State mpcs = {0, 0};
-    struct Crypto1State *pcs;
-    pcs = &mpcs;
-
-    uint8_t dataoutbuf[16];
-    uint8_t dataoutbuf2[16];
-
-    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
-    clear_trace();
-    set_tracing(false);
-
-    int retval = PM3_SUCCESS;
-
-    if (!iso14443a_select_card(uid, &p_card, &cuid, true, 0, true)) {
-        retval = PM3_ESOFT;
-        DbprintfEx(FLAG_RAWPRINT, "Can't select card");
-        goto out;
-    }
-
-    for (uint8_t s = 0; s < numSectors; s++) {
-        uint64_t ui64Key = emlGetKey(s, keyType);
-        if (s == 0) {
-            if (mifare_classic_auth(pcs, cuid, FirstBlockOfSector(s), keyType, ui64Key, AUTH_FIRST)) {
-                retval = PM3_ESOFT;
-                break;
-            }
-        } else {
-            if (mifare_classic_auth(pcs, cuid, FirstBlockOfSector(s), keyType, ui64Key, AUTH_NESTED)) {
-                retval = PM3_ESOFT;
-                break;
-            }
-        }
-
-        // failure to read one block,  skips to next sector.
-        for (uint8_t blockNo = 0; blockNo < NumBlocksPerSector(s); blockNo++) {
-            if (mifare_classic_readblock(pcs, cuid, FirstBlockOfSector(s) + blockNo, dataoutbuf)) {
-                retval = PM3_ESOFT;
-                break;
-            };
-
-            if (blockNo < NumBlocksPerSector(s) - 1) {
-                emlSetMem(dataoutbuf, FirstBlockOfSector(s) + blockNo, 1);
-            } else {
-                // sector trailer, keep the keys, set only the AC
-                emlGetMem(dataoutbuf2, FirstBlockOfSector(s) + blockNo, 1);
-                memcpy(&dataoutbuf2[6], &dataoutbuf[6], 4);
-                emlSetMem(dataoutbuf2, FirstBlockOfSector(s) + blockNo, 1);
-            }
-        }
-    }
-
-    int res = mifare_classic_halt(pcs, cuid);
-    (void)res;
-
-out:
-    crypto1_deinit(pcs);
-    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
-    return retval;
-}
-
-
 void ModInfo(void) {
     DbpString("  HF Mifare sniff/clone - aka MattyRun (Matías A. Ré Medina)");
 }
@@ -297,7 +194,7 @@ void ModInfo(void) {
 
     Alternatively, it can be dumped into a blank card.
 
-    This source code has been tested only in Mifare 1k.
+    This source code has been tested only in Mifare 1k, the clone to a blank card is 1k only.
 
     If you're using the proxmark connected to a device that has an OS, and you're not using the proxmark3 client to see the debug
     messages, you MUST uncomment usb_disable().
@@ -310,11 +207,8 @@ void RunMod(void) {
     // Comment this line below if you want to see debug messages.
     // usb_disable();
 
-    uint16_t mifare_size = 1024;    // Mifare 1k (only 1k supported for now)
-    uint8_t sectorSize = 64;        // 1k's sector size is 64 bytes.
-    uint8_t blockNo = 3;            // Security block is number 3 for each sector.
-    uint8_t sectorsCnt = (mifare_size / sectorSize);
-    uint64_t key64;                 // Defines current key
+    uint8_t sectorsCnt = 16;        // Mifare 1k, 40 sectors when the SAK says 4k
+    bool is4k = false;
     uint8_t *keyBlock;              // Where the keys will be held in memory.
     bool keyFound = false;
 
@@ -417,46 +311,55 @@ void RunMod(void) {
     bool validKey[2][40];
     uint8_t foundKey[2][40][6];
     for (uint8_t i = 0; i < 2; i++) {
-        for (uint16_t sectorNo = 0; sectorNo < sectorsCnt; sectorNo++) {
+        for (uint16_t sectorNo = 0; sectorNo < 40; sectorNo++) {
             validKey[i][sectorNo] = false;
-            foundKey[i][sectorNo][0] = 0xFF;
-            foundKey[i][sectorNo][1] = 0xFF;
-            foundKey[i][sectorNo][2] = 0xFF;
-            foundKey[i][sectorNo][3] = 0xFF;
-            foundKey[i][sectorNo][4] = 0xFF;
-            foundKey[i][sectorNo][5] = 0xFF;
+            memset(foundKey[i][sectorNo], 0xFF, 6);
         }
     }
 
-    // Iterates through each sector checking if there is a correct key.
+    // no debug output in the key checks and the dump
+    DBGLEVEL = DBG_NONE;
+
     bool err = 0;
     bool allKeysFound = true;
-    uint32_t size = mfKeysCnt;
-
-    for (int type = 0; type < 2 && !err; type++) {
-        int block = blockNo;
-        for (int sec = 0; sec < sectorsCnt && !err; ++sec) {
-            Dbprintf("\tCurrent sector:%3d, block:%3d, key type: %c, key count: %i ", sec, block, type ? 'B' : 'A', mfKeysCnt);
-            int key = saMifareChkKeys(block, type, true, size, &keyBlock[0], &key64);
-            if (key == -1) {
-                LED(LED_RED, 50);
-                Dbprintf("\t [✕] Key not found for this sector!");
+
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+    if (iso14443a_select_card(uid, &p_card, &cuid, true, 0, true) == 0) {
+        Dbprintf("\t [✕] No card found");
+        err = 1;
+    } else if ((p_card.sak & 0x18) == 0x18) {
+        is4k = true;
+        sectorsCnt = 40;
+    }
+
+    /*
+        All sectors at once with the fast chk engine. The keys above go first, then the
+        dictionary SA_MF_DICT_FILE when there is one in flash. A found key is tried on
+        every other sector straight away, a found key A reads key B where it may.
+    */
+    mf_chkkeys_spiffs_resp_t chk;
+    if (!err) {
+        Dbprintf("\tChecking %u sectors, key count: %i (+ %s)", sectorsCnt, mfKeysCnt, SA_MF_DICT_FILE);
+        if (sa_mf_chk_dict(keyBlock, mfKeysCnt, sectorsCnt, &chk) != PM3_SUCCESS) {
+            err = 1; // Can't select card.
+        }
+    }
+
+    for (uint8_t type = 0; type < 2 && !err; type++) {
+        for (uint8_t sec = 0; sec < sectorsCnt; ++sec) {
+            if (sa_mf_chk_found(&chk, sec, type) == false) {
+                Dbprintf("\t [✕] Sector:%3d key %c not found", sec, type ? 'B' : 'A');
                 allKeysFound = false;
-                // break;
-            } else if (key == -2) {
-                err = 1; // Can't select card.
-                break;
-            } else {
-                num_to_bytes(key64, 6, foundKey[type][sec]);
-                validKey[type][sec] = true;
-                keyFound = true;
-                Dbprintf("\t [✓] Found valid key: [%02x%02x%02x%02x%02x%02x]\n",
-                         (keyBlock + 6 * key)[0], (keyBlock + 6 * key)[1], (keyBlock + 6 * key)[2],
-                         (keyBlock + 6 * key)[3], (keyBlock + 6 * key)[4], (keyBlock + 6 * key)[5]
-                        );
+                continue;
             }
 
-            block < 127 ? (block += 4) : (block += 16);
+            memcpy(foundKey[type][sec], chk.keys + sec * 12 + type * 6, 6);
+            validKey[type][sec] = true;
+            keyFound = true;
+            Dbprintf("\t [✓] Sector:%3d key %c [%02x%02x%02x%02x%02x%02x]", sec, type ? 'B' : 'A',
+                     foundKey[type][sec][0], foundKey[type][sec][1], foundKey[type][sec][2],
+                     foundKey[type][sec][3], foundKey[type][sec][4], foundKey[type][sec][5]
+                    );
         }
     }
 
@@ -464,16 +367,50 @@ void RunMod(void) {
         TODO:
         - Get UID from tag and set accordingly in emulator memory and call mifaresim with right flags (iceman)
     */
-    if (allKeysFound) {
+    if (err) {
+        LED_C_ON(); //red
+        allKeysFound = false;
+    } else if (allKeysFound) {
         Dbprintf("\t✓ All keys found");
     } else {
         if (keyFound) {
-            Dbprintf("\t✕ There's currently no nested attack in MattyRun, sorry!");
             LED_C_ON(); //red
             LED_A_ON(); //yellow
-            // no room to run nested attack on device (iceman)
-            // Do nested attack, set allKeysFound = true;
-            // allKeysFound = true;
+#ifdef WITH_FLASH
+            /*
+                There is no room for the key recovery on device, so collect the nonces of the
+                missing keys with a known one and leave the attack to the client, offline:
+                hf mf hardnested r f <file>
+            */
+            uint8_t ksec = 0, ktype = 0;
+            while (!validKey[ktype][ksec]) {
+                if (++ksec == sectorsCnt) {
+                    ksec = 0;
+                    ktype = 1;
+                }
+            }
+            uint64_t knownkey = bytes_to_num(foundKey[ktype][ksec], 6);
+
+            for (uint8_t type = 0; type < 2 && !err; type++) {
+                for (uint8_t sec = 0; sec < sectorsCnt && !err; ++sec) {
+                    if (validKey[type][sec])
+                        continue;
+
+                    char fn[32];
+                    sprintf(fn, "mattyrun_%08" PRIx32 "_%02u%c.bin", cuid, sec, type ? 'B' : 'A');
+                    Dbprintf("\tNested: sector:%3d key %c, %u nonces to " _YELLOW_("%s"), sec, type ? 'B' : 'A', SA_MF_NONCES, fn);
+
+                    int res = sa_mf_nonces_save(FirstBlockOfSector(ksec), ktype, knownkey, FirstBlockOfSector(sec), type, fn);
+                    if (res != PM3_SUCCESS) {
+                        Dbprintf("\t [✕] Nonce collection stopped (%d)", res);
+                        err = 1;
+                    }
+                }
+            }
+            Dbprintf("\tGet the nonces with `mem spiffs dump`, then `hf mf hardnested r f <file>` on each");
+#else
+            Dbprintf("\t✕ There's currently no nested attack in MattyRun without flash, sorry!");
+#endif
         }   else {
             Dbprintf("\t✕ There's nothing I can do without at least a one valid key, sorry!");
             LED_C_ON(); //red
@@ -506,12 +443,12 @@ void RunMod(void) {
             int filled;
             Dbprintf("\tFilling in with key A.");
 
-            filled = saMifareECardLoad(sectorsCnt, 0);
+            filled = sa_mf_ecard_load(uid, &p_card, &cuid, sectorsCnt, 0);
             if (filled != PM3_SUCCESS) {
 
                 Dbprintf("\t [✕] Failed filling with A.");
                 Dbprintf("\tFilling in with key B.");
-                filled = saMifareECardLoad(sectorsCnt, 1);
+                filled = sa_mf_ecard_load(uid, &p_card, &cuid, sectorsCnt, 1);
                 if (filled != PM3_SUCCESS) {
                     Dbprintf("\t [✕] Failed filling with B.");
                 }
@@ -525,7 +462,7 @@ void RunMod(void) {
 
                 LED_B_ON(); // green
 
-                uint16_t simflags = FLAG_UID_IN_EMUL | FLAG_MF_1K;
+                uint16_t simflags = FLAG_UID_IN_EMUL | (is4k ? FLAG_MF_4K : FLAG_MF_1K);
 
                 SpinOff(1000);
                 Mifare1ksim(simflags, 0, uid, 0, 0);
@@ -533,7 +470,7 @@ void RunMod(void) {
                 Dbprintf("\t [✓] Simulation ended");
 
                 // Needs further testing.
-                if (fillFromEmulator) {
+                if (fillFromEmulator && !is4k) {
                     uint8_t retry = 5;
                     Dbprintf("\t Trying to dump into blank card.");
                     int flags = 0;
@@ -0,0 +1,168 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Several standalone modes in one image, picked with the button on entering
+// standalone mode. Built when STANDALONE lists more than one mode.
+//
+// The Makefile compiles every mode with its RunMod / ModInfo renamed to
+// RunMod_<MODE> / ModInfo_<MODE>, e.g. RunMod_LF_ICEHID.
+//
+// LEDs show 1 + the index of the mode in binary, LED A is the lowest bit.
+// Click to go to the next mode, hold to start it. The last mode started
+// is offered first the next time.
+//-----------------------------------------------------------------------------
+#include "standalone.h" // standalone definitions
+#include "standalone_services.h"
+
+#include "proxmark3_arm.h"
+#include "appmain.h"
+#include "dbprint.h"
+#include "util.h"
+#include "commonutil.h"  // ARRAYLEN
+
+typedef struct {
+    const char *name;
+    void (*run)(void);
+    void (*info)(void);
+} sa_mode_t;
+
+#define SA_MODE(m)  void RunMod_##m(void); void ModInfo_##m(void);
+#define SA_ENTRY(m) { #m, RunMod_##m, ModInfo_##m },
+
+#ifdef WITH_STANDALONE_LF_SKELETON
+SA_MODE(LF_SKELETON)
+#endif
+#ifdef WITH_STANDALONE_LF_EM4100EMUL
+SA_MODE(LF_EM4100EMUL)
+#endif
+#ifdef WITH_STANDALONE_LF_EM4100RSWB
+SA_MODE(LF_EM4100RSWB)
+#endif
+#ifdef WITH_STANDALONE_LF_EM4100RWC
+SA_MODE(LF_EM4100RWC)
+#endif
+#ifdef WITH_STANDALONE_LF_HIDBRUTE
+SA_MODE(LF_HIDBRUTE)
+#endif
+#ifdef WITH_STANDALONE_LF_ICEHID
+SA_MODE(LF_ICEHID)
+#endif
+#ifdef WITH_STANDALONE_LF_PROXBRUTE
+SA_MODE(LF_PROXBRUTE)
+#endif
+#ifdef WITH_STANDALONE_LF_SAMYRUN
+SA_MODE(LF_SAMYRUN)
+#endif
+#ifdef WITH_STANDALONE_HF_14ASNIFF
+SA_MODE(HF_14ASNIFF)
+#endif
+#ifdef WITH_STANDALONE_HF_AVEFUL
+SA_MODE(HF_AVEFUL)
+#endif
+#ifdef WITH_STANDALONE_HF_BOG
+SA_MODE(HF_BOG)
+#endif
+#ifdef WITH_STANDALONE_HF_COLIN
+SA_MODE(HF_COLIN)
+#endif
+#ifdef WITH_STANDALONE_HF_ICECLASS
+SA_MODE(HF_ICECLASS)
+#endif
+#ifdef WITH_STANDALONE_HF_LEGIC
+SA_MODE(HF_LEGIC)
+#endif
+#ifdef WITH_STANDALONE_HF_MATTYRUN
+SA_MODE(HF_MATTYRUN)
+#endif
+#ifdef WITH_STANDALONE_HF_MSDSAL
+SA_MODE(HF_MSDSAL)
+#endif
+#ifdef WITH_STANDALONE_HF_YOUNG
+SA_MODE(HF_YOUNG)
+#endif
+
+static const sa_mode_t sa_modes[] = {
+#ifdef WITH_STANDALONE_LF_SKELETON
+    SA_ENTRY(LF_SKELETON)
+#endif
+#ifdef WITH_STANDALONE_LF_EM4100EMUL
+    SA_ENTRY(LF_EM4100EMUL)
+#endif
+#ifdef WITH_STANDALONE_LF_EM4100RSWB
+    SA_ENTRY(LF_EM4100RSWB)
+#endif
+#ifdef WITH_STANDALONE_LF_EM4100RWC
+    SA_ENTRY(LF_EM4100RWC)
+#endif
+#ifdef WITH_STANDALONE_LF_HIDBRUTE
+    SA_ENTRY(LF_HIDBRUTE)
+#endif
+#ifdef WITH_STANDALONE_LF_ICEHID
+    SA_ENTRY(LF_ICEHID)
+#endif
+#ifdef WITH_STANDALONE_LF_PROXBRUTE
+    SA_ENTRY(LF_PROXBRUTE)
+#endif
+#ifdef WITH_STANDALONE_LF_SAMYRUN
+    SA_ENTRY(LF_SAMYRUN)
+#endif
+#ifdef WITH_STANDALONE_HF_14ASNIFF
+    SA_ENTRY(HF_14ASNIFF)
+#endif
+#ifdef WITH_STANDALONE_HF_AVEFUL
+    SA_ENTRY(HF_AVEFUL)
+#endif
+#ifdef WITH_STANDALONE_HF_BOG
+    SA_ENTRY(HF_BOG)
+#endif
+#ifdef WITH_STANDALONE_HF_COLIN
+    SA_ENTRY(HF_COLIN)
+#endif
+#ifdef WITH_STANDALONE_HF_ICECLASS
+    SA_ENTRY(HF_ICECLASS)
+#endif
+#ifdef WITH_STANDALONE_HF_LEGIC
+    SA_ENTRY(HF_LEGIC)
+#endif
+#ifdef WITH_STANDALONE_HF_MATTYRUN
+    SA_ENTRY(HF_MATTYRUN)
+#endif
+#ifdef WITH_STANDALONE_HF_MSDSAL
+    SA_ENTRY(HF_MSDSAL)
+#endif
+#ifdef WITH_STANDALONE_HF_YOUNG
+    SA_ENTRY(HF_YOUNG)
+#endif
+};
+
+#define SA_MODES_COUNT  ((uint8_t)ARRAYLEN(sa_modes))
+
+static uint8_t sa_last_mode = 0;
+
+void ModInfo(void) {
+    DbpString("  Multi standalone, hold the button to start, click for the next mode:");
+    for (uint8_t i = 0; i < SA_MODES_COUNT; i++) {
+        Dbprintf("  " _YELLOW_("%u") " %s", i + 1, sa_modes[i].name);
+        sa_modes[i].info();
+    }
+}
+
+void RunMod(void) {
+    StandAloneMode();
+
+    Dbprintf("[=] %u standalone modes, LEDs show the number. Click for the next, hold to start", SA_MODES_COUNT);
+    for (uint8_t i = 0; i < SA_MODES_COUNT; i++)
+        Dbprintf("[=]   %u %s", i + 1, sa_modes[i].name);
+
+    int mode = sa_choose(SA_MODES_COUNT, sa_last_mode);
+    if (mode == SA_ABORTED) {
+        LEDsoff();
+        return;
+    }
+
+    sa_last_mode = mode;
+    Dbprintf("[=] starting " _YELLOW_("%s"), sa_modes[mode].name);
+    sa_modes[mode].run();
+}
@@ -0,0 +1,413 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Services shared by the standalone modes: button / LED UI, Mifare Classic
+// key checks and emulator fill, buffered logging to flash
+//-----------------------------------------------------------------------------
+#include "standalone_services.h"
+
+#include "proxmark3_arm.h"
+#include "util.h"
+#include "ticks.h"
+#include "string.h"
+#include "commonutil.h"
+#include "fpgaloader.h"
+#include "BigBuf.h"
+#include "crc16.h"
+
+#ifdef WITH_ISO14443a
+#include "iso14443a.h"
+#include "mifareutil.h"
+#include "mifarecmd.h"
+#endif
+
+#ifdef WITH_FLASH
+#include "spiffs.h"
+#endif
+
+void sa_leds_show(uint8_t mask) {
+    LEDsoff();
+    LED(mask & (LED_A | LED_B | LED_C | LED_D), 0);
+}
+
+int sa_button_wait(uint32_t timeout_ms) {
+    uint32_t start = GetTickCount();
+
+    // a press still going on from before doesn't count
+    while (BUTTON_PRESS()) {
+        WDT_HIT();
+        if (data_available())
+            return SA_ABORTED;
+    }
+
+    for (;;) {
+        WDT_HIT();
+        if (data_available())
+            return SA_ABORTED;
+        if (BUTTON_PRESS())
+            break;
+        if (timeout_ms && GetTickCountDelta(start) > timeout_ms)
+            return BUTTON_NO_CLICK;
+    }
+    return BUTTON_HELD(SA_BUTTON_HOLD_MS);
+}
+
+int sa_choose(uint8_t count, uint8_t current) {
+    if (count == 0)
+        return SA_ABORTED;
+
+    current %= count;
+    for (;;) {
+        sa_leds_show(current + 1);
+        int button = sa_button_wait(0);
+        if (button == SA_ABORTED)
+            return SA_ABORTED;
+        if (button == BUTTON_HOLD)
+            break;
+        if (button == BUTTON_SINGLE_CLICK)
+            current = (current + 1) % count;
+    }
+
+    // acknowledge and wait for the release, the mode mustn't see this press
+    SpinErr(LED_A | LED_B | LED_C | LED_D, 80, 2);
+    while (BUTTON_PRESS())
+        WDT_HIT();
+    LEDsoff();
+    return current;
+}
+
+#ifdef WITH_ISO14443a
+
+static uint8_t sa_mf_cascades(const iso14a_card_select_t *card) {
+    switch (card->uidlen) {
+        case 7:
+            return 2;
+        case 10:
+            return 3;
+        default:
+            return 1;
+    }
+}
+
+int sa_mf_chk_keys(uint8_t *uid, iso14a_card_select_t *card, uint32_t *cuid,
+                   uint8_t blockNo, uint8_t keyType, uint8_t *keys, uint16_t keyCount, uint64_t *key) {
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+    set_tracing(false);
+
+    struct Crypto1State mpcs = {0, 0};
+    struct Crypto1State *pcs = &mpcs;
+
+    int retval = -1;
+    uint8_t cascades = 0;
+
+    for (uint16_t i = 0; i < keyCount; i++) {
+        WDT_HIT();
+
+        // only the first select needs the anticollision, the tag must still be the same one
+        if (cascades == 0) {
+            if (iso14443a_select_card(uid, card, cuid, true, 0, true) == 0) {
+                retval = -2;
+                break;
+            }
+            cascades = sa_mf_cascades(card);
+        } else if (iso14443a_fast_select_card(uid, cascades) == 0) {
+            retval = -2;
+            break;
+        }
+
+        uint64_t ui64Key = bytes_to_num(keys + i * 6, 6);
+        if (mifare_classic_auth(pcs, *cuid, blockNo, keyType, ui64Key, AUTH_FIRST)) {
+            uint8_t dummy_answer = 0;
+            ReaderTransmit(&dummy_answer, 1, NULL);
+            // wait for the card to become ready again
+            SpinDelayUs(AUTHENTICATION_TIMEOUT);
+            continue;
+        }
+        *key = ui64Key;
+        retval = i;
+        break;
+    }
+    crypto1_deinit(pcs);
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    return retval;
+}
+
+int sa_mf_ecard_load(uint8_t *uid, iso14a_card_select_t *card, uint32_t *cuid, uint8_t sectors, uint8_t keyType) {
+    struct Crypto1State mpcs = {0, 0};
+    struct Crypto1State *pcs = &mpcs;
+
+    uint8_t dataoutbuf[16];
+    uint8_t dataoutbuf2[16];
+
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+    clear_trace();
+    set_tracing(false);
+
+    int retval = PM3_SUCCESS;
+
+    if (iso14443a_select_card(uid, card, cuid, true, 0, true) == 0) {
+        retval = PM3_ESOFT;
+        goto out;
+    }
+
+    for (uint8_t s = 0; s < sectors && retval == PM3_SUCCESS; s++) {
+        uint64_t ui64Key = emlGetKey(s, keyType);
+        if (mifare_classic_auth(pcs, *cuid, FirstBlockOfSector(s), keyType, ui64Key, (s == 0) ? AUTH_FIRST : AUTH_NESTED)) {
+            retval = PM3_ESOFT;
+            break;
+        }
+
+        for (uint8_t blockNo = 0; blockNo < NumBlocksPerSector(s); blockNo++) {
+            if (mifare_classic_readblock(pcs, *cuid, FirstBlockOfSector(s) + blockNo, dataoutbuf)) {
+                retval = PM3_ESOFT;
+                break;
+            }
+
+            if (blockNo < NumBlocksPerSector(s) - 1) {
+                emlSetMem(dataoutbuf, FirstBlockOfSector(s) + blockNo, 1);
+            } else {
+                // sector trailer, keep the keys, set only the AC
+                emlGetMem(dataoutbuf2, FirstBlockOfSector(s) + blockNo, 1);
+                memcpy(&dataoutbuf2[6], &dataoutbuf[6], 4);
+                emlSetMem(dataoutbuf2, FirstBlockOfSector(s) + blockNo, 1);
+            }
+        }
+    }
+
+    mifare_classic_halt(pcs, *cuid);
+
+out:
+    crypto1_deinit(pcs);
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    return retval;
+}
+
+int sa_mf_chk_dict(uint8_t *keys, uint16_t keycnt, uint8_t sectors, mf_chkkeys_spiffs_resp_t *res) {
+    memset(res, 0, sizeof(mf_chkkeys_spiffs_resp_t));
+
+    // the short list catches the usual keys before the flash is touched
+    int retval = MifareChkKeys_dict(NULL, keys, keycnt, sectors, res, false);
+
+#ifdef WITH_FLASH
+    if (retval == PM3_SUCCESS && res->foundkeys < sectors * 2) {
+        retval = MifareChkKeys_dict(SA_MF_DICT_FILE, NULL, 0, sectors, res, false);
+        // no dictionary, the short list was all
+        if (retval == PM3_EFILE)
+            retval = PM3_SUCCESS;
+    }
+#endif
+
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    LEDsoff();
+    return retval;
+}
+
+bool sa_mf_chk_found(const mf_chkkeys_spiffs_resp_t *res, uint8_t sector, uint8_t keyType) {
+    uint8_t m = (sector * 2) + (keyType & 1);
+    return (res->found[m >> 3] >> (m & 7)) & 1;
+}
+
+#ifdef WITH_FLASH
+
+// a fast select or an auth failing this often in a row means the card is gone
+#define SA_MF_NONCES_RETRIES    50
+
+int sa_mf_nonces_save(uint8_t blockNo, uint8_t keyType, uint64_t key, uint8_t trgBlockNo, uint8_t trgKeyType, const char *fn) {
+    // nonce file version 1: cuid (4) | target block (1) | target key type (1) | pairs,
+    // a pair is nt_enc1 (4) | nt_enc2 (4) | par_enc1 << 4 | par_enc2 (1)
+    uint32_t size = 6 + (SA_MF_NONCES / 2) * 9;
+    uint8_t *buf = BigBuf_malloc_arena(size, BIGBUF_ARENA_SCRATCH);
+    if (buf == NULL)
+        return PM3_EMALLOC;
+
+    struct Crypto1State mpcs = {0, 0};
+    struct Crypto1State *pcs = &mpcs;
+
+    uint8_t uid[10] = {0x00};
+    iso14a_card_select_t card;
+    uint32_t cuid = 0;
+    uint8_t answer[MAX_MIFARE_FRAME_SIZE] = {0x00};
+    uint8_t par_enc[1] = {0x00};
+    uint32_t len = 6;
+    uint16_t nonces = 0;
+    uint8_t fails = 0;
+    int retval = PM3_SUCCESS;
+
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+    set_tracing(false);
+
+    if (iso14443a_select_card(uid, &card, &cuid, true, 0, true) == 0) {
+        retval = PM3_ECARDEXCHANGE;
+        goto out;
+    }
+    uint8_t cascades = sa_mf_cascades(&card);
+
+    num_to_bytes(cuid, 4, buf);
+    buf[4] = trgBlockNo;
+    buf[5] = trgKeyType;
+
+    while (len < size) {
+        WDT_HIT();
+        if (BUTTON_PRESS() || data_available()) {
+            retval = PM3_EOPABORTED;
+            break;
+        }
+
+        if (fails == SA_MF_NONCES_RETRIES) {
+            retval = PM3_ECARDEXCHANGE;
+            break;
+        }
+
+        if (iso14443a_fast_select_card(uid, cascades) == 0) {
+            fails++;
+            continue;
+        }
+
+        if (mifare_classic_authex(pcs, cuid, blockNo, keyType, key, AUTH_FIRST, NULL, NULL)) {
+            fails++;
+            continue;
+        }
+
+        // nested authentication, the encrypted nonce is all we want
+        uint16_t n = mifare_sendcmd_short(pcs, AUTH_NESTED, 0x60 + (trgKeyType & 0x01), trgBlockNo, answer, par_enc, NULL);
+
+        uint8_t dummy_answer = 0;
+        ReaderTransmit(&dummy_answer, 1, NULL);
+        SpinDelayUs(AUTHENTICATION_TIMEOUT);
+
+        if (n != 4) {
+            fails++;
+            continue;
+        }
+        fails = 0;
+
+        if ((nonces++ % 2) == 0) {
+            memcpy(buf + len, answer, 4);
+            buf[len + 8] = par_enc[0] & 0xf0;
+        } else {
+            memcpy(buf + len + 4, answer, 4);
+            buf[len + 8] |= par_enc[0] >> 4;
+            len += 9;
+        }
+    }
+
+out:
+    crypto1_deinit(pcs);
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+
+    if (len > 6) {
+        LED_B_ON();
+        int changed = rdv40_spiffs_lazy_mount();
+        rdv40_spiffs_write(fn, buf, len, RDV40_SPIFFS_SAFETY_SAFE);
+        rdv40_spiffs_lazy_mount_rollback(changed);
+        LED_B_OFF();
+    }
+
+    BigBuf_release(buf);
+    return retval;
+}
+
+#endif // WITH_FLASH
+
+#endif // WITH_ISO14443a
+
+#ifdef WITH_FLASH
+
+// bytes in front of the payload in buf
+static uint8_t sa_log_hdr(const sa_log_t *log) {
+    return log->framed ? sizeof(spiffs_log_chunk_t) : 0;
+}
+
+void sa_log_open(sa_log_t *log, const char *filename, uint8_t flags) {
+    memset(log, 0, sizeof(sa_log_t));
+    strncpy(log->filename, filename, sizeof(log->filename) - 1);
+    log->framed = (flags & SA_LOG_FRAMED);
+    rdv40_spiffs_lazy_mount();
+    log->exists = exists_in_spiffs(log->filename);
+    if (log->exists == false)
+        return;
+
+    rdv40_spiffs_stat(log->filename, &log->size, RDV40_SPIFFS_SAFETY_SAFE);
+
+    // keep appending the way the file was started
+    if (log->framed) {
+        uint16_t magic = 0;
+        int fd = rdv40_spiffs_open_read(log->filename);
+        if (fd >= 0) {
+            rdv40_spiffs_read_fd(fd, (uint8_t *)&magic, sizeof(magic));
+            rdv40_spiffs_close_fd(fd);
+        }
+        log->framed = (magic == SPIFFS_LOG_MAGIC);
+    }
+}
+
+// writes the first n bytes of payload, as one chunk when framed
+static void sa_log_commit(sa_log_t *log, uint16_t n) {
+    uint8_t hdr = sa_log_hdr(log);
+    if (log->framed) {
+        spiffs_log_chunk_t *chunk = (spiffs_log_chunk_t *)log->buf;
+        chunk->magic = SPIFFS_LOG_MAGIC;
+        chunk->len = n;
+        chunk->crc = Crc16ex(CRC_CCITT, log->buf + hdr, n);
+    }
+
+    LED_B_ON();
+    if (log->exists) {
+        rdv40_spiffs_append(log->filename, log->buf, hdr + n, RDV40_SPIFFS_SAFETY_SAFE);
+    } else {
+        rdv40_spiffs_write(log->filename, log->buf, hdr + n, RDV40_SPIFFS_SAFETY_SAFE);
+        log->exists = true;
+    }
+    LED_B_OFF();
+
+    log->size += hdr + n;
+    log->len -= n;
+    memmove(log->buf + hdr, log->buf + hdr + n, log->len);
+}
+
+void sa_log_flush(sa_log_t *log) {
+    if (log->len)
+        sa_log_commit(log, log->len);
+}
+
+// flushes up to the last page boundary the buffer reaches
+static void sa_log_flush_blocks(sa_log_t *log) {
+    uint32_t start = log->size + sa_log_hdr(log);
+    uint32_t end = ((start + log->len) / SA_LOG_BLOCK_SIZE) * SA_LOG_BLOCK_SIZE;
+    if (end > start)
+        sa_log_commit(log, end - start);
+}
+
+void sa_log_write(sa_log_t *log, const uint8_t *data, uint16_t len) {
+    uint8_t hdr = sa_log_hdr(log);
+    while (len) {
+        if (log->len == SA_LOG_BUFFER_SIZE)
+            sa_log_flush_blocks(log);
+
+        uint16_t n = MIN(len, SA_LOG_BUFFER_SIZE - log->len);
+        memcpy(log->buf + hdr + log->len, data, n);
+        log->len += n;
+        data += n;
+        len -= n;
+    }
+    log->last_write = GetTickCount();
+}
+
+bool sa_log_idle(sa_log_t *log, uint32_t idle_ms) {
+    if (log->len == 0 || GetTickCountDelta(log->last_write) <= idle_ms)
+        return false;
+
+    sa_log_flush(log);
+    return true;
+}
+
+void sa_log_close(sa_log_t *log) {
+    sa_log_flush(log);
+    LED_C_ON();
+    rdv40_spiffs_lazy_unmount();
+    LED_C_OFF();
+}
+
+#endif // WITH_FLASH
@@ -0,0 +1,100 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Services shared by the standalone modes: button / LED UI, Mifare Classic
+// key checks and emulator fill, buffered logging to flash
+//-----------------------------------------------------------------------------
+
+#ifndef __STANDALONE_SERVICES_H
+#define __STANDALONE_SERVICES_H
+
+#include "common.h"
+#include "mifare.h"
+#include "pm3_cmd.h"
+#include "spiffs_config.h"
+
+// sa_button_wait() result when the client sent a command, leave standalone mode
+#define SA_ABORTED          -3
+// a press this long on the button is a hold
+#define SA_BUTTON_HOLD_MS   600
+
+// LED_A..LED_D show the low 4 bits of mask, the others are turned off
+void sa_leds_show(uint8_t mask);
+
+// Waits up to timeout_ms (0 = forever) for a press on the button. Returns
+// BUTTON_SINGLE_CLICK, BUTTON_HOLD, BUTTON_NO_CLICK on timeout or SA_ABORTED
+int sa_button_wait(uint32_t timeout_ms);
+
+// Picks one of count choices on the LEDs, 1 + index in binary. A click goes to the next
+// one, a hold takes it. Returns the index or SA_ABORTED
+int sa_choose(uint8_t count, uint8_t current);
+
+// Tries keyCount 6 byte keys from keys on blockNo. The card is selected with anticollision
+// once, then re-selected with its known UID before every key. uid, card and cuid are
+// updated like iso14443a_select_card does.
+// Returns the index of the key found (in *key), -1 when none fits, -2 when the card is gone
+int sa_mf_chk_keys(uint8_t *uid, iso14a_card_select_t *card, uint32_t *cuid,
+                   uint8_t blockNo, uint8_t keyType, uint8_t *keys, uint16_t keyCount, uint64_t *key);
+
+// Reads sectors of the card into emulator memory with the keys already there,
+// keeping them in the sector trailers. PM3_SUCCESS or PM3_ESOFT
+int sa_mf_ecard_load(uint8_t *uid, iso14a_card_select_t *card, uint32_t *cuid, uint8_t sectors, uint8_t keyType);
+
+// dictionary in SPIFFS for sa_mf_chk_dict, e.g. `mem spiffs load f mfc_default_keys o mfc_keys.bin d`
+#define SA_MF_DICT_FILE     "mfc_keys.bin"
+
+// Finds the A and B keys of sectors sectors with the fast chk engine of MifareChkKeys_dict, with
+// keycnt 6 byte keys from keys first, then the rest with SA_MF_DICT_FILE if it is in SPIFFS.
+// Keys and found bits end up in res. PM3_SUCCESS or PM3_ECARDEXCHANGE / PM3_EOPABORTED
+int sa_mf_chk_dict(uint8_t *keys, uint16_t keycnt, uint8_t sectors, mf_chkkeys_spiffs_resp_t *res);
+bool sa_mf_chk_found(const mf_chkkeys_spiffs_resp_t *res, uint8_t sector, uint8_t keyType);
+
+#ifdef WITH_FLASH
+// encrypted nonces sa_mf_nonces_save collects, enough for hardnested on most cards
+#define SA_MF_NONCES        4000
+
+// With a known key of blockNo, collects SA_MF_NONCES encrypted nonces of trgBlockNo / trgKeyType and
+// saves them to SPIFFS as fn, a nonce file for the attack offline:
+// `mem spiffs dump o <fn> f <fn>` then `hf mf hardnested r f <fn>`.
+// PM3_SUCCESS, PM3_EMALLOC, PM3_ECARDEXCHANGE or PM3_EOPABORTED, the nonces so far are saved anyway
+int sa_mf_nonces_save(uint8_t blockNo, uint8_t keyType, uint64_t key, uint8_t trgBlockNo, uint8_t trgKeyType, const char *fn);
+#endif
+
+#ifdef WITH_FLASH
+// Log file in SPIFFS with a RAM buffer in front, so one flash write covers several entries.
+// Entries are lost if the power goes before a flush
+//
+// A full buffer is flushed up to a SPIFFS data page boundary of the file (256 byte page less its
+// 5 byte header), the rest stays in RAM, so pages are programmed whole. sa_log_idle / sa_log_flush
+// write everything
+#define SA_LOG_BLOCK_SIZE   (SPIFFS_CFG_LOG_PAGE_SZ(0) - 5)
+#define SA_LOG_BUFFER_SIZE  (2 * SA_LOG_BLOCK_SIZE)
+
+// sa_log_open flags
+// every flush is a spiffs_log_chunk_t chunk, for binary logs. An old file without them stays unframed
+#define SA_LOG_FRAMED       0x01
+
+typedef struct {
+    char filename[32];
+    bool exists;
+    bool framed;
+    uint32_t size;          // of the file, for the page alignment
+    uint16_t len;           // payload waiting in buf
+    uint32_t last_write;
+    uint8_t buf[sizeof(spiffs_log_chunk_t) + SA_LOG_BUFFER_SIZE];
+} sa_log_t;
+
+// mounts the flash
+void sa_log_open(sa_log_t *log, const char *filename, uint8_t flags);
+void sa_log_write(sa_log_t *log, const uint8_t *data, uint16_t len);
+// writes the buffer when something waits in it for idle_ms, call it from the mode loop.
+// Returns true if the flash was written
+bool sa_log_idle(sa_log_t *log, uint32_t idle_ms);
+void sa_log_flush(sa_log_t *log);
+// flushes and unmounts the flash
+void sa_log_close(sa_log_t *log);
+#endif
+
+#endif /* __STANDALONE_SERVICES_H */
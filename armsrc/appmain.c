@@ -35,7 +35,10 @@
 #include "legicrfsim.h"
 //#include "cryptorfsim.h"
 #include "epa.h"
+#include "lto.h"
 #include "hfsnoop.h"
+#include "hfsearch.h"
+#include "profiling.h"
 #include "lfops.h"
 #include "lfsampling.h"
 #include "mifarecmd.h"
@@ -46,6 +49,8 @@
 #include "util.h"
 #include "ticks.h"
 #include "commonutil.h"
+#include "crc32.h"
+#include "lz4.h"
 
 #ifdef WITH_LCD
 #include "LCD.h"
@@ -209,14 +214,88 @@ static uint32_t MeasureAntennaTuningLfData(void) {
     return (MAX_ADC_LF_VOLTAGE * (SumAdc(ADC_CHAN_LF, 32) >> 1)) >> 14;
 }
 
-void print_stack_usage(void) {
-    // pointer arithmetic is times 4. (two shifts to the left)
-    for (uint32_t *p = &_stack_start; ; ++p) {
-        if (*p != 0xdeadbeef) {
-            Dbprintf("  Max stack usage.........%d / %d bytes", (&_stack_end - p) << 2, (&_stack_end - &_stack_start) << 2);
-            break;
+// Pushes the antenna voltage every interval ms until the client sends something or the button is pressed
+static void StreamAntennaTuning(const antenna_tuning_stream_req_t *req) {
+
+    bool hf = req->flags & ANTENNA_TUNING_STREAM_HF;
+    uint16_t interval = req->interval;
+    if (interval < ANTENNA_TUNING_STREAM_MIN_MS || interval > ANTENNA_TUNING_STREAM_MAX_MS || (hf == false && req->divisor < 19)) {
+        reply_ng(CMD_MEASURE_ANTENNA_TUNING_STREAM, PM3_EINVARG, NULL, 0);
+        return;
+    }
+
+    if (hf) {
+        FpgaDownloadAndGo(FPGA_BITSTREAM_HF);
+        FpgaWriteConfWord(FPGA_MAJOR_MODE_HF_READER);
+    } else {
+        FpgaDownloadAndGo(FPGA_BITSTREAM_LF);
+        FpgaWriteConfWord(FPGA_MAJOR_MODE_LF_READER | FPGA_LF_ADC_READER_FIELD);
+        FpgaSendCommand(FPGA_CMD_SET_DIVISOR, req->divisor);
+    }
+    // let the field settle
+    SpinDelay(50);
+
+    antenna_tuning_stream_frame_t frame;
+    memset(&frame, 0, sizeof(frame));
+
+    LED_A_ON();
+
+    bool stop = false;
+    while (stop == false) {
+        uint32_t sum = 0;
+        frame.count = 0;
+        frame.min = UINT32_MAX;
+        frame.max = 0;
+
+        uint32_t start = GetTickCount();
+        while (GetTickCount() - start < interval) {
+            WDT_HIT();
+
+            if (BUTTON_PRESS() || data_available()) {
+                stop = true;
+                break;
+            }
+
+            uint32_t volt = hf ? MeasureAntennaTuningHfData() : MeasureAntennaTuningLfData();
+            sum += volt;
+            frame.min = MIN(frame.min, volt);
+            frame.max = MAX(frame.max, volt);
+            frame.count++;
         }
+
+        if (stop || frame.count == 0)
+            break;
+
+        frame.avg = sum / frame.count;
+        LED_B_ON();
+        reply_ng(CMD_MEASURE_ANTENNA_TUNING_STREAM, PM3_SUCCESS, (uint8_t *)&frame, sizeof(frame));
+        LED_B_OFF();
+        frame.seq++;
     }
+
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+
+    frame.final = true;
+    frame.count = 0;
+    frame.avg = frame.min = frame.max = 0;
+    reply_ng(CMD_MEASURE_ANTENNA_TUNING_STREAM, PM3_EOPABORTED, (uint8_t *)&frame, sizeof(frame));
+    LEDsoff();
+}
+
+uint32_t get_stack_usage(void) {
+    // pointer arithmetic is times 4. (two shifts to the left)
+    uint32_t *p = &_stack_start;
+    while (p < &_stack_end && *p == 0xdeadbeef)
+        ++p;
+    return (&_stack_end - p) << 2;
+}
+
+uint32_t get_stack_size(void) {
+    return (&_stack_end - &_stack_start) << 2;
+}
+
+void print_stack_usage(void) {
+    Dbprintf("  Max stack usage.........%d / %d bytes", get_stack_usage(), get_stack_size());
 }
 
 void ReadMem(int addr) {
@@ -362,6 +441,7 @@ static void SendStatus(void) {
     printHf14aConfig();   // HF 14a config
 #endif
     printConnSpeed();
+    profiling_print_status();
     DbpString(_CYAN_("Various"));
 
     print_stack_usage();
@@ -504,6 +584,293 @@ static void SendCapabilities(void) {
     reply_ng(CMD_CAPABILITIES, PM3_SUCCESS, (uint8_t *)&capabilities, sizeof(capabilities));
 }
 
+// Pushes a memory range as a continuous stream of sequence numbered frames,
+// without waiting in between. Ends with a CMD_DOWNLOAD_STREAM reply holding the CRC32 of the whole range
+static void DownloadStream(download_stream_req_t *req) {
+
+    LED_B_ON();
+    download_stream_end_t end;
+    memset(&end, 0, sizeof(end));
+
+    uint8_t *mem = NULL;
+    uint32_t memsize = 0;
+    switch (req->memtype) {
+        case DL_STREAM_BIGBUF:
+            BigBuf_linearize_trace();
+            mem = BigBuf_get_addr();
+            memsize = BigBuf_get_size();
+            break;
+        case DL_STREAM_BIGBUF_EML:
+            mem = BigBuf_get_EM_addr();
+            memsize = CARD_MEMORY_SIZE;
+            break;
+#ifdef WITH_FLASH
+        case DL_STREAM_FLASHMEM:
+            memsize = FLASH_MEM_MAX_SIZE;
+            if (FlashInit() == false) {
+                reply_ng(CMD_DOWNLOAD_STREAM, PM3_EFLASH, NULL, 0);
+                LED_B_OFF();
+                return;
+            }
+            break;
+#endif
+        default:
+            reply_ng(CMD_DOWNLOAD_STREAM, PM3_ENOTIMPL, NULL, 0);
+            LED_B_OFF();
+            return;
+    }
+
+    if ((req->start > memsize) || (req->length > memsize - req->start) ||
+            (req->length > (uint32_t)UINT16_MAX * DL_STREAM_CHUNK_SIZE)) {
+        reply_ng(CMD_DOWNLOAD_STREAM, PM3_EOUTOFBOUND, NULL, 0);
+        LED_B_OFF();
+        return;
+    }
+
+    // compression works in place on BigBuf, flash would need a bounce buffer
+    if ((req->flags & DL_STREAM_LZ4) && (req->memtype == DL_STREAM_FLASHMEM)) {
+        reply_ng(CMD_DOWNLOAD_STREAM, PM3_ENOTIMPL, NULL, 0);
+        LED_B_OFF();
+        return;
+    }
+
+    uint32_t crc = CRC32_PRESET;
+    int res = PM3_SUCCESS;
+
+    if (req->flags & DL_STREAM_LZ4) {
+        download_stream_lz4_chunk_t lchunk;
+        uint8_t *src = mem + req->start;
+        uint32_t i = 0;
+        while (i < req->length) {
+            // each frame is compressed on its own, so a lost frame doesn't spoil the next ones
+            int srclen = MIN(req->length - i, DL_STREAM_LZ4_MAX_RAW);
+            int clen = LZ4_compress_destSize((const char *)src + i, (char *)lchunk.data, &srclen, sizeof(lchunk.data));
+            if (clen <= 0 || srclen <= 0) {
+                res = PM3_ESOFT;
+                break;
+            }
+            lchunk.seq = end.frames++;
+            lchunk.offset = i;
+            lchunk.rawlen = srclen;
+            crc = crc32_update(crc, src + i, srclen);
+            reply_ng(CMD_DOWNLOADED_STREAM, PM3_SUCCESS, (uint8_t *)&lchunk, offsetof(download_stream_lz4_chunk_t, data) + clen);
+            i += srclen;
+        }
+        goto out;
+    }
+
+    // not from BigBuf_malloc, it would land in the memory we are pushing
+    download_stream_chunk_t chunk;
+
+    for (uint32_t i = 0; i < req->length; i += DL_STREAM_CHUNK_SIZE) {
+        uint16_t len = MIN(req->length - i, DL_STREAM_CHUNK_SIZE);
+        chunk.seq = i / DL_STREAM_CHUNK_SIZE;
+
+#ifdef WITH_FLASH
+        if (req->memtype == DL_STREAM_FLASHMEM) {
+            Flash_CheckBusy(BUSY_TIMEOUT);
+            if (Flash_ReadDataCont(req->start + i, chunk.data, len) != len) {
+                res = PM3_EFLASH;
+                break;
+            }
+        } else
+#endif
+            memcpy(chunk.data, mem + req->start + i, len);
+
+        crc = crc32_update(crc, chunk.data, len);
+        reply_ng(CMD_DOWNLOADED_STREAM, PM3_SUCCESS, (uint8_t *)&chunk, sizeof(chunk.seq) + len);
+        end.frames++;
+    }
+
+#ifdef WITH_FLASH
+    if (req->memtype == DL_STREAM_FLASHMEM)
+        FlashStop();
+#endif
+
+out:
+    end.length = req->length;
+    end.crc = crc;
+    end.tracelen = BigBuf_get_traceLen();
+    memcpy(&end.config, getSamplingConfig(), sizeof(sample_config));
+    reply_ng(CMD_DOWNLOAD_STREAM, res, (uint8_t *)&end, sizeof(end));
+    LED_B_OFF();
+}
+
+#ifdef WITH_FLASH
+// The dictionaries live in their own sectors, a write starting at one of them erases it first
+static void FlashEraseDictionary(uint32_t startidx) {
+    if (startidx == DEFAULT_T55XX_KEYS_OFFSET) {
+        Flash_CheckBusy(BUSY_TIMEOUT);
+        Flash_WriteEnable();
+        Flash_Erase4k(3, 0xC);
+    } else if (startidx ==  DEFAULT_MF_KEYS_OFFSET) {
+        Flash_CheckBusy(BUSY_TIMEOUT);
+        Flash_WriteEnable();
+        Flash_Erase4k(3, 0x9);
+        Flash_CheckBusy(BUSY_TIMEOUT);
+        Flash_WriteEnable();
+        Flash_Erase4k(3, 0xA);
+    } else if (startidx == DEFAULT_ICLASS_KEYS_OFFSET) {
+        Flash_CheckBusy(BUSY_TIMEOUT);
+        Flash_WriteEnable();
+        Flash_Erase4k(3, 0xB);
+    }
+}
+
+static struct {
+    uint32_t start;
+    uint32_t length;
+    int fd;
+    char filename[SPIFFS_OBJ_NAME_LEN];
+} flash_upload = { 0, 0, -1, {0} };
+
+static bool FlashUploadChunkValid(PacketCommandNG *packet) {
+    flash_upload_chunk_t *chunk = (flash_upload_chunk_t *)packet->data.asBytes;
+    return (packet->length >= offsetof(flash_upload_chunk_t, data) &&
+            chunk->len <= packet->length - offsetof(flash_upload_chunk_t, data));
+}
+
+// One chunk of a windowed upload to flash memory. The page programming of a chunk is still
+// running when its answer goes out, the next chunk waits for it only when it starts writing
+static void FlashUploadChunk(PacketCommandNG *packet) {
+    flash_upload_chunk_t *chunk = (flash_upload_chunk_t *)packet->data.asBytes;
+    flash_upload_ack_t ack;
+    memset(&ack, 0, sizeof(ack));
+    ack.seq = chunk->seq;
+    int res = PM3_SUCCESS;
+
+    LED_B_ON();
+    if (FlashUploadChunkValid(packet) == false) {
+        res = PM3_EINVARG;
+        goto out;
+    }
+    if (chunk->offset > FLASH_MEM_MAX_SIZE || chunk->len > FLASH_MEM_MAX_SIZE - chunk->offset) {
+        res = PM3_EOUTOFBOUND;
+        goto out;
+    }
+    if (FlashInit() == false) {
+        res = PM3_EFLASH;
+        goto out;
+    }
+
+    if (chunk->seq == 0) {
+        flash_upload.start = chunk->offset;
+        flash_upload.length = 0;
+    }
+
+    if (chunk->len) {
+        FlashEraseDictionary(chunk->offset);
+        if (Flash_Write(chunk->offset, chunk->data, chunk->len) != chunk->len) {
+            res = PM3_EFLASH;
+            goto out;
+        }
+        flash_upload.length = chunk->offset + chunk->len - flash_upload.start;
+    }
+
+    if (chunk->flags & FLASH_UPLOAD_LAST) {
+        // read back what was written
+        uint8_t buf[FLASH_MEM_BLOCK_SIZE];
+        uint32_t crc = CRC32_PRESET;
+        if (FlashInit() == false) {
+            res = PM3_EFLASH;
+            goto out;
+        }
+        for (uint32_t i = 0; i < flash_upload.length; i += sizeof(buf)) {
+            uint16_t len = MIN(flash_upload.length - i, sizeof(buf));
+            Flash_CheckBusy(BUSY_TIMEOUT);
+            if (Flash_ReadDataCont(flash_upload.start + i, buf, len) != len) {
+                res = PM3_EFLASH;
+                break;
+            }
+            crc = crc32_update(crc, buf, len);
+        }
+        FlashStop();
+        ack.length = flash_upload.length;
+        ack.crc = crc;
+    }
+
+out:
+    reply_ng(CMD_FLASHMEM_WRITE_STREAM, res, (uint8_t *)&ack, sizeof(ack));
+    LED_B_OFF();
+}
+
+// One chunk of a windowed upload to a SPIFFS file, seq 0 carries the file name and opens it
+static void SpiffsUploadChunk(PacketCommandNG *packet) {
+    flash_upload_chunk_t *chunk = (flash_upload_chunk_t *)packet->data.asBytes;
+    flash_upload_ack_t ack;
+    memset(&ack, 0, sizeof(ack));
+    ack.seq = chunk->seq;
+    int res = PM3_SUCCESS;
+
+    LED_B_ON();
+    if (FlashUploadChunkValid(packet) == false) {
+        res = PM3_EINVARG;
+        goto out;
+    }
+
+    if (chunk->seq == 0) {
+        memset(flash_upload.filename, 0, sizeof(flash_upload.filename));
+        memcpy(flash_upload.filename, chunk->data, MIN(chunk->len, SPIFFS_OBJ_NAME_LEN - 1));
+
+        if (flash_upload.fd >= 0)
+            rdv40_spiffs_close_fd(flash_upload.fd);
+
+        rdv40_spiffs_lazy_mount();
+        flash_upload.fd = rdv40_spiffs_open_write(flash_upload.filename);
+        flash_upload.length = 0;
+        if (flash_upload.fd < 0) {
+            res = PM3_EFLASH;
+            goto out;
+        }
+        if (DBGLEVEL >= DBG_DEBUG) Dbprintf("> Filename received for spiffs WRITE STREAM : %s", flash_upload.filename);
+
+    } else {
+        if (flash_upload.fd < 0) {
+            res = PM3_ESOFT;
+            goto out;
+        }
+        if (chunk->offset != flash_upload.length) {
+            res = PM3_ESOFT;
+            goto err;
+        }
+        if (rdv40_spiffs_write_fd(flash_upload.fd, chunk->data, chunk->len) != chunk->len) {
+            res = PM3_EFLASH;
+            goto err;
+        }
+        flash_upload.length += chunk->len;
+    }
+
+    if (chunk->flags & FLASH_UPLOAD_LAST) {
+        rdv40_spiffs_close_fd(flash_upload.fd);
+        flash_upload.fd = -1;
+
+        // read back the file
+        uint8_t buf[FLASH_MEM_BLOCK_SIZE];
+        uint32_t crc = CRC32_PRESET;
+        int fd = rdv40_spiffs_open_read(flash_upload.filename);
+        if (fd < 0) {
+            res = PM3_EFLASH;
+            goto out;
+        }
+        int n;
+        while ((n = rdv40_spiffs_read_fd(fd, buf, sizeof(buf))) > 0) {
+            crc = crc32_update(crc, buf, n);
+            ack.length += n;
+        }
+        rdv40_spiffs_close_fd(fd);
+        ack.crc = crc;
+    }
+    goto out;
+
+err:
+    rdv40_spiffs_close_fd(flash_upload.fd);
+    flash_upload.fd = -1;
+out:
+    reply_ng(CMD_SPIFFS_WRITE_STREAM, res, (uint8_t *)&ack, sizeof(ack));
+    LED_B_OFF();
+}
+#endif
+
 // Show some leds in a pattern to identify StandAlone mod is running
 void StandAloneMode(void) {
     DbpString("");
@@ -707,6 +1074,67 @@ void ListenReaderField(uint8_t limit) {
         }
     }
 }
+static void PacketReceived(PacketCommandNG *packet);
+
+// Runs the entries of a CMD_BATCH frame in order, each one as if it had been received on its own.
+// Stops at a malformed entry or when the client sends something, i.e. CMD_BREAK_LOOP
+static void PacketReceivedBatch(PacketCommandNG *packet) {
+    static PacketCommandNG sub;
+    uint8_t *p = packet->data.asBytes;
+    uint16_t left = packet->length;
+    uint8_t count = 0;
+    int status = PM3_SUCCESS;
+
+    while (left) {
+        PacketBatchEntry entry;
+        if (left < sizeof(entry)) {
+            status = PM3_EINVARG;
+            break;
+        }
+        memcpy(&entry, p, sizeof(entry));
+        p += sizeof(entry);
+        left -= sizeof(entry);
+
+        if (entry.length > left || entry.cmd == CMD_BATCH || (entry.ng == false && entry.length < 3 * sizeof(uint64_t))) {
+            status = PM3_EINVARG;
+            break;
+        }
+
+        if (count && data_available()) {
+            status = PM3_EOPABORTED;
+            break;
+        }
+
+        memset(&sub, 0, sizeof(sub));
+        sub.cmd = entry.cmd;
+        sub.ng = entry.ng;
+        sub.magic = COMMANDNG_PREAMBLE_MAGIC;
+        sub.crc = COMMANDNG_POSTAMBLE_MAGIC;
+        if (entry.ng) {
+            memcpy(sub.data.asBytes, p, entry.length);
+            sub.length = entry.length;
+        } else {
+            uint64_t arg[3];
+            memcpy(arg, p, sizeof(arg));
+            sub.oldarg[0] = arg[0];
+            sub.oldarg[1] = arg[1];
+            sub.oldarg[2] = arg[2];
+            memcpy(sub.data.asBytes, p + sizeof(arg), entry.length - sizeof(arg));
+            sub.length = entry.length - sizeof(arg);
+        }
+        p += entry.length;
+        left -= entry.length;
+
+        WDT_HIT();
+        uint32_t t = profiling_ticks(), ms = GetTickCount();
+        PacketReceived(&sub);
+        profiling_cmd(sub.cmd, t, ms);
+        count++;
+    }
+
+    reply_ng(CMD_BATCH, status, &count, sizeof(count));
+}
+
 static void PacketReceived(PacketCommandNG *packet) {
     /*
     if (packet->ng) {
@@ -719,6 +1147,10 @@ static void PacketReceived(PacketCommandNG *packet) {
     switch (packet->cmd) {
         case CMD_BREAK_LOOP:
             break;
+        case CMD_BATCH: {
+            PacketReceivedBatch(packet);
+            break;
+        }
         case CMD_QUIT_SESSION: {
             g_reply_via_fpc = false;
             g_reply_via_usb = false;
@@ -736,6 +1168,10 @@ static void PacketReceived(PacketCommandNG *packet) {
             hf_field_off();
             break;
         }
+        case CMD_HF_SEARCH: {
+            HfSearch();
+            break;
+        }
 #ifdef WITH_LF
         case CMD_LF_T55XX_SET_CONFIG: {
             setT55xxConfig(packet->oldarg[0], (t55xx_configurations_t *) packet->data.asBytes);
@@ -785,6 +1221,10 @@ static void PacketReceived(PacketCommandNG *packet) {
             ModThenAcquireRawAdcSamples125k(payload->delay, payload->period_0, payload->period_1, symbol_extra, period_extra, packet->data.asBytes + sizeof(struct p), payload->verbose, payload->samples);
             break;
         }
+        case CMD_LF_READ_DEMOD: {
+            ReadLFDemod((lf_demod_req_t *)packet->data.asBytes);
+            break;
+        }
         case CMD_LF_SNIFF_RAW_ADC: {
             struct p {
                 uint32_t samples : 31;
@@ -795,6 +1235,11 @@ static void PacketReceived(PacketCommandNG *packet) {
             reply_ng(CMD_LF_SNIFF_RAW_ADC, PM3_SUCCESS, (uint8_t *)&bits, sizeof(bits));
             break;
         }
+        case CMD_LF_ACQ_RAW_ADC_STREAM: {
+            lf_stream_req_t *payload = (lf_stream_req_t *)packet->data.asBytes;
+            StreamLF(payload->flags, payload->samples);
+            break;
+        }
         case CMD_LF_HID_WATCH: {
             uint32_t high, low;
             int res = lf_hid_watch(0, &high, &low);
@@ -826,6 +1271,10 @@ static void PacketReceived(PacketCommandNG *packet) {
             CmdNRZsimTAG(payload->invert, payload->separator, payload->clock, packet->length - sizeof(lf_nrzsim_t), payload->data, true);
             break;
         }
+        case CMD_LF_SIM_SWEEP: {
+            CmdLFSimSweep((sim_sweep_t *)packet->data.asBytes);
+            break;
+        }
         case CMD_LF_HID_CLONE: {
             CopyHIDtoT55x7(packet->oldarg[0], packet->oldarg[1], packet->oldarg[2], packet->data.asBytes[0]);
             break;
@@ -881,14 +1330,7 @@ static void PacketReceived(PacketCommandNG *packet) {
             break;
         }
         case CMD_LF_T55XX_READBL: {
-            struct p {
-                uint32_t password;
-                uint8_t  blockno;
-                uint8_t  page;
-                bool     pwdmode;
-                uint8_t  downlink_mode;
-            } PACKED;
-            struct p *payload = (struct p *) packet->data.asBytes;
+            t55xx_read_block_t *payload = (t55xx_read_block_t *) packet->data.asBytes;
             T55xxReadBlock(payload->page, payload->pwdmode, false, payload->blockno, payload->password, payload->downlink_mode);
             break;
         }
@@ -918,6 +1360,14 @@ static void PacketReceived(PacketCommandNG *packet) {
             T55xx_ChkPwds(packet->data.asBytes[0] & 0xff);
             break;
         }
+        case CMD_LF_T55XX_WRITE_BLOCKS: {
+            T55xxWriteBlocks((t55xx_write_blocks_t *)packet->data.asBytes);
+            break;
+        }
+        case CMD_LF_T55XX_BRUTE: {
+            T55xx_BruteForce((t55xx_brute_req_t *)packet->data.asBytes);
+            break;
+        }
         case CMD_LF_PCF7931_READ: {
             ReadPCF7931();
             break;
@@ -954,6 +1404,20 @@ static void PacketReceived(PacketCommandNG *packet) {
             EM4xWriteWord(payload->address, payload->data, payload->password, payload->usepwd);
             break;
         }
+        case CMD_LF_EM4X_READ_ALL: {
+            EM4xReadAll((em4x05_read_all_req_t *)packet->data.asBytes);
+            break;
+        }
+        case CMD_LF_EM4X_BRUTE: {
+            EM4xBruteForce((em4x05_brute_req_t *)packet->data.asBytes);
+            break;
+        }
+        case CMD_LF_WATCH: {
+            uint8_t types = (packet->length) ? packet->data.asBytes[0] : LF_WATCH_ALL;
+            int res = lf_watch(types & LF_WATCH_ALL, 0, NULL, NULL);
+            reply_ng(CMD_LF_WATCH, res, NULL, 0);
+            break;
+        }
         case CMD_LF_AWID_WATCH:  {
             uint32_t high, low;
             int res = lf_awid_watch(0, &high, &low);
@@ -990,6 +1454,11 @@ static void PacketReceived(PacketCommandNG *packet) {
             SimulateHitag2((bool)packet->oldarg[0], packet->data.asBytes);
             break;
         }
+        case CMD_LF_HITAG2_NONCES: { // Simulate Hitag2 tag, stream the reader authentications
+            lf_hitag2_nonces_t *payload = (lf_hitag2_nonces_t *)packet->data.asBytes;
+            SimulateHitag2Nonces(payload->uid);
+            break;
+        }
         case CMD_LF_HITAG_READER: { // Reader for Hitag tags, args = type and function
             ReaderHitag((hitag_function)packet->oldarg[0], (hitag_data *)packet->data.asBytes);
             break;
@@ -1008,7 +1477,9 @@ static void PacketReceived(PacketCommandNG *packet) {
         }
         case CMD_LF_HITAGS_WRITE: { //writer for Hitag tags args=data to write,page and key or challenge
             if ((hitag_function)packet->oldarg[0] < 10) {
-                WritePageHitagS((hitag_function)packet->oldarg[0], (hitag_data *)packet->data.asBytes, packet->oldarg[2]);
+                // oldarg[1] pages, the ones after the first follow hitag_data
+                WritePageHitagS((hitag_function)packet->oldarg[0], (hitag_data *)packet->data.asBytes, packet->oldarg[2],
+                                MAX(1, MIN(64, packet->oldarg[1])), packet->data.asBytes + sizeof(hitag_data));
             } else {
                 WriterHitag((hitag_function)packet->oldarg[0], (hitag_data *)packet->data.asBytes, packet->oldarg[2]);
             }
@@ -1037,6 +1508,10 @@ static void PacketReceived(PacketCommandNG *packet) {
             em4x50_wipe((em4x50_data_t *)packet->data.asBytes);
             break;
         }
+        case CMD_LF_EM4X50_BRUTE: {
+            em4x50_brute((em4x50_brute_req_t *)packet->data.asBytes);
+            break;
+        }
 #endif
 
 #ifdef WITH_ISO15693
@@ -1045,16 +1520,25 @@ static void PacketReceived(PacketCommandNG *packet) {
             break;
         }
         case CMD_HF_ISO15693_SNIFF: {
-            SniffIso15693(0, NULL);
+            SniffIso15693(0, NULL, false);
             reply_ng(CMD_HF_ISO15693_SNIFF, PM3_SUCCESS, NULL, 0);
             break;
         }
+        case CMD_HF_ISO15693_SNIFF_STREAM: {
+            // replies with its own final frame
+            SniffIso15693(0, NULL, true);
+            break;
+        }
         case CMD_HF_ISO15693_COMMAND: {
             DirectTag15693Command(packet->oldarg[0], packet->oldarg[1], packet->oldarg[2], packet->data.asBytes);
             break;
         }
         case CMD_HF_ISO15693_FINDAFI: {
-            BruteforceIso15693Afi(packet->oldarg[0]);
+            BruteforceIso15693Afi();
+            break;
+        }
+        case CMD_HF_ISO15693_INVENTORY: {
+            InventoryIso15693();
             break;
         }
         case CMD_HF_ISO15693_READER: {
@@ -1062,11 +1546,11 @@ static void PacketReceived(PacketCommandNG *packet) {
             break;
         }
         case CMD_HF_ISO15693_SIMULATE: {
-            struct p {
-                uint8_t uid[8];
-            } PACKED;
-            struct p *payload = (struct p *) packet->data.asBytes;
-            SimTagIso15693(payload->uid);
+            SimTagIso15693((iso15_sim_req_t *)packet->data.asBytes);
+            break;
+        }
+        case CMD_HF_ISO15693_DUMP: {
+            DumpIso15693((iso15_dump_req_t *)packet->data.asBytes);
             break;
         }
         case CMD_HF_ISO15693_CSETUID: {
@@ -1117,14 +1601,19 @@ static void PacketReceived(PacketCommandNG *packet) {
 
 #ifdef WITH_ISO14443b
         case CMD_HF_SRI_READ: {
-            ReadSTMemoryIso14443b(packet->oldarg[0]);
+            ReadSTMemoryIso14443b((srx_dump_req_t *)packet->data.asBytes);
             break;
         }
         case CMD_HF_ISO14443B_SNIFF: {
-            SniffIso14443b();
+            SniffIso14443b(false);
             reply_ng(CMD_HF_ISO14443B_SNIFF, PM3_SUCCESS, NULL, 0);
             break;
         }
+        case CMD_HF_ISO14443B_SNIFF_STREAM: {
+            // replies with its own final frame
+            SniffIso14443b(true);
+            break;
+        }
         case CMD_HF_ISO14443B_SIMULATE: {
             SimulateIso14443bTag(packet->oldarg[0]);
             break;
@@ -1150,14 +1639,23 @@ static void PacketReceived(PacketCommandNG *packet) {
             break;
         }
         case CMD_HF_FELICA_SNIFF: {
-            felica_sniff(packet->oldarg[0], packet->oldarg[1]);
+            felica_sniff(packet->oldarg[0], packet->oldarg[1], false);
             reply_ng(CMD_HF_FELICA_SNIFF, PM3_SUCCESS, NULL, 0);
             break;
         }
+        case CMD_HF_FELICA_SNIFF_STREAM: {
+            // no frame or trigger limit, replies with its own final frame
+            felica_sniff(0, 0, true);
+            break;
+        }
         case CMD_HF_FELICALITE_DUMP: {
             felica_dump_lite_s();
             break;
         }
+        case CMD_HF_FELICA_INVENTORY: {
+            felica_inventory(packet->data.asBytes[0]);
+            break;
+        }
 #endif
 
 #ifdef WITH_ISO14443a
@@ -1181,6 +1679,11 @@ static void PacketReceived(PacketCommandNG *packet) {
             reply_ng(CMD_HF_ISO14443A_SNIFF, PM3_SUCCESS, NULL, 0);
             break;
         }
+        case CMD_HF_ISO14443A_SNIFF_STREAM: {
+            // replies with its own final frame
+            SniffIso14443a(packet->data.asBytes[0] | 0x08);
+            break;
+        }
         case CMD_HF_ISO14443A_READER: {
             ReaderIso14443a(packet);
             break;
@@ -1195,14 +1698,58 @@ static void PacketReceived(PacketCommandNG *packet) {
             SimulateIso14443aTag(payload->tagtype, payload->flags, payload->uid);  // ## Simulate iso14443a tag - pass tag type & UID
             break;
         }
+        case CMD_HF_ISO14443A_SIM_SWEEP: {
+            SimulateIso14443aSweep((sim_sweep_t *)packet->data.asBytes);
+            break;
+        }
+        case CMD_HF_ISO14443A_TEAROFF_SWEEP: {
+            ReaderIso14443aTearoffSweep((iso14a_tearoff_sweep_req_t *)packet->data.asBytes);
+            break;
+        }
+        case CMD_HF_ISO14443A_APDU: {
+            ReaderIso14443aAPDU((iso14a_apdu_req_t *)packet->data.asBytes);
+            break;
+        }
+        case CMD_HF_ISO14443A_READ_BINARY: {
+            ReaderIso14443aReadBinary((iso14a_read_binary_req_t *)packet->data.asBytes);
+            break;
+        }
+        case CMD_HF_WAVESHARE_UPLOAD: {
+            ReaderIso14443aWaveshare((wshare_upload_req_t *)packet->data.asBytes);
+            break;
+        }
+        case CMD_HF_ISO14443A_CUIDS: {
+            ReaderIso14443aCUIDs((iso14a_cuids_req_t *)packet->data.asBytes);
+            break;
+        }
+        case CMD_HF_ISO14443A_INVENTORY: {
+            ReaderIso14443aInventory((iso14a_inventory_req_t *)packet->data.asBytes);
+            break;
+        }
+        case CMD_HF_TOPAZ_READALL: {
+            ReaderTopazReadAll();
+            break;
+        }
+        case CMD_HF_LTO_DUMP: {
+            LTODump((lto_dump_req_t *)packet->data.asBytes);
+            break;
+        }
+        case CMD_HF_LTO_RESTORE: {
+            LTORestore((lto_restore_req_t *)packet->data.asBytes);
+            break;
+        }
         case CMD_HF_ISO14443A_ANTIFUZZ: {
-            iso14443a_antifuzz(packet->oldarg[0]);
+            iso14443a_antifuzz((iso14a_antifuzz_t *)packet->data.asBytes);
             break;
         }
         case CMD_HF_EPA_COLLECT_NONCE: {
             EPA_PACE_Collect_Nonce(packet);
             break;
         }
+        case CMD_HF_EPA_COLLECT_NONCE_STREAM: {
+            EPA_PACE_Collect_Nonce_Stream((epa_nonce_stream_req_t *)packet->data.asBytes);
+            break;
+        }
         case CMD_HF_EPA_REPLAY: {
             EPA_PACE_Replay(packet);
             break;
@@ -1214,7 +1761,12 @@ static void PacketReceived(PacketCommandNG *packet) {
                 uint8_t key_type;
             } PACKED;
             struct p *payload = (struct p *) packet->data.asBytes;
-            ReaderMifare(payload->first_run, payload->blockno, payload->key_type);
+            ReaderMifare(payload->first_run, payload->blockno, payload->key_type, false);
+            break;
+        }
+        case CMD_HF_MIFARE_READER_STREAM: {
+            mf_darkside_stream_req_t *payload = (mf_darkside_stream_req_t *) packet->data.asBytes;
+            ReaderMifare(payload->first_run, payload->blockno, payload->key_type, true);
             break;
         }
         case CMD_HF_MIFARE_READBL: {
@@ -1230,10 +1782,18 @@ static void PacketReceived(PacketCommandNG *packet) {
             MifareUC_Auth(packet->oldarg[0], packet->data.asBytes);
             break;
         }
+        case CMD_HF_MIFAREU_CHKPWD: {
+            MifareUChkPwd(packet->data.asBytes);
+            break;
+        }
         case CMD_HF_MIFAREU_READCARD: {
             MifareUReadCard(packet->oldarg[0], packet->oldarg[1], packet->oldarg[2], packet->data.asBytes);
             break;
         }
+        case CMD_HF_MIFAREU_DUMP: {
+            MifareUDump(packet->data.asBytes);
+            break;
+        }
         case CMD_HF_MIFAREUC_SETPWD: {
             MifareUSetPwd(packet->oldarg[0], packet->data.asBytes);
             break;
@@ -1246,6 +1806,14 @@ static void PacketReceived(PacketCommandNG *packet) {
             MifareWriteBlock(packet->oldarg[0], packet->oldarg[1], packet->data.asBytes);
             break;
         }
+        case CMD_HF_MIFARE_READSC_BULK: {
+            MifareReadSectorBulk((mf_readsc_bulk_req_t *)packet->data.asBytes);
+            break;
+        }
+        case CMD_HF_MIFARE_WRITESC_BULK: {
+            MifareWriteSectorBulk((mf_writesc_bulk_req_t *)packet->data.asBytes, packet->length);
+            break;
+        }
         case CMD_HF_MIFAREU_WRITEBL: {
             MifareUWriteBlock(packet->oldarg[0], packet->oldarg[1], packet->data.asBytes);
             break;
@@ -1258,6 +1826,10 @@ static void PacketReceived(PacketCommandNG *packet) {
             MifareAcquireEncryptedNonces(packet->oldarg[0], packet->oldarg[1], packet->oldarg[2], packet->data.asBytes);
             break;
         }
+        case CMD_HF_MIFARE_ACQ_NONCES_STREAM: {
+            MifareAcquireNoncesStream(packet->data.asBytes);
+            break;
+        }
         case CMD_HF_MIFARE_ACQ_NONCES: {
             MifareAcquireNonces(packet->oldarg[0], packet->oldarg[2]);
             break;
@@ -1303,6 +1875,18 @@ static void PacketReceived(PacketCommandNG *packet) {
             MifareChkKeys_file(payload->filename);
             break;
         }
+        case CMD_HF_MIFARE_CHKKEYS_LOAD: {
+            MifareChkKeys_load((mf_chkkeys_load_t *)packet->data.asBytes, packet->length);
+            break;
+        }
+        case CMD_HF_MIFARE_CHKKEYS_BATCH: {
+            MifareChkKeys_batch((mf_chkkeys_batch_req_t *)packet->data.asBytes);
+            break;
+        }
+        case CMD_HF_MIFARE_CHKKEYS_SPIFFS: {
+            MifareChkKeys_spiffs((mf_chkkeys_spiffs_req_t *)packet->data.asBytes);
+            break;
+        }
         case CMD_HF_MIFARE_SIMULATE: {
             struct p {
                 uint16_t flags;
@@ -1358,6 +1942,10 @@ static void PacketReceived(PacketCommandNG *packet) {
             MifareCIdent();
             break;
         }
+        case CMD_HF_MIFARE_CLOAD: {
+            MifareCLoad((mifare_cload_req_t *)packet->data.asBytes);
+            break;
+        }
         // Gen 3 magic cards
         case CMD_HF_MIFARE_GEN3UID: {
             MifareGen3UID(packet->oldarg[0], packet->data.asBytes);
@@ -1418,6 +2006,18 @@ static void PacketReceived(PacketCommandNG *packet) {
             MifareSendCommand(packet->data.asBytes);
             break;
         }
+        case CMD_HF_DESFIRE_CHAINED: {
+            MifareDesfireChained(packet->data.asBytes);
+            break;
+        }
+        case CMD_HF_DESFIRE_CHKKEYS: {
+            MifareDesfireCheckKeys(packet->data.asBytes);
+            break;
+        }
+        case CMD_HF_MFP_CHKKEYS: {
+            MifarePlusCheckKeys(packet->data.asBytes);
+            break;
+        }
         case CMD_HF_MIFARE_NACK_DETECT: {
             DetectNACKbug();
             break;
@@ -1426,10 +2026,18 @@ static void PacketReceived(PacketCommandNG *packet) {
             MifareU_Otp_Tearoff(packet->oldarg[0], packet->oldarg[1], packet->data.asBytes);
             break;
         }
+        case CMD_HF_MFU_OTP_TEAROFF_SWEEP: {
+            MifareU_Otp_TearoffSweep(packet->data.asBytes);
+            break;
+        }
         case CMD_HF_MIFARE_STATIC_NONCE: {
             MifareHasStaticNonce();
             break;
         }
+        case CMD_HF_MIFARE_FINGERPRINT: {
+            MifareFingerprint((mf_fingerprint_req_t *)packet->data.asBytes);
+            break;
+        }
 #endif
 
 #ifdef WITH_NFCBARCODE
@@ -1447,11 +2055,14 @@ static void PacketReceived(PacketCommandNG *packet) {
         // Makes use of ISO14443a FPGA Firmware
         case CMD_HF_ICLASS_SNIFF: {
             struct p {
+                bool ring;
                 uint8_t jam_search_len;
                 uint8_t jam_search_string[];
             } PACKED;
             struct p *payload = (struct p *) packet->data.asBytes;
+            set_tracing_ring(payload->ring);
             SniffIClass(payload->jam_search_len, payload->jam_search_string);
+            set_tracing_ring(false);
             reply_ng(CMD_HF_ICLASS_SNIFF, PM3_SUCCESS, NULL, 0);
             break;
         }
@@ -1459,6 +2070,10 @@ static void PacketReceived(PacketCommandNG *packet) {
             SimulateIClass(packet->oldarg[0], packet->oldarg[1], packet->oldarg[2], packet->data.asBytes);
             break;
         }
+        case CMD_HF_ICLASS_SIMULATE_STREAM: {
+            SimulateIClassStream(packet->oldarg[0], packet->oldarg[1], packet->data.asBytes);
+            break;
+        }
         case CMD_HF_ICLASS_READER: {
             ReaderIClass(packet->oldarg[0]);
             break;
@@ -1532,6 +2147,10 @@ static void PacketReceived(PacketCommandNG *packet) {
             reply_ng(CMD_HF_SNIFF, res, (uint8_t *)&retval, sizeof(retval));
             break;
         }
+        case CMD_HF_SNIFF_STREAM: {
+            HfSniffStream((hf_sniff_stream_req_t *)packet->data.asBytes);
+            break;
+        }
 #endif
 
 #ifdef WITH_HFPLOT
@@ -1558,6 +2177,14 @@ static void PacketReceived(PacketCommandNG *packet) {
             SmartCardRaw(packet->oldarg[0], packet->oldarg[1], packet->data.asBytes);
             break;
         }
+        case CMD_SMART_RAW_BULK: {
+            SmartCardRawBulk(packet->data.asBytes, packet->length);
+            break;
+        }
+        case CMD_SMART_RELAY: {
+            SmartCardRelay14a((sc_relay_req_t *)packet->data.asBytes);
+            break;
+        }
         case CMD_SMART_UPLOAD: {
             // upload file from client
             uint8_t *mem = BigBuf_get_addr();
@@ -1727,6 +2354,14 @@ static void PacketReceived(PacketCommandNG *packet) {
             }
             break;
         }
+        case CMD_MEASURE_ANTENNA_TUNING_STREAM: {
+            if (packet->length != sizeof(antenna_tuning_stream_req_t)) {
+                reply_ng(CMD_MEASURE_ANTENNA_TUNING_STREAM, PM3_EINVARG, NULL, 0);
+                break;
+            }
+            StreamAntennaTuning((antenna_tuning_stream_req_t *)packet->data.asBytes);
+            break;
+        }
         case CMD_LISTEN_READER_FIELD: {
             if (packet->length != sizeof(uint8_t))
                 break;
@@ -1741,6 +2376,7 @@ static void PacketReceived(PacketCommandNG *packet) {
         }
         case CMD_DOWNLOAD_BIGBUF: {
             LED_B_ON();
+            BigBuf_linearize_trace();
             uint8_t *mem = BigBuf_get_addr();
             uint32_t startidx = packet->oldarg[0];
             uint32_t numofbytes = packet->oldarg[1];
@@ -1802,6 +2438,26 @@ static void PacketReceived(PacketCommandNG *packet) {
             break;
         }
 #endif
+        case CMD_DOWNLOAD_STREAM: {
+            DownloadStream((download_stream_req_t *)packet->data.asBytes);
+            break;
+        }
+        case CMD_UPLOAD_EML_STREAM: {
+            eml_upload_chunk_t *payload = (eml_upload_chunk_t *)packet->data.asBytes;
+            int res = PM3_SUCCESS;
+            if (packet->length < offsetof(eml_upload_chunk_t, data) ||
+                    payload->len > packet->length - offsetof(eml_upload_chunk_t, data)) {
+                res = PM3_EINVARG;
+            } else {
+                // FPGA download corrupts BigBuf, get it done before filling emulator memory
+                if (payload->seq == 0)
+                    FpgaDownloadAndGo(FPGA_BITSTREAM_HF);
+                if (emlSet(payload->data, payload->offset, payload->len))
+                    res = PM3_EOUTOFBOUND;
+            }
+            reply_ng(CMD_UPLOAD_EML_STREAM, res, (uint8_t *)&payload->seq, sizeof(payload->seq));
+            break;
+        }
         case CMD_DOWNLOAD_EML_BIGBUF: {
             LED_B_ON();
             uint8_t *mem = BigBuf_get_EM_addr();
@@ -1864,7 +2520,9 @@ static void PacketReceived(PacketCommandNG *packet) {
             uint32_t size = packet->oldarg[1];
 
             uint8_t *buff = BigBuf_malloc(size);
+            rdv40_spiffs_readahead(BigBuf_malloc(RDV40_SPIFFS_READAHEAD_SZ), RDV40_SPIFFS_READAHEAD_SZ);
             rdv40_spiffs_read_as_filetype((char *)filename, (uint8_t *)buff, size, RDV40_SPIFFS_SAFETY_SAFE);
+            rdv40_spiffs_readahead(NULL, 0);
 
             // arg0 = filename
             // arg1 = size
@@ -1961,6 +2619,10 @@ static void PacketReceived(PacketCommandNG *packet) {
             LED_B_OFF();
             break;
         }
+        case CMD_SPIFFS_WRITE_STREAM: {
+            SpiffsUploadChunk(packet);
+            break;
+        }
         case CMD_SPIFFS_WIPE: {
             LED_B_ON();
             rdv40_spiffs_safe_wipe();
@@ -1986,22 +2648,7 @@ static void PacketReceived(PacketCommandNG *packet) {
                 break;
             }
 
-            if (startidx == DEFAULT_T55XX_KEYS_OFFSET) {
-                Flash_CheckBusy(BUSY_TIMEOUT);
-                Flash_WriteEnable();
-                Flash_Erase4k(3, 0xC);
-            } else if (startidx ==  DEFAULT_MF_KEYS_OFFSET) {
-                Flash_CheckBusy(BUSY_TIMEOUT);
-                Flash_WriteEnable();
-                Flash_Erase4k(3, 0x9);
-                Flash_CheckBusy(BUSY_TIMEOUT);
-                Flash_WriteEnable();
-                Flash_Erase4k(3, 0xA);
-            } else if (startidx == DEFAULT_ICLASS_KEYS_OFFSET) {
-                Flash_CheckBusy(BUSY_TIMEOUT);
-                Flash_WriteEnable();
-                Flash_Erase4k(3, 0xB);
-            }
+            FlashEraseDictionary(startidx);
 
             res = Flash_Write(startidx, data, len);
             isok = (res == len) ? 1 : 0;
@@ -2010,6 +2657,10 @@ static void PacketReceived(PacketCommandNG *packet) {
             LED_B_OFF();
             break;
         }
+        case CMD_FLASHMEM_WRITE_STREAM: {
+            FlashUploadChunk(packet);
+            break;
+        }
         case CMD_FLASHMEM_WIPE: {
             LED_B_ON();
             uint8_t page = packet->oldarg[0];
@@ -2138,6 +2789,14 @@ static void PacketReceived(PacketCommandNG *packet) {
             reply_ng(CMD_PING, PM3_SUCCESS, packet->data.asBytes, packet->length);
             break;
         }
+        case CMD_PROFILE: {
+            profiling_reply(packet->length && packet->data.asBytes[0]);
+            break;
+        }
+        case CMD_FPGA_BENCH: {
+            FpgaBenchmark();
+            break;
+        }
 #ifdef WITH_LCD
         case CMD_LCD_RESET: {
             LCDReset();
@@ -2226,6 +2885,7 @@ void  __attribute__((noreturn)) AppMain(void) {
     FpgaDownloadAndGo(FPGA_BITSTREAM_HF);
 
     StartTickCount();
+    profiling_init();
 
 #ifdef WITH_LCD
     LCDInit();
@@ -2270,7 +2930,9 @@ void  __attribute__((noreturn)) AppMain(void) {
 
         int ret = receive_ng(&rx);
         if (ret == PM3_SUCCESS) {
+            uint32_t t = profiling_ticks(), ms = GetTickCount();
             PacketReceived(&rx);
+            profiling_cmd(rx.cmd, t, ms);
         } else if (ret != PM3_ENODATA) {
 
             Dbprintf("Error in frame reception: %d %s", ret, (ret == PM3_EIO) ? "PM3_EIO" : "");
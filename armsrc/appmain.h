@@ -40,5 +40,7 @@ void ListenReaderField(uint8_t limit);
 void StandAloneMode(void);
 void printStandAloneModes(void);
 void print_stack_usage(void);
+uint32_t get_stack_usage(void);
+uint32_t get_stack_size(void);
 
 #endif
@@ -74,7 +74,7 @@ int reply_old(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, void *d
 
     if (g_reply_via_fpc) {
 #ifdef WITH_FPC_USART_HOST
-        resultfpc = usart_writebuffer_sync((uint8_t *)&txcmd, sizeof(PacketResponseOLD));
+        resultfpc = usart_writebuffer_async((uint8_t *)&txcmd, sizeof(PacketResponseOLD));
 #else
         return PM3_EDEVNOTSUPP;
 #endif
@@ -132,7 +132,7 @@ static int reply_ng_internal(uint16_t cmd, int16_t status, uint8_t *data, size_t
     }
     if (g_reply_via_fpc) {
 #ifdef WITH_FPC_USART_HOST
-        resultfpc = usart_writebuffer_sync((uint8_t *)&txBufferNG, txBufferNGLen);
+        resultfpc = usart_writebuffer_async((uint8_t *)&txBufferNG, txBufferNGLen);
 #else
         return PM3_EDEVNOTSUPP;
 #endif
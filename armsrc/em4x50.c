@@ -14,6 +14,9 @@
 #include "lfadc.h"
 #include "commonutil.h"
 #include "em4x50.h"
+#include "BigBuf.h"
+#include "util.h"
+#include "spiffs.h"
 
 // 4 data bytes
 // + byte with row parities
@@ -77,6 +80,8 @@ static em4x50_tag_t tag = {
 #define EM4X50_T_WAITING_FOR_SNGLLIW        50
 #define EM4X50_T_WAITING_FOR_DBLLIW         1550
 
+#define EM4X50_T_TAG_MAX_PULSE              (3 * EM4X50_T_TAG_FULL_PERIOD + EM4X50_T_TAG_HALF_PERIOD)
+
 #define EM4X50_TAG_TOLERANCE                8
 #define EM4X50_TAG_WORD                     45
 
@@ -245,7 +250,7 @@ static bool get_signalproperties(void) {
     uint8_t sample_max_mean = 0;
     uint8_t sample_max[no_periods];
     uint32_t sample_max_sum = 0;
-    memcpy(sample_max, 0x00, sizeof(sample_max));
+    memset(sample_max, 0x00, sizeof(sample_max));
 
     // wait until signal/noise > 1 (max. 32 periods)
     for (int i = 0; i < T0 * no_periods; i++) {
@@ -313,41 +318,29 @@ static int get_next_bit(void) {
 
 static uint32_t get_pulse_length(void) {
 
-//    Dbprintf( _CYAN_("4x50 get_pulse_length A") );
-
-    int32_t timeout = (T0 * 3 * EM4X50_T_TAG_FULL_PERIOD);
-
-    // iterates pulse length (low -> high -> low)
-
-    volatile uint8_t sample = (uint8_t)AT91C_BASE_SSC->SSC_RHR;
+    // iterates pulse length (low -> high -> low); time limits are taken from
+    // TC1 so they don't depend on how long a single sample read takes
+    // returns 0 if there is no falling edge within 3 periods or if the pulse
+    // is longer than any valid pulse (EM4X50_T_TAG_MAX_PULSE)
 
-    while (sample > gLow && (timeout--)) {
-        sample = (uint8_t)AT91C_BASE_SSC->SSC_RHR;
+    AT91C_BASE_TC1->TC_CCR = AT91C_TC_SWTRG;
+    while ((uint8_t)AT91C_BASE_SSC->SSC_RHR > gLow) {
+        if (AT91C_BASE_TC1->TC_CV > T0 * 3 * EM4X50_T_TAG_FULL_PERIOD)
+            return 0;
     }
 
-    if (timeout == 0)
-        return 0;
-
     AT91C_BASE_TC1->TC_CCR = AT91C_TC_SWTRG;
-    timeout = (T0 * 3 * EM4X50_T_TAG_FULL_PERIOD);
-
-    while (sample < gHigh && (timeout--)) {
-        sample = (uint8_t)AT91C_BASE_SSC->SSC_RHR;
+    while ((uint8_t)AT91C_BASE_SSC->SSC_RHR < gHigh) {
+        if (AT91C_BASE_TC1->TC_CV > T0 * EM4X50_T_TAG_MAX_PULSE)
+            return 0;
     }
 
-    if (timeout == 0)
-        return 0;
-
-    timeout = (T0 * 3 * EM4X50_T_TAG_FULL_PERIOD);
-    while (sample > gLow && (timeout--)) {
-        sample = (uint8_t)AT91C_BASE_SSC->SSC_RHR;
+    while ((uint8_t)AT91C_BASE_SSC->SSC_RHR > gLow) {
+        if (AT91C_BASE_TC1->TC_CV > T0 * EM4X50_T_TAG_MAX_PULSE)
+            return 0;
     }
 
-    if (timeout == 0)
-        return 0;
-
     return (uint32_t)AT91C_BASE_TC1->TC_CV;
-
 }
 
 static bool check_pulse_length(uint32_t pl, int length) {
@@ -355,6 +348,20 @@ static bool check_pulse_length(uint32_t pl, int length) {
     return ((pl >= T0 * (length - EM4X50_TAG_TOLERANCE)) & (pl <= T0 * (length + EM4X50_TAG_TOLERANCE)));
 }
 
+static int get_pulse_half_periods(void) {
+
+    // measures next pulse and returns its length in half periods (2 - 6),
+    // 0 if it doesn't match any valid pulse length
+
+    uint32_t pl = get_pulse_length();
+
+    for (int n = 2; n <= 6; n++)
+        if (check_pulse_length(pl, n * EM4X50_T_TAG_HALF_PERIOD))
+            return n;
+
+    return 0;
+}
+
 static void em4x50_send_bit(int bit) {
 
     // send single bit according to EM4x50 application note and datasheet
@@ -582,91 +589,93 @@ static bool check_ack(bool bliw) {
 
 static int get_word_from_bitstream(uint8_t bits[EM4X50_TAG_WORD]) {
 
-    // decodes one word by evaluating pulse lengths and previous bit;
+    // decodes one word in a single pass over the pulse lengths, the state
+    // being the last bit and the parity of the 1.5 period pulses seen so far;
     // word must have 45 bits in total:
     // 32 data bits + 4 row parity bits + 8 column parity bits + 1 stop bit
+    // returns EM4X50_TAG_WORD if a complete word followed by a listen window
+    // has been decoded, -1 otherwise
 
+    // a pulse may add two bits, the last one before the listen window is
+    // cleared again
+    uint8_t b[EM4X50_TAG_WORD + 2] = {0};
     bool bbitchange = false;
     int i = 0;
-    uint32_t pl = 0;
 
     // initial bit value depends on last pulse length of listen window
-    pl = get_pulse_length();
-    if (check_pulse_length(pl, 3 * EM4X50_T_TAG_HALF_PERIOD)) {
-
-        // pulse length = 1.5
-        bits[0] = 1;
-
-    } else if (check_pulse_length(pl, 2 * EM4X50_T_TAG_FULL_PERIOD)) {
-
-        // pulse length = 2
-        bits[0] = 0;
-        bbitchange = true;
-
-    } else {
-
-        // pulse length = 2.5
-        bits[0] = 0;
-        bits[1] = 1;
-        i++;
+    switch (get_pulse_half_periods()) {
+        case 3:
+            // pulse length = 1.5
+            b[0] = 1;
+            break;
+        case 4:
+            // pulse length = 2
+            b[0] = 0;
+            bbitchange = true;
+            break;
+        case 5:
+            // pulse length = 2.5
+            b[0] = 0;
+            b[1] = 1;
+            i++;
+            break;
+        default:
+            return -1;
     }
 
     // identify remaining bits based on pulse lengths
     // between two listen windows only pulse lengths of 1, 1.5 and 2 are possible
-    while (true) {
-
-        i++;
-        pl = get_pulse_length();
-
-        if (check_pulse_length(pl, EM4X50_T_TAG_FULL_PERIOD)) {
+    while (++i < EM4X50_TAG_WORD + 1) {
 
-            // pulse length = 1 -> keep former bit value
-            bits[i] = bits[i - 1];
+        switch (get_pulse_half_periods()) {
+            case 2:
+                // pulse length = 1 -> keep former bit value
+                b[i] = b[i - 1];
+                break;
 
-        } else if (check_pulse_length(pl, 3 * EM4X50_T_TAG_HALF_PERIOD)) {
+            case 3:
+                // pulse length = 1.5 -> decision on bit change
+                if (bbitchange) {
 
-            // pulse length = 1.5 -> decision on bit change
+                    // if number of pulse lengths with 1.5 periods is even -> add bit
+                    // pulse length of 1.5 changes bit value
+                    b[i] = b[i - 1];
+                    b[i + 1] = b[i] ^ 1;
+                    i++;
 
-            if (bbitchange) {
+                } else {
+                    b[i] = b[i - 1] ^ 1;
+                }
 
-                // if number of pulse lengths with 1.5 periods is even -> add bit
-                bits[i] = (bits[i - 1] == 1) ? 1 : 0;
+                // next time the other number of bits has to be added
+                bbitchange = !bbitchange;
+                break;
 
-                // pulse length of 1.5 changes bit value
-                bits[i + 1] = (bits[i] == 1) ? 0 : 1;
+            case 4:
+                // pulse length of 2 means: adding 2 bits "01"
+                b[i] = 0;
+                b[i + 1] = 1;
                 i++;
+                break;
 
-                // next time add only one bit
-                bbitchange = false;
-
-            } else {
-
-                bits[i] = (bits[i - 1] == 1) ? 0 : 1;
-
-                // next time two bits have to be added
-                bbitchange = true;
-            }
-
-        } else if (check_pulse_length(pl, 2 * EM4X50_T_TAG_FULL_PERIOD)) {
-
-            // pulse length of 2 means: adding 2 bits "01"
-            bits[i] = 0;
-            bits[i + 1] = 1;
-            i++;
-
-        } else if (check_pulse_length(pl, 3 * EM4X50_T_TAG_FULL_PERIOD)) {
+            case 6:
+                // pulse length of 3 indicates listen window -> clear last
+                // bit (= 0) and return
+                if (--i != EM4X50_TAG_WORD)
+                    return -1;
 
-            // pulse length of 3 indicates listen window -> clear last
-            // bit (= 0) and return
-            return --i;
+                memcpy(bits, b, EM4X50_TAG_WORD);
+                return EM4X50_TAG_WORD;
 
+            default:
+                // timeout or pulse not possible within a word
+                return -1;
         }
     }
-}
 
-//==============================================================================
-// login function
-//==============================================================================
+    // too many bits without listen window
+    return -1;
+}
 
 static bool login(uint8_t password[4]) {
 
@@ -847,8 +856,10 @@ void em4x50_read(em4x50_data_t *etd) {
             if (etd->pwd_given)
                 blogin = login(etd->password);
 
-            // only one word has to be read -> first word read = last word read
-            addresses[2] = addresses[3] = etd->address;
+            // read from <address> up to last word read (addresses[2]) in one
+            // go; if not given only one word is read -> fwr = lwr
+            addresses[3] = etd->address;
+            addresses[2] = (etd->addresses[2] > etd->address) ? etd->addresses[2] : etd->address;
             bsuccess = selective_read(addresses);
 
         } else {
@@ -869,11 +880,15 @@ void em4x50_read(em4x50_data_t *etd) {
 // write functions
 //==============================================================================
 
-static bool write(uint8_t word[4], uint8_t address) {
+static bool write(uint8_t word[4], uint8_t address, bool brm, bool bnext) {
 
     // writes <word> to specified <address>
+    // <brm> is true if a RM request has already been sent in the listen
+    // window after the previous command's ACK, so the search for a double
+    // listen window can be skipped; if <bnext> is true a RM request for the
+    // following command is sent in the listen window after the final ACK
 
-    if (request_receive_mode()) {
+    if (brm || request_receive_mode()) {
 
         // send write command
         em4x50_send_byte_with_parity(EM4X50_COMMAND_WRITE);
@@ -892,7 +907,7 @@ static bool write(uint8_t word[4], uint8_t address) {
 
             // now EM4x50 needs T0 * EM4X50_T_TAG_TWEE (EEPROM write time)
             // for saving data and should return with ACK
-            if (check_ack(false))
+            if (check_ack(bnext))
                 return true;
 
         }
@@ -968,7 +983,7 @@ void em4x50_write(em4x50_data_t *etd) {
             blogin = login(etd->password);
 
         // write word to given address
-        if (write(etd->word, etd->address)) {
+        if (write(etd->word, etd->address, false, false)) {
 
             // to verify result reset EM4x50
             if (reset()) {
@@ -1046,8 +1061,12 @@ void em4x50_wipe(em4x50_data_t *etd) {
             // write 0x0 to each address but ignore addresses
             // 0 -> password, 32 -> serial, 33 -> uid
             // writing 34 words takes about 3.6 seconds -> high timeout needed
+            // commands are chained: the RM request for the next word is sent
+            // right after the ACK, a double listen window is only searched
+            // for again if a write failed
+            bool brm = false;
             for (int i = 1; i <= EM4X50_NO_WORDS - 3; i++)
-                write(zero, i);
+                brm = write(zero, i, brm, i < EM4X50_NO_WORDS - 3);
 
             // to verify result reset EM4x50
             if (reset()) {
@@ -1083,3 +1102,136 @@ void em4x50_wipe(em4x50_data_t *etd) {
     lf_finalize();
     reply_ng(CMD_ACK, bsuccess, (uint8_t *)tag.sectors, 238);
 }
+
+#define EM4X50_BRUTE_CHUNK                  64      // passwords read from SPIFFS at once
+
+void em4x50_brute(em4x50_brute_req_t *req) {
+
+    // tries passwords from a range or a SPIFFS dictionary without leaving
+    // the field; signal properties are only determined once, each attempt is
+    // a single login command
+    // every second a progress frame carries the next untried position so that
+    // an interrupted search can be resumed from there
+
+    em4x50_brute_resp_t resp;
+    memset(&resp, 0, sizeof(resp));
+    int status = PM3_SUCCESS;
+    bool bdict = (req->filename[0] != 0);
+    uint8_t password[4] = {0};
+
+#ifdef WITH_FLASH
+    int fd = -1, changed = 0;
+    uint8_t *buf = NULL;
+    uint16_t fill = 0, pos = 0;
+#endif
+
+    if (bdict) {
+#ifndef WITH_FLASH
+        resp.final = true;
+        reply_ng(CMD_LF_EM4X50_BRUTE, PM3_ENOTIMPL, (uint8_t *)&resp, sizeof(resp));
+        return;
+#else
+        BigBuf_free();
+        buf = BigBuf_malloc(EM4X50_BRUTE_CHUNK * 4);
+        req->filename[sizeof(req->filename) - 1] = 0;
+
+        changed = rdv40_spiffs_lazy_mount();
+        fd = rdv40_spiffs_open_read((char *)req->filename);
+        if (buf == NULL || fd < 0) {
+            status = (fd < 0) ? PM3_EFILE : PM3_EMALLOC;
+            goto out;
+        }
+        rdv40_spiffs_readahead(BigBuf_malloc(RDV40_SPIFFS_READAHEAD_SZ), RDV40_SPIFFS_READAHEAD_SZ);
+
+        // skip passwords already checked by an earlier run
+        for (uint32_t n = req->skip; n > 0;) {
+            uint32_t want = MIN(n, EM4X50_BRUTE_CHUNK) * 4;
+            if (rdv40_spiffs_read_fd(fd, buf, want) < (int)want) {
+                status = PM3_EINVARG;
+                goto out;
+            }
+            n -= want / 4;
+        }
+        resp.next = req->skip;
+#endif
+    } else {
+        resp.next = req->first;
+    }
+
+    init_tag();
+    em4x50_setup_read();
+
+    // set gHigh and gLow
+    if (get_signalproperties() && find_em4x50_tag()) {
+
+        uint32_t lastprogress = GetTickCount();
+
+        while (true) {
+
+            // Allow button press / usb cmd to interrupt device
+            if (BUTTON_PRESS() || data_available()) {
+                status = PM3_EOPABORTED;
+                break;
+            }
+
+            WDT_HIT();
+
+            if (GetTickCountDelta(lastprogress) > 1000) {
+                resp.final = false;
+                reply_ng(CMD_LF_EM4X50_BRUTE, PM3_SUCCESS, (uint8_t *)&resp, sizeof(resp));
+                lastprogress = GetTickCount();
+            }
+
+            // next candidate
+            if (bdict) {
+#ifdef WITH_FLASH
+                if (pos + 4 > fill) {
+                    int n = rdv40_spiffs_read_fd(fd, buf, EM4X50_BRUTE_CHUNK * 4);
+                    fill = (n > 0) ? n : 0;
+                    pos = 0;
+                    if (fill < 4)
+                        break;
+                }
+                memcpy(password, buf + pos, 4);
+                pos += 4;
+#endif
+            } else {
+                num_to_bytes(resp.next, 4, password);
+            }
+
+            resp.checked++;
+
+            if (login(password)) {
+                resp.found = true;
+                memcpy(resp.password, password, 4);
+            }
+
+            // end of range
+            if (bdict == false && resp.next == req->last)
+                break;
+
+            resp.next++;
+
+            if (resp.found)
+                break;
+        }
+
+    } else {
+        status = PM3_ECARDEXCHANGE;
+    }
+
+    lf_finalize();
+
+#ifdef WITH_FLASH
+out:
+    rdv40_spiffs_readahead(NULL, 0);
+    if (fd >= 0)
+        rdv40_spiffs_close_fd(fd);
+    if (bdict)
+        rdv40_spiffs_lazy_mount_rollback(changed);
+    BigBuf_free();
+#endif
+
+    resp.final = true;
+    reply_ng(CMD_LF_EM4X50_BRUTE, status, (uint8_t *)&resp, sizeof(resp));
+}
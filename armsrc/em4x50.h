@@ -22,5 +22,6 @@ void em4x50_write(em4x50_data_t *etd);
 void em4x50_write_password(em4x50_data_t *etd);
 void em4x50_read(em4x50_data_t *etd);
 void em4x50_wipe(em4x50_data_t *etd);
+void em4x50_brute(em4x50_brute_req_t *req);
 
 #endif /* EM4X50_H */
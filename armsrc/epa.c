@@ -12,6 +12,7 @@
 //-----------------------------------------------------------------------------
 #include "epa.h"
 
+#include "proxmark3_arm.h"
 #include "cmd.h"
 #include "fpgaloader.h"
 #include "iso14443a.h"
@@ -272,6 +273,36 @@ static void EPA_PACE_Collect_Nonce_Abort(uint32_t cmd, uint8_t step, int func_re
     reply_mix(cmd, step, func_return, 0, 0, 0);
 }
 
+//-----------------------------------------------------------------------------
+// Selects the card and finds its PACE version in the CardAccess file, the
+// steps 1 to 3 of EPA_PACE_Collect_Nonce. Returns the failing step or 0
+//-----------------------------------------------------------------------------
+static uint8_t EPA_PACE_Collect_Setup(pace_version_info_t *pace_version_info, int *func_return) {
+    // set up communication
+    *func_return = EPA_Setup();
+    if (*func_return != 0) {
+        return 1;
+    }
+
+    // read the CardAccess file
+    // this array will hold the CardAccess file
+    uint8_t card_access[256] = {0};
+    int cardlen = EPA_Read_CardAccess(card_access, 256);
+    // the response has to be at least this big to hold the OID
+    if (cardlen < 18) {
+        *func_return = cardlen;
+        return 2;
+    }
+
+    // search for the PACE OID
+    *func_return = EPA_Parse_CardAccess(card_access, cardlen, pace_version_info);
+
+    if (*func_return != 0 || pace_version_info->version == 0) {
+        return 3;
+    }
+    return 0;
+}
+
 //-----------------------------------------------------------------------------
 // Acquire one encrypted PACE nonce
 //-----------------------------------------------------------------------------
@@ -286,31 +317,13 @@ void EPA_PACE_Collect_Nonce(PacketCommandNG *c) {
      *   d:
      *       Encrypted nonce
      */
-    // set up communication
-    int func_return = EPA_Setup();
-    if (func_return != 0) {
-        EPA_PACE_Collect_Nonce_Abort(CMD_HF_EPA_COLLECT_NONCE, 1, func_return);
-        return;
-    }
-
-    // read the CardAccess file
-    // this array will hold the CardAccess file
-    uint8_t card_access[256] = {0};
-    int cardlen = EPA_Read_CardAccess(card_access, 256);
-    // the response has to be at least this big to hold the OID
-    if (cardlen < 18) {
-        EPA_PACE_Collect_Nonce_Abort(CMD_HF_EPA_COLLECT_NONCE, 2, cardlen);
-        return;
-    }
-
     // this will hold the PACE info of the card
     pace_version_info_t pace_version_info;
+    int func_return = 0;
 
-    // search for the PACE OID
-    func_return = EPA_Parse_CardAccess(card_access, cardlen, &pace_version_info);
-
-    if (func_return != 0 || pace_version_info.version == 0) {
-        EPA_PACE_Collect_Nonce_Abort(CMD_HF_EPA_COLLECT_NONCE, 3, func_return);
+    uint8_t step = EPA_PACE_Collect_Setup(&pace_version_info, &func_return);
+    if (step != 0) {
+        EPA_PACE_Collect_Nonce_Abort(CMD_HF_EPA_COLLECT_NONCE, step, func_return);
         return;
     }
 
@@ -344,6 +357,72 @@ void EPA_PACE_Collect_Nonce(PacketCommandNG *c) {
     reply_mix(CMD_HF_EPA_COLLECT_NONCE, 0, func_return, 0, nonce, func_return);
 }
 
+//-----------------------------------------------------------------------------
+// Acquire encrypted PACE nonces until count or the client stops it. The card
+// stays selected and its PACE version known, a nonce costs two APDUs
+//-----------------------------------------------------------------------------
+void EPA_PACE_Collect_Nonce_Stream(epa_nonce_stream_req_t *req) {
+    epa_nonce_frame_t frame;
+    memset(&frame, 0, sizeof(frame));
+
+    pace_version_info_t pace_version_info;
+    uint8_t nonce[256];
+    int func_return = 0;
+    int res = PM3_SUCCESS;
+    uint8_t fails = 0;
+
+    frame.step = EPA_PACE_Collect_Setup(&pace_version_info, &func_return);
+
+    while (frame.step == 0) {
+        WDT_HIT();
+        if (BUTTON_PRESS() || data_available()) {
+            res = PM3_EOPABORTED;
+            break;
+        }
+
+        // a new MSE:Set AT starts PACE over, so there is a new nonce
+        func_return = EPA_PACE_MSE_Set_AT(pace_version_info, 2);
+        uint8_t step = 4;
+        if (func_return == 0) {
+            func_return = EPA_PACE_Get_Nonce(req->m, nonce);
+            step = (func_return < 0) ? 5 : 0;
+        }
+
+        if (step != 0) {
+            // the card lost the session, select it again
+            EPA_Finish();
+            if (++fails > EPA_NONCE_RETRIES) {
+                frame.step = step;
+                break;
+            }
+            frame.step = EPA_PACE_Collect_Setup(&pace_version_info, &func_return);
+            continue;
+        }
+        fails = 0;
+
+        uint8_t len = MIN(func_return, UINT8_MAX);
+        if (frame.len + 1 + len > sizeof(frame.data)) {
+            reply_ng(CMD_HF_EPA_COLLECT_NONCE_STREAM, PM3_EPARTIAL, (uint8_t *)&frame, sizeof(frame) - sizeof(frame.data) + frame.len);
+            frame.len = 0;
+        }
+        frame.data[frame.len++] = len;
+        memcpy(frame.data + frame.len, nonce, len);
+        frame.len += len;
+        frame.collected++;
+
+        if (req->count && frame.collected >= req->count)
+            break;
+    }
+
+    EPA_Finish();
+
+    if (frame.step != 0)
+        res = PM3_ESOFT;
+    frame.final = true;
+    frame.func_return = func_return;
+    reply_ng(CMD_HF_EPA_COLLECT_NONCE_STREAM, res, (uint8_t *)&frame, sizeof(frame) - sizeof(frame.data) + frame.len);
+}
+
 //-----------------------------------------------------------------------------
 // Performs the "Get Nonce" step of the PACE protocol and saves the returned
 // nonce. The caller is responsible for allocating enough memory to store the
@@ -35,6 +35,7 @@ int EPA_PACE_MSE_Set_AT(pace_version_info_t pace_version_info, uint8_t password)
 int EPA_PACE_Get_Nonce(uint8_t requested_length, uint8_t *nonce);
 
 void EPA_PACE_Collect_Nonce(PacketCommandNG *c);
+void EPA_PACE_Collect_Nonce_Stream(epa_nonce_stream_req_t *req);
 void EPA_PACE_Replay(PacketCommandNG *c);
 
 #endif /* __EPA_H */
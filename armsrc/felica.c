@@ -10,6 +10,7 @@
 #include "dbprint.h"
 #include "ticks.h"
 #include "mifare.h"
+#include "profiling.h"
 
 // FeliCa timings
 // minimum time between the start bits of consecutive transfers from reader to tag: 6800 carrier (13.56MHz) cycles
@@ -86,24 +87,28 @@ static void FelicaFrameReset(void) {
     FelicaFrame.crc_ok = false;
     FelicaFrame.byte_offset = 0;
 }
+// bit reversed bytes, the SSC delivers FeliCa bits LSB first
+static uint8_t felica_reflect[256];
+
 static void FelicaFrameinit(uint8_t *data) {
     FelicaFrame.framebytes = data;
     FelicaFrameReset();
+    if (felica_reflect[0x01] == 0) {
+        for (uint16_t i = 0; i < 256; i++)
+            felica_reflect[i] = reflect8(i);
+    }
 }
 
-//shift byte into frame, reversing it at the same time
+//shift byte into frame, reversing it at the same time. The first byte_offset bits
+//complete the current frame byte, the rest start the next one
 static void shiftInByte(uint8_t bt) {
-    uint8_t j;
-    for (j = 0; j < FelicaFrame.byte_offset; j++) {
-        FelicaFrame.framebytes[FelicaFrame.posCnt] = (FelicaFrame.framebytes[FelicaFrame.posCnt] << 1) + (bt & 1);
-        bt >>= 1;
-    }
+    uint8_t r = felica_reflect[bt];
+    uint8_t off = FelicaFrame.byte_offset;
+    uint8_t *fb = FelicaFrame.framebytes + FelicaFrame.posCnt;
+    fb[0] = (fb[0] << off) | (r >> (8 - off));
+    fb[1] = (fb[1] << (8 - off)) | (r & (0xFF >> off));
     FelicaFrame.posCnt++;
     FelicaFrame.rem_len--;
-    for (j = FelicaFrame.byte_offset; j < 8; j++) {
-        FelicaFrame.framebytes[FelicaFrame.posCnt] = (FelicaFrame.framebytes[FelicaFrame.posCnt] << 1) + (bt & 1);
-        bt >>= 1;
-    }
 }
 
 static void Process18092Byte(uint8_t bt) {
@@ -111,7 +116,7 @@ static void Process18092Byte(uint8_t bt) {
         case STATE_UNSYNCD: {
             //almost any nonzero byte can be start of SYNC. SYNC should be preceded by zeros, but that is not always the case
             if (bt > 0) {
-                FelicaFrame.shiftReg = reflect8(bt);
+                FelicaFrame.shiftReg = felica_reflect[bt];
                 FelicaFrame.state = STATE_TRYING_SYNC;
             }
             break;
@@ -571,57 +576,158 @@ void felica_sendraw(PacketCommandNG *c) {
     return;
 }
 
-void felica_sniff(uint32_t samplesToSkip, uint32_t triggersToSkip) {
+// live sniff, ship the whole trace records from *sent on, at most FELICA_SNIFF_LIVE_BYTES per frame
+#define FELICA_SNIFF_LIVE_BYTES     128
+#define FELICA_SNIFF_LIVE_QUIET     16      // 16 bytes = 604us without a sync after the last frame
+
+static void FelicaSniffLiveSend(hf14a_sniff_frame_t *frame, uint32_t *sent, bool final, int status) {
+    uint8_t *trace = BigBuf_get_addr();
+    uint32_t end = BigBuf_get_traceLen();
+
+    frame->len = 0;
+    while (*sent < end) {
+        tracelog_hdr_t *hdr = (tracelog_hdr_t *)(trace + *sent);
+        uint16_t reclen = TRACELOG_HDR_LEN + hdr->data_len + TRACELOG_PARITY_LEN(hdr);
+        // a record longer than the limit still goes out alone
+        if (frame->len && frame->len + reclen > FELICA_SNIFF_LIVE_BYTES)
+            break;
+        if (frame->len + reclen > HF14A_SNIFF_RECORDS)
+            break;
+
+        memcpy(frame->data + frame->len, hdr, reclen);
+        frame->len += reclen;
+        *sent += reclen;
+    }
+
+    frame->final = final;
+    reply_ng(CMD_HF_FELICA_SNIFF_STREAM, status, (uint8_t *)frame, sizeof(hf14a_sniff_frame_t) - HF14A_SNIFF_RECORDS + frame->len);
+    frame->seq++;
+}
+
+// samplesToSkip frames are logged, sniffing stops after triggersToSkip sync candidates. 0 is no limit.
+// The bytes come through DMA, the live mode sends the records in between two frames
+void felica_sniff(uint32_t samplesToSkip, uint32_t triggersToSkip, bool live) {
     int remFrames = (samplesToSkip) ? samplesToSkip : 0;
     Dbprintf("Sniff Felica: Getting first %d frames, Skipping after %d triggers.\n", samplesToSkip, triggersToSkip);
     clear_trace();
     set_tracing(true);
     iso18092_setup(FPGA_HF_ISO18092_FLAG_NOMOD);
     LED_D_ON();
-    uint16_t numbts = 0;
     int trigger_cnt = 0;
     uint32_t timeout = iso18092_get_timeout();
     bool isReaderFrame = true;
+
+    hf14a_sniff_frame_t *frame = NULL;
+    uint32_t live_sent = 0;
+    int live_status = PM3_EOPABORTED;
+    if (live) {
+        frame = (hf14a_sniff_frame_t *)BigBuf_malloc(sizeof(hf14a_sniff_frame_t));
+        memset(frame, 0, sizeof(hf14a_sniff_frame_t));
+    }
+
+    // The DMA buffer, used to stream bytes from the FPGA
+    dmabuf8_t *dma = get_dma8();
+    uint8_t *data = dma->buf;
+
+    if (!FpgaSetupSscDma(dma->buf, DMA_BUFFER_SIZE)) {
+        if (DBGLEVEL > DBG_ERROR) DbpString("FpgaSetupSscDma failed. Exiting");
+        live_status = PM3_EINIT;
+        goto out;
+    }
+
+    uint32_t quiet = 0;
+
     while (!BUTTON_PRESS()) {
         WDT_HIT();
-        if (AT91C_BASE_SSC->SSC_SR & AT91C_SSC_RXRDY) {
-            uint8_t dist = (uint8_t)(AT91C_BASE_SSC->SSC_RHR);
+
+        int readBufDataP = data - dma->buf;
+        int dmaBufDataP = DMA_BUFFER_SIZE - AT91C_BASE_PDC_SSC->PDC_RCR;
+        int dataLen;
+        if (readBufDataP <= dmaBufDataP)
+            dataLen = dmaBufDataP - readBufDataP;
+        else
+            dataLen = DMA_BUFFER_SIZE - readBufDataP + dmaBufDataP;
+
+        if (dataLen > (9 * DMA_BUFFER_SIZE / 10)) {
+            profiling_dma_overrun();
+            Dbprintf("[!] blew circular buffer! | datalen %u", dataLen);
+            live_status = PM3_EOVFLOW;
+            break;
+        }
+
+        // live mode, only while no frame is on its way and with little DMA backlog
+        if (live && FelicaFrame.state == STATE_UNSYNCD && quiet > FELICA_SNIFF_LIVE_QUIET && dataLen < DMA_BUFFER_SIZE / 4) {
+            if (live_sent < BigBuf_get_traceLen()) {
+                FelicaSniffLiveSend(frame, &live_sent, false, PM3_SUCCESS);
+            } else if (data_available()) {
+                break;
+            } else if (live_sent > BigBuf_max_traceLen() / 2) {
+                // everything has been shipped, start the trace over
+                clear_trace();
+                live_sent = 0;
+            }
+            quiet = 0;
+        }
+
+        if (dataLen < 1) continue;
+
+        // secondary buffer sets as primary, secondary buffer was stopped
+        if (!AT91C_BASE_PDC_SSC->PDC_RNCR) {
+            AT91C_BASE_PDC_SSC->PDC_RNPR = (uint32_t) dma->buf;
+            AT91C_BASE_PDC_SSC->PDC_RNCR = DMA_BUFFER_SIZE;
+        }
+
+        // all bytes of this run, the decoder only looks at one byte at a time
+        while (dataLen--) {
+            uint8_t dist = *data++;
+            if (data == dma->buf + DMA_BUFFER_SIZE)
+                data = dma->buf;
+
             Process18092Byte(dist);
-            if ((dist >= 178) && (++trigger_cnt > triggersToSkip)) {
+            quiet++;
+
+            if (triggersToSkip && (dist >= 178) && (++trigger_cnt > triggersToSkip)) {
                 Dbprintf("triggersToSkip kicked %d", dist);
-                break;
+                goto done;
             }
             if (FelicaFrame.state == STATE_FULL) {
-                if ((FelicaFrame.framebytes[3] % 2) == 0) {
-                    isReaderFrame = true; // All Reader Frames are even and all Tag frames are odd
-                } else {
-                    isReaderFrame = false;
-                }
-                remFrames--;
-                if (remFrames <= 0) {
+                // All Reader Frames are even and all Tag frames are odd
+                isReaderFrame = ((FelicaFrame.framebytes[3] % 2) == 0);
+                if (samplesToSkip && --remFrames <= 0) {
                     Dbprintf("Stop Sniffing - samplesToSkip reached!");
-                    break;
+                    goto done;
+                }
+                if (!LogTrace(FelicaFrame.framebytes,
+                              FelicaFrame.len,
+                              ((GetCountSspClk() & 0xfffffff8) << 4) - DELAY_AIR2ARM_AS_READER - timeout,
+                              ((GetCountSspClk() & 0xfffffff8) << 4) - DELAY_AIR2ARM_AS_READER,
+                              NULL,
+                              isReaderFrame
+                             )) {
+                    live_status = PM3_EOVFLOW;
+                    goto done;
                 }
-                LogTrace(FelicaFrame.framebytes,
-                         FelicaFrame.len,
-                         ((GetCountSspClk() & 0xfffffff8) << 4) - DELAY_AIR2ARM_AS_READER - timeout,
-                         ((GetCountSspClk() & 0xfffffff8) << 4) - DELAY_AIR2ARM_AS_READER,
-                         NULL,
-                         isReaderFrame
-                        );
-                numbts += FelicaFrame.len;
                 FelicaFrameReset();
+                quiet = 0;
             }
         }
     }
+
+done:
+    FpgaDisableSscDma();
+out:
     switch_off();
     //reset framing
     AT91C_BASE_SSC->SSC_RFMR = SSC_FRAME_MODE_BITS_IN_WORD(8) | AT91C_SSC_MSBF | SSC_FRAME_MODE_WORDS_PER_TRANSFER(0);
-    set_tracelen(numbts);
-    set_tracelen(BigBuf_max_traceLen());
 
-    Dbprintf("Felica sniffing done, tracelen: %i, use hf list felica for annotations", BigBuf_get_traceLen());
-    reply_mix(CMD_ACK, 1, numbts, 0, 0, 0);
+    if (live) {
+        while (live_sent < BigBuf_get_traceLen())
+            FelicaSniffLiveSend(frame, &live_sent, false, PM3_SUCCESS);
+        FelicaSniffLiveSend(frame, &live_sent, true, live_status);
+    } else {
+        Dbprintf("Felica sniffing done, tracelen: %i, use hf list felica for annotations", BigBuf_get_traceLen());
+        reply_mix(CMD_ACK, 1, BigBuf_get_traceLen(), 0, 0, 0);
+    }
     LED_D_OFF();
 }
 
@@ -738,6 +844,12 @@ void felica_sim_lite(uint64_t uid) {
 
 #define RES_SVC_LEN 11 + 3
 
+// Read Without Encryption answer: fb[12..13] status flags, fb[14] block count, 16 bytes per block from fb[15]
+#define FELICA_RDBLK_DATA_OFFSET 15
+
+// Lite-S takes at most 4 blocks per Read Without Encryption
+#define FELICA_LITE_S_MAX_READ_BLOCKS 4
+
 void felica_dump_lite_s(void) {
     uint8_t ndef[8];
     uint8_t poll[10] = { 0xb2, 0x4d, 0x06, FELICA_POLL_REQ, 0xff, 0xff, 0x00, 0x00, 0x09, 0x21};
@@ -754,51 +866,52 @@ void felica_dump_lite_s(void) {
     while (!BUTTON_PRESS() && !data_available()) {
         WDT_HIT();
         // polling?
-        //TransmitFor18092_AsReader(poll, 10, GetCountSspClk()+512, 1, 0);
         TransmitFor18092_AsReader(poll, 10, NULL, 1, 0);
 
         if (WaitForFelicaReply(512) && FelicaFrame.framebytes[3] == FELICA_POLL_ACK) {
             // copy 8bytes to ndef.
             memcpy(ndef, FelicaFrame.framebytes + 4, 8);
-            // for (c=0; c < 8; c++)
-            // ndef[c] = FelicaFrame.framebytes[c+4];
-
-            for (blknum = 0; blknum < ARRAYLEN(liteblks);) {
-                // block to read.
-                BuildFliteRdblk(ndef, 1, &liteblks[blknum]);
-
-                //TransmitFor18092_AsReader(frameSpace, frameSpace[2]+4, GetCountSspClk()+512, 1, 0);
 
+            // blocks below single_until are read one by one, a batch with an error status
+            // doesn't say which of its blocks failed
+            uint8_t single_until = 0;
 
+            for (blknum = 0; blknum < ARRAYLEN(liteblks);) {
+                uint8_t n = MIN(FELICA_LITE_S_MAX_READ_BLOCKS, ARRAYLEN(liteblks) - blknum);
+                if (blknum < single_until)
+                    n = 1;
 
+                BuildFliteRdblk(ndef, n, &liteblks[blknum]);
                 TransmitFor18092_AsReader(frameSpace, frameSpace[2] + 4, NULL, 1, 0);
-                // read block
-                if (WaitForFelicaReply(1024) && FelicaFrame.framebytes[3] == FELICA_RDBLK_ACK) {
 
-                    dest[cnt++] = liteblks[blknum];
-
-                    uint8_t *fb = FelicaFrame.framebytes;
-                    dest[cnt++] = fb[12];
-                    dest[cnt++] = fb[13];
-
-                    //memcpy(dest+cnt, FelicaFrame.framebytes + 15, 16);
-                    //cnt += 16;
-                    for (uint8_t j = 0; j < 16; j++)
-                        dest[cnt++] = fb[15 + j];
-
-                    blknum++;
-                    cntfails = 0;
-
-                    // // print raw log.
-                    // Dbprintf("LEN %u | Dump bytes count %u ", FelicaFrame.len, cnt);
-                    Dbhexdump(FelicaFrame.len, FelicaFrame.framebytes + 15, 0);
-                } else {
+                if (WaitForFelicaReply(1024) == false || FelicaFrame.framebytes[3] != FELICA_RDBLK_ACK) {
                     cntfails++;
                     if (cntfails > 12) {
                         blknum++;
                         cntfails = 0;
                     }
+                    continue;
+                }
+
+                uint8_t *fb = FelicaFrame.framebytes;
+                if (n > 1 && (fb[12] != 0 || fb[14] != n)) {
+                    single_until = blknum + n;
+                    continue;
+                }
+
+                for (uint8_t i = 0; i < n; i++) {
+                    dest[cnt++] = liteblks[blknum + i];
+                    dest[cnt++] = fb[12];
+                    dest[cnt++] = fb[13];
+                    memcpy(dest + cnt, fb + FELICA_RDBLK_DATA_OFFSET + (i * 16), 16);
+                    cnt += 16;
                 }
+
+                if (DBGLEVEL >= DBG_DEBUG)
+                    Dbhexdump(n * 16, fb + FELICA_RDBLK_DATA_OFFSET, 0);
+
+                blknum += n;
+                cntfails = 0;
             }
 
             isOK = true;
@@ -814,3 +927,81 @@ void felica_dump_lite_s(void) {
     set_tracelen(cnt);
     reply_mix(CMD_ACK, isOK, cnt, 0, 0, 0);
 }
+
+// Polling answers start 2.417ms after the request, one 1.208ms time slot per card.
+// timeout counts received bytes, ~37.8us each at 212kbps
+#define FELICA_POLL_SLOT0_BYTES     64
+#define FELICA_POLL_SLOT_BYTES      32
+#define FELICA_INVENTORY_ROUNDS     8
+
+static void felica_inventory_add(felica_inventory_resp_t *resp, const uint8_t *fb) {
+    for (uint8_t i = 0; i < resp->count; i++) {
+        if (memcmp(resp->cards[i].IDm, fb + 4, 8) == 0)
+            return;
+    }
+    if (resp->count == FELICA_INVENTORY_MAX_CARDS) {
+        resp->flags |= FELICA_INVENTORY_TRUNCATED;
+        return;
+    }
+    memcpy(resp->cards[resp->count].IDm, fb + 4, 8);
+    memcpy(resp->cards[resp->count].PMm, fb + 12, 8);
+    resp->count++;
+}
+
+// Polls with time slots so several cards answer the same request. Each card picks a random
+// slot per request, rounds go on while answers collide or new cards turn up
+void felica_inventory(uint8_t slots) {
+
+    if (slots != 1 && slots != 2 && slots != 4 && slots != 8 && slots != 16)
+        slots = 16;
+
+    iso18092_setup(FPGA_HF_ISO18092_FLAG_READER | FPGA_HF_ISO18092_FLAG_NOMOD);
+
+    felica_inventory_resp_t resp;
+    memset(&resp, 0, sizeof(resp));
+
+    // the timeslot byte is the number of slots - 1
+    uint8_t poll[10] = {0xb2, 0x4d, 0x06, FELICA_POLL_REQ, 0xff, 0xff, 0x00, slots - 1, 0x00, 0x00};
+    AddCrc(poll + 2, 6);
+
+    // each WaitForFelicaReply restarts the count, a window covering every slot keeps
+    // the loop below listening until the last slot is over
+    iso18092_set_timeout(FELICA_POLL_SLOT0_BYTES + (slots * FELICA_POLL_SLOT_BYTES));
+
+    int status = PM3_SUCCESS;
+    uint8_t quiet = 0;
+    for (uint8_t round = 0; round < FELICA_INVENTORY_ROUNDS; round++) {
+        WDT_HIT();
+
+        if (BUTTON_PRESS() || data_available()) {
+            status = PM3_EOPABORTED;
+            break;
+        }
+
+        uint8_t before = resp.count;
+        bool collision = false;
+
+        TransmitFor18092_AsReader(poll, sizeof(poll), NULL, 1, 0);
+        while (WaitForFelicaReply(1024)) {
+            if (FelicaFrame.crc_ok == false || FelicaFrame.framebytes[2] < 0x12) {
+                collision = true;
+                continue;
+            }
+            if (FelicaFrame.framebytes[3] == FELICA_POLL_ACK)
+                felica_inventory_add(&resp, FelicaFrame.framebytes);
+        }
+
+        // two clean rounds in a row without a new card, nobody is left
+        if (collision || resp.count != before)
+            quiet = 0;
+        else if (++quiet == 2)
+            break;
+    }
+
+    switch_off();
+
+    //Resetting Frame mode (First set in fpgaloader.c)
+    AT91C_BASE_SSC->SSC_RFMR = SSC_FRAME_MODE_BITS_IN_WORD(8) | AT91C_SSC_MSBF | SSC_FRAME_MODE_WORDS_PER_TRANSFER(0);
+
+    reply_ng(CMD_HF_FELICA_INVENTORY, status, (uint8_t *)&resp, sizeof(resp));
+}
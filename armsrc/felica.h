@@ -15,8 +15,9 @@
 #include "cmd.h"
 
 void felica_sendraw(PacketCommandNG *c);
-void felica_sniff(uint32_t samplesToSkip, uint32_t triggersToSkip);
+void felica_sniff(uint32_t samplesToSkip, uint32_t triggersToSkip, bool live);
 void felica_sim_lite(uint64_t uid);
 void felica_dump_lite_s(void);
+void felica_inventory(uint8_t slots);
 
 #endif
@@ -184,6 +184,38 @@ uint16_t FlashSendLastByte(uint32_t data) {
     return FlashSendByte(data | AT91C_SPI_LASTXFER);
 }
 
+// Moves len bytes through the SPI with the PDC, chip select stays asserted. The caller ends the
+// frame with FlashSendLastByte. rx NULL discards the answer, the last received byte is flushed
+// so the next FlashSendByte doesn't return it.
+static void FlashTransferPDC(const uint8_t *tx, uint8_t *rx, uint16_t len) {
+
+    if (len == 0)
+        return;
+
+    AT91C_BASE_PDC_SPI->PDC_PTCR = AT91C_PDC_RXTDIS | AT91C_PDC_TXTDIS;
+
+    // drop a stale byte, else it shows up first in rx
+    if (AT91C_BASE_SPI->SPI_RDR == 0) {};
+
+    if (rx) {
+        AT91C_BASE_PDC_SPI->PDC_RPR = (uint32_t) rx;
+        AT91C_BASE_PDC_SPI->PDC_RCR = len;
+    }
+    AT91C_BASE_PDC_SPI->PDC_TPR = (uint32_t) tx;
+    AT91C_BASE_PDC_SPI->PDC_TCR = len;
+    AT91C_BASE_PDC_SPI->PDC_PTCR = (rx ? AT91C_PDC_RXTEN : 0) | AT91C_PDC_TXTEN;
+
+    if (rx) {
+        while ((AT91C_BASE_SPI->SPI_SR & AT91C_SPI_ENDRX) == 0) {};
+    } else {
+        while ((AT91C_BASE_SPI->SPI_SR & AT91C_SPI_ENDTX) == 0) {};
+        while ((AT91C_BASE_SPI->SPI_SR & AT91C_SPI_TXEMPTY) == 0) {};
+        if (AT91C_BASE_SPI->SPI_RDR == 0) {};
+    }
+
+    AT91C_BASE_PDC_SPI->PDC_PTCR = AT91C_PDC_RXTDIS | AT91C_PDC_TXTDIS;
+}
+
 // read state register 1
 uint8_t Flash_ReadStat1(void) {
     FlashSendByte(READSTAT1);
@@ -197,17 +229,18 @@ bool Flash_CheckBusy(uint32_t timeout) {
 
     if (DBGLEVEL > 3) Dbprintf("Checkbusy in...");
 
+    // the status register is sent over and over as long as chip select stays asserted,
+    // one byte per poll instead of a command frame
+    FlashSendByte(READSTAT1);
     do {
-        if (!(Flash_ReadStat1() & BUSY)) {
+        if (!(FlashSendByte(0xFF) & BUSY)) {
+            FlashSendLastByte(0xFF);
             return false;
         }
     } while ((GetCountUS() - _time) < timeout);
 
-    if (timeout <= (GetCountUS() - _time)) {
-        return true;
-    }
-
-    return false;
+    FlashSendLastByte(0xFF);
+    return true;
 }
 
 // read ID out
@@ -270,11 +303,11 @@ uint16_t Flash_ReadData(uint32_t address, uint8_t *out, uint16_t len) {
         FlashSendByte(DUMMYBYTE);
     }
 
-    uint16_t i = 0;
-    for (; i < (len - 1); i++)
-        out[i] = FlashSendByte(0xFF);
+    // flash ignores MOSI while reading, the buffer is sent out and filled in one go
+    memset(out, 0xFF, len - 1);
+    FlashTransferPDC(out, out, len - 1);
 
-    out[i] = FlashSendLastByte(0xFF);
+    out[len - 1] = FlashSendLastByte(0xFF);
     FlashStop();
     return len;
 }
@@ -300,11 +333,11 @@ uint16_t Flash_ReadDataCont(uint32_t address, uint8_t *out, uint16_t len) {
         FlashSendByte(DUMMYBYTE);
     }
 
-    uint16_t i = 0;
-    for (; i < (len - 1); i++)
-        out[i] = FlashSendByte(0xFF);
+    // flash ignores MOSI while reading, the buffer is sent out and filled in one go
+    memset(out, 0xFF, len - 1);
+    FlashTransferPDC(out, out, len - 1);
 
-    out[i] = FlashSendLastByte(0xFF);
+    out[len - 1] = FlashSendLastByte(0xFF);
     return len;
 }
 
@@ -344,11 +377,8 @@ uint16_t Flash_WriteData(uint32_t address, uint8_t *in, uint16_t len) {
     FlashSendByte((address >> 8) & 0xFF);
     FlashSendByte((address >> 0) & 0xFF);
 
-    uint16_t i = 0;
-    for (; i < (len - 1); i++)
-        FlashSendByte(in[i]);
-
-    FlashSendLastByte(in[i]);
+    FlashTransferPDC(in, NULL, len - 1);
+    FlashSendLastByte(in[len - 1]);
 
     FlashStop();
     return len;
@@ -378,31 +408,25 @@ uint16_t Flash_WriteDataCont(uint32_t address, uint8_t *in, uint16_t len) {
     FlashSendByte((address >> 8) & 0xFF);
     FlashSendByte((address >> 0) & 0xFF);
 
-    uint16_t i = 0;
-    for (; i < (len - 1); i++)
-        FlashSendByte(in[i]);
-
-    FlashSendLastByte(in[i]);
+    FlashTransferPDC(in, NULL, len - 1);
+    FlashSendLastByte(in[len - 1]);
     return len;
 }
 
-// assumes valid start 256 based 00 address
-//
+// splits at the page boundaries, any start address
+// pages go out straight from in, the next one as soon as the flash is done programming
 uint16_t Flash_Write(uint32_t address, uint8_t *in, uint16_t len) {
 
     bool isok;
     uint16_t res, bytes_sent = 0, bytes_remaining = len;
-    uint8_t buf[FLASH_MEM_BLOCK_SIZE];
     while (bytes_remaining > 0) {
 
         Flash_CheckBusy(BUSY_TIMEOUT);
         Flash_WriteEnable();
 
-        uint32_t bytes_in_packet = MIN(FLASH_MEM_BLOCK_SIZE, bytes_remaining);
-
-        memcpy(buf, in + bytes_sent, bytes_in_packet);
+        uint32_t bytes_in_packet = MIN(PAGESIZE - ((address + bytes_sent) & (PAGESIZE - 1)), bytes_remaining);
 
-        res = Flash_WriteDataCont(address + bytes_sent, buf, bytes_in_packet);
+        res = Flash_WriteDataCont(address + bytes_sent, in + bytes_sent, bytes_in_packet);
 
         bytes_remaining -= bytes_in_packet;
         bytes_sent += bytes_in_packet;
@@ -18,6 +18,7 @@
 #include "dbprint.h"
 #include "util.h"
 #include "fpga.h"
+#include "cmd.h"
 #include "string.h"
 
 #include "lz4.h"       // uncompress
@@ -37,7 +38,10 @@ static int downloaded_bitstream = 0;
 extern uint8_t _binary_obj_fpga_all_bit_z_start, _binary_obj_fpga_all_bit_z_end;
 
 static uint8_t *fpga_image_ptr = NULL;
-static uint32_t uncompressed_bytes_cnt;
+// position in the interleaved stream: byte within the current FPGA_INTERLEAVE_SIZE block and
+// which bitstream that block belongs to
+static uint16_t fpga_interleave_pos;
+static uint8_t fpga_interleave_idx;
 
 //-----------------------------------------------------------------------------
 // Set up the Serial Peripheral Interface as master
@@ -188,42 +192,76 @@ bool FpgaSetupSscDma(uint8_t *buf, uint16_t len) {
 }
 
 //----------------------------------------------------------------------------
-// Uncompress (inflate) the FPGA data. Returns one decompressed byte with each call.
+// Uncompress (inflate) the next chunk of FPGA data into the ring buffer
 //----------------------------------------------------------------------------
-static int get_from_fpga_combined_stream(lz4_streamp compressed_fpga_stream, uint8_t *output_buffer) {
-    if (fpga_image_ptr == output_buffer + FPGA_RING_BUFFER_BYTES) { // need more data
-        fpga_image_ptr = output_buffer;
-        int cmp_bytes;
-        memcpy(&cmp_bytes, compressed_fpga_stream->next_in, sizeof(int));
-        compressed_fpga_stream->next_in += 4;
-        compressed_fpga_stream->avail_in -= cmp_bytes + 4;
-        int res = LZ4_decompress_safe_continue(compressed_fpga_stream->lz4StreamDecode,
-                                               compressed_fpga_stream->next_in,
-                                               (char *)output_buffer,
-                                               cmp_bytes,
-                                               FPGA_RING_BUFFER_BYTES);
-        if (res <= 0) {
-            Dbprintf("inflate returned: %d", res);
-            return res;
-        }
-        compressed_fpga_stream->next_in += cmp_bytes;
+static int refill_fpga_stream(lz4_streamp compressed_fpga_stream, uint8_t *output_buffer) {
+    fpga_image_ptr = output_buffer;
+    int cmp_bytes;
+    memcpy(&cmp_bytes, compressed_fpga_stream->next_in, sizeof(int));
+    compressed_fpga_stream->next_in += 4;
+    compressed_fpga_stream->avail_in -= cmp_bytes + 4;
+    int res = LZ4_decompress_safe_continue(compressed_fpga_stream->lz4StreamDecode,
+                                           compressed_fpga_stream->next_in,
+                                           (char *)output_buffer,
+                                           cmp_bytes,
+                                           FPGA_RING_BUFFER_BYTES);
+    if (res <= 0) {
+        Dbprintf("inflate returned: %d", res);
+        return res;
+    }
+    compressed_fpga_stream->next_in += cmp_bytes;
+    return res;
+}
+
+// consumed n bytes, never more than left in the current interleave block
+static void advance_fpga_stream(uint16_t n) {
+    fpga_interleave_pos += n;
+    if (fpga_interleave_pos == FPGA_INTERLEAVE_SIZE) {
+        fpga_interleave_pos = 0;
+        if (++fpga_interleave_idx == g_fpga_bitstream_num)
+            fpga_interleave_idx = 0;
     }
-    uncompressed_bytes_cnt++;
-    return *fpga_image_ptr++;
 }
 
 //----------------------------------------------------------------------------
 // Undo the interleaving of several FPGA config files. FPGA config files
 // are combined into one big file:
 // 288 bytes from FPGA file 1, followed by 288 bytes from FGPA file 2, etc.
+// Blocks of the other files are skipped as a whole, not byte by byte.
+//
+// *span points to the next bytes of bitstream_version, right in the ring buffer.
+// Returns how many, at most max and never past the interleave block, or the inflate error
 //----------------------------------------------------------------------------
-static int get_from_fpga_stream(int bitstream_version, lz4_streamp compressed_fpga_stream, uint8_t *output_buffer) {
-    while ((uncompressed_bytes_cnt / FPGA_INTERLEAVE_SIZE) % g_fpga_bitstream_num != (bitstream_version - 1)) {
+static int get_span_from_fpga_stream(int bitstream_version, lz4_streamp compressed_fpga_stream, uint8_t *output_buffer, uint8_t **span, uint16_t max) {
+    for (;;) {
+        if (fpga_image_ptr == output_buffer + FPGA_RING_BUFFER_BYTES) { // need more data
+            int res = refill_fpga_stream(compressed_fpga_stream, output_buffer);
+            if (res <= 0)
+                return res;
+        }
+        uint16_t n = MIN(FPGA_INTERLEAVE_SIZE - fpga_interleave_pos, output_buffer + FPGA_RING_BUFFER_BYTES - fpga_image_ptr);
+        if (fpga_interleave_idx == (bitstream_version - 1)) {
+            n = MIN(n, max);
+            *span = fpga_image_ptr;
+            fpga_image_ptr += n;
+            advance_fpga_stream(n);
+            return n;
+        }
         // skip undesired data belonging to other bitstream_versions
-        get_from_fpga_combined_stream(compressed_fpga_stream, output_buffer);
+        fpga_image_ptr += n;
+        advance_fpga_stream(n);
     }
+}
 
-    return get_from_fpga_combined_stream(compressed_fpga_stream, output_buffer);
+//----------------------------------------------------------------------------
+// Returns one decompressed byte of bitstream_version with each call.
+//----------------------------------------------------------------------------
+static int get_from_fpga_stream(int bitstream_version, lz4_streamp compressed_fpga_stream, uint8_t *output_buffer) {
+    uint8_t *b;
+    int res = get_span_from_fpga_stream(bitstream_version, compressed_fpga_stream, output_buffer, &b, 1);
+    if (res <= 0)
+        return res;
+    return *b;
 }
 
 //----------------------------------------------------------------------------
@@ -232,7 +270,8 @@ static int get_from_fpga_stream(int bitstream_version, lz4_streamp compressed_fp
 static bool reset_fpga_stream(int bitstream_version, lz4_streamp compressed_fpga_stream, uint8_t *output_buffer) {
     uint8_t header[FPGA_BITSTREAM_FIXED_HEADER_SIZE];
 
-    uncompressed_bytes_cnt = 0;
+    fpga_interleave_pos = 0;
+    fpga_interleave_idx = 0;
 
     // initialize z_stream structure for inflate:
     compressed_fpga_stream->next_in = (char *)&_binary_obj_fpga_all_bit_z_start;
@@ -254,16 +293,23 @@ static bool reset_fpga_stream(int bitstream_version, lz4_streamp compressed_fpga
     return false;
 }
 
-static void DownloadFPGA_byte(uint8_t w) {
-#define SEND_BIT(x) { if(w & (1<<x) ) HIGH(GPIO_FPGA_DIN); else LOW(GPIO_FPGA_DIN); HIGH(GPIO_FPGA_CCLK); LOW(GPIO_FPGA_CCLK); }
-    SEND_BIT(7);
-    SEND_BIT(6);
-    SEND_BIT(5);
-    SEND_BIT(4);
-    SEND_BIT(3);
-    SEND_BIT(2);
-    SEND_BIT(1);
-    SEND_BIT(0);
+// Clocks n bytes straight from the decompression buffer into the FPGA, MSB first. Runs from RAM,
+// and plain writes to SODR / CODR save the read back of HIGH() / LOW() on every edge
+static void RAMFUNC DownloadFPGA_span(const uint8_t *p, uint16_t n) {
+    AT91PS_PIO pio = AT91C_BASE_PIOA;
+#define SEND_BIT(x) { if (w & (1 << x)) pio->PIO_SODR = GPIO_FPGA_DIN; else pio->PIO_CODR = GPIO_FPGA_DIN; pio->PIO_SODR = GPIO_FPGA_CCLK; pio->PIO_CODR = GPIO_FPGA_CCLK; }
+    while (n--) {
+        uint8_t w = *p++;
+        SEND_BIT(7);
+        SEND_BIT(6);
+        SEND_BIT(5);
+        SEND_BIT(4);
+        SEND_BIT(3);
+        SEND_BIT(2);
+        SEND_BIT(1);
+        SEND_BIT(0);
+    }
+#undef SEND_BIT
 }
 
 // Download the fpga image starting at current stream position with length FpgaImageLen bytes
@@ -337,13 +383,16 @@ static void DownloadFPGA(int bitstream_version, int FpgaImageLen, lz4_streamp co
     AT91C_BASE_PIOA->PIO_PDR = GPIO_SPCK | GPIO_MOSI;
     //
 
-    for (i = 0; i < FpgaImageLen; i++) {
-        int b = get_from_fpga_stream(bitstream_version, compressed_fpga_stream, output_buffer);
-        if (b < 0) {
-            Dbprintf("Error %d during FpgaDownload", b);
+    // whole spans of the decompressed image, no copy and no call per byte
+    for (i = 0; i < FpgaImageLen;) {
+        uint8_t *span;
+        int n = get_span_from_fpga_stream(bitstream_version, compressed_fpga_stream, output_buffer, &span, MIN(FpgaImageLen - i, FPGA_INTERLEAVE_SIZE));
+        if (n <= 0) {
+            Dbprintf("Error %d during FpgaDownload", n);
             break;
         }
-        DownloadFPGA_byte(b);
+        DownloadFPGA_span(span, n);
+        i += n;
     }
 
     // continue to clock FPGA until ready signal goes high
@@ -502,6 +551,55 @@ void FpgaDownloadAndGo(int bitstream_version) {
     BigBuf_Clear_ext(false);
 }
 
+//----------------------------------------------------------------------------
+// Times the bitstream load for CMD_FPGA_BENCH: decompressing the image alone, then a
+// full reconfiguration of the FPGA as on boot. BigBuf is cleared on the way
+//----------------------------------------------------------------------------
+void FpgaBenchmark(void) {
+    fpga_bench_t res = {0};
+    int bitstream_version = (downloaded_bitstream != 0) ? downloaded_bitstream : FPGA_BITSTREAM_HF;
+
+    send_wtx(3000);
+
+    BigBuf_free();
+    BigBuf_Clear_ext(false);
+
+    lz4_stream compressed_fpga_stream;
+    LZ4_streamDecode_t lz4StreamDecode_body = {{ 0 }};
+    compressed_fpga_stream.lz4StreamDecode = &lz4StreamDecode_body;
+    uint8_t *output_buffer = BigBuf_malloc(FPGA_RING_BUFFER_BYTES);
+
+    uint32_t start = GetTickCount();
+    uint32_t bitstream_length = 0;
+    if (reset_fpga_stream(bitstream_version, &compressed_fpga_stream, output_buffer) &&
+            bitparse_find_section(bitstream_version, 'e', &bitstream_length, &compressed_fpga_stream, output_buffer)) {
+
+        while (res.bytes < bitstream_length) {
+            uint8_t *span;
+            int n = get_span_from_fpga_stream(bitstream_version, &compressed_fpga_stream, output_buffer, &span, MIN(bitstream_length - res.bytes, FPGA_INTERLEAVE_SIZE));
+            if (n <= 0)
+                break;
+            res.bytes += n;
+        }
+    }
+    res.decode_ms = GetTickCountDelta(start);
+    BigBuf_free();
+
+    if (res.bytes == 0 || res.bytes != bitstream_length) {
+        reply_ng(CMD_FPGA_BENCH, PM3_ESOFT, (uint8_t *)&res, sizeof(res));
+        return;
+    }
+
+    // forget the loaded image, FpgaDownloadAndGo configures the FPGA from scratch
+    downloaded_bitstream = 0;
+    start = GetTickCount();
+    FpgaDownloadAndGo(bitstream_version);
+    res.load_ms = GetTickCountDelta(start);
+
+    bool done = (AT91C_BASE_PIOA->PIO_PDSR & GPIO_FPGA_DONE);
+    reply_ng(CMD_FPGA_BENCH, done ? PM3_SUCCESS : PM3_EFAILED, (uint8_t *)&res, sizeof(res));
+}
+
 //-----------------------------------------------------------------------------
 // Send a 16 bit command/data pair to the FPGA.
 // The bit format is:  C3 C2 C1 C0 D11 D10 D9 D8 D7 D6 D5 D4 D3 D2 D1 D0
@@ -122,6 +122,7 @@ void FpgaWriteConfWord(uint16_t v);
 void FpgaEnableTracing(void);
 void FpgaDisableTracing(void);
 void FpgaDownloadAndGo(int bitstream_version);
+void FpgaBenchmark(void);
 // void FpgaGatherVersion(int bitstream_version, char *dst, int len);
 void FpgaSetupSsc(uint16_t fpga_mode);
 void SetupSpi(int mode);
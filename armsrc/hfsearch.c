@@ -0,0 +1,139 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// HF pre-filter for `hf search`. One device side pass with the shortest wake up of
+// every protocol, so the client only runs the full info commands that can succeed
+//-----------------------------------------------------------------------------
+#include "hfsearch.h"
+
+#include "proxmark3_arm.h"
+#include "cmd.h"
+#include "appmain.h"
+#include "BigBuf.h"
+#include "fpgaloader.h"
+#include "util.h"
+#include "ticks.h"
+#include "dbprint.h"
+#include "protocols.h"
+#include "crc16.h"
+#include "iso15693tools.h"
+#include "mifare.h"
+#include "iso14443a.h"
+#include "iso14443b.h"
+#include "iso15693.h"
+#include "iclass.h"
+
+// 330/212kHz = 1558us, same as ISO15693_READER_TIMEOUT
+#define HF_SEARCH_15693_TIMEOUT     330
+
+static uint16_t hf_search_measure(void) {
+    FpgaDownloadAndGo(FPGA_BITSTREAM_HF);
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_HF_READER);
+    SpinDelay(20);
+#if defined RDV4
+    return (MAX_ADC_HF_VOLTAGE_RDV40 * SumAdc(ADC_CHAN_HF_RDV40, 32)) >> 15;
+#else
+    return (MAX_ADC_HF_VOLTAGE * SumAdc(ADC_CHAN_HF, 32)) >> 15;
+#endif
+}
+
+// the tags of the previous protocol need a field reset before they answer the next wake up
+static void hf_search_field_reset(void) {
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    SpinDelay(10);
+}
+
+static bool hf_search_aborted(void) {
+    return BUTTON_PRESS() || data_available();
+}
+
+void HfSearch(void) {
+
+    hf_search_resp_t payload = {0};
+    int status = PM3_SUCCESS;
+
+    LED_A_ON();
+    payload.v_hf = hf_search_measure();
+    if (payload.v_hf < HF_SEARCH_UNUSABLE_V) {
+        payload.found = HF_SEARCH_NO_FIELD;
+        goto out;
+    }
+
+#ifdef WITH_ISO14443a
+    hf_search_field_reset();
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_MOD);
+    iso14a_card_select_t card_a;
+    switch (iso14443a_select_card(NULL, &card_a, NULL, true, 0, true)) {
+        case 1:
+        case 2:
+            payload.found |= HF_SEARCH_14A;
+            break;
+        case 3:
+            payload.found |= HF_SEARCH_TOPAZ;
+            break;
+        default:
+            break;
+    }
+    if (hf_search_aborted()) {
+        status = PM3_EOPABORTED;
+        goto out;
+    }
+#endif
+
+#if defined WITH_ISO15693 || defined WITH_ICLASS
+    // Iso15693InitReader drops the field itself. iCLASS runs on the same setup
+    Iso15693InitReader();
+    uint32_t eof_time = 0;
+#endif
+
+#ifdef WITH_ISO15693
+    uint8_t inventory[5] = {
+        ISO15_REQ_SUBCARRIER_SINGLE | ISO15_REQ_DATARATE_HIGH | ISO15_REQ_INVENTORY | ISO15_REQINV_SLOT1,
+        ISO15_CMD_INVENTORY,
+        0x00
+    };
+    compute_crc(CRC_15693, inventory, 3, &inventory[3], &inventory[4]);
+    uint8_t answer[32] = {0};
+    int len = SendDataTag(inventory, sizeof(inventory), false, true, answer, sizeof(answer), GetCountSspClk(), HF_SEARCH_15693_TIMEOUT, &eof_time);
+    if (len >= 12 && check_crc(CRC_15693, answer, len)) {
+        payload.found |= HF_SEARCH_15693;
+    }
+#endif
+
+#ifdef WITH_ICLASS
+    uint8_t card_data[6 * 8] = {0};
+    if (select_iclass_tag(card_data, false, &eof_time)) {
+        payload.found |= HF_SEARCH_ICLASS;
+    }
+#endif
+
+#if defined WITH_ISO15693 || defined WITH_ICLASS
+    if (hf_search_aborted()) {
+        status = PM3_EOPABORTED;
+        goto out;
+    }
+#endif
+
+#ifdef WITH_ISO14443b
+    hf_search_field_reset();
+    iso14443b_setup();
+    iso14b_card_select_t card_b;
+    if (iso14443b_select_card(&card_b) == 0) {
+        payload.found |= HF_SEARCH_14B;
+    } else {
+        // SRx tags stay quiet after a WUPB until the field drops
+        hf_search_field_reset();
+        FpgaWriteConfWord(FPGA_MAJOR_MODE_HF_READER | FPGA_HF_READER_MODE_SEND_SHALLOW_MOD);
+        SpinDelay(20);
+        if (iso14443b_select_srx_card(&card_b) == 0) {
+            payload.found |= HF_SEARCH_SRX;
+        }
+    }
+#endif
+
+out:
+    switch_off();
+    reply_ng(CMD_HF_SEARCH, status, (uint8_t *)&payload, sizeof(payload));
+}
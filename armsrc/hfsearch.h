@@ -0,0 +1,15 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// HF pre-filter for `hf search`
+//-----------------------------------------------------------------------------
+#ifndef __HFSEARCH_H
+#define __HFSEARCH_H
+
+#include "common.h"
+
+void HfSearch(void);
+
+#endif
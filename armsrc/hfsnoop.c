@@ -17,6 +17,7 @@
 #include "fpga.h"
 #include "appmain.h"
 #include "cmd.h"
+#include "string.h"
 
 static void RAMFUNC optimizedSniff(uint16_t *dest, uint16_t dsize) {
     while (dsize > 0) {
@@ -28,12 +29,8 @@ static void RAMFUNC optimizedSniff(uint16_t *dest, uint16_t dsize) {
     }
 }
 
-int HfSniff(uint32_t samplesToSkip, uint32_t triggersToSkip, uint16_t *len) {
-    BigBuf_free();
-    BigBuf_Clear_ext(false);
-
-    Dbprintf("Skipping first %d sample pairs, Skipping %d triggers", samplesToSkip, triggersToSkip);
-
+// FPGA in HF sniff mode, 16 bit frames: two samples per SSC transfer
+static void hf_sniff_setup(void) {
     LED_D_ON();
 
     FpgaDownloadAndGo(FPGA_BITSTREAM_HF);
@@ -48,21 +45,28 @@ int HfSniff(uint32_t samplesToSkip, uint32_t triggersToSkip, uint16_t *len) {
 
     FpgaWriteConfWord(FPGA_MAJOR_MODE_HF_SNIFF);
     SpinDelay(100);
+}
 
-    *len = (BigBuf_max_traceLen() & 0xFFFE);
-    uint8_t *mem = BigBuf_malloc(*len);
+static void hf_sniff_stop(void) {
+    //Resetting Frame mode (First set in fpgaloader.c)
+    AT91C_BASE_SSC->SSC_RFMR = SSC_FRAME_MODE_BITS_IN_WORD(8) | AT91C_SSC_MSBF | SSC_FRAME_MODE_WORDS_PER_TRANSFER(0);
+    LED_D_OFF();
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+}
 
+// Waits for a strong field, triggersToSkip + 1 times. *r gets the sample that triggered.
+// PM3_SUCCESS, PM3_EOPABORTED on button press, PM3_ENODATA when a command came in
+static int hf_sniff_trigger(uint32_t triggersToSkip, uint16_t *r) {
     uint32_t trigger_cnt = 0;
-    uint16_t r = 0, interval = 0;
+    uint16_t interval = 0;
 
-    bool pressed = false;
-    while (pressed == false) {
+    for (;;) {
         WDT_HIT();
 
         // cancel w usb command.
         if (interval == 2000) {
             if (data_available())
-                break;
+                return PM3_ENODATA;
 
             interval = 0;
         } else {
@@ -71,21 +75,37 @@ int HfSniff(uint32_t samplesToSkip, uint32_t triggersToSkip, uint16_t *len) {
 
         // check if trigger is reached
         if (AT91C_BASE_SSC->SSC_SR & (AT91C_SSC_RXRDY)) {
-            r = (uint16_t)AT91C_BASE_SSC->SSC_RHR;
+            *r = (uint16_t)AT91C_BASE_SSC->SSC_RHR;
 
-            r = MAX(r & 0xFF, r >> 8);
+            *r = MAX(*r & 0xFF, *r >> 8);
 
             // 180 (0xB4) arbitary value to see if a strong RF field is near.
-            if (r > 180) {
+            if (*r > 180) {
 
                 if (++trigger_cnt > triggersToSkip) {
-                    break;
+                    return PM3_SUCCESS;
                 }
             }
         }
 
-        pressed = BUTTON_PRESS();
+        if (BUTTON_PRESS())
+            return PM3_EOPABORTED;
     }
+}
+
+int HfSniff(uint32_t samplesToSkip, uint32_t triggersToSkip, uint16_t *len) {
+    BigBuf_free();
+    BigBuf_Clear_ext(false);
+
+    Dbprintf("Skipping first %d sample pairs, Skipping %d triggers", samplesToSkip, triggersToSkip);
+
+    hf_sniff_setup();
+
+    *len = (BigBuf_max_traceLen() & 0xFFFE);
+    uint8_t *mem = BigBuf_malloc(*len);
+
+    uint16_t r = 0;
+    bool pressed = (hf_sniff_trigger(triggersToSkip, &r) == PM3_EOPABORTED);
 
     if (pressed == false) {
 
@@ -105,14 +125,127 @@ int HfSniff(uint32_t samplesToSkip, uint32_t triggersToSkip, uint16_t *len) {
         }
     }
 
-    //Resetting Frame mode (First set in fpgaloader.c)
-    AT91C_BASE_SSC->SSC_RFMR = SSC_FRAME_MODE_BITS_IN_WORD(8) | AT91C_SSC_MSBF | SSC_FRAME_MODE_WORDS_PER_TRANSFER(0);
-    LED_D_OFF();
-    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    hf_sniff_stop();
     BigBuf_free();
     return (pressed) ? PM3_EOPABORTED : PM3_SUCCESS;
 }
 
+/**
+* Streams the sniffed samples to the client while sniffing continues, so captures are
+* not limited by BigBuf. The SSC DMA fills one half of the buffer while the other one is
+* decimated into frames and pushed. If both halves fill up before the foreground is done,
+* samples were lost and the stream ends with PM3_EOVFLOW.
+**/
+#define HF_SNIFF_DMA_HALF   2048    // 16 bit transfers, two samples each
+
+void HfSniffStream(hf_sniff_stream_req_t *req) {
+    BigBuf_free();
+    BigBuf_Clear_ext(false);
+
+    uint8_t decimation = MAX(req->decimation, 1);
+    uint32_t samplesToSkip = req->samplesToSkip;
+
+    uint16_t *dma_buf = (uint16_t *)BigBuf_malloc(2 * HF_SNIFF_DMA_HALF * sizeof(uint16_t));
+    hf_sniff_stream_frame_t *frame = (hf_sniff_stream_frame_t *)BigBuf_malloc(sizeof(hf_sniff_stream_frame_t));
+    if (dma_buf == NULL || frame == NULL) {
+        reply_ng(CMD_HF_SNIFF_STREAM, PM3_EMALLOC, NULL, 0);
+        return;
+    }
+    memset(frame, 0, sizeof(hf_sniff_stream_frame_t));
+    frame->decimation = decimation;
+
+    hf_sniff_setup();
+
+    uint16_t r = 0;
+    int status = hf_sniff_trigger(req->triggersToSkip, &r);
+    if (status == PM3_ENODATA)
+        status = PM3_EOPABORTED;
+
+    if (status == PM3_SUCCESS) {
+        while (samplesToSkip != 0) {
+            if (AT91C_BASE_SSC->SSC_SR & (AT91C_SSC_RXRDY)) {
+                (void)AT91C_BASE_SSC->SSC_RHR;
+                samplesToSkip--;
+            }
+        }
+
+        // first half now, the second one queued as next transfer
+        uint16_t *halves[2] = { dma_buf, dma_buf + HF_SNIFF_DMA_HALF };
+        FpgaSetupSscDma((uint8_t *)halves[0], HF_SNIFF_DMA_HALF);
+        AT91C_BASE_PDC_SSC->PDC_RNPR = (uint32_t)halves[1];
+
+        uint8_t cur = 0;
+        uint8_t dec_counter = 0;
+        uint8_t peak = 0;
+        uint32_t saved = 0;
+        bool done = false;
+
+        LED_A_ON();
+
+        while (done == false) {
+            WDT_HIT();
+
+            if (BUTTON_PRESS() || data_available()) {
+                status = PM3_EOPABORTED;
+                break;
+            }
+
+            // the current half is full once the PDC went on with the next one
+            if (AT91C_BASE_PDC_SSC->PDC_RNCR != 0)
+                continue;
+
+            const uint8_t *p = (uint8_t *)halves[cur];
+            for (uint16_t i = 0; i < 2 * HF_SNIFF_DMA_HALF; i++) {
+
+                // keep the peak, short modulation pauses survive the decimation
+                peak = MAX(peak, p[i]);
+                if (++dec_counter < decimation)
+                    continue;
+
+                frame->data[frame->len++] = peak;
+                dec_counter = 0;
+                peak = 0;
+                saved++;
+
+                if (frame->len == HF_SNIFF_STREAM_SAMPLES) {
+                    LED_B_ON();
+                    reply_ng(CMD_HF_SNIFF_STREAM, PM3_SUCCESS, (uint8_t *)frame, sizeof(hf_sniff_stream_frame_t));
+                    LED_B_OFF();
+                    frame->seq++;
+                    frame->len = 0;
+                }
+
+                if (req->samples && saved >= req->samples) {
+                    done = true;
+                    break;
+                }
+            }
+
+            // the other half filled up too and the DMA stopped, samples were lost
+            if (AT91C_BASE_PDC_SSC->PDC_RCR == 0) {
+                status = PM3_EOVFLOW;
+                break;
+            }
+
+            AT91C_BASE_PDC_SSC->PDC_RNPR = (uint32_t)halves[cur];
+            AT91C_BASE_PDC_SSC->PDC_RNCR = HF_SNIFF_DMA_HALF;
+            cur ^= 1;
+        }
+
+        FpgaDisableSscDma();
+
+        if (DBGLEVEL >= DBG_DEBUG)
+            Dbprintf("HfSniffStream, trigger %u, " _YELLOW_("%u") " samples in " _YELLOW_("%u") " frames", r, saved, frame->seq + 1);
+    }
+
+    hf_sniff_stop();
+
+    frame->final = true;
+    reply_ng(CMD_HF_SNIFF_STREAM, status, (uint8_t *)frame, sizeof(hf_sniff_stream_frame_t) - HF_SNIFF_STREAM_SAMPLES + frame->len);
+    LEDsoff();
+    BigBuf_free();
+}
+
 void HfPlotDownload(void) {
 
     tosend_t *ts = get_tosend();
@@ -13,7 +13,9 @@
 #define __HFSNOOP_H
 
 #include "proxmark3_arm.h"
+#include "pm3_cmd.h"
 
 int HfSniff(uint32_t samplesToSkip, uint32_t triggersToSkip, uint16_t *len);
+void HfSniffStream(hf_sniff_stream_req_t *req);
 void HfPlotDownload(void);
 #endif
@@ -285,7 +285,7 @@ static void hitag2_handle_reader_command(uint8_t *rx, const size_t rxlen, uint8_
         // Received RWD authentication challenge and respnse
         case 64: {
             // Store the authentication attempt
-            if (auth_table_len < (AUTH_TABLE_LENGTH - 8)) {
+            if (auth_table && auth_table_len < (AUTH_TABLE_LENGTH - 8)) {
                 memcpy(auth_table + auth_table_len, rx, 8);
                 auth_table_len += 8;
             }
@@ -1057,8 +1057,8 @@ void SniffHitag2(void) {
     DbpString("Hitag2 sniffing finish. Use `lf hitag list` for annotations");
 }
 
-// Hitag2 simulation
-void SimulateHitag2(bool tag_mem_supplied, uint8_t *data) {
+// Hitag2 simulation, with a nonce_uid every reader authentication is sent to the client
+static void hitag2_simulate(bool tag_mem_supplied, uint8_t *data, const uint8_t *nonce_uid) {
 
     BigBuf_free();
     BigBuf_Clear_ext(false);
@@ -1076,9 +1076,13 @@ void SimulateHitag2(bool tag_mem_supplied, uint8_t *data) {
 
     auth_table_len = 0;
     auth_table_pos = 0;
+    auth_table = NULL;
 //    auth_table = BigBuf_malloc(AUTH_TABLE_LENGTH);
 //    memset(auth_table, 0x00, AUTH_TABLE_LENGTH);
 
+    lf_hitag2_nonce_t nonce_resp;
+    memset(&nonce_resp, 0, sizeof(nonce_resp));
+
     // Reset the received frame, frame count and timing info
 //    memset(rx, 0x00, sizeof(rx));
 //    memset(tx, 0x00, sizeof(tx));
@@ -1094,6 +1098,10 @@ void SimulateHitag2(bool tag_mem_supplied, uint8_t *data) {
         memcpy((uint8_t *)tag.sectors, data, 48);
     }
 
+    if (nonce_uid) {
+        memcpy(tag.sectors[0], nonce_uid, 4);
+    }
+
     // printing
     uint32_t block = 0;
     for (size_t i = 0; i < 12; i++) {
@@ -1118,6 +1126,11 @@ void SimulateHitag2(bool tag_mem_supplied, uint8_t *data) {
     uint32_t signal_size = 10000;
     while (BUTTON_PRESS() == false) {
 
+        // the client ends a nonce collection with CMD_BREAK_LOOP
+        if (nonce_uid && data_available()) {
+            break;
+        }
+
         // use malloc
         initSampleBufferEx(&signal_size, true);
 
@@ -1250,6 +1263,11 @@ void SimulateHitag2(bool tag_mem_supplied, uint8_t *data) {
 
             LogTrace(rx, nbytes(rxlen), response, response, NULL, true);
 
+            // the handler decrypts rx in place, keep the authentication as received
+            if (nonce_uid && rxlen == 64) {
+                memcpy(nonce_resp.nrar, rx, 8);
+            }
+
             // Process the incoming frame (rx) and prepare the outgoing frame (tx)
             hitag2_handle_reader_command(rx, rxlen, tx, &txlen);
 
@@ -1270,6 +1288,12 @@ void SimulateHitag2(bool tag_mem_supplied, uint8_t *data) {
                 LogTrace(tx, nbytes(txlen), 0, 0, NULL, false);
             }
 
+            // The reader waits for the tag answer, which we never have without the key
+            if (nonce_uid && rxlen == 64) {
+                nonce_resp.count++;
+                reply_ng(CMD_LF_HITAG2_NONCES, PM3_SUCCESS, (uint8_t *)&nonce_resp, sizeof(nonce_resp));
+            }
+
             // Reset the received frame and response timing info
             memset(rx, 0x00, sizeof(rx));
             response = 0;
@@ -1285,9 +1309,24 @@ void SimulateHitag2(bool tag_mem_supplied, uint8_t *data) {
 
     DbpString("Sim stopped");
 
+    if (nonce_uid) {
+        nonce_resp.final = true;
+        memset(nonce_resp.nrar, 0, sizeof(nonce_resp.nrar));
+        reply_ng(CMD_LF_HITAG2_NONCES, BUTTON_PRESS() ? PM3_EOPABORTED : PM3_SUCCESS, (uint8_t *)&nonce_resp, sizeof(nonce_resp));
+    }
+
 //    reply_ng(CMD_LF_HITAG_SIMULATE, (checked == -1) ? PM3_EOPABORTED : PM3_SUCCESS, (uint8_t *)tag.sectors, tag_size);
 }
 
+void SimulateHitag2(bool tag_mem_supplied, uint8_t *data) {
+    hitag2_simulate(tag_mem_supplied, data, NULL);
+}
+
+// Simulates the default tag with this uid, the reader authentications go to the client for `lf hitag crack`
+void SimulateHitag2Nonces(const uint8_t *uid) {
+    hitag2_simulate(false, NULL, uid);
+}
+
 void ReaderHitag(hitag_function htf, hitag_data *htd) {
 
     uint32_t command_start = 0, command_duration = 0;
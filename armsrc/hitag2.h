@@ -16,6 +16,7 @@
 
 void SniffHitag2(void);
 void SimulateHitag2(bool tag_mem_supplied, uint8_t *data);
+void SimulateHitag2Nonces(const uint8_t *uid);
 void ReaderHitag(hitag_function htf, hitag_data *htd);
 void WriterHitag(hitag_function htf, hitag_data *htd, int page);
 
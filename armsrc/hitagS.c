@@ -1339,12 +1339,10 @@ void ReadHitagS(hitag_function htf, hitag_data *htd) {
                                           | (pageData[6 + (i * 8)] << 1)
                                           | pageData[7 + (i * 8)]);
             }
-            if (tag.auth && tag.LKP && pageNum == 1) {
-                Dbprintf("Page[%2d]: %02X %02X %02X %02X", pageNum, pwdh0,
-                         (tag.pages[pageNum][2]) & 0xff,
-                         (tag.pages[pageNum][1]) & 0xff,
-                         tag.pages[pageNum][0] & 0xff);
-            } else {
+            // the pages go to the client at the end, printed here only when debugging
+            if (tag.auth && tag.LKP && pageNum == 1)
+                tag.pages[pageNum][3] = pwdh0;
+            if (DBGLEVEL >= DBG_EXTENDED) {
                 Dbprintf("Page[%2d]: %02X %02X %02X %02X", pageNum,
                          (tag.pages[pageNum][3]) & 0xff,
                          (tag.pages[pageNum][2]) & 0xff,
@@ -1353,25 +1351,21 @@ void ReadHitagS(hitag_function htf, hitag_data *htd) {
             }
 
             pageNum++;
-            //display key and password if possible
+            //key and password if possible
             if (pageNum == 2 && tag.auth == 1 && tag.LKP) {
                 if (htf == RHTSF_KEY) {
-                    Dbprintf("Page[ 2]: %02X %02X %02X %02X",
-                             (uint8_t)(key >> 8) & 0xff,
-                             (uint8_t) key & 0xff,
-                             pwdl1,
-                             pwdl0
-                            );
-                    Dbprintf("Page[ 3]: %02X %02X %02X %02X",
-                             (uint8_t)(key >> 40) & 0xff,
-                             (uint8_t)(key >> 32) & 0xff,
-                             (uint8_t)(key >> 24) & 0xff,
-                             (uint8_t)(key >> 16) & 0xff
-                            );
+                    tag.pages[2][3] = (key >> 8) & 0xff;
+                    tag.pages[2][2] = key & 0xff;
+                    tag.pages[2][1] = pwdl1;
+                    tag.pages[2][0] = pwdl0;
+                    tag.pages[3][3] = (key >> 40) & 0xff;
+                    tag.pages[3][2] = (key >> 32) & 0xff;
+                    tag.pages[3][1] = (key >> 24) & 0xff;
+                    tag.pages[3][0] = (key >> 16) & 0xff;
                 } else {
                     //if the authentication is done with a challenge the key and password are unknown
-                    Dbprintf("Page[ 2]: __ __ __ __");
-                    Dbprintf("Page[ 3]: __ __ __ __");
+                    memset(tag.pages[2], 0, sizeof(tag.pages[2]));
+                    memset(tag.pages[3], 0, sizeof(tag.pages[3]));
                 }
                 // since page 2+3 are not accessible when LKP == 1 and AUT == 1 fastforward to next readable page
                 pageNum = 4;
@@ -1385,6 +1379,7 @@ void ReadHitagS(hitag_function htf, hitag_data *htd) {
             tx[1] = 0x00 + ((pageNum % 16) * 16) + (crc / 16);
             tx[2] = 0x00 + (crc % 16) * 16;
             if (pageNum >= tag.max_page) {
+                bSuccessful = true;
                 bStop = !false;
             }
         }
@@ -1419,14 +1414,22 @@ void ReadHitagS(hitag_function htf, hitag_data *htd) {
     set_tracing(false);
 
     lf_finalize();
-    reply_mix(CMD_ACK, bSuccessful, 0, 0, 0, 0);
+
+    // all the pages read in the session in one reply, first byte of a page is its MSB
+    uint8_t pages[64 * 4] = {0};
+    for (i = 0; i < pageNum && i < 64; i++) {
+        for (j = 0; j < 4; j++)
+            pages[i * 4 + j] = tag.pages[i][3 - j];
+    }
+    reply_mix(CMD_ACK, bSuccessful, pageNum, 0, pages, pageNum * 4);
 }
 
 /*
  * Authenticates to the Tag with the given Key or Challenge.
- * Writes the given 32Bit data into page_
+ * Writes the given 32Bit data into page_, and the count - 1 pages of more
+ * after it in the same session
  */
-void WritePageHitagS(hitag_function htf, hitag_data *htd, int page) {
+void WritePageHitagS(hitag_function htf, hitag_data *htd, int page, int count, uint8_t *more) {
 
     StopTicks();
 
@@ -1442,6 +1445,7 @@ void WritePageHitagS(hitag_function htf, hitag_data *htd, int page) {
     bool bStop;
     unsigned char crc;
     uint8_t data[4] = {0, 0, 0, 0};
+    int written = 0;
 
     FpgaDownloadAndGo(FPGA_BITSTREAM_LF);
 
@@ -1481,7 +1485,7 @@ void WritePageHitagS(hitag_function htf, hitag_data *htd, int page) {
         }
     }
 
-    Dbprintf("Page: %d", page);
+    Dbprintf("Page: %d, %d page%s", page, count, (count == 1) ? "" : "s");
     Dbprintf("DATA: %02X %02X %02X %02X", data[0], data[1], data[2], data[3]);
 
     tag.pstate = HT_READY;
@@ -1567,6 +1571,20 @@ void WritePageHitagS(hitag_function htf, hitag_data *htd, int page) {
             if (hitagS_handle_tag_auth(htf, key, NrAr, rx, rxlen, tx, &txlen) == -1)
                 bStop = !false;
         }
+        if (tag.pstate == HT_SELECTED && tag.tstate == HT_WRITING_PAGE_DATA
+                && rxlen == 6 && rx[0] == 0xf4) {
+            //received ACK, the session stays for the next page
+            written++;
+            if (written == count) {
+                Dbprintf("Successful!");
+                bSuccessful = true;
+                bStop = !false;
+            } else {
+                page++;
+                memcpy(data, more + (written - 1) * 4, 4);
+                tag.tstate = HT_NO_OP;
+            }
+        }
         if (tag.pstate == HT_SELECTED && tag.tstate == HT_NO_OP && rxlen > 0) {
             //check if the given page exists
             if (page > tag.max_page) {
@@ -1597,11 +1615,6 @@ void WritePageHitagS(hitag_function htf, hitag_data *htd, int page) {
             tx[2] = data[1];
             tx[3] = data[0];
             tx[4] = crc;
-        } else if (tag.pstate == HT_SELECTED && tag.tstate == HT_WRITING_PAGE_DATA
-                   && rxlen == 6 && rx[0] == 0xf4) {
-            //received ACK
-            Dbprintf("Successful!");
-            bStop = !false;
         }
 
         // Send and store the reader command
@@ -1636,7 +1649,7 @@ void WritePageHitagS(hitag_function htf, hitag_data *htd, int page) {
 
     lf_finalize();
 
-    reply_mix(CMD_ACK, bSuccessful, 0, 0, 0, 0);
+    reply_mix(CMD_ACK, bSuccessful, written, 0, 0, 0);
 }
 
 /*
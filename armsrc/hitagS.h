@@ -18,7 +18,7 @@
 
 void SimulateHitagSTag(bool tag_mem_supplied, uint8_t *data);
 void ReadHitagS(hitag_function htf, hitag_data *htd);
-void WritePageHitagS(hitag_function htf, hitag_data *htd, int page);
+void WritePageHitagS(hitag_function htf, hitag_data *htd, int page, int count, uint8_t *more);
 void check_challenges(bool file_given, uint8_t *data);
 
 #endif
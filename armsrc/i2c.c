@@ -17,6 +17,10 @@
 #include "dbprint.h"
 #include "util.h"
 #include "string.h"
+#include "protocols.h"
+#include "iso14443a.h"
+#include "fpgaloader.h"
+#include "commonutil.h"
 
 #define GPIO_RST AT91C_PIO_PA1
 #define GPIO_SCL AT91C_PIO_PA5
@@ -43,9 +47,18 @@ static void __attribute__((optimize("O0"))) I2CSpinDelayClk(uint16_t delay) {
     for (c = delay * 2; c; c--) {};
 }
 
-#define I2C_DELAY_1CLK    I2CSpinDelayClk(1)
-#define I2C_DELAY_2CLK    I2CSpinDelayClk(2)
-#define I2C_DELAY_XCLK(x) I2CSpinDelayClk((x))
+// Bit timing of the bus. 2 loops per unit is the standard profile above, 1 halves every
+// SCL / SDA setup delay (fast profile, ~400kbps). Timeouts and the long delays stay on
+// I2CSpinDelayClk, the module keeps its clock stretching time whatever the profile
+static uint8_t i2c_bit_loops = 2;
+
+static void __attribute__((optimize("O0"))) I2CSpinDelayBit(uint16_t delay) {
+    for (c = delay * i2c_bit_loops; c; c--) {};
+}
+
+#define I2C_DELAY_1CLK    I2CSpinDelayBit(1)
+#define I2C_DELAY_2CLK    I2CSpinDelayBit(2)
+#define I2C_DELAY_XCLK(x) I2CSpinDelayBit((x))
 
 #define I2C_DELAY_100us   I2CSpinDelayClk( 100 / 3)
 #define I2C_DELAY_600us   I2CSpinDelayClk( 600 / 3)
@@ -55,6 +68,10 @@ static void __attribute__((optimize("O0"))) I2CSpinDelayClk(uint16_t delay) {
 
 #define  ISO7618_MAX_FRAME 255
 
+// called every few ms while the module talks to the card, the relay keeps its reader waiting with it
+static void (*i2c_wait_hook)(void) = NULL;
+#define I2C_WAIT_HOOK_SLICE 1000 // 1000 * 3.07us = 3ms
+
 // try i2c bus recovery at 100kHz = 5us high, 5us low
 void I2C_recovery(void) {
 
@@ -144,6 +161,7 @@ void I2C_Reset_EnterMainProgram(void) {
 // Reset the SIM_Adapter, then enter the bootloader program
 // Reserve for firmware update.
 void I2C_Reset_EnterBootloader(void) {
+    i2c_bit_loops = 2;
     StartTicks();
     I2C_init();
     I2C_SetResetStatus(0, 1, 1);
@@ -158,7 +176,7 @@ static bool WaitSCL_H_delay(uint32_t delay) {
         if (SCL_read) {
             return true;
         }
-        I2C_DELAY_1CLK;
+        I2CSpinDelayClk(1);
     }
     return false;
 }
@@ -174,7 +192,7 @@ static bool WaitSCL_L_delay(uint32_t delay) {
         if (!SCL_read) {
             return true;
         }
-        I2C_DELAY_1CLK;
+        I2CSpinDelayClk(1);
     }
     return false;
 }
@@ -193,6 +211,9 @@ static bool WaitSCL_L_timeout(void) {
         if (!SCL_read)
             return true;
 
+        if (i2c_wait_hook && (delay & 0x1F) == 0)
+            i2c_wait_hook();
+
         I2C_DELAY_100us;
     }
     return (delay == 0);
@@ -225,7 +246,14 @@ static bool I2C_WaitForSim(void) {
     // 8051 speaks with smart card.
     // 1000*50*3.07 = 153.5ms
     // 1byte transfer == 1ms  with max frame being 256bytes
-    if (!WaitSCL_H_delay(30 * 1000 * 50))
+    uint32_t delay = 30 * 1000 * 50;
+    while (i2c_wait_hook && delay > I2C_WAIT_HOOK_SLICE) {
+        if (WaitSCL_H_delay(I2C_WAIT_HOOK_SLICE))
+            return true;
+        delay -= I2C_WAIT_HOOK_SLICE;
+        i2c_wait_hook();
+    }
+    if (!WaitSCL_H_delay(delay))
         return false;
 
     return true;
@@ -630,6 +658,26 @@ int I2C_get_version(uint8_t *maj, uint8_t *min) {
     return PM3_EDEVNOTSUPP;
 }
 
+// Switches the bus to the fast profile when the module keeps up with it. The module firmware
+// has no speed command, the known answer of GETVERSION at both speeds decides
+bool I2C_SetFastProfile(bool enable) {
+    i2c_bit_loops = 2;
+    if (enable == false)
+        return true;
+
+    uint8_t ref[4] = {0}, resp[4] = {0};
+    if (I2C_BufferRead(ref, sizeof(ref), I2C_DEVICE_CMD_GETVERSION, I2C_DEVICE_ADDRESS_MAIN) <= 0)
+        return false;
+
+    i2c_bit_loops = 1;
+    if (I2C_BufferRead(resp, sizeof(resp), I2C_DEVICE_CMD_GETVERSION, I2C_DEVICE_ADDRESS_MAIN) <= 0 || memcmp(ref, resp, sizeof(ref))) {
+        i2c_bit_loops = 2;
+        if (DBGLEVEL > 3) DbpString("I2C fast profile refused, standard timing");
+        return false;
+    }
+    return true;
+}
+
 // Will read response from smart card module,  retries 3 times to get the data.
 bool sc_rx_bytes(uint8_t *dest, uint8_t *destlen) {
 
@@ -723,6 +771,48 @@ void SmartCardAtr(void) {
     LEDsoff();
 }
 
+// Sends one APDU, reads the answer of the module into resp (ISO7618_MAX_FRAME bytes). 0 on failure
+static uint8_t sc_exchange(uint8_t *apdu, uint8_t apdulen, bool t0, uint8_t *resp) {
+
+    LogTrace(apdu, apdulen, 0, 0, NULL, true);
+
+    bool res = I2C_BufferWrite(apdu, apdulen, (t0 ? I2C_DEVICE_CMD_SEND_T0 : I2C_DEVICE_CMD_SEND), I2C_DEVICE_ADDRESS_MAIN);
+    if (!res && DBGLEVEL > 3) DbpString(I2C_ERROR);
+
+    // read bytes from module
+    uint8_t len = ISO7618_MAX_FRAME;
+    if (sc_rx_bytes(resp, &len) == false)
+        return 0;
+
+    LogTrace(resp, len, 0, 0, NULL, false);
+    return len;
+}
+
+// sc_exchange plus what the client does per APDU otherwise: 6C xx resend with Le = xx,
+// 61 xx / 9F xx GET RESPONSE, the procedure byte of the module dropped
+static uint8_t sc_exchange_apdu(uint8_t *apdu, uint8_t apdulen, bool t0, uint8_t *resp) {
+
+    uint8_t len = sc_exchange(apdu, apdulen, t0, resp);
+
+    if (len == 2 && resp[0] == 0x6C && apdulen > 4) {
+        uint8_t retry[5];
+        memcpy(retry, apdu, 4);
+        retry[4] = resp[1];
+        len = sc_exchange(retry, sizeof(retry), true, resp);
+    }
+
+    if (len >= 2 && (resp[len - 2] == 0x61 || resp[len - 2] == 0x9F)) {
+        uint8_t le = resp[len - 1];
+        uint8_t getresp[] = {0x00, ISO7816_GET_RESPONSE, 0x00, 0x00, le};
+        len = sc_exchange(getresp, sizeof(getresp), false, resp);
+        if (len == le + 3 && resp[0] == ISO7816_GET_RESPONSE) {
+            len--;
+            memmove(resp, resp + 1, len);
+        }
+    }
+    return len;
+}
+
 void SmartCardRaw(uint64_t arg0, uint64_t arg1, uint8_t *data) {
 
     LED_D_ON();
@@ -753,23 +843,9 @@ void SmartCardRaw(uint64_t arg0, uint64_t arg1, uint8_t *data) {
     }
 
     if ((flags & SC_RAW) || (flags & SC_RAW_T0)) {
-
-        LogTrace(data, arg1, 0, 0, NULL, true);
-
-        // Send raw bytes
         // asBytes = A0 A4 00 00 02
         // arg1 = len 5
-        bool res = I2C_BufferWrite(data, arg1, ((flags & SC_RAW_T0) ? I2C_DEVICE_CMD_SEND_T0 : I2C_DEVICE_CMD_SEND), I2C_DEVICE_ADDRESS_MAIN);
-        if (!res && DBGLEVEL > 3) DbpString(I2C_ERROR);
-
-        // read bytes from module
-        len = ISO7618_MAX_FRAME;
-        res = sc_rx_bytes(resp, &len);
-        if (res) {
-            LogTrace(resp, len, 0, 0, NULL, false);
-        } else {
-            len = 0;
-        }
+        len = sc_exchange(data, arg1, (flags & SC_RAW_T0), resp);
     }
 OUT:
     reply_mix(CMD_ACK, len, 0, 0, resp, len);
@@ -778,6 +854,385 @@ OUT:
     LEDsoff();
 }
 
+// A queue of APDUs in one host command. In: flags, count, then count times [len][APDU].
+// Out: [len][response] per APDU, len 0 when the exchange failed. Several replies when the
+// answers overflow one frame, PM3_EPARTIAL on all but the last
+void SmartCardRawBulk(uint8_t *data, uint16_t datalen) {
+
+    struct p {
+        uint8_t flags;
+        uint8_t count;
+        uint8_t apdus[];
+    } PACKED;
+    struct p *payload = (struct p *)data;
+
+    if (datalen < sizeof(struct p)) {
+        reply_ng(CMD_SMART_RAW_BULK, PM3_EINVARG, NULL, 0);
+        return;
+    }
+
+    // the whole queue must be in the frame before the first APDU goes out
+    uint16_t pos = 0, avail = datalen - sizeof(struct p);
+    for (uint8_t i = 0; i < payload->count; i++) {
+        if (pos >= avail || pos + 1 + payload->apdus[pos] > avail || payload->apdus[pos] == 0) {
+            reply_ng(CMD_SMART_RAW_BULK, PM3_EINVARG, NULL, 0);
+            return;
+        }
+        pos += 1 + payload->apdus[pos];
+    }
+
+    LED_D_ON();
+
+    smartcard_command_t flags = payload->flags;
+    uint8_t *resp = BigBuf_malloc(ISO7618_MAX_FRAME);
+    uint8_t *out = BigBuf_malloc(PM3_CMD_DATA_SIZE);
+    uint16_t outlen = 0;
+    int status = PM3_SUCCESS;
+
+    if ((flags & SC_CLEARLOG) == SC_CLEARLOG)
+        clear_trace();
+
+    set_tracing((flags & SC_LOG) == SC_LOG);
+
+    if ((flags & SC_CONNECT)) {
+        I2C_Reset_EnterMainProgram();
+
+        if ((flags & SC_SELECT)) {
+            smart_card_atr_t card;
+            if (GetATR(&card, true) == false) {
+                status = PM3_ECARDEXCHANGE;
+                goto out;
+            }
+        }
+    }
+
+    if ((flags & SC_FAST))
+        I2C_SetFastProfile(true);
+
+    pos = 0;
+    for (uint8_t i = 0; i < payload->count; i++) {
+
+        if (BUTTON_PRESS() || data_available()) {
+            status = PM3_EOPABORTED;
+            break;
+        }
+
+        uint8_t len = sc_exchange_apdu(payload->apdus + pos + 1, payload->apdus[pos], (flags & SC_RAW_T0), resp);
+        pos += 1 + payload->apdus[pos];
+
+        if (outlen + 1 + len > PM3_CMD_DATA_SIZE) {
+            reply_ng(CMD_SMART_RAW_BULK, PM3_EPARTIAL, out, outlen);
+            outlen = 0;
+        }
+        out[outlen++] = len;
+        memcpy(out + outlen, resp, len);
+        outlen += len;
+    }
+
+    I2C_SetFastProfile(false);
+
+out:
+    reply_ng(CMD_SMART_RAW_BULK, status, out, outlen);
+    BigBuf_free();
+    set_tracing(false);
+    LEDsoff();
+}
+
+// On device relay of a 14a reader to the card in the slot. The activation of the reader gets the
+// precompiled answers of a 14a-4 tag like hf_msdsal, the I-blocks go to the card. Our ATS has FWI 6,
+// FWT 19.3ms, shorter than writing a long APDU to the module. The reader is asked for a WTX before
+// the APDU goes out and again every SC_RELAY_KEEPALIVE_MS while the module waits for the card
+#define SC_RELAY_WTXM           30      // 30 * 19.3ms = 580ms
+#define SC_RELAY_KEEPALIVE_MS   250
+#define SC_RELAY_NO_CID         0xFF
+
+#define ATQA      0
+#define UIDC1     1
+#define UIDC2     2
+#define SAKC1     3
+#define SAKC2     4
+#define RATS      5
+#define PPS       8
+
+static const uint16_t sc_relay_fsd[] = {16, 24, 32, 40, 48, 64, 96, 128, 256};
+
+typedef struct {
+    uint8_t *frame;         // from the reader
+    uint8_t *par;
+    uint8_t *last;          // our last block, sent again on R(NAK)
+    uint16_t last_len;
+    uint16_t fsd;           // frame size of the reader, from RATS
+    uint8_t cid;            // of the last block of the reader
+    uint8_t block;          // our block number
+    uint32_t wtx_tick;      // the reader granted the last WTX
+    bool lost;              // the reader or its field went away during a WTX
+    sc_relay_resp_t stats;
+} sc_relay_t;
+
+static sc_relay_t *sc_relay = NULL;
+
+// a block with our prologue, PCB and the CID when the reader uses one
+static void sc_relay_send(sc_relay_t *r, uint8_t pcb, const uint8_t *inf, uint16_t len) {
+    uint16_t n = 0;
+    r->last[n++] = pcb | ((r->cid != SC_RELAY_NO_CID) ? 0x08 : 0x00);
+    if (r->cid != SC_RELAY_NO_CID)
+        r->last[n++] = r->cid;
+    memcpy(r->last + n, inf, len);
+    n += len;
+    AddCrc14A(r->last, n);
+    r->last_len = n + 2;
+    EmSendCmd(r->last, r->last_len);
+}
+
+// a block of the reader with a good CRC, its PCB
+static bool sc_relay_get(sc_relay_t *r, uint16_t *len) {
+    for (;;) {
+        if (EmGetCmd(r->frame, len, r->par) != 0)
+            return false;
+        if (*len >= 3 && CheckCrc14A(r->frame, *len))
+            return true;
+    }
+}
+
+static bool sc_relay_wtx(sc_relay_t *r) {
+    uint8_t wtxm = SC_RELAY_WTXM;
+    sc_relay_send(r, 0xF2, &wtxm, 1);
+    for (;;) {
+        uint16_t len = 0;
+        if (sc_relay_get(r, &len) == false) {
+            r->lost = true;
+            return false;
+        }
+        uint8_t pcb = r->frame[0];
+        // S(WTX) response
+        if ((pcb & 0xF7) == 0xF2) {
+            r->wtx_tick = GetTickCount();
+            r->stats.wtx++;
+            return true;
+        }
+        // R(NAK), it missed the request
+        if ((pcb & 0xF6) == 0xB2) {
+            EmSendCmd(r->last, r->last_len);
+            continue;
+        }
+        r->lost = true;
+        return false;
+    }
+}
+
+static void sc_relay_keepalive(void) {
+    if (sc_relay && sc_relay->lost == false && GetTickCountDelta(sc_relay->wtx_tick) >= SC_RELAY_KEEPALIVE_MS)
+        sc_relay_wtx(sc_relay);
+}
+
+// the answer of the card, chained when longer than the frame size of the reader
+static bool sc_relay_answer(sc_relay_t *r, const uint8_t *data, uint16_t len) {
+    uint16_t max = r->fsd - 3 - ((r->cid != SC_RELAY_NO_CID) ? 1 : 0);
+    uint16_t pos = 0;
+    for (;;) {
+        uint16_t n = MIN(len - pos, max);
+        bool more = (pos + n < len);
+        sc_relay_send(r, 0x02 | (more ? 0x10 : 0x00) | r->block, data + pos, n);
+        if (more == false)
+            return true;
+
+        // R(ACK) of the other block number continues, the same number gets the block again
+        for (;;) {
+            uint16_t flen = 0;
+            if (sc_relay_get(r, &flen) == false)
+                return false;
+            uint8_t pcb = r->frame[0];
+            if ((pcb & 0xE6) != 0xA2)
+                return false;
+            if ((pcb & 0x01) == r->block) {
+                EmSendCmd(r->last, r->last_len);
+            } else if (pcb & 0x10) {
+                uint8_t ack = 0xA2 | r->block;
+                sc_relay_send(r, ack, NULL, 0);
+            } else {
+                break;
+            }
+        }
+        r->block ^= 1;
+        pos += n;
+    }
+}
+
+void SmartCardRelay14a(sc_relay_req_t *req) {
+
+    BigBuf_free_keep_EM();
+
+    sc_relay_t r = { .fsd = 32, .cid = SC_RELAY_NO_CID, .block = 1 };
+    r.frame = BigBuf_malloc(MAX_FRAME_SIZE);
+    r.par = BigBuf_malloc(MAX_PARITY_SIZE);
+    r.last = BigBuf_malloc(MAX_FRAME_SIZE);
+    uint8_t *apdu = BigBuf_malloc(ISO7618_MAX_FRAME);
+    uint8_t *resp = BigBuf_malloc(ISO7618_MAX_FRAME);
+    bool t0 = (req->flags & SC_RAW_T0);
+
+    clear_trace();
+    set_tracing(true);
+    LED_D_ON();
+
+    I2C_Reset_EnterMainProgram();
+    smart_card_atr_t card;
+    if (GetATR(&card, false) == false) {
+        reply_ng(CMD_SMART_RELAY, PM3_ECARDEXCHANGE, NULL, 0);
+        goto out;
+    }
+
+    // ISO/IEC 14443-4 tag (JCOP) answers
+    tag_response_info_t *responses;
+    uint32_t cuid = 0;
+    uint32_t counters[3] = { 0x00, 0x00, 0x00 };
+    uint8_t tearings[3] = { 0xbd, 0xbd, 0xbd };
+    uint8_t pages = 0;
+    uint8_t uid[7] = {0};
+    memcpy(uid, req->uid, MIN(req->uidlen, sizeof(uid)));
+    int flags = (req->uidlen == 7) ? FLAG_7B_UID_IN_DATA : FLAG_4B_UID_IN_DATA;
+    if (SimulateIso14443aInit(4, flags, uid, &responses, &cuid, counters, tearings, &pages) == false) {
+        reply_ng(CMD_SMART_RELAY, PM3_EINIT, NULL, 0);
+        goto out;
+    }
+
+    iso14443a_setup(FPGA_HF_ISO14443A_TAGSIM_LISTEN);
+
+    sc_relay = &r;
+    i2c_wait_hook = sc_relay_keepalive;
+
+    int status = PM3_SUCCESS;
+    bool active = false;
+    bool overflow = false;
+    uint16_t apdulen = 0;
+
+    for (;;) {
+        WDT_HIT();
+
+        uint16_t len = 0;
+        int res = EmGetCmd(r.frame, &len, r.par);
+        if (res == 1) {
+            status = PM3_EOPABORTED;
+            break;
+        }
+        // no field, back to idle
+        if (res == 2) {
+            active = false;
+            continue;
+        }
+
+        uint8_t *cmd = r.frame;
+        tag_response_info_t *p_response = NULL;
+
+        if (len == 1 && (cmd[0] == ISO14443A_CMD_REQA || cmd[0] == ISO14443A_CMD_WUPA)) {
+            active = false;
+            p_response = &responses[ATQA];
+        } else if (len == 2 && cmd[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT && cmd[1] == 0x20) {
+            p_response = &responses[UIDC1];
+        } else if (len == 9 && cmd[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT && cmd[1] == 0x70) {
+            p_response = &responses[SAKC1];
+        } else if (len == 2 && cmd[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT_2 && cmd[1] == 0x20) {
+            p_response = &responses[UIDC2];
+        } else if (len == 9 && cmd[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT_2 && cmd[1] == 0x70) {
+            p_response = &responses[SAKC2];
+        } else if (len == 4 && cmd[0] == ISO14443A_CMD_HALT) {
+            active = false;
+        } else if (len == 4 && cmd[0] == ISO14443A_CMD_RATS) {
+            r.fsd = sc_relay_fsd[MIN(cmd[1] >> 4, ARRAYLEN(sc_relay_fsd) - 1)];
+            r.block = 1;
+            r.cid = SC_RELAY_NO_CID;
+            apdulen = 0;
+            overflow = false;
+            active = true;
+            p_response = &responses[RATS];
+        } else if (active == false || len < 3 || CheckCrc14A(cmd, len) == false) {
+            continue;
+        } else if ((cmd[0] & 0xF0) == 0xD0) {
+            p_response = &responses[PPS];
+        } else {
+            uint8_t pcb = cmd[0];
+            uint8_t hdr = 1;
+            r.cid = SC_RELAY_NO_CID;
+            if (pcb & 0x08)
+                r.cid = cmd[hdr++];
+
+            if ((pcb & 0xE2) == 0x02) {
+                // I-block, NAD is not used
+                if (pcb & 0x04)
+                    hdr++;
+                uint16_t inflen = (len > hdr + 2) ? len - hdr - 2 : 0;
+                r.block = pcb & 0x01;
+                if (apdulen + inflen > ISO7618_MAX_FRAME) {
+                    overflow = true;
+                } else {
+                    memcpy(apdu + apdulen, cmd + hdr, inflen);
+                    apdulen += inflen;
+                }
+
+                // chained, the rest comes with the next blocks
+                if (pcb & 0x10) {
+                    sc_relay_send(&r, 0xA2 | r.block, NULL, 0);
+                    continue;
+                }
+
+                uint8_t rlen = 0;
+                if (overflow || apdulen < 4) {
+                    // wrong length
+                    resp[0] = 0x67;
+                    resp[1] = 0x00;
+                    rlen = 2;
+                } else {
+                    uint32_t start = GetTickCount();
+                    r.lost = false;
+                    if (sc_relay_wtx(&r))
+                        rlen = sc_exchange_apdu(apdu, apdulen, t0, resp);
+                    uint32_t ms = GetTickCountDelta(start);
+                    r.stats.apdus++;
+                    if (ms > r.stats.max_ms)
+                        r.stats.max_ms = ms;
+                    // no answer of the card
+                    if (rlen < 2) {
+                        resp[0] = 0x6F;
+                        resp[1] = 0x00;
+                        rlen = 2;
+                    }
+                }
+                apdulen = 0;
+                overflow = false;
+
+                if (r.lost) {
+                    active = false;
+                    continue;
+                }
+                if (sc_relay_answer(&r, resp, rlen) == false)
+                    active = false;
+            } else if ((pcb & 0xE6) == 0xA2) {
+                // R-block, ours got lost
+                if ((pcb & 0x01) == r.block)
+                    EmSendCmd(r.last, r.last_len);
+                else if (pcb & 0x10)
+                    sc_relay_send(&r, 0xA2 | r.block, NULL, 0);
+            } else if ((pcb & 0xF7) == 0xC2) {
+                // S(DESELECT)
+                sc_relay_send(&r, 0xC2, NULL, 0);
+                active = false;
+            }
+        }
+
+        if (p_response != NULL)
+            EmSendPrecompiledCmd(p_response);
+    }
+
+    reply_ng(CMD_SMART_RELAY, status, (uint8_t *)&r.stats, sizeof(r.stats));
+
+out:
+    i2c_wait_hook = NULL;
+    sc_relay = NULL;
+    switch_off();
+    set_tracing(false);
+    BigBuf_free_keep_EM();
+    LEDsoff();
+}
+
 void SmartCardUpgrade(uint64_t arg0) {
 
     LED_C_ON();
@@ -3,6 +3,7 @@
 
 #include "common.h"
 #include "mifare.h"
+#include "pm3_cmd.h"
 
 #define I2C_DEVICE_ADDRESS_BOOT     0xB0
 #define I2C_DEVICE_ADDRESS_MAIN     0xC0
@@ -33,6 +34,9 @@ int16_t I2C_BufferRead(uint8_t *data, uint8_t len, uint8_t device_cmd, uint8_t d
 int16_t I2C_ReadFW(uint8_t *data, uint8_t len, uint8_t msb, uint8_t lsb, uint8_t device_address);
 bool I2C_WriteFW(uint8_t *data, uint8_t len, uint8_t msb, uint8_t lsb, uint8_t device_address);
 
+// fast bit timing, checked against the module. Standard timing when it doesn't keep up or enable is false
+bool I2C_SetFastProfile(bool enable);
+
 bool sc_rx_bytes(uint8_t *dest, uint8_t *destlen);
 //
 bool GetATR(smart_card_atr_t *card_ptr, bool verbose);
@@ -40,6 +44,8 @@ bool GetATR(smart_card_atr_t *card_ptr, bool verbose);
 // generice functions
 void SmartCardAtr(void);
 void SmartCardRaw(uint64_t arg0, uint64_t arg1, uint8_t *data);
+void SmartCardRawBulk(uint8_t *data, uint16_t datalen);
+void SmartCardRelay14a(sc_relay_req_t *req);
 void SmartCardUpgrade(uint64_t arg0);
 void SmartCardSetBaud(uint64_t arg0);
 void SmartCardSetClock(uint64_t arg0);
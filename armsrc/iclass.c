@@ -88,7 +88,7 @@ static uint8_t get_pagemap(const picopass_hdr *hdr) {
 // Both sides of communication!
 //=============================================================================
 void SniffIClass(uint8_t jam_search_len, uint8_t *jam_search_string) {
-    SniffIso15693(jam_search_len, jam_search_string);
+    SniffIso15693(jam_search_len, jam_search_string, false);
 }
 
 static void rotateCSN(uint8_t *original_csn, uint8_t *rotated_csn) {
@@ -105,6 +105,47 @@ static void CodeIClassTagSOF(void) {
     ts->max++;
 }
 
+// READ answers of the first blocks, coded once so they go out right after the reader EOF.
+// An entry is coded again on its first read after a write to the block.
+#define ICLASS_SIM_CACHE_BLOCKS    32
+typedef struct {
+    uint8_t data[10];          // block + CRC, for the trace
+    uint8_t resp[22];          // SOF + 10 * 2 + EOF
+    uint8_t resp_len;
+} iclass_sim_block_t;
+
+typedef struct {
+    iclass_sim_block_t blocks[ICLASS_SIM_CACHE_BLOCKS];
+    uint32_t valid;
+} iclass_sim_cache_t;
+
+static iclass_sim_block_t *iclass_sim_cache_get(iclass_sim_cache_t *cache, const uint8_t *mem, uint8_t block) {
+    iclass_sim_block_t *b = &cache->blocks[block];
+    if ((cache->valid & (1u << block)) == 0) {
+        memcpy(b->data, mem + (block * 8), 8);
+        AddCrc(b->data, 8);
+        CodeIso15693AsTag(b->data, sizeof(b->data));
+        tosend_t *ts = get_tosend();
+        memcpy(b->resp, ts->buf, ts->max);
+        b->resp_len = ts->max;
+        cache->valid |= (1u << block);
+    }
+    return b;
+}
+
+static void iclass_sim_cache_fill(iclass_sim_cache_t *cache, const uint8_t *mem) {
+    cache->valid = 0;
+    for (uint8_t i = 0; i < ICLASS_SIM_CACHE_BLOCKS; i++) {
+        iclass_sim_cache_get(cache, mem, i);
+    }
+}
+
+static void iclass_sim_cache_invalidate(iclass_sim_cache_t *cache, uint16_t block) {
+    if (block < ICLASS_SIM_CACHE_BLOCKS) {
+        cache->valid &= ~(1u << block);
+    }
+}
+
 /*
  * SOF comprises 3 parts;
  * * An unmodulated time of 56.64 us
@@ -157,6 +198,34 @@ void SimulateIClass(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *datain
     iclass_simulate(arg0, arg1, arg2, datain, NULL, NULL);
 }
 
+// sim 2 / 4 pushing every MAC to the client as soon as it is captured
+static bool sim_stream = false;
+
+void SimulateIClassStream(uint32_t arg0, uint32_t arg1, uint8_t *datain) {
+    sim_stream = true;
+    iclass_simulate(arg0, arg1, true, datain, NULL, NULL);
+    sim_stream = false;
+}
+
+static void iclass_sim_push_mac(uint8_t index, uint8_t keyroll, uint8_t *csn, uint8_t *cc_nr_mac) {
+    if (sim_stream == false)
+        return;
+
+    iclass_sim_stream_frame_t frame = { .index = index, .keyroll = keyroll, .final = false, .count = 0 };
+    memcpy(frame.csn, csn, sizeof(frame.csn));
+    memcpy(frame.cc_nr_mac, cc_nr_mac, sizeof(frame.cc_nr_mac));
+    reply_ng(CMD_HF_ICLASS_SIMULATE_STREAM, PM3_SUCCESS, (uint8_t *)&frame, sizeof(frame));
+}
+
+static void iclass_sim_reply_macs(uint8_t count, uint8_t *macs, uint16_t len) {
+    if (sim_stream) {
+        iclass_sim_stream_frame_t frame = { .final = true, .count = count };
+        reply_ng(CMD_HF_ICLASS_SIMULATE_STREAM, PM3_SUCCESS, (uint8_t *)&frame, sizeof(frame));
+        return;
+    }
+    reply_old(CMD_ACK, CMD_HF_ICLASS_SIMULATE, count, 0, macs, len);
+}
+
 void iclass_simulate(uint8_t sim_type, uint8_t num_csns, bool send_reply, uint8_t *datain, uint8_t *dataout, uint16_t *dataoutlen) {
 
     LEDsoff();
@@ -203,15 +272,16 @@ void iclass_simulate(uint8_t sim_type, uint8_t num_csns, bool send_reply, uint8_
 
                 // Button pressed
                 if (send_reply)
-                    reply_old(CMD_ACK, CMD_HF_ICLASS_SIMULATE, i, 0, mac_responses, i * EPURSE_MAC_SIZE);
+                    iclass_sim_reply_macs(i, mac_responses, i * EPURSE_MAC_SIZE);
                 goto out;
             }
+            iclass_sim_push_mac(i, 0, emulator, mac_responses + i * EPURSE_MAC_SIZE);
         }
         if (dataoutlen)
             *dataoutlen = i * EPURSE_MAC_SIZE;
 
         if (send_reply)
-            reply_old(CMD_ACK, CMD_HF_ICLASS_SIMULATE, i, 0, mac_responses, i * EPURSE_MAC_SIZE);
+            iclass_sim_reply_macs(i, mac_responses, i * EPURSE_MAC_SIZE);
 
     } else if (sim_type == ICLASS_SIM_MODE_FULL) {
 
@@ -257,11 +327,12 @@ void iclass_simulate(uint8_t sim_type, uint8_t num_csns, bool send_reply, uint8_
                     *dataoutlen = i * EPURSE_MAC_SIZE * 2;
 
                 if (send_reply)
-                    reply_old(CMD_ACK, CMD_HF_ICLASS_SIMULATE, i * 2, 0, mac_responses, i * EPURSE_MAC_SIZE * 2);
+                    iclass_sim_reply_macs(i * 2, mac_responses, i * EPURSE_MAC_SIZE * 2);
 
                 // Button pressed
                 goto out;
             }
+            iclass_sim_push_mac(i, 0, emulator, mac_responses + i * EPURSE_MAC_SIZE);
 
             // keyroll 2
             if (do_iclass_simulation(ICLASS_SIM_MODE_EXIT_AFTER_MAC, mac_responses + (i + num_csns) * EPURSE_MAC_SIZE)) {
@@ -270,11 +341,12 @@ void iclass_simulate(uint8_t sim_type, uint8_t num_csns, bool send_reply, uint8_
                     *dataoutlen = i * EPURSE_MAC_SIZE * 2;
 
                 if (send_reply)
-                    reply_old(CMD_ACK, CMD_HF_ICLASS_SIMULATE, i * 2, 0, mac_responses, i * EPURSE_MAC_SIZE * 2);
+                    iclass_sim_reply_macs(i * 2, mac_responses, i * EPURSE_MAC_SIZE * 2);
 
                 // Button pressed
                 goto out;
             }
+            iclass_sim_push_mac(i, 1, emulator, mac_responses + (i + num_csns) * EPURSE_MAC_SIZE);
         }
 
         if (dataoutlen)
@@ -282,7 +354,7 @@ void iclass_simulate(uint8_t sim_type, uint8_t num_csns, bool send_reply, uint8_
 
         // double the amount of collected data.
         if (send_reply)
-            reply_old(CMD_ACK, CMD_HF_ICLASS_SIMULATE, i * 2, 0, mac_responses, i * EPURSE_MAC_SIZE * 2);
+            iclass_sim_reply_macs(i * 2, mac_responses, i * EPURSE_MAC_SIZE * 2);
 
     } else {
         // We may want a mode here where we hardcode the csns to use (from proxclone).
@@ -494,6 +566,12 @@ int do_iclass_simulation(int simulationMode, uint8_t *reader_mac_buf) {
     //Each bit is doubled when modulated for FPGA, and we also have SOF and EOF (2 bytes)
     uint8_t *data_response = BigBuf_malloc((34 * 2) + 3);
 
+    // READ answers of the current page
+    iclass_sim_cache_t *cache = (iclass_sim_cache_t *)BigBuf_malloc(sizeof(iclass_sim_cache_t));
+    if (simulationMode == ICLASS_SIM_MODE_FULL) {
+        iclass_sim_cache_fill(cache, emulator + (current_page * page_size));
+    }
+
     enum { IDLE, ACTIVATED, SELECTED, HALTED } chip_state = IDLE;
 
     bool button_pressed = false;
@@ -626,6 +704,12 @@ int do_iclass_simulation(int simulationMode, uint8_t *reader_mac_buf) {
                     modulated_response_size = resp_ff_len;
                     trace_data = ff_data;
                     trace_data_size = sizeof(ff_data);
+                } else if (block < ICLASS_SIM_CACHE_BLOCKS) { // precoded from emulator memory
+                    iclass_sim_block_t *b = iclass_sim_cache_get(cache, emulator + (current_page * page_size), block);
+                    trace_data = b->data;
+                    trace_data_size = sizeof(b->data);
+                    modulated_response = b->resp;
+                    modulated_response_size = b->resp_len;
                 } else { // use data from emulator memory
                     memcpy(data_generic_trace, emulator + (current_page * page_size) + (block * 8), 8);
                     AddCrc(data_generic_trace, 8);
@@ -808,6 +892,7 @@ int do_iclass_simulation(int simulationMode, uint8_t *reader_mac_buf) {
                 // update emulator memory
                 memcpy(emulator + (current_page * page_size) + (8 * block), receivedCmd + 2, 8);
             }
+            iclass_sim_cache_invalidate(cache, block);
 
             memcpy(data_generic_trace, receivedCmd + 2, 8);
             AddCrc(data_generic_trace, 8);
@@ -847,6 +932,8 @@ int do_iclass_simulation(int simulationMode, uint8_t *reader_mac_buf) {
                 personalization_mode = data_generic_trace[7] & 0x80;
                 block_wr_lock = data_generic_trace[3];
 
+                iclass_sim_cache_fill(cache, emulator + (current_page * page_size));
+
                 AddCrc(data_generic_trace, 8);
 
                 trace_data = data_generic_trace;
@@ -1018,6 +1105,10 @@ int do_iclass_simulation_nonsec(void) {
     //Each bit is doubled when modulated for FPGA, and we also have SOF and EOF (2 bytes)
     uint8_t *data_response = BigBuf_malloc((32 + 2) * 2 + 2);
 
+    // READ answers, they don't depend on the page
+    iclass_sim_cache_t *cache = (iclass_sim_cache_t *)BigBuf_malloc(sizeof(iclass_sim_cache_t));
+    iclass_sim_cache_fill(cache, emulator);
+
     enum { IDLE, ACTIVATED, SELECTED, HALTED } chip_state = IDLE;
 
     bool button_pressed = false;
@@ -1122,6 +1213,14 @@ int do_iclass_simulation_nonsec(void) {
                     goto send;
                 }
                 default : {
+                    if (block < ICLASS_SIM_CACHE_BLOCKS) {
+                        iclass_sim_block_t *b = iclass_sim_cache_get(cache, emulator, block);
+                        trace_data = b->data;
+                        trace_data_size = sizeof(b->data);
+                        modulated_response = b->resp;
+                        modulated_response_size = b->resp_len;
+                        goto send;
+                    }
                     memcpy(data_generic_trace, emulator + (block << 3), 8);
                     AddCrc(data_generic_trace, 8);
                     trace_data = data_generic_trace;
@@ -1177,6 +1276,7 @@ int do_iclass_simulation_nonsec(void) {
 
             // update emulator memory
             memcpy(emulator + (current_page * page_size) + (8 * block), receivedCmd + 2, 8);
+            iclass_sim_cache_invalidate(cache, (current_page * page_size / 8) + block);
 
             memcpy(data_generic_trace, receivedCmd + 2, 8);
             AddCrc(data_generic_trace, 8);
@@ -1617,11 +1717,17 @@ typedef struct iclass_premac {
 * - key loop only test one type of authtication key. Ie two calls needed
 *   to cover debit and credit key. (AA1/AA2)
 */
+// card left selected by the previous chunk, waiting for a check command
+static bool chk_selected = false;
+static uint32_t chk_start_time = 0;
+
 void iClass_Authentication_fast(uint64_t arg0, uint64_t arg1, uint8_t *datain) {
 
     uint8_t i = 0, isOK = 0;
-//    uint8_t lastChunk = ((arg0 >> 8) & 0xFF);
+    bool lastChunk = ((arg0 >> 8) & 0xFF);
     bool use_credit_key = ((arg0 >> 16) & 0xFF);
+    // continue with the card the previous chunk left selected
+    bool keep_selected = ((arg0 >> 24) & 0xFF);
     uint8_t keyCount = arg1 & 0xFF;
 
     uint8_t check[9] = { ICLASS_CMD_CHECK };
@@ -1638,18 +1744,23 @@ void iClass_Authentication_fast(uint64_t arg0, uint64_t arg1, uint8_t *datain) {
 
     LED_A_ON();
 
-    // fresh start
-    switch_off();
-    SpinDelay(20);
+    uint32_t start_time = 0, eof_time = 0;
 
-    Iso15693InitReader();
+    if (keep_selected && chk_selected) {
+        start_time = chk_start_time;
+    } else {
+        // fresh start
+        switch_off();
+        SpinDelay(20);
 
-    uint32_t start_time = 0, eof_time = 0;
+        Iso15693InitReader();
 
-    if (select_iclass_tag(card_data, use_credit_key, &eof_time) == false)
-        goto out;
+        if (select_iclass_tag(card_data, use_credit_key, &eof_time) == false)
+            goto out;
 
-    start_time = eof_time + DELAY_ICLASS_VICC_TO_VCD_READER;
+        start_time = eof_time + DELAY_ICLASS_VICC_TO_VCD_READER;
+    }
+    chk_selected = false;
 
     // since select_iclass_tag call sends s readcheck,  we start with sending first response.
     uint16_t checked = 0;
@@ -1686,10 +1797,17 @@ void iClass_Authentication_fast(uint64_t arg0, uint64_t arg1, uint8_t *datain) {
         LED_B_OFF();
     }
 
+    // all keys of the chunk checked, the card waits for the next one
+    if (lastChunk == false) {
+        chk_selected = true;
+        chk_start_time = eof_time + DELAY_ICLASS_VICC_TO_VCD_READER;
+    }
+
 out:
     // send keyindex.
     reply_mix(CMD_HF_ICLASS_CHKKEYS, isOK, i, 0, 0, 0);
-    switch_off();
+    if (chk_selected == false)
+        switch_off();
 }
 
 // Tries to read block.
@@ -1822,11 +1940,26 @@ void iClass_Dump(uint8_t *msg) {
     start_time = eof_time + DELAY_ICLASS_VICC_TO_VCD_READER;
 
     bool dumpsuccess = true;
+    // READ4 until the card does not answer it, then block by block
+    bool use_read4 = true;
 
     // main read loop
     uint16_t i;
     for (i = cmd->start_block; i <= cmd->end_block; i++) {
 
+        if (use_read4 && i + 3 <= cmd->end_block) {
+            uint8_t resp4[34];
+            uint8_t c4[] = {ICLASS_CMD_READ4, i, 0x00, 0x00};
+            AddCrc(c4 + 1, 1);
+
+            if (iclass_send_cmd_with_retries(c4, sizeof(c4), resp4, sizeof(resp4), 34, 2, &start_time, ICLASS_READER_TIMEOUT_OTHERS, &eof_time)) {
+                memcpy(dataout + (8 * i), resp4, 32);
+                i += 3;
+                continue;
+            }
+            use_read4 = false;
+        }
+
         uint8_t resp[10];
         uint8_t c[] = {ICLASS_CMD_READ_OR_IDENTIFY, i, 0x00, 0x00};
         AddCrc(c + 1, 1);
@@ -25,13 +25,13 @@
 #include "commonutil.h"
 #include "crc16.h"
 #include "protocols.h"
+#include "profiling.h"
 
 #define MAX_ISO14A_TIMEOUT 524288
 static uint32_t iso14a_timeout;
 // if iso14443a not active - transmit/receive dont try to execute
 static bool hf_field_active = false;
 
-static uint8_t colpos = 0;
 int g_rsamples = 0;
 uint8_t g_trigger = 0;
 // the block number for the ISO14443-4 PCB
@@ -130,7 +130,7 @@ Default HF 14a config is set to:
     forcecl3 = 0 (auto)
     forcerats = 0 (auto)
 */
-static hf14a_config hf14aconfig = { 0, 0, 0, 0, 0 } ;
+static hf14a_config hf14aconfig = { 0, 0, 0, 0, 0, 0, 0 } ;
 
 void printHf14aConfig(void) {
     DbpString(_CYAN_("HF 14a config"));
@@ -139,6 +139,9 @@ void printHf14aConfig(void) {
     Dbprintf("[2] CL2 override..........%i: %s%s%s", hf14aconfig.forcecl2, (hf14aconfig.forcecl2 == 0) ? _GREEN_("No") " (follow standard)" : "", (hf14aconfig.forcecl2 == 1) ? _RED_("Yes: Always do CL2") : "", (hf14aconfig.forcecl2 == 2) ? _RED_("Yes: Always skip CL2") : "");
     Dbprintf("[3] CL3 override..........%i: %s%s%s", hf14aconfig.forcecl3, (hf14aconfig.forcecl3 == 0) ? _GREEN_("No") " (follow standard)" : "", (hf14aconfig.forcecl3 == 1) ? _RED_("Yes: Always do CL3") : "", (hf14aconfig.forcecl3 == 2) ? _RED_("Yes: Always skip CL3") : "");
     Dbprintf("[r] RATS override.........%i: %s%s%s", hf14aconfig.forcerats, (hf14aconfig.forcerats == 0) ? _GREEN_("No") " (follow standard)" : "", (hf14aconfig.forcerats == 1) ? _RED_("Yes: Always do RATS") : "", (hf14aconfig.forcerats == 2) ? _RED_("Yes: Always skip RATS") : "");
+    Dbprintf("[t] Adaptive timeout......%i: %s", hf14aconfig.adaptive, (hf14aconfig.adaptive == 0) ? _GREEN_("No") " (fixed timeouts)" : _YELLOW_("Yes: Learn card answer latency"));
+    if (hf14aconfig.adaptive)
+        Dbprintf("    learned latency.......%u fc", hf14aconfig.latency);
 }
 
 /**
@@ -161,6 +164,10 @@ void setHf14aConfig(hf14a_config *hc) {
         hf14aconfig.forcecl3 = hc->forcecl3;
     if ((hc->forcerats >= 0) && (hc->forcerats <= 2))
         hf14aconfig.forcerats = hc->forcerats;
+    if ((hc->adaptive >= 0) && (hc->adaptive <= 1) && (hc->adaptive != hf14aconfig.adaptive)) {
+        hf14aconfig.adaptive = hc->adaptive;
+        hf14aconfig.latency = 0;
+    }
 }
 
 hf14a_config *getHf14aConfig(void) {
@@ -179,6 +186,41 @@ uint32_t iso14a_get_timeout(void) {
     return iso14a_timeout - (DELAY_AIR2ARM_AS_READER + DELAY_ARM2AIR_AS_READER) / (16 * 8) - 2;
 }
 
+// Adaptive timeout, hf 14a config t 1
+// The answers to SELECT, the Mifare authentication and the darkside NACK come at a fixed frame
+// delay. The largest one the selected card showed sets how long a missing answer is waited for,
+// twice that delay plus a margin instead of the full timeout. A new anticollision starts over
+#define ADAPTIVE_TIMEOUT_MIN    16  // iso14a_set_timeout units (128/fc), WUPA alone waits 10
+#define ADAPTIVE_TIMEOUT_MARGIN 4
+
+void iso14a_adaptive_reset(void) {
+    hf14aconfig.latency = 0;
+}
+
+// call right after a fixed delay answer was received
+void iso14a_adaptive_learn(void) {
+    if (hf14aconfig.adaptive == 0)
+        return;
+
+    uint32_t fdt = MIN(iso14a_get_last_fdt(), 0xFFFF);
+    if (fdt > hf14aconfig.latency)
+        hf14aconfig.latency = fdt;
+}
+
+// wait for a fixed delay answer, shorter than timeout once the card latency is known
+uint32_t iso14a_adaptive_timeout(uint32_t timeout) {
+    if (hf14aconfig.adaptive == 0 || hf14aconfig.latency == 0)
+        return timeout;
+
+    return MIN(timeout, MAX(ADAPTIVE_TIMEOUT_MIN, (2 * hf14aconfig.latency) / (16 * 8) + ADAPTIVE_TIMEOUT_MARGIN));
+}
+
+// Flash memory access reprograms the timers, restart the ssp clock and the frame timing before the next transfer
+void iso14a_restart_timing(void) {
+    StartCountSspClk();
+    NextTransferTime = 2 * DELAY_ARM2AIR_AS_READER;
+}
+
 //-----------------------------------------------------------------------------
 // Generate the parity value for a byte sequence
 //-----------------------------------------------------------------------------
@@ -608,11 +650,42 @@ static RAMFUNC int ManchesterDecoding_Thinfilm(uint8_t bit) {
 // near the reader.
 // "hf 14a sniff"
 //-----------------------------------------------------------------------------
+// called between frames while sniffing, see iso14a_set_sniff_hook
+static iso14a_sniff_hook_t sniff_hook = NULL;
+
+void iso14a_set_sniff_hook(iso14a_sniff_hook_t hook) {
+    sniff_hook = hook;
+}
+
+// live sniff, ship the whole trace records from *sent on that fit one frame
+static void Sniff14aLiveSend(hf14a_sniff_frame_t *frame, uint32_t *sent, bool final, int status) {
+    uint8_t *trace = BigBuf_get_addr();
+    uint32_t end = BigBuf_get_traceLen();
+
+    frame->len = 0;
+    while (*sent < end) {
+        tracelog_hdr_t *hdr = (tracelog_hdr_t *)(trace + *sent);
+        uint16_t reclen = TRACELOG_HDR_LEN + hdr->data_len + TRACELOG_PARITY_LEN(hdr);
+        if (frame->len + reclen > HF14A_SNIFF_RECORDS)
+            break;
+
+        memcpy(frame->data + frame->len, hdr, reclen);
+        frame->len += reclen;
+        *sent += reclen;
+    }
+
+    frame->final = final;
+    reply_ng(CMD_HF_ISO14443A_SNIFF_STREAM, status, (uint8_t *)frame, sizeof(hf14a_sniff_frame_t) - HF14A_SNIFF_RECORDS + frame->len);
+    frame->seq++;
+}
+
 void RAMFUNC SniffIso14443a(uint8_t param) {
     LEDsoff();
     // param:
     // bit 0 - trigger from first card answer
     // bit 1 - trigger from first reader 7-bit request
+    // bit 2 - ring trace, keep the latest traffic instead of stopping when the trace is full
+    // bit 3 - live, push the records to the client as they complete (CMD_HF_ISO14443A_SNIFF_STREAM)
     iso14443a_setup(FPGA_HF_ISO14443A_SNIFFER);
 
     // Allocate memory from BigBuf for some buffers
@@ -621,6 +694,10 @@ void RAMFUNC SniffIso14443a(uint8_t param) {
     BigBuf_Clear_ext(false);
     clear_trace();
     set_tracing(true);
+    bool live = (param & 0x08);
+
+    // records already sent are dropped instead, see below
+    set_tracing_ring((param & 0x04) && live == false);
 
     // The command (reader -> tag) that we're receiving.
     uint8_t *receivedCmd = BigBuf_malloc(MAX_FRAME_SIZE);
@@ -630,6 +707,14 @@ void RAMFUNC SniffIso14443a(uint8_t param) {
     uint8_t *receivedResp = BigBuf_malloc(MAX_FRAME_SIZE);
     uint8_t *receivedRespPar = BigBuf_malloc(MAX_PARITY_SIZE);
 
+    hf14a_sniff_frame_t *frame = NULL;
+    uint32_t live_sent = 0;
+    int live_status = PM3_EOPABORTED;
+    if (live) {
+        frame = (hf14a_sniff_frame_t *)BigBuf_malloc(sizeof(hf14a_sniff_frame_t));
+        memset(frame, 0, sizeof(hf14a_sniff_frame_t));
+    }
+
     uint8_t previous_data = 0;
     int maxDataLen = 0, dataLen;
     bool TagIsActive = false;
@@ -650,6 +735,8 @@ void RAMFUNC SniffIso14443a(uint8_t param) {
     // Setup and start DMA.
     if (!FpgaSetupSscDma((uint8_t *) dma->buf, DMA_BUFFER_SIZE)) {
         if (DBGLEVEL > 1) Dbprintf("FpgaSetupSscDma failed. Exiting");
+        if (live)
+            Sniff14aLiveSend(frame, &live_sent, true, PM3_EINIT);
         return;
     }
 
@@ -677,12 +764,41 @@ void RAMFUNC SniffIso14443a(uint8_t param) {
         if (dataLen > maxDataLen) {
             maxDataLen = dataLen;
             if (dataLen > (9 * DMA_BUFFER_SIZE / 10)) {
+                profiling_dma_overrun();
                 Dbprintf("[!] blew circular buffer! | datalen %u", dataLen);
+                live_status = PM3_EOVFLOW;
                 break;
             }
         }
         if (dataLen < 1) continue;
 
+        // live mode, only between frames and with little DMA backlog. One USB frame is
+        // well below what the DMA buffer holds, so no edges get lost while it goes out.
+        if (live && (rx_samples & 0x3F) == 0 && TagIsActive == false && ReaderIsActive == false && dataLen < DMA_BUFFER_SIZE / 4) {
+            if (live_sent < BigBuf_get_traceLen()) {
+                Sniff14aLiveSend(frame, &live_sent, false, PM3_SUCCESS);
+            } else if (data_available()) {
+                break;
+            } else if (live_sent > BigBuf_max_traceLen() / 2) {
+                // everything has been shipped, start the trace over
+                clear_trace();
+                live_sent = 0;
+            }
+        }
+
+        // a standalone mode moving the trace to flash. That takes longer than the DMA buffer lasts,
+        // so after it the sampling starts over on an empty buffer, nobody is talking anyway
+        if (sniff_hook && (rx_samples & 0x3F) == 0 && TagIsActive == false && ReaderIsActive == false && dataLen < DMA_BUFFER_SIZE / 4) {
+            if (sniff_hook()) {
+                FpgaSetupSscDma((uint8_t *) dma->buf, DMA_BUFFER_SIZE);
+                data = dma->buf;
+                maxDataLen = 0;
+                Uart14aReset();
+                Demod14aReset();
+                continue;
+            }
+        }
+
         // primary buffer was stopped( <-- we lost data!
         if (!AT91C_BASE_PDC_SSC->PDC_RCR) {
             AT91C_BASE_PDC_SSC->PDC_RPR = (uint32_t) dma->buf;
@@ -714,7 +830,10 @@ void RAMFUNC SniffIso14443a(uint8_t param) {
                                       Uart.startTime * 16 - DELAY_READER_AIR2ARM_AS_SNIFFER,
                                       Uart.endTime * 16 - DELAY_READER_AIR2ARM_AS_SNIFFER,
                                       Uart.parity,
-                                      true)) break;
+                                      true)) {
+                            live_status = PM3_EOVFLOW;
+                            break;
+                        }
                     }
                     /* ready to receive another command. */
                     Uart14aReset();
@@ -737,7 +856,10 @@ void RAMFUNC SniffIso14443a(uint8_t param) {
                                   Demod.startTime * 16 - DELAY_TAG_AIR2ARM_AS_SNIFFER,
                                   Demod.endTime * 16 - DELAY_TAG_AIR2ARM_AS_SNIFFER,
                                   Demod.parity,
-                                  false)) break;
+                                  false)) {
+                        live_status = PM3_EOVFLOW;
+                        break;
+                    }
 
                     if ((!triggered) && (param & 0x01)) triggered = true;
 
@@ -761,6 +883,13 @@ void RAMFUNC SniffIso14443a(uint8_t param) {
     } // end main loop
 
     FpgaDisableTracing();
+    set_tracing_ring(false);
+
+    if (live) {
+        while (live_sent < BigBuf_get_traceLen())
+            Sniff14aLiveSend(frame, &live_sent, false, PM3_SUCCESS);
+        Sniff14aLiveSend(frame, &live_sent, true, live_status);
+    }
 
     if (DBGLEVEL >= DBG_ERROR) {
         Dbprintf("trace len = " _YELLOW_("%d"), BigBuf_get_traceLen());
@@ -771,6 +900,18 @@ void RAMFUNC SniffIso14443a(uint8_t param) {
 //-----------------------------------------------------------------------------
 // Prepare tag messages
 //-----------------------------------------------------------------------------
+
+// tag modulation of the data bits of a nibble, LSB first. Coding a byte is two copies
+// instead of eight branches, answers coded on the fly (encrypted reads) leave earlier
+#define SEC_BIT(n, i)   ((((n) >> (i)) & 1) ? SEC_D : SEC_E)
+#define SEC_NIBBLE(n)   { SEC_BIT(n, 0), SEC_BIT(n, 1), SEC_BIT(n, 2), SEC_BIT(n, 3) }
+static const uint8_t sec_nibble[16][4] = {
+    SEC_NIBBLE(0),  SEC_NIBBLE(1),  SEC_NIBBLE(2),  SEC_NIBBLE(3),
+    SEC_NIBBLE(4),  SEC_NIBBLE(5),  SEC_NIBBLE(6),  SEC_NIBBLE(7),
+    SEC_NIBBLE(8),  SEC_NIBBLE(9),  SEC_NIBBLE(10), SEC_NIBBLE(11),
+    SEC_NIBBLE(12), SEC_NIBBLE(13), SEC_NIBBLE(14), SEC_NIBBLE(15),
+};
+
 static void CodeIso14443aAsTagPar(const uint8_t *cmd, uint16_t len, uint8_t *par, bool collision) {
 
     tosend_reset();
@@ -795,18 +936,13 @@ static void CodeIso14443aAsTagPar(const uint8_t *cmd, uint16_t len, uint8_t *par
         uint8_t b = cmd[i];
 
         // Data bits
-        for (uint16_t j = 0; j < 8; j++) {
-            if (collision) {
-                ts->buf[++ts->max] = SEC_COLL;
-            } else {
-                if (b & 1) {
-                    ts->buf[++ts->max] = SEC_D;
-                } else {
-                    ts->buf[++ts->max] = SEC_E;
-                }
-                b >>= 1;
-            }
+        if (collision) {
+            memset(ts->buf + ts->max + 1, SEC_COLL, 8);
+        } else {
+            memcpy(ts->buf + ts->max + 1, sec_nibble[b & 0x0F], 4);
+            memcpy(ts->buf + ts->max + 5, sec_nibble[b >> 4], 4);
         }
+        ts->max += 8;
 
         if (collision) {
             ts->buf[++ts->max] = SEC_COLL;
@@ -877,6 +1013,11 @@ static void Code4bitAnswerAsTag(uint8_t cmd) {
     ts->max++;
 }
 
+// end of the current candidate of a uid sweep or of an antifuzz progress frame, 0 otherwise
+static uint32_t sim_deadline = 0;
+// answer timing of the simulated tag, EmSendCmd14443aRaw counts
+static iso14a_sim_stats_t sim_stats;
+
 //-----------------------------------------------------------------------------
 // Wait for commands from reader
 // stop when button is pressed or client usb connection resets
@@ -904,6 +1045,9 @@ bool GetIso14443aCommandFromReader(uint8_t *received, uint8_t *par, int *len) {
             if (BUTTON_PRESS())
                 return false;
 
+            if (sim_deadline && (data_available() || GetTickCount() > sim_deadline))
+                return false;
+
             check = 0;
             WDT_HIT();
         }
@@ -920,7 +1064,7 @@ bool GetIso14443aCommandFromReader(uint8_t *received, uint8_t *par, int *len) {
     return false;
 }
 
-bool prepare_tag_modulation(tag_response_info_t *response_info, size_t max_buffer_size)  {
+static bool prepare_tag_modulation_ex(tag_response_info_t *response_info, size_t max_buffer_size, bool collision)  {
     // Example response, answer to MIFARE Classic read block will be 16 bytes + 2 CRC = 18 bytes
     // This will need the following byte array for a modulation sequence
     //    144        data bits (18 * 8)
@@ -932,7 +1076,7 @@ bool prepare_tag_modulation(tag_response_info_t *response_info, size_t max_buffe
     //    166 bytes, since every bit that needs to be send costs us a byte
     //
     // Prepare the tag modulation bits from the message
-    CodeIso14443aAsTag(response_info->response, response_info->response_n);
+    CodeIso14443aAsTagEx(response_info->response, response_info->response_n, collision);
 
     tosend_t *ts = get_tosend();
 
@@ -952,6 +1096,10 @@ bool prepare_tag_modulation(tag_response_info_t *response_info, size_t max_buffe
     return true;
 }
 
+bool prepare_tag_modulation(tag_response_info_t *response_info, size_t max_buffer_size)  {
+    return prepare_tag_modulation_ex(response_info, max_buffer_size, false);
+}
+
 bool prepare_allocated_tag_modulation(tag_response_info_t *response_info, uint8_t **buffer, size_t *max_buffer_size) {
 
     tosend_t *ts = get_tosend();
@@ -1205,8 +1353,9 @@ bool SimulateIso14443aInit(int tagType, int flags, uint8_t *data, tag_response_i
 // Main loop of simulated tag: receive commands from reader, decide what
 // response to send, and send it.
 // 'hf 14a sim'
+// Returns PM3_ETIMEOUT when the dwell time of a sweep candidate is over
 //-----------------------------------------------------------------------------
-void SimulateIso14443aTag(uint8_t tagType, uint8_t flags, uint8_t *data) {
+static int SimulateIso14443aTagEx(uint8_t tagType, uint8_t flags, uint8_t *data) {
 
 #define ATTACK_KEY_COUNT 8 // keep same as define in cmdhfmf.c -> readerAttack()
 
@@ -1249,8 +1398,7 @@ void SimulateIso14443aTag(uint8_t tagType, uint8_t flags, uint8_t *data) {
 
     if (SimulateIso14443aInit(tagType, flags, data, &responses, &cuid, counters, tearings, &pages) == false) {
         BigBuf_free_keep_EM();
-        reply_ng(CMD_HF_MIFARE_SIMULATE, PM3_EINIT, NULL, 0);
-        return;
+        return PM3_EINIT;
     }
 
     // We need to listen to the high-frequency, peak-detected path.
@@ -1287,7 +1435,9 @@ void SimulateIso14443aTag(uint8_t tagType, uint8_t flags, uint8_t *data) {
     bool odd_reply = true;
 
     clear_trace();
-    set_tracing(true);
+    // the trace costs time between the frames, a reader which is fast to send the next one may not wait for it
+    set_tracing((flags & FLAG_NO_TRACE) == 0);
+    memset(&sim_stats, 0, sizeof(sim_stats));
     LED_A_ON();
 
     // main loop
@@ -1298,6 +1448,10 @@ void SimulateIso14443aTag(uint8_t tagType, uint8_t flags, uint8_t *data) {
 
         // Clean receive command buffer
         if (GetIso14443aCommandFromReader(receivedCmd, receivedCmdPar, &len) == false) {
+            if (sim_deadline && GetTickCount() > sim_deadline && BUTTON_PRESS() == false && data_available() == false) {
+                retval = PM3_ETIMEOUT;
+                break;
+            }
             Dbprintf("Emulator stopped. Trace length: %d ", BigBuf_get_traceLen());
             retval = PM3_EOPABORTED;
             break;
@@ -1713,9 +1867,55 @@ void SimulateIso14443aTag(uint8_t tagType, uint8_t flags, uint8_t *data) {
         Dbprintf("-[ Messages after halt  [%d]", happened2);
         Dbprintf("-[ Num of received cmd  [%d]", cmdsRecvd);
         Dbprintf("-[ Num of moebius tries [%d]", moebius_count);
+        Dbprintf("-[ Late answers         [%u / %u]", sim_stats.late, sim_stats.answers);
     }
 
-    reply_ng(CMD_HF_MIFARE_SIMULATE, retval, NULL, 0);
+    return retval;
+}
+
+void SimulateIso14443aTag(uint8_t tagType, uint8_t flags, uint8_t *data) {
+    int res = SimulateIso14443aTagEx(tagType, flags, data);
+    reply_ng(CMD_HF_MIFARE_SIMULATE, res, (uint8_t *)&sim_stats, sizeof(sim_stats));
+}
+
+// uid sweep for `hf 14a sweep`, the uid is counted as a big endian number of 4 or 7 bytes.
+// Each candidate answers the reader for the dwell time before the next one is set up
+void SimulateIso14443aSweep(const sim_sweep_t *p) {
+
+    uint8_t uidlen = (p->flags & FLAG_7B_UID_IN_DATA) ? 7 : 4;
+    if ((p->flags & (FLAG_4B_UID_IN_DATA | FLAG_7B_UID_IN_DATA)) == 0 || p->dwell == 0 || p->count == 0) {
+        reply_ng(CMD_HF_ISO14443A_SIM_SWEEP, PM3_EINVARG, NULL, 0);
+        return;
+    }
+
+    uint64_t mask = (uidlen == 7) ? 0xFFFFFFFFFFFFFFULL : 0xFFFFFFFFULL;
+    sim_sweep_resp_t resp = { .index = 0, .value = p->start & mask };
+    int res = PM3_SUCCESS;
+    uint32_t last = GetTickCount();
+
+    for (uint32_t i = 0; i < p->count; i++) {
+
+        resp.index = i;
+        resp.value = (p->start + (uint64_t)i * p->step) & mask;
+
+        uint8_t uid[10] = {0};
+        num_to_bytes(resp.value, uidlen, uid);
+
+        sim_deadline = GetTickCount() + p->dwell;
+        res = SimulateIso14443aTagEx(p->tagtype, p->flags, uid);
+        sim_deadline = 0;
+
+        if (res != PM3_ETIMEOUT)
+            break;
+
+        res = PM3_SUCCESS;
+        if (GetTickCount() - last > 1000) {
+            reply_ng(CMD_HF_ISO14443A_SIM_SWEEP, PM3_EPARTIAL, (uint8_t *)&resp, sizeof(resp));
+            last = GetTickCount();
+        }
+    }
+
+    reply_ng(CMD_HF_ISO14443A_SIM_SWEEP, res, (uint8_t *)&resp, sizeof(resp));
 }
 
 // prepare a delayed transfer. This simply shifts ToSend[] by a number
@@ -1997,7 +2197,8 @@ int EmGetCmd(uint8_t *received, uint16_t *len, uint8_t *par) {
     }
 }
 
-int EmSendCmd14443aRaw(uint8_t *resp, uint16_t respLen) {
+// delay: bit times of 128/fc without modulation before the answer, added to its frame delay
+static int EmSendCmd14443aRawDelayed(uint8_t *resp, uint16_t respLen, uint8_t delay) {
     volatile uint8_t b;
     uint16_t i = 0;
     uint32_t ThisTransferTime;
@@ -2039,9 +2240,14 @@ int EmSendCmd14443aRaw(uint8_t *resp, uint16_t respLen) {
     AT91C_BASE_SSC->SSC_THR = SEC_F;
 
     // send cycle
-    for (; i < respLen;) {
+    for (uint8_t pad = delay; i < respLen;) {
         if (AT91C_BASE_SSC->SSC_SR & (AT91C_SSC_TXRDY)) {
-            AT91C_BASE_SSC->SSC_THR = resp[i++];
+            if (pad) {
+                AT91C_BASE_SSC->SSC_THR = SEC_F;
+                pad--;
+            } else {
+                AT91C_BASE_SSC->SSC_THR = resp[i++];
+            }
             FpgaSendQueueDelay = (uint8_t)AT91C_BASE_SSC->SSC_RHR;
         }
 
@@ -2062,10 +2268,23 @@ int EmSendCmd14443aRaw(uint8_t *resp, uint16_t respLen) {
             i++;
         }
     }
-    LastTimeProxToAirStart = ThisTransferTime + (correction_needed ? 8 : 0);
+    LastTimeProxToAirStart = ThisTransferTime + (correction_needed ? 8 : 0) + delay * 8;
+
+    // the frame delay on its grid as EmLogTrace finds it
+    uint32_t approx_fdt = (LastTimeProxToAirStart * 16 + DELAY_ARM2AIR_AS_TAG) - (Uart.endTime * 16 - DELAY_AIR2ARM_AS_TAG);
+    uint32_t exact_fdt = (approx_fdt - 20 + 32) / 64 * 64 + 20;
+    sim_stats.answers++;
+    if (exact_fdt > 1236)
+        sim_stats.late++;
+    if (exact_fdt > sim_stats.fdt_max)
+        sim_stats.fdt_max = MIN(exact_fdt, UINT16_MAX);
     return 0;
 }
 
+int EmSendCmd14443aRaw(uint8_t *resp, uint16_t respLen) {
+    return EmSendCmd14443aRawDelayed(resp, respLen, 0);
+}
+
 int EmSend4bit(uint8_t resp) {
     Code4bitAnswerAsTag(resp);
     tosend_t *ts = get_tosend();
@@ -2115,9 +2334,9 @@ int EmSendCmdEx(uint8_t *resp, uint16_t respLen, bool collision) {
     return EmSendCmdParEx(resp, respLen, par, collision);
 }
 
-int EmSendPrecompiledCmd(tag_response_info_t *p_response) {
+static int EmSendPrecompiledCmdDelayed(tag_response_info_t *p_response, uint8_t delay) {
     if (p_response == NULL) return 0;
-    int ret = EmSendCmd14443aRaw(p_response->modulation, p_response->modulation_n);
+    int ret = EmSendCmd14443aRawDelayed(p_response->modulation, p_response->modulation_n, delay);
     // do the tracing for the previous reader request and this tag answer:
     uint8_t par[MAX_PARITY_SIZE] = {0x00};
     GetParity(p_response->response, p_response->response_n, par);
@@ -2135,6 +2354,10 @@ int EmSendPrecompiledCmd(tag_response_info_t *p_response) {
     return ret;
 }
 
+int EmSendPrecompiledCmd(tag_response_info_t *p_response) {
+    return EmSendPrecompiledCmdDelayed(p_response, 0);
+}
+
 bool EmLogTrace(uint8_t *reader_data, uint16_t reader_len, uint32_t reader_StartTime,
                 uint32_t reader_EndTime, uint8_t *reader_Parity, uint8_t *tag_data,
                 uint16_t tag_len, uint32_t tag_StartTime, uint32_t tag_EndTime, uint8_t *tag_Parity) {
@@ -2250,12 +2473,52 @@ static int GetIso14443aAnswerFromTag(uint8_t *receivedResponse, uint8_t *receive
     return false;
 }
 
+//-----------------------------------------------------------------------------
+// Tear-off engine. Armed, the next reader frame is followed by a field cut at a fixed
+// ssp clock offset after its end, then the engine disarms itself
+//-----------------------------------------------------------------------------
+static bool tearoff_armed = false;
+static uint32_t tearoff_offset = 0;
+
+void iso14a_tearoff_arm(uint32_t offset) {
+    tearoff_offset = offset;
+    tearoff_armed = true;
+}
+
+void iso14a_tearoff_disarm(void) {
+    tearoff_armed = false;
+}
+
+// the frame was just handed to the SSC, wait for its end + offset on the ssp clock
+static void iso14a_tearoff_fire(void) {
+    uint32_t cut = LastTimeProxToAirStart + LastProxToAirDuration + tearoff_offset;
+    while (GetCountSspClk() < cut) {};
+
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    LED_D_OFF();
+    hf_field_active = false;
+    tearoff_armed = false;
+}
+
+// field off for off_ms so the tag loses its power, then on again and ready for a select
+void iso14a_field_cycle(uint16_t off_ms) {
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    LED_D_OFF();
+    SpinDelay(off_ms);
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_HF_ISO14443A | FPGA_HF_ISO14443A_READER_LISTEN);
+    LED_D_ON();
+    SpinDelay(ISO14A_FIELD_SETTLE_MS);
+    iso14a_restart_timing();
+    hf_field_active = true;
+}
+
 void ReaderTransmitBitsPar(uint8_t *frame, uint16_t bits, uint8_t *par, uint32_t *timing) {
 
     CodeIso14443aBitsAsReaderPar(frame, bits, par);
     // Send command to tag
     tosend_t *ts = get_tosend();
     TransmitFor14443a(ts->buf, ts->max, timing);
+    if (tearoff_armed) iso14a_tearoff_fire();
     if (g_trigger) LED_A_ON();
 
     LogTrace(frame, nbytes(bits), (LastTimeProxToAirStart << 4) + DELAY_ARM2AIR_AS_READER, ((LastTimeProxToAirStart + LastProxToAirDuration) << 4) + DELAY_ARM2AIR_AS_READER, par, true);
@@ -2293,11 +2556,82 @@ int ReaderReceive(uint8_t *receivedAnswer, uint8_t *par) {
     return Demod.len;
 }
 
+// Frame delay of the last tag answer, carrier periods from the end of the last reader frame
+uint32_t iso14a_get_last_fdt(void) {
+    return (Demod.startTime * 16 - DELAY_AIR2ARM_AS_READER) - ((LastTimeProxToAirStart + LastProxToAirDuration) * 16 + DELAY_ARM2AIR_AS_READER);
+}
+
+// Receives an answer the card sends at a fixed frame delay, see iso14a_adaptive_timeout
+int ReaderReceiveFixedDelay(uint8_t *receivedAnswer, uint8_t *par) {
+    uint32_t save_timeout = iso14a_get_timeout();
+    iso14a_set_timeout(iso14a_adaptive_timeout(save_timeout));
+
+    int len = ReaderReceive(receivedAnswer, par);
+
+    iso14a_set_timeout(save_timeout);
+    if (len)
+        iso14a_adaptive_learn();
+    return len;
+}
+
+
+// Anticollision fuzzing. The answers of all the variations of the spec are coded before the field is
+// listened to, the loop only picks them, so a reader sees a new variation from its next REQA / WUPA on.
+// Uid frames come by uid length, cascade level and BCC, valid or inverted.
+// With ANTIFUZZ_COLLIDE the uid bits all collide instead, the reader never gets one to select and
+// has to keep increasing the bits it sends, the original antifuzz. Some readers overflow on it.
+#define ANTIFUZZ_MOD_SIZE   1536
 
-// This function misstreats the ISO 14443a anticollision procedure.
-// by fooling the reader there is a collision and forceing the reader to
-// increase the uid bytes.   The might be an overflow, DoS will occure.
-void iso14443a_antifuzz(uint32_t flags) {
+typedef struct {
+    uint8_t *buf;
+    size_t free;
+} antifuzz_buf_t;
+
+// keeps the response bytes in the buffer next to their modulation
+static bool antifuzz_prepare(antifuzz_buf_t *b, tag_response_info_t *info, const uint8_t *data, uint8_t len, bool collision) {
+    if (b->free < len)
+        return false;
+    memcpy(b->buf, data, len);
+    info->response = b->buf;
+    info->response_n = len;
+    b->buf += len;
+    b->free -= len;
+
+    info->modulation = b->buf;
+    if (prepare_tag_modulation_ex(info, b->free, collision) == false)
+        return false;
+    b->buf += info->modulation_n;
+    b->free -= info->modulation_n;
+    return true;
+}
+
+static void antifuzz_sak(uint8_t *frame, uint8_t sak) {
+    frame[0] = sak;
+    AddCrc14A(frame, 1);
+}
+
+void iso14443a_antifuzz(const iso14a_antifuzz_t *p) {
+
+    uint8_t lens[3];
+    uint8_t nlen = 0;
+    if (p->flags & ANTIFUZZ_UID4)
+        lens[nlen++] = 4;
+    if (p->flags & ANTIFUZZ_UID7)
+        lens[nlen++] = 7;
+    if (p->flags & ANTIFUZZ_UID10)
+        lens[nlen++] = 10;
+
+    if (nlen == 0 || p->atqa_n > ANTIFUZZ_MAX_VALUES || p->sak_n > ANTIFUZZ_MAX_VALUES || p->delay_n > ANTIFUZZ_MAX_VALUES) {
+        reply_ng(CMD_HF_ISO14443A_ANTIFUZZ, PM3_EINVARG, NULL, 0);
+        return;
+    }
+
+    bool collide = (p->flags & ANTIFUZZ_COLLIDE);
+    uint8_t natqa = MAX(p->atqa_n, 1);
+    uint8_t nsak = MAX(p->sak_n, 1);
+    uint8_t ndelay = MAX(p->delay_n, 1);
+    uint8_t nbcc = ((p->flags & ANTIFUZZ_BADBCC) && collide == false) ? 2 : 1;
+    uint8_t activations = MAX(p->activations, 1);
 
     // We need to listen to the high-frequency, peak-detected path.
     iso14443a_setup(FPGA_HF_ISO14443A_TAGSIM_LISTEN);
@@ -2306,66 +2640,177 @@ void iso14443a_antifuzz(uint32_t flags) {
     clear_trace();
     set_tracing(true);
 
-    int len = 0;
-
-    // allocate buffers:
     uint8_t *received = BigBuf_malloc(MAX_FRAME_SIZE);
     uint8_t *receivedPar = BigBuf_malloc(MAX_PARITY_SIZE);
-    uint8_t *resp = BigBuf_malloc(20);
+    // atqa by value, or by uid length without values. uid frames by uid length, cascade level and bcc
+    tag_response_info_t *r_atqa = (tag_response_info_t *)BigBuf_malloc(ANTIFUZZ_MAX_VALUES * sizeof(tag_response_info_t));
+    tag_response_info_t *r_uid = (tag_response_info_t *)BigBuf_malloc(3 * 3 * 2 * sizeof(tag_response_info_t));
+    tag_response_info_t *r_sak = (tag_response_info_t *)BigBuf_malloc((ANTIFUZZ_MAX_VALUES + 1) * sizeof(tag_response_info_t));
+    antifuzz_buf_t b = { BigBuf_malloc(ANTIFUZZ_MOD_SIZE), ANTIFUZZ_MOD_SIZE };
+
+    if (received == NULL || receivedPar == NULL || r_atqa == NULL || r_uid == NULL || r_sak == NULL || b.buf == NULL) {
+        reply_ng(CMD_HF_ISO14443A_ANTIFUZZ, PM3_EMALLOC, NULL, 0);
+        switch_off();
+        BigBuf_free_keep_EM();
+        return;
+    }
+
+    bool ok = true;
+    uint8_t frame[5];
+    if (p->atqa_n) {
+        for (uint8_t i = 0; i < p->atqa_n; i++)
+            ok &= antifuzz_prepare(&b, &r_atqa[i], p->atqa[i], 2, false);
+    } else {
+        // the uid size bits of the length
+        for (uint8_t i = 0; i < nlen; i++) {
+            frame[0] = (lens[i] == 4) ? 0x04 : (lens[i] == 7) ? 0x44 : 0x84;
+            frame[1] = 0x00;
+            ok &= antifuzz_prepare(&b, &r_atqa[i], frame, 2, false);
+        }
+    }
 
-    memset(resp, 0xFF, 20);
+    for (uint8_t i = 0; i < nlen; i++) {
+        uint8_t levels = (lens[i] == 4) ? 1 : (lens[i] == 7) ? 2 : 3;
+        for (uint8_t cl = 0; cl < levels; cl++) {
+            if (collide) {
+                memset(frame, 0xFF, 4);
+                if (levels > 1)
+                    frame[0] = MIFARE_SELECT_CT;
+            } else if (cl == levels - 1) {
+                memcpy(frame, p->uid + cl * 3, 4);
+            } else {
+                frame[0] = MIFARE_SELECT_CT;
+                memcpy(frame + 1, p->uid + cl * 3, 3);
+            }
+            frame[4] = frame[0] ^ frame[1] ^ frame[2] ^ frame[3];
+
+            for (uint8_t bcc = 0; bcc < nbcc; bcc++) {
+                if (bcc)
+                    frame[4] ^= 0xFF;
+                ok &= antifuzz_prepare(&b, &r_uid[(i * 3 + cl) * 2 + bcc], frame, 5, collide);
+            }
+            // nothing resolves the collision, the first level is all there is
+            if (collide)
+                break;
+        }
+    }
+
+    for (uint8_t i = 0; i < nsak; i++) {
+        antifuzz_sak(frame, p->sak_n ? p->sak[i] : 0x08);
+        ok &= antifuzz_prepare(&b, &r_sak[i], frame, 3, false);
+    }
+    // uid not complete
+    antifuzz_sak(frame, 0x04);
+    ok &= antifuzz_prepare(&b, &r_sak[nsak], frame, 3, false);
+
+    if (ok == false) {
+        reply_ng(CMD_HF_ISO14443A_ANTIFUZZ, PM3_EOUTOFBOUND, NULL, 0);
+        switch_off();
+        BigBuf_free_keep_EM();
+        return;
+    }
+
+    iso14a_antifuzz_resp_t resp = {
+        .variations = (uint32_t)nlen * natqa * nsak * ndelay * nbcc,
+    };
+
+    // the current variation
+    uint8_t levels = 0, delay = 0, level = 0;
+    tag_response_info_t *atqa = NULL, *uid = NULL, *sak = NULL;
+    uint8_t done = 0;
+    bool started = false;
+
+    int res = PM3_SUCCESS;
+    int len = 0;
+    uint32_t last = GetTickCount();
 
     LED_A_ON();
     for (;;) {
         WDT_HIT();
 
-        // Clean receive command buffer
-        if (!GetIso14443aCommandFromReader(received, receivedPar, &len)) {
-            Dbprintf("Anti-fuzz stopped. Trace length: %d ", BigBuf_get_traceLen());
-            break;
+        if (GetTickCount() - last > 1000) {
+            reply_ng(CMD_HF_ISO14443A_ANTIFUZZ, PM3_EPARTIAL, (uint8_t *)&resp, sizeof(resp));
+            last = GetTickCount();
         }
-        if (received[0] == ISO14443A_CMD_WUPA || received[0] == ISO14443A_CMD_REQA) {
-            resp[0] = 0x04;
-            resp[1] = 0x00;
 
-            if ((flags & FLAG_7B_UID_IN_DATA) == FLAG_7B_UID_IN_DATA) {
-                resp[0] = 0x44;
-            }
-
-            EmSendCmd(resp, 2);
-            continue;
+        sim_deadline = last + 1000;
+        if (GetIso14443aCommandFromReader(received, receivedPar, &len) == false) {
+            if (GetTickCount() > sim_deadline && BUTTON_PRESS() == false && data_available() == false)
+                continue;
+            res = PM3_EOPABORTED;
+            break;
         }
 
-        // Received request for UID (cascade 1)
-        //if (received[1] >= 0x20 && received[1] <= 0x57 && received[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT) {
-        if (received[1] >= 0x20 && received[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT) {
-            resp[0] = 0xFF;
-            resp[1] = 0xFF;
-            resp[2] = 0xFF;
-            resp[3] = 0xFF;
-            resp[4] =  resp[0] ^ resp[1] ^ resp[2] ^ resp[3];
-            colpos = 0;
+        uint8_t cmd = received[0];
+        tag_response_info_t *answer = NULL;
 
-            if ((flags & FLAG_7B_UID_IN_DATA) == FLAG_7B_UID_IN_DATA) {
-                resp[0] = 0x88;
-                colpos = 8;
+        if (len == 1 && (cmd == ISO14443A_CMD_REQA || cmd == ISO14443A_CMD_WUPA)) {
+            if (started == false || done == activations) {
+                if (started && ++resp.variation == resp.variations) {
+                    resp.variation = 0;
+                    if (++resp.round == p->rounds)
+                        break;
+                }
+                started = true;
+                done = 0;
+
+                // slowest to fastest changing: uid length, atqa, sak, delay, bcc
+                uint32_t v = resp.variation;
+                uint8_t bcc = v % nbcc;
+                v /= nbcc;
+                delay = p->delay_n ? p->delay[v % ndelay] : 0;
+                v /= ndelay;
+                sak = &r_sak[v % nsak];
+                v /= nsak;
+                uint8_t li = v / natqa;
+                atqa = &r_atqa[p->atqa_n ? v % natqa : li];
+                uid = &r_uid[li * 3 * 2 + bcc];
+                levels = collide ? 1 : (lens[li] == 4) ? 1 : (lens[li] == 7) ? 2 : 3;
             }
+            done++;
+            resp.activations++;
+            level = 0;
+            answer = atqa;
+        } else if (len >= 2 && (cmd == ISO14443A_CMD_ANTICOLL_OR_SELECT || cmd == ISO14443A_CMD_ANTICOLL_OR_SELECT_2 || cmd == ISO14443A_CMD_ANTICOLL_OR_SELECT_3)) {
+            uint8_t cl = (cmd - ISO14443A_CMD_ANTICOLL_OR_SELECT) / 2;
+            tag_response_info_t *frame_cl = &uid[cl * 2];
+
+            if (collide) {
+                if (cl == 0 && levels && received[1] >= 0x20) {
+                    answer = frame_cl;
+                    LED_D_INV();
+                }
+            } else if (cl == level && cl < levels) {
+                if (received[1] == 0x20) {
+                    answer = frame_cl;
+                } else if (received[1] == 0x70 && len == 9 && memcmp(received + 2, frame_cl->response, 4) == 0) {
+                    // on the uid bytes alone, a reader going on with a bad bcc gets its sak
+                    if (++level == levels) {
+                        resp.selects++;
+                        answer = sak;
+                    } else {
+                        answer = &r_sak[nsak];
+                    }
+                    LED_D_INV();
+                }
+            }
+        } else if (len == 4 && cmd == ISO14443A_CMD_HALT) {
+            level = 0;
+        }
 
-            EmSendCmdEx(resp, 5, true);
-            if (DBGLEVEL >= DBG_EXTENDED) Dbprintf("ANTICOLL or SELECT %x", received[1]);
-            LED_D_INV();
-
-            continue;
-        } else if (received[1] == 0x20 && received[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT_2) {  // Received request for UID (cascade 2)
-            if (DBGLEVEL >= DBG_EXTENDED) Dbprintf("ANTICOLL or SELECT_2");
-        } else if (received[1] == 0x70 && received[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT) {    // Received a SELECT (cascade 1)
-        } else if (received[1] == 0x70 && received[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT_2) {  // Received a SELECT (cascade 2)
+        if (answer) {
+            EmSendPrecompiledCmdDelayed(answer, delay);
         } else {
-            Dbprintf("unknown command %x", received[0]);
+            // not answered, the frame of the reader is still what the fuzzing is about
+            LogTrace(Uart.output, Uart.len, Uart.startTime * 16 - DELAY_AIR2ARM_AS_TAG, Uart.endTime * 16 - DELAY_AIR2ARM_AS_TAG, Uart.parity, true);
         }
     }
+    sim_deadline = 0;
 
-    reply_old(CMD_ACK, 1, 0, 0, 0, 0);
+    if (DBGLEVEL >= DBG_INFO)
+        Dbprintf("Anti-fuzz stopped. Trace length: %d ", BigBuf_get_traceLen());
+
+    reply_ng(CMD_HF_ISO14443A_ANTIFUZZ, res, (uint8_t *)&resp, sizeof(resp));
     switch_off();
     BigBuf_free_keep_EM();
 }
@@ -2394,10 +2839,13 @@ static void iso14a_set_ATS_times(uint8_t *ats) {
     }
 }
 
+// REQA instead leaves the halted cards out, for the inventory
+static uint8_t atqa_request = ISO14443A_CMD_WUPA;
+
 static int GetATQA(uint8_t *resp, uint8_t *resp_par) {
 
 #define WUPA_RETRY_TIMEOUT 10    // 10ms
-    uint8_t wupa[] = { ISO14443A_CMD_WUPA };  // 0x26 - REQA  0x52 - WAKE-UP
+    uint8_t wupa[] = { atqa_request };  // 0x26 - REQA  0x52 - WAKE-UP
 
     uint32_t save_iso14a_timeout = iso14a_get_timeout();
     iso14a_set_timeout(1236 / (16 * 8) + 1);  // response to WUPA is expected at exactly 1236/fc. No need to wait longer.
@@ -2438,6 +2886,10 @@ int iso14443a_select_card(uint8_t *uid_ptr, iso14a_card_select_t *p_card, uint32
         p_card->ats_len = 0;
     }
 
+    // a new card, learn its latency again
+    if (anticollision)
+        iso14a_adaptive_reset();
+
     if (!GetATQA(resp, resp_par)) {
         return 0;
     }
@@ -2473,7 +2925,7 @@ int iso14443a_select_card(uint8_t *uid_ptr, iso14a_card_select_t *p_card, uint32
         if (anticollision) {
             // SELECT_ALL
             ReaderTransmit(sel_all, sizeof(sel_all), NULL);
-            if (!ReaderReceive(resp, resp_par)) {
+            if (!ReaderReceiveFixedDelay(resp, resp_par)) {
                 Dbprintf("Card didn't answer to CL%i select all", cascade_level + 1);
                 return 0;
             }
@@ -2548,7 +3000,7 @@ int iso14443a_select_card(uint8_t *uid_ptr, iso14a_card_select_t *p_card, uint32
         ReaderTransmit(sel_uid, sizeof(sel_uid), NULL);
 
         // Receive the SAK
-        if (!ReaderReceive(resp, resp_par)) {
+        if (!ReaderReceiveFixedDelay(resp, resp_par)) {
             Dbprintf("Card didn't answer to select");
             return 0;
         }
@@ -2657,7 +3109,7 @@ int iso14443a_fast_select_card(uint8_t *uid_ptr, uint8_t num_cascades) {
         ReaderTransmit(sel_uid, sizeof(sel_uid), NULL);
 
         // Receive the SAK
-        if (!ReaderReceive(resp, resp_par)) return 0;
+        if (!ReaderReceiveFixedDelay(resp, resp_par)) return 0;
 
         sak = resp[0];
 
@@ -2809,6 +3261,458 @@ int iso14_apdu(uint8_t *cmd, uint16_t cmd_len, bool send_chaining, void *data, u
     return len;
 }
 
+// One APDU through the block protocol, in I-blocks of fsc bytes, PCB and CRC included (0: one I-block), the
+// chained answer fetched with R(ACK). The answer goes to out, when out is full it goes to flush first, without
+// a flush the answer is too long. Returns an ISO14A_APDU_ error
+typedef void (*iso14a_apdu_flush_t)(uint8_t *out, uint16_t len, void *arg);
+
+static uint8_t iso14a_apdu_run(uint8_t *apdu, uint16_t len, uint16_t fsc, uint8_t *out, uint16_t outmax, uint16_t *outlen,
+                               iso14a_apdu_flush_t flush, void *arg) {
+    uint8_t buf[MAX_FRAME_SIZE];
+    uint8_t pcb = 0;
+    // PCB and CRC around every part
+    uint16_t part = (fsc > 3) ? fsc - 3 : len;
+
+    *outlen = 0;
+    if (len == 0)
+        return ISO14A_APDU_SHORT;
+
+    int rlen = 0;
+    uint16_t sent = 0;
+    while (sent < len) {
+        uint16_t n = MIN(part, len - sent);
+        bool more = (sent + n < len);
+        rlen = iso14_apdu(apdu + sent, n, more, buf, &pcb);
+        sent += n;
+
+        // every chained I-block is acknowledged with R(ACK)
+        if (more && (rlen <= 0 || (pcb & 0xF2) != 0xA2))
+            return ISO14A_APDU_CHAIN;
+    }
+
+    for (;;) {
+        if (rlen == 0)
+            return ISO14A_APDU_NO_ANSWER;
+        if (rlen < 0)
+            return ISO14A_APDU_CRC;
+        // PCB is cut, the CRC is still there
+        if (rlen < 2 || (pcb & 0xC0) != 0)
+            return ISO14A_APDU_SHORT;
+        rlen -= 2;
+
+        if (*outlen + rlen > outmax) {
+            if (flush == NULL)
+                return ISO14A_APDU_SHORT;
+            flush(out, *outlen, arg);
+            *outlen = 0;
+        }
+        memcpy(out + *outlen, buf, rlen);
+        *outlen += rlen;
+
+        if ((pcb & 0x10) == 0)
+            return ISO14A_APDU_OK;
+
+        WDT_HIT();
+        // R(ACK) for the next block of the answer
+        rlen = iso14_apdu(NULL, 0, false, buf, &pcb);
+    }
+}
+
+static void apdu_flush(uint8_t *out, uint16_t len, void *arg) {
+    iso14a_apdu_resp_t *resp = (iso14a_apdu_resp_t *)arg;
+    resp->len = len;
+    reply_ng(CMD_HF_ISO14443A_APDU, PM3_SUCCESS, (uint8_t *)resp, sizeof(*resp) - sizeof(resp->data) + resp->len);
+}
+
+// The whole block protocol of one APDU, the client only sees the APDU and its answer. The block
+// number is iso14_apdu's, so it stays in step with the ISO14A_APDU frames of CMD_HF_ISO14443A_READER
+void ReaderIso14443aAPDU(iso14a_apdu_req_t *req) {
+    iso14a_apdu_resp_t resp;
+    resp.final = false;
+    resp.error = ISO14A_APDU_OK;
+    resp.len = 0;
+
+    set_tracing(true);
+    LED_A_ON();
+
+    uint16_t len = MIN(req->len, sizeof(req->apdu));
+    uint16_t n = 0;
+    resp.error = iso14a_apdu_run(req->apdu, len, req->fsc, resp.data, sizeof(resp.data), &n, apdu_flush, &resp);
+    resp.len = n;
+    FpgaDisableTracing();
+
+    resp.final = true;
+    reply_ng(CMD_HF_ISO14443A_APDU, PM3_SUCCESS, (uint8_t *)&resp, sizeof(resp) - sizeof(resp.data) + resp.len);
+    LED_A_OFF();
+}
+
+static void read_binary_flush(iso14a_read_binary_resp_t *resp) {
+    FpgaDisableTracing();
+    reply_ng(CMD_HF_ISO14443A_READ_BINARY, PM3_SUCCESS, (uint8_t *)resp, sizeof(*resp) - sizeof(resp->data) + resp->len);
+    set_tracing(true);
+    resp->len = 0;
+}
+
+// 00 B0 READ BINARY of n bytes at offset, the data to out. Returns an ISO14A_APDU_ error, sw is the status word
+static uint8_t read_binary_apdu(uint16_t fsc, uint16_t offset, uint16_t n, uint8_t *out, uint16_t *outlen, uint16_t *sw) {
+    uint8_t apdu[] = { 0x00, 0xB0, offset >> 8, offset & 0xFF, n & 0xFF };  // Le 00 is 256
+    uint8_t answer[256 + 2];
+    uint16_t alen = 0;
+
+    *outlen = 0;
+    uint8_t err = iso14a_apdu_run(apdu, sizeof(apdu), fsc, answer, sizeof(answer), &alen, NULL, NULL);
+    if (err != ISO14A_APDU_OK)
+        return err;
+    if (alen < 2 || alen - 2 > n)
+        return ISO14A_APDU_SHORT;
+
+    *sw = answer[alen - 2] << 8 | answer[alen - 1];
+    *outlen = alen - 2;
+    memcpy(out, answer, *outlen);
+    return ISO14A_APDU_OK;
+}
+
+// A whole file of the selected ISO14443-4 card, READ BINARY after READ BINARY on the device
+void ReaderIso14443aReadBinary(iso14a_read_binary_req_t *req) {
+    iso14a_read_binary_resp_t resp;
+    memset(&resp, 0, sizeof(resp));
+    resp.sw = 0x9000;
+
+    uint8_t data[256];
+    uint16_t sw = 0x9000;
+    uint16_t le = (req->le == 0 || req->le > 256) ? 256 : req->le;
+    uint16_t total = req->len;
+    uint16_t offset = req->offset;
+
+    set_tracing(true);
+    LED_A_ON();
+
+    if (req->fid) {
+        uint8_t select[] = { 0x00, 0xA4, 0x00, 0x0C, 0x02, req->fid >> 8, req->fid & 0xFF };
+        uint16_t n = 0;
+        resp.error = iso14a_apdu_run(select, sizeof(select), req->fsc, data, sizeof(data), &n, NULL, NULL);
+        if (resp.error == ISO14A_APDU_OK && n >= 2)
+            resp.sw = data[n - 2] << 8 | data[n - 1];
+        else if (resp.error == ISO14A_APDU_OK)
+            resp.error = ISO14A_APDU_SHORT;
+    }
+
+    // NLEN in front, the file is that long and NLEN itself
+    if (req->nlen && resp.error == ISO14A_APDU_OK && resp.sw == 0x9000) {
+        uint16_t n = 0;
+        resp.error = read_binary_apdu(req->fsc, offset, 2, data, &n, &sw);
+        resp.sw = sw;
+        if (resp.error == ISO14A_APDU_OK && resp.sw == 0x9000 && n == 2) {
+            total = MIN(total, 2 + (data[0] << 8 | data[1]));
+            memcpy(resp.data, data, 2);
+            resp.len = 2;
+            resp.read = 2;
+            offset += 2;
+        } else if (resp.error == ISO14A_APDU_OK && resp.sw == 0x9000) {
+            resp.error = ISO14A_APDU_SHORT;
+        }
+    }
+
+    while (resp.error == ISO14A_APDU_OK && resp.sw == 0x9000 && resp.read < total) {
+        if (BUTTON_PRESS() || data_available())
+            break;
+
+        uint16_t n = 0;
+        resp.error = read_binary_apdu(req->fsc, offset, MIN(le, total - resp.read), data, &n, &sw);
+        resp.sw = sw;
+        // end of the file
+        if (n == 0)
+            break;
+
+        if (resp.len + n > sizeof(resp.data))
+            read_binary_flush(&resp);
+        memcpy(resp.data + resp.len, data, n);
+        resp.len += n;
+        resp.read += n;
+        offset += n;
+    }
+    FpgaDisableTracing();
+
+    resp.final = true;
+    reply_ng(CMD_HF_ISO14443A_READ_BINARY, PM3_SUCCESS, (uint8_t *)&resp, sizeof(resp) - sizeof(resp.data) + resp.len);
+    LED_A_OFF();
+}
+
+// The image frames of a Waveshare e-paper tag, the tag stays selected in between like with ISO14A_NO_DISCONNECT.
+// A frame the tag does not answer with 00 00 is sent again, like the client did it frame by frame
+void ReaderIso14443aWaveshare(wshare_upload_req_t *req) {
+    uint8_t frame[3 + UINT8_MAX + 2];
+    uint8_t buf[MAX_FRAME_SIZE];
+    uint8_t par[MAX_PARITY_SIZE];
+    uint8_t sent = 0;
+    int res = PM3_SUCCESS;
+
+    uint8_t count = req->count;
+    if (req->len == 0 || (uint16_t)req->len * count > sizeof(req->data))
+        count = 0;
+
+    set_tracing(true);
+    LED_A_ON();
+
+    for (; sent < count; sent++) {
+        frame[0] = 0xCD;
+        frame[1] = req->cmd;
+        frame[2] = req->len;
+        memcpy(frame + 3, req->data + sent * req->len, req->len);
+        AddCrc14A(frame, 3 + req->len);
+
+        uint8_t tries = 0;
+        for (; tries <= WSHARE_UPLOAD_RETRIES; tries++) {
+            WDT_HIT();
+            ReaderTransmit(frame, 3 + req->len + 2, NULL);
+            int len = ReaderReceive(buf, par);
+            if (len >= 2 && buf[0] == 0x00 && buf[1] == 0x00)
+                break;
+        }
+        if (tries > WSHARE_UPLOAD_RETRIES || BUTTON_PRESS() || data_available()) {
+            res = PM3_ECARDEXCHANGE;
+            break;
+        }
+        if (req->delay)
+            SpinDelay(req->delay);
+    }
+    FpgaDisableTracing();
+
+    reply_ng(CMD_HF_WAVESHARE_UPLOAD, res, &sent, sizeof(sent));
+    LED_A_OFF();
+}
+
+void ReaderIso14443aCUIDs(iso14a_cuids_req_t *req) {
+    iso14a_cuids_frame_t *frame = (iso14a_cuids_frame_t *)BigBuf_malloc(sizeof(iso14a_cuids_frame_t));
+    if (frame == NULL) {
+        reply_ng(CMD_HF_ISO14443A_CUIDS, PM3_EMALLOC, NULL, 0);
+        return;
+    }
+    memset(frame, 0, sizeof(iso14a_cuids_frame_t));
+
+    uint32_t count = req->count;
+    int res = PM3_SUCCESS;
+
+    // the trace would only slow it down
+    set_tracing(false);
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+    LED_A_ON();
+
+    while (count == 0 || frame->collected + frame->failed < count) {
+        WDT_HIT();
+        if (BUTTON_PRESS() || data_available()) {
+            res = PM3_EOPABORTED;
+            break;
+        }
+
+        iso14a_field_cycle(req->off_ms);
+
+        iso14a_card_select_t card;
+        if (iso14443a_select_card(NULL, &card, NULL, true, 0, true) == 0) {
+            frame->failed++;
+            continue;
+        }
+
+        iso14a_cuid_t *u = &frame->uids[frame->n++];
+        u->uidlen = MIN(card.uidlen, sizeof(u->uid));
+        memcpy(u->uid, card.uid, u->uidlen);
+        frame->collected++;
+
+        if (frame->n == ISO14A_CUIDS_FRAME) {
+            reply_ng(CMD_HF_ISO14443A_CUIDS, PM3_EPARTIAL, (uint8_t *)frame, sizeof(iso14a_cuids_frame_t));
+            frame->n = 0;
+        }
+    }
+
+    hf_field_off();
+    frame->final = true;
+    reply_ng(CMD_HF_ISO14443A_CUIDS, res, (uint8_t *)frame, sizeof(iso14a_cuids_frame_t));
+    BigBuf_free_keep_EM();
+    set_tracing(true);
+}
+
+void ReaderIso14443aInventory(iso14a_inventory_req_t *req) {
+    iso14a_cuid_t *seen = (iso14a_cuid_t *)BigBuf_malloc(ISO14A_INVENTORY_MAX * sizeof(iso14a_cuid_t));
+    if (seen == NULL) {
+        reply_ng(CMD_HF_ISO14443A_INVENTORY, PM3_EMALLOC, NULL, 0);
+        return;
+    }
+
+    uint8_t count = 0;
+    int res = PM3_SUCCESS;
+
+    clear_trace();
+    set_tracing(true);
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+    LED_A_ON();
+
+    atqa_request = ISO14443A_CMD_REQA;
+    while (count < ISO14A_INVENTORY_MAX) {
+        WDT_HIT();
+        if (BUTTON_PRESS() || data_available()) {
+            res = PM3_EOPABORTED;
+            break;
+        }
+
+        // no answer to REQA any more, every card is halted
+        iso14a_card_select_t card;
+        int sel = iso14443a_select_card(NULL, &card, NULL, true, 0, req->no_rats);
+        if (sel == 0 || sel == 3)
+            break;
+
+        bool again = false;
+        for (uint8_t i = 0; i < count && again == false; i++)
+            again = (seen[i].uidlen == card.uidlen && memcmp(seen[i].uid, card.uid, card.uidlen) == 0);
+        if (again) {
+            res = PM3_ESOFT;
+            break;
+        }
+        seen[count].uidlen = card.uidlen;
+        memcpy(seen[count].uid, card.uid, sizeof(seen[count].uid));
+        count++;
+
+        FpgaDisableTracing();
+        reply_ng(CMD_HF_ISO14443A_INVENTORY, PM3_EPARTIAL, (uint8_t *)&card, sizeof(iso14a_card_select_t));
+        set_tracing(true);
+
+        if (card.ats_len) {
+            uint8_t deselect[] = { 0xC2, 0x00, 0x00 };
+            uint8_t buf[MAX_FRAME_SIZE];
+            uint8_t par[MAX_PARITY_SIZE];
+            AddCrc14A(deselect, 1);
+            ReaderTransmit(deselect, sizeof(deselect), NULL);
+            ReaderReceive(buf, par);
+        } else {
+            uint8_t hlta[] = { ISO14443A_CMD_HALT, 0x00, 0x00, 0x00 };
+            AddCrc14A(hlta, 2);
+            ReaderTransmit(hlta, sizeof(hlta), NULL);
+        }
+    }
+    atqa_request = ISO14443A_CMD_WUPA;
+
+    FpgaDisableTracing();
+    hf_field_off();
+    reply_ng(CMD_HF_ISO14443A_INVENTORY, res, &count, sizeof(count));
+    BigBuf_free_keep_EM();
+}
+
+// Topaz frames go out with a short first byte and without parity. All but WUPA and its ATQA carry a CRC_B.
+// Returns the length of the answer, CRC checked and left out. -1 when the tag didn't answer right
+static int topaz_exchange(uint8_t *cmd, uint8_t len, uint8_t *resp, uint16_t resp_len) {
+    uint8_t par[MAX_PARITY_SIZE];
+    bool crc = (len > 1);
+
+    if (crc) {
+        AddCrc14B(cmd, len);
+        len += 2;
+    }
+    ReaderTransmitBitsPar(&cmd[0], 7, NULL, NULL);
+    for (uint8_t i = 1; i < len; i++)
+        ReaderTransmitBitsPar(&cmd[i], 8, NULL, NULL);
+
+    int n = ReaderReceive(resp, par);
+    if (n != resp_len + (crc ? 2 : 0))
+        return -1;
+    if (crc && check_crc(CRC_14443_B, resp, n) == false)
+        return -1;
+    return resp_len;
+}
+
+void ReaderTopazReadAll(void) {
+    uint8_t *mem = BigBuf_malloc(TOPAZ_MAX_MEMORY);
+    if (mem == NULL) {
+        reply_ng(CMD_HF_TOPAZ_READALL, PM3_EMALLOC, NULL, 0);
+        return;
+    }
+
+    uint8_t buf[MAX_FRAME_SIZE];
+    uint8_t cmd[16];
+    uint8_t uid[4];
+    topaz_readall_resp_t resp;
+    memset(&resp, 0, sizeof(resp));
+    int res = PM3_SUCCESS;
+
+    clear_trace();
+    set_tracing(true);
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+    LED_A_ON();
+
+    // the ATQA of a Topaz is 0C 00, same check as the client always did
+    cmd[0] = TOPAZ_WUPA;
+    if (topaz_exchange(cmd, 1, buf, 2) < 0 || (buf[1] != 0x0C && buf[0] != 0x00)) {
+        res = PM3_ESOFT;
+        goto out;
+    }
+
+    // HR0 HR1 UID0..3
+    memset(cmd, 0, sizeof(cmd));
+    cmd[0] = TOPAZ_RID;
+    if (topaz_exchange(cmd, 7, buf, 6) < 0) {
+        res = PM3_ESOFT;
+        goto out;
+    }
+    memcpy(resp.hr, buf, 2);
+    memcpy(uid, buf + 2, 4);
+
+    // HR0 HR1 and the static memory, blocks 0x00 to 0x0E
+    memset(cmd, 0, sizeof(cmd));
+    cmd[0] = TOPAZ_RALL;
+    memcpy(cmd + 3, uid, 4);
+    if (topaz_exchange(cmd, 7, buf, 2 + TOPAZ_STATIC_MEMORY) < 0) {
+        res = PM3_ECARDEXCHANGE;
+        goto out;
+    }
+    memcpy(mem, buf + 2, TOPAZ_STATIC_MEMORY);
+    resp.size = TOPAZ_STATIC_MEMORY;
+
+    // a dynamic memory map, with the size in its CC
+    if ((resp.hr[0] & 0x0F) != 0x01 && mem[8] == 0xE1) {
+        uint16_t size = MIN((mem[10] + 1) * 8, TOPAZ_MAX_MEMORY);
+        if (size > TOPAZ_STATIC_MEMORY) {
+            // the last block of segment 0
+            memset(cmd, 0, sizeof(cmd));
+            cmd[0] = TOPAZ_READ8;
+            cmd[1] = 0x0F;
+            memcpy(cmd + 10, uid, 4);
+            if (topaz_exchange(cmd, 14, buf, 1 + 8) < 0) {
+                res = PM3_ECARDEXCHANGE;
+                goto out;
+            }
+            memcpy(mem + TOPAZ_STATIC_MEMORY, buf + 1, 8);
+            resp.size = TOPAZ_STATIC_MEMORY + 8;
+
+            for (uint8_t seg = 1; seg < size / TOPAZ_SEGMENT_SIZE; seg++) {
+                WDT_HIT();
+                memset(cmd, 0, sizeof(cmd));
+                cmd[0] = TOPAZ_RSEG;
+                cmd[1] = seg << 4;
+                memcpy(cmd + 10, uid, 4);
+                if (topaz_exchange(cmd, 14, buf, 1 + TOPAZ_SEGMENT_SIZE) < 0) {
+                    res = PM3_ECARDEXCHANGE;
+                    goto out;
+                }
+                memcpy(mem + seg * TOPAZ_SEGMENT_SIZE, buf + 1, TOPAZ_SEGMENT_SIZE);
+                resp.size = (seg + 1) * TOPAZ_SEGMENT_SIZE;
+            }
+        }
+    }
+
+out:
+    FpgaDisableTracing();
+    hf_field_off();
+
+    // what was read, also when the tag went away halfway
+    do {
+        resp.len = MIN(resp.size - resp.offset, TOPAZ_READALL_CHUNK);
+        memcpy(resp.data, mem + resp.offset, resp.len);
+        bool last = (resp.offset + resp.len >= resp.size);
+        reply_ng(CMD_HF_TOPAZ_READALL, (last) ? res : PM3_EPARTIAL, (uint8_t *)&resp, sizeof(resp));
+        resp.offset += resp.len;
+    } while (resp.offset < resp.size);
+    LED_A_OFF();
+    BigBuf_free_keep_EM();
+}
+
 //-----------------------------------------------------------------------------
 // Read an ISO 14443a tag. Send out commands and store answers.
 //-----------------------------------------------------------------------------
@@ -2866,6 +3770,13 @@ void ReaderIso14443a(PacketCommandNG *c) {
 
     if ((param & ISO14A_RAW)) {
 
+        // the tear-off offset follows the frame, before the CRC takes its place
+        if ((param & ISO14A_TEAROFF) && len + 4 <= PM3_CMD_DATA_SIZE) {
+            uint32_t offset;
+            memcpy(&offset, cmd + len, sizeof(offset));
+            iso14a_tearoff_arm(offset);
+        }
+
         if ((param & ISO14A_APPEND_CRC)) {
             // Don't append crc on empty bytearray...
             if (len > 0) {
@@ -2904,6 +3815,7 @@ void ReaderIso14443a(PacketCommandNG *c) {
                 ReaderTransmit(cmd, len, NULL);                                         // 8 bits, odd parity
             }
         }
+        iso14a_tearoff_disarm();
         arg0 = ReaderReceive(buf, par);
         FpgaDisableTracing();
 
@@ -2921,6 +3833,148 @@ OUT:
     set_tracing(false);
 }
 
+// sends frame, with CRC if asked, answer and its length get at most ISO14A_TEAROFF_ANSWER bytes.
+// false without an answer
+static bool tearoff_exchange(const uint8_t *frame, uint8_t len, bool crc, uint8_t *answer, uint8_t *answer_len) {
+    uint8_t cmd[MAX_FRAME_SIZE] = {0};
+    uint8_t resp[MAX_FRAME_SIZE] = {0};
+    uint8_t resp_par[MAX_PARITY_SIZE] = {0};
+
+    memcpy(cmd, frame, len);
+    if (crc) {
+        AddCrc14A(cmd, len);
+        len += 2;
+    }
+    ReaderTransmit(cmd, len, NULL);
+
+    int res = ReaderReceive(resp, resp_par);
+    if (answer) {
+        *answer_len = MIN(res, ISO14A_TEAROFF_ANSWER);
+        memcpy(answer, resp, *answer_len);
+    }
+    return (res > 0);
+}
+
+// select, setup frames, readback. false if the tag got lost on the way
+static bool tearoff_session(const iso14a_tearoff_sweep_req_t *req, uint8_t *answer, uint8_t *answer_len) {
+    bool crc = (req->flags & ISO14A_TEAROFF_CRC);
+
+    if (iso14443a_select_card(NULL, NULL, NULL, true, 0, (req->flags & ISO14A_TEAROFF_RATS) == 0) == 0)
+        return false;
+
+    for (uint16_t i = 0; i < req->setup_len; i += 1 + req->data[i]) {
+        if (tearoff_exchange(req->data + i + 1, req->data[i], crc, NULL, NULL) == false)
+            return false;
+    }
+
+    if (req->readback_len) {
+        const uint8_t *readback = req->data + req->setup_len + req->frame_len;
+        if (tearoff_exchange(readback, req->readback_len, crc, answer, answer_len) == false)
+            return false;
+    }
+    return true;
+}
+
+static void tearoff_send(iso14a_tearoff_frame_t *frame, const iso14a_tearoff_entry_t *log, uint16_t *sent, uint16_t logged, bool final, int status) {
+    do {
+        frame->first = *sent;
+        frame->count = MIN(logged - *sent, ISO14A_TEAROFF_FRAME_ENTRIES);
+        memcpy(frame->entries, log + *sent, frame->count * sizeof(iso14a_tearoff_entry_t));
+        *sent += frame->count;
+        frame->final = final && (*sent == logged);
+        reply_ng(CMD_HF_ISO14443A_TEAROFF_SWEEP, frame->final ? status : PM3_SUCCESS, (uint8_t *)frame,
+                 sizeof(iso14a_tearoff_frame_t) - sizeof(frame->entries) + frame->count * sizeof(iso14a_tearoff_entry_t));
+    } while (*sent < logged && (final || logged - *sent >= ISO14A_TEAROFF_FRAME_ENTRIES));
+}
+
+// Tear-off sweep of a raw frame over ssp clock offsets, see iso14a_tearoff_sweep_req_t
+void ReaderIso14443aTearoffSweep(iso14a_tearoff_sweep_req_t *req) {
+    int status = PM3_SUCCESS;
+    uint16_t logged = 0;
+    uint16_t sent = 0;
+
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+
+    // the log takes the room of the trace
+    clear_trace();
+    set_tracing(false);
+    BigBuf_free();
+
+    iso14a_tearoff_entry_t *log = (iso14a_tearoff_entry_t *)BigBuf_malloc(ISO14A_TEAROFF_LOG_ENTRIES * sizeof(iso14a_tearoff_entry_t));
+    iso14a_tearoff_frame_t *frame = (iso14a_tearoff_frame_t *)BigBuf_malloc(sizeof(iso14a_tearoff_frame_t));
+    if (log == NULL || frame == NULL) {
+        hf_field_off();
+        reply_ng(CMD_HF_ISO14443A_TEAROFF_SWEEP, PM3_EMALLOC, NULL, 0);
+        return;
+    }
+
+    if (req->frame_len == 0 || req->frame_len > ISO14A_TEAROFF_FRAME_MAX || req->readback_len > ISO14A_TEAROFF_FRAME_MAX
+            || req->setup_len + req->frame_len + req->readback_len > sizeof(req->data)) {
+        status = PM3_EINVARG;
+        goto out;
+    }
+    for (uint16_t i = 0; i < req->setup_len; i += 1 + req->data[i]) {
+        if (req->data[i] == 0 || req->data[i] > ISO14A_TEAROFF_FRAME_MAX || i + 1 + req->data[i] > req->setup_len) {
+            status = PM3_EINVARG;
+            goto out;
+        }
+    }
+
+    const uint8_t *torn = req->data + req->setup_len;
+    bool crc = (req->flags & ISO14A_TEAROFF_CRC);
+    uint32_t step = MAX(req->step, 1);
+    uint8_t repeat = MAX(req->repeat, 1);
+
+    for (uint32_t offset = req->start; offset <= req->end; offset += step) {
+        for (uint8_t r = 0; r < repeat; r++) {
+            WDT_HIT();
+
+            if (BUTTON_PRESS() || data_available()) {
+                status = PM3_EOPABORTED;
+                goto out;
+            }
+            if (logged == ISO14A_TEAROFF_LOG_ENTRIES) {
+                status = PM3_EOVFLOW;
+                goto out;
+            }
+
+            iso14a_tearoff_entry_t *e = &log[logged++];
+            memset(e, 0, sizeof(iso14a_tearoff_entry_t));
+            e->offset = offset;
+
+            iso14a_field_cycle(ISO14A_TEAROFF_OFF_MS);
+            if (tearoff_session(req, e->before, &e->before_len) == false) {
+                e->status = ISO14A_TEAROFF_NO_TAG;
+            } else {
+                iso14a_tearoff_arm(offset);
+                tearoff_exchange(torn, req->frame_len, crc, NULL, NULL);
+                iso14a_tearoff_disarm();
+
+                iso14a_field_cycle(ISO14A_TEAROFF_OFF_MS);
+                if (tearoff_session(req, e->after, &e->after_len) == false)
+                    e->status = ISO14A_TEAROFF_LOST;
+                else if (e->before_len != e->after_len || memcmp(e->before, e->after, e->after_len))
+                    e->status = ISO14A_TEAROFF_CHANGED;
+            }
+
+            if (logged - sent >= ISO14A_TEAROFF_FRAME_ENTRIES)
+                tearoff_send(frame, log, &sent, logged, false, PM3_SUCCESS);
+
+            if (e->status == ISO14A_TEAROFF_CHANGED && (req->flags & ISO14A_TEAROFF_STOP_CHANGED))
+                goto out;
+        }
+
+        // end close to UINT32_MAX
+        if (req->end - offset < step)
+            break;
+    }
+
+out:
+    hf_field_off();
+    tearoff_send(frame, log, &sent, logged, true, status);
+    BigBuf_free();
+}
+
 // Determine the distance between two nonces.
 // Assume that the difference is small, but we don't know which is first.
 // Therefore try in alternating directions.
@@ -2952,8 +4006,10 @@ static int32_t dist_nt(uint32_t nt1, uint32_t nt2) {
 // the algorithm described in "The Dark Side of Security by Obscurity and
 // Cloning MiFare Classic Rail and Building Passes, Anywhere, Anytime"
 // (article by Nicolas T. Courtois, 2009)
+// stream: don't stop after the first tuple, send each one as CMD_HF_MIFARE_READER_STREAM frame
+// and go on with the next reader nonce until CMD_BREAK_LOOP or button
 //-----------------------------------------------------------------------------
-void ReaderMifare(bool first_try, uint8_t block, uint8_t keytype) {
+void ReaderMifare(bool first_try, uint8_t block, uint8_t keytype, bool stream) {
 
     iso14443a_setup(FPGA_HF_ISO14443A_READER_MOD);
 
@@ -2994,6 +4050,7 @@ void ReaderMifare(bool first_try, uint8_t block, uint8_t keytype) {
     static uint8_t mf_nr_ar3 = 0;
 
     int return_status = PM3_SUCCESS;
+    mf_darkside_stream_frame_t frame = {0};
 
     AddCrc14A(mf_auth, 2);
 
@@ -3076,7 +4133,7 @@ void ReaderMifare(bool first_try, uint8_t block, uint8_t keytype) {
         ReaderTransmit(mf_auth, sizeof(mf_auth), &sync_time);
 
         // Receive the (4 Byte) "random" TAG nonce
-        if (!ReaderReceive(receivedAnswer, receivedAnswerPar))
+        if (!ReaderReceiveFixedDelay(receivedAnswer, receivedAnswerPar))
             continue;
 
         previous_nt = nt;
@@ -3086,7 +4143,7 @@ void ReaderMifare(bool first_try, uint8_t block, uint8_t keytype) {
         ReaderTransmitPar(mf_nr_ar, sizeof(mf_nr_ar), par, NULL);
 
         // Receive answer. This will be a 4 Bit NACK when the 8 parity bits are OK after decoding
-        int resp_res = ReaderReceive(receivedAnswer, receivedAnswerPar);
+        int resp_res = ReaderReceiveFixedDelay(receivedAnswer, receivedAnswerPar);
         if (resp_res == 1)
             received_nack = true;
         else if (resp_res == 4) {
@@ -3189,7 +4246,30 @@ void ReaderMifare(bool first_try, uint8_t block, uint8_t keytype) {
             // Test if the information is complete
             if (nt_diff == 0x07) {
                 isOK = 1;
-                break;
+                if (stream == false)
+                    break;
+
+                // hand the tuple over, the PRNG stays in sync for the next reader nonce
+                frame.isOK = isOK;
+                num_to_bytes(cuid, 4, frame.cuid);
+                num_to_bytes(nt, 4, frame.nt);
+                memcpy(frame.par_list, par_list, sizeof(frame.par_list));
+                memcpy(frame.ks_list, ks_list, sizeof(frame.ks_list));
+                memcpy(frame.nr, mf_nr_ar, sizeof(frame.nr));
+                frame.nr[3] &= 0x1F;
+                memcpy(frame.ar, mf_nr_ar + 4, sizeof(frame.ar));
+                reply_ng(CMD_HF_MIFARE_READER_STREAM, PM3_SUCCESS, (uint8_t *)&frame, sizeof(frame));
+                frame.seq++;
+
+                first_try = false;
+                isOK = 0;
+                nt_diff = 0;
+                mf_nr_ar3++;
+                mf_nr_ar[3] = mf_nr_ar3;
+                par[0] = par_low;
+                memset(par_list, 0, sizeof(par_list));
+                memset(ks_list, 0, sizeof(ks_list));
+                continue;
             }
 
             nt_diff = (nt_diff + 1) & 0x07;
@@ -3238,7 +4318,13 @@ void ReaderMifare(bool first_try, uint8_t block, uint8_t keytype) {
     memcpy(payload.nr, mf_nr_ar, sizeof(payload.nr));
     memcpy(payload.ar, mf_nr_ar + 4, sizeof(payload.ar));
 
-    reply_ng(CMD_HF_MIFARE_READER, return_status, (uint8_t *)&payload, sizeof(payload));
+    if (stream) {
+        frame.isOK = isOK;
+        frame.final = true;
+        reply_ng(CMD_HF_MIFARE_READER_STREAM, return_status, (uint8_t *)&frame, sizeof(frame));
+    } else {
+        reply_ng(CMD_HF_MIFARE_READER, return_status, (uint8_t *)&payload, sizeof(payload));
+    }
 
     hf_field_off();
     set_tracing(false);
@@ -3247,8 +4333,9 @@ void ReaderMifare(bool first_try, uint8_t block, uint8_t keytype) {
 /*
  * Mifare Classic NACK-bug detection
  * Thanks to @doegox for the feedback and new approaches.
+ * data gets the result, the number of NACKs and the number of authentications, 4 bytes
 */
-void DetectNACKbug(void) {
+int DetectNACKbugEx(uint8_t *data) {
     uint8_t mf_auth[] = {0x60, 0x00, 0xF5, 0x7B};
     uint8_t mf_nr_ar[]    = {0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t uid[10]       = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
@@ -3479,11 +4566,16 @@ void DetectNACKbug(void) {
     // i  =  number of authentications sent.  Not always 256, since we are trying to sync but close to it.
     FpgaDisableTracing();
 
-    uint8_t *data = BigBuf_malloc(4);
     data[0] = isOK;
     data[1] = num_nacks;
     num_to_bytes(i, 2, data + 2);
-    reply_ng(CMD_HF_MIFARE_NACK_DETECT, status, data, 4);
+    return status;
+}
+
+void DetectNACKbug(void) {
+    uint8_t data[4] = {0};
+    int status = DetectNACKbugEx(data);
+    reply_ng(CMD_HF_MIFARE_NACK_DETECT, status, data, sizeof(data));
 
     BigBuf_free();
     hf_field_off();
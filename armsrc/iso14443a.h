@@ -100,6 +100,19 @@ void printHf14aConfig(void);
 void setHf14aConfig(hf14a_config *hc);
 hf14a_config *getHf14aConfig(void);
 void iso14a_set_timeout(uint32_t timeout);
+void iso14a_restart_timing(void);
+
+// Tear-off engine: armed, the field is cut offset ssp clocks (16 / fc, ~1.18us) after the end of the
+// next reader frame. iso14a_field_cycle powers the tag up again afterwards
+#define ISO14A_FIELD_SETTLE_MS      5
+#define ISO14A_TEAROFF_OFF_MS       10
+void iso14a_tearoff_arm(uint32_t offset);
+void iso14a_tearoff_disarm(void);
+void iso14a_field_cycle(uint16_t off_ms);
+uint32_t iso14a_get_last_fdt(void);
+void iso14a_adaptive_reset(void);
+void iso14a_adaptive_learn(void);
+uint32_t iso14a_adaptive_timeout(uint32_t timeout);
 uint32_t iso14a_get_timeout(void);
 
 void GetParity(const uint8_t *pbtCmd, uint16_t len, uint8_t *par);
@@ -113,16 +126,29 @@ void Uart14aInit(uint8_t *data, uint8_t *par);
 RAMFUNC bool MillerDecoding(uint8_t bit, uint32_t non_real_time);
 RAMFUNC int ManchesterDecoding(uint8_t bit, uint16_t offset, uint32_t non_real_time);
 
+// Called between frames while sniffing, returns true if it took long (the sampling restarts then).
+// Standalone modes store the trace with it, the hook may clear_trace() what it kept
+typedef bool (*iso14a_sniff_hook_t)(void);
+void iso14a_set_sniff_hook(iso14a_sniff_hook_t hook);
 void RAMFUNC SniffIso14443a(uint8_t param);
 void SimulateIso14443aTag(uint8_t tagType, uint8_t flags, uint8_t *data);
+void SimulateIso14443aSweep(const sim_sweep_t *p);
 bool SimulateIso14443aInit(int tagType, int flags, uint8_t *data, tag_response_info_t **responses, uint32_t *cuid, uint32_t counters[3], uint8_t tearings[3], uint8_t *pages);
 bool GetIso14443aCommandFromReader(uint8_t *received, uint8_t *par, int *len);
-void iso14443a_antifuzz(uint32_t flags);
+void iso14443a_antifuzz(const iso14a_antifuzz_t *p);
 void ReaderIso14443a(PacketCommandNG *c);
+void ReaderIso14443aTearoffSweep(iso14a_tearoff_sweep_req_t *req);
+void ReaderIso14443aAPDU(iso14a_apdu_req_t *req);
+void ReaderIso14443aReadBinary(iso14a_read_binary_req_t *req);
+void ReaderIso14443aWaveshare(wshare_upload_req_t *req);
+void ReaderIso14443aCUIDs(iso14a_cuids_req_t *req);
+void ReaderIso14443aInventory(iso14a_inventory_req_t *req);
+void ReaderTopazReadAll(void);
 void ReaderTransmit(uint8_t *frame, uint16_t len, uint32_t *timing);
 void ReaderTransmitBitsPar(uint8_t *frame, uint16_t bits, uint8_t *par, uint32_t *timing);
 void ReaderTransmitPar(uint8_t *frame, uint16_t len, uint8_t *par, uint32_t *timing);
 int ReaderReceive(uint8_t *receivedAnswer, uint8_t *par);
+int ReaderReceiveFixedDelay(uint8_t *receivedAnswer, uint8_t *par);
 
 void iso14443a_setup(uint8_t fpga_minor_mode);
 int iso14_apdu(uint8_t *cmd, uint16_t cmd_len, bool send_chaining, void *data, uint8_t *res);
@@ -146,7 +172,8 @@ bool prepare_tag_modulation(tag_response_info_t *response_info, size_t max_buffe
 bool EmLogTrace(uint8_t *reader_data, uint16_t reader_len, uint32_t reader_StartTime, uint32_t reader_EndTime, uint8_t *reader_Parity,
                 uint8_t *tag_data, uint16_t tag_len, uint32_t tag_StartTime, uint32_t tag_EndTime, uint8_t *tag_Parity);
 
-void ReaderMifare(bool first_try, uint8_t block, uint8_t keytype);
+void ReaderMifare(bool first_try, uint8_t block, uint8_t keytype, bool stream);
+int DetectNACKbugEx(uint8_t *data);
 void DetectNACKbug(void);
 
 bool GetIso14443aAnswerFromTag_Thinfilm(uint8_t *receivedResponse, uint8_t *received_len);
@@ -350,6 +350,18 @@ static void iso14b_set_maxframesize(uint16_t size) {
  *          false if we are still waiting for some more
  */
 static RAMFUNC int Handle14443bSampleFromReader(uint8_t bit) {
+
+    // three of four samples inside a data bit and the idle carrier between characters
+    // only count, keep them out of the state machine
+    if (Uart.state == STATE_14B_RECEIVING_DATA && Uart.posCnt != 1) {
+        Uart.posCnt = (Uart.posCnt + 1) & 0x03;
+        return false;
+    }
+    if (Uart.state == STATE_14B_AWAITING_START_BIT && bit && Uart.posCnt < 50 / 2) {
+        Uart.posCnt++;
+        return false;
+    }
+
     switch (Uart.state) {
         case STATE_14B_UNSYNCD:
             if (bit == false) {
@@ -742,6 +754,13 @@ static RAMFUNC int Handle14443bSamplesFromTag(int ci, int cq) {
 
     int v;
 
+    // first half of a data bit, only keep the soft decision
+    if (Demod.state == DEMOD_RECEIVING_DATA && Demod.posCount == 0) {
+        Demod.thisBit = ((Demod.sumI > 0) ? ci : -ci) + ((Demod.sumQ > 0) ? cq : -cq);
+        Demod.posCount = 1;
+        return false;
+    }
+
 // The soft decision on the bit uses an estimate of just the
 // quadrant of the reference angle, not the exact angle.
 #define MAKE_SOFT_DECISION() { \
@@ -1185,7 +1204,7 @@ uint8_t iso14443b_apdu(uint8_t const *message, size_t message_length, uint8_t *r
 /**
 * SRx Initialise.
 */
-static uint8_t iso14443b_select_srx_card(iso14b_card_select_t *card) {
+uint8_t iso14443b_select_srx_card(iso14b_card_select_t *card) {
     // INITIATE command: wake up the tag using the INITIATE
     static const uint8_t init_srx[] = { ISO14443B_INITIATE, 0x00, 0x97, 0x5b };
     uint8_t r_init[3] = {0x0};
@@ -1393,79 +1412,91 @@ void iso14443b_setup(void) {
 //
 // I tried to be systematic and check every answer of the tag, every CRC, etc...
 //-----------------------------------------------------------------------------
-static bool ReadSTBlock(uint8_t blocknr, uint8_t *block) {
+// a SRx answers a READ_BLOCK after TR0 + TR1, 200 samples = 944us instead of the generic reader timeout
+#define ISO14443B_SRX_READ_TIMEOUT      200
+#define ISO14443B_SRX_READ_RETRIES      3
+
+// quiet READ_BLOCK for the dump, start_time / eof_time chain the exchanges back to back
+static int ReadSTBlockFast(uint8_t blocknr, uint8_t *block, uint32_t *start_time, uint32_t *eof_time) {
     uint8_t cmd[] = {ISO14443B_READ_BLK, blocknr, 0x00, 0x00};
     AddCrc14B(cmd, 2);
 
     uint8_t r_block[6] = {0};
 
-    uint32_t start_time = 0;
-    uint32_t eof_time = 0;
-    CodeAndTransmit14443bAsReader(cmd, sizeof(cmd), &start_time, &eof_time);
+    for (uint8_t retry = 0; retry < ISO14443B_SRX_READ_RETRIES; retry++) {
+        CodeAndTransmit14443bAsReader(cmd, sizeof(cmd), start_time, eof_time);
 
-    eof_time += DELAY_ISO14443B_VCD_TO_VICC_READER;
-    int retlen = Get14443bAnswerFromTag(r_block, sizeof(r_block), ISO14443B_READER_TIMEOUT, &eof_time);
-    FpgaDisableTracing();
+        *eof_time += DELAY_ISO14443B_VCD_TO_VICC_READER;
+        int retlen = Get14443bAnswerFromTag(r_block, sizeof(r_block), ISO14443B_SRX_READ_TIMEOUT, eof_time);
+        *start_time = *eof_time + DELAY_ISO14443B_VICC_TO_VCD_READER;
 
-    // Check if we got an answer from the tag
-    if (retlen != 6) {
-        DbpString("[!] expected 6 bytes from tag, got less...");
-        return false;
-    }
-    // The check the CRC of the answer
-    if (!check_crc(CRC_14443_B, r_block, retlen)) {
-        DbpString("CRC fail");
-        return false;
-    }
-
-    if (block) {
-        memcpy(block, r_block, 4);
+        if (retlen == 6 && check_crc(CRC_14443_B, r_block, retlen)) {
+            memcpy(block, r_block, 4);
+            return PM3_SUCCESS;
+        }
     }
+    return PM3_ETIMEOUT;
+}
 
-    Dbprintf("Address=%02x, Contents=%08x, CRC=%04x",
-             blocknr,
-             (r_block[3] << 24) + (r_block[2] << 16) + (r_block[1] << 8) + r_block[0],
-             (r_block[4] << 8) + r_block[5]);
+void ReadSTMemoryIso14443b(srx_dump_req_t *req) {
 
-    return true;
-}
+    LED_A_ON();
 
-void ReadSTMemoryIso14443b(uint16_t numofblocks) {
+    BigBuf_free();
+    uint16_t numofblocks = req->blocks + 1;
+    uint8_t *mem = BigBuf_malloc(numofblocks * 4);
+    srx_dump_frame_t *frame = (srx_dump_frame_t *)BigBuf_malloc(sizeof(srx_dump_frame_t));
+    if (mem == NULL || frame == NULL) {
+        reply_ng(CMD_HF_SRI_READ, PM3_EMALLOC, NULL, 0);
+        return;
+    }
+    memset(frame, 0, sizeof(srx_dump_frame_t));
 
+    set_tracing(true);
     iso14443b_setup();
 
-    uint8_t *mem = BigBuf_malloc((numofblocks + 1) * 4);
+    int isOK = PM3_SUCCESS;
+    uint16_t blocks = 0;
 
     iso14b_card_select_t card;
-    uint8_t res = iso14443b_select_srx_card(&card);
-
-    int isOK = PM3_SUCCESS;
     // 0: OK 2: attrib fail, 3:crc fail,
-    if (res > 0) {
+    if (iso14443b_select_srx_card(&card) > 0) {
         isOK = PM3_ETIMEOUT;
         goto out;
     }
 
-    ++numofblocks;
-
-    for (uint8_t i = 0; i < numofblocks; i++) {
+    uint32_t start_time = 0;
+    uint32_t eof_time = 0;
+    for (; blocks < numofblocks; blocks++) {
+        isOK = ReadSTBlockFast(blocks, mem + (blocks * 4), &start_time, &eof_time);
+        if (isOK != PM3_SUCCESS)
+            break;
 
-        if (ReadSTBlock(i, mem + (i * 4)) == false) {
-            isOK = PM3_ETIMEOUT;
+        if (BUTTON_PRESS() || data_available()) {
+            isOK = PM3_EOPABORTED;
             break;
         }
     }
 
     // System area block (0xFF)
-    if (ReadSTBlock(0xFF, mem + (numofblocks * 4)) == false)
-        isOK = PM3_ETIMEOUT;
+    if (isOK == PM3_SUCCESS)
+        isOK = ReadSTBlockFast(0xFF, frame->system, &start_time, &eof_time);
 
 out:
+    switch_off();
 
-    reply_ng(CMD_HF_SRI_READ, isOK, mem, numofblocks * 4);
+    // whatever was read goes out, the status tells whether it is complete
+    uint16_t first = 0;
+    do {
+        frame->first = first;
+        frame->count = MIN(blocks - first, SRX_DUMP_FRAME_BLOCKS);
+        memcpy(frame->data, mem + (first * 4), frame->count * 4);
+        first += frame->count;
+        frame->final = (first >= blocks);
+        reply_ng(CMD_HF_SRI_READ, isOK, (uint8_t *)frame, sizeof(srx_dump_frame_t) - sizeof(frame->data) + frame->count * 4);
+    } while (frame->final == false);
 
     BigBuf_free();
-    switch_off();
 }
 
 //=============================================================================
@@ -1485,7 +1516,35 @@ out:
  * DMA Buffer - ISO14443B_DMA_BUFFER_SIZE
  * Demodulated samples received - all the rest
  */
-void SniffIso14443b(void) {
+// live sniff, same frames and limits as the 15693 one
+#define SNIFF14B_LIVE_BYTES     128
+#define SNIFF14B_LIVE_QUIET     200     // 200 samples = 944us after the last frame, past TR0 + TR1
+
+static void Sniff14bLiveSend(hf14a_sniff_frame_t *frame, uint32_t *sent, bool final, int status) {
+    uint8_t *trace = BigBuf_get_addr();
+    uint32_t end = BigBuf_get_traceLen();
+
+    frame->len = 0;
+    while (*sent < end) {
+        tracelog_hdr_t *hdr = (tracelog_hdr_t *)(trace + *sent);
+        uint16_t reclen = TRACELOG_HDR_LEN + hdr->data_len + TRACELOG_PARITY_LEN(hdr);
+        // a record longer than the limit still goes out alone
+        if (frame->len && frame->len + reclen > SNIFF14B_LIVE_BYTES)
+            break;
+        if (frame->len + reclen > HF14A_SNIFF_RECORDS)
+            break;
+
+        memcpy(frame->data + frame->len, hdr, reclen);
+        frame->len += reclen;
+        *sent += reclen;
+    }
+
+    frame->final = final;
+    reply_ng(CMD_HF_ISO14443B_SNIFF_STREAM, status, (uint8_t *)frame, sizeof(hf14a_sniff_frame_t) - HF14A_SNIFF_RECORDS + frame->len);
+    frame->seq++;
+}
+
+void SniffIso14443b(bool live) {
 
     LEDsoff();
     LED_A_ON();
@@ -1498,6 +1557,14 @@ void SniffIso14443b(void) {
     clear_trace();
     set_tracing(true);
 
+    hf14a_sniff_frame_t *frame = NULL;
+    uint32_t live_sent = 0;
+    int live_status = PM3_EOPABORTED;
+    if (live) {
+        frame = (hf14a_sniff_frame_t *)BigBuf_malloc(sizeof(hf14a_sniff_frame_t));
+        memset(frame, 0, sizeof(hf14a_sniff_frame_t));
+    }
+
     // Initialize Demod and Uart structs
     uint8_t dm_buf[MAX_FRAME_SIZE] = {0};
     Demod14bInit(dm_buf, sizeof(dm_buf));
@@ -1525,6 +1592,8 @@ void SniffIso14443b(void) {
     if (!FpgaSetupSscDma((uint8_t *) dma->buf, DMA_BUFFER_SIZE)) {
         if (DBGLEVEL > DBG_ERROR) DbpString("FpgaSetupSscDma failed. Exiting");
         switch_off();
+        if (live)
+            Sniff14bLiveSend(frame, &live_sent, true, PM3_EINIT);
         return;
     }
 
@@ -1538,23 +1607,98 @@ void SniffIso14443b(void) {
 
     // Count of samples received so far, so that we can include timing
     int samples = 0;
+    int last_frame = 0;
 
     uint16_t *upTo = dma->buf;
 
     for (;;) {
 
-        volatile int behind_by = ((uint16_t *)AT91C_BASE_PDC_SSC->PDC_RPR - upTo) & (DMA_BUFFER_SIZE - 1);
+        int behind_by = ((uint16_t *)AT91C_BASE_PDC_SSC->PDC_RPR - upTo) & (DMA_BUFFER_SIZE - 1);
         if (behind_by < 1) continue;
 
-        samples++;
-        if (samples == 1) {
+        if (samples == 0) {
             // DMA has transferred the very first data
             dma_start_time = GetCountSspClk() & 0xfffffff0;
         }
 
-        volatile int8_t ci = *upTo >> 8;
-        volatile int8_t cq = *upTo;
-        upTo++;
+        // everything the DMA delivered up to the end of the buffer in one run, without
+        // going back to the PDC registers for every sample
+        uint16_t *run_end = upTo + behind_by;
+        if (run_end > dma->buf + DMA_BUFFER_SIZE)
+            run_end = dma->buf + DMA_BUFFER_SIZE;
+
+        while (upTo < run_end) {
+
+            samples++;
+
+            int8_t ci = *upTo >> 8;
+            int8_t cq = *upTo;
+            upTo++;
+
+            // no need to try decoding reader data if the tag is sending
+            if (tag_is_active == false) {
+
+                if (Handle14443bSampleFromReader(ci & 0x01)) {
+                    uint32_t eof_time = dma_start_time + (samples * 16) + 8; // - DELAY_READER_TO_ARM_SNIFF; // end of EOF
+                    if (Uart.byteCnt > 0) {
+                        uint32_t sof_time = eof_time
+                                            - Uart.byteCnt * 1 // time for byte transfers
+                                            - 32 * 16          // time for SOF transfer
+                                            - 16 * 16;         // time for EOF transfer
+                        LogTrace(Uart.output, Uart.byteCnt, (sof_time * 4), (eof_time * 4), NULL, true);
+                    }
+                    // And ready to receive another command.
+                    Uart14bReset();
+                    Demod14bReset();
+                    reader_is_active = false;
+                    expect_tag_answer = true;
+                    last_frame = samples;
+                }
+
+                if (Handle14443bSampleFromReader(cq & 0x01)) {
+
+                    uint32_t eof_time = dma_start_time + (samples * 16) + 16; // - DELAY_READER_TO_ARM_SNIFF; // end of EOF
+                    if (Uart.byteCnt > 0) {
+                        uint32_t sof_time = eof_time
+                                            - Uart.byteCnt * 1 // time for byte transfers
+                                            - 32 * 16          // time for SOF transfer
+                                            - 16 * 16;         // time for EOF transfer
+                        LogTrace(Uart.output, Uart.byteCnt, (sof_time * 4), (eof_time * 4), NULL, true);
+                    }
+                    // And ready to receive another command
+                    Uart14bReset();
+                    Demod14bReset();
+                    reader_is_active = false;
+                    expect_tag_answer = true;
+                    last_frame = samples;
+                }
+
+                reader_is_active = (Uart.state > STATE_14B_GOT_FALLING_EDGE_OF_SOF);
+            }
+
+            // no need to try decoding tag data if the reader is sending - and we cannot afford the time
+            if (reader_is_active == false && expect_tag_answer) {
+
+                if (Handle14443bSamplesFromTag((ci >> 1), (cq >> 1))) {
+
+                    uint32_t eof_time = dma_start_time + (samples * 16); // - DELAY_TAG_TO_ARM_SNIFF; // end of EOF
+                    uint32_t sof_time = eof_time
+                                        - Demod.len * 8 * 8 * 16 // time for byte transfers
+                                        - (32 * 16)             // time for SOF transfer
+                                        - 0;                    // time for EOF transfer
+
+                    LogTrace(Demod.output, Demod.len, (sof_time * 4), (eof_time * 4), NULL, false);
+                    // And ready to receive another response.
+                    Uart14bReset();
+                    Demod14bReset();
+                    expect_tag_answer = false;
+                    tag_is_active = false;
+                    last_frame = samples;
+                } else {
+                    tag_is_active = (Demod.state > DEMOD_GOT_FALLING_EDGE_OF_SOF);
+                }
+            }
+        }
 
         // we have read all of the DMA buffer content.
         if (upTo >= dma->buf + DMA_BUFFER_SIZE) {
@@ -1584,64 +1728,19 @@ void SniffIso14443b(void) {
             }
         }
 
-        // no need to try decoding reader data if the tag is sending
-        if (tag_is_active == false) {
-
-            if (Handle14443bSampleFromReader(ci & 0x01)) {
-                uint32_t eof_time = dma_start_time + (samples * 16) + 8; // - DELAY_READER_TO_ARM_SNIFF; // end of EOF
-                if (Uart.byteCnt > 0) {
-                    uint32_t sof_time = eof_time
-                                        - Uart.byteCnt * 1 // time for byte transfers
-                                        - 32 * 16          // time for SOF transfer
-                                        - 16 * 16;         // time for EOF transfer
-                    LogTrace(Uart.output, Uart.byteCnt, (sof_time * 4), (eof_time * 4), NULL, true);
-                }
-                // And ready to receive another command.
-                Uart14bReset();
-                Demod14bReset();
-                reader_is_active = false;
-                expect_tag_answer = true;
-            }
-
-            if (Handle14443bSampleFromReader(cq & 0x01)) {
-
-                uint32_t eof_time = dma_start_time + (samples * 16) + 16; // - DELAY_READER_TO_ARM_SNIFF; // end of EOF
-                if (Uart.byteCnt > 0) {
-                    uint32_t sof_time = eof_time
-                                        - Uart.byteCnt * 1 // time for byte transfers
-                                        - 32 * 16          // time for SOF transfer
-                                        - 16 * 16;         // time for EOF transfer
-                    LogTrace(Uart.output, Uart.byteCnt, (sof_time * 4), (eof_time * 4), NULL, true);
+        // live mode, only between frames, after the window a tag answer could start in and with little DMA backlog
+        if (live && tag_is_active == false && reader_is_active == false && samples - last_frame > SNIFF14B_LIVE_QUIET) {
+            int backlog = ((uint16_t *)AT91C_BASE_PDC_SSC->PDC_RPR - upTo) & (DMA_BUFFER_SIZE - 1);
+            if (backlog < DMA_BUFFER_SIZE / 4) {
+                if (live_sent < BigBuf_get_traceLen()) {
+                    Sniff14bLiveSend(frame, &live_sent, false, PM3_SUCCESS);
+                } else if (data_available()) {
+                    break;
+                } else if (live_sent > BigBuf_max_traceLen() / 2) {
+                    // everything has been shipped, start the trace over
+                    clear_trace();
+                    live_sent = 0;
                 }
-                // And ready to receive another command
-                Uart14bReset();
-                Demod14bReset();
-                reader_is_active = false;
-                expect_tag_answer = true;
-            }
-
-            reader_is_active = (Uart.state > STATE_14B_GOT_FALLING_EDGE_OF_SOF);
-        }
-
-        // no need to try decoding tag data if the reader is sending - and we cannot afford the time
-        if (reader_is_active == false && expect_tag_answer) {
-
-            if (Handle14443bSamplesFromTag((ci >> 1), (cq >> 1))) {
-
-                uint32_t eof_time = dma_start_time + (samples * 16); // - DELAY_TAG_TO_ARM_SNIFF; // end of EOF
-                uint32_t sof_time = eof_time
-                                    - Demod.len * 8 * 8 * 16 // time for byte transfers
-                                    - (32 * 16)             // time for SOF transfer
-                                    - 0;                    // time for EOF transfer
-
-                LogTrace(Demod.output, Demod.len, (sof_time * 4), (eof_time * 4), NULL, false);
-                // And ready to receive another response.
-                Uart14bReset();
-                Demod14bReset();
-                expect_tag_answer = false;
-                tag_is_active = false;
-            } else {
-                tag_is_active = (Demod.state > DEMOD_GOT_FALLING_EDGE_OF_SOF);
             }
         }
     }
@@ -1649,6 +1748,13 @@ void SniffIso14443b(void) {
     FpgaDisableTracing();
     switch_off();
 
+    if (live) {
+        while (live_sent < BigBuf_get_traceLen())
+            Sniff14bLiveSend(frame, &live_sent, false, PM3_SUCCESS);
+        Sniff14bLiveSend(frame, &live_sent, true, live_status);
+        return;
+    }
+
     DbpString("");
     DbpString(_CYAN_("Sniff statistics"));
     DbpString("=================================");
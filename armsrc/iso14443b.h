@@ -30,12 +30,12 @@ void iso14443b_setup(void);
 uint8_t iso14443b_apdu(uint8_t const *message, size_t message_length, uint8_t *response, uint16_t respmaxlen);
 
 int iso14443b_select_card(iso14b_card_select_t *card);
-uint8_t iso14443b_select_card_srx(iso14b_card_select_t *card);
+uint8_t iso14443b_select_srx_card(iso14b_card_select_t *card);
 
 void SimulateIso14443bTag(uint32_t pupi);
 void AcquireRawAdcSamplesIso14443b(uint32_t parameter);
-void ReadSTMemoryIso14443b(uint16_t numofblocks);
-void SniffIso14443b(void);
+void ReadSTMemoryIso14443b(srx_dump_req_t *req);
+void SniffIso14443b(bool live);
 void SendRawCommand14443B(uint32_t, uint32_t, uint8_t, uint8_t[]);
 void SendRawCommand14443B_Ex(PacketCommandNG *c);
 
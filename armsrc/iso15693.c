@@ -66,6 +66,7 @@
 #include "ticks.h"
 #include "BigBuf.h"
 #include "crc16.h"
+#include "profiling.h"
 
 // Delays in SSP_CLK ticks.
 // SSP_CLK runs at 13,56MHz / 32 = 423.75kHz when simulating a tag
@@ -101,6 +102,7 @@
 
 // buffers
 #define ISO15693_MAX_RESPONSE_LENGTH     36 // allows read single block with the maximum block size of 256bits. Read multiple blocks not supported yet
+#define ISO15693_MAX_BLOCK_SIZE          32 // 256 bits
 #define ISO15693_MAX_COMMAND_LENGTH      45 // allows write single block with the maximum block size of 256bits. Write multiple blocks not supported yet
 
 // 32 + 2 crc + 1
@@ -209,6 +211,14 @@ static const uint8_t encode_4bits[16] = {
     0xa5, 0x65, 0x95, 0x55
 };
 
+// the 2 * len coded bytes of data, without SOF and EOF
+static void Iso15693CodeBytesAsTag(uint8_t *out, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        *out++ = encode_4bits[data[i] & 0xF];
+        *out++ = encode_4bits[data[i] >> 4];
+    }
+}
+
 void CodeIso15693AsTag(uint8_t *cmd, size_t len) {
     /*
      * SOF comprises 3 parts;
@@ -243,12 +253,8 @@ void CodeIso15693AsTag(uint8_t *cmd, size_t len) {
     ts->buf[++ts->max] = 0x1D;  // 00011101
 
     // data
-    for (int i = 0; i < len; i += 2) {
-        ts->buf[++ts->max] = encode_4bits[cmd[i] & 0xF];
-        ts->buf[++ts->max] = encode_4bits[cmd[i] >> 4];
-        ts->buf[++ts->max] = encode_4bits[cmd[i + 1] & 0xF];
-        ts->buf[++ts->max] = encode_4bits[cmd[i + 1] >> 4];
-    }
+    Iso15693CodeBytesAsTag(&ts->buf[ts->max + 1], cmd, len);
+    ts->max += 2 * len;
 
     // EOF
     ts->buf[++ts->max] = 0xB8; // 10111000
@@ -402,6 +408,18 @@ typedef struct {
 //-----------------------------------------------------------------------------
 static RAMFUNC int Handle15693SamplesFromTag(uint16_t amplitude, DecodeTag_t *tag) {
 
+    // inside a bit the samples only add up, keep six of eight out of the state machine.
+    // Position 1 clears the sums and position 8 correlates, both below
+    if (tag->state >= STATE_TAG_RECEIVING_DATA && tag->posCount > 1 && tag->posCount < 8) {
+        if (tag->posCount <= 4) {
+            tag->sum1 += amplitude;
+        } else {
+            tag->sum2 += amplitude;
+        }
+        tag->posCount++;
+        return false;
+    }
+
     switch (tag->state) {
 
         case STATE_TAG_SOF_LOW: {
@@ -795,13 +813,44 @@ typedef struct {
     int         byteCount;
     int         byteCountMax;
     int         posCount;
-    int         sum1, sum2;
+    uint8_t     samples;    // last 8 samples of the current pulse position, oldest in bit 7
     uint8_t     *output;
     uint8_t     jam_search_len;
     uint8_t     *jam_search_string;
 } DecodeReader_t;
 
+// A pulse position is 8 samples. Few high samples in the first half and a high second half is the EOF,
+// the other way round is the pulse. One lookup over the packed samples replaces both sums
+#define READER_POS_NONE     0
+#define READER_POS_PULSE    1
+#define READER_POS_EOF      2
+
+static uint8_t reader_pos_table[256];
+
+static void DecodeReaderInitTable(void) {
+    static bool ready = false;
+    if (ready)
+        return;
+
+    for (uint16_t i = 0; i < 256; i++) {
+        uint8_t sum1 = 0, sum2 = 0;
+        for (uint8_t j = 0; j < 4; j++) {
+            sum1 += (i >> (7 - j)) & 1;
+            sum2 += (i >> (3 - j)) & 1;
+        }
+        if (sum1 <= 1 && sum2 >= 3) {
+            reader_pos_table[i] = READER_POS_EOF;
+        } else if (sum1 >= 3 && sum2 <= 1) {
+            reader_pos_table[i] = READER_POS_PULSE;
+        } else {
+            reader_pos_table[i] = READER_POS_NONE;
+        }
+    }
+    ready = true;
+}
+
 static void DecodeReaderInit(DecodeReader_t *reader, uint8_t *data, uint16_t max_len, uint8_t jam_search_len, uint8_t *jam_search_string) {
+    DecodeReaderInitTable();
     reader->output = data;
     reader->byteCountMax = max_len;
     reader->state = STATE_READER_UNSYNCD;
@@ -819,6 +868,14 @@ static void DecodeReaderReset(DecodeReader_t *reader) {
 
 //static inline __attribute__((always_inline))
 static int RAMFUNC Handle15693SampleFromReader(bool bit, DecodeReader_t *reader) {
+
+    // inside a pulse position only collect the sample, position 8 looks the whole byte up
+    if ((reader->state == STATE_READER_RECEIVE_DATA_1_OUT_OF_4 || reader->state == STATE_READER_RECEIVE_DATA_1_OUT_OF_256) && reader->posCount < 7) {
+        reader->samples = (reader->samples << 1) | bit;
+        reader->posCount++;
+        return false;
+    }
+
     switch (reader->state) {
         case STATE_READER_UNSYNCD:
             // wait for unmodulated carrier
@@ -891,7 +948,7 @@ static int RAMFUNC Handle15693SampleFromReader(bool bit, DecodeReader_t *reader)
                         reader->posCount = 1;
                         reader->bitCount = 0;
                         reader->byteCount = 0;
-                        reader->sum1 = 1;
+                        reader->samples = 1;
                         reader->state = STATE_READER_RECEIVE_DATA_1_OUT_OF_256;
                         LED_B_ON();
                     }
@@ -929,7 +986,7 @@ static int RAMFUNC Handle15693SampleFromReader(bool bit, DecodeReader_t *reader)
                     reader->posCount = 1;
                     reader->bitCount = 0;
                     reader->byteCount = 0;
-                    reader->sum1 = 1;
+                    reader->samples = 1;
                     reader->state = STATE_READER_RECEIVE_DATA_1_OUT_OF_4;
                     LED_B_ON();
                 } else {
@@ -943,35 +1000,19 @@ static int RAMFUNC Handle15693SampleFromReader(bool bit, DecodeReader_t *reader)
         case STATE_READER_RECEIVE_DATA_1_OUT_OF_4:
 
             reader->posCount++;
-
-            if (reader->posCount == 1) {
-
-                reader->sum1 = bit ? 1 : 0;
-
-            } else if (reader->posCount <= 4) {
-
-                if (bit)
-                    reader->sum1++;
-
-            } else if (reader->posCount == 5) {
-
-                reader->sum2 = bit ? 1 : 0;
-
-            } else {
-                if (bit)
-                    reader->sum2++;
-            }
+            reader->samples = (reader->samples << 1) | bit;
 
             if (reader->posCount == 8) {
                 reader->posCount = 0;
-                if (reader->sum1 <= 1 && reader->sum2 >= 3) { // EOF
+                uint8_t pos = reader_pos_table[reader->samples];
+                if (pos == READER_POS_EOF) {
                     LED_B_OFF(); // Finished receiving
                     DecodeReaderReset(reader);
                     if (reader->byteCount != 0) {
                         return true;
                     }
 
-                } else if (reader->sum1 >= 3 && reader->sum2 <= 1) { // detected a 2bit position
+                } else if (pos == READER_POS_PULSE) { // detected a 2bit position
                     reader->shiftReg >>= 2;
                     reader->shiftReg |= (reader->bitCount << 6);
                 }
@@ -1004,27 +1045,19 @@ static int RAMFUNC Handle15693SampleFromReader(bool bit, DecodeReader_t *reader)
         case STATE_READER_RECEIVE_DATA_1_OUT_OF_256:
 
             reader->posCount++;
-
-            if (reader->posCount == 1) {
-                reader->sum1 = bit ? 1 : 0;
-            } else if (reader->posCount <= 4) {
-                if (bit) reader->sum1++;
-            } else if (reader->posCount == 5) {
-                reader->sum2 = bit ? 1 : 0;
-            } else if (bit) {
-                reader->sum2++;
-            }
+            reader->samples = (reader->samples << 1) | bit;
 
             if (reader->posCount == 8) {
                 reader->posCount = 0;
-                if (reader->sum1 <= 1 && reader->sum2 >= 3) { // EOF
+                uint8_t pos = reader_pos_table[reader->samples];
+                if (pos == READER_POS_EOF) {
                     LED_B_OFF(); // Finished receiving
                     DecodeReaderReset(reader);
                     if (reader->byteCount != 0) {
                         return true;
                     }
 
-                } else if (reader->sum1 >= 3 && reader->sum2 <= 1) { // detected the bit position
+                } else if (pos == READER_POS_PULSE) { // detected the bit position
                     reader->shiftReg = reader->bitCount;
                 }
 
@@ -1087,7 +1120,8 @@ static int RAMFUNC Handle15693SampleFromReader(bool bit, DecodeReader_t *reader)
 // Receive a command (from the reader to us, where we are the simulated tag),
 // and store it in the given buffer, up to the given maximum length. Keeps
 // spinning, waiting for a well-framed command, until either we get one
-// (returns len) or someone presses the pushbutton on the board (returns -1).
+// (returns len) or someone presses the pushbutton on the board or the client
+// sends a command (returns -1).
 //
 // Assume that we're called with the SSC (to the FPGA) and ADC path set
 // correctly.
@@ -1096,9 +1130,11 @@ static int RAMFUNC Handle15693SampleFromReader(bool bit, DecodeReader_t *reader)
 int GetIso15693CommandFromReader(uint8_t *received, size_t max_len, uint32_t *eof_time) {
     int samples = 0;
     bool gotFrame = false;
+    uint16_t checker = 0;
 
-    // the decoder data structure
-    DecodeReader_t *dr = (DecodeReader_t *)BigBuf_malloc(sizeof(DecodeReader_t));
+    // the decoder data structure, on the stack. A simulation calls this for every command
+    DecodeReader_t decoder;
+    DecodeReader_t *dr = &decoder;
     DecodeReaderInit(dr, received, max_len, 0, NULL);
 
     // wait for last transfer to complete
@@ -1135,6 +1171,7 @@ int GetIso15693CommandFromReader(uint8_t *received, size_t max_len, uint32_t *eo
         if (upTo >= dma->buf + DMA_BUFFER_SIZE) {               // we have read all of the DMA buffer content.
             upTo = dma->buf;                                    // start reading the circular buffer from the beginning
             if (behindBy > (9 * DMA_BUFFER_SIZE / 10)) {
+                profiling_dma_overrun();
                 Dbprintf("About to blow circular buffer - aborted! behindBy %d", behindBy);
                 break;
             }
@@ -1162,6 +1199,15 @@ int GetIso15693CommandFromReader(uint8_t *received, size_t max_len, uint32_t *eo
             break;
         }
 
+        // polling usb is slow, only look every few thousand bytes
+        if (checker++ == 4000) {
+            checker = 0;
+            if (data_available()) {
+                dr->byteCount = -1;
+                break;
+            }
+        }
+
         WDT_HIT();
     }
 
@@ -1228,7 +1274,35 @@ void AcquireRawAdcSamplesIso15693(void) {
     LEDsoff();
 }
 
-void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string) {
+// live sniff, the 14a frame with fewer bytes so one USB transfer stays well inside the DMA buffer
+#define SNIFF15_LIVE_BYTES      128
+#define SNIFF15_LIVE_QUIET      150     // 150/212kHz = 708us after the last frame, a tag answer starts at 320us
+
+static void Sniff15LiveSend(hf14a_sniff_frame_t *frame, uint32_t *sent, bool final, int status) {
+    uint8_t *trace = BigBuf_get_addr();
+    uint32_t end = BigBuf_get_traceLen();
+
+    frame->len = 0;
+    while (*sent < end) {
+        tracelog_hdr_t *hdr = (tracelog_hdr_t *)(trace + *sent);
+        uint16_t reclen = TRACELOG_HDR_LEN + hdr->data_len + TRACELOG_PARITY_LEN(hdr);
+        // a record longer than the limit still goes out alone
+        if (frame->len && frame->len + reclen > SNIFF15_LIVE_BYTES)
+            break;
+        if (frame->len + reclen > HF14A_SNIFF_RECORDS)
+            break;
+
+        memcpy(frame->data + frame->len, hdr, reclen);
+        frame->len += reclen;
+        *sent += reclen;
+    }
+
+    frame->final = final;
+    reply_ng(CMD_HF_ISO15693_SNIFF_STREAM, status, (uint8_t *)frame, sizeof(hf14a_sniff_frame_t) - HF14A_SNIFF_RECORDS + frame->len);
+    frame->seq++;
+}
+
+void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string, bool live) {
 
     LEDsoff();
     LED_A_ON();
@@ -1241,6 +1315,14 @@ void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string) {
     clear_trace();
     set_tracing(true);
 
+    hf14a_sniff_frame_t *frame = NULL;
+    uint32_t live_sent = 0;
+    int live_status = PM3_EOPABORTED;
+    if (live) {
+        frame = (hf14a_sniff_frame_t *)BigBuf_malloc(sizeof(hf14a_sniff_frame_t));
+        memset(frame, 0, sizeof(hf14a_sniff_frame_t));
+    }
+
     DecodeTag_t dtag = {0};
     uint8_t response[ISO15693_MAX_RESPONSE_LENGTH] = {0};
     DecodeTagInit(&dtag, response, sizeof(response));
@@ -1264,6 +1346,8 @@ void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string) {
     if (FpgaSetupSscDma((uint8_t *) dma->buf, DMA_BUFFER_SIZE) == false) {
         if (DBGLEVEL > DBG_ERROR) DbpString("FpgaSetupSscDma failed. Exiting");
         switch_off();
+        if (live)
+            Sniff15LiveSend(frame, &live_sent, true, PM3_EINIT);
         return;
     }
 
@@ -1274,6 +1358,7 @@ void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string) {
 
     // Count of samples received so far, so that we can include timing
     int samples = 0;
+    int last_frame = 0;
 
     uint16_t *upTo = dma->buf;
 
@@ -1318,6 +1403,20 @@ void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string) {
             }
         }
 
+        // live mode, only between frames, after the window a tag answer could start in and with little DMA backlog
+        if (live && (samples & 0x3F) == 0 && tag_is_active == false && reader_is_active == false
+                && samples - last_frame > SNIFF15_LIVE_QUIET && behind_by < DMA_BUFFER_SIZE / 4) {
+            if (live_sent < BigBuf_get_traceLen()) {
+                Sniff15LiveSend(frame, &live_sent, false, PM3_SUCCESS);
+            } else if (data_available()) {
+                break;
+            } else if (live_sent > BigBuf_max_traceLen() / 2) {
+                // everything has been shipped, start the trace over
+                clear_trace();
+                live_sent = 0;
+            }
+        }
+
         // no need to try decoding reader data if the tag is sending
         if (tag_is_active == false) {
 
@@ -1336,6 +1435,7 @@ void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string) {
                 DecodeTagReset(&dtag);
                 reader_is_active = false;
                 expect_tag_answer = true;
+                last_frame = samples;
 
             } else if (Handle15693SampleFromReader(sniffdata & 0x01, &dreader)) {
 
@@ -1352,6 +1452,7 @@ void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string) {
                 DecodeTagReset(&dtag);
                 reader_is_active = false;
                 expect_tag_answer = true;
+                last_frame = samples;
 
             } else {
                 reader_is_active = (dreader.state >= STATE_READER_RECEIVE_DATA_1_OUT_OF_4);
@@ -1377,6 +1478,7 @@ void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string) {
                 DecodeReaderReset(&dreader);
                 expect_tag_answer = false;
                 tag_is_active = false;
+                last_frame = samples;
             } else {
                 tag_is_active = (dtag.state >= STATE_TAG_RECEIVING_DATA);
             }
@@ -1387,6 +1489,13 @@ void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string) {
     FpgaDisableTracing();
     switch_off();
 
+    if (live) {
+        while (live_sent < BigBuf_get_traceLen())
+            Sniff15LiveSend(frame, &live_sent, false, PM3_SUCCESS);
+        Sniff15LiveSend(frame, &live_sent, true, live_status);
+        return;
+    }
+
     DbpString("");
     DbpString(_CYAN_("Sniff statistics"));
     DbpString("=================================");
@@ -1648,44 +1757,178 @@ void Iso15693InitTag(void) {
     StartCountSspClk();
 }
 
+// The simulated tag answers about 300us after the reader EOF, too short to code an answer then.
+// Everything is coded beforehand: the fixed answers whole, the emulator memory blocks as their
+// coded data. A read copies the coded blocks between the coded flags and CRC, a write
+// invalidates the coded block, it is coded again once the answer went out
+typedef struct {
+    uint8_t *plain;             // with CRC, for the trace
+    uint16_t plain_len;
+    uint8_t *coded;             // SOF, data, EOF
+    uint16_t coded_len;
+} iso15_sim_answer_t;
+
+typedef struct {
+    uint8_t *mem;               // emulator memory
+    uint8_t block_size;
+    uint16_t block_count;
+    uint8_t *coded;             // 2 * block_size coded bytes a block
+    uint8_t *valid;             // bitmap of the coded blocks up to date
+    uint8_t *plain;             // plain answer of a read, for its CRC and the trace
+} iso15_sim_mem_t;
+
+static bool Iso15693SimPrecode(iso15_sim_answer_t *a, uint8_t *data, uint16_t len) {
+    AddCrc15(data, len);
+    len += 2;
+
+    a->plain = BigBuf_malloc(len);
+    a->coded = BigBuf_malloc(2 * len + 2);
+    if (a->plain == NULL || a->coded == NULL)
+        return false;
+
+    memcpy(a->plain, data, len);
+    a->plain_len = len;
+    a->coded[0] = 0x1D; // SOF
+    Iso15693CodeBytesAsTag(a->coded + 1, data, len);
+    a->coded[2 * len + 1] = 0xB8; // EOF
+    a->coded_len = 2 * len + 2;
+    return true;
+}
+
+static void Iso15693SimCodeBlock(iso15_sim_mem_t *m, uint16_t block) {
+    Iso15693CodeBytesAsTag(m->coded + 2 * block * m->block_size, m->mem + block * m->block_size, m->block_size);
+    m->valid[block / 8] |= 1 << (block % 8);
+}
+
+// READ SINGLE BLOCK and READ MULTIPLE BLOCKS answer of count blocks from first, with their security
+// status bytes when sec is set. The coded answer is left in the tosend buffer, returns the plain length
+static uint16_t Iso15693SimRead(iso15_sim_mem_t *m, uint16_t first, uint16_t count, bool sec) {
+    tosend_t *ts = get_tosend();
+    uint8_t *p = m->plain;
+    uint8_t *c = ts->buf;
+
+    *p++ = ISO15_NOERROR;
+    *c++ = 0x1D; // SOF
+    *c++ = encode_4bits[0];
+    *c++ = encode_4bits[0];
+
+    for (uint16_t b = first; b < first + count; b++) {
+        if (sec) {
+            *p++ = 0x00; // not locked
+            *c++ = encode_4bits[0];
+            *c++ = encode_4bits[0];
+        }
+        if ((m->valid[b / 8] & (1 << (b % 8))) == 0)
+            Iso15693SimCodeBlock(m, b);
+
+        memcpy(p, m->mem + b * m->block_size, m->block_size);
+        p += m->block_size;
+        memcpy(c, m->coded + 2 * b * m->block_size, 2 * m->block_size);
+        c += 2 * m->block_size;
+    }
+
+    uint16_t len = p - m->plain;
+    AddCrc15(m->plain, len);
+    Iso15693CodeBytesAsTag(c, m->plain + len, 2);
+    c += 4;
+    *c++ = 0xB8; // EOF
+
+    ts->max = c - ts->buf;
+    return len + 2;
+}
+
 // Simulate an ISO15693 TAG, perform anti-collision and then print any reader commands
 // all demodulation performed in arm rather than host. - greg
-void SimTagIso15693(uint8_t *uid) {
+// With block_count set, READ SINGLE BLOCK, READ MULTIPLE BLOCKS and WRITE SINGLE BLOCK work on the
+// emulator memory
+void SimTagIso15693(iso15_sim_req_t *req) {
 
     // free eventually allocated BigBuf memory
     BigBuf_free_keep_EM();
 
-    Iso15693InitTag();
+    const uint8_t *uid = req->uid;
 
-    LED_A_ON();
+    iso15_sim_mem_t m = {
+        .mem = BigBuf_get_EM_addr(),
+        .block_size = req->block_size,
+        .block_count = req->block_count,
+    };
+    if (m.block_size == 0 || m.block_size > ISO15_SIM_MAX_BLOCK_SIZE || m.block_count > 256 ||
+            m.block_count * m.block_size > ISO15_SIM_MAX_MEMORY) {
+        m.block_count = 0;
+    }
 
-    Dbprintf("ISO-15963 Simulating uid: %02X%02X%02X%02X%02X%02X%02X%02X", uid[0], uid[1], uid[2], uid[3], uid[4], uid[5], uid[6], uid[7]);
+    // 64-bit UID, LSB first as on air
+    uint8_t uid_lsb[8];
+    for (int i = 0; i < 8; i++)
+        uid_lsb[i] = uid[7 - i];
+
+    // INVENTORY response
+    uint8_t data[17];
+    iso15_sim_answer_t resp_inv, resp_sysinfo, resp_ok, resp_not_sup, resp_not_rec, resp_unavailable;
+
+    data[0] = ISO15_NOERROR; // No error, no protocol format extension
+    data[1] = 0; // DSFID (data storage format identifier).  0x00 = not supported
+    memcpy(data + 2, uid_lsb, 8);
+    bool ok = Iso15693SimPrecode(&resp_inv, data, 10);
+
+    // GET SYSTEM INFO response, DSFID, AFI and the memory size when there is memory
+    data[0] = ISO15_NOERROR;
+    data[1] = (m.block_count) ? 0x07 : 0x03;
+    memcpy(data + 2, uid_lsb, 8);
+    data[10] = 0; // DSFID
+    data[11] = 0; // AFI
+    data[12] = m.block_count - 1;
+    data[13] = m.block_size - 1;
+    ok &= Iso15693SimPrecode(&resp_sysinfo, data, (m.block_count) ? 14 : 12);
+
+    data[0] = ISO15_NOERROR;
+    ok &= Iso15693SimPrecode(&resp_ok, data, 1);
+
+    data[0] = ISO15_RES_ERROR;
+    data[1] = ISO15_ERROR_CMD_NOT_SUP;
+    ok &= Iso15693SimPrecode(&resp_not_sup, data, 2);
+
+    data[0] = ISO15_RES_ERROR;
+    data[1] = ISO15_ERROR_CMD_NOT_REC;
+    ok &= Iso15693SimPrecode(&resp_not_rec, data, 2);
+
+    data[0] = ISO15_RES_ERROR;
+    data[1] = ISO15_ERROR_BLOCK_UNAVAILABLE;
+    ok &= Iso15693SimPrecode(&resp_unavailable, data, 2);
+
+    // all blocks of the emulator memory, coded
+    if (m.block_count) {
+        m.coded = BigBuf_malloc(2 * m.block_count * m.block_size);
+        m.valid = BigBuf_malloc((m.block_count + 7) / 8);
+        m.plain = BigBuf_malloc(ISO15_SIM_MAX_READ + 3);
+        if (m.coded == NULL || m.valid == NULL || m.plain == NULL) {
+            ok = false;
+        } else {
+            for (uint16_t b = 0; b < m.block_count; b++)
+                Iso15693SimCodeBlock(&m, b);
+        }
+    }
 
-    LED_C_ON();
+    if (ok == false) {
+        BigBuf_free_keep_EM();
+        reply_ng(CMD_HF_ISO15693_SIMULATE, PM3_EMALLOC, NULL, 0);
+        return;
+    }
 
-    // Build INVENTORY command
-    uint8_t resp_inv[CMD_INV_RESP] = {0};
+    Iso15693InitTag();
 
-    resp_inv[0] = 0; // No error, no protocol format extension
-    resp_inv[1] = 0; // DSFID (data storage format identifier).  0x00 = not supported
+    LED_A_ON();
 
-    // 64-bit UID
-    resp_inv[2] = uid[7];
-    resp_inv[3] = uid[6];
-    resp_inv[4] = uid[5];
-    resp_inv[5] = uid[4];
-    resp_inv[6] = uid[3];
-    resp_inv[7] = uid[2];
-    resp_inv[8] = uid[1];
-    resp_inv[9] = uid[0];
+    Dbprintf("ISO-15963 Simulating uid: %02X%02X%02X%02X%02X%02X%02X%02X", uid[0], uid[1], uid[2], uid[3], uid[4], uid[5], uid[6], uid[7]);
+    if (m.block_count)
+        Dbprintf("%u blocks of %u bytes from emulator memory", m.block_count, m.block_size);
 
-    // CRC
-    AddCrc15(resp_inv, 10);
-    CodeIso15693AsTag(resp_inv, CMD_INV_RESP);
+    LED_C_ON();
 
     tosend_t *ts = get_tosend();
 
-    enum { NO_FIELD, IDLE, ACTIVATED, SELECTED, HALTED } chip_state = NO_FIELD;
+    enum { NO_FIELD, READY, QUIET, SELECTED } chip_state = NO_FIELD;
 
     bool button_pressed = false;
     int vHf = 0; // in mV
@@ -1703,7 +1946,7 @@ void SimTagIso15693(uint8_t *uid) {
             vHf = (MAX_ADC_HF_VOLTAGE * SumAdc(ADC_CHAN_HF, 32)) >> 15;
 #endif
             if (vHf > MF_MINFIELDV) {
-                chip_state = IDLE;
+                chip_state = READY;
                 LED_A_ON();
             } else {
                 continue;
@@ -1720,15 +1963,102 @@ void SimTagIso15693(uint8_t *uid) {
             break;
         }
 
-        // TODO: check more flags
-        if ((cmd_len >= 5) && (cmd[0] & ISO15_REQ_INVENTORY) && (cmd[1] == ISO15_CMD_INVENTORY)) {
-            bool slow = !(cmd[0] & ISO15_REQ_DATARATE_HIGH);
-            uint32_t response_time = reader_eof_time + DELAY_ISO15693_VCD_TO_VICC_SIM;
-            TransmitTo15693Reader(ts->buf, ts->max, &response_time, 0, slow);
-            LogTrace_ISO15693(resp_inv, CMD_INV_RESP, response_time * 32, (response_time * 32) + (ts->max * 32 * 64), NULL, false);
+        if (cmd_len < 4 || CheckCrc15(cmd, cmd_len) == false)
+            continue;
+
+        uint8_t flags = cmd[0];
+        iso15_sim_answer_t *answer = NULL;
+        uint16_t read_len = 0;
+        int written = -1;
+
+        if (flags & ISO15_REQ_INVENTORY) {
+            // our AFI is 0, only an inventory without AFI or for all of them
+            bool afi_ok = ((flags & ISO15_REQINV_AFI) == 0 || (cmd_len > 4 && cmd[2] == 0));
+            if (cmd[1] == ISO15_CMD_INVENTORY && chip_state != QUIET && afi_ok)
+                answer = &resp_inv;
+        } else {
+            // addressed requests carry our UID, select ones go to the selected tag, the others to a tag not quiet
+            int p = 2;
+            if (flags & ISO15_REQ_ADDRESS) {
+                if (cmd_len < 12 || memcmp(cmd + 2, uid_lsb, 8) != 0)
+                    continue;
+                p = 10;
+            } else if (flags & ISO15_REQ_SELECT) {
+                if (chip_state != SELECTED)
+                    continue;
+            } else if (chip_state == QUIET) {
+                continue;
+            }
+            int n = cmd_len - 2 - p; // parameter bytes
+            bool sec = (flags & ISO15_REQ_OPTION);
+
+            switch (cmd[1]) {
+                case ISO15_CMD_STAYQUIET:
+                    if (flags & ISO15_REQ_ADDRESS)
+                        chip_state = QUIET;
+                    break;
+                case ISO15_CMD_SELECT:
+                    if (flags & ISO15_REQ_ADDRESS) {
+                        chip_state = SELECTED;
+                        answer = &resp_ok;
+                    }
+                    break;
+                case ISO15_CMD_RESET:
+                    chip_state = READY;
+                    answer = &resp_ok;
+                    break;
+                case ISO15_CMD_SYSINFO:
+                    answer = &resp_sysinfo;
+                    break;
+                case ISO15_CMD_READ:
+                    if (n != 1)
+                        answer = &resp_not_rec;
+                    else if (cmd[p] >= m.block_count)
+                        answer = &resp_unavailable;
+                    else
+                        read_len = Iso15693SimRead(&m, cmd[p], 1, sec);
+                    break;
+                case ISO15_CMD_READMULTI: {
+                    uint16_t count = (n == 2) ? cmd[p + 1] + 1 : 0;
+                    if (n != 2 || count * (m.block_size + sec) > ISO15_SIM_MAX_READ)
+                        answer = &resp_not_rec;
+                    else if (cmd[p] + count > m.block_count)
+                        answer = &resp_unavailable;
+                    else
+                        read_len = Iso15693SimRead(&m, cmd[p], count, sec);
+                    break;
+                }
+                case ISO15_CMD_WRITE:
+                    if (n != 1 + m.block_size) {
+                        answer = &resp_not_rec;
+                    } else if (cmd[p] >= m.block_count) {
+                        answer = &resp_unavailable;
+                    } else {
+                        written = cmd[p];
+                        memcpy(m.mem + written * m.block_size, cmd + p + 1, m.block_size);
+                        m.valid[written / 8] &= ~(1 << (written % 8));
+                        answer = &resp_ok;
+                    }
+                    break;
+                default:
+                    answer = &resp_not_sup;
+                    break;
+            }
+        }
 
-            chip_state = SELECTED;
+        bool slow = !(flags & ISO15_REQ_DATARATE_HIGH);
+        uint32_t response_time = reader_eof_time + DELAY_ISO15693_VCD_TO_VICC_SIM;
+        if (answer) {
+            TransmitTo15693Reader(answer->coded, answer->coded_len, &response_time, 0, slow);
+            LogTrace_ISO15693(answer->plain, answer->plain_len, response_time * 32, (response_time * 32) + (answer->coded_len * 32 * 64), NULL, false);
+        } else if (read_len) {
+            TransmitTo15693Reader(ts->buf, ts->max, &response_time, 0, slow);
+            LogTrace_ISO15693(m.plain, read_len, response_time * 32, (response_time * 32) + (ts->max * 32 * 64), NULL, false);
         }
+
+        // the answer is out, there is time to code the written block again
+        if (written >= 0)
+            Iso15693SimCodeBlock(&m, written);
     }
 
     switch_off();
@@ -1739,73 +2069,184 @@ void SimTagIso15693(uint8_t *uid) {
     reply_ng(CMD_HF_ISO15693_SIMULATE, PM3_SUCCESS, NULL, 0);
 }
 
-// Since there is no standardized way of reading the AFI out of a tag, we will brute force it
-// (some manufactures offer a way to read the AFI, though)
-void BruteforceIso15693Afi(uint32_t speed) {
-
-    uint8_t data[7] = {0};
-    uint8_t recv[ISO15693_MAX_RESPONSE_LENGTH];
-    Iso15693InitReader();
+// a tag answers about 320us after the EOF, an empty inventory slot doesn't need the full reader timeout
+#define ISO15693_INVENTORY_SLOT_TIMEOUT    150  // 150/212kHz = 708us
+#define ISO15693_INVENTORY_MAX_MASKS       32   // pending collided slots
 
-    // first without AFI
-    // Tags should respond wihtout AFI and with AFI=0 even when AFI is active
+typedef struct {
+    uint64_t mask;
+    uint8_t len;
+} iso15_inventory_mask_t;
 
-    data[0] = ISO15_REQ_SUBCARRIER_SINGLE | ISO15_REQ_DATARATE_HIGH | ISO15_REQ_INVENTORY | ISO15_REQINV_SLOT1;
-    data[1] = ISO15_CMD_INVENTORY;
-    data[2] = 0; // AFI
-    AddCrc15(data, 3);
+// number of AFI nibbles that are set, AFI 0x12 is more specific than the family 0x10 it also answers to
+static uint8_t Iso15693AfiNibbles(uint8_t afi) {
+    return ((afi & 0xF0) ? 1 : 0) + ((afi & 0x0F) ? 1 : 0);
+}
 
-    int datalen = 5;
-    uint32_t eof_time = 0;
-    uint32_t start_time = GetCountSspClk();
-    int recvlen = SendDataTag(data, datalen, true, speed, recv, sizeof(recv), 0, ISO15693_READER_TIMEOUT, &eof_time);
-    start_time = eof_time + DELAY_ISO15693_VICC_TO_VCD_READER;
+static void Iso15693InventoryAdd(iso15_inventory_resp_t *resp, const uint8_t *recv, uint8_t afi) {
 
-    WDT_HIT();
+    for (uint8_t i = 0; i < resp->count; i++) {
+        iso15_inventory_tag_t *tag = &resp->tags[i];
+        if (memcmp(tag->uid, recv + 2, sizeof(tag->uid)) == 0) {
+            if (Iso15693AfiNibbles(afi) > Iso15693AfiNibbles(tag->afi)) {
+                tag->afi = afi;
+            }
+            return;
+        }
+    }
 
-    if (recvlen >= 12) {
-        Dbprintf("NoAFI UID = %s", iso15693_sprintUID(NULL, recv + 2));
+    if (resp->count == ISO15_INVENTORY_MAX_TAGS) {
+        resp->flags |= ISO15_INVENTORY_TRUNCATED;
+        return;
     }
 
-    // now with AFI
-    data[0] |= ISO15_REQINV_AFI;
-    data[2] = 0; // AFI
-    data[3] = 0; // mask length
+    iso15_inventory_tag_t *tag = &resp->tags[resp->count++];
+    memcpy(tag->uid, recv + 2, sizeof(tag->uid));
+    tag->dsfid = recv[1];
+    tag->afi = afi;
+}
 
-    // 4 + 2crc
-    datalen = 6;
+// One inventory round. afi < 0 sends it without AFI, slot16 false is a single slot request.
+// Returns the slots where something answered without a valid response as a bit field, answered
+// gets every slot that wasn't silent
+static uint16_t Iso15693InventoryRound(int afi, bool slot16, uint64_t mask, uint8_t mask_len, iso15_inventory_resp_t *resp, uint16_t *answered, uint32_t *start_time, uint32_t *eof_time) {
+
+    // flags, command, AFI, mask length, up to 8 mask bytes, crc
+    uint8_t cmd[4 + 8 + 2];
+    uint8_t n = 0;
+    cmd[n++] = ISO15_REQ_SUBCARRIER_SINGLE | ISO15_REQ_DATARATE_HIGH | ISO15_REQ_INVENTORY
+               | (slot16 ? ISO15_REQINV_SLOT16 : ISO15_REQINV_SLOT1)
+               | (afi >= 0 ? ISO15_REQINV_AFI : 0);
+    cmd[n++] = ISO15_CMD_INVENTORY;
+    if (afi >= 0) {
+        cmd[n++] = afi & 0xFF;
+    }
+    cmd[n++] = mask_len;
+    for (uint8_t i = 0; i < (mask_len + 7) / 8; i++) {
+        cmd[n++] = (mask >> (8 * i)) & 0xFF;
+    }
+    AddCrc15(cmd, n);
+    n += 2;
 
-    bool aborted = false;
-    for (uint16_t i = 0; i < 256; i++) {
+    uint8_t recv[ISO15693_MAX_RESPONSE_LENGTH];
+    uint16_t collisions = 0;
+    *answered = 0;
+    uint8_t slots = slot16 ? 16 : 1;
 
-        data[2] = i & 0xFF;
-        AddCrc15(data, 4);
+    for (uint8_t slot = 0; slot < slots; slot++) {
 
-        recvlen = SendDataTag(data, datalen, false, speed, recv, sizeof(recv), start_time, ISO15693_READER_TIMEOUT, &eof_time);
-        start_time = eof_time + DELAY_ISO15693_VICC_TO_VCD_READER;
+        int len;
+        if (slot == 0) {
+            len = SendDataTag(cmd, n, false, true, recv, sizeof(recv), *start_time, ISO15693_INVENTORY_SLOT_TIMEOUT, eof_time);
+        } else {
+            // the EOF alone moves all tags on to the next slot
+            len = SendDataTagEOF(recv, sizeof(recv), *start_time, ISO15693_INVENTORY_SLOT_TIMEOUT, eof_time);
+        }
+        *start_time = *eof_time + DELAY_ISO15693_VICC_TO_VCD_READER;
 
         WDT_HIT();
 
-        if (recvlen >= 12) {
-            Dbprintf("AFI = %i  UID = %s", i, iso15693_sprintUID(NULL, recv + 2));
+        if (len != -3) {
+            *answered |= (1 << slot);
         }
 
-        aborted = BUTTON_PRESS();
+        if (len >= 12 && CheckCrc15(recv, 12)) {
+            Iso15693InventoryAdd(resp, recv, (afi >= 0) ? (afi & 0xFF) : 0);
+        } else if (len != -3) {
+            // anything but a timeout, more than one tag answered
+            collisions |= (1 << slot);
+        }
+    }
+    return collisions;
+}
 
-        if (aborted) {
-            DbpString("button pressed, aborting..");
-            break;
+// 16 slot inventory with anticollision. A collided slot is asked for again with the slot number appended
+// to the mask, the UID bits after the mask pick the slot
+static void Iso15693InventoryTags(int afi, iso15_inventory_resp_t *resp, uint32_t *start_time, uint32_t *eof_time) {
+
+    iso15_inventory_mask_t pending[ISO15693_INVENTORY_MAX_MASKS];
+    uint8_t npending = 1;
+    pending[0].mask = 0;
+    pending[0].len = 0;
+
+    while (npending) {
+
+        iso15_inventory_mask_t m = pending[--npending];
+        uint16_t answered;
+        uint16_t collisions = Iso15693InventoryRound(afi, true, m.mask, m.len, resp, &answered, start_time, eof_time);
+
+        for (uint8_t slot = 0; slot < 16; slot++) {
+            if ((collisions & (1 << slot)) == 0)
+                continue;
+
+            // a 60 bit mask leaves nothing to split on, same UID twice is noise
+            if (m.len + 4 > 60 || npending == ISO15693_INVENTORY_MAX_MASKS) {
+                resp->flags |= ISO15_INVENTORY_TRUNCATED;
+                continue;
+            }
+            pending[npending].mask = m.mask | ((uint64_t)slot << m.len);
+            pending[npending].len = m.len + 4;
+            npending++;
         }
     }
+}
+
+void InventoryIso15693(void) {
+
+    LED_A_ON();
+
+    iso15_inventory_resp_t resp = {0};
+
+    Iso15693InitReader();
+    set_tracing(true);
+    clear_trace();
+
+    uint32_t start_time = GetCountSspClk();
+    uint32_t eof_time = 0;
+    Iso15693InventoryTags(-1, &resp, &start_time, &eof_time);
 
-    DbpString("AFI Bruteforcing done.");
     switch_off();
+    reply_ng(CMD_HF_ISO15693_INVENTORY, PM3_SUCCESS, (uint8_t *)&resp, sizeof(resp));
+}
 
-    if (aborted) {
-        reply_ng(CMD_ACK, PM3_EOPABORTED, NULL, 0);
-    } else {
-        reply_ng(CMD_ACK, PM3_SUCCESS, NULL, 0);
+// Since there is no standardized way of reading the AFI out of a tag, we will brute force it
+// (some manufactures offer a way to read the AFI, though)
+void BruteforceIso15693Afi(void) {
+
+    LED_A_ON();
+
+    iso15_inventory_resp_t resp = {0};
+    int status = PM3_SUCCESS;
+
+    Iso15693InitReader();
+    set_tracing(true);
+    clear_trace();
+
+    uint32_t start_time = GetCountSspClk();
+    uint32_t eof_time = 0;
+
+    // first without AFI, lists the tags that have none set too
+    Iso15693InventoryTags(-1, &resp, &start_time, &eof_time);
+
+    // AFI 0 matches every tag
+    for (uint16_t afi = 1; afi < 256; afi++) {
+
+        uint16_t answered;
+        uint16_t collisions = Iso15693InventoryRound(afi, false, 0, 0, &resp, &answered, &start_time, &eof_time);
+
+        // a single slot sees more than one tag as a collision, or a weaker one hides behind a clean answer
+        if (collisions || (answered && resp.count > 1)) {
+            Iso15693InventoryTags(afi, &resp, &start_time, &eof_time);
+        }
+
+        if (BUTTON_PRESS() || data_available()) {
+            status = PM3_EOPABORTED;
+            break;
+        }
     }
+
+    switch_off();
+    reply_ng(CMD_HF_ISO15693_FINDAFI, status, (uint8_t *)&resp, sizeof(resp));
 }
 
 // Allows to directly send commands to the tag via the client
@@ -1995,6 +2436,138 @@ void LockPassSlixIso15693(uint32_t pass_id, uint32_t password) {
 //
 //-----------------------------------------------------------------------------
 
+// Reads count blocks from first in one exchange, count 1 is a READ SINGLE BLOCK. Addressed and with the
+// option flag, every block comes with its security status. Returns the block size, 0 when the tag
+// didn't answer properly and -1 when it answered with an error
+static int Iso15693DumpRead(const uint8_t *uid, uint8_t first, uint8_t count, uint8_t *sec, uint8_t *data,
+                            uint32_t *start_time, uint32_t *eof_time) {
+
+    uint8_t cmd[13];
+    uint8_t n = 0;
+    cmd[n++] = ISO15_REQ_SUBCARRIER_SINGLE | ISO15_REQ_DATARATE_HIGH | ISO15_REQ_NONINVENTORY | ISO15_REQ_ADDRESS | ISO15_REQ_OPTION;
+    cmd[n++] = (count > 1) ? ISO15_CMD_READMULTI : ISO15_CMD_READ;
+    memcpy(cmd + n, uid, 8);
+    n += 8;
+    cmd[n++] = first;
+    if (count > 1) {
+        cmd[n++] = count - 1;
+    }
+    AddCrc15(cmd, n);
+    n += 2;
+
+    uint8_t recv[3 + ISO15_DUMP_MULTI_BLOCKS * 5];
+    int len = SendDataTag(cmd, n, false, true, recv, sizeof(recv), *start_time, ISO15693_READER_TIMEOUT, eof_time);
+    *start_time = *eof_time + DELAY_ISO15693_VICC_TO_VCD_READER;
+
+    if (len < 3 || CheckCrc15(recv, len) == false)
+        return 0;
+
+    if (recv[0] & ISO15_RES_ERROR)
+        return -1;
+
+    int bs = (len - 3) / count - 1;
+    if (bs < 1 || ((bs + 1) * count + 3) != len)
+        return 0;
+
+    for (uint8_t i = 0; i < count; i++) {
+        sec[i] = recv[1 + i * (bs + 1)];
+        memcpy(data + i * bs, recv + 2 + i * (bs + 1), bs);
+    }
+    return bs;
+}
+
+// Dumps the whole tag memory with the field kept up, see iso15_dump_req_t
+void DumpIso15693(iso15_dump_req_t *req) {
+
+    LED_A_ON();
+
+    BigBuf_free();
+    uint8_t *sec = BigBuf_malloc(256);
+    uint8_t *data = BigBuf_malloc(256 * ISO15693_MAX_BLOCK_SIZE);
+    iso15_dump_frame_t *frame = (iso15_dump_frame_t *)BigBuf_malloc(sizeof(iso15_dump_frame_t));
+    if (frame == NULL || data == NULL || sec == NULL) {
+        reply_ng(CMD_HF_ISO15693_DUMP, PM3_EMALLOC, NULL, 0);
+        return;
+    }
+
+    Iso15693InitReader();
+    set_tracing(true);
+    clear_trace();
+
+    uint32_t start_time = GetCountSspClk();
+    uint32_t eof_time = 0;
+    int status = PM3_SUCCESS;
+    bool multi = (req->flags & ISO15_DUMP_SINGLE) == 0;
+
+    // block 0 alone first, it tells the block size
+    int bs = 0;
+    for (int retry = 0; retry < 3 && bs <= 0; retry++) {
+        bs = Iso15693DumpRead(req->uid, 0, 1, sec, data, &start_time, &eof_time);
+        if (bs < 0)
+            break;
+    }
+
+    uint16_t blocks = 0;
+    if (bs <= 0 || bs > ISO15693_MAX_BLOCK_SIZE) {
+        bs = 0;
+        status = PM3_ESOFT;
+        goto out;
+    }
+    blocks = 1;
+
+    // the receive buffer of Iso15693DumpRead holds ISO15_DUMP_MULTI_BLOCKS blocks of 4 bytes
+    uint8_t group = MIN(ISO15_DUMP_MULTI_BLOCKS, (ISO15_DUMP_MULTI_BLOCKS * 5) / (bs + 1));
+
+    while (blocks < 256) {
+
+        if (BUTTON_PRESS() || data_available()) {
+            status = PM3_EOPABORTED;
+            break;
+        }
+
+        WDT_HIT();
+
+        if (multi) {
+            uint8_t count = MIN(group, 256 - blocks);
+            if (count > 1 && Iso15693DumpRead(req->uid, blocks, count, sec + blocks, data + blocks * bs, &start_time, &eof_time) == bs) {
+                blocks += count;
+                continue;
+            }
+            // refused or past the end, one by one from here
+            multi = false;
+        }
+
+        int res = 0;
+        for (int retry = 0; retry < 3 && res == 0; retry++) {
+            res = Iso15693DumpRead(req->uid, blocks, 1, sec + blocks, data + blocks * bs, &start_time, &eof_time);
+        }
+        if (res != bs)
+            break;
+
+        blocks++;
+    }
+
+out:
+    switch_off();
+
+    // blocks per frame, security bytes first then the data
+    uint16_t per_frame = sizeof(frame->data) / (bs + 1);
+    uint16_t pos = 0;
+    do {
+        uint16_t count = MIN(per_frame, blocks - pos);
+        frame->final = (pos + count >= blocks);
+        frame->blocksize = bs;
+        frame->first = pos;
+        frame->count = count;
+        memcpy(frame->data, sec + pos, count);
+        memcpy(frame->data + count, data + pos * bs, count * bs);
+        reply_ng(CMD_HF_ISO15693_DUMP, frame->final ? status : PM3_SUCCESS, (uint8_t *)frame, 4 + count * (bs + 1));
+        pos += count;
+    } while (pos < blocks);
+
+    BigBuf_free();
+}
+
 // Set the UID on Magic ISO15693 tag (based on Iceman's LUA-script).
 void SetTag15693Uid(uint8_t *uid) {
 
@@ -36,12 +36,13 @@ int GetIso15693AnswerFromTag(uint8_t *response, uint16_t max_len, uint16_t timeo
 //void RecordRawAdcSamplesIso15693(void);
 void AcquireRawAdcSamplesIso15693(void);
 void ReaderIso15693(uint32_t parameter); // Simulate an ISO15693 reader - greg
-void SimTagIso15693(uint8_t *uid); // simulate an ISO15693 tag - greg
-void BruteforceIso15693Afi(uint32_t speed); // find an AFI of a tag - atrox
+void SimTagIso15693(iso15_sim_req_t *req); // simulate an ISO15693 tag - greg
+void BruteforceIso15693Afi(void); // find an AFI of a tag - atrox
+void InventoryIso15693(void);
 void DirectTag15693Command(uint32_t datalen, uint32_t speed, uint32_t recv, uint8_t *data); // send arbitrary commands from CLI - atrox
 void Iso15693InitReader(void);
 
-void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string);
+void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string, bool live);
 
 int SendDataTag(uint8_t *send, int sendlen, bool init, bool speed_fast, uint8_t *recv,
                 uint16_t max_recv_len, uint32_t start_time, uint16_t timeout, uint32_t *eof_time);
@@ -49,4 +50,5 @@ int SendDataTag(uint8_t *send, int sendlen, bool init, bool speed_fast, uint8_t
 int SendDataTagEOF(uint8_t *recv, uint16_t max_recv_len, uint32_t start_time, uint16_t timeout, uint32_t *eof_time);
 
 void SetTag15693Uid(uint8_t *uid);
+void DumpIso15693(iso15_dump_req_t *req);
 #endif
@@ -156,9 +156,12 @@ static void tx_bit(bool bit) {
 // present.
 //-----------------------------------------------------------------------------
 
-static void tx_frame(uint32_t frame, uint8_t len) {
+// transmit frame obfuscated with the keystream bits ks, the plain frame goes to the trace
+static void tx_frame_ks(uint32_t frame, uint8_t len, uint32_t ks) {
     FpgaWriteConfWord(FPGA_MAJOR_MODE_HF_READER | FPGA_HF_READER_MODE_SEND_FULL_MOD);
 
+    uint32_t obfuscated = frame ^ ks;
+
     // wait for next tx timeslot
     last_frame_end += RWD_FRAME_WAIT;
     while (GET_TICKS < last_frame_end) { };
@@ -168,9 +171,7 @@ static void tx_frame(uint32_t frame, uint8_t len) {
 
     // transmit frame, MSB first
     for (uint8_t i = 0; i < len; ++i) {
-        bool bit = (frame >> i) & 0x01;
-        tx_bit(bit ^ legic_prng_get_bit());
-        legic_prng_forward(1);
+        tx_bit((obfuscated >> i) & 0x01);
     };
 
     // add pause to mark end of the frame
@@ -184,7 +185,12 @@ static void tx_frame(uint32_t frame, uint8_t len) {
     LogTrace(cmdbytes, sizeof(cmdbytes), last_frame_start, last_frame_end, NULL, true);
 }
 
-static uint32_t rx_frame(uint8_t len) {
+static void tx_frame(uint32_t frame, uint8_t len) {
+    tx_frame_ks(frame, len, legic_prng_get_bits(len));
+}
+
+// receive len bits, deobfuscated with the keystream bits ks
+static uint32_t rx_frame_ks(uint8_t len, uint32_t ks) {
     FpgaWriteConfWord(FPGA_MAJOR_MODE_HF_READER | FPGA_HF_READER_SUBCARRIER_212_KHZ | FPGA_HF_READER_MODE_RECEIVE_IQ);
 
     // hold sampling until card is expected to respond
@@ -196,13 +202,13 @@ static uint32_t rx_frame(uint8_t len) {
 
     uint32_t frame = 0;
     for (uint8_t i = 0; i < len; ++i) {
-        frame |= (rx_bit() ^ legic_prng_get_bit()) << i;
-        legic_prng_forward(1);
+        frame |= rx_bit() << i;
 
         // rx_bit runs only 95us, resync to TAG_BIT_PERIOD
         last_frame_end += TAG_BIT_PERIOD;
         while (GET_TICKS < last_frame_end) { };
     }
+    frame ^= ks;
 
     // log
     uint8_t cmdbytes[] = {len, BYTEx(frame, 0), BYTEx(frame, 1)};
@@ -211,6 +217,10 @@ static uint32_t rx_frame(uint8_t len) {
     return frame;
 }
 
+static uint32_t rx_frame(uint8_t len) {
+    return rx_frame_ks(len, legic_prng_get_bits(len));
+}
+
 static bool rx_ack(void) {
     // change fpga into rx mode
     FpgaWriteConfWord(FPGA_MAJOR_MODE_HF_READER | FPGA_HF_READER_SUBCARRIER_212_KHZ | FPGA_HF_READER_MODE_RECEIVE_IQ);
@@ -354,6 +364,19 @@ static uint8_t calc_crc4(uint16_t cmd, uint8_t cmd_sz, uint8_t value) {
     return crc_finish(&legic_crc);
 }
 
+// split frame into data and crc, check received against calculated crc
+static int16_t check_read(uint16_t cmd, uint8_t cmd_sz, uint32_t frame) {
+    uint8_t byte = BYTEx(frame, 0);
+    uint8_t crc = BYTEx(frame, 1);
+
+    uint8_t calc_crc = calc_crc4(cmd, cmd_sz, byte);
+    if (calc_crc != crc) {
+        Dbprintf("!!! crc mismatch: %x != %x !!!",  calc_crc, crc);
+        return -1;
+    }
+    return byte;
+}
+
 static int16_t read_byte(uint16_t index, uint8_t cmd_sz) {
     uint16_t cmd = (index << 1) | LEGIC_READ;
 
@@ -365,14 +388,8 @@ static int16_t read_byte(uint16_t index, uint8_t cmd_sz) {
     uint32_t frame = rx_frame(12);
     LED_B_OFF();
 
-    // split frame into data and crc
-    uint8_t byte = BYTEx(frame, 0);
-    uint8_t crc = BYTEx(frame, 1);
-
-    // check received against calculated crc
-    uint8_t calc_crc = calc_crc4(cmd, cmd_sz, byte);
-    if (calc_crc != crc) {
-        Dbprintf("!!! crc mismatch: %x != %x !!!",  calc_crc, crc);
+    int16_t byte = check_read(cmd, cmd_sz, frame);
+    if (byte == -1) {
         return -1;
     }
 
@@ -381,6 +398,116 @@ static int16_t read_byte(uint16_t index, uint8_t cmd_sz) {
     return byte;
 }
 
+//-----------------------------------------------------------------------------
+// Bulk read
+//
+// The prng doesn't depend on the card answers, so the keystream of a whole read
+// run is known from the iv. setup_phase leaves the prng 17 steps past the iv and
+// every read_byte takes cmd_sz + 17 steps (2 idle, cmd_sz tx, 2 idle, 12 rx,
+// 1 idle). read_range computes the stream before the card is woken up, the gaps
+// between the frames then only hold the lookup and the crc check.
+//-----------------------------------------------------------------------------
+#define LEGIC_SETUP_PRNG_STEPS   17
+#define LEGIC_READ_PRNG_STEPS    17
+#define LEGIC_MAX_CMD_SIZE       11
+
+// one bit per prng step, for len reads of the largest command size
+static uint8_t *legic_keystream(uint8_t iv, uint16_t len) {
+    uint32_t bytes = ((len * (LEGIC_MAX_CMD_SIZE + LEGIC_READ_PRNG_STEPS)) + 7) / 8;
+
+    // ks_bits reads three bytes at once
+    bytes += 2;
+    if (bytes > 0xFFFF) {
+        return NULL;
+    }
+
+    uint8_t *ks = BigBuf_malloc(bytes);
+    if (ks == NULL) {
+        return NULL;
+    }
+
+    legic_prng_init(iv);
+    legic_prng_forward(LEGIC_SETUP_PRNG_STEPS);
+    for (uint32_t i = 0; i < bytes; ++i) {
+        ks[i] = legic_prng_get_bits(8);
+    }
+    return ks;
+}
+
+// len <= 12 bits of keystream from bit pos on
+static uint32_t ks_bits(const uint8_t *ks, uint32_t pos, uint8_t len) {
+    const uint8_t *p = ks + (pos >> 3);
+    uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+    return (v >> (pos & 7)) & ((1 << len) - 1);
+}
+
+// same exchange as read_byte, keystream from bit pos of ks
+static int16_t read_byte_ks(uint16_t index, uint8_t cmd_sz, const uint8_t *ks, uint32_t pos) {
+    uint16_t cmd = (index << 1) | LEGIC_READ;
+    uint32_t tx_ks = ks_bits(ks, pos + 2, cmd_sz);
+    uint32_t rx_ks = ks_bits(ks, pos + 2 + cmd_sz + 2, 12);
+
+    LED_B_ON();
+    tx_frame_ks(cmd, cmd_sz, tx_ks);
+    uint32_t frame = rx_frame_ks(12, rx_ks);
+    LED_B_OFF();
+
+    return check_read(cmd, cmd_sz, frame);
+}
+
+// select the card and read *len bytes from offset into legic_mem, *len is cut to the card size
+static int read_range(uint16_t offset, uint16_t *len, uint8_t iv) {
+
+    int res = PM3_SUCCESS;
+
+    // the card size is only known after the setup, plan for the largest card
+    if (*len + offset > LEGIC_CARD_MEMSIZE) {
+        *len = LEGIC_CARD_MEMSIZE - offset;
+    }
+
+    // without room for the keystream it's read byte by byte
+    uint8_t *ks = legic_keystream(iv, *len);
+
+    // establish shared secret and detect card type
+    uint8_t card_type = setup_phase(iv);
+    if (init_card(card_type, &card) != PM3_SUCCESS) {
+        res = PM3_ESOFT;
+        goto OUT;
+    }
+
+    // do not read beyond card memory
+    if (*len + offset > card.cardsize) {
+        *len = card.cardsize - offset;
+    }
+
+    uint32_t pos = 0;
+    for (uint16_t i = 0; i < *len; ++i) {
+        int16_t byte;
+        if (ks) {
+            byte = read_byte_ks(offset + i, card.cmdsize, ks, pos);
+            pos += card.cmdsize + LEGIC_READ_PRNG_STEPS;
+        } else {
+            byte = read_byte(offset + i, card.cmdsize);
+        }
+
+        if (byte == -1) {
+            res = PM3_EOVFLOW;
+            goto OUT;
+        }
+        legic_mem[i] = byte;
+
+        if (i < 4) {
+            card.uid[i] = byte;
+        }
+    }
+
+OUT:
+    if (ks) {
+        BigBuf_free_keep_EM();
+    }
+    return res;
+}
+
 // Transmit write command, wait until (3.6ms) the tag sends back an unencrypted
 // ACK ('1' bit) and forward the prng time based.
 static bool write_byte(uint16_t index, uint8_t byte, uint8_t addr_sz) {
@@ -447,38 +574,11 @@ OUT:
 }
 
 int LegicRfReaderEx(uint16_t offset, uint16_t len, uint8_t iv) {
-
-    int res = PM3_SUCCESS;
-
     // configure ARM and FPGA
     init_reader();
 
-    // establish shared secret and detect card type
-    uint8_t card_type = setup_phase(iv);
-    if (init_card(card_type, &card) != PM3_SUCCESS) {
-        res = PM3_ESOFT;
-        goto OUT;
-    }
-
-    // do not read beyond card memory
-    if (len + offset > card.cardsize) {
-        len = card.cardsize - offset;
-    }
-
-    for (uint16_t i = 0; i < len; ++i) {
-        int16_t byte = read_byte(offset + i, card.cmdsize);
-        if (byte == -1) {
-            res = PM3_EOVFLOW;
-            goto OUT;
-        }
-        legic_mem[i] = byte;
-
-        if (i < 4) {
-            card.uid[i] = byte;
-        }
-    }
+    int res = read_range(offset, &len, iv);
 
-OUT:
     switch_off();
     StopTicks();
     return res;
@@ -488,35 +588,13 @@ void LegicRfReader(uint16_t offset, uint16_t len, uint8_t iv) {
     // configure ARM and FPGA
     init_reader();
 
-    // establish shared secret and detect card type
-    uint8_t card_type = setup_phase(iv);
-    if (init_card(card_type, &card) != PM3_SUCCESS) {
+    if (read_range(offset, &len, iv) != PM3_SUCCESS) {
         reply_mix(CMD_ACK, 0, 0, 0, 0, 0);
-        goto OUT;
+    } else {
+        // OK
+        reply_mix(CMD_ACK, 1, len, 0, 0, 0);
     }
 
-    // do not read beyond card memory
-    if (len + offset > card.cardsize) {
-        len = card.cardsize - offset;
-    }
-
-    for (uint16_t i = 0; i < len; ++i) {
-        int16_t byte = read_byte(offset + i, card.cmdsize);
-        if (byte == -1) {
-            reply_mix(CMD_ACK, 0, 0, 0, 0, 0);
-            goto OUT;
-        }
-        legic_mem[i] = byte;
-
-        if (i < 4) {
-            card.uid[i] = byte;
-        }
-    }
-
-    // OK
-    reply_mix(CMD_ACK, 1, len, 0, 0, 0);
-
-OUT:
     switch_off();
     StopTicks();
 }
@@ -22,10 +22,13 @@
 #include "ticks.h"
 #include "dbprint.h"
 #include "util.h"
+#include "string.h"
 
 static uint8_t *legic_mem;      /* card memory, used for sim */
+static uint8_t *legic_mem_crc;  /* crc-4 of the read answer of each address */
 static legic_card_select_t card;/* metadata of currently selected card */
 static crc_t legic_crc;
+static legic_sim_stats_t stats; /* timeslots missed, reported at the end */
 
 //-----------------------------------------------------------------------------
 // Frame timing and pseudorandom number generator
@@ -130,6 +133,10 @@ static int8_t rx_bit(void) {
 //       the subcarrier when the frame is done.
 // Note: inlining this function would fail with -Os
 static void tx_bit(bool bit) {
+    // the timeslot started already, one ssp clock of slack
+    if (GetCountSspClk() > last_frame_end + 1)
+        stats.late_bits++;
+
     LED_C_ON();
 
     if (bit) {
@@ -157,9 +164,16 @@ static void tx_bit(bool bit) {
 //-----------------------------------------------------------------------------
 
 static void tx_frame(uint32_t frame, uint8_t len) {
-    // wait for next tx timeslot
+    // the keystream of the whole frame before the timeslot, the bits only
+    // have to go out then
     last_frame_end += TAG_FRAME_WAIT;
     legic_prng_forward(TAG_FRAME_WAIT / TAG_BIT_PERIOD - 1);
+    uint32_t enc = frame ^ legic_prng_get_bits(len);
+
+    // wait for next tx timeslot
+    stats.frames++;
+    if (GetCountSspClk() > last_frame_end)
+        stats.late_frames++;
     while (GetCountSspClk() < last_frame_end) { };
 
     // backup ts for trace log
@@ -167,9 +181,7 @@ static void tx_frame(uint32_t frame, uint8_t len) {
 
     // transmit frame, MSB first
     for (uint8_t i = 0; i < len; ++i) {
-        bool bit = (frame >> i) & 0x01;
-        tx_bit(bit ^ legic_prng_get_bit());
-        legic_prng_forward(1);
+        tx_bit((enc >> i) & 0x01);
     };
 
     // disable subcarrier
@@ -184,6 +196,9 @@ static void tx_ack(void) {
     // wait for ack timeslot
     last_frame_end += TAG_ACK_WAIT;
     legic_prng_forward(TAG_ACK_WAIT / TAG_BIT_PERIOD - 1);
+    stats.frames++;
+    if (GetCountSspClk() > last_frame_end)
+        stats.late_frames++;
     while (GetCountSspClk() < last_frame_end) { };
 
     // backup ts for trace log
@@ -402,6 +417,15 @@ static uint8_t calc_crc4(uint16_t cmd, uint8_t cmd_sz, uint8_t value) {
     return crc_finish(&legic_crc);
 }
 
+// the crc of every read answer up front, a write updates its address
+static void init_crc_table(legic_card_select_t *p_card) {
+    legic_mem_crc = BigBuf_malloc(p_card->cardsize);
+    if (legic_mem_crc == NULL)
+        return;
+    for (uint16_t addr = 0; addr < p_card->cardsize; addr++)
+        legic_mem_crc[addr] = calc_crc4((addr << 1) | 1, p_card->cmdsize, legic_mem[addr]);
+}
+
 static int32_t connected_phase(legic_card_select_t *p_card) {
     uint8_t len = 0;
 
@@ -414,8 +438,13 @@ static int32_t connected_phase(legic_card_select_t *p_card) {
     // check if command is LEGIC_READ
     if (len == p_card->cmdsize) {
         // prepare data
-        uint8_t byte = legic_mem[cmd >> 1];
-        uint8_t crc = calc_crc4(cmd, p_card->cmdsize, byte);
+        uint16_t addr = cmd >> 1;
+        uint8_t byte = legic_mem[addr];
+        uint8_t crc;
+        if (legic_mem_crc && (cmd & 1) && addr < p_card->cardsize)
+            crc = legic_mem_crc[addr];
+        else
+            crc = calc_crc4(cmd, p_card->cmdsize, byte);
 
         // transmit data
         tx_frame((crc << 8) | byte, 12);
@@ -440,6 +469,8 @@ static int32_t connected_phase(legic_card_select_t *p_card) {
 
         // store data
         legic_mem[addr] = byte;
+        if (legic_mem_crc && addr < p_card->cardsize)
+            legic_mem_crc[addr] = calc_crc4((addr << 1) | 1, p_card->cmdsize, byte);
 
         // transmit ack
         tx_ack();
@@ -468,6 +499,9 @@ void LegicRfSimulate(uint8_t tagtype, bool send_reply) {
         goto OUT;
     }
 
+    memset(&stats, 0, sizeof(stats));
+    init_crc_table(&card);
+
     uint16_t counter = 0;
     LED_A_ON();
 
@@ -510,11 +544,15 @@ OUT:
     if (res == PM3_EOPABORTED)
         DbpString("aborted by user");
 
+    if (DBGLEVEL >= DBG_INFO && (stats.late_frames || stats.late_bits))
+        Dbprintf("%u frames, late %u frames %u bits", stats.frames, stats.late_frames, stats.late_bits);
+
     switch_off();
     StopTicks();
 
     if (send_reply)
-        reply_ng(CMD_HF_LEGIC_SIMULATE, res, NULL, 0);
+        reply_ng(CMD_HF_LEGIC_SIMULATE, res, (uint8_t *)&stats, sizeof(stats));
 
+    legic_mem_crc = NULL;
     BigBuf_free_keep_EM();
 }
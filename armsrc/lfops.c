@@ -10,6 +10,8 @@
 
 #include "lfops.h"
 
+#include <inttypes.h>
+
 #include "proxmark3_arm.h"
 #include "cmd.h"
 #include "BigBuf.h"
@@ -25,6 +27,7 @@
 #include "lfdemod.h"
 #include "lfsampling.h"
 #include "protocols.h"
+#include "parity.h"
 #include "pmflash.h"
 #include "flashmem.h" // persistence on flash
 #include "appmain.h" // print stack
@@ -171,6 +174,10 @@ t55xx_configurations_t T55xx_Timing  = {
 #define T55XX_DLMODE_1OF4          3 // 1 of 4
 #define T55XX_LONGLEADINGREFERENCE 4 // Value to tell Write Bit to send long reference
 
+// field on time after a write command, programming takes ~5.6ms on T55x7 and ~18ms on E5550
+#define T55XX_PROG_WAIT            (20 * 1000)
+#define T55XX_PROG_WAIT_FAST       (7 * 1000)
+
 // ATA55xx shared presets & routines
 static uint32_t GetT55xxClockBit(uint8_t clock) {
     switch (clock) {
@@ -807,9 +814,8 @@ void WriteTItag(uint32_t idhi, uint32_t idlo, uint16_t crc) {
     StopTicks();
 }
 
-// note:   a call to FpgaDownloadAndGo(FPGA_BITSTREAM_LF) must be done before, but
-//  this may destroy the bigbuf so be sure this is called before calling SimulateTagLowFrequencyEx
-void SimulateTagLowFrequencyEx(int period, int gap, bool ledcontrol, int numcycles) {
+// sets up the FPGA for tag simulation at the divisor of `lf config`
+static void lf_sim_setup(void) {
 
     // start us timer
     StartTicks();
@@ -818,9 +824,6 @@ void SimulateTagLowFrequencyEx(int period, int gap, bool ledcontrol, int numcycl
     FpgaWriteConfWord(FPGA_MAJOR_MODE_LF_EDGE_DETECT);
     WaitMS(20);
 
-    int i = 0, x = 0;
-    uint8_t *buf = BigBuf_get_addr();
-
     // set frequency,  get values from 'lf config' command
     sample_config *sc = getSamplingConfig();
 
@@ -834,8 +837,39 @@ void SimulateTagLowFrequencyEx(int period, int gap, bool ledcontrol, int numcycl
     AT91C_BASE_PIOA->PIO_PER = GPIO_SSC_DOUT | GPIO_SSC_CLK;
     AT91C_BASE_PIOA->PIO_OER = GPIO_SSC_DOUT;
     AT91C_BASE_PIOA->PIO_ODR = GPIO_SSC_CLK;
+}
 
+// waits until SSC_CLK is at the level given, the reader field clocks the simulation.
+// false on button or client command
+static inline bool lf_sim_wait_clk(bool high) {
     uint16_t check = 0;
+    while (((AT91C_BASE_PIOA->PIO_PDSR & GPIO_SSC_CLK) != 0) != high) {
+        WDT_HIT();
+        if (check == 1000) {
+            if (data_available() || BUTTON_PRESS())
+                return false;
+            check = 0;
+        }
+        ++check;
+    }
+    return true;
+}
+
+static void lf_sim_stop(void) {
+    StopTicks();
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    LED_D_OFF();
+}
+
+// note:   a call to FpgaDownloadAndGo(FPGA_BITSTREAM_LF) must be done before, but
+//  this may destroy the bigbuf so be sure this is called before calling SimulateTagLowFrequencyEx
+// returns PM3_SUCCESS after numcycles field clocks, PM3_EOPABORTED on button or client command
+int SimulateTagLowFrequencyEx(int period, int gap, bool ledcontrol, int numcycles) {
+
+    lf_sim_setup();
+
+    int i = 0, x = 0;
+    uint8_t *buf = BigBuf_get_addr();
 
     for (;;) {
 
@@ -844,7 +878,7 @@ void SimulateTagLowFrequencyEx(int period, int gap, bool ledcontrol, int numcycl
                 ++x;
             } else {
                 // exit without turning off field
-                return;
+                return PM3_SUCCESS;
             }
         }
 
@@ -852,15 +886,8 @@ void SimulateTagLowFrequencyEx(int period, int gap, bool ledcontrol, int numcycl
 
         // wait until SSC_CLK goes HIGH
         // used as a simple detection of a reader field?
-        while (!(AT91C_BASE_PIOA->PIO_PDSR & GPIO_SSC_CLK)) {
-            WDT_HIT();
-            if (check == 1000) {
-                if (data_available() || BUTTON_PRESS())
-                    goto OUT;
-                check = 0;
-            }
-            ++check;
-        }
+        if (lf_sim_wait_clk(true) == false)
+            break;
 
         if (ledcontrol) LED_D_OFF();
 
@@ -869,18 +896,9 @@ void SimulateTagLowFrequencyEx(int period, int gap, bool ledcontrol, int numcycl
         else
             SHORT_COIL();
 
-        check = 0;
-
         //wait until SSC_CLK goes LOW
-        while (AT91C_BASE_PIOA->PIO_PDSR & GPIO_SSC_CLK) {
-            WDT_HIT();
-            if (check == 1000) {
-                if (data_available() || BUTTON_PRESS())
-                    goto OUT;
-                check = 0;
-            }
-            ++check;
-        }
+        if (lf_sim_wait_clk(false) == false)
+            break;
 
         i++;
         if (i == period) {
@@ -891,46 +909,170 @@ void SimulateTagLowFrequencyEx(int period, int gap, bool ledcontrol, int numcycl
             }
         }
     }
-OUT:
-    StopTicks();
-    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
-    LED_D_OFF();
+
+    lf_sim_stop();
+    return PM3_EOPABORTED;
 }
 
 void SimulateTagLowFrequency(int period, int gap, bool ledcontrol) {
     SimulateTagLowFrequencyEx(period, gap, ledcontrol, -1);
 }
 
+// Same as SimulateTagLowFrequencyEx, playing a run table instead of one sample per field clock
+int SimulateTagLowFrequencyRuns(const lf_sim_wave_t *wave, int gap, bool ledcontrol, int numcycles) {
+
+    if (wave->count == 0)
+        return PM3_EINVARG;
+
+    lf_sim_setup();
+
+    const lf_sim_run_t *run = wave->runs;
+    const lf_sim_run_t *end = wave->runs + wave->count;
+    uint8_t left = run->first;
+    uint8_t repeat = run->repeat;
+    uint8_t level = run->level;
+    bool first = true;
+    int x = 0;
+
+    for (;;) {
+
+        if (numcycles > -1) {
+            if (x != numcycles) {
+                ++x;
+            } else {
+                // exit without turning off field
+                return PM3_SUCCESS;
+            }
+        }
+
+        if (ledcontrol) LED_D_ON();
+
+        if (lf_sim_wait_clk(true) == false)
+            break;
+
+        if (ledcontrol) LED_D_OFF();
+
+        if (level)
+            OPEN_COIL();
+        else
+            SHORT_COIL();
+
+        if (lf_sim_wait_clk(false) == false)
+            break;
+
+        // next field clock
+        if (--left)
+            continue;
+
+        if (first && run->second) {
+            first = false;
+            left = run->second;
+            level ^= 1;
+            continue;
+        }
+
+        if (--repeat == 0) {
+            if (++run == end) {
+                run = wave->runs;
+                if (gap) {
+                    SHORT_COIL();
+                    WaitUS(gap);
+                }
+            }
+            repeat = run->repeat;
+        }
+        first = true;
+        left = run->first;
+        level = run->level;
+    }
+
+    lf_sim_stop();
+    return PM3_EOPABORTED;
+}
+
+// run tables are built at the start of BigBuf, below anything allocated
+static void lf_sim_wave_init(lf_sim_wave_t *wave) {
+    wave->runs = (lf_sim_run_t *)BigBuf_get_addr();
+    wave->max = MIN(BigBuf_max_traceLen() / sizeof(lf_sim_run_t), 0xFFFF);
+    wave->count = 0;
+    wave->len = 0;
+    wave->overflow = false;
+}
+
+// adds one wave of lo field clocks at level and hi at the other. Same waves in a row share a run
+static void lf_sim_wave_add(lf_sim_wave_t *wave, uint8_t level, uint8_t lo, uint8_t hi) {
+
+    if (lo == 0) {
+        if (hi == 0)
+            return;
+        lo = hi;
+        hi = 0;
+        level ^= 1;
+    }
+
+    wave->len += lo + hi;
+
+    if (wave->count) {
+        lf_sim_run_t *last = &wave->runs[wave->count - 1];
+        if (last->level == level && last->first == lo && last->second == hi && last->repeat < 0xFF) {
+            last->repeat++;
+            return;
+        }
+    }
+
+    if (wave->count == wave->max) {
+        wave->overflow = true;
+        return;
+    }
+
+    wave->runs[wave->count++] = (lf_sim_run_t) { .first = lo, .second = hi, .level = level, .repeat = 1 };
+}
+
+// a constant level of any length
+static void lf_sim_wave_level(lf_sim_wave_t *wave, uint8_t level, uint16_t len) {
+    while (len > 0xFF) {
+        lf_sim_wave_add(wave, level, 0xFF, 0);
+        len -= 0xFF;
+    }
+    lf_sim_wave_add(wave, level, len, 0);
+}
 
 #define DEBUG_FRAME_CONTENTS 1
 void SimulateTagLowFrequencyBidir(int divisor, int max_bitlen) {
 }
 
 // compose fc/X fc/Y waveform (FSKx)
-static void fcAll(uint8_t fc, int *n, uint8_t clock, int16_t *remainder) {
-    uint8_t *dest = BigBuf_get_addr();
+static void fcAll(lf_sim_wave_t *wave, uint8_t fc, uint8_t clock, int16_t *remainder) {
     uint8_t halfFC = fc >> 1;
     uint8_t wavesPerClock = (clock + *remainder) / fc;
     // loop through clock - step field clock
     for (uint8_t idx = 0; idx < wavesPerClock; idx++) {
         // put 1/2 FC length 1's and 1/2 0's per field clock wave (to create the wave)
-        memset(dest + (*n), 0, fc - halfFC);  //in case of odd number use extra here
-        memset(dest + (*n) + (fc - halfFC), 1, halfFC);
-        *n += fc;
+        lf_sim_wave_add(wave, 0, fc - halfFC, halfFC);  //in case of odd number use extra here
     }
     *remainder = (clock + *remainder) % fc;
     // if we've room for more than a half wave, add a full wave and use negative remainder
     if (*remainder > halfFC) {
-        memset(dest + (*n), 0, fc - halfFC);  //in case of odd number use extra here
-        memset(dest + (*n) + (fc - halfFC), 1, halfFC);
-        *n += fc;
+        lf_sim_wave_add(wave, 0, fc - halfFC, halfFC);
         *remainder -= fc;
     }
 }
 
-// prepare a waveform pattern in the buffer based on the ID given then
-// simulate a HID tag until the button is pressed
-void CmdHIDsimTAGEx(uint32_t hi2, uint32_t hi, uint32_t lo, uint8_t longFMT, bool ledcontrol, int numcycles) {
+// compose the FSK waveform of a bit stream
+static void fskBuildBits(lf_sim_wave_t *wave, uint8_t fchigh, uint8_t fclow, uint8_t clk, uint16_t bitslen, const uint8_t *bits) {
+    int16_t remainder = 0;
+    for (uint16_t i = 0; i < bitslen; i++) {
+        if (bits[i])
+            fcAll(wave, fchigh, clk, &remainder);
+        else
+            fcAll(wave, fclow, clk, &remainder);
+    }
+}
+
+#define HID_SIM_BITS_MAX    (8 + 8 * 2 + 84 * 2)
+
+// HID bit stream of the ID given, returns its length or 0 when the ID doesn't fit
+static uint16_t hidBuildBits(uint32_t hi2, uint32_t hi, uint32_t lo, uint8_t longFMT, uint8_t *bits) {
 
     /*
      HID tag bitstream format
@@ -947,15 +1089,16 @@ void CmdHIDsimTAGEx(uint32_t hi2, uint32_t hi, uint32_t lo, uint8_t longFMT, boo
     */
 
     // special start of frame marker containing invalid Manchester bit sequences
-    uint8_t bits[8 + 8 * 2 + 84 * 2] = { 0, 0, 0, 1, 1, 1, 0, 1 };
-    uint8_t bitlen = 0;
+    static const uint8_t sof[8] = { 0, 0, 0, 1, 1, 1, 0, 1 };
+    memcpy(bits, sof, sizeof(sof));
+    uint16_t bitlen = 0;
     uint16_t n = 8;
 
     if (longFMT) {
         // Ensure no more than 84 bits supplied
         if (hi2 > 0xFFFFF) {
             DbpString("Tags can only have 84 bits.");
-            return;
+            return 0;
         }
         bitlen = 8 + 8 * 2 + 84 * 2;
         hi2 |= 0x9E00000; // 9E: long format identifier
@@ -966,12 +1109,22 @@ void CmdHIDsimTAGEx(uint32_t hi2, uint32_t hi, uint32_t lo, uint8_t longFMT, boo
 
         if (hi > 0xFFF) {
             DbpString("[!] tags can only have 44 bits. - USE lf simfsk for larger tags");
-            return;
+            return 0;
         }
         bitlen = 8 + 44 * 2;
         manchesterEncodeUint32(hi, 12, bits, &n);
         manchesterEncodeUint32(lo, 32, bits, &n);
     }
+    return bitlen;
+}
+
+// prepare a waveform pattern in the buffer based on the ID given then
+// simulate a HID tag until the button is pressed
+void CmdHIDsimTAGEx(uint32_t hi2, uint32_t hi, uint32_t lo, uint8_t longFMT, bool ledcontrol, int numcycles) {
+    uint8_t bits[HID_SIM_BITS_MAX];
+    uint16_t bitlen = hidBuildBits(hi2, hi, lo, longFMT, bits);
+    if (bitlen == 0)
+        return;
     CmdFSKsimTAGEx(10, 8, 0, 50, bitlen, bits, ledcontrol, numcycles);
 }
 
@@ -980,6 +1133,22 @@ void CmdHIDsimTAG(uint32_t hi2, uint32_t hi, uint32_t lo, uint8_t longFMT, bool
     reply_ng(CMD_LF_HID_SIMULATE, PM3_EOPABORTED, NULL, 0);
 }
 
+// runs the waveform built, PM3_EOVFLOW when it didn't fit
+static int lf_sim_wave_run(const lf_sim_wave_t *wave, bool ledcontrol, int numcycles) {
+
+    WDT_HIT();
+
+    if (wave->overflow) {
+        Dbprintf("waveform too long, %u runs max", wave->max);
+        return PM3_EOVFLOW;
+    }
+
+    if (ledcontrol) LED_A_ON();
+    int res = SimulateTagLowFrequencyRuns(wave, 0, ledcontrol, numcycles);
+    if (ledcontrol) LED_A_OFF();
+    return res;
+}
+
 // prepare a waveform pattern in the buffer based on the ID given then
 // simulate a FSK tag until the button is pressed
 // arg1 contains fcHigh and fcLow, arg2 contains STT marker and clock
@@ -987,33 +1156,24 @@ void CmdFSKsimTAGEx(uint8_t fchigh, uint8_t fclow, uint8_t separator, uint8_t cl
 
     FpgaDownloadAndGo(FPGA_BITSTREAM_LF);
 
-    // free eventually allocated BigBuf memory
+    // free eventually allocated BigBuf memory. The run table covers all of the waveform,
+    // no need to clear the buffer when switching ids
     BigBuf_free();
-    BigBuf_Clear_ext(false);
     clear_trace();
     set_tracing(false);
 
-    int n = 0, i = 0;
-    int16_t remainder = 0;
-
     if (separator) {
         //int fsktype = ( fchigh == 8 && fclow == 5) ? 1 : 2;
         //fcSTT(&n);
     }
-    for (i = 0; i < bitslen; i++) {
-        if (bits[i])
-            fcAll(fchigh, &n, clk, &remainder);
-        else
-            fcAll(fclow, &n, clk, &remainder);
-    }
-
-    WDT_HIT();
+    lf_sim_wave_t wave;
+    lf_sim_wave_init(&wave);
+    fskBuildBits(&wave, fchigh, fclow, clk, bitslen, bits);
 
-    Dbprintf("Simulating with fcHigh: %d, fcLow: %d, clk: %d, STT: %d, n: %d", fchigh, fclow, clk, separator, n);
+    if (numcycles == -1)
+        Dbprintf("Simulating with fcHigh: %d, fcLow: %d, clk: %d, STT: %d, n: %u, runs: %u", fchigh, fclow, clk, separator, wave.len, wave.count);
 
-    if (ledcontrol) LED_A_ON();
-    SimulateTagLowFrequencyEx(n, 0, ledcontrol, numcycles);
-    if (ledcontrol) LED_A_OFF();
+    lf_sim_wave_run(&wave, ledcontrol, numcycles);
 }
 
 // prepare a waveform pattern in the buffer based on the ID given then
@@ -1025,55 +1185,42 @@ void CmdFSKsimTAG(uint8_t fchigh, uint8_t fclow, uint8_t separator, uint8_t clk,
 }
 
 // compose ask waveform for one bit(ASK)
-static void askSimBit(uint8_t c, int *n, uint8_t clock, uint8_t manchester) {
-    uint8_t *dest = BigBuf_get_addr();
+static void askSimBit(lf_sim_wave_t *wave, uint8_t c, uint8_t clock, uint8_t manchester) {
     uint8_t halfClk = clock / 2;
     // c = current bit 1 or 0
     if (manchester == 1) {
-        memset(dest + (*n), c, halfClk);
-        memset(dest + (*n) + halfClk, c ^ 1, halfClk);
+        lf_sim_wave_add(wave, c, halfClk, clock - halfClk);
     } else {
-        memset(dest + (*n), c, clock);
+        lf_sim_wave_add(wave, c, clock, 0);
     }
-    *n += clock;
 }
 
-static void biphaseSimBit(uint8_t c, int *n, uint8_t clock, uint8_t *phase) {
-    uint8_t *dest = BigBuf_get_addr();
+static void biphaseSimBit(lf_sim_wave_t *wave, uint8_t c, uint8_t clock, uint8_t *phase) {
     uint8_t halfClk = clock / 2;
     if (c) {
-        memset(dest + (*n), c ^ 1 ^ *phase, halfClk);
-        memset(dest + (*n) + halfClk, c ^ *phase, halfClk);
+        lf_sim_wave_add(wave, *phase, halfClk, clock - halfClk);
     } else {
-        memset(dest + (*n), c ^ *phase, clock);
+        lf_sim_wave_add(wave, *phase, clock, 0);
         *phase ^= 1;
     }
-    *n += clock;
 }
 
-static void stAskSimBit(int *n, uint8_t clock) {
-    uint8_t *dest = BigBuf_get_addr();
+static void stAskSimBit(lf_sim_wave_t *wave, uint8_t clock) {
     uint8_t halfClk = clock / 2;
     //ST = .5 high .5 low 1.5 high .5 low 1 high
-    memset(dest + (*n), 1, halfClk);
-    memset(dest + (*n) + halfClk, 0, halfClk);
-    memset(dest + (*n) + clock, 1, clock + halfClk);
-    memset(dest + (*n) + clock * 2 + halfClk, 0, halfClk);
-    memset(dest + (*n) + clock * 3, 1, clock);
-    *n += clock * 4;
-}
-static void leadingZeroAskSimBits(int *n, uint8_t clock) {
-    uint8_t *dest = BigBuf_get_addr();
-    memset(dest + (*n), 0, clock * 8);
-    *n += clock * 8;
+    lf_sim_wave_add(wave, 1, halfClk, clock - halfClk);
+    lf_sim_wave_level(wave, 1, clock + halfClk);
+    lf_sim_wave_add(wave, 0, clock - halfClk, 0);
+    lf_sim_wave_add(wave, 1, clock, 0);
+}
+static void leadingZeroAskSimBits(lf_sim_wave_t *wave, uint8_t clock) {
+    lf_sim_wave_level(wave, 0, clock * 8);
 }
 /*
-static void leadingZeroBiphaseSimBits(int *n, uint8_t clock, uint8_t *phase) {
-    uint8_t *dest = BigBuf_get_addr();
+static void leadingZeroBiphaseSimBits(lf_sim_wave_t *wave, uint8_t clock, uint8_t *phase) {
     for (uint8_t i = 0; i < 8; i++) {
-        memset(dest + (*n), 0 ^ *phase, clock);
+        lf_sim_wave_add(wave, *phase, clock, 0);
         *phase ^= 1;
-        *n += clock;
     }
 }
 */
@@ -1084,7 +1231,9 @@ void CmdASKsimTAG(uint8_t encoding, uint8_t invert, uint8_t separator, uint8_t c
     FpgaDownloadAndGo(FPGA_BITSTREAM_LF);
     set_tracing(false);
 
-    int n = 0, i = 0;
+    lf_sim_wave_t wave;
+    lf_sim_wave_init(&wave);
+    int i = 0;
 
     if (encoding == 2) { //biphase
         uint8_t phase = 0;
@@ -1092,70 +1241,154 @@ void CmdASKsimTAG(uint8_t encoding, uint8_t invert, uint8_t separator, uint8_t c
 // iceman,  if I add this,  the demod includes these extra zero and detection fails.
 // now, I only need to figure out just to add carrier without modulation
 // the old bug, with adding ask zeros messed up the phase variable and deteion failed because of it in LF FDX
-//        leadingZeroBiphaseSimBits(&n, clk, &phase);
+//        leadingZeroBiphaseSimBits(&wave, clk, &phase);
 
         for (i = 0; i < size; i++) {
-            biphaseSimBit(bits[i] ^ invert, &n, clk, &phase);
+            biphaseSimBit(&wave, bits[i] ^ invert, clk, &phase);
         }
         if (phase == 1) { //run a second set inverted to keep phase in check
             for (i = 0; i < size; i++) {
-                biphaseSimBit(bits[i] ^ invert, &n, clk, &phase);
+                biphaseSimBit(&wave, bits[i] ^ invert, clk, &phase);
             }
         }
     } else {  // ask/manchester || ask/raw
 
-        leadingZeroAskSimBits(&n, clk);
+        leadingZeroAskSimBits(&wave, clk);
 
         for (i = 0; i < size; i++) {
-            askSimBit(bits[i] ^ invert, &n, clk, encoding);
+            askSimBit(&wave, bits[i] ^ invert, clk, encoding);
         }
         if (encoding == 0 && bits[0] == bits[size - 1]) { //run a second set inverted (for ask/raw || biphase phase)
             for (i = 0; i < size; i++) {
-                askSimBit(bits[i] ^ invert ^ 1, &n, clk, encoding);
+                askSimBit(&wave, bits[i] ^ invert ^ 1, clk, encoding);
             }
         }
     }
     if (separator == 1 && encoding == 1)
-        stAskSimBit(&n, clk);
+        stAskSimBit(&wave, clk);
     else if (separator == 1)
         Dbprintf("sorry but separator option not yet available");
 
-    WDT_HIT();
-
-    Dbprintf("Simulating with clk: %d, invert: %d, encoding: %s (%d), separator: %d, n: %d"
+    Dbprintf("Simulating with clk: %d, invert: %d, encoding: %s (%d), separator: %d, n: %u, runs: %u"
              , clk
              , invert
              , (encoding == 2) ? "BI" : (encoding == 1) ? "ASK" : "RAW"
              , encoding
              , separator
-             , n
+             , wave.len
+             , wave.count
             );
 
-    if (ledcontrol) LED_A_ON();
-    SimulateTagLowFrequency(n, 0, ledcontrol);
-    if (ledcontrol) LED_A_OFF();
-    reply_ng(CMD_LF_ASK_SIMULATE, PM3_EOPABORTED, NULL, 0);
+    int res = lf_sim_wave_run(&wave, ledcontrol, -1);
+    reply_ng(CMD_LF_ASK_SIMULATE, (res == PM3_EOVFLOW) ? res : PM3_EOPABORTED, NULL, 0);
+}
+
+// EM410x frame of a 40 bit id, Manchester coded like `lf em 410x_sim`. 9 header ones,
+// ten rows of 4 bits and even parity, the column parity and a stop bit
+static void em410xBuildWave(lf_sim_wave_t *wave, uint64_t id, uint8_t clk) {
+    uint8_t colparity = 0;
+
+    for (uint8_t i = 0; i < 9; i++)
+        askSimBit(wave, 1, clk, 1);
+
+    for (int8_t row = 9; row >= 0; row--) {
+        uint8_t nibble = (id >> (row * 4)) & 0x0F;
+        for (int8_t j = 3; j >= 0; j--)
+            askSimBit(wave, (nibble >> j) & 1, clk, 1);
+        askSimBit(wave, evenparity8(nibble), clk, 1);
+        colparity ^= nibble;
+    }
+
+    for (int8_t j = 3; j >= 0; j--)
+        askSimBit(wave, (colparity >> j) & 1, clk, 1);
+    askSimBit(wave, 0, clk, 1);
+}
+
+// H10301 26 bit with the standard HID header
+static void hid26Pack(uint8_t fc, uint16_t cn, uint32_t *hi, uint32_t *lo) {
+    uint32_t bot = ((uint32_t)fc << 17) | ((uint32_t)cn << 1);
+    bot |= oddparity32((bot >> 1) & 0xFFF);
+    bot |= (uint32_t)evenparity32((bot >> 13) & 0xFFF) << 25;
+    *lo = bot | (1 << 26);
+    *hi = 0x20;
+}
+
+// Id sweep for `lf em 410x_sweep`, `lf em 410x_brute` and `lf hid sweep`. Each candidate gets its run table
+// and is simulated for the dwell time, the loop stays on the device until the range or list is done
+void CmdLFSimSweep(const sim_sweep_t *p) {
+
+    if ((p->type != SIM_SWEEP_EM410X && p->type != SIM_SWEEP_HID26 && p->type != SIM_SWEEP_EM410X_LIST) || p->dwell == 0 || p->count == 0
+            || (p->type == SIM_SWEEP_EM410X_LIST && p->count > SIM_SWEEP_LIST_MAX)) {
+        reply_ng(CMD_LF_SIM_SWEEP, PM3_EINVARG, NULL, 0);
+        return;
+    }
+
+    uint8_t clk = (p->clock) ? p->clock : 64;
+
+    FpgaDownloadAndGo(FPGA_BITSTREAM_LF);
+    BigBuf_free();
+    clear_trace();
+    set_tracing(false);
+
+    // the list out of the packet buffer
+    uint8_t *ids = NULL;
+    if (p->type == SIM_SWEEP_EM410X_LIST) {
+        ids = BigBuf_malloc(p->count * 5);
+        memcpy(ids, (const uint8_t *)p + sizeof(sim_sweep_t), p->count * 5);
+    }
+
+    // field clocks at 125kHz, 8us each
+    int cycles = p->dwell * 125;
+
+    sim_sweep_resp_t resp = { .index = 0, .value = p->start };
+    int res = PM3_SUCCESS;
+    uint32_t last = GetTickCount();
+
+    LED_A_ON();
+    for (uint32_t i = 0; i < p->count; i++) {
+
+        resp.index = i;
+        resp.value = (ids) ? bytes_to_num(ids + i * 5, 5) : p->start + (uint64_t)i * p->step;
+
+        lf_sim_wave_t wave;
+        lf_sim_wave_init(&wave);
+        if (p->type == SIM_SWEEP_EM410X || p->type == SIM_SWEEP_EM410X_LIST) {
+            resp.value &= 0xFFFFFFFFFFULL;
+            em410xBuildWave(&wave, resp.value, clk);
+        } else {
+            resp.value &= 0xFFFF;
+            uint32_t hi, lo;
+            uint8_t bits[HID_SIM_BITS_MAX];
+            hid26Pack(p->fc, resp.value, &hi, &lo);
+            uint16_t bitlen = hidBuildBits(0, hi, lo, 0, bits);
+            fskBuildBits(&wave, 10, 8, 50, bitlen, bits);
+        }
+
+        res = SimulateTagLowFrequencyRuns(&wave, 0, true, cycles);
+        if (res != PM3_SUCCESS)
+            break;
+
+        if (GetTickCount() - last > 1000) {
+            reply_ng(CMD_LF_SIM_SWEEP, PM3_EPARTIAL, (uint8_t *)&resp, sizeof(resp));
+            last = GetTickCount();
+        }
+    }
+
+    StopTicks();
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    LEDsoff();
+    reply_ng(CMD_LF_SIM_SWEEP, res, (uint8_t *)&resp, sizeof(resp));
 }
 
 //carrier can be 2,4 or 8
-static void pskSimBit(uint8_t waveLen, int *n, uint8_t clk, uint8_t *curPhase, bool phaseChg) {
-    uint8_t *dest = BigBuf_get_addr();
+static void pskSimBit(lf_sim_wave_t *wave, uint8_t waveLen, uint8_t clk, uint8_t *curPhase, bool phaseChg) {
     uint8_t halfWave = waveLen / 2;
-    //uint8_t idx;
-    int i = 0;
-    if (phaseChg) {
-        // write phase change
-        memset(dest + (*n), *curPhase ^ 1, halfWave);
-        memset(dest + (*n) + halfWave, *curPhase, halfWave);
-        *n += waveLen;
+    // a phase change is the first wave of the new phase
+    if (phaseChg)
         *curPhase ^= 1;
-        i += waveLen;
-    }
     //write each normal clock wave for the clock duration
-    for (; i < clk; i += waveLen) {
-        memset(dest + (*n), *curPhase, halfWave);
-        memset(dest + (*n) + halfWave, *curPhase ^ 1, halfWave);
-        *n += waveLen;
+    for (int i = 0; i < clk; i += waveLen) {
+        lf_sim_wave_add(wave, *curPhase, halfWave, waveLen - halfWave);
     }
 }
 
@@ -1164,33 +1397,27 @@ void CmdPSKsimTAG(uint8_t carrier, uint8_t invert, uint8_t clk, uint16_t size, u
     FpgaDownloadAndGo(FPGA_BITSTREAM_LF);
     set_tracing(false);
 
-    int n = 0, i = 0;
+    lf_sim_wave_t wave;
+    lf_sim_wave_init(&wave);
     uint8_t curPhase = 0;
-    for (i = 0; i < size; i++) {
+    for (int i = 0; i < size; i++) {
         if (bits[i] == curPhase) {
-            pskSimBit(carrier, &n, clk, &curPhase, false);
+            pskSimBit(&wave, carrier, clk, &curPhase, false);
         } else {
-            pskSimBit(carrier, &n, clk, &curPhase, true);
+            pskSimBit(&wave, carrier, clk, &curPhase, true);
         }
     }
 
-    WDT_HIT();
-
-    Dbprintf("Simulating with Carrier: %d, clk: %d, invert: %d, n: %d", carrier, clk, invert, n);
+    Dbprintf("Simulating with Carrier: %d, clk: %d, invert: %d, n: %u, runs: %u", carrier, clk, invert, wave.len, wave.count);
 
-    if (ledcontrol) LED_A_ON();
-    SimulateTagLowFrequency(n, 0, ledcontrol);
-    if (ledcontrol) LED_A_OFF();
-    reply_ng(CMD_LF_PSK_SIMULATE, PM3_EOPABORTED, NULL, 0);
+    int res = lf_sim_wave_run(&wave, ledcontrol, -1);
+    reply_ng(CMD_LF_PSK_SIMULATE, (res == PM3_EOVFLOW) ? res : PM3_EOPABORTED, NULL, 0);
 }
 
 // compose nrz waveform for one bit(NRZ)
-static void nrzSimBit(uint8_t c, int *n, uint8_t clock) {
-    uint8_t *dest = BigBuf_get_addr();
-//    uint8_t halfClk = clock / 2;
+static void nrzSimBit(lf_sim_wave_t *wave, uint8_t c, uint8_t clock) {
     // c = current bit 1 or 0
-    memset(dest + (*n), c, clock);
-    *n += clock;
+    lf_sim_wave_add(wave, c, clock, 0);
 }
 
 // args clock,
@@ -1199,324 +1426,370 @@ void CmdNRZsimTAG(uint8_t invert, uint8_t separator, uint8_t clk, uint16_t size,
     FpgaDownloadAndGo(FPGA_BITSTREAM_LF);
     set_tracing(false);
 
-    int n = 0, i = 0;
+    lf_sim_wave_t wave;
+    lf_sim_wave_init(&wave);
+    int i = 0;
 
     // NRZ
 
-    leadingZeroAskSimBits(&n, clk);
+    leadingZeroAskSimBits(&wave, clk);
 
     for (i = 0; i < size; i++) {
-        nrzSimBit(bits[i] ^ invert, &n, clk);
+        nrzSimBit(&wave, bits[i] ^ invert, clk);
     }
 
     if (bits[0] == bits[size - 1]) {
         for (i = 0; i < size; i++) {
-            nrzSimBit(bits[i] ^ invert ^ 1, &n, clk);
+            nrzSimBit(&wave, bits[i] ^ invert ^ 1, clk);
         }
     }
 
     if (separator == 1)
         Dbprintf("sorry but separator option not yet available");
 
-    WDT_HIT();
-
-    Dbprintf("Simulating with clk: %d, invert: %d, separator: %d, n: %d"
+    Dbprintf("Simulating with clk: %d, invert: %d, separator: %d, n: %u, runs: %u"
              , clk
              , invert
              , separator
-             , n
+             , wave.len
+             , wave.count
             );
 
-    if (ledcontrol) LED_A_ON();
-    SimulateTagLowFrequency(n, 0, ledcontrol);
-    if (ledcontrol) LED_A_OFF();
-    reply_ng(CMD_LF_NRZ_SIMULATE, PM3_EOPABORTED, NULL, 0);
+    int res = lf_sim_wave_run(&wave, ledcontrol, -1);
+    reply_ng(CMD_LF_NRZ_SIMULATE, (res == PM3_EOVFLOW) ? res : PM3_EOPABORTED, NULL, 0);
 }
 
-// loop to get raw HID waveform then FSK demodulate the TAG ID from it
-int lf_hid_watch(int findone, uint32_t *high, uint32_t *low) {
+// the IDs seen last, a badge on the antenna keeps refreshing its entry instead of being
+// reported again
+static bool lf_watch_seen(lf_watch_cache_t *cache, const lf_watch_id_t *id) {
+
+    uint32_t now = GetTickCount();
+    uint8_t oldest = 0;
+
+    for (uint8_t i = 0; i < LF_WATCH_CACHE_SIZE; i++) {
+        lf_watch_cache_entry_t *e = &cache->entry[i];
+        if (e->type == id->type && e->hi2 == id->hi2 && e->hi == id->hi && e->lo == id->lo) {
+            bool seen = (now - e->last < LF_WATCH_DEDUPE_MS);
+            e->last = now;
+            return seen;
+        }
+        if (e->last < cache->entry[oldest].last)
+            oldest = i;
+    }
+
+    lf_watch_cache_entry_t *e = &cache->entry[oldest];
+    e->type = id->type;
+    e->hi2 = id->hi2;
+    e->hi = id->hi;
+    e->lo = id->lo;
+    e->last = now;
+    return false;
+}
+
+static bool lf_watch_hid(uint8_t *dest, lf_watch_id_t *id) {
 
-    size_t size;
     uint32_t hi2 = 0, hi = 0, lo = 0;
     int dummyIdx = 0;
-    // Configure to go in 125kHz listen mode
-    LFSetupFPGAForADC(LF_DIVISOR_125, true);
 
-    uint8_t *dest = BigBuf_get_addr();
-    BigBuf_Clear_keep_EM();
-    clear_trace();
-    set_tracing(false);
+    // FSK demodulator
+    // 50 * 128 * 2 - big enough to catch 2 sequences of largest format
+    size_t size = MIN(12800, BigBuf_max_traceLen());
 
-    //clear read buffer
-    BigBuf_Clear_keep_EM();
+    int idx = HIDdemodFSK(dest, &size, &hi2, &hi, &lo, &dummyIdx);
+    if (idx <= 0 || lo == 0 || (size != 96 && size != 192))
+        return false;
 
-    int res = PM3_SUCCESS;
-    uint16_t interval = 0;
-    while (BUTTON_PRESS() == false) {
+    id->type = LF_WATCH_HID;
+    id->hi2 = hi2;
+    id->hi = hi;
+    id->lo = lo;
 
-        WDT_HIT();
+    // go over previously decoded manchester data and decode into usable tag ID
+    if (hi2 != 0) { //extra large HID tags  88/192 bits
+        sprintf(id->desc, "HID TAG ID: %"PRIx32"%08"PRIx32"%08"PRIx32" (%"PRIu32")", hi2, hi, lo, (lo >> 1) & 0xFFFF);
+        return true;
+    }
 
-        // cancel w usb command.
-        if (interval == 4000) {
-            if (data_available()) {
-                res = PM3_EOPABORTED;
-                break;
-            }
-            interval = 0;
+    //standard HID tags 44/96 bits
+    uint8_t bitlen = 0;
+    uint32_t fac = 0;
+    uint32_t cardnum = 0;
+
+    if (((hi >> 5) & 1) == 1) { //if bit 38 is set then < 37 bit format is used
+        uint32_t lo2 = 0;
+        lo2 = (((hi & 31) << 12) | (lo >> 20)); //get bits 21-37 to check for format len bit
+        uint8_t idx3 = 1;
+        while (lo2 > 1) { //find last bit set to 1 (format len bit)
+            lo2 >>= 1;
+            idx3++;
+        }
+        bitlen = idx3 + 19;
+        if (bitlen == 26) {
+            cardnum = (lo >> 1) & 0xFFFF;
+            fac = (lo >> 17) & 0xFF;
+        }
+        if (bitlen == 37) {
+            cardnum = (lo >> 1) & 0x7FFFF;
+            fac = ((hi & 0xF) << 12) | (lo >> 20);
+        }
+        if (bitlen == 34) {
+            cardnum = (lo >> 1) & 0xFFFF;
+            fac = ((hi & 1) << 15) | (lo >> 17);
+        }
+        if (bitlen == 35) {
+            cardnum = (lo >> 1) & 0xFFFFF;
+            fac = ((hi & 1) << 11) | (lo >> 21);
+        }
+    } else { //if bit 38 is not set then 37 bit format is used
+        bitlen = 37;
+        cardnum = (lo >> 1) & 0x7FFFF;
+        fac = ((hi & 0xF) << 12) | (lo >> 20);
+    }
+    sprintf(id->desc, "HID TAG ID: %"PRIx32"%08"PRIx32" (%"PRIu32") - Format Len: %u bit - FC: %"PRIu32" - Card: %"PRIu32,
+            hi, lo, (lo >> 1) & 0xFFFF, bitlen, fac, cardnum);
+    return true;
+}
+
+static bool lf_watch_awid(uint8_t *dest, lf_watch_id_t *id) {
+
+    int dummyIdx = 0;
+    size_t size = MIN(12800, BigBuf_max_traceLen());
+
+    //askdemod and manchester decode
+    int idx = detectAWID(dest, &size, &dummyIdx);
+    if (idx <= 0 || size != 96)
+        return false;
+
+    // Index map
+    // 0            10            20            30              40            50              60
+    // |            |             |             |               |             |               |
+    // 01234567 890 1 234 5 678 9 012 3 456 7 890 1 234 5 678 9 012 3 456 7 890 1 234 5 678 9 012 3 - to 96
+    // -----------------------------------------------------------------------------
+    // 00000001 000 1 110 1 101 1 011 1 101 1 010 0 000 1 000 1 010 0 001 0 110 1 100 0 000 1 000 1
+    // premable bbb o bbb o bbw o fff o fff o ffc o ccc o ccc o ccc o ccc o ccc o wxx o xxx o xxx o - to 96
+    //          |---26 bit---|    |-----117----||-------------142-------------|
+    // b = format bit len, o = odd parity of last 3 bits
+    // f = facility code, c = card number
+    // w = wiegand parity
+    // (26 bit format shown)
+
+    //get raw ID before removing parities
+    uint32_t rawLo = bytebits_to_byte(dest + idx + 64, 32);
+    uint32_t rawHi = bytebits_to_byte(dest + idx + 32, 32);
+    uint32_t rawHi2 = bytebits_to_byte(dest + idx, 32);
+
+    size = removeParity(dest, idx + 8, 4, 1, 88);
+    if (size != 66)
+        return false;
+    // ok valid card found!
+
+    // Index map
+    // 0           10         20        30          40        50        60
+    // |           |          |         |           |         |         |
+    // 01234567 8 90123456 7890123456789012 3 456789012345678901234567890123456
+    // -----------------------------------------------------------------------------
+    // 00011010 1 01110101 0000000010001110 1 000000000000000000000000000000000
+    // bbbbbbbb w ffffffff cccccccccccccccc w xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx
+    // |26 bit|   |-117--| |-----142------|
+    // b = format bit len, o = odd parity of last 3 bits
+    // f = facility code, c = card number
+    // w = wiegand parity
+    // (26 bit format shown)
+
+    id->type = LF_WATCH_AWID;
+    id->hi2 = rawHi2;
+    id->hi = rawHi;
+    id->lo = rawLo;
+
+    uint8_t fmtLen = bytebits_to_byte(dest, 8);
+    if (fmtLen == 26) {
+        uint32_t fac = bytebits_to_byte(dest + 9, 8);
+        uint32_t cardnum = bytebits_to_byte(dest + 17, 16);
+        uint32_t code1 = bytebits_to_byte(dest + 8, fmtLen);
+        sprintf(id->desc, "AWID Found - Bit length: %u, FC: %"PRIu32", Card: %"PRIu32" - Wiegand: %"PRIx32", Raw: %08"PRIx32"%08"PRIx32"%08"PRIx32,
+                fmtLen, fac, cardnum, code1, rawHi2, rawHi, rawLo);
+    } else {
+        uint32_t cardnum = bytebits_to_byte(dest + 8 + (fmtLen - 17), 16);
+        if (fmtLen > 32) {
+            uint32_t code1 = bytebits_to_byte(dest + 8, fmtLen - 32);
+            uint32_t code2 = bytebits_to_byte(dest + 8 + (fmtLen - 32), 32);
+            sprintf(id->desc, "AWID Found - Bit length: %u -unknown bit length- (%"PRIu32") - Wiegand: %"PRIx32"%08"PRIx32", Raw: %08"PRIx32"%08"PRIx32"%08"PRIx32,
+                    fmtLen, cardnum, code1, code2, rawHi2, rawHi, rawLo);
         } else {
-            interval++;
-        }
-
-        DoAcquisition_default(-1, false);
-
-        // FSK demodulator
-        // 50 * 128 * 2 - big enough to catch 2 sequences of largest format
-        size = MIN(12800, BigBuf_max_traceLen());
-
-        int idx = HIDdemodFSK(dest, &size, &hi2, &hi, &lo, &dummyIdx);
-        if (idx < 0) continue;
-
-        if (idx > 0 && lo > 0 && (size == 96 || size == 192)) {
-            // go over previously decoded manchester data and decode into usable tag ID
-            if (hi2 != 0) { //extra large HID tags  88/192 bits
-                Dbprintf("TAG ID: " _GREEN_("%x%08x%08x") " (%d)",
-                         hi2,
-                         hi,
-                         lo,
-                         (lo >> 1) & 0xFFFF
-                        );
-            } else {  //standard HID tags 44/96 bits
-                uint8_t bitlen = 0;
-                uint32_t fac = 0;
-                uint32_t cardnum = 0;
-
-                if (((hi >> 5) & 1) == 1) { //if bit 38 is set then < 37 bit format is used
-                    uint32_t lo2 = 0;
-                    lo2 = (((hi & 31) << 12) | (lo >> 20)); //get bits 21-37 to check for format len bit
-                    uint8_t idx3 = 1;
-                    while (lo2 > 1) { //find last bit set to 1 (format len bit)
-                        lo2 >>= 1;
-                        idx3++;
-                    }
-                    bitlen = idx3 + 19;
-                    fac = 0;
-                    cardnum = 0;
-                    if (bitlen == 26) {
-                        cardnum = (lo >> 1) & 0xFFFF;
-                        fac = (lo >> 17) & 0xFF;
-                    }
-                    if (bitlen == 37) {
-                        cardnum = (lo >> 1) & 0x7FFFF;
-                        fac = ((hi & 0xF) << 12) | (lo >> 20);
-                    }
-                    if (bitlen == 34) {
-                        cardnum = (lo >> 1) & 0xFFFF;
-                        fac = ((hi & 1) << 15) | (lo >> 17);
-                    }
-                    if (bitlen == 35) {
-                        cardnum = (lo >> 1) & 0xFFFFF;
-                        fac = ((hi & 1) << 11) | (lo >> 21);
-                    }
-                } else { //if bit 38 is not set then 37 bit format is used
-                    bitlen = 37;
-                    cardnum = (lo >> 1) & 0x7FFFF;
-                    fac = ((hi & 0xF) << 12) | (lo >> 20);
-                }
-                Dbprintf("TAG ID: " _GREEN_("%x%08x (%d)") " - Format Len: " _GREEN_("%d") " bit - FC: " _GREEN_("%d") " - Card: "_GREEN_("%d"),
-                         hi,
-                         lo,
-                         (lo >> 1) & 0xFFFF,
-                         bitlen,
-                         fac,
-                         cardnum
-                        );
-            }
-            if (findone) {
-                *high = hi;
-                *low = lo;
-                break;
-            }
-            // reset
+            uint32_t code1 = bytebits_to_byte(dest + 8, fmtLen);
+            sprintf(id->desc, "AWID Found - Bit length: %u -unknown bit length- (%"PRIu32") - Wiegand: %"PRIx32", Raw: %08"PRIx32"%08"PRIx32"%08"PRIx32,
+                    fmtLen, cardnum, code1, rawHi2, rawHi, rawLo);
         }
-        hi2 = hi = lo = idx = 0;
     }
-    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
-    BigBuf_free();
-    LEDsoff();
-    return res;
+    return true;
 }
 
-// loop to get raw HID waveform then FSK demodulate the TAG ID from it
-int lf_awid_watch(int findone, uint32_t *high, uint32_t *low) {
+static bool lf_watch_io(uint8_t *dest, lf_watch_id_t *id) {
 
-    size_t size;
     int dummyIdx = 0;
+    size_t size = MIN(12000, BigBuf_max_traceLen());
+
+    //fskdemod and get start index
+    int idx = detectIOProx(dest, &size, &dummyIdx);
+    if (idx < 0)
+        return false;
+
+    //Index map
+    //0           10          20          30          40          50          60
+    //|           |           |           |           |           |           |
+    //01234567 8 90123456 7 89012345 6 78901234 5 67890123 4 56789012 3 45678901 23
+    //-----------------------------------------------------------------------------
+    //00000000 0 11110000 1 facility 1 version* 1 code*one 1 code*two 1 checksum 11
+    //
+    //Checksum:
+    //00000000 0 11110000 1 11100000 1 00000001 1 00000011 1 10110110 1 01110101 11
+    //preamble      F0         E0         01         03         B6         75
+    // How to calc checksum,
+    // http://www.proxmark.org/forum/viewtopic.php?id=364&p=6
+    //   F0 + E0 + 01 + 03 + B6 = 28A
+    //   28A & FF = 8A
+    //   FF - 8A = 75
+    // Checksum: 0x75
+    //XSF(version)facility:codeone+codetwo
+    uint32_t code = bytebits_to_byte(dest + idx, 32);
+    uint32_t code2 = bytebits_to_byte(dest + idx + 32, 32);
+    uint8_t version = bytebits_to_byte(dest + idx + 27, 8); //14,4
+    uint8_t facilitycode = bytebits_to_byte(dest + idx + 18, 8);
+    uint16_t number = (bytebits_to_byte(dest + idx + 36, 8) << 8) | (bytebits_to_byte(dest + idx + 45, 8)); //36,9
+
+    id->type = LF_WATCH_IO;
+    id->hi2 = 0;
+    id->hi = code;
+    id->lo = code2;
+    sprintf(id->desc, "IO Prox XSF(%02u)%02x:%05u (%08"PRIx32"%08"PRIx32")", version, facilitycode, number, code, code2);
+    return true;
+}
 
-    uint8_t *dest = BigBuf_get_addr();
-    BigBuf_Clear_keep_EM();
-    clear_trace();
-    set_tracing(false);
+static bool lf_watch_em410x(uint8_t *dest, lf_watch_id_t *id) {
 
-    LFSetupFPGAForADC(LF_DIVISOR_125, true);
+    size_t idx = 0;
+    int clk = 0, invert = 0, maxErr = 20;
+    uint32_t hi = 0;
+    uint64_t lo = 0;
 
-    int res = PM3_SUCCESS;
-    uint16_t interval = 0;
-    while (BUTTON_PRESS() == false) {
+    size_t size = MIN(16385, BigBuf_max_traceLen());
 
-        WDT_HIT();
+    //askdemod and manchester decode
+    int errCnt = askdemod(dest, &size, &clk, &invert, maxErr, 0, 1);
+    if (errCnt > 50)
+        return false;
 
-        // cancel w usb command.
-        if (interval == 4000) {
-            if (data_available()) {
-                res = PM3_EOPABORTED;
-                break;
-            }
-            interval = 0;
-        } else {
-            interval++;
-        }
-
-        DoAcquisition_default(-1, false);
-        // FSK demodulator
-
-        size = MIN(12800, BigBuf_max_traceLen());
-
-        //askdemod and manchester decode
-        int idx = detectAWID(dest, &size, &dummyIdx);
-
-        if (idx <= 0 || size != 96) continue;
-        // Index map
-        // 0            10            20            30              40            50              60
-        // |            |             |             |               |             |               |
-        // 01234567 890 1 234 5 678 9 012 3 456 7 890 1 234 5 678 9 012 3 456 7 890 1 234 5 678 9 012 3 - to 96
-        // -----------------------------------------------------------------------------
-        // 00000001 000 1 110 1 101 1 011 1 101 1 010 0 000 1 000 1 010 0 001 0 110 1 100 0 000 1 000 1
-        // premable bbb o bbb o bbw o fff o fff o ffc o ccc o ccc o ccc o ccc o ccc o wxx o xxx o xxx o - to 96
-        //          |---26 bit---|    |-----117----||-------------142-------------|
-        // b = format bit len, o = odd parity of last 3 bits
-        // f = facility code, c = card number
-        // w = wiegand parity
-        // (26 bit format shown)
-
-        //get raw ID before removing parities
-        uint32_t rawLo = bytebits_to_byte(dest + idx + 64, 32);
-        uint32_t rawHi = bytebits_to_byte(dest + idx + 32, 32);
-        uint32_t rawHi2 = bytebits_to_byte(dest + idx, 32);
-
-        size = removeParity(dest, idx + 8, 4, 1, 88);
-        if (size != 66) continue;
-        // ok valid card found!
-
-        // Index map
-        // 0           10         20        30          40        50        60
-        // |           |          |         |           |         |         |
-        // 01234567 8 90123456 7890123456789012 3 456789012345678901234567890123456
-        // -----------------------------------------------------------------------------
-        // 00011010 1 01110101 0000000010001110 1 000000000000000000000000000000000
-        // bbbbbbbb w ffffffff cccccccccccccccc w xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx
-        // |26 bit|   |-117--| |-----142------|
-        // b = format bit len, o = odd parity of last 3 bits
-        // f = facility code, c = card number
-        // w = wiegand parity
-        // (26 bit format shown)
-
-        uint8_t fmtLen = bytebits_to_byte(dest, 8);
-        if (fmtLen == 26) {
-            uint32_t fac = bytebits_to_byte(dest + 9, 8);
-            uint32_t cardnum = bytebits_to_byte(dest + 17, 16);
-            uint32_t code1 = bytebits_to_byte(dest + 8, fmtLen);
-            Dbprintf("AWID Found - Bit length: " _GREEN_("%d") ", FC: " _GREEN_("%d") ", Card: " _GREEN_("%d") " - Wiegand: %x, Raw: %08x%08x%08x", fmtLen, fac, cardnum, code1, rawHi2, rawHi, rawLo);
-        } else {
-            uint32_t cardnum = bytebits_to_byte(dest + 8 + (fmtLen - 17), 16);
-            if (fmtLen > 32) {
-                uint32_t code1 = bytebits_to_byte(dest + 8, fmtLen - 32);
-                uint32_t code2 = bytebits_to_byte(dest + 8 + (fmtLen - 32), 32);
-                Dbprintf("AWID Found - Bit length: " _GREEN_("%d") " -unknown bit length- (%d) - Wiegand: %x%08x, Raw: %08x%08x%08x", fmtLen, cardnum, code1, code2, rawHi2, rawHi, rawLo);
-            } else {
-                uint32_t code1 = bytebits_to_byte(dest + 8, fmtLen);
-                Dbprintf("AWID Found - Bit length: " _GREEN_("%d") " -unknown bit length- (%d) - Wiegand: %x, Raw: %08x%08x%08x", fmtLen, cardnum, code1, rawHi2, rawHi, rawLo);
-            }
-        }
-        if (findone) {
-            *high = rawHi;
-            *low = rawLo;
-            break;
-        }
-    }
+    WDT_HIT();
 
-    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
-    BigBuf_free();
-    LEDsoff();
-    return res;
+    errCnt = Em410xDecode(dest, &size, &idx, &hi, &lo);
+    if (errCnt != 1)
+        return false;
+
+    id->type = LF_WATCH_EM410X;
+    id->hi2 = 0;
+    id->hi = hi;
+    id->lo = lo;
+
+    if (size == 128) {
+        sprintf(id->desc, "EM XL TAG ID: %06"PRIx32"%08"PRIx32"%08"PRIx32" - ( %05"PRIu32"_%03"PRIu32"_%08"PRIu32" )",
+                hi,
+                (uint32_t)(lo >> 32),
+                (uint32_t)lo,
+                (uint32_t)(lo & 0xFFFF),
+                (uint32_t)((lo >> 16LL) & 0xFF),
+                (uint32_t)(lo & 0xFFFFFF));
+    } else {
+        sprintf(id->desc, "EM TAG ID: %02"PRIx32"%08"PRIx32" - ( %05"PRIu32"_%03"PRIu32"_%08"PRIu32" )",
+                (uint32_t)(lo >> 32),
+                (uint32_t)lo,
+                (uint32_t)(lo & 0xFFFF),
+                (uint32_t)((lo >> 16LL) & 0xFF),
+                (uint32_t)(lo & 0xFFFFFF));
+    }
+    return true;
 }
 
-int lf_em410x_watch(int findone, uint32_t *high, uint64_t *low) {
+static const struct {
+    uint8_t type;
+    bool (*demod)(uint8_t *dest, lf_watch_id_t *id);
+} lf_watch_demods[] = {
+    { LF_WATCH_HID,    lf_watch_hid },
+    { LF_WATCH_AWID,   lf_watch_awid },
+    { LF_WATCH_IO,     lf_watch_io },
+    { LF_WATCH_EM410X, lf_watch_em410x },
+};
 
-    size_t size, idx = 0;
-    int clk = 0, invert = 0, maxErr = 20;
-    uint32_t hi = 0;
-    uint64_t lo = 0;
+// Captures once per round and runs every demodulator of types against the same samples.
+// The demodulators work in place, with more than one type each gets a copy of the capture.
+// New IDs are printed, with findone the first one is returned in found. cache keeps the
+// IDs seen over several calls, NULL for a cache of this call only
+int lf_watch(uint8_t types, int findone, lf_watch_cache_t *cache, lf_watch_id_t *found) {
 
-    uint8_t *dest = BigBuf_get_addr();
+    if (types == 0)
+        return PM3_EINVARG;
+
+    lf_watch_cache_t local;
+    if (cache == NULL) {
+        memset(&local, 0, sizeof(local));
+        cache = &local;
+    }
+
+    // Configure to go in 125kHz listen mode
+    LFSetupFPGAForADC(LF_DIVISOR_125, true);
+
+    uint8_t *capture = BigBuf_get_addr();
+    BigBuf_Clear_keep_EM();
     clear_trace();
     set_tracing(false);
-    BigBuf_Clear_keep_EM();
 
-    LFSetupFPGAForADC(LF_DIVISOR_125, true);
+    uint8_t *dest = capture;
+    bool single = ((types & (types - 1)) == 0);
+    if (single == false) {
+        dest = BigBuf_malloc_arena(LF_WATCH_SAMPLES, BIGBUF_ARENA_SCRATCH);
+        if (dest == NULL)
+            return PM3_EMALLOC;
+    }
 
     int res = PM3_SUCCESS;
-    uint16_t interval = 0;
     while (BUTTON_PRESS() == false) {
+
         WDT_HIT();
 
         // cancel w usb command.
-        if (interval == 4000) {
-            if (data_available()) {
-                res = PM3_EOPABORTED;
-                break;
-            }
-            interval = 0;
-        } else {
-            interval++;
+        if (data_available()) {
+            res = PM3_EOPABORTED;
+            break;
         }
 
-        DoAcquisition_default(-1, false);
+        uint32_t samples = DoAcquisition_default(-1, false);
+        samples = MIN(samples, LF_WATCH_SAMPLES);
 
-        size = MIN(16385, BigBuf_max_traceLen());
+        bool done = false;
+        for (uint8_t i = 0; i < ARRAYLEN(lf_watch_demods) && done == false; i++) {
 
-        //askdemod and manchester decode
-        int errCnt = askdemod(dest, &size, &clk, &invert, maxErr, 0, 1);
-        if (errCnt > 50) continue;
+            if ((types & lf_watch_demods[i].type) == 0)
+                continue;
 
-        WDT_HIT();
+            if (single == false)
+                memcpy(dest, capture, samples);
 
-        errCnt = Em410xDecode(dest, &size, &idx, &hi, &lo);
-        if (errCnt == 1) {
-            if (size == 128) {
-                Dbprintf("EM XL TAG ID: " _GREEN_("%06x%08x%08x") " - ( %05d_%03d_%08d )",
-                         hi,
-                         (uint32_t)(lo >> 32),
-                         (uint32_t)lo,
-                         (uint32_t)(lo & 0xFFFF),
-                         (uint32_t)((lo >> 16LL) & 0xFF),
-                         (uint32_t)(lo & 0xFFFFFF));
-            } else {
-                Dbprintf("EM TAG ID: " _GREEN_("%02x%08x") " - ( %05d_%03d_%08d )",
-                         (uint32_t)(lo >> 32),
-                         (uint32_t)lo,
-                         (uint32_t)(lo & 0xFFFF),
-                         (uint32_t)((lo >> 16LL) & 0xFF),
-                         (uint32_t)(lo & 0xFFFFFF));
-            }
+            lf_watch_id_t id = {0};
+            if (lf_watch_demods[i].demod(dest, &id) == false)
+                continue;
+
+            if (lf_watch_seen(cache, &id))
+                continue;
+
+            Dbprintf("%s", id.desc);
 
             if (findone) {
-                *high = hi;
-                *low = lo;
-                break;
+                if (found)
+                    *found = id;
+                done = true;
             }
         }
-        hi = lo = size = idx = 0;
-        clk = invert = 0;
+        if (done)
+            break;
     }
 
     FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
@@ -1525,94 +1798,44 @@ int lf_em410x_watch(int findone, uint32_t *high, uint64_t *low) {
     return res;
 }
 
-int lf_io_watch(int findone, uint32_t *high, uint32_t *low) {
-
-    int dummyIdx = 0;
-    uint32_t code = 0, code2 = 0;
-    uint8_t version = 0, facilitycode = 0;
-    uint16_t number = 0;
-
-    uint8_t *dest = BigBuf_get_addr();
-    BigBuf_Clear_keep_EM();
-    clear_trace();
-    set_tracing(false);
-
-    // Configure to go in 125kHz listen mode
-    LFSetupFPGAForADC(LF_DIVISOR_125, true);
+// loop to get raw HID waveform then FSK demodulate the TAG ID from it
+int lf_hid_watch(int findone, uint32_t *high, uint32_t *low) {
+    lf_watch_id_t id;
+    int res = lf_watch(LF_WATCH_HID, findone, NULL, &id);
+    if (res == PM3_SUCCESS && findone) {
+        *high = id.hi;
+        *low = id.lo;
+    }
+    return res;
+}
 
-    int res = PM3_SUCCESS;
-    uint16_t interval = 0;
-    while (BUTTON_PRESS() == false) {
+int lf_awid_watch(int findone, uint32_t *high, uint32_t *low) {
+    lf_watch_id_t id;
+    int res = lf_watch(LF_WATCH_AWID, findone, NULL, &id);
+    if (res == PM3_SUCCESS && findone) {
+        *high = id.hi;
+        *low = id.lo;
+    }
+    return res;
+}
 
-        WDT_HIT();
+int lf_em410x_watch(int findone, uint32_t *high, uint64_t *low) {
+    lf_watch_id_t id;
+    int res = lf_watch(LF_WATCH_EM410X, findone, NULL, &id);
+    if (res == PM3_SUCCESS && findone) {
+        *high = id.hi;
+        *low = id.lo;
+    }
+    return res;
+}
 
-        // cancel w usb command.
-        if (interval == 4000) {
-            if (data_available()) {
-                res = PM3_EOPABORTED;
-                break;
-            }
-            interval = 0;
-        } else {
-            interval++;
-        }
-
-        DoAcquisition_default(-1, false);
-
-        size_t size = MIN(12000, BigBuf_max_traceLen());
-
-        //fskdemod and get start index
-        int idx = detectIOProx(dest, &size, &dummyIdx);
-        if (idx < 0) continue;
-        //valid tag found
-
-        //Index map
-        //0           10          20          30          40          50          60
-        //|           |           |           |           |           |           |
-        //01234567 8 90123456 7 89012345 6 78901234 5 67890123 4 56789012 3 45678901 23
-        //-----------------------------------------------------------------------------
-        //00000000 0 11110000 1 facility 1 version* 1 code*one 1 code*two 1 checksum 11
-        //
-        //Checksum:
-        //00000000 0 11110000 1 11100000 1 00000001 1 00000011 1 10110110 1 01110101 11
-        //preamble      F0         E0         01         03         B6         75
-        // How to calc checksum,
-        // http://www.proxmark.org/forum/viewtopic.php?id=364&p=6
-        //   F0 + E0 + 01 + 03 + B6 = 28A
-        //   28A & FF = 8A
-        //   FF - 8A = 75
-        // Checksum: 0x75
-        //XSF(version)facility:codeone+codetwo
-        //Handle the data
-        // if(findone){ //only print binary if we are doing one
-        // Dbprintf("%d%d%d%d%d%d%d%d %d",dest[idx],   dest[idx+1],   dest[idx+2],dest[idx+3],dest[idx+4],dest[idx+5],dest[idx+6],dest[idx+7],dest[idx+8]);
-        // Dbprintf("%d%d%d%d%d%d%d%d %d",dest[idx+9], dest[idx+10],dest[idx+11],dest[idx+12],dest[idx+13],dest[idx+14],dest[idx+15],dest[idx+16],dest[idx+17]);
-        // Dbprintf("%d%d%d%d%d%d%d%d %d",dest[idx+18],dest[idx+19],dest[idx+20],dest[idx+21],dest[idx+22],dest[idx+23],dest[idx+24],dest[idx+25],dest[idx+26]);
-        // Dbprintf("%d%d%d%d%d%d%d%d %d",dest[idx+27],dest[idx+28],dest[idx+29],dest[idx+30],dest[idx+31],dest[idx+32],dest[idx+33],dest[idx+34],dest[idx+35]);
-        // Dbprintf("%d%d%d%d%d%d%d%d %d",dest[idx+36],dest[idx+37],dest[idx+38],dest[idx+39],dest[idx+40],dest[idx+41],dest[idx+42],dest[idx+43],dest[idx+44]);
-        // Dbprintf("%d%d%d%d%d%d%d%d %d",dest[idx+45],dest[idx+46],dest[idx+47],dest[idx+48],dest[idx+49],dest[idx+50],dest[idx+51],dest[idx+52],dest[idx+53]);
-        // Dbprintf("%d%d%d%d%d%d%d%d %d%d",dest[idx+54],dest[idx+55],dest[idx+56],dest[idx+57],dest[idx+58],dest[idx+59],dest[idx+60],dest[idx+61],dest[idx+62],dest[idx+63]);
-        // }
-        code = bytebits_to_byte(dest + idx, 32);
-        code2 = bytebits_to_byte(dest + idx + 32, 32);
-        version = bytebits_to_byte(dest + idx + 27, 8); //14,4
-        facilitycode = bytebits_to_byte(dest + idx + 18, 8);
-        number = (bytebits_to_byte(dest + idx + 36, 8) << 8) | (bytebits_to_byte(dest + idx + 45, 8)); //36,9
-
-        Dbprintf("IO Prox " _GREEN_("XSF(%02d)%02x:%05d") " (%08x%08x) (%s)", version, facilitycode, number, code, code2);
-
-        if (findone) {
-            *high = code;
-            *low = code2;
-            break;
-        }
-        code = code2 = 0;
-        version = facilitycode = 0;
-        number = 0;
+int lf_io_watch(int findone, uint32_t *high, uint32_t *low) {
+    lf_watch_id_t id;
+    int res = lf_watch(LF_WATCH_IO, findone, NULL, &id);
+    if (res == PM3_SUCCESS && findone) {
+        *high = id.hi;
+        *low = id.lo;
     }
-    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
-    BigBuf_free();
-    LEDsoff();
     return res;
 }
 
@@ -1882,7 +2105,8 @@ void T55xxDangerousRawTest(uint8_t *data) {
 
 // Write one card block in page 0, no lock
 //void T55xxWriteBlockExt(uint32_t data, uint8_t blockno, uint32_t pwd, uint8_t flags) {
-void T55xxWriteBlock(uint8_t *data) {
+// prog_wait is the time the field stays on for the tag to program the block
+static void T55xx_WriteBlockWait(t55xx_write_block_t *c, uint32_t prog_wait) {
 
     /*
     flag bits
@@ -1895,7 +2119,6 @@ void T55xxWriteBlock(uint8_t *data) {
     1xxxxxxx 0x80 reset
     */
 
-    t55xx_write_block_t *c = (t55xx_write_block_t *)data;
     // c->data, c->blockno, c->pwd, c->flags
 
     bool testMode = ((c->flags & 0x04) == 0x04);
@@ -1921,7 +2144,7 @@ void T55xxWriteBlock(uint8_t *data) {
         TurnReadLFOn(5184);
 
     } else {
-        TurnReadLFOn(20 * 1000);
+        TurnReadLFOn(prog_wait);
         //could attempt to do a read to confirm write took
         // as the tag should repeat back the new block
         // until it is reset, but to confirm it we would
@@ -1935,10 +2158,14 @@ void T55xxWriteBlock(uint8_t *data) {
     // turn field off
     FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
 
-    reply_ng(CMD_LF_T55XX_WRITEBL, PM3_SUCCESS, NULL, 0);
     LED_A_OFF();
 }
 
+void T55xxWriteBlock(uint8_t *data) {
+    T55xx_WriteBlockWait((t55xx_write_block_t *)data, T55XX_PROG_WAIT);
+    reply_ng(CMD_LF_T55XX_WRITEBL, PM3_SUCCESS, NULL, 0);
+}
+
 /*
 // uses NG format
 void T55xxWriteBlock(uint8_t *data) {
@@ -2003,6 +2230,10 @@ bool brute_mem = (flags & 0x0100) >> 8;
 */
 // Read one card block in page [page]
 void T55xxReadBlock(uint8_t page, bool pwd_mode, bool brute_mem, uint8_t block, uint32_t pwd, uint8_t downlink_mode) {
+    T55xxReadBlockSamples(page, pwd_mode, brute_mem, block, pwd, downlink_mode, (brute_mem) ? 2048 : 12000);
+}
+
+void T55xxReadBlockSamples(uint8_t page, bool pwd_mode, bool brute_mem, uint8_t block, uint32_t pwd, uint8_t downlink_mode, size_t samples) {
     /*
     flag bits
     xxxx xxxxxxx1 0x0001 PwdMode
@@ -2021,12 +2252,8 @@ void T55xxReadBlock(uint8_t page, bool pwd_mode, bool brute_mem, uint8_t block,
     if (brute_mem) flags |= 0x0100;
 
 
-    size_t samples = 12000;
-
     LED_A_ON();
 
-    if (brute_mem) samples = 2048;
-
     //-- Set Read Flag to ensure SendCMD does not add "data" to the packet
     //-- flags |= 0x40;
 
@@ -2178,6 +2405,405 @@ OUT:
     BigBuf_free();
 }
 
+// T55xx config block modulation field values
+#define T55XX_BRUTE_MOD_NRZ     0x00
+#define T55XX_BRUTE_MOD_PSK1    0x01
+#define T55XX_BRUTE_MOD_PSK2    0x02
+#define T55XX_BRUTE_MOD_FSK1    0x04
+#define T55XX_BRUTE_MOD_FSK2a   0x07
+#define T55XX_BRUTE_MOD_ASK     0x08
+#define T55XX_BRUTE_MOD_BI      0x10
+#define T55XX_BRUTE_MOD_BIa     0x18
+#define T55XX_BRUTE_MOD_ALL     0xFF
+
+static uint32_t T55xx_PackBits(const uint8_t *bits, uint8_t len) {
+    uint32_t v = 0;
+    for (uint8_t i = 0; i < len; i++)
+        v = (v << 1) | (bits[i] & 1);
+    return v;
+}
+
+// Same checks as the client's config block test (T55x7 only). A wrong password leaves the tag in
+// regular read mode, it never sends block 0, so a plausible config block sent twice in a row is a hit
+static bool T55xx_FindConfigBlock(const uint8_t *bits, size_t size, uint8_t modulation, int clk, uint32_t *block0) {
+
+    const uint8_t rates[] = {8, 16, 32, 40, 50, 64, 100, 128};
+
+    if (size < 64) return false;
+
+    for (size_t idx = 0; idx <= size - 64; idx++) {
+        const uint8_t *b = bits + idx;
+
+        uint32_t conf = T55xx_PackBits(b, 32);
+        if ((conf >> 4) == 0) continue;
+
+        // reserved nibble must be zero
+        if ((conf >> 24) & 0xF) continue;
+
+        uint8_t safer = conf >> 28;
+        uint8_t rate = (conf >> 18) & 0x3F;
+        bool extended = (conf >> 17) & 1;
+        uint8_t modread = (conf >> 12) & 0x1F;
+
+        if ((safer == 0x6 || safer == 0x9) && extended) {
+            if ((rate * 2) + 2 != clk) continue;
+        } else {
+            if (rate > 7 || rates[rate] != clk) continue;
+        }
+
+        if (modulation == T55XX_BRUTE_MOD_FSK1) {
+            if (modread < T55XX_BRUTE_MOD_FSK1 || modread > T55XX_BRUTE_MOD_FSK2a) continue;
+        } else if (modread != modulation) {
+            continue;
+        }
+
+        if (T55xx_PackBits(b + 32, 32) != conf) continue;
+
+        *block0 = conf;
+        return true;
+    }
+    return false;
+}
+
+// Demodulates the samples of one read attempt as one modulation.
+// raw is left untouched, work gets the demodulated bits
+static bool T55xx_DemodSamples(const uint8_t *raw, uint8_t *work, size_t samples, uint8_t modulation, uint8_t invert, size_t *bits, int *clock) {
+
+    size_t size = samples;
+    int clk = 0, inv = invert, start = 0;
+    memcpy(work, raw, samples);
+
+    switch (modulation) {
+        case T55XX_BRUTE_MOD_ASK:
+            if (askdemod_ext(work, &size, &clk, &inv, 1, 0, 1, &start) < 0) return false;
+            break;
+        case T55XX_BRUTE_MOD_BI:
+        case T55XX_BRUTE_MOD_BIa: {
+            inv = 0;
+            if (askdemod_ext(work, &size, &clk, &inv, 1, 0, 0, &start) < 0) return false;
+            int offset = 0;
+            if (BiphaseRawDecode(work, &size, &offset, (modulation == T55XX_BRUTE_MOD_BIa)) < 0) return false;
+            break;
+        }
+        case T55XX_BRUTE_MOD_NRZ:
+            if (nrzRawDemod(work, &size, &clk, &inv, &start) < 0) return false;
+            break;
+        case T55XX_BRUTE_MOD_FSK1: {
+            uint16_t fc = countFC(work, size, true);
+            uint8_t fchigh = fc >> 8, fclow = fc & 0xFF;
+            if (fchigh == 0 || fclow == 0 || fchigh <= fclow) return false;
+            int first = 0;
+            clk = detectFSKClk(work, size, fchigh, fclow, &first);
+            if (clk == 0) return false;
+            size = fskdemod(work, size, clk, invert, fchigh, fclow, &start);
+            break;
+        }
+        case T55XX_BRUTE_MOD_PSK1:
+        case T55XX_BRUTE_MOD_PSK2:
+            if (pskRawDemod_ext(work, &size, &clk, &inv, &start) < 0) return false;
+            if (modulation == T55XX_BRUTE_MOD_PSK2)
+                psk1TOpsk2(work, size);
+            break;
+        default:
+            return false;
+    }
+
+    *bits = size;
+    *clock = clk;
+    return true;
+}
+
+// Demodulates one read attempt and looks for block 0
+static bool T55xx_CheckSamples(const uint8_t *raw, uint8_t *work, size_t samples, uint8_t modulation, uint8_t invert, uint32_t *block0) {
+    size_t size = 0;
+    int clk = 0;
+    if (T55xx_DemodSamples(raw, work, samples, modulation, invert, &size, &clk) == false)
+        return false;
+    return T55xx_FindConfigBlock(work, size, modulation, clk, block0);
+}
+
+/*
+ * lf read with the demodulation done here, CMD_LF_READ_DEMOD. Only the bits, or with
+ * LF_DEMOD_AUTO the first tag the 'lf watch' demodulators find, go back to the client.
+ */
+void ReadLFDemod(const lf_demod_req_t *req) {
+
+    lf_demod_resp_t *resp = (lf_demod_resp_t *)BigBuf_malloc(sizeof(lf_demod_resp_t));
+    if (resp == NULL) {
+        reply_ng(CMD_LF_READ_DEMOD, PM3_EMALLOC, NULL, 0);
+        return;
+    }
+
+    // the demodulators need whole samples
+    if (getSamplingConfig()->bits_per_sample != 8) {
+        BigBuf_free();
+        reply_ng(CMD_LF_READ_DEMOD, PM3_EINVARG, NULL, 0);
+        return;
+    }
+
+    uint32_t samples = (req->samples) ? MIN(req->samples, LF_DEMOD_SAMPLES) : LF_DEMOD_SAMPLES;
+    uint8_t *work = BigBuf_malloc(samples);
+    if (work == NULL) {
+        BigBuf_free();
+        reply_ng(CMD_LF_READ_DEMOD, PM3_EMALLOC, NULL, 0);
+        return;
+    }
+
+    LED_A_ON();
+    uint8_t *raw = BigBuf_get_addr();
+    samples = MIN(SampleLF(false, samples) / 8, samples);
+    WDT_HIT();
+
+    // SampleLF clears all of BigBuf, the chunks too
+    memset(resp, 0, sizeof(lf_demod_resp_t));
+    lf_demod_info_t *info = &resp->info;
+    info->samples = samples;
+    info->modulation = req->modulation;
+    info->invert = req->invert;
+
+    int res = PM3_ESOFT;
+    if (req->modulation == LF_DEMOD_AUTO) {
+        for (uint8_t i = 0; i < ARRAYLEN(lf_watch_demods); i++) {
+            memcpy(work, raw, samples);
+            lf_watch_id_t id = {0};
+            if (lf_watch_demods[i].demod(work, &id) == false)
+                continue;
+
+            info->tag_type = id.type;
+            info->hi2 = id.hi2;
+            info->hi = id.hi;
+            info->lo = id.lo;
+            memcpy(info->desc, id.desc, sizeof(info->desc));
+            res = PM3_SUCCESS;
+            break;
+        }
+    } else {
+        size_t size = 0;
+        int clk = 0;
+        if (T55xx_DemodSamples(raw, work, samples, req->modulation, req->invert, &size, &clk)) {
+            size = MIN(size, sizeof(resp->bits) * 8);
+            for (size_t i = 0; i < size; i++)
+                resp->bits[i / 8] |= (work[i] & 1) << (7 - (i % 8));
+            info->clock = clk;
+            info->len = size;
+            res = PM3_SUCCESS;
+        }
+    }
+
+    reply_ng(CMD_LF_READ_DEMOD, res, (uint8_t *)resp, sizeof(lf_demod_info_t) + ((info->len + 7) / 8));
+    BigBuf_free();
+    LED_A_OFF();
+}
+
+/*
+ * Password range or dictionary search, validated on the device. Every candidate is read as block 0
+ * in password mode and demodulated with lfdemod, only hits and progress go back to the client.
+ * The loop stops at the first hit, on button press or when the client asks to.
+ */
+void T55xx_BruteForce(const t55xx_brute_req_t *req) {
+
+// enough for two config blocks at RF/128
+#define BRUTE_SAMPLES_SIGNAL 8192
+
+    // modulation / inverted pairs tried when the client doesn't know the config
+    const uint8_t auto_mods[][2] = {
+        {T55XX_BRUTE_MOD_ASK, 0}, {T55XX_BRUTE_MOD_ASK, 1},
+        {T55XX_BRUTE_MOD_BI, 0}, {T55XX_BRUTE_MOD_BIa, 0},
+        {T55XX_BRUTE_MOD_FSK1, 0}, {T55XX_BRUTE_MOD_FSK1, 1},
+        {T55XX_BRUTE_MOD_PSK1, 0}, {T55XX_BRUTE_MOD_PSK2, 0},
+        {T55XX_BRUTE_MOD_NRZ, 0}, {T55XX_BRUTE_MOD_NRZ, 1},
+    };
+
+    uint8_t one_mod[1][2] = {{req->modulation, req->inverted}};
+    const uint8_t (*mods)[2] = auto_mods;
+    uint8_t mod_count = ARRAYLEN(auto_mods);
+    if (req->modulation != T55XX_BRUTE_MOD_ALL) {
+        mods = (const uint8_t (*)[2])one_mod;
+        mod_count = 1;
+    }
+
+    bool dict = (req->flags & T55XX_BRUTE_DICT);
+    // a range stops at its end password, it may be 0xFFFFFFFF
+    uint32_t count = (dict) ? MIN(req->pwdcount, T55XX_BRUTE_DICT_MAX) : UINT32_MAX;
+    uint8_t dl_first = req->downlink_mode & 3;
+    uint8_t dl_last = (req->flags & T55XX_BRUTE_ALL_DL) ? 3 : dl_first;
+
+    uint8_t *pwds = BigBuf_get_EM_addr();
+    uint8_t *raw = BigBuf_get_addr();
+    uint8_t *work = BigBuf_malloc(BRUTE_SAMPLES_SIGNAL);
+
+    t55xx_brute_resp_t resp;
+    memset(&resp, 0, sizeof(resp));
+
+    LED_D_ON();
+
+    for (uint32_t i = 0; i < count && resp.found == false; i++) {
+
+        if (BUTTON_PRESS() || data_available())
+            break;
+
+        WDT_HIT();
+
+        uint32_t pwd = (dict) ? bytes_to_num(pwds + (i * 4), 4) : req->start + i;
+
+        for (uint8_t dl = dl_first; dl <= dl_last && resp.found == false; dl++) {
+
+            T55xxReadBlockSamples(0, true, true, 0, pwd, dl, BRUTE_SAMPLES_SIGNAL);
+
+            // nothing but noise, no tag or it didn't answer at all
+            if (getSignalProperties()->isnoise)
+                continue;
+
+            for (uint8_t m = 0; m < mod_count; m++) {
+                uint32_t block0 = 0;
+                if (T55xx_CheckSamples(raw, work, BRUTE_SAMPLES_SIGNAL, mods[m][0], mods[m][1], &block0)) {
+                    resp.found = true;
+                    resp.block0 = block0;
+                    resp.password = pwd;
+                    resp.downlink_mode = dl;
+                    resp.modulation = mods[m][0];
+                    break;
+                }
+            }
+        }
+
+        resp.tried = i + 1;
+
+        if (resp.found == false && (resp.tried % T55XX_BRUTE_REPORT) == 0) {
+            resp.password = pwd;
+            reply_ng(CMD_LF_T55XX_BRUTE, PM3_SUCCESS, (uint8_t *)&resp, sizeof(resp));
+        }
+
+        if (dict == false && pwd == req->end)
+            break;
+    }
+
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    LEDsoff();
+
+    resp.final = true;
+    reply_ng(CMD_LF_T55XX_BRUTE, PM3_SUCCESS, (uint8_t *)&resp, sizeof(resp));
+    BigBuf_free_keep_EM();
+}
+
+// modulation to demodulate a read back with, from the modulation field of a T55x7 config block
+static uint8_t T55xx_ModulationFromBlock0(uint32_t block0) {
+    uint8_t modread = (block0 >> 12) & 0x1F;
+    switch (modread) {
+        case T55XX_BRUTE_MOD_NRZ:
+        case T55XX_BRUTE_MOD_PSK1:
+        case T55XX_BRUTE_MOD_PSK2:
+        case T55XX_BRUTE_MOD_ASK:
+        case T55XX_BRUTE_MOD_BI:
+        case T55XX_BRUTE_MOD_BIa:
+            return modread;
+        case 0x04:
+        case 0x05:
+        case 0x06:
+        case 0x07:
+            return T55XX_BRUTE_MOD_FSK1;
+        default:
+            return T55XX_BRUTE_MOD_ALL;
+    }
+}
+
+// A direct access read repeats the block, so the data twice in a row is a good read back
+static bool T55xx_VerifyBlock(const t55xx_write_block_t *c, uint8_t modulation, bool pwd_mode, uint32_t pwd, uint8_t downlink_mode, uint8_t *work) {
+
+#define VERIFY_SAMPLES_SIGNAL 8192
+
+    T55xxReadBlockSamples((c->flags & 0x02) ? 1 : 0, pwd_mode, true, c->blockno, pwd, downlink_mode, VERIFY_SAMPLES_SIGNAL);
+
+    if (getSignalProperties()->isnoise)
+        return false;
+
+    uint8_t *raw = BigBuf_get_addr();
+    for (uint8_t invert = 0; invert < 2; invert++) {
+        size_t size = 0;
+        int clk = 0;
+        if (T55xx_DemodSamples(raw, work, VERIFY_SAMPLES_SIGNAL, modulation, invert, &size, &clk) == false)
+            continue;
+
+        if (size < 64)
+            continue;
+
+        for (size_t idx = 0; idx <= size - 64; idx++) {
+            if (T55xx_PackBits(work + idx, 32) == c->data && T55xx_PackBits(work + idx + 32, 32) == c->data)
+                return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Writes a list of blocks in one go and optionally reads them back. The read back decodes with the
+ * config block in the list, or the one the client passes. With read back on, blocks are first written
+ * with the short programming wait and only the ones that don't verify are written again with the full one.
+ */
+void T55xxWriteBlocks(t55xx_write_blocks_t *req) {
+
+    t55xx_write_blocks_resp_t resp;
+    memset(&resp, 0, sizeof(resp));
+    resp.count = MIN(req->count, T55XX_WRITE_BLOCKS_MAX);
+
+    // what the tag looks like once everything is written
+    uint32_t block0 = req->block0;
+    uint32_t pwd = req->blocks[0].pwd;
+    uint8_t downlink_mode = (req->blocks[0].flags >> 3) & 0x03;
+    for (uint8_t i = 0; i < resp.count; i++) {
+        t55xx_write_block_t *c = &req->blocks[i];
+        if (c->flags & 0x02)
+            continue;
+        if (c->blockno == 0) {
+            block0 = c->data;
+            downlink_mode = (c->flags >> 3) & 0x03;
+        } else if (c->blockno == 7) {
+            pwd = c->data;
+        }
+    }
+
+    uint8_t modulation = T55xx_ModulationFromBlock0(block0);
+    resp.verify = (req->flags & T55XX_WRITE_BLOCKS_VERIFY) && block0 != 0 && modulation != T55XX_BRUTE_MOD_ALL;
+    bool pwd_mode = (block0 >> 4) & 1;
+
+    uint8_t *work = (resp.verify) ? BigBuf_malloc(VERIFY_SAMPLES_SIGNAL) : NULL;
+    if (resp.verify && work == NULL)
+        resp.verify = false;
+
+    LED_D_ON();
+
+    for (uint8_t i = 0; i < resp.count; i++) {
+        WDT_HIT();
+        T55xx_WriteBlockWait(&req->blocks[i], (resp.verify) ? T55XX_PROG_WAIT_FAST : T55XX_PROG_WAIT);
+    }
+
+    if (resp.verify) {
+        for (uint8_t pass = 0; pass < 2; pass++) {
+            for (uint8_t i = 0; i < resp.count; i++) {
+                if (resp.verified & (1 << i))
+                    continue;
+
+                WDT_HIT();
+
+                // second pass writes the blocks that failed again, the slow way
+                if (pass)
+                    T55xx_WriteBlockWait(&req->blocks[i], T55XX_PROG_WAIT);
+
+                if (T55xx_VerifyBlock(&req->blocks[i], modulation, pwd_mode, pwd, downlink_mode, work))
+                    resp.verified |= (1 << i);
+            }
+
+            if (resp.verified == (1 << resp.count) - 1)
+                break;
+        }
+        FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    }
+
+    LEDsoff();
+    reply_ng(CMD_LF_T55XX_WRITE_BLOCKS, PM3_SUCCESS, (uint8_t *)&resp, sizeof(resp));
+    BigBuf_free_keep_EM();
+}
+
 void T55xxWakeUp(uint32_t pwd, uint8_t flags) {
 
     flags |= 0x01 | 0x40 | 0x20; //Password | Read Call (no data) | reg_read no block
@@ -2546,6 +3172,199 @@ void EM4xReadWord(uint8_t addr, uint32_t pwd, uint8_t usepwd) {
     LEDsoff();
 }
 
+// 8 bit preamble + 32 bit word response (max clock (128) * 40bits = 5120 samples), like the client reads
+#define EM4X05_SAMPLES  6000
+
+// modulation / inverted pairs in the order the client tries them
+static const uint8_t em4x05_mods[][2] = {
+    {T55XX_BRUTE_MOD_ASK, 0},
+    {T55XX_BRUTE_MOD_BI, 0}, {T55XX_BRUTE_MOD_BIa, 0},
+    {T55XX_BRUTE_MOD_NRZ, 0}, {T55XX_BRUTE_MOD_NRZ, 1},
+    {T55XX_BRUTE_MOD_FSK1, 0},
+    {T55XX_BRUTE_MOD_PSK1, 0}, {T55XX_BRUTE_MOD_PSK1, 1}, {T55XX_BRUTE_MOD_PSK2, 0},
+};
+
+// The answer starts with the preamble 001010 in the first bits. A read answer has 45 bits after it,
+// 4 rows of 8 bits with even parity and a row of column parity, word gets the data like the client's
+static bool EM4x05_FindAnswer(uint8_t *bits, size_t size, uint32_t *word) {
+    uint8_t preamble[] = {0, 0, 1, 0, 1, 0};
+    size_t len = MIN(size, 20);
+    size_t idx = 0;
+    if (preambleSearchEx(bits, preamble, sizeof(preamble), &len, &idx, true) == false)
+        return false;
+
+    if (word == NULL)
+        return true;
+
+    idx += sizeof(preamble);
+    if (idx + 45 > size)
+        return false;
+
+    for (uint8_t c = 0; c < 8; c++) {
+        uint8_t colp = 0;
+        for (uint8_t r = 0; r < 5; r++)
+            colp ^= bits[idx + r * 9 + c];
+        if (colp)
+            return false;
+    }
+
+    if (removeParity(bits, idx, 9, 0, 36) == 0)
+        return false;
+
+    *word = bytebits_to_byteLSBF(bits, 32);
+    return true;
+}
+
+// Demodulates the answer in BigBuf, the modulation that worked before first. word NULL looks for the preamble only
+static bool EM4x05_DemodAnswer(uint8_t *work, size_t samples, uint8_t *mod, uint32_t *word) {
+
+    if (getSignalProperties()->isnoise)
+        return false;
+
+    uint8_t *raw = BigBuf_get_addr();
+    for (uint8_t i = 0; i < ARRAYLEN(em4x05_mods); i++) {
+        uint8_t m = (*mod + i) % ARRAYLEN(em4x05_mods);
+        size_t size = 0;
+        int clk = 0;
+        if (T55xx_DemodSamples(raw, work, samples, em4x05_mods[m][0], em4x05_mods[m][1], &size, &clk) == false)
+            continue;
+
+        if (EM4x05_FindAnswer(work, size, word)) {
+            *mod = m;
+            return true;
+        }
+    }
+    return false;
+}
+
+// samples of the answer, DC offset removed and signal properties set
+static size_t EM4x05_AcquireAnswer(void) {
+    return DoAcquisition(1, 8, false, 20, false, EM4X05_SAMPLES, 1000, 0) / 8;
+}
+
+/*
+ * Reads the words of the mask one after the other in the same field and demodulates them on the device.
+ * A word that doesn't come out is read once more after a power cycle of the tag, then it is left to the client
+ */
+void EM4xReadAll(const em4x05_read_all_req_t *req) {
+
+    em4x05_read_all_resp_t resp;
+    memset(&resp, 0, sizeof(resp));
+
+    StartTicks();
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    WaitMS(20);
+
+    LED_A_ON();
+    BigBuf_free();
+    BigBuf_Clear_ext(false);
+    uint8_t *work = BigBuf_malloc(EM4X05_SAMPLES);
+
+    uint8_t mod = 0;
+    for (uint8_t addr = 0; addr < 16; addr++) {
+        if ((req->mask & (1 << addr)) == 0)
+            continue;
+
+        if (BUTTON_PRESS() || data_available())
+            break;
+
+        WDT_HIT();
+
+        for (uint8_t retry = 0; retry < 2; retry++) {
+            if (retry) {
+                FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+                WaitMS(20);
+            }
+
+            if (req->usepwd)
+                EM4xLogin(req->password);
+
+            forward_ptr = forwardLink_data;
+            uint8_t len = Prepare_Cmd(FWD_CMD_READ);
+            len += Prepare_Addr(addr);
+            SendForward(len);
+            WaitUS(400);
+
+            size_t samples = EM4x05_AcquireAnswer();
+            uint32_t word = 0;
+            if (EM4x05_DemodAnswer(work, samples, &mod, &word)) {
+                resp.words[addr] = word;
+                resp.ok |= 1 << addr;
+                break;
+            }
+        }
+    }
+
+    StopTicks();
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    BigBuf_free();
+    reply_ng(CMD_LF_EM4X_READ_ALL, PM3_SUCCESS, (uint8_t *)&resp, sizeof(resp));
+    LEDsoff();
+}
+
+/*
+ * Password range or dictionary search on the login answer. The tag stays in the field, a wrong password
+ * is answered with an error pattern without the preamble. The loop stops at the first hit, on button
+ * press or when the client asks to
+ */
+void EM4xBruteForce(const em4x05_brute_req_t *req) {
+
+    bool dict = (req->flags & EM4X05_BRUTE_DICT);
+    // a range stops at its end password, it may be 0xFFFFFFFF
+    uint32_t count = (dict) ? MIN(req->pwdcount, EM4X05_BRUTE_DICT_MAX) : UINT32_MAX;
+    uint8_t *pwds = BigBuf_get_EM_addr();
+
+    StartTicks();
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    WaitMS(20);
+
+    BigBuf_free_keep_EM();
+    uint8_t *work = BigBuf_malloc(EM4X05_SAMPLES);
+
+    em4x05_brute_resp_t resp;
+    memset(&resp, 0, sizeof(resp));
+
+    LED_D_ON();
+
+    uint8_t mod = 0;
+    for (uint32_t i = 0; i < count && resp.found == false; i++) {
+
+        if (BUTTON_PRESS() || data_available())
+            break;
+
+        WDT_HIT();
+
+        uint32_t pwd = (dict) ? bytes_to_num(pwds + (i * 4), 4) : req->start + i;
+
+        EM4xLogin(pwd);
+        WaitUS(400);
+
+        size_t samples = EM4x05_AcquireAnswer();
+        if (EM4x05_DemodAnswer(work, samples, &mod, NULL))
+            resp.found = true;
+
+        resp.password = pwd;
+        resp.tried = i + 1;
+
+        if (resp.found == false && (resp.tried % EM4X05_BRUTE_REPORT) == 0)
+            reply_ng(CMD_LF_EM4X_BRUTE, PM3_SUCCESS, (uint8_t *)&resp, sizeof(resp));
+
+        if (dict == false && pwd == req->end)
+            break;
+
+        // back in listening state before the next login
+        WaitMS(1);
+    }
+
+    StopTicks();
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    LEDsoff();
+
+    resp.final = true;
+    reply_ng(CMD_LF_EM4X_BRUTE, PM3_SUCCESS, (uint8_t *)&resp, sizeof(resp));
+    BigBuf_free_keep_EM();
+}
+
 void EM4xWriteWord(uint8_t addr, uint32_t data, uint32_t pwd, uint8_t usepwd) {
 
     StartTicks();
@@ -2665,6 +3484,17 @@ void Cotag(uint32_t arg0) {
             reply_ng(CMD_LF_COTAG_READ, PM3_SUCCESS, NULL, 0);
             break;
         }
+        case 3: {
+            // as 1, done on the first clean frame, three frames at most
+            uint8_t *dest = BigBuf_malloc(COTAG_BITS);
+            uint8_t *scratch = BigBuf_malloc(COTAG_BITS);
+            int res = doCotagAcquisitionFrame(dest, scratch, COTAG_BITS, 3 * COTAG_BITS);
+            if (res == PM3_SUCCESS || res == PM3_ESOFT)
+                reply_ng(CMD_LF_COTAG_READ, res, dest, COTAG_BITS);
+            else
+                reply_ng(CMD_LF_COTAG_READ, res, NULL, 0);
+            break;
+        }
         default: {
             reply_ng(CMD_LF_COTAG_READ, PM3_SUCCESS, NULL, 0);
             break;
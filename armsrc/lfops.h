@@ -21,7 +21,25 @@ void WriteTItag(uint32_t idhi, uint32_t idlo, uint16_t crc);
 
 void AcquireTiType(void);
 void AcquireRawBitsTI(void);
-void SimulateTagLowFrequencyEx(int period, int gap, bool ledcontrol, int numcycles);
+// Run length coded sim waveform, `repeat` times `first` field clocks at `level` then `second`
+// field clocks at the other level. A FSK/PSK bit or a Manchester bit is a single run
+typedef struct {
+    uint8_t first;
+    uint8_t second;
+    uint8_t level;
+    uint8_t repeat;
+} lf_sim_run_t;
+
+typedef struct {
+    lf_sim_run_t *runs;
+    uint16_t count;
+    uint16_t max;
+    uint32_t len;       // field clocks
+    bool overflow;
+} lf_sim_wave_t;
+
+int SimulateTagLowFrequencyEx(int period, int gap, bool ledcontrol, int numcycles);
+int SimulateTagLowFrequencyRuns(const lf_sim_wave_t *wave, int gap, bool ledcontrol, int numcycles);
 void SimulateTagLowFrequency(int period, int gap, bool ledcontrol);
 void SimulateTagLowFrequencyBidir(int divisor, int max_bitlen);
 
@@ -33,7 +51,34 @@ void CmdFSKsimTAG(uint8_t fchigh, uint8_t fclow, uint8_t separator, uint8_t clk,
 void CmdASKsimTAG(uint8_t encoding, uint8_t invert, uint8_t separator, uint8_t clk, uint16_t size, uint8_t *bits, bool ledcontrol);
 void CmdPSKsimTAG(uint8_t carrier, uint8_t invert, uint8_t clk, uint16_t size, uint8_t *bits, bool ledcontrol);
 void CmdNRZsimTAG(uint8_t invert, uint8_t separator, uint8_t clk, uint16_t size, uint8_t *bits, bool ledcontrol);
+void CmdLFSimSweep(const sim_sweep_t *p);
+
+// samples the demodulators look at, the most is EM410x
+#define LF_WATCH_SAMPLES        16385
+#define LF_WATCH_CACHE_SIZE     8
+#define LF_WATCH_DEDUPE_MS      2000
+
+typedef struct {
+    uint8_t type;
+    uint32_t hi2;
+    uint32_t hi;
+    uint64_t lo;
+    char desc[128];
+} lf_watch_id_t;
+
+typedef struct {
+    uint8_t type;
+    uint32_t hi2;
+    uint32_t hi;
+    uint64_t lo;
+    uint32_t last;      // ms
+} lf_watch_cache_entry_t;
+
+typedef struct {
+    lf_watch_cache_entry_t entry[LF_WATCH_CACHE_SIZE];
+} lf_watch_cache_t;
 
+int lf_watch(uint8_t types, int findone, lf_watch_cache_t *cache, lf_watch_id_t *found);
 int lf_hid_watch(int findone, uint32_t *high, uint32_t *low);
 int lf_awid_watch(int findone, uint32_t *high, uint32_t *low); // Realtime demodulation mode for AWID26
 int lf_em410x_watch(int findone, uint32_t *high, uint64_t *low);
@@ -50,14 +95,20 @@ void T55xxResetRead(uint8_t flags);
 void T55xxWriteBlock(uint8_t *data);
 // void T55xxWriteBlockExt(uint32_t data, uint8_t blockno, uint32_t pwd, uint8_t flags);
 void T55xxReadBlock(uint8_t page, bool pwd_mode, bool brute_mem, uint8_t block, uint32_t pwd, uint8_t downlink_mode);
+void T55xxReadBlockSamples(uint8_t page, bool pwd_mode, bool brute_mem, uint8_t block, uint32_t pwd, uint8_t downlink_mode, size_t samples);
 void T55xxWakeUp(uint32_t pwd, uint8_t flags);
 void T55xx_ChkPwds(uint8_t flags);
+void T55xx_BruteForce(const t55xx_brute_req_t *req);
+void ReadLFDemod(const lf_demod_req_t *req);
+void T55xxWriteBlocks(t55xx_write_blocks_t *req);
 void T55xxDangerousRawTest(uint8_t *data);
 
 void TurnReadLFOn(uint32_t delay);
 
 void EM4xReadWord(uint8_t addr, uint32_t pwd, uint8_t usepwd);
 void EM4xWriteWord(uint8_t addr, uint32_t data, uint32_t pwd, uint8_t usepwd);
+void EM4xReadAll(const em4x05_read_all_req_t *req);
+void EM4xBruteForce(const em4x05_brute_req_t *req);
 
 void Cotag(uint32_t arg0);
 void setT55xxConfig(uint8_t arg0, t55xx_configurations_t *c);
@@ -9,6 +9,7 @@
 #include "lfsampling.h"
 
 #include "proxmark3_arm.h"
+#include "cmd.h"
 #include "BigBuf.h"
 #include "fpgaloader.h"
 #include "ticks.h"
@@ -405,6 +406,136 @@ uint32_t SniffLF(bool verbose, uint32_t sample_size) {
     return ReadLF(false, verbose, sample_size);
 }
 
+/**
+* Streams the ADC samples to the client while sampling continues, so captures are
+* not limited by BigBuf. The SSC fills a circular DMA buffer, the foreground loop
+* decimates into a frame and pushes it when full. A push blocks for a short while,
+* the DMA buffer has to cover that, else the stream ends with PM3_EOVFLOW.
+**/
+#define LF_STREAM_DMA_SIZE 8192
+
+void StreamLF(uint8_t flags, uint32_t sample_size) {
+
+    bool reader_field = flags & LF_STREAM_READER_FIELD;
+    uint8_t decimation = config.decimation;
+    bool avg = config.averaging;
+    int16_t trigger_threshold = config.trigger_threshold;
+    int32_t samples_to_skip = config.samples_to_skip;
+
+    BigBuf_free();
+    BigBuf_Clear_ext(false);
+
+    uint8_t *dma_buf = BigBuf_malloc(LF_STREAM_DMA_SIZE);
+    lf_stream_frame_t *frame = (lf_stream_frame_t *)BigBuf_malloc(sizeof(lf_stream_frame_t));
+    if (dma_buf == NULL || frame == NULL) {
+        reply_ng(CMD_LF_ACQ_RAW_ADC_STREAM, PM3_EMALLOC, NULL, 0);
+        return;
+    }
+    memset(frame, 0, sizeof(lf_stream_frame_t));
+    frame->decimation = decimation;
+
+    LFSetupFPGAForADC(config.divisor, reader_field);
+
+    if (FpgaSetupSscDma(dma_buf, LF_STREAM_DMA_SIZE) == false) {
+        reply_ng(CMD_LF_ACQ_RAW_ADC_STREAM, PM3_EINIT, NULL, 0);
+        StopTicks();
+        FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+        return;
+    }
+
+    uint8_t *data = dma_buf;
+    bool trigger_hit = false;
+    uint8_t dec_counter = 0;
+    uint32_t sum = 0;
+    uint32_t saved = 0;
+    int status = PM3_SUCCESS;
+
+    LED_A_ON();
+
+    for (;;) {
+        WDT_HIT();
+
+        if (BUTTON_PRESS() || data_available()) {
+            status = PM3_EOPABORTED;
+            break;
+        }
+
+        uint16_t readBufDataP = data - dma_buf;
+        uint16_t dmaBufDataP = LF_STREAM_DMA_SIZE - AT91C_BASE_PDC_SSC->PDC_RCR;
+        uint16_t dataLen;
+        if (readBufDataP <= dmaBufDataP)
+            dataLen = dmaBufDataP - readBufDataP;
+        else
+            dataLen = LF_STREAM_DMA_SIZE - readBufDataP + dmaBufDataP;
+
+        // the client did not read fast enough, samples were overwritten
+        if (dataLen > (9 * LF_STREAM_DMA_SIZE / 10) || AT91C_BASE_PDC_SSC->PDC_RCR == 0) {
+            status = PM3_EOVFLOW;
+            break;
+        }
+
+        // secondary buffer sets as primary, secondary buffer was stopped
+        if (AT91C_BASE_PDC_SSC->PDC_RNCR == 0) {
+            AT91C_BASE_PDC_SSC->PDC_RNPR = (uint32_t) dma_buf;
+            AT91C_BASE_PDC_SSC->PDC_RNCR = LF_STREAM_DMA_SIZE;
+        }
+
+        while (dataLen--) {
+            uint8_t sample = *data++;
+            if (data == dma_buf + LF_STREAM_DMA_SIZE)
+                data = dma_buf;
+
+            // threshold either high or low values 128 = center 0.
+            if (trigger_hit == false) {
+                if ((trigger_threshold > 0) && (sample < (trigger_threshold + 128)) && (sample > (128 - trigger_threshold)))
+                    continue;
+                trigger_hit = true;
+            }
+
+            if (samples_to_skip > 0) {
+                samples_to_skip--;
+                continue;
+            }
+
+            sum += sample;
+            if (++dec_counter < decimation)
+                continue;
+
+            frame->data[frame->len++] = avg ? sum / decimation : sample;
+            dec_counter = 0;
+            sum = 0;
+            saved++;
+
+            if (frame->len == LF_STREAM_SAMPLES) {
+                LED_B_ON();
+                reply_ng(CMD_LF_ACQ_RAW_ADC_STREAM, PM3_SUCCESS, (uint8_t *)frame, sizeof(lf_stream_frame_t));
+                LED_B_OFF();
+                frame->seq++;
+                frame->len = 0;
+            }
+
+            if (sample_size && saved >= sample_size)
+                break;
+        }
+
+        if (sample_size && saved >= sample_size)
+            break;
+    }
+
+    FpgaDisableSscDma();
+    StopTicks();
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+
+    frame->final = true;
+    reply_ng(CMD_LF_ACQ_RAW_ADC_STREAM, status, (uint8_t *)frame, sizeof(lf_stream_frame_t) - LF_STREAM_SAMPLES + frame->len);
+
+    if (DBGLEVEL >= DBG_DEBUG)
+        Dbprintf("StreamLF finished, " _YELLOW_("%u") " samples in " _YELLOW_("%u") " frames", saved, frame->seq + 1);
+
+    LEDsoff();
+    BigBuf_free();
+}
+
 /**
 * acquisition of T55x7 LF signal. Similar to other LF, but adjusted with @marshmellows thresholds
 * the data is collected in BigBuf.
@@ -616,3 +747,117 @@ uint16_t doCotagAcquisitionManchester(uint8_t *dest, uint16_t destlen) {
 
     return i;
 }
+
+/**
+* As doCotagAcquisitionManchester, with the Manchester check done while sampling. The last destlen half bits
+* are kept in a ring and the read ends as soon as they are one clean frame: every bit pair from the start of
+* the window is 01 or 10. Lost sync slides the window along, a gap in the signal starts over. When no frame
+* comes in maxperiods half bit periods of samples, dest gets the last window anyway. scratch holds destlen bytes.
+* PM3_SUCCESS, PM3_ESOFT for a window with errors, PM3_ENODATA for no full window, PM3_EOPABORTED
+**/
+int doCotagAcquisitionFrame(uint8_t *dest, uint8_t *scratch, uint16_t destlen, uint32_t maxperiods) {
+
+    if (dest == NULL || scratch == NULL || destlen < 2 || (destlen & 1))
+        return PM3_EINVARG;
+
+    // half bits go in dest as a ring, scratch[k % destlen] is set when half bit k equals half bit k - 1.
+    // errors[p] counts the set ones of the window with k % 2 == p
+    bool firsthigh = false, firstlow = false;
+    uint8_t curr = 0, prev = 0;
+    uint16_t period = 0, errors[2] = {0, 0};
+    uint32_t k = 0, same = 0;
+    uint32_t samples = 0, maxsamples = maxperiods * COTAG_T1;
+    int status = PM3_ENODATA;
+
+    while (samples < maxsamples) {
+
+        WDT_HIT();
+
+        if (BUTTON_PRESS()) {
+            status = PM3_EOPABORTED;
+            break;
+        }
+
+        if ((AT91C_BASE_SSC->SSC_SR & AT91C_SSC_RXRDY) == 0)
+            continue;
+
+        volatile uint8_t sample = (uint8_t)AT91C_BASE_SSC->SSC_RHR;
+        samples++;
+
+        // find first peak, the half bit periods start on the low after it
+        if (firsthigh == false) {
+            if (sample < COTAG_ONE_THRESHOLD)
+                continue;
+            firsthigh = true;
+        }
+
+        if (firstlow == false) {
+            if (sample > COTAG_ZERO_THRESHOLD)
+                continue;
+            firstlow = true;
+            period = 0;
+        }
+
+        // set sample 1, 0,  or previous
+        if (sample > COTAG_ONE_THRESHOLD) {
+            prev = curr;
+            curr = 1;
+        } else if (sample < COTAG_ZERO_THRESHOLD) {
+            prev = curr;
+            curr = 0;
+        } else {
+            curr = prev;
+        }
+
+        // full T1 periods,
+        if (period > 0) {
+            --period;
+            continue;
+        }
+        period = COTAG_T1;
+
+        uint8_t v = (k && curr == dest[(k - 1) % destlen]) ? 1 : 0;
+
+        // Manchester changes level at least every two half bits, a longer run is a gap. Start over
+        same = v ? same + 1 : 0;
+        if (same > 4) {
+            k = 0;
+            same = 0;
+            errors[0] = errors[1] = 0;
+            firsthigh = firstlow = false;
+            continue;
+        }
+
+        dest[k % destlen] = curr;
+        scratch[k % destlen] = v;
+        errors[k & 1] += v;
+
+        // the window is half bits k - destlen + 1 .. k, its first one pairs with nothing inside
+        if (k + 1 >= destlen) {
+            uint32_t start = k + 1 - destlen;
+            if (start > 0)
+                errors[start & 1] -= scratch[start % destlen];
+
+            // pairs (start, start + 1), ... end on the other parity
+            if (errors[(start + 1) & 1] == 0) {
+                status = PM3_SUCCESS;
+                k++;
+                break;
+            }
+            status = PM3_ESOFT;
+        }
+        k++;
+    }
+
+    // window from its first half bit on
+    if (k >= destlen) {
+        uint16_t first = k % destlen;
+        memcpy(scratch, dest + first, destlen - first);
+        memcpy(scratch + destlen - first, dest, first);
+        memcpy(dest, scratch, destlen);
+    } else if (status == PM3_ESOFT) {
+        // a gap came after the last full window
+        status = PM3_ENODATA;
+    }
+    return status;
+}
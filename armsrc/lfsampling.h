@@ -23,6 +23,8 @@ typedef struct {
 **/
 void doCotagAcquisition(void);
 uint16_t doCotagAcquisitionManchester(uint8_t *dest, uint16_t destlen);
+// ends on the first clean Manchester frame of destlen half bits, see lfsampling.c
+int doCotagAcquisitionFrame(uint8_t *dest, uint8_t *scratch, uint16_t destlen, uint32_t maxperiods);
 
 /**
 * acquisition of T55x7 LF signal. Similar to other LF, but adjusted with @marshmellows thresholds
@@ -42,6 +44,12 @@ uint32_t SampleLF(bool verbose, uint32_t sample_size);
 **/
 uint32_t SniffLF(bool verbose, uint32_t sample_size);
 
+/**
+* Samples with the LF config and streams them to the client until sample_size
+* samples are sent (0 = no limit), CMD_BREAK_LOOP or button press.
+**/
+void StreamLF(uint8_t flags, uint32_t sample_size);
+
 uint32_t DoAcquisition(uint8_t decimation, uint8_t bits_per_sample, bool avg, int16_t trigger_threshold,
                        bool verbose, uint32_t sample_size, uint32_t cancel_after, int32_t samples_to_skip);
 
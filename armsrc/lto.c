@@ -0,0 +1,160 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Routines to read / write LTO-CM cartridge memory, a mangled ISO 14443 type A
+//
+// The tag is woken up and selected once per command, the blocks then follow
+// back to back. The frames are the ones of client/src/cmdhflto.c
+//-----------------------------------------------------------------------------
+
+#include "lto.h"
+
+#include "proxmark3_arm.h"
+#include "cmd.h"
+#include "appmain.h"
+#include "BigBuf.h"
+#include "iso14443a.h"
+#include "fpgaloader.h"
+#include "protocols.h"
+#include "string.h"
+#include "util.h"
+#include "commonutil.h"
+
+// the answer must be resp_len bytes long
+static int lto_exchange(const uint8_t *cmd, uint8_t len, bool addcrc, bool is7bits, uint8_t *resp, uint8_t resp_len) {
+    uint8_t frame[LTO_BLOCK_SIZE + 2];
+    uint8_t buf[MAX_FRAME_SIZE];
+    uint8_t par[MAX_PARITY_SIZE] = {0};
+
+    memcpy(frame, cmd, len);
+    if (addcrc) {
+        AddCrc14A(frame, len);
+        len += 2;
+    }
+
+    if (is7bits)
+        ReaderTransmitBitsPar(frame, 7, par, NULL);
+    else
+        ReaderTransmit(frame, len, NULL);
+
+    if (ReaderReceive(buf, par) != resp_len)
+        return PM3_EWRONGANSWER;
+
+    memcpy(resp, buf, resp_len);
+    return PM3_SUCCESS;
+}
+
+// WUPA, REQUEST SERIAL NUMBER and SELECT. PM3_ESOFT when no tag answers
+static int lto_select(uint8_t *uid) {
+    uint8_t type_info[2];
+    uint8_t wupa_cmd[] = {LTO_REQ_STANDARD};
+    if (lto_exchange(wupa_cmd, sizeof(wupa_cmd), false, true, type_info, sizeof(type_info)) != PM3_SUCCESS)
+        return PM3_ESOFT;
+
+    uint8_t select_sn_cmd[] = {LTO_SELECT, 0x20};
+    if (lto_exchange(select_sn_cmd, sizeof(select_sn_cmd), false, false, uid, 5) != PM3_SUCCESS)
+        return PM3_EWRONGANSWER;
+
+    uint8_t select_cmd[] = {LTO_SELECT, 0x70, 0, 0, 0, 0, 0};
+    memcpy(select_cmd + 2, uid, 5);
+    uint8_t ack = 0;
+    if (lto_exchange(select_cmd, sizeof(select_cmd), true, false, &ack, 1) != PM3_SUCCESS || ack != 0x0A)
+        return PM3_EWRONGANSWER;
+
+    return PM3_SUCCESS;
+}
+
+// READ BLOCK gives the first half, READ BLOCK CONTINUE the second, both with their CRC
+static int lto_rdbl(uint8_t blk, uint8_t *data) {
+    uint8_t half[16 + 2];
+    uint8_t rdbl_cmd[] = {LTO_READBLOCK, blk};
+    if (lto_exchange(rdbl_cmd, sizeof(rdbl_cmd), true, false, half, sizeof(half)) != PM3_SUCCESS)
+        return PM3_EWRONGANSWER;
+    memcpy(data, half, 16);
+
+    uint8_t rdbl_cnt_cmd[] = {LTO_READBLOCK_CONT};
+    if (lto_exchange(rdbl_cnt_cmd, sizeof(rdbl_cnt_cmd), false, false, half, sizeof(half)) != PM3_SUCCESS)
+        return PM3_EWRONGANSWER;
+    memcpy(data + 16, half, 16);
+    return PM3_SUCCESS;
+}
+
+static int lto_wrbl(uint8_t blk, const uint8_t *data) {
+    uint8_t ack = 0;
+    uint8_t wrbl_cmd[] = {LTO_WRITEBLOCK, blk};
+    if (lto_exchange(wrbl_cmd, sizeof(wrbl_cmd), true, false, &ack, 1) != PM3_SUCCESS || ack != 0x0A)
+        return PM3_EWRONGANSWER;
+
+    for (uint8_t i = 0; i < 2; i++) {
+        if (lto_exchange(data + i * 16, 16, true, false, &ack, 1) != PM3_SUCCESS || ack != 0x0A)
+            return PM3_EWRONGANSWER;
+    }
+    return PM3_SUCCESS;
+}
+
+static void lto_setup(void) {
+    clear_trace();
+    set_tracing(true);
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+    LED_A_ON();
+}
+
+static void lto_finish(void) {
+    hf_field_off();
+    set_tracing(false);
+    LED_A_OFF();
+}
+
+void LTODump(lto_dump_req_t *req) {
+    lto_dump_frame_t frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.first = req->first;
+
+    lto_setup();
+
+    int res = lto_select(frame.uid);
+    for (uint16_t blk = req->first; res == PM3_SUCCESS && blk <= req->last; blk++) {
+        WDT_HIT();
+        if (data_available()) {
+            res = PM3_EOPABORTED;
+            break;
+        }
+
+        if (frame.count == LTO_FRAME_BLOCKS) {
+            reply_ng(CMD_HF_LTO_DUMP, PM3_SUCCESS, (uint8_t *)&frame, sizeof(frame));
+            frame.first = blk;
+            frame.count = 0;
+        }
+
+        res = lto_rdbl(blk, frame.data + frame.count * LTO_BLOCK_SIZE);
+        if (res == PM3_SUCCESS)
+            frame.count++;
+    }
+
+    lto_finish();
+
+    frame.final = true;
+    reply_ng(CMD_HF_LTO_DUMP, res, (uint8_t *)&frame, sizeof(frame) - sizeof(frame.data) + frame.count * LTO_BLOCK_SIZE);
+}
+
+void LTORestore(lto_restore_req_t *req) {
+    uint8_t uid[5];
+    uint8_t written = 0;
+    uint8_t count = MIN(req->count, LTO_FRAME_BLOCKS);
+
+    lto_setup();
+
+    int res = lto_select(uid);
+    for (; res == PM3_SUCCESS && written < count; written++) {
+        WDT_HIT();
+        res = lto_wrbl(req->first + written, req->data + written * LTO_BLOCK_SIZE);
+        if (res != PM3_SUCCESS)
+            break;
+    }
+
+    lto_finish();
+
+    reply_ng(CMD_HF_LTO_RESTORE, res, &written, sizeof(written));
+}
@@ -0,0 +1,18 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Routines to read / write LTO-CM cartridge memory, a mangled ISO 14443 type A
+//-----------------------------------------------------------------------------
+
+#ifndef __LTO_H
+#define __LTO_H
+
+#include "common.h"
+#include "pm3_cmd.h"
+
+void LTODump(lto_dump_req_t *req);
+void LTORestore(lto_restore_req_t *req);
+
+#endif /* __LTO_H */
@@ -30,6 +30,7 @@
 #include "util.h"
 #include "commonutil.h"
 #include "crc16.h"
+#include "lz4.h"
 #include "dbprint.h"
 #include "ticks.h"
 #include "usb_cdc.h"  // usb_poll_validate_length
@@ -150,6 +151,65 @@ void MifareUC_Auth(uint8_t arg0, uint8_t *keybytes) {
     reply_mix(CMD_ACK, 1, 0, 0, 0, 0);
 }
 
+// Tries a batch of EV1 / NTAG passwords or UL-C 3DES keys, see mfu_chk_req_t. The card is selected
+// with anticollision once, a refused key halts it and it is woken up again by its UID
+void MifareUChkPwd(uint8_t *datain) {
+    mfu_chk_req_t *req = (mfu_chk_req_t *)datain;
+
+    mfu_chk_resp_t resp = {0};
+    int status = PM3_SUCCESS;
+
+    bool ulc = (req->flags & MFU_CHK_ULC);
+    uint8_t keylen = ulc ? 16 : 4;
+    uint8_t count = MIN(req->count, MFU_CHK_KEYS_DATA / keylen);
+
+    LEDsoff();
+    LED_A_ON();
+
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+    clear_trace();
+    set_tracing(true);
+
+    uint8_t uid[10] = {0};
+    iso14a_card_select_t card;
+    if (iso14443a_select_card(uid, &card, NULL, true, 0, true) == 0) {
+        status = PM3_ECARDEXCHANGE;
+        goto out;
+    }
+    uint8_t cascades = (card.uidlen == 10) ? 3 : (card.uidlen == 7) ? 2 : 1;
+
+    for (uint8_t i = 0; i < count; i++) {
+        WDT_HIT();
+
+        if (BUTTON_PRESS() || data_available()) {
+            status = PM3_EOPABORTED;
+            break;
+        }
+
+        if (i && iso14443a_fast_select_card(uid, cascades) == 0) {
+            status = PM3_ECARDEXCHANGE;
+            break;
+        }
+
+        uint8_t *key = req->keys + i * keylen;
+        uint8_t pack[4] = {0};
+        int res = ulc ? mifare_ultra_auth(key) : mifare_ul_ev1_auth(key, pack);
+        resp.tried++;
+        if (res) {
+            resp.found = true;
+            resp.index = i;
+            memcpy(resp.pack, pack, sizeof(resp.pack));
+            break;
+        }
+    }
+
+out:
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    set_tracing(false);
+    LEDsoff();
+    reply_ng(CMD_HF_MIFAREU_CHKPWD, status, (uint8_t *)&resp, sizeof(resp));
+}
+
 // Arg0 = BlockNo,
 // Arg1 = UsePwd bool
 // datain = PWD bytes,
@@ -377,6 +437,166 @@ void MifareUReadCard(uint8_t arg0, uint16_t arg1, uint8_t arg2, uint8_t *datain)
     set_tracing(false);
 }
 
+static bool mfu_dump_auth(mfu_dump_req_t *req, uint8_t *pack) {
+    uint8_t dummy[4] = {0};
+    switch (req->keytype) {
+        case 1:
+            return mifare_ultra_auth(req->key);
+        case 2:
+            return mifare_ul_ev1_auth(req->key, pack ? pack : dummy);
+        default:
+            return true;
+    }
+}
+
+// a refused command leaves the tag in IDLE, wake it up by its UID and authenticate again
+static bool mfu_dump_reselect(mfu_dump_req_t *req, uint8_t *uid, uint8_t cascades) {
+    if (iso14443a_fast_select_card(uid, cascades) == 0)
+        return false;
+    return mfu_dump_auth(req, NULL);
+}
+
+// FAST_READ of pages first..first + count - 1, 0 or a mifare_ultra_readblock like error
+static int mfu_fast_read(uint8_t first, uint8_t count, uint8_t *out) {
+    uint8_t range[2] = {first, first + count - 1};
+    uint8_t answer[MAX_FRAME_SIZE] = {0x00};
+    uint8_t answer_par[MAX_PARITY_SIZE] = {0x00};
+
+    int len = mifare_sendcmd(MIFARE_ULEV1_FASTREAD, range, sizeof(range), answer, answer_par, NULL);
+    if (len == 1)
+        return 1;
+    if (len != count * 4 + 2)
+        return 2;
+    if (!CheckCrc14A(answer, len))
+        return 3;
+
+    memcpy(out, answer, count * 4);
+    return 0;
+}
+
+// a GET_VERSION, READ_CNT, CHECK_TEARING_EVENT or READ_SIG answer of len data bytes, false if refused
+static bool mfu_dump_cmd(uint8_t cmd, uint8_t *arg, uint8_t arglen, uint8_t *out, uint8_t len) {
+    uint8_t answer[MAX_FRAME_SIZE] = {0x00};
+    uint8_t answer_par[MAX_PARITY_SIZE] = {0x00};
+
+    int res = mifare_sendcmd(cmd, arg, arglen, answer, answer_par, NULL);
+    if (res != len + 2 || !CheckCrc14A(answer, res))
+        return false;
+
+    memcpy(out, answer, len);
+    return true;
+}
+
+// Dumps an Ultralight / NTAG in one session, see mfu_dump_req_t. Pages the tag refuses end the dump,
+// what was read before is kept
+void MifareUDump(uint8_t *datain) {
+    mfu_dump_req_t *req = (mfu_dump_req_t *)datain;
+    mfu_dump_resp_t resp = {0};
+    int status = PM3_SUCCESS;
+
+    LEDsoff();
+    LED_A_ON();
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+
+    BigBuf_free();
+    BigBuf_Clear_ext(false);
+    clear_trace();
+    set_tracing(true);
+
+    uint16_t pages = MIN(req->pages, CARD_MEMORY_SIZE / 4);
+    uint8_t *dataout = BigBuf_malloc(CARD_MEMORY_SIZE);
+    if (dataout == NULL) {
+        status = PM3_EMALLOC;
+        goto out;
+    }
+    resp.offset = dataout - BigBuf_get_addr();
+
+    uint8_t uid[10] = {0};
+    iso14a_card_select_t card;
+    if (iso14443a_select_card(uid, &card, NULL, true, 0, true) == 0) {
+        status = PM3_ECARDEXCHANGE;
+        goto out;
+    }
+    uint8_t cascades = (card.uidlen == 10) ? 3 : (card.uidlen == 7) ? 2 : 1;
+
+    uint8_t pack[4] = {0};
+    if (!mfu_dump_auth(req, pack)) {
+        status = PM3_EWRONGANSWER;
+        goto out;
+    }
+    memcpy(resp.pack, pack, sizeof(resp.pack));
+
+    bool fast = (req->flags & MFU_DUMP_FAST_READ);
+    while (resp.pages < pages) {
+        WDT_HIT();
+
+        uint8_t page = req->startpage + resp.pages;
+        uint8_t *p = dataout + resp.pages * 4;
+
+        if (fast) {
+            uint8_t count = MIN(pages - resp.pages, MFU_FAST_READ_PAGES);
+            if (mfu_fast_read(page, count, p) == 0) {
+                resp.pages += count;
+                continue;
+            }
+            // no FAST_READ or a range past the end, go on with READ
+            fast = false;
+            if (!mfu_dump_reselect(req, uid, cascades))
+                break;
+        }
+
+        // READ answers 4 pages, wrapping around at the end of the memory
+        uint8_t block[16] = {0};
+        if (mifare_ultra_readblock(page, block)) {
+            if (DBGLEVEL >= DBG_ERROR) Dbprintf("Read page %d error", page);
+            mfu_dump_reselect(req, uid, cascades);
+            break;
+        }
+        uint8_t count = MIN(pages - resp.pages, 4);
+        memcpy(p, block, count * 4);
+        resp.pages += count;
+    }
+
+    if (resp.pages == 0) {
+        status = PM3_ESOFT;
+        goto out;
+    }
+
+    if (req->flags & MFU_DUMP_VERSION) {
+        if (!mfu_dump_cmd(MIFARE_ULEV1_VERSION, NULL, 0, resp.version, sizeof(resp.version))
+                && !mfu_dump_reselect(req, uid, cascades))
+            goto out;
+    }
+
+    for (uint8_t n = 0; n < 3; n++) {
+        if ((req->counters & (1 << n))
+                && !mfu_dump_cmd(MIFARE_ULEV1_READ_CNT, &n, 1, resp.counter_tearing[n], 3)
+                && !mfu_dump_reselect(req, uid, cascades))
+            goto out;
+
+        if ((req->tearing & (1 << n))
+                && !mfu_dump_cmd(MIFARE_ULEV1_CHECKTEAR, &n, 1, &resp.counter_tearing[n][3], 1)
+                && !mfu_dump_reselect(req, uid, cascades))
+            goto out;
+    }
+
+    if (req->flags & MFU_DUMP_SIGNATURE) {
+        uint8_t addr = 0x00;
+        mfu_dump_cmd(MIFARE_ULEV1_READSIG, &addr, 1, resp.signature, sizeof(resp.signature));
+    }
+
+    mifare_ultra_halt();
+
+out:
+    if (DBGLEVEL >= DBG_EXTENDED) Dbprintf("Pages read %d", resp.pages);
+
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    set_tracing(false);
+    LEDsoff();
+    reply_ng(CMD_HF_MIFAREU_DUMP, status, (uint8_t *)&resp, sizeof(resp));
+    BigBuf_free();
+}
+
 //-----------------------------------------------------------------------------
 // Select, Authenticate, Write a MIFARE tag.
 // read block
@@ -444,6 +664,220 @@ void MifareWriteBlock(uint8_t arg0, uint8_t arg1, uint8_t *datain) {
     set_tracing(false);
 }
 
+// Session shared by the bulk sector commands. The card is selected once, later
+// sectors are reached with nested authentications as long as the session runs.
+typedef struct {
+    struct Crypto1State mpcs;
+    uint8_t uid[10];
+    uint32_t cuid;
+    bool session;       // crypto session running, the next auth is nested
+    uint8_t sector;     // sector and key the session is authenticated for
+    uint8_t keytype;
+} mf_bulk_t;
+
+static bool mf_bulk_auth(mf_bulk_t *b, uint8_t sectorNo, uint8_t keyType, uint64_t ui64Key) {
+
+    if (b->session && b->sector == sectorNo && b->keytype == keyType)
+        return true;
+
+    uint8_t blockNo = FirstBlockOfSector(sectorNo);
+
+    if (b->session) {
+        if (mifare_classic_auth(&b->mpcs, b->cuid, blockNo, keyType, ui64Key, AUTH_NESTED) == 0) {
+            b->sector = sectorNo;
+            b->keytype = keyType;
+            return true;
+        }
+        b->session = false;
+    }
+
+    // session lost or not started yet
+    if (!iso14443a_select_card(b->uid, NULL, &b->cuid, true, 0, true)) {
+        if (DBGLEVEL >= DBG_ERROR) Dbprintf("Can't select card");
+        return false;
+    }
+
+    if (mifare_classic_auth(&b->mpcs, b->cuid, blockNo, keyType, ui64Key, AUTH_FIRST)) {
+        if (DBGLEVEL >= DBG_ERROR) Dbprintf("Auth error sector %2d key %c", sectorNo, keyType ? 'B' : 'A');
+        return false;
+    }
+
+    b->session = true;
+    b->sector = sectorNo;
+    b->keytype = keyType;
+    return true;
+}
+
+static bool mf_bulk_readblock(mf_bulk_t *b, uint8_t sectorNo, uint8_t keyType, uint64_t ui64Key, uint8_t blockNo, uint8_t *dataout) {
+    for (uint8_t tries = 0; tries < 2; tries++) {
+        if (mf_bulk_auth(b, sectorNo, keyType, ui64Key) == false)
+            continue;
+
+        if (mifare_classic_readblock(&b->mpcs, b->cuid, FirstBlockOfSector(sectorNo) + blockNo, dataout) == 0)
+            return true;
+
+        if (DBGLEVEL >= DBG_ERROR) Dbprintf("Read sector %2d block %2d error", sectorNo, blockNo);
+        b->session = false;
+    }
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+// Select once, authenticate and read sector by sector. Keys, access bits and
+// data areas are handled like hf mf dump does it on the client side.
+//-----------------------------------------------------------------------------
+void MifareReadSectorBulk(mf_readsc_bulk_req_t *req) {
+
+    mf_bulk_t b = {0};
+    mf_readsc_bulk_frame_t frame;
+    int status = PM3_SUCCESS;
+
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+
+    clear_trace();
+    set_tracing(true);
+
+    LED_A_ON();
+    LED_B_OFF();
+    LED_C_OFF();
+
+    uint8_t sectorcnt = MIN(req->sectorcnt, ARRAYLEN(req->keyA));
+
+    for (uint8_t sectorNo = 0; sectorNo < sectorcnt; sectorNo++) {
+
+        WDT_HIT();
+
+        if (BUTTON_PRESS() || data_available()) {
+            status = PM3_EOPABORTED;
+            break;
+        }
+
+        memset(&frame, 0, sizeof(frame));
+        frame.sector = sectorNo;
+
+        uint8_t blocks = NumBlocksPerSector(sectorNo);
+        uint8_t trailer = blocks - 1;
+        uint64_t keyA = bytes_to_num(req->keyA[sectorNo], 6);
+        uint64_t keyB = bytes_to_num(req->keyB[sectorNo], 6);
+
+        // C1C2C3 per data area, defaults when the trailer can't be read
+        uint8_t rights[4] = {0x00, 0x00, 0x00, 0x01};
+
+        // at least the access conditions can always be read with key A
+        uint8_t *data = frame.data + 16 * trailer;
+        if (mf_bulk_readblock(&b, sectorNo, 0, keyA, trailer, data)) {
+            frame.readmask |= 1 << trailer;
+            rights[0] = ((data[7] & 0x10) >> 2) | ((data[8] & 0x1) << 1) | ((data[8] & 0x10) >> 4);
+            rights[1] = ((data[7] & 0x20) >> 3) | ((data[8] & 0x2) << 0) | ((data[8] & 0x20) >> 5);
+            rights[2] = ((data[7] & 0x40) >> 4) | ((data[8] & 0x4) >> 1) | ((data[8] & 0x40) >> 6);
+            rights[3] = ((data[7] & 0x80) >> 5) | ((data[8] & 0x8) >> 2) | ((data[8] & 0x80) >> 7);
+        }
+
+        // key A blocks first while its session runs, then the ones only key B may read
+        for (uint8_t keyType = 0; keyType < 2; keyType++) {
+            for (uint8_t blockNo = 0; blockNo < trailer; blockNo++) {
+                uint8_t data_area = (sectorNo < 32) ? blockNo : blockNo / 5;
+                uint8_t r = rights[data_area];
+
+                // no key would work
+                if (r == 0x07)
+                    continue;
+
+                bool only_b = (r == 0x03) || (r == 0x05);
+                if (only_b != (keyType == 1))
+                    continue;
+
+                if (mf_bulk_readblock(&b, sectorNo, keyType, keyType ? keyB : keyA, blockNo, frame.data + 16 * blockNo))
+                    frame.readmask |= 1 << blockNo;
+            }
+        }
+
+        reply_ng(CMD_HF_MIFARE_READSC_BULK, PM3_SUCCESS, (uint8_t *)&frame, offsetof(mf_readsc_bulk_frame_t, data) + 16 * blocks);
+    }
+
+    if (b.session && mifare_classic_halt(&b.mpcs, b.cuid)) {
+        if (DBGLEVEL >= DBG_ERROR) Dbprintf("Halt error");
+    }
+
+    crypto1_deinit(&b.mpcs);
+
+    if (DBGLEVEL >= 2) DbpString("READ SECTORS FINISHED");
+
+    memset(&frame, 0, sizeof(frame));
+    frame.final = true;
+    reply_ng(CMD_HF_MIFARE_READSC_BULK, status, (uint8_t *)&frame, offsetof(mf_readsc_bulk_frame_t, data));
+
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    LEDsoff();
+    set_tracing(false);
+}
+
+//-----------------------------------------------------------------------------
+// Select once, authenticate and write sector by sector, each with its own key.
+//-----------------------------------------------------------------------------
+void MifareWriteSectorBulk(mf_writesc_bulk_req_t *req, uint16_t len) {
+
+    mf_bulk_t b = {0};
+    mf_writesc_bulk_resp_t resp = {0};
+    uint16_t pos = 0;
+    uint16_t datalen = (len > 0) ? len - 1 : 0;
+
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+
+    clear_trace();
+    set_tracing(true);
+
+    LED_A_ON();
+    LED_B_OFF();
+    LED_C_OFF();
+
+    for (uint8_t i = 0; i < req->count && i < MF_WRITESC_BULK_MAX; i++) {
+
+        WDT_HIT();
+
+        if (pos + sizeof(mf_writesc_bulk_entry_t) > datalen)
+            break;
+
+        mf_writesc_bulk_entry_t *e = (mf_writesc_bulk_entry_t *)(req->data + pos);
+        uint8_t blocks = NumBlocksPerSector(e->sector);
+        pos += sizeof(mf_writesc_bulk_entry_t) + 16 * blocks;
+        if (pos > datalen)
+            break;
+
+        uint64_t ui64Key = bytes_to_num(e->key, 6);
+
+        for (uint8_t blockNo = 0; blockNo < blocks; blockNo++) {
+            for (uint8_t tries = 0; tries < 2; tries++) {
+                if (mf_bulk_auth(&b, e->sector, e->keytype & 0x01, ui64Key) == false)
+                    continue;
+
+                if (mifare_classic_writeblock(&b.mpcs, b.cuid, FirstBlockOfSector(e->sector) + blockNo, e->data + 16 * blockNo) == 0) {
+                    resp.writemask[i] |= 1 << blockNo;
+                    break;
+                }
+
+                if (DBGLEVEL >= DBG_ERROR) Dbprintf("Write sector %2d block %2d error", e->sector, blockNo);
+                b.session = false;
+            }
+        }
+        resp.count = i + 1;
+    }
+
+    if (b.session && mifare_classic_halt(&b.mpcs, b.cuid)) {
+        if (DBGLEVEL >= DBG_ERROR) Dbprintf("Halt error");
+    }
+
+    crypto1_deinit(&b.mpcs);
+
+    if (DBGLEVEL >= 2) DbpString("WRITE SECTORS FINISHED");
+
+    reply_ng(CMD_HF_MIFARE_WRITESC_BULK, PM3_SUCCESS, (uint8_t *)&resp, sizeof(resp));
+
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    LEDsoff();
+    set_tracing(false);
+}
+
 // Arg0   : Block to write to.
 // Arg1   : 0 = use no authentication.
 //          1 = use 0x1A authentication.
@@ -894,57 +1328,195 @@ void MifareAcquireEncryptedNonces(uint32_t arg0, uint32_t arg1, uint32_t flags,
 
 
 //-----------------------------------------------------------------------------
-// MIFARE nested authentication.
-//
+// Same acquisition as above, but keeps going until the client sends CMD_BREAK_LOOP
+// (or the button is pressed). The card is only selected with anticollision once,
+// full frames are pushed as CMD_HF_MIFARE_ACQ_NONCES_STREAM replies, the last
+// one has final set and carries what was left.
 //-----------------------------------------------------------------------------
-void MifareNested(uint8_t blockNo, uint8_t keyType, uint8_t targetBlockNo, uint8_t targetKeyType, bool calibrate, uint8_t *key) {
-    uint64_t ui64Key = 0;
-    ui64Key = bytes_to_num(key, 6);
-
-    // variables
-    uint16_t i, j, len;
-    static uint16_t dmin, dmax;
+void MifareAcquireNoncesStream(uint8_t *datain) {
 
-    uint8_t par[1] = {0x00};
-    uint8_t par_array[4] = {0x00};
-    uint8_t uid[10] = {0x00};
-    uint32_t cuid = 0, nt1, nt2, nttest, ks1;
-    uint32_t target_nt[2] = {0x00}, target_ks[2] = {0x00};
+    mf_acq_stream_req_t *req = (mf_acq_stream_req_t *)datain;
 
-    uint16_t ncount = 0;
     struct Crypto1State mpcs = {0, 0};
     struct Crypto1State *pcs;
     pcs = &mpcs;
+
+    uint8_t uid[10] = {0x00};
     uint8_t receivedAnswer[MAX_MIFARE_FRAME_SIZE] = {0x00};
+    uint8_t par_enc[1] = {0x00};
 
-    uint32_t auth1_time, auth2_time;
-    static uint16_t delta_time = 0;
+    uint64_t ui64Key = bytes_to_num(req->key, 6);
+    uint8_t blockNo = req->blockno;
+    uint8_t keyType = req->keytype;
+    uint8_t targetBlockNo = req->target_blockno;
+    uint8_t targetKeyType = req->target_keytype;
+    bool slow = req->flags & MF_ACQ_STREAM_SLOW;
+
+    uint32_t cuid = 0;
+    uint32_t num_nonces = 0;
+    uint8_t nt_par_enc = 0;
+    uint8_t cascade_levels = 0;
+    bool have_uid = false;
+    int status = PM3_SUCCESS;
 
     LED_A_ON();
     LED_C_OFF();
-    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
 
-    // free eventually allocated BigBuf memory
     BigBuf_free();
-    BigBuf_Clear_ext(false);
+    clear_trace();
+    set_tracing(false);
 
-    if (calibrate)
-        clear_trace();
+    mf_acq_stream_frame_t *frame = (mf_acq_stream_frame_t *)BigBuf_malloc(sizeof(mf_acq_stream_frame_t));
+    memset(frame, 0, sizeof(mf_acq_stream_frame_t));
 
-    set_tracing(true);
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
 
-    // statistics on nonce distance
-    int16_t isOK = PM3_SUCCESS;
-#define NESTED_MAX_TRIES 12
-    if (calibrate) { // calibrate: for first call only. Otherwise reuse previous calibration
-        LED_B_ON();
-        WDT_HIT();
+    LED_C_ON();
 
-        uint16_t unsuccessful_tries = 0;
-        uint16_t davg = 0;
-        dmax = 0;
-        dmin = 2000;
-        delta_time = 0;
+    for (;;) {
+
+        // Test if the action was cancelled
+        if (BUTTON_PRESS() || data_available()) {
+            status = PM3_EOPABORTED;
+            break;
+        }
+
+        if (!have_uid) { // need a full select cycle to get the uid first
+            iso14a_card_select_t card_info;
+            if (!iso14443a_select_card(uid, &card_info, &cuid, true, 0, true)) {
+                if (DBGLEVEL >= DBG_ERROR) Dbprintf("AcquireNoncesStream: Can't select card (ALL)");
+                continue;
+            }
+            switch (card_info.uidlen) {
+                case 4 :
+                    cascade_levels = 1;
+                    break;
+                case 7 :
+                    cascade_levels = 2;
+                    break;
+                case 10:
+                    cascade_levels = 3;
+                    break;
+                default:
+                    break;
+            }
+            frame->cuid = cuid;
+            have_uid = true;
+        } else { // no need for anticollision. We can directly select the card
+            if (!iso14443a_fast_select_card(uid, cascade_levels)) {
+                if (DBGLEVEL >= DBG_ERROR) Dbprintf("AcquireNoncesStream: Can't select card (UID)");
+                continue;
+            }
+        }
+
+        if (slow)
+            SpinDelayUs(HARDNESTED_PRE_AUTHENTICATION_LEADTIME);
+
+        uint32_t nt1;
+        if (mifare_classic_authex(pcs, cuid, blockNo, keyType, ui64Key, AUTH_FIRST, &nt1, NULL)) {
+            if (DBGLEVEL >= DBG_ERROR) Dbprintf("AcquireNoncesStream: Auth1 error");
+            continue;
+        }
+
+        // nested authentication
+        uint16_t len = mifare_sendcmd_short(pcs, AUTH_NESTED, 0x60 + (targetKeyType & 0x01), targetBlockNo, receivedAnswer, par_enc, NULL);
+
+        // wait for the card to become ready again
+        CHK_TIMEOUT();
+
+        if (len != 4) {
+            if (DBGLEVEL >= DBG_ERROR) Dbprintf("AcquireNoncesStream: Auth2 error len=%d", len);
+            continue;
+        }
+
+        uint8_t *rec = frame->data + frame->pairs * 9;
+        num_nonces++;
+        if (num_nonces % 2) {
+            memcpy(rec, receivedAnswer, 4);
+            nt_par_enc = par_enc[0] & 0xf0;
+            continue;
+        }
+
+        nt_par_enc |= par_enc[0] >> 4;
+        memcpy(rec + 4, receivedAnswer, 4);
+        rec[8] = nt_par_enc;
+
+        if (++frame->pairs == MF_ACQ_STREAM_PAIRS) {
+            LED_B_ON();
+            reply_ng(CMD_HF_MIFARE_ACQ_NONCES_STREAM, PM3_SUCCESS, (uint8_t *)frame, sizeof(mf_acq_stream_frame_t));
+            LED_B_OFF();
+            frame->seq++;
+            frame->pairs = 0;
+        }
+    }
+
+    LED_C_OFF();
+    crypto1_deinit(pcs);
+
+    // an unpaired nonce at the end is dropped
+    frame->final = true;
+    reply_ng(CMD_HF_MIFARE_ACQ_NONCES_STREAM, status, (uint8_t *)frame, sizeof(mf_acq_stream_frame_t));
+
+    if (DBGLEVEL >= 3) Dbprintf("AcquireNoncesStream finished, %u nonces", num_nonces);
+
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    LEDsoff();
+    set_tracing(false);
+    BigBuf_free();
+}
+
+//-----------------------------------------------------------------------------
+// MIFARE nested authentication.
+//
+//-----------------------------------------------------------------------------
+void MifareNested(uint8_t blockNo, uint8_t keyType, uint8_t targetBlockNo, uint8_t targetKeyType, bool calibrate, uint8_t *key) {
+    uint64_t ui64Key = 0;
+    ui64Key = bytes_to_num(key, 6);
+
+    // variables
+    uint16_t i, j, len;
+    static uint16_t dmin, dmax;
+
+    uint8_t par[1] = {0x00};
+    uint8_t par_array[4] = {0x00};
+    uint8_t uid[10] = {0x00};
+    uint32_t cuid = 0, nt1, nt2, nttest, ks1;
+    uint32_t target_nt[2] = {0x00}, target_ks[2] = {0x00};
+
+    uint16_t ncount = 0;
+    struct Crypto1State mpcs = {0, 0};
+    struct Crypto1State *pcs;
+    pcs = &mpcs;
+    uint8_t receivedAnswer[MAX_MIFARE_FRAME_SIZE] = {0x00};
+
+    uint32_t auth1_time, auth2_time;
+    static uint16_t delta_time = 0;
+
+    LED_A_ON();
+    LED_C_OFF();
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+
+    // free eventually allocated BigBuf memory
+    BigBuf_free();
+    BigBuf_Clear_ext(false);
+
+    if (calibrate)
+        clear_trace();
+
+    set_tracing(true);
+
+    // statistics on nonce distance
+    int16_t isOK = PM3_SUCCESS;
+#define NESTED_MAX_TRIES 12
+    if (calibrate) { // calibrate: for first call only. Otherwise reuse previous calibration
+        LED_B_ON();
+        WDT_HIT();
+
+        uint16_t unsuccessful_tries = 0;
+        uint16_t davg = 0;
+        dmax = 0;
+        dmin = 2000;
+        delta_time = 0;
         uint16_t rtr;
         for (rtr = 0; rtr < 17; rtr++) {
 
@@ -1126,6 +1698,9 @@ void MifareNested(uint8_t blockNo, uint8_t keyType, uint8_t targetBlockNo, uint8
     set_tracing(false);
 }
 
+// Static nonce cards give the nonce of a nested auth as prng_successor(nt, 160) of the one before.
+// Nonce k comes after k nested auths with the known key, their decrypted nonces show the card keeps
+// to it, so each one gets a keystream of its own. The client intersects the candidates of all of them
 void MifareStaticNested(uint8_t blockNo, uint8_t keyType, uint8_t targetBlockNo, uint8_t targetKeyType, uint8_t *key) {
 
     LEDsoff();
@@ -1143,6 +1718,9 @@ void MifareStaticNested(uint8_t blockNo, uint8_t keyType, uint8_t targetBlockNo,
     struct Crypto1State *pcs;
     pcs = &mpcs;
 
+    mf_static_nested_resp_t payload;
+    memset(&payload, 0, sizeof(payload));
+
     LED_A_ON();
     iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
 
@@ -1152,67 +1730,91 @@ void MifareStaticNested(uint8_t blockNo, uint8_t keyType, uint8_t targetBlockNo,
     clear_trace();
     set_tracing(true);
 
-    int16_t isOK = 0;
     LED_C_ON();
 
-    for (uint8_t retry = 0; retry < 3 && (isOK == 0); retry++) {
+    for (uint8_t k = 0; k < MF_STATIC_NESTED_NONCES; k++) {
 
-        WDT_HIT();
+        int16_t isOK = 0;
+        bool keeps = true;
+        for (uint8_t retry = 0; retry < 3 && (isOK == 0); retry++) {
 
-        // prepare next select. No need to power down the card.
-        if (mifare_classic_halt(pcs, cuid)) {
-            if (DBGLEVEL >= DBG_INFO) Dbprintf("Nested: Halt error");
-            retry--;
-            continue;
-        }
+            WDT_HIT();
 
-        if (!iso14443a_select_card(uid, NULL, &cuid, true, 0, true)) {
-            if (DBGLEVEL >= DBG_INFO) Dbprintf("Nested: Can't select card");
-            retry--;
-            continue;
-        };
+            // prepare next select. No need to power down the card.
+            if (mifare_classic_halt(pcs, cuid)) {
+                if (DBGLEVEL >= DBG_INFO) Dbprintf("Nested: Halt error");
+                // the first nonce waits for the card, the others are only a bonus
+                if (k == 0) retry--;
+                continue;
+            }
 
-        // First authentication. Normal auth.
-        if (mifare_classic_authex(pcs, cuid, blockNo, keyType, ui64Key, AUTH_FIRST, &nt1, NULL)) {
-            if (DBGLEVEL >= DBG_INFO) Dbprintf("Nested: Auth1 error");
-            retry--;
-            continue;
-        };
+            if (!iso14443a_select_card(uid, NULL, &cuid, true, 0, true)) {
+                if (DBGLEVEL >= DBG_INFO) Dbprintf("Nested: Can't select card");
+                if (k == 0) retry--;
+                continue;
+            };
 
-        // second authentication. Nested auth
-        len = mifare_sendcmd_short(pcs, AUTH_NESTED, 0x60 + (targetKeyType & 0x01), targetBlockNo, receivedAnswer, par, NULL);
-        if (len != 4) {
-            if (DBGLEVEL >= DBG_INFO) Dbprintf("Nested: Auth2 error len=%d", len);
-            continue;
-        };
+            // First authentication. Normal auth.
+            if (mifare_classic_authex(pcs, cuid, blockNo, keyType, ui64Key, AUTH_FIRST, &nt1, NULL)) {
+                if (DBGLEVEL >= DBG_INFO) Dbprintf("Nested: Auth1 error");
+                if (k == 0) retry--;
+                continue;
+            };
 
-        nt2 = bytes_to_num(receivedAnswer, 4);
-        target_nt = prng_successor(nt1, 160);
-        target_ks = nt2 ^ target_nt;
-        isOK = 1;
+            // k nested auths with the known key before the target one
+            uint32_t nt_last = nt1;
+            bool ok = true;
+            for (uint8_t n = 0; n < k && ok; n++) {
+                uint32_t nt_known = 0;
+                if (mifare_classic_authex(pcs, cuid, blockNo, keyType, ui64Key, AUTH_NESTED, &nt_known, NULL)) {
+                    if (DBGLEVEL >= DBG_INFO) Dbprintf("Nested: Auth%u error", n + 2);
+                    ok = false;
+                    break;
+                }
+                if (nt_known != prng_successor(nt_last, 160)) {
+                    if (DBGLEVEL >= DBG_INFO) Dbprintf("Nested: nonce %u doesn't follow the static one", n + 2);
+                    keeps = false;
+                    ok = false;
+                    break;
+                }
+                nt_last = nt_known;
+            }
+            if (keeps == false)
+                break;
+            if (ok == false)
+                continue;
 
-        if (DBGLEVEL >= DBG_DEBUG) Dbprintf("Testing nt1=%08x nt2enc=%08x nt2par=%02x  ks=%08x", nt1, nt2, par[0], target_ks);
+            // target authentication. Nested auth
+            len = mifare_sendcmd_short(pcs, AUTH_NESTED, 0x60 + (targetKeyType & 0x01), targetBlockNo, receivedAnswer, par, NULL);
+            if (len != 4) {
+                if (DBGLEVEL >= DBG_INFO) Dbprintf("Nested: Auth2 error len=%d", len);
+                continue;
+            };
+
+            nt2 = bytes_to_num(receivedAnswer, 4);
+            target_nt = prng_successor(nt_last, 160);
+            target_ks = nt2 ^ target_nt;
+            isOK = 1;
+
+            if (DBGLEVEL >= DBG_DEBUG) Dbprintf("Testing nt1=%08x nt2enc=%08x nt2par=%02x  ks=%08x", nt_last, nt2, par[0], target_ks);
+        }
+
+        if (isOK == 0)
+            break;
+
+        memcpy(payload.nonces[k].nt, &target_nt, 4);
+        memcpy(payload.nonces[k].ks, &target_ks, 4);
+        payload.count++;
     }
 
     LED_C_OFF();
 
     crypto1_deinit(pcs);
 
-    struct p {
-        int16_t isOK;
-        uint8_t block;
-        uint8_t keytype;
-        uint8_t cuid[4];
-        uint8_t nt[4];
-        uint8_t ks[4];
-    } PACKED payload;
-    payload.isOK = isOK;
+    payload.isOK = (payload.count) ? 1 : 0;
     payload.block = targetBlockNo;
     payload.keytype = targetKeyType;
-
     memcpy(payload.cuid, &cuid, 4);
-    memcpy(payload.nt, &target_nt, 4);
-    memcpy(payload.ks, &target_ks, 4);
 
     LED_B_ON();
     reply_ng(CMD_HF_MIFARE_STATIC_NESTED, PM3_SUCCESS, (uint8_t *)&payload, sizeof(payload));
@@ -1239,17 +1841,60 @@ typedef struct chk_t {
     uint8_t keyType;
     uint8_t *uid;
     struct Crypto1State *pcs;
+    bool session;       // the last check authenticated, the next one can go nested without a select
+    uint32_t timeout;   // answer timeout learned from this card, 0 until the first correct key
 } chk_t;
 
+// Shortest learned answer timeout, in iso14a_set_timeout units (128/fc). A genuine card answers
+// about 10 units after the reader nonce, the learned value is twice its own delay plus a margin
+#define CHK_AUTH_TIMEOUT_MIN    16
+#define CHK_AUTH_TIMEOUT_MARGIN 4
+
+// timeout, learned on an earlier key chunk or 0
+static void chkKey_init(struct chk_t *c, uint8_t *uid, uint32_t cuid, uint8_t cl, struct Crypto1State *pcs, uint32_t timeout) {
+    c->uid = uid;
+    c->cuid = cuid;
+    c->cl = cl;
+    c->pcs = pcs;
+    c->block = 0;
+    c->session = false;
+    c->timeout = timeout;
+    mifare_classic_set_auth_timeout(timeout ? timeout : AUTHENTICATION_ANSWER_TIMEOUT);
+}
+
+// A correct key shows how fast this card answers, wrong keys don't need to wait much longer
+static void chkKey_learn_timing(struct chk_t *c) {
+    if (c->timeout)
+        return;
+
+    c->timeout = MAX(CHK_AUTH_TIMEOUT_MIN, (2 * iso14a_get_last_fdt()) / (16 * 8) + CHK_AUTH_TIMEOUT_MARGIN);
+    mifare_classic_set_auth_timeout(c->timeout);
+    if (DBGLEVEL >= DBG_EXTENDED) Dbprintf("ChkKeys: answer timeout %u", MIN(c->timeout, AUTHENTICATION_ANSWER_TIMEOUT));
+}
+
 // checks one key.
+// while a session is open the key goes as nested auth, no select needed
 // fast select,  tries 5 times to select
 //
 // return:
 //  2 = failed to select.
 //  1 = wrong key
 //  0 = correct key
-static uint8_t chkKey(struct chk_t *c) {
+static uint8_t chkKey_ex(struct chk_t *c, uint8_t keyType) {
     uint8_t i = 0, res = 2;
+
+    if (c->session) {
+        c->session = false;
+        res = mifare_classic_authex(c->pcs, c->cuid, c->block, keyType, c->key, AUTH_NESTED, NULL, NULL);
+        if (res == 0) {
+            c->session = true;
+            return 0;
+        }
+        // the card sent a nonce, so the key is wrong. Otherwise the session was gone already
+        if (res != 1)
+            return 1;
+    }
+
     while (i < 5) {
         // this part is from Piwi's faster nonce collecting part in Hardnested.
         // assume: fast select
@@ -1257,30 +1902,32 @@ static uint8_t chkKey(struct chk_t *c) {
             ++i;
             continue;
         }
-        res = mifare_classic_authex(c->pcs, c->cuid, c->block, c->keyType, c->key, AUTH_FIRST, NULL, NULL);
+        res = mifare_classic_authex(c->pcs, c->cuid, c->block, keyType, c->key, AUTH_FIRST, NULL, NULL);
 
-//        CHK_TIMEOUT();
-
-        // if successful auth, send HALT
-        // if ( !res )
-        // mifare_classic_halt_ex(c->pcs);
+        // keep the authenticated card for the next check
+        if (res == 0) {
+            c->session = true;
+            chkKey_learn_timing(c);
+        }
         break;
     }
     return res;
 }
 
-static uint8_t chkKey_readb(struct chk_t *c, uint8_t *keyb) {
+static uint8_t chkKey(struct chk_t *c) {
+    return chkKey_ex(c, c->keyType);
+}
 
-    if (!iso14443a_fast_select_card(c->uid, c->cl))
-        return 2;
+static uint8_t chkKey_readb(struct chk_t *c, uint8_t *keyb) {
 
-    if (mifare_classic_authex(c->pcs, c->cuid, c->block, 0, c->key, AUTH_FIRST, NULL, NULL))
-        return 1;
+    uint8_t res = chkKey_ex(c, 0);
+    if (res)
+        return res;
 
     uint8_t data[16] = {0x00};
-    uint8_t res = mifare_classic_readblock(c->pcs, c->cuid, c->block, data);
+    res = mifare_classic_readblock(c->pcs, c->cuid, c->block, data);
 
-    // successful read
+    // successful read, the session stays open for the next trailer
     if (!res) {
         // data was something else than zeros.
         if (memcmp(data + 10, "\x00\x00\x00\x00\x00\x00", 6) != 0) {
@@ -1289,7 +1936,9 @@ static uint8_t chkKey_readb(struct chk_t *c, uint8_t *keyb) {
         } else {
             res = 3;
         }
-        mifare_classic_halt_ex(c->pcs);
+    } else {
+        // a refused read leaves the card halted
+        c->session = false;
     }
     return res;
 }
@@ -1382,7 +2031,7 @@ void MifareChkKeys_fast(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *da
     struct Crypto1State mpcs = {0, 0};
     struct Crypto1State *pcs;
     pcs = &mpcs;
-    struct chk_t chk_data;
+    struct chk_t chk_data = {0};
 
     uint8_t allkeys = sectorcnt << 1;
 
@@ -1392,6 +2041,7 @@ void MifareChkKeys_fast(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *da
     static sector_t k_sector[80];
     static uint8_t found[80];
     static uint8_t *uid;
+    static uint32_t auth_timeout = 0;
 
     int oldbg = DBGLEVEL;
 
@@ -1444,6 +2094,7 @@ void MifareChkKeys_fast(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *da
         memset(k_sector, 0x00, 480 + 10);
         memset(found, 0x00, sizeof(found));
         foundkeys = 0;
+        auth_timeout = 0;
 
         iso14a_card_select_t card_info;
         if (!iso14443a_select_card(uid, &card_info, &cuid, true, 0, true)) {
@@ -1472,11 +2123,7 @@ void MifareChkKeys_fast(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *da
     DBGLEVEL = DBG_NONE;
 
     // set check struct.
-    chk_data.uid = uid;
-    chk_data.cuid = cuid;
-    chk_data.cl = cascade_levels;
-    chk_data.pcs = pcs;
-    chk_data.block = 0;
+    chkKey_init(&chk_data, uid, cuid, cascade_levels, pcs, auth_timeout);
 
     // keychunk loop - depth first one sector.
     if (strategy == 1 || use_flashmem) {
@@ -1489,33 +2136,37 @@ void MifareChkKeys_fast(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *da
         // keep track of how many sectors on card.
         for (uint8_t s = 0; s < sectorcnt; ++s) {
 
-            if (found[(s * 2)] && found[(s * 2) + 1])
-                continue;
+            // A first, a found A reads B from the trailer before B is brute forced
+            for (uint8_t keytype = 0; keytype < 2; ++keytype) {
 
-            for (uint16_t i = s_point; i < keyCount; ++i) {
+                if (found[(s * 2) + keytype])
+                    continue;
 
-                // Allow button press / usb cmd to interrupt device
-                if (BUTTON_PRESS() || data_available()) {
-                    goto OUT;
-                }
+                for (uint16_t i = s_point; i < keyCount; ++i) {
 
-                // found all keys?
-                if (foundkeys == allkeys)
-                    goto OUT;
+                    // Allow button press / usb cmd to interrupt device
+                    if (BUTTON_PRESS() || data_available()) {
+                        goto OUT;
+                    }
 
-                WDT_HIT();
+                    // found all keys?
+                    if (foundkeys == allkeys)
+                        goto OUT;
+
+                    WDT_HIT();
 
-                // assume: block0,1,2 has more read rights in accessbits than the sectortrailer. authenticating against block0 in each sector
-                chk_data.block = FirstBlockOfSector(s);
+                    // assume: block0,1,2 has more read rights in accessbits than the sectortrailer. authenticating against block0 in each sector
+                    chk_data.block = FirstBlockOfSector(s);
 
-                // new key
-                chk_data.key = bytes_to_num(datain + i * 6, 6);
+                    // new key
+                    chk_data.key = bytes_to_num(datain + i * 6, 6);
+                    chk_data.keyType = keytype;
 
-                // skip already found A keys
-                if (!found[(s * 2)]) {
-                    chk_data.keyType = 0;
                     status = chkKey(&chk_data);
-                    if (status == 0) {
+                    if (status != 0)
+                        continue;
+
+                    if (keytype == 0) {
                         memcpy(k_sector[s].keyA, datain + i * 6, 6);
                         found[(s * 2)] = 1;
                         ++foundkeys;
@@ -1525,51 +2176,29 @@ void MifareChkKeys_fast(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *da
                         // read Block B, if A is found.
                         chkKey_loopBonly(&chk_data, k_sector, found, &sectorcnt, &foundkeys);
 
+                        chk_data.key = bytes_to_num(datain + i * 6, 6);
                         chk_data.keyType = 1;
                         chkKey_scanB(&chk_data, k_sector, found, &sectorcnt, &foundkeys);
-
-                        chk_data.keyType = 0;
-                        chk_data.block = FirstBlockOfSector(s);
-
-                        if (use_flashmem) {
-                            if (lastpos != i && lastpos != 0) {
-                                if (i - lastpos < 0xF) {
-                                    s_point = i & 0xFFF0;
-                                }
-                            } else {
-                                lastpos = i;
-                            }
-                        }
-                    }
-                }
-
-                // skip already found B keys
-                if (!found[(s * 2) + 1]) {
-                    chk_data.keyType = 1;
-                    status = chkKey(&chk_data);
-                    if (status == 0) {
+                    } else {
                         memcpy(k_sector[s].keyB, datain + i * 6, 6);
                         found[(s * 2) + 1] = 1;
                         ++foundkeys;
 
                         chkKey_scanB(&chk_data, k_sector, found, &sectorcnt, &foundkeys);
+                    }
 
-                        if (use_flashmem) {
-                            if (lastpos != i && lastpos != 0) {
-
-                                if (i - lastpos < 0xF)
-                                    s_point = i & 0xFFF0;
-                            } else {
-                                lastpos = i;
+                    if (use_flashmem) {
+                        if (lastpos != i && lastpos != 0) {
+                            if (i - lastpos < 0xF) {
+                                s_point = i & 0xFFF0;
                             }
+                        } else {
+                            lastpos = i;
                         }
                     }
-                }
-
-                if (found[(s * 2)] && found[(s * 2) + 1])
                     break;
-
-            } // end keys test loop - depth first
+                } // end keys test loop - depth first
+            }
 
             // assume1. if no keys found in first sector, get next keychunk from client
             if (!use_flashmem && (newfound - foundkeys == 0))
@@ -1583,39 +2212,44 @@ void MifareChkKeys_fast(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *da
 
     if (strategy == 2 || use_flashmem) {
 
-        // Keychunk loop
-        for (uint16_t i = 0; i < keyCount; i++) {
+        // A pass over all keys first, found A keys read B back. The B pass only gets the sectors left
+        for (uint8_t keytype = 0; keytype < 2; ++keytype) {
 
-            // Allow button press / usb cmd to interrupt device
-            if (BUTTON_PRESS() || data_available()) break;
+            // Keychunk loop
+            for (uint16_t i = 0; i < keyCount; i++) {
 
-            // found all keys?
-            if (foundkeys == allkeys)
-                goto OUT;
+                // Allow button press / usb cmd to interrupt device
+                if (BUTTON_PRESS() || data_available()) goto OUT;
 
-            WDT_HIT();
+                // found all keys?
+                if (foundkeys == allkeys)
+                    goto OUT;
 
-            // new key
-            chk_data.key = bytes_to_num(datain + i * 6, 6);
+                WDT_HIT();
 
-            // Sector main loop
-            // keep track of how many sectors on card.
-            for (uint8_t s = 0; s < sectorcnt; ++s) {
+                // Sector main loop
+                // keep track of how many sectors on card.
+                for (uint8_t s = 0; s < sectorcnt; ++s) {
 
-                if (found[(s * 2)] && found[(s * 2) + 1]) continue;
+                    // skip already found keys
+                    if (found[(s * 2) + keytype]) continue;
 
-                // found all keys?
-                if (foundkeys == allkeys)
-                    goto OUT;
+                    // found all keys?
+                    if (foundkeys == allkeys)
+                        goto OUT;
+
+                    // assume: block0,1,2 has more read rights in accessbits than the sectortrailer. authenticating against block0 in each sector
+                    chk_data.block = FirstBlockOfSector(s);
 
-                // assume: block0,1,2 has more read rights in accessbits than the sectortrailer. authenticating against block0 in each sector
-                chk_data.block = FirstBlockOfSector(s);
+                    // new key
+                    chk_data.key = bytes_to_num(datain + i * 6, 6);
+                    chk_data.keyType = keytype;
 
-                // skip already found A keys
-                if (!found[(s * 2)]) {
-                    chk_data.keyType = 0;
                     status = chkKey(&chk_data);
-                    if (status == 0) {
+                    if (status != 0)
+                        continue;
+
+                    if (keytype == 0) {
                         memcpy(k_sector[s].keyA, datain + i * 6, 6);
                         found[(s * 2)] = 1;
                         ++foundkeys;
@@ -1624,29 +2258,22 @@ void MifareChkKeys_fast(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *da
 
                         // read Block B, if A is found.
                         chkKey_loopBonly(&chk_data, k_sector, found, &sectorcnt, &foundkeys);
-
-                        chk_data.block = FirstBlockOfSector(s);
-                    }
-                }
-
-                // skip already found B keys
-                if (!found[(s * 2) + 1]) {
-                    chk_data.keyType = 1;
-                    status = chkKey(&chk_data);
-                    if (status == 0) {
+                    } else {
                         memcpy(k_sector[s].keyB, datain + i * 6, 6);
                         found[(s * 2) + 1] = 1;
                         ++foundkeys;
 
                         chkKey_scanB(&chk_data, k_sector, found, &sectorcnt, &foundkeys);
                     }
-                }
-            } // end loop sectors
-        } // end loop keys
+                } // end loop sectors
+            } // end loop keys
+        }
     } // end loop strategy 2
 OUT:
     LEDsoff();
 
+    auth_timeout = chk_data.timeout;
+    mifare_classic_set_auth_timeout(AUTHENTICATION_ANSWER_TIMEOUT);
     crypto1_deinit(pcs);
 
     // All keys found, send to client, or last keychunk from client
@@ -1708,6 +2335,38 @@ OUT:
     DBGLEVEL = oldbg;
 }
 
+// Select for key checks, the first call does the full select cycle to get the uid
+static bool chkkeys_select(uint8_t *uid, uint32_t *cuid, uint8_t *cascade_levels, bool *have_uid) {
+    // Iceman: use piwi's faster nonce collecting part in hardnested.
+    if (*have_uid == false) { // need a full select cycle to get the uid first
+        iso14a_card_select_t card_info;
+        if (!iso14443a_select_card(uid, &card_info, cuid, true, 0, true)) {
+            if (DBGLEVEL >= DBG_ERROR) Dbprintf("ChkKeys: Can't select card (ALL)");
+            return false;
+        }
+        switch (card_info.uidlen) {
+            case 4 :
+                *cascade_levels = 1;
+                break;
+            case 7 :
+                *cascade_levels = 2;
+                break;
+            case 10:
+                *cascade_levels = 3;
+                break;
+            default:
+                break;
+        }
+        *have_uid = true;
+    } else { // no need for anticollision. We can directly select the card
+        if (!iso14443a_select_card(uid, NULL, NULL, false, *cascade_levels, true)) {
+            if (DBGLEVEL >= DBG_ERROR) Dbprintf("ChkKeys: Can't select card (UID)");
+            return false;
+        }
+    }
+    return true;
+}
+
 void MifareChkKeys(uint8_t *datain, uint8_t reserved_mem) {
 
     FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
@@ -1729,116 +2388,461 @@ void MifareChkKeys(uint8_t *datain, uint8_t reserved_mem) {
     keyresult.found = false;
     bool have_uid = false;
 
-    uint8_t keyType = datain[0];
-    uint8_t blockNo = datain[1];
-    bool clearTrace = datain[2];
-    uint16_t key_count = (datain[3] << 8) | datain[4];
+    uint8_t keyType = datain[0];
+    uint8_t blockNo = datain[1];
+    bool clearTrace = datain[2];
+    uint16_t key_count = (datain[3] << 8) | datain[4];
+
+    uint16_t key_mem_available;
+    if (reserved_mem)
+        key_mem_available = key_count * 6;
+    else
+        key_mem_available = MIN((PM3_CMD_DATA_SIZE - 5), key_count * 6);
+
+    key_count = key_mem_available / 6;
+
+    datain += 5;
+
+    LEDsoff();
+    LED_A_ON();
+
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+
+    if (clearTrace)
+        clear_trace();
+
+    int oldbg = DBGLEVEL;
+    DBGLEVEL = DBG_NONE;
+
+    set_tracing(false);
+
+    for (i = 0; i < key_count; i++) {
+
+        if (chkkeys_select(uid, &cuid, &cascade_levels, &have_uid) == false) {
+            --i; // try same key once again
+            continue;
+        }
+
+        key = bytes_to_num(datain + i * 6, 6);
+        res = mifare_classic_auth(pcs, cuid, blockNo, keyType, key, AUTH_FIRST);
+
+//        CHK_TIMEOUT();
+
+        if (res)
+            continue;
+
+        memcpy(keyresult.key, datain + i * 6, 6);
+        keyresult.found = true;
+        break;
+    }
+
+    LED_B_ON();
+
+    reply_ng(CMD_HF_MIFARE_CHKKEYS, PM3_SUCCESS, (uint8_t *)&keyresult, sizeof(keyresult));
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    LEDsoff();
+
+    set_tracing(false);
+    crypto1_deinit(pcs);
+
+    DBGLEVEL = oldbg;
+}
+
+void MifareChkKeys_file(uint8_t *fn) {
+
+#ifdef WITH_FLASH
+    BigBuf_free();
+
+    SpinOff(0);
+
+    int changed = rdv40_spiffs_lazy_mount();
+    uint32_t size = size_in_spiffs((char *)fn);
+    uint8_t *mem = BigBuf_malloc(size);
+
+    rdv40_spiffs_read_as_filetype((char *)fn, mem, size, RDV40_SPIFFS_SAFETY_SAFE);
+
+    if (changed) {
+        rdv40_spiffs_lazy_unmount();
+    }
+
+    SpinOff(0);
+
+    MifareChkKeys(mem, true);
+
+    BigBuf_free();
+#endif
+}
+
+// Candidate key list in BigBuf for MifareChkKeys_batch
+static uint8_t *chkkeys_batch = NULL;
+static uint16_t chkkeys_batch_len = 0;
+
+// Fills the candidate key list, one frame at a time
+void MifareChkKeys_load(mf_chkkeys_load_t *payload, uint16_t len) {
+
+    if (len < offsetof(mf_chkkeys_load_t, data)) {
+        reply_ng(CMD_HF_MIFARE_CHKKEYS_LOAD, PM3_EINVARG, NULL, 0);
+        return;
+    }
+
+    if (payload->offset == 0) {
+        // load the HF image now, it would clear BigBuf when checking
+        FpgaDownloadAndGo(FPGA_BITSTREAM_HF);
+        BigBuf_free();
+        chkkeys_batch = BigBuf_malloc(MF_CHKKEYS_BATCH_MAX_KEYS * 6);
+        chkkeys_batch_len = 0;
+    }
+
+    uint16_t size = MF_CHKKEYS_BATCH_MAX_KEYS * 6;
+    if (chkkeys_batch == NULL || payload->offset > size || payload->rawlen > size - payload->offset) {
+        reply_ng(CMD_HF_MIFARE_CHKKEYS_LOAD, PM3_EOUTOFBOUND, NULL, 0);
+        return;
+    }
+
+    uint16_t datalen = len - offsetof(mf_chkkeys_load_t, data);
+    if (payload->flags & MF_CHKKEYS_LOAD_LZ4) {
+        int res = LZ4_decompress_safe((const char *)payload->data, (char *)chkkeys_batch + payload->offset, datalen, size - payload->offset);
+        if (res != payload->rawlen) {
+            reply_ng(CMD_HF_MIFARE_CHKKEYS_LOAD, PM3_ESOFT, NULL, 0);
+            return;
+        }
+    } else {
+        if (datalen != payload->rawlen) {
+            reply_ng(CMD_HF_MIFARE_CHKKEYS_LOAD, PM3_EINVARG, NULL, 0);
+            return;
+        }
+        memcpy(chkkeys_batch + payload->offset, payload->data, datalen);
+    }
+
+    chkkeys_batch_len = MAX(chkkeys_batch_len, payload->offset + payload->rawlen);
+    reply_ng(CMD_HF_MIFARE_CHKKEYS_LOAD, PM3_SUCCESS, NULL, 0);
+}
+
+// Checks the whole candidate key list, stops at the first valid key
+void MifareChkKeys_batch(mf_chkkeys_batch_req_t *req) {
+
+    mf_chkkeys_batch_resp_t resp;
+    memset(&resp, 0, sizeof(resp));
+
+    uint16_t key_count = MIN(req->keycnt, chkkeys_batch_len / 6);
+    if (chkkeys_batch == NULL || key_count == 0) {
+        resp.final = true;
+        reply_ng(CMD_HF_MIFARE_CHKKEYS_BATCH, PM3_EINVARG, (uint8_t *)&resp, sizeof(resp));
+        return;
+    }
+
+    struct Crypto1State mpcs = {0, 0};
+    struct Crypto1State *pcs = &mpcs;
+    uint8_t uid[10] = {0x00};
+    uint32_t cuid = 0;
+    uint8_t cascade_levels = 0;
+    bool have_uid = false;
+    int status = PM3_SUCCESS;
+
+    LEDsoff();
+    LED_A_ON();
+
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+
+    int oldbg = DBGLEVEL;
+    DBGLEVEL = DBG_NONE;
+
+    set_tracing(false);
+
+    uint32_t lastprogress = GetTickCount();
+
+    for (uint16_t i = 0; i < key_count;) {
+
+        if (BUTTON_PRESS() || data_available()) {
+            status = PM3_EOPABORTED;
+            break;
+        }
+
+        // progress frame if some time passed
+        if (GetTickCountDelta(lastprogress) > 500) {
+            resp.checked = i;
+            reply_ng(CMD_HF_MIFARE_CHKKEYS_BATCH, PM3_SUCCESS, (uint8_t *)&resp, sizeof(resp));
+            lastprogress = GetTickCount();
+        }
+
+        if (chkkeys_select(uid, &cuid, &cascade_levels, &have_uid) == false)
+            continue; // try same key once again
+
+        uint64_t key = bytes_to_num(chkkeys_batch + i * 6, 6);
+        if (mifare_classic_auth(pcs, cuid, req->blockno, req->keytype, key, AUTH_FIRST) == 0) {
+            memcpy(resp.key, chkkeys_batch + i * 6, 6);
+            resp.found = true;
+            break;
+        }
+        i++;
+        resp.checked = i;
+    }
+
+    DBGLEVEL = oldbg;
+    crypto1_deinit(pcs);
+
+    LED_B_ON();
+    resp.final = true;
+    reply_ng(CMD_HF_MIFARE_CHKKEYS_BATCH, status, (uint8_t *)&resp, sizeof(resp));
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    LEDsoff();
+}
+
+// Double buffered key reader for MifareChkKeys_dict. The auth loop takes keys from the front half
+// while the back half is filled one slice per checked key, only an empty back half stops the loop.
+// Keys already in memory are one front half with nothing behind it
+#define CHKKEYS_STREAM_HALF     (256 * 6)
+#define CHKKEYS_STREAM_SLICE    (42 * 6)
+// keys in memory, the front half fill counter limits them
+#define CHKKEYS_MEM_MAX_KEYS    (0xFFFF / 6)
+typedef struct {
+    int fd;
+    uint8_t *buf[2];
+    uint16_t fill[2];       // bytes in each half
+    uint8_t front;
+    uint16_t pos;           // next key in the front half, in bytes
+    bool eof;
+    uint32_t keys;          // keys handed out so far
+} chk_keystream_t;
+
+// reads one more slice into the back half,  returns true if the flash was touched
+static bool chk_keystream_fill(chk_keystream_t *ks) {
+    uint8_t back = ks->front ^ 1;
+    if (ks->eof || ks->fill[back] == CHKKEYS_STREAM_HALF)
+        return false;
+
+#ifdef WITH_FLASH
+    uint16_t want = MIN(CHKKEYS_STREAM_SLICE, CHKKEYS_STREAM_HALF - ks->fill[back]);
+    int n = rdv40_spiffs_read_fd(ks->fd, ks->buf[back] + ks->fill[back], want);
+    if (n < want)
+        ks->eof = true;
+
+    ks->fill[back] += n;
+    return true;
+#else
+    return false;
+#endif
+}
+
+static bool chk_keystream_next(chk_keystream_t *ks, uint8_t **key) {
+    if (ks->pos + 6 > ks->fill[ks->front]) {
+        // front half used up,  complete the back half and swap
+        bool read = false;
+        while (chk_keystream_fill(ks))
+            read = true;
+
+        if (read)
+            iso14a_restart_timing();
+
+        ks->fill[ks->front] = 0;
+        ks->front ^= 1;
+        ks->pos = 0;
+        if (ks->fill[ks->front] < 6)
+            return false;
+    }
+    *key = ks->buf[ks->front] + ks->pos;
+    ks->pos += 6;
+    ks->keys++;
+    return true;
+}
+
+// Checks sectorcnt sectors, key after key on every sector still missing a key. The keys come from the
+// dictionary fn in SPIFFS, never loaded as a whole, or when fn is NULL from keycnt keys in memory.
+// Keys already marked in res->found are kept and not searched again. With progress set the client
+// gets progress frames.
+// Returns PM3_SUCCESS, PM3_EFILE, PM3_EMALLOC, PM3_ECARDEXCHANGE or PM3_EOPABORTED
+int MifareChkKeys_dict(const char *fn, uint8_t *keys, uint16_t keycnt, uint8_t sectorcnt, mf_chkkeys_spiffs_resp_t *res, bool progress) {
+
+    sectorcnt = MIN(sectorcnt, 40);
+    uint8_t allkeys = sectorcnt << 1;
+    sector_t *k_sector = (sector_t *)res->keys;
+    uint8_t found[80] = {0};
+    uint8_t foundkeys = 0;
+    int status = PM3_SUCCESS;
+
+    for (uint8_t m = 0; m < allkeys; m++) {
+        if (res->found[m >> 3] & (1 << (m & 7))) {
+            found[m] = 1;
+            ++foundkeys;
+        }
+    }
+
+    chk_keystream_t ks;
+    memset(&ks, 0, sizeof(ks));
+    ks.fd = -1;
 
-    uint16_t key_mem_available;
-    if (reserved_mem)
-        key_mem_available = key_count * 6;
-    else
-        key_mem_available = MIN((PM3_CMD_DATA_SIZE - 5), key_count * 6);
+#ifdef WITH_FLASH
+    int changed = 0;
+    uint8_t *readahead = NULL;
+#endif
 
-    key_count = key_mem_available / 6;
+    if (fn == NULL) {
+        ks.buf[0] = keys;
+        ks.fill[0] = MIN(keycnt, CHKKEYS_MEM_MAX_KEYS) * 6;
+        ks.eof = true;
+    } else {
+#ifdef WITH_FLASH
+        ks.buf[0] = BigBuf_malloc_arena(2 * CHKKEYS_STREAM_HALF, BIGBUF_ARENA_SCRATCH);
+        if (ks.buf[0] == NULL)
+            return PM3_EMALLOC;
+        ks.buf[1] = ks.buf[0] + CHKKEYS_STREAM_HALF;
+
+        changed = rdv40_spiffs_lazy_mount();
+        ks.fd = rdv40_spiffs_open_read((char *)fn);
+        if (ks.fd < 0) {
+            rdv40_spiffs_lazy_mount_rollback(changed);
+            BigBuf_release(ks.buf[0]);
+            return PM3_EFILE;
+        }
+        readahead = BigBuf_malloc_arena(RDV40_SPIFFS_READAHEAD_SZ, BIGBUF_ARENA_SCRATCH);
+        if (readahead)
+            rdv40_spiffs_readahead(readahead, RDV40_SPIFFS_READAHEAD_SZ);
+
+        // first front half before the field is up
+        while (chk_keystream_fill(&ks)) {};
+#else
+        return PM3_ENOTIMPL;
+#endif
+    }
 
-    datain += 5;
+    struct Crypto1State mpcs = {0, 0};
+    struct Crypto1State *pcs = &mpcs;
+    uint8_t uid[10] = {0x00};
+    uint32_t cuid = 0;
+    uint8_t cascade_levels = 0;
+    bool have_uid = false;
 
     LEDsoff();
     LED_A_ON();
 
     iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
-
-    if (clearTrace)
-        clear_trace();
+    clear_trace();
+    set_tracing(false);
 
     int oldbg = DBGLEVEL;
+
+    if (chkkeys_select(uid, &cuid, &cascade_levels, &have_uid) == false) {
+        status = PM3_ECARDEXCHANGE;
+        goto out;
+    }
+    CHK_TIMEOUT();
+
+    // clear debug level. We are expecting lots of authentication failures...
     DBGLEVEL = DBG_NONE;
 
-    set_tracing(false);
+    struct chk_t chk_data;
+    chkKey_init(&chk_data, uid, cuid, cascade_levels, pcs, 0);
 
-    for (i = 0; i < key_count; i++) {
+    uint32_t lastprogress = GetTickCount();
+    uint8_t *key;
 
-        // Iceman: use piwi's faster nonce collecting part in hardnested.
-        if (!have_uid) { // need a full select cycle to get the uid first
-            iso14a_card_select_t card_info;
-            if (!iso14443a_select_card(uid, &card_info, &cuid, true, 0, true)) {
-                if (DBGLEVEL >= DBG_ERROR) Dbprintf("ChkKeys: Can't select card (ALL)");
-                --i; // try same key once again
-                continue;
-            }
-            switch (card_info.uidlen) {
-                case 4 :
-                    cascade_levels = 1;
-                    break;
-                case 7 :
-                    cascade_levels = 2;
-                    break;
-                case 10:
-                    cascade_levels = 3;
-                    break;
-                default:
-                    break;
-            }
-            have_uid = true;
-        } else { // no need for anticollision. We can directly select the card
-            if (!iso14443a_select_card(uid, NULL, NULL, false, cascade_levels, true)) {
-                if (DBGLEVEL >= DBG_ERROR) Dbprintf("ChkKeys: Can't select card (UID)");
-                --i; // try same key once again
-                continue;
-            }
+    while (foundkeys < allkeys && chk_keystream_next(&ks, &key)) {
+
+        // Allow button press / usb cmd to interrupt device
+        if (BUTTON_PRESS() || data_available()) {
+            status = PM3_EOPABORTED;
+            break;
         }
 
-        key = bytes_to_num(datain + i * 6, 6);
-        res = mifare_classic_auth(pcs, cuid, blockNo, keyType, key, AUTH_FIRST);
+        WDT_HIT();
 
-//        CHK_TIMEOUT();
+        // progress frame if some time passed
+        if (progress && GetTickCountDelta(lastprogress) > 500) {
+            res->final = false;
+            res->foundkeys = foundkeys;
+            res->checked = ks.keys - 1;
+            reply_ng(CMD_HF_MIFARE_CHKKEYS_SPIFFS, PM3_SUCCESS, (uint8_t *)res, offsetof(mf_chkkeys_spiffs_resp_t, found));
+            lastprogress = GetTickCount();
+        }
 
-        if (res)
-            continue;
+        chk_data.key = bytes_to_num(key, 6);
 
-        memcpy(keyresult.key, datain + i * 6, 6);
-        keyresult.found = true;
-        break;
-    }
+        for (uint8_t s = 0; s < sectorcnt && foundkeys < allkeys; ++s) {
 
-    LED_B_ON();
+            if (found[(s * 2)] && found[(s * 2) + 1]) continue;
 
-    reply_ng(CMD_HF_MIFARE_CHKKEYS, PM3_SUCCESS, (uint8_t *)&keyresult, sizeof(keyresult));
-    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
-    LEDsoff();
+            // assume: block0,1,2 has more read rights in accessbits than the sectortrailer. authenticating against block0 in each sector
+            chk_data.block = FirstBlockOfSector(s);
 
-    set_tracing(false);
-    crypto1_deinit(pcs);
+            // skip already found A keys
+            if (!found[(s * 2)]) {
+                chk_data.keyType = 0;
+                if (chkKey(&chk_data) == 0) {
+                    memcpy(k_sector[s].keyA, key, 6);
+                    found[(s * 2)] = 1;
+                    ++foundkeys;
 
-    DBGLEVEL = oldbg;
-}
+                    chkKey_scanA(&chk_data, k_sector, found, &sectorcnt, &foundkeys);
 
-void MifareChkKeys_file(uint8_t *fn) {
+                    // read Block B, if A is found.
+                    chkKey_loopBonly(&chk_data, k_sector, found, &sectorcnt, &foundkeys);
 
-#ifdef WITH_FLASH
-    BigBuf_free();
+                    chk_data.block = FirstBlockOfSector(s);
+                }
+            }
 
-    SpinOff(0);
+            // skip already found B keys
+            if (!found[(s * 2) + 1]) {
+                chk_data.keyType = 1;
+                if (chkKey(&chk_data) == 0) {
+                    memcpy(k_sector[s].keyB, key, 6);
+                    found[(s * 2) + 1] = 1;
+                    ++foundkeys;
 
-    int changed = rdv40_spiffs_lazy_mount();
-    uint32_t size = size_in_spiffs((char *)fn);
-    uint8_t *mem = BigBuf_malloc(size);
+                    chkKey_scanB(&chk_data, k_sector, found, &sectorcnt, &foundkeys);
+                }
+            }
+        }
 
-    rdv40_spiffs_read_as_filetype((char *)fn, mem, size, RDV40_SPIFFS_SAFETY_SAFE);
+        // refill the back half between authentications
+        if (chk_keystream_fill(&ks))
+            iso14a_restart_timing();
+    }
 
-    if (changed) {
-        rdv40_spiffs_lazy_unmount();
+out:
+    DBGLEVEL = oldbg;
+    mifare_classic_set_auth_timeout(AUTHENTICATION_ANSWER_TIMEOUT);
+    crypto1_deinit(pcs);
+
+#ifdef WITH_FLASH
+    if (ks.fd >= 0) {
+        rdv40_spiffs_readahead(NULL, 0);
+        rdv40_spiffs_close_fd(ks.fd);
+        rdv40_spiffs_lazy_mount_rollback(changed);
+        if (readahead)
+            BigBuf_release(readahead);
+        BigBuf_release(ks.buf[0]);
     }
+#endif
 
-    SpinOff(0);
+    res->foundkeys = foundkeys;
+    res->checked = ks.keys;
+    for (uint8_t m = 0; m < allkeys; m++) {
+        if (found[m])
+            res->found[m >> 3] |= 1 << (m & 7);
+    }
+    return status;
+}
 
-    MifareChkKeys(mem, true);
+// Checks all sectors against a dictionary in SPIFFS, see MifareChkKeys_dict.
+// The file size is only limited by the flash
+void MifareChkKeys_spiffs(mf_chkkeys_spiffs_req_t *req) {
+
+    mf_chkkeys_spiffs_resp_t resp;
+    memset(&resp, 0, sizeof(resp));
 
     BigBuf_free();
-#endif
-}
+    req->filename[sizeof(req->filename) - 1] = 0;
 
+    int status = MifareChkKeys_dict((char *)req->filename, NULL, 0, req->sectorcnt, &resp, true);
+
+    resp.final = true;
+    LED_B_ON();
+    reply_ng(CMD_HF_MIFARE_CHKKEYS_SPIFFS, status, (uint8_t *)&resp, sizeof(resp));
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    LEDsoff();
+    BigBuf_free();
+}
 //-----------------------------------------------------------------------------
 // MIFARE Personalize UID. Only for Mifare Classic EV1 7Byte UID
 //-----------------------------------------------------------------------------
@@ -2236,7 +3240,110 @@ void MifareCGetBlock(uint32_t arg0, uint32_t arg1, uint8_t *datain) {
         OnSuccessMagic();
 }
 
-void MifareCIdent(void) {
+// wupC1 + wupC2, only wupC1 for a gen 1b
+static bool MifareMagicWupC(void) {
+    uint8_t receivedAnswer[MAX_MIFARE_FRAME_SIZE] = {0x00};
+    uint8_t receivedAnswerPar[MAX_MIFARE_PARITY_SIZE] = {0x00};
+
+    for (int i = 0; i < 2; i++) {
+        ReaderTransmitBitsPar(wupC1, 7, NULL, NULL);
+        if (!ReaderReceive(receivedAnswer, receivedAnswerPar) || (receivedAnswer[0] != 0x0a)) {
+            if (DBGLEVEL >= DBG_ERROR) Dbprintf("wupC1 error");
+            return false;
+        }
+
+        ReaderTransmit(wupC2, sizeof(wupC2), NULL);
+        if (ReaderReceive(receivedAnswer, receivedAnswerPar) && (receivedAnswer[0] == 0x0a))
+            return true;
+
+        // the failed wupC2 put it back to idle, wupC1 is enough
+        if (DBGLEVEL >= DBG_INFO) Dbprintf("Assuming Magic Gen 1B tag. [wupC2 failed]");
+    }
+    return true;
+}
+
+static bool MifareMagicWrite(uint8_t blockNo, uint8_t *block, bool verify) {
+    uint8_t data[18] = {0x00};
+    uint8_t receivedAnswer[MAX_MIFARE_FRAME_SIZE] = {0x00};
+    uint8_t receivedAnswerPar[MAX_MIFARE_PARITY_SIZE] = {0x00};
+
+    if ((mifare_sendcmd_short(NULL, CRYPT_NONE, ISO14443A_CMD_WRITEBLOCK, blockNo, receivedAnswer, receivedAnswerPar, NULL) != 1) || (receivedAnswer[0] != 0x0a)) {
+        if (DBGLEVEL >= DBG_ERROR) Dbprintf("write block %u send command error", blockNo);
+        return false;
+    }
+
+    memcpy(data, block, 16);
+    AddCrc14A(data, 16);
+
+    ReaderTransmit(data, sizeof(data), NULL);
+    if ((ReaderReceive(receivedAnswer, receivedAnswerPar) != 1) || (receivedAnswer[0] != 0x0a)) {
+        if (DBGLEVEL >= DBG_ERROR) Dbprintf("write block %u send data error", blockNo);
+        return false;
+    }
+
+    if (verify == false)
+        return true;
+
+    if (mifare_sendcmd_short(NULL, CRYPT_NONE, ISO14443A_CMD_READBLOCK, blockNo, receivedAnswer, receivedAnswerPar, NULL) != 18) {
+        if (DBGLEVEL >= DBG_ERROR) Dbprintf("read block %u send command error", blockNo);
+        return false;
+    }
+    if (memcmp(receivedAnswer, block, 16) != 0) {
+        if (DBGLEVEL >= DBG_ERROR) Dbprintf("block %u read back differs", blockNo);
+        return false;
+    }
+    return true;
+}
+
+// The whole emulator memory to the card after a single wupC, instead of a
+// client round trip per block. A failed block gets a new wupC and two more tries
+void MifareCLoad(mifare_cload_req_t *req) {
+    int retval = PM3_SUCCESS;
+    uint16_t blocks = 0;
+    uint8_t *mem = BigBuf_get_EM_addr();
+
+    LED_A_ON();
+    LED_B_OFF();
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+    clear_trace();
+    set_tracing(true);
+
+    if (req->blocks > MIFARE_4K_MAXBLOCK) {
+        retval = PM3_EINVARG;
+        goto OUT;
+    }
+
+    if (MifareMagicWupC() == false) {
+        retval = PM3_ESOFT;
+        goto OUT;
+    }
+
+    for (; blocks < req->blocks; blocks++) {
+        WDT_HIT();
+        if (BUTTON_PRESS() || data_available()) {
+            retval = PM3_EOPABORTED;
+            break;
+        }
+
+        bool ok = MifareMagicWrite(blocks, mem + blocks * 16, req->verify);
+        for (int retry = 0; retry < 2 && ok == false; retry++) {
+            mifare_classic_halt_ex(NULL);
+            ok = MifareMagicWupC() && MifareMagicWrite(blocks, mem + blocks * 16, req->verify);
+        }
+        if (ok == false) {
+            retval = PM3_ESOFT;
+            break;
+        }
+    }
+    mifare_classic_halt_ex(NULL);
+
+OUT:
+    reply_ng(CMD_HF_MIFARE_CLOAD, retval, (uint8_t *)&blocks, sizeof(blocks));
+    OnSuccessMagic();
+}
+
+// MAGIC_* of the card in the field, 0 for none. The field is left on
+static uint8_t mifare_cident(void) {
     // variables
     uint8_t isGen = 0;
     uint8_t rec[1] = {0x00};
@@ -2248,7 +3355,6 @@ void MifareCIdent(void) {
     uint8_t *buf = BigBuf_malloc(PM3_CMD_DATA_SIZE);
     uint8_t *uid = BigBuf_malloc(10);
     uint32_t cuid = 0;
-    uint8_t data[1] = {0x00};
 
     iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
 
@@ -2351,15 +3457,19 @@ void MifareCIdent(void) {
     };
 
 OUT:
+    return isGen;
+}
 
-    data[0] = isGen;
+void MifareCIdent(void) {
+    uint8_t data[1] = { mifare_cident() };
     reply_ng(CMD_HF_MIFARE_CIDENT, PM3_SUCCESS, data, sizeof(data));
     // turns off
     OnSuccessMagic();
     BigBuf_free();
 }
 
-void MifareHasStaticNonce(void) {
+// NONCE_* from three authentications to block 0, with a field reset after each. nt is the last tag nonce
+static int mifare_static_nonce(uint8_t *nonce, uint32_t *last_nt) {
 
     // variables
     int retval = PM3_SUCCESS;
@@ -2411,11 +3521,63 @@ void MifareHasStaticNonce(void) {
     }
 
 OUT:
+    crypto1_deinit(pcs);
+    *nonce = data[0];
+    *last_nt = nt;
+    return retval;
+}
+
+void MifareHasStaticNonce(void) {
+    uint8_t data[1] = { NONCE_FAIL };
+    uint32_t nt = 0;
+    int retval = mifare_static_nonce(data, &nt);
     reply_ng(CMD_HF_MIFARE_STATIC_NONCE, retval, data, sizeof(data));
     // turns off
     OnSuccessMagic();
     BigBuf_free();
-    crypto1_deinit(pcs);
+}
+
+// The detections hf 14a info and hf mf autopwn start with, in one call. The prng is told from the
+// last nonce of the static nonce test, the nack bug test is the slow one, up to 256 more authentications
+void MifareFingerprint(mf_fingerprint_req_t *req) {
+    mf_fingerprint_resp_t resp;
+    memset(&resp, 0, sizeof(resp));
+    resp.nonce = NONCE_FAIL;
+    resp.nack = MF_FINGERPRINT_NOT_TESTED;
+
+    if (req->flags & MF_FINGERPRINT_MAGIC) {
+        resp.magic = mifare_cident();
+        BigBuf_free();
+        // the card is left selected or halted, start over from a reset
+        FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+        SpinDelay(40);
+    }
+
+    uint32_t nt = 0;
+    int retval = mifare_static_nonce(&resp.nonce, &nt);
+    resp.nt = nt;
+    BigBuf_free();
+
+    // no card or no crypto1 is no failure of the command, the magic test has its answer anyway
+    if (retval == PM3_ESOFT)
+        retval = PM3_SUCCESS;
+
+    if (resp.nonce == NONCE_NORMAL) {
+        resp.prng = validate_prng_nonce(nt);
+
+        if (req->flags & MF_FINGERPRINT_NACK) {
+            uint8_t nack[4] = {0};
+            retval = DetectNACKbugEx(nack);
+            resp.nack = nack[0];
+            resp.nacks = nack[1];
+            resp.auths = bytes_to_num(nack + 2, 2);
+        }
+    }
+
+    reply_ng(CMD_HF_MIFARE_FINGERPRINT, retval, (uint8_t *)&resp, sizeof(resp));
+    // turns off
+    OnSuccessMagic();
+    BigBuf_free();
 }
 
 void OnSuccessMagic(void) {
@@ -2737,3 +3899,143 @@ void MifareU_Otp_Tearoff(uint8_t arg0, uint32_t arg1, uint8_t *datain) {
 
     if (DBGLEVEL >= DBG_ERROR) DbpString("Done");
 }
+
+// selects the tag and reads the 4 bytes of block
+static bool mfu_tearoff_read(uint8_t block, uint8_t *out) {
+    uint8_t data[16] = {0};
+    if (iso14443a_select_card(NULL, NULL, NULL, true, 0, true) == 0)
+        return false;
+    if (mifare_ultra_readblock(block, data))
+        return false;
+    memcpy(out, data, 4);
+    return true;
+}
+
+// One tear-off attempt of the WRITE in cmd, e->delay and e->block set. The tag is left halted or powered off
+static void mfu_tearoff_attempt(mfu_tearoff_sweep_req_t *req, uint8_t *cmd, uint8_t cmdlen, mfu_tearoff_entry_t *e) {
+    // ns to MCK cycles
+    uint32_t clk = (e->delay / 1000) * 48 + ((e->delay % 1000) * 48) / 1000;
+
+    uint8_t data[16] = {0};
+
+    e->status = MFU_TEAROFF_NO_TAG;
+
+    if (iso14443a_select_card(NULL, NULL, NULL, true, 0, true) == 0)
+        goto out;
+    if ((req->flags & MFU_TEAROFF_NO_RESTORE) == 0 && mifare_ultra_writeblock(e->block, req->data))
+        goto out;
+    if (mifare_ultra_readblock(e->block, data))
+        goto out;
+    memcpy(e->before, data, 4);
+
+    ReaderTransmit(cmd, cmdlen, NULL);
+    SpinDelayMck(clk);
+    iso14a_field_cycle(ISO14A_TEAROFF_OFF_MS);
+
+    if (mfu_tearoff_read(e->block, e->after) == false)
+        goto out;
+
+    uint8_t otp[4];
+    for (uint8_t i = 0; i < 4; i++)
+        otp[i] = e->before[i] | req->tear[i];
+
+    if (memcmp(e->after, e->before, 4) == 0)
+        e->status = MFU_TEAROFF_UNCHANGED;
+    else if (memcmp(e->after, req->tear, 4) == 0 || (e->block == 3 && memcmp(e->after, otp, 4) == 0))
+        e->status = MFU_TEAROFF_WRITTEN;
+    else
+        e->status = MFU_TEAROFF_PARTIAL;
+
+    // HALTed, the next select wakes it up
+    mifare_ultra_halt();
+    return;
+
+out:
+    iso14a_field_cycle(ISO14A_TEAROFF_OFF_MS);
+}
+
+static void mfu_tearoff_send(mfu_tearoff_frame_t *frame, const mfu_tearoff_entry_t *log, uint16_t *sent, uint16_t logged, bool final, int status) {
+    do {
+        frame->first = *sent;
+        frame->count = MIN(logged - *sent, MFU_TEAROFF_FRAME_ENTRIES);
+        memcpy(frame->entries, log + *sent, frame->count * sizeof(mfu_tearoff_entry_t));
+        *sent += frame->count;
+        frame->final = final && (*sent == logged);
+        reply_ng(CMD_HF_MFU_OTP_TEAROFF_SWEEP, frame->final ? status : PM3_SUCCESS, (uint8_t *)frame,
+                 sizeof(mfu_tearoff_frame_t) - sizeof(frame->entries) + frame->count * sizeof(mfu_tearoff_entry_t));
+    } while (*sent < logged && (final || logged - *sent >= MFU_TEAROFF_FRAME_ENTRIES));
+}
+
+// Tear-off sweep over blocks and delays in one session, see mfu_tearoff_sweep_req_t.
+// Full frames of the log go out while it runs, the rest and the status at the end
+void MifareU_Otp_TearoffSweep(uint8_t *datain) {
+    mfu_tearoff_sweep_req_t *req = (mfu_tearoff_sweep_req_t *)datain;
+    int status = PM3_SUCCESS;
+    uint16_t logged = 0;
+    uint16_t sent = 0;
+
+    LEDsoff();
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+
+    // the log takes the room of the trace
+    clear_trace();
+    set_tracing(false);
+    BigBuf_free();
+
+    mfu_tearoff_entry_t *log = (mfu_tearoff_entry_t *)BigBuf_malloc(MFU_TEAROFF_LOG_ENTRIES * sizeof(mfu_tearoff_entry_t));
+    mfu_tearoff_frame_t *frame = (mfu_tearoff_frame_t *)BigBuf_malloc(sizeof(mfu_tearoff_frame_t));
+    if (log == NULL || frame == NULL) {
+        FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+        LEDsoff();
+        reply_ng(CMD_HF_MFU_OTP_TEAROFF_SWEEP, PM3_EMALLOC, NULL, 0);
+        return;
+    }
+
+    uint32_t step = MAX(req->step, 1);
+    uint8_t repeat = MAX(req->repeat, 1);
+
+    for (uint8_t b = 0; b < MAX(req->blocks, 1); b++) {
+
+        // WRITE, block, tear, CRC
+        uint8_t cmd[8] = {MIFARE_ULC_WRITE, req->block + b};
+        memcpy(cmd + 2, req->tear, 4);
+        AddCrc14A(cmd, 6);
+
+        for (uint32_t delay = req->start; delay <= req->end; delay += step) {
+            for (uint8_t r = 0; r < repeat; r++) {
+                WDT_HIT();
+
+                if (BUTTON_PRESS() || data_available()) {
+                    status = PM3_EOPABORTED;
+                    goto out;
+                }
+                if (logged == MFU_TEAROFF_LOG_ENTRIES) {
+                    status = PM3_EOVFLOW;
+                    goto out;
+                }
+
+                mfu_tearoff_entry_t *e = &log[logged++];
+                memset(e, 0, sizeof(mfu_tearoff_entry_t));
+                e->delay = delay;
+                e->block = req->block + b;
+                mfu_tearoff_attempt(req, cmd, sizeof(cmd), e);
+
+                if (logged - sent >= MFU_TEAROFF_FRAME_ENTRIES)
+                    mfu_tearoff_send(frame, log, &sent, logged, false, PM3_SUCCESS);
+
+                if (e->status == MFU_TEAROFF_PARTIAL && (req->flags & MFU_TEAROFF_STOP_PARTIAL))
+                    goto out;
+            }
+
+            // end close to UINT32_MAX
+            if (req->end - delay < step)
+                break;
+        }
+    }
+
+out:
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    LEDsoff();
+    mfu_tearoff_send(frame, log, &sent, logged, true, status);
+    BigBuf_free();
+}
@@ -12,14 +12,19 @@
 #define __MIFARECMD_H
 
 #include "common.h"
+#include "pm3_cmd.h"
 
 void MifareReadBlock(uint8_t blockNo, uint8_t keyType, uint8_t *datain);
 
 void MifareUReadBlock(uint8_t arg0, uint8_t arg1, uint8_t *datain);
 void MifareUC_Auth(uint8_t arg0, uint8_t *keybytes);
+void MifareUChkPwd(uint8_t *datain);
 void MifareUReadCard(uint8_t arg0, uint16_t arg1, uint8_t arg2, uint8_t *datain);
+void MifareUDump(uint8_t *datain);
 void MifareReadSector(uint8_t arg0, uint8_t arg1, uint8_t *datain);
 void MifareWriteBlock(uint8_t arg0, uint8_t arg1, uint8_t *datain);
+void MifareReadSectorBulk(mf_readsc_bulk_req_t *req);
+void MifareWriteSectorBulk(mf_writesc_bulk_req_t *req, uint16_t len);
 void MifareUWriteBlockCompat(uint8_t arg0, uint8_t arg1, uint8_t *datain);
 
 void MifareUWriteBlock(uint8_t arg0, uint8_t arg1, uint8_t *datain);
@@ -28,10 +33,15 @@ void MifareNested(uint8_t blockNo, uint8_t keyType, uint8_t targetBlockNo, uint8
 void MifareStaticNested(uint8_t blockNo, uint8_t keyType, uint8_t targetBlockNo, uint8_t targetKeyType, uint8_t *key);
 
 void MifareAcquireEncryptedNonces(uint32_t arg0, uint32_t arg1, uint32_t flags, uint8_t *datain);
+void MifareAcquireNoncesStream(uint8_t *datain);
 void MifareAcquireNonces(uint32_t arg0, uint32_t flags);
 void MifareChkKeys(uint8_t *datain, uint8_t reserved_mem);
 void MifareChkKeys_fast(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *datain);
 void MifareChkKeys_file(uint8_t *fn);
+void MifareChkKeys_load(mf_chkkeys_load_t *payload, uint16_t len);
+void MifareChkKeys_batch(mf_chkkeys_batch_req_t *req);
+void MifareChkKeys_spiffs(mf_chkkeys_spiffs_req_t *req);
+int MifareChkKeys_dict(const char *fn, uint8_t *keys, uint16_t keycnt, uint8_t sectorcnt, mf_chkkeys_spiffs_resp_t *res, bool progress);
 
 void MifareEMemClr(void);
 void MifareEMemSet(uint8_t blockno, uint8_t blockcnt, uint8_t blockwidth, uint8_t *datain);
@@ -42,7 +52,9 @@ int MifareECardLoadExt(uint8_t sectorcnt, uint8_t keytype);
 void MifareCSetBlock(uint32_t arg0, uint32_t arg1, uint8_t *datain);  // Work with "magic Chinese" card
 void MifareCGetBlock(uint32_t arg0, uint32_t arg1, uint8_t *datain);
 void MifareCIdent(void);  // is "magic chinese" card?
+void MifareCLoad(mifare_cload_req_t *req);  // magic card written from emulator memory
 void MifareHasStaticNonce(void);  // Has the tag a static nonce?
+void MifareFingerprint(mf_fingerprint_req_t *req);  // magic, static nonce, prng and nack bug in one call
 
 int DoGen3Cmd(uint8_t *cmd, uint8_t cmd_len);
 void MifareGen3UID(uint8_t uidlen, uint8_t *uid); // Gen 3 magic card set UID without manufacturer block
@@ -64,5 +76,6 @@ void Mifare_DES_Auth2(uint32_t arg0, uint8_t *datain);
 
 // Tear-off test for MFU
 void MifareU_Otp_Tearoff(uint8_t arg0, uint32_t arg1, uint8_t *datain);
+void MifareU_Otp_TearoffSweep(uint8_t *datain);
 
 #endif
@@ -609,6 +609,382 @@ void MifareDES_Auth1(uint8_t *datain) {
     LED_B_OFF();
 }
 
+// one card answer to apdu, ISO14443-4 chaining of the answer included. out gets the data and SW
+static int desfire_chain_exchange(uint8_t *apdu, uint16_t apdu_len, uint8_t *out, uint16_t out_size, uint16_t *out_len) {
+    uint8_t buf[MAX_FRAME_SIZE];
+    uint8_t pcb = 0;
+
+    *out_len = 0;
+    int len = iso14_apdu(apdu, apdu_len, false, buf, &pcb);
+    for (;;) {
+        // PCB is cut, the CRC is still there
+        if (len < 2)
+            return PM3_ECARDEXCHANGE;
+        len -= 2;
+
+        if (*out_len + len > out_size)
+            return PM3_EOVFLOW;
+        memcpy(out + *out_len, buf, len);
+        *out_len += len;
+
+        if ((pcb & 0x10) == 0)
+            break;
+
+        // R(ACK) for the next block of the answer
+        len = iso14_apdu(NULL, 0, false, buf, &pcb);
+    }
+    return (*out_len) ? PM3_SUCCESS : PM3_ECARDEXCHANGE;
+}
+
+// Sends one ISO wrapped DESFire command to the selected card and, with DESFIRE_CHAIN_ALL, all 0xAF
+// additional frames right after each other. Uses iso14_apdu, so the block number stays in step
+// with CMD_HF_ISO14443A_READER apdus of the client
+void MifareDesfireChained(uint8_t *datain) {
+    desfire_chain_req_t *req = (desfire_chain_req_t *)datain;
+
+    desfire_chain_resp_t resp;
+    resp.sw = 0;
+    resp.final = false;
+    resp.frames = 0;
+    resp.len = 0;
+
+    uint8_t apdu[DESFIRE_CHAIN_MAX_APDU];
+    uint16_t apdu_len = MIN(req->len, sizeof(apdu));
+    memcpy(apdu, req->apdu, apdu_len);
+
+    int status = PM3_SUCCESS;
+
+    set_tracing(true);
+
+    LED_A_ON();
+    uint8_t answer[0xFF + 2];
+    for (;;) {
+        WDT_HIT();
+
+        uint16_t alen = 0;
+        status = desfire_chain_exchange(apdu, apdu_len, answer, sizeof(answer), &alen);
+        if (status == PM3_SUCCESS && alen < 2)
+            status = PM3_ECARDEXCHANGE;
+        if (status != PM3_SUCCESS)
+            break;
+
+        alen -= 2;
+        resp.sw = (answer[alen] << 8) | answer[alen + 1];
+
+        // whole answers only, the full frame goes out first
+        if (resp.len + 1 + alen > sizeof(resp.data)) {
+            reply_ng(CMD_HF_DESFIRE_CHAINED, PM3_SUCCESS, (uint8_t *)&resp, sizeof(resp) - sizeof(resp.data) + resp.len);
+            resp.frames = 0;
+            resp.len = 0;
+        }
+        resp.data[resp.len++] = alen;
+        memcpy(resp.data + resp.len, answer, alen);
+        resp.len += alen;
+        resp.frames++;
+
+        if (resp.sw != 0x91AF || (req->flags & DESFIRE_CHAIN_ALL) == 0)
+            break;
+
+        if (BUTTON_PRESS()) {
+            status = PM3_EOPABORTED;
+            break;
+        }
+
+        // ADDITIONAL FRAME
+        apdu[0] = 0x90;
+        apdu[1] = MFDES_ADDITIONAL_FRAME;
+        apdu[2] = 0x00;
+        apdu[3] = 0x00;
+        apdu[4] = 0x00;
+        apdu_len = 5;
+    }
+    LED_A_OFF();
+
+    FpgaDisableTracing();
+    resp.final = true;
+    reply_ng(CMD_HF_DESFIRE_CHAINED, status, (uint8_t *)&resp, sizeof(resp) - sizeof(resp.data) + resp.len);
+}
+
+static void desfire_chk_rnd(uint8_t *rnd, uint8_t len) {
+    for (uint8_t i = 0; i < len; i += 4) {
+        num_to_bytes(prng_successor(GetTickCount(), 32), 4, rnd + i);
+    }
+}
+
+// first authentication step with one DESFire key, the same crypto as the client side auth. The
+// session key isn't needed, the card answering 9100 on RndA + RndB' is the hit
+static int desfire_chk_key(uint8_t mode, uint8_t algo, uint8_t keyno, uint8_t *keybytes, uint16_t *sw) {
+    mbedtls_aes_context ctx;
+    struct desfire_key dkey = {0};
+    desfirekey_t key = &dkey;
+
+    if (algo == MFDES_ALGO_AES) {
+        mbedtls_aes_init(&ctx);
+        Desfire_aes_key_new(keybytes, key);
+    } else if (algo == MFDES_ALGO_3DES) {
+        Desfire_3des_key_new_with_version(keybytes, key);
+    } else if (algo == MFDES_ALGO_3K3DES) {
+        Desfire_3k3des_key_new_with_version(keybytes, key);
+    } else {
+        Desfire_des_key_new(keybytes, key);
+    }
+
+    uint8_t subcommand = MFDES_AUTHENTICATE;
+    if (mode == MFDES_AUTH_AES)
+        subcommand = MFDES_AUTHENTICATE_AES;
+    else if (mode == MFDES_AUTH_ISO)
+        subcommand = MFDES_AUTHENTICATE_ISO;
+
+    uint8_t IV[16] = {0x00};
+    uint8_t RndA[16] = {0x00};
+    uint8_t RndB[16] = {0x00};
+    uint8_t encRndA[16] = {0x00};
+    uint8_t encRndB[16] = {0x00};
+    uint8_t rotRndB[16] = {0x00};
+    uint8_t both[32] = {0x00};
+    uint8_t cmd[5 + 32 + 1] = {0x90, subcommand, 0x00, 0x00, 0x01, keyno, 0x00};
+    uint8_t answer[0xFF + 2];
+    uint16_t alen = 0;
+
+    int res = desfire_chain_exchange(cmd, 7, answer, sizeof(answer), &alen);
+    if (res != PM3_SUCCESS || alen < 2)
+        return PM3_ECARDEXCHANGE;
+
+    alen -= 2;
+    *sw = (answer[alen] << 8) | answer[alen + 1];
+
+    uint8_t rndlen = (algo == MFDES_ALGO_AES || algo == MFDES_ALGO_3K3DES) ? 16 : 8;
+    if (*sw != 0x91AF || alen != rndlen)
+        return PM3_EWRONGANSWER;
+
+    memcpy(encRndB, answer, rndlen);
+    desfire_chk_rnd(RndA, rndlen);
+
+    if (algo == MFDES_ALGO_AES) {
+        mbedtls_aes_setkey_dec(&ctx, key->data, 128);
+        mbedtls_aes_crypt_cbc(&ctx, MBEDTLS_AES_DECRYPT, rndlen, IV, encRndB, RndB);
+    } else if (algo == MFDES_ALGO_DES) {
+        des_decrypt(RndB, encRndB, key->data);
+    } else if (algo == MFDES_ALGO_3DES) {
+        tdes_nxp_receive(encRndB, RndB, rndlen, key->data, IV, 2);
+    } else if (algo == MFDES_ALGO_3K3DES) {
+        tdes_nxp_receive(encRndB, RndB, rndlen, key->data, IV, 3);
+    }
+
+    memcpy(rotRndB, RndB, rndlen);
+    rol(rotRndB, rndlen);
+
+    uint8_t tmp[32] = {0x00};
+    memcpy(tmp, RndA, rndlen);
+    memcpy(tmp + rndlen, rotRndB, rndlen);
+
+    if (mode == MFDES_AUTH_DES) {
+        des_decrypt(encRndA, RndA, key->data);
+        memcpy(both, encRndA, rndlen);
+        for (uint8_t x = 0; x < rndlen; x++) {
+            rotRndB[x] ^= encRndA[x];
+        }
+        des_decrypt(both + rndlen, rotRndB, key->data);
+    } else if (mode == MFDES_AUTH_ISO) {
+        tdes_nxp_send(tmp, both, rndlen * 2, key->data, IV, (algo == MFDES_ALGO_3K3DES) ? 3 : 2);
+    } else if (mode == MFDES_AUTH_AES) {
+        mbedtls_aes_setkey_enc(&ctx, key->data, 128);
+        mbedtls_aes_crypt_cbc(&ctx, MBEDTLS_AES_ENCRYPT, 32, IV, tmp, both);
+    }
+
+    uint8_t bothlen = rndlen * 2;
+    cmd[1] = MFDES_ADDITIONAL_FRAME;
+    cmd[4] = bothlen;
+    memcpy(cmd + 5, both, bothlen);
+    cmd[5 + bothlen] = 0x00;
+
+    res = desfire_chain_exchange(cmd, 5 + bothlen + 1, answer, sizeof(answer), &alen);
+    if (res != PM3_SUCCESS || alen < 2)
+        return PM3_ECARDEXCHANGE;
+
+    *sw = (answer[alen - 2] << 8) | answer[alen - 1];
+    return (*sw == 0x9100) ? PM3_SUCCESS : PM3_ESOFT;
+}
+
+// MIFARE Plus SL3 first authentication with one AES key, answer code 0x90 on the second step is the hit
+static int mfp_chk_key(uint16_t keyno, uint8_t *keybytes) {
+    mbedtls_aes_context ctx;
+    mbedtls_aes_init(&ctx);
+
+    uint8_t IV[16] = {0x00};
+    uint8_t RndB[16] = {0x00};
+    uint8_t raw[32] = {0x00};
+    uint8_t cmd[1 + 32] = {0x70, keyno & 0xFF, keyno >> 8, 0x00};
+    uint8_t answer[0xFF + 2];
+    uint16_t alen = 0;
+
+    int res = desfire_chain_exchange(cmd, 4, answer, sizeof(answer), &alen);
+    if (res != PM3_SUCCESS)
+        return PM3_ECARDEXCHANGE;
+    if (answer[0] != 0x90 || alen != 17)
+        return PM3_EWRONGANSWER;
+
+    mbedtls_aes_setkey_dec(&ctx, keybytes, 128);
+    mbedtls_aes_crypt_cbc(&ctx, MBEDTLS_AES_DECRYPT, 16, IV, answer + 1, RndB);
+
+    // RndA + RndB'
+    desfire_chk_rnd(raw, 16);
+    memcpy(raw + 16, RndB + 1, 15);
+    raw[31] = RndB[0];
+
+    memset(IV, 0, sizeof(IV));
+    mbedtls_aes_setkey_enc(&ctx, keybytes, 128);
+    mbedtls_aes_crypt_cbc(&ctx, MBEDTLS_AES_ENCRYPT, 32, IV, raw, cmd + 1);
+    cmd[0] = 0x72;
+
+    res = desfire_chain_exchange(cmd, sizeof(cmd), answer, sizeof(answer), &alen);
+    if (res != PM3_SUCCESS)
+        return PM3_ECARDEXCHANGE;
+
+    return (answer[0] == 0x90) ? PM3_SUCCESS : PM3_ESOFT;
+}
+
+// Tries a batch of dictionary keys on one key slot, see desfire_chk_req_t. Stops at the first key that
+// authenticates, on a card that stops answering or refuses the key slot
+void MifareDesfireCheckKeys(uint8_t *datain) {
+    desfire_chk_req_t *req = (desfire_chk_req_t *)datain;
+
+    desfire_chk_resp_t resp = {0};
+    int status = PM3_SUCCESS;
+
+    LED_A_ON();
+    if (req->flags & DESFIRE_CHK_SELECT) {
+        iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+        iso14a_card_select_t card;
+        if (iso14443a_select_card(NULL, &card, NULL, true, 0, false) != 1) {
+            status = PM3_ECARDEXCHANGE;
+            goto out;
+        }
+    }
+
+    set_tracing(true);
+
+    uint8_t count = MIN(req->count, DESFIRE_CHK_KEYS_DATA / MAX(req->keylen, 1));
+    for (uint8_t i = 0; i < count; i++) {
+        WDT_HIT();
+
+        if (BUTTON_PRESS() || data_available()) {
+            status = PM3_EOPABORTED;
+            break;
+        }
+
+        uint8_t keybytes[24] = {0};
+        memcpy(keybytes, req->keys + i * req->keylen, MIN(req->keylen, sizeof(keybytes)));
+
+        int res;
+        uint16_t sw = 0;
+        if (req->mode == DESFIRE_CHK_MFP)
+            res = mfp_chk_key(req->keyno, keybytes);
+        else
+            res = desfire_chk_key(req->mode, req->algo, req->keyno, keybytes, &sw);
+        resp.sw = sw;
+
+        resp.tried++;
+        if (res == PM3_SUCCESS) {
+            resp.found = true;
+            resp.index = i;
+            break;
+        }
+        if (res != PM3_ESOFT) {
+            status = res;
+            break;
+        }
+    }
+
+    FpgaDisableTracing();
+out:
+    LED_A_OFF();
+    reply_ng(CMD_HF_DESFIRE_CHKKEYS, status, (uint8_t *)&resp, sizeof(resp));
+}
+
+static bool mfp_chk_select(void) {
+    iso14a_card_select_t card;
+    return (iso14443a_select_card(NULL, &card, NULL, true, 0, false) == 1);
+}
+
+// Tries the keys on every key address of mfp_chk_req_t that has none yet. After a hit the card is authenticated,
+// the field goes off for a fresh select. A card that stops answering is selected again once
+void MifarePlusCheckKeys(uint8_t *datain) {
+    mfp_chk_req_t *req = (mfp_chk_req_t *)datain;
+
+    mfp_chk_resp_t resp;
+    memset(&resp, 0, sizeof(resp));
+    int status = PM3_SUCCESS;
+
+    uint8_t slots = MIN(req->slots, MFP_CHK_MAX_SLOTS);
+    uint8_t count = MIN(req->count, MFP_CHK_KEYS_DATA / 16);
+
+    LED_A_ON();
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+    set_tracing(true);
+
+    if (mfp_chk_select() == false) {
+        status = PM3_ECARDEXCHANGE;
+        goto out;
+    }
+
+    for (uint8_t slot = 0; slot < slots && status == PM3_SUCCESS; slot++) {
+        if (req->done[slot / 8] & (1 << (slot % 8)))
+            continue;
+
+        uint16_t keyno = req->keyno + slot * req->stride;
+        bool reselected = false;
+        for (uint8_t i = 0; i < count; i++) {
+            WDT_HIT();
+
+            if (BUTTON_PRESS() || data_available()) {
+                status = PM3_EOPABORTED;
+                break;
+            }
+
+            uint8_t keybytes[16];
+            memcpy(keybytes, req->keys + i * 16, sizeof(keybytes));
+
+            int res = mfp_chk_key(keyno, keybytes);
+            resp.tried++;
+
+            if (res == PM3_SUCCESS) {
+                resp.found[slot / 8] |= 1 << (slot % 8);
+                resp.index[slot] = i;
+
+                hf_field_off();
+                SpinDelay(50);
+                iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+                if (mfp_chk_select() == false)
+                    status = PM3_ECARDEXCHANGE;
+                break;
+            }
+
+            if (res == PM3_EWRONGANSWER) {
+                resp.refused[slot / 8] |= 1 << (slot % 8);
+                break;
+            }
+
+            if (res == PM3_ECARDEXCHANGE) {
+                // once per key address, then the card is gone
+                if (reselected || mfp_chk_select() == false) {
+                    status = PM3_ECARDEXCHANGE;
+                    break;
+                }
+                reselected = true;
+                i--;
+                resp.tried--;
+            }
+        }
+    }
+
+out:
+    FpgaDisableTracing();
+    hf_field_off();
+    LED_A_OFF();
+    reply_ng(CMD_HF_MFP_CHKKEYS, status, (uint8_t *)&resp, sizeof(resp));
+}
+
 // 3 different ISO ways to send data to a DESFIRE (direct, capsuled, capsuled ISO)
 // cmd  =  cmd bytes to send
 // cmd_len = length of cmd
@@ -15,6 +15,9 @@
 
 bool InitDesfireCard(void);
 void MifareSendCommand(uint8_t *datain);
+void MifareDesfireChained(uint8_t *datain);
+void MifareDesfireCheckKeys(uint8_t *datain);
+void MifarePlusCheckKeys(uint8_t *datain);
 void MifareDesfireGetInformation(void);
 void MifareDES_Auth1(uint8_t *datain);
 void ReaderMifareDES(uint32_t param, uint32_t param2, uint8_t *datain);
@@ -167,6 +167,66 @@ static bool IsAccessAllowed(uint8_t blockNo, uint8_t keytype, uint8_t action) {
     }
 }
 
+// Read answers of the blocks read last, access masked and with CRC. Only the encryption
+// is left to do when a reader reads them again, readers polling a card keep the hits high
+#define MFEMUL_READ_CACHE_SIZE  8
+
+typedef struct {
+    uint32_t last_used;     // 0 = unused
+    uint8_t blockNo;
+    uint8_t keytype;
+    uint8_t data[MAX_MIFARE_FRAME_SIZE];
+} mfemul_read_cache_t;
+
+static mfemul_read_cache_t read_cache[MFEMUL_READ_CACHE_SIZE];
+static uint32_t read_cache_clock = 0;
+
+static void ReadCacheClear(void) {
+    memset(read_cache, 0, sizeof(read_cache));
+    read_cache_clock = 0;
+}
+
+// a written trailer changes what every block of its sector reads as, drop the whole sector
+static void ReadCacheInvalidate(uint8_t blockNo) {
+    uint8_t sector = MifareBlockToSector(blockNo);
+    for (uint8_t i = 0; i < MFEMUL_READ_CACHE_SIZE; i++) {
+        if (read_cache[i].last_used && MifareBlockToSector(read_cache[i].blockNo) == sector)
+            read_cache[i].last_used = 0;
+    }
+}
+
+static bool ReadCacheGet(uint8_t blockNo, uint8_t keytype, uint8_t *data) {
+    for (uint8_t i = 0; i < MFEMUL_READ_CACHE_SIZE; i++) {
+        mfemul_read_cache_t *e = &read_cache[i];
+        if (e->last_used && e->blockNo == blockNo && e->keytype == keytype) {
+            e->last_used = ++read_cache_clock;
+            memcpy(data, e->data, sizeof(e->data));
+            return true;
+        }
+    }
+    return false;
+}
+
+static void ReadCachePut(uint8_t blockNo, uint8_t keytype, const uint8_t *data) {
+    mfemul_read_cache_t *e = &read_cache[0];
+    for (uint8_t i = 1; i < MFEMUL_READ_CACHE_SIZE; i++) {
+        if (read_cache[i].last_used < e->last_used)
+            e = &read_cache[i];
+    }
+    e->last_used = ++read_cache_clock;
+    e->blockNo = blockNo;
+    e->keytype = keytype;
+    memcpy(e->data, data, sizeof(e->data));
+}
+
+// An AR/NR entry with both pairs goes to the client in interactive mode, so it can find the key while
+// the simulation goes on. Sent after the answer to the reader, completed < 0 is none
+static void MifareSimSendNonces(uint16_t flags, const nonces_t *ar_nr_resp, int8_t completed) {
+    if (completed < 0 || (flags & FLAG_INTERACTIVE) != FLAG_INTERACTIVE)
+        return;
+    reply_ng(CMD_HF_MIFARE_SIMULATE, PM3_EPARTIAL, (uint8_t *)&ar_nr_resp[completed], sizeof(nonces_t));
+}
+
 static bool MifareSimInit(uint16_t flags, uint8_t *datain, uint16_t atqa, uint8_t sak, tag_response_info_t **responses, uint32_t *cuid, uint8_t *uid_len, uint8_t **rats, uint8_t *rats_len) {
 
     // SPEC: https://www.nxp.com/docs/en/application-note/AN10833.pdf
@@ -514,6 +574,9 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *datain, uint1
     // free eventually allocated BigBuf memory but keep Emulator Memory
     BigBuf_free_keep_EM();
 
+    // emulator memory may have changed since the last run
+    ReadCacheClear();
+
     if (MifareSimInit(flags, datain, atqa, sak, &responses, &cuid, &uid_len, &rats, &rats_len) == false) {
         BigBuf_free_keep_EM();
         return;
@@ -855,50 +918,53 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *datain, uint1
                 if (receivedCmd_len == 4 && receivedCmd_dec[0] == ISO14443A_CMD_READBLOCK) {
                     blockNo = receivedCmd_dec[1];
                     if (DBGLEVEL >= DBG_EXTENDED) Dbprintf("[MFEMUL_WORK] Reader reading block %d (0x%02x)", blockNo, blockNo);
-                    emlGetMem(response, blockNo, 1);
-                    if (DBGLEVEL >= DBG_EXTENDED)  {
-                        Dbprintf("[MFEMUL_WORK - ISO14443A_CMD_READBLOCK] Data Block[%d]: %02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x", blockNo,
-                                 response[0], response[1], response[2], response[3],  response[4],  response[5],  response[6],
-                                 response[7], response[8], response[9], response[10], response[11], response[12], response[13],
-                                 response[14], response[15]);
-                    }
+                    if (ReadCacheGet(blockNo, cardAUTHKEY, response) == false) {
+                        emlGetMem(response, blockNo, 1);
+                        if (DBGLEVEL >= DBG_EXTENDED)  {
+                            Dbprintf("[MFEMUL_WORK - ISO14443A_CMD_READBLOCK] Data Block[%d]: %02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x", blockNo,
+                                     response[0], response[1], response[2], response[3],  response[4],  response[5],  response[6],
+                                     response[7], response[8], response[9], response[10], response[11], response[12], response[13],
+                                     response[14], response[15]);
+                        }
 
-                    // Access permission managment:
-                    //
-                    // Sector Trailer:
-                    // - KEY A access
-                    // - KEY B access
-                    // - AC bits access
-                    //
-                    // Data block:
-                    // - Data access
+                        // Access permission managment:
+                        //
+                        // Sector Trailer:
+                        // - KEY A access
+                        // - KEY B access
+                        // - AC bits access
+                        //
+                        // Data block:
+                        // - Data access
 
-                    // If permission is not allowed, data is cleared (00) in emulator memeory.
-                    // ex: a0a1a2a3a4a561e789c1b0b1b2b3b4b5 => 00000000000061e789c1b0b1b2b3b4b5
+                        // If permission is not allowed, data is cleared (00) in emulator memeory.
+                        // ex: a0a1a2a3a4a561e789c1b0b1b2b3b4b5 => 00000000000061e789c1b0b1b2b3b4b5
 
 
-                    // Check if selected Block is a Sector Trailer
-                    if (IsSectorTrailer(blockNo)) {
+                        // Check if selected Block is a Sector Trailer
+                        if (IsSectorTrailer(blockNo)) {
 
-                        if (!IsAccessAllowed(blockNo, cardAUTHKEY, AC_KEYA_READ)) {
-                            memset(response, 0x00, 6); // keyA can never be read
-                            if (DBGLEVEL >= DBG_EXTENDED) Dbprintf("[MFEMUL_WORK - IsSectorTrailer] keyA can never be read - block %d (0x%02x)", blockNo, blockNo);
-                        }
-                        if (!IsAccessAllowed(blockNo, cardAUTHKEY, AC_KEYB_READ)) {
-                            memset(response + 10, 0x00, 6); // keyB cannot be read
-                            if (DBGLEVEL >= DBG_EXTENDED) Dbprintf("[MFEMUL_WORK - IsSectorTrailer] keyB cannot be read - block %d (0x%02x)", blockNo, blockNo);
-                        }
-                        if (!IsAccessAllowed(blockNo, cardAUTHKEY, AC_AC_READ)) {
-                            memset(response + 6, 0x00, 4); // AC bits cannot be read
-                            if (DBGLEVEL >= DBG_EXTENDED) Dbprintf("[MFEMUL_WORK - IsAccessAllowed] AC bits cannot be read - block %d (0x%02x)", blockNo, blockNo);
-                        }
-                    } else {
-                        if (!IsAccessAllowed(blockNo, cardAUTHKEY, AC_DATA_READ)) {
-                            memset(response, 0x00, 16); // datablock cannot be read
-                            if (DBGLEVEL >= DBG_EXTENDED) Dbprintf("[MFEMUL_WORK - IsAccessAllowed] Data block %d (0x%02x) cannot be read", blockNo, blockNo);
+                            if (!IsAccessAllowed(blockNo, cardAUTHKEY, AC_KEYA_READ)) {
+                                memset(response, 0x00, 6); // keyA can never be read
+                                if (DBGLEVEL >= DBG_EXTENDED) Dbprintf("[MFEMUL_WORK - IsSectorTrailer] keyA can never be read - block %d (0x%02x)", blockNo, blockNo);
+                            }
+                            if (!IsAccessAllowed(blockNo, cardAUTHKEY, AC_KEYB_READ)) {
+                                memset(response + 10, 0x00, 6); // keyB cannot be read
+                                if (DBGLEVEL >= DBG_EXTENDED) Dbprintf("[MFEMUL_WORK - IsSectorTrailer] keyB cannot be read - block %d (0x%02x)", blockNo, blockNo);
+                            }
+                            if (!IsAccessAllowed(blockNo, cardAUTHKEY, AC_AC_READ)) {
+                                memset(response + 6, 0x00, 4); // AC bits cannot be read
+                                if (DBGLEVEL >= DBG_EXTENDED) Dbprintf("[MFEMUL_WORK - IsAccessAllowed] AC bits cannot be read - block %d (0x%02x)", blockNo, blockNo);
+                            }
+                        } else {
+                            if (!IsAccessAllowed(blockNo, cardAUTHKEY, AC_DATA_READ)) {
+                                memset(response, 0x00, 16); // datablock cannot be read
+                                if (DBGLEVEL >= DBG_EXTENDED) Dbprintf("[MFEMUL_WORK - IsAccessAllowed] Data block %d (0x%02x) cannot be read", blockNo, blockNo);
+                            }
                         }
+                        AddCrc14A(response, 16);
+                        ReadCachePut(blockNo, cardAUTHKEY, response);
                     }
-                    AddCrc14A(response, 16);
                     mf_crypto1_encrypt(pcs, response, MAX_MIFARE_FRAME_SIZE, response_par);
                     EmSendCmdPar(response, MAX_MIFARE_FRAME_SIZE, response_par);
                     FpgaDisableTracing();
@@ -972,6 +1038,7 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *datain, uint1
                 if (receivedCmd_len == 4 && receivedCmd_dec[0] == MIFARE_CMD_TRANSFER) {
                     blockNo = receivedCmd_dec[1];
                     if (DBGLEVEL >= DBG_EXTENDED) Dbprintf("[MFEMUL_WORK] RECV 0x%02x transfer block %d (%02x)", receivedCmd_dec[0], blockNo, blockNo);
+                    ReadCacheInvalidate(receivedCmd_dec[1]);
                     if (emlSetValBl(cardINTREG, cardINTBLOCK, receivedCmd_dec[1]))
                         EmSend4bit(mf_crypto1_encrypt4bit(pcs, CARD_NACK_NA));
                     else
@@ -1064,6 +1131,8 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *datain, uint1
                 ar = bytes_to_num(&receivedCmd[4], 4);
 
                 // Collect AR/NR per keytype & sector
+                // the entry which got its second pair now, it goes to the client after the answer
+                int8_t completed = -1;
                 if ((flags & FLAG_NR_AR_ATTACK) == FLAG_NR_AR_ATTACK) {
 
                     for (uint8_t i = 0; i < ATTACK_KEY_COUNT; i++) {
@@ -1102,6 +1171,7 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *datain, uint1
                                                 // done collecting std test switch to moebius
                                                 // first finish incrementing last sample
                                                 ar_nr_collected[i + mM]++;
+                                                completed = i + mM;
                                                 // switch to moebius collection
                                                 gettingMoebius = true;
                                                 mM = ATTACK_KEY_COUNT;
@@ -1116,6 +1186,8 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *datain, uint1
                                         }
                                     }
                                     ar_nr_collected[i + mM]++;
+                                    if (ar_nr_collected[i + mM] == 2)
+                                        completed = i + mM;
                                 }
                             }
                             // we found right spot for this nonce stop looking
@@ -1144,6 +1216,7 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *datain, uint1
                     cardSTATE_TO_IDLE();
                     // Really tags not respond NACK on invalid authentication
                     LogTrace(uart->output, uart->len, uart->startTime * 16 - DELAY_AIR2ARM_AS_TAG, uart->endTime * 16 - DELAY_AIR2ARM_AS_TAG, uart->parity, true);
+                    MifareSimSendNonces(flags, ar_nr_resp, completed);
                     break;
                 }
 
@@ -1152,6 +1225,7 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *datain, uint1
                 mf_crypto1_encrypt(pcs, response, 4, response_par);
                 EmSendCmdPar(response, 4, response_par);
                 FpgaDisableTracing();
+                MifareSimSendNonces(flags, ar_nr_resp, completed);
 
                 if (DBGLEVEL >= DBG_EXTENDED) {
                     Dbprintf("[MFEMUL_AUTH1] AUTH COMPLETED for sector %d with key %c. time=%d",
@@ -1188,6 +1262,7 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *datain, uint1
                             }
                         }
                         emlSetMem(receivedCmd_dec, cardWRBL, 1);
+                        ReadCacheInvalidate(cardWRBL);
                         EmSend4bit(mf_crypto1_encrypt4bit(pcs, CARD_ACK)); // always ACK?
                         FpgaDisableTracing();
 
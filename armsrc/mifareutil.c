@@ -123,6 +123,13 @@ int mifare_sendcmd_short(struct Crypto1State *pcs, uint8_t crypted, uint8_t cmd,
     return len;
 }
 
+// key check loops shorten the wait for a wrong key to what the card showed, see MifareChkKeys_fast
+static uint32_t auth_answer_timeout = AUTHENTICATION_ANSWER_TIMEOUT;
+
+void mifare_classic_set_auth_timeout(uint32_t timeout) {
+    auth_answer_timeout = MIN(timeout, AUTHENTICATION_ANSWER_TIMEOUT);
+}
+
 // mifare classic commands
 int mifare_classic_auth(struct Crypto1State *pcs, uint32_t uid, uint8_t blockNo, uint8_t keyType, uint64_t ui64Key, uint8_t isNested) {
     return mifare_classic_authex(pcs, uid, blockNo, keyType, ui64Key, isNested, NULL, NULL);
@@ -140,9 +147,15 @@ int mifare_classic_authex(struct Crypto1State *pcs, uint32_t uid, uint8_t blockN
     // "random" reader nonce:
     num_to_bytes(prng_successor(GetTickCount(), 32), 4, nr);
 
-    // Transmit MIFARE_CLASSIC_AUTH
+    // save standard timeout
+    uint32_t save_timeout = iso14a_get_timeout();
+
+    // Transmit MIFARE_CLASSIC_AUTH, the nonce comes at a fixed delay
+    iso14a_set_timeout(iso14a_adaptive_timeout(save_timeout));
     len = mifare_sendcmd_short(pcs, isNested, 0x60 + (keyType & 0x01), blockNo, receivedAnswer, receivedAnswerPar, timing);
+    iso14a_set_timeout(save_timeout);
     if (len != 4) return 1;
+    iso14a_adaptive_learn();
 
     // Save the tag nonce (nt)
     nt = bytes_to_num(receivedAnswer, 4);
@@ -190,12 +203,10 @@ int mifare_classic_authex(struct Crypto1State *pcs, uint32_t uid, uint8_t blockN
     // Transmit reader nonce and reader answer
     ReaderTransmitPar(mf_nr_ar, sizeof(mf_nr_ar), par, NULL);
 
-    // save standard timeout
-    uint32_t save_timeout = iso14a_get_timeout();
-
     // set timeout for authentication response
-    if (save_timeout > 103)
-        iso14a_set_timeout(103);
+    uint32_t auth_timeout = iso14a_adaptive_timeout(auth_answer_timeout);
+    if (save_timeout > auth_timeout)
+        iso14a_set_timeout(auth_timeout);
 
     // Receive 4 byte tag answer
     len = ReaderReceive(receivedAnswer, receivedAnswerPar);
@@ -207,6 +218,8 @@ int mifare_classic_authex(struct Crypto1State *pcs, uint32_t uid, uint8_t blockN
         return 2;
     }
 
+    iso14a_adaptive_learn();
+
     ntpp = prng_successor(nt, 32) ^ crypto1_word(pcs, 0, 0);
 
     if (ntpp != bytes_to_num(receivedAnswer, 4)) {
@@ -12,6 +12,8 @@
 
 #define T0_PCF 8 //period for the pcf7931 in us
 #define ALLOC 16
+// the demodulator looks at this many samples, no need to take more
+#define PCF7931_SAMPLES 18000
 
 size_t DemodPCF7931(uint8_t **outBlocks) {
     uint8_t bits[256] = {0x00};
@@ -19,8 +21,8 @@ size_t DemodPCF7931(uint8_t **outBlocks) {
     uint8_t *dest = BigBuf_get_addr();
 
     int GraphTraceLen = BigBuf_max_traceLen();
-    if (GraphTraceLen > 18000)
-        GraphTraceLen = 18000;
+    if (GraphTraceLen > PCF7931_SAMPLES)
+        GraphTraceLen = PCF7931_SAMPLES;
 
     int i = 2, j, lastval, bitidx, half_switch;
     int clock = 64;
@@ -33,7 +35,7 @@ size_t DemodPCF7931(uint8_t **outBlocks) {
 
     BigBuf_Clear_keep_EM();
     LFSetupFPGAForADC(LF_DIVISOR_125, true);
-    DoAcquisition_default(0, true);
+    DoAcquisition(1, 8, 0, 0, true, GraphTraceLen, 0, 0);
 
     /* Find first local max/min */
     if (dest[1] > dest[0]) {
@@ -186,6 +188,8 @@ void ReadPCF7931(void) {
     uint8_t found_0_1 = 0; // flag: blocks 0 and 1 were found
     int errors = 0; // error counter
     int tries = 0; // tries counter
+    int status = PM3_SUCCESS;
+    lf_pcf7931_read_t res;
 
     memset(memory_blocks, 0, 8 * 17 * sizeof(uint8_t));
     memset(single_blocks, 0, 8 * 17 * sizeof(uint8_t));
@@ -206,7 +210,8 @@ void ReadPCF7931(void) {
             if (DBGLEVEL >= DBG_INFO)
                 Dbprintf("[!!] Error, no tag or bad tag");
 
-            return;
+            status = PM3_ESOFT;
+            goto end;
         }
         // exit if too many errors during reading
         if (tries > 50 && (2 * errors > tries)) {
@@ -233,7 +238,8 @@ void ReadPCF7931(void) {
                 }
                 if (j != 1) {
                     memcpy(single_blocks[single_blocks_cnt], tmp_blocks[0], 16);
-                    print_result("got single block", single_blocks[single_blocks_cnt], 16);
+                    if (DBGLEVEL >= DBG_EXTENDED)
+                        print_result("got single block", single_blocks[single_blocks_cnt], 16);
                     single_blocks_cnt++;
                 }
                 j = 0;
@@ -245,8 +251,9 @@ void ReadPCF7931(void) {
         if (DBGLEVEL >= DBG_EXTENDED)
             Dbprintf("(dbg) got %d blocks (%d/%d found) (%d tries, %d errors)", n, found_blocks, (max_blocks == 0 ? found_blocks : max_blocks), tries, errors);
 
-        for (i = 0; i < n; ++i) {
-            print_result("got consecutive blocks", tmp_blocks[i], 16);
+        if (DBGLEVEL >= DBG_EXTENDED) {
+            for (i = 0; i < n; ++i)
+                print_result("got consecutive blocks", tmp_blocks[i], 16);
         }
 
         i = 0;
@@ -261,7 +268,8 @@ void ReadPCF7931(void) {
                     max_blocks = MAX((memory_blocks[1][14] & 0x7f), memory_blocks[1][15]) + 1;
                     found_blocks = 2;
 
-                    Dbprintf("Found blocks 0 and 1. PCF is transmitting %d blocks.", max_blocks);
+                    if (DBGLEVEL >= DBG_INFO)
+                        Dbprintf("Found blocks 0 and 1. PCF is transmitting %d blocks.", max_blocks);
 
                     // handle the following blocks
                     for (j = i + 2; j < n; ++j) {
@@ -305,36 +313,31 @@ void ReadPCF7931(void) {
             }
         }
         ++tries;
-        if (BUTTON_PRESS()) {
+        if (BUTTON_PRESS() || data_available()) {
             if (DBGLEVEL >= DBG_EXTENDED)
                 Dbprintf("Button pressed, stopping.");
 
+            status = PM3_EOPABORTED;
             goto end;
         }
     } while (found_blocks < max_blocks);
 
 end:
-    Dbprintf("-----------------------------------------");
-    Dbprintf("Memory content:");
-    Dbprintf("-----------------------------------------");
+    // the blocks found go to the client, which prints them
+    memset(&res, 0, sizeof(res));
+    res.max_blocks = max_blocks;
     for (i = 0; i < max_blocks; ++i) {
-        if (memory_blocks[i][ALLOC])
-            print_result("Block", memory_blocks[i], 16);
-        else
-            Dbprintf("<missing block %d>", i);
+        if (memory_blocks[i][ALLOC]) {
+            res.mask |= 1 << i;
+            memcpy(res.blocks[i], memory_blocks[i], 16);
+        }
     }
-    Dbprintf("-----------------------------------------");
-
     if (found_blocks < max_blocks) {
-        Dbprintf("-----------------------------------------");
-        Dbprintf("Blocks with unknown position:");
-        Dbprintf("-----------------------------------------");
+        res.single_cnt = single_blocks_cnt;
         for (i = 0; i < single_blocks_cnt; ++i)
-            print_result("Block", single_blocks[i], 16);
-
-        Dbprintf("-----------------------------------------");
+            memcpy(res.single[i], single_blocks[i], 16);
     }
-    reply_mix(CMD_ACK, 0, 0, 0, 0, 0);
+    reply_ng(CMD_LF_PCF7931_READ, status, (uint8_t *)&res, sizeof(res));
 }
 
 static void RealWritePCF7931(uint8_t *pass, uint16_t init_delay, int32_t l, int32_t p, uint8_t address, uint8_t byte, uint8_t data) {
@@ -0,0 +1,128 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Firmware profiling counters. The ARM7TDMI has no cycle counter and the TC timers
+// belong to the handlers, the otherwise unused PIT is the time base.
+//-----------------------------------------------------------------------------
+#include "profiling.h"
+
+#include "proxmark3_arm.h"
+#include "string.h"
+#include "cmd.h"
+#include "ticks.h"
+#include "dbprint.h"
+#include "BigBuf.h"
+#include "appmain.h"
+#include "usb_cdc.h"
+
+// PIT ticks per us
+#define PROFILING_TICKS_US      (MCK / 16 / 1000000)
+
+static profile_cmd_t s_cmds[PROFILE_MAX_CMDS];
+static uint8_t s_cmd_count = 0;
+static uint32_t s_dma_overruns = 0;
+static uint32_t s_since = 0;
+
+void profiling_init(void) {
+    // a full 20 bit period, the 12 bit PICNT on top makes PIIR a 32 bit counter
+    AT91C_BASE_PITC->PITC_PIMR = AT91C_PITC_PITEN | AT91C_PITC_PIV;
+    profiling_reset();
+}
+
+void profiling_reset(void) {
+    memset(s_cmds, 0, sizeof(s_cmds));
+    s_cmd_count = 0;
+    s_dma_overruns = 0;
+    usb_tx_stalls_reset();
+    s_since = GetTickCount();
+}
+
+uint32_t profiling_ticks(void) {
+    return AT91C_BASE_PITC->PITC_PIIR;
+}
+
+void profiling_cmd(uint16_t cmd, uint32_t start_ticks, uint32_t start_ms) {
+
+    // the PIT wraps after 23 minutes, long runs are counted in ms
+    uint32_t ms = GetTickCountDelta(start_ms);
+    uint32_t us = (ms > 60000) ? ms * 1000 : (profiling_ticks() - start_ticks) / PROFILING_TICKS_US;
+
+    profile_cmd_t *e = NULL;
+    for (uint8_t i = 0; i < s_cmd_count; i++) {
+        if (s_cmds[i].cmd == cmd) {
+            e = &s_cmds[i];
+            break;
+        }
+    }
+
+    if (e == NULL) {
+        if (s_cmd_count < PROFILE_MAX_CMDS) {
+            e = &s_cmds[s_cmd_count++];
+        } else {
+            // the one that took the least time so far makes room
+            e = &s_cmds[0];
+            for (uint8_t i = 1; i < s_cmd_count; i++) {
+                if (s_cmds[i].total_us < e->total_us)
+                    e = &s_cmds[i];
+            }
+        }
+        memset(e, 0, sizeof(*e));
+        e->cmd = cmd;
+    }
+
+    e->calls++;
+    e->total_us += us;
+    if (us > e->max_us)
+        e->max_us = us;
+}
+
+void profiling_dma_overrun(void) {
+    s_dma_overruns++;
+}
+
+static void profiling_fill(profile_t *p) {
+    p->uptime_ms = GetTickCountDelta(s_since);
+    p->dma_overruns = s_dma_overruns;
+    p->usb_tx_stalls = usb_tx_stalls();
+    p->bigbuf_size = BigBuf_get_size();
+    p->bigbuf_used = BigBuf_get_size() - BigBuf_max_traceLen();
+    p->bigbuf_peak = BigBuf_get_peak();
+    p->stack_used = get_stack_usage();
+    p->stack_size = get_stack_size();
+    p->count = s_cmd_count;
+    memcpy(p->cmds, s_cmds, sizeof(s_cmds));
+}
+
+void profiling_print_status(void) {
+    profile_t p;
+    profiling_fill(&p);
+
+    DbpString(_CYAN_("Profiling"));
+    Dbprintf("  Counting since..........%d ms", p.uptime_ms);
+    Dbprintf("  DMA overruns............%d", p.dma_overruns);
+    Dbprintf("  USB TX stalls...........%d", p.usb_tx_stalls);
+    Dbprintf("  BigBuf used / peak......%d / %d bytes", p.bigbuf_used, p.bigbuf_peak);
+
+    // the busiest handlers, without the hw status run going on
+    for (uint8_t n = 0; n < 3; n++) {
+        profile_cmd_t *best = NULL;
+        for (uint8_t i = 0; i < p.count; i++) {
+            if (p.cmds[i].cmd != CMD_STATUS && p.cmds[i].calls && (best == NULL || p.cmds[i].total_us > best->total_us))
+                best = &p.cmds[i];
+        }
+        if (best == NULL)
+            break;
+        Dbprintf("  cmd 0x%04x..............%d calls, %d ms, max %d us", best->cmd, best->calls, (uint32_t)(best->total_us / 1000), best->max_us);
+        best->calls = 0;
+    }
+}
+
+void profiling_reply(bool reset) {
+    profile_t p;
+    profiling_fill(&p);
+    reply_ng(CMD_PROFILE, PM3_SUCCESS, (uint8_t *)&p, sizeof(p));
+    if (reset)
+        profiling_reset();
+}
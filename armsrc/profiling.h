@@ -0,0 +1,28 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Firmware profiling counters, time per command handler, DMA overruns, USB stalls
+//-----------------------------------------------------------------------------
+#ifndef __PROFILING_H
+#define __PROFILING_H
+
+#include "common.h"
+
+void profiling_init(void);
+void profiling_reset(void);
+
+// free running, MCK/16 = 3MHz. Wraps after 23 minutes
+uint32_t profiling_ticks(void);
+
+// one handler run of cmd, started at profiling_ticks() / GetTickCount() values given
+void profiling_cmd(uint16_t cmd, uint32_t start_ticks, uint32_t start_ms);
+
+// a sniffer fell so far behind its DMA buffer that it gave up
+void profiling_dma_overrun(void);
+
+void profiling_print_status(void);
+void profiling_reply(bool reset);
+
+#endif
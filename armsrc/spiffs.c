@@ -20,7 +20,10 @@
 // testing regarding power loss, page consistency checks, Garbage collector
 // Flushing handling... in doubt, use maximal safetylevel as, in most of the
 // case, will ensure a flush by rollbacking to previous Unmounted state
-#define RDV40_SPIFFS_CACHE_SZ ((LOG_PAGE_SIZE + 32) * 4)
+#ifndef RDV40_SPIFFS_CACHE_PAGES
+# define RDV40_SPIFFS_CACHE_PAGES 4
+#endif
+#define RDV40_SPIFFS_CACHE_SZ ((LOG_PAGE_SIZE + 32) * RDV40_SPIFFS_CACHE_PAGES)
 #define SPIFFS_FD_SIZE (32)
 #define RDV40_SPIFFS_MAX_FD (3)
 #define RDV40_SPIFFS_FDBUF_SZ (SPIFFS_FD_SIZE * RDV40_SPIFFS_MAX_FD)
@@ -48,9 +51,38 @@
 #include "BigBuf.h"
 #include "dbprint.h"
 
+// Sequential read-ahead window, only while a streaming reader hands in a buffer (see
+// rdv40_spiffs_readahead). A page read that misses the window fetches the whole window in one
+// flash transfer, files written in one go sit on consecutive pages.
+static struct {
+    uint8_t *buf;
+    uint32_t size;
+    uint32_t addr;      // flash address of buf[0]
+    uint32_t len;       // valid bytes in buf, 0 when empty
+} spiffs_ra;
+
 ///// FLASH LEVEL R/W/E operations  for feeding SPIFFS Driver/////////////////
 static s32_t rdv40_spiffs_llread(u32_t addr, u32_t size, u8_t *dst) {
 
+    if (spiffs_ra.buf) {
+        if (spiffs_ra.len && addr >= spiffs_ra.addr && (addr + size) <= (spiffs_ra.addr + spiffs_ra.len)) {
+            memcpy(dst, spiffs_ra.buf + (addr - spiffs_ra.addr), size);
+            return SPIFFS_OK;
+        }
+
+        uint32_t len = MIN(spiffs_ra.size, SPIFFS_CFG_PHYS_SZ - addr);
+        if (size == LOG_PAGE_SIZE && len >= size) {
+            spiffs_ra.len = 0;
+            if (!Flash_ReadData(addr, spiffs_ra.buf, len)) {
+                return 128;
+            }
+            spiffs_ra.addr = addr;
+            spiffs_ra.len = len;
+            memcpy(dst, spiffs_ra.buf, size);
+            return SPIFFS_OK;
+        }
+    }
+
     if (!Flash_ReadData(addr, dst, size)) {
         return 128;
     }
@@ -59,6 +91,7 @@ static s32_t rdv40_spiffs_llread(u32_t addr, u32_t size, u8_t *dst) {
 
 static s32_t rdv40_spiffs_llwrite(u32_t addr, u32_t size, u8_t *src) {
 
+    spiffs_ra.len = 0;
     if (!FlashInit()) {
         return 129;
     }
@@ -68,6 +101,7 @@ static s32_t rdv40_spiffs_llwrite(u32_t addr, u32_t size, u8_t *src) {
 
 static s32_t rdv40_spiffs_llerase(u32_t addr, u32_t size) {
     uint8_t erased = 0;
+    spiffs_ra.len = 0;
 
     if (!FlashInit()) {
         return 130;
@@ -157,6 +191,7 @@ int rdv40_spiffs_unmount(void) {
 
     SPIFFS_clearerr(&fs);
     SPIFFS_unmount(&fs);
+    rdv40_spiffs_readahead(NULL, 0);
 
     int ret = SPIFFS_errno(&fs);
     if (ret == SPIFFS_OK) {
@@ -537,6 +572,52 @@ int rdv40_spiffs_read_as_filetype(char *filename, uint8_t *dst, uint32_t size, R
     )
 }
 
+// Streaming reads, the file stays open so it can be read piece by piece without a
+// BigBuf sized copy. Symlinks are followed, the caller mounts before and unmounts after.
+// Returns a file descriptor >= 0,  or a negative SPIFFS error
+int rdv40_spiffs_open_read(const char *filename) {
+    char linkdest[SPIFFS_OBJ_NAME_LEN] = {0};
+    const char *name = filename;
+    if (filetype_in_spiffs(filename) == RDV40_SPIFFS_FILETYPE_SYMLINK) {
+        char linkfilename[SPIFFS_OBJ_NAME_LEN];
+        sprintf(linkfilename, "%s.lnk", filename);
+        read_from_spiffs(linkfilename, (uint8_t *)linkdest, SPIFFS_OBJ_NAME_LEN);
+        linkdest[SPIFFS_OBJ_NAME_LEN - 1] = 0;
+        name = linkdest;
+    }
+    return SPIFFS_open(&fs, name, SPIFFS_RDONLY, 0);
+}
+
+// Returns the bytes read,  0 at the end of the file
+int rdv40_spiffs_read_fd(int fd, uint8_t *dst, uint32_t size) {
+    s32_t res = SPIFFS_read(&fs, fd, dst, size);
+    return (res < 0) ? 0 : res;
+}
+
+void rdv40_spiffs_close_fd(int fd) {
+    SPIFFS_close(&fs, fd);
+}
+
+// Streaming writes, the file is created or truncated and written piece by piece.
+// The caller mounts before and unmounts after, the fd is closed with rdv40_spiffs_close_fd
+// Returns a file descriptor >= 0,  or a negative SPIFFS error
+int rdv40_spiffs_open_write(const char *filename) {
+    return SPIFFS_open(&fs, filename, SPIFFS_CREAT | SPIFFS_TRUNC | SPIFFS_RDWR, 0);
+}
+
+// Returns the bytes written,  negative on error
+int rdv40_spiffs_write_fd(int fd, uint8_t *src, uint32_t size) {
+    return SPIFFS_write(&fs, fd, src, size);
+}
+
+// Lends buf (size bytes, usually from BigBuf) to the read-ahead of sequential reads. Hand it in
+// after open, NULL ends it. It must be ended before buf is freed, unmounting ends it too
+void rdv40_spiffs_readahead(uint8_t *buf, uint32_t size) {
+    spiffs_ra.buf = (size >= LOG_PAGE_SIZE) ? buf : NULL;
+    spiffs_ra.size = size;
+    spiffs_ra.len = 0;
+}
+
 // TODO regarding reads/write and symlinks :
 // Provide a higher level readFile function which
 //   - don't need a size to be provided, getting it from STAT call and using bigbuff malloc
@@ -42,6 +42,16 @@ int rdv40_spiffs_read(const char *filename, uint8_t *dst, uint32_t size, RDV40Sp
 int rdv40_spiffs_rename(char *old_filename, char *new_filename, RDV40SpiFFSSafetyLevel level);
 int rdv40_spiffs_remove(char *filename, RDV40SpiFFSSafetyLevel level);
 int rdv40_spiffs_read_as_symlink(char *filename, uint8_t *dst, uint32_t size, RDV40SpiFFSSafetyLevel level);
+int rdv40_spiffs_open_read(const char *filename);
+int rdv40_spiffs_read_fd(int fd, uint8_t *dst, uint32_t size);
+void rdv40_spiffs_close_fd(int fd);
+int rdv40_spiffs_open_write(const char *filename);
+int rdv40_spiffs_write_fd(int fd, uint8_t *src, uint32_t size);
+// default read-ahead window of the streaming readers
+#ifndef RDV40_SPIFFS_READAHEAD_SZ
+# define RDV40_SPIFFS_READAHEAD_SZ  2048
+#endif
+void rdv40_spiffs_readahead(uint8_t *buf, uint32_t size);
 void write_to_spiffs(const char *filename, uint8_t *src, uint32_t size);
 void read_from_spiffs(const char *filename, uint8_t *dst, uint32_t size);
 void test_spiffs(void);
@@ -46,6 +46,28 @@ void SpinDelay(int ms) {
     // convert to us and call microsecond delay function
     SpinDelayUs(ms * 1000);
 }
+
+// Busy waits clk cycles of MCK (1 / 48MHz) on PWM channel 1, channel 0 stays with SpinDelayUs and the
+// TC0..TC2 counters with the ssp clock, so it can time tear-offs in the middle of a 14a exchange
+void RAMFUNC SpinDelayMck(uint32_t clk) {
+    AT91C_BASE_PWMC->PWMC_ENA = PWM_CHANNEL(1);
+
+    AT91C_BASE_PWMC_CH1->PWMC_CMR = PWM_CH_MODE_PRESCALER(0);
+    AT91C_BASE_PWMC_CH1->PWMC_CDTYR = 0;
+    AT91C_BASE_PWMC_CH1->PWMC_CPRDR = 0xffff;
+
+    uint16_t last = AT91C_BASE_PWMC_CH1->PWMC_CCNTR;
+    while (clk) {
+        uint16_t now = AT91C_BASE_PWMC_CH1->PWMC_CCNTR;
+        uint16_t elapsed = now - last;
+        if (elapsed >= clk)
+            return;
+
+        clk -= elapsed;
+        last = now;
+        WDT_HIT();
+    }
+}
 //  -------------------------------------------------------------------------
 //  timer lib
 //  -------------------------------------------------------------------------
@@ -20,6 +20,7 @@
 
 void SpinDelay(int ms);
 void SpinDelayUs(int us);
+void RAMFUNC SpinDelayMck(uint32_t clk);
 
 void StartTickCount(void);
 uint32_t RAMFUNC GetTickCount(void);
@@ -10,6 +10,8 @@
 //-----------------------------------------------------------------------------
 #include "usart.h"
 #include "proxmark3_arm.h"
+#include "pm3_cmd.h"
+#include "string.h"
 
 volatile AT91PS_USART pUS1 = AT91C_BASE_US1;
 volatile AT91PS_PIO pPIO   = AT91C_BASE_PIOA;
@@ -160,6 +162,22 @@ uint32_t usart_read_ng(uint8_t *data, size_t len) {
     return nbBytesRcv;
 }
 
+// Frame being sent by usart_writebuffer_async, the PDC reads it from here
+static uint8_t us_outbuf[sizeof(PacketResponseOLD)];
+
+// transfer from device to client, returns as soon as the PDC is sending.
+// Only the frame before has to be gone, so the next one is composed while this one goes out
+int usart_writebuffer_async(uint8_t *data, size_t len) {
+    if (len > sizeof(us_outbuf))
+        return usart_writebuffer_sync(data, len);
+
+    while (pUS1->US_TNCR || pUS1->US_TCR) {};
+    memcpy(us_outbuf, data, len);
+    pUS1->US_TPR = (uint32_t)us_outbuf;
+    pUS1->US_TCR = len;
+    return PM3_SUCCESS;
+}
+
 // transfer from device to client
 int usart_writebuffer_sync(uint8_t *data, size_t len) {
 
@@ -184,6 +202,9 @@ void usart_init(uint32_t baudrate, uint8_t parity) {
     // For a nice detailed sample, interrupt driven but still relevant.
     // See https://www.sparkfun.com/datasheets/DevTools/SAM7/at91sam7%20serial%20communications.pdf
 
+    // a frame may still be going out
+    while (pUS1->US_TNCR || pUS1->US_TCR) {};
+
     // disable & reset receiver / transmitter for configuration
     pUS1->US_CR = (AT91C_US_RSTRX | AT91C_US_RSTTX | AT91C_US_RXDIS | AT91C_US_TXDIS);
 
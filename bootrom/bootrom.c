@@ -75,6 +75,31 @@ static void Fatal(void) {
     for (;;) {};
 }
 
+// same CRC32 as crc32_update in common/crc32.c, bitwise to keep the bootrom small
+static uint32_t block_crc32(const uint8_t *data, uint32_t len) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++)
+            crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320 : 0);
+    }
+    return crc;
+}
+
+// the page a fast write left programming, the next command waits for it
+static AT91PS_EFC pending_efc = NULL;
+
+// returns the flash status if the page failed, 0 otherwise
+static uint32_t wait_pending_page(void) {
+    if (pending_efc == NULL)
+        return 0;
+
+    uint32_t sr;
+    while (!((sr = pending_efc->EFC_FSR) & AT91C_MC_FRDY));
+    pending_efc = NULL;
+    return (sr & (AT91C_MC_LOCKE | AT91C_MC_PROGE)) ? sr : 0;
+}
+
 static void UsbPacketReceived(uint8_t *packet) {
     int dont_ack = 0;
     PacketCommandOLD *c = (PacketCommandOLD *)packet;
@@ -83,6 +108,13 @@ static void UsbPacketReceived(uint8_t *packet) {
 
     uint32_t arg0 = (uint32_t)c->arg[0];
 
+    // flash must be done programming before it is read or written again
+    uint32_t pending_sr = wait_pending_page();
+    if (pending_sr) {
+        reply_old(CMD_NACK, pending_sr, 0, 0, 0, 0);
+        return;
+    }
+
     switch (c->cmd) {
         case CMD_DEVICE_INFO: {
             dont_ack = 1;
@@ -90,7 +122,9 @@ static void UsbPacketReceived(uint8_t *packet) {
                    DEVICE_INFO_FLAG_CURRENT_MODE_BOOTROM |
                    DEVICE_INFO_FLAG_UNDERSTANDS_START_FLASH |
                    DEVICE_INFO_FLAG_UNDERSTANDS_CHIP_INFO |
-                   DEVICE_INFO_FLAG_UNDERSTANDS_VERSION;
+                   DEVICE_INFO_FLAG_UNDERSTANDS_VERSION |
+                   DEVICE_INFO_FLAG_UNDERSTANDS_BLOCK_CRC |
+                   DEVICE_INFO_FLAG_UNDERSTANDS_FAST_WRITE;
             if (common_area.flags.osimage_present)
                 arg0 |= DEVICE_INFO_FLAG_OSIMAGE_PRESENT;
 
@@ -107,13 +141,29 @@ static void UsbPacketReceived(uint8_t *packet) {
 
         case CMD_BL_VERSION: {
             dont_ack = 1;
-            arg0 = BL_VERSION_1_0_0;
+            arg0 = BL_VERSION_1_2_0;
             reply_old(CMD_BL_VERSION, arg0, 0, 0, 0, 0);
         }
         break;
 
+        case CMD_BL_BLOCK_CRC: {
+            dont_ack = 1;
+            uint32_t crcs[PM3_CMD_DATA_SIZE / sizeof(uint32_t)];
+            uint32_t count = MIN(c->arg[1], PM3_CMD_DATA_SIZE / sizeof(uint32_t));
+            if ((arg0 < (uint32_t)_flash_start) || ((arg0 + count * BL_CRC_BLOCK_SIZE) > (uint32_t)&_flash_end)) {
+                reply_old(CMD_NACK, 0, 0, 0, 0, 0);
+                break;
+            }
+            for (uint32_t i = 0; i < count; i++) {
+                crcs[i] = block_crc32((uint8_t *)(arg0 + i * BL_CRC_BLOCK_SIZE), BL_CRC_BLOCK_SIZE);
+            }
+            reply_old(CMD_BL_BLOCK_CRC, arg0, count, 0, crcs, count * sizeof(uint32_t));
+        }
+        break;
+
         case CMD_FINISH_WRITE: {
-            if (c->arg[1] == CMD_ACK && c->arg[2] == (CMD_ACK + CMD_NACK)) {
+            bool fast = (c->arg[2] == FINISH_WRITE_FAST_MAGIC);
+            if (c->arg[1] == CMD_ACK && (c->arg[2] == (CMD_ACK + CMD_NACK) || fast)) {
                 for (int j = 0; j < 2; j++) {
                     uint32_t flash_address = arg0 + (0x100 * j);
                     AT91PS_EFC efc_bank = AT91C_BASE_EFC0;
@@ -140,6 +190,12 @@ static void UsbPacketReceived(uint8_t *packet) {
                         efc_bank->EFC_FCR = MC_FLASH_COMMAND_KEY |
                             MC_FLASH_COMMAND_PAGEN(page_n) |
                             AT91C_MC_FCMD_START_PROG;
+
+                        // the last page programs while the ACK goes out and the next block comes in
+                        if (fast && j == 1) {
+                            pending_efc = efc_bank;
+                            break;
+                        }
                     }
 
                     // Wait until flashing of page finishes
@@ -7,8 +7,8 @@
 #include <jni_tools.h>
 #include "stdbool.h"
 
-// native thread attach label
-static bool g_IsAttach;
+// native thread attach label, per thread, the session thread attaches on its own
+static __thread bool g_IsAttach;
 
 // get current env for jvm
 JNIEnv *getJniEnv() {
@@ -16,6 +16,7 @@
 #include <limits.h>
 #include <unistd.h>
 #include <ctype.h>
+#include <pthread.h>
 #include "usart_defs.h"
 #include "util_posix.h"
 #include "proxgui.h"
@@ -34,6 +35,9 @@
 // I will impl a function to load preferences at future.
 #define PM3_LOCAL_SOCKET_SERVER "DXL.COM.ASL"
 
+// jobs queued by the async calls, run one after the other by the session thread
+#define PM3_JNI_JOBS 8
+
 static char *g_android_executable_directory = NULL;
 static char *g_android_user_directory = NULL;
 
@@ -109,7 +113,7 @@ jboolean IsClientRunning(JNIEnv *env, jobject instance) {
  * test hw and fw and client.
  * */
 jboolean TestPm3(JNIEnv *env, jobject instance) {
-    if (open() == false) {
+    if (OpenPm3() == false) {
         CloseProxmark();
         return false;
     }
@@ -124,6 +128,248 @@ void ClosePm3(JNIEnv *env, jobject instance) {
     CloseProxmark();
 }
 
+/*
+ * Persistent session, the connection is opened once and kept for all calls.
+ * Async calls are queued to one session thread, so the Java thread never waits
+ * on the device. The callback object gets
+ *   void onData(int cmd, int status, byte[] data)   each reply, PM3_EPARTIAL ones included
+ *   void onDone(int status)                         when the job is over
+ * */
+typedef enum {
+    JOB_CONSOLE,
+    JOB_RAW,
+} jni_job_kind_t;
+
+typedef struct {
+    jni_job_kind_t kind;
+    char *line;                 // JOB_CONSOLE
+    uint16_t cmd;               // JOB_RAW
+    uint8_t data[PM3_CMD_DATA_SIZE];
+    uint16_t len;
+    uint32_t timeout;
+    jobject callback;           // global ref, may be NULL
+} jni_job_t;
+
+static struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool running;
+    bool cancel;
+    jni_job_t jobs[PM3_JNI_JOBS];
+    uint8_t head;
+    uint8_t count;
+} jni_session = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+static bool session_connect(void) {
+    if (conn.run) { return true; }
+    if (OpenPm3() && TestProxmark() == PM3_SUCCESS) {
+        return true;
+    }
+    CloseProxmark();
+    return false;
+}
+
+static void callback_data(JNIEnv *env, jobject cb, uint16_t cmd, int16_t status, const uint8_t *data, uint16_t len) {
+    if (cb == NULL) { return; }
+    jclass clz = (*env)->GetObjectClass(env, cb);
+    jmethodID mid = (*env)->GetMethodID(env, clz, "onData", "(II[B)V");
+    if (mid != NULL) {
+        jbyteArray arr = (*env)->NewByteArray(env, len);
+        (*env)->SetByteArrayRegion(env, arr, 0, len, (const jbyte *) data);
+        (*env)->CallVoidMethod(env, cb, mid, (jint) cmd, (jint) status, arr);
+        (*env)->DeleteLocalRef(env, arr);
+    }
+    (*env)->DeleteLocalRef(env, clz);
+}
+
+static void callback_done(JNIEnv *env, jobject cb, int status) {
+    if (cb == NULL) { return; }
+    jclass clz = (*env)->GetObjectClass(env, cb);
+    jmethodID mid = (*env)->GetMethodID(env, clz, "onDone", "(I)V");
+    if (mid != NULL) {
+        (*env)->CallVoidMethod(env, cb, mid, (jint) status);
+    }
+    (*env)->DeleteLocalRef(env, clz);
+}
+
+// one command, then its replies until one is not PM3_EPARTIAL, the timeout or a cancel
+static int run_raw(JNIEnv *env, jni_job_t *job) {
+    clearCommandBuffer();
+    SendCommandNG(job->cmd, job->data, job->len);
+
+    PacketResponseNG resp;
+    for (;;) {
+        if (WaitForResponseTimeoutW(job->cmd, &resp, job->timeout, false) == false) {
+            return PM3_ETIMEOUT;
+        }
+        callback_data(env, job->callback, resp.cmd, resp.status, resp.data.asBytes, resp.length);
+        if (resp.status != PM3_EPARTIAL) {
+            return resp.status;
+        }
+        if (__atomic_load_n(&jni_session.cancel, __ATOMIC_RELAXED)) {
+            // streams run until CMD_BREAK_LOOP, the last frame closes them
+            __atomic_store_n(&jni_session.cancel, false, __ATOMIC_RELAXED);
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+        }
+    }
+}
+
+static void *session_thread(void *arg) {
+    JNIEnv *env = getJniEnv();
+
+    pthread_mutex_lock(&jni_session.lock);
+    while (jni_session.running) {
+        if (jni_session.count == 0) {
+            pthread_cond_wait(&jni_session.cond, &jni_session.lock);
+            continue;
+        }
+        jni_job_t job = jni_session.jobs[jni_session.head];
+        jni_session.head = (jni_session.head + 1) % PM3_JNI_JOBS;
+        jni_session.count--;
+        pthread_mutex_unlock(&jni_session.lock);
+
+        int ret = PM3_EIO;
+        if (session_connect()) {
+            __atomic_store_n(&jni_session.cancel, false, __ATOMIC_RELAXED);
+            if (job.kind == JOB_CONSOLE) {
+                ret = CommandReceived(job.line);
+            } else {
+                ret = run_raw(env, &job);
+            }
+        }
+        callback_done(env, job.callback, ret);
+
+        free(job.line);
+        if (job.callback) {
+            (*env)->DeleteGlobalRef(env, job.callback);
+        }
+        pthread_mutex_lock(&jni_session.lock);
+    }
+    pthread_mutex_unlock(&jni_session.lock);
+
+    detachThread();
+    return NULL;
+}
+
+static bool session_queue(JNIEnv *env, jni_job_t *job, jobject callback) {
+    pthread_mutex_lock(&jni_session.lock);
+    if (jni_session.running == false) {
+        jni_session.running = (pthread_create(&jni_session.thread, NULL, session_thread, NULL) == 0);
+    }
+    if (jni_session.running == false || jni_session.count == PM3_JNI_JOBS) {
+        pthread_mutex_unlock(&jni_session.lock);
+        free(job->line);
+        return false;
+    }
+    job->callback = (callback) ? (*env)->NewGlobalRef(env, callback) : NULL;
+    jni_session.jobs[(jni_session.head + jni_session.count) % PM3_JNI_JOBS] = *job;
+    jni_session.count++;
+    pthread_cond_signal(&jni_session.cond);
+    pthread_mutex_unlock(&jni_session.lock);
+    return true;
+}
+
+/*
+ * open the session, stays open until closeSession / stopExecute
+ * */
+jboolean OpenSession(JNIEnv *env, jobject instance) {
+    return (jboolean) session_connect();
+}
+
+/*
+ * stop the session thread, the queued jobs are dropped, then close the device
+ * */
+void CloseSession(JNIEnv *env, jobject instance) {
+    pthread_mutex_lock(&jni_session.lock);
+    bool running = jni_session.running;
+    jni_session.running = false;
+    __atomic_store_n(&jni_session.cancel, true, __ATOMIC_RELAXED);
+    pthread_cond_signal(&jni_session.cond);
+    pthread_mutex_unlock(&jni_session.lock);
+    if (running) {
+        pthread_join(jni_session.thread, NULL);
+    }
+    for (; jni_session.count; jni_session.count--) {
+        jni_job_t *job = &jni_session.jobs[jni_session.head];
+        jni_session.head = (jni_session.head + 1) % PM3_JNI_JOBS;
+        free(job->line);
+        if (job->callback) {
+            (*env)->DeleteGlobalRef(env, job->callback);
+        }
+    }
+    CloseProxmark();
+}
+
+/*
+ * queue a console command, false if the queue is full
+ * */
+jboolean ExecuteAsync(JNIEnv *env, jobject instance, jstring cmd_, jobject callback) {
+    jni_job_t job = { .kind = JOB_CONSOLE };
+    const char *cmd = (*env)->GetStringUTFChars(env, cmd_, 0);
+    job.line = strdup(cmd);
+    (*env)->ReleaseStringUTFChars(env, cmd_, cmd);
+    if (job.line == NULL) {
+        return false;
+    }
+    return (jboolean) session_queue(env, &job, callback);
+}
+
+/*
+ * queue a NG command with its payload as is, the replies come to onData
+ * */
+jboolean SendAsync(JNIEnv *env, jobject instance, jint cmd, jbyteArray data, jint timeout, jobject callback) {
+    jni_job_t job = { .kind = JOB_RAW, .cmd = cmd, .timeout = timeout };
+    if (data != NULL) {
+        jsize len = (*env)->GetArrayLength(env, data);
+        if (len > PM3_CMD_DATA_SIZE) {
+            return false;
+        }
+        (*env)->GetByteArrayRegion(env, data, 0, len, (jbyte *) job.data);
+        job.len = len;
+    }
+    return (jboolean) session_queue(env, &job, callback);
+}
+
+/*
+ * send a NG command and wait for its reply, payload of the reply or null.
+ * Not for streams, the PM3_EPARTIAL frames are only for SendAsync
+ * */
+jbyteArray SendSync(JNIEnv *env, jobject instance, jint cmd, jbyteArray data, jint timeout) {
+    if (session_connect() == false) {
+        return NULL;
+    }
+    uint8_t buf[PM3_CMD_DATA_SIZE];
+    jsize len = 0;
+    if (data != NULL) {
+        len = (*env)->GetArrayLength(env, data);
+        if (len > PM3_CMD_DATA_SIZE) {
+            return NULL;
+        }
+        (*env)->GetByteArrayRegion(env, data, 0, len, (jbyte *) buf);
+    }
+
+    PacketResponseNG resp;
+    clearCommandBuffer();
+    SendCommandNG(cmd, buf, len);
+    if (WaitForResponseTimeoutW(cmd, &resp, timeout, false) == false || resp.status != PM3_SUCCESS) {
+        return NULL;
+    }
+    jbyteArray arr = (*env)->NewByteArray(env, resp.length);
+    (*env)->SetByteArrayRegion(env, arr, 0, resp.length, (const jbyte *) resp.data.asBytes);
+    return arr;
+}
+
+/*
+ * ask the running job to stop, a stream gets CMD_BREAK_LOOP
+ * */
+void CancelAsync(JNIEnv *env, jobject instance) {
+    __atomic_store_n(&jni_session.cancel, true, __ATOMIC_RELAXED);
+}
+
 /*
  * native function map to jvm
  * */
@@ -142,8 +388,14 @@ JNIEXPORT jint JNI_OnLoad(JavaVM *vm, void *reserved) {
     jclass clz_test = (*jniEnv)->FindClass(jniEnv, "cn/rrg/devices/Proxmark3RRGRdv4");
     JNINativeMethod methods[] = {
         {"startExecute", "(Ljava/lang/String;)I", (void *) Console},
-        {"stopExecute",  "()V", (void *) ClosePm3},
-        {"isExecuting",  "()Z", (void *) IsClientRunning}
+        {"stopExecute",  "()V", (void *) CloseSession},
+        {"isExecuting",  "()Z", (void *) IsClientRunning},
+        {"openSession",  "()Z", (void *) OpenSession},
+        {"closeSession", "()V", (void *) CloseSession},
+        {"executeAsync", "(Ljava/lang/String;Ljava/lang/Object;)Z", (void *) ExecuteAsync},
+        {"sendAsync",    "(I[BILjava/lang/Object;)Z", (void *) SendAsync},
+        {"sendSync",     "(I[BI)[B", (void *) SendSync},
+        {"cancelAsync",  "()V", (void *) CancelAsync}
     };
 
     JNINativeMethod methods1[] = {
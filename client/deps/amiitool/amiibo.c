@@ -6,6 +6,7 @@
  */
 
 #include "amiibo.h"
+#include <pthread.h>
 #include "md.h"
 #include "aes.h"
 #include "commonutil.h"
@@ -21,11 +22,11 @@ static void nfc3d_amiibo_calc_seed(const uint8_t *dump, uint8_t *key) {
     memcpy(key + 0x20, dump + 0x1E8, 0x20);
 }
 
-static void nfc3d_amiibo_keygen(const nfc3d_keygen_masterkeys *masterKeys, const uint8_t *dump, nfc3d_keygen_derivedkeys *derivedKeys) {
+static void nfc3d_amiibo_keygen(nfc3d_keygen_ctx *masterKeys, const uint8_t *dump, nfc3d_keygen_derivedkeys *derivedKeys) {
     uint8_t seed[NFC3D_KEYGEN_SEED_SIZE];
 
     nfc3d_amiibo_calc_seed(dump, seed);
-    nfc3d_keygen(masterKeys, seed, derivedKeys);
+    nfc3d_keygen_ctx_derive(masterKeys, seed, derivedKeys);
 }
 
 static void nfc3d_amiibo_cipher(const nfc3d_keygen_derivedkeys *keys, const uint8_t *in, uint8_t *out) {
@@ -67,7 +68,32 @@ static void nfc3d_amiibo_internal_to_tag(const uint8_t *intl, uint8_t *tag) {
     memcpy(tag + 0x054, intl + 0x1DC, 0x02C);
 }
 
+void nfc3d_amiibo_ctx_init(nfc3d_amiibo_ctx *ctx, const nfc3d_amiibo_keys *amiiboKeys) {
+    nfc3d_keygen_ctx_init(&ctx->data, &amiiboKeys->data);
+    nfc3d_keygen_ctx_init(&ctx->tag, &amiiboKeys->tag);
+}
+
+void nfc3d_amiibo_ctx_free(nfc3d_amiibo_ctx *ctx) {
+    nfc3d_keygen_ctx_free(&ctx->data);
+    nfc3d_keygen_ctx_free(&ctx->tag);
+}
+
 bool nfc3d_amiibo_unpack(const nfc3d_amiibo_keys *amiiboKeys, const uint8_t *tag, uint8_t *plain) {
+    nfc3d_amiibo_ctx ctx;
+    nfc3d_amiibo_ctx_init(&ctx, amiiboKeys);
+    bool res = nfc3d_amiibo_unpack_ctx(&ctx, tag, plain);
+    nfc3d_amiibo_ctx_free(&ctx);
+    return res;
+}
+
+void nfc3d_amiibo_pack(const nfc3d_amiibo_keys *amiiboKeys, const uint8_t *plain, uint8_t *tag) {
+    nfc3d_amiibo_ctx ctx;
+    nfc3d_amiibo_ctx_init(&ctx, amiiboKeys);
+    nfc3d_amiibo_pack_ctx(&ctx, plain, tag);
+    nfc3d_amiibo_ctx_free(&ctx);
+}
+
+bool nfc3d_amiibo_unpack_ctx(nfc3d_amiibo_ctx *amiiboKeys, const uint8_t *tag, uint8_t *plain) {
     uint8_t internal[NFC3D_AMIIBO_SIZE];
     nfc3d_keygen_derivedkeys dataKeys;
     nfc3d_keygen_derivedkeys tagKeys;
@@ -95,7 +121,7 @@ bool nfc3d_amiibo_unpack(const nfc3d_amiibo_keys *amiiboKeys, const uint8_t *tag
         memcmp(plain + HMAC_POS_TAG, internal + HMAC_POS_TAG, 32) == 0;
 }
 
-void nfc3d_amiibo_pack(const nfc3d_amiibo_keys *amiiboKeys, const uint8_t *plain, uint8_t *tag) {
+void nfc3d_amiibo_pack_ctx(nfc3d_amiibo_ctx *amiiboKeys, const uint8_t *plain, uint8_t *tag) {
     uint8_t cipher[NFC3D_AMIIBO_SIZE];
     nfc3d_keygen_derivedkeys tagKeys;
     nfc3d_keygen_derivedkeys dataKeys;
@@ -131,13 +157,94 @@ void nfc3d_amiibo_pack(const nfc3d_amiibo_keys *amiiboKeys, const uint8_t *plain
     nfc3d_amiibo_internal_to_tag(cipher, tag);
 }
 
+typedef struct {
+    const nfc3d_amiibo_keys *amiiboKeys;
+    bool pack;
+    const uint8_t *in;
+    uint8_t *out;
+    bool *ok;
+    size_t count;
+    size_t next;
+    size_t good;
+    pthread_mutex_t lock;
+} nfc3d_amiibo_batch_t;
+
+// takes dumps off the batch until none is left, with master key contexts set up once per thread
+static void *nfc3d_amiibo_batch_thread(void *arg) {
+    nfc3d_amiibo_batch_t *b = (nfc3d_amiibo_batch_t *)arg;
+    nfc3d_amiibo_ctx ctx;
+    nfc3d_amiibo_ctx_init(&ctx, b->amiiboKeys);
+
+    size_t good = 0;
+    for (;;) {
+        pthread_mutex_lock(&b->lock);
+        size_t i = b->next++;
+        pthread_mutex_unlock(&b->lock);
+        if (i >= b->count)
+            break;
+
+        const uint8_t *in = b->in + i * NFC3D_AMIIBO_SIZE;
+        uint8_t *out = b->out + i * NFC3D_AMIIBO_SIZE;
+        bool ok = true;
+        if (b->pack)
+            nfc3d_amiibo_pack_ctx(&ctx, in, out);
+        else
+            ok = nfc3d_amiibo_unpack_ctx(&ctx, in, out);
+
+        if (b->ok)
+            b->ok[i] = ok;
+        if (ok)
+            good++;
+    }
+
+    nfc3d_amiibo_ctx_free(&ctx);
+
+    pthread_mutex_lock(&b->lock);
+    b->good += good;
+    pthread_mutex_unlock(&b->lock);
+    return NULL;
+}
+
+size_t nfc3d_amiibo_batch(const nfc3d_amiibo_keys *amiiboKeys, bool pack, const uint8_t *in, uint8_t *out, bool *ok, size_t count, unsigned int threads) {
+    nfc3d_amiibo_batch_t b = {
+        .amiiboKeys = amiiboKeys,
+        .pack = pack,
+        .in = in,
+        .out = out,
+        .ok = ok,
+        .count = count,
+    };
+    pthread_mutex_init(&b.lock, NULL);
+
+    pthread_t tid[NFC3D_AMIIBO_MAX_THREADS];
+    unsigned int n = threads;
+    if (n > NFC3D_AMIIBO_MAX_THREADS)
+        n = NFC3D_AMIIBO_MAX_THREADS;
+    if (n > count)
+        n = count;
+
+    unsigned int started = 0;
+    while (started < n && pthread_create(&tid[started], NULL, nfc3d_amiibo_batch_thread, &b) == 0)
+        started++;
+
+    // no thread at all, do everything here
+    if (started == 0)
+        nfc3d_amiibo_batch_thread(&b);
+
+    for (unsigned int i = 0; i < started; i++)
+        pthread_join(tid[i], NULL);
+
+    pthread_mutex_destroy(&b.lock);
+    return b.good;
+}
+
 bool nfc3d_amiibo_load_keys(nfc3d_amiibo_keys *amiiboKeys, const char *path) {
     FILE *f = fopen(path, "rb");
     if (!f) {
         return false;
     }
 
-    size_t len = fread(amiiboKeys, sizeof(*amiiboKeys), 1, f);
+    size_t len = fread(amiiboKeys, 1, sizeof(*amiiboKeys), f);
     fclose(f);
 
     if (len != sizeof(*amiiboKeys)) {
@@ -23,8 +23,23 @@ typedef struct {
 } nfc3d_amiibo_keys;
 #pragma pack()
 
+// the master keys with their HMAC contexts keyed once, one per thread
+typedef struct {
+    nfc3d_keygen_ctx data;
+    nfc3d_keygen_ctx tag;
+} nfc3d_amiibo_ctx;
+
+#define NFC3D_AMIIBO_MAX_THREADS 64
+
 bool nfc3d_amiibo_unpack(const nfc3d_amiibo_keys *amiiboKeys, const uint8_t *tag, uint8_t *plain);
 void nfc3d_amiibo_pack(const nfc3d_amiibo_keys *amiiboKeys, const uint8_t *plain, uint8_t *tag);
+void nfc3d_amiibo_ctx_init(nfc3d_amiibo_ctx *ctx, const nfc3d_amiibo_keys *amiiboKeys);
+void nfc3d_amiibo_ctx_free(nfc3d_amiibo_ctx *ctx);
+bool nfc3d_amiibo_unpack_ctx(nfc3d_amiibo_ctx *ctx, const uint8_t *tag, uint8_t *plain);
+void nfc3d_amiibo_pack_ctx(nfc3d_amiibo_ctx *ctx, const uint8_t *plain, uint8_t *tag);
+// Unpacks (or packs) count dumps of NFC3D_AMIIBO_SIZE bytes from in to out on up to threads threads.
+// ok[i], if not NULL, tells whether the HMACs of dump i were right. Returns how many were
+size_t nfc3d_amiibo_batch(const nfc3d_amiibo_keys *amiiboKeys, bool pack, const uint8_t *in, uint8_t *out, bool *ok, size_t count, unsigned int threads);
 bool nfc3d_amiibo_load_keys(nfc3d_amiibo_keys *amiiboKeys, const char *path);
 void nfc3d_amiibo_copy_app_data(const uint8_t *src, uint8_t *dst);
 
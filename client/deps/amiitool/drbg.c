@@ -76,3 +76,34 @@ void nfc3d_drbg_generate_bytes(const uint8_t *hmacKey, size_t hmacKeySize, const
 
     nfc3d_drbg_cleanup(&rngCtx);
 }
+
+void nfc3d_drbg_generate_bytes_ctx(mbedtls_md_context_t *hmacCtx, const uint8_t *seed, size_t seedSize, uint8_t *output, size_t outputSize) {
+    assert(hmacCtx != NULL);
+    assert(seed != NULL);
+    assert(seedSize <= NFC3D_DRBG_MAX_SEED_SIZE);
+
+    uint8_t buffer[sizeof(uint16_t) + NFC3D_DRBG_MAX_SEED_SIZE];
+    uint8_t temp[NFC3D_DRBG_OUTPUT_SIZE];
+    uint16_t iteration = 0;
+
+    memcpy(buffer + sizeof(uint16_t), seed, seedSize);
+
+    while (outputSize > 0) {
+        buffer[0] = iteration >> 8;
+        buffer[1] = iteration >> 0;
+        iteration++;
+
+        mbedtls_md_hmac_reset(hmacCtx);
+        mbedtls_md_hmac_update(hmacCtx, buffer, sizeof(uint16_t) + seedSize);
+
+        if (outputSize < NFC3D_DRBG_OUTPUT_SIZE) {
+            mbedtls_md_hmac_finish(hmacCtx, temp);
+            memcpy(output, temp, outputSize);
+            break;
+        }
+
+        mbedtls_md_hmac_finish(hmacCtx, output);
+        output += NFC3D_DRBG_OUTPUT_SIZE;
+        outputSize -= NFC3D_DRBG_OUTPUT_SIZE;
+    }
+}
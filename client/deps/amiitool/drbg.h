@@ -28,6 +28,8 @@ void nfc3d_drbg_init(nfc3d_drbg_ctx *ctx, const uint8_t *hmacKey, size_t hmacKey
 void nfc3d_drbg_step(nfc3d_drbg_ctx *ctx, uint8_t *output);
 void nfc3d_drbg_cleanup(nfc3d_drbg_ctx *ctx);
 void nfc3d_drbg_generate_bytes(const uint8_t *hmacKey, size_t hmacKeySize, const uint8_t *seed, size_t seedSize, uint8_t *output, size_t outputSize);
+// same with an HMAC context mbedtls_md_hmac_starts() already ran on with the key, it is reset and reused
+void nfc3d_drbg_generate_bytes_ctx(mbedtls_md_context_t *hmacCtx, const uint8_t *seed, size_t seedSize, uint8_t *output, size_t outputSize);
 
 #endif
 
@@ -51,3 +51,26 @@ void nfc3d_keygen(const nfc3d_keygen_masterkeys *baseKeys, const uint8_t *baseSe
     nfc3d_keygen_prepare_seed(baseKeys, baseSeed, preparedSeed, &preparedSeedSize);
     nfc3d_drbg_generate_bytes(baseKeys->hmacKey, sizeof(baseKeys->hmacKey), preparedSeed, preparedSeedSize, (uint8_t *) derivedKeys, sizeof(*derivedKeys));
 }
+
+void nfc3d_keygen_ctx_init(nfc3d_keygen_ctx *ctx, const nfc3d_keygen_masterkeys *baseKeys) {
+    assert(ctx != NULL);
+    assert(baseKeys != NULL);
+
+    ctx->baseKeys = baseKeys;
+    mbedtls_md_init(&ctx->hmacCtx);
+    mbedtls_md_setup(&ctx->hmacCtx, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 1);
+    mbedtls_md_hmac_starts(&ctx->hmacCtx, baseKeys->hmacKey, sizeof(baseKeys->hmacKey));
+}
+
+void nfc3d_keygen_ctx_derive(nfc3d_keygen_ctx *ctx, const uint8_t *baseSeed, nfc3d_keygen_derivedkeys *derivedKeys) {
+    uint8_t preparedSeed[NFC3D_DRBG_MAX_SEED_SIZE];
+    size_t preparedSeedSize;
+
+    nfc3d_keygen_prepare_seed(ctx->baseKeys, baseSeed, preparedSeed, &preparedSeedSize);
+    nfc3d_drbg_generate_bytes_ctx(&ctx->hmacCtx, preparedSeed, preparedSeedSize, (uint8_t *) derivedKeys, sizeof(*derivedKeys));
+}
+
+void nfc3d_keygen_ctx_free(nfc3d_keygen_ctx *ctx) {
+    assert(ctx != NULL);
+    mbedtls_md_free(&ctx->hmacCtx);
+}
@@ -9,6 +9,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "mbedtls/md.h"
 
 #define NFC3D_KEYGEN_SEED_SIZE 64
 
@@ -29,6 +30,15 @@ typedef struct {
 } nfc3d_keygen_derivedkeys;
 #pragma pack()
 
+// master keys with their HMAC context keyed once, for deriving the keys of many dumps. One per thread
+typedef struct {
+    const nfc3d_keygen_masterkeys *baseKeys;
+    mbedtls_md_context_t hmacCtx;
+} nfc3d_keygen_ctx;
+
 void nfc3d_keygen(const nfc3d_keygen_masterkeys *baseKeys, const uint8_t *baseSeed, nfc3d_keygen_derivedkeys *derivedKeys);
+void nfc3d_keygen_ctx_init(nfc3d_keygen_ctx *ctx, const nfc3d_keygen_masterkeys *baseKeys);
+void nfc3d_keygen_ctx_derive(nfc3d_keygen_ctx *ctx, const uint8_t *baseSeed, nfc3d_keygen_derivedkeys *derivedKeys);
+void nfc3d_keygen_ctx_free(nfc3d_keygen_ctx *ctx);
 
 #endif
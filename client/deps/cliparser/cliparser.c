@@ -15,6 +15,15 @@
 # define ARRAYLEN(x) (sizeof(x)/sizeof((x)[0]))
 #endif
 
+#define CLI_CACHE_SLOTS     32
+#define CLI_PRESET_ARGS     200
+
+// contexts of CLIParserInitCached, by program name
+static CLIParserContext *cli_cache[CLI_CACHE_SLOTS];
+
+static int preset_argc = -1;
+static const char *preset_argv[CLI_PRESET_ARGS];
+
 int CLIParserInit(CLIParserContext **ctx, const char *vprogramName, const char *vprogramHint, const char *vprogramHelp) {
     *ctx = malloc(sizeof(CLIParserContext));
     if (!*ctx) {
@@ -27,13 +36,71 @@ int CLIParserInit(CLIParserContext **ctx, const char *vprogramName, const char *
     (*ctx)->programName = vprogramName;
     (*ctx)->programHint = vprogramHint;
     (*ctx)->programHelp = vprogramHelp;
+    (*ctx)->cached = false;
+    (*ctx)->busy = false;
+    (*ctx)->table_copy = false;
     memset((*ctx)->buf, 0x00, sizeof((*ctx)->buf));
     return 0;
 }
 
+// Same as CLIParserInit, but the context and its argtable are kept for the next call of the
+// command. A context in use, a command calling itself, gets a new one as CLIParserInit.
+int CLIParserInitCached(CLIParserContext **ctx, const char *vprogramName, const char *vprogramHint, const char *vprogramHelp) {
+    for (int i = 0; i < CLI_CACHE_SLOTS && cli_cache[i]; i++) {
+        if (strcmp(cli_cache[i]->programName, vprogramName) == 0) {
+            if (cli_cache[i]->busy)
+                break;
+            cli_cache[i]->busy = true;
+            *ctx = cli_cache[i];
+            return 0;
+        }
+    }
+    return CLIParserInit(ctx, vprogramName, vprogramHint, vprogramHelp);
+}
+
+// The argtable of a CLIParserCachedTable is a local array, its entries are copied to the heap.
+// Into the cache if there is room and the command is not there yet.
+void CLIParserKeepTable(CLIParserContext *ctx, void *vargtable[], size_t vargtableLen) {
+    ctx->argtable = malloc(vargtableLen * sizeof(void *));
+    if (ctx->argtable == NULL) {
+        printf("ERROR: Insufficient memory\n");
+        fflush(stdout);
+        arg_freetable(vargtable, vargtableLen);
+        return;
+    }
+    memcpy(ctx->argtable, vargtable, vargtableLen * sizeof(void *));
+    ctx->argtableLen = vargtableLen;
+    ctx->table_copy = true;
+
+    for (int i = 0; i < CLI_CACHE_SLOTS; i++) {
+        if (cli_cache[i] == NULL) {
+            ctx->cached = true;
+            ctx->busy = true;
+            cli_cache[i] = ctx;
+            return;
+        }
+        if (strcmp(cli_cache[i]->programName, ctx->programName) == 0)
+            return;
+    }
+}
+
+void CLIParserRelease(CLIParserContext *ctx) {
+    if (ctx->cached) {
+        ctx->busy = false;
+        return;
+    }
+    arg_freetable(ctx->argtable, ctx->argtableLen);
+    if (ctx->table_copy)
+        free(ctx->argtable);
+    free(ctx);
+}
+
 int CLIParserParseArg(CLIParserContext *ctx, int argc, char **argv, void *vargtable[], size_t vargtableLen, bool allowEmptyExec) {
     int nerrors;
 
+    if (vargtable == NULL)
+        return 2;
+
     ctx->argtable = vargtable;
     ctx->argtableLen = vargtableLen;
 
@@ -86,10 +153,27 @@ int CLIParserParseString(CLIParserContext *ctx, const char *str, void *vargtable
     return CLIParserParseStringEx(ctx, str, vargtable, vargtableLen, allowEmptyExec, false);
 }
 
+void CLIParserPresetArgs(int argc, const char **argv) {
+    if (argc > CLI_PRESET_ARGS - 1)
+        argc = CLI_PRESET_ARGS - 1;
+    preset_argc = argc;
+    for (int i = 0; i < argc; i++)
+        preset_argv[i] = argv[i];
+}
+
 int CLIParserParseStringEx(CLIParserContext *ctx, const char *str, void *vargtable[], size_t vargtableLen, bool allowEmptyExec, bool clueData) {
     int argc = 0;
     char *argv[200] = {NULL};
 
+    // tokens of CLIParserPresetArgs, for this parse only
+    if (preset_argc >= 0) {
+        argv[argc++] = (char *)ctx->programName;
+        for (int i = 0; i < preset_argc; i++)
+            argv[argc++] = (char *)preset_argv[i];
+        preset_argc = -1;
+        return CLIParserParseArg(ctx, argc, argv, vargtable, vargtableLen, allowEmptyExec);
+    }
+
     int len = strlen(str);
     memset(ctx->buf, 0x00, ARRAYLEN(ctx->buf));
     char *bufptr = ctx->buf;
@@ -28,8 +28,11 @@
 #define arg_strx1(shortopts, longopts, datatype, glossary) (arg_strn((shortopts), (longopts), (datatype), 1, 250, (glossary)))
 #define arg_strx0(shortopts, longopts, datatype, glossary) (arg_strn((shortopts), (longopts), (datatype), 0, 250, (glossary)))
 
-#define CLIParserFree(ctx)        if ((ctx)) {arg_freetable(ctx->argtable, ctx->argtableLen); free((ctx)); (ctx)=NULL;}
+#define CLIParserFree(ctx)        if ((ctx)) {CLIParserRelease((ctx)); (ctx)=NULL;}
 #define CLIExecWithReturn(ctx, cmd, atbl, ifempty)    if (CLIParserParseString(ctx, cmd, atbl, arg_getsize(atbl), ifempty)) {CLIParserFree((ctx)); return PM3_ESOFT;}
+// for a context of CLIParserInitCached, the argtable is built on the first call only and kept
+#define CLIParserCachedTable(ctx, ...) if ((ctx)->argtable == NULL) {void *atbl_[] = {__VA_ARGS__}; CLIParserKeepTable((ctx), atbl_, arg_getsize(atbl_));}
+#define CLIExecCachedWithReturn(ctx, cmd, ifempty)    if (CLIParserParseString(ctx, cmd, (ctx)->argtable, (ctx)->argtableLen, ifempty)) {CLIParserFree((ctx)); return PM3_ESOFT;}
 #define CLIGetHexBLessWithReturn(ctx, paramnum, data, datalen, delta) if (CLIParamHexToBuf(arg_get_str(ctx, paramnum), data, sizeof(data) - (delta), datalen)) {CLIParserFree((ctx)); return PM3_ESOFT;}
 #define CLIGetHexWithReturn(ctx, paramnum, data, datalen) if (CLIParamHexToBuf(arg_get_str(ctx, paramnum), data, sizeof(data), datalen)) {CLIParserFree((ctx)); return PM3_ESOFT;}
 #define CLIGetStrWithReturn(ctx, paramnum, data, datalen) if (CLIParamStrToBuf(arg_get_str(ctx, paramnum), data, sizeof(data), datalen)) {CLIParserFree((ctx)); return PM3_ESOFT;}
@@ -41,8 +44,17 @@ typedef struct {
     const char *programHint;
     const char *programHelp;
     char buf[1024 + 60];
+    bool cached;        // kept by CLIParserInitCached, the argtable with it
+    bool busy;
+    bool table_copy;    // argtable copied to the heap by CLIParserKeepTable
 } CLIParserContext;
 int CLIParserInit(CLIParserContext **ctx, const char *vprogramName, const char *vprogramHint, const char *vprogramHelp);
+int CLIParserInitCached(CLIParserContext **ctx, const char *vprogramName, const char *vprogramHint, const char *vprogramHelp);
+void CLIParserKeepTable(CLIParserContext *ctx, void *vargtable[], size_t vargtableLen);
+void CLIParserRelease(CLIParserContext *ctx);
+// the next parse takes these tokens as they are instead of splitting its string, for Lua / JNI callers.
+// The strings must live until the command is done, argc -1 drops them
+void CLIParserPresetArgs(int argc, const char **argv);
 int CLIParserParseString(CLIParserContext *ctx, const char *str, void *vargtable[], size_t vargtableLen, bool allowEmptyExec);
 int CLIParserParseStringEx(CLIParserContext *ctx, const char *str, void *vargtable[], size_t vargtableLen, bool allowEmptyExec, bool clueData);
 int CLIParserParseArg(CLIParserContext *ctx, int argc, char **argv, void *vargtable[], size_t vargtableLen, bool allowEmptyExec);
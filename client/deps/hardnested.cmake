@@ -14,6 +14,8 @@ target_include_directories(pm3rrg_rdv4_hardnested_nosimd PRIVATE
 ## These are mostly for x86-based architectures, which is not useful for many Android devices.
 ## Mingw platforms: AMD64
 set(X86_CPUS x86 x86_64 i686 AMD64)
+## Raspberry Pi 64 bit, Apple Silicon, arm64 Android: NEON is always there
+set(ARM64_CPUS aarch64 arm64 ARM64)
 
 message(STATUS "CMAKE_SYSTEM_PROCESSOR := ${CMAKE_SYSTEM_PROCESSOR}")
 
@@ -104,13 +106,43 @@ if ("${CMAKE_SYSTEM_PROCESSOR}" IN_LIST X86_CPUS)
             $<TARGET_OBJECTS:pm3rrg_rdv4_hardnested_avx>
             $<TARGET_OBJECTS:pm3rrg_rdv4_hardnested_avx2>
             $<TARGET_OBJECTS:pm3rrg_rdv4_hardnested_avx512>)
+elseif ("${CMAKE_SYSTEM_PROCESSOR}" IN_LIST ARM64_CPUS)
+    message(STATUS "Building optimised arm64 binaries")
+
+    target_compile_options(pm3rrg_rdv4_hardnested_nosimd BEFORE PRIVATE
+            -DNOSIMD_BUILD -fno-tree-vectorize)
+
+    ## arm64 / NEON
+    add_library(pm3rrg_rdv4_hardnested_neon OBJECT
+            hardnested/hardnested_bf_core.c
+            hardnested/hardnested_bitarray_core.c)
+
+    target_compile_options(pm3rrg_rdv4_hardnested_neon PRIVATE -Wall -Werror -O3)
+    set_property(TARGET pm3rrg_rdv4_hardnested_neon PROPERTY POSITION_INDEPENDENT_CODE ON)
+
+    target_include_directories(pm3rrg_rdv4_hardnested_neon PRIVATE
+            ../../common
+            ../../include
+            ../src)
+
+    set(SIMD_TARGETS
+            $<TARGET_OBJECTS:pm3rrg_rdv4_hardnested_neon>)
 else ()
     message(STATUS "Not building optimised targets")
     set(SIMD_TARGETS)
 endif ()
 
+## optional OpenCL backend, only the dispatcher in the nosimd object refers to it
+if ((NOT SKIPOPENCL EQUAL 1) AND (OpenCL_FOUND))
+    set(OPENCL_SOURCES hardnested/hardnested_bf_opencl.c)
+    target_compile_definitions(pm3rrg_rdv4_hardnested_nosimd PRIVATE HAVE_OPENCL)
+else ()
+    set(OPENCL_SOURCES)
+endif ()
+
 add_library(pm3rrg_rdv4_hardnested STATIC
         hardnested/hardnested_bruteforce.c
+        ${OPENCL_SOURCES}
         $<TARGET_OBJECTS:pm3rrg_rdv4_hardnested_nosimd>
         ${SIMD_TARGETS})
 target_compile_options(pm3rrg_rdv4_hardnested PRIVATE -Wall -Werror -O3)
@@ -121,3 +153,7 @@ target_include_directories(pm3rrg_rdv4_hardnested PRIVATE
         ../src
         jansson)
 target_include_directories(pm3rrg_rdv4_hardnested INTERFACE hardnested)
+if (OPENCL_SOURCES)
+    target_compile_definitions(pm3rrg_rdv4_hardnested PRIVATE HAVE_OPENCL)
+    target_include_directories(pm3rrg_rdv4_hardnested PRIVATE ${OpenCL_INCLUDE_DIRS})
+endif ()
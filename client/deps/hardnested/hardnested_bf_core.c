@@ -74,6 +74,8 @@ THE SOFTWARE.
 #define MAX_BITSLICES 128
 #elif defined(__SSE2__)
 #define MAX_BITSLICES 128
+#elif defined(BUILD_NEON)
+#define MAX_BITSLICES 128
 #else // MMX or SSE or NOSIMD
 #define MAX_BITSLICES 64
 #endif
@@ -118,6 +120,9 @@ typedef union {
 #elif defined (__MMX__)
 #define BITSLICE_TEST_NONCES bitslice_test_nonces_MMX
 #define CRACK_STATES_BITSLICED crack_states_bitsliced_MMX
+#elif defined (BUILD_NEON)
+#define BITSLICE_TEST_NONCES bitslice_test_nonces_NEON
+#define CRACK_STATES_BITSLICED crack_states_bitsliced_NEON
 #else
 #define BITSLICE_TEST_NONCES bitslice_test_nonces_NOSIMD
 #define CRACK_STATES_BITSLICED crack_states_bitsliced_NOSIMD
@@ -130,6 +135,7 @@ crack_states_bitsliced_t crack_states_bitsliced_AVX2;
 crack_states_bitsliced_t crack_states_bitsliced_AVX;
 crack_states_bitsliced_t crack_states_bitsliced_SSE2;
 crack_states_bitsliced_t crack_states_bitsliced_MMX;
+crack_states_bitsliced_t crack_states_bitsliced_NEON;
 crack_states_bitsliced_t crack_states_bitsliced_NOSIMD;
 crack_states_bitsliced_t crack_states_bitsliced_dispatch;
 
@@ -139,6 +145,7 @@ bitslice_test_nonces_t bitslice_test_nonces_AVX2;
 bitslice_test_nonces_t bitslice_test_nonces_AVX;
 bitslice_test_nonces_t bitslice_test_nonces_SSE2;
 bitslice_test_nonces_t bitslice_test_nonces_MMX;
+bitslice_test_nonces_t bitslice_test_nonces_NEON;
 bitslice_test_nonces_t bitslice_test_nonces_NOSIMD;
 bitslice_test_nonces_t bitslice_test_nonces_dispatch;
 
@@ -541,7 +548,11 @@ out:
 
 
 
-#ifndef __MMX__
+#if !defined(__MMX__) && !defined(BUILD_NEON)
+
+#if defined(HAVE_OPENCL)
+#include "hardnested_bf_opencl.h"
+#endif
 
 // pointers to functions:
 crack_states_bitsliced_t *crack_states_bitsliced_function_p = &crack_states_bitsliced_dispatch;
@@ -575,7 +586,11 @@ static SIMDExecInstr GetSIMDInstr(void) {
             instr = SIMD_MMX;
         else
 #endif
+#if defined(COMPILER_HAS_SIMD_NEON)
+            instr = SIMD_NEON;
+#else
             instr = SIMD_NONE;
+#endif
 
     return instr;
 }
@@ -609,6 +624,18 @@ uint64_t crack_states_bitsliced_dispatch(uint32_t cuid, uint8_t *best_first_byte
         case SIMD_MMX:
             crack_states_bitsliced_function_p = &crack_states_bitsliced_MMX;
             break;
+#endif
+#if defined(COMPILER_HAS_SIMD_NEON)
+        case SIMD_NEON:
+            crack_states_bitsliced_function_p = &crack_states_bitsliced_NEON;
+            break;
+#endif
+#if defined(HAVE_OPENCL)
+        case SIMD_OPENCL:
+            crack_states_bitsliced_function_p = &crack_states_bitsliced_OPENCL;
+            break;
+#else
+        case SIMD_OPENCL:
 #endif
         case SIMD_AUTO:
         case SIMD_NONE:
@@ -640,6 +667,18 @@ void bitslice_test_nonces_dispatch(uint32_t nonces_to_bruteforce, uint32_t *bf_t
         case SIMD_MMX:
             bitslice_test_nonces_function_p = &bitslice_test_nonces_MMX;
             break;
+#endif
+#if defined(COMPILER_HAS_SIMD_NEON)
+        case SIMD_NEON:
+            bitslice_test_nonces_function_p = &bitslice_test_nonces_NEON;
+            break;
+#endif
+#if defined(HAVE_OPENCL)
+        case SIMD_OPENCL:
+            bitslice_test_nonces_function_p = &bitslice_test_nonces_OPENCL;
+            break;
+#else
+        case SIMD_OPENCL:
 #endif
         case SIMD_AUTO:
         case SIMD_NONE:
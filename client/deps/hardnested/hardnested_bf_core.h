@@ -61,6 +61,15 @@ THE SOFTWARE.
 #  endif
 #endif
 
+// NEON is always there on aarch64. The sources are built twice, the plain
+// build (-DNOSIMD_BUILD) holds the dispatchers
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#  define COMPILER_HAS_SIMD_NEON
+#  if !defined(NOSIMD_BUILD)
+#    define BUILD_NEON
+#  endif
+#endif
+
 typedef enum {
     SIMD_AUTO,
 #if defined(COMPILER_HAS_SIMD_AVX512)
@@ -72,6 +81,10 @@ typedef enum {
     SIMD_SSE2,
     SIMD_MMX,
 #endif
+#if defined(COMPILER_HAS_SIMD_NEON)
+    SIMD_NEON,
+#endif
+    SIMD_OPENCL,    // only when built with HAVE_OPENCL, never picked by SIMD_AUTO
     SIMD_NONE,
 } SIMDExecInstr;
 void SetSIMDInstr(SIMDExecInstr instr);
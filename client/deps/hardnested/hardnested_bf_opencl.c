@@ -0,0 +1,341 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// OpenCL backend for the hardnested brute force phase
+//
+// One work item per odd/even state pair of a bucket. Like the bitsliced CPU
+// code it starts with the best first byte already shifted in and checks the
+// parity of the remaining three bytes of the test nonces. The few surviving
+// pairs are sent back and verified on the host with verify_key().
+//
+// Only one device is used, brute force threads take turns on it.
+//-----------------------------------------------------------------------------
+
+#include "hardnested_bf_opencl.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define CL_TARGET_OPENCL_VERSION 120
+#if defined(__APPLE__)
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "crapto1/crapto1.h"
+#include "ui.h"             // PrintAndLogEx
+
+// pairs per kernel launch, and reported survivors per launch
+#define OPENCL_MAX_PAIRS    (1 << 24)
+#define OPENCL_MAX_FOUND    (1 << 16)
+#define OPENCL_MAX_NONCES   256
+
+typedef enum {
+    EVEN_STATE = 0,
+    ODD_STATE = 1
+} odd_even_t;
+
+static const char *hardnested_kernel_source =
+    "#define LF_POLY_ODD  (0x29CE5C)\n"
+    "#define LF_POLY_EVEN (0x870804)\n"
+    "\n"
+    "inline uint filter(uint x) {\n"
+    "    uint f;\n"
+    "    f  = 0xf22c0 >> (x       & 0xf) & 16;\n"
+    "    f |= 0x6c9c0 >> (x >>  4 & 0xf) &  8;\n"
+    "    f |= 0x3c8b0 >> (x >>  8 & 0xf) &  4;\n"
+    "    f |= 0x1e458 >> (x >> 12 & 0xf) &  2;\n"
+    "    f |= 0x0d938 >> (x >> 16 & 0xf) &  1;\n"
+    "    return (0xEC57E80A >> f) & 1;\n"
+    "}\n"
+    "\n"
+    "__kernel void crack_states(__global const uint *odd, uint odd_start,\n"
+    "                           __global const uint *even, uint even_start, uint even_cnt,\n"
+    "                           __global const uint *nonces, __global const uchar *nonces_par, uint nonce_cnt,\n"
+    "                           __global volatile uint *found_cnt, __global uint2 *found, uint found_max) {\n"
+    "\n"
+    "    uint e_idx = get_global_id(0);\n"
+    "    if (e_idx >= even_cnt)\n"
+    "        return;\n"
+    "\n"
+    "    uint o0 = odd[odd_start + get_global_id(1)];\n"
+    "    uint e0 = even[even_start + e_idx];\n"
+    "\n"
+    "    for (uint t = 0; t < nonce_cnt; t++) {\n"
+    "        uint o = o0, e = e0;\n"
+    "        uint enc = nonces[t];\n"
+    "        uint par = nonces_par[t];\n"
+    "        // first byte is already shifted in\n"
+    "        for (int byte_pos = 2; byte_pos >= 0; byte_pos--) {\n"
+    "            uint enc_byte = (enc >> (8 * byte_pos)) & 0xff;\n"
+    "            uint p = 0;\n"
+    "            for (int i = 0; i < 8; i++) {\n"
+    "                uint dec = ((enc_byte >> i) & 1) ^ filter(o);\n"
+    "                p ^= dec;\n"
+    "                uint fb = (popcount((o & LF_POLY_ODD) ^ (e & LF_POLY_EVEN)) & 1) ^ dec;\n"
+    "                uint t_ = o;\n"
+    "                o = ((e << 1) | fb) & 0xffffff;\n"
+    "                e = t_;\n"
+    "            }\n"
+    "            if ((((par >> byte_pos) & 1) ^ filter(o)) != p)\n"
+    "                return;\n"
+    "        }\n"
+    "    }\n"
+    "\n"
+    "    uint slot = atomic_inc(found_cnt);\n"
+    "    if (slot < found_max)\n"
+    "        found[slot] = (uint2)(o0, e0);\n"
+    "}\n";
+
+typedef struct {
+    bool init_done;
+    bool available;
+    cl_device_id device;
+    cl_context context;
+    cl_command_queue queue;
+    cl_program program;
+    cl_kernel kernel;
+    cl_mem nonces;
+    cl_mem nonces_par;
+    cl_mem found_cnt;
+    cl_mem found;
+    cl_mem states[2];
+    size_t states_size[2];
+} opencl_ctx_t;
+
+static opencl_ctx_t ctx;
+static pthread_mutex_t opencl_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint32_t test_nonces_cnt = 0;
+static uint32_t test_nonces[OPENCL_MAX_NONCES];
+static uint8_t test_nonces_par[OPENCL_MAX_NONCES];
+
+// CPU fallback when there is no usable OpenCL device
+uint64_t crack_states_bitsliced_NOSIMD(uint32_t cuid, uint8_t *best_first_bytes, statelist_t *p, uint32_t *keys_found, uint64_t *num_keys_tested, uint32_t nonces_to_bruteforce, uint8_t *bf_test_nonce_2nd_byte, noncelist_t *nonces);
+void bitslice_test_nonces_NOSIMD(uint32_t nonces_to_bruteforce, uint32_t *bf_test_nonce, uint8_t *bf_test_nonce_par);
+
+static bool opencl_init(void) {
+
+    if (ctx.init_done)
+        return ctx.available;
+    ctx.init_done = true;
+
+    cl_int err;
+    cl_platform_id platform;
+    if (clGetPlatformIDs(1, &platform, NULL) != CL_SUCCESS) {
+        PrintAndLogEx(WARNING, "OpenCL: no platform found, using CPU");
+        return false;
+    }
+
+    if (clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &ctx.device, NULL) != CL_SUCCESS &&
+            clGetDeviceIDs(platform, CL_DEVICE_TYPE_ALL, 1, &ctx.device, NULL) != CL_SUCCESS) {
+        PrintAndLogEx(WARNING, "OpenCL: no device found, using CPU");
+        return false;
+    }
+
+    char name[128] = {0};
+    clGetDeviceInfo(ctx.device, CL_DEVICE_NAME, sizeof(name) - 1, name, NULL);
+
+    ctx.context = clCreateContext(NULL, 1, &ctx.device, NULL, NULL, &err);
+    if (err != CL_SUCCESS)
+        goto fail;
+
+    ctx.queue = clCreateCommandQueue(ctx.context, ctx.device, 0, &err);
+    if (err != CL_SUCCESS)
+        goto fail;
+
+    ctx.program = clCreateProgramWithSource(ctx.context, 1, &hardnested_kernel_source, NULL, &err);
+    if (err != CL_SUCCESS)
+        goto fail;
+
+    if (clBuildProgram(ctx.program, 1, &ctx.device, NULL, NULL, NULL) != CL_SUCCESS) {
+        char log[2048] = {0};
+        clGetProgramBuildInfo(ctx.program, ctx.device, CL_PROGRAM_BUILD_LOG, sizeof(log) - 1, log, NULL);
+        PrintAndLogEx(ERR, "OpenCL: kernel build failed\n%s", log);
+        goto fail;
+    }
+
+    ctx.kernel = clCreateKernel(ctx.program, "crack_states", &err);
+    if (err != CL_SUCCESS)
+        goto fail;
+
+    ctx.nonces = clCreateBuffer(ctx.context, CL_MEM_READ_ONLY, sizeof(test_nonces), NULL, &err);
+    if (err != CL_SUCCESS)
+        goto fail;
+    ctx.nonces_par = clCreateBuffer(ctx.context, CL_MEM_READ_ONLY, sizeof(test_nonces_par), NULL, &err);
+    if (err != CL_SUCCESS)
+        goto fail;
+    ctx.found_cnt = clCreateBuffer(ctx.context, CL_MEM_READ_WRITE, sizeof(cl_uint), NULL, &err);
+    if (err != CL_SUCCESS)
+        goto fail;
+    ctx.found = clCreateBuffer(ctx.context, CL_MEM_WRITE_ONLY, OPENCL_MAX_FOUND * sizeof(cl_uint2), NULL, &err);
+    if (err != CL_SUCCESS)
+        goto fail;
+
+    PrintAndLogEx(INFO, "OpenCL: brute forcing on " _YELLOW_("%s"), name);
+    ctx.available = true;
+    return true;
+
+fail:
+    PrintAndLogEx(WARNING, "OpenCL: device setup failed (%d), using CPU", err);
+    return false;
+}
+
+// copy a state list to the device, growing the buffer when needed
+static bool opencl_upload_states(int idx, const uint32_t *states, uint32_t len) {
+
+    size_t size = len * sizeof(uint32_t);
+    if (ctx.states_size[idx] < size) {
+        if (ctx.states[idx])
+            clReleaseMemObject(ctx.states[idx]);
+
+        cl_int err;
+        ctx.states[idx] = clCreateBuffer(ctx.context, CL_MEM_READ_ONLY, size, NULL, &err);
+        if (err != CL_SUCCESS) {
+            ctx.states[idx] = NULL;
+            ctx.states_size[idx] = 0;
+            return false;
+        }
+        ctx.states_size[idx] = size;
+    }
+    return clEnqueueWriteBuffer(ctx.queue, ctx.states[idx], CL_TRUE, 0, size, states, 0, NULL, NULL) == CL_SUCCESS;
+}
+
+// run one chunk, returns the number of survivors or -1 on error
+static int64_t opencl_run(uint32_t odd_start, uint32_t odd_cnt, uint32_t even_start, uint32_t even_cnt, cl_uint2 *found) {
+
+    cl_uint zero = 0;
+    cl_uint nonce_cnt = test_nonces_cnt;
+    cl_uint found_max = OPENCL_MAX_FOUND;
+
+    if (clEnqueueWriteBuffer(ctx.queue, ctx.found_cnt, CL_TRUE, 0, sizeof(zero), &zero, 0, NULL, NULL) != CL_SUCCESS)
+        return -1;
+
+    cl_int err;
+    err  = clSetKernelArg(ctx.kernel, 0, sizeof(cl_mem), &ctx.states[ODD_STATE]);
+    err |= clSetKernelArg(ctx.kernel, 1, sizeof(cl_uint), &odd_start);
+    err |= clSetKernelArg(ctx.kernel, 2, sizeof(cl_mem), &ctx.states[EVEN_STATE]);
+    err |= clSetKernelArg(ctx.kernel, 3, sizeof(cl_uint), &even_start);
+    err |= clSetKernelArg(ctx.kernel, 4, sizeof(cl_uint), &even_cnt);
+    err |= clSetKernelArg(ctx.kernel, 5, sizeof(cl_mem), &ctx.nonces);
+    err |= clSetKernelArg(ctx.kernel, 6, sizeof(cl_mem), &ctx.nonces_par);
+    err |= clSetKernelArg(ctx.kernel, 7, sizeof(cl_uint), &nonce_cnt);
+    err |= clSetKernelArg(ctx.kernel, 8, sizeof(cl_mem), &ctx.found_cnt);
+    err |= clSetKernelArg(ctx.kernel, 9, sizeof(cl_mem), &ctx.found);
+    err |= clSetKernelArg(ctx.kernel, 10, sizeof(cl_uint), &found_max);
+    if (err != CL_SUCCESS)
+        return -1;
+
+    size_t global[2] = { even_cnt, odd_cnt };
+    if (clEnqueueNDRangeKernel(ctx.queue, ctx.kernel, 2, NULL, global, NULL, 0, NULL, NULL) != CL_SUCCESS)
+        return -1;
+
+    cl_uint cnt = 0;
+    if (clEnqueueReadBuffer(ctx.queue, ctx.found_cnt, CL_TRUE, 0, sizeof(cnt), &cnt, 0, NULL, NULL) != CL_SUCCESS)
+        return -1;
+
+    if (cnt > 0 && cnt <= OPENCL_MAX_FOUND) {
+        if (clEnqueueReadBuffer(ctx.queue, ctx.found, CL_TRUE, 0, cnt * sizeof(cl_uint2), found, 0, NULL, NULL) != CL_SUCCESS)
+            return -1;
+    }
+    return cnt;
+}
+
+void bitslice_test_nonces_OPENCL(uint32_t nonces_to_bruteforce, uint32_t *bf_test_nonce, uint8_t *bf_test_nonce_par) {
+
+    test_nonces_cnt = MIN(nonces_to_bruteforce, OPENCL_MAX_NONCES);
+    memcpy(test_nonces, bf_test_nonce, test_nonces_cnt * sizeof(uint32_t));
+    memcpy(test_nonces_par, bf_test_nonce_par, test_nonces_cnt * sizeof(uint8_t));
+
+    // keep the CPU fallback ready
+    bitslice_test_nonces_NOSIMD(nonces_to_bruteforce, bf_test_nonce, bf_test_nonce_par);
+
+    pthread_mutex_lock(&opencl_lock);
+    if (opencl_init()) {
+        clEnqueueWriteBuffer(ctx.queue, ctx.nonces, CL_TRUE, 0, test_nonces_cnt * sizeof(uint32_t), test_nonces, 0, NULL, NULL);
+        clEnqueueWriteBuffer(ctx.queue, ctx.nonces_par, CL_TRUE, 0, test_nonces_cnt * sizeof(uint8_t), test_nonces_par, 0, NULL, NULL);
+    }
+    pthread_mutex_unlock(&opencl_lock);
+}
+
+uint64_t crack_states_bitsliced_OPENCL(uint32_t cuid, uint8_t *best_first_bytes, statelist_t *p, uint32_t *keys_found, uint64_t *num_keys_tested, uint32_t nonces_to_bruteforce, uint8_t *bf_test_nonce_2nd_byte, noncelist_t *nonces) {
+
+    uint64_t key = -1;
+    uint64_t bucket_states_tested = 0;
+    const uint32_t odd_len = p->len[ODD_STATE];
+    const uint32_t even_len = p->len[EVEN_STATE];
+
+    cl_uint2 *found = calloc(OPENCL_MAX_FOUND, sizeof(cl_uint2));
+    if (found == NULL)
+        return crack_states_bitsliced_NOSIMD(cuid, best_first_bytes, p, keys_found, num_keys_tested, nonces_to_bruteforce, bf_test_nonce_2nd_byte, nonces);
+
+    pthread_mutex_lock(&opencl_lock);
+
+    if (opencl_init() == false
+            || opencl_upload_states(ODD_STATE, p->states[ODD_STATE], odd_len) == false
+            || opencl_upload_states(EVEN_STATE, p->states[EVEN_STATE], even_len) == false) {
+        pthread_mutex_unlock(&opencl_lock);
+        free(found);
+        return crack_states_bitsliced_NOSIMD(cuid, best_first_bytes, p, keys_found, num_keys_tested, nonces_to_bruteforce, bf_test_nonce_2nd_byte, nonces);
+    }
+
+    // every test nonce keeps about 1/8 of the pairs, size the chunks so the
+    // survivors fit in the result buffer
+    uint64_t max_pairs = (uint64_t)OPENCL_MAX_FOUND / 4 << MIN(3 * test_nonces_cnt, 24);
+    max_pairs = MIN(max_pairs, OPENCL_MAX_PAIRS);
+
+    uint32_t even_step = MIN(even_len, max_pairs);
+    uint32_t odd_step = MAX(1, max_pairs / even_step);
+
+    for (uint32_t o = 0; o < odd_len && key == (uint64_t) -1 && *keys_found == 0;) {
+        uint32_t odd_cnt = MIN(odd_step, odd_len - o);
+
+        for (uint32_t e = 0; e < even_len && key == (uint64_t) -1 && *keys_found == 0;) {
+            uint32_t even_cnt = MIN(even_step, even_len - e);
+
+            int64_t cnt = opencl_run(o, odd_cnt, e, even_cnt, found);
+            if (cnt < 0) {
+                PrintAndLogEx(ERR, "OpenCL: kernel run failed");
+                goto out;
+            }
+
+            // too many survivors, retry this chunk smaller. Chunks never get
+            // below OPENCL_MAX_FOUND pairs, so this ends.
+            if (cnt > OPENCL_MAX_FOUND) {
+                if (e == 0 && odd_cnt > 1) {
+                    odd_step = MAX(1, odd_step / 2);
+                    odd_cnt = MIN(odd_step, odd_len - o);
+                } else {
+                    even_step = MAX(1, even_step / 2);
+                }
+                continue;
+            }
+
+            for (uint32_t i = 0; i < cnt; i++) {
+                if (verify_key(cuid, nonces, best_first_bytes, found[i].s[0], found[i].s[1])) {
+                    struct Crypto1State pcs;
+                    pcs.odd = found[i].s[0];
+                    pcs.even = found[i].s[1];
+                    lfsr_rollback_byte(&pcs, (cuid >> 24) ^ best_first_bytes[0], true);
+                    crypto1_get_lfsr(&pcs, &key);
+                    break;
+                }
+            }
+
+            bucket_states_tested += (uint64_t)odd_cnt * even_cnt;
+            e += even_cnt;
+        }
+        o += odd_cnt;
+    }
+
+out:
+    pthread_mutex_unlock(&opencl_lock);
+    free(found);
+    __sync_fetch_and_add(num_keys_tested, bucket_states_tested);
+    return key;
+}
@@ -0,0 +1,18 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// OpenCL backend for the hardnested brute force phase
+//-----------------------------------------------------------------------------
+
+#ifndef HARDNESTED_BF_OPENCL_H__
+#define HARDNESTED_BF_OPENCL_H__
+
+#include "hardnested_bruteforce.h" // statelist_t
+
+// same interface as the bitsliced CPU functions, see hardnested_bf_core.c
+uint64_t crack_states_bitsliced_OPENCL(uint32_t cuid, uint8_t *best_first_bytes, statelist_t *p, uint32_t *keys_found, uint64_t *num_keys_tested, uint32_t nonces_to_bruteforce, uint8_t *bf_test_nonce_2nd_byte, noncelist_t *nonces);
+void bitslice_test_nonces_OPENCL(uint32_t nonces_to_bruteforce, uint32_t *bf_test_nonce, uint8_t *bf_test_nonce_par);
+
+#endif
@@ -26,6 +26,12 @@
 #include <malloc.h>
 #endif
 
+#if defined (BUILD_NEON)
+#include <arm_neon.h>
+// add the number of set bits in every 32 bit lane of the 16 bytes v to acc
+#define NEON_POPCOUNT_ACC(acc, v) (acc) = vpadalq_u16((acc), vpaddlq_u8(vcntq_u8(v)))
+#endif
+
 // this needs to be compiled several times for each instruction set.
 // For each instruction set, define a dedicated function name:
 #if defined (__AVX512F__)
@@ -98,6 +104,20 @@
 #define COUNT_BITARRAY_AND2 count_bitarray_AND2_MMX
 #define COUNT_BITARRAY_AND3 count_bitarray_AND3_MMX
 #define COUNT_BITARRAY_AND4 count_bitarray_AND4_MMX
+#elif defined (BUILD_NEON)
+#define MALLOC_BITARRAY malloc_bitarray_NEON
+#define FREE_BITARRAY free_bitarray_NEON
+#define BITCOUNT bitcount_NEON
+#define COUNT_STATES count_states_NEON
+#define BITARRAY_AND bitarray_AND_NEON
+#define BITARRAY_LOW20_AND bitarray_low20_AND_NEON
+#define COUNT_BITARRAY_AND count_bitarray_AND_NEON
+#define COUNT_BITARRAY_LOW20_AND count_bitarray_low20_AND_NEON
+#define BITARRAY_AND4 bitarray_AND4_NEON
+#define BITARRAY_OR bitarray_OR_NEON
+#define COUNT_BITARRAY_AND2 count_bitarray_AND2_NEON
+#define COUNT_BITARRAY_AND3 count_bitarray_AND3_NEON
+#define COUNT_BITARRAY_AND4 count_bitarray_AND4_NEON
 #else
 #define MALLOC_BITARRAY malloc_bitarray_NOSIMD
 #define FREE_BITARRAY free_bitarray_NOSIMD
@@ -117,31 +137,31 @@
 
 // typedefs and declaration of functions:
 typedef uint32_t *malloc_bitarray_t(uint32_t);
-malloc_bitarray_t malloc_bitarray_AVX512, malloc_bitarray_AVX2, malloc_bitarray_AVX, malloc_bitarray_SSE2, malloc_bitarray_MMX, malloc_bitarray_NOSIMD, malloc_bitarray_dispatch;
+malloc_bitarray_t malloc_bitarray_AVX512, malloc_bitarray_AVX2, malloc_bitarray_AVX, malloc_bitarray_SSE2, malloc_bitarray_MMX, malloc_bitarray_NEON, malloc_bitarray_NOSIMD, malloc_bitarray_dispatch;
 typedef void free_bitarray_t(uint32_t *);
-free_bitarray_t free_bitarray_AVX512, free_bitarray_AVX2, free_bitarray_AVX, free_bitarray_SSE2, free_bitarray_MMX, free_bitarray_NOSIMD, free_bitarray_dispatch;
+free_bitarray_t free_bitarray_AVX512, free_bitarray_AVX2, free_bitarray_AVX, free_bitarray_SSE2, free_bitarray_MMX, free_bitarray_NEON, free_bitarray_NOSIMD, free_bitarray_dispatch;
 typedef uint32_t bitcount_t(uint32_t);
-bitcount_t bitcount_AVX512, bitcount_AVX2, bitcount_AVX, bitcount_SSE2, bitcount_MMX, bitcount_NOSIMD, bitcount_dispatch;
+bitcount_t bitcount_AVX512, bitcount_AVX2, bitcount_AVX, bitcount_SSE2, bitcount_MMX, bitcount_NEON, bitcount_NOSIMD, bitcount_dispatch;
 typedef uint32_t count_states_t(uint32_t *);
-count_states_t count_states_AVX512, count_states_AVX2, count_states_AVX, count_states_SSE2, count_states_MMX, count_states_NOSIMD, count_states_dispatch;
+count_states_t count_states_AVX512, count_states_AVX2, count_states_AVX, count_states_SSE2, count_states_MMX, count_states_NEON, count_states_NOSIMD, count_states_dispatch;
 typedef void bitarray_AND_t(uint32_t[], uint32_t[]);
-bitarray_AND_t bitarray_AND_AVX512, bitarray_AND_AVX2, bitarray_AND_AVX, bitarray_AND_SSE2, bitarray_AND_MMX, bitarray_AND_NOSIMD, bitarray_AND_dispatch;
+bitarray_AND_t bitarray_AND_AVX512, bitarray_AND_AVX2, bitarray_AND_AVX, bitarray_AND_SSE2, bitarray_AND_MMX, bitarray_AND_NEON, bitarray_AND_NOSIMD, bitarray_AND_dispatch;
 typedef void bitarray_low20_AND_t(uint32_t *, uint32_t *);
-bitarray_low20_AND_t bitarray_low20_AND_AVX512, bitarray_low20_AND_AVX2, bitarray_low20_AND_AVX, bitarray_low20_AND_SSE2, bitarray_low20_AND_MMX, bitarray_low20_AND_NOSIMD, bitarray_low20_AND_dispatch;
+bitarray_low20_AND_t bitarray_low20_AND_AVX512, bitarray_low20_AND_AVX2, bitarray_low20_AND_AVX, bitarray_low20_AND_SSE2, bitarray_low20_AND_MMX, bitarray_low20_AND_NEON, bitarray_low20_AND_NOSIMD, bitarray_low20_AND_dispatch;
 typedef uint32_t count_bitarray_AND_t(uint32_t *, uint32_t *);
-count_bitarray_AND_t count_bitarray_AND_AVX512, count_bitarray_AND_AVX2, count_bitarray_AND_AVX, count_bitarray_AND_SSE2, count_bitarray_AND_MMX, count_bitarray_AND_NOSIMD, count_bitarray_AND_dispatch;
+count_bitarray_AND_t count_bitarray_AND_AVX512, count_bitarray_AND_AVX2, count_bitarray_AND_AVX, count_bitarray_AND_SSE2, count_bitarray_AND_MMX, count_bitarray_AND_NEON, count_bitarray_AND_NOSIMD, count_bitarray_AND_dispatch;
 typedef uint32_t count_bitarray_low20_AND_t(uint32_t *, uint32_t *);
-count_bitarray_low20_AND_t count_bitarray_low20_AND_AVX512, count_bitarray_low20_AND_AVX2, count_bitarray_low20_AND_AVX, count_bitarray_low20_AND_SSE2, count_bitarray_low20_AND_MMX, count_bitarray_low20_AND_NOSIMD, count_bitarray_low20_AND_dispatch;
+count_bitarray_low20_AND_t count_bitarray_low20_AND_AVX512, count_bitarray_low20_AND_AVX2, count_bitarray_low20_AND_AVX, count_bitarray_low20_AND_SSE2, count_bitarray_low20_AND_MMX, count_bitarray_low20_AND_NEON, count_bitarray_low20_AND_NOSIMD, count_bitarray_low20_AND_dispatch;
 typedef void bitarray_AND4_t(uint32_t *, uint32_t *, uint32_t *, uint32_t *);
-bitarray_AND4_t bitarray_AND4_AVX512, bitarray_AND4_AVX2, bitarray_AND4_AVX, bitarray_AND4_SSE2, bitarray_AND4_MMX, bitarray_AND4_NOSIMD, bitarray_AND4_dispatch;
+bitarray_AND4_t bitarray_AND4_AVX512, bitarray_AND4_AVX2, bitarray_AND4_AVX, bitarray_AND4_SSE2, bitarray_AND4_MMX, bitarray_AND4_NEON, bitarray_AND4_NOSIMD, bitarray_AND4_dispatch;
 typedef void bitarray_OR_t(uint32_t[], uint32_t[]);
-bitarray_OR_t bitarray_OR_AVX512, bitarray_OR_AVX2, bitarray_OR_AVX, bitarray_OR_SSE2, bitarray_OR_MMX, bitarray_OR_NOSIMD, bitarray_OR_dispatch;
+bitarray_OR_t bitarray_OR_AVX512, bitarray_OR_AVX2, bitarray_OR_AVX, bitarray_OR_SSE2, bitarray_OR_MMX, bitarray_OR_NEON, bitarray_OR_NOSIMD, bitarray_OR_dispatch;
 typedef uint32_t count_bitarray_AND2_t(uint32_t *, uint32_t *);
-count_bitarray_AND2_t count_bitarray_AND2_AVX512, count_bitarray_AND2_AVX2, count_bitarray_AND2_AVX, count_bitarray_AND2_SSE2, count_bitarray_AND2_MMX, count_bitarray_AND2_NOSIMD, count_bitarray_AND2_dispatch;
+count_bitarray_AND2_t count_bitarray_AND2_AVX512, count_bitarray_AND2_AVX2, count_bitarray_AND2_AVX, count_bitarray_AND2_SSE2, count_bitarray_AND2_MMX, count_bitarray_AND2_NEON, count_bitarray_AND2_NOSIMD, count_bitarray_AND2_dispatch;
 typedef uint32_t count_bitarray_AND3_t(uint32_t *, uint32_t *, uint32_t *);
-count_bitarray_AND3_t count_bitarray_AND3_AVX512, count_bitarray_AND3_AVX2, count_bitarray_AND3_AVX, count_bitarray_AND3_SSE2, count_bitarray_AND3_MMX, count_bitarray_AND3_NOSIMD, count_bitarray_AND3_dispatch;
+count_bitarray_AND3_t count_bitarray_AND3_AVX512, count_bitarray_AND3_AVX2, count_bitarray_AND3_AVX, count_bitarray_AND3_SSE2, count_bitarray_AND3_MMX, count_bitarray_AND3_NEON, count_bitarray_AND3_NOSIMD, count_bitarray_AND3_dispatch;
 typedef uint32_t count_bitarray_AND4_t(uint32_t *, uint32_t *, uint32_t *, uint32_t *);
-count_bitarray_AND4_t count_bitarray_AND4_AVX512, count_bitarray_AND4_AVX2, count_bitarray_AND4_AVX, count_bitarray_AND4_SSE2, count_bitarray_AND4_MMX, count_bitarray_AND4_NOSIMD, count_bitarray_AND4_dispatch;
+count_bitarray_AND4_t count_bitarray_AND4_AVX512, count_bitarray_AND4_AVX2, count_bitarray_AND4_AVX, count_bitarray_AND4_SSE2, count_bitarray_AND4_MMX, count_bitarray_AND4_NEON, count_bitarray_AND4_NOSIMD, count_bitarray_AND4_dispatch;
 
 
 inline uint32_t *MALLOC_BITARRAY(uint32_t x) {
@@ -175,11 +195,19 @@ inline uint32_t BITCOUNT(uint32_t a) {
 
 
 inline uint32_t COUNT_STATES(uint32_t *A) {
+#if defined (BUILD_NEON)
+    uint32x4_t acc = vdupq_n_u32(0);
+    for (uint32_t i = 0; i < (1 << 19); i += 4) {
+        NEON_POPCOUNT_ACC(acc, vreinterpretq_u8_u32(vld1q_u32(A + i)));
+    }
+    return vaddvq_u32(acc);
+#else
     uint32_t count = 0;
     for (uint32_t i = 0; i < (1 << 19); i++) {
         count += BITCOUNT(A[i]);
     }
     return count;
+#endif
 }
 
 
@@ -196,29 +224,56 @@ inline void BITARRAY_LOW20_AND(uint32_t *restrict A, uint32_t *restrict B) {
     uint16_t *a = (uint16_t *)__builtin_assume_aligned(A, __BIGGEST_ALIGNMENT__);
     uint16_t *b = (uint16_t *)__builtin_assume_aligned(B, __BIGGEST_ALIGNMENT__);
 
+#if defined (BUILD_NEON)
+    for (uint32_t i = 0; i < (1 << 20); i += 8) {
+        uint16x8_t vb = vld1q_u16(b + i);
+        vst1q_u16(a + i, vandq_u16(vld1q_u16(a + i), vtstq_u16(vb, vb)));
+    }
+#else
     for (uint32_t i = 0; i < (1 << 20); i++) {
         if (!b[i]) {
             a[i] = 0;
         }
     }
+#endif
 }
 
 
 inline uint32_t COUNT_BITARRAY_AND(uint32_t *restrict A, uint32_t *restrict B) {
     A = __builtin_assume_aligned(A, __BIGGEST_ALIGNMENT__);
     B = __builtin_assume_aligned(B, __BIGGEST_ALIGNMENT__);
+#if defined (BUILD_NEON)
+    uint32x4_t acc = vdupq_n_u32(0);
+    for (uint32_t i = 0; i < (1 << 19); i += 4) {
+        uint32x4_t v = vandq_u32(vld1q_u32(A + i), vld1q_u32(B + i));
+        vst1q_u32(A + i, v);
+        NEON_POPCOUNT_ACC(acc, vreinterpretq_u8_u32(v));
+    }
+    return vaddvq_u32(acc);
+#else
     uint32_t count = 0;
     for (uint32_t i = 0; i < (1 << 19); i++) {
         A[i] &= B[i];
         count += BITCOUNT(A[i]);
     }
     return count;
+#endif
 }
 
 
 inline uint32_t COUNT_BITARRAY_LOW20_AND(uint32_t *restrict A, uint32_t *restrict B) {
     uint16_t *a = (uint16_t *)__builtin_assume_aligned(A, __BIGGEST_ALIGNMENT__);
     uint16_t *b = (uint16_t *)__builtin_assume_aligned(B, __BIGGEST_ALIGNMENT__);
+#if defined (BUILD_NEON)
+    uint32x4_t acc = vdupq_n_u32(0);
+    for (uint32_t i = 0; i < (1 << 20); i += 8) {
+        uint16x8_t vb = vld1q_u16(b + i);
+        uint16x8_t va = vandq_u16(vld1q_u16(a + i), vtstq_u16(vb, vb));
+        vst1q_u16(a + i, va);
+        NEON_POPCOUNT_ACC(acc, vreinterpretq_u8_u16(va));
+    }
+    return vaddvq_u32(acc);
+#else
     uint32_t count = 0;
 
     for (uint32_t i = 0; i < (1 << 20); i++) {
@@ -228,6 +283,7 @@ inline uint32_t COUNT_BITARRAY_LOW20_AND(uint32_t *restrict A, uint32_t *restric
         count += BITCOUNT(a[i]);
     }
     return count;
+#endif
 }
 
 
@@ -254,11 +310,20 @@ inline void BITARRAY_OR(uint32_t *restrict A, uint32_t *restrict B) {
 inline uint32_t COUNT_BITARRAY_AND2(uint32_t *restrict A, uint32_t *restrict B) {
     A = __builtin_assume_aligned(A, __BIGGEST_ALIGNMENT__);
     B = __builtin_assume_aligned(B, __BIGGEST_ALIGNMENT__);
+#if defined (BUILD_NEON)
+    uint32x4_t acc = vdupq_n_u32(0);
+    for (uint32_t i = 0; i < (1 << 19); i += 4) {
+        uint32x4_t v = vandq_u32(vld1q_u32(A + i), vld1q_u32(B + i));
+        NEON_POPCOUNT_ACC(acc, vreinterpretq_u8_u32(v));
+    }
+    return vaddvq_u32(acc);
+#else
     uint32_t count = 0;
     for (uint32_t i = 0; i < (1 << 19); i++) {
         count += BITCOUNT(A[i] & B[i]);
     }
     return count;
+#endif
 }
 
 
@@ -266,11 +331,20 @@ inline uint32_t COUNT_BITARRAY_AND3(uint32_t *restrict A, uint32_t *restrict B,
     A = __builtin_assume_aligned(A, __BIGGEST_ALIGNMENT__);
     B = __builtin_assume_aligned(B, __BIGGEST_ALIGNMENT__);
     C = __builtin_assume_aligned(C, __BIGGEST_ALIGNMENT__);
+#if defined (BUILD_NEON)
+    uint32x4_t acc = vdupq_n_u32(0);
+    for (uint32_t i = 0; i < (1 << 19); i += 4) {
+        uint32x4_t v = vandq_u32(vandq_u32(vld1q_u32(A + i), vld1q_u32(B + i)), vld1q_u32(C + i));
+        NEON_POPCOUNT_ACC(acc, vreinterpretq_u8_u32(v));
+    }
+    return vaddvq_u32(acc);
+#else
     uint32_t count = 0;
     for (uint32_t i = 0; i < (1 << 19); i++) {
         count += BITCOUNT(A[i] & B[i] & C[i]);
     }
     return count;
+#endif
 }
 
 
@@ -279,15 +353,24 @@ inline uint32_t COUNT_BITARRAY_AND4(uint32_t *restrict A, uint32_t *restrict B,
     B = __builtin_assume_aligned(B, __BIGGEST_ALIGNMENT__);
     C = __builtin_assume_aligned(C, __BIGGEST_ALIGNMENT__);
     D = __builtin_assume_aligned(D, __BIGGEST_ALIGNMENT__);
+#if defined (BUILD_NEON)
+    uint32x4_t acc = vdupq_n_u32(0);
+    for (uint32_t i = 0; i < (1 << 19); i += 4) {
+        uint32x4_t v = vandq_u32(vandq_u32(vld1q_u32(A + i), vld1q_u32(B + i)), vandq_u32(vld1q_u32(C + i), vld1q_u32(D + i)));
+        NEON_POPCOUNT_ACC(acc, vreinterpretq_u8_u32(v));
+    }
+    return vaddvq_u32(acc);
+#else
     uint32_t count = 0;
     for (uint32_t i = 0; i < (1 << 19); i++) {
         count += BITCOUNT(A[i] & B[i] & C[i] & D[i]);
     }
     return count;
+#endif
 }
 
 
-#ifndef __MMX__
+#if !defined(__MMX__) && !defined(BUILD_NEON)
 
 // pointers to functions:
 malloc_bitarray_t *malloc_bitarray_function_p = &malloc_bitarray_dispatch;
@@ -317,7 +400,11 @@ uint32_t *malloc_bitarray_dispatch(uint32_t x) {
         else if (__builtin_cpu_supports("mmx")) malloc_bitarray_function_p = &malloc_bitarray_MMX;
         else
 #endif
+#if defined(COMPILER_HAS_SIMD_NEON)
+            malloc_bitarray_function_p = &malloc_bitarray_NEON;
+#else
             malloc_bitarray_function_p = &malloc_bitarray_NOSIMD;
+#endif
 
     // call the most optimized function for this CPU
     return (*malloc_bitarray_function_p)(x);
@@ -335,7 +422,11 @@ void free_bitarray_dispatch(uint32_t *x) {
         else if (__builtin_cpu_supports("mmx")) free_bitarray_function_p = &free_bitarray_MMX;
         else
 #endif
+#if defined(COMPILER_HAS_SIMD_NEON)
+            free_bitarray_function_p = &free_bitarray_NEON;
+#else
             free_bitarray_function_p = &free_bitarray_NOSIMD;
+#endif
 
     // call the most optimized function for this CPU
     (*free_bitarray_function_p)(x);
@@ -353,7 +444,11 @@ uint32_t bitcount_dispatch(uint32_t a) {
         else if (__builtin_cpu_supports("mmx")) bitcount_function_p = &bitcount_MMX;
         else
 #endif
+#if defined(COMPILER_HAS_SIMD_NEON)
+            bitcount_function_p = &bitcount_NEON;
+#else
             bitcount_function_p = &bitcount_NOSIMD;
+#endif
 
     // call the most optimized function for this CPU
     return (*bitcount_function_p)(a);
@@ -371,7 +466,11 @@ uint32_t count_states_dispatch(uint32_t *bitarray) {
         else if (__builtin_cpu_supports("mmx")) count_states_function_p = &count_states_MMX;
         else
 #endif
+#if defined(COMPILER_HAS_SIMD_NEON)
+            count_states_function_p = &count_states_NEON;
+#else
             count_states_function_p = &count_states_NOSIMD;
+#endif
 
     // call the most optimized function for this CPU
     return (*count_states_function_p)(bitarray);
@@ -389,7 +488,11 @@ void bitarray_AND_dispatch(uint32_t *A, uint32_t *B) {
         else if (__builtin_cpu_supports("mmx")) bitarray_AND_function_p = &bitarray_AND_MMX;
         else
 #endif
+#if defined(COMPILER_HAS_SIMD_NEON)
+            bitarray_AND_function_p = &bitarray_AND_NEON;
+#else
             bitarray_AND_function_p = &bitarray_AND_NOSIMD;
+#endif
 
     // call the most optimized function for this CPU
     (*bitarray_AND_function_p)(A, B);
@@ -407,7 +510,11 @@ void bitarray_low20_AND_dispatch(uint32_t *A, uint32_t *B) {
         else if (__builtin_cpu_supports("mmx")) bitarray_low20_AND_function_p = &bitarray_low20_AND_MMX;
         else
 #endif
+#if defined(COMPILER_HAS_SIMD_NEON)
+            bitarray_low20_AND_function_p = &bitarray_low20_AND_NEON;
+#else
             bitarray_low20_AND_function_p = &bitarray_low20_AND_NOSIMD;
+#endif
 
     // call the most optimized function for this CPU
     (*bitarray_low20_AND_function_p)(A, B);
@@ -425,7 +532,11 @@ uint32_t count_bitarray_AND_dispatch(uint32_t *A, uint32_t *B) {
         else if (__builtin_cpu_supports("mmx")) count_bitarray_AND_function_p = &count_bitarray_AND_MMX;
         else
 #endif
+#if defined(COMPILER_HAS_SIMD_NEON)
+            count_bitarray_AND_function_p = &count_bitarray_AND_NEON;
+#else
             count_bitarray_AND_function_p = &count_bitarray_AND_NOSIMD;
+#endif
 
     // call the most optimized function for this CPU
     return (*count_bitarray_AND_function_p)(A, B);
@@ -443,7 +554,11 @@ uint32_t count_bitarray_low20_AND_dispatch(uint32_t *A, uint32_t *B) {
         else if (__builtin_cpu_supports("mmx")) count_bitarray_low20_AND_function_p = &count_bitarray_low20_AND_MMX;
         else
 #endif
+#if defined(COMPILER_HAS_SIMD_NEON)
+            count_bitarray_low20_AND_function_p = &count_bitarray_low20_AND_NEON;
+#else
             count_bitarray_low20_AND_function_p = &count_bitarray_low20_AND_NOSIMD;
+#endif
 
     // call the most optimized function for this CPU
     return (*count_bitarray_low20_AND_function_p)(A, B);
@@ -461,7 +576,11 @@ void bitarray_AND4_dispatch(uint32_t *A, uint32_t *B, uint32_t *C, uint32_t *D)
         else if (__builtin_cpu_supports("mmx")) bitarray_AND4_function_p = &bitarray_AND4_MMX;
         else
 #endif
+#if defined(COMPILER_HAS_SIMD_NEON)
+            bitarray_AND4_function_p = &bitarray_AND4_NEON;
+#else
             bitarray_AND4_function_p = &bitarray_AND4_NOSIMD;
+#endif
 
     // call the most optimized function for this CPU
     (*bitarray_AND4_function_p)(A, B, C, D);
@@ -479,7 +598,11 @@ void bitarray_OR_dispatch(uint32_t *A, uint32_t *B) {
         else if (__builtin_cpu_supports("mmx")) bitarray_OR_function_p = &bitarray_OR_MMX;
         else
 #endif
+#if defined(COMPILER_HAS_SIMD_NEON)
+            bitarray_OR_function_p = &bitarray_OR_NEON;
+#else
             bitarray_OR_function_p = &bitarray_OR_NOSIMD;
+#endif
 
     // call the most optimized function for this CPU
     (*bitarray_OR_function_p)(A, B);
@@ -497,7 +620,11 @@ uint32_t count_bitarray_AND2_dispatch(uint32_t *A, uint32_t *B) {
         else if (__builtin_cpu_supports("mmx")) count_bitarray_AND2_function_p = &count_bitarray_AND2_MMX;
         else
 #endif
+#if defined(COMPILER_HAS_SIMD_NEON)
+            count_bitarray_AND2_function_p = &count_bitarray_AND2_NEON;
+#else
             count_bitarray_AND2_function_p = &count_bitarray_AND2_NOSIMD;
+#endif
 
     // call the most optimized function for this CPU
     return (*count_bitarray_AND2_function_p)(A, B);
@@ -515,7 +642,11 @@ uint32_t count_bitarray_AND3_dispatch(uint32_t *A, uint32_t *B, uint32_t *C) {
         else if (__builtin_cpu_supports("mmx")) count_bitarray_AND3_function_p = &count_bitarray_AND3_MMX;
         else
 #endif
+#if defined(COMPILER_HAS_SIMD_NEON)
+            count_bitarray_AND3_function_p = &count_bitarray_AND3_NEON;
+#else
             count_bitarray_AND3_function_p = &count_bitarray_AND3_NOSIMD;
+#endif
 
     // call the most optimized function for this CPU
     return (*count_bitarray_AND3_function_p)(A, B, C);
@@ -533,7 +664,11 @@ uint32_t count_bitarray_AND4_dispatch(uint32_t *A, uint32_t *B, uint32_t *C, uin
         else if (__builtin_cpu_supports("mmx")) count_bitarray_AND4_function_p = &count_bitarray_AND4_MMX;
         else
 #endif
+#if defined(COMPILER_HAS_SIMD_NEON)
+            count_bitarray_AND4_function_p = &count_bitarray_AND4_NEON;
+#else
             count_bitarray_AND4_function_p = &count_bitarray_AND4_NOSIMD;
+#endif
 
     // call the most optimized function for this CPU
     return (*count_bitarray_AND4_function_p)(A, B, C, D);
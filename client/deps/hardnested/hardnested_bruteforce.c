@@ -87,8 +87,25 @@ static uint32_t nonces_to_bruteforce = 0;
 static uint32_t bf_test_nonce[256];
 static uint8_t bf_test_nonce_2nd_byte[256];
 static uint8_t bf_test_nonce_par[256];
-static uint32_t bucket_count = 0;
-static statelist_t *buckets[128];
+
+// Work for the brute force threads. Large buckets are split into sub ranges of
+// odd (and if needed even) states, sorted by size and dealt out round robin.
+// Thread t owns items t, t + n, t + 2n, ... and takes them from the front, an
+// idle thread steals from the back of the fullest queue, i.e. the small ones.
+#define BF_ITEMS_PER_THREAD             16
+#define BF_MIN_ITEM_SIZE                (1 << 22)     // odd * even pairs, smaller is not worth the even bitslicing
+#define BF_EVEN_ALIGN                   512           // MAX_BITSLICES of the widest instruction set
+
+typedef struct {
+    pthread_mutex_t lock;
+    uint32_t head;
+    uint32_t tail;
+} bf_queue_t;
+
+static statelist_t *work_items = NULL;
+static uint32_t work_count = 0;
+static uint32_t num_queues = 0;
+static bf_queue_t *work_queues = NULL;
 static uint32_t keys_found = 0;
 static uint64_t num_keys_tested;
 static uint64_t found_bs_key = 0;
@@ -140,6 +157,44 @@ bool verify_key(uint32_t cuid, noncelist_t *nonces, uint8_t *best_first_bytes, u
     }
     return true;
 }
+static statelist_t *get_work_item(int thread_id) {
+
+    bf_queue_t *q = &work_queues[thread_id];
+    pthread_mutex_lock(&q->lock);
+    if (q->head < q->tail) {
+        uint32_t k = q->head++;
+        pthread_mutex_unlock(&q->lock);
+        return &work_items[thread_id + k * num_queues];
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    // own queue is empty, steal from the one with most work left
+    for (;;) {
+        int victim = -1;
+        uint32_t most = 0;
+        for (uint32_t i = 0; i < num_queues; i++) {
+            // tail first, head never passes it
+            uint32_t tail = __atomic_load_n(&work_queues[i].tail, __ATOMIC_ACQUIRE);
+            uint32_t left = tail - __atomic_load_n(&work_queues[i].head, __ATOMIC_ACQUIRE);
+            if (left > most) {
+                most = left;
+                victim = i;
+            }
+        }
+        if (victim < 0)
+            return NULL;
+
+        q = &work_queues[victim];
+        pthread_mutex_lock(&q->lock);
+        if (q->head < q->tail) {
+            uint32_t k = --q->tail;
+            pthread_mutex_unlock(&q->lock);
+            return &work_items[victim + k * num_queues];
+        }
+        pthread_mutex_unlock(&q->lock);
+    }
+}
+
 static void *
 #ifdef __has_attribute
 #if __has_attribute(force_align_arg_pointer)
@@ -159,40 +214,124 @@ crack_states_thread(void *x) {
 
     thread_arg = (struct arg *)x;
     const int thread_id = thread_arg->thread_ID;
-    uint32_t current_bucket = thread_id;
-    while (current_bucket < bucket_count) {
-        statelist_t *bucket = buckets[current_bucket];
-        if (bucket) {
+    statelist_t *bucket;
+    while (keys_found == 0 && (bucket = get_work_item(thread_id)) != NULL) {
 #if defined (DEBUG_BRUTE_FORCE)
-            PrintAndLogEx(INFO, "Thread %u starts working on bucket %u\n", thread_id, current_bucket);
+        PrintAndLogEx(INFO, "Thread %u starts working on %u x %u states\n", thread_id, bucket->len[ODD_STATE], bucket->len[EVEN_STATE]);
 #endif
-            const uint64_t key = crack_states_bitsliced(thread_arg->cuid, thread_arg->best_first_bytes, bucket, &keys_found, &num_keys_tested, nonces_to_bruteforce, bf_test_nonce_2nd_byte, thread_arg->nonces);
-            if (key != -1) {
-                __atomic_fetch_add(&keys_found, 1, __ATOMIC_SEQ_CST);
-                __atomic_fetch_add(&found_bs_key, key, __ATOMIC_SEQ_CST);
-
+        const uint64_t key = crack_states_bitsliced(thread_arg->cuid, thread_arg->best_first_bytes, bucket, &keys_found, &num_keys_tested, nonces_to_bruteforce, bf_test_nonce_2nd_byte, thread_arg->nonces);
+        if (key != -1) {
+            __atomic_fetch_add(&keys_found, 1, __ATOMIC_SEQ_CST);
+            __atomic_fetch_add(&found_bs_key, key, __ATOMIC_SEQ_CST);
+
+            char progress_text[80];
+            char keystr[19];
+            sprintf(keystr, "%012" PRIx64 "  ", key);
+            sprintf(progress_text, "Brute force phase completed. Key found: " _YELLOW_("%s"), keystr);
+            hardnested_print_progress(thread_arg->num_acquired_nonces, progress_text, 0.0, 0);
+            break;
+        } else if (keys_found) {
+            break;
+        } else {
+            if (!thread_arg->silent) {
                 char progress_text[80];
-                char keystr[19];
-                sprintf(keystr, "%012" PRIx64 "  ", key);
-                sprintf(progress_text, "Brute force phase completed. Key found: " _YELLOW_("%s"), keystr);
-                hardnested_print_progress(thread_arg->num_acquired_nonces, progress_text, 0.0, 0);
-                break;
-            } else if (keys_found) {
-                break;
-            } else {
-                if (!thread_arg->silent) {
-                    char progress_text[80];
-                    sprintf(progress_text, "Brute force phase: %6.02f%%\t", 100.0 * (float)num_keys_tested / (float)(thread_arg->maximum_states));
-                    float remaining_bruteforce = thread_arg->nonces[thread_arg->best_first_bytes[0]].expected_num_brute_force - (float)num_keys_tested / 2;
-                    hardnested_print_progress(thread_arg->num_acquired_nonces, progress_text, remaining_bruteforce, 5000);
-                }
+                sprintf(progress_text, "Brute force phase: %6.02f%%\t", 100.0 * (float)num_keys_tested / (float)(thread_arg->maximum_states));
+                float remaining_bruteforce = thread_arg->nonces[thread_arg->best_first_bytes[0]].expected_num_brute_force - (float)num_keys_tested / 2;
+                hardnested_print_progress(thread_arg->num_acquired_nonces, progress_text, remaining_bruteforce, 5000);
             }
         }
-        current_bucket += NUM_BRUTE_FORCE_THREADS;
     }
     return NULL;
 }
 
+static int compare_work_items(const void *a, const void *b) {
+    uint64_t wa = (uint64_t)((const statelist_t *)a)->len[ODD_STATE] * ((const statelist_t *)a)->len[EVEN_STATE];
+    uint64_t wb = (uint64_t)((const statelist_t *)b)->len[ODD_STATE] * ((const statelist_t *)b)->len[EVEN_STATE];
+    return (wa < wb) - (wa > wb);
+}
+
+// split the candidate buckets into work items for num_threads threads
+static bool split_work(statelist_t *candidates, uint32_t num_threads) {
+
+    uint64_t total = 0;
+    for (statelist_t *p = candidates; p != NULL; p = p->next) {
+        if (p->states[ODD_STATE] != NULL && p->states[EVEN_STATE] != NULL)
+            total += (uint64_t)p->len[ODD_STATE] * p->len[EVEN_STATE];
+    }
+    uint64_t item_size = MAX(total / ((uint64_t)num_threads * BF_ITEMS_PER_THREAD), BF_MIN_ITEM_SIZE);
+
+    // count first, then fill
+    for (int pass = 0; pass < 2; pass++) {
+        work_count = 0;
+        for (statelist_t *p = candidates; p != NULL; p = p->next) {
+            if (p->states[ODD_STATE] == NULL || p->states[EVEN_STATE] == NULL
+                    || p->len[ODD_STATE] == 0 || p->len[EVEN_STATE] == 0)
+                continue;
+
+            const uint32_t odd_len = p->len[ODD_STATE];
+            const uint32_t even_len = p->len[EVEN_STATE];
+            uint64_t pieces = ((uint64_t)odd_len * even_len + item_size - 1) / item_size;
+
+            // prefer splitting the odd states, the even ones are bitsliced once per item
+            uint32_t odd_pieces = MIN(pieces, odd_len);
+            uint32_t odd_step = (odd_len + odd_pieces - 1) / odd_pieces;
+            uint32_t even_step = even_len;
+            if (pieces > odd_len) {
+                uint64_t even_pieces = (pieces + odd_len - 1) / odd_len;
+                even_step = (even_len + even_pieces - 1) / even_pieces;
+                even_step = (even_step + BF_EVEN_ALIGN - 1) / BF_EVEN_ALIGN * BF_EVEN_ALIGN;
+            }
+
+            for (uint32_t o = 0; o < odd_len; o += odd_step) {
+                for (uint32_t e = 0; e < even_len; e += even_step) {
+                    if (pass == 1) {
+                        statelist_t *w = &work_items[work_count];
+                        w->states[ODD_STATE] = p->states[ODD_STATE] + o;
+                        w->states[EVEN_STATE] = p->states[EVEN_STATE] + e;
+                        w->len[ODD_STATE] = MIN(odd_step, odd_len - o);
+                        w->len[EVEN_STATE] = MIN(even_step, even_len - e);
+                        w->next = NULL;
+                    }
+                    work_count++;
+                }
+            }
+        }
+
+        if (pass == 0) {
+            free(work_items);
+            work_items = calloc(MAX(work_count, 1), sizeof(statelist_t));
+            if (work_items == NULL)
+                return false;
+        }
+    }
+
+    qsort(work_items, work_count, sizeof(statelist_t), compare_work_items);
+
+    free(work_queues);
+    work_queues = calloc(num_threads, sizeof(bf_queue_t));
+    if (work_queues == NULL)
+        return false;
+
+    num_queues = num_threads;
+    for (uint32_t i = 0; i < num_threads; i++) {
+        pthread_mutex_init(&work_queues[i].lock, NULL);
+        work_queues[i].head = 0;
+        work_queues[i].tail = (work_count > i) ? (work_count - i + num_threads - 1) / num_threads : 0;
+    }
+    return true;
+}
+
+static void free_work(void) {
+    for (uint32_t i = 0; i < num_queues; i++)
+        pthread_mutex_destroy(&work_queues[i].lock);
+    free(work_queues);
+    work_queues = NULL;
+    num_queues = 0;
+    free(work_items);
+    work_items = NULL;
+    work_count = 0;
+}
+
 
 void prepare_bf_test_nonces(noncelist_t *nonces, uint8_t best_first_byte) {
     // we do bitsliced brute forcing with best_first_bytes[0] only.
@@ -306,15 +445,6 @@ bool brute_force_bs(float *bf_rate, statelist_t *candidates, uint32_t cuid, uint
 
     bitslice_test_nonces(nonces_to_bruteforce, bf_test_nonce, bf_test_nonce_par);
 
-    // count number of states to go
-    bucket_count = 0;
-    for (statelist_t *p = candidates; p != NULL; p = p->next) {
-        if (p->states[ODD_STATE] != NULL && p->states[EVEN_STATE] != NULL) {
-            buckets[bucket_count] = p;
-            bucket_count++;
-        }
-    }
-
     uint64_t start_time = msclock();
 
 #if defined(__linux__) ||  defined(__APPLE__)
@@ -322,6 +452,12 @@ bool brute_force_bs(float *bf_rate, statelist_t *candidates, uint32_t cuid, uint
         return false;
 #endif
 
+    if (split_work(candidates, NUM_BRUTE_FORCE_THREADS) == false) {
+        PrintAndLogEx(WARNING, "Out of memory error in brute_force. Aborting...");
+        free_work();
+        return false;
+    }
+
     pthread_t threads[NUM_BRUTE_FORCE_THREADS];
     struct args {
         bool silent;
@@ -347,6 +483,8 @@ bool brute_force_bs(float *bf_rate, statelist_t *candidates, uint32_t cuid, uint
         pthread_join(threads[i], 0);
     }
 
+    free_work();
+
     uint64_t elapsed_time = msclock() - start_time;
 
     if (bf_rate != NULL)
@@ -13,6 +13,7 @@
 -- Loads the commands-library
 local taglib = require('taglib')
 local cmds = require('commands')
+local utils = require('utils')
 
 -- Shouldn't take longer than 2 seconds
 local TIMEOUT = 2000
@@ -27,7 +28,9 @@ local ISO14A_COMMAND = {
     ISO14A_SET_TIMEOUT = 0x40,
     ISO14A_NO_SELECT = 0x80,
     ISO14A_TOPAZMODE = 0x100,
-    ISO14A_NO_RATS = 0x200
+    ISO14A_NO_RATS = 0x200,
+    ISO14A_SEND_CHAINING = 0x400,
+    ISO14A_TEAROFF = 0x800
 }
 
 local ISO14443a_TYPES = {}
@@ -138,8 +141,25 @@ local function disconnect14443a()
     return c:sendMIX(true)
 end
 
+---
+-- Sends a raw frame and cuts the field offset ssp clocks (~1.18us) after its end, the
+-- field has to be on (read with dont_disconnect). Select the tag again afterwards.
+-- Sweeps with read back run on the device with `hf 14a tearoff`
+-- @param rawdata - hex string, CRC included
+-- @param offset - ssp clocks after the end of the frame
+local function tearoff14443a(rawdata, offset)
+    local flags = ISO14A_COMMAND.ISO14A_RAW + ISO14A_COMMAND.ISO14A_TEAROFF
+    local command = Command:newMIX{cmd = cmds.CMD_HF_ISO14443A_READER,
+                                   arg1 = flags,
+                                   -- the offset follows the frame, little endian
+                                   arg2 = string.len(rawdata) / 2,
+                                   data = rawdata..utils.SwapEndiannessStr(('%08X'):format(offset), 32)}
+    return command:sendMIX()
+end
+
 local library = {
     read = read14443a,
+    tearoff = tearoff14443a,
     waitFor14443a = waitFor14443a,
     parse14443a = parse14443a,
     disconnect = disconnect14443a,
@@ -315,32 +315,15 @@ local Utils =
         return rev
     end,
 
+    -- native, see bit.fromhex / bit.tohex in pm3_bitlib.c
     ConvertHexToAscii = function(s, useSafechars)
         if s == nil then return '' end
-        if #s == 0 then return '' end
-        local t={}
-        for k in s:gmatch"(%x%x)" do
-
-            local n = tonumber(k,16)
-            local c
-            if useSafechars and ( (n < 32) or (n == 127) ) then
-                c = '.';
-            else
-                c = string.char(n)
-            end
-            table.insert(t,c)
-        end
-        return table.concat(t)
+        return bit.fromhex(s, useSafechars)
     end,
 
     ConvertAsciiToHex = function(s)
         if s == nil then return '' end
-        if #s == 0 then return '' end
-        local t={}
-        for k in s:gmatch"(.)" do
-            table.insert(t, string.format("%02X", string.byte(k)))
-        end
-        return table.concat(t)
+        return bit.tohex(s)
     end,
 
     hexlify = function(s)
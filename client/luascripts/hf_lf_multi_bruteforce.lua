@@ -281,6 +281,13 @@ local function main(args)
     print('BruteForcing '..rfidtagname..''..facilitymessage..''..facility..' - CardNumber Start: '..baseid..' - CardNumber End: '..endid..' - TimeOut: '..timeout)
     print("")
 
+    -- HID runs on the device, one sweep instead of a sim per card. 65535 steps down, card numbers are 16 bit
+    if rfidtag == 'hid' and timeout ~= 'pause' and tonumber(timeout) > 0 then
+        local step = (fordirection == 1) and 1 or 65535
+        core.console(('lf hid sweep f %d c %d n %d s %d d %d'):format(facility, baseid, count + 1, step, math.floor(tonumber(timeout) * 1000)))
+        return
+    end
+
     -- loop through for each count (-c)
     for cardnum = baseid, endid, fordirection do
 
@@ -6,9 +6,10 @@ local ansicolors  = require('ansicolors')
 
 copyright = ''
 author = 'Daniel Underhay (updated), Keld Norman(original)'
-version = 'v2.0.1'
+version = 'v2.1.0'
 desc =[[
 This script bruteforces 4 or 7 byte UID Mifare classic card numbers.
+With a timeout the loop runs on the device, see `hf 14a sweep`.
 ]]
 example =[[
 Bruteforce a 4 byte UID Mifare classic card number, starting at 11223344, ending at 11223346.
@@ -110,6 +111,15 @@ local function main(args)
 
     if command == '' then return print(usage) end
 
+    -- the device steps through the range itself, unless we wait for the user between cards
+    if timeout ~= 'pause' and tonumber(timeout) > 0 then
+        local sweep = string.format(command, tonumber(start_id)):gsub(' sim ', ' sweep ')
+        local c = ('%s n %d d %d'):format(sweep, tonumber(end_id) - tonumber(start_id) + 1, tonumber(timeout))
+        print('Running: "'..c..'"')
+        core.console(c)
+        return
+    end
+
     for n = start_id, end_id do
         local c = string.format( command, n )
         print('Running: "'..c..'"')
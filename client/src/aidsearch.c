@@ -13,6 +13,20 @@
 #include "fileutils.h"
 #include "pm3_cmd.h"
 
+// aidlist.json is parsed once per client run, AIDSearchInit hands out references of it
+static json_t *aid_root = NULL;
+
+// AIDs of the list sorted once, a lookup is a binary search instead of a pass over all the records
+typedef struct {
+    const char *aid;
+    uint32_t elmindx;
+    json_t *elm;
+} aid_index_t;
+
+static json_t *aid_index_root = NULL;
+static aid_index_t *aid_index = NULL;
+static size_t aid_index_len = 0;
+
 static int openAIDFile(json_t **root, bool verbose) {
     json_error_t error;
 
@@ -48,12 +62,17 @@ static int closeAIDFile(json_t *root) {
 }
 
 json_t *AIDSearchInit(bool verbose) {
-    json_t *root = NULL;
-    int res = openAIDFile(&root, verbose);
-    if (res != PM3_SUCCESS)
-        return NULL;
+    if (aid_root == NULL) {
+        json_t *root = NULL;
+        int res = openAIDFile(&root, verbose);
+        if (res != PM3_SUCCESS) {
+            json_decref(root);
+            return NULL;
+        }
+        aid_root = root;
+    }
 
-    return root;
+    return json_incref(aid_root);
 }
 
 json_t *AIDSearchGetElm(json_t *root, int elmindx) {
@@ -66,6 +85,13 @@ json_t *AIDSearchGetElm(json_t *root, int elmindx) {
 }
 
 int AIDSearchFree(json_t *root) {
+    // the index of the shared list stays for the next lookup
+    if (root == aid_index_root && root != aid_root) {
+        free(aid_index);
+        aid_index = NULL;
+        aid_index_len = 0;
+        aid_index_root = NULL;
+    }
     return closeAIDFile(root);
 }
 
@@ -86,17 +112,6 @@ static const char *jsonStrGet(json_t *data, const char *name) {
     return cstr;
 }
 
-static bool aidCompare(const char *aidlarge, const char *aidsmall) {
-    if (strcmp(aidlarge, aidsmall) == 0)
-        return true;
-
-    if (strlen(aidlarge) > strlen(aidsmall))
-        if (strncmp(aidlarge, aidsmall, strlen(aidsmall)) == 0)
-            return true;
-
-    return false;
-}
-
 bool AIDGetFromElm(json_t *data, uint8_t *aid, size_t aidmaxlen, int *aidlen) {
     *aidlen = 0;
     const char *hexaid = jsonStrGet(data, "AID");
@@ -110,6 +125,64 @@ bool AIDGetFromElm(json_t *data, uint8_t *aid, size_t aidmaxlen, int *aidlen) {
     return true;
 }
 
+static int aidIndexCompare(const void *a, const void *b) {
+    const aid_index_t *ia = a;
+    const aid_index_t *ib = b;
+    int res = strcmp(ia->aid, ib->aid);
+    if (res)
+        return res;
+    return (ia->elmindx > ib->elmindx) - (ia->elmindx < ib->elmindx);
+}
+
+static bool aidIndexBuild(json_t *root) {
+    if (root == aid_index_root && aid_index != NULL)
+        return true;
+
+    free(aid_index);
+    aid_index = calloc(json_array_size(root) + 1, sizeof(aid_index_t));
+    aid_index_len = 0;
+    aid_index_root = NULL;
+    if (aid_index == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return false;
+    }
+
+    for (uint32_t elmindx = 0; elmindx < json_array_size(root); elmindx++) {
+        json_t *data = AIDSearchGetElm(root, elmindx);
+        if (data == NULL)
+            continue;
+        const char *dictaid = jsonStrGet(data, "AID");
+        if (dictaid == NULL)
+            continue;
+        aid_index[aid_index_len].aid = dictaid;
+        aid_index[aid_index_len].elmindx = elmindx;
+        aid_index[aid_index_len].elm = data;
+        aid_index_len++;
+    }
+
+    // equal AIDs keep the order of the file, the first one wins like in the list
+    qsort(aid_index, aid_index_len, sizeof(aid_index_t), aidIndexCompare);
+    aid_index_root = root;
+    return true;
+}
+
+// first index entry for the first aidlen chars of aid
+static json_t *aidIndexFind(const char *aid, size_t aidlen) {
+    size_t lo = 0;
+    size_t hi = aid_index_len;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (strncmp(aid_index[mid].aid, aid, aidlen) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo < aid_index_len && strlen(aid_index[lo].aid) == aidlen && strncmp(aid_index[lo].aid, aid, aidlen) == 0)
+        return aid_index[lo].elm;
+    return NULL;
+}
+
 int PrintAIDDescription(json_t *xroot, char *aid, bool verbose) {
     int retval = PM3_SUCCESS;
 
@@ -119,19 +192,13 @@ int PrintAIDDescription(json_t *xroot, char *aid, bool verbose) {
     if (root == NULL)
         goto out;
 
+    if (aidIndexBuild(root) == false)
+        goto out;
+
+    // the longest AID of the list the requested one starts with
     json_t *elm = NULL;
-    uint32_t maxaidlen = 0;
-    for (uint32_t elmindx = 0; elmindx < json_array_size(root); elmindx++) {
-        json_t *data = AIDSearchGetElm(root, elmindx);
-        if (data == NULL)
-            continue;
-        const char *dictaid = jsonStrGet(data, "AID");
-        if (aidCompare(aid, dictaid)) {  // dictaid may be less length than requested aid
-            if (maxaidlen < strlen(dictaid) && strlen(dictaid) <= strlen(aid)) {
-                maxaidlen = strlen(dictaid);
-                elm = data;
-            }
-        }
+    for (size_t len = strlen(aid); len > 0 && elm == NULL; len--) {
+        elm = aidIndexFind(aid, len);
     }
 
     if (elm == NULL)
@@ -9,7 +9,9 @@
 //-----------------------------------------------------------------------------
 #include "cmdanalyse.h"
 
+#include <stdio.h>
 #include <stdlib.h>       // size_t
+#include <inttypes.h>
 #include <string.h>
 #include <ctype.h>        // tolower
 //#include <stdio.h>        // printf
@@ -19,8 +21,16 @@
 #include "ui.h"           // PrintAndLog
 #include "crc.h"
 #include "crc16.h"        // crc16 ccitt
+#include "crc32.h"
+#include "crc64.h"
+#include "util_posix.h"   // msclock
 #include "tea.h"
 #include "legic_prng.h"
+#include "prng.h"         // burtle
+#include "crapto1/crapto1.h"
+#include "ht2bitslice.h"
+#include "loclass/cipher.h"
+#include "mifare/desfire_crypto.h"
 #include "cmddata.h"      // demodbuffer
 
 static int CmdHelp(const char *Cmd);
@@ -67,16 +77,63 @@ static int usage_analyse_crc(void) {
     PrintAndLogEx(NORMAL, "      analyse crc 137AF00A0A0D");
     return PM3_SUCCESS;
 }
+static int usage_analyse_crcbench(void) {
+    PrintAndLogEx(NORMAL, "Benchmark of the CRC kernels against their bit wise reference, on random data");
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(NORMAL, "Usage:  analyse crcbench [h] [<kB>]");
+    PrintAndLogEx(NORMAL, "Options:");
+    PrintAndLogEx(NORMAL, "           h          This help");
+    PrintAndLogEx(NORMAL, "           <kB>       buffer size in kB, default 1024");
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(NORMAL, "Examples:");
+    PrintAndLogEx(NORMAL, "      analyse crcbench");
+    PrintAndLogEx(NORMAL, "      analyse crcbench 16");
+    return PM3_SUCCESS;
+}
+static int usage_analyse_cryptobench(void) {
+    PrintAndLogEx(NORMAL, "Benchmark of the crypto primitives on fixed, seeded inputs. The counts do not change");
+    PrintAndLogEx(NORMAL, "between releases, so the times compare builds, compilers and instruction sets");
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(NORMAL, "Usage:  analyse cryptobench [h] [<scale>]");
+    PrintAndLogEx(NORMAL, "Options:");
+    PrintAndLogEx(NORMAL, "           h          This help");
+    PrintAndLogEx(NORMAL, "           <scale>    multiplies the counts, 1-100, default 1");
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(NORMAL, "Examples:");
+    PrintAndLogEx(NORMAL, "      analyse cryptobench");
+    PrintAndLogEx(NORMAL, "      analyse cryptobench 10");
+    return PM3_SUCCESS;
+}
 static int usage_analyse_nuid(void) {
-    PrintAndLogEx(NORMAL, "Generate 4byte NUID from 7byte UID");
+    PrintAndLogEx(NORMAL, "Generate 4byte NUID from 7byte UID, or find the UIDs of a NUID");
     PrintAndLogEx(NORMAL, "");
-    PrintAndLogEx(NORMAL, "Usage:  analyse hid [h] <bytes>");
+    PrintAndLogEx(NORMAL, "Usage:  analyse nuid [h] [t] <bytes>");
+    PrintAndLogEx(NORMAL, "        analyse nuid s <nuid> <prefix>");
     PrintAndLogEx(NORMAL, "Options:");
     PrintAndLogEx(NORMAL, "           h          This help");
+    PrintAndLogEx(NORMAL, "           t          selftest");
     PrintAndLogEx(NORMAL, "           <bytes>  input bytes (14 hexsymbols)");
+    PrintAndLogEx(NORMAL, "           s        list the UIDs starting with <prefix> (3-6 bytes) which give <nuid> (4 bytes)");
     PrintAndLogEx(NORMAL, "");
     PrintAndLogEx(NORMAL, "Examples:");
     PrintAndLogEx(NORMAL, "      analyse nuid 11223344556677");
+    PrintAndLogEx(NORMAL, "      analyse nuid s 8F430FEF 040D681AB5");
+    return PM3_SUCCESS;
+}
+static int usage_analyse_lfsr(void) {
+    PrintAndLogEx(NORMAL, "LEGIC LFSR tests, the 12 bit lfsr output after each bit of IV");
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(NORMAL, "Usage:  analyse lfsr [h] <iv> [find]");
+    PrintAndLogEx(NORMAL, "        analyse lfsr s <value>");
+    PrintAndLogEx(NORMAL, "Options:");
+    PrintAndLogEx(NORMAL, "           h          This help");
+    PrintAndLogEx(NORMAL, "           <iv>     IV, hex");
+    PrintAndLogEx(NORMAL, "           [find]   XOR shown next to each lfsr, hex");
+    PrintAndLogEx(NORMAL, "           s        list the IV and bit# of every lfsr output equal to <value>, hex");
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(NORMAL, "Examples:");
+    PrintAndLogEx(NORMAL, "      analyse lfsr 55 40");
+    PrintAndLogEx(NORMAL, "      analyse lfsr s 0A3");
     return PM3_SUCCESS;
 }
 static int usage_analyse_a(void) {
@@ -246,8 +303,34 @@ static uint16_t calcBSDchecksum4(uint8_t *bytes, uint8_t len, uint32_t mask) {
 }
 
 // measuring LFSR maximum length
+// every IV and bit# of the table below whose 12 bit lfsr output is value
+static int analyse_lfsr_search(uint16_t value) {
+    uint32_t found = 0;
+    PrintAndLogEx(NORMAL, " iv | bit# \n");
+    for (uint16_t iv = 0x01; iv <= 0x7F; iv++) {
+        for (uint8_t i = 0x01; i < 0x30; i++) {
+            legic_prng_init(iv);
+            legic_prng_forward(i);
+            uint16_t lfsr = legic_prng_get_bits(12);
+            if (lfsr == value) {
+                PrintAndLogEx(NORMAL, " %02X | %02X \n", iv, i);
+                found++;
+            }
+        }
+    }
+    PrintAndLogEx(SUCCESS, "found " _YELLOW_("%u") " of lfsr " _YELLOW_("%03X"), found, value);
+    return PM3_SUCCESS;
+}
+
 static int CmdAnalyseLfsr(const char *Cmd) {
 
+    char cmdp = tolower(param_getchar(Cmd, 0));
+    if (cmdp == 'h') return usage_analyse_lfsr();
+    if (cmdp == 's') {
+        if (param_getlength(Cmd, 1) == 0) return usage_analyse_lfsr();
+        return analyse_lfsr_search(param_get32ex(Cmd, 1, 0, 16) & 0xFFF);
+    }
+
     uint8_t iv = param_get8ex(Cmd, 0, 0, 16);
     uint8_t find = param_get8ex(Cmd, 1, 0, 16);
 
@@ -379,6 +462,409 @@ static int CmdAnalyseCRC(const char *Cmd) {
     free(data);
     return 0;
 }
+// every kernel runs over CRCBENCH_TOTAL bytes, the buffer is repeated as needed
+#define CRCBENCH_TOTAL  (32 * 1024 * 1024)
+
+static void crcbench_print(const char *name, uint64_t ms, size_t len, bool ok) {
+    PrintAndLogEx(SUCCESS, "%-22s %6" PRIu64 " ms  %8.1f MB/s  %s", name, ms, len / 1000.0 / (double)MAX(ms, 1), ok ? _GREEN_("ok") : _RED_("mismatch"));
+}
+
+static int CmdAnalyseCRCBench(const char *Cmd) {
+    char cmdp = tolower(param_getchar(Cmd, 0));
+    if (cmdp == 'h') return usage_analyse_crcbench();
+
+    size_t len = 1024 * 1024;
+    if (cmdp != 0x00) {
+        uint32_t kb = param_get32ex(Cmd, 0, 0, 10);
+        if (kb == 0 || kb > CRCBENCH_TOTAL / 1024) return usage_analyse_crcbench();
+        len = (size_t)kb * 1024;
+    }
+
+    uint8_t *data = calloc(len, sizeof(uint8_t));
+    if (data == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+    for (size_t i = 0; i < len; i++)
+        data[i] = rand() & 0xFF;
+
+    size_t rounds = CRCBENCH_TOTAL / len;
+    size_t total = rounds * len;
+    bool all_ok = true;
+    uint64_t t;
+
+    PrintAndLogEx(INFO, "buffer " _YELLOW_("%zu") " bytes, " _YELLOW_("%zu") " rounds", len, rounds);
+
+    // CRC-A, the bit loop is the reference
+    uint16_t ref16 = 0;
+    t = msclock();
+    for (size_t r = 0; r < rounds; r++)
+        ref16 = Crc16(data, len, 0xC6C6, CRC16_POLY_CCITT, true, true);
+    crcbench_print("crc16 a bitwise", msclock() - t, total, true);
+
+    uint16_t crc16 = 0;
+    init_table(CRC_14443_A);
+    t = msclock();
+    for (size_t r = 0; r < rounds; r++)
+        crc16 = crc16_a(data, len);
+    crcbench_print("crc16 a sliced", msclock() - t, total, crc16 == ref16);
+    all_ok &= (crc16 == ref16);
+
+    // trace annotation, short frames on alternating crc types
+    uint32_t frames = 0, frames_ref = 0;
+    t = msclock();
+    for (size_t r = 0; r < rounds; r++) {
+        for (size_t i = 0; i + 18 <= len; i += 18) {
+            frames = (frames << 1 | frames >> 31) ^ Crc16ex(CRC_14443_A, data + i, 18);
+            frames = (frames << 1 | frames >> 31) ^ Crc16ex(CRC_FELICA, data + i, 18);
+        }
+    }
+    uint64_t ms = msclock() - t;
+    for (size_t r = 0; r < rounds; r++) {
+        for (size_t i = 0; i + 18 <= len; i += 18) {
+            frames_ref = (frames_ref << 1 | frames_ref >> 31) ^ Crc16(data + i, 18, 0xC6C6, CRC16_POLY_CCITT, true, true);
+            frames_ref = (frames_ref << 1 | frames_ref >> 31) ^ Crc16(data + i, 18, 0x0000, CRC16_POLY_CCITT, false, false);
+        }
+    }
+    crcbench_print("crc16 frames a/felica", ms, rounds * (len / 18) * 36, frames == frames_ref);
+    all_ok &= (frames == frames_ref);
+
+    uint32_t ref32 = 0;
+    t = msclock();
+    for (size_t r = 0; r < rounds; r++) {
+        ref32 = CRC32_PRESET;
+        crc32_update_kernel(CRC32_BITWISE, &ref32, data, len);
+    }
+    crcbench_print("crc32 bitwise", msclock() - t, total, true);
+
+    uint32_t crc32 = 0;
+    t = msclock();
+    for (size_t r = 0; r < rounds; r++) {
+        crc32 = CRC32_PRESET;
+        crc32_update_kernel(CRC32_SLICE8, &crc32, data, len);
+    }
+    crcbench_print("crc32 sliced", msclock() - t, total, crc32 == ref32);
+    all_ok &= (crc32 == ref32);
+
+    const char *hw = crc32_hw_kernel();
+    if (hw) {
+        char name[30];
+        snprintf(name, sizeof(name), "crc32 %s", hw);
+        // odd length and offset, to go through the unaligned head and the tail
+        bool ok = true;
+        for (size_t l = 0; l + 1 < MIN(len, 300); l++) {
+            uint32_t ref_odd = CRC32_PRESET;
+            crc32_update_kernel(CRC32_SLICE8, &ref_odd, data + 1, l);
+            uint32_t hw_odd = CRC32_PRESET;
+            crc32_update_kernel(CRC32_HW, &hw_odd, data + 1, l);
+            ok &= (hw_odd == ref_odd);
+        }
+
+        t = msclock();
+        for (size_t r = 0; r < rounds; r++) {
+            crc32 = CRC32_PRESET;
+            crc32_update_kernel(CRC32_HW, &crc32, data, len);
+        }
+        ok &= (crc32 == ref32);
+        crcbench_print(name, msclock() - t, total, ok);
+        all_ok &= ok;
+    } else {
+        PrintAndLogEx(INFO, "crc32 no hardware kernel on this cpu");
+    }
+
+    uint64_t ref64 = 0;
+    t = msclock();
+    for (size_t r = 0; r < rounds; r++) {
+        ref64 = 0;
+        for (size_t i = 0; i < len; i++)
+            ref64 = crc64_table[((ref64 >> 56) ^ data[i]) & 0xFF] ^ (ref64 << 8);
+    }
+    crcbench_print("crc64 bytewise", msclock() - t, total, true);
+
+    uint64_t crc64v = 0;
+    t = msclock();
+    for (size_t r = 0; r < rounds; r++) {
+        crc64v = 0;
+        crc64(data, len, &crc64v);
+    }
+    crcbench_print("crc64 sliced", msclock() - t, total, crc64v == ref64);
+    all_ok &= (crc64v == ref64);
+
+    free(data);
+    PrintAndLogEx(NORMAL, "");
+    if (all_ok) {
+        PrintAndLogEx(SUCCESS, "CRC kernels ( " _GREEN_("ok") " )");
+        return PM3_SUCCESS;
+    }
+    PrintAndLogEx(FAILED, "CRC kernels ( " _RED_("fail") " )");
+    return PM3_ESOFT;
+}
+
+static void cryptobench_print(const char *name, uint64_t us, uint64_t ops, int ok) {
+    PrintAndLogEx(SUCCESS, "%-24s %9" PRIu64 " ops %8.1f ms %12.1f ns/op  %s", name, ops, us / 1000.0, us * 1000.0 / (double)MAX(ops, 1),
+                  (ok < 0) ? "" : (ok ? _GREEN_("ok") : _RED_("mismatch")));
+}
+
+static int CmdAnalyseCryptoBench(const char *Cmd) {
+    char cmdp = tolower(param_getchar(Cmd, 0));
+    if (cmdp == 'h') return usage_analyse_cryptobench();
+
+    uint32_t scale = 1;
+    if (cmdp != 0x00) {
+        scale = param_get32ex(Cmd, 0, 0, 10);
+        if (scale == 0 || scale > 100) return usage_analyse_cryptobench();
+    }
+
+#if defined(__VERSION__)
+    PrintAndLogEx(INFO, "compiler " _YELLOW_("%s"), __VERSION__);
+#endif
+    PrintAndLogEx(INFO, "simd " _YELLOW_("%s") ", hitag2 bitslices of %u lanes",
+#if defined(__AVX512F__)
+                  "avx512",
+#elif defined(__AVX2__)
+                  "avx2",
+#elif defined(__SSE2__)
+                  "sse2",
+#elif defined(__ARM_NEON)
+                  "neon",
+#else
+                  "none",
+#endif
+                  HT2BS_LANES);
+
+    // every input comes from this seed
+    prng_ctx rng;
+    burtle_init(&rng, 0x5EED1234);
+
+    bool all_ok = true;
+    uint64_t t, ops;
+
+    // crypto1, keystream words
+    uint64_t key = ((uint64_t)burtle_get_mod(&rng) << 16 | (burtle_get_mod(&rng) & 0xFFFF)) & 0xFFFFFFFFFFFF;
+    uint32_t nt = burtle_get_mod(&rng);
+    struct Crypto1State *s = crypto1_create(key);
+    uint32_t ks = 0;
+    ops = 2000000ULL * scale;
+    t = usclock();
+    for (uint64_t i = 0; i < ops; i++)
+        ks ^= crypto1_word(s, (uint32_t)i, 0);
+    cryptobench_print("crypto1_word", usclock() - t, ops, -1);
+
+    // rolled back as far as it went forward, the state is the one it started with
+    uint64_t lfsr_before, lfsr_after;
+    crypto1_init(s, key);
+    crypto1_get_lfsr(s, &lfsr_before);
+    ops = 1000000ULL * scale;
+    for (uint64_t i = 0; i < ops; i++)
+        crypto1_word(s, (uint32_t)i, 0);
+    t = usclock();
+    for (uint64_t i = ops; i > 0; i--)
+        lfsr_rollback_word(s, (uint32_t)(i - 1), 0);
+    uint64_t us = usclock() - t;
+    crypto1_get_lfsr(s, &lfsr_after);
+    cryptobench_print("lfsr_rollback_word", us, ops, lfsr_before == lfsr_after);
+    all_ok &= (lfsr_before == lfsr_after);
+
+    ops = 10000000ULL * scale;
+    uint32_t n = nt;
+    t = usclock();
+    for (uint64_t i = 0; i < ops; i++)
+        n = prng_successor(n, 1);
+    cryptobench_print("prng_successor", usclock() - t, ops, -1);
+
+    // key recovery from the keystream of an authentication, the key has to be among the candidates
+    bool ok = true;
+    ops = 4ULL * scale;
+    uint64_t us32 = 0, us64 = 0;
+    uint64_t ops64 = 20ULL * scale;
+    for (uint64_t i = 0; i < ops; i++) {
+        uint64_t k = ((uint64_t)burtle_get_mod(&rng) << 16 | (burtle_get_mod(&rng) & 0xFFFF)) & 0xFFFFFFFFFFFF;
+        uint32_t u = burtle_get_mod(&rng), nonce = burtle_get_mod(&rng), nr = burtle_get_mod(&rng);
+        crypto1_init(s, k);
+        crypto1_word(s, u ^ nonce, 0);
+        uint32_t ks2 = crypto1_word(s, nr, 0);
+
+        t = usclock();
+        struct Crypto1State *revstate = lfsr_recovery32(ks2, nr);
+        us32 += usclock() - t;
+
+        bool found = false;
+        for (struct Crypto1State *r = revstate; revstate && (r->odd | r->even); r++) {
+            struct Crypto1State back = *r;
+            lfsr_rollback_word(&back, nr, 0);
+            lfsr_rollback_word(&back, u ^ nonce, 0);
+            uint64_t rk = 0;
+            crypto1_get_lfsr(&back, &rk);
+            if (rk == k) {
+                found = true;
+                break;
+            }
+        }
+        free(revstate);
+        ok &= found;
+    }
+    cryptobench_print("lfsr_recovery32", us32, ops, ok);
+    all_ok &= ok;
+
+    ok = true;
+    for (uint64_t i = 0; i < ops64; i++) {
+        uint64_t k = ((uint64_t)burtle_get_mod(&rng) << 16 | (burtle_get_mod(&rng) & 0xFFFF)) & 0xFFFFFFFFFFFF;
+        crypto1_init(s, k);
+        uint32_t ks2 = crypto1_word(s, 0, 0);
+        uint32_t ks3 = crypto1_word(s, 0, 0);
+
+        t = usclock();
+        struct Crypto1State *revstate = lfsr_recovery64(ks2, ks3);
+        us64 += usclock() - t;
+        if (revstate) {
+            lfsr_rollback_word(revstate, 0, 0);
+            lfsr_rollback_word(revstate, 0, 0);
+            uint64_t rk = 0;
+            crypto1_get_lfsr(revstate, &rk);
+            ok &= (rk == k);
+        } else {
+            ok = false;
+        }
+        crypto1_destroy(revstate);
+    }
+    cryptobench_print("lfsr_recovery64", us64, ops64, ok);
+    all_ok &= ok;
+    crypto1_destroy(s);
+
+    // iClass MAC, one at a time and batched
+    size_t nmacs = 20000 * scale;
+    uint8_t *cc_nr = calloc(nmacs, 12);
+    uint8_t *div_keys = calloc(nmacs, 8);
+    uint8_t *macs = calloc(nmacs, 4);
+    uint8_t *macs_batch = calloc(nmacs, 4);
+    if (cc_nr == NULL || div_keys == NULL || macs == NULL || macs_batch == NULL) {
+        free(cc_nr);
+        free(div_keys);
+        free(macs);
+        free(macs_batch);
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+    for (size_t i = 0; i < nmacs * 12; i++)
+        cc_nr[i] = burtle_get_mod(&rng) & 0xFF;
+    for (size_t i = 0; i < nmacs * 8; i++)
+        div_keys[i] = burtle_get_mod(&rng) & 0xFF;
+
+    t = usclock();
+    for (size_t i = 0; i < nmacs; i++)
+        doMAC(cc_nr + i * 12, div_keys + i * 8, macs + i * 4);
+    cryptobench_print("iclass doMAC", usclock() - t, nmacs, -1);
+
+    t = usclock();
+    for (size_t i = 0; i < nmacs; i += MAC_BATCH_SIZE)
+        doMAC_batch(cc_nr + i * 12, 12, div_keys + i * 8, macs_batch + i * 4, MIN(nmacs - i, MAC_BATCH_SIZE));
+    us = usclock() - t;
+    ok = (memcmp(macs, macs_batch, nmacs * 4) == 0);
+    cryptobench_print("iclass doMAC_batch", us, nmacs, ok);
+    all_ok &= ok;
+    free(cc_nr);
+    free(div_keys);
+    free(macs);
+    free(macs_batch);
+
+    // hitag2, bitsliced key checks against one authentication
+    ht2bs_t keyslices[48];
+    ht2bs_t hit = {0};
+    uint32_t ht_uid = burtle_get_mod(&rng), ht_nonce = burtle_get_mod(&rng), ht_ks = burtle_get_mod(&rng);
+    uint64_t rounds = 20000ULL * scale;
+    t = usclock();
+    for (uint64_t r = 0; r < rounds; r++) {
+        ht2bs_counter(keyslices, r * HT2BS_LANES, 48);
+        hit |= ht2bs_check_keys(keyslices, ht_uid, ht_nonce, ht_ks);
+    }
+    cryptobench_print("hitag2 ht2bs_check_keys", usclock() - t, rounds * HT2BS_LANES, -1);
+
+    // legic prng
+    uint32_t legic = 0;
+    ops = 200000ULL * scale;
+    t = usclock();
+    for (uint64_t i = 0; i < ops; i++) {
+        legic_prng_init(i & 0x7F);
+        legic = legic * 31 + legic_prng_get_bits(32);
+    }
+    cryptobench_print("legic prng 32 bits", usclock() - t, ops, -1);
+
+    // desfire block ciphers, an encrypted block decrypts to what it was
+    struct {
+        const char *name;
+        void (*key_new)(const uint8_t *value, desfirekey_t key);
+        size_t block;
+        bool check;
+    } ciphers[] = {
+        { "desfire des block",    Desfire_des_key_new,     8, true },
+        { "desfire 2k3des block", Desfire_3des_key_new,    8, true },
+        { "desfire 3k3des block", Desfire_3k3des_key_new,  8, true },
+        // the aes decypher of a single block does not undo its encypher, timed only
+        { "desfire aes block",    Desfire_aes_key_new,    16, false },
+    };
+    uint8_t keyval[24];
+    for (size_t i = 0; i < sizeof(keyval); i++)
+        keyval[i] = burtle_get_mod(&rng) & 0xFF;
+    for (size_t c = 0; c < ARRAYLEN(ciphers); c++) {
+        struct desfire_key dkey;
+        ciphers[c].key_new(keyval, &dkey);
+        uint8_t data[16], orig[16], iv[16] = {0}, iv2[16] = {0};
+        for (size_t i = 0; i < sizeof(data); i++)
+            orig[i] = data[i] = burtle_get_mod(&rng) & 0xFF;
+
+        ops = (c == 0 ? 400000ULL : 100000ULL) * scale;
+        t = usclock();
+        for (uint64_t i = 0; i < ops; i++)
+            mifare_cypher_single_block(&dkey, data, iv, MCD_SEND, MCO_ENCYPHER, ciphers[c].block);
+        us = usclock() - t;
+
+        // one block from the start, decyphered with the iv it was sent with
+        memcpy(data, orig, sizeof(data));
+        memset(iv, 0, sizeof(iv));
+        mifare_cypher_single_block(&dkey, data, iv, MCD_SEND, MCO_ENCYPHER, ciphers[c].block);
+        mifare_cypher_single_block(&dkey, data, iv2, MCD_RECEIVE, MCO_DECYPHER, ciphers[c].block);
+        if (ciphers[c].check) {
+            ok = (memcmp(data, orig, ciphers[c].block) == 0);
+            cryptobench_print(ciphers[c].name, us, ops, ok);
+            all_ok &= ok;
+        } else {
+            cryptobench_print(ciphers[c].name, us, ops, -1);
+        }
+    }
+
+    // tea, decrypted back to the plaintext
+    uint8_t tea_key[16], tea_v[8], tea_orig[8];
+    for (size_t i = 0; i < sizeof(tea_key); i++)
+        tea_key[i] = burtle_get_mod(&rng) & 0xFF;
+    for (size_t i = 0; i < sizeof(tea_v); i++)
+        tea_orig[i] = tea_v[i] = burtle_get_mod(&rng) & 0xFF;
+    ops = 500000ULL * scale;
+    t = usclock();
+    for (uint64_t i = 0; i < ops; i++)
+        tea_encrypt(tea_v, tea_key);
+    us = usclock() - t;
+    for (uint64_t i = 0; i < ops; i++)
+        tea_decrypt(tea_v, tea_key);
+    ok = (memcmp(tea_v, tea_orig, sizeof(tea_v)) == 0);
+    cryptobench_print("tea_encrypt", us, ops, ok);
+    all_ok &= ok;
+
+    // burtle prng
+    prng_ctx bench_rng;
+    burtle_init(&bench_rng, 0x12345678);
+    uint32_t acc = 0;
+    ops = 10000000ULL * scale;
+    t = usclock();
+    for (uint64_t i = 0; i < ops; i++)
+        acc += burtle_get_mod(&bench_rng);
+    cryptobench_print("burtle_get_mod", usclock() - t, ops, -1);
+
+    // keep the results the compiler would drop otherwise
+    PrintAndLogEx(DEBUG, "%08x %08x %08x %08x %s", ks, n, legic, acc, ht2bs_any(hit) ? "hit" : "-");
+    PrintAndLogEx(SUCCESS, "crypto primitives ( %s )", all_ok ? _GREEN_("ok") : _RED_("fail"));
+    return all_ok ? PM3_SUCCESS : PM3_ESOFT;
+}
+
 static int CmdAnalyseCHKSUM(const char *Cmd) {
 
     uint8_t data[50];
@@ -854,6 +1340,101 @@ static void generate4bNUID(uint8_t *uid, uint8_t *nuid) {
     nuid[3] = crc & 0xFF;
 }
 
+// The UIDs starting with the plen (3..6) bytes of prefix which give nuid, *uids gets
+// 7 bytes per UID, the caller frees it.
+//
+// With the first three bytes known, nuid[0..1] are fixed and nuid[2..3] is a CRC over
+// uid[3..6], affine in those bytes: crc(x) = crc(0) ^ T3[x3] ^ T4[x4] ^ T5[x5] ^ T6[x6].
+// T5[x5] ^ T6[x6] is a bijection on 16 bits, so for each choice of the bytes before them
+// exactly one uid[5..6] fits. At most 2^16 UIDs to list, no 2^32 scan
+static int nuid_search(const uint8_t *nuid, const uint8_t *prefix, uint8_t plen, uint8_t **uids, uint32_t *count) {
+    *uids = NULL;
+    *count = 0;
+    if (plen < 3 || plen > 6)
+        return PM3_EINVARG;
+
+    uint8_t uid[7] = {0};
+    uint8_t n[4];
+    memcpy(uid, prefix, plen);
+    generate4bNUID(uid, n);
+    if (n[0] != nuid[0] || n[1] != nuid[1])
+        return PM3_SUCCESS;
+
+    uint16_t base = (n[2] << 8) | n[3];
+    uint16_t target = ((nuid[2] << 8) | nuid[3]) ^ base;
+
+    uint16_t t[7][256];
+    for (uint8_t k = 3; k < 7; k++) {
+        for (uint16_t b = 0; b < 256; b++) {
+            uint8_t u[7];
+            memcpy(u, uid, sizeof(u));
+            u[k] = b;
+            generate4bNUID(u, n);
+            t[k][b] = ((n[2] << 8) | n[3]) ^ base;
+        }
+    }
+
+    if (plen == 6) {
+        // one byte left, no bijection to use
+        uint8_t *res = calloc(256, sizeof(uid));
+        if (res == NULL)
+            return PM3_EMALLOC;
+        for (uint16_t b = 0; b < 256; b++) {
+            if (t[6][b] == target) {
+                memcpy(res + *count * sizeof(uid), uid, 6);
+                res[*count * sizeof(uid) + 6] = b;
+                (*count)++;
+            }
+        }
+        *uids = res;
+        return PM3_SUCCESS;
+    }
+
+    // uid[5..6] of each 16 bit value
+    uint16_t *inv = calloc(0x10000, sizeof(uint16_t));
+    uint8_t *seen = calloc(0x10000, sizeof(uint8_t));
+    if (inv == NULL || seen == NULL) {
+        free(inv);
+        free(seen);
+        return PM3_EMALLOC;
+    }
+    for (uint32_t x = 0; x < 0x10000; x++) {
+        uint16_t v = t[5][x >> 8] ^ t[6][x & 0xFF];
+        if (seen[v]) {
+            free(inv);
+            free(seen);
+            return PM3_ESOFT;
+        }
+        seen[v] = 1;
+        inv[v] = x;
+    }
+    free(seen);
+
+    // bytes between the prefix and uid[5]
+    uint32_t free_bytes = 5 - plen;
+    uint32_t combos = 1u << (8 * free_bytes);
+    uint8_t *res = calloc(combos, sizeof(uid));
+    if (res == NULL) {
+        free(inv);
+        return PM3_EMALLOC;
+    }
+    for (uint32_t c = 0; c < combos; c++) {
+        uint8_t *u = res + c * sizeof(uid);
+        memcpy(u, uid, sizeof(uid));
+        uint16_t d = target;
+        for (uint32_t k = 0; k < free_bytes; k++) {
+            u[plen + k] = (c >> (8 * (free_bytes - 1 - k))) & 0xFF;
+            d ^= t[plen + k][u[plen + k]];
+        }
+        u[5] = inv[d] >> 8;
+        u[6] = inv[d] & 0xFF;
+    }
+    free(inv);
+    *uids = res;
+    *count = combos;
+    return PM3_SUCCESS;
+}
+
 static int CmdAnalyseNuid(const char *Cmd) {
     uint8_t nuid[4] = {0};
     uint8_t uid[7] = {0};
@@ -879,9 +1460,53 @@ static int CmdAnalyseNuid(const char *Cmd) {
         generate4bNUID(uid, nuid);
         bool test2 = (0 == memcmp(nuid, nuid_test2, sizeof(nuid)));
         PrintAndLogEx(SUCCESS, "Selftest2 %s\n", test2 ? _GREEN_("OK") : _RED_("Fail"));
+
+        // the search with the first three bytes of UID 1 must list it, and give its NUID every time
+        bool test3 = false;
+        uint8_t *uids = NULL;
+        uint32_t count = 0;
+        if (nuid_search(nuid_test1, uid_test1, 3, &uids, &count) == PM3_SUCCESS && count == 0x10000) {
+            test3 = true;
+            bool listed = false;
+            for (uint32_t i = 0; i < count; i++) {
+                generate4bNUID(uids + i * sizeof(uid), nuid);
+                if (memcmp(nuid, nuid_test1, sizeof(nuid)))
+                    test3 = false;
+                if (memcmp(uids + i * sizeof(uid), uid_test1, sizeof(uid)) == 0)
+                    listed = true;
+            }
+            test3 &= listed;
+        }
+        free(uids);
+        PrintAndLogEx(SUCCESS, "Selftest3 %s\n", test3 ? _GREEN_("OK") : _RED_("Fail"));
         return 0;
     }
 
+    if (cmdp == 's') {
+        uint8_t prefix[7] = {0};
+        int plen = 0;
+        if (param_getlength(Cmd, 1) != 8 || param_gethex_ex(Cmd, 1, nuid, &len))
+            return usage_analyse_nuid();
+        plen = param_getlength(Cmd, 2);
+        if (plen < 6 || plen > 12 || param_gethex_ex(Cmd, 2, prefix, &plen))
+            return usage_analyse_nuid();
+        plen >>= 1;
+
+        uint8_t *uids = NULL;
+        uint32_t count = 0;
+        uint64_t t1 = msclock();
+        int res = nuid_search(nuid, prefix, plen, &uids, &count);
+        if (res != PM3_SUCCESS) {
+            PrintAndLogEx(FAILED, "search failed");
+            return res;
+        }
+        for (uint32_t i = 0; i < count; i++)
+            PrintAndLogEx(NORMAL, "UID  | %s", sprint_hex_inrow(uids + i * sizeof(uid), sizeof(uid)));
+        free(uids);
+        PrintAndLogEx(SUCCESS, "found " _YELLOW_("%u") " UIDs with NUID %s in %" PRIu64 " ms", count, sprint_hex_inrow(nuid, sizeof(nuid)), msclock() - t1);
+        return PM3_SUCCESS;
+    }
+
     param_gethex_ex(Cmd, 0, uid, &len);
     if (len % 2  || len != 14) return usage_analyse_nuid();
 
@@ -945,6 +1570,8 @@ static command_t CommandTable[] = {
     {"help",    CmdHelp,            AlwaysAvailable, "This help"},
     {"lcr",     CmdAnalyseLCR,      AlwaysAvailable, "Generate final byte for XOR LRC"},
     {"crc",     CmdAnalyseCRC,      AlwaysAvailable, "Stub method for CRC evaluations"},
+    {"crcbench", CmdAnalyseCRCBench, AlwaysAvailable, "Benchmark the CRC kernels"},
+    {"cryptobench", CmdAnalyseCryptoBench, AlwaysAvailable, "Benchmark the crypto primitives"},
     {"chksum",  CmdAnalyseCHKSUM,   AlwaysAvailable, "Checksum with adding, masking and one's complement"},
     {"dates",   CmdAnalyseDates,    AlwaysAvailable, "Look for datestamps in a given array of bytes"},
     {"tea",     CmdAnalyseTEASelfTest, AlwaysAvailable, "Crypto TEA test"},
@@ -13,6 +13,8 @@
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <strings.h>
+#include <pthread.h>
 
 #ifdef _WIN32
 #  include <io.h>
@@ -24,7 +26,8 @@
 
 #include "reveng.h"
 #include "ui.h"
-#include "util.h"
+#include "util.h"   // num_CPUs
+#include "commonutil.h"  // ARRAYLEN
 
 #define MAX_ARGS 20
 
@@ -388,115 +391,404 @@ static int CmdrevengTestC(const char *Cmd) {
     return 1;
 }
 */
-//returns a calloced string (needs to be freed)
-static char *SwapEndianStr(const char *inStr, const size_t len, const uint8_t blockSize) {
-    char *tmp = calloc(len + 1, sizeof(char));
-    for (uint8_t block = 0; block < (uint8_t)(len / blockSize); block++) {
-        for (size_t i = 0; i < blockSize; i += 2) {
-            tmp[i + (blockSize * block)] = inStr[(blockSize - 1 - i - 1) + (blockSize * block)];
-            tmp[i + (blockSize * block) + 1] = inStr[(blockSize - 1 - i) + (blockSize * block)];
+// Catalogue search. Every preset model is compiled once, plain and reversed (RunModel reverse = true),
+// into a slice-by-8 table on a left aligned 64 bit register. Models wider than 64 bits keep going
+// through RunModel
+typedef struct {
+    char *name;
+    uint8_t width;
+    int flags;
+    bool reverse;
+    bool fast;
+    uint64_t init;
+    uint64_t xorout;
+    uint64_t (*table)[256];
+} crc_kernel_t;
+
+static crc_kernel_t *crc_kernels = NULL;
+static int crc_kernels_count = 0;
+static pthread_once_t crc_kernels_once = PTHREAD_ONCE_INIT;
+
+#define CRC_SEARCH_MAX_THREADS  16
+// below this frame size the search stays on the caller's thread
+#define CRC_SEARCH_MT_BYTES     64
+
+static uint8_t crc_rev8(uint8_t b) {
+    b = (b & 0xF0) >> 4 | (b & 0x0F) << 4;
+    b = (b & 0xCC) >> 2 | (b & 0x33) << 2;
+    b = (b & 0xAA) >> 1 | (b & 0x55) << 1;
+    return b;
+}
+
+static uint64_t crc_rev64(uint64_t v) {
+    uint64_t r = 0;
+    for (int i = 0; i < 8; i++)
+        r = (r << 8) | crc_rev8((v >> (i * 8)) & 0xFF);
+    return r;
+}
+
+static uint8_t crc_hexnibble(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    return (tolower(c) - 'a' + 10) & 0x0F;
+}
+
+static uint64_t crc_poly_u64(const poly_t poly) {
+    char *s = ptostr(poly, P_RTJUST, 4);
+    uint64_t v = (s && *s) ? strtoull(s, NULL, 16) : 0;
+    free(s);
+    return v;
+}
+
+// same model set up as RunModel(), endian = 0
+static void crc_kernel_compile(int num, bool reverse, crc_kernel_t *k) {
+    model_t model = MZERO;
+    poly_t apoly;
+
+    mbynum(&model, num);
+    mcanon(&model);
+    k->name = strdup(model.name ? model.name : "");
+    k->reverse = reverse;
+
+    if (reverse) {
+        prcp(&model.spoly);
+        if (~model.flags & P_REFOUT) {
+            prev(&model.init);
+            prev(&model.xorout);
+        }
+        apoly = model.init;
+        model.init = model.xorout;
+        model.xorout = apoly;
+    }
+    if (model.flags & P_REFOUT)
+        prev(&model.xorout);
+
+    k->width = (uint8_t)MIN(plen(model.spoly), 255);
+    k->flags = model.flags;
+    k->fast = (plen(model.spoly) > 0) && (plen(model.spoly) <= 64) && (model.flags & P_MULXN) && (~model.flags & P_SPACE);
+    if (k->fast) {
+        uint8_t shift = 64 - k->width;
+        uint64_t poly = crc_poly_u64(model.spoly) << shift;
+        k->init = crc_poly_u64(model.init) << shift;
+        k->xorout = crc_poly_u64(model.xorout) << shift;
+
+        k->table = calloc(8, sizeof(*k->table));
+        if (k->table == NULL) {
+            k->fast = false;
+        } else {
+            for (int b = 0; b < 256; b++) {
+                uint64_t r = (uint64_t)b << 56;
+                for (int i = 0; i < 8; i++)
+                    r = (r & 0x8000000000000000ULL) ? (r << 1) ^ poly : r << 1;
+                k->table[0][b] = r;
+            }
+            for (int t = 1; t < 8; t++) {
+                for (int b = 0; b < 256; b++) {
+                    uint64_t r = k->table[t - 1][b];
+                    k->table[t][b] = (r << 8) ^ k->table[0][r >> 56];
+                }
+            }
         }
     }
-    return tmp;
+    mfree(&model);
 }
 
-// takes hex string in and searches for a matching result (hex string must include checksum)
-static int CmdrevengSearch(const char *Cmd) {
+static void crc_kernels_init(void) {
+    SETBMP();
+    int count = mcount();
+    if (count <= 0)
+        return;
 
-#define NMODELS 106
+    crc_kernels = calloc(count * 2, sizeof(crc_kernel_t));
+    if (crc_kernels == NULL)
+        return;
 
-    char inHexStr[100] = {0x00};
-    int dataLen = param_getstr(Cmd, 0, inHexStr, sizeof(inHexStr));
-    if (dataLen < 4) return 0;
+    for (int i = 0; i < count; i++) {
+        crc_kernel_compile(i, false, &crc_kernels[i * 2]);
+        crc_kernel_compile(i, true, &crc_kernels[i * 2 + 1]);
+    }
+    crc_kernels_count = count * 2;
+}
 
-    // these two arrays, must match preset size.
-    char *Models[NMODELS];
-    uint8_t width[NMODELS] = {0};
-    int count = 0;
+// MSB first remainder of the message, as pcrc() with P_MULXN, left aligned
+static uint64_t crc_kernel_run(const crc_kernel_t *k, const uint8_t *data, size_t len) {
+    uint64_t crc = k->init;
+    const uint64_t (*t)[256] = (const uint64_t (*)[256])k->table;
 
-    char result[30];
-    char revResult[30];
-    int ans = GetModels(Models, &count, width);
-    bool found = false;
-    if (!ans) return 0;
+    for (; len >= 8; len -= 8, data += 8) {
+        crc ^= (uint64_t)data[0] << 56 | (uint64_t)data[1] << 48 | (uint64_t)data[2] << 40 | (uint64_t)data[3] << 32 |
+               (uint64_t)data[4] << 24 | (uint64_t)data[5] << 16 | (uint64_t)data[6] << 8 | (uint64_t)data[7];
+        crc = t[7][crc >> 56] ^ t[6][(crc >> 48) & 0xFF] ^ t[5][(crc >> 40) & 0xFF] ^ t[4][(crc >> 32) & 0xFF] ^
+              t[3][(crc >> 24) & 0xFF] ^ t[2][(crc >> 16) & 0xFF] ^ t[1][(crc >> 8) & 0xFF] ^ t[0][crc & 0xFF];
+    }
+    while (len--)
+        crc = (crc << 8) ^ t[0][(crc >> 56) ^ *data++];
+
+    crc ^= k->xorout;
+    // RunModel reflects the whole crc of a reversed calculation
+    if (k->reverse)
+        crc = crc_rev64(crc) << (64 - k->width);
+    return crc;
+}
 
-    // try each model and get result
-    for (int i = 0; i < count; i++) {
-        /*if (found) {
-            free(Models[i]);
-            continue;
-        }*/
-        // round up to # of characters in this model's crc
-        uint8_t crcChars = ((width[i] + 7) / 8) * 2;
-        // can't test a model that has more crc digits than our data
-        if (crcChars >= dataLen)
-            continue;
+static void crc_prhex(char **sp, uint8_t b, int flags) {
+    const char *hex = (flags & P_UPPER) ? "0123456789ABCDEF" : "0123456789abcdef";
+    *(*sp)++ = hex[b >> 4];
+    *(*sp)++ = hex[b & 0x0F];
+}
 
-        PrintAndLogEx(DEBUG
-                      , "DEBUG: dataLen %d, crcChars %u,  width[i] %u"
-                      , dataLen
-                      , crcChars
-                      , width[i]
-                     );
+// ptostr(crc, flags, 8) of a width bit remainder, see pxsubs()
+static void crc_kernel_format(const crc_kernel_t *k, uint64_t rem, char *out) {
+    uint8_t w = k->width;
+    uint64_t r = rem >> (64 - w);
+    uint8_t part = w % 8;
+    uint8_t iter = 0;
+
+    if (part && (k->flags & P_RTJUST)) {
+        uint8_t accu = (r >> (w - part)) & ((1 << part) - 1);
+        if (k->flags & P_REFOUT)
+            accu = crc_rev8(accu);
+        crc_prhex(&out, accu, k->flags);
+        iter = part;
+    }
+    while ((iter += 8) <= w) {
+        uint8_t accu = (r >> (w - iter)) & 0xFF;
+        if (k->flags & P_REFOUT)
+            accu = crc_rev8(accu);
+        crc_prhex(&out, accu, k->flags);
+    }
+    if (part && (~k->flags & P_RTJUST)) {
+        uint8_t accu = r & ((1 << part) - 1);
+        if (k->flags & P_REFOUT)
+            accu = crc_rev8(accu) >> (8 - part);
+        else
+            accu <<= 8 - part;
+        crc_prhex(&out, accu, k->flags);
+    }
+    *out = '\0';
+}
 
-        if (crcChars == 0)
-            continue;
+typedef struct {
+    // message as read by strtop(), [refin ^ reverse] bit reflected bytes, [reverse] in reversed order
+    uint8_t *msg[2][2];
+    size_t len;
+    const char *crc;
+    size_t crc_chars;
+    crc_match_t *results;   // one slot per kernel, value[0] == 0 when it didn't match
+    int next;
+} crc_search_t;
+
+static bool crc_search_compare(const char *value, const char *crc, size_t crc_chars, bool *swapped) {
+    if (strlen(value) != crc_chars)
+        return false;
+    if (strncasecmp(value, crc, crc_chars) == 0) {
+        *swapped = false;
+        return true;
+    }
+    if (crc_chars <= 2)
+        return false;
+    for (size_t i = 0; i < crc_chars; i += 2) {
+        if (tolower(value[crc_chars - 2 - i]) != tolower(crc[i]) || tolower(value[crc_chars - 1 - i]) != tolower(crc[i + 1]))
+            return false;
+    }
+    *swapped = true;
+    return true;
+}
 
-        memset(result, 0, 30);
-        char *inCRC = calloc(crcChars + 1, sizeof(char));
-        memcpy(inCRC, inHexStr + (dataLen - crcChars), crcChars);
+static void crc_search_one(crc_search_t *s, int i) {
+    const crc_kernel_t *k = &crc_kernels[i];
+    crc_match_t *m = &s->results[i];
+    char value[sizeof(m->value)];
+    bool swapped = false;
+
+    // early rejection, crc can't be longer than the frame, and the crc digits must match the model width
+    uint8_t crc_chars = ((k->width + 7) / 8) * 2;
+    if (crc_chars == 0 || crc_chars != s->crc_chars)
+        return;
+
+    bool refl = ((k->flags & P_REFIN) != 0) ^ k->reverse;
+    crc_kernel_format(k, crc_kernel_run(k, s->msg[refl][k->reverse], s->len), value);
+    if (crc_search_compare(value, s->crc, s->crc_chars, &swapped) == false)
+        return;
+
+    m->name = k->name;
+    m->width = k->width;
+    m->reversed = k->reverse;
+    m->swapped = swapped;
+    if (swapped) {
+        for (size_t j = 0; j < s->crc_chars; j += 2) {
+            m->value[j] = value[s->crc_chars - 2 - j];
+            m->value[j + 1] = value[s->crc_chars - 1 - j];
+        }
+        m->value[s->crc_chars] = '\0';
+    } else {
+        strcpy(m->value, value);
+    }
+}
 
-        char *outHex = calloc(dataLen - crcChars + 1, sizeof(char));
-        memcpy(outHex, inHexStr, dataLen - crcChars);
+#define CRC_SEARCH_CHUNK    8
 
-        ans = RunModel(Models[i], outHex, false, 0, result);
-        if (ans) {
-            // test for match
-            if (memcmp(result, inCRC, crcChars) == 0) {
-                PrintAndLogEx(SUCCESS, "\nfound possible match\nmodel: %s | value: %s\n", Models[i], result);
-                //optional - stop searching if found...
-                found = true;
-            } else {
-                if (crcChars > 2) {
-                    char *swapEndian = SwapEndianStr(result, crcChars, crcChars);
-                    if (memcmp(swapEndian, inCRC, crcChars) == 0) {
-                        PrintAndLogEx(SUCCESS, "\nfound possible match\nmodel: %s | value endian swapped: %s\n", Models[i], swapEndian);
-                        // optional - stop searching if found...
-                        found = true;
-                    }
-                    free(swapEndian);
-                }
+static void *crc_search_worker(void *arg) {
+    crc_search_t *s = (crc_search_t *)arg;
+    for (;;) {
+        int start = __atomic_fetch_add(&s->next, CRC_SEARCH_CHUNK, __ATOMIC_SEQ_CST);
+        if (start >= crc_kernels_count)
+            break;
+        int end = MIN(start + CRC_SEARCH_CHUNK, crc_kernels_count);
+        for (int i = start; i < end; i++) {
+            if (crc_kernels[i].fast)
+                crc_search_one(s, i);
+        }
+    }
+    return NULL;
+}
+
+int SearchModels(const char *inHexStr, crc_match_t *matches, int max) {
+    size_t hexlen = strlen(inHexStr);
+    for (size_t i = 0; i < hexlen; i++) {
+        if (isxdigit((unsigned char)inHexStr[i]) == 0) {
+            PrintAndLogEx(ERR, "invalid character in hexadecimal argument");
+            return -1;
+        }
+    }
+
+    pthread_once(&crc_kernels_once, crc_kernels_init);
+    if (crc_kernels_count == 0) {
+        PrintAndLogEx(WARNING, "no preset models available");
+        return -1;
+    }
+
+    crc_search_t s = {
+        .results = calloc(crc_kernels_count, sizeof(crc_match_t)),
+        .next = 0,
+    };
+    if (s.results == NULL) {
+        PrintAndLogEx(WARNING, "out of memory?");
+        return -1;
+    }
+
+    int found = 0;
+    // the crc is the tail of the frame, so every crc size gets tried on its own message length
+    for (size_t crc_chars = 2; crc_chars < hexlen && crc_chars <= 16; crc_chars += 2) {
+        size_t datachars = hexlen - crc_chars;
+        s.len = datachars / 2;
+        s.crc = inHexStr + datachars;
+        s.crc_chars = crc_chars;
+        for (int r = 0; r < 2; r++) {
+            for (int o = 0; o < 2; o++) {
+                s.msg[r][o] = calloc(s.len + 1, 1);
             }
         }
-        ans = RunModel(Models[i], outHex, true, 0, revResult);
-        if (ans) {
-            // test for match
-            if (memcmp(revResult, inCRC, crcChars) == 0) {
-                PrintAndLogEx(SUCCESS, "\nfound possible match\nmodel reversed: %s | value: %s\n", Models[i], revResult);
-                // optional - stop searching if found...
-                found = true;
-            } else {
-                if (crcChars > 2) {
-                    char *swapEndian = SwapEndianStr(revResult, crcChars, crcChars);
-                    if (memcmp(swapEndian, inCRC, crcChars) == 0) {
-                        PrintAndLogEx(SUCCESS, "\nfound possible match\nmodel reversed: %s | value endian swapped: %s\n", Models[i], swapEndian);
-                        // optional - stop searching if found...
-                        found = true;
-                    }
-                    free(swapEndian);
+        for (size_t i = 0; i < s.len; i++) {
+            uint8_t b = (crc_hexnibble(inHexStr[i * 2]) << 4) | crc_hexnibble(inHexStr[i * 2 + 1]);
+            s.msg[0][0][i] = b;
+            s.msg[1][0][i] = crc_rev8(b);
+            s.msg[0][1][s.len - 1 - i] = b;
+            s.msg[1][1][s.len - 1 - i] = crc_rev8(b);
+        }
+
+        int num_threads = (s.len < CRC_SEARCH_MT_BYTES) ? 1 : MIN(num_CPUs(), CRC_SEARCH_MAX_THREADS);
+        pthread_t threads[CRC_SEARCH_MAX_THREADS];
+        int started = 0;
+        s.next = 0;
+        if (num_threads > 1) {
+            for (; started < num_threads; started++) {
+                if (pthread_create(&threads[started], NULL, crc_search_worker, &s))
+                    break;
+            }
+        }
+        if (started == 0)
+            crc_search_worker(&s);
+        for (int i = 0; i < started; i++)
+            pthread_join(threads[i], NULL);
+
+        for (int r = 0; r < 2; r++) {
+            for (int o = 0; o < 2; o++) {
+                free(s.msg[r][o]);
+            }
+        }
+    }
+
+    // wide models, RunModel isn't thread safe
+    for (int i = 0; i < crc_kernels_count; i++) {
+        const crc_kernel_t *k = &crc_kernels[i];
+        size_t crc_chars = ((k->width + 7) / 8) * 2;
+        if (k->fast || crc_chars == 0 || crc_chars >= hexlen || crc_chars >= sizeof(s.results[i].value))
+            continue;
+
+        char *inHexData = calloc(hexlen - crc_chars + 1, sizeof(char));
+        char value[sizeof(s.results[i].value)] = {0};
+        bool swapped = false;
+        memcpy(inHexData, inHexStr, hexlen - crc_chars);
+        if (RunModel(k->name, inHexData, k->reverse, 0, value) && crc_search_compare(value, inHexStr + hexlen - crc_chars, crc_chars, &swapped)) {
+            crc_match_t *m = &s.results[i];
+            m->name = k->name;
+            m->width = k->width;
+            m->reversed = k->reverse;
+            m->swapped = swapped;
+            if (swapped) {
+                for (size_t j = 0; j < crc_chars; j += 2) {
+                    m->value[j] = value[crc_chars - 2 - j];
+                    m->value[j + 1] = value[crc_chars - 1 - j];
                 }
+            } else {
+                strcpy(m->value, value);
             }
         }
-        free(inCRC);
-        free(outHex);
-        free(Models[i]);
+        free(inHexData);
+    }
+
+    // catalogue order, each model plain then reversed
+    for (int i = 0; i < crc_kernels_count; i++) {
+        if (s.results[i].value[0] == 0)
+            continue;
+        if (found < max)
+            matches[found] = s.results[i];
+        found++;
+    }
+    free(s.results);
+    return found;
+}
+
+// takes hex string in and searches for a matching result (hex string must include checksum)
+static int CmdrevengSearch(const char *Cmd) {
+
+    int dataLen = strlen(Cmd);
+    if (dataLen < 4) return 0;
+
+    crc_match_t matches[32];
+    int found = SearchModels(Cmd, matches, ARRAYLEN(matches));
+    if (found < 0) return 0;
+
+    for (int i = 0; i < MIN(found, (int)ARRAYLEN(matches)); i++) {
+        PrintAndLogEx(SUCCESS, "\nfound possible match\nmodel%s: %s | value%s: %s\n"
+                      , matches[i].reversed ? " reversed" : ""
+                      , matches[i].name
+                      , matches[i].swapped ? " endian swapped" : ""
+                      , matches[i].value
+                     );
     }
+    if (found > (int)ARRAYLEN(matches))
+        PrintAndLogEx(INFO, "... %d more", found - (int)ARRAYLEN(matches));
 
     if (!found) PrintAndLogEx(FAILED, "\nno matches found\n");
     return 1;
 }
 
 int CmdCrc(const char *Cmd) {
+    // -g takes frames longer than the reveng command line
+    if (param_getlength(Cmd, 0) == 2 && strncmp(Cmd + strspn(Cmd, " \t"), "-g", 2) == 0
+            && param_getlength(Cmd, 1) > 0 && param_getlength(Cmd, 2) == 0) {
+        int len = param_getlength(Cmd, 1);
+        char *hex = calloc(len + 1, sizeof(char));
+        if (hex == NULL)
+            return 0;
+        param_getstr(Cmd, 1, hex, len + 1);
+        CmdrevengSearch(hex);
+        free(hex);
+        return 0;
+    }
+
     char name[] = {"reveng "};
     char Cmd2[100 + 7];
     memcpy(Cmd2, name, 7);
@@ -504,11 +796,7 @@ int CmdCrc(const char *Cmd) {
     char *argv[MAX_ARGS];
     int argc = split(Cmd2, argv);
 
-    if (argc == 3 && memcmp(argv[1], "-g", 2) == 0) {
-        CmdrevengSearch(argv[2]);
-    } else {
-        reveng_main(argc, argv);
-    }
+    reveng_main(argc, argv);
     for (int i = 0; i < argc; ++i) {
         free(argv[i]);
     }
@@ -17,4 +17,16 @@ int CmdCrc(const char *Cmd);
 
 int GetModels(char *Models[], int *count, uint8_t *width);
 int RunModel(char *inModel, char *inHexStr, bool reverse, char endian, char *result);
+
+typedef struct {
+    const char *name;
+    uint8_t width;
+    bool reversed;      // value from RunModel reverse = true
+    bool swapped;       // value bytes are in the other order than the model gives them
+    char value[30];
+} crc_match_t;
+
+// Tests all catalogue models, plain and reversed, on a hex frame ending with its crc, in parallel for long frames.
+// Returns the number of matches, in catalogue order, the first max of them in matches. -1 on a bad frame
+int SearchModels(const char *inHexStr, crc_match_t *matches, int max);
 #endif
@@ -15,6 +15,7 @@
 #include <limits.h>   // for CmdNorm INT_MIN && INT_MAX
 #include <math.h>     // pow
 #include <ctype.h>    // tolower
+#include <pthread.h>
 #include "commonutil.h"          // ARRAYLEN
 #include "cmdparser.h"           // for command_t
 #include "ui.h"                  // for show graph controls
@@ -27,6 +28,10 @@
 #include "fileutils.h"           // searchFile
 #include "mifare/ndef.h"
 #include "cliparser.h"
+#include "util.h"                // num_CPUs
+#include "util_posix.h"          // msclock
+#include "mifare/mifare4.h"      // mfIsSectorTrailer
+#include "cmdhfmfu.h"            // OLD_MFU_DUMP_PREFIX_LENGTH
 
 uint8_t DemodBuffer[MAX_DEMOD_BUF_LEN];
 size_t DemodBufferLen = 0;
@@ -306,8 +311,8 @@ void setDemodBuff(uint8_t *buff, size_t size, size_t start_idx) {
     if (size > MAX_DEMOD_BUF_LEN - start_idx)
         size = MAX_DEMOD_BUF_LEN - start_idx;
 
-    for (size_t i = 0; i < size; i++)
-        DemodBuffer[i] = buff[start_idx++];
+    // DemodBuffer itself, shifted, is what most demods hand in
+    memmove(DemodBuffer, buff + start_idx, size);
 
     DemodBufferLen = size;
 }
@@ -411,14 +416,14 @@ void save_restoreDB(uint8_t saveOpt) {
 
     if (saveOpt == GRAPH_SAVE) { //save
 
-        memcpy(SavedDB, DemodBuffer, sizeof(DemodBuffer));
+        memcpy(SavedDB, DemodBuffer, DemodBufferLen);
         SavedDBlen = DemodBufferLen;
         DB_Saved = true;
         savedDemodStartIdx = g_DemodStartIdx;
         savedDemodClock = g_DemodClock;
     } else if (DB_Saved) { //restore
 
-        memcpy(DemodBuffer, SavedDB, sizeof(DemodBuffer));
+        memcpy(DemodBuffer, SavedDB, SavedDBlen);
         DemodBufferLen = SavedDBlen;
         g_DemodClock = savedDemodClock;
         g_DemodStartIdx = savedDemodStartIdx;
@@ -578,7 +583,7 @@ int ASKDemod_ext(const char *Cmd, bool verbose, bool emSearch, uint8_t askType,
         invert = 1;
         clk = 0;
     }
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN, sizeof(uint8_t));
+    uint8_t *bits = calloc(MAX(GraphTraceLen, MAX_GRAPH_TRACE_LEN), sizeof(uint8_t));
     if (bits == NULL) {
         return PM3_EMALLOC;
     }
@@ -840,6 +845,84 @@ static int Cmdaskrawdemod(const char *Cmd) {
     return ASKDemod(Cmd, true, false, 0);
 }
 
+// above this many multiply-adds AutoCorrelate switches to the FFT lag sums
+#define AUTOCORR_DIRECT_MAX (1 << 24)
+
+// in-place iterative radix-2 FFT, n must be a power of two.
+// inverse transform is unscaled
+static void fft_radix2(double *re, double *im, size_t n, bool inverse) {
+
+    for (size_t i = 1, j = 0; i < n; i++) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        if (i < j) {
+            double t = re[i];
+            re[i] = re[j];
+            re[j] = t;
+            t = im[i];
+            im[i] = im[j];
+            im[j] = t;
+        }
+    }
+
+    for (size_t step = 2; step <= n; step <<= 1) {
+        double ang = (inverse ? 2.0 : -2.0) * M_PI / step;
+        double wr = cos(ang), wi = sin(ang);
+        size_t half = step >> 1;
+        for (size_t k = 0; k < n; k += step) {
+            double cr = 1.0, ci = 0.0;
+            for (size_t m = 0; m < half; m++) {
+                size_t a = k + m, b = a + half;
+                double tr = re[b] * cr - im[b] * ci;
+                double ti = re[b] * ci + im[b] * cr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+                double t = cr * wr - ci * wi;
+                ci = cr * wi + ci * wr;
+                cr = t;
+            }
+        }
+    }
+}
+
+// lag sums  sums[i] = sum (in[j] - mean) * (in[j + i] - mean)  for i < lags,
+// computed as the inverse FFT of the power spectrum of the zero padded signal.
+// O(n log n) instead of the O(n * lags) direct loop.
+static bool autocov_sums_fft(const int *in, size_t len, double mean, size_t lags, double *sums) {
+    size_t n = 1;
+    while (n < 2 * len)
+        n <<= 1;
+
+    double *re = calloc(n, sizeof(double));
+    double *im = calloc(n, sizeof(double));
+    if (re == NULL || im == NULL) {
+        free(re);
+        free(im);
+        return false;
+    }
+
+    for (size_t i = 0; i < len; i++)
+        re[i] = in[i] - mean;
+
+    fft_radix2(re, im, n, false);
+    for (size_t i = 0; i < n; i++) {
+        re[i] = re[i] * re[i] + im[i] * im[i];
+        im[i] = 0.0;
+    }
+    fft_radix2(re, im, n, true);
+
+    for (size_t i = 0; i < lags; i++)
+        sums[i] = re[i] / n;
+
+    free(re);
+    free(im);
+    return true;
+}
+
 int AutoCorrelate(const int *in, int *out, size_t len, size_t window, bool SaveGrph, bool verbose) {
     // sanity check
     if (window > len) window = len;
@@ -856,12 +939,32 @@ int AutoCorrelate(const int *in, int *out, size_t len, size_t window, bool SaveG
     // Computed variance
     double variance = compute_variance(in, len);
 
-    int *correl_buf = calloc(MAX_GRAPH_TRACE_LEN, sizeof(int));
+    int *correl_buf = calloc(MAX(len + 1, MAX_GRAPH_TRACE_LEN), sizeof(int));
+    if (correl_buf == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return 0;
+    }
+
+    // the direct lag sums are O(len * lags),  a full graph buffer takes
+    // many seconds that way.  Large inputs go through the FFT instead.
+    size_t lags = len - window;
+    double *sums = NULL;
+    if ((uint64_t)lags * len > AUTOCORR_DIRECT_MAX) {
+        sums = calloc(lags + 1, sizeof(double));
+        if (sums && autocov_sums_fft(in, len, mean, lags, sums) == false) {
+            free(sums);
+            sums = NULL;
+        }
+    }
 
-    for (size_t i = 0; i < len - window; ++i) {
+    for (size_t i = 0; i < lags; ++i) {
 
-        for (size_t j = 0; j < (len - i); j++) {
-            autocv += (in[j] - mean) * (in[j + i] - mean);
+        if (sums) {
+            autocv += sums[i];
+        } else {
+            for (size_t j = 0; j < (len - i); j++) {
+                autocv += (in[j] - mean) * (in[j + i] - mean);
+            }
         }
         autocv = (1.0 / (len - i)) * autocv;
 
@@ -877,6 +980,7 @@ int AutoCorrelate(const int *in, int *out, size_t len, size_t window, bool SaveG
             lastmax = i;
         }
     }
+    free(sums);
 
     //
     int hi = 0, idx = 0;
@@ -1018,19 +1122,17 @@ static int CmdUndec(const char *Cmd) {
 
     uint8_t factor = param_get8ex(Cmd, 0, 2, 10);
 
-    //We have memory, don't we?
-    int swap[MAX_GRAPH_TRACE_LEN] = {0};
-    uint32_t g_index = 0, s_index = 0;
-    while (g_index < GraphTraceLen && s_index + factor < MAX_GRAPH_TRACE_LEN) {
-        int count = 0;
-        for (count = 0; count < factor && s_index + count < MAX_GRAPH_TRACE_LEN; count++)
-            swap[s_index + count] = GraphBuffer[g_index];
-        s_index += count;
-        g_index++;
-    }
+    if (factor == 0) return usage_data_undecimate();
 
-    memcpy(GraphBuffer, swap, s_index * sizeof(int));
-    GraphTraceLen = s_index;
+    // in place, from the end
+    if (GraphReserve(GraphTraceLen * factor) == false)
+        return PM3_EMALLOC;
+
+    for (size_t g_index = GraphTraceLen; g_index-- > 0;) {
+        for (uint8_t count = 0; count < factor; count++)
+            GraphBuffer[g_index * factor + count] = GraphBuffer[g_index];
+    }
+    GraphTraceLen *= factor;
     RepaintGraphWindow();
     return PM3_SUCCESS;
 }
@@ -1161,7 +1263,7 @@ int FSKrawDemod(const char *Cmd, bool verbose) {
     if (getSignalProperties()->isnoise)
         return PM3_ESOFT;
 
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN, sizeof(uint8_t));
+    uint8_t *bits = calloc(MAX(GraphTraceLen, MAX_GRAPH_TRACE_LEN), sizeof(uint8_t));
     if (bits == NULL) {
         return PM3_EMALLOC;
     }
@@ -1241,7 +1343,7 @@ int PSKDemod(const char *Cmd, bool verbose) {
     if (getSignalProperties()->isnoise)
         return PM3_ESOFT;
 
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN, sizeof(uint8_t));
+    uint8_t *bits = calloc(MAX(GraphTraceLen, MAX_GRAPH_TRACE_LEN), sizeof(uint8_t));
     if (bits == NULL) {
         return PM3_EMALLOC;
     }
@@ -1365,7 +1467,7 @@ int NRZrawDemod(const char *Cmd, bool verbose) {
     if (getSignalProperties()->isnoise)
         return PM3_ESOFT;
 
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN, sizeof(uint8_t));
+    uint8_t *bits = calloc(MAX(GraphTraceLen, MAX_GRAPH_TRACE_LEN), sizeof(uint8_t));
     if (bits == NULL) {
         return PM3_EMALLOC;
     }
@@ -1567,13 +1669,18 @@ static int CmdHide(const char *Cmd) {
 //zero mean GraphBuffer
 int CmdHpf(const char *Cmd) {
     (void)Cmd; // Cmd is not used so far
-    uint8_t bits[GraphTraceLen];
+    uint8_t *bits = calloc(GraphTraceLen + 1, sizeof(uint8_t));
+    if (bits == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
     size_t size = getFromGraphBuf(bits);
     removeSignalOffset(bits, size);
     // push it back to graph
     setGraphBuf(bits, size);
     // set signal properties low/high/mean/amplitude and is_noise detection
     computeSignalProperties(bits, size);
+    free(bits);
 
     RepaintGraphWindow();
     return PM3_SUCCESS;
@@ -1657,10 +1764,8 @@ int getSamplesEx(uint32_t start, uint32_t end, bool verbose) {
         GraphTraceLen = n;
     }
 
-    uint8_t bits[GraphTraceLen];
-    size_t size = getFromGraphBuf(bits);
     // set signal properties low/high/mean/amplitude and is_noise detection
-    computeSignalProperties(bits, size);
+    computeGraphSignalProperties();
 
     setClockGrid(0, 0);
     DemodBufferLen = 0;
@@ -1788,6 +1893,66 @@ int CmdTuneSamples(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// Live antenna voltage from CMD_MEASURE_ANTENNA_TUNING_STREAM frames, one line updated in place with a bar
+// against the highest average seen, the point to tune to. Stops on Enter, button or after frames frames
+int antenna_tune_stream(bool hf, uint8_t divisor, uint16_t interval, uint32_t frames) {
+#define TUNE_STREAM_BAR 30
+    antenna_tuning_stream_req_t req = {
+        .flags = hf ? ANTENNA_TUNING_STREAM_HF : 0,
+        .divisor = divisor,
+        .interval = interval,
+    };
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_MEASURE_ANTENNA_TUNING_STREAM, (uint8_t *)&req, sizeof(req));
+
+    PacketResponseNG resp;
+    antenna_tuning_stream_frame_t *frame = (antenna_tuning_stream_frame_t *)resp.data.asBytes;
+    uint32_t peak = 0, received = 0;
+    bool stopping = false;
+    int status = PM3_SUCCESS;
+
+    for (;;) {
+        if (stopping == false && (kbd_enter_pressed() || (frames && received >= frames))) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            stopping = true;
+        }
+
+        if (WaitForResponseTimeout(CMD_MEASURE_ANTENNA_TUNING_STREAM, &resp, interval + 1000) == false) {
+            PrintAndLogEx(NORMAL, "");
+            PrintAndLogEx(WARNING, "Timeout while waiting for Proxmark antenna measure, aborting");
+            if (stopping == false)
+                SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            status = PM3_ETIMEOUT;
+            break;
+        }
+
+        if (resp.length != sizeof(antenna_tuning_stream_frame_t)) {
+            status = resp.status;
+            break;
+        }
+
+        if (frame->final)
+            break;
+
+        received++;
+
+        peak = MAX(peak, frame->avg);
+        char bar[TUNE_STREAM_BAR + 1] = {0};
+        size_t fill = peak ? ((uint64_t)frame->avg * TUNE_STREAM_BAR) / peak : 0;
+        for (size_t i = 0; i < TUNE_STREAM_BAR; i++)
+            bar[i] = (i < fill) ? '#' : '.';
+
+        PrintAndLogEx(INPLACE, " %5u mV  min %5u  max %5u  peak " _YELLOW_("%5u") " mV [%s]",
+                      frame->avg, frame->min, frame->max, peak, bar);
+    }
+
+    PrintAndLogEx(NORMAL, "");
+    if (status == PM3_SUCCESS)
+        PrintAndLogEx(INFO, "%u measures, peak " _YELLOW_("%u") " mV / " _YELLOW_("%.2f") " V", received, peak, peak / 1000.0);
+    return status;
+}
+
 static int CmdLoad(const char *Cmd) {
     char filename[FILE_PATH_SIZE] = {0x00};
     int len = 0;
@@ -1805,34 +1970,45 @@ static int CmdLoad(const char *Cmd) {
         }
     }
 
+    int res = LoadGraphFile(path);
+    free(path);
+    return res;
+}
+
+// Loads a sample per line file like the traces/*.pm3 into the graph buffer,
+// without the offset and with its signal properties
+int LoadGraphFile(const char *path) {
     FILE *f = fopen(path, "r");
     if (!f) {
         PrintAndLogEx(WARNING, "couldn't open '%s'", path);
-        free(path);
         return PM3_EFILE;
     }
-    free(path);
 
     GraphTraceLen = 0;
     char line[80];
     while (fgets(line, sizeof(line), f)) {
+        if (GraphReserve(GraphTraceLen + 1) == false)
+            break;
+
         GraphBuffer[GraphTraceLen] = atoi(line);
         GraphTraceLen++;
-
-        if (GraphTraceLen >= MAX_GRAPH_TRACE_LEN)
-            break;
     }
 
     fclose(f);
 
     PrintAndLogEx(SUCCESS, "loaded " _YELLOW_("%zu") " samples", GraphTraceLen);
 
-    uint8_t bits[GraphTraceLen];
+    uint8_t *bits = calloc(GraphTraceLen + 1, sizeof(uint8_t));
+    if (bits == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
     size_t size = getFromGraphBuf(bits);
 
     removeSignalOffset(bits, size);
     setGraphBuf(bits, size);
     computeSignalProperties(bits, size);
+    free(bits);
 
     setClockGrid(0, 0);
     DemodBufferLen = 0;
@@ -1903,10 +2079,8 @@ int CmdNorm(const char *Cmd) {
         }
     }
 
-    uint8_t bits[GraphTraceLen];
-    size_t size = getFromGraphBuf(bits);
     // set signal properties low/high/mean/amplitude and is_noise detection
-    computeSignalProperties(bits, size);
+    computeGraphSignalProperties();
 
     RepaintGraphWindow();
     return PM3_SUCCESS;
@@ -2011,10 +2185,7 @@ static int CmdDirectionalThreshold(const char *Cmd) {
     directionalThreshold(GraphBuffer, GraphBuffer, GraphTraceLen, up, down);
 
     // set signal properties low/high/mean/amplitude and isnoice detection
-    uint8_t bits[GraphTraceLen];
-    size_t size = getFromGraphBuf(bits);
-    // set signal properties low/high/mean/amplitude and is_noice detection
-    computeSignalProperties(bits, size);
+    computeGraphSignalProperties();
 
     RepaintGraphWindow();
     return PM3_SUCCESS;
@@ -2043,10 +2214,8 @@ static int CmdZerocrossings(const char *Cmd) {
         }
     }
 
-    uint8_t bits[GraphTraceLen];
-    size_t size = getFromGraphBuf(bits);
     // set signal properties low/high/mean/amplitude and is_noise detection
-    computeSignalProperties(bits, size);
+    computeGraphSignalProperties();
 
     RepaintGraphWindow();
     return PM3_SUCCESS;
@@ -2296,10 +2465,8 @@ static int CmdDataIIR(const char *Cmd) {
     //iceIIR_Butterworth(GraphBuffer, GraphTraceLen);
     iceSimple_Filter(GraphBuffer, GraphTraceLen, k);
 
-    uint8_t bits[GraphTraceLen];
-    size_t size = getFromGraphBuf(bits);
     // set signal properties low/high/mean/amplitude and is_noise detection
-    computeSignalProperties(bits, size);
+    computeGraphSignalProperties();
     RepaintGraphWindow();
     return PM3_SUCCESS;
 }
@@ -2343,6 +2510,440 @@ static int CmdDataNDEF(const char *Cmd) {
     return res;
 }
 
+// dump types data dumpconv converts, the JSON file types and the EML row lengths
+typedef struct {
+    const char *name;
+    const char *json;
+    JSONFileType ftype;
+    uint8_t blocksize;
+} dumpconv_type_t;
+
+static const dumpconv_type_t dumpconv_types[] = {
+    {"mfc",    "mfcard", jsfCardMemory, 16},
+    {"mfu",    "mfu",    jsfMfuMemory,  4},
+    {"iclass", "iclass", jsfIclass,     8},
+    {"t55x7",  "t55x7",  jsfT55x7,      4},
+    {"hitag",  "hitag",  jsfHitag,      4},
+    {"raw",    "raw",    jsfRaw,        16},
+};
+
+enum { DC_MFC, DC_MFU, DC_ICLASS, DC_T55X7, DC_HITAG, DC_RAW, DC_AUTO };
+
+static const char *dumpconv_formats[] = {"bin", "eml", "json"};
+
+typedef struct {
+    char **names;
+    int count;
+    const char *dir;
+    const char *outdir;
+    int type;
+    DumpFileType_t format;
+    bool check;
+    bool verbose;
+
+    pthread_mutex_t lock;
+    int next;
+    int converted;
+    int invalid;
+    int failed;
+} dumpconv_job_t;
+
+static bool dumpconv_is_eml(const uint8_t *text, size_t len) {
+    bool comment = false, digits = false;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = text[i];
+        if (c == '\n') {
+            comment = false;
+        } else if (comment == false) {
+            if (c == '#')
+                comment = true;
+            else if (isxdigit(c))
+                digits = true;
+            else if (c != '\r' && c != ' ' && c != '\t')
+                return false;
+        }
+    }
+    return digits;
+}
+
+// hex of an EML text to bytes in place, text has twice the room needed
+static bool dumpconv_parse_eml(uint8_t *text, size_t len, size_t *datalen) {
+    size_t n = 0;
+    int nibbles = 0;
+    bool comment = false;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = text[i];
+        if (c == '\n') {
+            // a row is whole bytes
+            if (nibbles & 1)
+                return false;
+            comment = false;
+        } else if (comment == false && c == '#') {
+            comment = true;
+        } else if (comment == false && isxdigit(c)) {
+            uint8_t v = isdigit(c) ? c - '0' : (tolower(c) - 'a' + 10);
+            if (nibbles & 1)
+                text[n++] |= v;
+            else
+                text[n] = v << 4;
+            nibbles++;
+        }
+    }
+    *datalen = n;
+    return (nibbles & 1) == 0 && n > 0;
+}
+
+static int dumpconv_json_type(const uint8_t *text, size_t len) {
+    const char *key = "\"FileType\"";
+    size_t keylen = strlen(key);
+    for (size_t i = 0; i + keylen < len; i++) {
+        if (memcmp(text + i, key, keylen))
+            continue;
+
+        i += keylen;
+        while (i < len && (text[i] == ' ' || text[i] == ':' || text[i] == '\t'))
+            i++;
+        if (i >= len || text[i] != '"')
+            return -1;
+        i++;
+        for (int t = 0; t < DC_AUTO; t++) {
+            size_t l = strlen(dumpconv_types[t].json);
+            if (i + l < len && memcmp(text + i, dumpconv_types[t].json, l) == 0 && text[i + l] == '"')
+                return t;
+        }
+        return -1;
+    }
+    return -1;
+}
+
+// the inverted copies of the access bits in a sector trailer must match
+static bool dumpconv_mfc_trailers_ok(const uint8_t *data, size_t len) {
+    for (size_t b = 0; b < len / 16; b++) {
+        if (mfIsSectorTrailer(b) == false)
+            continue;
+        const uint8_t *ac = data + b * 16 + 6;
+        if (((ac[0] ^ (ac[1] >> 4)) & 0x0F) != 0x0F ||
+                (((ac[0] >> 4) ^ ac[2]) & 0x0F) != 0x0F ||
+                ((ac[1] ^ (ac[2] >> 4)) & 0x0F) != 0x0F)
+            return false;
+    }
+    return true;
+}
+
+static bool dumpconv_mfc_size(size_t len) {
+    // mini, 1k, 2k, 4k
+    return len == 320 || len == 1024 || len == 2048 || len == 4096;
+}
+
+// any of the Ultralight dump formats to the new one, in a buffer of a whole mfu_dump_t
+static int dumpconv_mfu(uint8_t **data, size_t *len) {
+    if (*len < OLD_MFU_DUMP_PREFIX_LENGTH || *len > sizeof(mfu_dump_t))
+        return PM3_ESOFT;
+
+    uint8_t *buf = calloc(1, sizeof(mfu_dump_t));
+    if (buf == NULL)
+        return PM3_EMALLOC;
+    memcpy(buf, *data, *len);
+    free(*data);
+    *data = buf;
+
+    mfu_df_e df = detect_mfu_dump_format(data, len, false);
+    if (df == MFU_DF_UNKNOWN || (df == MFU_DF_PLAINBIN && *len > sizeof(((mfu_dump_t *)0)->data)))
+        return PM3_ESOFT;
+
+    int res = convert_mfu_dump_format(data, len, false);
+    // the plain one is copied, the old one freed
+    if (df == MFU_DF_PLAINBIN && *data != buf)
+        free(buf);
+    return res;
+}
+
+static int dumpconv_autodetect(const uint8_t *data, size_t len) {
+    if (dumpconv_mfc_size(len) && dumpconv_mfc_trailers_ok(data, len))
+        return DC_MFC;
+
+    if (len >= OLD_MFU_DUMP_PREFIX_LENGTH && len <= sizeof(mfu_dump_t)) {
+        uint8_t *tmp = calloc(1, sizeof(mfu_dump_t));
+        if (tmp != NULL) {
+            memcpy(tmp, data, len);
+            size_t tmplen = len;
+            mfu_df_e df = detect_mfu_dump_format(&tmp, &tmplen, false);
+            free(tmp);
+            if (df != MFU_DF_UNKNOWN)
+                return DC_MFU;
+        }
+    }
+    return DC_RAW;
+}
+
+// NULL when the dump is fine for its type
+static const char *dumpconv_validate(int type, const uint8_t *data, size_t len) {
+    switch (type) {
+        case DC_MFC:
+            if (dumpconv_mfc_size(len) == false)
+                return "not a Mifare Classic size";
+            if (dumpconv_mfc_trailers_ok(data, len) == false)
+                return "bad access bits in a sector trailer";
+            return NULL;
+        case DC_MFU:
+            if ((len - MFU_DUMP_PREFIX_LENGTH) % 4 || len <= MFU_DUMP_PREFIX_LENGTH)
+                return "not whole pages";
+            if (((const mfu_dump_t *)data)->pages + 1 != (len - MFU_DUMP_PREFIX_LENGTH) / 4)
+                return "page count in the header doesn't match";
+            return NULL;
+        case DC_ICLASS:
+            if (len < sizeof(picopass_hdr) || len % 8)
+                return "not whole 8 byte blocks";
+            return NULL;
+        case DC_T55X7:
+        case DC_HITAG:
+            if (len < 4 || len % 4)
+                return "not whole 4 byte blocks";
+            return NULL;
+        default:
+            return len ? NULL : "empty";
+    }
+}
+
+static void dumpconv_file(dumpconv_job_t *job, const char *name) {
+    char path[FILE_PATH_SIZE * 2];
+    snprintf(path, sizeof(path), "%s" PATHSEP "%s", job->dir, name);
+
+    uint8_t *data = NULL;
+    size_t len = 0;
+    if (loadFile_safeEx(path, "", (void **)&data, &len, false) != PM3_SUCCESS) {
+        PrintAndLogEx(FAILED, "%-40s " _RED_("can't read"), name);
+        pthread_mutex_lock(&job->lock);
+        job->failed++;
+        pthread_mutex_unlock(&job->lock);
+        return;
+    }
+
+    const char *error = NULL;
+    bool bad = false;
+    int type = job->type;
+    DumpFileType_t format = BIN;
+
+    size_t skip = 0;
+    while (skip < len && isspace(data[skip]))
+        skip++;
+
+    if (skip < len && data[skip] == '{') {
+        format = JSON;
+        int jtype = dumpconv_json_type(data, len);
+        if (jtype < 0) {
+            error = "unsupported JSON FileType";
+        } else if (type != DC_AUTO && type != jtype) {
+            error = "JSON of another dump type";
+        } else {
+            type = jtype;
+            uint8_t *buf = calloc(1, len);
+            size_t buflen = 0;
+            if (buf == NULL || loadFileJSONex(path, buf, len, &buflen, false, NULL) != PM3_SUCCESS || buflen == 0) {
+                free(buf);
+                error = "can't load the JSON";
+            } else {
+                free(data);
+                data = buf;
+                len = buflen;
+            }
+        }
+    } else if (dumpconv_is_eml(data, len)) {
+        format = EML;
+        if (dumpconv_parse_eml(data, len, &len) == false)
+            error = "bad EML line";
+    }
+
+    if (error == NULL) {
+        if (type == DC_AUTO)
+            type = dumpconv_autodetect(data, len);
+
+        if (type == DC_MFU && dumpconv_mfu(&data, &len) != PM3_SUCCESS) {
+            error = "unknown Ultralight dump format";
+            bad = true;
+        } else {
+            error = dumpconv_validate(type, data, len);
+            bad = (error != NULL);
+        }
+    }
+
+    int res = PM3_SUCCESS;
+    if (error == NULL && job->check == false) {
+        char out[FILE_PATH_SIZE * 2];
+        const char *dot = strrchr(name, '.');
+        int stem = (dot && dot != name) ? (int)(dot - name) : (int)strlen(name);
+        snprintf(out, sizeof(out), "%s" PATHSEP "%.*s", job->outdir[0] ? job->outdir : job->dir, stem, name);
+
+        switch (job->format) {
+            case BIN:
+                res = saveFileEx(out, ".bin", data, len, false);
+                break;
+            case EML:
+                // emulators take the Ultralight pages only
+                if (type == DC_MFU)
+                    res = saveFileEMLex(out, data + MFU_DUMP_PREFIX_LENGTH, len - MFU_DUMP_PREFIX_LENGTH, 4, false);
+                else
+                    res = saveFileEMLex(out, data, len, dumpconv_types[type].blocksize, false);
+                break;
+            default:
+                res = saveFileJSONex(out, dumpconv_types[type].ftype, data, len, false, NULL);
+                break;
+        }
+        if (res != PM3_SUCCESS)
+            error = "can't save";
+    }
+    free(data);
+
+    if (error) {
+        PrintAndLogEx(FAILED, "%-40s %-4s %-6s " _RED_("%s"), name, dumpconv_formats[format],
+                      (type == DC_AUTO) ? "" : dumpconv_types[type].name, error);
+    } else if (job->verbose) {
+        PrintAndLogEx(SUCCESS, "%-40s %-4s %-6s %4zu bytes " _GREEN_("ok"), name, dumpconv_formats[format],
+                      dumpconv_types[type].name, len);
+    }
+
+    pthread_mutex_lock(&job->lock);
+    if (error == NULL)
+        job->converted++;
+    else if (bad)
+        job->invalid++;
+    else
+        job->failed++;
+    pthread_mutex_unlock(&job->lock);
+}
+
+static void *dumpconv_worker(void *arg) {
+    dumpconv_job_t *job = (dumpconv_job_t *)arg;
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        int i = job->next++;
+        pthread_mutex_unlock(&job->lock);
+        if (i >= job->count)
+            break;
+        dumpconv_file(job, job->names[i]);
+    }
+    return NULL;
+}
+
+static int CmdDataDumpConv(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "data dumpconv",
+                  "Converts all the dumps of a directory between binary, EML and JSON on several threads.\n"
+                  "The format of each file is found from its content and the dump type from the JSON FileType,\n"
+                  "else from the size and content: Mifare Classic (valid access bits), Ultralight (UID BCC) or raw.\n"
+                  "Every dump is checked for its type before it is written, Ultralight ones are saved in the new format",
+                  "Usage:\n"
+                  "\tdata dumpconv -d dumps -f json                -> every dump to <name>.json next to it\n"
+                  "\tdata dumpconv -d dumps -o eml -f eml -t mfc   -> Mifare Classic dumps to directory eml\n"
+                  "\tdata dumpconv -d dumps -n                     -> only check the dumps\n");
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str1("dD", "dir", "<dir>", "directory of the dumps"),
+        arg_str0("oO", "out", "<dir>", "directory for the results, else next to the dumps"),
+        arg_str0("fF", "format", "<bin|eml|json>", "format to write"),
+        arg_str0("tT", "type", "<mfc|mfu|iclass|t55x7|hitag|raw>", "dump type, default is to detect it"),
+        arg_int0(NULL, "threads", "<dec>", "threads (default all CPUs)"),
+        arg_lit0("nN", "check", "only check the dumps, write nothing"),
+        arg_lit0("vV", "verbose", "list every dump"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, false);
+
+    char dir[FILE_PATH_SIZE] = {0};
+    char outdir[FILE_PATH_SIZE] = {0};
+    char format[8] = {0};
+    char type[8] = {0};
+    int len = 0;
+    CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)dir, sizeof(dir) - 1, &len);
+    CLIParamStrToBuf(arg_get_str(ctx, 2), (uint8_t *)outdir, sizeof(outdir) - 1, &len);
+    CLIParamStrToBuf(arg_get_str(ctx, 3), (uint8_t *)format, sizeof(format) - 1, &len);
+    CLIParamStrToBuf(arg_get_str(ctx, 4), (uint8_t *)type, sizeof(type) - 1, &len);
+    int threads = arg_get_int_def(ctx, 5, num_CPUs());
+    bool check = arg_get_lit(ctx, 6);
+    bool verbose = arg_get_lit(ctx, 7);
+    CLIParserFree(ctx);
+
+    dumpconv_job_t job = {0};
+    job.check = check;
+    job.verbose = verbose;
+
+    job.format = DICTIONARY;
+    for (int i = 0; i < ARRAYLEN(dumpconv_formats); i++) {
+        if (strcmp(format, dumpconv_formats[i]) == 0)
+            job.format = i;
+    }
+    if (job.format == DICTIONARY && check == false) {
+        PrintAndLogEx(WARNING, "format must be bin, eml or json");
+        return PM3_EINVARG;
+    }
+
+    job.type = DC_AUTO;
+    for (int i = 0; i < DC_AUTO; i++) {
+        if (strcmp(type, dumpconv_types[i].name) == 0)
+            job.type = i;
+    }
+    if (job.type == DC_AUTO && type[0]) {
+        PrintAndLogEx(WARNING, "unknown dump type " _YELLOW_("%s"), type);
+        return PM3_EINVARG;
+    }
+
+    if (threads < 1)
+        threads = 1;
+
+    // strip a trailing separator, names are joined with one
+    for (size_t l = strlen(dir); l > 1 && dir[l - 1] == PATHSEP[0]; l--)
+        dir[l - 1] = 0;
+    for (size_t l = strlen(outdir); l > 1 && outdir[l - 1] == PATHSEP[0]; l--)
+        outdir[l - 1] = 0;
+    job.dir = dir;
+    job.outdir = outdir;
+
+    job.count = listDirFiles(dir, NULL, &job.names);
+    if (job.count < 0) {
+        PrintAndLogEx(WARNING, "can't read directory " _YELLOW_("%s"), dir);
+        return PM3_EFILE;
+    }
+
+    if (threads > job.count)
+        threads = job.count ? job.count : 1;
+
+    pthread_t *workers = calloc(threads, sizeof(pthread_t));
+    if (workers == NULL) {
+        for (int i = 0; i < job.count; i++)
+            free(job.names[i]);
+        free(job.names);
+        return PM3_EMALLOC;
+    }
+
+    PrintAndLogEx(INFO, "%s " _YELLOW_("%d") " files on " _YELLOW_("%d") " threads", check ? "checking" : "converting", job.count, threads);
+
+    pthread_mutex_init(&job.lock, NULL);
+    uint64_t t1 = msclock();
+
+    // the calling thread is a worker too
+    int started = 0;
+    for (int i = 1; i < threads; i++) {
+        if (pthread_create(&workers[started], NULL, dumpconv_worker, &job) == 0)
+            started++;
+    }
+    dumpconv_worker(&job);
+    for (int i = 0; i < started; i++)
+        pthread_join(workers[i], NULL);
+
+    t1 = msclock() - t1;
+    pthread_mutex_destroy(&job.lock);
+    free(workers);
+
+    for (int i = 0; i < job.count; i++)
+        free(job.names[i]);
+    free(job.names);
+
+    PrintAndLogEx(SUCCESS, "%s " _GREEN_("%d") ", invalid " _YELLOW_("%d") ", failed " _RED_("%d") " in %" PRIu64 " ms",
+                  check ? "valid" : "converted", job.converted, job.invalid, job.failed, t1);
+    return (job.invalid || job.failed) ? PM3_ESOFT : PM3_SUCCESS;
+}
+
 static command_t CommandTable[] = {
     {"help",            CmdHelp,                 AlwaysAvailable, "This help"},
     {"askedgedetect",   CmdAskEdgeDetect,        AlwaysAvailable, "[threshold] Adjust Graph for manual ASK demod using the length of sample differences to detect the edge of a wave (use 20-45, def:25)"},
@@ -2354,6 +2955,7 @@ static command_t CommandTable[] = {
     {"convertbitstream", CmdConvertBitStream,    AlwaysAvailable, "Convert GraphBuffer's 0/1 values to 127 / -127"},
     {"dec",             CmdDec,                  AlwaysAvailable, "Decimate samples"},
     {"detectclock",     CmdDetectClockRate,      AlwaysAvailable, "[<a|f|n|p>] Detect ASK, FSK, NRZ, PSK clock rate of wave in GraphBuffer"},
+    {"dumpconv",        CmdDataDumpConv,         AlwaysAvailable, "Convert a directory of dumps between bin, eml and json"},
     {"fsktonrz",        CmdFSKToNRZ,             AlwaysAvailable, "Convert fsk2 to nrz wave for alternate fsk demodulating (for weak fsk)"},
     {"getbitstream",    CmdGetBitStream,         AlwaysAvailable, "Convert GraphBuffer's >=1 values to 1 and <1 to 0"},
     {"grid",            CmdGrid,                 AlwaysAvailable, "<x> <y> -- overlay grid on graph window, use zero value to turn off either"},
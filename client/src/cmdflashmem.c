@@ -242,40 +242,17 @@ static int CmdFlashMemLoad(const char *Cmd) {
     }
 
     //Send to device
-    uint32_t bytes_sent = 0;
-    uint32_t bytes_remaining = datalen;
-
-    // fast push mode
-    conn.block_after_ACK = true;
-
-    while (bytes_remaining > 0) {
-        uint32_t bytes_in_packet = MIN(FLASH_MEM_BLOCK_SIZE, bytes_remaining);
-
-        clearCommandBuffer();
-
-        SendCommandOLD(CMD_FLASHMEM_WRITE, start_index + bytes_sent, bytes_in_packet, 0, data + bytes_sent, bytes_in_packet);
-
-        bytes_remaining -= bytes_in_packet;
-        bytes_sent += bytes_in_packet;
-
-        PacketResponseNG resp;
-        if (!WaitForResponseTimeout(CMD_ACK, &resp, 2000)) {
-            PrintAndLogEx(WARNING, "timeout while waiting for reply.");
-            conn.block_after_ACK = false;
-            free(data);
-            return PM3_ETIMEOUT;
-        }
-
-        uint8_t isok  = resp.oldarg[0] & 0xFF;
-        if (!isok) {
-            conn.block_after_ACK = false;
-            PrintAndLogEx(FAILED, "Flash write fail [offset %u]", bytes_sent);
-            return PM3_EFLASH;
-        }
+    res = SendToDeviceFlash(CMD_FLASHMEM_WRITE_STREAM, NULL, data, datalen, start_index);
+    free(data);
+    if (res == PM3_ETIMEOUT) {
+        PrintAndLogEx(WARNING, "timeout while waiting for reply.");
+        return res;
+    }
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(FAILED, "Flash write fail");
+        return PM3_EFLASH;
     }
 
-    conn.block_after_ACK = false;
-    free(data);
     PrintAndLogEx(SUCCESS, "Wrote "_GREEN_("%zu")" bytes to offset "_GREEN_("%u"), datalen, start_index);
     return PM3_SUCCESS;
 }
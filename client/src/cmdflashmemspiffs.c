@@ -65,12 +65,16 @@ static int usage_flashmemspiffs_load(void) {
     PrintAndLogEx(NORMAL, "Uploads binary-wise file into device filesystem");
     PrintAndLogEx(NORMAL, "Warning: mem area to be written must have been wiped first");
     PrintAndLogEx(NORMAL, "(this is already taken care when loading dictionaries)\n");
-    PrintAndLogEx(NORMAL, "Usage:  mem spiffs load o <filename> f <filename>");
+    PrintAndLogEx(NORMAL, "Usage:  mem spiffs load o <filename> f <filename> [d|p]");
     PrintAndLogEx(NORMAL, "  o <filename>       - destination filename");
     PrintAndLogEx(NORMAL, "  f <filename>       - local filename");
+    PrintAndLogEx(NORMAL, "  d                  - local file is a MIFARE key dictionary (*.dic), upload its keys as 6 byte binary for `hf mf fchk s`");
+    PrintAndLogEx(NORMAL, "  p                  - local file is a password dictionary (*.dic), upload as 4 byte binary for `lf em 4x50_brute s`");
     PrintAndLogEx(NORMAL, "");
     PrintAndLogEx(NORMAL, "Examples:");
     PrintAndLogEx(NORMAL, _YELLOW_("        mem spiffs load f myfile o myapp.conf"));
+    PrintAndLogEx(NORMAL, _YELLOW_("        mem spiffs load f mfc_default_keys o mfc_keys.bin d"));
+    PrintAndLogEx(NORMAL, _YELLOW_("        mem spiffs load f t55xx_default_pwds o em4x50_pwds.bin p"));
     return PM3_SUCCESS;
 }
 
@@ -362,57 +366,16 @@ int flashmem_spiffs_load(uint8_t *destfn, uint8_t *data, size_t datalen) {
     SendCommandNG(CMD_SPIFFS_MOUNT, NULL, 0);
 
     // Send to device
-    uint32_t bytes_sent = 0;
-    uint32_t bytes_remaining = datalen;
-    uint32_t append = 0;
-
-    // fast push mode
-    conn.block_after_ACK = true;
-
-    while (bytes_remaining > 0) {
-        uint32_t bytes_in_packet = MIN(FLASH_MEM_BLOCK_SIZE, bytes_remaining);
-
-        clearCommandBuffer();
-
-        char fdata[32 + bytes_in_packet];
-        memset(fdata, 0, sizeof(fdata));
-        memcpy(fdata, destfn, 32);
-        memcpy(fdata + 32, data + bytes_sent, bytes_in_packet);
-
-        if (bytes_sent > 0)
-            append = 1;
-
-        SendCommandOLD(CMD_SPIFFS_WRITE, append, bytes_in_packet, 0, fdata, 32 + bytes_in_packet);
-
-        bytes_remaining -= bytes_in_packet;
-        bytes_sent += bytes_in_packet;
-
-        PacketResponseNG resp;
-
-        uint8_t retry = 3;
-        while (!WaitForResponseTimeout(CMD_ACK, &resp, 2000)) {
-            PrintAndLogEx(WARNING, "timeout while waiting for reply.");
-            retry--;
-            if (retry == 0) {
-                ret_val = PM3_ETIMEOUT;
-                goto out;
-            }
-        }
-
-        uint8_t isok = resp.oldarg[0] & 0xFF;
-        if (!isok) {
-            PrintAndLogEx(FAILED, "Flash write fail [offset %u]", bytes_sent);
-            ret_val = PM3_EFLASH;
-            break;
-        }
+    ret_val = SendToDeviceFlash(CMD_SPIFFS_WRITE_STREAM, (char *)destfn, data, datalen, 0);
+    if (ret_val == PM3_ETIMEOUT) {
+        PrintAndLogEx(WARNING, "timeout while waiting for reply.");
+    } else if (ret_val != PM3_SUCCESS) {
+        PrintAndLogEx(FAILED, "Flash write fail");
+        ret_val = PM3_EFLASH;
     }
 
-out:
     clearCommandBuffer();
 
-    // turn off fast push mode
-    conn.block_after_ACK = false;
-
     // We want to unmount after these to set things back to normal but more than this
     // unmouting ensure that SPIFFS CACHES are all flushed so our file is actually written on memory
     SendCommandNG(CMD_SPIFFS_UNMOUNT, NULL, 0);
@@ -442,12 +405,20 @@ static int CmdFlashMemSpiFFSLoad(const char *Cmd) {
     char filename[FILE_PATH_SIZE] = {0};
     uint8_t destfilename[32] = {0};
     bool errors = false;
+    bool dictionary = false;
+    uint8_t keylen = 6;
     uint8_t cmdp = 0;
 
     while (param_getchar(Cmd, cmdp) != 0x00 && !errors) {
         switch (tolower(param_getchar(Cmd, cmdp))) {
             case 'h':
                 return usage_flashmemspiffs_load();
+            case 'd':
+            case 'p':
+                dictionary = true;
+                keylen = (tolower(param_getchar(Cmd, cmdp)) == 'p') ? 4 : 6;
+                cmdp++;
+                break;
             case 'f':
                 if (param_getstr(Cmd, cmdp + 1, filename, FILE_PATH_SIZE) >= FILE_PATH_SIZE) {
                     PrintAndLogEx(FAILED, "Filename too long");
@@ -477,7 +448,14 @@ static int CmdFlashMemSpiFFSLoad(const char *Cmd) {
     size_t datalen = 0;
     uint8_t *data = NULL;
 
-    int res = loadFile_safe(filename, "", (void **)&data, &datalen);
+    int res;
+    if (dictionary) {
+        uint32_t keycnt = 0;
+        res = loadFileDICTIONARY_safe(filename, (void **)&data, keylen, &keycnt);
+        datalen = keycnt * keylen;
+    } else {
+        res = loadFile_safe(filename, "", (void **)&data, &datalen);
+    }
     // int res = loadFileEML( filename, data, &datalen);
     if (res != PM3_SUCCESS) {
         free(data);
@@ -43,15 +43,19 @@
 #include "cmddata.h"
 #include "graph.h"
 #include "fpga.h"
+#include "fileutils.h"      // newfilenamemcopy
+#include "util_posix.h"     // msclock
 
 static int CmdHelp(const char *Cmd);
 
 static int usage_hf_search(void) {
-    PrintAndLogEx(NORMAL, "Usage: hf search");
+    PrintAndLogEx(NORMAL, "Usage: hf search [h] [a]");
     PrintAndLogEx(NORMAL, "Will try to find a HF read out of the unknown tag.");
     PrintAndLogEx(NORMAL, "Continues to search for all different HF protocols");
+    PrintAndLogEx(NORMAL, "A first pass on the device polls all protocols at once, only the ones that answered are read out");
     PrintAndLogEx(NORMAL, "Options:");
     PrintAndLogEx(NORMAL, "       h               - This help");
+    PrintAndLogEx(NORMAL, "       a               - skip the device pass, run every protocol search");
     PrintAndLogEx(NORMAL, "");
     return PM3_SUCCESS;
 }
@@ -59,16 +63,22 @@ static int usage_hf_search(void) {
 static int usage_hf_sniff(void) {
     PrintAndLogEx(NORMAL, "The high frequence sniffer will assign all available memory on device for sniffed data");
     PrintAndLogEx(NORMAL, "Use " _YELLOW_("'data samples'")" command to download from device,  and " _YELLOW_("'data plot'")" to look at it");
+    PrintAndLogEx(NORMAL, "With r the samples are streamed while sniffing, the capture is not limited by device memory");
     PrintAndLogEx(NORMAL, "Press button to quit the sniffing.\n");
-    PrintAndLogEx(NORMAL, "Usage: hf sniff <skip pairs> <skip triggers>");
+    PrintAndLogEx(NORMAL, "Usage: hf sniff <skip pairs> <skip triggers> [r [d <decimation>] [s #samples] [f <filename>]]");
     PrintAndLogEx(NORMAL, "Options:");
     PrintAndLogEx(NORMAL, "       h               - This help");
     PrintAndLogEx(NORMAL, "       <skip pairs>    - skip sample pairs");
     PrintAndLogEx(NORMAL, "       <skip triggers> - skip number of triggers");
+    PrintAndLogEx(NORMAL, "       r               - stream the samples until " _GREEN_("Enter") " or button press");
+    PrintAndLogEx(NORMAL, "       d <decimation>  - with r, keep the peak of every <decimation> samples (1-255, default 8)");
+    PrintAndLogEx(NORMAL, "       s #samples      - with r, stop after this many samples (optional)");
+    PrintAndLogEx(NORMAL, "       f <filename>    - with r, save all streamed samples to a pm3 file (optional)");
     PrintAndLogEx(NORMAL, "");
     PrintAndLogEx(NORMAL, "Examples:");
     PrintAndLogEx(NORMAL, _YELLOW_("           hf sniff"));
     PrintAndLogEx(NORMAL, _YELLOW_("           hf sniff 1000 0"));
+    PrintAndLogEx(NORMAL, _YELLOW_("           hf sniff 0 0 r d 4 f longsniff"));
     PrintAndLogEx(NORMAL, "");
     return PM3_SUCCESS;
 }
@@ -76,16 +86,39 @@ static int usage_hf_sniff(void) {
 static int usage_hf_tune(void) {
     PrintAndLogEx(NORMAL, "Continuously measure HF antenna tuning.");
     PrintAndLogEx(NORMAL, "Press button or `enter` to interrupt.");
-    PrintAndLogEx(NORMAL, "Usage: hf tune [h] [<iter>]");
+    PrintAndLogEx(NORMAL, "Usage: hf tune [h] [<iter>] [s] [i <ms>]");
     PrintAndLogEx(NORMAL, "Options:");
     PrintAndLogEx(NORMAL, "       h             - This help");
     PrintAndLogEx(NORMAL, "       <iter>        - number of iterations (default: 0=infinite)");
+    PrintAndLogEx(NORMAL, "       s             - stream, the device pushes the average, min and max voltage");
+    PrintAndLogEx(NORMAL, "       i <ms>        - stream interval, %d-%d ms (default: %d)", ANTENNA_TUNING_STREAM_MIN_MS, ANTENNA_TUNING_STREAM_MAX_MS, TUNE_STREAM_INTERVAL_MS);
     PrintAndLogEx(NORMAL, "Examples:");
     PrintAndLogEx(NORMAL, _YELLOW_("           hf tune 1"));
+    PrintAndLogEx(NORMAL, _YELLOW_("           hf tune s i 20"));
     PrintAndLogEx(NORMAL, "");
     return PM3_SUCCESS;
 }
 
+// Device side poll of all protocols in one go. Returns the HF_SEARCH_ flags of the protocols that
+// answered, or everything set when the firmware doesn't know CMD_HF_SEARCH
+static uint16_t hf_search_prefilter(void) {
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_SEARCH, NULL, 0);
+    PacketResponseNG resp;
+    if (WaitForResponseTimeout(CMD_HF_SEARCH, &resp, 2500) == false) {
+        PrintAndLogEx(DEBUG, "no answer to the device pre-filter, trying all protocols");
+        return 0xFFFF & ~HF_SEARCH_NO_FIELD;
+    }
+
+    if (resp.status != PM3_SUCCESS && resp.status != PM3_EOPABORTED) {
+        return 0xFFFF & ~HF_SEARCH_NO_FIELD;
+    }
+
+    const hf_search_resp_t *payload = (const hf_search_resp_t *)resp.data.asBytes;
+    PrintAndLogEx(DEBUG, "pre-filter found 0x%04x, HF antenna %u mV", payload->found, payload->v_hf);
+    return payload->found;
+}
+
 int CmdHFSearch(const char *Cmd) {
 
     char cmdp = tolower(param_getchar(Cmd, 0));
@@ -93,6 +126,16 @@ int CmdHFSearch(const char *Cmd) {
 
     int res = PM3_ESOFT;
 
+    uint16_t found = 0xFFFF & ~HF_SEARCH_NO_FIELD;
+    if (cmdp != 'a') {
+        found = hf_search_prefilter();
+    }
+
+    if (found & HF_SEARCH_NO_FIELD) {
+        PrintAndLogEx(WARNING, "HF antenna is " _RED_("unusable") ", see " _YELLOW_("`hw tune`"));
+        return PM3_ESOFT;
+    }
+
     PROMPT_CLEARLINE;
     PrintAndLogEx(INPLACE, " Searching for ThinFilm tag...");
     if (IfPm3NfcBarcode()) {
@@ -113,7 +156,7 @@ int CmdHFSearch(const char *Cmd) {
 
     PROMPT_CLEARLINE;
     PrintAndLogEx(INPLACE, " Searching for ISO14443-A tag...");
-    if (IfPm3Iso14443a()) {
+    if (IfPm3Iso14443a() && (found & HF_SEARCH_14A)) {
         if (infoHF14A(false, false, false) > 0) {
             PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("ISO14443-A tag") " found\n");
             res = PM3_SUCCESS;
@@ -122,7 +165,7 @@ int CmdHFSearch(const char *Cmd) {
 
     PROMPT_CLEARLINE;
     PrintAndLogEx(INPLACE, " Searching for ISO15693 tag...");
-    if (IfPm3Iso15693()) {
+    if (IfPm3Iso15693() && (found & HF_SEARCH_15693)) {
         if (readHF15Uid(false, false)) {
             PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("ISO15693 tag") " found\n");
             res = PM3_SUCCESS;
@@ -131,7 +174,7 @@ int CmdHFSearch(const char *Cmd) {
 
     PROMPT_CLEARLINE;
     PrintAndLogEx(INPLACE, " Searching for iCLASS / PicoPass tag...");
-    if (IfPm3Iclass()) {
+    if (IfPm3Iclass() && (found & HF_SEARCH_ICLASS)) {
         if (read_iclass_csn(false, false) == PM3_SUCCESS) {
             PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("iCLASS tag / PicoPass tag") " found\n");
             res = PM3_SUCCESS;
@@ -149,7 +192,7 @@ int CmdHFSearch(const char *Cmd) {
 
     PROMPT_CLEARLINE;
     PrintAndLogEx(INPLACE, " Searching for Topaz tag...");
-    if (IfPm3Iso14443a()) {
+    if (IfPm3Iso14443a() && (found & HF_SEARCH_TOPAZ)) {
         if (readTopazUid(false) == PM3_SUCCESS) {
             PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Topaz tag") " found\n");
             res = PM3_SUCCESS;
@@ -159,7 +202,7 @@ int CmdHFSearch(const char *Cmd) {
     // 14b  is the longest test (put last)
     PROMPT_CLEARLINE;
     PrintAndLogEx(INPLACE, " Searching for ISO14443-B tag...");
-    if (IfPm3Iso14443b()) {
+    if (IfPm3Iso14443b() && (found & (HF_SEARCH_14B | HF_SEARCH_SRX))) {
         if (readHF14B(false) == 1) {
             PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("ISO14443-B tag") " found\n");
             res = PM3_SUCCESS;
@@ -198,9 +241,41 @@ int CmdHFSearch(const char *Cmd) {
 }
 
 int CmdHFTune(const char *Cmd) {
-    char cmdp = tolower(param_getchar(Cmd, 0));
-    if (cmdp == 'h') return usage_hf_tune();
-    int iter = param_get32ex(Cmd, 0, 0, 10);
+    int iter = 0;
+    bool stream = false;
+    uint32_t interval = TUNE_STREAM_INTERVAL_MS;
+    uint8_t cmdp = 0;
+    while (param_getchar(Cmd, cmdp) != 0x00) {
+        switch (tolower(param_getchar(Cmd, cmdp))) {
+            case 'h':
+                return usage_hf_tune();
+            case 's':
+                stream = true;
+                cmdp++;
+                break;
+            case 'i':
+                interval = param_get32ex(Cmd, cmdp + 1, 0, 10);
+                if (interval < ANTENNA_TUNING_STREAM_MIN_MS || interval > ANTENNA_TUNING_STREAM_MAX_MS) {
+                    PrintAndLogEx(ERR, "interval must be between %d and %d ms", ANTENNA_TUNING_STREAM_MIN_MS, ANTENNA_TUNING_STREAM_MAX_MS);
+                    return PM3_EINVARG;
+                }
+                cmdp += 2;
+                break;
+            default:
+                if (!isdigit((unsigned char)param_getchar(Cmd, cmdp))) {
+                    PrintAndLogEx(WARNING, "Unknown parameter '%c'", param_getchar(Cmd, cmdp));
+                    return usage_hf_tune();
+                }
+                iter = param_get32ex(Cmd, cmdp, 0, 10);
+                cmdp++;
+                break;
+        }
+    }
+
+    if (stream) {
+        PrintAndLogEx(INFO, "Streaming HF antenna every %u ms, click " _GREEN_("pm3 button") " or press " _GREEN_("Enter") " to exit", interval);
+        return antenna_tune_stream(true, 0, interval, iter);
+    }
 
     PrintAndLogEx(INFO, "Measuring HF antenna, click " _GREEN_("pm3 button") " or press " _GREEN_("Enter") " to exit");
     PacketResponseNG resp;
@@ -246,6 +321,104 @@ int CmdHFTune(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// Streamed sniff, the device pushes CMD_HF_SNIFF_STREAM frames while it keeps sniffing.
+// The last MAX_GRAPH_TRACE_LEN samples end up in the graph buffer, the whole capture
+// can be written to a file as it arrives.
+static int hf_sniff_stream(hf_sniff_stream_req_t *req, const char *filename) {
+    FILE *f = NULL;
+    if (filename != NULL) {
+        char *fn = newfilenamemcopy(filename, ".pm3");
+        if (fn == NULL) return PM3_EMALLOC;
+        f = fopen(fn, "w");
+        if (f == NULL) {
+            PrintAndLogEx(WARNING, "could not create file " _YELLOW_("%s"), fn);
+            free(fn);
+            return PM3_EFILE;
+        }
+        PrintAndLogEx(INFO, "saving samples to " _YELLOW_("%s"), fn);
+        free(fn);
+    }
+
+    graph_ring_t ring = { .size = MAX_GRAPH_TRACE_LEN };
+    ring.buf = calloc(ring.size, sizeof(uint8_t));
+    if (ring.buf == NULL) {
+        if (f) fclose(f);
+        return PM3_EMALLOC;
+    }
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_SNIFF_STREAM, (uint8_t *)req, sizeof(hf_sniff_stream_req_t));
+    PrintAndLogEx(INFO, "Waiting for the trigger, press " _GREEN_("Enter") " to stop");
+
+    PacketResponseNG resp;
+    hf_sniff_stream_frame_t *frame = (hf_sniff_stream_frame_t *)resp.data.asBytes;
+    uint64_t last_frame = msclock();
+    uint16_t seq = 0;
+    bool stopping = false;
+    int status = PM3_SUCCESS;
+
+    for (;;) {
+        if (stopping == false && kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            stopping = true;
+            last_frame = msclock();
+        }
+
+        if (WaitForResponseTimeout(CMD_HF_SNIFF_STREAM, &resp, 100) == false) {
+            // nothing comes while waiting for the trigger
+            if (stopping == false || msclock() - last_frame < 2500)
+                continue;
+
+            PrintAndLogEx(WARNING, "(hf sniff) command execution time out");
+            clearCommandBuffer();
+            SendCommandNG(CMD_FPGA_MAJOR_MODE_OFF, NULL, 0);
+            status = PM3_ETIMEOUT;
+            break;
+        }
+        last_frame = msclock();
+
+        // errors before sniffing started carry no frame
+        if (resp.length < sizeof(hf_sniff_stream_frame_t) - HF_SNIFF_STREAM_SAMPLES) {
+            status = resp.status;
+            break;
+        }
+
+        if (frame->seq != seq)
+            PrintAndLogEx(WARNING, "lost " _YELLOW_("%u") " frames", (uint16_t)(frame->seq - seq));
+        seq = frame->seq + 1;
+
+        uint16_t len = MIN(frame->len, HF_SNIFF_STREAM_SAMPLES);
+        graph_ring_push(&ring, frame->data, len);
+        if (f) {
+            for (uint16_t i = 0; i < len; i++)
+                fprintf(f, "%d\n", ((int)frame->data[i]) - 127);
+        }
+
+        if (frame->final) {
+            status = resp.status;
+            break;
+        }
+    }
+
+    if (f) {
+        fflush(f);
+        fclose(f);
+    }
+
+    graph_ring_to_graph(&ring, ring.size);
+    RepaintGraphWindow();
+    free(ring.buf);
+
+    if (status == PM3_EOVFLOW)
+        PrintAndLogEx(WARNING, "device buffer overflow, the samples came faster than they were read. Try a higher decimation");
+
+    PrintAndLogEx(SUCCESS, "Streamed " _YELLOW_("%" PRIu64) " samples, decimation " _YELLOW_("%u") ", graph buffer holds the last " _YELLOW_("%zu"), ring.total, req->decimation, GraphTraceLen);
+    PrintAndLogEx(HINT, "Use `" _YELLOW_("data hpf") "` to remove offset");
+    PrintAndLogEx(HINT, "Use `" _YELLOW_("data plot") "` to view");
+
+    return (status == PM3_EOPABORTED) ? PM3_SUCCESS : status;
+}
+
 // Collects pars of u8,
 // uses 16bit transfers from FPGA for speed
 // Takes all available bigbuff memory
@@ -262,6 +435,62 @@ int CmdHFSniff(const char *Cmd) {
     params.samplesToSkip = param_get32ex(Cmd, 0, 0, 10);
     params.triggersToSkip = param_get32ex(Cmd, 1, 0, 10);
 
+    // streaming options follow the skip counts
+    bool errors = false;
+    bool stream = false;
+    bool stream_opts = false;
+    char filename[FILE_PATH_SIZE] = {0};
+    hf_sniff_stream_req_t req = { .decimation = 8 };
+    uint8_t i = 0;
+    while (param_getchar(Cmd, i) != 0x00 && !errors) {
+        char c = tolower(param_getchar(Cmd, i));
+        if (i < 2 && isdigit(c)) {
+            i++;
+            continue;
+        }
+        stream_opts |= (c == 'd' || c == 's' || c == 'f');
+        switch (c) {
+            case 'r':
+                stream = true;
+                i++;
+                break;
+            case 'd':
+                req.decimation = param_get8ex(Cmd, i + 1, 0, 10);
+                if (req.decimation == 0) {
+                    PrintAndLogEx(WARNING, "decimation must be 1-255");
+                    errors = true;
+                }
+                i += 2;
+                break;
+            case 's':
+                req.samples = param_get32ex(Cmd, i + 1, 0, 10);
+                i += 2;
+                break;
+            case 'f':
+                if (param_getstr(Cmd, i + 1, filename, FILE_PATH_SIZE) == 0) {
+                    PrintAndLogEx(WARNING, "missing filename");
+                    errors = true;
+                }
+                i += 2;
+                break;
+            default:
+                PrintAndLogEx(WARNING, "Unknown parameter '%c'", param_getchar(Cmd, i));
+                errors = true;
+                break;
+        }
+    }
+    if (errors) return usage_hf_sniff();
+    if (stream_opts && stream == false) {
+        PrintAndLogEx(WARNING, "options d, s and f need r");
+        return usage_hf_sniff();
+    }
+
+    if (stream) {
+        req.samplesToSkip = params.samplesToSkip;
+        req.triggersToSkip = params.triggersToSkip;
+        return hf_sniff_stream(&req, filename[0] ? filename : NULL);
+    }
+
     clearCommandBuffer();
     SendCommandNG(CMD_HF_SNIFF, (uint8_t *)&params, sizeof(params));
 
@@ -354,7 +583,7 @@ static command_t CommandTable[] = {
     {"14a",         CmdHF14A,         AlwaysAvailable, "{ ISO14443A RFIDs...               }"},
     {"14b",         CmdHF14B,         AlwaysAvailable, "{ ISO14443B RFIDs...               }"},
     {"15",          CmdHF15,          AlwaysAvailable, "{ ISO15693 RFIDs...                }"},
-//    {"cryptorf",    CmdHFCryptoRF,    AlwaysAvailable, "{ CryptoRF RFIDs...                }"},
+    {"cryptorf",    CmdHFCryptoRF,    AlwaysAvailable, "{ CryptoRF RFIDs...                }"},
     {"epa",         CmdHFEPA,         AlwaysAvailable, "{ German Identification Card...    }"},
     {"felica",      CmdHFFelica,      AlwaysAvailable, "{ ISO18092 / Felica RFIDs...       }"},
     {"fido",        CmdHFFido,        AlwaysAvailable, "{ FIDO and FIDO2 authenticators... }"},
@@ -27,6 +27,7 @@
 #include "crc16.h"
 #include "util_posix.h"  // msclock
 #include "aidsearch.h"
+#include "protocols.h"  // ISO_14443A
 
 bool APDUInFramingEnable = true;
 
@@ -169,7 +170,7 @@ static uint16_t frameLength = 0;
 uint16_t atsFSC[] = {16, 24, 32, 40, 48, 64, 96, 128, 256};
 
 static int usage_hf_14a_config(void) {
-    PrintAndLogEx(NORMAL, "Usage: hf 14a config [a 0|1|2] [b 0|1|2] [2 0|1|2] [3 0|1|2]");
+    PrintAndLogEx(NORMAL, "Usage: hf 14a config [a 0|1|2] [b 0|1|2] [2 0|1|2] [3 0|1|2] [r 0|1|2] [t 0|1]");
     PrintAndLogEx(NORMAL, "\nOptions:");
     PrintAndLogEx(NORMAL, "       h                 This help");
     PrintAndLogEx(NORMAL, "       a 0|1|2           ATQA<>anticollision: 0=follow standard 1=execute anticol 2=skip anticol");
@@ -177,12 +178,14 @@ static int usage_hf_14a_config(void) {
     PrintAndLogEx(NORMAL, "       2 0|1|2           SAK<>CL2:            0=follow standard 1=execute CL2     2=skip CL2");
     PrintAndLogEx(NORMAL, "       3 0|1|2           SAK<>CL3:            0=follow standard 1=execute CL3     2=skip CL3");
     PrintAndLogEx(NORMAL, "       r 0|1|2           SAK<>ATS:            0=follow standard 1=execute RATS    2=skip RATS");
+    PrintAndLogEx(NORMAL, "       t 0|1             Timeouts:            0=fixed           1=learn the card latency, wait shorter for missing answers");
     PrintAndLogEx(NORMAL, "\nExamples:");
     PrintAndLogEx(NORMAL, _YELLOW_("          hf 14a config       ")"     Print current configuration");
     PrintAndLogEx(NORMAL, _YELLOW_("          hf 14a config a 1   ")"     Force execution of anticollision");
     PrintAndLogEx(NORMAL, _YELLOW_("          hf 14a config a 0   ")"     Restore ATQA interpretation");
     PrintAndLogEx(NORMAL, _YELLOW_("          hf 14a config b 1   ")"     Force fix of bad BCC in anticollision");
     PrintAndLogEx(NORMAL, _YELLOW_("          hf 14a config b 0   ")"     Restore BCC check");
+    PrintAndLogEx(NORMAL, _YELLOW_("          hf 14a config t 1   ")"     Faster dictionary and darkside loops on cards answering in time");
     PrintAndLogEx(NORMAL, "\nExamples to revive Gen2/DirectWrite magic cards failing at anticollision:");
     PrintAndLogEx(NORMAL, _CYAN_("    MFC 1k 4b UID")":");
     PrintAndLogEx(NORMAL, _YELLOW_("          hf 14a config a 1 b 2 2 2 r 2"));
@@ -227,26 +230,49 @@ static int usage_hf_14a_sim(void) {
     PrintAndLogEx(NORMAL, "    u     : 4, 7 byte UID");
     PrintAndLogEx(NORMAL, "    x     : (Optional) Performs the 'reader attack', nr/ar attack against a reader");
     PrintAndLogEx(NORMAL, "    e     : (Optional) Fill simulator keys from found keys");
+    PrintAndLogEx(NORMAL, "    n     : (Optional) No trace, for readers which are quick to send the next frame");
     PrintAndLogEx(NORMAL, "    v     : (Optional) Verbose");
     PrintAndLogEx(NORMAL, "Examples:");
     PrintAndLogEx(NORMAL, _YELLOW_("          hf 14a sim t 1 u 11223344 x"));
+    PrintAndLogEx(NORMAL, _YELLOW_("          hf 14a sim t 1 u 11223344 n"));
     PrintAndLogEx(NORMAL, _YELLOW_("          hf 14a sim t 1 u 11223344"));
     PrintAndLogEx(NORMAL, _YELLOW_("          hf 14a sim t 1 u 11223344556677"));
 //  PrintAndLogEx(NORMAL, "          hf 14a sim t 1 u 11223445566778899AA\n");
     return PM3_SUCCESS;
 }
+static int usage_hf_14a_sweep(void) {
+    PrintAndLogEx(NORMAL, "\n Reader bruteforce with a range of ISO/IEC 14443 type A uids, the loop runs on the device\n");
+    PrintAndLogEx(NORMAL, "Usage: hf 14a sweep [h] t <type> u <uid> [n <count>] [s <step>] [d <ms>]");
+    PrintAndLogEx(NORMAL, "Options:");
+    PrintAndLogEx(NORMAL, "    h     : This help");
+    PrintAndLogEx(NORMAL, "    t     : tag type, see " _YELLOW_("`hf 14a sim h`"));
+    PrintAndLogEx(NORMAL, "    u     : first 4 or 7 byte UID");
+    PrintAndLogEx(NORMAL, "    n     : number of uids, default 256");
+    PrintAndLogEx(NORMAL, "    s     : added to the uid for the next one, default 1");
+    PrintAndLogEx(NORMAL, "    d     : time each uid answers the reader in ms, default 500");
+    PrintAndLogEx(NORMAL, "Examples:");
+    PrintAndLogEx(NORMAL, _YELLOW_("          hf 14a sweep t 1 u 11223300"));
+    PrintAndLogEx(NORMAL, _YELLOW_("          hf 14a sweep t 1 u 11223300 n 1000 d 200"));
+    PrintAndLogEx(NORMAL, _YELLOW_("          hf 14a sweep t 2 u 04112233445566 s 0x100"));
+    return PM3_SUCCESS;
+}
 static int usage_hf_14a_sniff(void) {
     PrintAndLogEx(NORMAL, "It get data from the field and saves it into command buffer.");
     PrintAndLogEx(NORMAL, "Buffer accessible from command 'hf list 14a'");
-    PrintAndLogEx(NORMAL, "Usage:  hf 14a sniff [c][r]");
+    PrintAndLogEx(NORMAL, "Usage:  hf 14a sniff [c][r][w][l|m]");
     PrintAndLogEx(NORMAL, "c - triggered by first data from card");
     PrintAndLogEx(NORMAL, "r - triggered by first 7-bit request from reader (REQ,WUP,...)");
+    PrintAndLogEx(NORMAL, "w - wrap around when the trace is full, keeps the latest traffic and sniffs until the button");
+    PrintAndLogEx(NORMAL, "l - live, list the frames as they are sniffed until Enter or the button");
+    PrintAndLogEx(NORMAL, "m - live, as l but annotated and decrypted as Mifare Classic");
     PrintAndLogEx(NORMAL, "Examples:");
     PrintAndLogEx(NORMAL, _YELLOW_("        hf 14a sniff c r"));
+    PrintAndLogEx(NORMAL, _YELLOW_("        hf 14a sniff w"));
+    PrintAndLogEx(NORMAL, _YELLOW_("        hf 14a sniff l"));
     return PM3_SUCCESS;
 }
 static int usage_hf_14a_raw(void) {
-    PrintAndLogEx(NORMAL, "Usage: hf 14a raw [-h] [-r] [-c] [-p] [-a] [-T] [-t] <milliseconds> [-b] <number of bits>  <0A 0B 0C ... hex>");
+    PrintAndLogEx(NORMAL, "Usage: hf 14a raw [-h] [-r] [-c] [-p] [-a] [-T] [-t] <milliseconds> [-b] <number of bits> [-g] <ticks>  <0A 0B 0C ... hex>");
     PrintAndLogEx(NORMAL, "       -h    this help");
     PrintAndLogEx(NORMAL, "       -r    do not read response");
     PrintAndLogEx(NORMAL, "       -c    calculate and append CRC");
@@ -257,6 +283,7 @@ static int usage_hf_14a_raw(void) {
     PrintAndLogEx(NORMAL, "       -t    timeout in ms");
     PrintAndLogEx(NORMAL, "       -T    use Topaz protocol to send command");
     PrintAndLogEx(NORMAL, "       -3    ISO14443-3 select only (skip RATS)");
+    PrintAndLogEx(NORMAL, "       -g    tear-off, cut the field <ticks> ssp clocks (~1.18us) after the end of the frame");
     return PM3_SUCCESS;
 }
 static int usage_hf_14a_reader(void) {
@@ -318,7 +345,8 @@ static int CmdHf14AConfig(const char *Cmd) {
         .forcebcc = -1,
         .forcecl2 = -1,
         .forcecl3 = -1,
-        .forcerats = -1
+        .forcerats = -1,
+        .adaptive = -1
     };
 
     bool errors = false;
@@ -417,6 +445,21 @@ static int CmdHf14AConfig(const char *Cmd) {
                 }
                 cmdp += 2;
                 break;
+            case 't':
+                switch (param_getchar(Cmd, cmdp + 1)) {
+                    case '0':
+                        config.adaptive = 0;
+                        break;
+                    case '1':
+                        config.adaptive = 1;
+                        break;
+                    default:
+                        PrintAndLogEx(WARNING, "Unknown value '%c'", param_getchar(Cmd, cmdp + 1));
+                        errors = 1;
+                        break;
+                }
+                cmdp += 2;
+                break;
             default:
                 PrintAndLogEx(WARNING, "Unknown parameter '%c'", param_getchar(Cmd, cmdp));
                 errors = 1;
@@ -590,40 +633,91 @@ static int CmdHF14ACUIDs(const char *Cmd) {
     int n = atoi(Cmd);
     // collect at least 1 (e.g. if no parameter was given)
     n = n > 0 ? n : 1;
+    // field off time between two UIDs
+    uint16_t off_ms = 5;
+    if (tolower(param_getchar(Cmd, 1)) == 'd')
+        off_ms = param_get32ex(Cmd, 2, 5, 10);
 
     uint64_t t1 =  msclock();
-    PrintAndLogEx(SUCCESS, "collecting %d UIDs", n);
+    PrintAndLogEx(SUCCESS, "collecting %d UIDs, field off %u ms in between", n, off_ms);
 
-    // repeat n times
-    for (int i = 0; i < n; i++) {
+    iso14a_cuids_req_t req = { .count = n, .off_ms = off_ms };
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_ISO14443A_CUIDS, (uint8_t *)&req, sizeof(req));
 
-        if (kbd_enter_pressed()) {
+    PacketResponseNG resp;
+    iso14a_cuids_frame_t *frame = (iso14a_cuids_frame_t *)resp.data.asBytes;
+    bool aborted = false;
+    for (;;) {
+        if (aborted == false && kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
             PrintAndLogEx(WARNING, "aborted via keyboard!\n");
-            break;
+            aborted = true;
         }
 
-        // execute anticollision procedure
-        SendCommandMIX(CMD_HF_ISO14443A_READER, ISO14A_CONNECT | ISO14A_NO_RATS, 0, 0, NULL, 0);
-
-        PacketResponseNG resp;
-        WaitForResponse(CMD_ACK, &resp);
-
-        iso14a_card_select_t *card = (iso14a_card_select_t *) resp.data.asBytes;
+        if (WaitForResponseTimeout(CMD_HF_ISO14443A_CUIDS, &resp, 100) == false)
+            continue;
 
-        // check if command failed
-        if (resp.oldarg[0] == 0) {
+        if (resp.length < sizeof(iso14a_cuids_frame_t)) {
             PrintAndLogEx(WARNING, "card select failed.");
-        } else {
-            char uid_string[20];
-            for (uint16_t m = 0; m < card->uidlen; m++) {
-                sprintf(&uid_string[2 * m], "%02X", card->uid[m]);
+            return resp.status;
+        }
+
+        for (uint8_t i = 0; i < frame->n && i < ISO14A_CUIDS_FRAME; i++) {
+            char uid_string[21];
+            for (uint8_t m = 0; m < frame->uids[i].uidlen && m < sizeof(frame->uids[i].uid); m++) {
+                sprintf(&uid_string[2 * m], "%02X", frame->uids[i].uid[m]);
             }
             PrintAndLogEx(SUCCESS, "%s", uid_string);
         }
+
+        if (frame->final)
+            break;
     }
-    PrintAndLogEx(SUCCESS, "end: %" PRIu64 " seconds", (msclock() - t1) / 1000);
-    return 1;
+
+    uint64_t t = msclock() - t1;
+    if (frame->failed)
+        PrintAndLogEx(WARNING, "card select failed %u times", frame->failed);
+    PrintAndLogEx(SUCCESS, "end: %" PRIu64 " seconds, %u UIDs, %.0f per second", t / 1000, frame->collected, (t) ? frame->collected * 1000.0 / t : 0);
+    return resp.status;
 }
+// All the ISO14443 Type A cards in the field
+static int CmdHF14AInventory(const char *Cmd) {
+    iso14a_inventory_req_t req = { .no_rats = (tolower(param_getchar(Cmd, 0)) == 's') };
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_ISO14443A_INVENTORY, (uint8_t *)&req, sizeof(req));
+
+    PacketResponseNG resp;
+    bool aborted = false;
+    for (;;) {
+        if (aborted == false && kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            PrintAndLogEx(WARNING, "aborted via keyboard!\n");
+            aborted = true;
+        }
+
+        if (WaitForResponseTimeout(CMD_HF_ISO14443A_INVENTORY, &resp, 100) == false)
+            continue;
+
+        if (resp.status != PM3_EPARTIAL)
+            break;
+
+        iso14a_card_select_t *card = (iso14a_card_select_t *)resp.data.asBytes;
+        PrintAndLogEx(SUCCESS, " UID: " _GREEN_("%s") " ATQA: %02x %02x SAK: %02x%s%s",
+                      sprint_hex(card->uid, card->uidlen),
+                      card->atqa[1], card->atqa[0], card->sak,
+                      (card->ats_len) ? " ATS: " : "",
+                      (card->ats_len) ? sprint_hex(card->ats, card->ats_len) : ""
+                     );
+    }
+
+    uint8_t count = (resp.length) ? resp.data.asBytes[0] : 0;
+    if (resp.status == PM3_ESOFT)
+        PrintAndLogEx(WARNING, "a card answered again after the halt, there may be more");
+    PrintAndLogEx(SUCCESS, "%u card%s in the field", count, (count == 1) ? "" : "s");
+    return resp.status;
+}
+
 // ## simulate iso14443a tag
 int CmdHF14ASim(const char *Cmd) {
 
@@ -682,6 +776,10 @@ int CmdHF14ASim(const char *Cmd) {
                 setEmulatorMem = true;
                 cmdp++;
                 break;
+            case 'n':
+                flags |= FLAG_NO_TRACE;
+                cmdp++;
+                break;
             default:
                 PrintAndLogEx(WARNING, "Unknown parameter " _RED_("'%c'"), param_getchar(Cmd, cmdp));
                 errors = true;
@@ -732,18 +830,151 @@ int CmdHF14ASim(const char *Cmd) {
     if (resp.status == PM3_EOPABORTED && ((flags & FLAG_NR_AR_ATTACK) == FLAG_NR_AR_ATTACK))
         showSectorTable(k_sector, k_sectorsCount);
 
+    // the final reply has the answer timing
+    if (resp.status != PM3_SUCCESS && resp.length == sizeof(iso14a_sim_stats_t)) {
+        iso14a_sim_stats_t *stats = (iso14a_sim_stats_t *)resp.data.asBytes;
+        if (stats->late)
+            PrintAndLogEx(WARNING, _YELLOW_("%u") " of %u answers were late, longest frame delay %u", stats->late, stats->answers, stats->fdt_max);
+        else if (verbose)
+            PrintAndLogEx(INFO, "%u answers in time, longest frame delay %u", stats->answers, stats->fdt_max);
+    }
+
     PrintAndLogEx(INFO, "Done");
     return PM3_SUCCESS;
 }
 
+static int CmdHF14ASweep(const char *Cmd) {
+
+    sim_sweep_t payload = {
+        .type = SIM_SWEEP_14A,
+        .tagtype = 1,
+        .dwell = 500,
+        .step = 1,
+        .count = 256,
+    };
+
+    uint8_t uid[7] = {0};
+    int uidlen = 0;
+    bool errors = false;
+    uint8_t cmdp = 0;
+    while (param_getchar(Cmd, cmdp) != 0x00 && errors == false) {
+        switch (tolower(param_getchar(Cmd, cmdp))) {
+            case 'h':
+                return usage_hf_14a_sweep();
+            case 't':
+                payload.tagtype = param_get8ex(Cmd, cmdp + 1, 0, 10);
+                if (payload.tagtype == 0)
+                    errors = true;
+                cmdp += 2;
+                break;
+            case 'u':
+                uidlen = param_getlength(Cmd, cmdp + 1);
+                if (uidlen != 8 && uidlen != 14) {
+                    errors = true;
+                    break;
+                }
+                param_gethex_ex(Cmd, cmdp + 1, uid, &uidlen);
+                uidlen >>= 1;
+                payload.flags = (uidlen == 7) ? FLAG_7B_UID_IN_DATA : FLAG_4B_UID_IN_DATA;
+                payload.start = bytes_to_num(uid, uidlen);
+                cmdp += 2;
+                break;
+            case 'n':
+                payload.count = param_get32ex(Cmd, cmdp + 1, 256, 0);
+                cmdp += 2;
+                break;
+            case 's':
+                payload.step = param_get32ex(Cmd, cmdp + 1, 1, 0);
+                cmdp += 2;
+                break;
+            case 'd':
+                payload.dwell = param_get32ex(Cmd, cmdp + 1, 500, 10);
+                cmdp += 2;
+                break;
+            default:
+                PrintAndLogEx(WARNING, "Unknown parameter: " _YELLOW_("'%c'"), param_getchar(Cmd, cmdp));
+                errors = true;
+                break;
+        }
+    }
+
+    if (uidlen == 0 || payload.count == 0 || payload.dwell == 0) errors = true;
+    if (errors) return usage_hf_14a_sweep();
+
+    PrintAndLogEx(SUCCESS, "Sweeping " _YELLOW_("%u") " uids of type %u from " _GREEN_("%s") ", step %u, %u ms each"
+                  , payload.count, payload.tagtype, sprint_hex_inrow(uid, uidlen), payload.step, payload.dwell);
+    PrintAndLogEx(INFO, "Press pm3-button or " _GREEN_("Enter") " to abort the sweep");
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_ISO14443A_SIM_SWEEP, (uint8_t *)&payload, sizeof(payload));
+
+    PacketResponseNG resp;
+    sim_sweep_resp_t *r = (sim_sweep_resp_t *)resp.data.asBytes;
+    uint64_t stopped = 0;
+
+    for (;;) {
+        if (stopped == 0 && kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            stopped = msclock();
+        }
+
+        if (WaitForResponseTimeout(CMD_HF_ISO14443A_SIM_SWEEP, &resp, 200) == false) {
+            if (stopped && msclock() - stopped > 2500) {
+                PrintAndLogEx(NORMAL, "");
+                PrintAndLogEx(WARNING, "command execution time out");
+                return PM3_ETIMEOUT;
+            }
+            continue;
+        }
+
+        if (resp.length < sizeof(sim_sweep_resp_t)) {
+            PrintAndLogEx(NORMAL, "");
+            return resp.status;
+        }
+
+        num_to_bytes(r->value, uidlen, uid);
+        PrintAndLogEx(INPLACE, " %u / %u  uid " _YELLOW_("%s"), r->index + 1, payload.count, sprint_hex_inrow(uid, uidlen));
+
+        if (resp.status != PM3_EPARTIAL)
+            break;
+    }
+
+    PrintAndLogEx(NORMAL, "");
+    if (resp.status == PM3_EOPABORTED) {
+        PrintAndLogEx(INFO, "Sweep aborted");
+        return PM3_SUCCESS;
+    }
+    if (resp.status == PM3_SUCCESS)
+        PrintAndLogEx(SUCCESS, "Sweep done");
+    return resp.status;
+}
+
+static int sniff14a_live(uint8_t param, uint8_t protocol) {
+    int res = trace_live_sniff(CMD_HF_ISO14443A_SNIFF_STREAM, protocol, &param, sizeof(param));
+    PrintAndLogEx(HINT, "Try `" _YELLOW_("trace list 14a 1") "` to list the session again, or `" _YELLOW_("trace save") "` to keep it");
+    return res;
+}
+
 int CmdHF14ASniff(const char *Cmd) {
     uint8_t param = 0;
-    for (uint8_t i = 0; i < 2; i++) {
+    bool live = false;
+    uint8_t protocol = ISO_14443A;
+    for (uint8_t i = 0; i < 4; i++) {
         uint8_t ctmp = tolower(param_getchar(Cmd, i));
         if (ctmp == 'h') return usage_hf_14a_sniff();
         if (ctmp == 'c') param |= 0x01;
         if (ctmp == 'r') param |= 0x02;
+        if (ctmp == 'w') param |= 0x04;
+        if (ctmp == 'l') live = true;
+        if (ctmp == 'm') {
+            live = true;
+            protocol = PROTO_MIFARE;
+        }
     }
+
+    if (live)
+        return sniff14a_live(param, protocol);
+
     clearCommandBuffer();
     SendCommandNG(CMD_HF_ISO14443A_SNIFF, (uint8_t *)&param, sizeof(uint8_t));
     return PM3_SUCCESS;
@@ -993,8 +1224,134 @@ static int CmdExchangeAPDU(bool chainingin, uint8_t *datain, int datainlen, bool
     return 0;
 }
 
+// the device does the block protocol of the whole APDU, same results as the host chaining below
+static int CmdExchangeAPDUDevice(uint8_t *datain, int datainlen, bool activateField, uint8_t *dataout, int maxdataoutlen, int *dataoutlen) {
+    if (activateField) {
+        // select with no disconnect and set frameLength
+        int selres = SelectCard14443_4(false, NULL);
+        if (selres)
+            return selres;
+    }
+
+    iso14a_apdu_req_t req;
+    req.fsc = APDUInFramingEnable ? frameLength : 0;
+    req.len = datainlen;
+    memcpy(req.apdu, datain, datainlen);
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_ISO14443A_APDU, (uint8_t *)&req, sizeof(req) - sizeof(req.apdu) + datainlen);
+
+    bool overflow = false;
+    PacketResponseNG resp;
+    for (;;) {
+        if (WaitForResponseTimeout(CMD_HF_ISO14443A_APDU, &resp, 1500) == false) {
+            PrintAndLogEx(ERR, "APDU: Reply timeout.");
+            return 4;
+        }
+
+        iso14a_apdu_resp_t *answer = (iso14a_apdu_resp_t *)resp.data.asBytes;
+        if (maxdataoutlen && *dataoutlen + answer->len > maxdataoutlen) {
+            overflow = true;
+        } else {
+            memcpy(dataout + *dataoutlen, answer->data, answer->len);
+            *dataoutlen += answer->len;
+        }
+
+        if (answer->final == false)
+            continue;
+
+        if (overflow) {
+            PrintAndLogEx(ERR, "APDU: Buffer too small(%d). Needs more", maxdataoutlen);
+            return 2;
+        }
+
+        switch (answer->error) {
+            case ISO14A_APDU_OK:
+                return 0;
+            case ISO14A_APDU_NO_ANSWER:
+                PrintAndLogEx(ERR, "APDU: No APDU response.");
+                return 1;
+            case ISO14A_APDU_CRC:
+                PrintAndLogEx(ERR, "APDU: ISO 14443A CRC error.");
+                return 3;
+            case ISO14A_APDU_CHAIN:
+                return 201;
+            default:
+                PrintAndLogEx(ERR, "APDU: Small APDU response.");
+                return 2;
+        }
+    }
+}
+
+// a whole file of the selected ISO14443-4 card, READ BINARY after READ BINARY of le bytes on the device.
+// fid 0 reads the file selected already. With nlen the file starts with its length, len is the most to read
+int ReadBinary14a(uint16_t fid, uint16_t offset, uint16_t len, uint16_t le, bool nlen, uint8_t *dataout, int maxdataoutlen, int *dataoutlen, uint16_t *sw) {
+    *dataoutlen = 0;
+    *sw = 0;
+
+    iso14a_read_binary_req_t req;
+    req.fsc = APDUInFramingEnable ? frameLength : 0;
+    req.fid = fid;
+    req.offset = offset;
+    req.len = len;
+    req.le = le;
+    req.nlen = nlen;
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_ISO14443A_READ_BINARY, (uint8_t *)&req, sizeof(req));
+
+    bool overflow = false;
+    PacketResponseNG resp;
+    for (;;) {
+        if (WaitForResponseTimeout(CMD_HF_ISO14443A_READ_BINARY, &resp, 2500) == false) {
+            PrintAndLogEx(ERR, "APDU: Reply timeout.");
+            return PM3_ETIMEOUT;
+        }
+
+        iso14a_read_binary_resp_t *answer = (iso14a_read_binary_resp_t *)resp.data.asBytes;
+        if (*dataoutlen + answer->len > maxdataoutlen) {
+            overflow = true;
+        } else {
+            memcpy(dataout + *dataoutlen, answer->data, answer->len);
+            *dataoutlen += answer->len;
+        }
+
+        if (answer->final == false)
+            continue;
+
+        *sw = answer->sw;
+        if (overflow) {
+            PrintAndLogEx(ERR, "APDU: Buffer too small(%d). Needs more", maxdataoutlen);
+            return PM3_EOVFLOW;
+        }
+
+        switch (answer->error) {
+            case ISO14A_APDU_OK:
+                return PM3_SUCCESS;
+            case ISO14A_APDU_NO_ANSWER:
+                PrintAndLogEx(ERR, "APDU: No APDU response.");
+                return PM3_ECARDEXCHANGE;
+            case ISO14A_APDU_CRC:
+                PrintAndLogEx(ERR, "APDU: ISO 14443A CRC error.");
+                return PM3_ECARDEXCHANGE;
+            default:
+                PrintAndLogEx(ERR, "APDU: Small APDU response.");
+                return PM3_ESOFT;
+        }
+    }
+}
+
 int ExchangeAPDU14a(uint8_t *datain, int datainlen, bool activateField, bool leaveSignalON, uint8_t *dataout, int maxdataoutlen, int *dataoutlen) {
     *dataoutlen = 0;
+
+    if (datainlen > 0 && datainlen <= ISO14A_APDU_MAX) {
+        int res = CmdExchangeAPDUDevice(datain, datainlen, activateField, dataout, maxdataoutlen, dataoutlen);
+        if (!leaveSignalON)
+            DropField();
+        return res;
+    }
+
+    // longer than a command, chained here
     bool chaining = false;
     int res;
 
@@ -1194,6 +1551,8 @@ static int CmdHF14ACmdRaw(const char *Cmd) {
     bool bTimeout = false;
     uint32_t timeout = 0;
     bool topazmode = false;
+    bool tearoff = false;
+    uint32_t tearoff_offset = 0;
     char buf[5] = "";
     int i = 0;
     uint8_t data[PM3_CMD_DATA_SIZE];
@@ -1248,6 +1607,14 @@ static int CmdHF14ACmdRaw(const char *Cmd) {
                 case '3':
                     no_rats = true;
                     break;
+                case 'g':
+                    tearoff = true;
+                    sscanf(Cmd + i + 2, "%u", &temp);
+                    tearoff_offset = temp;
+                    i += 3;
+                    while (Cmd[i] != ' ' && Cmd[i] != '\0') { i++; }
+                    i -= 2;
+                    break;
                 default:
                     return usage_hf_14a_raw();
             }
@@ -1324,8 +1691,20 @@ static int CmdHF14ACmdRaw(const char *Cmd) {
     // Max buffer is PM3_CMD_DATA_SIZE
     datalen = (datalen > PM3_CMD_DATA_SIZE) ? PM3_CMD_DATA_SIZE : datalen;
 
+    // the offset goes after the frame, not counted in its length
+    uint16_t sendlen = datalen;
+    if (tearoff && datalen > 0) {
+        if (datalen + sizeof(tearoff_offset) > sizeof(data)) {
+            PrintAndLogEx(WARNING, "no room for the tear-off offset after the data");
+            return PM3_EINVARG;
+        }
+        flags |= ISO14A_TEAROFF;
+        memcpy(data + datalen, &tearoff_offset, sizeof(tearoff_offset));
+        sendlen += sizeof(tearoff_offset);
+    }
+
     clearCommandBuffer();
-    SendCommandOLD(CMD_HF_ISO14443A_READER, flags, (datalen & 0xFFFF) | ((uint32_t)(numbits << 16)), argtimeout, data, datalen & 0xFFFF);
+    SendCommandOLD(CMD_HF_ISO14443A_READER, flags, (datalen & 0xFFFF) | ((uint32_t)(numbits << 16)), argtimeout, data, sendlen);
 
     if (reply) {
         int res = 0;
@@ -1337,6 +1716,155 @@ static int CmdHF14ACmdRaw(const char *Cmd) {
     return 0;
 }
 
+static const char *tearoff_status(uint8_t status) {
+    switch (status) {
+        case ISO14A_TEAROFF_UNCHANGED:
+            return "unchanged";
+        case ISO14A_TEAROFF_CHANGED:
+            return _YELLOW_("changed");
+        case ISO14A_TEAROFF_NO_TAG:
+            return _RED_("no tag");
+        default:
+            return _RED_("lost");
+    }
+}
+
+static int CmdHF14ATearoff(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hf 14a tearoff",
+                  "Tear-off sweep of a raw frame on the device. For every offset the tag is powered up, selected, gets the\n"
+                  "setup frames and the readback, then the frame, cut off <offset> ssp clocks (~1.18us) after its end.\n"
+                  "After a power cycle select, setup and readback run again. Readback answers before and after are compared",
+                  "Usage:\n"
+                  "\thf 14a tearoff -c -d a203eeeeeeee -r 3003 --start 0 --end 400 --step 4  -> NTAG / UL write of page 3\n"
+                  "\thf 14a tearoff -c -s 1b00000000 -d a50201000000 -r 3902 --end 300 -e      -> EV1 / NTAG counter increment after PWD_AUTH\n");
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_strx0("sS", "setup", "<hex>", "setup frame after the select, can be repeated"),
+        arg_str1("dD", "data", "<hex>", "frame to cut off"),
+        arg_str0("rR", "readback", "<hex>", "frame whose answer is compared before and after"),
+        arg_lit0("cC", "crc", "append CRC to the frames"),
+        arg_lit0("4", NULL, "select with RATS"),
+        arg_int0(NULL, "start", "<ticks>", "first offset (default 0)"),
+        arg_int0(NULL, "end", "<ticks>", "last offset (default start)"),
+        arg_int0(NULL, "step", "<ticks>", "offset step (default 1)"),
+        arg_int0("nN", "repeat", "<dec>", "attempts for each offset (default 1)"),
+        arg_lit0("eE", "stop", "stop at the first changed readback"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, false);
+
+    iso14a_tearoff_sweep_req_t req;
+    memset(&req, 0, sizeof(req));
+
+    struct arg_str *setup = arg_get_str(ctx, 1);
+    for (int i = 0; i < setup->count; i++) {
+        int len = 0;
+        if (param_gethex_to_eol(setup->sval[i], 0, req.data + req.setup_len + 1, MIN(ISO14A_TEAROFF_FRAME_MAX, (int)sizeof(req.data) - req.setup_len - 1), &len) || len == 0) {
+            PrintAndLogEx(WARNING, "wrong setup frame " _YELLOW_("%s"), setup->sval[i]);
+            CLIParserFree(ctx);
+            return PM3_EINVARG;
+        }
+        req.data[req.setup_len] = len;
+        req.setup_len += 1 + len;
+    }
+
+    int len = 0;
+    if (param_gethex_to_eol(arg_get_str(ctx, 2)->sval[0], 0, req.data + req.setup_len, MIN(ISO14A_TEAROFF_FRAME_MAX, (int)sizeof(req.data) - req.setup_len), &len) || len == 0) {
+        PrintAndLogEx(WARNING, "wrong frame");
+        CLIParserFree(ctx);
+        return PM3_EINVARG;
+    }
+    req.frame_len = len;
+
+    len = 0;
+    if (arg_get_str(ctx, 3)->count) {
+        uint16_t at = req.setup_len + req.frame_len;
+        if (param_gethex_to_eol(arg_get_str(ctx, 3)->sval[0], 0, req.data + at, MIN(ISO14A_TEAROFF_FRAME_MAX, (int)sizeof(req.data) - at), &len)) {
+            PrintAndLogEx(WARNING, "wrong readback frame");
+            CLIParserFree(ctx);
+            return PM3_EINVARG;
+        }
+    }
+    req.readback_len = len;
+
+    if (arg_get_lit(ctx, 4))
+        req.flags |= ISO14A_TEAROFF_CRC;
+    if (arg_get_lit(ctx, 5))
+        req.flags |= ISO14A_TEAROFF_RATS;
+    req.start = arg_get_int_def(ctx, 6, 0);
+    req.end = arg_get_int_def(ctx, 7, req.start);
+    req.step = arg_get_int_def(ctx, 8, 1);
+    req.repeat = arg_get_int_def(ctx, 9, 1);
+    if (arg_get_lit(ctx, 10))
+        req.flags |= ISO14A_TEAROFF_STOP_CHANGED;
+    CLIParserFree(ctx);
+
+    if (req.end < req.start || req.step == 0 || req.repeat == 0) {
+        PrintAndLogEx(WARNING, "wrong offsets or repeat");
+        return PM3_EINVARG;
+    }
+
+    uint64_t attempts = (uint64_t)req.repeat * ((req.end - req.start) / req.step + 1);
+    PrintAndLogEx(INFO, "tear-off of " _YELLOW_("%s") "at %u .. %u ticks, %" PRIu64 " attempts",
+                  sprint_hex(req.data + req.setup_len, req.frame_len), req.start, req.end, attempts);
+    if (attempts > ISO14A_TEAROFF_LOG_ENTRIES)
+        PrintAndLogEx(WARNING, "the device log stops after " _YELLOW_("%u") " attempts", ISO14A_TEAROFF_LOG_ENTRIES);
+    PrintAndLogEx(INFO, "press pm3-button to abort");
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_ISO14443A_TEAROFF_SWEEP, (uint8_t *)&req, sizeof(req) - sizeof(req.data) + req.setup_len + req.frame_len + req.readback_len);
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(NORMAL, "   ticks   | result    | readback before / after");
+    PrintAndLogEx(NORMAL, "-----------+-----------+-------------------------");
+
+    uint32_t counts[4] = {0};
+
+    PacketResponseNG resp;
+    iso14a_tearoff_frame_t *frame = (iso14a_tearoff_frame_t *)resp.data.asBytes;
+    for (;;) {
+        // about 35ms an attempt
+        if (WaitForResponseTimeout(CMD_HF_ISO14443A_TEAROFF_SWEEP, &resp, 5000) == false) {
+            PrintAndLogEx(WARNING, "command execution time out");
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            return PM3_ETIMEOUT;
+        }
+
+        if (resp.length < sizeof(iso14a_tearoff_frame_t) - sizeof(frame->entries)) {
+            PrintAndLogEx(WARNING, "tear-off sweep failed");
+            return (resp.status == PM3_SUCCESS) ? PM3_ESOFT : resp.status;
+        }
+
+        for (uint8_t i = 0; i < frame->count && i < ISO14A_TEAROFF_FRAME_ENTRIES; i++) {
+            iso14a_tearoff_entry_t *e = &frame->entries[i];
+            PrintAndLogEx(NORMAL, " %9u | %-9s | %s", e->offset, tearoff_status(e->status),
+                          sprint_hex_inrow(e->before, MIN(e->before_len, ISO14A_TEAROFF_ANSWER)));
+            if (e->status == ISO14A_TEAROFF_CHANGED)
+                PrintAndLogEx(NORMAL, "           |           | " _YELLOW_("%s"),
+                              sprint_hex_inrow(e->after, MIN(e->after_len, ISO14A_TEAROFF_ANSWER)));
+            counts[MIN(e->status, ISO14A_TEAROFF_LOST)]++;
+        }
+
+        if (frame->final)
+            break;
+    }
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(SUCCESS, "unchanged " _YELLOW_("%u") ", changed " _YELLOW_("%u") ", no tag " _YELLOW_("%u") ", lost " _YELLOW_("%u"),
+                  counts[ISO14A_TEAROFF_UNCHANGED], counts[ISO14A_TEAROFF_CHANGED], counts[ISO14A_TEAROFF_NO_TAG], counts[ISO14A_TEAROFF_LOST]);
+
+    if (resp.status == PM3_EOPABORTED)
+        PrintAndLogEx(WARNING, "aborted via keyboard / button");
+    else if (resp.status == PM3_EOVFLOW)
+        PrintAndLogEx(WARNING, "device log full, the sweep stopped early");
+    else if (resp.status != PM3_SUCCESS)
+        return resp.status;
+
+    return PM3_SUCCESS;
+}
+
 static int waitCmd(uint8_t iSelect, uint32_t timeout) {
     PacketResponseNG resp;
 
@@ -1368,36 +1896,203 @@ static int CmdHF14AAntiFuzz(const char *Cmd) {
 
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf 14a antifuzz",
-                  "Tries to fuzz the ISO14443a anticollision phase",
+                  "Fuzzing of the ISO14443a anticollision phase, the device answers a reader with one variation after the other.\n"
+                  "Each of the uid lengths with each atqa, sak of the last cascade level and frame delay, with the BCCs inverted too\n"
+                  "by --bcc. A variation answers <activations> REQA / WUPA of the reader, all of them run <rounds> times, 0 until the\n"
+                  "button. The delay is in bit times of 128/fc (9.4us) added to the frame delay of each answer.\n"
+                  "Without any of the uid, atqa, sak, delay or bcc options all uid bits collide, the reader never gets to a select.\n"
+                  "The reader frames and the answers are in the trace",
                   "Usage:\n"
-                  "\thf 14a antifuzz -4\n");
+                  "\thf 14a antifuzz -4                                          -> collide on a 4 byte uid, until the button\n"
+                  "\thf 14a antifuzz -4 -7 -u 04112233445566 --sak 08 --sak 20   -> 4 and 7 byte uid, two saks\n"
+                  "\thf 14a antifuzz -4 -u 01020304 --delay 0 --delay 2 --bcc -n 3 --rounds 1\n");
 
     void *argtable[] = {
         arg_param_begin,
         arg_lit0("4",   NULL,  "4 byte uid"),
         arg_lit0("7",   NULL,  "7 byte uid"),
         arg_lit0(NULL,  "10",  "10 byte uid"),
+        arg_str0("uU",  "uid", "<hex>", "uid, as long as the longest length (default 0102030405060708090A)"),
+        arg_strx0(NULL, "atqa", "<hex>", "atqa as sent, 0400, can be repeated (default by the uid length)"),
+        arg_strx0(NULL, "sak", "<hex>", "sak, can be repeated (default 08)"),
+        arg_intn(NULL,  "delay", "<bits>", 0, ANTIFUZZ_MAX_VALUES, "frame delay added, can be repeated (default 0)"),
+        arg_lit0(NULL,  "bcc", "each variation with the BCCs inverted too"),
+        arg_lit0(NULL,  "collide", "all uid bits collide"),
+        arg_int0("nN",  "activations", "<dec>", "REQA / WUPA for each variation (default 1)"),
+        arg_int0(NULL,  "rounds", "<dec>", "runs of all the variations (default 0, until the button)"),
         arg_param_end
     };
-    CLIExecWithReturn(ctx, Cmd, argtable, false);
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+
+    iso14a_antifuzz_t payload = {
+        .uid = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A },
+    };
 
-    uint8_t arg0 = FLAG_4B_UID_IN_DATA;
+    if (arg_get_lit(ctx, 1))
+        payload.flags |= ANTIFUZZ_UID4;
     if (arg_get_lit(ctx, 2))
-        arg0 = FLAG_7B_UID_IN_DATA;
+        payload.flags |= ANTIFUZZ_UID7;
     if (arg_get_lit(ctx, 3))
-        arg0 = FLAG_10B_UID_IN_DATA;
+        payload.flags |= ANTIFUZZ_UID10;
+    if ((payload.flags & (ANTIFUZZ_UID4 | ANTIFUZZ_UID7 | ANTIFUZZ_UID10)) == 0)
+        payload.flags |= ANTIFUZZ_UID4;
+
+    uint8_t maxlen = (payload.flags & ANTIFUZZ_UID10) ? 10 : (payload.flags & ANTIFUZZ_UID7) ? 7 : 4;
+    int uidlen = 0;
+    uint8_t uid[10] = {0};
+    CLIGetHexWithReturn(ctx, 4, uid, &uidlen);
+    if (uidlen && uidlen != maxlen) {
+        PrintAndLogEx(WARNING, "uid must be %u bytes", maxlen);
+        CLIParserFree(ctx);
+        return PM3_EINVARG;
+    }
+    if (uidlen)
+        memcpy(payload.uid, uid, uidlen);
+
+    struct arg_str *atqa = arg_get_str(ctx, 5);
+    struct arg_str *sak = arg_get_str(ctx, 6);
+    struct arg_int *delay = (struct arg_int *)ctx->argtable[7];
+    if (atqa->count > ANTIFUZZ_MAX_VALUES || sak->count > ANTIFUZZ_MAX_VALUES) {
+        PrintAndLogEx(WARNING, "up to %u atqa and %u sak", ANTIFUZZ_MAX_VALUES, ANTIFUZZ_MAX_VALUES);
+        CLIParserFree(ctx);
+        return PM3_EINVARG;
+    }
+
+    for (int i = 0; i < atqa->count; i++) {
+        int len = 0;
+        if (param_gethex_to_eol(atqa->sval[i], 0, payload.atqa[i], 2, &len) || len != 2) {
+            PrintAndLogEx(WARNING, "wrong atqa " _YELLOW_("%s"), atqa->sval[i]);
+            CLIParserFree(ctx);
+            return PM3_EINVARG;
+        }
+    }
+    payload.atqa_n = atqa->count;
+
+    for (int i = 0; i < sak->count; i++) {
+        int len = 0;
+        if (param_gethex_to_eol(sak->sval[i], 0, &payload.sak[i], 1, &len) || len != 1) {
+            PrintAndLogEx(WARNING, "wrong sak " _YELLOW_("%s"), sak->sval[i]);
+            CLIParserFree(ctx);
+            return PM3_EINVARG;
+        }
+    }
+    payload.sak_n = sak->count;
 
+    for (int i = 0; i < delay->count; i++) {
+        if (delay->ival[i] < 0 || delay->ival[i] > 0xFF) {
+            PrintAndLogEx(WARNING, "wrong delay " _YELLOW_("%d"), delay->ival[i]);
+            CLIParserFree(ctx);
+            return PM3_EINVARG;
+        }
+        payload.delay[i] = delay->ival[i];
+    }
+    payload.delay_n = delay->count;
+
+    if (arg_get_lit(ctx, 8))
+        payload.flags |= ANTIFUZZ_BADBCC;
+    if (arg_get_lit(ctx, 9))
+        payload.flags |= ANTIFUZZ_COLLIDE;
+    payload.activations = MIN(arg_get_int_def(ctx, 10, 1), 0xFF);
+    payload.rounds = arg_get_int_def(ctx, 11, 0);
     CLIParserFree(ctx);
+
+    // the original antifuzz, with the lengths only
+    if (uidlen == 0 && payload.atqa_n == 0 && payload.sak_n == 0 && payload.delay_n == 0 && (payload.flags & ANTIFUZZ_BADBCC) == 0)
+        payload.flags |= ANTIFUZZ_COLLIDE;
+
+    bool collide = (payload.flags & ANTIFUZZ_COLLIDE);
+    uint8_t lens[3], nlen = 0;
+    if (payload.flags & ANTIFUZZ_UID4)
+        lens[nlen++] = 4;
+    if (payload.flags & ANTIFUZZ_UID7)
+        lens[nlen++] = 7;
+    if (payload.flags & ANTIFUZZ_UID10)
+        lens[nlen++] = 10;
+    uint8_t natqa = MAX(payload.atqa_n, 1);
+    uint8_t nsak = MAX(payload.sak_n, 1);
+    uint8_t ndelay = MAX(payload.delay_n, 1);
+    uint8_t nbcc = ((payload.flags & ANTIFUZZ_BADBCC) && collide == false) ? 2 : 1;
+    uint32_t variations = (uint32_t)nlen * natqa * nsak * ndelay * nbcc;
+
+    PrintAndLogEx(SUCCESS, _YELLOW_("%u") " variation(s), %u REQA / WUPA each, %s%s", variations, MAX(payload.activations, 1)
+                  , collide ? "uid bits colliding, " : "", payload.rounds ? "" : "until the button");
+    if (payload.rounds)
+        PrintAndLogEx(SUCCESS, _YELLOW_("%u") " round(s)", payload.rounds);
+
+    // same order as the device
+    for (uint32_t i = 0; i < variations && i < 32; i++) {
+        uint32_t v = i;
+        uint8_t bcc = v % nbcc;
+        v /= nbcc;
+        uint8_t d = payload.delay_n ? payload.delay[v % ndelay] : 0;
+        v /= ndelay;
+        uint8_t s = payload.sak_n ? payload.sak[v % nsak] : 0x08;
+        v /= nsak;
+        uint8_t li = v / natqa;
+        uint8_t a[2] = { (lens[li] == 4) ? 0x04 : (lens[li] == 7) ? 0x44 : 0x84, 0x00 };
+        if (payload.atqa_n)
+            memcpy(a, payload.atqa[v % natqa], 2);
+
+        if (collide)
+            PrintAndLogEx(INFO, "%3u  uid %2u bytes  atqa %02X%02X  delay %u", i, lens[li], a[0], a[1], d);
+        else
+            PrintAndLogEx(INFO, "%3u  uid " _YELLOW_("%s") "  atqa %02X%02X  sak %02X  delay %u%s", i
+                          , sprint_hex_inrow(payload.uid, lens[li]), a[0], a[1], s, d, bcc ? "  " _RED_("bad bcc") : "");
+    }
+    if (variations > 32)
+        PrintAndLogEx(INFO, "...");
+
+    PrintAndLogEx(INFO, "Press pm3-button or " _GREEN_("Enter") " to abort");
+
     clearCommandBuffer();
-    SendCommandMIX(CMD_HF_ISO14443A_ANTIFUZZ, arg0, 0, 0, NULL, 0);
-    return 0;
+    SendCommandNG(CMD_HF_ISO14443A_ANTIFUZZ, (uint8_t *)&payload, sizeof(payload));
+
+    PacketResponseNG resp;
+    iso14a_antifuzz_resp_t *r = (iso14a_antifuzz_resp_t *)resp.data.asBytes;
+    uint64_t stopped = 0;
+
+    for (;;) {
+        if (stopped == 0 && kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            stopped = msclock();
+        }
+
+        if (WaitForResponseTimeout(CMD_HF_ISO14443A_ANTIFUZZ, &resp, 200) == false) {
+            if (stopped && msclock() - stopped > 2500) {
+                PrintAndLogEx(NORMAL, "");
+                PrintAndLogEx(WARNING, "command execution time out");
+                return PM3_ETIMEOUT;
+            }
+            continue;
+        }
+
+        if (resp.length < sizeof(iso14a_antifuzz_resp_t)) {
+            PrintAndLogEx(NORMAL, "");
+            PrintAndLogEx(FAILED, "antifuzz failed ( %d )", resp.status);
+            return resp.status;
+        }
+
+        PrintAndLogEx(INPLACE, " round %u  variation %u / %u  activations " _YELLOW_("%u") "  selects " _YELLOW_("%u")
+                      , r->round, r->variation, r->variations, r->activations, r->selects);
+
+        if (resp.status != PM3_EPARTIAL)
+            break;
+    }
+
+    PrintAndLogEx(NORMAL, "");
+    if (resp.status == PM3_EOPABORTED)
+        PrintAndLogEx(INFO, "Anti-fuzz aborted");
+    else if (resp.status == PM3_SUCCESS)
+        PrintAndLogEx(SUCCESS, "Anti-fuzz done");
+    PrintAndLogEx(HINT, "Try `" _YELLOW_("hf 14a list") "` to see the reader reactions");
+    return (resp.status == PM3_EOPABORTED) ? PM3_SUCCESS : resp.status;
 }
 
 static int CmdHF14AChaining(const char *Cmd) {
 
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf 14a chaining",
-                  "Enable/Disable ISO14443a input chaining. Maximum input length goes from ATS.",
+                  "Enable/Disable ISO14443a input chaining, done on the device. Maximum input length goes from ATS.",
                   "Usage:\n"
                   "\thf 14a chaining disable -> disable chaining\n"
                   "\thf 14a chaining         -> show chaining enable/disable state\n");
@@ -1430,12 +2125,15 @@ static command_t CommandTable[] = {
     {"list",        CmdHF14AList,         AlwaysAvailable,  "List ISO 14443-a history"},
     {"info",        CmdHF14AInfo,         IfPm3Iso14443a,  "Tag information"},
     {"reader",      CmdHF14AReader,       IfPm3Iso14443a,  "Act like an ISO14443-a reader"},
-    {"cuids",       CmdHF14ACUIDs,        IfPm3Iso14443a,  "<n> Collect n>0 ISO14443-a UIDs in one go"},
+    {"cuids",       CmdHF14ACUIDs,        IfPm3Iso14443a,  "<n> [d <ms>] Collect n>0 ISO14443-a UIDs in one go, field off <ms> (def 5) between"},
+    {"inventory",   CmdHF14AInventory,    IfPm3Iso14443a,  "[s] All the ISO14443-a cards in the field, s = no RATS"},
     {"sim",         CmdHF14ASim,          IfPm3Iso14443a,  "<UID> -- Simulate ISO 14443-a tag"},
+    {"sweep",       CmdHF14ASweep,        IfPm3Iso14443a,  "Reader bruteforce with a device side range of uids"},
     {"sniff",       CmdHF14ASniff,        IfPm3Iso14443a,  "sniff ISO 14443-a traffic"},
     {"apdu",        CmdHF14AAPDU,         IfPm3Iso14443a,  "Send ISO 14443-4 APDU to tag"},
     {"chaining",    CmdHF14AChaining,     IfPm3Iso14443a,  "Control ISO 14443-4 input chaining"},
     {"raw",         CmdHF14ACmdRaw,       IfPm3Iso14443a,  "Send raw hex data to tag"},
+    {"tearoff",     CmdHF14ATearoff,      IfPm3Iso14443a,  "Tear-off sweep of a raw frame over ssp clock offsets"},
     {"antifuzz",    CmdHF14AAntiFuzz,     IfPm3Iso14443a,  "Fuzzing the anticollision phase.  Warning! Readers may react strange"},
     {"config",      CmdHf14AConfig,       IfPm3Iso14443a,  "Configure 14a settings (use with caution)"},
     {NULL, NULL, NULL, NULL}
@@ -1979,33 +2677,33 @@ int infoHF14A(bool verbose, bool do_nack_test, bool do_aid_search) {
     }
 
     int isMagic = 0;
-    if (isMifareClassic || isMifareUltralight) {
-        isMagic = detect_classic_magic();
-
-        if (isMifareClassic) {
-
-            int res = detect_classic_static_nonce();
-            if (res == NONCE_STATIC)
+    if (isMifareClassic) {
+        // magic, static nonce, prng and nack bug in one go
+        mf_fingerprint_resp_t fp;
+        uint8_t flags = MF_FINGERPRINT_MAGIC | (do_nack_test ? MF_FINGERPRINT_NACK : 0);
+        if (detect_classic_fingerprint(flags, &fp) == PM3_SUCCESS) {
+            isMagic = fp.magic;
+            print_classic_magic(isMagic);
+
+            if (fp.nonce == NONCE_STATIC)
                 PrintAndLogEx(SUCCESS, "Static nonce: " _YELLOW_("yes"));
 
-            if (res == NONCE_FAIL && verbose)
+            if (fp.nonce == NONCE_FAIL && verbose)
                 PrintAndLogEx(SUCCESS, "Static nonce:  " _RED_("read failed"));
 
-            if (res == NONCE_NORMAL) {
-
-                // not static
-                res = detect_classic_prng();
-                if (res == 1)
+            // not static
+            if (fp.nonce == NONCE_NORMAL) {
+                if (fp.prng)
                     PrintAndLogEx(SUCCESS, "Prng detection: " _GREEN_("weak"));
-                else if (res == 0)
-                    PrintAndLogEx(SUCCESS, "Prng detection: " _YELLOW_("hard"));
                 else
-                    PrintAndLogEx(FAILED, "Prng detection:  " _RED_("fail"));
+                    PrintAndLogEx(SUCCESS, "Prng detection: " _YELLOW_("hard"));
 
-                if (do_nack_test)
-                    detect_classic_nackbug(false);
+                if (fp.nack != MF_FINGERPRINT_NOT_TESTED)
+                    print_classic_nackbug(fp.nack, fp.nacks, fp.auths, false);
             }
         }
+    } else if (isMifareUltralight) {
+        isMagic = detect_classic_magic();
     }
 
     if (isMifareUltralight)
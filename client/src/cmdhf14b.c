@@ -60,11 +60,13 @@ static int usage_hf_14b_raw(void) {
 static int usage_hf_14b_sniff(void) {
     PrintAndLogEx(NORMAL, "It get data from the field and saves it into command buffer.");
     PrintAndLogEx(NORMAL, "Buffer accessible from command 'hf list 14b'");
-    PrintAndLogEx(NORMAL, "Usage: hf 14b sniff [h]");
+    PrintAndLogEx(NORMAL, "Usage: hf 14b sniff [h] [l]");
     PrintAndLogEx(NORMAL, "Options:");
     PrintAndLogEx(NORMAL, "       h    this help");
+    PrintAndLogEx(NORMAL, "       l    live, list the frames while sniffing, Enter stops");
     PrintAndLogEx(NORMAL, "Example:");
     PrintAndLogEx(NORMAL, _YELLOW_("       hf 14b sniff"));
+    PrintAndLogEx(NORMAL, _YELLOW_("       hf 14b sniff l"));
     return 0;
 }
 static int usage_hf_14b_sim(void) {
@@ -190,6 +192,12 @@ static int CmdHF14BSniff(const char *Cmd) {
     char cmdp = tolower(param_getchar(Cmd, 0));
     if (cmdp == 'h') return usage_hf_14b_sniff();
 
+    if (cmdp == 'l') {
+        int res = trace_live_sniff(CMD_HF_ISO14443B_SNIFF_STREAM, ISO_14443B, NULL, 0);
+        PrintAndLogEx(HINT, "Try `" _YELLOW_("hf 14b list") "` to list the session again, or `" _YELLOW_("trace save") "` to keep it");
+        return res;
+    }
+
     clearCommandBuffer();
     SendCommandNG(CMD_HF_ISO14443B_SNIFF, NULL, 0);
     return PM3_SUCCESS;
@@ -739,6 +747,65 @@ static int CmdHF14BReader(const char *Cmd) {
     return readHF14B(verbose);
 }
 
+// Whole SRx memory in one device side pass. data gets (blocks + 1) * 4 bytes, system the block 0xFF
+static int read_srx_memory(uint8_t blocks, uint8_t *data, uint8_t *system) {
+
+    srx_dump_req_t req = { .blocks = blocks };
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_SRI_READ, (uint8_t *)&req, sizeof(req));
+
+    PacketResponseNG resp;
+    srx_dump_frame_t *frame = (srx_dump_frame_t *)resp.data.asBytes;
+    uint16_t received = 0;
+
+    for (;;) {
+        if (WaitForResponseTimeout(CMD_HF_SRI_READ, &resp, 2500) == false) {
+            PrintAndLogEx(WARNING, "command execution time out");
+            return PM3_ETIMEOUT;
+        }
+
+        if (resp.length < sizeof(srx_dump_frame_t) - sizeof(frame->data)) {
+            return (resp.status == PM3_SUCCESS) ? PM3_ESOFT : resp.status;
+        }
+
+        if (frame->first == received && received + frame->count <= blocks + 1) {
+            memcpy(data + (frame->first * 4), frame->data, frame->count * 4);
+            received += frame->count;
+        }
+
+        if (frame->final) {
+            memcpy(system, frame->system, sizeof(frame->system));
+            break;
+        }
+    }
+
+    if (resp.status == PM3_SUCCESS && received != blocks + 1) {
+        return PM3_ESOFT;
+    }
+    if (resp.status != PM3_SUCCESS) {
+        PrintAndLogEx(FAILED, "read failed at block " _YELLOW_("%u"), received);
+    }
+    return resp.status;
+}
+
+static void print_srx_memory(uint8_t blocks, const uint8_t *data, const uint8_t *system) {
+    PrintAndLogEx(NORMAL, "block#   | data         | ascii");
+    PrintAndLogEx(NORMAL, "---------+--------------+----------");
+
+    for (int i = 0; i <= blocks; i++) {
+        PrintAndLogEx(NORMAL,
+                      "%3d/0x%02X | %s | %s",
+                      i,
+                      i,
+                      sprint_hex(data + (i * 4), 4),
+                      sprint_ascii(data + (i * 4), 4)
+                     );
+    }
+    PrintAndLogEx(NORMAL, "---------+--------------+----------");
+    PrintAndLogEx(NORMAL, "255/0xFF | %s | %s", sprint_hex(system, 4), sprint_ascii(system, 4));
+    PrintAndLogEx(NORMAL, "");
+}
+
 /* New command to read the contents of a SRI512|SRIX4K tag
  * SRI* tags are ISO14443-B modulated memory tags,
  * this command just dumps the contents of the memory/
@@ -750,10 +817,14 @@ static int CmdHF14BReadSri(const char *Cmd) {
     uint8_t tagtype = param_get8(Cmd, 0);
     uint8_t blocks = (tagtype == 1) ? 0x7F : 0x0F;
 
-    clearCommandBuffer();
-    SendCommandMIX(CMD_HF_SRI_READ, blocks, 0, 0, NULL, 0);
+    uint8_t data[(0x7F + 1) * 4] = {0};
+    uint8_t system[4] = {0};
+    int res = read_srx_memory(blocks, data, system);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
 
-    // iceman:  should download read data and print in client.
+    print_srx_memory(blocks, data, system);
     return PM3_SUCCESS;
 }
 
@@ -888,85 +959,14 @@ static int CmdHF14BDump(const char *Cmd) {
 
     uint8_t data[cardsize];
     memset(data, 0, sizeof(data));
+    uint8_t system[4] = {0};
 
-    int blocknum = 0;
-    uint8_t *recv = NULL;
-
-    PacketResponseNG resp;
-    clearCommandBuffer();
-    SendCommandMIX(CMD_HF_ISO14443B_COMMAND,  ISO14B_CONNECT | ISO14B_SELECT_SR, 0, 0, NULL, 0);
-
-    //select
-    if (WaitForResponseTimeout(CMD_HF_ISO14443B_COMMAND, &resp, 2000)) {
-        if (resp.oldarg[0]) {
-            PrintAndLogEx(INFO, "failed to select %" PRId64 " | %" PRId64, resp.oldarg[0], resp.oldarg[1]);
-            goto out;
-        }
-    }
-
-    uint8_t req[2] = {ISO14443B_READ_BLK};
-
-    for (int retry = 0; retry < 5; retry++) {
-
-        req[1] = blocknum;
-
-        clearCommandBuffer();
-        SendCommandMIX(CMD_HF_ISO14443B_COMMAND, ISO14B_APPEND_CRC | ISO14B_RAW, 2, 0, req, sizeof(req));
-
-        if (WaitForResponseTimeout(CMD_HF_ISO14443B_COMMAND, &resp, 2000)) {
-
-            uint8_t status = resp.oldarg[0] & 0xFF;
-            if (status > 0) {
-                continue;
-            }
-
-            uint16_t len = (resp.oldarg[1] & 0xFFFF);
-            recv = resp.data.asBytes;
-
-            if (check_crc(CRC_14443_B, recv, len) == false) {
-                PrintAndLogEx(FAILED, "crc fail, retrying one more time");
-                continue;
-            }
-
-            memcpy(data + (blocknum * 4), resp.data.asBytes, 4);
-
-            if (blocknum == 0xFF) {
-                //last read.
-                break;
-            }
-
-            retry = 0;
-            blocknum++;
-            if (blocknum > blocks) {
-                // read config block
-                blocknum = 0xFF;
-            }
-
-            PrintAndLogEx(NORMAL, "." NOLF);
-        }
-    }
-    PrintAndLogEx(NORMAL, "");
-
-    if (blocknum != 0xFF) {
+    if (read_srx_memory(blocks, data, system) != PM3_SUCCESS) {
         PrintAndLogEx(NORMAL, "Dump failed");
         goto out;
     }
 
-    PrintAndLogEx(NORMAL, "block#   | data         | ascii");
-    PrintAndLogEx(NORMAL, "---------+--------------+----------");
-
-    for (int i = 0; i <= blocks; i++) {
-        PrintAndLogEx(NORMAL,
-                      "%3d/0x%02X | %s | %s",
-                      i,
-                      i,
-                      sprint_hex(data + (i * 4), 4),
-                      sprint_ascii(data + (i * 4), 4)
-                     );
-    }
-
-    PrintAndLogEx(NORMAL, "");
-
+    print_srx_memory(blocks, data, system);
 
     size_t datalen = (blocks + 1) * 4;
     saveFileEML(filename, data, datalen, 4);
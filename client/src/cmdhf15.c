@@ -34,6 +34,7 @@
 #include "crc16.h"             // iso15 crc
 #include "cmddata.h"           // getsamples
 #include "fileutils.h"         // savefileEML
+#include "protocols.h"          // ISO_15693
 
 #define FrameSOF                Iso15693FrameSOF
 #define Logic0                  Iso15693Logic0
@@ -50,11 +51,6 @@
 #define AddCrc15(data, len)     compute_crc(CRC_15693, (data), (len), (data)+(len), (data)+(len)+1)
 #endif
 
-typedef struct {
-    uint8_t lock;
-    uint8_t block[4];
-} t15memory_t;
-
 // structure and database for uid -> tagtype lookups
 typedef struct {
     uint64_t uid;
@@ -236,7 +232,16 @@ static int usage_15_info(void) {
     return PM3_SUCCESS;
 }
 static int usage_15_record(void) {
-    PrintAndLogEx(NORMAL, "Record activity without enabling carrier");
+    PrintAndLogEx(NORMAL, "Record activity without enabling carrier\n"
+                  "\n"
+                  "Usage: hf 15 sniff [h] [l]\n"
+                  "Options:\n"
+                  "\th             this help\n"
+                  "\tl             live, list the frames while sniffing, Enter stops\n"
+                  "\n"
+                  "Example:\n"
+                  _YELLOW_("\thf 15 sniff\n")
+                  _YELLOW_("\thf 15 sniff l"));
     return PM3_SUCCESS;
 }
 static int usage_15_reader(void) {
@@ -253,18 +258,38 @@ static int usage_15_reader(void) {
     return PM3_SUCCESS;
 }
 static int usage_15_sim(void) {
-    PrintAndLogEx(NORMAL, "Usage:  hf 15 sim <UID>\n"
+    const char *options[][2] = {
+        {"h", "this help"},
+        {"f <filename>", "load the tag memory from <filename>"},
+        {"b <block size>", "block size, default is 4"}
+    };
+    PrintAndLogEx(NORMAL, "Usage:  hf 15 sim <UID> [f <filename>] [b <block size>]");
+    PrintAndLogOptions(options, 3, 3);
+    PrintAndLogEx(NORMAL, "\n"
+                  "The memory of a dump file goes to the emulator memory, the tag answers reads and writes of its blocks\n"
                   "\n"
                   "Example:\n"
-                  _YELLOW_("\thf 15 sim E016240000000000"));
+                  _YELLOW_("\thf 15 sim E016240000000000") "\n"
+                  _YELLOW_("\thf 15 sim E016240000000000 f hf-15-dump.bin"));
     return PM3_SUCCESS;
 }
 static int usage_15_findafi(void) {
-    PrintAndLogEx(NORMAL, "This command attempts to brute force AFI of an ISO15693 tag\n"
+    PrintAndLogEx(NORMAL, "This command attempts to brute force AFI of all ISO15693 tags in the field\n"
                   "\n"
                   "Usage: hf 15 findafi");
     return PM3_SUCCESS;
 }
+static int usage_15_inventory(void) {
+    PrintAndLogEx(NORMAL, "This command lists all ISO15693 tags in the field with a 16 slot anticollision inventory\n"
+                  "\n"
+                  "Usage: hf 15 inventory [h]\n"
+                  "Options:\n"
+                  "\th             this help\n"
+                  "\n"
+                  "Example:\n"
+                  _YELLOW_("\thf 15 inventory"));
+    return PM3_SUCCESS;
+}
 static int usage_15_writeafi(void) {
     PrintAndLogEx(NORMAL, "Usage:  hf 15 writeafi <uid|u|*> <afi>\n"
                   "\tuid (either): \n"
@@ -286,9 +311,12 @@ static int usage_15_writedsfid(void) {
 static int usage_15_dump(void) {
     PrintAndLogEx(NORMAL, "This command dumps the contents of a ISO-15693 tag and save it to file\n"
                   "\n"
-                  "Usage: hf 15 dump [h] <f filename> \n"
+                  "The device reads 16 blocks per exchange with READ MULTIPLE BLOCKS, tags without it are read block by block\n"
+                  "\n"
+                  "Usage: hf 15 dump [h] [s] <f filename> \n"
                   "Options:\n"
                   "\th             this help\n"
+                  "\ts             read single blocks only\n"
                   "\tf <name>      filename,  if no <name> UID will be used as filename\n"
                   "\n"
                   "Example:\n"
@@ -982,9 +1010,16 @@ static int CmdHF15Info(const char *Cmd) {
 
 // Record Activity without enabling carrier
 //helptext
+static int sniff15_live(void) {
+    int res = trace_live_sniff(CMD_HF_ISO15693_SNIFF_STREAM, ISO_15693, NULL, 0);
+    PrintAndLogEx(HINT, "Try `" _YELLOW_("hf 15 list") "` to list the session again, or `" _YELLOW_("trace save h") "` to keep it");
+    return res;
+}
+
 static int CmdHF15Sniff(const char *Cmd) {
     char cmdp =  tolower(param_getchar(Cmd, 0));
     if (cmdp == 'h') return usage_15_record();
+    if (cmdp == 'l') return sniff15_live();
 
     PacketResponseNG resp;
     clearCommandBuffer();
@@ -1012,27 +1047,133 @@ static int CmdHF15Sim(const char *Cmd) {
     char cmdp = tolower(param_getchar(Cmd, 0));
     if (strlen(Cmd) < 1 || cmdp == 'h') return usage_15_sim();
 
-    struct {
-        uint8_t uid[8];
-    } PACKED payload;
+    iso15_sim_req_t payload = { .block_size = 4 };
 
     if (param_gethex(Cmd, 0, payload.uid, 16)) {
         PrintAndLogEx(WARNING, "UID must include 16 HEX symbols");
         return PM3_EINVARG;
     }
 
+    char filename[FILE_PATH_SIZE] = {0x00};
+    cmdp = 1;
+    while (param_getchar(Cmd, cmdp) != 0x00) {
+        switch (tolower(param_getchar(Cmd, cmdp))) {
+            case 'f':
+                param_getstr(Cmd, cmdp + 1, filename, FILE_PATH_SIZE);
+                cmdp++;
+                break;
+            case 'b':
+                payload.block_size = param_get8ex(Cmd, cmdp + 1, 4, 10);
+                cmdp++;
+                break;
+            case 'h':
+                return usage_15_sim();
+            default:
+                PrintAndLogEx(WARNING, "unknown parameter " _YELLOW_("'%c'"), param_getchar(Cmd, cmdp));
+                return usage_15_sim();
+        }
+        cmdp++;
+    }
+
+    if (payload.block_size == 0 || payload.block_size > ISO15_SIM_MAX_BLOCK_SIZE) {
+        PrintAndLogEx(WARNING, "block size must be 1 - %u", ISO15_SIM_MAX_BLOCK_SIZE);
+        return PM3_EINVARG;
+    }
+
+    if (strlen(filename)) {
+        size_t datalen = 0;
+        uint8_t *data = NULL;
+        if (loadFile_safe(filename, ".bin", (void **)&data, &datalen) != PM3_SUCCESS) {
+            PrintAndLogEx(WARNING, "could not find file " _YELLOW_("%s"), filename);
+            return PM3_EFILE;
+        }
+
+        if ((datalen % payload.block_size) != 0 || datalen / payload.block_size > 256 || datalen > ISO15_SIM_MAX_MEMORY) {
+            PrintAndLogEx(WARNING, "datalen %zu isn't up to 256 blocks of %u bytes", datalen, payload.block_size);
+            free(data);
+            return PM3_ESOFT;
+        }
+
+        int res = SendToDeviceEML(data, datalen, 0);
+        free(data);
+        if (res != PM3_SUCCESS) {
+            PrintAndLogEx(FAILED, "loading emulator memory failed");
+            return res;
+        }
+        payload.block_count = datalen / payload.block_size;
+        PrintAndLogEx(SUCCESS, "loaded " _YELLOW_("%u") " blocks of " _YELLOW_("%u") " bytes to emulator memory", payload.block_count, payload.block_size);
+    }
+
     PrintAndLogEx(SUCCESS, "Starting simulating UID " _YELLOW_("%s"), iso15693_sprintUID(NULL, payload.uid));
 
     PacketResponseNG resp;
     clearCommandBuffer();
     SendCommandNG(CMD_HF_ISO15693_SIMULATE, (uint8_t *)&payload, sizeof(payload));
     WaitForResponse(CMD_HF_ISO15693_SIMULATE, &resp);
-    return PM3_SUCCESS;
+    if (resp.status == PM3_EMALLOC) {
+        PrintAndLogEx(FAILED, "not enough device memory for the coded answers");
+    }
+    return resp.status;
 }
 
 // finds the AFI (Application Family Identifier) of a card, by trying all values
 // (There is no standard way of reading the AFI, although some tags support this)
 // helptext
+static void print_inventory(const iso15_inventory_resp_t *resp, bool show_afi) {
+
+    if (resp->count == 0) {
+        PrintAndLogEx(WARNING, "no tag found");
+        return;
+    }
+
+    PrintAndLogEx(NORMAL, "");
+    for (uint8_t i = 0; i < resp->count && i < ISO15_INVENTORY_MAX_TAGS; i++) {
+        const iso15_inventory_tag_t *tag = &resp->tags[i];
+        if (show_afi == false) {
+            PrintAndLogEx(SUCCESS, " UID: " _GREEN_("%s") "  DSFID: %02X  " _YELLOW_("%s")
+                          , iso15693_sprintUID(NULL, (uint8_t *)tag->uid)
+                          , tag->dsfid
+                          , getTagInfo_15((uint8_t *)tag->uid)
+                         );
+        } else if (tag->afi) {
+            PrintAndLogEx(SUCCESS, " UID: " _GREEN_("%s") "  AFI: " _GREEN_("%02X") " ( %d )"
+                          , iso15693_sprintUID(NULL, (uint8_t *)tag->uid)
+                          , tag->afi
+                          , tag->afi
+                         );
+        } else {
+            PrintAndLogEx(SUCCESS, " UID: " _GREEN_("%s") "  AFI: " _YELLOW_("not set")
+                          , iso15693_sprintUID(NULL, (uint8_t *)tag->uid)
+                         );
+        }
+    }
+
+    if (resp->flags & ISO15_INVENTORY_TRUNCATED) {
+        PrintAndLogEx(WARNING, "more tags in the field than listed, move some away and try again");
+    }
+    PrintAndLogEx(SUCCESS, "found " _YELLOW_("%u") " tag%s", resp->count, (resp->count == 1) ? "" : "s");
+}
+
+static int CmdHF15Inventory(const char *Cmd) {
+    char cmdp = tolower(param_getchar(Cmd, 0));
+    if (cmdp == 'h') return usage_15_inventory();
+
+    PacketResponseNG resp;
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_ISO15693_INVENTORY, NULL, 0);
+    if (WaitForResponseTimeout(CMD_HF_ISO15693_INVENTORY, &resp, 2000) == false) {
+        PrintAndLogEx(WARNING, "command execution time out");
+        return PM3_ETIMEOUT;
+    }
+
+    if (resp.status != PM3_SUCCESS) {
+        return resp.status;
+    }
+
+    print_inventory((iso15_inventory_resp_t *)resp.data.asBytes, false);
+    return PM3_SUCCESS;
+}
+
 static int CmdHF15FindAfi(const char *Cmd) {
     PacketResponseNG resp;
     uint32_t timeout = 0;
@@ -1043,20 +1184,24 @@ static int CmdHF15FindAfi(const char *Cmd) {
     PrintAndLogEx(SUCCESS, "press pm3-button to cancel");
 
     clearCommandBuffer();
-    SendCommandMIX(CMD_HF_ISO15693_FINDAFI, strtol(Cmd, NULL, 0), 0, 0, NULL, 0);
+    SendCommandNG(CMD_HF_ISO15693_FINDAFI, NULL, 0);
 
-    while (!WaitForResponseTimeout(CMD_ACK, &resp, 2000)) {
+    while (!WaitForResponseTimeout(CMD_HF_ISO15693_FINDAFI, &resp, 2000)) {
         timeout++;
 
-        // should be done in about 2 minutes
-        if (timeout > 180) {
+        // one short window per AFI, a few seconds even with many tags
+        if (timeout > 10) {
             PrintAndLogEx(WARNING, "\nNo response from Proxmark3. Aborting...");
             DropField();
             return PM3_ETIMEOUT;
         }
     }
 
-    DropField();
+    if (resp.status == PM3_EOPABORTED) {
+        PrintAndLogEx(WARNING, "aborted, partial result");
+    }
+
+    print_inventory((iso15_inventory_resp_t *)resp.data.asBytes, true);
     return resp.status; // PM3_EOPABORTED or PM3_SUCCESS
 }
 
@@ -1180,6 +1325,7 @@ static int CmdHF15Dump(const char *Cmd) {
     char filename[FILE_PATH_SIZE] = {0};
     char *fptr = filename;
     bool errors = false;
+    bool single = false;
     uint8_t cmdp = 0;
     uint8_t uid[8] = {0, 0, 0, 0, 0, 0, 0, 0};
 
@@ -1187,6 +1333,10 @@ static int CmdHF15Dump(const char *Cmd) {
         switch (tolower(param_getchar(Cmd, cmdp))) {
             case 'h':
                 return usage_15_dump();
+            case 's':
+                single = true;
+                cmdp++;
+                break;
             case 'f':
                 fileNameLen = param_getstr(Cmd, cmdp + 1, filename, FILE_PATH_SIZE);
                 cmdp += 2;
@@ -1211,79 +1361,70 @@ static int CmdHF15Dump(const char *Cmd) {
         fptr += sprintf(fptr, "hf-15-");
         FillFileNameByUID(fptr, uid, "-dump", sizeof(uid));
     }
-    // detect blocksize from card :)
 
     PrintAndLogEx(SUCCESS, "Reading memory from tag UID " _YELLOW_("%s"), iso15693_sprintUID(NULL, uid));
 
-    int blocknum = 0;
-    uint8_t *recv = NULL;
+    iso15_dump_req_t payload = {0};
+    memcpy(payload.uid, uid, sizeof(uid));
+    payload.flags = single ? ISO15_DUMP_SINGLE : 0;
 
-    // memory.
-    t15memory_t mem[256];
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_ISO15693_DUMP, (uint8_t *)&payload, sizeof(payload));
 
-    uint8_t data[256 * 4] = {0};
-    memset(data, 0, sizeof(data));
+    // detected from the card
+    uint8_t blocksize = 4;
+    uint16_t blocknum = 0;
+    uint8_t lock[256] = {0};
+    uint8_t data[256 * 32] = {0};
+    int res = PM3_SUCCESS;
 
     PacketResponseNG resp;
-    uint8_t req[13];
-    req[0] = ISO15_REQ_SUBCARRIER_SINGLE | ISO15_REQ_DATARATE_HIGH | ISO15_REQ_NONINVENTORY | ISO15_REQ_ADDRESS;
-    req[1] = ISO15_CMD_READ;
-
-    // copy uid to read command
-    memcpy(req + 2, uid, sizeof(uid));
-
-    for (int retry = 0; retry < 5; retry++) {
-
-        req[10] = blocknum;
-        AddCrc15(req, 11);
-
-        clearCommandBuffer();
-        SendCommandMIX(CMD_HF_ISO15693_COMMAND, sizeof(req), 1, 1, req, sizeof(req));
-
-        if (WaitForResponseTimeout(CMD_ACK, &resp, 2000)) {
-
-            int len = resp.oldarg[0];
-            if (len < 2) {
-                PrintAndLogEx(FAILED, "iso15693 command failed");
-                continue;
-            }
-
-            recv = resp.data.asBytes;
-
-            if (CheckCrc15(recv, len) == false) {
-                PrintAndLogEx(FAILED, "crc (" _RED_("fail") ")");
-                continue;
-            }
-
-            if ((recv[0] & ISO15_RES_ERROR) == ISO15_RES_ERROR) {
-                PrintAndLogEx(FAILED, "Tag returned Error %i: %s", recv[1], TagErrorStr(recv[1]));
-                break;
-            }
+    for (;;) {
+        if (WaitForResponseTimeout(CMD_HF_ISO15693_DUMP, &resp, 5000) == false) {
+            PrintAndLogEx(WARNING, "command execution time out");
+            DropField();
+            return PM3_ETIMEOUT;
+        }
 
-            mem[blocknum].lock = resp.data.asBytes[0];
-            memcpy(mem[blocknum].block, resp.data.asBytes + 1, 4);
-            memcpy(data + (blocknum * 4), resp.data.asBytes + 1, 4);
+        if (resp.length < 4) {
+            res = resp.status;
+            break;
+        }
 
-            retry = 0;
-            blocknum++;
+        const iso15_dump_frame_t *frame = (const iso15_dump_frame_t *)resp.data.asBytes;
+        if (frame->count && frame->blocksize && (frame->first + frame->count) <= 256 && frame->blocksize <= 32) {
+            blocksize = frame->blocksize;
+            memcpy(lock + frame->first, frame->data, frame->count);
+            memcpy(data + frame->first * blocksize, frame->data + frame->count, frame->count * blocksize);
+            blocknum = frame->first + frame->count;
+        }
 
-            PrintAndLogEx(NORMAL, "." NOLF);
+        if (frame->final) {
+            res = resp.status;
+            break;
         }
     }
 
-    DropField();
+    if (res == PM3_EOPABORTED) {
+        PrintAndLogEx(WARNING, "aborted by user");
+    }
+
+    if (blocknum == 0) {
+        PrintAndLogEx(FAILED, "iso15693 read failed");
+        return PM3_ESOFT;
+    }
 
     PrintAndLogEx(NORMAL, "");
     PrintAndLogEx(NORMAL, "block#   | data         |lck| ascii");
     PrintAndLogEx(NORMAL, "---------+--------------+---+----------");
     for (int i = 0; i < blocknum; i++) {
-        PrintAndLogEx(NORMAL, "%3d/0x%02X | %s | %d | %s", i, i, sprint_hex(mem[i].block, 4), mem[i].lock, sprint_ascii(mem[i].block, 4));
+        PrintAndLogEx(NORMAL, "%3d/0x%02X | %s | %d | %s", i, i, sprint_hex(data + i * blocksize, blocksize), lock[i], sprint_ascii(data + i * blocksize, blocksize));
     }
     PrintAndLogEx(NORMAL, "\n");
 
-    size_t datalen = blocknum * 4;
+    size_t datalen = blocknum * blocksize;
     saveFile(filename, ".bin", data, datalen);
-    saveFileEML(filename, data, datalen, 4);
+    saveFileEML(filename, data, datalen, blocksize);
     saveFileJSON(filename, jsf15, data, datalen, NULL);
     return PM3_SUCCESS;
 }
@@ -1820,6 +1961,7 @@ static command_t CommandTable[] = {
     {"demod",       CmdHF15Demod,       AlwaysAvailable, "Demodulate ISO15693 from tag"},
     {"dump",        CmdHF15Dump,        IfPm3Iso15693,   "Read all memory pages of an ISO15693 tag, save to file"},
     {"info",        CmdHF15Info,        IfPm3Iso15693,   "Tag information"},
+    {"inventory",   CmdHF15Inventory,   IfPm3Iso15693,   "List all ISO15693 tags in the field"},
     {"sniff",       CmdHF15Sniff,       IfPm3Iso15693,   "Sniff ISO15693 traffic"},
     {"raw",         CmdHF15Raw,         IfPm3Iso15693,   "Send raw hex data to tag"},
     {"read",        CmdHF15Read,        IfPm3Iso15693,   "Read a block"},
@@ -1830,7 +1972,7 @@ static command_t CommandTable[] = {
     {"sim",         CmdHF15Sim,         IfPm3Iso15693,   "Fake an ISO15693 tag"},
     {"write",       CmdHF15Write,       IfPm3Iso15693,   "Write a block"},
     {"-----------", CmdHF15Help,        IfPm3Iso15693,  "----------------------- " _CYAN_("afi") " -----------------------"},
-    {"findafi",     CmdHF15FindAfi,     IfPm3Iso15693,   "Brute force AFI of an ISO15693 tag"},
+    {"findafi",     CmdHF15FindAfi,     IfPm3Iso15693,   "Brute force AFI of the ISO15693 tags in the field"},
     {"writeafi",    CmdHF15WriteAfi,    IfPm3Iso15693,   "Writes the AFI on an ISO15693 tag"},
     {"writedsfid",  CmdHF15WriteDsfid,  IfPm3Iso15693,   "Writes the DSFID on an ISO15693 tag"},
     {"-----------", CmdHF15Help,        IfPm3Iso15693,  "----------------------- " _CYAN_("magic") " -----------------------"},
@@ -19,6 +19,7 @@
 #include "crc16.h"
 #include "cmdhf14a.h"
 #include "protocols.h"  // definitions of ISO14B protocol
+#include "cryptorf/sma.h"
 
 #define TIMEOUT 2000
 static int CmdHelp(const char *Cmd);
@@ -107,6 +108,23 @@ static int usage_hf_cryptorf_esave(void) {
     return PM3_SUCCESS;
 }
 
+static int usage_hf_cryptorf_crack(void) {
+    PrintAndLogEx(NORMAL, "Recover the key (Gc) of a SecureMemory tag from one sniffed authentication.\n"
+                  "Runs on all cores and takes a while, press `enter` to cancel.\n"
+                  "Usage:  hf cryptorf crack [h] <Ci> <Q> <Ch> <Ci+1>\n"
+                  "Options:\n"
+                  "    h         this help\n"
+                  "    <Ci>      tag nonce, 8 hex bytes\n"
+                  "    <Q>       reader nonce, 8 hex bytes\n"
+                  "    <Ch>      reader challenge, 8 hex bytes\n"
+                  "    <Ci+1>    tag answer, 8 hex bytes\n"
+                  "\n"
+                  "Examples:\n"
+                  _YELLOW_("        hf cryptorf crack ffffffffffffffff 1234567812345678 88c9d4466a501a87 dec2ee1b1c9276e9")
+                 );
+    return PM3_SUCCESS;
+}
+
 static int switch_off_field_cryptorf(void) {
     clearCommandBuffer();
     SendCommandMIX(CMD_HF_ISO14443B_COMMAND, ISO14B_DISCONNECT, 0, 0, NULL, 0);
@@ -477,8 +495,36 @@ static int CmdHFCryptoRFESave(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+static int CmdHFCryptoRFCrack(const char *Cmd) {
+    char cmdp = tolower(param_getchar(Cmd, 0));
+    if (cmdp == 'h' || cmdp == 0x00) return usage_hf_cryptorf_crack();
+
+    uint8_t auth[4][8];
+    for (int i = 0; i < 4; i++) {
+        if (param_gethex(Cmd, i, auth[i], 16)) {
+            PrintAndLogEx(WARNING, "Ci, Q, Ch and Ci+1 must be 8 hex bytes each");
+            return usage_hf_cryptorf_crack();
+        }
+    }
+
+    PrintAndLogEx(INFO, "  Ci: %s", sprint_hex_inrow(auth[0], 8));
+    PrintAndLogEx(INFO, "   Q: %s", sprint_hex_inrow(auth[1], 8));
+    PrintAndLogEx(INFO, "  Ch: %s", sprint_hex_inrow(auth[2], 8));
+    PrintAndLogEx(INFO, "Ci+1: %s", sprint_hex_inrow(auth[3], 8));
+
+    uint64_t key = 0;
+    int res = sma_recover_key(auth[0], auth[1], auth[2], auth[3], &key);
+    if (res == PM3_SUCCESS) {
+        PrintAndLogEx(SUCCESS, "Found valid key: " _GREEN_("%016" PRIX64), key);
+    } else if (res == PM3_ESOFT) {
+        PrintAndLogEx(FAILED, "key not found, better find another trace");
+    }
+    return res;
+}
+
 static command_t CommandTable[] = {
     {"help",    CmdHelp,              AlwaysAvailable, "This help"},
+    {"crack",   CmdHFCryptoRFCrack,   AlwaysAvailable, "Recover SecureMemory key from an authentication"},
     {"dump",    CmdHFCryptoRFDump,    IfPm3Iso14443b,  "Read all memory pages of an CryptoRF tag, save to file"},
     {"info",    CmdHFCryptoRFInfo,    IfPm3Iso14443b,  "Tag information"},
     {"list",    CmdHFCryptoRFList,    AlwaysAvailable,  "List ISO 14443B history"},
@@ -21,6 +21,8 @@
 #include "comms.h"        // clearCommandBuffer
 #include "ui.h"
 #include "util_posix.h"
+#include "util.h"         // param_get32ex
+#include "fileutils.h"    // FILE_PATH_SIZE
 
 static int CmdHelp(const char *Cmd);
 
@@ -39,6 +41,23 @@ static int usage_epa_collect(void) {
     return PM3_SUCCESS;
 }
 
+static int usage_epa_stream(void) {
+    PrintAndLogEx(NORMAL, "Collects encrypted PACE nonces on the device until n or Enter, the card stays selected.\n"
+                  "The nonces go to a binary file, one after the other.\n"
+                  "\n"
+                  "Usage:  hf epa snonces [h] [m <size>] [n <count>] [f <filename>]\n"
+                  "Options:\n"
+                  "\th           this help\n"
+                  "\tm <size>    nonce size, default 8\n"
+                  "\tn <count>   number of nonces, default 0 = until Enter\n"
+                  "\tf <fn>      binary file, default hf-epa-nonces.bin\n"
+                  "\n"
+                  "Example:\n"
+                  _YELLOW_("\thf epa snonces m 8 n 100000 f nonces.bin")
+                 );
+    return PM3_SUCCESS;
+}
+
 // Perform (part of) the PACE protocol
 static int CmdHFEPACollectPACENonces(const char *Cmd) {
 
@@ -97,6 +116,105 @@ static int CmdHFEPACollectPACENonces(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// Collect PACE nonces in one device side loop
+static int CmdHFEPAStreamPACENonces(const char *Cmd) {
+    epa_nonce_stream_req_t req = {.m = 8, .count = 0};
+    char filename[FILE_PATH_SIZE] = "hf-epa-nonces.bin";
+    bool errors = false;
+    uint8_t cmdp = 0;
+
+    while (param_getchar(Cmd, cmdp) != 0x00 && !errors) {
+        switch (tolower(param_getchar(Cmd, cmdp))) {
+            case 'h':
+                return usage_epa_stream();
+            case 'm':
+                req.m = param_get8ex(Cmd, cmdp + 1, 8, 10);
+                if (req.m == 0)
+                    errors = true;
+                cmdp += 2;
+                break;
+            case 'n':
+                req.count = param_get32ex(Cmd, cmdp + 1, 0, 10);
+                cmdp += 2;
+                break;
+            case 'f':
+                if (param_getstr(Cmd, cmdp + 1, filename, FILE_PATH_SIZE) == 0)
+                    errors = true;
+                cmdp += 2;
+                break;
+            default:
+                PrintAndLogEx(WARNING, "Unknown parameter '%c'", param_getchar(Cmd, cmdp));
+                errors = true;
+                break;
+        }
+    }
+    if (errors) return usage_epa_stream();
+
+    FILE *f = fopen(filename, "wb");
+    if (f == NULL) {
+        PrintAndLogEx(WARNING, "Could not create file " _YELLOW_("%s"), filename);
+        return PM3_EFILE;
+    }
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_EPA_COLLECT_NONCE_STREAM, (uint8_t *)&req, sizeof(req));
+    PrintAndLogEx(INFO, "Collecting %u byte nonces, press " _GREEN_("Enter") " to stop", req.m);
+
+    PacketResponseNG resp;
+    epa_nonce_frame_t *frame = (epa_nonce_frame_t *)resp.data.asBytes;
+    uint64_t t1 = msclock();
+    uint64_t last_frame = t1;
+    uint64_t bytes = 0;
+    bool stopping = false;
+    int status = PM3_SUCCESS;
+
+    for (;;) {
+        if (stopping == false && kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            stopping = true;
+        }
+
+        if (WaitForResponseTimeout(CMD_HF_EPA_COLLECT_NONCE_STREAM, &resp, 100) == false) {
+            // a new select of the card takes a while
+            if (msclock() - last_frame < 5000)
+                continue;
+
+            PrintAndLogEx(WARNING, "command execution time out");
+            if (stopping == false)
+                SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            status = PM3_ETIMEOUT;
+            break;
+        }
+        last_frame = msclock();
+
+        // length byte, then the nonce
+        uint16_t len = MIN(frame->len, EPA_NONCE_FRAME_DATA);
+        for (uint16_t i = 0; i < len; i += 1 + frame->data[i]) {
+            uint8_t n = MIN(frame->data[i], len - i - 1);
+            fwrite(frame->data + i + 1, 1, n, f);
+            bytes += n;
+        }
+
+        uint64_t secs = (last_frame - t1) / 1000;
+        PrintAndLogEx(INPLACE, "%u nonces ( %" PRIu64 " / s )", frame->collected, secs ? frame->collected / secs : frame->collected);
+
+        if (frame->final) {
+            status = resp.status;
+            break;
+        }
+    }
+    fclose(f);
+    PrintAndLogEx(NORMAL, "");
+
+    if (status == PM3_ESOFT)
+        PrintAndLogEx(FAILED, "Error in step %u, Return code: %d", frame->step, frame->func_return);
+    else if (status == PM3_EOPABORTED)
+        PrintAndLogEx(INFO, "aborted");
+
+    PrintAndLogEx(SUCCESS, "saved " _YELLOW_("%" PRIu64) " bytes of nonces to " _YELLOW_("%s") " in %" PRIu64 " s", bytes, filename, (msclock() - t1) / 1000);
+    return (status == PM3_EOPABORTED) ? PM3_SUCCESS : status;
+}
+
 // perform the PACE protocol by replaying APDUs
 static int CmdHFEPAPACEReplay(const char *Cmd) {
     // the 4 APDUs which are replayed + their lengths
@@ -206,6 +324,7 @@ static int CmdHFEPAPACEReplay(const char *Cmd) {
 static command_t CommandTable[] = {
     {"help",    CmdHelp,                   AlwaysAvailable, "This help"},
     {"cnonces", CmdHFEPACollectPACENonces, IfPm3Iso14443,   "<m> <n> <d> Acquire n>0 encrypted PACE nonces of size m>0 with d sec pauses"},
+    {"snonces", CmdHFEPAStreamPACENonces,  IfPm3Iso14443,   "Collect encrypted PACE nonces on the device to a binary file"},
     {"preplay", CmdHFEPAPACEReplay,        IfPm3Iso14443,   "<mse> <get> <map> <pka> <ma> Perform PACE protocol by replaying given APDUs"},
     {NULL, NULL, NULL, NULL}
 };
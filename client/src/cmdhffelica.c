@@ -22,6 +22,7 @@
 #include "util.h"
 #include "ui.h"
 #include "mifare.h"     // felica_card_select_t struct
+#include "protocols.h"
 #include "des.h"
 #define AddCrc(data, len) compute_crc(CRC_FELICA, (data), (len), (data)+(len)+1, (data)+(len))
 
@@ -50,14 +51,16 @@ static int usage_hf_felica_sim(void) {
 static int usage_hf_felica_sniff(void) {
     PrintAndLogEx(NORMAL, "\nInfo: It get data from the field and saves it into command buffer. ");
     PrintAndLogEx(NORMAL, "        Buffer accessible from command 'hf list felica'");
-    PrintAndLogEx(NORMAL, "\nUsage:  hf felica sniff [-h] [-s] [-t]");
+    PrintAndLogEx(NORMAL, "\nUsage:  hf felica sniff [-h] [-s] [-t] [-l]");
     PrintAndLogEx(NORMAL, "       -h    this help");
     PrintAndLogEx(NORMAL, "       -s    samples to skip (decimal) max 9999");
     PrintAndLogEx(NORMAL, "       -t    triggers to skip (decimal) max 9999");
+    PrintAndLogEx(NORMAL, "       -l    live, list the frames while sniffing until Enter, no skipping");
 
     PrintAndLogEx(NORMAL, "Examples:");
     PrintAndLogEx(NORMAL, "          hf felica sniff");
     PrintAndLogEx(NORMAL, "          hf felica sniff -s 10 -t 10");
+    PrintAndLogEx(NORMAL, "          hf felica sniff -l");
     return PM3_SUCCESS;
 }
 
@@ -72,6 +75,18 @@ static int usage_hf_felica_simlite(void) {
     return PM3_SUCCESS;
 }
 
+static int usage_hf_felica_inventory(void) {
+    PrintAndLogEx(NORMAL, "\n List every ISO/18092 FeliCa card in the field, polling with time slots \n");
+    PrintAndLogEx(NORMAL, "Usage: hf felica inventory [h] [<slots>]");
+    PrintAndLogEx(NORMAL, "Options:");
+    PrintAndLogEx(NORMAL, "    h       : This help");
+    PrintAndLogEx(NORMAL, "    slots   : time slots per poll, 1, 2, 4, 8 or 16 (default 16)");
+    PrintAndLogEx(NORMAL, "Examples:");
+    PrintAndLogEx(NORMAL, "          hf felica inventory");
+    PrintAndLogEx(NORMAL, "          hf felica inventory 4");
+    return PM3_SUCCESS;
+}
+
 static int usage_hf_felica_dumplite(void) {
     PrintAndLogEx(NORMAL, "\n Dump ISO/18092 FeliCa Lite tag \n");
     PrintAndLogEx(NORMAL, "press button to abort run, otherwise it will loop for 200sec.");
@@ -1402,6 +1417,7 @@ static int CmdHFFelicaSniff(const char *Cmd) {
     uint8_t paramCount = 0;
     uint64_t samples2skip = 0;
     uint64_t triggers2skip = 0;
+    bool live = false;
     strip_cmds(Cmd);
     int i = 0;
     while (Cmd[i] != '\0') {
@@ -1427,6 +1443,10 @@ static int CmdHFFelicaSniff(const char *Cmd) {
                         return PM3_EINVARG;
                     }
                     break;
+                case 'l':
+                    paramCount++;
+                    live = true;
+                    break;
                 default:
                     PrintAndLogEx(WARNING, "Unknown parameter '%c'", param_getchar(Cmd, paramCount));
                     return usage_hf_felica_sniff();
@@ -1436,6 +1456,12 @@ static int CmdHFFelicaSniff(const char *Cmd) {
         i++;
     }
 
+    if (live) {
+        int res = trace_live_sniff(CMD_HF_FELICA_SNIFF_STREAM, FELICA, NULL, 0);
+        PrintAndLogEx(HINT, "Try `" _YELLOW_("hf felica list") "` to list the session again, or `" _YELLOW_("trace save") "` to keep it");
+        return res;
+    }
+
     if (samples2skip == 0) {
         samples2skip = 10;
         PrintAndLogEx(INFO, "Set default samples2skip: %" PRIu64, samples2skip);
@@ -1800,6 +1826,55 @@ static int CmdHFFelicaCmdRaw(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+static int CmdHFFelicaInventory(const char *Cmd) {
+
+    char ctmp = tolower(param_getchar(Cmd, 0));
+    if (ctmp == 'h') return usage_hf_felica_inventory();
+
+    uint8_t slots = 16;
+    if (ctmp != 0x00) {
+        slots = param_get8(Cmd, 0);
+        if (slots != 1 && slots != 2 && slots != 4 && slots != 8 && slots != 16) {
+            PrintAndLogEx(WARNING, "time slots must be 1, 2, 4, 8 or 16");
+            return PM3_EINVARG;
+        }
+    }
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_FELICA_INVENTORY, &slots, sizeof(slots));
+    PacketResponseNG resp;
+    if (!WaitForResponseTimeout(CMD_HF_FELICA_INVENTORY, &resp, 2500)) {
+        PrintAndLogEx(WARNING, "timeout while waiting for reply.");
+        DropField();
+        return PM3_ETIMEOUT;
+    }
+
+    if (resp.status == PM3_EOPABORTED) {
+        PrintAndLogEx(WARNING, "Button pressed, aborted");
+        return PM3_EOPABORTED;
+    }
+
+    felica_inventory_resp_t *inv = (felica_inventory_resp_t *)resp.data.asBytes;
+    if (resp.status != PM3_SUCCESS || inv->count == 0) {
+        PrintAndLogEx(WARNING, "no FeliCa card found");
+        return PM3_ESOFT;
+    }
+
+    PrintAndLogEx(NORMAL, "");
+    for (uint8_t i = 0; i < inv->count; i++) {
+        PrintAndLogEx(SUCCESS, "IDm " _GREEN_("%s") "  PMm %s",
+                      sprint_hex(inv->cards[i].IDm, sizeof(inv->cards[i].IDm)),
+                      sprint_hex(inv->cards[i].PMm, sizeof(inv->cards[i].PMm))
+                     );
+    }
+    PrintAndLogEx(SUCCESS, "found " _YELLOW_("%u") " card%s", inv->count, (inv->count == 1) ? "" : "s");
+
+    if (inv->flags & FELICA_INVENTORY_TRUNCATED)
+        PrintAndLogEx(WARNING, "more cards in the field than fit in one answer");
+
+    return PM3_SUCCESS;
+}
+
 int readFelicaUid(bool verbose) {
 
     clearCommandBuffer();
@@ -1856,6 +1931,7 @@ static command_t CommandTable[] = {
     {"help",            CmdHelp,                          AlwaysAvailable, "This help"},
     {"list",            CmdHFFelicaList,                  AlwaysAvailable,     "List ISO 18092/FeliCa history"},
     {"reader",          CmdHFFelicaReader,                IfPm3Felica,     "Act like an ISO18092/FeliCa reader"},
+    {"inventory",       CmdHFFelicaInventory,             IfPm3Felica,     "List every FeliCa card in the field"},
     {"sniff",           CmdHFFelicaSniff,                 IfPm3Felica,     "Sniff ISO 18092/FeliCa traffic"},
     {"raw",             CmdHFFelicaCmdRaw,                IfPm3Felica,     "Send raw hex data to tag"},
     {"rdunencrypted",   CmdHFFelicaReadWithoutEncryption, IfPm3Felica,     "read Block Data from authentication-not-required Service."},
@@ -36,6 +36,9 @@
 #include "emv/dump.h"
 #include "ui.h"
 #include "cmdhf14a.h"
+#include "fileutils.h"    // listDirFiles
+#include "util_posix.h"   // msclock
+#include "x509_crt.h"
 
 static int CmdHelp(const char *Cmd);
 
@@ -902,6 +905,83 @@ static int CmdHFFido2GetAssertion(const char *cmd) {
     return PM3_SUCCESS;
 }
 
+static int CmdHFFidoVerify(const char *cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hf fido verify",
+                  "Checks the attestation certificates of saved registrations against the known CAs, for test runs\n"
+                  "with many credentials. Takes every JSON file of a directory with a DER (hf fido reg -j) or an\n"
+                  "AppData.DER (hf fido make -j). The CAs are parsed once.",
+                  "Usage:\n\thf fido verify -d regs -> check every registration in directory regs\n");
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str1("dD",  "dir",      "<dir>", "directory of the JSON files"),
+        arg_lit0("vV",  "verbose",  "list every file and the reasons a check failed"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, cmd, argtable, false);
+
+    char dir[FILE_PATH_SIZE] = {0};
+    int dirlen = 0;
+    CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)dir, sizeof(dir) - 1, &dirlen);
+    bool verbose = arg_get_lit(ctx, 2);
+    CLIParserFree(ctx);
+
+    char **names = NULL;
+    int n = listDirFiles(dir, ".json", &names);
+    if (n < 0) {
+        PrintAndLogEx(WARNING, "can't read directory " _YELLOW_("%s"), dir);
+        return PM3_EFILE;
+    }
+
+    int good = 0, failed = 0, skipped = 0;
+    uint64_t t1 = msclock();
+    for (int i = 0; i < n; i++) {
+        char fn[FILE_PATH_SIZE * 2];
+        snprintf(fn, sizeof(fn), "%s" PATHSEP "%s", dir, names[i]);
+
+        uint8_t der[2048] = {0};
+        size_t derlen = 0;
+        json_error_t error;
+        json_t *root = json_load_file(fn, 0, &error);
+        if (root) {
+            if (JsonLoadBufAsHex(root, "$.DER", der, sizeof(der), &derlen))
+                JsonLoadBufAsHex(root, "$.AppData.DER", der, sizeof(der), &derlen);
+            json_decref(root);
+        }
+
+        if (derlen == 0) {
+            if (verbose)
+                PrintAndLogEx(INFO, "%-40s no certificate", names[i]);
+            skipped++;
+            free(names[i]);
+            continue;
+        }
+
+        uint32_t verifyflags = 0;
+        int res = FIDOVerifyDER(der, derlen, &verifyflags);
+        if (res) {
+            PrintAndLogEx(FAILED, "%-40s " _RED_("fail") " 0x%x - %s", names[i], (res < 0) ? -res : res, ecdsa_get_error(res));
+            if (verbose) {
+                char linfo[300] = {0};
+                mbedtls_x509_crt_verify_info(linfo, sizeof(linfo), "  ", verifyflags);
+                PrintAndLogEx(NORMAL, "%s", linfo);
+            }
+            failed++;
+        } else {
+            if (verbose)
+                PrintAndLogEx(SUCCESS, "%-40s " _GREEN_("ok"), names[i]);
+            good++;
+        }
+        free(names[i]);
+    }
+    free(names);
+    t1 = msclock() - t1;
+
+    PrintAndLogEx(SUCCESS, "certificates ok " _GREEN_("%d") ", failed " _RED_("%d") ", without one %d in %" PRIu64 " ms", good, failed, skipped, t1);
+    return failed ? PM3_ESOFT : PM3_SUCCESS;
+}
+
 static command_t CommandTable[] = {
     {"help",      CmdHelp,                    AlwaysAvailable, "This help."},
     {"info",      CmdHFFidoInfo,              IfPm3Iso14443a,  "Info about FIDO tag."},
@@ -909,6 +989,7 @@ static command_t CommandTable[] = {
     {"auth",      CmdHFFidoAuthenticate,      IfPm3Iso14443a,  "FIDO U2F Authentication Message."},
     {"make",      CmdHFFido2MakeCredential,   IfPm3Iso14443a,  "FIDO2 MakeCredential command."},
     {"assert",    CmdHFFido2GetAssertion,     IfPm3Iso14443a,  "FIDO2 GetAssertion command."},
+    {"verify",    CmdHFFidoVerify,            AlwaysAvailable, "Check the attestation certificates of saved registrations."},
     {NULL,        NULL,                       0, NULL}
 };
 
@@ -14,6 +14,7 @@
 
 #include "cmdhficlass.h"
 #include <ctype.h>
+#include <pthread.h>
 #include "cliparser.h"
 #include "cmdparser.h"    // command_t
 #include "commonutil.h"  // ARRAYLEN
@@ -25,6 +26,7 @@
 #include "loclass/cipher.h"
 #include "loclass/ikeys.h"
 #include "loclass/elite_crack.h"
+#include "loclass/hash1_brute.h"
 #include "fileutils.h"
 #include "protocols.h"
 #include "cardhelper.h"
@@ -315,12 +317,13 @@ static int usage_hf_iclass_loclass(void) {
     PrintAndLogEx(NORMAL, "  <8 byte CSN><8 byte CC><4 byte NR><4 byte MAC>");
     PrintAndLogEx(NORMAL, "  <8 byte CSN><8 byte CC><4 byte NR><4 byte MAC>");
     PrintAndLogEx(NORMAL, "   ... totalling N*24 bytes\n");
-    PrintAndLogEx(NORMAL, "Usage: hf iclass loclass [h] [t [l]] [f <filename>]\n");
+    PrintAndLogEx(NORMAL, "Usage: hf iclass loclass [h] [t [l]] [f <filename>] [c]\n");
     PrintAndLogEx(NORMAL, "Options:");
     PrintAndLogEx(NORMAL, "  h             Show this help");
     PrintAndLogEx(NORMAL, "  t             Perform self-test");
     PrintAndLogEx(NORMAL, "  t l           Perform self-test, including long ones");
     PrintAndLogEx(NORMAL, "  f <filename>  Bruteforce iclass dumpfile");
+    PrintAndLogEx(NORMAL, "  c             Search CSNs suited for the reader attack (slow)");
     PrintAndLogEx(NORMAL, "Examples:");
     PrintAndLogEx(NORMAL, _YELLOW_("\thf iclass loclass f iclass-dump.bin"));
     PrintAndLogEx(NORMAL, _YELLOW_("\thf iclass loclass t"));
@@ -644,25 +647,32 @@ static int CmdHFiClassSniff(const char *Cmd) {
                   "Usage:\n"
                   _YELLOW_("\thf iclass sniff") "\n"
                   _YELLOW_("\thf iclass sniff -j") " -> jam e-purse updates\n"
+                  _YELLOW_("\thf iclass sniff -w") " -> wrap around, keep the latest traffic\n"
                  );
 
     void *argtable[] = {
         arg_param_begin,
         arg_lit0("j",  "jam",    "Jam (prevent) e-purse updates"),
+        arg_lit0("w",  "wrap",   "Wrap around when the trace is full, keeps the latest traffic"),
         arg_param_end
     };
 
     CLIExecWithReturn(ctx, Cmd, argtable, true);
     bool jam_epurse_update = arg_get_lit(ctx, 1);
+    bool ring = arg_get_lit(ctx, 2);
     CLIParserFree(ctx);
 
     const uint8_t update_epurse_sequence[2] = {0x87, 0x02};
 
     struct {
+        bool ring;
         uint8_t jam_search_len;
         uint8_t jam_search_string[2];
     } PACKED payload;
 
+    memset(&payload, 0, sizeof(payload));
+    payload.ring = ring;
+
     if (jam_epurse_update) {
         payload.jam_search_len = sizeof(update_epurse_sequence);
         memcpy(payload.jam_search_string, update_epurse_sequence, sizeof(payload.jam_search_string));
@@ -679,6 +689,171 @@ static int CmdHFiClassSniff(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// loclass for sim 2 / 4 while the reader attack is still running. Every item needs the keytable bytes
+// recovered by the ones before it, so one worker per key takes the items in order as they arrive
+typedef struct {
+    dumpdata items[NUM_CSNS];
+    uint8_t available;
+    bool done;
+    int res;
+    uint16_t keytable[128];
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} iclass_crack_queue_t;
+
+static void *iclass_crack_worker(void *arg) {
+    iclass_crack_queue_t *q = (iclass_crack_queue_t *)arg;
+
+    for (uint8_t i = 0; i < NUM_CSNS; i++) {
+        pthread_mutex_lock(&q->lock);
+        while (i >= q->available && q->done == false)
+            pthread_cond_wait(&q->cond, &q->lock);
+
+        bool have_item = (i < q->available);
+        pthread_mutex_unlock(&q->lock);
+
+        if (have_item == false) {
+            q->res = PM3_EOPABORTED;
+            break;
+        }
+
+        q->res = bruteforceItem(q->items[i], q->keytable);
+        if (q->res != PM3_SUCCESS)
+            break;
+    }
+    return NULL;
+}
+
+static void iclass_crack_push(iclass_crack_queue_t *q, uint8_t index, uint8_t *cc_nr_mac) {
+    pthread_mutex_lock(&q->lock);
+    // the device fills the csns in order, anything else is a lost frame
+    if (index == q->available && index < NUM_CSNS) {
+        memcpy(q->items[index].cc_nr, cc_nr_mac, sizeof(q->items[index].cc_nr));
+        memcpy(q->items[index].mac, cc_nr_mac + sizeof(q->items[index].cc_nr), sizeof(q->items[index].mac));
+        q->available++;
+        pthread_cond_signal(&q->cond);
+    }
+    pthread_mutex_unlock(&q->lock);
+}
+
+static void iclass_crack_done(iclass_crack_queue_t *q) {
+    pthread_mutex_lock(&q->lock);
+    q->done = true;
+    pthread_cond_signal(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+}
+
+static int iclass_sim_reader_attack(uint8_t sim_type, uint8_t *csns) {
+
+    bool keyroll = (sim_type == ICLASS_SIM_MODE_READER_ATTACK_KEYROLL);
+    uint8_t nkeys = (keyroll) ? 2 : 1;
+
+    iclass_crack_queue_t *queues = calloc(nkeys, sizeof(iclass_crack_queue_t));
+    if (queues == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+
+    pthread_t thread_id[2];
+    for (uint8_t k = 0; k < nkeys; k++) {
+        // need zeroes for the EPURSE - field (offical), CSN is the same as was sent in
+        for (uint8_t i = 0; i < NUM_CSNS; i++)
+            memcpy(queues[k].items[i].csn, csns + i * 8, 8);
+
+        pthread_mutex_init(&queues[k].lock, NULL);
+        pthread_cond_init(&queues[k].cond, NULL);
+        pthread_create(&thread_id[k], NULL, iclass_crack_worker, &queues[k]);
+    }
+
+    PrintAndLogEx(INFO, "press " _YELLOW_("`enter`") " to cancel");
+    uint64_t t1 = msclock();
+
+    clearCommandBuffer();
+    SendCommandMIX(CMD_HF_ICLASS_SIMULATE_STREAM, sim_type, NUM_CSNS, 1, csns, 8 * NUM_CSNS);
+
+    int res = PM3_SUCCESS;
+    uint8_t num_mac = 0;
+    uint8_t tries = 0;
+    for (;;) {
+        PacketResponseNG resp;
+        if (WaitForResponseTimeout(CMD_HF_ICLASS_SIMULATE_STREAM, &resp, 2000) == false) {
+            tries++;
+            if (res == PM3_SUCCESS && kbd_enter_pressed()) {
+                PrintAndLogEx(WARNING, "\naborted via keyboard.");
+                SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+                res = PM3_EOPABORTED;
+                // give the device a moment for its final frame
+                tries = 19;
+            }
+            if (tries > 20) {
+                if (res == PM3_SUCCESS) {
+                    PrintAndLogEx(WARNING, "\ntimeout while waiting for reply.");
+                    SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+                    res = PM3_ETIMEOUT;
+                }
+                break;
+            }
+            continue;
+        }
+
+        iclass_sim_stream_frame_t *frame = (iclass_sim_stream_frame_t *)resp.data.asBytes;
+        if (frame->final) {
+            num_mac = frame->count;
+            break;
+        }
+
+        tries = 0;
+        if (frame->keyroll < nkeys) {
+            PrintAndLogEx(SUCCESS, "CSN %s MAC %s" NOLF, sprint_hex(frame->csn, 8), sprint_hex(frame->cc_nr_mac + 8, 8));
+            PrintAndLogEx(NORMAL, "%s", (keyroll) ? ((frame->keyroll) ? " ( key B )" : " ( key A )") : "");
+            iclass_crack_push(&queues[frame->keyroll], frame->index, frame->cc_nr_mac);
+        }
+    }
+
+    for (uint8_t k = 0; k < nkeys; k++) {
+        iclass_crack_done(&queues[k]);
+        pthread_join(thread_id[k], NULL);
+        pthread_cond_destroy(&queues[k].cond);
+        pthread_mutex_destroy(&queues[k].lock);
+    }
+
+    if (res == PM3_SUCCESS || num_mac) {
+        bool success = ((NUM_CSNS * nkeys) == num_mac);
+        PrintAndLogEx((success) ? SUCCESS : WARNING, "[%c] %d out of %d MAC obtained [%s]", (success) ? '+' : '!', num_mac, NUM_CSNS * nkeys, (success) ? "OK" : "FAIL");
+    }
+
+    if (num_mac) {
+        /** Now, save to dumpfile **/
+        if (keyroll) {
+            saveFile("iclass_mac_attack_keyroll_A", ".bin", queues[0].items, sizeof(queues[0].items));
+            saveFile("iclass_mac_attack_keyroll_B", ".bin", queues[1].items, sizeof(queues[1].items));
+        } else {
+            saveFile("iclass_mac_attack", ".bin", queues[0].items, sizeof(queues[0].items));
+        }
+    }
+
+    bool recovered = false;
+    for (uint8_t k = 0; k < nkeys; k++) {
+        if (queues[k].res != PM3_SUCCESS || queues[k].available != NUM_CSNS)
+            continue;
+
+        if (keyroll)
+            PrintAndLogEx(INFO, "Keyroll key %c", 'A' + k);
+        if (calculateMasterKeyFromTable(queues[k].keytable, NULL) == PM3_SUCCESS)
+            recovered = true;
+    }
+
+    if (recovered) {
+        t1 = msclock() - t1;
+        PrintAndLogEx(SUCCESS, "time: %" PRIu64 " seconds", t1 / 1000);
+    } else if (num_mac) {
+        PrintAndLogEx(HINT, "Try `" _YELLOW_("hf iclass loclass h") "` to recover elite key");
+    }
+
+    free(queues);
+    return res;
+}
+
 static int CmdHFiClassSim(const char *Cmd) {
 
     char cmdp = tolower(param_getchar(Cmd, 0));
@@ -726,125 +901,17 @@ static int CmdHFiClassSim(const char *Cmd) {
      * <4 byte NR><4 byte MAC>
      * CC are all zeroes, CSN is the same as was sent in
      **/
-    uint8_t tries = 0;
 
     switch (sim_type) {
 
         case ICLASS_SIM_MODE_READER_ATTACK: {
             PrintAndLogEx(INFO, "Starting iCLASS sim 2 attack (elite mode)");
-            PrintAndLogEx(INFO, "press " _YELLOW_("`enter`") " to cancel");
-            PacketResponseNG resp;
-            clearCommandBuffer();
-            SendCommandMIX(CMD_HF_ICLASS_SIMULATE, sim_type, NUM_CSNS, 1, csns, 8 * NUM_CSNS);
-
-            while (WaitForResponseTimeout(CMD_ACK, &resp, 2000) == false) {
-                tries++;
-                if (kbd_enter_pressed()) {
-                    PrintAndLogEx(WARNING, "\naborted via keyboard.");
-                    return PM3_EOPABORTED;
-                }
-                if (tries > 20) {
-                    PrintAndLogEx(WARNING, "\ntimeout while waiting for reply.");
-                    return PM3_ETIMEOUT;
-                }
-            }
-            uint8_t num_mac  = resp.oldarg[1];
-            bool success = (NUM_CSNS == num_mac);
-            PrintAndLogEx((success) ? SUCCESS : WARNING, "[%c] %d out of %d MAC obtained [%s]", (success) ? '+' : '!', num_mac, NUM_CSNS, (success) ? "OK" : "FAIL");
-
-            if (num_mac == 0)
-                break;
-
-            size_t datalen = NUM_CSNS * 24;
-            uint8_t *dump = calloc(datalen, sizeof(uint8_t));
-            if (!dump) {
-                PrintAndLogEx(WARNING, "Failed to allocate memory");
-                return PM3_EMALLOC;
-            }
-
-            memset(dump, 0, datalen);//<-- Need zeroes for the EPURSE - field (offical)
-
-            uint8_t i = 0;
-            for (i = 0 ; i < NUM_CSNS ; i++) {
-                //copy CSN
-                memcpy(dump + i * 24, csns + i * 8, 8);
-                //copy epurse
-                memcpy(dump + i * 24 + 8, resp.data.asBytes + i * 16, 8);
-                // NR_MAC (eight bytes from the response)  ( 8b csn + 8b epurse == 16)
-                memcpy(dump + i * 24 + 16, resp.data.asBytes + i * 16 + 8, 8);
-            }
-            /** Now, save to dumpfile **/
-            saveFile("iclass_mac_attack", ".bin", dump, datalen);
-            free(dump);
-
-            PrintAndLogEx(HINT, "Try `" _YELLOW_("hf iclass loclass h") "` to recover elite key");
-            break;
+            return iclass_sim_reader_attack(sim_type, csns);
         }
         case ICLASS_SIM_MODE_READER_ATTACK_KEYROLL: {
             // reader in key roll mode,  when it has two keys it alternates when trying to verify.
             PrintAndLogEx(INFO, "Starting iCLASS sim 4 attack (elite mode, reader in key roll mode)");
-            PrintAndLogEx(INFO, "press Enter to cancel");
-            PacketResponseNG resp;
-            clearCommandBuffer();
-            SendCommandMIX(CMD_HF_ICLASS_SIMULATE, sim_type, NUM_CSNS, 1, csns, 8 * NUM_CSNS);
-
-            while (WaitForResponseTimeout(CMD_ACK, &resp, 2000) == false) {
-                tries++;
-                if (kbd_enter_pressed()) {
-                    PrintAndLogEx(WARNING, "\naborted via keyboard.");
-                    return PM3_EOPABORTED;
-                }
-                if (tries > 20) {
-                    PrintAndLogEx(WARNING, "\ntimeout while waiting for reply.");
-                    return PM3_ETIMEOUT;
-                }
-            }
-            uint8_t num_mac = resp.oldarg[1];
-            bool success = ((NUM_CSNS * 2) == num_mac);
-            PrintAndLogEx((success) ? SUCCESS : WARNING, "[%c] %d out of %d MAC obtained [%s]", (success) ? '+' : '!', num_mac, NUM_CSNS * 2, (success) ? "OK" : "FAIL");
-
-            if (num_mac == 0)
-                break;
-
-            size_t datalen = NUM_CSNS * 24;
-            uint8_t *dump = calloc(datalen, sizeof(uint8_t));
-            if (!dump) {
-                PrintAndLogEx(WARNING, "Failed to allocate memory");
-                return PM3_EMALLOC;
-            }
-
-#define MAC_ITEM_SIZE 24
-
-            //KEYROLL 1
-            //Need zeroes for the CC-field
-            memset(dump, 0, datalen);
-            for (uint8_t i = 0; i < NUM_CSNS ; i++) {
-                // copy CSN
-                memcpy(dump + i * MAC_ITEM_SIZE, csns + i * 8, 8); //CSN
-                // copy EPURSE
-                memcpy(dump + i * MAC_ITEM_SIZE + 8, resp.data.asBytes + i * 16, 8);
-                // copy NR_MAC (eight bytes from the response)  ( 8b csn + 8b epurse == 16)
-                memcpy(dump + i * MAC_ITEM_SIZE + 16, resp.data.asBytes + i * 16 + 8, 8);
-            }
-            saveFile("iclass_mac_attack_keyroll_A", ".bin", dump, datalen);
-
-            //KEYROLL 2
-            memset(dump, 0, datalen);
-            for (uint8_t i = 0; i < NUM_CSNS; i++) {
-                uint8_t resp_index = (i + NUM_CSNS) * 16;
-                // Copy CSN
-                memcpy(dump + i * MAC_ITEM_SIZE, csns + i * 8, 8);
-                // copy EPURSE
-                memcpy(dump + i * MAC_ITEM_SIZE + 8, resp.data.asBytes + resp_index, 8);
-                // copy NR_MAC (eight bytes from the response)  ( 8b csn + 8 epurse == 16)
-                memcpy(dump + i * MAC_ITEM_SIZE + 16, resp.data.asBytes + resp_index + 8, 8);
-                resp_index++;
-            }
-            saveFile("iclass_mac_attack_keyroll_B", ".bin", dump, datalen);
-            free(dump);
-
-            PrintAndLogEx(HINT, "Try `" _YELLOW_("hf iclass loclass h") "` to recover elite key");
-            break;
+            return iclass_sim_reader_attack(sim_type, csns);
         }
         case ICLASS_SIM_MODE_CSN:
         case ICLASS_SIM_MODE_CSN_DEFAULT:
@@ -1121,27 +1188,15 @@ static int CmdHFiClassELoad(const char *Cmd) {
     print_picopass_header((picopass_hdr *) dump);
     print_picopass_info((picopass_hdr *) dump);
 
-    // fast push mode
-    conn.block_after_ACK = true;
-
     //Send to device
-    uint32_t bytes_sent = 0;
-    uint32_t bytes_remaining  = bytes_read;
-
-    while (bytes_remaining > 0) {
-        uint32_t bytes_in_packet = MIN(PM3_CMD_DATA_SIZE, bytes_remaining);
-        if (bytes_in_packet == bytes_remaining) {
-            // Disable fast mode on last packet
-            conn.block_after_ACK = false;
-        }
-        clearCommandBuffer();
-        SendCommandOLD(CMD_HF_ICLASS_EML_MEMSET, bytes_sent, bytes_in_packet, 0, dump + bytes_sent, bytes_in_packet);
-        bytes_remaining -= bytes_in_packet;
-        bytes_sent += bytes_in_packet;
-    }
+    res = SendToDeviceEML(dump, bytes_read, 0);
     free(dump);
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(FAILED, "failed to send data to device emulator memory (%d)", res);
+        return res;
+    }
 
-    PrintAndLogEx(SUCCESS, "sent %d bytes of data to device emulator memory", bytes_sent);
+    PrintAndLogEx(SUCCESS, "sent %zu bytes of data to device emulator memory", bytes_read);
     return PM3_SUCCESS;
 }
 
@@ -2587,6 +2642,8 @@ static int CmdHFiClass_loclass(const char *Cmd) {
             PrintAndLogEx(ERR, "There were errors!!!");
 
         return PM3_ESOFT;
+    } else if (opt == 'c') {
+        return brute_hash1();
     }
 
     return usage_hf_iclass_loclass();
@@ -3038,6 +3095,91 @@ static void add_key(uint8_t *key) {
     }
 }
 
+// MACs for the key check are generated chunk by chunk on all cores, ahead of the chunk the device is testing
+typedef struct {
+    uint8_t *CSN;
+    uint8_t *CCNR;
+    bool use_raw;
+    bool use_elite;
+    uint8_t *keys;
+    uint32_t keycnt;
+    iclass_premac_t *list;
+    uint32_t chunksize;
+    uint32_t chunkcnt;
+    uint32_t next;      // next chunk to generate
+    bool *ready;
+    bool stop;
+    int num_threads;
+    pthread_t thread_id[64];
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} iclass_macgen_t;
+
+static void *iclass_macgen_thread(void *arg) {
+    iclass_macgen_t *gen = (iclass_macgen_t *)arg;
+
+    for (;;) {
+        pthread_mutex_lock(&gen->lock);
+        if (gen->stop || gen->next >= gen->chunkcnt) {
+            pthread_mutex_unlock(&gen->lock);
+            break;
+        }
+        uint32_t chunk = gen->next++;
+        pthread_mutex_unlock(&gen->lock);
+
+        uint32_t offset = chunk * gen->chunksize;
+        uint32_t n = MIN(gen->chunksize, gen->keycnt - offset);
+        GenerateMacFrom(gen->CSN, gen->CCNR, gen->use_raw, gen->use_elite, gen->keys + offset * 8, n, gen->list + offset);
+
+        pthread_mutex_lock(&gen->lock);
+        gen->ready[chunk] = true;
+        pthread_cond_broadcast(&gen->cond);
+        pthread_mutex_unlock(&gen->lock);
+    }
+    return NULL;
+}
+
+static int iclass_macgen_start(iclass_macgen_t *gen) {
+    gen->chunkcnt = (gen->keycnt + gen->chunksize - 1) / gen->chunksize;
+    gen->ready = calloc(gen->chunkcnt, sizeof(bool));
+    if (gen->ready == NULL)
+        return PM3_EMALLOC;
+
+    pthread_mutex_init(&gen->lock, NULL);
+    pthread_cond_init(&gen->cond, NULL);
+
+    int n = MIN(MIN(num_CPUs(), (int)ARRAYLEN(gen->thread_id)), (int)gen->chunkcnt);
+    for (gen->num_threads = 0; gen->num_threads < n; gen->num_threads++) {
+        if (pthread_create(&gen->thread_id[gen->num_threads], NULL, iclass_macgen_thread, gen) != 0)
+            break;
+    }
+    // no thread at all, generate everything here
+    if (gen->num_threads == 0)
+        iclass_macgen_thread(gen);
+
+    return PM3_SUCCESS;
+}
+
+static void iclass_macgen_wait(iclass_macgen_t *gen, uint32_t chunk) {
+    pthread_mutex_lock(&gen->lock);
+    while (gen->ready[chunk] == false)
+        pthread_cond_wait(&gen->cond, &gen->lock);
+    pthread_mutex_unlock(&gen->lock);
+}
+
+static void iclass_macgen_stop(iclass_macgen_t *gen) {
+    pthread_mutex_lock(&gen->lock);
+    gen->stop = true;
+    pthread_mutex_unlock(&gen->lock);
+
+    for (int i = 0; i < gen->num_threads; i++)
+        pthread_join(gen->thread_id[i], NULL);
+
+    pthread_cond_destroy(&gen->cond);
+    pthread_mutex_destroy(&gen->lock);
+    free(gen->ready);
+}
+
 static int CmdHFiClassCheckKeys(const char *Cmd) {
 
     // empty string
@@ -3133,14 +3275,25 @@ static int CmdHFiClassCheckKeys(const char *Cmd) {
     if (use_raw)
         PrintAndLogEx(NORMAL, "using " _YELLOW_("raw mode"));
 
-    GenerateMacFrom(CSN, CCNR, use_raw, use_elite, keyBlock, keycount, pre);
-
     PrintAndLogEx(SUCCESS, "Searching for " _YELLOW_("%s") " key...", (use_credit_key) ? "CREDIT" : "DEBIT");
 
     // max 42 keys inside USB_COMMAND.  512/4 = 103 mac
     uint32_t chunksize = keycount > (PM3_CMD_DATA_SIZE / 4) ? (PM3_CMD_DATA_SIZE / 4) : keycount;
     bool lastChunk = false;
 
+    // the MACs of the next chunks are generated while the device checks the current one
+    iclass_macgen_t gen = {
+        .CSN = CSN, .CCNR = CCNR, .use_raw = use_raw, .use_elite = use_elite,
+        .keys = keyBlock, .keycnt = keycount, .list = pre, .chunksize = chunksize
+    };
+    res = iclass_macgen_start(&gen);
+    if (res != PM3_SUCCESS) {
+        free(pre);
+        free(keyBlock);
+        DropField();
+        return res;
+    }
+
     // fast push mode
     conn.block_after_ACK = true;
 
@@ -3172,6 +3325,10 @@ static int CmdHFiClassCheckKeys(const char *Cmd) {
         //   - 1 indicates credit key
         //   - 0 indicates debit key (default)
         flags |= (use_credit_key << 16);
+        // bit 24, continue with the card the previous chunk left selected
+        flags |= ((key_offset > 0) << 24);
+
+        iclass_macgen_wait(&gen, key_offset / chunksize);
 
         clearCommandBuffer();
         SendCommandOLD(CMD_HF_ICLASS_CHKKEYS, flags, keys, 0, pre + key_offset, 4 * keys);
@@ -3223,6 +3380,7 @@ static int CmdHFiClassCheckKeys(const char *Cmd) {
     } // end chunks of keys
 
 out:
+    iclass_macgen_stop(&gen);
     t1 = msclock() - t1;
 
     PrintAndLogEx(NORMAL, "");
@@ -3242,6 +3400,124 @@ out:
 
 // this method tries to identify in which configuration mode a iCLASS / iCLASS SE reader is in.
 // Standard or Elite / HighSecurity mode.  It uses a default key dictionary list in order to work.
+// lookup of a sniffed MAC. The mapped dictionary is cut in ranges of lines, searched on all cores
+#define ICLASS_LOOKUP_CHUNK                 0x10000
+#define ICLASS_LOOKUP_MAX_THREADS           64
+#define ICLASS_LOOKUP_PROGRESS_INTERVAL     2 // seconds
+
+typedef struct {
+    const char *dic;
+    size_t diclen;
+    uint8_t *CSN;
+    uint8_t *CCNR;
+    bool use_raw;
+    bool use_elite;
+    uint8_t mac[4];
+    size_t next;        // start of the next range
+    size_t done;        // bytes searched
+    uint32_t keycnt;
+    int finished;       // threads
+    bool abort;
+    size_t found_at;    // line of the key in the file, the first one wins
+    uint8_t key[8];
+    pthread_mutex_t lock;
+} iclass_lookup_t;
+
+// same rules as loadFileDICTIONARY, a line with 16 hex digits up front, # is a comment
+static bool iclass_lookup_parse(const char *line, const char *end, uint8_t *key) {
+    if (end - line < 16 || line[0] == '#')
+        return false;
+    for (int i = 0; i < 16; i++) {
+        char c = tolower(line[i]);
+        uint8_t nib;
+        if (c >= '0' && c <= '9')
+            nib = c - '0';
+        else if (c >= 'a' && c <= 'f')
+            nib = c - 'a' + 10;
+        else
+            return false;
+        key[i >> 1] = (i & 1) ? (key[i >> 1] | nib) : (nib << 4);
+    }
+    return true;
+}
+
+static void iclass_lookup_batch(iclass_lookup_t *lookup, uint8_t *keys, const size_t *at, uint32_t n) {
+    uint8_t div_keys[MAC_BATCH_SIZE * 8];
+    uint8_t macs[MAC_BATCH_SIZE * 4];
+
+    for (uint32_t j = 0; j < n; j++) {
+        if (lookup->use_raw)
+            memcpy(div_keys + j * 8, keys + j * 8, 8);
+        else
+            HFiClassCalcDivKey(lookup->CSN, keys + j * 8, div_keys + j * 8, lookup->use_elite);
+    }
+    doMAC_batch(lookup->CCNR, 0, div_keys, macs, n);
+
+    for (uint32_t j = 0; j < n; j++) {
+        if (memcmp(macs + j * 4, lookup->mac, 4))
+            continue;
+        pthread_mutex_lock(&lookup->lock);
+        if (at[j] < lookup->found_at) {
+            __atomic_store_n(&lookup->found_at, at[j], __ATOMIC_SEQ_CST);
+            memcpy(lookup->key, keys + j * 8, 8);
+        }
+        pthread_mutex_unlock(&lookup->lock);
+    }
+}
+
+static void *iclass_lookup_thread(void *arg) {
+    iclass_lookup_t *lookup = (iclass_lookup_t *)arg;
+    const char *dic = lookup->dic;
+    size_t diclen = lookup->diclen;
+
+    uint8_t keys[MAC_BATCH_SIZE * 8];
+    size_t at[MAC_BATCH_SIZE];
+
+    for (;;) {
+        size_t start = __atomic_fetch_add(&lookup->next, ICLASS_LOOKUP_CHUNK, __ATOMIC_SEQ_CST);
+        if (start >= diclen || __atomic_load_n(&lookup->abort, __ATOMIC_SEQ_CST))
+            break;
+        // past the line of a key already found, nothing can beat it
+        if (start > __atomic_load_n(&lookup->found_at, __ATOMIC_SEQ_CST))
+            break;
+
+        size_t stop = MIN(start + ICLASS_LOOKUP_CHUNK, diclen);
+
+        // the lines starting in the range, the one cut at the start belongs to the previous
+        size_t pos = start;
+        if (pos > 0 && dic[pos - 1] != '\n') {
+            const char *nl = memchr(dic + pos, '\n', diclen - pos);
+            pos = (nl) ? (size_t)(nl - dic) + 1 : diclen;
+        }
+
+        uint32_t n = 0, cnt = 0;
+        while (pos < stop) {
+            const char *line = dic + pos;
+            const char *nl = memchr(line, '\n', diclen - pos);
+            const char *end = (nl) ? nl : dic + diclen;
+
+            if (iclass_lookup_parse(line, end, keys + n * 8)) {
+                at[n++] = pos;
+                if (n == MAC_BATCH_SIZE) {
+                    iclass_lookup_batch(lookup, keys, at, n);
+                    cnt += n;
+                    n = 0;
+                }
+            }
+            pos = (size_t)(end - dic) + 1;
+        }
+        if (n) {
+            iclass_lookup_batch(lookup, keys, at, n);
+            cnt += n;
+        }
+
+        __atomic_add_fetch(&lookup->keycnt, cnt, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&lookup->done, stop - start, __ATOMIC_SEQ_CST);
+    }
+    __atomic_add_fetch(&lookup->finished, 1, __ATOMIC_SEQ_CST);
+    return NULL;
+}
+
 static int CmdHFiClassLookUp(const char *Cmd) {
 
     uint8_t CSN[8];
@@ -3258,7 +3534,6 @@ static int CmdHFiClassLookUp(const char *Cmd) {
 
     char filename[FILE_PATH_SIZE] = {0};
 
-    iclass_prekey_t *prekey = NULL;
     int len = 0;
     // if empty string
     if (strlen(Cmd) == 0) errors = true;
@@ -3329,94 +3604,125 @@ static int CmdHFiClassLookUp(const char *Cmd) {
     PrintAndLogEx(SUCCESS, "   CCNR: " _GREEN_("%s"), sprint_hex(CCNR, sizeof(CCNR)));
     PrintAndLogEx(SUCCESS, "TAG MAC: %s", sprint_hex(MAC_TAG, sizeof(MAC_TAG)));
 
-    uint8_t *keyBlock = NULL;
-    uint32_t keycount = 0;
-
-    // load keys
-    int res = loadFileDICTIONARY_safe(filename, (void **)&keyBlock, 8, &keycount);
-    if (res != PM3_SUCCESS || keycount == 0) {
-        free(keyBlock);
+    char *dic = NULL;
+    size_t diclen = 0;
+    int res = mapFileDICTIONARY_safe(filename, (void **)&dic, &diclen);
+    if (res != PM3_SUCCESS)
         return res;
-    }
-
-    //iclass_prekey_t
-    prekey = calloc(keycount, sizeof(iclass_prekey_t));
-    if (!prekey) {
-        free(keyBlock);
-        return PM3_EMALLOC;
-    }
-
-    PrintAndLogEx(SUCCESS, "Generating diversified keys...");
-    GenerateMacKeyFrom(CSN, CCNR, use_raw, use_elite, keyBlock, keycount, prekey);
 
     if (use_elite)
         PrintAndLogEx(SUCCESS, "Using " _YELLOW_("elite algo"));
     if (use_raw)
         PrintAndLogEx(SUCCESS, "Using " _YELLOW_("raw mode"));
 
-    PrintAndLogEx(SUCCESS, "Sorting...");
+    iclass_lookup_t lookup;
+    memset(&lookup, 0, sizeof(lookup));
+    lookup.dic = dic;
+    lookup.diclen = diclen;
+    lookup.CSN = CSN;
+    lookup.CCNR = CCNR;
+    lookup.use_raw = use_raw;
+    lookup.use_elite = use_elite;
+    memcpy(lookup.mac, MAC_TAG, sizeof(lookup.mac));
+    lookup.found_at = SIZE_MAX;
+    pthread_mutex_init(&lookup.lock, NULL);
+
+    int num_threads = MIN(num_CPUs(), ICLASS_LOOKUP_MAX_THREADS);
+    PrintAndLogEx(SUCCESS, "Searching for " _YELLOW_("%s") " key, %d threads...", "DEBIT", num_threads);
+
+    pthread_t thread_id[ICLASS_LOOKUP_MAX_THREADS];
+    int started = 0;
+    for (; started < num_threads; started++) {
+        if (pthread_create(&thread_id[started], NULL, iclass_lookup_thread, &lookup) != 0)
+            break;
+    }
+    // no thread at all, search everything here
+    if (started == 0)
+        iclass_lookup_thread(&lookup);
 
-    // sort mac list.
-    qsort(prekey, keycount, sizeof(iclass_prekey_t), cmp_uint32);
+    uint64_t last = t1;
+    while (__atomic_load_n(&lookup.finished, __ATOMIC_SEQ_CST) < started) {
+        msleep(100);
 
-    PrintAndLogEx(SUCCESS, "Searching for " _YELLOW_("%s") " key...", "DEBIT");
-    iclass_prekey_t *item;
-    iclass_prekey_t lookup;
-    memcpy(lookup.mac, MAC_TAG, 4);
+        if (kbd_enter_pressed()) {
+            __atomic_store_n(&lookup.abort, true, __ATOMIC_SEQ_CST);
+            break;
+        }
 
-    // binsearch
-    item = (iclass_prekey_t *) bsearch(&lookup, prekey, keycount, sizeof(iclass_prekey_t), cmp_uint32);
+        uint64_t now = msclock();
+        if (now - last < ICLASS_LOOKUP_PROGRESS_INTERVAL * 1000)
+            continue;
 
-    if (item != NULL) {
-        PrintAndLogEx(SUCCESS, "Found valid key " _GREEN_("%s"), sprint_hex(item->key, 8));
-        add_key(item->key);
+        last = now;
+        size_t done = __atomic_load_n(&lookup.done, __ATOMIC_SEQ_CST);
+        uint64_t eta = (done) ? (now - t1) * (diclen - done) / done / 1000 : 0;
+        PrintAndLogEx(INPLACE, "%5.1f%%, %u keys tested, ETA %" PRIu64 " s   ", (float)done * 100 / diclen, __atomic_load_n(&lookup.keycnt, __ATOMIC_RELAXED), eta);
     }
 
-    t1 = msclock() - t1;
-    PrintAndLogEx(SUCCESS, "time in iclass lookup " _YELLOW_("%.0f") " seconds", (float)t1 / 1000.0);
+    for (int i = 0; i < started; i++)
+        pthread_join(thread_id[i], NULL);
+    pthread_mutex_destroy(&lookup.lock);
+    unmapFile(dic, diclen);
 
-    free(prekey);
-    free(keyBlock);
+    PrintAndLogEx(NORMAL, "");
+    if (lookup.abort && lookup.found_at == SIZE_MAX) {
+        PrintAndLogEx(WARNING, "aborted via keyboard, %u keys tested", lookup.keycnt);
+        return PM3_EOPABORTED;
+    }
+
+    if (lookup.found_at != SIZE_MAX) {
+        PrintAndLogEx(SUCCESS, "Found valid key " _GREEN_("%s"), sprint_hex(lookup.key, 8));
+        add_key(lookup.key);
+    }
+
+    t1 = msclock() - t1;
+    PrintAndLogEx(SUCCESS, "%u keys tested, time in iclass lookup " _YELLOW_("%.0f") " seconds", lookup.keycnt, (float)t1 / 1000.0);
     PrintAndLogEx(NORMAL, "");
     return PM3_SUCCESS;
 }
 
 // precalc diversified keys and their MAC
 void GenerateMacFrom(uint8_t *CSN, uint8_t *CCNR, bool use_raw, bool use_elite, uint8_t *keys, uint32_t keycnt, iclass_premac_t *list) {
-    uint8_t key[8] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
-    uint8_t div_key[8] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+    uint8_t div_keys[MAC_BATCH_SIZE * 8] = {0};
+    uint8_t macs[MAC_BATCH_SIZE * 4] = {0};
 
-//iceman: threading
-    for (uint32_t i = 0; i < keycnt; i++) {
-
-        memcpy(key, keys + 8 * i, 8);
+    for (uint32_t i = 0; i < keycnt; i += MAC_BATCH_SIZE) {
 
-        if (use_raw)
-            memcpy(div_key, key, 8);
-        else
-            HFiClassCalcDivKey(CSN, key, div_key, use_elite);
+        uint32_t n = MIN(keycnt - i, MAC_BATCH_SIZE);
+        for (uint32_t j = 0; j < n; j++) {
+            if (use_raw)
+                memcpy(div_keys + j * 8, keys + 8 * (i + j), 8);
+            else
+                HFiClassCalcDivKey(CSN, keys + 8 * (i + j), div_keys + j * 8, use_elite);
+        }
 
-        doMAC(CCNR, div_key, list[i].mac);
+        doMAC_batch(CCNR, 0, div_keys, macs, n);
+        for (uint32_t j = 0; j < n; j++)
+            memcpy(list[i + j].mac, macs + j * 4, 4);
     }
 }
 
 void GenerateMacKeyFrom(uint8_t *CSN, uint8_t *CCNR, bool use_raw, bool use_elite, uint8_t *keys, uint32_t keycnt, iclass_prekey_t *list) {
+    uint8_t div_keys[MAC_BATCH_SIZE * 8] = {0};
+    uint8_t macs[MAC_BATCH_SIZE * 4] = {0};
 
-    uint8_t div_key[8] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
-
-//iceman: threading
-    for (uint32_t i = 0; i < keycnt; i++) {
+    for (uint32_t i = 0; i < keycnt; i += MAC_BATCH_SIZE) {
 
-        memcpy(list[i].key, keys + 8 * i, 8);
+        uint32_t n = MIN(keycnt - i, MAC_BATCH_SIZE);
+        for (uint32_t j = 0; j < n; j++) {
+            memcpy(list[i + j].key, keys + 8 * (i + j), 8);
 
-        // generate diversifed key
-        if (use_raw)
-            memcpy(div_key, list[i].key, 8);
-        else
-            HFiClassCalcDivKey(CSN, list[i].key, div_key, use_elite);
+            // generate diversifed key
+            if (use_raw)
+                memcpy(div_keys + j * 8, list[i + j].key, 8);
+            else
+                HFiClassCalcDivKey(CSN, list[i + j].key, div_keys + j * 8, use_elite);
+        }
 
-        // generate MAC
-        doMAC(CCNR, div_key, list[i].mac);
+        // generate MACs
+        doMAC_batch(CCNR, 0, div_keys, macs, n);
+        for (uint32_t j = 0; j < n; j++)
+            memcpy(list[i + j].mac, macs + j * 4, 4);
     }
 }
 
@@ -603,16 +603,26 @@ static int CmdLegicSim(const char *Cmd) {
 
     PrintAndLogEx(INFO, "Press pm3-button to abort simulation");
     bool keypress = kbd_enter_pressed();
+    bool done = false;
     while (keypress == false) {
         keypress = kbd_enter_pressed();
 
         if (WaitForResponseTimeout(CMD_HF_LEGIC_SIMULATE, &resp, 1500)) {
+            done = true;
             break;
         }
 
     }
-    if (keypress)
+    if (keypress) {
         SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+        done = WaitForResponseTimeout(CMD_HF_LEGIC_SIMULATE, &resp, 1500);
+    }
+
+    // timeslots the simulation missed, a reader may have dropped those answers
+    if (done && resp.length >= sizeof(legic_sim_stats_t)) {
+        legic_sim_stats_t *stats = (legic_sim_stats_t *)resp.data.asBytes;
+        PrintAndLogEx(INFO, "%u frames sent, %u late, %u late bits", stats->frames, stats->late_frames, stats->late_bits);
+    }
 
     PrintAndLogEx(INFO, "Done");
     return PM3_SUCCESS;
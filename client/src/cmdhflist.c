@@ -12,16 +12,21 @@
 #include "cmdhflist.h"
 
 #include <inttypes.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <pthread.h>
 
 #include "commonutil.h"  // ARRAYLEN
+#include "util.h"        // num_CPUs
 #include "mifare/mifarehost.h"
 #include "mifare/mifaredefault.h"
 #include "parity.h"         // oddparity
 #include "ui.h"
 #include "crc16.h"
 #include "crapto1/crapto1.h"
+#include "crapto1/crypto1_bs.h"
+#include "crapto1/nonce_brute.h"
 #include "protocols.h"
 #include "cmdhficlass.h"
 
@@ -38,6 +43,46 @@ enum MifareAuthSeq {
 static enum MifareAuthSeq MifareAuthState;
 static TAuthData AuthData;
 
+// Key search ahead of the listing.  A pre-pass collects the authentications
+// of the trace by frame shape, the keys of all nested ones are then searched
+// in threads and kept here for DecodeMifareData to pick up.
+enum {
+    mfkNotFound,
+    mfkKey,
+    mfkNested,
+};
+
+typedef struct {
+    TAuthData ad;       // nested, nt is the nonce of the first auth of the session
+    uint8_t cmd[32];    // first frame after the auth
+    uint8_t parity[4];
+    uint8_t cmdsize;
+    bool first;         // plain authentication, the key comes from ks2 and ks3
+    uint8_t found;      // mfkNotFound, mfkKey, mfkNested
+    uint64_t key;
+    uint32_t nt;
+    uint32_t ks2;
+    uint32_t ks3;
+} mf_cached_auth_t;
+
+static mf_cached_auth_t *mf_auths;
+static uint32_t mf_auths_cnt;
+static uint32_t mf_auths_cap;
+static uint32_t *mf_auths_order;    // sorted for find_cached_auth
+
+// collector state
+static struct {
+    uint8_t step;           // 0 idle, 1 auth cmd, 2 nt, 3 nr ar, 4 at - waiting for the first frame
+    bool plain;
+    bool have_first;
+    uint32_t first_nt;
+    TAuthData ad;
+} mf_scan;
+
+static const mf_cached_auth_t *find_cached_auth(const TAuthData *ad, bool first, const uint8_t *cmd, uint8_t cmdsize);
+static bool nested_check_prng(TAuthData *ad, uint8_t *cmd, uint8_t cmdsize, uint8_t *parity);
+static struct Crypto1State *auth_state(uint64_t key, const TAuthData *ad);
+
 void ClearAuthData(void) {
     AuthData.uid = 0;
     AuthData.nt = 0;
@@ -158,21 +203,97 @@ uint8_t iclass_CRC_check(bool isResponse, uint8_t *d, uint8_t n) {
     return check_crc(CRC_ICLASS, d, n);
 }
 
+// Opcode tables for the annotations, indexed by the command byte and filled in
+// at compile time.  An entry names the command, when arg is set the frame byte
+// at that offset follows as "(%d)".  Commands whose text depends on more than
+// the opcode stay in the switch of their annotate function.
+typedef struct {
+    const char *name;
+    uint8_t arg;
+} annotation_t;
+
+// same as snprintf(exp, size, "%s", s)
+static void annotate_copy(char *exp, size_t size, const char *s) {
+    if (size == 0)
+        return;
+
+    size_t n = strlen(s);
+    if (n >= size)
+        n = size - 1;
+
+    memcpy(exp, s, n);
+    exp[n] = 0;
+}
+
+// same as snprintf(exp, size, "%s(%d)", name, value)
+static void annotate_arg(char *exp, size_t size, const char *name, uint8_t value) {
+    char buf[64];
+    size_t n = strlen(name);
+    if (n > sizeof(buf) - 6)
+        n = sizeof(buf) - 6;
+
+    memcpy(buf, name, n);
+    buf[n++] = '(';
+    if (value >= 100)
+        buf[n++] = '0' + value / 100;
+    if (value >= 10)
+        buf[n++] = '0' + (value / 10) % 10;
+    buf[n++] = '0' + value % 10;
+    buf[n++] = ')';
+    buf[n] = 0;
+    annotate_copy(exp, size, buf);
+}
+
+static bool annotate_from_table(char *exp, size_t size, const annotation_t *table, uint8_t op, const uint8_t *cmd) {
+    const annotation_t *a = &table[op];
+    if (a->name == NULL)
+        return false;
+
+    if (a->arg)
+        annotate_arg(exp, size, a->name, cmd[a->arg]);
+    else
+        annotate_copy(exp, size, a->name);
+    return true;
+}
+
+static const annotation_t iso14443a_table[256] = {
+    [ISO14443A_CMD_WUPA]        = { "WUPA", 0 },
+    [ISO14443A_CMD_REQA]        = { "REQA", 0 },
+    [ISO14443A_CMD_READBLOCK]   = { "READBLOCK", 1 },
+    [ISO14443A_CMD_WRITEBLOCK]  = { "WRITEBLOCK", 1 },
+    [ISO14443A_CMD_RATS]        = { "RATS", 0 },
+    [ISO14443A_CMD_PPS]         = { "PPS", 0 },
+    [ISO14443A_CMD_OPTS]        = { "OPTIONAL TIMESLOT", 0 },
+    [MIFARE_CMD_INC]            = { "INC", 1 },
+    [MIFARE_CMD_DEC]            = { "DEC", 1 },
+    [MIFARE_CMD_RESTORE]        = { "RESTORE", 1 },
+    [MIFARE_CMD_TRANSFER]       = { "TRANSFER", 1 },
+    [MIFARE_MAGICWUPC1]         = { "MAGIC WUPC1", 0 },
+    [MIFARE_MAGICWUPC2]         = { "MAGIC WUPC2", 0 },
+    [MIFARE_MAGICWIPEC]         = { "MAGIC WIPEC", 0 },
+    [MIFARE_ULC_AUTH_1]         = { "AUTH ", 0 },
+    [MIFARE_ULC_AUTH_2]         = { "AUTH_ANSW", 0 },
+    [MIFARE_ULEV1_READSIG]      = { "READ SIG", 0 },
+    [MIFARE_ULEV1_CHECKTEAR]    = { "CHK TEARING", 1 },
+    [MIFARE_ULEV1_VCSL]         = { "VCSL", 0 },
+    [MIFARE_ULNANO_WRITESIG]    = { "WRITE SIG", 0 },
+};
+
 int applyIso14443a(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize) {
+    if (annotate_from_table(exp, size, iso14443a_table, cmd[0], cmd))
+        return 1;
+
     switch (cmd[0]) {
-        case ISO14443A_CMD_WUPA:
-            snprintf(exp, size, "WUPA");
-            break;
         case ISO14443A_CMD_ANTICOLL_OR_SELECT: {
             // 93 20 = Anticollision (usage: 9320 - answer: 4bytes UID+1byte UID-bytes-xor)
             // 93 50 = Bit oriented anti-collision (usage: 9350+ up to 5bytes, 9350 answer - up to 5bytes UID+BCC)
             // 93 70 = Select (usage: 9370+5bytes 9370 answer - answer: 1byte SAK)
             if (cmd[1] == 0x70)
-                snprintf(exp, size, "SELECT_UID");
+                annotate_copy(exp, size, "SELECT_UID");
             else if (cmd[1] == 0x20 || cmd[1] == 0x50)
-                snprintf(exp, size, "ANTICOLL");
+                annotate_copy(exp, size, "ANTICOLL");
             else
-                snprintf(exp, size, "SELECT_XXX");
+                annotate_copy(exp, size, "SELECT_XXX");
             break;
         }
         case ISO14443A_CMD_ANTICOLL_OR_SELECT_2: {
@@ -180,11 +301,11 @@ int applyIso14443a(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize) {
             //95 50 = Bit oriented anti-collision level2
             //95 70 = Select of cascade level2
             if (cmd[1] == 0x70)
-                snprintf(exp, size, "SELECT_UID-2");
+                annotate_copy(exp, size, "SELECT_UID-2");
             else if (cmd[1] == 0x20 || cmd[1] == 0x50)
-                snprintf(exp, size, "ANTICOLL-2");
+                annotate_copy(exp, size, "ANTICOLL-2");
             else
-                snprintf(exp, size, "SELECT_XXX-2");
+                annotate_copy(exp, size, "SELECT_XXX-2");
             break;
         }
         case ISO14443A_CMD_ANTICOLL_OR_SELECT_3: {
@@ -192,82 +313,37 @@ int applyIso14443a(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize) {
             //97 50 = Bit oriented anti-collision level3
             //97 70 = Select of cascade level3
             if (cmd[1] == 0x70)
-                snprintf(exp, size, "SELECT_UID-3");
+                annotate_copy(exp, size, "SELECT_UID-3");
             else if (cmd[1] == 0x20 || cmd[1] == 0x50)
-                snprintf(exp, size, "ANTICOLL-3");
+                annotate_copy(exp, size, "ANTICOLL-3");
             else
-                snprintf(exp, size, "SELECT_XXX-3");
+                annotate_copy(exp, size, "SELECT_XXX-3");
             break;
         }
-        case ISO14443A_CMD_REQA:
-            snprintf(exp, size, "REQA");
-            break;
-        case ISO14443A_CMD_READBLOCK:
-            snprintf(exp, size, "READBLOCK(%d)", cmd[1]);
-            break;
-        case ISO14443A_CMD_WRITEBLOCK:
-            snprintf(exp, size, "WRITEBLOCK(%d)", cmd[1]);
-            break;
         case ISO14443A_CMD_HALT:
-            snprintf(exp, size, "HALT");
+            annotate_copy(exp, size, "HALT");
             MifareAuthState = masNone;
             break;
-        case ISO14443A_CMD_RATS:
-            snprintf(exp, size, "RATS");
-            break;
-        case ISO14443A_CMD_PPS:
-            snprintf(exp, size, "PPS");
-            break;
-        case ISO14443A_CMD_OPTS:
-            snprintf(exp, size, "OPTIONAL TIMESLOT");
-            break;
-        case MIFARE_CMD_INC:
-            snprintf(exp, size, "INC(%d)", cmd[1]);
-            break;
-        case MIFARE_CMD_DEC:
-            snprintf(exp, size, "DEC(%d)", cmd[1]);
-            break;
-        case MIFARE_CMD_RESTORE:
-            snprintf(exp, size, "RESTORE(%d)", cmd[1]);
-            break;
-        case MIFARE_CMD_TRANSFER:
-            snprintf(exp, size, "TRANSFER(%d)", cmd[1]);
-            break;
         case MIFARE_AUTH_KEYA: {
             if (cmdsize > 3) {
-                snprintf(exp, size, "AUTH-A(%d)", cmd[1]);
+                annotate_arg(exp, size, "AUTH-A", cmd[1]);
                 MifareAuthState = masNt;
             } else {
                 // case MIFARE_ULEV1_VERSION :  both 0x60.
-                snprintf(exp, size, "EV1 VERSION");
+                annotate_copy(exp, size, "EV1 VERSION");
             }
             break;
         }
         case MIFARE_AUTH_KEYB: {
             MifareAuthState = masNt;
-            snprintf(exp, size, "AUTH-B(%d)", cmd[1]);
+            annotate_arg(exp, size, "AUTH-B", cmd[1]);
             break;
         }
-        case MIFARE_MAGICWUPC1:
-            snprintf(exp, size, "MAGIC WUPC1");
-            break;
-        case MIFARE_MAGICWUPC2:
-            snprintf(exp, size, "MAGIC WUPC2");
-            break;
-        case MIFARE_MAGICWIPEC:
-            snprintf(exp, size, "MAGIC WIPEC");
-            break;
-        case MIFARE_ULC_AUTH_1:
-            snprintf(exp, size, "AUTH ");
-            break;
-        case MIFARE_ULC_AUTH_2:
-            snprintf(exp, size, "AUTH_ANSW");
-            break;
         case MIFARE_ULEV1_AUTH:
             if (cmdsize == 7)
                 snprintf(exp, size, "PWD-AUTH KEY: " _YELLOW_("0x%02x%02x%02x%02x"), cmd[1], cmd[2], cmd[3], cmd[4]);
             else
-                snprintf(exp, size, "PWD-AUTH");
+                annotate_copy(exp, size, "PWD-AUTH");
             break;
         case MIFARE_ULEV1_FASTREAD : {
             if (cmdsize >= 3 && cmd[2] <= 0xE6)
@@ -279,7 +355,7 @@ int applyIso14443a(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize) {
         }
         case MIFARE_ULC_WRITE : {
             if (cmd[1] < 0x21)
-                snprintf(exp, size, "WRITEBLOCK(%d)", cmd[1]);
+                annotate_arg(exp, size, "WRITEBLOCK", cmd[1]);
             else
                 // outside limits, useful for some tags...
                 snprintf(exp, size, "WRITEBLOCK(%d) (?)", cmd[1]);
@@ -287,37 +363,25 @@ int applyIso14443a(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize) {
         }
         case MIFARE_ULEV1_READ_CNT : {
             if (cmd[1] < 5)
-                snprintf(exp, size, "READ CNT(%d)", cmd[1]);
+                annotate_arg(exp, size, "READ CNT", cmd[1]);
             else
-                snprintf(exp, size, "?");
+                annotate_copy(exp, size, "?");
             break;
         }
         case MIFARE_ULEV1_INCR_CNT : {
             if (cmd[1] < 5)
-                snprintf(exp, size, "INCR(%d)", cmd[1]);
+                annotate_arg(exp, size, "INCR", cmd[1]);
             else
-                snprintf(exp, size, "?");
+                annotate_copy(exp, size, "?");
             break;
         }
-        case MIFARE_ULEV1_READSIG:
-            snprintf(exp, size, "READ SIG");
-            break;
-        case MIFARE_ULEV1_CHECKTEAR:
-            snprintf(exp, size, "CHK TEARING(%d)", cmd[1]);
-            break;
-        case MIFARE_ULEV1_VCSL:
-            snprintf(exp, size, "VCSL");
-            break;
-        case MIFARE_ULNANO_WRITESIG:
-            snprintf(exp, size, "WRITE SIG");
-            break;
         case MIFARE_ULNANO_LOCKSIF: {
             if (cmd[1] == 0)
-                snprintf(exp, size, "UNLOCK SIG");
+                annotate_copy(exp, size, "UNLOCK SIG");
             else if (cmd[1] == 2)
-                snprintf(exp, size, "LOCK SIG");
+                annotate_copy(exp, size, "LOCK SIG");
             else
-                snprintf(exp, size, "?");
+                annotate_copy(exp, size, "?");
             break;
         }
         default:
@@ -348,62 +412,62 @@ void annotateIclass(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize, bool
 
         switch (c) {
             case ICLASS_CMD_HALT:
-                snprintf(exp, size, "HALT");
+                annotate_copy(exp, size, "HALT");
                 curr_state = PICO_NONE;
                 break;
             case ICLASS_CMD_SELECT:
-                snprintf(exp, size, "SELECT");
+                annotate_copy(exp, size, "SELECT");
                 curr_state = PICO_SELECT;
                 break;
             case ICLASS_CMD_ACTALL:
-                snprintf(exp, size, "ACTALL");
+                annotate_copy(exp, size, "ACTALL");
                 curr_state = PICO_NONE;
                 break;
             case ICLASS_CMD_DETECT:
-                snprintf(exp, size, "DETECT");
+                annotate_copy(exp, size, "DETECT");
                 curr_state = PICO_NONE;
                 break;
             case ICLASS_CMD_CHECK:
-                snprintf(exp, size, "CHECK");
+                annotate_copy(exp, size, "CHECK");
                 curr_state = PICO_AUTH_MACS;
                 memcpy(rmac, cmd + 1, 4);
                 memcpy(tmac, cmd + 5, 4);
                 break;
             case ICLASS_CMD_READ4:
-                snprintf(exp, size, "READ4(%d)", cmd[1]);
+                annotate_arg(exp, size, "READ4", cmd[1]);
                 break;
             case ICLASS_CMD_READ_OR_IDENTIFY: {
 
                 if (cmdsize > 1) {
-                    snprintf(exp, size, "READ(%d)", cmd[1]);
+                    annotate_arg(exp, size, "READ", cmd[1]);
                 } else {
-                    snprintf(exp, size, "IDENTIFY");
+                    annotate_copy(exp, size, "IDENTIFY");
                 }
                 break;
             }
             case ICLASS_CMD_PAGESEL:
-                snprintf(exp, size, "PAGESEL(%d)", cmd[1]);
+                annotate_arg(exp, size, "PAGESEL", cmd[1]);
                 curr_state = PICO_NONE;
                 break;
             case ICLASS_CMD_UPDATE:
-                snprintf(exp, size, "UPDATE(%d)", cmd[1]);
+                annotate_arg(exp, size, "UPDATE", cmd[1]);
                 curr_state = PICO_NONE;
                 break;
             case ICLASS_CMD_READCHECK:
                 if (ICLASS_CREDIT(cmd[0])) {
-                    snprintf(exp, size, "READCHECK[Kc](%d)", cmd[1]);
+                    annotate_arg(exp, size, "READCHECK[Kc]", cmd[1]);
                     curr_state = PICO_AUTH_EPURSE;
                 } else {
-                    snprintf(exp, size, "READCHECK[Kd](%d)", cmd[1]);
+                    annotate_arg(exp, size, "READCHECK[Kd]", cmd[1]);
                     curr_state = PICO_AUTH_EPURSE;
                 }
                 break;
             case ICLASS_CMD_ACT:
-                snprintf(exp, size, "ACT");
+                annotate_copy(exp, size, "ACT");
                 curr_state = PICO_NONE;
                 break;
             default:
-                snprintf(exp, size, "?");
+                annotate_copy(exp, size, "?");
                 curr_state = PICO_NONE;
                 break;
         }
@@ -427,16 +491,53 @@ void annotateIclass(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize, bool
     return;
 }
 
+static const annotation_t iso15693_table[256] = {
+    [ISO15693_INVENTORY]                  = { "INVENTORY", 0 },
+    [ISO15693_STAYQUIET]                  = { "STAY_QUIET", 0 },
+    [ISO15693_LOCKBLOCK]                  = { "LOCKBLOCK", 0 },
+    [ISO15693_READ_MULTI_BLOCK]           = { "READ_MULTI_BLOCK", 0 },
+    [ISO15693_WRITE_MULTI_BLOCK]          = { "WRITE_MULTI_BLOCK", 0 },
+    [ISO15693_SELECT]                     = { "SELECT", 0 },
+    [ISO15693_RESET_TO_READY]             = { "RESET_TO_READY", 0 },
+    [ISO15693_WRITE_AFI]                  = { "WRITE_AFI", 0 },
+    [ISO15693_LOCK_AFI]                   = { "LOCK_AFI", 0 },
+    [ISO15693_WRITE_DSFID]                = { "WRITE_DSFID", 0 },
+    [ISO15693_LOCK_DSFID]                 = { "LOCK_DSFID", 0 },
+    [ISO15693_GET_SYSTEM_INFO]            = { "GET_SYSTEM_INFO", 0 },
+    [ISO15693_READ_MULTI_SECSTATUS]       = { "READ_MULTI_SECSTATUS", 0 },
+    [ISO15693_INVENTORY_READ]             = { "INVENTORY_READ", 0 },
+    [ISO15693_FAST_INVENTORY_READ]        = { "FAST_INVENTORY_READ", 0 },
+    [ISO15693_SET_EAS]                    = { "SET_EAS", 0 },
+    [ISO15693_RESET_EAS]                  = { "RESET_EAS", 0 },
+    [ISO15693_LOCK_EAS]                   = { "LOCK_EAS", 0 },
+    [ISO15693_EAS_ALARM]                  = { "EAS_ALARM", 0 },
+    [ISO15693_PASSWORD_PROTECT_EAS]       = { "PASSWORD_PROTECT_EAS", 0 },
+    [ISO15693_WRITE_EAS_ID]               = { "WRITE_EAS_ID", 0 },
+    [ISO15693_READ_EPC]                   = { "READ_EPC", 0 },
+    [ISO15693_GET_NXP_SYSTEM_INFO]        = { "GET_NXP_SYSTEM_INFO", 0 },
+    [ISO15693_INVENTORY_PAGE_READ]        = { "INVENTORY_PAGE_READ", 0 },
+    [ISO15693_FAST_INVENTORY_PAGE_READ]   = { "FAST_INVENTORY_PAGE_READ", 0 },
+    [ISO15693_GET_RANDOM_NUMBER]          = { "GET_RANDOM_NUMBER", 0 },
+    [ISO15693_SET_PASSWORD]               = { "SET_PASSWORD", 0 },
+    [ISO15693_WRITE_PASSWORD]             = { "WRITE_PASSWORD", 0 },
+    [ISO15693_LOCK_PASSWORD]              = { "LOCK_PASSWORD", 0 },
+    [ISO15693_PROTECT_PAGE]               = { "PROTECT_PAGE", 0 },
+    [ISO15693_LOCK_PAGE_PROTECTION]       = { "LOCK_PAGE_PROTECTION", 0 },
+    [ISO15693_GET_MULTI_BLOCK_PROTECTION] = { "GET_MULTI_BLOCK_PROTECTION", 0 },
+    [ISO15693_DESTROY]                    = { "DESTROY", 0 },
+    [ISO15693_ENABLE_PRIVACY]             = { "ENABLE_PRIVACY", 0 },
+    [ISO15693_64BIT_PASSWORD_PROTECTION]  = { "64BIT_PASSWORD_PROTECTION", 0 },
+    [ISO15693_STAYQUIET_PERSISTENT]       = { "STAYQUIET_PERSISTENT", 0 },
+    [ISO15693_READ_SIGNATURE]             = { "READ_SIGNATURE", 0 },
+};
+
 void annotateIso15693(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize) {
 
     if (cmdsize >= 2) {
+        if (annotate_from_table(exp, size, iso15693_table, cmd[1], cmd))
+            return;
+
         switch (cmd[1]) {
-            case ISO15693_INVENTORY:
-                snprintf(exp, size, "INVENTORY");
-                return;
-            case ISO15693_STAYQUIET:
-                snprintf(exp, size, "STAY_QUIET");
-                return;
             case ISO15693_READBLOCK: {
 
                 uint8_t block = 0;
@@ -445,176 +546,69 @@ void annotateIso15693(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize) {
                 else if (cmdsize == 5)
                     block = cmd[2];
 
-                snprintf(exp, size, "READBLOCK(%d)", block);
+                annotate_arg(exp, size, "READBLOCK", block);
                 return;
             }
             case ISO15693_WRITEBLOCK: {
                 uint8_t block = 0;
                 if (cmdsize == 9)
                     block = cmd[2];
-                snprintf(exp, size, "WRITEBLOCK(%d)", block);
+                annotate_arg(exp, size, "WRITEBLOCK", block);
                 return;
             }
-            case ISO15693_LOCKBLOCK:
-                snprintf(exp, size, "LOCKBLOCK");
-                return;
-            case ISO15693_READ_MULTI_BLOCK:
-                snprintf(exp, size, "READ_MULTI_BLOCK");
-                return;
-            case ISO15693_WRITE_MULTI_BLOCK:
-                snprintf(exp, size, "WRITE_MULTI_BLOCK");
-                return;
-            case ISO15693_SELECT:
-                snprintf(exp, size, "SELECT");
-                return;
-            case ISO15693_RESET_TO_READY:
-                snprintf(exp, size, "RESET_TO_READY");
-                return;
-            case ISO15693_WRITE_AFI:
-                snprintf(exp, size, "WRITE_AFI");
-                return;
-            case ISO15693_LOCK_AFI:
-                snprintf(exp, size, "LOCK_AFI");
-                return;
-            case ISO15693_WRITE_DSFID:
-                snprintf(exp, size, "WRITE_DSFID");
-                return;
-            case ISO15693_LOCK_DSFID:
-                snprintf(exp, size, "LOCK_DSFID");
-                return;
-            case ISO15693_GET_SYSTEM_INFO:
-                snprintf(exp, size, "GET_SYSTEM_INFO");
-                return;
-            case ISO15693_READ_MULTI_SECSTATUS:
-                snprintf(exp, size, "READ_MULTI_SECSTATUS");
-                return;
-            case ISO15693_INVENTORY_READ:
-                snprintf(exp, size, "INVENTORY_READ");
-                return;
-            case ISO15693_FAST_INVENTORY_READ:
-                snprintf(exp, size, "FAST_INVENTORY_READ");
-                return;
-            case ISO15693_SET_EAS:
-                snprintf(exp, size, "SET_EAS");
-                return;
-            case ISO15693_RESET_EAS:
-                snprintf(exp, size, "RESET_EAS");
-                return;
-            case ISO15693_LOCK_EAS:
-                snprintf(exp, size, "LOCK_EAS");
-                return;
-            case ISO15693_EAS_ALARM:
-                snprintf(exp, size, "EAS_ALARM");
-                return;
-            case ISO15693_PASSWORD_PROTECT_EAS:
-                snprintf(exp, size, "PASSWORD_PROTECT_EAS");
-                return;
-            case ISO15693_WRITE_EAS_ID:
-                snprintf(exp, size, "WRITE_EAS_ID");
-                return;
-            case ISO15693_READ_EPC:
-                snprintf(exp, size, "READ_EPC");
-                return;
-            case ISO15693_GET_NXP_SYSTEM_INFO:
-                snprintf(exp, size, "GET_NXP_SYSTEM_INFO");
-                return;
-            case ISO15693_INVENTORY_PAGE_READ:
-                snprintf(exp, size, "INVENTORY_PAGE_READ");
-                return;
-            case ISO15693_FAST_INVENTORY_PAGE_READ:
-                snprintf(exp, size, "FAST_INVENTORY_PAGE_READ");
-                return;
-            case ISO15693_GET_RANDOM_NUMBER:
-                snprintf(exp, size, "GET_RANDOM_NUMBER");
-                return;
-            case ISO15693_SET_PASSWORD:
-                snprintf(exp, size, "SET_PASSWORD");
-                return;
-            case ISO15693_WRITE_PASSWORD:
-                snprintf(exp, size, "WRITE_PASSWORD");
-                return;
-            case ISO15693_LOCK_PASSWORD:
-                snprintf(exp, size, "LOCK_PASSWORD");
-                return;
-            case ISO15693_PROTECT_PAGE:
-                snprintf(exp, size, "PROTECT_PAGE");
-                return;
-            case ISO15693_LOCK_PAGE_PROTECTION:
-                snprintf(exp, size, "LOCK_PAGE_PROTECTION");
-                return;
-            case ISO15693_GET_MULTI_BLOCK_PROTECTION:
-                snprintf(exp, size, "GET_MULTI_BLOCK_PROTECTION");
-                return;
-            case ISO15693_DESTROY:
-                snprintf(exp, size, "DESTROY");
-                return;
-            case ISO15693_ENABLE_PRIVACY:
-                snprintf(exp, size, "ENABLE_PRIVACY");
-                return;
-            case ISO15693_64BIT_PASSWORD_PROTECTION:
-                snprintf(exp, size, "64BIT_PASSWORD_PROTECTION");
-                return;
-            case ISO15693_STAYQUIET_PERSISTENT:
-                snprintf(exp, size, "STAYQUIET_PERSISTENT");
-                return;
-            case ISO15693_READ_SIGNATURE:
-                snprintf(exp, size, "READ_SIGNATURE");
-                return;
             default:
                 break;
         }
 
-        if (cmd[1] > ISO15693_STAYQUIET && cmd[1] < ISO15693_READBLOCK) snprintf(exp, size, "Mandatory RFU");
-        else if (cmd[1] > ISO15693_READ_MULTI_SECSTATUS && cmd[1] <= 0x9F) snprintf(exp, size, "Optional RFU");
-        //    else if (cmd[1] >= 0xA0 && cmd[1] <= 0xDF) snprintf(exp, size, "Cust IC MFG dependent");
-        else if (cmd[1] > ISO15693_READ_SIGNATURE && cmd[1] <= 0xDF) snprintf(exp, size, "Cust IC MFG dependent");
-        else if (cmd[1] >= 0xE0) snprintf(exp, size, "Proprietary IC MFG dependent");
+        if (cmd[1] > ISO15693_STAYQUIET && cmd[1] < ISO15693_READBLOCK) annotate_copy(exp, size, "Mandatory RFU");
+        else if (cmd[1] > ISO15693_READ_MULTI_SECSTATUS && cmd[1] <= 0x9F) annotate_copy(exp, size, "Optional RFU");
+        //    else if (cmd[1] >= 0xA0 && cmd[1] <= 0xDF) annotate_copy(exp, size, "Cust IC MFG dependent");
+        else if (cmd[1] > ISO15693_READ_SIGNATURE && cmd[1] <= 0xDF) annotate_copy(exp, size, "Cust IC MFG dependent");
+        else if (cmd[1] >= 0xE0) annotate_copy(exp, size, "Proprietary IC MFG dependent");
         else
-            snprintf(exp, size, "?");
+            annotate_copy(exp, size, "?");
     }
 }
 
+static const annotation_t topaz_table[256] = {
+    [TOPAZ_REQA]      = { "REQA", 0 },
+    [TOPAZ_WUPA]      = { "WUPA", 0 },
+    [TOPAZ_RID]       = { "RID", 0 },
+    [TOPAZ_RALL]      = { "RALL", 0 },
+    [TOPAZ_READ]      = { "READ", 0 },
+    [TOPAZ_WRITE_E]   = { "WRITE-E", 0 },
+    [TOPAZ_WRITE_NE]  = { "WRITE-NE", 0 },
+    [TOPAZ_RSEG]      = { "RSEG", 0 },
+    [TOPAZ_READ8]     = { "READ8", 0 },
+    [TOPAZ_WRITE_E8]  = { "WRITE-E8", 0 },
+    [TOPAZ_WRITE_NE8] = { "WRITE-NE8", 0 },
+};
+
 void annotateTopaz(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize) {
-    switch (cmd[0]) {
-        case TOPAZ_REQA:
-            snprintf(exp, size, "REQA");
-            break;
-        case TOPAZ_WUPA:
-            snprintf(exp, size, "WUPA");
-            break;
-        case TOPAZ_RID:
-            snprintf(exp, size, "RID");
-            break;
-        case TOPAZ_RALL:
-            snprintf(exp, size, "RALL");
-            break;
-        case TOPAZ_READ:
-            snprintf(exp, size, "READ");
-            break;
-        case TOPAZ_WRITE_E:
-            snprintf(exp, size, "WRITE-E");
-            break;
-        case TOPAZ_WRITE_NE:
-            snprintf(exp, size, "WRITE-NE");
-            break;
-        case TOPAZ_RSEG:
-            snprintf(exp, size, "RSEG");
-            break;
-        case TOPAZ_READ8:
-            snprintf(exp, size, "READ8");
-            break;
-        case TOPAZ_WRITE_E8:
-            snprintf(exp, size, "WRITE-E8");
-            break;
-        case TOPAZ_WRITE_NE8:
-            snprintf(exp, size, "WRITE-NE8");
-            break;
-        default:
-            snprintf(exp, size, "?");
-            break;
-    }
+    if (annotate_from_table(exp, size, topaz_table, cmd[0], cmd) == false)
+        annotate_copy(exp, size, "?");
 }
 
+static const annotation_t iso7816_table[256] = {
+    [ISO7816_READ_BINARY]             = { "READ BIN", 0 },
+    [ISO7816_WRITE_BINARY]            = { "WRITE BIN", 0 },
+    [ISO7816_UPDATE_BINARY]           = { "UPDATE BIN", 0 },
+    [ISO7816_ERASE_BINARY]            = { "ERASE BIN", 0 },
+    [ISO7816_READ_RECORDS]            = { "READ RECORDS", 0 },
+    [ISO7816_WRITE_RECORDS]           = { "WRITE RECORDS", 0 },
+    [ISO7816_APPEND_RECORD]           = { "APPEND RECORD", 0 },
+    [ISO7816_UPDATE_RECORD]           = { "UPDATE RECORD", 0 },
+    [ISO7816_GET_DATA]                = { "GET DATA", 0 },
+    [ISO7816_PUT_DATA]                = { "PUT DATA", 0 },
+    [ISO7816_SELECT_FILE]             = { "SELECT FILE", 0 },
+    [ISO7816_VERIFY]                  = { "VERIFY", 0 },
+    [ISO7816_INTERNAL_AUTHENTICATION] = { "INTERNAL AUTH", 0 },
+    [ISO7816_EXTERNAL_AUTHENTICATION] = { "EXTERNAL AUTH", 0 },
+    [ISO7816_GET_CHALLENGE]           = { "GET CHALLENGE", 0 },
+    [ISO7816_MANAGE_CHANNEL]          = { "MANAGE CHANNEL", 0 },
+    [ISO7816_GET_RESPONSE]            = { "GET RESPONSE", 0 },
+};
+
 // iso 7816-3
 void annotateIso7816(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize) {
 
@@ -675,65 +669,48 @@ void annotateIso7816(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize) {
                 pos = 3;
                 break;
         }
-        switch (cmd[pos]) {
-            case ISO7816_READ_BINARY:
-                snprintf(exp, size, "READ BIN");
-                break;
-            case ISO7816_WRITE_BINARY:
-                snprintf(exp, size, "WRITE BIN");
-                break;
-            case ISO7816_UPDATE_BINARY:
-                snprintf(exp, size, "UPDATE BIN");
-                break;
-            case ISO7816_ERASE_BINARY:
-                snprintf(exp, size, "ERASE BIN");
-                break;
-            case ISO7816_READ_RECORDS:
-                snprintf(exp, size, "READ RECORDS");
-                break;
-            case ISO7816_WRITE_RECORDS:
-                snprintf(exp, size, "WRITE RECORDS");
-                break;
-            case ISO7816_APPEND_RECORD:
-                snprintf(exp, size, "APPEND RECORD");
-                break;
-            case ISO7816_UPDATE_RECORD:
-                snprintf(exp, size, "UPDATE RECORD");
-                break;
-            case ISO7816_GET_DATA:
-                snprintf(exp, size, "GET DATA");
-                break;
-            case ISO7816_PUT_DATA:
-                snprintf(exp, size, "PUT DATA");
-                break;
-            case ISO7816_SELECT_FILE:
-                snprintf(exp, size, "SELECT FILE");
-                break;
-            case ISO7816_VERIFY:
-                snprintf(exp, size, "VERIFY");
-                break;
-            case ISO7816_INTERNAL_AUTHENTICATION:
-                snprintf(exp, size, "INTERNAL AUTH");
-                break;
-            case ISO7816_EXTERNAL_AUTHENTICATION:
-                snprintf(exp, size, "EXTERNAL AUTH");
-                break;
-            case ISO7816_GET_CHALLENGE:
-                snprintf(exp, size, "GET CHALLENGE");
-                break;
-            case ISO7816_MANAGE_CHANNEL:
-                snprintf(exp, size, "MANAGE CHANNEL");
-                break;
-            case ISO7816_GET_RESPONSE:
-                snprintf(exp, size, "GET RESPONSE");
-                break;
-            default:
-                //snprintf(exp, size, "?");
-                break;
-        }
+        annotate_from_table(exp, size, iso7816_table, cmd[pos], cmd);
     }
 }
 
+static const annotation_t mfdes_table[256] = {
+    [MFDES_CREATE_APPLICATION]        = { "CREATE APPLICATION", 0 },
+    [MFDES_DELETE_APPLICATION]        = { "DELETE APPLICATION", 0 },
+    [MFDES_GET_APPLICATION_IDS]       = { "GET APPLICATION IDS", 0 },
+    [MFDES_SELECT_APPLICATION]        = { "SELECT APPLICATION", 0 },
+    [MFDES_FORMAT_PICC]               = { "FORMAT PICC", 0 },
+    [MFDES_GET_VERSION]               = { "GET VERSION", 0 },
+    [MFDES_READ_DATA]                 = { "READ DATA", 0 },
+    [MFDES_WRITE_DATA]                = { "WRITE DATA", 0 },
+    [MFDES_GET_VALUE]                 = { "GET VALUE", 0 },
+    [MFDES_CREDIT]                    = { "CREDIT", 0 },
+    [MFDES_DEBIT]                     = { "DEBIT", 0 },
+    [MFDES_LIMITED_CREDIT]            = { "LIMITED CREDIT", 0 },
+    [MFDES_WRITE_RECORD]              = { "WRITE RECORD", 0 },
+    [MFDES_READ_RECORDS]              = { "READ RECORDS", 0 },
+    [MFDES_CLEAR_RECORD_FILE]         = { "CLEAR RECORD FILE", 0 },
+    [MFDES_COMMIT_TRANSACTION]        = { "COMMIT TRANSACTION", 0 },
+    [MFDES_ABORT_TRANSACTION]         = { "ABORT TRANSACTION", 0 },
+    [MFDES_GET_FREE_MEMORY]           = { "GET FREE MEMORY", 0 },
+    [MFDES_GET_FILE_IDS]              = { "GET FILE IDS", 0 },
+    [MFDES_GET_DF_NAMES]              = { "GET DF NAMES", 0 },
+    [MFDES_GET_ISOFILE_IDS]           = { "GET ISOFILE IDS", 0 },
+    [MFDES_GET_FILE_SETTINGS]         = { "GET FILE SETTINGS", 0 },
+    [MFDES_CHANGE_FILE_SETTINGS]      = { "CHANGE FILE SETTINGS", 0 },
+    [MFDES_CREATE_STD_DATA_FILE]      = { "CREATE STD DATA FILE", 0 },
+    [MFDES_CREATE_BACKUP_DATA_FILE]   = { "CREATE BACKUP DATA FILE", 0 },
+    [MFDES_CREATE_VALUE_FILE]         = { "CREATE VALUE FILE", 0 },
+    [MFDES_CREATE_LINEAR_RECORD_FILE] = { "CREATE LINEAR RECORD FILE", 0 },
+    [MFDES_CREATE_CYCLIC_RECORD_FILE] = { "CREATE CYCLIC RECORD FILE", 0 },
+    [MFDES_DELETE_FILE]               = { "DELETE FILE", 0 },
+    [MFDES_CHANGE_KEY_SETTINGS]       = { "CHANGE KEY SETTINGS", 0 },
+    [MFDES_GET_KEY_SETTINGS]          = { "GET KEY SETTINGS", 0 },
+    [MFDES_CHANGE_KEY]                = { "CHANGE KEY", 0 },
+    [MFDES_GET_KEY_VERSION]           = { "GET KEY VERSION", 0 },
+    [MFDES_ADDITIONAL_FRAME]          = { "AUTH FRAME / NEXT FRAME", 0 },
+    [MFDES_READSIG]                   = { "READ SIGNATURE", 0 },
+};
+
 // MIFARE DESFire
 void annotateMfDesfire(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize) {
 
@@ -773,94 +750,10 @@ void annotateMfDesfire(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize) {
                 pos++;
 
             for (uint8_t i = 0; i < 2; i++, pos++) {
+                if (annotate_from_table(exp, size, mfdes_table, cmd[pos], cmd))
+                    continue;
+
                 switch (cmd[pos]) {
-                    case MFDES_CREATE_APPLICATION:
-                        snprintf(exp, size, "CREATE APPLICATION");
-                        break;
-                    case MFDES_DELETE_APPLICATION:
-                        snprintf(exp, size, "DELETE APPLICATION");
-                        break;
-                    case MFDES_GET_APPLICATION_IDS:
-                        snprintf(exp, size, "GET APPLICATION IDS");
-                        break;
-                    case MFDES_SELECT_APPLICATION:
-                        snprintf(exp, size, "SELECT APPLICATION");
-                        break;
-                    case MFDES_FORMAT_PICC:
-                        snprintf(exp, size, "FORMAT PICC");
-                        break;
-                    case MFDES_GET_VERSION:
-                        snprintf(exp, size, "GET VERSION");
-                        break;
-                    case MFDES_READ_DATA:
-                        snprintf(exp, size, "READ DATA");
-                        break;
-                    case MFDES_WRITE_DATA:
-                        snprintf(exp, size, "WRITE DATA");
-                        break;
-                    case MFDES_GET_VALUE:
-                        snprintf(exp, size, "GET VALUE");
-                        break;
-                    case MFDES_CREDIT:
-                        snprintf(exp, size, "CREDIT");
-                        break;
-                    case MFDES_DEBIT:
-                        snprintf(exp, size, "DEBIT");
-                        break;
-                    case MFDES_LIMITED_CREDIT:
-                        snprintf(exp, size, "LIMITED CREDIT");
-                        break;
-                    case MFDES_WRITE_RECORD:
-                        snprintf(exp, size, "WRITE RECORD");
-                        break;
-                    case MFDES_READ_RECORDS:
-                        snprintf(exp, size, "READ RECORDS");
-                        break;
-                    case MFDES_CLEAR_RECORD_FILE:
-                        snprintf(exp, size, "CLEAR RECORD FILE");
-                        break;
-                    case MFDES_COMMIT_TRANSACTION:
-                        snprintf(exp, size, "COMMIT TRANSACTION");
-                        break;
-                    case MFDES_ABORT_TRANSACTION:
-                        snprintf(exp, size, "ABORT TRANSACTION");
-                        break;
-                    case MFDES_GET_FREE_MEMORY:
-                        snprintf(exp, size, "GET FREE MEMORY");
-                        break;
-                    case MFDES_GET_FILE_IDS:
-                        snprintf(exp, size, "GET FILE IDS");
-                        break;
-                    case MFDES_GET_DF_NAMES:
-                        snprintf(exp, size, "GET DF NAMES");
-                        break;
-                    case MFDES_GET_ISOFILE_IDS:
-                        snprintf(exp, size, "GET ISOFILE IDS");
-                        break;
-                    case MFDES_GET_FILE_SETTINGS:
-                        snprintf(exp, size, "GET FILE SETTINGS");
-                        break;
-                    case MFDES_CHANGE_FILE_SETTINGS:
-                        snprintf(exp, size, "CHANGE FILE SETTINGS");
-                        break;
-                    case MFDES_CREATE_STD_DATA_FILE:
-                        snprintf(exp, size, "CREATE STD DATA FILE");
-                        break;
-                    case MFDES_CREATE_BACKUP_DATA_FILE:
-                        snprintf(exp, size, "CREATE BACKUP DATA FILE");
-                        break;
-                    case MFDES_CREATE_VALUE_FILE:
-                        snprintf(exp, size, "CREATE VALUE FILE");
-                        break;
-                    case MFDES_CREATE_LINEAR_RECORD_FILE:
-                        snprintf(exp, size, "CREATE LINEAR RECORD FILE");
-                        break;
-                    case MFDES_CREATE_CYCLIC_RECORD_FILE:
-                        snprintf(exp, size, "CREATE CYCLIC RECORD FILE");
-                        break;
-                    case MFDES_DELETE_FILE:
-                        snprintf(exp, size, "DELETE FILE");
-                        break;
                     case MFDES_AUTHENTICATE:
                         snprintf(exp, size, "AUTH NATIVE (keyNo %d)", cmd[pos + 1]);
                         break;  // AUTHENTICATE_NATIVE
@@ -870,24 +763,6 @@ void annotateMfDesfire(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize) {
                     case MFDES_AUTHENTICATE_AES:
                         snprintf(exp, size, "AUTH AES (keyNo %d)", cmd[pos + 1]);
                         break;
-                    case MFDES_CHANGE_KEY_SETTINGS:
-                        snprintf(exp, size, "CHANGE KEY SETTINGS");
-                        break;
-                    case MFDES_GET_KEY_SETTINGS:
-                        snprintf(exp, size, "GET KEY SETTINGS");
-                        break;
-                    case MFDES_CHANGE_KEY:
-                        snprintf(exp, size, "CHANGE KEY");
-                        break;
-                    case MFDES_GET_KEY_VERSION:
-                        snprintf(exp, size, "GET KEY VERSION");
-                        break;
-                    case MFDES_ADDITIONAL_FRAME:
-                        snprintf(exp, size, "AUTH FRAME / NEXT FRAME");
-                        break;
-                    case MFDES_READSIG:
-                        snprintf(exp, size, "READ SIGNATURE");
-                        break;
                     default:
                         break;
                 }
@@ -899,6 +774,21 @@ void annotateMfDesfire(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize) {
     }
 }
 
+static const annotation_t iso14443b_table[256] = {
+    [ISO14443B_ATTRIB]       = { "ATTRIB", 0 },
+    [ISO14443B_HALT]         = { "HALT", 0 },
+    [ISO14443B_INITIATE]     = { "INITIATE", 0 },
+    [ISO14443B_SELECT]       = { "SELECT", 1 },
+    [ISO14443B_GET_UID]      = { "GET UID", 0 },
+    [ISO14443B_READ_BLK]     = { "READ_BLK", 1 },
+    [ISO14443B_WRITE_BLK]    = { "WRITE_BLK", 1 },
+    [ISO14443B_RESET]        = { "RESET", 0 },
+    [ISO14443B_COMPLETION]   = { "COMPLETION", 0 },
+    [ISO14443B_AUTHENTICATE] = { "AUTHENTICATE", 0 },
+    [ISO14443B_PING]         = { "PING", 0 },
+    [ISO14443B_PONG]         = { "PONG", 0 },
+};
+
 /**
 06 00 = INITIATE
 0E xx = SELECT ID (xx = Chip-ID)
@@ -910,6 +800,9 @@ void annotateMfDesfire(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize) {
 0A 11 22 33 44 55 66 = Authenticate (11 22 33 44 55 66 = data to authenticate)
 **/
 void annotateIso14443b(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize) {
+    if (annotate_from_table(exp, size, iso14443b_table, cmd[0], cmd))
+        return;
+
     switch (cmd[0]) {
         case ISO14443B_REQB : {
 
@@ -936,86 +829,29 @@ void annotateIso14443b(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize) {
                 snprintf(exp, size, "REQB");
             break;
         }
-        case ISO14443B_ATTRIB:
-            snprintf(exp, size, "ATTRIB");
-            break;
-        case ISO14443B_HALT:
-            snprintf(exp, size, "HALT");
-            break;
-        case ISO14443B_INITIATE:
-            snprintf(exp, size, "INITIATE");
-            break;
-        case ISO14443B_SELECT:
-            snprintf(exp, size, "SELECT(%d)", cmd[1]);
-            break;
-        case ISO14443B_GET_UID:
-            snprintf(exp, size, "GET UID");
-            break;
-        case ISO14443B_READ_BLK:
-            snprintf(exp, size, "READ_BLK(%d)", cmd[1]);
-            break;
-        case ISO14443B_WRITE_BLK:
-            snprintf(exp, size, "WRITE_BLK(%d)", cmd[1]);
-            break;
-        case ISO14443B_RESET:
-            snprintf(exp, size, "RESET");
-            break;
-        case ISO14443B_COMPLETION:
-            snprintf(exp, size, "COMPLETION");
-            break;
-        case ISO14443B_AUTHENTICATE:
-            snprintf(exp, size, "AUTHENTICATE");
-            break;
-        case ISO14443B_PING:
-            snprintf(exp, size, "PING");
-            break;
-        case ISO14443B_PONG:
-            snprintf(exp, size, "PONG");
-            break;
         default:
             snprintf(exp, size, "?");
             break;
     }
 }
 
+static const annotation_t cryptorf_table[256] = {
+    [CRYPTORF_SET_USER_ZONE]     = { "SET USR ZONE", 0 },
+    [CRYPTORF_READ_USER_ZONE]    = { "READ USR ZONE", 0 },
+    [CRYPTORF_WRITE_USER_ZONE]   = { "WRITE USR ZONE", 0 },
+    [CRYPTORF_WRITE_SYSTEM_ZONE] = { "WRITE SYSTEM ZONE", 0 },
+    [CRYPTORF_READ_SYSTEM_ZONE]  = { "READ SYSTEM ZONE", 0 },
+    [CRYPTORF_VERIFY_CRYPTO]     = { "VERIFY CRYPTO", 0 },
+    [CRYPTORF_SEND_CHECKSUM]     = { "SEND CHKSUM", 0 },
+    [CRYPTORF_DESELECT]          = { "DESELECT", 0 },
+    [CRYPTORF_IDLE]              = { "IDLE", 0 },
+    [CRYPTORF_CHECK_PASSWORD]    = { "CHECK PWD", 0 },
+};
+
 // CryptoRF which is based on ISO-14443B
 void annotateCryptoRF(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize) {
-
-    switch (cmd[0]) {
-        case CRYPTORF_SET_USER_ZONE:
-            snprintf(exp, size, "SET USR ZONE");
-            break;
-        case CRYPTORF_READ_USER_ZONE:
-            snprintf(exp, size, "READ USR ZONE");
-            break;
-        case CRYPTORF_WRITE_USER_ZONE:
-            snprintf(exp, size, "WRITE USR ZONE");
-            break;
-        case CRYPTORF_WRITE_SYSTEM_ZONE:
-            snprintf(exp, size, "WRITE SYSTEM ZONE");
-            break;
-        case CRYPTORF_READ_SYSTEM_ZONE:
-            snprintf(exp, size, "READ SYSTEM ZONE");
-            break;
-        case CRYPTORF_VERIFY_CRYPTO:
-            snprintf(exp, size, "VERIFY CRYPTO");
-            break;
-        case CRYPTORF_SEND_CHECKSUM:
-            snprintf(exp, size, "SEND CHKSUM");
-            break;
-        case CRYPTORF_DESELECT:
-            snprintf(exp, size, "DESELECT");
-            break;
-        case CRYPTORF_IDLE:
-            snprintf(exp, size, "IDLE");
-            break;
-        case CRYPTORF_CHECK_PASSWORD:
-            snprintf(exp, size, "CHECK PWD");
-            break;
-        default:
-            snprintf(exp, size, "?");
-            break;
-    }
+    if (annotate_from_table(exp, size, cryptorf_table, cmd[0], cmd) == false)
+        annotate_copy(exp, size, "?");
 }
 
 
@@ -1084,174 +920,76 @@ void annotateLegic(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize) {
     }
 }
 
+static const annotation_t felica_table[256] = {
+    [FELICA_POLL_REQ]         = { "POLLING", 0 },
+    [FELICA_POLL_ACK]         = { "POLL ACK", 0 },
+    [FELICA_REQSRV_REQ]       = { "REQUEST SERVICE", 0 },
+    [FELICA_REQSRV_ACK]       = { "REQ SERV ACK", 0 },
+    [FELICA_REQRESP_REQ]      = { "REQUEST RESPONSE", 0 },
+    [FELICA_REQRESP_ACK]      = { "REQ RESP ACK", 0 },
+    [FELICA_RDBLK_REQ]        = { "READ BLK", 0 },
+    [FELICA_RDBLK_ACK]        = { "READ BLK ACK", 0 },
+    [FELICA_WRTBLK_REQ]       = { "WRITE BLK", 0 },
+    [FELICA_WRTBLK_ACK]       = { "WRITE BLK ACK", 0 },
+    [FELICA_SRCHSYSCODE_REQ]  = { "SEARCH SERVICE CODE", 0 },
+    [FELICA_SRCHSYSCODE_ACK]  = { "SSC ACK", 0 },
+    [FELICA_REQSYSCODE_REQ]   = { "REQUEST SYSTEM CODE", 0 },
+    [FELICA_REQSYSCODE_ACK]   = { "RSC ACK", 0 },
+    [FELICA_AUTH1_REQ]        = { "AUTH 1", 0 },
+    [FELICA_AUTH1_ACK]        = { "AUTH 1 ACK", 0 },
+    [FELICA_AUTH2_REQ]        = { "AUTH 2", 0 },
+    [FELICA_AUTH2_ACK]        = { "AUTH 2 ACK", 0 },
+    [FELICA_RDSEC_REQ]        = { "READ", 0 },
+    [FELICA_RDSEC_ACK]        = { "READ ACK", 0 },
+    [FELICA_WRTSEC_REQ]       = { "WRITE", 0 },
+    [FELICA_WRTSEC_ACK]       = { "WRITE ACK", 0 },
+    [FELICA_REQSRV2_REQ]      = { "REQUEST SERVICE v2", 0 },
+    [FELICA_REQSRV2_ACK]      = { "REQ SERV v2 ACK", 0 },
+    [FELICA_GETSTATUS_REQ]    = { "GET STATUS", 0 },
+    [FELICA_GETSTATUS_ACK]    = { "GET STATUS ACK", 0 },
+    [FELICA_OSVER_REQ]        = { "REQUEST SPECIFIC VERSION", 0 },
+    [FELICA_OSVER_ACK]        = { "RSV ACK", 0 },
+    [FELICA_RESET_MODE_REQ]   = { "RESET MODE", 0 },
+    [FELICA_RESET_MODE_ACK]   = { "RESET MODE ACK", 0 },
+    [FELICA_AUTH1V2_REQ]      = { "AUTH 1 v2", 0 },
+    [FELICA_AUTH1V2_ACK]      = { "AUTH 1 v2 ACK", 0 },
+    [FELICA_AUTH2V2_REQ]      = { "AUTH 2 v2", 0 },
+    [FELICA_AUTH2V2_ACK]      = { "AUTH 2 v2 ACK", 0 },
+    [FELICA_RDSECV2_REQ]      = { "READ v2", 0 },
+    [FELICA_RDSECV2_ACK]      = { "READ v2 ACK", 0 },
+    [FELICA_WRTSECV2_REQ]     = { "WRITE v2", 0 },
+    [FELICA_WRTSECV2_ACK]     = { "WRITE v2 ACK", 0 },
+    [FELICA_UPDATE_RNDID_REQ] = { "UPDATE RANDOM ID", 0 },
+    [FELICA_UPDATE_RNDID_ACK] = { "URI ACK", 0 },
+};
+
 void annotateFelica(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize) {
-    switch (cmd[3]) {
-        case FELICA_POLL_REQ:
-            snprintf(exp, size, "POLLING");
-            break;
-        case FELICA_POLL_ACK:
-            snprintf(exp, size, "POLL ACK");
-            break;
-        case FELICA_REQSRV_REQ:
-            snprintf(exp, size, "REQUEST SERVICE");
-            break;
-        case FELICA_REQSRV_ACK:
-            snprintf(exp, size, "REQ SERV ACK");
-            break;
-        case FELICA_REQRESP_REQ:
-            snprintf(exp, size, "REQUEST RESPONSE");
-            break;
-        case FELICA_REQRESP_ACK:
-            snprintf(exp, size, "REQ RESP ACK");
-            break;
-        case FELICA_RDBLK_REQ:
-            snprintf(exp, size, "READ BLK");
-            break;
-        case FELICA_RDBLK_ACK:
-            snprintf(exp, size, "READ BLK ACK");
-            break;
-        case FELICA_WRTBLK_REQ:
-            snprintf(exp, size, "WRITE BLK");
-            break;
-        case FELICA_WRTBLK_ACK:
-            snprintf(exp, size, "WRITE BLK ACK");
-            break;
-        case FELICA_SRCHSYSCODE_REQ:
-            snprintf(exp, size, "SEARCH SERVICE CODE");
-            break;
-        case FELICA_SRCHSYSCODE_ACK:
-            snprintf(exp, size, "SSC ACK");
-            break;
-        case FELICA_REQSYSCODE_REQ:
-            snprintf(exp, size, "REQUEST SYSTEM CODE");
-            break;
-        case FELICA_REQSYSCODE_ACK:
-            snprintf(exp, size, "RSC ACK");
-            break;
-        case FELICA_AUTH1_REQ:
-            snprintf(exp, size, "AUTH 1");
-            break;
-        case FELICA_AUTH1_ACK:
-            snprintf(exp, size, "AUTH 1 ACK");
-            break;
-        case FELICA_AUTH2_REQ:
-            snprintf(exp, size, "AUTH 2");
-            break;
-        case FELICA_AUTH2_ACK:
-            snprintf(exp, size, "AUTH 2 ACK");
-            break;
-        case FELICA_RDSEC_REQ:
-            snprintf(exp, size, "READ");
-            break;
-        case FELICA_RDSEC_ACK:
-            snprintf(exp, size, "READ ACK");
-            break;
-        case FELICA_WRTSEC_REQ:
-            snprintf(exp, size, "WRITE");
-            break;
-        case FELICA_WRTSEC_ACK:
-            snprintf(exp, size, "WRITE ACK");
-            break;
-        case FELICA_REQSRV2_REQ:
-            snprintf(exp, size, "REQUEST SERVICE v2");
-            break;
-        case FELICA_REQSRV2_ACK:
-            snprintf(exp, size, "REQ SERV v2 ACK");
-            break;
-        case FELICA_GETSTATUS_REQ:
-            snprintf(exp, size, "GET STATUS");
-            break;
-        case FELICA_GETSTATUS_ACK:
-            snprintf(exp, size, "GET STATUS ACK");
-            break;
-        case FELICA_OSVER_REQ:
-            snprintf(exp, size, "REQUEST SPECIFIC VERSION");
-            break;
-        case FELICA_OSVER_ACK:
-            snprintf(exp, size, "RSV ACK");
-            break;
-        case FELICA_RESET_MODE_REQ:
-            snprintf(exp, size, "RESET MODE");
-            break;
-        case FELICA_RESET_MODE_ACK:
-            snprintf(exp, size, "RESET MODE ACK");
-            break;
-        case FELICA_AUTH1V2_REQ:
-            snprintf(exp, size, "AUTH 1 v2");
-            break;
-        case FELICA_AUTH1V2_ACK:
-            snprintf(exp, size, "AUTH 1 v2 ACK");
-            break;
-        case FELICA_AUTH2V2_REQ:
-            snprintf(exp, size, "AUTH 2 v2");
-            break;
-        case FELICA_AUTH2V2_ACK:
-            snprintf(exp, size, "AUTH 2 v2 ACK");
-            break;
-        case FELICA_RDSECV2_REQ:
-            snprintf(exp, size, "READ v2");
-            break;
-        case FELICA_RDSECV2_ACK:
-            snprintf(exp, size, "READ v2 ACK");
-            break;
-        case FELICA_WRTSECV2_REQ:
-            snprintf(exp, size, "WRITE v2");
-            break;
-        case FELICA_WRTSECV2_ACK:
-            snprintf(exp, size, "WRITE v2 ACK");
-            break;
-        case FELICA_UPDATE_RNDID_REQ:
-            snprintf(exp, size, "UPDATE RANDOM ID");
-            break;
-        case FELICA_UPDATE_RNDID_ACK:
-            snprintf(exp, size, "URI ACK");
-            break;
-        default                     :
-            snprintf(exp, size, "?");
-            break;
-    }
+    if (annotate_from_table(exp, size, felica_table, cmd[3], cmd) == false)
+        annotate_copy(exp, size, "?");
 }
 
+static const annotation_t lto_table[256] = {
+    [LTO_REQ_STANDARD]      = { "REQ Standard", 0 },
+    [LTO_REQ_ALL]           = { "REQ All", 0 },
+    [LTO_TEST_CMD_1]        = { "TEST CMD 1", 0 },
+    [LTO_TEST_CMD_2]        = { "TEST CMD 2", 0 },
+    [LTO_READWORD]          = { "READWORD", 0 },
+    [LTO_READBLOCK & 0xF0]  = { "READBLOCK", 1 },
+    [LTO_READBLOCK_CONT]    = { "READBLOCK CONT", 0 },
+    [LTO_WRITEWORD]         = { "WRITEWORD", 0 },
+    [LTO_WRITEBLOCK & 0xF0] = { "WRITEBLOCK", 1 },
+    [LTO_HALT]              = { "HALT", 0 },
+};
+
 void annotateLTO(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize) {
-    switch (cmd[0]) {
-        case LTO_REQ_STANDARD:
-            snprintf(exp, size, "REQ Standard");
-            break;
-        case LTO_SELECT:
-            if (cmd[1] == 0x70)
-                snprintf(exp, size, "SELECT_UID-2");
-            else if (cmd[1] == 0x20)
-                snprintf(exp, size, "SELECT");
-            break;
-        case LTO_REQ_ALL:
-            snprintf(exp, size, "REQ All");
-            break;
-        case LTO_TEST_CMD_1:
-            snprintf(exp, size, "TEST CMD 1");
-            break;
-        case LTO_TEST_CMD_2:
-            snprintf(exp, size, "TEST CMD 2");
-            break;
-        case LTO_READWORD:
-            snprintf(exp, size, "READWORD");
-            break;
-        case (LTO_READBLOCK & 0xF0):
-            snprintf(exp, size, "READBLOCK(%d)", cmd[1]);
-            break;
-        case LTO_READBLOCK_CONT:
-            snprintf(exp, size, "READBLOCK CONT");
-            break;
-        case LTO_WRITEWORD:
-            snprintf(exp, size, "WRITEWORD");
-            break;
-        case (LTO_WRITEBLOCK & 0xF0):
-            snprintf(exp, size, "WRITEBLOCK(%d)", cmd[1]);
-            break;
-        case LTO_HALT:
-            snprintf(exp, size, "HALT");
-            break;
-        default:
-            break;
+    if (annotate_from_table(exp, size, lto_table, cmd[0], cmd))
+        return;
+
+    if (cmd[0] == LTO_SELECT) {
+        if (cmd[1] == 0x70)
+            annotate_copy(exp, size, "SELECT_UID-2");
+        else if (cmd[1] == 0x20)
+            annotate_copy(exp, size, "SELECT");
     }
 }
 
@@ -1359,7 +1097,8 @@ bool DecodeMifareData(uint8_t *cmd, uint8_t cmdsize, uint8_t *parity, bool isRes
             AuthData.ks2 = AuthData.ar_enc ^ prng_successor(AuthData.nt, 64);
             AuthData.ks3 = AuthData.at_enc ^ prng_successor(AuthData.nt, 96);
 
-            mfLastKey = GetCrypto1ProbableKey(&AuthData);
+            const mf_cached_auth_t *a = find_cached_auth(&AuthData, true, cmd, cmdsize);
+            mfLastKey = (a) ? a->key : GetCrypto1ProbableKey(&AuthData);
             PrintAndLogEx(NORMAL, "            |            |  *  |%48s %012"PRIx64" prng %s |     |",
                           "key",
                           mfLastKey,
@@ -1367,7 +1106,7 @@ bool DecodeMifareData(uint8_t *cmd, uint8_t cmdsize, uint8_t *parity, bool isRes
 
             AuthData.first_auth = false;
 
-            traceCrypto1 = lfsr_recovery64(AuthData.ks2, AuthData.ks3);
+            traceCrypto1 = auth_state(mfLastKey, &AuthData);
         } else {
             if (traceCrypto1) {
                 crypto1_destroy(traceCrypto1);
@@ -1378,51 +1117,57 @@ bool DecodeMifareData(uint8_t *cmd, uint8_t cmdsize, uint8_t *parity, bool isRes
             if (mfLastKey) {
                 if (NestedCheckKey(mfLastKey, &AuthData, cmd, cmdsize, parity)) {
                     PrintAndLogEx(NORMAL, "            |            |  *  |%60s %012"PRIx64"|     |", "last used key", mfLastKey);
-                    traceCrypto1 = lfsr_recovery64(AuthData.ks2, AuthData.ks3);
+                    traceCrypto1 = auth_state(mfLastKey, &AuthData);
                 };
             }
 
-            // check default keys
+            // keys searched ahead by SearchMifareKeys
+            bool searched = false;
             if (!traceCrypto1) {
-                for (int i = 0; i < ARRAYLEN(g_mifare_default_keys); i++) {
-                    if (NestedCheckKey(g_mifare_default_keys[i], &AuthData, cmd, cmdsize, parity)) {
-                        PrintAndLogEx(NORMAL, "            |            |  *  |%61s %012"PRIx64"|     |", "key", g_mifare_default_keys[i]);
+                const mf_cached_auth_t *a = find_cached_auth(&AuthData, false, cmd, cmdsize);
+                if (a) {
+                    // not found while walking from another nonce, leave it to the nested check below
+                    searched = (a->found != mfkNotFound || a->ad.nt == AuthData.nt);
+                    if (a->found != mfkNotFound) {
+                        AuthData.nt = a->nt;
+                        AuthData.ks2 = a->ks2;
+                        AuthData.ks3 = a->ks3;
+                        mfLastKey = a->key;
+                    }
+                    if (a->found == mfkKey) {
+                        PrintAndLogEx(NORMAL, "            |            |  *  |%61s %012"PRIx64"|     |", "key", mfLastKey);
+                    } else if (a->found == mfkNested) {
+                        PrintAndLogEx(NORMAL, "            |            |  *  | nested probable key:%012"PRIx64"      ks2:%08x ks3:%08x |     |",
+                                      mfLastKey,
+                                      AuthData.ks2,
+                                      AuthData.ks3);
+                    }
+                    if (a->found != mfkNotFound)
+                        traceCrypto1 = auth_state(mfLastKey, &AuthData);
+                }
+            }
 
-                        mfLastKey = g_mifare_default_keys[i];
-                        traceCrypto1 = lfsr_recovery64(AuthData.ks2, AuthData.ks3);
-                        break;
-                    };
+            // check default keys
+            if (!traceCrypto1 && !searched) {
+                int i = NestedCheckKeys(g_mifare_default_keys, ARRAYLEN(g_mifare_default_keys), &AuthData, cmd, cmdsize, parity);
+                if (i >= 0) {
+                    PrintAndLogEx(NORMAL, "            |            |  *  |%61s %012"PRIx64"|     |", "key", g_mifare_default_keys[i]);
+
+                    mfLastKey = g_mifare_default_keys[i];
+                    traceCrypto1 = auth_state(mfLastKey, &AuthData);
                 }
             }
 
             // nested
-            if (!traceCrypto1 && validate_prng_nonce(AuthData.nt)) {
-                uint32_t ntx = prng_successor(AuthData.nt, 90);
-                for (int i = 0; i < 16383; i++) {
-                    ntx = prng_successor(ntx, 1);
-                    if (NTParityChk(&AuthData, ntx)) {
-
-                        uint32_t ks2 = AuthData.ar_enc ^ prng_successor(ntx, 64);
-                        uint32_t ks3 = AuthData.at_enc ^ prng_successor(ntx, 96);
-                        struct Crypto1State *pcs = lfsr_recovery64(ks2, ks3);
-                        memcpy(mfData, cmd, cmdsize);
-                        mf_crypto1_decrypt(pcs, mfData, cmdsize, 0);
-                        crypto1_destroy(pcs);
-
-                        if (CheckCrypto1Parity(cmd, cmdsize, mfData, parity) && check_crc(CRC_14443_A, mfData, cmdsize)) {
-                            AuthData.ks2 = ks2;
-                            AuthData.ks3 = ks3;
-                            AuthData.nt = ntx;
-                            mfLastKey = GetCrypto1ProbableKey(&AuthData);
-                            PrintAndLogEx(NORMAL, "            |            |  *  | nested probable key:%012"PRIx64"      ks2:%08x ks3:%08x |     |",
-                                          mfLastKey,
-                                          AuthData.ks2,
-                                          AuthData.ks3);
-
-                            traceCrypto1 = lfsr_recovery64(AuthData.ks2, AuthData.ks3);
-                            break;
-                        }
-                    }
+            if (!traceCrypto1 && !searched && validate_prng_nonce(AuthData.nt)) {
+                if (nested_check_prng(&AuthData, cmd, cmdsize, parity)) {
+                    mfLastKey = GetCrypto1ProbableKey(&AuthData);
+                    PrintAndLogEx(NORMAL, "            |            |  *  | nested probable key:%012"PRIx64"      ks2:%08x ks3:%08x |     |",
+                                  mfLastKey,
+                                  AuthData.ks2,
+                                  AuthData.ks3);
+
+                    traceCrypto1 = auth_state(mfLastKey, &AuthData);
                 }
             }
 
@@ -1495,13 +1240,24 @@ bool NTParityChk(TAuthData *ad, uint32_t ntx) {
     return true;
 }
 
-bool NestedCheckKey(uint64_t key, TAuthData *ad, uint8_t *cmd, uint8_t cmdsize, uint8_t *parity) {
+// crypto1 state after an authentication with key, the frames that follow are
+// encrypted with it. ad->nt is the plain tag nonce. Much cheaper than
+// lfsr_recovery64 on ks2 and ks3 once the key is known.
+static struct Crypto1State *auth_state(uint64_t key, const TAuthData *ad) {
+    struct Crypto1State *pcs = crypto1_create(key);
+    crypto1_word(pcs, ad->uid ^ ad->nt, 0);
+    crypto1_word(pcs, ad->nr_enc, 1);
+    crypto1_word(pcs, 0, 0);
+    crypto1_word(pcs, 0, 0);
+    return pcs;
+}
+
+// Checks a key against a nested authentication and the first frame after it, on
+// success nt, ks2 and ks3 of ad are set. Only touches ad, safe to run in threads.
+static bool nested_check_key(uint64_t key, TAuthData *ad, uint8_t *cmd, uint8_t cmdsize, uint8_t *parity) {
     uint8_t buf[32] = {0};
     struct Crypto1State *pcs;
 
-    AuthData.ks2 = 0;
-    AuthData.ks3 = 0;
-
     pcs = crypto1_create(key);
     uint32_t nt1 = crypto1_word(pcs, ad->nt_enc ^ ad->uid, 1) ^ ad->nt_enc;
     uint32_t ar = prng_successor(nt1, 64);
@@ -1527,12 +1283,102 @@ bool NestedCheckKey(uint64_t key, TAuthData *ad, uint8_t *cmd, uint8_t cmdsize,
     if (!check_crc(CRC_14443_A, buf, cmdsize))
         return false;
 
-    AuthData.nt = nt1;
-    AuthData.ks2 = AuthData.ar_enc ^ ar;
-    AuthData.ks3 = AuthData.at_enc ^ at;
+    ad->nt = nt1;
+    ad->ks2 = ad->ar_enc ^ ar;
+    ad->ks3 = ad->at_enc ^ at;
     return true;
 }
 
+// nested_check_key over a key list whose states are already initialised, the
+// auth keystream of all keys is computed bitsliced. ks needs keycnt * 4 words.
+static int nested_check_keys(const struct Crypto1State *states, const uint64_t *keys, uint32_t keycnt, uint32_t *ks, TAuthData *ad, uint8_t *cmd, uint8_t cmdsize, uint8_t *parity) {
+    const crypto1_bs_op_t ops[] = {
+        { CRYPTO1_BS_FORWARD, 1, 0, ad->nt_enc ^ ad->uid, 0 },
+        { CRYPTO1_BS_FORWARD, 1, 0, ad->nr_enc, 0 },
+        { CRYPTO1_BS_FORWARD, 0, 0, 0, 0 },
+        { CRYPTO1_BS_FORWARD, 0, 0, 0, 0 },
+    };
+    crypto1_bs_run(states, keycnt, ops, ARRAYLEN(ops), ks);
+
+    for (uint32_t i = 0; i < keycnt; i++) {
+        uint32_t nt1 = ks[i * 4] ^ ad->nt_enc;
+        if (prng_successor(nt1, 64) != (ks[i * 4 + 2] ^ ad->ar_enc))
+            continue;
+        if (prng_successor(nt1, 96) != (ks[i * 4 + 3] ^ ad->at_enc))
+            continue;
+
+        if (nested_check_key(keys[i], ad, cmd, cmdsize, parity))
+            return i;
+    }
+    return -1;
+}
+
+// the first frame after the auth decrypts right with nonce ntx. On success nt, ks2 and ks3 of ad are set
+static bool nested_check_nt(TAuthData *ad, uint32_t ntx, uint8_t *cmd, uint8_t cmdsize, uint8_t *parity) {
+    uint8_t buf[32] = {0};
+    uint32_t ks2 = ad->ar_enc ^ prng_successor(ntx, 64);
+    uint32_t ks3 = ad->at_enc ^ prng_successor(ntx, 96);
+    struct Crypto1State *pcs = lfsr_recovery64(ks2, ks3);
+    memcpy(buf, cmd, cmdsize);
+    mf_crypto1_decrypt(pcs, buf, cmdsize, 0);
+    crypto1_destroy(pcs);
+
+    if (CheckCrypto1Parity(cmd, cmdsize, buf, parity) && check_crc(CRC_14443_A, buf, cmdsize)) {
+        ad->ks2 = ks2;
+        ad->ks3 = ks3;
+        ad->nt = ntx;
+        return true;
+    }
+    return false;
+}
+
+// weak prng, walk the nonces following ad->nt. On success nt, ks2 and ks3 of ad are set
+static bool nested_check_prng(TAuthData *ad, uint8_t *cmd, uint8_t cmdsize, uint8_t *parity) {
+    uint32_t ntx = prng_successor(ad->nt, 90);
+    for (int i = 0; i < 16383; i++) {
+        ntx = prng_successor(ntx, 1);
+        if (NTParityChk(ad, ntx) && nested_check_nt(ad, ntx, cmd, cmdsize, parity))
+            return true;
+    }
+    return false;
+}
+
+bool NestedCheckKey(uint64_t key, TAuthData *ad, uint8_t *cmd, uint8_t cmdsize, uint8_t *parity) {
+    AuthData.ks2 = 0;
+    AuthData.ks3 = 0;
+    return nested_check_key(key, ad, cmd, cmdsize, parity);
+}
+
+// Same as NestedCheckKey over a key list, returns the index of the first valid
+// key or -1. The auth keystream of all keys is computed bitsliced, only keys
+// giving the right ar and at go through NestedCheckKey.
+int NestedCheckKeys(const uint64_t *keys, uint32_t keycnt, TAuthData *ad, uint8_t *cmd, uint8_t cmdsize, uint8_t *parity) {
+
+    AuthData.ks2 = 0;
+    AuthData.ks3 = 0;
+
+    struct Crypto1State *states = calloc(keycnt, sizeof(struct Crypto1State));
+    uint32_t *ks = calloc(keycnt * 4, sizeof(uint32_t));
+    if (states == NULL || ks == NULL) {
+        free(states);
+        free(ks);
+        for (uint32_t i = 0; i < keycnt; i++) {
+            if (NestedCheckKey(keys[i], ad, cmd, cmdsize, parity))
+                return i;
+        }
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < keycnt; i++)
+        crypto1_init(&states[i], keys[i]);
+
+    int res = nested_check_keys(states, keys, keycnt, ks, ad, cmd, cmdsize, parity);
+
+    free(states);
+    free(ks);
+    return res;
+}
+
 bool CheckCrypto1Parity(uint8_t *cmd_enc, uint8_t cmdsize, uint8_t *cmd, uint8_t *parity_enc) {
     for (int i = 0; i < cmdsize - 1; i++) {
         if (oddparity8(cmd[i]) ^ (cmd[i + 1] & 0x01) ^ ((parity_enc[i / 8] >> (7 - i % 8)) & 0x01) ^ (cmd_enc[i + 1] & 0x01))
@@ -1554,3 +1400,348 @@ uint64_t GetCrypto1ProbableKey(TAuthData *ad) {
     crypto1_destroy(revstate);
     return key;
 }
+
+void ClearMifareKeyCache(void) {
+    free(mf_auths);
+    free(mf_auths_order);
+    mf_auths = NULL;
+    mf_auths_order = NULL;
+    mf_auths_cnt = 0;
+    mf_auths_cap = 0;
+    memset(&mf_scan, 0, sizeof(mf_scan));
+}
+
+void CollectMifareAuth(uint8_t *cmd, uint8_t cmdsize, uint8_t *parity, bool isResponse) {
+
+    // the first frame after an authentication, same rule as DecodeMifareData
+    if (mf_scan.step == 4) {
+        if (cmdsize > 32)
+            return;
+
+        mf_scan.step = 0;
+        if (mf_scan.plain) {
+            mf_scan.first_nt = mf_scan.ad.nt;
+            mf_scan.have_first = true;
+        }
+
+        if (mf_auths_cnt == mf_auths_cap) {
+            uint32_t cap = mf_auths_cap ? mf_auths_cap * 2 : 256;
+            mf_cached_auth_t *tmp = realloc(mf_auths, cap * sizeof(mf_cached_auth_t));
+            if (tmp == NULL)
+                return;
+            mf_auths = tmp;
+            mf_auths_cap = cap;
+        }
+        mf_cached_auth_t *a = &mf_auths[mf_auths_cnt++];
+        memset(a, 0, sizeof(mf_cached_auth_t));
+        a->ad = mf_scan.ad;
+        a->ad.nt = mf_scan.first_nt;
+        a->first = mf_scan.plain;
+        a->cmdsize = cmdsize;
+        memcpy(a->cmd, cmd, cmdsize);
+        memcpy(a->parity, parity, (cmdsize - 1) / 8 + 1);
+
+        // it may be the auth command of a nested one right away
+        if (isResponse == false && cmdsize == 4) {
+            mf_scan.plain = false;
+            mf_scan.step = 1;
+        }
+        return;
+    }
+
+    if (isResponse == false) {
+        if (cmdsize == 1) {
+            mf_scan.step = 0;
+            return;
+        }
+
+        if (cmdsize == 9 && cmd[1] == 0x70 && (cmd[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT ||
+                                               cmd[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT_2 ||
+                                               cmd[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT_3)) {
+            memset(&mf_scan, 0, sizeof(mf_scan));
+            mf_scan.ad.uid = bytes_to_num(&cmd[2], 4);
+            return;
+        }
+
+        if (cmdsize == 4) {
+            // after the first auth everything is encrypted, any 4 byte frame may start a nested one
+            if (mf_scan.have_first) {
+                mf_scan.plain = false;
+                mf_scan.step = 1;
+                return;
+            }
+            if ((cmd[0] == MIFARE_AUTH_KEYA || cmd[0] == MIFARE_AUTH_KEYB) && check_crc(CRC_14443_A, cmd, cmdsize)) {
+                mf_scan.plain = true;
+                mf_scan.step = 1;
+                return;
+            }
+        }
+
+        if (cmdsize == 8 && mf_scan.step == 2) {
+            mf_scan.ad.nr_enc = bytes_to_num(cmd, 4);
+            mf_scan.ad.ar_enc = bytes_to_num(&cmd[4], 4);
+            mf_scan.ad.ar_enc_par = parity[0] << 4;
+            mf_scan.step = 3;
+            return;
+        }
+    } else if (cmdsize == 4) {
+        if (mf_scan.step == 1) {
+            if (mf_scan.plain) {
+                mf_scan.ad.nt = bytes_to_num(cmd, 4);
+            } else {
+                mf_scan.ad.nt_enc = bytes_to_num(cmd, 4);
+                mf_scan.ad.nt_enc_par = parity[0];
+            }
+            mf_scan.step = 2;
+            return;
+        }
+        if (mf_scan.step == 3) {
+            mf_scan.ad.at_enc = bytes_to_num(cmd, 4);
+            mf_scan.ad.at_enc_par = parity[0];
+            mf_scan.step = 4;
+            return;
+        }
+    }
+
+    mf_scan.step = 0;
+}
+
+// the nonce of a nested auth depends on the key, only the tag sent nt_enc counts
+static int cached_auth_cmp(const mf_cached_auth_t *a, const TAuthData *ad, bool first, const uint8_t *cmd, uint8_t cmdsize) {
+    const uint32_t x[] = { a->first, a->ad.uid, a->first ? a->ad.nt : a->ad.nt_enc, a->ad.nr_enc, a->ad.ar_enc, a->ad.at_enc, a->cmdsize };
+    const uint32_t y[] = { first, ad->uid, first ? ad->nt : ad->nt_enc, ad->nr_enc, ad->ar_enc, ad->at_enc, cmdsize };
+    for (int i = 0; i < ARRAYLEN(x); i++) {
+        if (x[i] != y[i])
+            return (x[i] < y[i]) ? -1 : 1;
+    }
+    return memcmp(a->cmd, cmd, cmdsize);
+}
+
+static int cached_auth_order_cmp(const void *a, const void *b) {
+    const mf_cached_auth_t *pb = &mf_auths[*(const uint32_t *)b];
+    return cached_auth_cmp(&mf_auths[*(const uint32_t *)a], &pb->ad, pb->first, pb->cmd, pb->cmdsize);
+}
+
+static const mf_cached_auth_t *find_cached_auth(const TAuthData *ad, bool first, const uint8_t *cmd, uint8_t cmdsize) {
+    if (mf_auths_order == NULL)
+        return NULL;
+
+    uint32_t lo = 0, hi = mf_auths_cnt;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        int c = cached_auth_cmp(&mf_auths[mf_auths_order[mid]], ad, first, cmd, cmdsize);
+        if (c == 0)
+            return &mf_auths[mf_auths_order[mid]];
+        if (c < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return NULL;
+}
+
+// the key list shared by the search threads
+static struct {
+    const uint64_t *keys;
+    struct Crypto1State *states;
+    uint32_t keycnt;
+    bool prng;
+    uint32_t next;
+    uint32_t count;
+} mf_search;
+
+static void *search_keys_thread(void *arg) {
+    (void)arg;
+    uint32_t *ks = calloc(mf_search.keycnt * 4 + 1, sizeof(uint32_t));
+    if (ks == NULL)
+        return NULL;
+
+    for (;;) {
+        uint32_t i = __atomic_fetch_add(&mf_search.next, 1, __ATOMIC_RELAXED);
+        if (i >= mf_search.count)
+            break;
+
+        mf_cached_auth_t *a = &mf_auths[i];
+        if (a->found != mfkNotFound)
+            continue;
+
+        TAuthData ad = a->ad;
+        if (a->first) {
+            ad.ks2 = ad.ar_enc ^ prng_successor(ad.nt, 64);
+            ad.ks3 = ad.at_enc ^ prng_successor(ad.nt, 96);
+            a->found = mfkKey;
+            a->key = GetCrypto1ProbableKey(&ad);
+            a->nt = ad.nt;
+            a->ks2 = ad.ks2;
+            a->ks3 = ad.ks3;
+            continue;
+        }
+
+        int k = nested_check_keys(mf_search.states, mf_search.keys, mf_search.keycnt, ks, &ad, a->cmd, a->cmdsize, a->parity);
+        if (k >= 0) {
+            a->found = mfkKey;
+            a->key = mf_search.keys[k];
+        } else if (mf_search.prng && validate_prng_nonce(ad.nt) && nested_check_prng(&ad, a->cmd, a->cmdsize, a->parity)) {
+            a->found = mfkNested;
+            a->key = GetCrypto1ProbableKey(&ad);
+        } else {
+            continue;
+        }
+        a->nt = ad.nt;
+        a->ks2 = ad.ks2;
+        a->ks3 = ad.ks3;
+    }
+    free(ks);
+    return NULL;
+}
+
+static void run_threads(void *(*fn)(void *), void *arg, uint32_t count) {
+    int n = num_CPUs();
+    if ((uint32_t)n > count)
+        n = count;
+    if (n < 1)
+        n = 1;
+
+    mf_search.next = 0;
+    mf_search.count = count;
+
+    pthread_t thread_id[n];
+    int started = 0;
+    for (; started < n; started++) {
+        if (pthread_create(&thread_id[started], NULL, fn, arg) != 0)
+            break;
+    }
+    // no thread at all, do it here
+    if (started == 0)
+        fn(arg);
+
+    for (int i = 0; i < started; i++)
+        pthread_join(thread_id[i], NULL);
+}
+
+static int search_keys(const uint64_t *keys, uint32_t keycnt, bool prng) {
+    mf_search.keys = keys;
+    mf_search.keycnt = keycnt;
+    mf_search.prng = prng;
+    mf_search.states = calloc(keycnt + 1, sizeof(struct Crypto1State));
+    if (mf_search.states == NULL)
+        return PM3_EMALLOC;
+
+    for (uint32_t i = 0; i < keycnt; i++)
+        crypto1_init(&mf_search.states[i], keys[i]);
+
+    run_threads(search_keys_thread, NULL, mf_auths_cnt);
+
+    free(mf_search.states);
+    mf_search.states = NULL;
+    return PM3_SUCCESS;
+}
+
+static bool nonce_brute_found(const nonce_brute_result_t *res, void *arg) {
+    mf_cached_auth_t *a = (mf_cached_auth_t *)arg;
+    TAuthData ad = a->ad;
+    if (nested_check_nt(&ad, res->nt, a->cmd, a->cmdsize, a->parity) == false)
+        return false;
+
+    a->found = mfkNested;
+    a->key = res->key;
+    a->nt = ad.nt;
+    a->ks2 = ad.ks2;
+    a->ks3 = ad.ks3;
+    return true;
+}
+
+// weak prng but too far from the nonce of the first auth for nested_check_prng,
+// try the whole nonce space on the parity bits
+static uint32_t search_nonces(void) {
+    uint32_t found = 0;
+    for (uint32_t i = 0; i < mf_auths_cnt; i++) {
+        mf_cached_auth_t *a = &mf_auths[i];
+        if (a->first || a->found != mfkNotFound || a->cmdsize == 0 || validate_prng_nonce(a->ad.nt) == false)
+            continue;
+
+        nonce_brute_params_t p = {
+            .uid = a->ad.uid,
+            .nt_enc = a->ad.nt_enc,
+            .nr_enc = a->ad.nr_enc,
+            .ar_enc = a->ad.ar_enc,
+            .at_enc = a->ad.at_enc,
+            .nt_par = a->ad.nt_enc_par,
+            .ar_par = a->ad.ar_enc_par,
+            .at_par = a->ad.at_enc_par,
+            .has_cmd = (a->cmdsize == 4),
+            .cmd_enc = (a->cmdsize == 4) ? bytes_to_num(a->cmd, 4) : 0,
+        };
+        nonce_brute_run(&p, num_CPUs(), NULL, nonce_brute_found, a);
+        if (a->found != mfkNotFound)
+            found++;
+    }
+    return found;
+}
+
+static int u64_cmp(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Searches the keys of every authentication collected by CollectMifareAuth.
+// Nested ones try the default keys and dict first, then the weak prng nonces,
+// the keys recovered from any other authentication of the trace, at last the
+// whole nonce space of a weak prng.
+// Returns the number of authentications with a key.
+uint32_t SearchMifareKeys(const uint64_t *dict, uint32_t dictcnt) {
+    if (mf_auths_cnt == 0)
+        return 0;
+
+    // the bitsliced kernel is picked on first use, do it before the threads start
+    crypto1_bs_simd();
+
+    uint32_t keycnt = ARRAYLEN(g_mifare_default_keys) + dictcnt;
+    uint64_t *keys = calloc(keycnt + mf_auths_cnt, sizeof(uint64_t));
+    if (keys == NULL)
+        return 0;
+
+    memcpy(keys, g_mifare_default_keys, sizeof(g_mifare_default_keys));
+    if (dictcnt)
+        memcpy(keys + ARRAYLEN(g_mifare_default_keys), dict, dictcnt * sizeof(uint64_t));
+
+    search_keys(keys, keycnt, true);
+
+    // keys of the whole trace, the dictionary is done with
+    uint32_t n = 0;
+    uint32_t found = 0;
+    for (uint32_t i = 0; i < mf_auths_cnt; i++) {
+        if (mf_auths[i].found != mfkNotFound) {
+            keys[n++] = mf_auths[i].key;
+            found++;
+        }
+    }
+
+    if (found < mf_auths_cnt && n) {
+        qsort(keys, n, sizeof(uint64_t), u64_cmp);
+        uint32_t m = 1;
+        for (uint32_t i = 1; i < n; i++) {
+            if (keys[i] != keys[m - 1])
+                keys[m++] = keys[i];
+        }
+        search_keys(keys, m, false);
+
+        found = 0;
+        for (uint32_t i = 0; i < mf_auths_cnt; i++) {
+            if (mf_auths[i].found != mfkNotFound)
+                found++;
+        }
+    }
+    free(keys);
+
+    if (found < mf_auths_cnt)
+        found += search_nonces();
+
+    mf_auths_order = calloc(mf_auths_cnt, sizeof(uint32_t));
+    if (mf_auths_order) {
+        for (uint32_t i = 0; i < mf_auths_cnt; i++)
+            mf_auths_order[i] = i;
+        qsort(mf_auths_order, mf_auths_cnt, sizeof(uint32_t), cached_auth_order_cmp);
+    }
+    return found;
+}
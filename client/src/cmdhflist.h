@@ -54,7 +54,12 @@ void annotateCryptoRF(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize);
 bool DecodeMifareData(uint8_t *cmd, uint8_t cmdsize, uint8_t *parity, bool isResponse, uint8_t *mfData, size_t *mfDataLen);
 bool NTParityChk(TAuthData *ad, uint32_t ntx);
 bool NestedCheckKey(uint64_t key, TAuthData *ad, uint8_t *cmd, uint8_t cmdsize, uint8_t *parity);
+int NestedCheckKeys(const uint64_t *keys, uint32_t keycnt, TAuthData *ad, uint8_t *cmd, uint8_t cmdsize, uint8_t *parity);
 bool CheckCrypto1Parity(uint8_t *cmd_enc, uint8_t cmdsize, uint8_t *cmd, uint8_t *parity_enc);
 uint64_t GetCrypto1ProbableKey(TAuthData *ad);
 
+void ClearMifareKeyCache(void);
+void CollectMifareAuth(uint8_t *cmd, uint8_t cmdsize, uint8_t *parity, bool isResponse);
+uint32_t SearchMifareKeys(const uint64_t *dict, uint32_t dictcnt);
+
 #endif // CMDHFLIST
@@ -212,63 +212,52 @@ static int CmdHfLTOList(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
-static int lto_rdbl(uint8_t blk, uint8_t *block_responce, uint8_t *block_cnt_responce, bool verbose) {
+// reads blocks st_blk..end_blk in one transaction on the device, the select included. The 32 byte
+// blocks go to data, blocks gets how many there are. It reads up to the first failing one
+static int lto_rdbl_device(uint8_t st_blk, uint8_t end_blk, uint8_t *data, uint16_t *blocks, bool verbose) {
+    lto_dump_req_t req = {st_blk, end_blk};
+    *blocks = 0;
 
-    uint16_t resp_len = 18;
-    uint8_t rdbl_cmd[] = {0x30, blk};
-    uint8_t rdbl_cnt_cmd[] = {0x80};
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_LTO_DUMP, (uint8_t *)&req, sizeof(req));
 
-    int status = lto_send_cmd_raw(rdbl_cmd, sizeof(rdbl_cmd), block_responce, &resp_len, true, false, verbose);
-    if (status == PM3_ETIMEOUT || status == PM3_ESOFT) {
-        return PM3_EWRONGANSWER; // READ BLOCK failed
-    }
+    while (true) {
+        PacketResponseNG resp;
+        if (!WaitForResponseTimeout(CMD_HF_LTO_DUMP, &resp, 2500)) {
+            if (verbose) PrintAndLogEx(WARNING, "timeout while waiting for reply.");
+            return PM3_ETIMEOUT;
+        }
 
-    status = lto_send_cmd_raw(rdbl_cnt_cmd, sizeof(rdbl_cnt_cmd), block_cnt_responce, &resp_len, false, false, verbose);
-    if (status == PM3_ETIMEOUT || status == PM3_ESOFT) {
-        return PM3_EWRONGANSWER; // READ BLOCK CONTINUE failed
-    }
+        lto_dump_frame_t *frame = (lto_dump_frame_t *)resp.data.asBytes;
+        if (frame->first == st_blk + *blocks && frame->first + frame->count <= end_blk + 1) {
+            memcpy(data + *blocks * LTO_BLOCK_SIZE, frame->data, frame->count * LTO_BLOCK_SIZE);
+            *blocks += frame->count;
+        }
 
-    return PM3_SUCCESS;
+        if (frame->final) {
+            if (resp.status != PM3_SUCCESS && verbose)
+                PrintAndLogEx(WARNING, "reading stopped at block %03u", st_blk + *blocks);
+            return resp.status;
+        }
+    }
 }
 
 int rdblLTO(uint8_t st_blk, uint8_t end_blk, bool verbose) {
 
-    clearCommandBuffer();
-    lto_switch_on_field();
-
-    uint8_t serial_number[5];
-    uint8_t serial_len = sizeof(serial_number);
-    uint8_t type_info[2];
-    int ret_val = lto_select(serial_number, serial_len, type_info, verbose);
-
-    if (ret_val != PM3_SUCCESS) {
-        lto_switch_off_field();
-        return ret_val;
+    uint16_t blocks = 0;
+    uint8_t *data = calloc((end_blk - st_blk + 1) * LTO_BLOCK_SIZE, sizeof(uint8_t));
+    if (data == NULL) {
+        PrintAndLogEx(ERR, "error, cannot allocate memory");
+        return PM3_EMALLOC;
     }
 
-    uint8_t block_data_d00_d15[18];
-    uint8_t block_data_d16_d31[18];
-    uint8_t block_data[32];
+    int ret_val = lto_rdbl_device(st_blk, end_blk, data, &blocks, verbose);
 
-    for (uint8_t i = st_blk; i < end_blk + 1; i++) {
-
-        ret_val = lto_rdbl(i, block_data_d00_d15,  block_data_d16_d31, verbose);
-
-        if (ret_val == PM3_SUCCESS) {
-            //Remove CRCs
-            for (int t = 0; t < 16; t++) {
-                block_data[t] = block_data_d00_d15[t];
-                block_data[t + 16] = block_data_d16_d31[t];
-            }
-
-            PrintAndLogEx(SUCCESS, "BLK %03d: " _YELLOW_("%s"), i, sprint_hex_inrow(block_data, sizeof(block_data)));
-        } else {
-            lto_switch_off_field();
-            return ret_val;
-        }
+    for (uint16_t i = 0; i < blocks; i++) {
+        PrintAndLogEx(SUCCESS, "BLK %03d: " _YELLOW_("%s"), st_blk + i, sprint_hex_inrow(data + i * LTO_BLOCK_SIZE, LTO_BLOCK_SIZE));
     }
 
-    lto_switch_off_field();
+    free(data);
     return ret_val;
 }
 
@@ -425,39 +414,8 @@ static int CmdHfLTOWriteBlock(const char *Cmd) {
 }
 
 int dumpLTO(uint8_t *dump, bool verbose) {
-
-    clearCommandBuffer();
-    lto_switch_on_field();
-
-    uint8_t serial_number[5];
-    uint8_t serial_len = sizeof(serial_number);
-    uint8_t type_info[2];
-    int ret_val = lto_select(serial_number, serial_len, type_info, verbose);
-
-    if (ret_val != PM3_SUCCESS) {
-        lto_switch_off_field();
-        return ret_val;
-    }
-
-    uint8_t block_data_d00_d15[18];
-    uint8_t block_data_d16_d31[18];
-
-    for (uint8_t i = 0; i < 255; i++) {
-
-        ret_val = lto_rdbl(i, block_data_d00_d15,  block_data_d16_d31, verbose);
-
-        if (ret_val == PM3_SUCCESS) {
-            // remove CRCs
-            memcpy(dump + i * 32, block_data_d00_d15, 16);
-            memcpy(dump + (i * 32) + 16, block_data_d16_d31, 16);
-        } else {
-            lto_switch_off_field();
-            return ret_val;
-        }
-    }
-
-    lto_switch_off_field();
-    return ret_val;
+    uint16_t blocks = 0;
+    return lto_rdbl_device(0, 254, dump, &blocks, verbose);
 }
 
 static int CmdHfLTODump(const char *Cmd) {
@@ -517,38 +475,35 @@ static int CmdHfLTODump(const char *Cmd) {
 
 int restoreLTO(uint8_t *dump, bool verbose) {
 
-    clearCommandBuffer();
-    lto_switch_on_field();
-
-    uint8_t type_info[2];
-    uint8_t serial_number[5];
-    uint8_t serial_len = sizeof(serial_number);
-    int ret_val = lto_select(serial_number, serial_len, type_info, verbose);
-
-    if (ret_val != PM3_SUCCESS) {
-        lto_switch_off_field();
-        return ret_val;
-    }
-
-    uint8_t block_data[32] = {0};
+    lto_restore_req_t req;
 
     //Block address 0 and 1 are read-only
-    for (uint8_t blk = 2; blk < 255; blk++) {
-
-        memcpy(block_data, dump + (blk * 32), 32);
+    for (uint16_t blk = 2; blk < 255; blk += LTO_FRAME_BLOCKS) {
+
+        req.first = blk;
+        req.count = MIN(LTO_FRAME_BLOCKS, 255 - blk);
+        memcpy(req.data, dump + (blk * LTO_BLOCK_SIZE), req.count * LTO_BLOCK_SIZE);
+
+        clearCommandBuffer();
+        SendCommandNG(CMD_HF_LTO_RESTORE, (uint8_t *)&req, 2 + req.count * LTO_BLOCK_SIZE);
+        PacketResponseNG resp;
+        if (!WaitForResponseTimeout(CMD_HF_LTO_RESTORE, &resp, 5000)) {
+            if (verbose) PrintAndLogEx(WARNING, "timeout while waiting for reply.");
+            return PM3_ETIMEOUT;
+        }
 
-        ret_val = lto_wrbl(blk, block_data, verbose);
+        uint8_t written = resp.data.asBytes[0];
+        for (uint8_t i = 0; i < written; i++) {
+            PrintAndLogEx(SUCCESS, "Block %03d - " _YELLOW_("write success"), blk + i);
+        }
 
-        if (ret_val == PM3_SUCCESS) {
-            PrintAndLogEx(SUCCESS, "Block %03d - " _YELLOW_("write success"), blk);
-        } else {
-            lto_switch_off_field();
-            return ret_val;
+        if (resp.status != PM3_SUCCESS) {
+            if (verbose) PrintAndLogEx(WARNING, "Block %03d - write error", blk + written);
+            return resp.status;
         }
     }
 
-    lto_switch_off_field();
-    return ret_val;
+    return PM3_SUCCESS;
 }
 
 static int CmdHfLTRestore(const char *Cmd) {
@@ -18,12 +18,15 @@
 #include "cmdtrace.h"
 #include "emv/dump.h"
 #include "mifare/mifaredefault.h"          // mifare default key array
+#include "mifare/mfkeycache.h"   // key cache
 #include "cliparser.h"           // argtable
 #include "hardnested_bf_core.h" // SetSIMDInstr
 #include "mifare/mad.h"
 #include "mifare/ndef.h"
 #include "protocols.h"
 #include "util_posix.h"  // msclock
+#include "util.h"        // num_CPUs
+#include <pthread.h>
 #include "cmdhfmfhard.h"
 
 #define MFBLOCK_SIZE 16
@@ -152,6 +155,7 @@ static int usage_hf14_hardnested(void) {
     PrintAndLogEx(NORMAL, "      hf mf hardnested <block number> <key A|B> <key (12 hex symbols)>");
     PrintAndLogEx(NORMAL, "                       <target block number> <target key A|B> [known target key (12 hex symbols)] [w] [s]");
     PrintAndLogEx(NORMAL, "  or  hf mf hardnested r [known target key]");
+    PrintAndLogEx(NORMAL, "  or  hf mf hardnested b [runs] [f <json file>] [i <X>]");
     PrintAndLogEx(NORMAL, "");
     PrintAndLogEx(NORMAL, "Options:");
     PrintAndLogEx(NORMAL, "      h         this help");
@@ -161,6 +165,9 @@ static int usage_hf14_hardnested(void) {
     PrintAndLogEx(NORMAL, "      u <UID>   read/write hf-mf-<UID>-nonces.bin instead of default name");
     PrintAndLogEx(NORMAL, "      f <name>  read/write <name> instead of default name");
     PrintAndLogEx(NORMAL, "      t         tests?");
+    PrintAndLogEx(NORMAL, "      b [runs]  benchmark every SIMD core (only <X> with i) for 1 .. all threads, then time the stages of");
+    PrintAndLogEx(NORMAL, "                [runs] simulated attacks (default 1). Results as JSON, to <json file> with f");
+    PrintAndLogEx(NORMAL, "      e <bits>  stop acquiring nonces once about 2^<bits> states are left to brute force (default 24)");
     PrintAndLogEx(NORMAL, "      i <X>     set type of SIMD instructions. Without this flag programs autodetect it.");
 #if defined(COMPILER_HAS_SIMD_AVX512)
     PrintAndLogEx(NORMAL, "        i 5   = AVX512");
@@ -170,6 +177,12 @@ static int usage_hf14_hardnested(void) {
     PrintAndLogEx(NORMAL, "        i a   = AVX");
     PrintAndLogEx(NORMAL, "        i s   = SSE2");
     PrintAndLogEx(NORMAL, "        i m   = MMX");
+#endif
+#if defined(COMPILER_HAS_SIMD_NEON)
+    PrintAndLogEx(NORMAL, "        i e   = NEON");
+#endif
+#if defined(HAVE_OPENCL)
+    PrintAndLogEx(NORMAL, "        i g   = GPU (OpenCL)");
 #endif
     PrintAndLogEx(NORMAL, "        i n   = none (use CPU regular instruction set)");
     PrintAndLogEx(NORMAL, "");
@@ -179,6 +192,7 @@ static int usage_hf14_hardnested(void) {
     PrintAndLogEx(NORMAL, _YELLOW_("      hf mf hardnested 0 A FFFFFFFFFFFF 4 A f nonces.bin w s"));
     PrintAndLogEx(NORMAL, _YELLOW_("      hf mf hardnested r"));
     PrintAndLogEx(NORMAL, _YELLOW_("      hf mf hardnested r a0a1a2a3a4a5"));
+    PrintAndLogEx(NORMAL, _YELLOW_("      hf mf hardnested b 3 f bench.json"));
     PrintAndLogEx(NORMAL, "");
     PrintAndLogEx(NORMAL, "Add the known target key to check if it is present in the remaining key space:");
     PrintAndLogEx(NORMAL, _YELLOW_("      hf mf hardnested 0 A A0A1A2A3A4A5 4 A FFFFFFFFFFFF"));
@@ -217,6 +231,12 @@ static int usage_hf14_autopwn(void) {
     PrintAndLogEx(NORMAL, "        i s   = SSE2");
 #endif
     PrintAndLogEx(NORMAL, "        i m   = MMX");
+#if defined(COMPILER_HAS_SIMD_NEON)
+    PrintAndLogEx(NORMAL, "        i e   = NEON");
+#endif
+#if defined(HAVE_OPENCL)
+    PrintAndLogEx(NORMAL, "        i g   = GPU (OpenCL)");
+#endif
     PrintAndLogEx(NORMAL, "        i n   = none (use CPU regular instruction set)");
     PrintAndLogEx(NORMAL, "");
     PrintAndLogEx(NORMAL, "Examples:");
@@ -237,6 +257,7 @@ static int usage_hf14_chk(void) {
     PrintAndLogEx(NORMAL, "                4 - 4K");
     PrintAndLogEx(NORMAL, "      d    write keys to binary file");
     PrintAndLogEx(NORMAL, "      t    write keys to emulator memory\n");
+    PrintAndLogEx(NORMAL, "Duplicate keys are dropped. With " _YELLOW_("`pref set keycache on`") " keys found on this kind of card before are tried first");
     PrintAndLogEx(NORMAL, "");
     PrintAndLogEx(NORMAL, "Examples:");
     PrintAndLogEx(NORMAL, _YELLOW_("      hf mf chk 0 A 1234567890ab")"          -- target block 0, Key A using key 1234567890ab");
@@ -247,7 +268,7 @@ static int usage_hf14_chk(void) {
 }
 static int usage_hf14_chk_fast(void) {
     PrintAndLogEx(NORMAL, "This is a improved checkkeys method speedwise. It checks MIFARE Classic tags sector keys against a dictionary file with keys");
-    PrintAndLogEx(NORMAL, "Usage:  hf mf fchk [h] <card memory> [t|d|f] [<key (12 hex symbols)>] [<dic (*.dic)>]");
+    PrintAndLogEx(NORMAL, "Usage:  hf mf fchk [h] <card memory> [t|d|f] [<key (12 hex symbols)>] [<dic (*.dic)>] [s <spiffs file>]");
     PrintAndLogEx(NORMAL, "Options:");
     PrintAndLogEx(NORMAL, "      h    this help");
     PrintAndLogEx(NORMAL, "      <cardmem> all sectors based on card memory, other values than below defaults to 1k");
@@ -257,7 +278,9 @@ static int usage_hf14_chk_fast(void) {
     PrintAndLogEx(NORMAL, "                 4 - 4K");
     PrintAndLogEx(NORMAL, "      d    write keys to binary file");
     PrintAndLogEx(NORMAL, "      t    write keys to emulator memory");
-    PrintAndLogEx(NORMAL, "      m    use dictionary from flashmemory\n");
+    PrintAndLogEx(NORMAL, "      m    use dictionary from flashmemory");
+    PrintAndLogEx(NORMAL, "      s    use dictionary file in SPIFFS, the device streams it, any size (s. `mem spiffs load d`)\n");
+    PrintAndLogEx(NORMAL, "Duplicate keys are dropped. With " _YELLOW_("`pref set keycache on`") " keys found on this kind of card before are tried first");
     PrintAndLogEx(NORMAL, "");
     PrintAndLogEx(NORMAL, "Examples:");
     PrintAndLogEx(NORMAL, _YELLOW_("      hf mf fchk 1 1234567890ab")"          -- target 1K using key 1234567890ab");
@@ -266,6 +289,8 @@ static int usage_hf14_chk_fast(void) {
     PrintAndLogEx(NORMAL, _YELLOW_("      hf mf fchk 1 d")"                     -- target 1K, write to file");
     if (IfPm3Flash())
         PrintAndLogEx(NORMAL, _YELLOW_("      hf mf fchk 1 m")"                     -- target 1K, use dictionary from flashmemory");
+    if (IfPm3Flash())
+        PrintAndLogEx(NORMAL, _YELLOW_("      hf mf fchk 1 s mfc_keys.bin")"        -- target 1K, use dictionary file mfc_keys.bin in SPIFFS");
     return PM3_SUCCESS;
 }
 /*
@@ -438,9 +463,12 @@ static int usage_hf14_cload(void) {
     PrintAndLogEx(NORMAL, "It loads magic Chinese card from the file `filename.eml`");
     PrintAndLogEx(NORMAL, "or from emulator memory");
     PrintAndLogEx(NORMAL, "");
-    PrintAndLogEx(NORMAL, "Usage:  hf mf cload [h] [e] <file name w/o `.eml`>");
+    PrintAndLogEx(NORMAL, "The device writes all blocks in one magic session, a file goes through the emulator memory");
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(NORMAL, "Usage:  hf mf cload [h] [v] [e] <file name w/o `.eml`>");
     PrintAndLogEx(NORMAL, "Options:");
     PrintAndLogEx(NORMAL, "       h            this help");
+    PrintAndLogEx(NORMAL, "       v            read back and verify each block");
     PrintAndLogEx(NORMAL, "       e            load card with data from emulator memory");
     PrintAndLogEx(NORMAL, "       j <filename> load card with data from json file");
     PrintAndLogEx(NORMAL, "       b <filename> load card with data from binary file");
@@ -448,6 +476,7 @@ static int usage_hf14_cload(void) {
     PrintAndLogEx(NORMAL, "Examples:");
     PrintAndLogEx(NORMAL, _YELLOW_("       hf mf cload mydump"));
     PrintAndLogEx(NORMAL, _YELLOW_("       hf mf cload e"));
+    PrintAndLogEx(NORMAL, _YELLOW_("       hf mf cload v b mydump"));
     return PM3_SUCCESS;
 }
 static int usage_hf14_cgetblk(void) {
@@ -1034,11 +1063,38 @@ static int CmdHF14AMfDump(const char *Cmd) {
 
     fclose(f);
 
-    PrintAndLogEx(INFO, "Reading sector access bits...");
+    PrintAndLogEx(INFO, "Dumping all blocks from card...");
+
+    // the whole card in one exchange, whatever it misses is read block by block below
+    uint16_t readmask[40] = {0};
+    mfReadSectorsBulk(numSectors, keyA, keyB, (uint8_t *)carddata, readmask);
+
+    uint8_t missing = 0;
+    for (sectorNo = 0; sectorNo < numSectors; sectorNo++) {
+        for (blockNo = 0; blockNo < NumBlocksPerSector(sectorNo); blockNo++) {
+            if ((readmask[sectorNo] & (1 << blockNo)) == 0) {
+                missing++;
+                continue;
+            }
+            if (blockNo == NumBlocksPerSector(sectorNo) - 1) { // sector trailer. Fill in the keys.
+                memcpy(carddata[FirstBlockOfSector(sectorNo) + blockNo], keyA[sectorNo], 6);
+                memcpy(carddata[FirstBlockOfSector(sectorNo) + blockNo] + 10, keyB[sectorNo], 6);
+            }
+            PrintAndLogEx(SUCCESS, "successfully read block %2d of sector %2d.", blockNo, sectorNo);
+        }
+        if (readmask[sectorNo] == (uint16_t)((1 << NumBlocksPerSector(sectorNo)) - 1))
+            readmask[sectorNo] = 0xFFFF;
+    }
+
+    if (missing)
+        PrintAndLogEx(INFO, "Reading sector access bits...");
 
     uint8_t tries;
     mf_readblock_t payload;
-    for (sectorNo = 0; sectorNo < numSectors; sectorNo++) {
+    for (sectorNo = 0; sectorNo < numSectors && missing; sectorNo++) {
+        if (readmask[sectorNo] == 0xFFFF)
+            continue;
+
         for (tries = 0; tries < MIFARE_SECTOR_RETRY; tries++) {
             PrintAndLogEx(NORMAL, "." NOLF);
             fflush(stdout);
@@ -1071,14 +1127,19 @@ static int CmdHF14AMfDump(const char *Cmd) {
             }
         }
     }
-    PrintAndLogEx(NORMAL, "");
-    PrintAndLogEx(SUCCESS, "Finished reading sector access bits");
-    PrintAndLogEx(INFO, "Dumping all blocks from card...");
+    if (missing) {
+        PrintAndLogEx(NORMAL, "");
+        PrintAndLogEx(SUCCESS, "Finished reading sector access bits");
+        PrintAndLogEx(INFO, "Reading %u remaining blocks from card...", missing);
+    }
 
-    for (sectorNo = 0; sectorNo < numSectors; sectorNo++) {
+    for (sectorNo = 0; sectorNo < numSectors && missing; sectorNo++) {
         for (blockNo = 0; blockNo < NumBlocksPerSector(sectorNo); blockNo++) {
             bool received = false;
 
+            if (readmask[sectorNo] & (1 << blockNo))
+                continue;
+
             for (tries = 0; tries < MIFARE_SECTOR_RETRY; tries++) {
                 if (blockNo == NumBlocksPerSector(sectorNo) - 1) { // sector trailer. At least the Access Conditions can always be read with key A.
 
@@ -1177,7 +1238,7 @@ static int CmdHF14AMfRestore(const char *Cmd) {
     uint8_t sectorNo, blockNo;
     uint8_t keyType = 0;
     uint8_t key[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
-    uint8_t bldata[16] = {0x00};
+    uint8_t carddata[256][16];
     uint8_t keyA[40][6];
     uint8_t keyB[40][6];
     uint8_t numSectors = 16;
@@ -1270,8 +1331,7 @@ static int CmdHF14AMfRestore(const char *Cmd) {
 
     for (sectorNo = 0; sectorNo < numSectors; sectorNo++) {
         for (blockNo = 0; blockNo < NumBlocksPerSector(sectorNo); blockNo++) {
-            uint8_t data[26];
-            memcpy(data, key, 6);
+            uint8_t *bldata = carddata[FirstBlockOfSector(sectorNo) + blockNo];
             bytes_read = fread(bldata, 1, 16, fdump);
             if (bytes_read != 16) {
                 PrintAndLogEx(ERR, "File reading error " _YELLOW_("%s"), dataFilename);
@@ -1281,22 +1341,30 @@ static int CmdHF14AMfRestore(const char *Cmd) {
             }
 
             if (blockNo == NumBlocksPerSector(sectorNo) - 1) { // sector trailer
-                bldata[0]  = (keyA[sectorNo][0]);
-                bldata[1]  = (keyA[sectorNo][1]);
-                bldata[2]  = (keyA[sectorNo][2]);
-                bldata[3]  = (keyA[sectorNo][3]);
-                bldata[4]  = (keyA[sectorNo][4]);
-                bldata[5]  = (keyA[sectorNo][5]);
-                bldata[10] = (keyB[sectorNo][0]);
-                bldata[11] = (keyB[sectorNo][1]);
-                bldata[12] = (keyB[sectorNo][2]);
-                bldata[13] = (keyB[sectorNo][3]);
-                bldata[14] = (keyB[sectorNo][4]);
-                bldata[15] = (keyB[sectorNo][5]);
+                memcpy(bldata, keyA[sectorNo], 6);
+                memcpy(bldata + 10, keyB[sectorNo], 6);
             }
+        }
+    }
+    fclose(fdump);
+
+    // whole sectors per exchange, block by block only if the device doesn't know the command
+    uint16_t writemask[40] = {0};
+    int res = mfWriteSectorsBulk(numSectors, keyType, key, (uint8_t *)carddata, writemask);
+
+    for (sectorNo = 0; sectorNo < numSectors; sectorNo++) {
+        for (blockNo = 0; blockNo < NumBlocksPerSector(sectorNo); blockNo++) {
+            uint8_t *bldata = carddata[FirstBlockOfSector(sectorNo) + blockNo];
 
             PrintAndLogEx(NORMAL, "Writing to block %3d: %s", FirstBlockOfSector(sectorNo) + blockNo, sprint_hex(bldata, 16));
 
+            if (res == PM3_SUCCESS || (writemask[sectorNo] & (1 << blockNo))) {
+                PrintAndLogEx(SUCCESS, "isOk:%02x", (writemask[sectorNo] >> blockNo) & 1);
+                continue;
+            }
+
+            uint8_t data[26];
+            memcpy(data, key, 6);
             memcpy(data + 10, bldata, 16);
             clearCommandBuffer();
             SendCommandMIX(CMD_HF_MIFARE_WRITEBL, FirstBlockOfSector(sectorNo) + blockNo, keyType, 0, data, sizeof(data));
@@ -1310,7 +1378,6 @@ static int CmdHF14AMfRestore(const char *Cmd) {
             }
         }
     }
-    fclose(fdump);
     PrintAndLogEx(INFO, "Finish restore");
     return PM3_SUCCESS;
 }
@@ -1800,7 +1867,10 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
     bool nonce_file_read = false;
     bool nonce_file_write = false;
     bool slow = false;
+    bool benchmark = false;
+    bool all_simd = true;
     int tests = 0;
+    uint64_t bf_target = HARDNESTED_DEFAULT_TARGET;
 
     switch (tolower(param_getchar(Cmd, cmdp))) {
         case 'h':
@@ -1827,6 +1897,15 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
             }
             cmdp += 2;
             break;
+        case 'b':
+            benchmark = true;
+            tests = 1;
+            if (isdigit(param_getchar(Cmd, cmdp + 1))) {
+                tests = param_get32ex(Cmd, cmdp + 1, 1, 10);
+                cmdp++;
+            }
+            cmdp++;
+            break;
         default:
             if (param_getchar(Cmd, cmdp) == 0x00) {
                 PrintAndLogEx(WARNING, "Block number is missing");
@@ -1895,6 +1974,16 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
                 strncpy(filename, szTemp, FILE_PATH_SIZE - 20);
                 cmdp++;
                 break;
+            case 'e': {
+                uint8_t bits = param_get8(Cmd, cmdp + 1);
+                if (bits < 16 || bits > 47) {
+                    PrintAndLogEx(WARNING, "Brute force target must be between 16 and 47 (2^16 .. 2^47 states)");
+                    return 1;
+                }
+                bf_target = 1ULL << bits;
+                cmdp++;
+                break;
+            }
             case 'i':
                 SetSIMDInstr(SIMD_AUTO);
                 ctmp = tolower(param_getchar(Cmd, cmdp + 1));
@@ -1917,6 +2006,16 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
                     case 'm':
                         SetSIMDInstr(SIMD_MMX);
                         break;
+#endif
+#if defined(COMPILER_HAS_SIMD_NEON)
+                    case 'e':
+                        SetSIMDInstr(SIMD_NEON);
+                        break;
+#endif
+#if defined(HAVE_OPENCL)
+                    case 'g':
+                        SetSIMDInstr(SIMD_OPENCL);
+                        break;
 #endif
                     case 'n':
                         SetSIMDInstr(SIMD_NONE);
@@ -1925,6 +2024,7 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
                         PrintAndLogEx(WARNING, "Unknown SIMD type. %c", ctmp);
                         return 1;
                 }
+                all_simd = false;
                 cmdp += 2;
                 break;
             default:
@@ -1935,6 +2035,10 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
         cmdp++;
     }
 
+    if (benchmark) {
+        return mfnestedhard_benchmark(tests, all_simd, filename);
+    }
+
     if (!know_target_key && nonce_file_read == false) {
 
         // check if tag doesn't have static nonce
@@ -1964,7 +2068,9 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
                   tests);
 
     uint64_t foundkey = 0;
+    mfnestedhard_set_target(bf_target);
     int16_t isOK = mfnestedhard(blockNo, keyType, key, trgBlockNo, trgKeyType, know_target_key ? trgkey : NULL, nonce_file_read, nonce_file_write, slow, tests, &foundkey, filename);
+    mfnestedhard_set_target(HARDNESTED_DEFAULT_TARGET);
 
     if (tests == 0)
         DropField();
@@ -1985,13 +2091,356 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
     return 0;
 }
 
+// tries a key found on all the keys still unknown, the fast check returns false keys, so one by one
+static void autopwn_reuse_key(sector_t *e_sector, uint8_t sectors_cnt, uint8_t *key) {
+    uint64_t key64 = 0;
+    for (int i = 0; i < sectors_cnt; i++) {
+        for (int j = 0; j < 2; j++) {
+            // Check if the sector key is already broken
+            if (e_sector[i].foundKey[j])
+                continue;
+
+            // Check if the key works
+            if (mfCheckKeys(FirstBlockOfSector(i), j, true, 1, key, &key64) == PM3_SUCCESS) {
+                e_sector[i].Key[j] = bytes_to_num(key, 6);
+                e_sector[i].foundKey[j] = 'R';
+                PrintAndLogEx(SUCCESS, "target sector:%3u key type: %c -- found valid key [ " _GREEN_("%s") "]",
+                              i,
+                              j ? 'B' : 'A',
+                              sprint_hex(key, 6)
+                             );
+            }
+        }
+    }
+}
+
+// reads the B key out of the sector trailer with the A key, when the access rights allow it
+static bool autopwn_read_keyb(sector_t *e_sector, uint8_t sector, bool verbose) {
+    if (verbose) {
+        PrintAndLogEx(INFO, "======================= " _YELLOW_("START READ B KEY ATTACK") " =======================");
+        PrintAndLogEx(INFO, "reading  B  key: sector: %3d key type: %c", sector, 'B');
+    }
+
+    mf_readblock_t payload;
+    payload.blockno = FirstBlockOfSector(sector) + NumBlocksPerSector(sector) - 1;
+    payload.keytype = 0;
+    num_to_bytes(e_sector[sector].Key[0], 6, payload.key); // KEY A
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_MIFARE_READBL, (uint8_t *)&payload, sizeof(mf_readblock_t));
+
+    PacketResponseNG resp;
+    if (WaitForResponseTimeout(CMD_HF_MIFARE_READBL, &resp, 1500) == false || resp.status != PM3_SUCCESS)
+        return false;
+
+    uint64_t key64 = bytes_to_num(resp.data.asBytes + 10, 6);
+    if (key64 == 0) {
+        if (verbose) {
+            PrintAndLogEx(WARNING, "unknown  B  key: sector: %3d key type: %c", sector, 'B');
+            PrintAndLogEx(INFO, " -- reading the B key was not possible, maybe due to access rights?");
+        }
+        return false;
+    }
+
+    uint8_t key[6];
+    num_to_bytes(key64, 6, key);
+    e_sector[sector].foundKey[1] = 'A';
+    e_sector[sector].Key[1] = key64;
+    PrintAndLogEx(SUCCESS, "target sector:%3u key type: %c -- found valid key [ " _GREEN_("%s") "]",
+                  sector,
+                  'B',
+                  sprint_hex(key, sizeof(key))
+                 );
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// autopwn nested planner
+//
+// The nonces of a nested attack are collected on the device, the key
+// candidates are recovered from them on the host. The planner keeps the
+// device busy with the nonces of the next key while the candidates of the
+// previous ones are recovered, checks the candidates when they are ready and
+// tries each key found on all the keys still unknown before anything else.
+//-----------------------------------------------------------------------------
+#define AUTOPWN_JOBS    2   // recoveries in flight, each one runs two threads
+
+typedef enum {
+    AUTOPWN_KEY_OPEN,
+    AUTOPWN_KEY_RECOVERING,
+    AUTOPWN_KEY_FAILED,
+} autopwn_key_state_t;
+
+typedef enum {
+    AUTOPWN_JOB_FREE,
+    AUTOPWN_JOB_RUNNING,
+    AUTOPWN_JOB_DONE,
+} autopwn_job_state_t;
+
+typedef struct autopwn_plan_s autopwn_plan_t;
+
+typedef struct {
+    autopwn_plan_t *plan;
+    autopwn_job_state_t state;
+    pthread_t thread;
+    bool threaded;
+    uint8_t sector;
+    uint8_t keytype;
+    nested_nonces_t nn;
+    int res;
+} autopwn_job_t;
+
+struct autopwn_plan_s {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    autopwn_job_t jobs[AUTOPWN_JOBS];
+    sector_t *e_sector;
+    uint8_t sectors_cnt;
+    uint8_t *state;     // autopwn_key_state_t, two a sector
+    uint8_t *retries;   // two a sector
+};
+
+static void *autopwn_recover_thread(void *arg) {
+    autopwn_job_t *job = (autopwn_job_t *)arg;
+    int res = mfnested_recover(&job->nn);
+
+    pthread_mutex_lock(&job->plan->lock);
+    job->res = res;
+    job->state = AUTOPWN_JOB_DONE;
+    pthread_cond_signal(&job->plan->cond);
+    pthread_mutex_unlock(&job->plan->lock);
+    return NULL;
+}
+
+// the live status, one line for each key that changes
+static void autopwn_plan_status(autopwn_plan_t *plan, uint8_t sector, uint8_t keytype, const char *what) {
+    uint32_t found = 0, recovering = 0;
+    for (uint8_t i = 0; i < plan->sectors_cnt; i++) {
+        for (uint8_t j = 0; j < 2; j++) {
+            if (plan->e_sector[i].foundKey[j])
+                found++;
+            else if (plan->state[i * 2 + j] == AUTOPWN_KEY_RECOVERING)
+                recovering++;
+        }
+    }
+    PrintAndLogEx(INFO, "sector:%3u key type: %c -- %-22s [ " _YELLOW_("%u") "/%u keys, %u recovering ]",
+                  sector,
+                  keytype ? 'B' : 'A',
+                  what,
+                  found,
+                  plan->sectors_cnt * 2,
+                  recovering
+                 );
+}
+
+// checks the candidates of a finished recovery on the device, or drops them when stopping
+static int autopwn_plan_finish(autopwn_plan_t *plan, autopwn_job_t *job, bool stop) {
+    if (job->threaded)
+        pthread_join(job->thread, NULL);
+
+    uint8_t s = job->sector;
+    uint8_t t = job->keytype;
+    uint8_t *state = &plan->state[s * 2 + t];
+    int res = job->res;
+
+    if (res == PM3_SUCCESS && (stop || plan->e_sector[s].foundKey[t])) {
+        // stopping, or a key reused got there first
+        free(job->nn.keys);
+        job->nn.keys = NULL;
+    } else if (res == PM3_SUCCESS) {
+        uint8_t key[6];
+        res = mfnested_check(&job->nn, key);
+        if (res == PM3_SUCCESS) {
+            plan->e_sector[s].Key[t] = bytes_to_num(key, 6);
+            plan->e_sector[s].foundKey[t] = 'N';
+            *state = AUTOPWN_KEY_OPEN;
+            PrintAndLogEx(SUCCESS, "target sector:%3u key type: %c -- found valid key [ " _GREEN_("%s") "]",
+                          s,
+                          t ? 'B' : 'A',
+                          sprint_hex(key, sizeof(key))
+                         );
+            autopwn_reuse_key(plan->e_sector, plan->sectors_cnt, key);
+            autopwn_plan_status(plan, s, t, "found");
+        }
+    }
+
+    job->state = AUTOPWN_JOB_FREE;
+
+    if (res == PM3_EMALLOC)
+        return res;
+
+    if (stop) {
+        *state = AUTOPWN_KEY_OPEN;
+    } else if (plan->e_sector[s].foundKey[t] == 0) {
+        // this can happen on some old cards, it's worth trying some more before switching to slower hardnested
+        if (++plan->retries[s * 2 + t] < MIFARE_SECTOR_RETRY) {
+            *state = AUTOPWN_KEY_OPEN;
+            autopwn_plan_status(plan, s, t, "no key, trying again");
+        } else {
+            *state = AUTOPWN_KEY_FAILED;
+            autopwn_plan_status(plan, s, t, "no key, for hardnested");
+        }
+    }
+    return PM3_SUCCESS;
+}
+
+// next key to collect the nonces for, false when there is none left
+static bool autopwn_plan_next(autopwn_plan_t *plan, uint8_t *sector, uint8_t *keytype) {
+    for (uint8_t i = 0; i < plan->sectors_cnt; i++) {
+        for (uint8_t j = 0; j < 2; j++) {
+            if (plan->e_sector[i].foundKey[j] == 0 && plan->state[i * 2 + j] == AUTOPWN_KEY_OPEN) {
+                *sector = i;
+                *keytype = j;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// nested attack on all the keys still unknown. PM3_EFAILED when the card isn't vulnerable,
+// the keys the nested attack doesn't find are left to the hardnested one
+static int autopwn_nested_plan(sector_t *e_sector, uint8_t sectors_cnt, uint8_t blockNo, uint8_t keyType, uint8_t *key, bool verbose) {
+
+    autopwn_plan_t plan;
+    memset(&plan, 0, sizeof(plan));
+    plan.e_sector = e_sector;
+    plan.sectors_cnt = sectors_cnt;
+    plan.state = calloc(sectors_cnt * 2, sizeof(uint8_t));
+    plan.retries = calloc(sectors_cnt * 2, sizeof(uint8_t));
+    if (plan.state == NULL || plan.retries == NULL) {
+        free(plan.state);
+        free(plan.retries);
+        return PM3_EMALLOC;
+    }
+    pthread_mutex_init(&plan.lock, NULL);
+    pthread_cond_init(&plan.cond, NULL);
+    for (int i = 0; i < AUTOPWN_JOBS; i++)
+        plan.jobs[i].plan = &plan;
+
+    if (verbose) {
+        PrintAndLogEx(INFO, "======================= " _YELLOW_("START NESTED ATTACK") " =======================");
+        PrintAndLogEx(INFO, "up to %u key recoveries run while the device collects the next nonces", AUTOPWN_JOBS);
+    }
+
+    bool calibrate = true;
+    bool stop = false;
+    int res = PM3_SUCCESS;
+
+    for (;;) {
+        // the recoveries done go back to the device first, a key found opens more sectors
+        autopwn_job_t *free_job = NULL;
+        uint32_t running = 0;
+        for (int i = 0; i < AUTOPWN_JOBS; i++) {
+            autopwn_job_t *job = &plan.jobs[i];
+
+            pthread_mutex_lock(&plan.lock);
+            autopwn_job_state_t state = job->state;
+            pthread_mutex_unlock(&plan.lock);
+
+            if (state == AUTOPWN_JOB_DONE) {
+                int fres = autopwn_plan_finish(&plan, job, stop);
+                if (fres != PM3_SUCCESS && res == PM3_SUCCESS) {
+                    res = fres;
+                    stop = true;
+                }
+                state = job->state;
+            }
+
+            if (state == AUTOPWN_JOB_RUNNING)
+                running++;
+            else if (free_job == NULL)
+                free_job = job;
+        }
+
+        uint8_t s = 0, t = 0;
+        if (stop == false && free_job && autopwn_plan_next(&plan, &s, &t)) {
+
+            if (kbd_enter_pressed()) {
+                PrintAndLogEx(WARNING, "\naborted via keyboard!\n");
+                res = PM3_EOPABORTED;
+                stop = true;
+                continue;
+            }
+
+            // the A key opens the sector trailer, the B key might be in there
+            if (t == 1 && e_sector[s].foundKey[0] && plan.retries[s * 2 + t] == 0 && autopwn_read_keyb(e_sector, s, verbose)) {
+                uint8_t keyb[6];
+                num_to_bytes(e_sector[s].Key[1], 6, keyb);
+                autopwn_reuse_key(e_sector, sectors_cnt, keyb);
+                autopwn_plan_status(&plan, s, t, "read with key A");
+                continue;
+            }
+
+            int cres = mfnested_collect(FirstBlockOfSector(blockNo), keyType, key, FirstBlockOfSector(s), t, calibrate, &free_job->nn);
+            switch (cres) {
+                case PM3_SUCCESS:
+                    break;
+                case PM3_ETIMEOUT:
+                    PrintAndLogEx(ERR, "\nError: No response from Proxmark3.");
+                    break;
+                case PM3_EOPABORTED:
+                    PrintAndLogEx(WARNING, "\nButton pressed. Aborted.");
+                    break;
+                case PM3_EFAILED:
+                    PrintAndLogEx(FAILED, "Tag isn't vulnerable to Nested Attack (PRNG is probably not predictable).");
+                    PrintAndLogEx(FAILED, "Nested attack failed --> try hardnested");
+                    break;
+                default:
+                    PrintAndLogEx(ERR, "unknown Error.\n");
+                    cres = PM3_ESOFT;
+                    break;
+            }
+            if (cres != PM3_SUCCESS) {
+                res = cres;
+                stop = true;
+                continue;
+            }
+            calibrate = false;
+
+            free_job->sector = s;
+            free_job->keytype = t;
+            free_job->state = AUTOPWN_JOB_RUNNING;
+            plan.state[s * 2 + t] = AUTOPWN_KEY_RECOVERING;
+            autopwn_plan_status(&plan, s, t, "nonces, recovering");
+
+            free_job->threaded = (pthread_create(&free_job->thread, NULL, autopwn_recover_thread, free_job) == 0);
+            // no thread, do it here
+            if (free_job->threaded == false)
+                autopwn_recover_thread(free_job);
+            continue;
+        }
+
+        if (running == 0)
+            break;
+
+        // nothing for the device to do, wait for a recovery
+        pthread_mutex_lock(&plan.lock);
+        for (;;) {
+            bool done = false;
+            for (int i = 0; i < AUTOPWN_JOBS; i++)
+                done |= (plan.jobs[i].state == AUTOPWN_JOB_DONE);
+            if (done)
+                break;
+            pthread_cond_wait(&plan.cond, &plan.lock);
+        }
+        pthread_mutex_unlock(&plan.lock);
+    }
+
+    pthread_cond_destroy(&plan.cond);
+    pthread_mutex_destroy(&plan.lock);
+    free(plan.state);
+    free(plan.retries);
+    DropField();
+    return res;
+}
+
 static int CmdHF14AMfAutoPWN(const char *Cmd) {
     // Nested and Hardnested parameter
     uint8_t blockNo = 0;
     uint8_t keyType = 0;
     uint8_t key[6] = {0};
     uint64_t key64 = 0;
-    bool calibrate = true;
     // Attack key storage variables
     uint8_t *keyBlock = NULL;
     uint32_t key_cnt = 0;
@@ -2107,6 +2556,16 @@ static int CmdHF14AMfAutoPWN(const char *Cmd) {
                     case 'm':
                         SetSIMDInstr(SIMD_MMX);
                         break;
+#endif
+#if defined(COMPILER_HAS_SIMD_NEON)
+                    case 'e':
+                        SetSIMDInstr(SIMD_NEON);
+                        break;
+#endif
+#if defined(HAVE_OPENCL)
+                    case 'g':
+                        SetSIMDInstr(SIMD_OPENCL);
+                        break;
 #endif
                     case 'n':
                         SetSIMDInstr(SIMD_NONE);
@@ -2138,18 +2597,17 @@ static int CmdHF14AMfAutoPWN(const char *Cmd) {
     char *fptr = GenerateFilename("hf-mf-", "-key.bin");
 
 
-    // check if tag doesn't have static nonce
-    has_staticnonce = detect_classic_static_nonce();
-
-    // card prng type (weak=1 / hard=0 / select/card comm error = negative value)
-    if (has_staticnonce == NONCE_NORMAL)  {
-        prng_type = detect_classic_prng();
-        if (prng_type < 0) {
-            PrintAndLogEx(FAILED, "\nNo tag detected or other tag communication error");
-            free(e_sector);
-            return prng_type;
-        }
+    // static nonce and card prng type (weak=1 / hard=0) in one call to the device
+    mf_fingerprint_resp_t fp;
+    res = detect_classic_fingerprint(0, &fp);
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(FAILED, "\nNo tag detected or other tag communication error");
+        free(e_sector);
+        return res;
     }
+    has_staticnonce = fp.nonce;
+    if (has_staticnonce == NONCE_NORMAL)
+        prng_type = fp.prng;
 
     // print parameters
     if (verbose) {
@@ -2411,7 +2869,20 @@ noValidKeyFound:
     free(keyBlock);
     // Clear the needed variables
     num_to_bytes(0, 6, tmp_key);
-    bool nested_failed = false;
+
+    // weak PRNG, the planner runs the nested attack on all the keys at once,
+    // the loop below is left with what it didn't find, for the hardnested attack
+    if (prng_type && has_staticnonce != NONCE_STATIC) {
+        res = autopwn_nested_plan(e_sector, sectors_cnt, blockNo, keyType, key, verbose);
+        if (res == PM3_ETIMEOUT || res == PM3_EMALLOC) {
+            free(e_sector);
+            return PM3_ESOFT;
+        }
+        if (res == PM3_EOPABORTED) {
+            free(e_sector);
+            return PM3_EOPABORTED;
+        }
+    }
 
     // Iterate over each sector and key(A/B)
     for (current_sector_i = 0; current_sector_i < sectors_cnt; current_sector_i++) {
@@ -2421,177 +2892,57 @@ noValidKeyFound:
             if (e_sector[current_sector_i].foundKey[current_key_type_i] == 0) {
 
                 // Try the found keys are reused
-                if (bytes_to_num(tmp_key, 6) != 0) {
-                    // <!> The fast check --> mfCheckKeys_fast(sectors_cnt, true, true, 2, 1, tmp_key, e_sector, false);
-                    // <!> Returns false keys, so we just stick to the slower mfchk.
-                    for (int i = 0; i < sectors_cnt; i++) {
-                        for (int j = 0; j < 2; j++) {
-                            // Check if the sector key is already broken
-                            if (e_sector[i].foundKey[j])
-                                continue;
-
-                            // Check if the key works
-                            if (mfCheckKeys(FirstBlockOfSector(i), j, true, 1, tmp_key, &key64) == PM3_SUCCESS) {
-                                e_sector[i].Key[j] = bytes_to_num(tmp_key, 6);
-                                e_sector[i].foundKey[j] = 'R';
-                                PrintAndLogEx(SUCCESS, "target sector:%3u key type: %c -- found valid key [ " _GREEN_("%s") "]",
-                                              i,
-                                              j ? 'B' : 'A',
-                                              sprint_hex(tmp_key, sizeof(tmp_key))
-                                             );
-                            }
-                        }
-                    }
-                }
+                if (bytes_to_num(tmp_key, 6) != 0)
+                    autopwn_reuse_key(e_sector, sectors_cnt, tmp_key);
+
                 // Clear the last found key
                 num_to_bytes(0, 6, tmp_key);
 
-                if (current_key_type_i == 1) {
-                    if (e_sector[current_sector_i].foundKey[0] && !e_sector[current_sector_i].foundKey[1]) {
-                        if (verbose) {
-                            PrintAndLogEx(INFO, "======================= " _YELLOW_("START READ B KEY ATTACK") " =======================");
-                            PrintAndLogEx(INFO, "reading  B  key: sector: %3d key type: %c",
-                                          current_sector_i,
-                                          current_key_type_i ? 'B' : 'A');
-                        }
-                        uint8_t sectrail = (FirstBlockOfSector(current_sector_i) + NumBlocksPerSector(current_sector_i) - 1);
-
-                        mf_readblock_t payload;
-                        payload.blockno = sectrail;
-                        payload.keytype = 0;
-
-                        num_to_bytes(e_sector[current_sector_i].Key[0], 6, payload.key); // KEY A
-
-                        clearCommandBuffer();
-                        SendCommandNG(CMD_HF_MIFARE_READBL, (uint8_t *)&payload, sizeof(mf_readblock_t));
-
-                        PacketResponseNG resp;
-                        if (!WaitForResponseTimeout(CMD_HF_MIFARE_READBL, &resp, 1500)) goto skipReadBKey;
-
-                        if (resp.status != PM3_SUCCESS) goto skipReadBKey;
-
-                        uint8_t *data = resp.data.asBytes;
-                        key64 = bytes_to_num(data + 10, 6);
-                        if (key64) {
-                            e_sector[current_sector_i].foundKey[current_key_type_i] = 'A';
-                            e_sector[current_sector_i].Key[current_key_type_i] = key64;
-                            num_to_bytes(key64, 6, tmp_key);
-                            PrintAndLogEx(SUCCESS, "target sector:%3u key type: %c -- found valid key [ " _GREEN_("%s") "]",
-                                          current_sector_i,
-                                          current_key_type_i ? 'B' : 'A',
-                                          sprint_hex(tmp_key, sizeof(tmp_key))
-                                         );
-                        } else {
-                            if (verbose) {
-                                PrintAndLogEx(WARNING, "unknown  B  key: sector: %3d key type: %c",
-                                              current_sector_i,
-                                              current_key_type_i ? 'B' : 'A'
-                                             );
-                                PrintAndLogEx(INFO, " -- reading the B key was not possible, maybe due to access rights?");
-
-                            }
-
-                        }
-                    }
+                if (current_key_type_i == 1 && e_sector[current_sector_i].foundKey[0] && !e_sector[current_sector_i].foundKey[1]) {
+                    if (autopwn_read_keyb(e_sector, current_sector_i, verbose))
+                        num_to_bytes(e_sector[current_sector_i].Key[1], 6, tmp_key);
                 }
 
                 // Use the nested / hardnested attack
-skipReadBKey:
                 if (e_sector[current_sector_i].foundKey[current_key_type_i] == 0) {
 
                     if (has_staticnonce == NONCE_STATIC)
                         goto tryStaticnested;
 
-                    if (prng_type && (nested_failed == false)) {
-                        uint8_t retries = 0;
-                        if (verbose) {
-                            PrintAndLogEx(INFO, "======================= " _YELLOW_("START NESTED ATTACK") " =======================");
-                            PrintAndLogEx(INFO, "sector no: %3d, target key type: %c",
-                                          current_sector_i,
-                                          current_key_type_i ? 'B' : 'A');
-                        }
-tryNested:
-                        isOK = mfnested(FirstBlockOfSector(blockNo), keyType, key, FirstBlockOfSector(current_sector_i), current_key_type_i, tmp_key, calibrate);
+                    // the nested attack was the planner's, what is left needs the hardnested one
+                    if (verbose) {
+                        PrintAndLogEx(INFO, "======================= " _YELLOW_("START HARDNESTED ATTACK") " =======================");
+                        PrintAndLogEx(INFO, "sector no: %3d, target key type: %c, Slow: %s",
+                                      current_sector_i,
+                                      current_key_type_i ? 'B' : 'A',
+                                      slow ? "Yes" : "No");
+                    }
 
+                    isOK = mfnestedhard(FirstBlockOfSector(blockNo), keyType, key, FirstBlockOfSector(current_sector_i), current_key_type_i, NULL, false, false, slow, 0, &foundkey, NULL);
+                    DropField();
+                    if (isOK) {
                         switch (isOK) {
-                            case PM3_ETIMEOUT: {
+                            case 1: {
                                 PrintAndLogEx(ERR, "\nError: No response from Proxmark3.");
-                                free(e_sector);
-                                return PM3_ESOFT;
-                            }
-                            case PM3_EOPABORTED: {
-                                PrintAndLogEx(WARNING, "\nButton pressed. Aborted.");
-                                free(e_sector);
-                                return PM3_EOPABORTED;
-                            }
-                            case PM3_EFAILED: {
-                                PrintAndLogEx(FAILED, "Tag isn't vulnerable to Nested Attack (PRNG is probably not predictable).");
-                                PrintAndLogEx(FAILED, "Nested attack failed --> try hardnested");
-                                goto tryHardnested;
-                            }
-                            case PM3_ESOFT: {
-                                // key not found
-                                calibrate = false;
-                                // this can happen on some old cards, it's worth trying some more before switching to slower hardnested
-                                if (retries++ < MIFARE_SECTOR_RETRY) {
-                                    PrintAndLogEx(FAILED, "Nested attack failed, trying again (%i/%i)", retries, MIFARE_SECTOR_RETRY);
-                                    goto tryNested;
-                                } else {
-                                    PrintAndLogEx(FAILED, "Nested attack failed, moving to hardnested");
-                                    nested_failed = true;
-                                    goto tryHardnested;
-                                }
                                 break;
                             }
-                            case PM3_SUCCESS: {
-                                calibrate = false;
-                                e_sector[current_sector_i].Key[current_key_type_i] = bytes_to_num(tmp_key, 6);
-                                e_sector[current_sector_i].foundKey[current_key_type_i] = 'N';
+                            case 2: {
+                                PrintAndLogEx(NORMAL, "\nButton pressed. Aborted.");
                                 break;
                             }
                             default: {
-                                PrintAndLogEx(ERR, "unknown Error.\n");
-                                free(e_sector);
-                                return PM3_ESOFT;
-                            }
-                        }
-
-                    } else {
-tryHardnested: // If the nested attack fails then we try the hardnested attack
-                        if (verbose) {
-                            PrintAndLogEx(INFO, "======================= " _YELLOW_("START HARDNESTED ATTACK") " =======================");
-                            PrintAndLogEx(INFO, "sector no: %3d, target key type: %c, Slow: %s",
-                                          current_sector_i,
-                                          current_key_type_i ? 'B' : 'A',
-                                          slow ? "Yes" : "No");
-                        }
-
-                        isOK = mfnestedhard(FirstBlockOfSector(blockNo), keyType, key, FirstBlockOfSector(current_sector_i), current_key_type_i, NULL, false, false, slow, 0, &foundkey, NULL);
-                        DropField();
-                        if (isOK) {
-                            switch (isOK) {
-                                case 1: {
-                                    PrintAndLogEx(ERR, "\nError: No response from Proxmark3.");
-                                    break;
-                                }
-                                case 2: {
-                                    PrintAndLogEx(NORMAL, "\nButton pressed. Aborted.");
-                                    break;
-                                }
-                                default: {
-                                    break;
-                                }
+                                break;
                             }
-                            free(e_sector);
-                            return PM3_ESOFT;
                         }
-
-                        // Copy the found key to the tmp_key variale (for the following print statement, and the mfCheckKeys above)
-                        num_to_bytes(foundkey, 6, tmp_key);
-                        e_sector[current_sector_i].Key[current_key_type_i] = foundkey;
-                        e_sector[current_sector_i].foundKey[current_key_type_i] = 'H';
+                        free(e_sector);
+                        return PM3_ESOFT;
                     }
 
+                    // Copy the found key to the tmp_key variale (for the following print statement, and the mfCheckKeys above)
+                    num_to_bytes(foundkey, 6, tmp_key);
+                    e_sector[current_sector_i].Key[current_key_type_i] = foundkey;
+                    e_sector[current_sector_i].foundKey[current_key_type_i] = 'H';
+
                     if (has_staticnonce == NONCE_STATIC) {
 tryStaticnested:
                         if (verbose) {
@@ -2733,6 +3084,34 @@ static void shuffle(uint8_t *array, uint16_t len) {
 }
 */
 
+// Drops duplicate keys. With pref keycache on, keyBlock is replaced by the hit ordered candidates for the card in the field
+static bool mfPrepareKeys(uint8_t **keyBlock, int *keycnt, mfkc_profile_t *profile) {
+
+    uint32_t cnt = mfKeyCacheDedup(*keyBlock, *keycnt);
+    if (cnt != (uint32_t)*keycnt)
+        PrintAndLogEx(INFO, "Removed " _YELLOW_("%u") " duplicate keys", *keycnt - cnt);
+    *keycnt = cnt;
+
+    if (session.keycache == false)
+        return false;
+
+    if (mfKeyCacheGetProfile(profile) != PM3_SUCCESS) {
+        PrintAndLogEx(WARNING, "key cache: can't select card, keys are tried in the given order");
+        return false;
+    }
+
+    uint8_t *keys = NULL;
+    if (mfKeyCacheBuild(profile, *keyBlock, *keycnt, &keys, &cnt) != PM3_SUCCESS || cnt == 0) {
+        free(keys);
+        return false;
+    }
+
+    free(*keyBlock);
+    *keyBlock = keys;
+    *keycnt = cnt;
+    return true;
+}
+
 static int CmdHF14AMfChk_fast(const char *Cmd) {
 
     char ctmp = 0x00;
@@ -2749,6 +3128,7 @@ static int CmdHF14AMfChk_fast(const char *Cmd) {
     int transferToEml = 0, createDumpFile = 0;
     uint32_t keyitems = ARRAYLEN(g_mifare_default_keys);
     bool use_flashmemory = false;
+    char spiffs_fn[32] = {0};
 
     sector_t *e_sector = NULL;
 
@@ -2803,6 +3183,13 @@ static int CmdHF14AMfChk_fast(const char *Cmd) {
             if (ctmp == 't') { transferToEml = 1; continue; }
             if (ctmp == 'd') { createDumpFile = 1; continue; }
             if ((ctmp == 'm') && (IfPm3Flash())) { use_flashmemory = true; continue; }
+            if ((ctmp == 's') && (IfPm3Flash())) {
+                if (param_getstr(Cmd, ++i, spiffs_fn, sizeof(spiffs_fn)) == 0) {
+                    free(keyBlock);
+                    return usage_hf14_chk_fast();
+                }
+                continue;
+            }
         } else {
             // May be a dic file
             if (param_getstr(Cmd, i, filename, FILE_PATH_SIZE) >= FILE_PATH_SIZE) {
@@ -2862,7 +3249,7 @@ static int CmdHF14AMfChk_fast(const char *Cmd) {
         }
     }
 
-    if (keycnt == 0 && !use_flashmemory) {
+    if (keycnt == 0 && !use_flashmemory && spiffs_fn[0] == 0) {
         PrintAndLogEx(SUCCESS, "No key specified, trying default keys");
         for (; keycnt < ARRAYLEN(g_mifare_default_keys); keycnt++)
             PrintAndLogEx(NORMAL, "[%2d] %02x%02x%02x%02x%02x%02x", keycnt,
@@ -2877,13 +3264,25 @@ static int CmdHF14AMfChk_fast(const char *Cmd) {
         return PM3_EMALLOC;
     }
 
+    mfkc_profile_t profile;
+    bool use_keycache = false;
+    if (use_flashmemory == false && spiffs_fn[0] == 0)
+        use_keycache = mfPrepareKeys(&keyBlock, &keycnt, &profile);
+
     uint32_t chunksize = keycnt > (PM3_CMD_DATA_SIZE / 6) ? (PM3_CMD_DATA_SIZE / 6) : keycnt;
     bool firstChunk = true, lastChunk = false;
 
     // time
     uint64_t t1 = msclock();
 
-    if (use_flashmemory) {
+    if (spiffs_fn[0]) {
+        PrintAndLogEx(SUCCESS, "Using dictionary " _YELLOW_("%s") " in SPIFFS", spiffs_fn);
+        res = mfCheckKeys_spiffs(sectorsCnt, spiffs_fn, e_sector);
+        if (res == PM3_EFILE)
+            PrintAndLogEx(FAILED, "no such file in SPIFFS, list with " _YELLOW_("`mem spiffs tree`"));
+        else if (res == PM3_EOPABORTED)
+            PrintAndLogEx(WARNING, "aborted via keyboard!");
+    } else if (use_flashmemory) {
         PrintAndLogEx(SUCCESS, "Using dictionary in flash memory");
         mfCheckKeys_fast(sectorsCnt, true, true, 1, 0, keyBlock, e_sector, use_flashmemory);
     } else {
@@ -2943,6 +3342,9 @@ out:
 
         printKeyTable(sectorsCnt, e_sector);
 
+        if (use_keycache)
+            mfKeyCacheRecord(&profile, e_sector, sectorsCnt);
+
         if (use_flashmemory && found_keys == (sectorsCnt << 1)) {
             PrintAndLogEx(SUCCESS, "Card dumped aswell. run " _YELLOW_("`%s %c`"),
                           "hf mf esave",
@@ -3157,6 +3559,9 @@ static int CmdHF14AMfChk(const char *Cmd) {
         return PM3_EMALLOC;
     }
 
+    mfkc_profile_t profile;
+    bool use_keycache = mfPrepareKeys(&keyBlock, &keycnt, &profile);
+
     uint8_t trgKeyType = 0;
     uint16_t max_keys = keycnt > KEYS_IN_BLOCK ? KEYS_IN_BLOCK : keycnt;
 
@@ -3258,6 +3663,9 @@ out:
     else
         printKeyTable(SectorsCnt, e_sector);
 
+    if (use_keycache)
+        mfKeyCacheRecord(&profile, e_sector, SectorsCnt);
+
     if (transferToEml) {
         // fast push mode
         conn.block_after_ACK = true;
@@ -3354,6 +3762,150 @@ void readerAttack(sector_t *k_sector, uint8_t k_sectorsCount, nonces_t data, boo
     free(k_sector);
 }
 
+// AR/NR pairs hf mf sim streams, mfkey32 runs on them in a few threads while the simulation goes on
+#define MFSIM_KEY_JOBS      32
+#define MFSIM_KEY_THREADS   4
+
+typedef enum {
+    MFSIM_JOB_FREE = 0,
+    MFSIM_JOB_QUEUED,
+    MFSIM_JOB_RUNNING,
+    MFSIM_JOB_DONE,
+} mfsim_job_state_t;
+
+typedef struct {
+    mfsim_job_state_t state;
+    nonces_t data;
+    uint64_t key;
+    bool found;
+} mfsim_job_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool stop;
+    mfsim_job_t jobs[MFSIM_KEY_JOBS];
+    pthread_t thread_id[MFSIM_KEY_THREADS];
+    int threads;
+} mfsim_pool_t;
+
+static void *mfsim_key_worker(void *arg) {
+    mfsim_pool_t *pool = (mfsim_pool_t *)arg;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        mfsim_job_t *job = NULL;
+        for (int i = 0; i < MFSIM_KEY_JOBS && job == NULL; i++) {
+            if (pool->jobs[i].state == MFSIM_JOB_QUEUED)
+                job = &pool->jobs[i];
+        }
+        if (job == NULL) {
+            if (pool->stop)
+                break;
+            pthread_cond_wait(&pool->cond, &pool->lock);
+            continue;
+        }
+
+        job->state = MFSIM_JOB_RUNNING;
+        pthread_mutex_unlock(&pool->lock);
+        job->found = mfkey32_moebius(&job->data, &job->key);
+        pthread_mutex_lock(&pool->lock);
+        job->state = MFSIM_JOB_DONE;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+static void mfsim_pool_start(mfsim_pool_t *pool) {
+    memset(pool, 0, sizeof(mfsim_pool_t));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+
+    int n = MIN(num_CPUs(), MFSIM_KEY_THREADS);
+    for (; pool->threads < n; pool->threads++) {
+        if (pthread_create(&pool->thread_id[pool->threads], NULL, mfsim_key_worker, pool) != 0)
+            break;
+    }
+}
+
+static void mfsim_pool_push(mfsim_pool_t *pool, const nonces_t *data) {
+    mfsim_job_t *job = NULL;
+    pthread_mutex_lock(&pool->lock);
+    for (int i = 0; i < MFSIM_KEY_JOBS && job == NULL; i++) {
+        if (pool->jobs[i].state == MFSIM_JOB_FREE)
+            job = &pool->jobs[i];
+    }
+    if (job) {
+        job->data = *data;
+        job->state = (pool->threads) ? MFSIM_JOB_QUEUED : MFSIM_JOB_RUNNING;
+    }
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    if (job == NULL) {
+        PrintAndLogEx(WARNING, "key recovery queue full, sector %02d key %s skipped", data->sector, data->keytype ? "B" : "A");
+        return;
+    }
+    // no thread at all, do it here
+    if (pool->threads == 0) {
+        job->found = mfkey32_moebius(&job->data, &job->key);
+        job->state = MFSIM_JOB_DONE;
+    }
+}
+
+// prints the keys found so far and puts them in the table / emulator memory
+static void mfsim_pool_report(mfsim_pool_t *pool, sector_t *k_sector, uint8_t k_sectorsCount, bool setEmulatorMem) {
+    for (int i = 0; i < MFSIM_KEY_JOBS; i++) {
+        pthread_mutex_lock(&pool->lock);
+        bool done = (pool->jobs[i].state == MFSIM_JOB_DONE);
+        mfsim_job_t job = pool->jobs[i];
+        if (done)
+            pool->jobs[i].state = MFSIM_JOB_FREE;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (done == false || job.found == false || job.data.sector >= k_sectorsCount)
+            continue;
+
+        uint8_t sector = job.data.sector;
+        uint8_t keytype = job.data.keytype;
+        PrintAndLogEx(INFO, "Reader is trying authenticate with: Key %s, sector %02d: [%012" PRIx64 "]"
+                      , keytype ? "B" : "A"
+                      , sector
+                      , job.key
+                     );
+
+        k_sector[sector].Key[keytype] = job.key;
+        k_sector[sector].foundKey[keytype] = true;
+
+        //set emulator memory for keys
+        if (setEmulatorMem) {
+            uint8_t memBlock[16] = {0, 0, 0, 0, 0, 0, 0xff, 0x0F, 0x80, 0x69, 0, 0, 0, 0, 0, 0};
+            num_to_bytes(k_sector[sector].Key[0], 6, memBlock);
+            num_to_bytes(k_sector[sector].Key[1], 6, memBlock + 10);
+            uint8_t blockno = FirstBlockOfSector(sector) + NumBlocksPerSector(sector) - 1;
+            PrintAndLogEx(INFO, "Setting Emulator Memory Block %02d: [%s]"
+                          , blockno
+                          , sprint_hex(memBlock, sizeof(memBlock))
+                         );
+            mfEmlSetMem(memBlock, blockno, 1);
+        }
+    }
+}
+
+// waits for the jobs still queued
+static void mfsim_pool_stop(mfsim_pool_t *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->threads; i++)
+        pthread_join(pool->thread_id[i], NULL);
+
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->lock);
+}
+
 static int CmdHF14AMfSim(const char *Cmd) {
 
     uint8_t uid[10] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
@@ -3366,7 +3918,6 @@ static int CmdHF14AMfSim(const char *Cmd) {
     int uidlen = 0;
     uint8_t cmdp = 0;
     bool errors = false, verbose = false, setEmulatorMem = false;
-    nonces_t data[1];
     char csize[13] = { 0 };
     char uidsize[8] = { 0 };
     sector_t *k_sector = NULL;
@@ -3512,13 +4063,37 @@ static int CmdHF14AMfSim(const char *Cmd) {
     if (flags & FLAG_INTERACTIVE) {
         PrintAndLogEx(INFO, "Press pm3-button or send another cmd to abort simulation");
 
+        bool attack = ((flags & FLAG_NR_AR_ATTACK) == FLAG_NR_AR_ATTACK);
+        mfsim_pool_t pool;
+        if (attack) {
+            if (initSectorTable(&k_sector, k_sectorsCount) != k_sectorsCount) {
+                free(k_sector);
+                return PM3_EMALLOC;
+            }
+            mfsim_pool_start(&pool);
+        }
+
         while (!kbd_enter_pressed()) {
-            if (!WaitForResponseTimeout(CMD_ACK, &resp, 1500)) continue;
-            if (!(flags & FLAG_NR_AR_ATTACK)) break;
-            if ((resp.oldarg[0] & 0xffff) != CMD_HF_MIFARE_SIMULATE) break;
+            if (attack)
+                mfsim_pool_report(&pool, k_sector, k_sectorsCount, setEmulatorMem);
 
-            memcpy(data, resp.data.asBytes, sizeof(data));
-            readerAttack(k_sector, k_sectorsCount, data[0], setEmulatorMem, verbose);
+            if (!WaitForResponseTimeout(CMD_UNKNOWN, &resp, 200)) continue;
+
+            // every AR/NR entry with its two pairs comes as soon as the device has it
+            if (resp.cmd == CMD_HF_MIFARE_SIMULATE && resp.status == PM3_EPARTIAL) {
+                if (attack && resp.length == sizeof(nonces_t)) {
+                    if (verbose) PrintAndLogEx(INFO, "AR/NR pairs for sector %02d key %s", ((nonces_t *)resp.data.asBytes)->sector, ((nonces_t *)resp.data.asBytes)->keytype ? "B" : "A");
+                    mfsim_pool_push(&pool, (nonces_t *)resp.data.asBytes);
+                }
+                continue;
+            }
+
+            if (resp.cmd == CMD_ACK && (resp.oldarg[0] & 0xffff) == CMD_HF_MIFARE_SIMULATE) break;
+        }
+
+        if (attack) {
+            mfsim_pool_stop(&pool);
+            mfsim_pool_report(&pool, k_sector, k_sectorsCount, setEmulatorMem);
         }
         showSectorTable(k_sector, k_sectorsCount);
     }
@@ -3703,7 +4278,6 @@ static int CmdHF14AMfESet(const char *Cmd) {
 
 int CmdHF14AMfELoad(const char *Cmd) {
 
-    size_t counter = 0;
     char filename[FILE_PATH_SIZE];
     int blockNum, numBlocks, nameParamNo = 1;
     uint8_t blockWidth = 16;
@@ -3784,28 +4358,14 @@ int CmdHF14AMfELoad(const char *Cmd) {
 
     PrintAndLogEx(INFO, "Uploading to emulator memory");
 
-    // fast push mode
-    conn.block_after_ACK = true;
-    blockNum = 0;
-    while (datalen) {
-        if (datalen == blockWidth) {
-            // Disable fast mode on last packet
-            conn.block_after_ACK = false;
-        }
-
-        if (mfEmlSetMem_xt(data + counter, blockNum, 1, blockWidth) != PM3_SUCCESS) {
-            PrintAndLogEx(FAILED, "Cant set emul block: %3d", blockNum);
-            free(data);
-            return PM3_ESOFT;
-        }
-        PrintAndLogEx(NORMAL, "." NOLF);
-        fflush(stdout);
-
-        blockNum++;
-        counter += blockWidth;
-        datalen -= blockWidth;
-    }
+    // emulator memory holds the blocks back to back, the whole file goes in one stream
+    res = SendToDeviceEML(data, datalen, 0);
     free(data);
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(FAILED, "Cant set emulator memory (%d)", res);
+        return PM3_ESOFT;
+    }
+    blockNum = datalen / blockWidth;
     PrintAndLogEx(NORMAL, "\n");
 
     if (blockWidth == 4) {
@@ -3967,7 +4527,6 @@ static int CmdHF14AMfECFill(const char *Cmd) {
 static int CmdHF14AMfEKeyPrn(const char *Cmd) {
 
     uint8_t sectors_cnt = MIFARE_1K_MAXSECTOR;
-    uint8_t data[16];
     uint8_t uid[4];
     uint8_t cmdp = 0;
     bool errors = false, createDumpFile = false;
@@ -4007,29 +4566,31 @@ static int CmdHF14AMfEKeyPrn(const char *Cmd) {
         return PM3_EMALLOC;
     }
 
-    // read UID from EMUL
-    if (mfEmlGetMem(data, 0, 1) != PM3_SUCCESS) {
-        PrintAndLogEx(WARNING, "error get block %d", 0);
+    // download UID and keys from EMUL in one go
+    uint16_t blocks = FirstBlockOfSector(sectors_cnt - 1) + NumBlocksPerSector(sectors_cnt - 1);
+    uint8_t *dump = calloc(blocks, MFBLOCK_SIZE);
+    if (dump == NULL) {
+        free(e_sector);
+        return PM3_EMALLOC;
+    }
+
+    if (mfEmlGetMem(dump, 0, blocks) != PM3_SUCCESS) {
+        PrintAndLogEx(WARNING, "error get blocks 0 - %d", blocks - 1);
+        free(dump);
         free(e_sector);
         return PM3_ESOFT;
     }
 
-    memcpy(uid, data, sizeof(uid));
+    memcpy(uid, dump, sizeof(uid));
 
-    // download keys from EMUL
     for (int i = 0; i < sectors_cnt; i++) {
-
-        if (mfEmlGetMem(data, FirstBlockOfSector(i) + NumBlocksPerSector(i) - 1, 1) != PM3_SUCCESS) {
-            PrintAndLogEx(WARNING, "error get block %d", FirstBlockOfSector(i) + NumBlocksPerSector(i) - 1);
-            e_sector[i].foundKey[0] = false;
-            e_sector[i].foundKey[1] = false;
-        } else {
-            e_sector[i].foundKey[0] = true;
-            e_sector[i].Key[0] = bytes_to_num(data, 6);
-            e_sector[i].foundKey[1] = true;
-            e_sector[i].Key[1] = bytes_to_num(data + 10, 6);
-        }
+        uint8_t *data = dump + (FirstBlockOfSector(i) + NumBlocksPerSector(i) - 1) * MFBLOCK_SIZE;
+        e_sector[i].foundKey[0] = true;
+        e_sector[i].Key[0] = bytes_to_num(data, 6);
+        e_sector[i].foundKey[1] = true;
+        e_sector[i].Key[1] = bytes_to_num(data + 10, 6);
     }
+    free(dump);
 
     // print keys
     printKeyTable(sectors_cnt, e_sector);
@@ -4194,8 +4755,16 @@ static int CmdHF14AMfCLoad(const char *Cmd) {
     uint8_t fillFromEmulator = 0;
     bool fillFromJson = false;
     bool fillFromBin = false;
+    bool verify = false;
     char fileName[50] = {0};
 
+    if (param_getlength(Cmd, 0) == 1 && tolower(param_getchar(Cmd, 0)) == 'v') {
+        verify = true;
+        int bg, en;
+        param_getptr(Cmd, &bg, &en, 1);
+        Cmd += bg;
+    }
+
     char ctmp = tolower(param_getchar(Cmd, 0));
     if (param_getlength(Cmd, 0) == 1) {
         if (ctmp == 'h' || ctmp == 0x00) return usage_hf14_cload();
@@ -4207,104 +4776,61 @@ static int CmdHF14AMfCLoad(const char *Cmd) {
     if (fillFromJson || fillFromBin)
         param_getstr(Cmd, 1, fileName, sizeof(fileName));
 
+    uint16_t blocks = MIFARE_1K_MAXBLOCK;
+    if (fillFromEmulator == 0) {
+        size_t maxdatalen = 4096;
+        uint8_t *data = calloc(maxdatalen, sizeof(uint8_t));
+        if (!data) {
+            PrintAndLogEx(WARNING, "Fail, cannot allocate memory");
+            return PM3_EMALLOC;
+        }
 
-    if (fillFromEmulator) {
-        for (int blockNum = 0; blockNum < 16 * 4; blockNum += 1) {
-            int flags = 0;
-            uint8_t buf8[16] = {0x00};
-            if (mfEmlGetMem(buf8, blockNum, 1)) {
-                PrintAndLogEx(WARNING, "Cant get block: %d", blockNum);
-                return 2;
-            }
-            if (blockNum == 0) flags = MAGIC_INIT + MAGIC_WUPC;             // switch on field and send magic sequence
-            if (blockNum == 1) flags = 0;                                   // just write
-            if (blockNum == 16 * 4 - 1) flags = MAGIC_HALT + MAGIC_OFF;     // Done. Magic Halt and switch off field.
-
-            if (mfCSetBlock(blockNum, buf8, NULL, flags)) {
-                PrintAndLogEx(WARNING, "Cant set magic card block: %d", blockNum);
-                return PM3_ESOFT;
+        size_t datalen = 0;
+        int res = 0;
+        if (fillFromBin) {
+            res = loadFile(fileName, ".bin", data, maxdatalen, &datalen);
+        } else {
+            if (fillFromJson) {
+                res = loadFileJSON(fileName, data, maxdatalen, &datalen, NULL);
+            } else {
+                res = loadFileEML(Cmd, data, &datalen);
             }
-            PrintAndLogEx(NORMAL, "." NOLF);
-            fflush(stdout);
         }
-        PrintAndLogEx(NORMAL, "\n");
-        return PM3_SUCCESS;
-    }
-
-    size_t maxdatalen = 4096;
-    uint8_t *data = calloc(maxdatalen, sizeof(uint8_t));
-    if (!data) {
-        PrintAndLogEx(WARNING, "Fail, cannot allocate memory");
-        return PM3_EMALLOC;
-    }
 
-    size_t datalen = 0;
-    int res = 0;
-    if (fillFromBin) {
-        res = loadFile(fileName, ".bin", data, maxdatalen, &datalen);
-    } else {
-        if (fillFromJson) {
-            res = loadFileJSON(fileName, data, maxdatalen, &datalen, NULL);
-        } else {
-            res = loadFileEML(Cmd, data, &datalen);
+        if (res) {
+            if (data)
+                free(data);
+            return PM3_EFILE;
         }
-    }
 
-    if (res) {
-        if (data)
+        // 64 or 256blocks.
+        if (datalen != 1024 && datalen != 4096) {
+            PrintAndLogEx(ERR, "File content error. There must be 64 or 256 blocks");
             free(data);
-        return PM3_EFILE;
-    }
+            return PM3_EFILE;
+        }
+        blocks = datalen / 16;
 
-    // 64 or 256blocks.
-    if (datalen != 1024 && datalen != 4096) {
-        PrintAndLogEx(ERR, "File content error. ");
+        // to the emulator memory, the device writes the card from there
+        res = SendToDeviceEML(data, datalen, 0);
         free(data);
-        return PM3_EFILE;
-    }
-
-    PrintAndLogEx(INFO, "Copying to magic card");
-
-    int blockNum = 0;
-    int flags = 0;
-    while (datalen) {
-
-        // switch on field and send magic sequence
-        if (blockNum == 0) flags = MAGIC_INIT + MAGIC_WUPC;
-
-        // write
-        if (blockNum == 1) flags = 0;
-
-        // Switch off field.
-        if (blockNum == 16 * 4 - 1) flags = MAGIC_HALT + MAGIC_OFF;
-
-        if (mfCSetBlock(blockNum, data + (16 * blockNum), NULL, flags)) {
-            PrintAndLogEx(WARNING, "Can't set magic card block: %d", blockNum);
-            free(data);
+        if (res != PM3_SUCCESS) {
+            PrintAndLogEx(FAILED, "Cant set emulator memory (%d)", res);
             return PM3_ESOFT;
         }
-
-        datalen -= 16;
-
-        PrintAndLogEx(NORMAL, "." NOLF);
-        fflush(stdout);
-
-        blockNum++;
-
-        // magic card type - mifare 1K
-        if (blockNum >= MIFARE_1K_MAXBLOCK) break;
     }
-    PrintAndLogEx(NORMAL, "\n");
 
-    // 64 or 256blocks.
-    if (blockNum != 16 * 4 && blockNum != 32 * 4 + 8 * 16) {
-        PrintAndLogEx(ERR, "File content error. There must be 64 blocks");
-        free(data);
-        return PM3_EFILE;
+    PrintAndLogEx(INFO, "Copying %u blocks to magic card%s", blocks, (verify) ? ", verifying" : "");
+
+    uint16_t written = 0;
+    uint64_t t1 = msclock();
+    int res = mfCLoad(blocks, verify, &written);
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(WARNING, "Can't set magic card block: %d", written);
+        return res;
     }
 
-    PrintAndLogEx(SUCCESS, "Card loaded %d blocks from file", blockNum);
-    free(data);
+    PrintAndLogEx(SUCCESS, "Card loaded %d blocks in %" PRIu64 " ms", written, msclock() - t1);
     return PM3_SUCCESS;
 }
 
@@ -5016,7 +5542,6 @@ static int CmdHFMFNDEF(const char *Cmd) {
 
     uint8_t sector0[16 * 4] = {0};
     uint8_t sector10[16 * 4] = {0};
-    uint8_t data[4096] = {0};
     int datalen = 0;
 
     if (verbose)
@@ -5054,36 +5579,40 @@ static int CmdHFMFNDEF(const char *Cmd) {
         return res;
     }
 
+    // the NDEF sectors are decoded as they are read, until the terminator
+    ndef_stream_t *ndef = calloc(1, sizeof(ndef_stream_t));
+    if (ndef == NULL)
+        return PM3_EMALLOC;
+
     PrintAndLogEx(INFO, "reading data from tag");
-    for (int i = 0; i < madlen; i++) {
+    NDEFStreamInit(ndef, verbose);
+
+    for (int i = 0; i < madlen && ndef->done == false; i++) {
         if (ndefAID == mad[i]) {
             uint8_t vsector[16 * 4] = {0};
             if (mfReadSector(i + 1, keyB ? MF_KEY_B : MF_KEY_A, ndefkey, vsector)) {
                 PrintAndLogEx(ERR, "error, reading sector %d ", i + 1);
+                free(ndef);
                 return PM3_ESOFT;
             }
 
-            memcpy(&data[datalen], vsector, 16 * 3);
-            datalen += 16 * 3;
+            if (verbose2) {
+                PrintAndLogEx(INFO, "--- " _CYAN_("MFC NDEF raw") " sector %d ----------------", i + 1);
+                dump_buffer(vsector, 16 * 3, stdout, 1);
+            }
 
-            PrintAndLogEx(INPLACE, "%d", i);
+            datalen += 16 * 3;
+            if (NDEFStreamFeed(ndef, vsector, 16 * 3) != PM3_SUCCESS)
+                break;
         }
     }
-    PrintAndLogEx(NORMAL, "");
 
-    if (!datalen) {
+    if (datalen == 0)
         PrintAndLogEx(WARNING, "no NDEF data");
-        return PM3_SUCCESS;
-    }
-
-    if (verbose2) {
-        PrintAndLogEx(NORMAL, "");
-        PrintAndLogEx(INFO, "--- " _CYAN_("MFC NDEF raw") " ----------------");
-        dump_buffer(data, datalen, stdout, 1);
-    }
-
-    NDEFDecodeAndPrint(data, datalen, verbose);
+    else
+        NDEFStreamFinish(ndef);
 
+    free(ndef);
     PrintAndLogEx(HINT, "Try " _YELLOW_("`hf mf ndef -vv`") " for more details");
     return PM3_SUCCESS;
 }
@@ -331,6 +331,16 @@ typedef struct {
 
 static int CmdHelp(const char *Cmd);
 
+// field is on and the card selected, send_desfire_cmd doesn't select again and selecting the
+// application of the session is skipped. Keeps an authentication alive from one command to the next
+static bool desfire_session = false;
+static uint8_t desfire_session_aid[3] = {0};
+
+static void desfire_drop_field(void) {
+    desfire_session = false;
+    DropField();
+}
+
 /*
   The 7 MSBits (= n) code the storage size itself based on 2^n,
   the LSBit is set to '0' if the size is exactly 2^n
@@ -391,6 +401,21 @@ static char *getVersionStr(uint8_t major, uint8_t minor) {
     return buf;
 }
 
+static int desfire_check_sw(sAPDU apdu, uint16_t isw) {
+    if (isw != 0x9000 && isw != status(MFDES_S_OPERATION_OK) && isw != status(MFDES_S_SIGNATURE) && isw != status(MFDES_S_ADDITIONAL_FRAME) && isw != status(MFDES_S_NO_CHANGES)) {
+        if (GetAPDULogging()) {
+            if (isw >> 8 == 0x61) {
+                PrintAndLogEx(ERR, "APDU chaining len: 0x%02x -->", isw & 0xff);
+            } else {
+                PrintAndLogEx(ERR, "APDU(%02x%02x) ERROR: [0x%4X] %s", apdu.CLA, apdu.INS, isw, GetAPDUCodeDescription(isw >> 8, isw & 0xff));
+                return PM3_EAPDU_FAIL;
+            }
+        }
+        return PM3_EAPDU_FAIL;
+    }
+    return PM3_SUCCESS;
+}
+
 static int DESFIRESendApdu(bool activate_field, bool leavefield_on, sAPDU apdu, uint8_t *result, uint32_t max_result_len, uint32_t *result_len, uint16_t *sw) {
 
     *result_len = 0;
@@ -400,7 +425,7 @@ static int DESFIRESendApdu(bool activate_field, bool leavefield_on, sAPDU apdu,
     int res = 0;
 
     if (activate_field) {
-        DropField();
+        desfire_drop_field();
         msleep(50);
     }
 
@@ -435,18 +460,7 @@ static int DESFIRESendApdu(bool activate_field, bool leavefield_on, sAPDU apdu,
     if (sw)
         *sw = isw;
 
-    if (isw != 0x9000 && isw != status(MFDES_S_OPERATION_OK) && isw != status(MFDES_S_SIGNATURE) && isw != status(MFDES_S_ADDITIONAL_FRAME) && isw != status(MFDES_S_NO_CHANGES)) {
-        if (GetAPDULogging()) {
-            if (isw >> 8 == 0x61) {
-                PrintAndLogEx(ERR, "APDU chaining len: 0x%02x -->", isw & 0xff);
-            } else {
-                PrintAndLogEx(ERR, "APDU(%02x%02x) ERROR: [0x%4X] %s", apdu.CLA, apdu.INS, isw, GetAPDUCodeDescription(isw >> 8, isw & 0xff));
-                return PM3_EAPDU_FAIL;
-            }
-        }
-        return PM3_EAPDU_FAIL;
-    }
-    return PM3_SUCCESS;
+    return desfire_check_sw(apdu, isw);
 }
 
 static const char *getstatus(uint16_t *sw) {
@@ -568,20 +582,8 @@ static const char *GetErrorString(int res, uint16_t *sw) {
     return "";
 }
 
-static int send_desfire_cmd(sAPDU *apdu, bool select, uint8_t *dest, uint32_t *recv_len, uint16_t *sw, uint32_t splitbysize, bool readalldata) {
-    if (apdu == NULL) {
-        PrintAndLogEx(DEBUG, "APDU=NULL");
-        return PM3_EINVARG;
-    }
-    if (sw == NULL) {
-        PrintAndLogEx(DEBUG, "SW=NULL");
-        return PM3_EINVARG;
-    }
-    if (recv_len == NULL) {
-        PrintAndLogEx(DEBUG, "RECV_LEN=NULL");
-        return PM3_EINVARG;
-    }
-
+// one client round trip per card answer. For the select and for apdus longer than one ISO14443-4 block
+static int send_desfire_cmd_apdu(sAPDU *apdu, bool select, uint8_t *dest, uint32_t *recv_len, uint16_t *sw, uint32_t splitbysize, bool readalldata) {
     *sw = 0;
     uint8_t data[255 * 5]  = {0x00};
     uint32_t resplen = 0;
@@ -590,9 +592,14 @@ static int send_desfire_cmd(sAPDU *apdu, bool select, uint8_t *dest, uint32_t *r
     int res = DESFIRESendApdu(select, true, *apdu, data, sizeof(data), &resplen, sw);
     if (res != PM3_SUCCESS) {
         PrintAndLogEx(DEBUG, "%s", GetErrorString(res, sw));
-        DropField();
+        desfire_drop_field();
         return res;
     }
+    // a fresh select has the PICC level selected
+    if (select) {
+        memset(desfire_session_aid, 0, sizeof(desfire_session_aid));
+        desfire_session = true;
+    }
     if (dest != NULL) {
         memcpy(dest, data, resplen);
     }
@@ -615,7 +622,7 @@ static int send_desfire_cmd(sAPDU *apdu, bool select, uint8_t *dest, uint32_t *r
         res = DESFIRESendApdu(false, true, *apdu, data, sizeof(data), &resplen, sw);
         if (res != PM3_SUCCESS) {
             PrintAndLogEx(DEBUG, "%s", GetErrorString(res, sw));
-            DropField();
+            desfire_drop_field();
             return res;
         }
 
@@ -636,6 +643,112 @@ static int send_desfire_cmd(sAPDU *apdu, bool select, uint8_t *dest, uint32_t *r
     return PM3_SUCCESS;
 }
 
+static int send_desfire_cmd(sAPDU *apdu, bool select, uint8_t *dest, uint32_t *recv_len, uint16_t *sw, uint32_t splitbysize, bool readalldata) {
+    if (apdu == NULL) {
+        PrintAndLogEx(DEBUG, "APDU=NULL");
+        return PM3_EINVARG;
+    }
+    if (sw == NULL) {
+        PrintAndLogEx(DEBUG, "SW=NULL");
+        return PM3_EINVARG;
+    }
+    if (recv_len == NULL) {
+        PrintAndLogEx(DEBUG, "RECV_LEN=NULL");
+        return PM3_EINVARG;
+    }
+
+    // select only once per session
+    bool cached = (select && desfire_session);
+    if (cached)
+        select = false;
+
+    *sw = 0;
+
+    desfire_chain_req_t req = {0};
+    int datalen = 0;
+    uint8_t data[APDU_RES_LEN] = {0};
+    if (APDUEncodeS(apdu, false, 0x100, data, &datalen)) {
+        PrintAndLogEx(ERR, "APDU encoding error.");
+        return PM3_EAPDU_ENCODEFAIL;
+    }
+
+    // the select goes through ExchangeAPDU14a, it also learns the frame size of the card there
+    if (select || datalen > DESFIRE_CHAIN_MAX_APDU)
+        return send_desfire_cmd_apdu(apdu, select, dest, recv_len, sw, splitbysize, readalldata);
+
+    req.flags = (readalldata ? DESFIRE_CHAIN_ALL : 0);
+    req.len = datalen;
+    memcpy(req.apdu, data, datalen);
+
+    if (GetAPDULogging() || (g_debugMode > 1))
+        PrintAndLogEx(SUCCESS, ">>>> %s", sprint_hex(data, datalen));
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_DESFIRE_CHAINED, (uint8_t *)&req, sizeof(req) - sizeof(req.apdu) + req.len);
+
+    // all card answers of the command, frames of the device until the final one
+    PacketResponseNG resp;
+    desfire_chain_resp_t *payload = (desfire_chain_resp_t *)resp.data.asBytes;
+    uint32_t pos = 0;
+    uint32_t i = 0;
+    int res = PM3_SUCCESS;
+    do {
+        if (WaitForResponseTimeout(CMD_HF_DESFIRE_CHAINED, &resp, 1500) == false) {
+            PrintAndLogEx(ERR, "APDU: Reply timeout.");
+            res = PM3_ETIMEOUT;
+            break;
+        }
+        if (resp.status != PM3_SUCCESS) {
+            res = resp.status;
+            break;
+        }
+
+        for (uint16_t n = 0; n < MIN(payload->len, DESFIRE_CHAIN_DATA);) {
+            uint8_t alen = payload->data[n++];
+            if (GetAPDULogging() || (g_debugMode > 1))
+                PrintAndLogEx(SUCCESS, "<<<< %s", sprint_hex(payload->data + n, alen));
+
+            if (dest != NULL) {
+                if (splitbysize)
+                    memcpy(&dest[i * splitbysize], payload->data + n, alen);
+                else
+                    memcpy(&dest[pos], payload->data + n, alen);
+            }
+            pos += alen;
+            i++;
+            n += alen;
+        }
+        *sw = payload->sw;
+    } while (payload->final == false);
+
+    if (res != PM3_SUCCESS) {
+        desfire_drop_field();
+
+        // the cached session is gone, start over with the select
+        if (cached)
+            return send_desfire_cmd_apdu(apdu, true, dest, recv_len, sw, splitbysize, readalldata);
+
+        PrintAndLogEx(DEBUG, "%s", GetErrorString(res, sw));
+        return res;
+    }
+
+    res = desfire_check_sw(*apdu, *sw);
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(DEBUG, "%s", GetErrorString(res, sw));
+        desfire_drop_field();
+        return res;
+    }
+
+    if (!readalldata) {
+        if (*sw == status(MFDES_ADDITIONAL_FRAME))
+            *recv_len = pos;
+        return PM3_SUCCESS;
+    }
+
+    *recv_len = (splitbysize) ? i : pos;
+    return PM3_SUCCESS;
+}
+
 static nxp_cardtype_t getCardType(uint8_t major, uint8_t minor) {
 
     if (major == 0x00)
@@ -966,7 +1079,7 @@ static int test_desfire_authenticate(void) {
     int res = send_desfire_cmd(&apdu, true, NULL, &recv_len, &sw, 0, false);
     if (res == PM3_SUCCESS)
         if (sw == status(MFDES_ADDITIONAL_FRAME)) {
-            DropField();
+            desfire_drop_field();
             return res;
         }
     return res;
@@ -981,7 +1094,7 @@ static int test_desfire_authenticate_iso(void) {
     int res = send_desfire_cmd(&apdu, true, NULL, &recv_len, &sw, 0, false);
     if (res == PM3_SUCCESS)
         if (sw == status(MFDES_ADDITIONAL_FRAME)) {
-            DropField();
+            desfire_drop_field();
             return res;
         }
     return res;
@@ -996,7 +1109,7 @@ static int test_desfire_authenticate_aes(void) {
     int res = send_desfire_cmd(&apdu, true, NULL, &recv_len, &sw, 0, false);
     if (res == PM3_SUCCESS)
         if (sw == status(MFDES_ADDITIONAL_FRAME)) {
-            DropField();
+            desfire_drop_field();
             return res;
         }
     return res;
@@ -1129,7 +1242,7 @@ static int mifare_desfire_change_key(uint8_t key_no, uint8_t *new_key, uint8_t n
 
     if (res != PM3_SUCCESS) {
         PrintAndLogEx(WARNING, _RED_("   Can't change key -> %s"), GetErrorString(res, &sw));
-        DropField();
+        desfire_drop_field();
         return res;
     }
 
@@ -1236,7 +1349,7 @@ static int handler_desfire_signature(uint8_t *signature, size_t *signature_len)
             *signature_len = recv_len;
         }
     }
-    DropField();
+    desfire_drop_field();
     return res;
 }
 
@@ -1436,16 +1549,23 @@ static int handler_desfire_select_application(uint8_t *aid) {
         if (aid == NULL) PrintAndLogEx(ERR, "AID=NULL");
     }
     if (aid == NULL) return PM3_EINVARG;
+
+    if (desfire_session && memcmp(desfire_session_aid, aid, sizeof(desfire_session_aid)) == 0) {
+        memcpy(&tag->selected_application, aid, 3);
+        return PM3_SUCCESS;
+    }
+
     sAPDU apdu = {0x90, MFDES_SELECT_APPLICATION, 0x00, 0x00, 0x03, aid}; //0x5a
     uint32_t recv_len = 0;
     uint16_t sw = 0;
     int res = send_desfire_cmd(&apdu, true, NULL, &recv_len, &sw, sizeof(dfname_t), true);
     if (res != PM3_SUCCESS) {
         PrintAndLogEx(WARNING, _RED_("   Can't select AID 0x%X -> %s"), (aid[2] << 16) + (aid[1] << 8) + aid[0], GetErrorString(res, &sw));
-        DropField();
+        desfire_drop_field();
         return res;
     }
     memcpy(&tag->selected_application, aid, 3);
+    memcpy(desfire_session_aid, aid, sizeof(desfire_session_aid));
     return PM3_SUCCESS;
 }
 
@@ -1484,7 +1604,7 @@ static int handler_desfire_fileids(uint8_t *dest, uint32_t *file_ids_len) {
     int res = send_desfire_cmd(&apdu, false, dest, &recv_len, &sw, 0, true);
     if (res != PM3_SUCCESS) {
         PrintAndLogEx(WARNING, _RED_("   Can't get file ids -> %s"), GetErrorString(res, &sw));
-        DropField();
+        desfire_drop_field();
         return res;
     }
     *file_ids_len = recv_len;
@@ -1503,7 +1623,7 @@ static int handler_desfire_filesettings(uint8_t file_id, uint8_t *dest, uint32_t
     int res = send_desfire_cmd(&apdu, false, dest, destlen, &sw, 0, true);
     if (res != PM3_SUCCESS) {
         PrintAndLogEx(WARNING, _RED_("   Can't get file settings -> %s"), GetErrorString(res, &sw));
-        DropField();
+        desfire_drop_field();
         return res;
     }
     return res;
@@ -1542,7 +1662,7 @@ static int handler_desfire_createapp(aidhdr_t *aidhdr, bool usename, bool usefid
     if (data != NULL) free(data);
     if (res != PM3_SUCCESS) {
         PrintAndLogEx(WARNING, _RED_("   Can't create aid -> %s"), GetErrorString(res, &sw));
-        DropField();
+        desfire_drop_field();
         return res;
     }
 
@@ -1557,7 +1677,7 @@ static int handler_desfire_deleteapp(const uint8_t *aid) {
     int res = send_desfire_cmd(&apdu, false, NULL, &recvlen, &sw, 0, true);
     if (res != PM3_SUCCESS) {
         PrintAndLogEx(WARNING, _RED_("   Can't delete aid -> %s"), GetErrorString(res, &sw));
-        DropField();
+        desfire_drop_field();
         return res;
     }
     return res;
@@ -1576,7 +1696,7 @@ static int handler_desfire_credit(mfdes_value_t *value, uint8_t cs) {
     int res = send_desfire_cmd(&apdu, false, NULL, &recvlen, &sw, 0, true);
     if (res != PM3_SUCCESS) {
         PrintAndLogEx(WARNING, _RED_("   Can't credit value -> %s"), GetErrorString(res, &sw));
-        DropField();
+        desfire_drop_field();
         return res;
     }
     return res;
@@ -1595,7 +1715,7 @@ static int handler_desfire_limitedcredit(mfdes_value_t *value, uint8_t cs) {
     int res = send_desfire_cmd(&apdu, false, NULL, &recvlen, &sw, 0, true);
     if (res != PM3_SUCCESS) {
         PrintAndLogEx(WARNING, _RED_("   Can't credit limited value -> %s"), GetErrorString(res, &sw));
-        DropField();
+        desfire_drop_field();
         return res;
     }
     return res;
@@ -1614,7 +1734,7 @@ static int handler_desfire_debit(mfdes_value_t *value, uint8_t cs) {
     int res = send_desfire_cmd(&apdu, false, NULL, &recvlen, &sw, 0, true);
     if (res != PM3_SUCCESS) {
         PrintAndLogEx(WARNING, _RED_("   Can't debit value -> %s"), GetErrorString(res, &sw));
-        DropField();
+        desfire_drop_field();
         return res;
     }
     return res;
@@ -1636,7 +1756,7 @@ static int handler_desfire_readdata(mfdes_data_t *data, MFDES_FILE_TYPE_T type,
     int res = send_desfire_cmd(&apdu, false, data->data, &resplen, &sw, 0, true);
     if (res != PM3_SUCCESS) {
         PrintAndLogEx(WARNING, _RED_("   Can't read data -> %s"), GetErrorString(res, &sw));
-        DropField();
+        desfire_drop_field();
         return res;
     }
 
@@ -1666,7 +1786,7 @@ static int handler_desfire_getvalue(mfdes_value_t *value, uint32_t *resplen, uin
     int res = send_desfire_cmd(&apdu, false, value->value, resplen, &sw, 0, true);
     if (res != PM3_SUCCESS) {
         PrintAndLogEx(WARNING, _RED_("   Can't read data -> %s"), GetErrorString(res, &sw));
-        DropField();
+        desfire_drop_field();
         return res;
     }
     size_t dlen = (size_t)resplen;
@@ -1721,7 +1841,7 @@ static int handler_desfire_writedata(mfdes_data_t *data, MFDES_FILE_TYPE_T type,
         res = send_desfire_cmd(&apdu, false, NULL, &recvlen, &sw, 0, true);
         if (res != PM3_SUCCESS) {
             PrintAndLogEx(WARNING, _RED_("   Can't write data -> %s"), GetErrorString(res, &sw));
-            DropField();
+            desfire_drop_field();
             return res;
         }
         offset += datasize;
@@ -1731,7 +1851,7 @@ static int handler_desfire_writedata(mfdes_data_t *data, MFDES_FILE_TYPE_T type,
     if (type == MFDES_RECORD_FILE) {
         if (handler_desfire_commit_transaction() != PM3_SUCCESS) {
             PrintAndLogEx(WARNING, _RED_("   Can't commit transaction -> %s"), GetErrorString(res, &sw));
-            DropField();
+            desfire_drop_field();
             return res;
         }
     }
@@ -1746,7 +1866,7 @@ static int handler_desfire_deletefile(uint8_t fileno) {
     int res = send_desfire_cmd(&apdu, false, NULL, &recvlen, &sw, 0, true);
     if (res != PM3_SUCCESS) {
         PrintAndLogEx(WARNING, _RED_("   Can't delete file -> %s"), GetErrorString(res, &sw));
-        DropField();
+        desfire_drop_field();
         return res;
     }
     return res;
@@ -1760,13 +1880,13 @@ static int handler_desfire_clearrecordfile(uint8_t fileno) {
     int res = send_desfire_cmd(&apdu, false, NULL, &recvlen, &sw, 0, true);
     if (res != PM3_SUCCESS) {
         PrintAndLogEx(WARNING, _RED_("   Can't clear record file -> %s"), GetErrorString(res, &sw));
-        DropField();
+        desfire_drop_field();
         return res;
     } else {
         res = handler_desfire_commit_transaction();
         if (res != PM3_SUCCESS) {
             PrintAndLogEx(WARNING, _RED_("   Can't commit transaction -> %s"), GetErrorString(res, &sw));
-            DropField();
+            desfire_drop_field();
             return res;
         }
     }
@@ -1783,7 +1903,7 @@ static int handler_desfire_create_value_file(mfdes_value_file_t *value) {
     int res = send_desfire_cmd(&apdu, false, NULL, &recvlen, &sw, 0, true);
     if (res != PM3_SUCCESS) {
         PrintAndLogEx(WARNING, _RED_("   Can't create value -> %s"), GetErrorString(res, &sw));
-        DropField();
+        desfire_drop_field();
         return res;
     }
     return res;
@@ -1798,7 +1918,7 @@ static int handler_desfire_create_std_file(mfdes_file_t *file) {
     int res = send_desfire_cmd(&apdu, false, NULL, &recvlen, &sw, 0, true);
     if (res != PM3_SUCCESS) {
         PrintAndLogEx(WARNING, _RED_("   Can't create file -> %s"), GetErrorString(res, &sw));
-        DropField();
+        desfire_drop_field();
         return res;
     }
     return res;
@@ -1814,7 +1934,7 @@ static int handler_desfire_create_linearrecordfile(mfdes_linear_t *file) {
     int res = send_desfire_cmd(&apdu, false, NULL, &recvlen, &sw, 0, true);
     if (res != PM3_SUCCESS) {
         PrintAndLogEx(WARNING, _RED_("   Can't create linear record file -> %s"), GetErrorString(res, &sw));
-        DropField();
+        desfire_drop_field();
         return res;
     }
     return res;
@@ -1830,7 +1950,7 @@ static int handler_desfire_create_cyclicrecordfile(mfdes_linear_t *file) {
     int res = send_desfire_cmd(&apdu, false, NULL, &recvlen, &sw, 0, true);
     if (res != PM3_SUCCESS) {
         PrintAndLogEx(WARNING, _RED_("   Can't create cyclic record file -> %s"), GetErrorString(res, &sw));
-        DropField();
+        desfire_drop_field();
         return res;
     }
     return res;
@@ -1846,7 +1966,7 @@ static int handler_desfire_create_backup_file(mfdes_file_t *file) {
     int res = send_desfire_cmd(&apdu, false, NULL, &recvlen, &sw, 0, true);
     if (res != PM3_SUCCESS) {
         PrintAndLogEx(WARNING, _RED_("   Can't create backup file -> %s"), GetErrorString(res, &sw));
-        DropField();
+        desfire_drop_field();
         return res;
     }
     return res;
@@ -1947,7 +2067,7 @@ static int getKeySettings(uint8_t *aid) {
         }
     }
 
-    DropField();
+    desfire_drop_field();
     return PM3_SUCCESS;
 }
 
@@ -2055,7 +2175,7 @@ static int CmdHF14ADesGetUID(const char *Cmd) {
     uint8_t uid[16] = {0};
     int res = handler_desfire_getuid(uid);
     if (res != PM3_SUCCESS) {
-        DropField();
+        desfire_drop_field();
         PrintAndLogEx(ERR, "Error on getting uid.");
         return res;
     }
@@ -2090,7 +2210,7 @@ static int CmdHF14ADesSelectApp(const char *Cmd) {
 
     int res = handler_desfire_select_application(aid);
     if (res != PM3_SUCCESS) {
-        DropField();
+        desfire_drop_field();
         PrintAndLogEx(ERR, "Error on selecting aid.");
         return res;
     }
@@ -2216,12 +2336,12 @@ static int CmdHF14ADesCreateApp(const char *Cmd) {
     uint8_t rootaid[3] = {0x00, 0x00, 0x00};
     int res = handler_desfire_select_application(rootaid);
     if (res != PM3_SUCCESS) {
-        DropField();
+        desfire_drop_field();
         return res;
     }
 
     res = handler_desfire_createapp(&aidhdr, usename, usefid);
-    DropField();
+    desfire_drop_field();
     PrintAndLogEx(SUCCESS, "Successfully created aid.");
     return res;
 }
@@ -2257,9 +2377,9 @@ static int CmdHF14ADesDeleteApp(const char *Cmd) {
 
     uint8_t rootaid[3] = {0x00, 0x00, 0x00};
     int res = handler_desfire_select_application(rootaid);
-    if (res != PM3_SUCCESS) { DropField(); return res;}
+    if (res != PM3_SUCCESS) { desfire_drop_field(); return res;}
     res = handler_desfire_deleteapp(aid);
-    DropField();
+    desfire_drop_field();
     PrintAndLogEx(SUCCESS, "Successfully deleted aid.");
     return res;
 }
@@ -2349,7 +2469,7 @@ static int CmdHF14ADesClearRecordFile(const char *Cmd) {
     } else {
         PrintAndLogEx(ERR, "Error on deleting file : %d", res);
     }
-    DropField();
+    desfire_drop_field();
     return res;
 }
 
@@ -2411,7 +2531,7 @@ static int CmdHF14ADesDeleteFile(const char *Cmd) {
     } else {
         PrintAndLogEx(ERR, "Error on deleting file : %d", res);
     }
-    DropField();
+    desfire_drop_field();
     return res;
 }
 
@@ -2501,12 +2621,12 @@ static int CmdHF14ADesCreateFile(const char *Cmd) {
 
     if (aidlength != 3 && aidlength != 0) {
         PrintAndLogEx(ERR, _RED_("   The given aid must have 3 bytes (big endian)."));
-        DropField();
+        desfire_drop_field();
         return PM3_ESOFT;
     } else if (aidlength == 0) {
         if (memcmp(&tag->selected_application, aid, 3) == 0) {
             PrintAndLogEx(ERR, _RED_("   You need to select an aid first."));
-            DropField();
+            desfire_drop_field();
             return PM3_ESOFT;
         }
         memcpy(aid, (uint8_t *)&tag->selected_application, 3);
@@ -2515,7 +2635,7 @@ static int CmdHF14ADesCreateFile(const char *Cmd) {
     int res = handler_desfire_select_application(aid);
     if (res != PM3_SUCCESS) {
         PrintAndLogEx(ERR, "Couldn't select aid. Error %d", res);
-        DropField();
+        desfire_drop_field();
         return res;
     }
 
@@ -2529,7 +2649,7 @@ static int CmdHF14ADesCreateFile(const char *Cmd) {
     else
         PrintAndLogEx(ERR, "Couldn't create standard/backup file. Error %d", res);
 
-    DropField();
+    desfire_drop_field();
     return res;
 }
 
@@ -2601,7 +2721,7 @@ static int CmdHF14ADesGetValueData(const char *Cmd) {
     } else {
         PrintAndLogEx(ERR, "Couldn't read value. Error %d", res);
     }
-    DropField();
+    desfire_drop_field();
     return res;
 }
 
@@ -2719,12 +2839,12 @@ static int CmdHF14ADesReadData(const char *Cmd) {
             }
         } else {
             PrintAndLogEx(ERR, "Couldn't read data. Error %d", res);
-            DropField();
+            desfire_drop_field();
             return res;
         }
         free(data);
     }
-    DropField();
+    desfire_drop_field();
     return res;
 }
 
@@ -2821,7 +2941,7 @@ static int CmdHF14ADesChangeValue(const char *Cmd) {
     } else {
         PrintAndLogEx(ERR, "Couldn't change value in value file. Error %d", res);
     }
-    DropField();
+    desfire_drop_field();
     return res;
 }
 
@@ -2916,7 +3036,7 @@ static int CmdHF14ADesWriteData(const char *Cmd) {
     uint8_t cs = 0;
     if (selectfile(aid, _fileno[0], &cs) != PM3_SUCCESS) {
         PrintAndLogEx(ERR, _RED_("   Error on selecting file."));
-        DropField();
+        desfire_drop_field();
         return PM3_ESOFT;
     }
 
@@ -2928,7 +3048,7 @@ static int CmdHF14ADesWriteData(const char *Cmd) {
     } else {
         PrintAndLogEx(ERR, "Couldn't read data. Error %d", res);
     }
-    DropField();
+    desfire_drop_field();
     return res;
 }
 
@@ -3063,7 +3183,7 @@ static int CmdHF14ADesCreateRecordFile(const char *Cmd) {
     } else {
         PrintAndLogEx(ERR, "Couldn't create linear/cyclic record file. Error %d", res);
     }
-    DropField();
+    desfire_drop_field();
     return res;
 }
 
@@ -3196,7 +3316,7 @@ static int CmdHF14ADesCreateValueFile(const char *Cmd) {
     } else {
         PrintAndLogEx(ERR, "Couldn't create value file. Error %d", res);
     }
-    DropField();
+    desfire_drop_field();
     return res;
 }
 
@@ -3218,19 +3338,19 @@ static int CmdHF14ADesFormatPICC(const char *Cmd) {
     } else {
         PrintAndLogEx(INFO, "Card successfully reset");
     }
-    DropField();
+    desfire_drop_field();
     return res;
 }
 
 static int CmdHF14ADesInfo(const char *Cmd) {
     (void)Cmd; // Cmd is not used so far
-    DropField();
+    desfire_drop_field();
     SendCommandNG(CMD_HF_DESFIRE_INFO, NULL, 0);
     PacketResponseNG resp;
 
     if (WaitForResponseTimeout(CMD_HF_DESFIRE_INFO, &resp, 1500) == false) {
         PrintAndLogEx(WARNING, "Command execute timeout");
-        DropField();
+        desfire_drop_field();
         return PM3_ETIMEOUT;
     }
 
@@ -3357,7 +3477,7 @@ static int CmdHF14ADesInfo(const char *Cmd) {
 
     */
 
-    DropField();
+    desfire_drop_field();
     return PM3_SUCCESS;
 }
 
@@ -3494,7 +3614,7 @@ static int DecodeFileSettings(uint8_t *src, int src_len, int maclen) {
 
 static int CmdHF14ADesDump(const char *Cmd) {
     (void)Cmd; // Cmd is not used so far
-    DropField();
+    desfire_drop_field();
 
     uint8_t aid[3] = {0};
     uint8_t app_ids[78] = {0};
@@ -3510,7 +3630,7 @@ static int CmdHF14ADesDump(const char *Cmd) {
 
     if (handler_desfire_appids(app_ids, &app_ids_len) != PM3_SUCCESS) {
         PrintAndLogEx(ERR, "Can't get list of applications on tag");
-        DropField();
+        desfire_drop_field();
         return PM3_ESOFT;
     }
 
@@ -3568,7 +3688,7 @@ static int CmdHF14ADesDump(const char *Cmd) {
 
                 uint8_t *data = (uint8_t *)calloc(filesize, sizeof(uint8_t));
                 if (data == NULL) {
-                    DropField();
+                    desfire_drop_field();
                     return PM3_EMALLOC;
                 }
 
@@ -3615,7 +3735,7 @@ static int CmdHF14ADesDump(const char *Cmd) {
                 memset(fdata.length, 0, 3);
                 uint8_t *data = (uint8_t *)calloc(filesize, sizeof(uint8_t));
                 if (data == NULL) {
-                    DropField();
+                    desfire_drop_field();
                     return PM3_EMALLOC;
                 }
 
@@ -3645,14 +3765,14 @@ static int CmdHF14ADesDump(const char *Cmd) {
     }
 
     PrintAndLogEx(INFO, "-------------------------------------------------------------");
-    DropField();
+    desfire_drop_field();
     return PM3_SUCCESS;
 }
 
 static int CmdHF14ADesEnumApplications(const char *Cmd) {
 
     (void)Cmd; // Cmd is not used so far
-    DropField();
+    desfire_drop_field();
 
     uint8_t aid[3] = {0};
     uint8_t app_ids[78] = {0};
@@ -3666,7 +3786,7 @@ static int CmdHF14ADesEnumApplications(const char *Cmd) {
 
     if (handler_desfire_appids(app_ids, &app_ids_len) != PM3_SUCCESS) {
         PrintAndLogEx(ERR, "Can't get list of applications on tag");
-        DropField();
+        desfire_drop_field();
         return PM3_ESOFT;
     }
 
@@ -3730,12 +3850,12 @@ static int CmdHF14ADesEnumApplications(const char *Cmd) {
 
     }
     PrintAndLogEx(INFO, "-------------------------------------------------------------");
-    DropField();
+    desfire_drop_field();
     return PM3_SUCCESS;
 }
 
 static int CmdHF14ADesChangeKey(const char *Cmd) {
-    //DropField();
+    //desfire_drop_field();
     // NR  DESC     KEYLENGHT
     // ------------------------
     // 1 = DES      8
@@ -3833,7 +3953,7 @@ static int CmdHF14ADesChangeKey(const char *Cmd) {
 //
 #define BUFSIZE 256
 static int CmdHF14ADesAuth(const char *Cmd) {
-    //DropField();
+    //desfire_drop_field();
     // NR  DESC     KEYLENGHT
     // ------------------------
     // 1 = DES      8
@@ -3977,6 +4097,48 @@ static void DesFill2bPattern(
     (*startPattern)++;
 }
 
+// Tries the keys on one key slot of the selected application, the auth steps run on the device in
+// batches of what fits one command. found gets the index of the key that authenticated, -1 without one
+static int desfire_check_keys(uint8_t mode, uint8_t algo, uint8_t keyno, uint8_t *keys, uint8_t keylen, uint32_t count, int *found) {
+    *found = -1;
+
+    desfire_chk_req_t req = {0};
+    req.mode = mode;
+    req.algo = algo;
+    req.keyno = keyno;
+    req.keylen = keylen;
+
+    uint32_t batch = MIN(DESFIRE_CHK_KEYS_DATA / keylen, 0xFF);
+    for (uint32_t pos = 0; pos < count; pos += batch) {
+
+        if (kbd_enter_pressed()) {
+            PrintAndLogEx(WARNING, "\nAborted via keyboard!");
+            return PM3_EOPABORTED;
+        }
+
+        req.count = MIN(batch, count - pos);
+        memcpy(req.keys, keys + pos * keylen, req.count * keylen);
+
+        clearCommandBuffer();
+        SendCommandNG(CMD_HF_DESFIRE_CHKKEYS, (uint8_t *)&req, sizeof(req) - sizeof(req.keys) + req.count * keylen);
+
+        PacketResponseNG resp;
+        if (WaitForResponseTimeout(CMD_HF_DESFIRE_CHKKEYS, &resp, 5000) == false) {
+            PrintAndLogEx(WARNING, "timeout while waiting for reply.");
+            return PM3_ETIMEOUT;
+        }
+        if (resp.status != PM3_SUCCESS)
+            return resp.status;
+
+        desfire_chk_resp_t *payload = (desfire_chk_resp_t *)resp.data.asBytes;
+        if (payload->found) {
+            *found = pos + payload->index;
+            break;
+        }
+    }
+    return PM3_SUCCESS;
+}
+
 static int AuthCheckDesfire(uint8_t *aid,
                             uint8_t deskeyList[MAX_KEYS_LIST_LEN][8], uint32_t deskeyListLen,
                             uint8_t aeskeyList[MAX_KEYS_LIST_LEN][16], uint32_t aeskeyListLen,
@@ -4060,137 +4222,58 @@ static int AuthCheckDesfire(uint8_t *aid,
         des = true;
     }
 
-    int error = PM3_SUCCESS;
-    bool badlen = false;
-
-    if (des) {
-
-        for (uint8_t keyno = 0; keyno < 0xE; keyno++) {
+    struct {
+        bool used;
+        uint8_t mode;
+        uint8_t algo;
+        const char *name;
+        uint8_t *keys;
+        uint8_t keylen;
+        uint32_t count;
+    } checks[] = {
+        {des,    MFDES_AUTH_DES, MFDES_ALGO_DES,    "DES",  (uint8_t *)deskeyList, 8,  deskeyListLen},
+        {tdes,   MFDES_AUTH_DES, MFDES_ALGO_3DES,   "3DES", (uint8_t *)aeskeyList, 16, aeskeyListLen},
+        {aes,    MFDES_AUTH_AES, MFDES_ALGO_AES,    "AES",  (uint8_t *)aeskeyList, 16, aeskeyListLen},
+        {k3kdes, MFDES_AUTH_ISO, MFDES_ALGO_3K3DES, "3K3",  (uint8_t *)k3kkeyList, 24, k3kkeyListLen},
+    };
 
-            if (usedkeys[keyno] == 1 && foundKeys[0][keyno][0] == 0) {
-                for (uint32_t curkey = 0; curkey < deskeyListLen; curkey++) {
-                    mfdes_auth_res_t rpayload;
-                    error = desfire_authenticate(MFDES_AUTH_DES, MFDES_ALGO_DES, aid, deskeyList[curkey], keyno, &rpayload);
-                    if (error == PM3_SUCCESS) {
-                        PrintAndLogEx(SUCCESS, "AID 0x%06X, Found DES Key %u        : " _GREEN_("%s"), curaid, keyno, sprint_hex(deskeyList[curkey], 8));
-                        foundKeys[0][keyno][0] = 0x01;
-                        *result = true;
-                        memcpy(&foundKeys[0][keyno][1], deskeyList[curkey], 8);
-                        break;
-                    } else if (error < 7) {
-                        badlen = true;
-                        DropField();
-                        res = handler_desfire_select_application(aid);
-                        if (res != PM3_SUCCESS) {
-                            return res;
-                        }
-                        break;
-                    }
-                }
-                if (badlen == true) {
-                    badlen = false;
-                    break;
-                }
-            }
-        }
-    }
+    for (uint8_t c = 0; c < ARRAYLEN(checks); c++) {
 
-    if (tdes) {
+        if (checks[c].used == false)
+            continue;
 
         for (uint8_t keyno = 0; keyno < 0xE; keyno++) {
 
-            if (usedkeys[keyno] == 1 && foundKeys[1][keyno][0] == 0) {
-                for (uint32_t curkey = 0; curkey < aeskeyListLen; curkey++) {
-                    mfdes_auth_res_t rpayload;
-                    error = desfire_authenticate(MFDES_AUTH_DES, MFDES_ALGO_3DES, aid, aeskeyList[curkey], keyno, &rpayload);
-                    if (error == PM3_SUCCESS) {
-                        PrintAndLogEx(SUCCESS, "AID 0x%06X, Found 3DES Key %u        : " _GREEN_("%s"), curaid, keyno, sprint_hex(aeskeyList[curkey], 16));
-                        foundKeys[1][keyno][0] = 0x01;
-                        *result = true;
-                        memcpy(&foundKeys[1][keyno][1], aeskeyList[curkey], 16);
-                        break;
-                    } else if (error < 7) {
-                        badlen = true;
-                        DropField();
-                        res = handler_desfire_select_application(aid);
-                        if (res != PM3_SUCCESS) {
-                            return res;
-                        }
-                        break;
-                    }
-                }
-                if (badlen == true) {
-                    badlen = false;
-                    break;
-                }
-            }
-        }
-    }
-
-    if (aes) {
+            if (usedkeys[keyno] == 0 || foundKeys[c][keyno][0] != 0)
+                continue;
 
-        for (uint8_t keyno = 0; keyno < 0xE; keyno++) {
-
-            if (usedkeys[keyno] == 1 && foundKeys[2][keyno][0] == 0) {
-                for (uint32_t curkey = 0; curkey < aeskeyListLen; curkey++) {
-                    mfdes_auth_res_t rpayload;
-                    error = desfire_authenticate(MFDES_AUTH_AES, MFDES_ALGO_AES, aid, aeskeyList[curkey], keyno, &rpayload);
-                    if (error == PM3_SUCCESS) {
-                        PrintAndLogEx(SUCCESS, "AID 0x%06X, Found AES Key %u        : " _GREEN_("%s"), curaid, keyno, sprint_hex(aeskeyList[curkey], 16));
-                        foundKeys[2][keyno][0] = 0x01;
-                        *result = true;
-                        memcpy(&foundKeys[2][keyno][1], aeskeyList[curkey], 16);
-                        break;
-                    } else if (error < 7) {
-                        badlen = true;
-                        DropField();
-                        res = handler_desfire_select_application(aid);
-                        if (res != PM3_SUCCESS) {
-                            return res;
-                        }
-                        break;
-                    }
-                }
-                if (badlen == true) {
-                    badlen = false;
-                    break;
-                }
+            int found = -1;
+            res = desfire_check_keys(checks[c].mode, checks[c].algo, keyno, checks[c].keys, checks[c].keylen, checks[c].count, &found);
+            if (res == PM3_EOPABORTED) {
+                desfire_drop_field();
+                return res;
             }
-        }
-    }
 
-    if (k3kdes) {
-
-        for (uint8_t keyno = 0; keyno < 0xE; keyno++) {
-
-            if (usedkeys[keyno] == 1 && foundKeys[3][keyno][0] == 0) {
-                for (uint32_t curkey = 0; curkey < k3kkeyListLen; curkey++) {
-                    mfdes_auth_res_t rpayload;
-                    error = desfire_authenticate(MFDES_AUTH_ISO, MFDES_ALGO_3K3DES, aid, k3kkeyList[curkey], keyno, &rpayload);
-                    if (error == PM3_SUCCESS) {
-                        PrintAndLogEx(SUCCESS, "AID 0x%06X, Found 3K3 Key %u        : " _GREEN_("%s"), curaid, keyno, sprint_hex(k3kkeyList[curkey], 24));
-                        foundKeys[3][keyno][0] = 0x01;
-                        *result = true;
-                        memcpy(&foundKeys[3][keyno][1], k3kkeyList[curkey], 16);
-                        break;
-                    } else if (error < 7) {
-                        badlen = true;
-                        DropField();
-                        res = handler_desfire_select_application(aid);
-                        if (res != PM3_SUCCESS) {
-                            return res;
-                        }
-                        break;
-                    }
+            // the card refused the key slot, the rest of this algo is skipped
+            if (res != PM3_SUCCESS) {
+                desfire_drop_field();
+                res = handler_desfire_select_application(aid);
+                if (res != PM3_SUCCESS) {
+                    return res;
                 }
+                break;
+            }
 
-                if (badlen == true) {
-                    break;
-                }
+            if (found >= 0) {
+                uint8_t *key = checks[c].keys + found * checks[c].keylen;
+                PrintAndLogEx(SUCCESS, "AID 0x%06X, Found %s Key %u        : " _GREEN_("%s"), curaid, checks[c].name, keyno, sprint_hex(key, checks[c].keylen));
+                foundKeys[c][keyno][0] = 0x01;
+                *result = true;
+                memcpy(&foundKeys[c][keyno][1], key, checks[c].keylen);
             }
         }
     }
-    DropField();
+    desfire_drop_field();
     return PM3_SUCCESS;
 }
 
@@ -4374,7 +4457,7 @@ static int CmdHF14aDesChk(const char *Cmd) {
 
     if (handler_desfire_appids(app_ids, &app_ids_len) != PM3_SUCCESS) {
         PrintAndLogEx(ERR, "Can't get list of applications on tag");
-        DropField();
+        desfire_drop_field();
         return PM3_ESOFT;
     }
 
@@ -4469,7 +4552,7 @@ static int CmdHF14ADesList(const char *Cmd) {
 
 /*
 static int CmdHF14aDesNDEF(const char *Cmd) {
-    DropField();
+    desfire_drop_field();
 
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf mfdes ndef",
@@ -4532,7 +4615,7 @@ static int CmdHF14aDesNDEF(const char *Cmd) {
 
             uint8_t *data = (uint8_t *)calloc(filesize, sizeof(uint8_t));
             if (data == NULL) {
-                DropField();
+                desfire_drop_field();
                 return PM3_EMALLOC;
             }
 
@@ -24,6 +24,13 @@
 #include <math.h>
 #include <time.h> // MingW
 #include <bzlib.h>
+#include <sys/stat.h>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#define HAVE_TABLE_CACHE
+#endif
 
 #include "commonutil.h"  // ARRAYLEN
 #include "comms.h"
@@ -37,6 +44,8 @@
 #include "hardnested_bf_core.h"
 #include "hardnested_bitarray_core.h"
 #include "fileutils.h"
+#include "util.h"    // num_CPUs
+#include "jansson.h"
 
 #define NUM_CHECK_BITFLIPS_THREADS      (num_CPUs())
 #define NUM_REDUCTION_WORKING_THREADS   (num_CPUs())
@@ -46,6 +55,19 @@
 #define STATE_FILES_DIRECTORY           "hardnested_tables/"
 #define STATE_FILE_TEMPLATE             "bitflip_%d_%03" PRIx16 "_states.bin.bz2"
 
+#define TABLE_CACHE_FILENAME            "bitflip_tables.bin"
+#define TABLE_CACHE_MAGIC               0x48334d50 // "PM3H"
+#define TABLE_CACHE_VERSION             1
+#define TABLE_CACHE_PAGE                4096
+#define BITFLIP_BITARRAY_SIZE           (sizeof(uint32_t) * (1 << 19))
+
+#define NONCE_FILE_MAGIC                0x484e4e43 // "HNNC"
+#define NONCE_FILE_VERSION              2
+#define NONCE_FILE_HDR_SIZE             12
+#define NONCE_CHUNK_HDR_SIZE            5
+#define NONCE_CHUNK_PAIRS               'P'
+#define NONCE_CHUNK_INDEX               'I'
+
 #define DEBUG_KEY_ELIMINATION
 // #define DEBUG_REDUCTION
 
@@ -93,6 +115,18 @@ static void get_SIMD_instruction_set(char *instruction_set) {
         case SIMD_MMX:
             strcpy(instruction_set, "MMX");
             break;
+#endif
+#if defined(COMPILER_HAS_SIMD_NEON)
+        case SIMD_NEON:
+            strcpy(instruction_set, "NEON");
+            break;
+#endif
+#if defined(HAVE_OPENCL)
+        case SIMD_OPENCL:
+            strcpy(instruction_set, "OpenCL");
+            break;
+#else
+        case SIMD_OPENCL:
 #endif
         case SIMD_AUTO:
         case SIMD_NONE:
@@ -228,6 +262,152 @@ static void init_bunzip2(bz_stream *compressed_stream, char *input_buffer, uint3
 }
 
 
+//----------------------------------------------------------------------------
+// Uncompressed cache of the bitflip tables, ~/.proxmark3/hardnested_cache/
+//
+// Bunzipping all tables takes several seconds. The first run writes the
+// effective ones into a single file, page aligned, later runs map it read only
+// and shared, so concurrent clients use the same pages.
+//
+// The fingerprint covers which bz2 tables were found and their sizes, a
+// changed table set rebuilds the cache.
+//----------------------------------------------------------------------------
+#if defined(HAVE_TABLE_CACHE)
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t num_tables;
+    uint64_t fingerprint;
+} PACKED table_cache_hdr_t;
+
+typedef struct {
+    uint16_t odd_even;
+    uint16_t bitflip;
+    uint32_t count;
+} PACKED table_cache_entry_t;
+
+static void *table_cache_map = NULL;
+static size_t table_cache_len = 0;
+
+// tables start on the first page after the header and entries
+static size_t table_cache_data_offset(uint16_t num_tables) {
+    size_t len = sizeof(table_cache_hdr_t) + num_tables * sizeof(table_cache_entry_t);
+    return (len + TABLE_CACHE_PAGE - 1) / TABLE_CACHE_PAGE * TABLE_CACHE_PAGE;
+}
+
+static bool table_cache_load(uint64_t fingerprint) {
+
+    char *path = NULL;
+    if (searchHomeFilePath(&path, HARDNESTED_CACHE_SUBDIR, TABLE_CACHE_FILENAME, false) != PM3_SUCCESS)
+        return false;
+
+    int fd = open(path, O_RDONLY);
+    free(path);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    table_cache_hdr_t hdr;
+    if (fstat(fd, &st) != 0 || read(fd, &hdr, sizeof(hdr)) != sizeof(hdr)
+            || hdr.magic != TABLE_CACHE_MAGIC || hdr.version != TABLE_CACHE_VERSION || hdr.fingerprint != fingerprint
+            || (size_t)st.st_size != table_cache_data_offset(hdr.num_tables) + hdr.num_tables * BITFLIP_BITARRAY_SIZE) {
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    const table_cache_entry_t *entry = (const table_cache_entry_t *)((uint8_t *)map + sizeof(hdr));
+    uint8_t *data = (uint8_t *)map + table_cache_data_offset(hdr.num_tables);
+    for (uint16_t i = 0; i < hdr.num_tables; i++, entry++) {
+        if (entry->odd_even > ODD_STATE || entry->bitflip == 0 || entry->bitflip >= 0x400) {
+            munmap(map, st.st_size);
+            return false;
+        }
+    }
+
+    entry = (const table_cache_entry_t *)((uint8_t *)map + sizeof(hdr));
+    for (uint16_t i = 0; i < hdr.num_tables; i++, entry++) {
+        bitflip_bitarrays[entry->odd_even][entry->bitflip] = (uint32_t *)(data + i * BITFLIP_BITARRAY_SIZE);
+        count_bitflip_bitarrays[entry->odd_even][entry->bitflip] = entry->count;
+        effective_bitflip[entry->odd_even][num_effective_bitflips[entry->odd_even]++] = entry->bitflip;
+    }
+
+    table_cache_map = map;
+    table_cache_len = st.st_size;
+    return true;
+}
+
+static void table_cache_store(uint64_t fingerprint) {
+
+    char *path = NULL;
+    if (searchHomeFilePath(&path, HARDNESTED_CACHE_SUBDIR, TABLE_CACHE_FILENAME, true) != PM3_SUCCESS)
+        return;
+
+    // write aside and rename, another client may be reading the old one
+    size_t len = strlen(path) + 16;
+    char *tmp = calloc(len, sizeof(char));
+    if (tmp == NULL) {
+        free(path);
+        return;
+    }
+    snprintf(tmp, len, "%s.%d", path, (int)getpid());
+
+    FILE *f = fopen(tmp, "wb");
+    if (f == NULL) {
+        PrintAndLogEx(DEBUG, "hardnested: could not write %s", tmp);
+        goto out;
+    }
+
+    table_cache_hdr_t hdr = {
+        .magic = TABLE_CACHE_MAGIC,
+        .version = TABLE_CACHE_VERSION,
+        .num_tables = num_effective_bitflips[EVEN_STATE] + num_effective_bitflips[ODD_STATE],
+        .fingerprint = fingerprint
+    };
+    bool ok = (fwrite(&hdr, sizeof(hdr), 1, f) == 1);
+
+    for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
+        for (uint16_t i = 0; i < num_effective_bitflips[odd_even]; i++) {
+            uint16_t bitflip = effective_bitflip[odd_even][i];
+            table_cache_entry_t entry = {odd_even, bitflip, count_bitflip_bitarrays[odd_even][bitflip]};
+            ok &= (fwrite(&entry, sizeof(entry), 1, f) == 1);
+        }
+    }
+
+    ok &= (fseek(f, table_cache_data_offset(hdr.num_tables), SEEK_SET) == 0);
+    for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
+        for (uint16_t i = 0; i < num_effective_bitflips[odd_even]; i++) {
+            uint16_t bitflip = effective_bitflip[odd_even][i];
+            ok &= (fwrite(bitflip_bitarrays[odd_even][bitflip], BITFLIP_BITARRAY_SIZE, 1, f) == 1);
+        }
+    }
+    ok &= (fclose(f) == 0);
+
+    if (ok == false || rename(tmp, path) != 0) {
+        PrintAndLogEx(DEBUG, "hardnested: could not write %s", path);
+        remove(tmp);
+    }
+
+out:
+    free(tmp);
+    free(path);
+}
+#else
+static bool table_cache_load(uint64_t fingerprint) {
+    (void)fingerprint;
+    return false;
+}
+
+static void table_cache_store(uint64_t fingerprint) {
+    (void)fingerprint;
+}
+#endif
+
+
 static void init_bitflip_bitarrays(void) {
 #if defined (DEBUG_REDUCTION)
     uint8_t line = 0;
@@ -237,7 +417,10 @@ static void init_bitflip_bitarrays(void) {
 
     char state_files_path[strlen(get_my_executable_directory()) + strlen(STATE_FILES_DIRECTORY) + strlen(STATE_FILE_TEMPLATE) + 1];
     char state_file_name[strlen(STATE_FILE_TEMPLATE) + 1];
+    char *state_file_paths[2][0x400] = {{NULL}};
 
+    // find the tables, fingerprint is FNV-1a over table id and file size
+    uint64_t fingerprint = 0xcbf29ce484222325ULL;
     for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
         num_effective_bitflips[odd_even] = 0;
         for (uint16_t bitflip = 0x001; bitflip < 0x400; bitflip++) {
@@ -253,6 +436,30 @@ static void init_bitflip_bitarrays(void) {
                 continue;
             }
 
+            struct stat st;
+            uint64_t id[2] = {(uint64_t)odd_even << 16 | bitflip, 0};
+            if (stat(path, &st) == 0)
+                id[1] = st.st_size;
+            for (size_t k = 0; k < sizeof(id); k++) {
+                fingerprint ^= ((uint8_t *)id)[k];
+                fingerprint *= 0x100000001b3ULL;
+            }
+            state_file_paths[odd_even][bitflip] = path;
+        }
+    }
+
+    bool cached = table_cache_load(fingerprint);
+
+    for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
+        for (uint16_t bitflip = 0x001; bitflip < 0x400; bitflip++) {
+
+            char *path = state_file_paths[odd_even][bitflip];
+            if (path == NULL || cached) {
+                free(path);
+                continue;
+            }
+            sprintf(state_file_name, STATE_FILE_TEMPLATE, odd_even, bitflip);
+
             FILE *statesfile = fopen(path, "rb");
             free(path);
             if (statesfile == NULL) {
@@ -285,14 +492,14 @@ static void init_bitflip_bitarrays(void) {
                     exit(4);
                 }
                 if ((float)count / (1 << 24) < IGNORE_BITFLIP_THRESHOLD) {
-                    uint32_t *bitset = (uint32_t *)malloc_bitarray(sizeof(uint32_t) * (1 << 19));
+                    uint32_t *bitset = (uint32_t *)malloc_bitarray(BITFLIP_BITARRAY_SIZE);
                     if (bitset == NULL) {
                         PrintAndLogEx(ERR, "Out of memory error in init_bitflip_statelists(). Aborting...\n");
                         BZ2_bzDecompressEnd(&compressed_stream);
                         exit(4);
                     }
                     compressed_stream.next_out = (char *)bitset;
-                    compressed_stream.avail_out = sizeof(uint32_t) * (1 << 19);
+                    compressed_stream.avail_out = BITFLIP_BITARRAY_SIZE;
                     res = BZ2_bzDecompress(&compressed_stream);
                     if (res != BZ_OK && res != BZ_STREAM_END) {
                         PrintAndLogEx(ERR, "Bunzip2 error. Aborting...\n");
@@ -317,6 +524,9 @@ static void init_bitflip_bitarrays(void) {
         effective_bitflip[odd_even][num_effective_bitflips[odd_even]] = 0x400; // EndOfList marker
     }
 
+    if (cached == false && num_effective_bitflips[EVEN_STATE] + num_effective_bitflips[ODD_STATE] > 0)
+        table_cache_store(fingerprint);
+
     uint16_t i = 0;
     uint16_t j = 0;
     num_all_effective_bitflips = 0;
@@ -358,6 +568,15 @@ static void init_bitflip_bitarrays(void) {
 
 
 static void free_bitflip_bitarrays(void) {
+#if defined(HAVE_TABLE_CACHE)
+    if (table_cache_map != NULL) {
+        munmap(table_cache_map, table_cache_len);
+        table_cache_map = NULL;
+        table_cache_len = 0;
+        memset(bitflip_bitarrays, 0, sizeof(bitflip_bitarrays));
+        return;
+    }
+#endif
     for (int16_t bitflip = 0x3ff; bitflip > 0x000; bitflip--) {
         free_bitarray(bitflip_bitarrays[ODD_STATE][bitflip]);
     }
@@ -515,6 +734,7 @@ static uint32_t num_all_bitflips_bitarray[2];
 static bool all_bitflips_bitarray_dirty[2];
 static uint64_t last_sample_clock = 0;
 static uint64_t sample_period = 0;
+static float brute_force_target = HARDNESTED_DEFAULT_TARGET;
 static uint64_t num_keys_tested = 0;
 static statelist_t *candidates = NULL;
 
@@ -1027,7 +1247,7 @@ static bool shrink_key_space(float *brute_forces) {
 //iceman 2018
     return ((hardnested_stage & CHECK_2ND_BYTES) &&
             reduction_rate >= 0.0 &&
-            (reduction_rate < brute_force_per_second * (float)sample_period / 1000.0  || *brute_forces < 0xF00000));
+            (reduction_rate < brute_force_per_second * (float)sample_period / 1000.0  || *brute_forces < brute_force_target));
 
 }
 
@@ -1048,6 +1268,101 @@ static void estimate_sum_a8(void) {
 }
 
 
+//----------------------------------------------------------------------------
+// Nonce file
+//
+// version 1: cuid (4) | target block (1) | target key type (1) | pairs...
+// version 2: magic (4) | version (1) | target block (1) | target key type (1) |
+//            flags (1) | cuid (4) | chunks...
+//
+// A pair is nt_enc1 (4) | nt_enc2 (4) | par_enc1 << 4 | par_enc2 (1). A chunk
+// is type (1) | length (4) | payload. Pair chunks hold the pairs as acquired,
+// the index chunk is appended when the acquisition ends and holds the number
+// of acquired nonces (4), the number of distinct nonces per first byte
+// (256 * 2) and those nonces (4 + 1 each), in nonce list order. When it is
+// there only the index is replayed, it never has more than 65536 entries.
+// All numbers are big endian.
+//----------------------------------------------------------------------------
+static void write_nonce_chunk(FILE *fnonces, uint8_t type, uint8_t *data, uint32_t len) {
+    uint8_t hdr[NONCE_CHUNK_HDR_SIZE];
+    hdr[0] = type;
+    num_to_bytes(len, 4, hdr + 1);
+    fwrite(hdr, 1, sizeof(hdr), fnonces);
+    fwrite(data, 1, len, fnonces);
+    fflush(fnonces);
+}
+
+static void write_nonce_file_header(FILE *fnonces, uint8_t trgBlockNo, uint8_t trgKeyType) {
+    uint8_t hdr[NONCE_FILE_HDR_SIZE] = {0};
+    num_to_bytes(NONCE_FILE_MAGIC, 4, hdr);
+    hdr[4] = NONCE_FILE_VERSION;
+    hdr[5] = trgBlockNo;
+    hdr[6] = trgKeyType;
+    num_to_bytes(cuid, 4, hdr + 8);
+    fwrite(hdr, 1, sizeof(hdr), fnonces);
+    fflush(fnonces);
+}
+
+static void write_nonce_index(FILE *fnonces) {
+    uint32_t len = 4 + 256 * 2;
+    for (uint16_t i = 0; i < 256; i++) {
+        len += nonces[i].num * 5;
+    }
+
+    uint8_t *buf = calloc(len, sizeof(uint8_t));
+    if (buf == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory, nonce file written without index");
+        return;
+    }
+
+    num_to_bytes(num_acquired_nonces, 4, buf);
+    uint8_t *p = buf + 4 + 256 * 2;
+    for (uint16_t i = 0; i < 256; i++) {
+        num_to_bytes(nonces[i].num, 2, buf + 4 + i * 2);
+        for (noncelistentry_t *e = nonces[i].first; e != NULL; e = e->next) {
+            num_to_bytes(e->nonce_enc, 4, p);
+            p[4] = e->par_enc;
+            p += 5;
+        }
+    }
+    write_nonce_chunk(fnonces, NONCE_CHUNK_INDEX, buf, len);
+    free(buf);
+}
+
+static void read_nonce_pairs(uint8_t *bufp, size_t len) {
+    for (; len >= 9; len -= 9, bufp += 9) {
+        uint32_t nt_enc1 = bytes_to_num(bufp, 4);
+        uint32_t nt_enc2 = bytes_to_num(bufp + 4, 4);
+        uint8_t par_enc = bytes_to_num(bufp + 8, 1);
+        add_nonce(nt_enc1, par_enc >> 4);
+        add_nonce(nt_enc2, par_enc & 0x0f);
+        num_acquired_nonces += 2;
+    }
+}
+
+static bool read_nonce_index(uint8_t *bufp, uint32_t len) {
+    if (len < 4 + 256 * 2) {
+        return false;
+    }
+    uint32_t need = 4 + 256 * 2;
+    for (uint16_t i = 0; i < 256; i++) {
+        need += bytes_to_num(bufp + 4 + i * 2, 2) * 5;
+    }
+    if (need != len) {
+        return false;
+    }
+
+    uint8_t *p = bufp + 4 + 256 * 2;
+    for (uint16_t i = 0; i < 256; i++) {
+        for (uint16_t j = bytes_to_num(bufp + 4 + i * 2, 2); j > 0; j--) {
+            add_nonce(bytes_to_num(p, 4), p[4]);
+            p += 5;
+        }
+    }
+    num_acquired_nonces = bytes_to_num(bufp, 4);
+    return true;
+}
+
 static int read_nonce_file(char *filename) {
 
     if (filename == NULL) {
@@ -1056,7 +1371,6 @@ static int read_nonce_file(char *filename) {
     }
     FILE *fnonces = NULL;
     char progress_text[80] = "";
-    uint8_t read_buf[9];
 
     num_acquired_nonces = 0;
     if ((fnonces = fopen(filename, "rb")) == NULL) {
@@ -1066,30 +1380,74 @@ static int read_nonce_file(char *filename) {
 
     snprintf(progress_text, 80, "Reading nonces from file %s...", filename);
     hardnested_print_progress(0, progress_text, (float)(1LL << 47), 0);
-    size_t bytes_read = fread(read_buf, 1, 6, fnonces);
-    if (bytes_read != 6) {
+
+    // read it in one go
+    fseek(fnonces, 0, SEEK_END);
+    long fsize = ftell(fnonces);
+    fseek(fnonces, 0, SEEK_SET);
+    uint8_t *data = NULL;
+    if (fsize < 6 || (data = malloc(fsize)) == NULL || fread(data, 1, fsize, fnonces) != (size_t)fsize) {
         PrintAndLogEx(ERR, "File reading error.");
+        free(data);
         fclose(fnonces);
         return 1;
     }
-    cuid = bytes_to_num(read_buf, 4);
-    uint8_t trgBlockNo = bytes_to_num(read_buf + 4, 1);
-    uint8_t trgKeyType = bytes_to_num(read_buf + 5, 1);
+    fclose(fnonces);
 
-    bytes_read = fread(read_buf, 1, 9, fnonces);
-    while (bytes_read == 9) {
-        uint32_t nt_enc1 = bytes_to_num(read_buf, 4);
-        uint32_t nt_enc2 = bytes_to_num(read_buf + 4, 4);
-        uint8_t par_enc = bytes_to_num(read_buf + 8, 1);
-        add_nonce(nt_enc1, par_enc >> 4);
-        add_nonce(nt_enc2, par_enc & 0x0f);
-        num_acquired_nonces += 2;
-        bytes_read = fread(read_buf, 1, 9, fnonces);
+    uint8_t trgBlockNo;
+    uint8_t trgKeyType;
+    bool from_index = false;
+
+    if (fsize >= NONCE_FILE_HDR_SIZE && bytes_to_num(data, 4) == NONCE_FILE_MAGIC) {
+        if (data[4] != NONCE_FILE_VERSION) {
+            PrintAndLogEx(ERR, "Unsupported nonce file version %u", data[4]);
+            free(data);
+            return 1;
+        }
+        trgBlockNo = data[5];
+        trgKeyType = data[6];
+        cuid = bytes_to_num(data + 8, 4);
+
+        // find the index first
+        size_t pos = NONCE_FILE_HDR_SIZE;
+        while (pos + NONCE_CHUNK_HDR_SIZE <= (size_t)fsize) {
+            uint32_t len = bytes_to_num(data + pos + 1, 4);
+            if (len > fsize - pos - NONCE_CHUNK_HDR_SIZE) {
+                PrintAndLogEx(WARNING, "Nonce file truncated");
+                break;
+            }
+            if (data[pos] == NONCE_CHUNK_INDEX) {
+                from_index = read_nonce_index(data + pos + NONCE_CHUNK_HDR_SIZE, len);
+                if (from_index == false) {
+                    PrintAndLogEx(WARNING, "Invalid nonce index, replaying all nonces");
+                }
+                break;
+            }
+            pos += NONCE_CHUNK_HDR_SIZE + len;
+        }
+
+        if (from_index == false) {
+            pos = NONCE_FILE_HDR_SIZE;
+            while (pos + NONCE_CHUNK_HDR_SIZE <= (size_t)fsize) {
+                uint32_t len = bytes_to_num(data + pos + 1, 4);
+                len = MIN(len, fsize - pos - NONCE_CHUNK_HDR_SIZE);
+                if (data[pos] == NONCE_CHUNK_PAIRS) {
+                    read_nonce_pairs(data + pos + NONCE_CHUNK_HDR_SIZE, len);
+                }
+                pos += NONCE_CHUNK_HDR_SIZE + len;
+            }
+        }
+    } else {
+        // version 1
+        cuid = bytes_to_num(data, 4);
+        trgBlockNo = data[4];
+        trgKeyType = data[5];
+        read_nonce_pairs(data + 6, fsize - 6);
     }
-    fclose(fnonces);
+    free(data);
 
     char progress_string[80];
-    sprintf(progress_string, "Read %u nonces from file. cuid = %08x", num_acquired_nonces, cuid);
+    sprintf(progress_string, "Read %u nonces from file%s. cuid = %08x", num_acquired_nonces, from_index ? " index" : "", cuid);
     hardnested_print_progress(num_acquired_nonces, progress_string, (float)(1LL << 47), 0);
     sprintf(progress_string, "Target Block=%d, Keytype=%c", trgBlockNo, trgKeyType == 0 ? 'A' : 'B');
     hardnested_print_progress(num_acquired_nonces, progress_string, (float)(1LL << 47), 0);
@@ -1318,7 +1676,9 @@ static void simulate_acquire_nonces(void) {
     char progress_text[80];
     sprintf(progress_text, "Simulating key %012" PRIx64 ", cuid %08" PRIx32 " ...", known_target_key, cuid);
     hardnested_print_progress(0, progress_text, (float)(1LL << 47), 0);
-    fprintf(fstats, "%012" PRIx64 ";%" PRIx32 ";", known_target_key, cuid);
+    if (write_stats) {
+        fprintf(fstats, "%012" PRIx64 ";%" PRIx32 ";", known_target_key, cuid);
+    }
 
     num_acquired_nonces = 0;
 
@@ -1369,166 +1729,280 @@ static void simulate_acquire_nonces(void) {
     // difftime(end_time, time1)!=0.0?(float)total_num_nonces*60.0/difftime(end_time, time1):INFINITY
     // );
 
-    fprintf(fstats, "%" PRIu32 ";%" PRIu32 ";%1.0f;", total_num_nonces, num_acquired_nonces, difftime(end_time, time1));
+    if (write_stats) {
+        fprintf(fstats, "%" PRIu32 ";%" PRIu32 ";%1.0f;", total_num_nonces, num_acquired_nonces, difftime(end_time, time1));
+    }
+
+}
+
+
+//----------------------------------------------------------------------------
+// Nonce acquisition
+//
+// The device streams CMD_HF_MIFARE_ACQ_NONCES_STREAM frames until it is told to
+// stop. One thread queues the frames, the caller adds them and updates the
+// bitflip and sum properties meanwhile. The acquirer stops the device as soon
+// as shrink_key_space() is satisfied.
+//----------------------------------------------------------------------------
+typedef struct nonce_batch {
+    uint16_t num;
+    uint8_t data[PM3_CMD_DATA_SIZE];
+    struct nonce_batch *next;
+} nonce_batch_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    nonce_batch_t *first;
+    nonce_batch_t *last;
+    bool stop;          // set by the consumer
+    bool done;          // set by the acquirer, no more batches
+    int error;
+} nonce_acq_t;
+
+static void nonce_acq_push(nonce_acq_t *acq, const mf_acq_stream_frame_t *frame) {
+    nonce_batch_t *b = calloc(1, sizeof(nonce_batch_t));
+    if (b == NULL) {
+        acq->error = PM3_EMALLOC;
+        acq->done = true;
+        return;
+    }
+    b->num = MIN(frame->pairs, MF_ACQ_STREAM_PAIRS) * 2;
+    memcpy(b->data, frame->data, b->num / 2 * 9);
+
+    if (acq->last)
+        acq->last->next = b;
+    else
+        acq->first = b;
+    acq->last = b;
+}
+
+static void *nonce_acq_thread(void *arg) {
+    nonce_acq_t *acq = (nonce_acq_t *)arg;
+    PacketResponseNG resp;
+    mf_acq_stream_frame_t *frame = (mf_acq_stream_frame_t *)resp.data.asBytes;
+    bool final = false;
+    int error = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&acq->lock);
+        bool stop = acq->stop;
+        pthread_mutex_unlock(&acq->lock);
+        if (stop)
+            break;
+
+        if (!WaitForResponseTimeout(CMD_HF_MIFARE_ACQ_NONCES_STREAM, &resp, 3000)) {
+            error = 1;
+            break;
+        }
+        // stopped on the device side (button)
+        if (frame->final) {
+            final = true;
+            error = 2;
+            break;
+        }
+
+        pthread_mutex_lock(&acq->lock);
+        uint64_t now = msclock();
+        if (now - last_sample_clock < sample_period) {
+            sample_period = now - last_sample_clock;
+        }
+        last_sample_clock = now;
+        nonce_acq_push(acq, frame);
+        pthread_cond_signal(&acq->cond);
+        pthread_mutex_unlock(&acq->lock);
+    }
+
+    // the device switches the field off when it leaves the loop, wait for its last frame
+    if (final == false) {
+        SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+        while (WaitForResponseTimeout(CMD_HF_MIFARE_ACQ_NONCES_STREAM, &resp, 2000)) {
+            if (frame->final) {
+                final = true;
+                break;
+            }
+        }
+        if (final == false) {
+            clearCommandBuffer();
+            SendCommandNG(CMD_FPGA_MAJOR_MODE_OFF, NULL, 0);
+        }
+    }
 
+    pthread_mutex_lock(&acq->lock);
+    if (acq->error == 0)
+        acq->error = error;
+    acq->done = true;
+    pthread_cond_signal(&acq->cond);
+    pthread_mutex_unlock(&acq->lock);
+    return NULL;
 }
 
+// add a batch of nonces as sent by the device, 9 bytes per pair
+static void add_nonce_batch(uint8_t *bufp, uint16_t num_sampled_nonces, FILE *fnonces) {
+    if (fnonces) {
+        write_nonce_chunk(fnonces, NONCE_CHUNK_PAIRS, bufp, num_sampled_nonces / 2 * 9);
+    }
+
+    for (uint16_t i = 0; i < num_sampled_nonces; i += 2) {
+        uint32_t nt_enc1 = bytes_to_num(bufp, 4);
+        uint32_t nt_enc2 = bytes_to_num(bufp + 4, 4);
+        uint8_t par_enc = bytes_to_num(bufp + 8, 1);
+
+        //PrintAndLogEx(NORMAL, "Encrypted nonce: %08x, encrypted_parity: %02x\n", nt_enc1, par_enc >> 4);
+        num_acquired_nonces += add_nonce(nt_enc1, par_enc >> 4);
+        //PrintAndLogEx(NORMAL, "Encrypted nonce: %08x, encrypted_parity: %02x\n", nt_enc2, par_enc & 0x0f);
+        num_acquired_nonces += add_nonce(nt_enc2, par_enc & 0x0f);
+
+        bufp += 9;
+    }
+}
 
 static int acquire_nonces(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, bool nonce_file_write, bool slow, char *filename) {
     last_sample_clock = msclock();
     sample_period = 2000; // initial rough estimate. Will be refined.
-    bool initialize = true;
-    bool field_off = false;
     hardnested_stage = CHECK_1ST_BYTES;
     bool acquisition_completed = false;
-    uint8_t write_buf[9];
-    //uint32_t total_num_nonces = 0;
     float brute_force_depth;
     bool reported_suma8 = false;
     char progress_text[80];
     FILE *fnonces = NULL;
     PacketResponseNG resp;
+    mf_acq_stream_frame_t *frame = (mf_acq_stream_frame_t *)resp.data.asBytes;
     num_acquired_nonces = 0;
 
-    clearCommandBuffer();
+    nonce_acq_t acq = {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .cond = PTHREAD_COND_INITIALIZER,
+    };
 
-    do {
-        uint32_t flags = 0;
-        flags |= initialize ? 0x0001 : 0;
-        flags |= slow ? 0x0002 : 0;
-        flags |= field_off ? 0x0004 : 0;
+    mf_acq_stream_req_t req = {
+        .blockno = blockNo,
+        .keytype = keyType,
+        .target_blockno = trgBlockNo,
+        .target_keytype = trgKeyType,
+        .flags = slow ? MF_ACQ_STREAM_SLOW : 0,
+    };
+    memcpy(req.key, key, sizeof(req.key));
 
+    // the first frame carries the uid
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_MIFARE_ACQ_NONCES_STREAM, (uint8_t *)&req, sizeof(req));
+
+    if (!WaitForResponseTimeout(CMD_HF_MIFARE_ACQ_NONCES_STREAM, &resp, 3000)) {
+        SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
         clearCommandBuffer();
+        SendCommandNG(CMD_FPGA_MAJOR_MODE_OFF, NULL, 0);
+        return 1;
+    }
 
-        if (field_off) {
+    // stopped on the device side (button)
+    if (frame->final) {
+        return 2;
+    }
+
+    cuid = frame->cuid;
+    if (nonce_file_write) {
+        if ((fnonces = fopen(filename, "wb")) == NULL) {
+            PrintAndLogEx(WARNING, "Could not create file %s", filename);
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            WaitForResponseTimeout(CMD_HF_MIFARE_ACQ_NONCES_STREAM, &resp, 2000);
+            clearCommandBuffer();
             SendCommandNG(CMD_FPGA_MAJOR_MODE_OFF, NULL, 0);
-            break;
-        } else {
-            SendCommandMIX(CMD_HF_MIFARE_ACQ_ENCRYPTED_NONCES, blockNo + keyType * 0x100, trgBlockNo + trgKeyType * 0x100, flags, key, 6);
+            return 3;
         }
+        snprintf(progress_text, 80, "Writing acquired nonces to binary file %s", filename);
+        hardnested_print_progress(0, progress_text, (float)(1LL << 47), 0);
+        write_nonce_file_header(fnonces, trgBlockNo, trgKeyType);
+    }
 
-        if (initialize) {
-
-            if (!WaitForResponseTimeout(CMD_ACK, &resp, 3000)) {
-                clearCommandBuffer();
-                SendCommandNG(CMD_FPGA_MAJOR_MODE_OFF, NULL, 0);
-                return 1;
-            }
-
-            // error during nested_hard
-            if (resp.oldarg[0]) {
-                clearCommandBuffer();
-                SendCommandNG(CMD_FPGA_MAJOR_MODE_OFF, NULL, 0);
-                return resp.oldarg[0];
-            }
+    nonce_acq_push(&acq, frame);
+    last_sample_clock = msclock();
 
-            cuid = resp.oldarg[1];
-            if (nonce_file_write && fnonces == NULL) {
-                if ((fnonces = fopen(filename, "wb")) == NULL) {
-                    PrintAndLogEx(WARNING, "Could not create file %s", filename);
-                    clearCommandBuffer();
-                    SendCommandNG(CMD_FPGA_MAJOR_MODE_OFF, NULL, 0);
-                    return 3;
-                }
-                snprintf(progress_text, 80, "Writing acquired nonces to binary file %s", filename);
-                hardnested_print_progress(0, progress_text, (float)(1LL << 47), 0);
-                num_to_bytes(cuid, 4, write_buf);
-                fwrite(write_buf, 1, 4, fnonces);
-                fwrite(&trgBlockNo, 1, 1, fnonces);
-                fwrite(&trgKeyType, 1, 1, fnonces);
-                fflush(fnonces);
-            }
-        }
+    pthread_t acq_thread;
+    if (pthread_create(&acq_thread, NULL, nonce_acq_thread, &acq) != 0) {
+        SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+        clearCommandBuffer();
+        SendCommandNG(CMD_FPGA_MAJOR_MODE_OFF, NULL, 0);
+        if (fnonces)
+            fclose(fnonces);
+        return 1;
+    }
 
-        if (!initialize) {
-            uint16_t num_sampled_nonces = resp.oldarg[2];
-            uint8_t *bufp = resp.data.asBytes;
-            for (uint16_t i = 0; i < num_sampled_nonces; i += 2) {
-                uint32_t nt_enc1 = bytes_to_num(bufp, 4);
-                uint32_t nt_enc2 = bytes_to_num(bufp + 4, 4);
-                uint8_t par_enc = bytes_to_num(bufp + 8, 1);
+    int res = 0;
+    while (!acquisition_completed) {
 
-                //PrintAndLogEx(NORMAL, "Encrypted nonce: %08x, encrypted_parity: %02x\n", nt_enc1, par_enc >> 4);
-                num_acquired_nonces += add_nonce(nt_enc1, par_enc >> 4);
-                //PrintAndLogEx(NORMAL, "Encrypted nonce: %08x, encrypted_parity: %02x\n", nt_enc2, par_enc & 0x0f);
-                num_acquired_nonces += add_nonce(nt_enc2, par_enc & 0x0f);
+        // take everything queued so far
+        pthread_mutex_lock(&acq.lock);
+        while (acq.first == NULL && acq.done == false)
+            pthread_cond_wait(&acq.cond, &acq.lock);
+        nonce_batch_t *batch = acq.first;
+        acq.first = acq.last = NULL;
+        bool done = acq.done;
+        res = acq.error;
+        pthread_mutex_unlock(&acq.lock);
 
-                if (nonce_file_write) {
-                    fwrite(bufp, 1, 9, fnonces);
-                    fflush(fnonces);
-                }
-                bufp += 9;
-            }
-            //total_num_nonces += num_sampled_nonces;
-
-            if (first_byte_num == 256) {
-                if (hardnested_stage == CHECK_1ST_BYTES) {
-                    for (uint16_t i = 0; i < NUM_SUMS; i++) {
-                        if (first_byte_Sum == sums[i]) {
-                            first_byte_Sum = i;
-                            break;
-                        }
-                    }
-                    hardnested_stage |= CHECK_2ND_BYTES;
-                    apply_sum_a0();
-                }
-                update_nonce_data(true);
-                acquisition_completed = shrink_key_space(&brute_force_depth);
-                if (!reported_suma8) {
-                    char progress_string[80];
-                    sprintf(progress_string, "Apply Sum property. Sum(a0) = %d", sums[first_byte_Sum]);
-                    hardnested_print_progress(num_acquired_nonces, progress_string, brute_force_depth, 0);
-                    reported_suma8 = true;
-                } else {
-                    hardnested_print_progress(num_acquired_nonces, "Apply bit flip properties", brute_force_depth, 0);
-                }
-            } else {
-                update_nonce_data(true);
-                acquisition_completed = shrink_key_space(&brute_force_depth);
-                hardnested_print_progress(num_acquired_nonces, "Apply bit flip properties", brute_force_depth, 0);
-            }
+        if (batch == NULL && done) {
+            if (res == 0)
+                res = 1;
+            break;
         }
 
-        if (acquisition_completed) {
-            field_off = true; // switch off field with next SendCommandOLD and then finish
+        while (batch) {
+            add_nonce_batch(batch->data, batch->num, fnonces);
+            nonce_batch_t *next = batch->next;
+            free(batch);
+            batch = next;
         }
 
-        if (!initialize) {
-
-            if (!WaitForResponseTimeout(CMD_ACK, &resp, 3000)) {
-                if (nonce_file_write) {
-                    fclose(fnonces);
+        if (first_byte_num == 256) {
+            if (hardnested_stage == CHECK_1ST_BYTES) {
+                for (uint16_t i = 0; i < NUM_SUMS; i++) {
+                    if (first_byte_Sum == sums[i]) {
+                        first_byte_Sum = i;
+                        break;
+                    }
                 }
-                clearCommandBuffer();
-                SendCommandNG(CMD_FPGA_MAJOR_MODE_OFF, NULL, 0);
-                return 1;
+                hardnested_stage |= CHECK_2ND_BYTES;
+                apply_sum_a0();
             }
-
-            // error during nested_hard
-            if (resp.oldarg[0]) {
-                if (nonce_file_write) {
-                    fclose(fnonces);
-                }
-                clearCommandBuffer();
-                SendCommandNG(CMD_FPGA_MAJOR_MODE_OFF, NULL, 0);
-                return resp.oldarg[0];
+            update_nonce_data(true);
+            acquisition_completed = shrink_key_space(&brute_force_depth);
+            if (!reported_suma8) {
+                char progress_string[80];
+                sprintf(progress_string, "Apply Sum property. Sum(a0) = %d", sums[first_byte_Sum]);
+                hardnested_print_progress(num_acquired_nonces, progress_string, brute_force_depth, 0);
+                reported_suma8 = true;
+            } else {
+                hardnested_print_progress(num_acquired_nonces, "Apply bit flip properties", brute_force_depth, 0);
             }
+        } else {
+            update_nonce_data(true);
+            acquisition_completed = shrink_key_space(&brute_force_depth);
+            hardnested_print_progress(num_acquired_nonces, "Apply bit flip properties", brute_force_depth, 0);
         }
+    }
 
-        initialize = false;
+    // tell the acquirer to stop, the device switches the field off. Nonces still in
+    // flight are dropped.
+    pthread_mutex_lock(&acq.lock);
+    acq.stop = true;
+    pthread_mutex_unlock(&acq.lock);
+    pthread_join(acq_thread, NULL);
 
-        if (msclock() - last_sample_clock < sample_period) {
-            sample_period = msclock() - last_sample_clock;
-        }
-        last_sample_clock = msclock();
-
-    } while (!acquisition_completed || field_off);
+    for (nonce_batch_t *b = acq.first; b != NULL;) {
+        nonce_batch_t *next = b->next;
+        free(b);
+        b = next;
+    }
+    pthread_mutex_destroy(&acq.lock);
+    pthread_cond_destroy(&acq.cond);
 
-    if (nonce_file_write) {
+    if (fnonces) {
+        write_nonce_index(fnonces);
         fclose(fnonces);
     }
 
-    return 0;
+    return acquisition_completed ? 0 : res;
 }
 
 
@@ -2155,6 +2629,10 @@ static void set_test_state(uint8_t byte) {
     crypto1_destroy(pcs);
 }
 
+void mfnestedhard_set_target(uint64_t states) {
+    brute_force_target = states;
+}
+
 int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *trgkey, bool nonce_file_read, bool nonce_file_write, bool slow, int tests, uint64_t *foundkey, char *filename) {
     char progress_text[80];
     char instr_set[12] = {0};
@@ -2399,3 +2877,188 @@ int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBloc
     }
     return 0;
 }
+
+//----------------------------------------------------------------------------
+// Benchmark suite
+//
+// Brute force rate of every SIMD core for 1, 2, 4 ... all threads, then
+// <runs> simulated attacks with fixed seeds, timing table loading, nonce
+// acquisition (incl. the bitflip and sum reductions), candidate generation
+// (the Sum(a8) reduction) and brute force separately.
+//----------------------------------------------------------------------------
+static void benchmark_bf_rates(json_t *rates, bool all_simd) {
+    char instr_set[12] = {0};
+    SIMDExecInstr simd = GetSIMDInstrAuto();
+    int cpus = num_CPUs();
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, " SIMD    | threads | million keys/s");
+    PrintAndLogEx(INFO, "---------+---------+---------------");
+    for (;;) {
+        SetSIMDInstr(simd);
+        get_SIMD_instruction_set(instr_set);
+        for (int threads = 1; ; threads = MIN(threads * 2, cpus)) {
+            set_num_CPUs(threads);
+            float rate = brute_force_benchmark();
+            PrintAndLogEx(INFO, " %-7s | %7d | %14.1f", instr_set, threads, rate / 1000000);
+
+            json_t *r = json_object();
+            json_object_set_new(r, "simd", json_string(instr_set));
+            json_object_set_new(r, "threads", json_integer(threads));
+            json_object_set_new(r, "keys_per_second", json_real(rate));
+            json_array_append_new(rates, r);
+            if (threads == cpus)
+                break;
+        }
+        set_num_CPUs(0);
+
+        if (all_simd == false || simd == SIMD_NONE)
+            break;
+        // everything after the best one available is supported too. No OpenCL unless asked for
+        do {
+            simd++;
+        } while (simd == SIMD_OPENCL);
+    }
+
+    SetSIMDInstr(all_simd ? SIMD_AUTO : simd);
+}
+
+static json_t *benchmark_attack(uint32_t seed) {
+    uint64_t t0 = msclock();
+    init_bitflip_bitarrays();
+    uint64_t t_tables = msclock() - t0;
+
+    init_part_sum_bitarrays();
+    init_sum_bitarrays();
+    init_allbitflips_array();
+    init_nonce_memory();
+    update_reduction_rate(0.0, true);
+
+    srand(seed);
+    known_target_key = -1;
+    start_time = msclock();
+    print_progress_header();
+    t0 = msclock();
+    simulate_acquire_nonces();
+    uint64_t t_acquire = msclock() - t0;
+    uint32_t acquired = num_acquired_nonces;
+    free_bitflip_bitarrays();
+
+    uint64_t t_candidates = 0;
+    uint64_t t_bf = 0;
+    uint64_t foundkey = 0;
+    uint8_t guesses = 0;
+    bool key_found = false;
+
+    uint32_t num_odd = nonces[best_first_byte_smallest_bitarray].num_states_bitarray[ODD_STATE];
+    uint32_t num_even = nonces[best_first_byte_smallest_bitarray].num_states_bitarray[EVEN_STATE];
+    float expected_brute_force1 = (float)num_odd * num_even / 2.0;
+    float expected_brute_force2 = nonces[best_first_bytes[0]].expected_num_brute_force;
+
+    if (expected_brute_force1 < expected_brute_force2) {
+        t0 = msclock();
+        add_bitflip_candidates(best_first_byte_smallest_bitarray);
+        maximum_states = 0;
+        for (statelist_t *sl = candidates; sl != NULL; sl = sl->next) {
+            maximum_states += (uint64_t)sl->len[ODD_STATE] * sl->len[EVEN_STATE];
+        }
+        best_first_bytes[0] = best_first_byte_smallest_bitarray;
+        pre_XOR_nonces();
+        prepare_bf_test_nonces(nonces, best_first_bytes[0]);
+        t_candidates = msclock() - t0;
+
+        t0 = msclock();
+        key_found = brute_force(&foundkey);
+        t_bf = msclock() - t0;
+        free(candidates->states[ODD_STATE]);
+        free(candidates->states[EVEN_STATE]);
+        free_candidates_memory(candidates);
+        candidates = NULL;
+    } else {
+        pre_XOR_nonces();
+        prepare_bf_test_nonces(nonces, best_first_bytes[0]);
+        for (uint8_t j = 0; j < NUM_SUMS && !key_found; j++) {
+            guesses++;
+            t0 = msclock();
+            generate_candidates(first_byte_Sum, nonces[best_first_bytes[0]].sum_a8_guess[j].sum_a8_idx);
+            t_candidates += msclock() - t0;
+
+            t0 = msclock();
+            key_found = brute_force(&foundkey);
+            t_bf += msclock() - t0;
+            free_statelist_cache();
+            free_candidates_memory(candidates);
+            candidates = NULL;
+            if (!key_found) {
+                nonces[best_first_bytes[0]].sum_a8_guess[j].prob = 0;
+                nonces[best_first_bytes[0]].sum_a8_guess[j].num_states = 0;
+                update_expected_brute_force(best_first_bytes[0]);
+            }
+        }
+    }
+
+    free_nonces_memory();
+    free_bitarray(all_bitflips_bitarray[ODD_STATE]);
+    free_bitarray(all_bitflips_bitarray[EVEN_STATE]);
+    free_sum_bitarrays();
+    free_part_sum_bitarrays();
+
+    json_t *r = json_object();
+    json_object_set_new(r, "seed", json_integer(seed));
+    json_object_set_new(r, "nonces", json_integer(acquired));
+    json_object_set_new(r, "table_load_ms", json_integer(t_tables));
+    json_object_set_new(r, "acquire_ms", json_integer(t_acquire));
+    json_object_set_new(r, "candidates_ms", json_integer(t_candidates));
+    json_object_set_new(r, "sum_a8_guesses", json_integer(guesses));
+    json_object_set_new(r, "brute_force_ms", json_integer(t_bf));
+    json_object_set_new(r, "key_found", json_boolean(key_found && foundkey == known_target_key));
+    return r;
+}
+
+int mfnestedhard_benchmark(uint32_t runs, bool all_simd, const char *filename) {
+    char instr_set[12] = {0};
+
+    json_t *root = json_object();
+    json_t *rates = json_array();
+    json_t *attacks = json_array();
+    json_object_set_new(root, "cpus", json_integer(num_CPUs()));
+
+    benchmark_bf_rates(rates, all_simd);
+    json_object_set_new(root, "brute_force", rates);
+
+    get_SIMD_instruction_set(instr_set);
+    json_object_set_new(root, "simd", json_string(instr_set));
+    brute_force_per_second = brute_force_benchmark();
+    write_stats = false;
+
+    for (uint32_t i = 0; i < runs; i++) {
+        json_t *r = benchmark_attack(i + 1);
+        PrintAndLogEx(INFO, "Run %u: tables %" PRIu64 " ms, acquire %" PRIu64 " ms, candidates %" PRIu64 " ms, brute force %" PRIu64 " ms",
+                      i + 1,
+                      (uint64_t)json_integer_value(json_object_get(r, "table_load_ms")),
+                      (uint64_t)json_integer_value(json_object_get(r, "acquire_ms")),
+                      (uint64_t)json_integer_value(json_object_get(r, "candidates_ms")),
+                      (uint64_t)json_integer_value(json_object_get(r, "brute_force_ms"))
+                     );
+        json_array_append_new(attacks, r);
+    }
+    json_object_set_new(root, "attacks", attacks);
+
+    int res = 0;
+    if (filename != NULL && filename[0] != '\0') {
+        if (json_dump_file(root, filename, JSON_INDENT(2)) != 0) {
+            PrintAndLogEx(ERR, "Can't save benchmark to file %s", filename);
+            res = 1;
+        } else {
+            PrintAndLogEx(SUCCESS, "Saved benchmark to " _YELLOW_("%s"), filename);
+        }
+    } else {
+        char *js = json_dumps(root, JSON_INDENT(2));
+        if (js) {
+            PrintAndLogEx(NORMAL, "%s", js);
+            free(js);
+        }
+    }
+    json_decref(root);
+    return res;
+}
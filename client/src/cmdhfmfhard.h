@@ -13,7 +13,12 @@
 
 #include "common.h"
 
+// stop acquiring nonces when the expected brute force is below this many states
+#define HARDNESTED_DEFAULT_TARGET 0xF00000
+
 int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *trgkey, bool nonce_file_read, bool nonce_file_write, bool slow, int tests, uint64_t *foundkey, char *filename);
+void mfnestedhard_set_target(uint64_t states);
+int mfnestedhard_benchmark(uint32_t runs, bool all_simd, const char *filename);
 void hardnested_print_progress(uint32_t nonces, const char *activity, float brute_force, uint64_t min_diff_print_time);
 
 #endif
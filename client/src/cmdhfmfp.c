@@ -26,6 +26,7 @@
 #include "fileutils.h"
 #include "protocols.h"
 #include "crypto/libpcrypto.h"
+#include "emv/emvjson.h"
 
 static const uint8_t DefaultKey[16] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
 uint16_t CardAddresses[] = {0x9000, 0x9001, 0x9002, 0x9003, 0x9004, 0xA000, 0xA001, 0xA080, 0xA081, 0xC000, 0xC001};
@@ -645,12 +646,12 @@ static int CmdHFMFPRdbl(const char *Cmd) {
     int keylen = 0;
 
     CLIParserContext *ctx;
-    CLIParserInit(&ctx, "hf mfp rdbl",
-                  "Reads several blocks from Mifare Plus card.",
-                  "Usage:\n\thf mfp rdbl 0 000102030405060708090a0b0c0d0e0f -> executes authentication and read block 0 data\n"
-                  "\thf mfp rdbl 1 -v -> executes authentication and shows sector 1 data with default key 0xFF..0xFF and some additional data\n");
+    CLIParserInitCached(&ctx, "hf mfp rdbl",
+                        "Reads several blocks from Mifare Plus card.",
+                        "Usage:\n\thf mfp rdbl 0 000102030405060708090a0b0c0d0e0f -> executes authentication and read block 0 data\n"
+                        "\thf mfp rdbl 1 -v -> executes authentication and shows sector 1 data with default key 0xFF..0xFF and some additional data\n");
 
-    void *argtable[] = {
+    CLIParserCachedTable(ctx,
         arg_param_begin,
         arg_lit0("vV",  "verbose", "show internal data."),
         arg_int0("nN",  "count",   "blocks count (by default 1).", NULL),
@@ -659,8 +660,8 @@ static int CmdHFMFPRdbl(const char *Cmd) {
         arg_int1(NULL,  NULL,      "<Block Num (0..255)>", NULL),
         arg_str0(NULL,  NULL,      "<Key Value (HEX 16 bytes)>", NULL),
         arg_param_end
-    };
-    CLIExecWithReturn(ctx, Cmd, argtable, false);
+    );
+    CLIExecCachedWithReturn(ctx, Cmd, false);
 
     bool verbose = arg_get_lit(ctx, 1);
     int blocksCount = arg_get_int_def(ctx, 2, 1);
@@ -758,12 +759,12 @@ static int CmdHFMFPRdsc(const char *Cmd) {
     int keylen = 0;
 
     CLIParserContext *ctx;
-    CLIParserInit(&ctx, "hf mfp rdsc",
-                  "Reads one sector from Mifare Plus card.",
-                  "Usage:\n\thf mfp rdsc 0 000102030405060708090a0b0c0d0e0f -> executes authentication and read sector 0 data\n"
-                  "\thf mfp rdsc 1 -v -> executes authentication and shows sector 1 data with default key 0xFF..0xFF and some additional data\n");
+    CLIParserInitCached(&ctx, "hf mfp rdsc",
+                        "Reads one sector from Mifare Plus card.",
+                        "Usage:\n\thf mfp rdsc 0 000102030405060708090a0b0c0d0e0f -> executes authentication and read sector 0 data\n"
+                        "\thf mfp rdsc 1 -v -> executes authentication and shows sector 1 data with default key 0xFF..0xFF and some additional data\n");
 
-    void *argtable[] = {
+    CLIParserCachedTable(ctx,
         arg_param_begin,
         arg_lit0("vV",  "verbose", "show internal data."),
         arg_lit0("bB",  "keyb",    "use key B (by default keyA)."),
@@ -771,8 +772,8 @@ static int CmdHFMFPRdsc(const char *Cmd) {
         arg_int1(NULL,  NULL,      "<Sector Num (0..255)>", NULL),
         arg_str0(NULL,  NULL,      "<Key Value (HEX 16 bytes)>", NULL),
         arg_param_end
-    };
-    CLIExecWithReturn(ctx, Cmd, argtable, false);
+    );
+    CLIExecCachedWithReturn(ctx, Cmd, false);
 
     bool verbose = arg_get_lit(ctx, 1);
     bool keyB = arg_get_lit(ctx, 2);
@@ -811,42 +812,183 @@ static int CmdHFMFPRdsc(const char *Cmd) {
         return res;
     }
 
-    uint8_t data[250] = {0};
-    int datalen = 0;
-    uint8_t mac[8] = {0};
-    for (int n = mfFirstBlockOfSector(sectorNum); n < mfFirstBlockOfSector(sectorNum) + mfNumBlocksPerSector(sectorNum); n++) {
-        res = MFPReadBlock(&mf4session, plain, n & 0xff, 1, false, true, data, sizeof(data), &datalen, mac);
-        if (res) {
-            PrintAndLogEx(ERR, "Read error: %d", res);
-            DropField();
-            return res;
+    // the blocks of the sector in MFP_READ_BLOCKS_MAX block reads
+    uint8_t data[16 * 16] = {0};
+    uint8_t firstBlockNo = mfFirstBlockOfSector(sectorNum);
+    res = MFPReadBlocks(&mf4session, plain, firstBlockNo, mfNumBlocksPerSector(sectorNum), data, verbose);
+    DropField();
+    if (res)
+        return res;
+
+    if (verbose == false) {
+        for (int n = 0; n < mfNumBlocksPerSector(sectorNum); n++)
+            PrintAndLogEx(INFO, "data[%03d]: %s", firstBlockNo + n, sprint_hex(&data[n * 16], 16));
+    }
+
+    return PM3_SUCCESS;
+}
+
+static int CmdHFMFPDump(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hf mfp dump",
+                  "Reads the sectors of a Mifare Plus card in SL3 to a binary and an eml file. The card is selected once, every sector "
+                  "is authenticated in the running session and read three blocks per command.",
+                  "Usage:\n\thf mfp dump -> reads sectors 0..31 with the default key 0xFF..0xFF\n"
+                  "\thf mfp dump -j hf-mfp-01020304-key -n 40 -> reads sectors 0..39 with the keys saved by `hf mfp chk -j`\n");
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_lit0("vV",  "verbose", "show internal data."),
+        arg_lit0("bB",  "keyb",    "use key B (by default keyA)."),
+        arg_str0("kK",  "key",     "<Key>", "key for the sectors without one in the json file (HEX 16 bytes, by default 0xFF..0xFF)"),
+        arg_str0("jJ",  "json",    "<file>", "json file with the keys of `hf mfp chk -j`"),
+        arg_int0("nN",  "sectors", "<1..40>", "sectors to read (by default 32)"),
+        arg_str0("fF",  "file",    "<filename>", "dump file name (by default hf-mfp-<UID>-dump)"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+
+    bool verbose = arg_get_lit(ctx, 1);
+    bool keyB = arg_get_lit(ctx, 2);
+
+    uint8_t key[250] = {0};
+    int keylen = 0;
+    CLIGetHexWithReturn(ctx, 3, key, &keylen);
+
+    uint8_t jsonname[FILE_PATH_SIZE + 1] = {0};
+    int jsonnamelen = 0;
+    if (CLIParamStrToBuf(arg_get_str(ctx, 4), jsonname, FILE_PATH_SIZE - 5, &jsonnamelen)) {
+        PrintAndLogEx(FAILED, "File name too long or invalid.");
+        CLIParserFree(ctx);
+        return PM3_EINVARG;
+    }
+
+    int sectors = arg_get_int_def(ctx, 5, 32);
+
+    char filename[FILE_PATH_SIZE] = {0};
+    int filenamelen = 0;
+    if (CLIParamStrToBuf(arg_get_str(ctx, 6), (uint8_t *)filename, FILE_PATH_SIZE, &filenamelen)) {
+        PrintAndLogEx(FAILED, "File name too long or invalid.");
+        CLIParserFree(ctx);
+        return PM3_EINVARG;
+    }
+    CLIParserFree(ctx);
+
+    mfpSetVerboseMode(verbose);
+
+    if (!keylen) {
+        memmove(key, DefaultKey, 16);
+        keylen = 16;
+    }
+
+    if (keylen != 16) {
+        PrintAndLogEx(ERR, "<Key Value> must be 16 bytes long instead of: %d", keylen);
+        return PM3_EINVARG;
+    }
+
+    if (sectors < 1 || sectors > 40) {
+        PrintAndLogEx(ERR, "sectors must be in range [1..40] instead of: %d", sectors);
+        return PM3_EINVARG;
+    }
+
+    uint8_t keys[40][16];
+    for (int i = 0; i < sectors; i++)
+        memcpy(keys[i], key, 16);
+
+    if (jsonnamelen) {
+        if (strstr((char *)jsonname, ".json") == NULL)
+            strcat((char *)jsonname, ".json");
+
+        json_error_t error;
+        json_t *root = json_load_file((char *)jsonname, 0, &error);
+        if (root == NULL) {
+            PrintAndLogEx(ERR, "ERROR: json error on line %d: %s", error.line, error.text);
+            return PM3_EFILE;
         }
 
-        if (datalen && data[0] != 0x90) {
-            PrintAndLogEx(ERR, "Card read error: %02x %s", data[0], mfpGetErrorDescription(data[0]));
-            DropField();
-            return 6;
+        int loaded = 0;
+        for (int i = 0; i < sectors; i++) {
+            char path[40] = {0};
+            snprintf(path, sizeof(path), "$.SectorKeys.%d.%s", i, keyB ? "KeyB" : "KeyA");
+
+            uint8_t jkey[16] = {0};
+            size_t jkeylen = 0;
+            if (JsonLoadBufAsHex(root, path, jkey, sizeof(jkey), &jkeylen) == 0 && jkeylen == 16) {
+                memcpy(keys[i], jkey, 16);
+                loaded++;
+            }
         }
-        if (datalen != 1 + 16 + 8 + 2) {
-            PrintAndLogEx(ERR, "Error return length:%d", datalen);
-            DropField();
-            return 5;
+        json_decref(root);
+        PrintAndLogEx(INFO, "loaded " _YELLOW_("%d") " keys from " _YELLOW_("%s"), loaded, jsonname);
+    }
+
+    // UID for the file name
+    if (filenamelen == 0) {
+        clearCommandBuffer();
+        SendCommandMIX(CMD_HF_ISO14443A_READER, ISO14A_CONNECT, 0, 0, NULL, 0);
+
+        PacketResponseNG resp;
+        if (WaitForResponseTimeout(CMD_ACK, &resp, 2500) == false || resp.oldarg[0] == 0) {
+            PrintAndLogEx(ERR, "No card found");
+            return PM3_ECARDEXCHANGE;
         }
 
-        PrintAndLogEx(INFO, "data[%03d]: %s", n, sprint_hex(&data[1], 16));
+        iso14a_card_select_t card;
+        memcpy(&card, (iso14a_card_select_t *)resp.data.asBytes, sizeof(iso14a_card_select_t));
 
-        if (memcmp(&data[1 + 16], mac, 8)) {
-            PrintAndLogEx(WARNING, "WARNING: mac on block %d not equal...", n);
-            PrintAndLogEx(WARNING, "MAC   card: %s", sprint_hex(&data[1 + 16], 8));
-            PrintAndLogEx(WARNING, "MAC reader: %s", sprint_hex(mac, 8));
-        } else {
-            if (verbose)
-                PrintAndLogEx(INFO, "MAC: %s", sprint_hex(&data[1 + 16], 8));
+        char *fptr = filename;
+        fptr += sprintf(fptr, "hf-mfp-");
+        FillFileNameByUID(fptr, card.uid, "-dump", card.uidlen);
+    }
+
+    uint16_t blocks = (sectors <= 32) ? sectors * 4 : 32 * 4 + (sectors - 32) * 16;
+    uint8_t *dump = calloc(blocks, 16);
+    if (dump == NULL) {
+        PrintAndLogEx(ERR, "failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+
+    PrintAndLogEx(INFO, "reading %d sectors with key %s" NOLF, sectors, keyB ? "B" : "A");
+
+    // one ISO14443-4 session while the sectors read, a failed one drops the field
+    bool field = false;
+    int failed = 0;
+    uint16_t block = 0;
+    for (int i = 0; i < sectors; i++) {
+        if (kbd_enter_pressed()) {
+            PrintAndLogEx(WARNING, "\naborted via keyboard!\n");
+            DropField();
+            free(dump);
+            return PM3_EOPABORTED;
         }
+
+        int res = mfpReadSectorEx(i, keyB ? MF_KEY_B : MF_KEY_A, keys[i], &dump[block * 16], field == false, true, verbose);
+        field = (res == 0);
+        if (res)
+            failed++;
+        else if (verbose == false)
+            PrintAndLogEx(NORMAL, "." NOLF);
+
+        block += mfNumBlocksPerSector(i);
     }
     DropField();
+    PrintAndLogEx(NORMAL, "");
 
-    return PM3_SUCCESS;
+    if (failed == sectors) {
+        PrintAndLogEx(FAILED, "no sector read");
+        free(dump);
+        return PM3_ESOFT;
+    }
+
+    if (failed)
+        PrintAndLogEx(WARNING, _YELLOW_("%d") " of %d sectors not read, their blocks are zero", failed, sectors);
+    else
+        PrintAndLogEx(SUCCESS, "read " _GREEN_("%d") " sectors", sectors);
+
+    saveFile(filename, ".bin", dump, blocks * 16);
+    saveFileEML(filename, dump, blocks * 16, 16);
+    free(dump);
+    return (failed) ? PM3_ESOFT : PM3_SUCCESS;
 }
 
 static int CmdHFMFPWrbl(const char *Cmd) {
@@ -857,12 +999,12 @@ static int CmdHFMFPWrbl(const char *Cmd) {
     int datainlen = 0;
 
     CLIParserContext *ctx;
-    CLIParserInit(&ctx, "hf mfp wrbl",
-                  "Writes one block to Mifare Plus card.",
-                  "Usage:\n\thf mfp wrbl 1 ff0000000000000000000000000000ff 000102030405060708090a0b0c0d0e0f -> writes block 1 data\n"
-                  "\thf mfp wrbl 2 ff0000000000000000000000000000ff -v -> writes block 2 data with default key 0xFF..0xFF and some additional data\n");
+    CLIParserInitCached(&ctx, "hf mfp wrbl",
+                        "Writes one block to Mifare Plus card.",
+                        "Usage:\n\thf mfp wrbl 1 ff0000000000000000000000000000ff 000102030405060708090a0b0c0d0e0f -> writes block 1 data\n"
+                        "\thf mfp wrbl 2 ff0000000000000000000000000000ff -v -> writes block 2 data with default key 0xFF..0xFF and some additional data\n");
 
-    void *argtable[] = {
+    CLIParserCachedTable(ctx,
         arg_param_begin,
         arg_lit0("vV",  "verbose", "show internal data."),
         arg_lit0("bB",  "keyb",    "use key B (by default keyA)."),
@@ -870,8 +1012,8 @@ static int CmdHFMFPWrbl(const char *Cmd) {
         arg_str1(NULL,  NULL,      "<Data (HEX 16 bytes)>", NULL),
         arg_str0(NULL,  NULL,      "<Key (HEX 16 bytes)>", NULL),
         arg_param_end
-    };
-    CLIExecWithReturn(ctx, Cmd, argtable, false);
+    );
+    CLIExecCachedWithReturn(ctx, Cmd, false);
 
     bool verbose = arg_get_lit(ctx, 1);
     bool keyB = arg_get_lit(ctx, 2);
@@ -955,85 +1097,128 @@ static int CmdHFMFPWrbl(const char *Cmd) {
 #define AES_KEY_LEN        16
 #define MAX_KEYS_LIST_LEN  1024
 
+// one CMD_HF_MFP_CHKKEYS, the device tries the keys on all key addresses of req without a key yet
+static int MFPCheckKeysSlots(mfp_chk_req_t *req, mfp_chk_resp_t *payload) {
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_MFP_CHKKEYS, (uint8_t *)req, sizeof(*req) - sizeof(req->keys) + req->count * AES_KEY_LEN);
+
+    PacketResponseNG resp;
+    uint32_t waited = 0;
+    // 30 keys on 128 key addresses take a while, no fixed timeout but one per key tried
+    uint32_t timeout = 2000 + (uint32_t)req->count * req->slots * 40;
+    while (WaitForResponseTimeout(CMD_HF_MFP_CHKKEYS, &resp, 500) == false) {
+        waited += 500;
+        if (kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            // the hits so far come back with PM3_EOPABORTED
+            if (WaitForResponseTimeout(CMD_HF_MFP_CHKKEYS, &resp, 2000))
+                break;
+            return PM3_EOPABORTED;
+        }
+        if (waited > timeout) {
+            PrintAndLogEx(WARNING, "timeout while waiting for reply.");
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            return PM3_ETIMEOUT;
+        }
+    }
+
+    if (resp.length < sizeof(mfp_chk_resp_t))
+        return (resp.status == PM3_SUCCESS) ? PM3_ESOFT : resp.status;
+
+    memcpy(payload, resp.data.asBytes, sizeof(mfp_chk_resp_t));
+    return resp.status;
+}
+
 static int MFPKeyCheck(uint8_t startSector, uint8_t endSector, uint8_t startKeyAB, uint8_t endKeyAB,
                        uint8_t keyList[MAX_KEYS_LIST_LEN][AES_KEY_LEN], size_t keyListLen, uint8_t foundKeys[2][64][AES_KEY_LEN + 1],
                        bool verbose) {
-    int res;
-    bool selectCard = true;
-    uint8_t keyn[2] = {0};
 
-    // sector number from 0
-    for (uint8_t sector = startSector; sector <= endSector; sector++) {
-        // 0-keyA 1-keyB
-        for (uint8_t keyAB = startKeyAB; keyAB <= endKeyAB; keyAB++) {
-            // main cycle with key check
-            for (int i = 0; i < keyListLen; i++) {
-                if (i % 10 == 0) {
-
-                    if (verbose == false)
-                        PrintAndLogEx(NORMAL, "." NOLF);
-
-                    if (kbd_enter_pressed()) {
-                        PrintAndLogEx(WARNING, "\nAborted via keyboard!\n");
-                        DropField();
-                        return PM3_EOPABORTED;
-                    }
-                }
+    // key addresses 0x4000 + sector * 2 + keyAB, one slot each on the device
+    uint8_t nab = endKeyAB - startKeyAB + 1;
+    mfp_chk_req_t req = {0};
+    req.keyno = 0x4000 + startSector * 2 + startKeyAB;
+    req.stride = (nab == 1) ? 2 : 1;
+    req.slots = (endSector - startSector + 1) * nab;
 
-                uint16_t uKeyNum = 0x4000 + sector * 2 + keyAB;
-                keyn[0] = uKeyNum >> 8;
-                keyn[1] = uKeyNum & 0xff;
+    // keys found before, e.g. with an earlier dictionary
+    for (uint8_t slot = 0; slot < req.slots; slot++) {
+        if (foundKeys[startKeyAB + slot % nab][startSector + slot / nab][0])
+            req.done[slot / 8] |= 1 << (slot % 8);
+    }
 
-                for (int retry = 0; retry < 4; retry++) {
-                    res =  MifareAuth4(NULL, keyn, keyList[i], selectCard, true, false, false, true);
-                    if (res != 2)
-                        break;
+    uint32_t batch = MFP_CHK_KEYS_DATA / AES_KEY_LEN;
+    for (uint32_t pos = 0; pos < keyListLen; pos += batch) {
 
-                    if (verbose)
-                        PrintAndLogEx(WARNING, "\nretried[%d]...", retry);
-                    else
-                        PrintAndLogEx(NORMAL, "R" NOLF);
+        if (verbose == false)
+            PrintAndLogEx(NORMAL, "." NOLF);
 
-                    DropField();
-                    selectCard = true;
-                    msleep(100);
-                }
+        req.count = MIN(batch, keyListLen - pos);
+        memcpy(req.keys, keyList[pos], req.count * AES_KEY_LEN);
 
-                if (verbose)
-                    PrintAndLogEx(WARNING, "\nsector %02d key %d [%s] res: %d", sector, keyAB, sprint_hex_inrow(keyList[i], 16), res);
+        mfp_chk_resp_t payload;
+        int res = PM3_ECARDEXCHANGE;
+        for (int retry = 0; retry < 4; retry++) {
+            memset(&payload, 0, sizeof(payload));
+            res = MFPCheckKeysSlots(&req, &payload);
 
-                // key for [sector,keyAB] found
-                if (res == 0) {
+            // hits of an interrupted or failed run count too
+            for (uint8_t slot = 0; slot < req.slots; slot++) {
+                uint8_t bit = 1 << (slot % 8);
+                if ((payload.refused[slot / 8] & bit) && (req.done[slot / 8] & bit) == 0) {
                     if (verbose)
-                        PrintAndLogEx(INFO, "\nFound key for sector %d key %s [%s]", sector, keyAB == 0 ? "A" : "B", sprint_hex_inrow(keyList[i], 16));
-                    else
-                        PrintAndLogEx(NORMAL, "+" NOLF);
-
-                    foundKeys[keyAB][sector][0] = 0x01;
-                    memcpy(&foundKeys[keyAB][sector][1], keyList[i], AES_KEY_LEN);
-                    DropField();
-                    selectCard = true;
-                    msleep(50);
-                    break;
+                        PrintAndLogEx(WARNING, "\nKey address %04x refused, skipped", req.keyno + slot * req.stride);
+                    req.done[slot / 8] |= bit;
                 }
 
-                // 5 - auth error (rnd not equal)
-                if (res != 5) {
-                    if (verbose)
-                        PrintAndLogEx(ERR, "\nExchange error. Aborted.");
-                    else
-                        PrintAndLogEx(NORMAL, "E" NOLF);
+                if ((payload.found[slot / 8] & bit) == 0 || payload.index[slot] >= req.count)
+                    continue;
 
-                    DropField();
-                    return PM3_ECARDEXCHANGE;
-                }
+                uint8_t sector = startSector + slot / nab;
+                uint8_t keyAB = startKeyAB + slot % nab;
+                uint8_t *key = keyList[pos + payload.index[slot]];
+                if (verbose)
+                    PrintAndLogEx(INFO, "\nFound key for sector %d key %s [%s]", sector, keyAB == 0 ? "A" : "B", sprint_hex_inrow(key, AES_KEY_LEN));
+                else
+                    PrintAndLogEx(NORMAL, "+" NOLF);
 
-                selectCard = false;
+                foundKeys[keyAB][sector][0] = 0x01;
+                memcpy(&foundKeys[keyAB][sector][1], key, AES_KEY_LEN);
+                req.done[slot / 8] |= bit;
             }
+
+            if (res == PM3_SUCCESS || res == PM3_EOPABORTED || res == PM3_ETIMEOUT)
+                break;
+
+            if (verbose)
+                PrintAndLogEx(WARNING, "\nretried[%d]...", retry);
+            else
+                PrintAndLogEx(NORMAL, "R" NOLF);
+
+            msleep(100);
         }
+
+        if (res == PM3_EOPABORTED) {
+            PrintAndLogEx(WARNING, "\nAborted via keyboard!\n");
+            return res;
+        }
+
+        if (res != PM3_SUCCESS) {
+            if (verbose)
+                PrintAndLogEx(ERR, "\nExchange error. Aborted.");
+            else
+                PrintAndLogEx(NORMAL, "E" NOLF);
+            return PM3_ECARDEXCHANGE;
+        }
+
+        // every key address has a key
+        bool all = true;
+        for (uint8_t slot = 0; slot < req.slots; slot++)
+            if ((req.done[slot / 8] & (1 << (slot % 8))) == 0)
+                all = false;
+        if (all)
+            break;
     }
 
-    DropField();
     return PM3_SUCCESS;
 }
 
@@ -1473,7 +1658,6 @@ static int CmdHFMFPNDEF(const char *Cmd) {
 
     uint8_t sector0[16 * 4] = {0};
     uint8_t sector10[16 * 4] = {0};
-    uint8_t data[4096] = {0};
     int datalen = 0;
 
     if (verbose)
@@ -1512,35 +1696,40 @@ static int CmdHFMFPNDEF(const char *Cmd) {
         return res;
     }
 
+    // the NDEF sectors are decoded as they are read, until the terminator
+    ndef_stream_t *ndef = calloc(1, sizeof(ndef_stream_t));
+    if (ndef == NULL)
+        return PM3_EMALLOC;
+
     PrintAndLogEx(INFO, "reading data from tag");
-    for (int i = 0; i < madlen; i++) {
+    NDEFStreamInit(ndef, verbose);
+
+    for (int i = 0; i < madlen && ndef->done == false; i++) {
         if (ndefAID == mad[i]) {
             uint8_t vsector[16 * 4] = {0};
             if (mfpReadSector(i + 1, keyB ? MF_KEY_B : MF_KEY_A, ndefkey, vsector, false)) {
                 PrintAndLogEx(ERR, "error, reading sector %d", i + 1);
+                free(ndef);
                 return PM3_ESOFT;
             }
 
-            memcpy(&data[datalen], vsector, 16 * 3);
-            datalen += 16 * 3;
+            if (verbose2) {
+                PrintAndLogEx(INFO, "--- " _CYAN_("MF Plus NDEF raw") " sector %d ----------------", i + 1);
+                dump_buffer(vsector, 16 * 3, stdout, 1);
+            }
 
-            PrintAndLogEx(INPLACE, "%d", i);
+            datalen += 16 * 3;
+            if (NDEFStreamFeed(ndef, vsector, 16 * 3) != PM3_SUCCESS)
+                break;
         }
     }
-    PrintAndLogEx(NORMAL, "");
 
-    if (!datalen) {
+    if (datalen == 0)
         PrintAndLogEx(ERR, "no NDEF data");
-        return PM3_SUCCESS;
-    }
-
-    if (verbose2) {
-        PrintAndLogEx(NORMAL, "");
-        PrintAndLogEx(INFO, "--- " _CYAN_("MF Plus NDEF raw") " ----------------");
-        dump_buffer(data, datalen, stdout, 1);
-    }
+    else
+        NDEFStreamFinish(ndef);
 
-    NDEFDecodeAndPrint(data, datalen, verbose);
+    free(ndef);
     PrintAndLogEx(HINT, "Try " _YELLOW_("`hf mfp ndef -vv`") " for more details");
     return PM3_SUCCESS;
 }
@@ -1554,6 +1743,7 @@ static command_t CommandTable[] = {
     {"auth",             CmdHFMFPAuth,            IfPm3Iso14443a,  "Authentication"},
     {"rdbl",             CmdHFMFPRdbl,            IfPm3Iso14443a,  "Read blocks"},
     {"rdsc",             CmdHFMFPRdsc,            IfPm3Iso14443a,  "Read sectors"},
+    {"dump",             CmdHFMFPDump,            IfPm3Iso14443a,  "Dump sectors to file"},
     {"wrbl",             CmdHFMFPWrbl,            IfPm3Iso14443a,  "Write blocks"},
     {"chk",              CmdHFMFPChk,             IfPm3Iso14443a,  "Check keys"},
     {"mad",              CmdHFMFPMAD,             IfPm3Iso14443a,  "Checks and prints MAD"},
@@ -21,6 +21,8 @@
 #include "generator.h"
 #include "mifare/ndef.h"
 #include "cliparser.h"
+#include "util_posix.h"
+#include "amiibo.h"
 
 
 #define MAX_UL_BLOCKS       0x0F
@@ -220,14 +222,18 @@ static int usage_hf_mfu_gendiverse(void) {
 }
 
 static int usage_hf_mfu_pwdgen(void) {
-    PrintAndLogEx(NORMAL, "Usage:  hf mfu pwdgen [h|t] [r] <uid (14 hex symbols)>");
+    PrintAndLogEx(NORMAL, "Usage:  hf mfu pwdgen [h|t] [r] [c [f <dictionary>]] <uid (14 hex symbols)>");
     PrintAndLogEx(NORMAL, "Options:");
     PrintAndLogEx(NORMAL, "    h       : this help");
     PrintAndLogEx(NORMAL, "    t       : selftest");
     PrintAndLogEx(NORMAL, "    r       : read uid from tag");
+    PrintAndLogEx(NORMAL, "    c       : read uid from tag, then check all passwords on it in one device side loop");
+    PrintAndLogEx(NORMAL, "    f <dic> : with c, also check the 4 byte passwords of this dictionary");
     PrintAndLogEx(NORMAL, "    <uid>   : 7 byte UID (optional)");
     PrintAndLogEx(NORMAL, "Examples:");
     PrintAndLogEx(NORMAL, _YELLOW_("        hf mfu pwdgen r"));
+    PrintAndLogEx(NORMAL, _YELLOW_("        hf mfu pwdgen c"));
+    PrintAndLogEx(NORMAL, _YELLOW_("        hf mfu pwdgen c f mypwds"));
     PrintAndLogEx(NORMAL, _YELLOW_("        hf mfu pwdgen 11223344556677"));
     PrintAndLogEx(NORMAL, _YELLOW_("        hf mfu pwdgen t"));
     PrintAndLogEx(NORMAL, "");
@@ -235,8 +241,8 @@ static int usage_hf_mfu_pwdgen(void) {
 }
 
 static int usage_hf_mfu_otp_tearoff(void) {
-    PrintAndLogEx(NORMAL, "Tear-off test against OTP block (no 3) on MFU tags - More help sooner or later\n");
-    PrintAndLogEx(NORMAL, "Usage:  hf mfu otptear b <block number> i <intervalTime> l <limitTime> s <startTime> d <data before> t <data after>\n");
+    PrintAndLogEx(NORMAL, "Tear-off test against OTP block (no 3) on MFU tags, the whole sweep runs on the device\n");
+    PrintAndLogEx(NORMAL, "Usage:  hf mfu otptear b <block number> i <intervalTime> l <limitTime> s <startTime> d <data before> t <data after> [n <blocks>] [r <repeat>] [e] [w]\n");
     PrintAndLogEx(NORMAL, "Options:");
     PrintAndLogEx(NORMAL, "  b <no>    : (optional) block to run the test -  default block: 8 (not OTP for safety)");
     PrintAndLogEx(NORMAL, "  i <time>  : (optional) time interval to increase in each test - default 500 us");
@@ -244,12 +250,19 @@ static int usage_hf_mfu_otp_tearoff(void) {
     PrintAndLogEx(NORMAL, "  s <time>  : (optional) start time to run the test - default 0 us");
     PrintAndLogEx(NORMAL, "  d <data>  : (optional) data to full-write before trying the OTP test - default 0x00");
     PrintAndLogEx(NORMAL, "  t <data>  : (optional) data to write while running the OTP test - default 0x00");
+    PrintAndLogEx(NORMAL, "  n <no>    : (optional) number of blocks from b to sweep - default 1");
+    PrintAndLogEx(NORMAL, "  r <no>    : (optional) attempts for each time - default 1");
+    PrintAndLogEx(NORMAL, "  e         : (optional) stop at the first partial write");
+    PrintAndLogEx(NORMAL, "  w         : (optional) no full-write of <data before> before the attempts");
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(NORMAL, "  times are in us, fractions like 12.5 are timed in 1/48MHz steps, at most %u attempts", MFU_TEAROFF_LOG_ENTRIES);
     PrintAndLogEx(NORMAL, "");
     PrintAndLogEx(NORMAL, "Examples:");
     PrintAndLogEx(NORMAL, "        hf mfu otptear b 3");
     PrintAndLogEx(NORMAL, "        hf mfu otptear b 8 i 100 l 3000 s 1000");
     PrintAndLogEx(NORMAL, "        hf mfu otptear b 3 i 1 l 200");
     PrintAndLogEx(NORMAL, "        hf mfu otptear b 3 i 100 l 2500 s 200 d FFFFFFFF t EEEEEEEE");
+    PrintAndLogEx(NORMAL, "        hf mfu otptear b 8 i 0.25 s 280 l 320 r 4 e");
     return PM3_SUCCESS;
 }
 
@@ -268,6 +281,22 @@ uint8_t default_pwd_pack[][4] = {
     {0xFF, 0xFF, 0xFF, 0xFF}, // PACK 0x00,0x00 -- factory default
 };
 
+// uid based EV1 / NTAG password algorithms
+typedef struct {
+    const char *name;
+    uint32_t (*pwdgen)(uint8_t *uid);
+    uint16_t (*packgen)(uint8_t *uid);
+} mfu_pwdgen_t;
+
+static const mfu_pwdgen_t mfu_pwdgens[] = {
+    {"EV1", ul_ev1_pwdgenA, ul_ev1_packgenA},
+    {"Ami", ul_ev1_pwdgenB, ul_ev1_packgenB},
+    {"LD",  ul_ev1_pwdgenC, ul_ev1_packgenC},
+    {"XYZ", ul_ev1_pwdgenD, ul_ev1_packgenD},
+};
+
+#define MFU_PWD_CANDIDATES  (ARRAYLEN(mfu_pwdgens) + ARRAYLEN(default_pwd_pack))
+
 uint32_t UL_TYPES_ARRAY[] = {
     UNKNOWN,   UL,          UL_C,        UL_EV1_48,       UL_EV1_128,      NTAG,
     NTAG_203,  NTAG_210,    NTAG_212,    NTAG_213,        NTAG_215,        NTAG_216,
@@ -417,6 +446,48 @@ static int ulev1_requestAuthentication(uint8_t *pwd, uint8_t *pack, uint16_t pac
     return len;
 }
 
+// Checks keycnt EV1 / NTAG passwords, or with MFU_CHK_ULC UL-C 3DES keys, in device side batches.
+// Each batch selects the card once. PM3_SUCCESS with the index of the key in *found, PM3_ESOFT if none fits
+static int mfu_chk_keys(uint8_t flags, const uint8_t *keys, uint32_t keycnt, uint32_t *found, uint8_t *pack) {
+    uint8_t keylen = (flags & MFU_CHK_ULC) ? 16 : 4;
+    uint8_t batch = MFU_CHK_KEYS_DATA / keylen;
+
+    for (uint32_t i = 0; i < keycnt; i += batch) {
+        mfu_chk_req_t req = { .flags = flags, .count = MIN(batch, keycnt - i) };
+        memcpy(req.keys, keys + i * keylen, req.count * keylen);
+
+        clearCommandBuffer();
+        SendCommandNG(CMD_HF_MIFAREU_CHKPWD, (uint8_t *)&req, sizeof(req) - MFU_CHK_KEYS_DATA + req.count * keylen);
+        PacketResponseNG resp;
+        if (WaitForResponseTimeout(CMD_HF_MIFAREU_CHKPWD, &resp, 2500) == false) {
+            PrintAndLogEx(WARNING, "timeout while waiting for reply.");
+            return PM3_ETIMEOUT;
+        }
+        if (resp.status != PM3_SUCCESS)
+            return resp.status;
+
+        mfu_chk_resp_t *r = (mfu_chk_resp_t *)resp.data.asBytes;
+        if (r->found) {
+            *found = i + r->index;
+            if (pack)
+                memcpy(pack, r->pack, sizeof(r->pack));
+            return PM3_SUCCESS;
+        }
+    }
+    return PM3_ESOFT;
+}
+
+// EV1 / NTAG passwords worth a try on uid: the ones of the algorithms, then default_pwd_pack.
+// pwds holds MFU_PWD_CANDIDATES, returns how many
+static uint8_t mfu_pwd_candidates(uint8_t *uid, uint8_t *pwds) {
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < ARRAYLEN(mfu_pwdgens); i++)
+        num_to_bytes(mfu_pwdgens[i].pwdgen(uid), 4, pwds + 4 * n++);
+    for (uint8_t i = 0; i < ARRAYLEN(default_pwd_pack); i++)
+        memcpy(pwds + 4 * n++, default_pwd_pack[i], 4);
+    return n;
+}
+
 static int ul_auth_select(iso14a_card_select_t *card, TagTypeUL_t tagtype, bool hasAuthKey, uint8_t *authkey, uint8_t *pack, uint8_t packSize) {
     if (hasAuthKey && (tagtype & UL_C)) {
         //will select card automatically and close connection on error
@@ -1204,10 +1275,7 @@ static int CmdHF14AMfUInfo(const char *Cmd) {
     uint8_t dataLen = 0;
     uint8_t authenticationkey[16] = {0x00};
     uint8_t *authkeyptr = authenticationkey;
-    uint8_t pwd[4] = {0, 0, 0, 0};
-    uint8_t *key = pwd;
     uint8_t pack[4] = {0, 0, 0, 0};
-    int len;
     uint8_t uid[7];
 
     char tempStr[50];
@@ -1303,15 +1371,12 @@ static int CmdHF14AMfUInfo(const char *Cmd) {
 
             // also try to diversify default keys..  look into CmdHF14AMfGenDiverseKeys
             PrintAndLogEx(INFO, "Trying some default 3des keys");
-            for (uint8_t i = 0; i < ARRAYLEN(default_3des_keys); ++i) {
-                key = default_3des_keys[i];
-                if (ulc_authentication(key, true)) {
-                    PrintAndLogEx(SUCCESS, "Found default 3des key: ");
-                    uint8_t keySwap[16];
-                    memcpy(keySwap, SwapEndian64(key, 16, 8), 16);
-                    ulc_print_3deskey(keySwap);
-                    return PM3_SUCCESS;
-                }
+            uint32_t found = 0;
+            if (mfu_chk_keys(MFU_CHK_ULC, (uint8_t *)default_3des_keys, ARRAYLEN(default_3des_keys), &found, NULL) == PM3_SUCCESS) {
+                PrintAndLogEx(SUCCESS, "Found default 3des key: ");
+                uint8_t keySwap[16];
+                memcpy(keySwap, SwapEndian64(default_3des_keys[found], 16, 8), 16);
+                ulc_print_3deskey(keySwap);
             }
             return PM3_SUCCESS;
         }
@@ -1401,60 +1466,20 @@ static int CmdHF14AMfUInfo(const char *Cmd) {
         if (!authlim && !hasAuthKey) {
             PrintAndLogEx(NORMAL, "");
             PrintAndLogEx(SUCCESS, "--- " _CYAN_("Known EV1/NTAG passwords"));
-            // test pwd gen A
-            num_to_bytes(ul_ev1_pwdgenA(card.uid), 4, key);
-            len = ulev1_requestAuthentication(key, pack, sizeof(pack));
-            if (len > -1) {
-                PrintAndLogEx(SUCCESS, "Found a default password: " _GREEN_("%s") "|| Pack: %02X %02X", sprint_hex(key, 4), pack[0], pack[1]);
-                goto out;
-            }
-
-            if (ul_auth_select(&card, tagtype, hasAuthKey, authkeyptr, pack, sizeof(pack)) == PM3_ESOFT) return PM3_ESOFT;
-
-            // test pwd gen B
-            num_to_bytes(ul_ev1_pwdgenB(card.uid), 4, key);
-            len = ulev1_requestAuthentication(key, pack, sizeof(pack));
-            if (len > -1) {
-                PrintAndLogEx(SUCCESS, "Found a default password: " _GREEN_("%s") " || Pack: %02X %02X", sprint_hex(key, 4), pack[0], pack[1]);
-                goto out;
-            }
-
-            if (ul_auth_select(&card, tagtype, hasAuthKey, authkeyptr, pack, sizeof(pack)) == PM3_ESOFT) return PM3_ESOFT;
-
-            // test pwd gen C
-            num_to_bytes(ul_ev1_pwdgenC(card.uid), 4, key);
-            len = ulev1_requestAuthentication(key, pack, sizeof(pack));
-            if (len > -1) {
-                PrintAndLogEx(SUCCESS, "Found a default password: " _GREEN_("%s") " || Pack: %02X %02X", sprint_hex(key, 4), pack[0], pack[1]);
-                goto out;
-            }
-
-            if (ul_auth_select(&card, tagtype, hasAuthKey, authkeyptr, pack, sizeof(pack)) == PM3_ESOFT) return PM3_ESOFT;
-
-            // test pwd gen D
-            num_to_bytes(ul_ev1_pwdgenD(card.uid), 4, key);
-            len = ulev1_requestAuthentication(key, pack, sizeof(pack));
-            if (len > -1) {
-                PrintAndLogEx(SUCCESS, "Found a default password:" _GREEN_("%s") " || Pack: %02X %02X", sprint_hex(key, 4), pack[0], pack[1]);
-                goto out;
-            }
-
-            if (ul_auth_select(&card, tagtype, hasAuthKey, authkeyptr, pack, sizeof(pack)) == PM3_ESOFT) return PM3_ESOFT;
-
-            for (uint8_t i = 0; i < ARRAYLEN(default_pwd_pack); ++i) {
-                key = default_pwd_pack[i];
-                len = ulev1_requestAuthentication(key, pack, sizeof(pack));
-                if (len > -1) {
-                    PrintAndLogEx(SUCCESS, "Found a default password: " _GREEN_("%s") " || Pack: %02X %02X", sprint_hex(key, 4), pack[0], pack[1]);
-                    break;
-                } else {
-                    if (ul_auth_select(&card, tagtype, hasAuthKey, authkeyptr, pack, sizeof(pack)) == PM3_ESOFT) return PM3_ESOFT;
-                }
-            }
-            if (len < 1) PrintAndLogEx(WARNING, _YELLOW_("password not known"));
+            // the device selects the card again and tries them all in one go
+            DropField();
+            uint8_t pwds[MFU_PWD_CANDIDATES * 4];
+            uint8_t n = mfu_pwd_candidates(card.uid, pwds);
+            uint32_t found = 0;
+            int res = mfu_chk_keys(0, pwds, n, &found, pack);
+            if (res == PM3_SUCCESS)
+                PrintAndLogEx(SUCCESS, "Found a default password: " _GREEN_("%s") " || Pack: %02X %02X", sprint_hex(pwds + 4 * found, 4), pack[0], pack[1]);
+            else if (res == PM3_ESOFT)
+                PrintAndLogEx(WARNING, _YELLOW_("password not known"));
+            else
+                PrintAndLogEx(WARNING, "password check failed (%d)", res);
         }
     }
-out:
     DropField();
     if (locked) PrintAndLogEx(FAILED, "\nTag appears to be locked, try using the key to get more info");
     PrintAndLogEx(NORMAL, "");
@@ -1952,22 +1977,48 @@ static int CmdHF14AMfUDump(const char *Cmd) {
             keytype = 2; //UL_EV1/NTAG auth
     }
 
+    mfu_dump_req_t req = {0};
+    req.startpage = startPage;
+    req.pages = pages;
+    req.keytype = keytype;
+    memcpy(req.key, authKeyPtr, MIN(dataLen, sizeof(req.key)));
+
+    // EV1 and NTAG21x take the memory in a few FAST_READ ranges
+    if (tagtype & (UL_EV1_48 | UL_EV1_128 | UL_EV1 | NTAG_210 | NTAG_212 | NTAG_213 | NTAG_213_F | NTAG_215 | NTAG_216 | NTAG_216_F))
+        req.flags |= MFU_DUMP_FAST_READ;
+
+    // not ul_c and not std ul then attempt to collect info like
+    //  VERSION, SIGNATURE, COUNTERS, TEARING, PACK,
+    bool extras = !(tagtype & UL_C || tagtype & UL || tagtype & MY_D_MOVE || tagtype & MY_D_MOVE_LEAN);
+    if (extras) {
+        req.flags |= MFU_DUMP_VERSION | MFU_DUMP_SIGNATURE;
+
+        // NTAG has 1 counter, at 0x02, ULEV-1 has 3 counters and tearing flags
+        if ((tagtype & (NTAG_213 | NTAG_213_F | NTAG_215 | NTAG_216))) {
+            req.counters = 0x04;
+        } else {
+            req.counters = 0x07;
+            req.tearing = 0x07;
+        }
+    }
+
     clearCommandBuffer();
-    SendCommandMIX(CMD_HF_MIFAREU_READCARD, startPage, pages, keytype, authKeyPtr, dataLen);
+    SendCommandNG(CMD_HF_MIFAREU_DUMP, (uint8_t *)&req, sizeof(req));
 
     PacketResponseNG resp;
-    if (!WaitForResponseTimeout(CMD_ACK, &resp, 2500)) {
+    if (!WaitForResponseTimeout(CMD_HF_MIFAREU_DUMP, &resp, 2500)) {
         PrintAndLogEx(WARNING, "Command execute time-out");
         return 1;
     }
 
-    if (resp.oldarg[0] != 1) {
+    if (resp.status != PM3_SUCCESS) {
         PrintAndLogEx(WARNING, "Failed dumping card");
         return 1;
     }
 
-    uint32_t startindex = resp.oldarg[2];
-    uint32_t bufferSize = resp.oldarg[1];
+    mfu_dump_resp_t *dr = (mfu_dump_resp_t *)resp.data.asBytes;
+    uint32_t startindex = dr->offset;
+    uint32_t bufferSize = dr->pages * 4;
     if (bufferSize > sizeof(data)) {
         PrintAndLogEx(FAILED, "Data exceeded Buffer size!");
         bufferSize = sizeof(data);
@@ -1982,79 +2033,13 @@ static int CmdHF14AMfUDump(const char *Cmd) {
 
     pages = bufferSize / 4;
 
-    iso14a_card_select_t card;
     mfu_dump_t dump_file_data;
-    uint8_t get_version[] = {0, 0, 0, 0, 0, 0, 0, 0};
-    uint8_t get_counter_tearing[][4] = {{0, 0, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}};
-    uint8_t get_signature[32];
-    memset(get_signature, 0, sizeof(get_signature));
-
-    // not ul_c and not std ul then attempt to collect info like
-    //  VERSION, SIGNATURE, COUNTERS, TEARING, PACK,
-    if (!(tagtype & UL_C || tagtype & UL || tagtype & MY_D_MOVE || tagtype & MY_D_MOVE_LEAN)) {
-        //attempt to read pack
-        uint8_t get_pack[] = {0, 0};
-        if (ul_auth_select(&card, tagtype, true, authKeyPtr, get_pack, sizeof(get_pack)) != PM3_SUCCESS) {
-            //reset pack
-            get_pack[0] = 0;
-            get_pack[1] = 0;
-        }
-        DropField();
-
-        // only add pack if not partial read,  and complete pages read.
-        if (!is_partial && pages == card_mem_size) {
-
-            // add pack to block read
-            memcpy(data + (pages * 4) - 4, get_pack, sizeof(get_pack));
-        }
-
-        if (hasAuthKey) {
-            uint8_t dummy_pack[] = {0, 0};
-            ul_auth_select(&card, tagtype, hasAuthKey, authKeyPtr, dummy_pack, sizeof(dummy_pack));
-        } else {
-            ul_select(&card);
-        }
-
-        ulev1_getVersion(get_version, sizeof(get_version));
-
-        // ULEV-1 has 3 counters
-        uint8_t n = 0;
-
-        // NTAG has 1 counter, at 0x02
-        if ((tagtype & (NTAG_213 | NTAG_213_F | NTAG_215 | NTAG_216))) {
-            n = 2;
-        }
-
-        // NTAG can have nfc counter pwd protection enabled
-        for (; n < 3; n++) {
-
-            if (hasAuthKey) {
-                uint8_t dummy_pack[] = {0, 0};
-                ul_auth_select(&card, tagtype, hasAuthKey, authKeyPtr, dummy_pack, sizeof(dummy_pack));
-            } else {
-                ul_select(&card);
-            }
-            ulev1_readCounter(n, &get_counter_tearing[n][0], 3);
 
-            if (hasAuthKey) {
-                uint8_t dummy_pack[] = {0, 0};
-                ul_auth_select(&card, tagtype, hasAuthKey, authKeyPtr, dummy_pack, sizeof(dummy_pack));
-            } else {
-                ul_select(&card);
-            }
-            ulev1_readTearing(n, &get_counter_tearing[n][3], 1);
-        }
-
-        DropField();
+    // only add pack if not partial read,  and complete pages read.
+    if (extras && !is_partial && pages == card_mem_size) {
 
-        if (hasAuthKey) {
-            uint8_t dummy_pack[] = {0, 0};
-            ul_auth_select(&card, tagtype, hasAuthKey, authKeyPtr, dummy_pack, sizeof(dummy_pack));
-        } else
-            ul_select(&card);
-
-        ulev1_readSignature(get_signature, sizeof(get_signature));
-        DropField();
+        // add pack to block read
+        memcpy(data + (pages * 4) - 4, dr->pack, sizeof(dr->pack));
     }
 
     // format and add keys to block dump output
@@ -2080,9 +2065,9 @@ static int CmdHF14AMfUDump(const char *Cmd) {
     //add *special* blocks to dump
     // pack and pwd saved into last pages of dump, if was not partial read
     dump_file_data.pages = pages - 1;
-    memcpy(dump_file_data.version, get_version, sizeof(dump_file_data.version));
-    memcpy(dump_file_data.signature, get_signature, sizeof(dump_file_data.signature));
-    memcpy(dump_file_data.counter_tearing, get_counter_tearing, sizeof(dump_file_data.counter_tearing));
+    memcpy(dump_file_data.version, dr->version, sizeof(dump_file_data.version));
+    memcpy(dump_file_data.signature, dr->signature, sizeof(dump_file_data.signature));
+    memcpy(dump_file_data.counter_tearing, dr->counter_tearing, sizeof(dump_file_data.counter_tearing));
     memcpy(dump_file_data.data, data, pages * 4);
 
     printMFUdumpEx(&dump_file_data, pages, startPage);
@@ -2736,7 +2721,16 @@ static int CmdHF14AMfUPwdGen(const char *Cmd) {
 
     if (cmdp == 't') return generator_selftest();
 
-    if (cmdp == 'r') {
+    bool check = (cmdp == 'c');
+    char filename[FILE_PATH_SIZE] = {0};
+    if (check && tolower(param_getchar(Cmd, 1)) == 'f') {
+        if (param_getstr(Cmd, 2, filename, sizeof(filename)) == 0) {
+            PrintAndLogEx(WARNING, "missing dictionary");
+            return usage_hf_mfu_pwdgen();
+        }
+    }
+
+    if (cmdp == 'r' || check) {
         // read uid from tag
         clearCommandBuffer();
         SendCommandMIX(CMD_HF_ISO14443A_READER, ISO14A_CONNECT | ISO14A_NO_RATS, 0, 0, NULL, 0);
@@ -2768,14 +2762,76 @@ static int CmdHF14AMfUPwdGen(const char *Cmd) {
     PrintAndLogEx(NORMAL, "---------------------------------");
     PrintAndLogEx(NORMAL, " algo | pwd      | pack");
     PrintAndLogEx(NORMAL, "------+----------+-----");
-    PrintAndLogEx(NORMAL, " EV1  | %08X | %04X", ul_ev1_pwdgenA(uid), ul_ev1_packgenA(uid));
-    PrintAndLogEx(NORMAL, " Ami  | %08X | %04X", ul_ev1_pwdgenB(uid), ul_ev1_packgenB(uid));
-    PrintAndLogEx(NORMAL, " LD   | %08X | %04X", ul_ev1_pwdgenC(uid), ul_ev1_packgenC(uid));
-    PrintAndLogEx(NORMAL, " XYZ  | %08X | %04X", ul_ev1_pwdgenD(uid), ul_ev1_packgenD(uid));
+    for (uint8_t i = 0; i < ARRAYLEN(mfu_pwdgens); i++)
+        PrintAndLogEx(NORMAL, " %-4s | %08X | %04X", mfu_pwdgens[i].name, mfu_pwdgens[i].pwdgen(uid), mfu_pwdgens[i].packgen(uid));
     PrintAndLogEx(NORMAL, "------+----------+-----");
     PrintAndLogEx(NORMAL, " Vingcard algo");
     PrintAndLogEx(NORMAL, "--------------------");
-    return PM3_SUCCESS;
+
+    if (check == false)
+        return PM3_SUCCESS;
+
+    // algorithms and defaults first, then the dictionary
+    uint8_t *dict = NULL;
+    uint32_t dictcnt = 0;
+    if (filename[0] && loadFileDICTIONARY_safe(filename, (void **)&dict, 4, &dictcnt) != PM3_SUCCESS) {
+        free(dict);
+        return PM3_EFILE;
+    }
+
+    uint8_t *pwds = calloc(MFU_PWD_CANDIDATES + dictcnt, 4);
+    if (pwds == NULL) {
+        free(dict);
+        return PM3_EMALLOC;
+    }
+    uint8_t n = mfu_pwd_candidates(uid, pwds);
+    if (dictcnt)
+        memcpy(pwds + 4 * n, dict, 4 * dictcnt);
+    free(dict);
+
+    PrintAndLogEx(INFO, "checking " _YELLOW_("%u") " passwords", n + dictcnt);
+    uint32_t found = 0;
+    uint8_t pack[2] = {0};
+    int res = mfu_chk_keys(0, pwds, n + dictcnt, &found, pack);
+    if (res == PM3_SUCCESS) {
+        const char *from = (found < ARRAYLEN(mfu_pwdgens)) ? mfu_pwdgens[found].name : (found < n) ? "default" : "dictionary";
+        PrintAndLogEx(SUCCESS, "Found password: " _GREEN_("%s") " (%s) || Pack: %02X %02X", sprint_hex(pwds + 4 * found, 4), from, pack[0], pack[1]);
+    } else if (res == PM3_ESOFT) {
+        PrintAndLogEx(WARNING, _YELLOW_("password not known"));
+    } else {
+        PrintAndLogEx(WARNING, "password check failed (%d)", res);
+    }
+    free(pwds);
+    return (res == PM3_ESOFT) ? PM3_SUCCESS : res;
+}
+
+//
+// time in us, fractions allowed, to ns
+static bool mfu_param_get_ns(const char *Cmd, uint8_t cmdp, uint32_t *ns) {
+    char str[20] = {0};
+    if (param_getstr(Cmd, cmdp, str, sizeof(str)) == 0)
+        return false;
+
+    char *end = NULL;
+    double us = strtod(str, &end);
+    if (*end != '\0' || us < 0 || us * 1000 > UINT32_MAX)
+        return false;
+
+    *ns = (uint32_t)(us * 1000 + 0.5);
+    return true;
+}
+
+static const char *mfu_tearoff_status(uint8_t status) {
+    switch (status) {
+        case MFU_TEAROFF_UNCHANGED:
+            return "unchanged";
+        case MFU_TEAROFF_WRITTEN:
+            return _GREEN_("written");
+        case MFU_TEAROFF_PARTIAL:
+            return _YELLOW_("partial");
+        default:
+            return _RED_("no tag");
+    }
 }
 
 //
@@ -2783,65 +2839,89 @@ static int CmdHF14AMfUPwdGen(const char *Cmd) {
 // Moebius et al
 //
 static int CmdHF14AMfuOtpTearoff(const char *Cmd) {
-    uint8_t blockNoUint = 8;
     uint8_t cmdp = 0;
     bool errors = 0;
-    uint8_t teardata[8] = {0x00};
-    uint32_t interval = 500; // time in us
-    uint32_t timeLimit = 3000; // time in us
-    uint32_t startTime = 0; // time in us
+    mfu_tearoff_sweep_req_t req = {
+        .block = 8,
+        .blocks = 1,
+        .repeat = 1,
+    };
+    uint32_t interval = 500000; // time in ns
+    uint32_t timeLimit = 3000000; // time in ns
+    uint32_t startTime = 0; // time in ns
 
     while (param_getchar(Cmd, cmdp) != 0x00 && !errors) {
         switch (tolower(param_getchar(Cmd, cmdp))) {
             case 'h':
                 return usage_hf_mfu_otp_tearoff();
             case 'b':
-                blockNoUint = param_get8(Cmd, cmdp + 1);
+                req.block = param_get8(Cmd, cmdp + 1);
                 //iceman,  which blocks can be targeted? UID blocks?
-                if (blockNoUint < 2) {
+                if (req.block < 2) {
                     PrintAndLogEx(WARNING, "Wrong block number");
                     errors = true;
                 }
                 cmdp += 2;
                 break;
             case 'i':
-                interval = param_get32ex(Cmd, cmdp + 1, interval, 10);
-                if (interval == 0) {
+                if (mfu_param_get_ns(Cmd, cmdp + 1, &interval) == false || interval == 0) {
                     PrintAndLogEx(WARNING, "Wrong interval number");
                     errors = true;
                 }
                 cmdp += 2;
                 break;
             case 'l':
-                timeLimit = param_get32ex(Cmd, cmdp + 1, timeLimit, 10);
-                if (timeLimit < interval) {
+                if (mfu_param_get_ns(Cmd, cmdp + 1, &timeLimit) == false) {
                     PrintAndLogEx(WARNING, "Wrong time limit number");
                     errors = true;
                 }
                 cmdp += 2;
                 break;
             case 's':
-                startTime = param_get32ex(Cmd, cmdp + 1, 0, 10);
-                if (startTime > (timeLimit - interval)) {
+                if (mfu_param_get_ns(Cmd, cmdp + 1, &startTime) == false) {
                     PrintAndLogEx(WARNING, "Wrong start time number");
                     errors = true;
                 }
                 cmdp += 2;
                 break;
             case 'd':
-                if (param_gethex(Cmd, cmdp + 1, teardata, 8)) {
+                if (param_gethex(Cmd, cmdp + 1, req.data, 8)) {
                     PrintAndLogEx(WARNING, "Block data must include 8 HEX symbols");
                     errors = true;
                 }
                 cmdp += 2;
                 break;
             case 't':
-                if (param_gethex(Cmd, cmdp + 1, teardata + 4, 8)) {
+                if (param_gethex(Cmd, cmdp + 1, req.tear, 8)) {
                     PrintAndLogEx(WARNING, "Block data must include 8 HEX symbols");
                     errors = true;
                 }
                 cmdp += 2;
                 break;
+            case 'n':
+                req.blocks = param_get8(Cmd, cmdp + 1);
+                if (req.blocks == 0) {
+                    PrintAndLogEx(WARNING, "Wrong number of blocks");
+                    errors = true;
+                }
+                cmdp += 2;
+                break;
+            case 'r':
+                req.repeat = param_get8(Cmd, cmdp + 1);
+                if (req.repeat == 0) {
+                    PrintAndLogEx(WARNING, "Wrong number of attempts");
+                    errors = true;
+                }
+                cmdp += 2;
+                break;
+            case 'e':
+                req.flags |= MFU_TEAROFF_STOP_PARTIAL;
+                cmdp++;
+                break;
+            case 'w':
+                req.flags |= MFU_TEAROFF_NO_RESTORE;
+                cmdp++;
+                break;
             default:
                 PrintAndLogEx(WARNING, "Unknown parameter '%c'", param_getchar(Cmd, cmdp));
                 errors = true;
@@ -2849,68 +2929,89 @@ static int CmdHF14AMfuOtpTearoff(const char *Cmd) {
         }
     }
 
+    if (!errors && timeLimit < interval) {
+        PrintAndLogEx(WARNING, "Wrong time limit number");
+        errors = true;
+    }
+    if (!errors && startTime > (timeLimit - interval)) {
+        PrintAndLogEx(WARNING, "Wrong start time number");
+        errors = true;
+    }
+
     if (errors) return usage_hf_mfu_otp_tearoff();
 
-    PrintAndLogEx(INFO, "Starting TearOff test - Selected Block no: %u", blockNoUint);
+    // same times as the host driven loop had, start .. limit - interval
+    req.start = startTime;
+    req.end = timeLimit - interval;
+    req.step = interval;
 
+    uint64_t attempts = (uint64_t)req.blocks * req.repeat * ((req.end - req.start) / req.step + 1);
+    PrintAndLogEx(INFO, "Starting TearOff test - Selected Block no: %u, %" PRIu64 " attempts", req.block, attempts);
+    if (attempts > MFU_TEAROFF_LOG_ENTRIES)
+        PrintAndLogEx(WARNING, "the device log stops after " _YELLOW_("%u") " attempts", MFU_TEAROFF_LOG_ENTRIES);
+    PrintAndLogEx(INFO, "press pm3-button to abort");
 
-    uint32_t actualTime = startTime;
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_MFU_OTP_TEAROFF_SWEEP, (uint8_t *)&req, sizeof(req));
 
-    while (actualTime <= (timeLimit - interval)) {
-        PrintAndLogEx(INFO, "Using tear-off at: %" PRIu32 " us", actualTime);
-        PrintAndLogEx(INFO, "Reading block BEFORE attack");
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(NORMAL, "  time us   | block | before      | after       | result");
+    PrintAndLogEx(NORMAL, "------------+-------+-------------+-------------+-----------");
 
-        clearCommandBuffer();
-        SendCommandMIX(CMD_HF_MIFAREU_READBL, blockNoUint, 0, 0, NULL, 0);
-        PacketResponseNG resp;
+    uint32_t counts[4] = {0};
+    uint32_t first_partial = 0;
+    bool partial = false;
 
-        if (WaitForResponseTimeout(CMD_ACK, &resp, 1500)) {
-            uint8_t isOK = resp.oldarg[0] & 0xff;
-            if (isOK) {
-                uint8_t *d = resp.data.asBytes;
-                PrintAndLogEx(NORMAL, "\nBlock#  | Data        | Ascii");
-                PrintAndLogEx(NORMAL, "-----------------------------");
-                PrintAndLogEx(NORMAL, "%02d/0x%02X | %s| %s\n", blockNoUint, blockNoUint, sprint_hex(d, 4), sprint_ascii(d, 4));
-            }
-        }
+    // a frame at most every MFU_TEAROFF_FRAME_ENTRIES attempts
+    uint32_t timeout = 5000 + MFU_TEAROFF_FRAME_ENTRIES * (req.end / 1000000 + 1);
 
-        PrintAndLogEx(INFO, ".....");
-        clearCommandBuffer();
+    PacketResponseNG resp;
+    mfu_tearoff_frame_t *frame = (mfu_tearoff_frame_t *)resp.data.asBytes;
+    for (;;) {
+        if (WaitForResponseTimeout(CMD_HF_MFU_OTP_TEAROFF_SWEEP, &resp, timeout) == false) {
+            PrintAndLogEx(WARNING, "command execution time out");
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            return PM3_ETIMEOUT;
+        }
 
-        SendCommandMIX(CMD_HF_MFU_OTP_TEAROFF, blockNoUint, actualTime, 0, teardata, 8);
-        if (!WaitForResponseTimeout(CMD_HF_MFU_OTP_TEAROFF, &resp, 4000)) {
+        if (resp.length < sizeof(mfu_tearoff_frame_t) - sizeof(frame->entries)) {
             PrintAndLogEx(WARNING, "Failed");
-            return PM3_ESOFT;
+            return (resp.status == PM3_SUCCESS) ? PM3_ESOFT : resp.status;
         }
 
-        PrintAndLogEx(INFO, "Reading block AFTER attack");
-
-        clearCommandBuffer();
-        SendCommandMIX(CMD_HF_MIFAREU_READBL, blockNoUint, 0, 0, NULL, 0);
-        if (WaitForResponseTimeout(CMD_ACK, &resp, 1500)) {
-            uint8_t isOK = resp.oldarg[0] & 0xff;
-            if (isOK) {
-                uint8_t *d = resp.data.asBytes;
-                PrintAndLogEx(NORMAL, "\nBlock#  | Data        | Ascii");
-                PrintAndLogEx(NORMAL, "-----------------------------");
-                PrintAndLogEx(NORMAL, "%02d/0x%02X | %s| %s\n", blockNoUint, blockNoUint, sprint_hex(d, 4), sprint_ascii(d, 4));
+        for (uint8_t i = 0; i < frame->count && i < MFU_TEAROFF_FRAME_ENTRIES; i++) {
+            mfu_tearoff_entry_t *e = &frame->entries[i];
+            PrintAndLogEx(NORMAL, " %10.3f |  %3u  | %s| %s| %s",
+                          e->delay / 1000.0,
+                          e->block,
+                          sprint_hex(e->before, sizeof(e->before)),
+                          sprint_hex(e->after, sizeof(e->after)),
+                          mfu_tearoff_status(e->status)
+                         );
+            counts[MIN(e->status, MFU_TEAROFF_NO_TAG)]++;
+            if (e->status == MFU_TEAROFF_PARTIAL && partial == false) {
+                partial = true;
+                first_partial = e->delay;
             }
         }
 
-        /*  TEMPORALLY DISABLED
-                uint8_t d0, d1, d2, d3;
-                d0 = *resp.data.asBytes;
-                d1 = *(resp.data.asBytes + 1);
-                d2 = *(resp.data.asBytes + 2);
-                d3 = *(resp.data.asBytes + 3);
-                if ((d0 != 0xFF) || (d1 != 0xFF) || (d2 != 0xFF) || (d3 = ! 0xFF)) {
-                    PrintAndLogEx(NORMAL, "---------------------------------");
-                    PrintAndLogEx(NORMAL, "        EFFECT AT: %d us", actualTime);
-                    PrintAndLogEx(NORMAL, "---------------------------------\n");
-                }
-        */
-        actualTime += interval;
+        if (frame->final)
+            break;
     }
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(SUCCESS, "unchanged " _YELLOW_("%u") ", written " _YELLOW_("%u") ", partial " _YELLOW_("%u") ", no tag " _YELLOW_("%u"),
+                  counts[MFU_TEAROFF_UNCHANGED], counts[MFU_TEAROFF_WRITTEN], counts[MFU_TEAROFF_PARTIAL], counts[MFU_TEAROFF_NO_TAG]);
+    if (partial)
+        PrintAndLogEx(SUCCESS, "first partial write at " _GREEN_("%.3f") " us", first_partial / 1000.0);
+
+    if (resp.status == PM3_EOPABORTED)
+        PrintAndLogEx(WARNING, "aborted via keyboard / button");
+    else if (resp.status == PM3_EOVFLOW)
+        PrintAndLogEx(WARNING, "device log full, the sweep stopped early");
+    else if (resp.status != PM3_SUCCESS)
+        return resp.status;
+
     return PM3_SUCCESS;
 }
 
@@ -3003,29 +3104,194 @@ static int CmdHF14MfuNDEF(const char *Cmd) {
         }
     }
 
-    // allocate mem
-    uint8_t *records = calloc(maxsize, sizeof(uint8_t));
-    if (records == NULL) {
+    // read NDEF records, decoded as they come in until the terminator
+    ndef_stream_t *ndef = calloc(1, sizeof(ndef_stream_t));
+    if (ndef == NULL) {
         DropField();
         return PM3_EMALLOC;
     }
+    NDEFStreamInit(ndef, true);
 
-    // read NDEF records.
-    for (uint16_t i = 0, j = 0; i < maxsize; i += 16, j += 4) {
-        status = ul_read(4 + j, records + i, 16);
+    for (uint16_t i = 0, j = 0; i < maxsize && ndef->done == false; i += 16, j += 4) {
+        uint8_t records[16] = {0};
+        status = ul_read(4 + j, records, sizeof(records));
         if (status == -1) {
             DropField();
             PrintAndLogEx(ERR, "Error: tag didn't answer to READ");
-            free(records);
+            free(ndef);
             return PM3_ESOFT;
         }
+
+        status = NDEFStreamFeed(ndef, records, MIN(16, maxsize - i));
+        if (status != PM3_SUCCESS) {
+            DropField();
+            free(ndef);
+            return status;
+        }
     }
 
     DropField();
-    status = NDEFDecodeAndPrint(records, (size_t)maxsize, true);
-    free(records);
+    status = NDEFStreamFinish(ndef);
+    free(ndef);
     return status;
 }
+// a pm3 dump (mfu_dump_t) of a NTAG215 or the raw pages, at least NFC3D_AMIIBO_SIZE bytes
+#define AMIIBO_PM3_DUMP_SIZE    (MFU_DUMP_PREFIX_LENGTH + 540)
+
+typedef struct {
+    char *name;
+    uint8_t *data;
+    size_t len;
+    size_t offset;          // of the NFC3D_AMIIBO_SIZE bytes in data
+} amiibo_file_t;
+
+static int CmdHF14AMfUAmiibo(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hf mfu amiibo",
+                  "Decrypts or encrypts all the amiibo dumps of a directory on several threads. Pm3 dumps (.bin of hf mfu dump)\n"
+                  "and raw dumps of at least 520 bytes are taken, the other bytes are kept as they are.\n"
+                  "Decrypted dumps are only written when their HMACs are right",
+                  "Usage:\n"
+                  "\thf mfu amiibo -d dumps                         -> decrypt every dump to <name>-dec.bin\n"
+                  "\thf mfu amiibo -d plain -o enc -e -k retail.bin -> encrypt every dump into directory enc\n");
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str1("dD", "dir", "<dir>", "directory of the dumps"),
+        arg_str0("oO", "out", "<dir>", "directory for the results, else next to the dumps"),
+        arg_str0("kK", "keys", "<file>", "amiibo master keys (default key_retail.bin)"),
+        arg_lit0("eE", "encrypt", "encrypt, default is decrypt"),
+        arg_int0("tT", "threads", "<dec>", "threads (default all CPUs)"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, false);
+
+    char dir[FILE_PATH_SIZE] = {0};
+    char outdir[FILE_PATH_SIZE] = {0};
+    char keyfile[FILE_PATH_SIZE] = {0};
+    int len = 0;
+    CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)dir, sizeof(dir) - 1, &len);
+    CLIParamStrToBuf(arg_get_str(ctx, 2), (uint8_t *)outdir, sizeof(outdir) - 1, &len);
+    CLIParamStrToBuf(arg_get_str(ctx, 3), (uint8_t *)keyfile, sizeof(keyfile) - 1, &len);
+    bool pack = arg_get_lit(ctx, 4);
+    int threads = arg_get_int_def(ctx, 5, num_CPUs());
+    CLIParserFree(ctx);
+
+    if (keyfile[0] == 0)
+        strcpy(keyfile, "key_retail.bin");
+    if (threads < 1)
+        threads = 1;
+
+    // strip a trailing separator, names are joined with one
+    for (size_t l = strlen(dir); l > 1 && dir[l - 1] == PATHSEP[0]; l--)
+        dir[l - 1] = 0;
+    for (size_t l = strlen(outdir); l > 1 && outdir[l - 1] == PATHSEP[0]; l--)
+        outdir[l - 1] = 0;
+
+    char *path = NULL;
+    if (searchFile(&path, RESOURCES_SUBDIR, keyfile, "", false) != PM3_SUCCESS)
+        return PM3_EFILE;
+
+    nfc3d_amiibo_keys keys;
+    bool loaded = nfc3d_amiibo_load_keys(&keys, path);
+    free(path);
+    if (loaded == false) {
+        PrintAndLogEx(WARNING, "can't load amiibo master keys from " _YELLOW_("%s"), keyfile);
+        return PM3_EFILE;
+    }
+
+    char **names = NULL;
+    int n = listDirFiles(dir, NULL, &names);
+    if (n < 0) {
+        PrintAndLogEx(WARNING, "can't read directory " _YELLOW_("%s"), dir);
+        return PM3_EFILE;
+    }
+
+    amiibo_file_t *files = calloc(n + 1, sizeof(amiibo_file_t));
+    uint8_t *in = calloc(n + 1, NFC3D_AMIIBO_SIZE);
+    uint8_t *out = calloc(n + 1, NFC3D_AMIIBO_SIZE);
+    bool *ok = calloc(n + 1, sizeof(bool));
+    if (files == NULL || in == NULL || out == NULL || ok == NULL) {
+        for (int i = 0; i < n; i++)
+            free(names[i]);
+        free(names);
+        free(files);
+        free(in);
+        free(out);
+        free(ok);
+        return PM3_EMALLOC;
+    }
+
+    size_t count = 0;
+    for (int i = 0; i < n; i++) {
+        char fn[FILE_PATH_SIZE * 2];
+        snprintf(fn, sizeof(fn), "%s" PATHSEP "%s", dir, names[i]);
+
+        amiibo_file_t *f = &files[count];
+        if (loadFile_safeEx(fn, "", (void **)&f->data, &f->len, false) != PM3_SUCCESS || f->len < NFC3D_AMIIBO_SIZE) {
+            PrintAndLogEx(INFO, "skipping " _YELLOW_("%s"), names[i]);
+            free(f->data);
+            free(names[i]);
+            f->data = NULL;
+            continue;
+        }
+
+        f->name = names[i];
+        f->offset = (f->len == AMIIBO_PM3_DUMP_SIZE) ? MFU_DUMP_PREFIX_LENGTH : 0;
+        memcpy(in + count * NFC3D_AMIIBO_SIZE, f->data + f->offset, NFC3D_AMIIBO_SIZE);
+        count++;
+    }
+    free(names);
+
+    PrintAndLogEx(INFO, "%s " _YELLOW_("%zu") " dumps on " _YELLOW_("%d") " threads", pack ? "encrypting" : "decrypting", count, threads);
+
+    uint64_t t1 = msclock();
+    size_t good = nfc3d_amiibo_batch(&keys, pack, in, out, ok, count, threads);
+    t1 = msclock() - t1;
+
+    int res = PM3_SUCCESS;
+    for (size_t i = 0; i < count; i++) {
+        amiibo_file_t *f = &files[i];
+
+        if (ok[i] == false) {
+            PrintAndLogEx(FAILED, "%-40s " _RED_("HMAC fail"), f->name);
+        } else {
+            char *ext = strrchr(f->name, '.');
+            if (ext && strcmp(ext, ".bin") == 0)
+                *ext = 0;
+
+            char fn[FILE_PATH_SIZE * 2];
+            if (outdir[0])
+                snprintf(fn, sizeof(fn), "%s" PATHSEP "%s.bin", outdir, f->name);
+            else
+                snprintf(fn, sizeof(fn), "%s" PATHSEP "%s-%s.bin", dir, f->name, pack ? "enc" : "dec");
+
+            memcpy(f->data + f->offset, out + i * NFC3D_AMIIBO_SIZE, NFC3D_AMIIBO_SIZE);
+
+            FILE *fp = fopen(fn, "wb");
+            if (fp == NULL || fwrite(f->data, 1, f->len, fp) != f->len) {
+                PrintAndLogEx(WARNING, "can't write " _YELLOW_("%s"), fn);
+                res = PM3_EFILE;
+            } else {
+                PrintAndLogEx(SUCCESS, "%-40s " _GREEN_("ok") "  %s", f->name, fn);
+            }
+            if (fp)
+                fclose(fp);
+        }
+
+        free(f->name);
+        free(f->data);
+    }
+
+    PrintAndLogEx(SUCCESS, _YELLOW_("%zu") " / " _YELLOW_("%zu") " dumps ok in %" PRIu64 " ms", good, count, t1);
+
+    free(files);
+    free(in);
+    free(out);
+    free(ok);
+    return res;
+}
+
 //------------------------------------
 // Menu Stuff
 //------------------------------------
@@ -3042,7 +3308,8 @@ static command_t CommandTable[] = {
     {"setuid",  CmdHF14AMfUCSetUid,        IfPm3Iso14443a,  "Set UID - MAGIC tags only"},
     {"sim",     CmdHF14AMfUSim,            IfPm3Iso14443a,  "Simulate Ultralight from emulator memory"},
     {"gen",     CmdHF14AMfUGenDiverseKeys, AlwaysAvailable, "Generate 3des mifare diversified keys"},
-    {"pwdgen",  CmdHF14AMfUPwdGen,         AlwaysAvailable, "Generate pwd from known algos"},
+    {"pwdgen",  CmdHF14AMfUPwdGen,         AlwaysAvailable, "Generate pwd from known algos, optionally check them on a tag"},
+    {"amiibo",  CmdHF14AMfUAmiibo,         AlwaysAvailable, "Decrypt / encrypt a directory of amiibo dumps"},
     {"otptear", CmdHF14AMfuOtpTearoff,     IfPm3Iso14443a,  "Tear-off test on OTP bits"},
     {"ndef",    CmdHF14MfuNDEF,            IfPm3Iso14443a,  "Prints NDEF records from card"},
     {NULL, NULL, NULL, NULL}
@@ -415,10 +415,43 @@ static int cmd_hf_st_ndef(const char *Cmd) {
     activate_field = false;
     keep_field_on = true;
 
+    // ---------------  CC file reading, how much a READ BINARY may get ----------------
+    uint8_t aSELECT_FILE_CC[30];
+    int aSELECT_FILE_CC_n = 0;
+    param_gethex_to_eol("00a4000c02e103", 0, aSELECT_FILE_CC, sizeof(aSELECT_FILE_CC), &aSELECT_FILE_CC_n);
+    res = ExchangeAPDU14a(aSELECT_FILE_CC, aSELECT_FILE_CC_n, activate_field, keep_field_on, response, sizeof(response), &resplen);
+    if (res)
+        return res;
+
+    sw = get_sw(response, resplen);
+    if (sw != 0x9000) {
+        PrintAndLogEx(ERR, "Selecting CC file failed (%04x - %s).", sw, GetAPDUCodeDescription(sw >> 8, sw & 0xff));
+        return PM3_ESOFT;
+    }
+
+    uint8_t aREAD_CC[30];
+    int aREAD_CC_n = 0;
+    param_gethex_to_eol("00b000000f", 0, aREAD_CC, sizeof(aREAD_CC), &aREAD_CC_n);
+    res = ExchangeAPDU14a(aREAD_CC, aREAD_CC_n, activate_field, keep_field_on, response, sizeof(response), &resplen);
+    if (res)
+        return res;
+
+    sw = get_sw(response, resplen);
+    if (sw != 0x9000 || resplen < 0x0F + 2) {
+        PrintAndLogEx(ERR, "reading CC file failed (%04x - %s).", sw, GetAPDUCodeDescription(sw >> 8, sw & 0xff));
+        return PM3_ESOFT;
+    }
+
+    uint16_t mle = (response[3] << 8 | response[4]);
+    uint16_t ndef_fid = (response[9] << 8 | response[10]);
+    uint16_t max_ndef = (response[11] << 8 | response[12]);
+
     // ---------------  NDEF file reading ----------------
     uint8_t aSELECT_FILE_NDEF[30];
     int aSELECT_FILE_NDEF_n = 0;
-    param_gethex_to_eol("00a4000c020001", 0, aSELECT_FILE_NDEF, sizeof(aSELECT_FILE_NDEF), &aSELECT_FILE_NDEF_n);    
+    param_gethex_to_eol("00a4000c020001", 0, aSELECT_FILE_NDEF, sizeof(aSELECT_FILE_NDEF), &aSELECT_FILE_NDEF_n);
+    aSELECT_FILE_NDEF[5] = ndef_fid >> 8;
+    aSELECT_FILE_NDEF[6] = ndef_fid & 0xFF;
     res = ExchangeAPDU14a(aSELECT_FILE_NDEF, aSELECT_FILE_NDEF_n, activate_field, keep_field_on, response, sizeof(response), &resplen);
     if (res)
         return res;
@@ -453,21 +486,29 @@ static int cmd_hf_st_ndef(const char *Cmd) {
         }
     }
    
-    keep_field_on = false;
-    uint8_t aREAD_NDEF[30];
-    int aREAD_NDEF_n = 0;
-    param_gethex_to_eol("00b000001d", 0, aREAD_NDEF, sizeof(aREAD_NDEF), &aREAD_NDEF_n);    
-    res = ExchangeAPDU14a(aREAD_NDEF, aREAD_NDEF_n, activate_field, keep_field_on, response, sizeof(response), &resplen);
-    if (res)
+    // the whole NDEF file in one go, NLEN first, the most a READ BINARY gets each time
+    uint8_t *ndef = calloc(max_ndef + 2, sizeof(uint8_t));
+    if (ndef == NULL) {
+        DropField();
+        return PM3_EMALLOC;
+    }
+
+    int ndeflen = 0;
+    res = ReadBinary14a(0, 0, max_ndef, MIN(mle, 256), true, ndef, max_ndef + 2, &ndeflen, &sw);
+    DropField();
+    if (res != PM3_SUCCESS) {
+        free(ndef);
         return res;
+    }
 
-    sw = get_sw(response, resplen);
-    if (sw != 0x9000) {
+    if (sw != 0x9000 || ndeflen < 2) {
         PrintAndLogEx(ERR, "reading NDEF file failed (%04x - %s).", sw, GetAPDUCodeDescription(sw >> 8, sw & 0xff));
+        free(ndef);
         return PM3_ESOFT;
     }
 
-    NDEFRecordsDecodeAndPrint(response + 2, resplen - 4);
+    NDEFRecordsDecodeAndPrint(ndef + 2, ndeflen - 2);
+    free(ndef);
     return PM3_SUCCESS;
 }
 
@@ -23,8 +23,6 @@
 #include "protocols.h"
 #include "mifare/ndef.h"
 
-#define TOPAZ_STATIC_MEMORY (0x0f * 8)  // 15 blocks with 8 Bytes each
-
 // a struct to describe a memory area which contains lock bits and the corresponding lockable memory area
 typedef struct dynamic_lock_area {
     struct dynamic_lock_area *next;
@@ -39,127 +37,44 @@ static struct {
     uint8_t uid[7];
     uint16_t size;
     uint8_t data_blocks[TOPAZ_STATIC_MEMORY / 8][8]; // this memory is always there
-    uint8_t *dynamic_memory;                       // this memory can be there
+    uint8_t dynamic_memory[TOPAZ_MAX_MEMORY - TOPAZ_STATIC_MEMORY]; // this memory can be there
     dynamic_lock_area_t *dynamic_lock_areas;       // lock area descriptors
 } topaz_tag;
 
-static void topaz_switch_on_field(void) {
-    SendCommandMIX(CMD_HF_ISO14443A_READER, ISO14A_CONNECT | ISO14A_NO_SELECT | ISO14A_NO_DISCONNECT | ISO14A_TOPAZMODE | ISO14A_NO_RATS, 0, 0, NULL, 0);
-}
-
 static void topaz_switch_off_field(void) {
     SendCommandMIX(CMD_HF_ISO14443A_READER, 0, 0, 0, NULL, 0);
 }
 
-// send a raw topaz command, returns the length of the response (0 in case of error)
-static int topaz_send_cmd_raw(uint8_t *cmd, uint8_t len, uint8_t *response, uint16_t *response_len, bool verbose) {
-    SendCommandOLD(CMD_HF_ISO14443A_READER, ISO14A_RAW | ISO14A_NO_DISCONNECT | ISO14A_TOPAZMODE | ISO14A_NO_RATS, len, 0, cmd, len);
+// select the tag and read all of its memory, the device does RALL and READ8 / RSEG of the dynamic memory
+// in one go. The static memory goes to data_blocks, the rest to dynamic_memory
+static int topaz_read_all(uint8_t *hr, bool verbose) {
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_TOPAZ_READALL, NULL, 0);
 
+    uint8_t mem[TOPAZ_MAX_MEMORY] = {0};
     PacketResponseNG resp;
-
-    if (!WaitForResponseTimeout(CMD_ACK, &resp, 1500)) {
-        if (verbose) PrintAndLogEx(WARNING, "timeout while waiting for reply.");
-        return PM3_ETIMEOUT;
-    }
-
-    if (resp.oldarg[0] == *response_len) {
-        *response_len = resp.oldarg[0];
-
-        PrintAndLogEx(DEBUG, "%s", sprint_hex(resp.data.asBytes, *response_len));
-        if (*response_len > 0) {
-            memcpy(response, resp.data.asBytes, *response_len);
+    topaz_readall_resp_t *r = (topaz_readall_resp_t *)resp.data.asBytes;
+    do {
+        if (WaitForResponseTimeout(CMD_HF_TOPAZ_READALL, &resp, 2500) == false) {
+            if (verbose) PrintAndLogEx(WARNING, "timeout while waiting for reply.");
+            return PM3_ETIMEOUT;
         }
-    } else {
-        if (verbose) PrintAndLogEx(WARNING, "Wrong response length (%d != %" PRIu64 ")", *response_len, resp.oldarg[0]);
-        return PM3_ESOFT;
-    }
-    return PM3_SUCCESS;
-}
-
-// calculate CRC bytes and send topaz command, returns the length of the response (0 in case of error)
-static int topaz_send_cmd(uint8_t *cmd, uint8_t len, uint8_t *response, uint16_t *response_len, bool verbose) {
-    if (len > 1) {
-        uint8_t b1, b2;
-        compute_crc(CRC_14443_B, cmd, len - 2, &b1, &b2);
-        cmd[len - 2] = b1;
-        cmd[len - 1] = b2;
-    }
-
-    return topaz_send_cmd_raw(cmd, len, response, response_len, verbose);
-}
-
-// select a topaz tag. Send WUPA and RID.
-static int topaz_select(uint8_t *atqa, uint8_t atqa_len, uint8_t *rid_response,  uint8_t rid_len, bool verbose) {
-    // ToDo: implement anticollision
-
-    uint16_t resp_len;
-    uint8_t wupa_cmd[] = {TOPAZ_WUPA};
-    uint8_t rid_cmd[] = {TOPAZ_RID, 0, 0, 0, 0, 0, 0, 0, 0};
-
-    topaz_switch_on_field();
-
-    resp_len = atqa_len;
-    int status = topaz_send_cmd(wupa_cmd, sizeof(wupa_cmd), atqa, &resp_len, verbose);
-    if (status == PM3_ETIMEOUT || status == PM3_ESOFT) {
-        topaz_switch_off_field();
-        return PM3_ESOFT; // WUPA failed
-    }
-
-    resp_len = rid_len;
-    status = topaz_send_cmd(rid_cmd, sizeof(rid_cmd), rid_response, &resp_len, verbose);
-    if (status == PM3_ETIMEOUT || status == PM3_ESOFT) {
-        topaz_switch_off_field();
-        return PM3_EWRONGANSWER; // RID failed
-    }
-
-    return PM3_SUCCESS;
-}
-
-// read all of the static memory of a selected Topaz tag.
-static int topaz_rall(uint8_t *uid, uint8_t *response) {
-    uint16_t resp_len = 0;
-    uint8_t rall_cmd[] = {TOPAZ_RALL, 0, 0, 0, 0, 0, 0, 0, 0};
-    memcpy(&rall_cmd[3], uid, 4);
-
-    if (topaz_send_cmd(rall_cmd, sizeof(rall_cmd), response, &resp_len, true) == PM3_ETIMEOUT) {
-        topaz_switch_off_field();
-        return PM3_ESOFT; // RALL failed
-    }
-
-    return PM3_SUCCESS;
-}
-
-// read a block (8 Bytes) of a selected Topaz tag.
-static int topaz_read_block(uint8_t *uid, uint8_t blockno, uint8_t *block_data) {
-    uint16_t resp_len = 0;
-    uint8_t read8_cmd[] = {TOPAZ_READ8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-    uint8_t read8_response[11];
-
-    read8_cmd[1] = blockno;
-    memcpy(&read8_cmd[10], uid, 4);
-
-    if (topaz_send_cmd(read8_cmd, sizeof(read8_cmd), read8_response, &resp_len, true) == PM3_ETIMEOUT) {
-        topaz_switch_off_field();
-        return PM3_ESOFT; // READ8 failed
-    }
-    memcpy(block_data, &read8_response[1], 8);
-    return PM3_SUCCESS;
-}
-
-// read a segment (16 blocks = 128 Bytes) of a selected Topaz tag. Works only for tags with dynamic memory.
-static int topaz_read_segment(uint8_t *uid, uint8_t segno, uint8_t *segment_data) {
-    uint16_t resp_len = 0;
-    uint8_t rseg_cmd[] = {TOPAZ_RSEG, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-    uint8_t rseg_response[131];
-
-    rseg_cmd[1] = segno << 4;
-    memcpy(&rseg_cmd[10], uid, 4);
-
-    if (topaz_send_cmd(rseg_cmd, sizeof(rseg_cmd), rseg_response, &resp_len, true) == PM3_ETIMEOUT) {
-        topaz_switch_off_field();
-        return PM3_ESOFT; // RSEG failed
-    }
-    memcpy(segment_data, &rseg_response[1], 128);
+        if (resp.status != PM3_SUCCESS && resp.status != PM3_EPARTIAL && resp.status != PM3_ECARDEXCHANGE)
+            return resp.status;
+        if (r->offset + r->len <= sizeof(mem))
+            memcpy(mem + r->offset, r->data, r->len);
+    } while (resp.status == PM3_EPARTIAL);
+
+    if (r->size < TOPAZ_STATIC_MEMORY)
+        return PM3_ECARDEXCHANGE;
+
+    memcpy(hr, r->hr, 2);
+    memcpy(topaz_tag.data_blocks, mem, TOPAZ_STATIC_MEMORY);
+    memcpy(topaz_tag.dynamic_memory, mem + TOPAZ_STATIC_MEMORY, sizeof(topaz_tag.dynamic_memory));
+    topaz_tag.size = MIN(r->size, TOPAZ_MAX_MEMORY);
+
+    if (resp.status == PM3_ECARDEXCHANGE)
+        PrintAndLogEx(WARNING, "Tag stopped answering, only " _YELLOW_("%u") " bytes read", topaz_tag.size);
     return PM3_SUCCESS;
 }
 
@@ -209,7 +124,6 @@ static bool topaz_byte_is_locked(uint16_t byteno) {
 // read and print the Capability Container
 static int topaz_print_CC(uint8_t *data) {
     if (data[0] != 0xe1) {
-        topaz_tag.size = TOPAZ_STATIC_MEMORY;
         return PM3_ESOFT; // no NDEF message
     }
 
@@ -217,8 +131,6 @@ static int topaz_print_CC(uint8_t *data) {
     PrintAndLogEx(SUCCESS, "  %02x: NDEF Magic Number", data[0]);
     PrintAndLogEx(SUCCESS, "  %02x: version %d.%d supported by tag", data[1], (data[1] & 0xF0) >> 4, data[1] & 0x0f);
     uint16_t memsize = (data[2] + 1) * 8;
-    topaz_tag.size = memsize;
-    topaz_tag.dynamic_memory = calloc(memsize - TOPAZ_STATIC_MEMORY, sizeof(uint8_t));
     PrintAndLogEx(SUCCESS, "  %02x: Physical Memory Size of this tag: %d bytes", data[2], memsize);
     PrintAndLogEx(SUCCESS, "  %02x: %s / %s", data[3],
                   (data[3] & 0xF0) ? "(RFU)" : "Read access granted without any security",
@@ -343,43 +255,22 @@ static void topaz_print_control_TLVs(uint8_t *memory) {
     }
 }
 
-// read all of the dynamic memory
-static int topaz_read_dynamic_data(void) {
-    // first read the remaining block of segment 0
-    if (topaz_read_block(topaz_tag.uid, 0x0F, &topaz_tag.dynamic_memory[0]) == PM3_ESOFT) {
-        PrintAndLogEx(ERR, "Error while reading dynamic memory block " _YELLOW_("%02x") ". Aborting...", 0x0F);
-        return PM3_ESOFT;
-    }
-
-    // read the remaining segments
-    uint8_t max_segment = topaz_tag.size / 128 - 1;
-    for (uint8_t segment = 1; segment <= max_segment; segment++) {
-        if (topaz_read_segment(topaz_tag.uid, segment, &topaz_tag.dynamic_memory[(segment - 1) * 128 + 8]) == PM3_ESOFT) {
-            PrintAndLogEx(ERR, "Error while reading dynamic memory block " _YELLOW_("%02x") ". Aborting...", segment);
-            return PM3_ESOFT;
-        }
-    }
-    return PM3_SUCCESS;
-}
-
-// read and print the dynamic memory
+// print the dynamic memory
 static void topaz_print_dynamic_data(void) {
     if (topaz_tag.size > TOPAZ_STATIC_MEMORY) {
         PrintAndLogEx(SUCCESS, "Dynamic Data blocks:");
-        if (topaz_read_dynamic_data() == 0) {
-            PrintAndLogEx(NORMAL, "block# | offset | Data                    | Locked(y/n)");
-            PrintAndLogEx(NORMAL, "-------+--------+-------------------------+------------");
-            char line[80];
-            for (uint16_t blockno = 0x0F; blockno < topaz_tag.size / 8; blockno++) {
-                uint8_t *block_data = &topaz_tag.dynamic_memory[(blockno - 0x0F) * 8];
-                char lockbits[9];
-                for (uint16_t j = 0; j < 8; j++) {
-                    sprintf(&line[3 * j], "%02x ", block_data[j]);
-                    lockbits[j] = topaz_byte_is_locked(blockno * 8 + j) ? 'y' : 'n';
-                }
-                lockbits[8] = '\0';
-                PrintAndLogEx(NORMAL, "  0x%02x | 0x%04x   | %s|   %-3s", blockno, blockno * 8, line, lockbits);
+        PrintAndLogEx(NORMAL, "block# | offset | Data                    | Locked(y/n)");
+        PrintAndLogEx(NORMAL, "-------+--------+-------------------------+------------");
+        char line[80];
+        for (uint16_t blockno = 0x0F; blockno < topaz_tag.size / 8; blockno++) {
+            uint8_t *block_data = &topaz_tag.dynamic_memory[(blockno - 0x0F) * 8];
+            char lockbits[9];
+            for (uint16_t j = 0; j < 8; j++) {
+                sprintf(&line[3 * j], "%02x ", block_data[j]);
+                lockbits[j] = topaz_byte_is_locked(blockno * 8 + j) ? 'y' : 'n';
             }
+            lockbits[8] = '\0';
+            PrintAndLogEx(NORMAL, "  0x%02x | 0x%04x   | %s|   %-3s", blockno, blockno * 8, line, lockbits);
         }
     }
 }
@@ -512,38 +403,19 @@ int CmdHFTopaz(const char *Cmd) {
 
 int readTopazUid(bool verbose) {
 
-    uint8_t atqa[2];
-    uint8_t rid_response[8];
-    uint8_t *uid_echo = &rid_response[2];
-    uint8_t rall_response[124];
+    uint8_t rid_response[2];
 
-    int status = topaz_select(atqa, sizeof(atqa), rid_response, sizeof(rid_response), verbose);
+    int status = topaz_read_all(rid_response, verbose);
     if (status == PM3_ESOFT) {
-        if (verbose) PrintAndLogEx(ERR, "Error: couldn't receive ATQA");
+        if (verbose) PrintAndLogEx(ERR, "Error: couldn't select a Topaz tag");
         return PM3_ESOFT;
     }
-
-    if (atqa[1] != 0x0c && atqa[0] != 0x00) {
-        if (verbose) PrintAndLogEx(ERR, "Tag doesn't support the Topaz protocol.");
-        topaz_switch_off_field();
+    if (status != PM3_SUCCESS) {
+        if (verbose) PrintAndLogEx(ERR, "Error: tag didn't answer to RALL");
         return PM3_ESOFT;
     }
 
-    if (status == PM3_EWRONGANSWER) {
-        if (verbose) PrintAndLogEx(ERR, "Error: tag didn't answer to RID");
-        topaz_switch_off_field();
-        return PM3_ESOFT;
-    }
-
-    status = topaz_rall(uid_echo, rall_response);
-    if (status == PM3_ESOFT) {
-        PrintAndLogEx(ERR, "Error: tag didn't answer to RALL");
-        topaz_switch_off_field();
-        return PM3_ESOFT;
-    }
-
-    memcpy(topaz_tag.uid, rall_response + 2, 7);
-    memcpy(topaz_tag.data_blocks, rall_response + 2, 0x0f * 8);
+    memcpy(topaz_tag.uid, topaz_tag.data_blocks[0], 7);
 
     // printing
     PrintAndLogEx(NORMAL, "");
@@ -563,8 +435,6 @@ int readTopazUid(bool verbose) {
                   getTagInfo(topaz_tag.uid[6])
                  );
 
-    PrintAndLogEx(SUCCESS, " ATQA: %02x %02x", atqa[1], atqa[0]);
-
     topaz_tag.HR01[0] = rid_response[0];
     topaz_tag.HR01[1] = rid_response[1];
 
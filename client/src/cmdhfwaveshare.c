@@ -180,25 +180,27 @@ static void rgb_to_gray(int16_t *chanR, int16_t *chanG, int16_t *chanB, uint16_t
 }
 
 // Floyd-Steinberg dithering
+// error diffusion goes pixel by pixel, so it stays a scalar loop, in integers on two rows
 static void dither_chan_inplace(int16_t *chan, uint16_t width, uint16_t height) {
     for (uint16_t Y=0; Y<height; Y++) {
+        int16_t *row = chan + Y * width;
+        int16_t *next = (Y < height - 1) ? row + width : NULL;
         for (uint16_t X=0; X<width; X++) {
-            int16_t oldp = chan[X + Y * width];
+            int16_t oldp = row[X];
             int16_t newp = oldp > 127 ? 255 : 0;
-            chan[X + Y * width] = newp;
-            int16_t err = oldp - newp;
-            float m[] = {7,3,5,1};
-            if (X < width - 1){
-                chan[X + 1 +  Y      * width] = chan[X + 1 +  Y      * width] + m[0]/16 * err;
+            row[X] = newp;
+            int32_t err = oldp - newp;
+            if (X < width - 1) {
+                row[X + 1] += err * 7 / 16;
             }
-            if (Y < height - 1) {
-                chan[X - 1 + (Y + 1) * width] = chan[X - 1 + (Y + 1) * width] + m[1]/16 * err;
-            }
-            if (Y < height - 1){
-                chan[X     + (Y + 1) * width] = chan[X     + (Y + 1) * width] + m[2]/16 * err;
-            }
-            if ((X < width - 1) && (Y < height - 1)){
-                chan[X + 1 + (Y + 1) * width] = chan[X + 1 + (Y + 1) * width] + m[3]/16 * err;
+            if (next) {
+                if (X > 0) {
+                    next[X - 1] += err * 3 / 16;
+                }
+                next[X] += err * 5 / 16;
+                if (X < width - 1) {
+                    next[X + 1] += err / 16;
+                }
             }
         }
     }
@@ -536,22 +538,6 @@ static int read_bmp_rgb(uint8_t *bmp, const size_t bmpsize, uint8_t model_nr, ui
     return PM3_SUCCESS;
 }
 
-static void read_black(uint32_t i, uint8_t *l, uint8_t model_nr, uint8_t *black) {
-    for (uint8_t j = 0; j < models[model_nr].len; j++) {
-        l[3 + j] = black[i * models[model_nr].len + j];
-    }
-}
-static void read_red(uint32_t i, uint8_t *l, uint8_t model_nr, uint8_t *red) {
-    for (uint8_t j = 0; j < models[model_nr].len; j++) {
-        if (model_nr == M1in54B) {
-            //1.54B needs to flip the red picture data, other screens do not need to flip data
-            l[3 + j] = ~red[i * models[model_nr].len + j];
-        } else {
-            l[3 + j] = red[i * models[model_nr].len + j];
-        }
-    }
-}
-
 static int transceive_blocking( uint8_t* txBuf, uint16_t txBufLen, uint8_t* rxBuf, uint16_t rxBufLen, uint16_t* actLen, bool retransmit ){
     uint8_t fail_num = 0;
     if (rxBufLen < 2) {
@@ -589,30 +575,59 @@ static int transceive_blocking( uint8_t* txBuf, uint16_t txBufLen, uint8_t* rxBu
     return PM3_SUCCESS;
 }
 
+// Sends frames of len bytes from data as `cd <cmd> <len> ..`, the device sends as many of them as fit in one
+// command to the tag. invert flips the bits, delay is the time in ms after every frame.
+// progress goes from base to base + span
+static int upload_blocking(uint8_t cmd, uint8_t len, const uint8_t *data, uint16_t frames, bool invert, uint8_t delay, uint8_t base, uint8_t span) {
+    wshare_upload_req_t req;
+    uint16_t per_cmd = sizeof(req.data) / len;
+
+    for (uint16_t i = 0; i < frames; i += per_cmd) {
+        uint16_t n = MIN(per_cmd, frames - i);
+        req.cmd = cmd;
+        req.len = len;
+        req.count = n;
+        req.delay = delay;
+        memcpy(req.data, data + i * len, n * len);
+        if (invert) {
+            for (uint16_t j = 0; j < n * len; j++) {
+                req.data[j] = ~req.data[j];
+            }
+        }
+
+        clearCommandBuffer();
+        SendCommandNG(CMD_HF_WAVESHARE_UPLOAD, (uint8_t *)&req, 4 + n * len);
+        PacketResponseNG resp;
+        if (!WaitForResponseTimeout(CMD_HF_WAVESHARE_UPLOAD, &resp, 2000 + n * (delay + 100))) {
+            PROMPT_CLEARLINE;
+            PrintAndLogEx(WARNING, "command execution time out");
+            DropField();
+            return PM3_ETIMEOUT;
+        }
+        if (resp.status != PM3_SUCCESS) {
+            PROMPT_CLEARLINE;
+            PrintAndLogEx(WARNING, "Transmission failed, please try again.");
+            DropField();
+            return PM3_ESOFT;
+        }
+        PrintAndLogEx(INPLACE, "Progress: %d %%", base + (i + n) * span / frames);
+    }
+    return PM3_SUCCESS;
+}
+
 // 1.54B Keychain
 // 1.54B does not share the common base and requires specific handling
 static int start_drawing_1in54B(uint8_t model_nr, uint8_t *black, uint8_t *red) {
     int ret;
-    uint8_t step_5[128] = {0xcd, 0x05, 100};
     uint8_t step_4[2] = {0xcd, 0x04};
     uint8_t step_6[2] = {0xcd, 0x06};
     uint8_t rx[20] = {0};
-    uint16_t actrxlen[20], i = 0, progress = 0;
+    uint16_t actrxlen[20];
 
-    if (model_nr == M1in54B) {
-        step_5[2] = 100;
-    }
     PrintAndLogEx(DEBUG, "1.54_Step9: e-paper config2 (black)");
-    if (model_nr == M1in54B) {      //1.54inch B Keychain
-        for (i = 0; i < 50; i++) {
-            read_black(i, step_5, model_nr, black);
-            ret = transceive_blocking(step_5, 103, rx, 20, actrxlen, true); // cd 05
-            if (ret != PM3_SUCCESS) {
-                return ret;
-            }
-            progress = i * 100 / 100;
-            PrintAndLogEx(INPLACE, "Progress: %d %%", progress);
-        }
+    ret = upload_blocking(0x05, models[model_nr].len, black, 50, false, 0, 0, 50); // cd 05
+    if (ret != PM3_SUCCESS) {
+        return ret;
     }
     PROMPT_CLEARLINE;
     PrintAndLogEx(DEBUG, "1.54_Step6: e-paper power on");
@@ -621,16 +636,10 @@ static int start_drawing_1in54B(uint8_t model_nr, uint8_t *black, uint8_t *red)
         return ret;
     }
     PrintAndLogEx(DEBUG, "1.54_Step7: e-paper config2 (red)");
-    if (model_nr == M1in54B) {       //1.54inch B Keychain
-        for (i = 0; i < 50; i++) {
-            read_red(i, step_5, model_nr, red);
-            ret = transceive_blocking(step_5, 103, rx, 20, actrxlen, true); // cd 05
-            if (ret != PM3_SUCCESS) {
-                return ret;
-            }
-            progress = i * 100 / 100 + 50;
-            PrintAndLogEx(INPLACE, "Progress: %d %%", progress);
-        }
+    //1.54B needs to flip the red picture data, other screens do not need to flip data
+    ret = upload_blocking(0x05, models[model_nr].len, red, 50, true, 0, 50, 50); // cd 05
+    if (ret != PM3_SUCCESS) {
+        return ret;
     }
     PROMPT_CLEARLINE;
     // Send update instructions
@@ -644,7 +653,6 @@ static int start_drawing_1in54B(uint8_t model_nr, uint8_t *black, uint8_t *red)
 }
 
 static int start_drawing(uint8_t model_nr, uint8_t *black, uint8_t *red) {
-    uint8_t progress = 0;
     uint8_t step0[2] = {0xcd, 0x0d};
     uint8_t step1[3] = {0xcd, 0x00, 10};    //select e-paper type and reset e-paper        4:2.13inch e-Paper   7:2.9inch e-Paper  10:4.2inch e-Paper  14:7.5inch e-Paper
     uint8_t step2[2] = {0xcd, 0x01};      //e-paper normal mode  type：
@@ -662,7 +670,7 @@ static int start_drawing(uint8_t model_nr, uint8_t *black, uint8_t *red) {
 // uint8_t step13[2]={0xcd,0x0b};     //Judge whether the power supply is turned off successfully
 // uint8_t step14[2]={0xcd,0x0c};     //The end of the transmission
     uint8_t rx[20];
-    uint16_t actrxlen[20], i = 0;
+    uint16_t actrxlen[20];
 
 
 
@@ -792,85 +800,31 @@ static int start_drawing(uint8_t model_nr, uint8_t *black, uint8_t *red) {
             return ret;
         }
         PrintAndLogEx(DEBUG, "Step8: Start data transfer");
+        // the device sends several cd 08 frames per command
         if (model_nr == M2in13) {      //2.13inch
-            for (i = 0; i < 250; i++) {
-                read_black(i, step8, model_nr, black);
-                ret = transceive_blocking(step8, 19, rx, 20, actrxlen, true); // cd 08
-                if (ret != PM3_SUCCESS) {
-                    return ret;
-                }
-                progress = i * 100 / 250;
-                PrintAndLogEx(INPLACE, "Progress: %d %%", progress);
-            }
+            ret = upload_blocking(0x08, step8[2], black, 250, false, 0, 0, 100);
         } else if (model_nr == M2in9) {
-            for (i = 0; i < 296; i++) {
-                read_black(i, step8, model_nr, black);
-                ret = transceive_blocking(step8, 19, rx, 20, actrxlen, true); // cd 08
-                if (ret != PM3_SUCCESS) {
-                    return ret;
-                }
-                progress = i * 100 / 296;
-                PrintAndLogEx(INPLACE, "Progress: %d %%", progress);
-            }
+            ret = upload_blocking(0x08, step8[2], black, 296, false, 0, 0, 100);
         } else if (model_nr == M4in2) {    //4.2inch
-            for (i = 0; i < 150; i++) {
-                read_black(i, step8, model_nr, black);
-                ret = transceive_blocking(step8, 103, rx, 20, actrxlen, true); // cd 08
-                if (ret != PM3_SUCCESS) {
-                    return ret;
-                }
-                progress = i * 100 / 150;
-                PrintAndLogEx(INPLACE, "Progress: %d %%", progress);
-            }
+            ret = upload_blocking(0x08, step8[2], black, 150, false, 0, 0, 100);
         } else if (model_nr == M7in5) {  //7.5inch
-            for (i = 0; i < 400; i++) {
-                read_black(i, step8, model_nr, black);
-                ret = transceive_blocking(step8, 123, rx, 20, actrxlen, true); // cd 08
-                if (ret != PM3_SUCCESS) {
-                    return ret;
-                }
-                progress = i * 100 / 400;
-                PrintAndLogEx(INPLACE, "Progress: %d %%", progress);
-                msleep(6);
-            }
+            ret = upload_blocking(0x08, step8[2], black, 400, false, 6, 0, 100);
         } else if (model_nr == M2in13B) {  //2.13inch B
-            for (i = 0; i < 26; i++) {
-                read_black(i, step8, model_nr, black);
-                ret = transceive_blocking(step8, 109, rx, 20, actrxlen, true); // cd 08
-                if (ret != PM3_SUCCESS) {
-                    return ret;
-                }
-                progress = i * 50 / 26;
-                PrintAndLogEx(INPLACE, "Progress: %d %%", progress);
-            }
+            ret = upload_blocking(0x08, step8[2], black, 26, false, 0, 0, 50);
         } else if (model_nr == M7in5HD) {  //7.5HD
-
-            for (i = 0; i < 484; i++) {
-                read_black(i, step8, model_nr, black);
-                //memset(&step8[3], 0xf0, 120);
-                ret = transceive_blocking(step8, 123, rx, 20, actrxlen, true); // cd 08
-                if (ret != PM3_SUCCESS) {
-                    return ret;
-                }
-                progress = i * 100 / 484;
-                PrintAndLogEx(INPLACE, "Progress: %d %%", progress);
-            }
-            memset(&step8[3], 0xff, 120);
-            ret = transceive_blocking(step8, 110 + 3, rx, 20, actrxlen, true); // cd 08
-            if (ret != PM3_SUCCESS) {
-                return ret;
+            ret = upload_blocking(0x08, step8[2], black, 484, false, 0, 0, 100);
+            if (ret == PM3_SUCCESS) {
+                memset(&step8[3], 0xff, 120);
+                ret = transceive_blocking(step8, 110 + 3, rx, 20, actrxlen, true); // cd 08
             }
         } else if (model_nr == M2in7) {   //2.7inch
-            for (i = 0; i < 48; i++) {
-                //read_black(i,step8, model_nr, black);
-                memset(&step8[3], 0xFF, sizeof(step8)-3);
-                ret = transceive_blocking(step8, 124, rx, 20, actrxlen, true); // cd 08
-                if (ret != PM3_SUCCESS) {
-                    return ret;
-                }
-                progress = i * 50 / 48;
-                PrintAndLogEx(INPLACE, "Progress: %d %%", progress);
-            }
+            // blank data first, the image goes with cd 19
+            uint8_t blank[48 * 121];
+            memset(blank, 0xFF, sizeof(blank));
+            ret = upload_blocking(0x08, step8[2], blank, 48, false, 0, 0, 50);
+        }
+        if (ret != PM3_SUCCESS) {
+            return ret;
         }
         PROMPT_CLEARLINE;
         PrintAndLogEx(DEBUG, "Step9: e-paper power on");
@@ -887,26 +841,12 @@ static int start_drawing(uint8_t model_nr, uint8_t *black, uint8_t *red) {
             }
             PrintAndLogEx(DEBUG, "Step9b");
             if (model_nr == M2in7) {
-                for (i = 0; i < 48; i++) {
-                    read_black(i, step13, model_nr, black);
-                    ret = transceive_blocking(step13, 124, rx, 20, actrxlen, true); //CD 19
-                    if (ret != PM3_SUCCESS) {
-                        return ret;
-                    }
-                    progress = i * 50 / 48 + 50;
-                    PrintAndLogEx(INPLACE, "Progress: %d %%", progress);
-                }
+                ret = upload_blocking(0x19, step13[2], black, 48, false, 0, 50, 50); //CD 19
             } else if (model_nr == M2in13B) {
-                for (i = 0; i < 26; i++) {
-                    read_red(i, step13, model_nr, red);
-                    //memset(&step13[3], 0xfE, 106);
-                    ret = transceive_blocking(step13, 109, rx, 20, actrxlen, true);
-                    if (ret != PM3_SUCCESS) {
-                        return ret;
-                    }
-                    progress = i * 50 / 26 + 50;
-                    PrintAndLogEx(INPLACE, "Progress: %d %%", progress);
-                }
+                ret = upload_blocking(0x19, step13[2], red, 26, false, 0, 50, 50);
+            }
+            if (ret != PM3_SUCCESS) {
+                return ret;
             }
             PROMPT_CLEARLINE;
         }
@@ -13,6 +13,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <inttypes.h>
 
 #include "cmdparser.h"    // command_t
 #include "comms.h"
@@ -21,6 +22,8 @@
 #include "cmdhw.h"
 #include "cmddata.h"
 #include "commonutil.h"
+#include "perf.h"
+#include "util.h"        // FILE_PATH_SIZE
 
 static int CmdHelp(const char *Cmd);
 
@@ -67,6 +70,53 @@ static int usage_hw_setmux(void) {
     return PM3_SUCCESS;
 }
 
+static int usage_hw_perf(void) {
+    PrintAndLogEx(NORMAL, "Client side telemetry, opt-in. Per command round trip, time waiting for the device,");
+    PrintAndLogEx(NORMAL, "host compute, bytes moved and the device time estimated from the firmware counters");
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(NORMAL, "Usage:  hw perf [h] [on|off] [reset] [v] [j <file>]");
+    PrintAndLogEx(NORMAL, "Options:");
+    PrintAndLogEx(NORMAL, "       h          This help");
+    PrintAndLogEx(NORMAL, "       on|off     Start / stop recording, starting clears the numbers");
+    PrintAndLogEx(NORMAL, "       reset      Clear the numbers");
+    PrintAndLogEx(NORMAL, "       v          Print the histograms too");
+    PrintAndLogEx(NORMAL, "       j <file>   Save everything as JSON, with the client and firmware versions");
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(NORMAL, "Examples:");
+    PrintAndLogEx(NORMAL, _YELLOW_("      hw perf on"));
+    PrintAndLogEx(NORMAL, _YELLOW_("      hw perf v"));
+    PrintAndLogEx(NORMAL, _YELLOW_("      hw perf j perf.json"));
+    return PM3_SUCCESS;
+}
+
+static int usage_hw_fpgabench(void) {
+    PrintAndLogEx(NORMAL, "Time the FPGA bitstream load: decompressing the image alone, then a full");
+    PrintAndLogEx(NORMAL, "reconfiguration of the FPGA as on boot. Clears the device BigBuf, trace included");
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(NORMAL, "Usage:  hw fpgabench [h]");
+    PrintAndLogEx(NORMAL, "Options:");
+    PrintAndLogEx(NORMAL, "       h          This help");
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(NORMAL, "Examples:");
+    PrintAndLogEx(NORMAL, _YELLOW_("      hw fpgabench"));
+    return PM3_SUCCESS;
+}
+
+static int usage_hw_profile(void) {
+    PrintAndLogEx(NORMAL, "Show the device side profiling counters: time spent per command handler,");
+    PrintAndLogEx(NORMAL, "sniffer DMA overruns, USB write stalls, BigBuf and stack high water marks");
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(NORMAL, "Usage:  hw profile [h] [r]");
+    PrintAndLogEx(NORMAL, "Options:");
+    PrintAndLogEx(NORMAL, "       h          This help");
+    PrintAndLogEx(NORMAL, "       r          Reset the counters after reading them");
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(NORMAL, "Examples:");
+    PrintAndLogEx(NORMAL, _YELLOW_("      hw profile"));
+    PrintAndLogEx(NORMAL, _YELLOW_("      hw profile r"));
+    return PM3_SUCCESS;
+}
+
 static int usage_hw_connect(void) {
     PrintAndLogEx(NORMAL, "Connects to a Proxmark3 device via specified serial port");
     PrintAndLogEx(NORMAL, "Baudrate here is only for physical UART or UART-BT, " _YELLOW_("not")" for USB-CDC or blue shark add-on");
@@ -515,6 +565,135 @@ static int CmdStatus(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+static int profile_cmp(const void *a, const void *b) {
+    const profile_cmd_t *pa = a, *pb = b;
+    if (pa->total_us == pb->total_us) return 0;
+    return (pa->total_us < pb->total_us) ? 1 : -1;
+}
+
+static int CmdFPGABench(const char *Cmd) {
+    char ctmp = tolower(param_getchar(Cmd, 0));
+    if (ctmp == 'h') return usage_hw_fpgabench();
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_FPGA_BENCH, NULL, 0);
+    PacketResponseNG resp;
+    if (WaitForResponseTimeout(CMD_FPGA_BENCH, &resp, 5000) == false) {
+        PrintAndLogEx(WARNING, "timeout while waiting for reply.");
+        return PM3_ETIMEOUT;
+    }
+    if (resp.length != sizeof(fpga_bench_t)) {
+        PrintAndLogEx(FAILED, "firmware does not support the benchmark, or it is out of date");
+        return PM3_ESOFT;
+    }
+
+    fpga_bench_t *b = (fpga_bench_t *)resp.data.asBytes;
+    if (resp.status == PM3_ESOFT) {
+        PrintAndLogEx(FAILED, "bitstream decompression failed after " _YELLOW_("%u") " bytes", b->bytes);
+        return PM3_ESOFT;
+    }
+
+    PrintAndLogEx(INFO, "bitstream......... %u bytes", b->bytes);
+    PrintAndLogEx(INFO, "decompress........ %u ms", b->decode_ms);
+    PrintAndLogEx(INFO, "full load......... %u ms, %u kB/s", b->load_ms, b->load_ms ? b->bytes / b->load_ms : 0);
+    PrintAndLogEx(INFO, "clocking in....... ~%u ms", (b->load_ms > b->decode_ms) ? b->load_ms - b->decode_ms : 0);
+    if (resp.status != PM3_SUCCESS) {
+        PrintAndLogEx(FAILED, "FPGA did not signal " _RED_("DONE") " after the load");
+        return resp.status;
+    }
+    return PM3_SUCCESS;
+}
+
+static int CmdProfile(const char *Cmd) {
+    char ctmp = tolower(param_getchar(Cmd, 0));
+    if (ctmp == 'h') return usage_hw_profile();
+
+    uint8_t reset = (ctmp == 'r');
+    clearCommandBuffer();
+    SendCommandNG(CMD_PROFILE, &reset, sizeof(reset));
+    PacketResponseNG resp;
+    if (WaitForResponseTimeout(CMD_PROFILE, &resp, 2000) == false) {
+        PrintAndLogEx(WARNING, "timeout while waiting for reply.");
+        return PM3_ETIMEOUT;
+    }
+    if (resp.status != PM3_SUCCESS || resp.length != sizeof(profile_t)) {
+        PrintAndLogEx(FAILED, "firmware does not support profiling, or it is out of date");
+        return PM3_ESOFT;
+    }
+
+    profile_t *p = (profile_t *)resp.data.asBytes;
+    PrintAndLogEx(INFO, "uptime............ %u.%03u s", p->uptime_ms / 1000, p->uptime_ms % 1000);
+    if (p->dma_overruns)
+        PrintAndLogEx(WARNING, "DMA overruns...... " _RED_("%u"), p->dma_overruns);
+    else
+        PrintAndLogEx(INFO, "DMA overruns...... 0");
+    PrintAndLogEx(INFO, "USB write stalls.. %u", p->usb_tx_stalls);
+    PrintAndLogEx(INFO, "BigBuf............ %u used, %u peak of %u bytes", p->bigbuf_used, p->bigbuf_peak, p->bigbuf_size);
+    PrintAndLogEx(INFO, "stack............. %u used of %u bytes", p->stack_used, p->stack_size);
+
+    uint8_t count = MIN(p->count, PROFILE_MAX_CMDS);
+    if (count == 0) {
+        PrintAndLogEx(INFO, "no command handlers timed yet");
+        return PM3_SUCCESS;
+    }
+    qsort(p->cmds, count, sizeof(profile_cmd_t), profile_cmp);
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, " cmd    |     calls |   total ms |     max us |     avg us");
+    PrintAndLogEx(INFO, "--------+-----------+------------+------------+-----------");
+    for (uint8_t i = 0; i < count; i++) {
+        profile_cmd_t *c = &p->cmds[i];
+        PrintAndLogEx(INFO, " 0x%04x | %9u | %10" PRIu64 " | %10u | %10" PRIu64,
+                      c->cmd, c->calls, c->total_us / 1000, c->max_us,
+                      c->calls ? c->total_us / c->calls : 0);
+    }
+    if (reset) PrintAndLogEx(INFO, "counters reset");
+    return PM3_SUCCESS;
+}
+
+static int CmdPerf(const char *Cmd) {
+    bool histograms = false;
+    bool show = true;
+    char filename[FILE_PATH_SIZE] = {0};
+    char arg[FILE_PATH_SIZE] = {0};
+
+    for (int cmdp = 0; param_getchar(Cmd, cmdp) != 0x00; cmdp++) {
+        param_getstr(Cmd, cmdp, arg, sizeof(arg));
+        str_lower(arg);
+        if (strcmp(arg, "h") == 0) {
+            return usage_hw_perf();
+        } else if (strcmp(arg, "on") == 0) {
+            perf_enable(true);
+            PrintAndLogEx(SUCCESS, "client telemetry " _GREEN_("on"));
+            show = false;
+        } else if (strcmp(arg, "off") == 0) {
+            perf_enable(false);
+            PrintAndLogEx(SUCCESS, "client telemetry " _YELLOW_("off"));
+            show = false;
+        } else if (strcmp(arg, "reset") == 0) {
+            perf_reset();
+            PrintAndLogEx(SUCCESS, "client telemetry cleared");
+            show = false;
+        } else if (strcmp(arg, "v") == 0) {
+            histograms = true;
+        } else if (strcmp(arg, "j") == 0) {
+            if (param_getstr(Cmd, ++cmdp, filename, sizeof(filename)) == 0)
+                return usage_hw_perf();
+            show = false;
+        } else {
+            PrintAndLogEx(WARNING, "Unknown parameter '%s'", arg);
+            return usage_hw_perf();
+        }
+    }
+
+    if (filename[0])
+        return perf_save_json(filename);
+
+    if (show || histograms)
+        perf_print(histograms);
+    return PM3_SUCCESS;
+}
+
 static int CmdTia(const char *Cmd) {
     (void)Cmd; // Cmd is not used so far
     PrintAndLogEx(INFO, "Triggering new Timing Interval Acquisition (TIA)...");
@@ -611,10 +790,13 @@ static command_t CommandTable[] = {
     {"connect",       CmdConnect,      AlwaysAvailable, "connect Proxmark3 to serial port"},
     {"dbg",           CmdDbg,          IfPm3Present,    "Set Proxmark3 debug level"},
     {"detectreader",  CmdDetectReader, IfPm3Present,    "['l'|'h'] -- Detect external reader field (option 'l' or 'h' to limit to LF or HF)"},
+    {"fpgabench",     CmdFPGABench,    IfPm3Present,    "Time the FPGA bitstream decompression and load"},
     {"fpgaoff",       CmdFPGAOff,      IfPm3Present,    "Set FPGA off"},
     {"lcd",           CmdLCD,          IfPm3Lcd,        "<HEX command> <count> -- Send command/data to LCD"},
     {"lcdreset",      CmdLCDReset,     IfPm3Lcd,        "Hardware reset LCD"},
+    {"perf",          CmdPerf,         AlwaysAvailable, "[on|off] [reset] [v] [j <file>] -- Client side command latency histograms"},
     {"ping",          CmdPing,         IfPm3Present,    "Test if the Proxmark3 is responsive"},
+    {"profile",       CmdProfile,      IfPm3Present,    "[r] -- Show the device side profiling counters, optionally reset them"},
     {"readmem",       CmdReadmem,      IfPm3Present,    "[address] -- Read memory at decimal address from flash"},
     {"reset",         CmdReset,        IfPm3Present,    "Reset the Proxmark3"},
     {"setlfdivisor",  CmdSetDivisor,   IfPm3Present,    "<19 - 255> -- Drive LF antenna at 12MHz/(divisor+1)"},
@@ -22,6 +22,9 @@
 #include "cmdparser.h"    // command_t
 #include "comms.h"
 #include "commonutil.h"  // ARRAYLEN
+#include "fileutils.h"   // newfilenamemcopy
+#include "util_posix.h"  // msclock
+#include "jansson.h"
 
 #include "lfdemod.h"        // device/client demods of LF signals
 #include "ui.h"             // for show graph controls
@@ -91,17 +94,28 @@ static int usage_lf_cmdread(void) {
     return PM3_SUCCESS;
 }
 static int usage_lf_read(void) {
-    PrintAndLogEx(NORMAL, "Usage: lf read [h] [q] [s #samples] [@]");
+    PrintAndLogEx(NORMAL, "Usage: lf read [h] [q] [s #samples] [@] [r [f <filename>] [d]] [m <mod> [i]]");
     PrintAndLogEx(NORMAL, "Options:");
     PrintAndLogEx(NORMAL, "       h            This help");
     PrintAndLogEx(NORMAL, "       q            silent (optional)");
     PrintAndLogEx(NORMAL, "       s #samples   number of samples to collect (optional)");
     PrintAndLogEx(NORMAL, "       @            run continuously until a key is pressed (optional)");
+    PrintAndLogEx(NORMAL, "       r            stream the samples while sampling, not limited by device memory (optional)");
+    PrintAndLogEx(NORMAL, "       f <filename> with r, save all streamed samples to a pm3 file (optional)");
+    PrintAndLogEx(NORMAL, "       d            with r, run " _YELLOW_("'lf search'") " on the samples as they arrive (optional)");
+    PrintAndLogEx(NORMAL, "       m <mod>      demodulate on the device, only the bits are downloaded (optional)");
+    PrintAndLogEx(NORMAL, "                    ask, bi, bia, nrz, fsk, psk1, psk2, or auto for the EM410x, HID, AWID and IO Prox ID");
+    PrintAndLogEx(NORMAL, "       i            with m, inverted (optional)");
     PrintAndLogEx(NORMAL, "");
     PrintAndLogEx(NORMAL, "Examples:");
     PrintAndLogEx(NORMAL, "      lf read");
     PrintAndLogEx(NORMAL, "- collecting quietly 12000 samples:");
     PrintAndLogEx(NORMAL, "      lf read q s 12000     - ");
+    PrintAndLogEx(NORMAL, "- streaming until Enter is pressed, saving everything:");
+    PrintAndLogEx(NORMAL, "      lf read r f longread");
+    PrintAndLogEx(NORMAL, "- EM410x ID or bits of an ask tag, demodulated on the device:");
+    PrintAndLogEx(NORMAL, "      lf read m auto");
+    PrintAndLogEx(NORMAL, "      lf read m ask");
     PrintAndLogEx(NORMAL, "- oscilloscope style:");
     PrintAndLogEx(NORMAL, "      data plot");
     PrintAndLogEx(NORMAL, "      lf read q s 3000 @");
@@ -124,14 +138,22 @@ static int usage_lf_sim(void) {
 }
 static int usage_lf_sniff(void) {
     PrintAndLogEx(NORMAL, "Sniff low frequence signal.");
-    PrintAndLogEx(NORMAL, "Usage: lf sniff [h] [q] [s #samples] [@]");
+    PrintAndLogEx(NORMAL, "Usage: lf sniff [h] [q] [s #samples] [@] [r [f <filename>] [d]]");
     PrintAndLogEx(NORMAL, "Options:");
     PrintAndLogEx(NORMAL, "       h         This help");
     PrintAndLogEx(NORMAL, "       q            silent (optional)");
     PrintAndLogEx(NORMAL, "       s #samples   number of samples to collect (optional)");
     PrintAndLogEx(NORMAL, "       @            run continuously until a key is pressed (optional)");
+    PrintAndLogEx(NORMAL, "       r            stream the samples while sampling, not limited by device memory (optional)");
+    PrintAndLogEx(NORMAL, "       f <filename> with r, save all streamed samples to a pm3 file (optional)");
+    PrintAndLogEx(NORMAL, "       d            with r, run " _YELLOW_("'lf search'") " on the samples as they arrive (optional)");
     PrintAndLogEx(NORMAL, "Examples:");
     PrintAndLogEx(NORMAL, "      lf sniff");
+    PrintAndLogEx(NORMAL, "- long sniff of a reader, the graph buffer keeps the last samples:");
+    PrintAndLogEx(NORMAL, "      lf sniff r f readersniff");
+    PrintAndLogEx(NORMAL, "- EM410x ID or bits of an ask tag, demodulated on the device:");
+    PrintAndLogEx(NORMAL, "      lf read m auto");
+    PrintAndLogEx(NORMAL, "      lf read m ask");
     PrintAndLogEx(NORMAL, "- oscilloscope style:");
     PrintAndLogEx(NORMAL, "      data plot");
     PrintAndLogEx(NORMAL, "      lf sniff q s 3000 @");
@@ -227,22 +249,62 @@ static int usage_lf_find(void) {
     PrintAndLogEx(NORMAL, "      lf search 1 u = use data from GraphBuffer & search for known and unknown tags");
     return PM3_SUCCESS;
 }
+static int usage_lf_bench(void) {
+    PrintAndLogEx(NORMAL, "Benchmark on the .pm3 traces of a directory, offline: loads each one, times");
+    PrintAndLogEx(NORMAL, "`lf search 1` and every demod it tries, and checks what was found against the");
+    PrintAndLogEx(NORMAL, "tag type the trace name tells");
+    PrintAndLogEx(NORMAL, "Usage:  lf bench [h] [d <dir>] [n <loops>] [j <file>]");
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(NORMAL, "Options:");
+    PrintAndLogEx(NORMAL, "       h             - This help");
+    PrintAndLogEx(NORMAL, "       d <dir>       - traces directory (default: traces)");
+    PrintAndLogEx(NORMAL, "       n <loops>     - runs of each timing, the fastest counts (default: 3)");
+    PrintAndLogEx(NORMAL, "       j <file>      - save the results as JSON");
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(NORMAL, "Examples:");
+    PrintAndLogEx(NORMAL, "      lf bench");
+    PrintAndLogEx(NORMAL, "      lf bench d traces n 5 j lf_bench.json");
+    return PM3_SUCCESS;
+}
+static int usage_lf_watch(void) {
+    PrintAndLogEx(NORMAL, "Read LF badges in a loop on the device. One capture per round is demodulated as");
+    PrintAndLogEx(NORMAL, "every type given, an ID is shown again only after 2 s off the antenna.");
+    PrintAndLogEx(NORMAL, "Press button or Enter to interrupt.");
+    PrintAndLogEx(NORMAL, "Usage:  lf watch [h] [hid] [awid] [io] [em]");
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(NORMAL, "Options:");
+    PrintAndLogEx(NORMAL, "       h             - This help");
+    PrintAndLogEx(NORMAL, "       hid awid io em - types to look for (default: all)");
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(NORMAL, "Examples:");
+    PrintAndLogEx(NORMAL, "      lf watch");
+    PrintAndLogEx(NORMAL, "      lf watch hid em");
+    return PM3_SUCCESS;
+}
 static int usage_lf_tune(void) {
     PrintAndLogEx(NORMAL, "Continuously measure LF antenna tuning.");
     PrintAndLogEx(NORMAL, "Press button or Enter to interrupt.");
-    PrintAndLogEx(NORMAL, "Usage:  lf tune [h] [n <iter>] [q <divisor> | f <freq>]");
+    PrintAndLogEx(NORMAL, "Usage:  lf tune [h] [n <iter>] [q <divisor> | f <freq>] [s] [i <ms>]");
     PrintAndLogEx(NORMAL, "");
     PrintAndLogEx(NORMAL, "Options:");
     PrintAndLogEx(NORMAL, "       h             - This help");
     PrintAndLogEx(NORMAL, "       n <iter>      - number of iterations (default: 0=infinite)");
     PrintAndLogEx(NORMAL, "       q <divisor>   - Frequency divisor. %d -> 134 kHz, %d -> 125 kHz", LF_DIVISOR_134, LF_DIVISOR_125);
     PrintAndLogEx(NORMAL, "       f <freq>      - Frequency in kHz");
+    PrintAndLogEx(NORMAL, "       s             - stream, the device pushes the average, min and max voltage");
+    PrintAndLogEx(NORMAL, "       i <ms>        - stream interval, %d-%d ms (default: %d)", ANTENNA_TUNING_STREAM_MIN_MS, ANTENNA_TUNING_STREAM_MAX_MS, TUNE_STREAM_INTERVAL_MS);
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(NORMAL, "Examples:");
+    PrintAndLogEx(NORMAL, "       lf tune s");
+    PrintAndLogEx(NORMAL, "       lf tune f 134 s i 20");
     return PM3_SUCCESS;
 }
 
 static int CmdLFTune(const char *Cmd) {
     int iter = 0;
     uint8_t divisor =  LF_DIVISOR_125;//Frequency divisor
+    bool stream = false;
+    uint32_t interval = TUNE_STREAM_INTERVAL_MS;
     bool errors = false;
     uint8_t cmdp = 0;
     while (param_getchar(Cmd, cmdp) != 0x00 && !errors) {
@@ -271,6 +333,18 @@ static int CmdLFTune(const char *Cmd) {
                 iter = param_get32ex(Cmd, cmdp + 1, 0, 10);
                 cmdp += 2;
                 break;
+            case 's':
+                stream = true;
+                cmdp++;
+                break;
+            case 'i':
+                interval = param_get32ex(Cmd, cmdp + 1, 0, 10);
+                if (interval < ANTENNA_TUNING_STREAM_MIN_MS || interval > ANTENNA_TUNING_STREAM_MAX_MS) {
+                    PrintAndLogEx(ERR, "interval must be between %d and %d ms", ANTENNA_TUNING_STREAM_MIN_MS, ANTENNA_TUNING_STREAM_MAX_MS);
+                    return PM3_EINVARG;
+                }
+                cmdp += 2;
+                break;
             default:
                 PrintAndLogEx(WARNING, "Unknown parameter '%c'", param_getchar(Cmd, cmdp));
                 errors = 1;
@@ -281,6 +355,11 @@ static int CmdLFTune(const char *Cmd) {
     //Validations
     if (errors) return usage_lf_tune();
 
+    if (stream) {
+        PrintAndLogEx(INFO, "Streaming LF antenna at " _YELLOW_("%.2f") " kHz every %u ms, click " _GREEN_("pm3 button") " or press " _GREEN_("Enter") " to exit", LF_DIV2FREQ(divisor), interval);
+        return antenna_tune_stream(false, divisor, interval, iter);
+    }
+
     PrintAndLogEx(INFO, "Measuring LF antenna at " _YELLOW_("%.2f") " kHz, click " _GREEN_("pm3 button") " or press " _GREEN_("Enter") " to exit", LF_DIV2FREQ(divisor));
 
     uint8_t params[] = {1, 0};
@@ -471,8 +550,12 @@ int CmdFlexdemod(const char *Cmd) {
 #endif
     int i, j, start, bit, sum;
 
-    int data[GraphTraceLen];
-    memcpy(data, GraphBuffer, GraphTraceLen);
+    int *data = calloc(GraphTraceLen + 1, sizeof(int));
+    if (data == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+    memcpy(data, GraphBuffer, GraphTraceLen * sizeof(int));
 
     size_t size = GraphTraceLen;
 
@@ -492,6 +575,7 @@ int CmdFlexdemod(const char *Cmd) {
 
     if (start == size - LONG_WAIT) {
         PrintAndLogEx(WARNING, "nothing to wait for");
+        free(data);
         return PM3_ENODATA;
     }
 
@@ -520,6 +604,7 @@ int CmdFlexdemod(const char *Cmd) {
         if (sum < 0 && bits[bit] != 0) PrintAndLogEx(WARNING, "oops2 at %d", bit);
 
     }
+    free(data);
 
     // iceman,  use demod buffer?  blue line?
     // HACK writing back to graphbuffer.
@@ -701,6 +786,249 @@ int lf_read(bool verbose, uint32_t samples) {
     return PM3_SUCCESS;
 }
 
+static const struct {
+    const char *name;
+    uint8_t modulation;
+} lf_demod_names[] = {
+    {"auto", LF_DEMOD_AUTO},
+    {"ask",  DEMOD_ASK},
+    {"bi",   DEMOD_BI},
+    {"bia",  DEMOD_BIa},
+    {"nrz",  DEMOD_NRZ},
+    {"fsk",  DEMOD_FSK1},
+    {"psk1", DEMOD_PSK1},
+    {"psk2", DEMOD_PSK2},
+};
+
+// lf read with the demodulation on the device, CMD_LF_READ_DEMOD. The bits go to the
+// demod buffer, the samples stay on the device
+int lf_read_demod(bool verbose, uint32_t samples, uint8_t modulation, bool invert) {
+    if (!session.pm3_present) return PM3_ENOTTY;
+
+    lf_demod_req_t payload = {
+        .samples = samples,
+        .modulation = modulation,
+        .invert = invert,
+    };
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_LF_READ_DEMOD, (uint8_t *)&payload, sizeof(payload));
+    PacketResponseNG resp;
+    if (WaitForResponseTimeout(CMD_LF_READ_DEMOD, &resp, 2500) == false) {
+        PrintAndLogEx(WARNING, "(lf_read_demod) command execution time out");
+        return PM3_ETIMEOUT;
+    }
+    if (resp.status == PM3_EINVARG) {
+        PrintAndLogEx(WARNING, "device demodulation needs 8 bits per sample, see " _YELLOW_("'lf config'"));
+        return resp.status;
+    }
+    if (resp.status != PM3_SUCCESS) {
+        if (verbose)
+            PrintAndLogEx(FAILED, "nothing demodulated");
+        return resp.status;
+    }
+
+    const lf_demod_resp_t *r = (const lf_demod_resp_t *)resp.data.asBytes;
+    const lf_demod_info_t *info = &r->info;
+    if (modulation == LF_DEMOD_AUTO) {
+        PrintAndLogEx(SUCCESS, "%s", info->desc);
+        return PM3_SUCCESS;
+    }
+
+    uint8_t bits[sizeof(r->bits) * 8];
+    uint16_t len = MIN(info->len, sizeof(bits));
+    for (uint16_t i = 0; i < len; i++)
+        bits[i] = (r->bits[i / 8] >> (7 - (i % 8))) & 1;
+
+    setDemodBuff(bits, len, 0);
+    g_DemodClock = info->clock;
+    g_DemodStartIdx = 0;
+
+    if (verbose) {
+        PrintAndLogEx(SUCCESS, "%u samples read, " _GREEN_("%u") " bits at RF/%u", info->samples, len, info->clock);
+        printDemodBuff();
+    }
+    return PM3_SUCCESS;
+}
+
+// Streamed acquisition, the device pushes CMD_LF_ACQ_RAW_ADC_STREAM frames while
+// it keeps sampling. They go into a ring buffer holding the last MAX_GRAPH_TRACE_LEN
+// samples, which ends up in the graph buffer. The whole capture can be written to
+// a file as it arrives, and with live demodulation every LF_STREAM_WINDOW samples
+// the latest window is handed to lf search.
+#define LF_STREAM_WINDOW 30000
+
+int lf_stream(bool reader_field, bool verbose, uint32_t samples, const char *filename, bool live) {
+    if (!session.pm3_present) return PM3_ENOTTY;
+
+    FILE *f = NULL;
+    if (filename != NULL) {
+        char *fn = newfilenamemcopy(filename, ".pm3");
+        if (fn == NULL) return PM3_EMALLOC;
+        f = fopen(fn, "w");
+        if (f == NULL) {
+            PrintAndLogEx(WARNING, "could not create file " _YELLOW_("%s"), fn);
+            free(fn);
+            return PM3_EFILE;
+        }
+        if (verbose) PrintAndLogEx(INFO, "saving samples to " _YELLOW_("%s"), fn);
+        free(fn);
+    }
+
+    graph_ring_t ring = { .size = MAX_GRAPH_TRACE_LEN };
+    ring.buf = calloc(ring.size, sizeof(uint8_t));
+    if (ring.buf == NULL) {
+        if (f) fclose(f);
+        return PM3_EMALLOC;
+    }
+
+    lf_stream_req_t req = {
+        .flags = reader_field ? LF_STREAM_READER_FIELD : 0,
+        .samples = samples,
+    };
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_LF_ACQ_RAW_ADC_STREAM, (uint8_t *)&req, sizeof(req));
+    PrintAndLogEx(INFO, "Streaming, press " _GREEN_("Enter") " to stop");
+
+    PacketResponseNG resp;
+    lf_stream_frame_t *frame = (lf_stream_frame_t *)resp.data.asBytes;
+    uint64_t next_demod = LF_STREAM_WINDOW;
+    uint64_t last_frame = msclock();
+    uint16_t seq = 0;
+    bool stopping = false;
+    int status = PM3_SUCCESS;
+
+    for (;;) {
+        if (stopping == false && kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            stopping = true;
+            last_frame = msclock();
+        }
+
+        if (WaitForResponseTimeout(CMD_LF_ACQ_RAW_ADC_STREAM, &resp, 100) == false) {
+            // nothing comes while waiting for the trigger threshold
+            if ((g_lf_threshold_set && stopping == false) || msclock() - last_frame < 2500)
+                continue;
+
+            PrintAndLogEx(WARNING, "(lf_stream) command execution time out");
+            if (stopping == false)
+                SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            clearCommandBuffer();
+            SendCommandNG(CMD_FPGA_MAJOR_MODE_OFF, NULL, 0);
+            status = PM3_ETIMEOUT;
+            break;
+        }
+        last_frame = msclock();
+
+        // errors before sampling started carry no frame
+        if (resp.length < sizeof(lf_stream_frame_t) - LF_STREAM_SAMPLES) {
+            status = resp.status;
+            break;
+        }
+
+        if (frame->seq != seq)
+            PrintAndLogEx(WARNING, "lost " _YELLOW_("%u") " frames", (uint16_t)(frame->seq - seq));
+        seq = frame->seq + 1;
+
+        uint16_t len = MIN(frame->len, LF_STREAM_SAMPLES);
+        graph_ring_push(&ring, frame->data, len);
+        if (f) {
+            for (uint16_t i = 0; i < len; i++)
+                fprintf(f, "%d\n", ((int)frame->data[i]) - 127);
+        }
+
+        if (frame->final) {
+            status = resp.status;
+            break;
+        }
+
+        if (live && ring.total >= next_demod) {
+            graph_ring_to_graph(&ring, LF_STREAM_WINDOW);
+            CmdLFfind("1");
+            next_demod = ring.total + LF_STREAM_WINDOW;
+        }
+    }
+
+    if (f) {
+        fflush(f);
+        fclose(f);
+    }
+
+    graph_ring_to_graph(&ring, ring.size);
+    RepaintGraphWindow();
+    free(ring.buf);
+
+    if (status == PM3_EOVFLOW)
+        PrintAndLogEx(WARNING, "device buffer overflow, the samples came faster than they were read. Try a higher decimation in " _YELLOW_("'lf config'"));
+
+    if (verbose)
+        PrintAndLogEx(SUCCESS, "Streamed " _YELLOW_("%" PRIu64) " samples, graph buffer holds the last " _YELLOW_("%zu"), ring.total, GraphTraceLen);
+
+    return (status == PM3_EOPABORTED) ? PM3_SUCCESS : status;
+}
+
+// runs one device side id sweep, CMD_LF_SIM_SWEEP, len bytes of payload with the ids of a list. Without a
+// reader field the device makes no progress, so missing frames are only an error once the sweep was asked
+// to stop. Returns the status of the final frame
+int lf_sim_sweep_run(sim_sweep_t *payload, uint16_t len) {
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_LF_SIM_SWEEP, (uint8_t *)payload, len);
+
+    PacketResponseNG resp;
+    sim_sweep_resp_t *r = (sim_sweep_resp_t *)resp.data.asBytes;
+    uint64_t stopped = 0;
+
+    for (;;) {
+        if (stopped == 0 && kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            stopped = msclock();
+        }
+
+        if (WaitForResponseTimeout(CMD_LF_SIM_SWEEP, &resp, 200) == false) {
+            if (stopped && msclock() - stopped > 2500) {
+                PrintAndLogEx(NORMAL, "");
+                PrintAndLogEx(WARNING, "command execution time out");
+                return PM3_ETIMEOUT;
+            }
+            continue;
+        }
+
+        if (resp.length < sizeof(sim_sweep_resp_t)) {
+            PrintAndLogEx(NORMAL, "");
+            return resp.status;
+        }
+
+        if (payload->type == SIM_SWEEP_EM410X)
+            PrintAndLogEx(INPLACE, " %u / %u  id " _YELLOW_("%010" PRIX64), r->index + 1, payload->count, r->value);
+        else if (payload->type == SIM_SWEEP_EM410X_LIST)
+            PrintAndLogEx(INPLACE, " %" PRIu64 " / %u  id " _YELLOW_("%010" PRIX64), payload->start + r->index + 1, payload->step, r->value);
+        else
+            PrintAndLogEx(INPLACE, " %u / %u  fc " _YELLOW_("%u") " cn " _YELLOW_("%" PRIu64), r->index + 1, payload->count, payload->fc, r->value);
+
+        if (resp.status != PM3_EPARTIAL)
+            break;
+    }
+
+    return resp.status;
+}
+
+int lf_sim_sweep(sim_sweep_t *payload) {
+
+    PrintAndLogEx(INFO, "Press pm3-button or " _GREEN_("Enter") " to abort the sweep");
+    int res = lf_sim_sweep_run(payload, sizeof(sim_sweep_t));
+
+    PrintAndLogEx(NORMAL, "");
+    if (res == PM3_EOPABORTED) {
+        PrintAndLogEx(INFO, "Sweep aborted");
+        return PM3_SUCCESS;
+    }
+    if (res == PM3_SUCCESS)
+        PrintAndLogEx(SUCCESS, "Sweep done");
+    return res;
+}
+
 int CmdLFRead(const char *Cmd) {
 
     if (!session.pm3_present) return PM3_ENOTTY;
@@ -708,12 +1036,54 @@ int CmdLFRead(const char *Cmd) {
     bool errors = false;
     bool verbose = true;
     bool continuous = false;
+    bool stream = false;
+    bool live = false;
+    bool demod = false, demod_known = false;
+    bool invert = false;
+    uint8_t modulation = LF_DEMOD_AUTO;
+    char filename[FILE_PATH_SIZE] = {0};
     uint32_t samples = 0;
     uint8_t cmdp = 0;
     while (param_getchar(Cmd, cmdp) != 0x00 && !errors) {
         switch (tolower(param_getchar(Cmd, cmdp))) {
             case 'h':
                 return usage_lf_read();
+            case 'r':
+                stream = true;
+                cmdp++;
+                break;
+            case 'f':
+                if (param_getstr(Cmd, cmdp + 1, filename, FILE_PATH_SIZE) == 0) {
+                    PrintAndLogEx(WARNING, "missing filename");
+                    errors = true;
+                }
+                cmdp += 2;
+                break;
+            case 'd':
+                live = true;
+                cmdp++;
+                break;
+            case 'm': {
+                char mod[8] = {0};
+                param_getstr(Cmd, cmdp + 1, mod, sizeof(mod));
+                demod = true;
+                for (size_t i = 0; i < ARRAYLEN(lf_demod_names); i++) {
+                    if (strcmp(mod, lf_demod_names[i].name) == 0) {
+                        modulation = lf_demod_names[i].modulation;
+                        demod_known = true;
+                    }
+                }
+                if (demod_known == false) {
+                    PrintAndLogEx(WARNING, "unknown modulation '%s'", mod);
+                    errors = true;
+                }
+                cmdp += 2;
+                break;
+            }
+            case 'i':
+                invert = true;
+                cmdp++;
+                break;
             case 's':
                 samples = param_get32ex(Cmd, cmdp + 1, 0, 10);
                 cmdp += 2;
@@ -735,12 +1105,30 @@ int CmdLFRead(const char *Cmd) {
 
     //Validations
     if (errors) return usage_lf_read();
+    if ((filename[0] || live) && stream == false) {
+        PrintAndLogEx(WARNING, "options f and d need r");
+        return usage_lf_read();
+    }
+    if (demod && stream) {
+        PrintAndLogEx(WARNING, "options m and r can't be combined");
+        return usage_lf_read();
+    }
+    if (invert && demod == false) {
+        PrintAndLogEx(WARNING, "option i needs m");
+        return usage_lf_read();
+    }
+    if (stream)
+        return lf_stream(true, verbose, samples, filename[0] ? filename : NULL, live);
+
     if (continuous) {
         PrintAndLogEx(INFO, "Press " _GREEN_("Enter") " to exit");
     }
     int ret = PM3_SUCCESS;
     do {
-        ret = lf_read(verbose, samples);
+        if (demod)
+            ret = lf_read_demod(verbose, samples, modulation, invert);
+        else
+            ret = lf_read(verbose, samples);
         if (kbd_enter_pressed()) {
             break;
         }
@@ -785,12 +1173,30 @@ int CmdLFSniff(const char *Cmd) {
     bool errors = false;
     bool verbose = true;
     bool continuous = false;
+    bool stream = false;
+    bool live = false;
+    char filename[FILE_PATH_SIZE] = {0};
     uint32_t samples = 0;
     uint8_t cmdp = 0;
     while (param_getchar(Cmd, cmdp) != 0x00 && !errors) {
         switch (tolower(param_getchar(Cmd, cmdp))) {
             case 'h':
                 return usage_lf_sniff();
+            case 'r':
+                stream = true;
+                cmdp++;
+                break;
+            case 'f':
+                if (param_getstr(Cmd, cmdp + 1, filename, FILE_PATH_SIZE) == 0) {
+                    PrintAndLogEx(WARNING, "missing filename");
+                    errors = true;
+                }
+                cmdp += 2;
+                break;
+            case 'd':
+                live = true;
+                cmdp++;
+                break;
             case 's':
                 samples = param_get32ex(Cmd, cmdp + 1, 0, 10);
                 cmdp += 2;
@@ -812,6 +1218,13 @@ int CmdLFSniff(const char *Cmd) {
 
     //Validations
     if (errors) return usage_lf_sniff();
+    if ((filename[0] || live) && stream == false) {
+        PrintAndLogEx(WARNING, "options f and d need r");
+        return usage_lf_sniff();
+    }
+    if (stream)
+        return lf_stream(false, verbose, samples, filename[0] ? filename : NULL, live);
+
     if (continuous) {
         PrintAndLogEx(INFO, "Press " _GREEN_("Enter") " to exit");
     }
@@ -1375,6 +1788,41 @@ out:
     return retval;
 }
 
+static int demodFDXverbose(void) {
+    return demodFDX(true);
+}
+
+// the demods `lf search` tries on the graph, in this order
+static const struct {
+    const char *name;
+    int (*demod)(void);
+} lf_demods[] = {
+    { "Visa2000 ID",           demodVisa2k },
+    { "HID Prox ID",           demodHID },
+    { "AWID ID",               demodAWID },
+    { "IO Prox ID",            demodIOProx },
+    { "Paradox ID",            demodParadox },
+    { "NexWatch ID",           demodNexWatch },
+    { "EM410x ID",             demodEM410x },
+    { "FDX-B ID",              demodFDXverbose },
+    { "Guardall G-Prox II ID", demodGuard },
+    { "Idteck ID",             demodIdteck },
+    { "Jablotron ID",          demodJablotron },
+    { "NEDAP ID",              demodNedap },
+    { "Noralsy ID",            demodNoralsy },
+    { "KERI ID",               demodKeri },
+    { "PAC/Stanley ID",        demodPac },
+    { "Presco ID",             demodPresco },
+    { "Pyramid ID",            demodPyramid },
+    { "Securakey ID",          demodSecurakey },
+    { "Viking ID",             demodViking },
+    { "GALLAGHER ID",          demodGallagher },
+    { "Indala ID",             demodIndala },
+};
+
+// index in lf_demods of what the last `lf search` found, -1 for nothing known
+static int lf_search_found = -1;
+
 int CmdLFfind(const char *Cmd) {
     int retval = PM3_SUCCESS;
     int ans = 0;
@@ -1384,6 +1832,8 @@ int CmdLFfind(const char *Cmd) {
 
     if (strlen(Cmd) > 3 || cmdp == 'h') return usage_lf_find();
 
+    lf_search_found = -1;
+
     if (cmdp == 'u') testRaw = 'u';
 
     bool isOnline = (session.pm3_present && (cmdp != '1'));
@@ -1445,27 +1895,13 @@ int CmdLFfind(const char *Cmd) {
         }
     }
 
-    if (demodVisa2k() == PM3_SUCCESS) { PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Visa2000 ID") " found!"); goto out;}
-    if (demodHID() == PM3_SUCCESS) { PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("HID Prox ID") " found!"); goto out;}
-    if (demodAWID() == PM3_SUCCESS) { PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("AWID ID") " found!"); goto out;}
-    if (demodIOProx() == PM3_SUCCESS) { PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("IO Prox ID") " found!"); goto out;}
-    if (demodParadox() == PM3_SUCCESS) { PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Paradox ID") " found!"); goto out;}
-    if (demodNexWatch() == PM3_SUCCESS) { PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("NexWatch ID") " found!"); goto out;}
-    if (demodEM410x() == PM3_SUCCESS) { PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("EM410x ID") " found!"); goto out;}
-    if (demodFDX(true) == PM3_SUCCESS) { PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("FDX-B ID") " found!"); goto out;}
-    if (demodGuard() == PM3_SUCCESS) { PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Guardall G-Prox II ID") " found!"); goto out; }
-    if (demodIdteck() == PM3_SUCCESS) { PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Idteck ID") " found!"); goto out;}
-    if (demodJablotron() == PM3_SUCCESS) { PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Jablotron ID") " found!"); goto out;}
-    if (demodNedap() == PM3_SUCCESS) { PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("NEDAP ID") " found!"); goto out;}
-    if (demodNoralsy() == PM3_SUCCESS) { PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Noralsy ID") " found!"); goto out;}
-    if (demodKeri() == PM3_SUCCESS) { PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("KERI ID") " found!"); goto out;}
-    if (demodPac() == PM3_SUCCESS) { PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("PAC/Stanley ID") " found!"); goto out;}
-    if (demodPresco() == PM3_SUCCESS) { PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Presco ID") " found!"); goto out;}
-    if (demodPyramid() == PM3_SUCCESS) { PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Pyramid ID") " found!"); goto out;}
-    if (demodSecurakey() == PM3_SUCCESS) { PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Securakey ID") " found!"); goto out;}
-    if (demodViking() == PM3_SUCCESS) { PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Viking ID") " found!"); goto out;}
-    if (demodGallagher() == PM3_SUCCESS) { PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("GALLAGHER ID") " found!"); goto out;}
-    if (demodIndala() == PM3_SUCCESS) { PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Indala ID") " found!");  goto out; }
+    for (size_t i = 0; i < ARRAYLEN(lf_demods); i++) {
+        if (lf_demods[i].demod() == PM3_SUCCESS) {
+            PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("%s") " found!", lf_demods[i].name);
+            lf_search_found = i;
+            goto out;
+        }
+    }
 
 //    if (demodTI() == PM3_SUCCESS) { PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Texas Instrument ID") " found!"); goto out;}
 //    if (demodFermax() == PM3_SUCCESS) { PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Fermax ID") " found!"); goto out;}
@@ -1521,6 +1957,303 @@ out:
     return retval;
 }
 
+// this read loops on device side, on one capture for all the types
+// tag type `lf search` should find in a trace, by the start of its name
+static const struct {
+    const char *prefix;
+    const char *name;
+} lf_bench_expected[] = {
+    { "ata5577-hidemu", "HID Prox ID" },
+    { "awid",           "AWID ID" },
+    { "em4102",         "EM410x ID" },
+    { "em4x05",         "FDX-B ID" },
+    { "gallagher",      "GALLAGHER ID" },
+    { "hid",            "HID Prox ID" },
+    { "homeagain",      "FDX-B ID" },
+    { "indala",         "Indala ID" },
+    { "ioprox",         "IO Prox ID" },
+    { "keri",           "Pyramid ID" },
+    { "lf_fdx",         "FDX-B ID" },
+    { "lf_gprox",       "Guardall G-Prox II ID" },
+    { "lf_idteck",      "Idteck ID" },
+    { "nexkey",         "NexWatch ID" },
+    { "pac",            "PAC/Stanley ID" },
+    { "paradox",        "Paradox ID" },
+    { "quadrakey",      "NexWatch ID" },
+    { "securakey",      "Securakey ID" },
+    { "transit999",     "Viking ID" },
+    { "visa2000",       "Visa2000 ID" },
+};
+
+static const char *lf_bench_expect(const char *fn) {
+    char name[64] = {0};
+    strncpy(name, fn, sizeof(name) - 1);
+    str_lower(name);
+    for (size_t i = 0; i < ARRAYLEN(lf_bench_expected); i++) {
+        if (strncmp(name, lf_bench_expected[i].prefix, strlen(lf_bench_expected[i].prefix)) == 0)
+            return lf_bench_expected[i].name;
+    }
+    return NULL;
+}
+
+typedef struct {
+    int *samples;
+    size_t len;
+    signal_t signal;
+} lf_bench_graph_t;
+
+// puts the loaded trace back, the demods change the graph and demod buffers
+static void lf_bench_restore(const lf_bench_graph_t *g) {
+    if (GraphReserve(g->len) == false)
+        return;
+    memcpy(GraphBuffer, g->samples, g->len * sizeof(int));
+    GraphTraceLen = g->len;
+    memcpy(getSignalProperties(), &g->signal, sizeof(signal_t));
+    DemodBufferLen = 0;
+}
+
+static int CmdLFBench(const char *Cmd) {
+    char dir[FILE_PATH_SIZE] = "traces";
+    char jsonfn[FILE_PATH_SIZE] = {0};
+    uint32_t loops = 3;
+
+    uint8_t cmdp = 0;
+    while (param_getchar(Cmd, cmdp) != 0x00) {
+        switch (tolower(param_getchar(Cmd, cmdp))) {
+            case 'h':
+                return usage_lf_bench();
+            case 'd':
+                if (param_getstr(Cmd, cmdp + 1, dir, sizeof(dir)) == 0)
+                    return usage_lf_bench();
+                cmdp += 2;
+                break;
+            case 'n':
+                loops = param_get32ex(Cmd, cmdp + 1, 3, 10);
+                if (loops == 0 || loops > 100)
+                    return usage_lf_bench();
+                cmdp += 2;
+                break;
+            case 'j':
+                if (param_getstr(Cmd, cmdp + 1, jsonfn, sizeof(jsonfn)) == 0)
+                    return usage_lf_bench();
+                cmdp += 2;
+                break;
+            default:
+                PrintAndLogEx(WARNING, "Unknown parameter '%c'", param_getchar(Cmd, cmdp));
+                return usage_lf_bench();
+        }
+    }
+
+    char **names = NULL;
+    int count = listDirFiles(dir, ".pm3", &names);
+    if (count < 0) {
+        PrintAndLogEx(FAILED, "can't read directory " _YELLOW_("%s"), dir);
+        return PM3_EFILE;
+    }
+
+    const size_t ndemods = ARRAYLEN(lf_demods);
+    uint64_t *demod_us = calloc(ndemods, sizeof(uint64_t));
+    uint32_t *demod_hits = calloc(ndemods, sizeof(uint32_t));
+    lf_bench_graph_t g = { NULL, 0, {0} };
+    if (demod_us == NULL || demod_hits == NULL) {
+        free(demod_us);
+        free(demod_hits);
+        for (int i = 0; i < count; i++)
+            free(names[i]);
+        free(names);
+        return PM3_EMALLOC;
+    }
+
+    json_t *root = json_object();
+    json_object_set_new(root, "Created", json_string("proxmark3"));
+    json_object_set_new(root, "FileType", json_string("lfbench"));
+    json_object_set_new(root, "loops", json_integer(loops));
+    json_t *jtraces = json_array();
+
+    PrintAndLogEx(INFO, "%d traces in " _YELLOW_("%s") ", best of %u runs", count, dir, loops);
+    PrintAndLogEx(INFO, "");
+    PrintAndLogEx(INFO, " trace                                    | samples | load ms | search ms | found");
+    PrintAndLogEx(INFO, "------------------------------------------+---------+---------+-----------+------------------");
+
+    uint32_t expected = 0, correct = 0;
+    uint64_t total_search_us = 0;
+    for (int t = 0; t < count; t++) {
+        char path[FILE_PATH_SIZE * 2];
+        snprintf(path, sizeof(path), "%s%s%s", dir, PATHSEP, names[t]);
+
+        SetPrintAndLogQuiet(true);
+        uint64_t load_us = UINT64_MAX;
+        int res = PM3_SUCCESS;
+        for (uint32_t l = 0; l < loops && res == PM3_SUCCESS; l++) {
+            uint64_t t0 = usclock();
+            res = LoadGraphFile(path);
+            load_us = MIN(load_us, usclock() - t0);
+        }
+        if (res != PM3_SUCCESS || GraphTraceLen == 0) {
+            SetPrintAndLogQuiet(false);
+            PrintAndLogEx(WARNING, " %-40s | can't load", names[t]);
+            continue;
+        }
+
+        int *p = realloc(g.samples, GraphTraceLen * sizeof(int));
+        if (p == NULL) {
+            SetPrintAndLogQuiet(false);
+            PrintAndLogEx(WARNING, "Failed to allocate memory");
+            break;
+        }
+        g.samples = p;
+        g.len = GraphTraceLen;
+        memcpy(g.samples, GraphBuffer, g.len * sizeof(int));
+        memcpy(&g.signal, getSignalProperties(), sizeof(signal_t));
+
+        uint64_t search_us = UINT64_MAX;
+        for (uint32_t l = 0; l < loops; l++) {
+            lf_bench_restore(&g);
+            uint64_t t0 = usclock();
+            CmdLFfind("1");
+            search_us = MIN(search_us, usclock() - t0);
+        }
+        const char *found = (lf_search_found < 0) ? NULL : lf_demods[lf_search_found].name;
+        total_search_us += search_us;
+
+        json_t *jdemods = json_object();
+        for (size_t d = 0; d < ndemods; d++) {
+            uint64_t us = UINT64_MAX;
+            bool ok = false;
+            for (uint32_t l = 0; l < loops; l++) {
+                lf_bench_restore(&g);
+                uint64_t t0 = usclock();
+                ok = (lf_demods[d].demod() == PM3_SUCCESS);
+                us = MIN(us, usclock() - t0);
+            }
+            demod_us[d] += us;
+            if (ok)
+                demod_hits[d]++;
+            json_t *jd = json_object();
+            json_object_set_new(jd, "us", json_integer(us));
+            json_object_set_new(jd, "found", json_boolean(ok));
+            json_object_set_new(jdemods, lf_demods[d].name, jd);
+        }
+        SetPrintAndLogQuiet(false);
+
+        const char *expect = lf_bench_expect(names[t]);
+        bool match = (expect && found && strcmp(expect, found) == 0);
+        if (expect) {
+            expected++;
+            if (match)
+                correct++;
+        }
+
+        PrintAndLogEx(INFO, " %-40s | %7zu | %7.1f | %9.1f | %s%s%s", names[t], g.len, load_us / 1000.0, search_us / 1000.0,
+                      found ? found : "-",
+                      (expect && match == false) ? ", expected " : "",
+                      (expect && match == false) ? expect : "");
+
+        json_t *jt = json_object();
+        json_object_set_new(jt, "file", json_string(names[t]));
+        json_object_set_new(jt, "samples", json_integer(g.len));
+        json_object_set_new(jt, "load_us", json_integer(load_us));
+        json_object_set_new(jt, "search_us", json_integer(search_us));
+        json_object_set_new(jt, "found", found ? json_string(found) : json_null());
+        json_object_set_new(jt, "expected", expect ? json_string(expect) : json_null());
+        if (expect)
+            json_object_set_new(jt, "correct", json_boolean(match));
+        json_object_set_new(jt, "demods", jdemods);
+        json_array_append_new(jtraces, jt);
+    }
+    json_object_set_new(root, "traces", jtraces);
+
+    // the graph is left with the last trace loaded
+    lf_bench_restore(&g);
+    free(g.samples);
+
+    PrintAndLogEx(INFO, "");
+    PrintAndLogEx(INFO, " demod                  | total ms | found in");
+    PrintAndLogEx(INFO, "------------------------+----------+---------");
+    json_t *jsum = json_object();
+    for (size_t d = 0; d < ndemods; d++) {
+        PrintAndLogEx(INFO, " %-22s | %8.1f | %u", lf_demods[d].name, demod_us[d] / 1000.0, demod_hits[d]);
+        json_t *jd = json_object();
+        json_object_set_new(jd, "total_us", json_integer(demod_us[d]));
+        json_object_set_new(jd, "found", json_integer(demod_hits[d]));
+        json_object_set_new(jsum, lf_demods[d].name, jd);
+    }
+    json_object_set_new(root, "demods", jsum);
+    json_object_set_new(root, "search_total_us", json_integer(total_search_us));
+    json_object_set_new(root, "expected", json_integer(expected));
+    json_object_set_new(root, "correct", json_integer(correct));
+
+    PrintAndLogEx(INFO, "");
+    PrintAndLogEx(SUCCESS, "lf search " _YELLOW_("%.1f") " ms over all traces, found the expected tag in " _YELLOW_("%u / %u"),
+                  total_search_us / 1000.0, correct, expected);
+
+    int ret = PM3_SUCCESS;
+    if (jsonfn[0]) {
+        if (json_dump_file(root, jsonfn, JSON_INDENT(2)) == 0) {
+            PrintAndLogEx(SUCCESS, "saved to " _YELLOW_("%s"), jsonfn);
+        } else {
+            PrintAndLogEx(FAILED, "can't write " _YELLOW_("%s"), jsonfn);
+            ret = PM3_EFILE;
+        }
+    }
+    json_decref(root);
+
+    free(demod_us);
+    free(demod_hits);
+    for (int i = 0; i < count; i++)
+        free(names[i]);
+    free(names);
+    return ret;
+}
+
+static int CmdLFWatch(const char *Cmd) {
+
+    static const struct {
+        const char *name;
+        uint8_t type;
+    } types[] = {
+        { "hid",  LF_WATCH_HID },
+        { "awid", LF_WATCH_AWID },
+        { "io",   LF_WATCH_IO },
+        { "em",   LF_WATCH_EM410X },
+    };
+
+    uint8_t watch = 0;
+    char arg[8];
+    for (int cmdp = 0; param_getstr(Cmd, cmdp, arg, sizeof(arg)) > 0; cmdp++) {
+        str_lower(arg);
+        if (strcmp(arg, "h") == 0)
+            return usage_lf_watch();
+
+        size_t i = 0;
+        while (i < ARRAYLEN(types) && strcmp(arg, types[i].name))
+            i++;
+        if (i == ARRAYLEN(types)) {
+            PrintAndLogEx(WARNING, "Unknown parameter '%s'", arg);
+            return usage_lf_watch();
+        }
+        watch |= types[i].type;
+    }
+    if (watch == 0)
+        watch = LF_WATCH_ALL;
+
+    PrintAndLogEx(SUCCESS, "Watching for LF badges - place tag on antenna");
+    PrintAndLogEx(INFO, "Press pm3-button or " _GREEN_("Enter") " to stop reading cards");
+    clearCommandBuffer();
+    SendCommandNG(CMD_LF_WATCH, &watch, sizeof(watch));
+
+    PacketResponseNG resp;
+    while (WaitForResponseTimeout(CMD_LF_WATCH, &resp, 500) == false) {
+        if (kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            WaitForResponse(CMD_LF_WATCH, &resp);
+            break;
+        }
+    }
+    PrintAndLogEx(INFO, "Done");
+    return PM3_SUCCESS;
+}
+
 static command_t CommandTable[] = {
     {"help",        CmdHelp,            AlwaysAvailable, "This help"},
     {"awid",        CmdLFAWID,          AlwaysAvailable, "{ AWID RFIDs...              }"},
@@ -1550,6 +2283,7 @@ static command_t CommandTable[] = {
     {"viking",      CmdLFViking,        AlwaysAvailable, "{ Viking RFIDs...            }"},
     {"visa2000",    CmdLFVisa2k,        AlwaysAvailable, "{ Visa2000 RFIDs...          }"},
     {"",            CmdHelp,            AlwaysAvailable, ""},
+    {"bench",       CmdLFBench,         AlwaysAvailable, "Benchmark lf search and the demods over the .pm3 traces"},
     {"config",      CmdLFConfig,        IfPm3Lf,         "Get/Set config for LF sampling, bit/sample, decimation, frequency"},
     {"cmdread",     CmdLFCommandRead,   IfPm3Lf,         "Modulate LF reader field to send command before read (all periods in microseconds)"},
     {"read",        CmdLFRead,          IfPm3Lf,         "Read LF tag"},
@@ -1562,6 +2296,7 @@ static command_t CommandTable[] = {
     {"simbidir",    CmdLFSimBidir,      IfPm3Lf,         "Simulate LF tag (with bidirectional data transmission between reader and tag)"},
     {"sniff",       CmdLFSniff,         IfPm3Lf,         "Sniff LF traffic between reader and tag"},
     {"tune",        CmdLFTune,          IfPm3Lf,         "Continuously measure LF antenna tuning"},
+    {"watch",       CmdLFWatch,         IfPm3Lf,         "Read HID, AWID, ioProx and EM410x badges in a loop on one capture"},
 //    {"vchdemod",    CmdVchDemod,        AlwaysAvailable, "['clone'] -- Demodulate samples for VeriChip"},
 //    {"flexdemod",   CmdFlexdemod,       AlwaysAvailable, "Demodulate samples for Motorola FlexPass"},
     {NULL, NULL, NULL, NULL}
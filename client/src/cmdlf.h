@@ -33,7 +33,11 @@ int CmdVchDemod(const char *Cmd);
 int CmdLFfind(const char *Cmd);
 
 int lf_read(bool verbose, uint32_t samples);
+int lf_read_demod(bool verbose, uint32_t samples, uint8_t modulation, bool invert);
 int lf_sniff(bool verbose, uint32_t samples);
+int lf_stream(bool reader_field, bool verbose, uint32_t samples, const char *filename, bool live);
+int lf_sim_sweep(sim_sweep_t *payload);
+int lf_sim_sweep_run(sim_sweep_t *payload, uint16_t len);
 int lf_config(sample_config *config);
 int lf_getconfig(sample_config *config);
 
@@ -199,7 +199,7 @@ static int CmdAWIDWatch(const char *Cmd) {
 static int CmdAWIDDemod(const char *Cmd) {
     (void)Cmd; // Cmd is not used so far
 
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN, sizeof(uint8_t));
+    uint8_t *bits = calloc(MAX(GraphTraceLen, MAX_GRAPH_TRACE_LEN), sizeof(uint8_t));
     if (bits == NULL) {
         PrintAndLogEx(DEBUG, "DEBUG: Error - AWID failed to allocate memory");
         return PM3_EMALLOC;
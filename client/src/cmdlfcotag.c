@@ -25,9 +25,10 @@ static int usage_lf_cotag_read(void) {
     PrintAndLogEx(NORMAL, "Usage: lf COTAG read [h] <signaldata>");
     PrintAndLogEx(NORMAL, "Options:");
     PrintAndLogEx(NORMAL, "      h          : This help");
-    PrintAndLogEx(NORMAL, "      <0|1|2>    : 0 - HIGH/LOW signal; maxlength bigbuff");
+    PrintAndLogEx(NORMAL, "      <0|1|2|3>  : 0 - HIGH/LOW signal; maxlength bigbuff");
     PrintAndLogEx(NORMAL, "                 : 1 - translation of HI/LO into bytes with manchester 0,1");
     PrintAndLogEx(NORMAL, "                 : 2 - raw signal; maxlength bigbuff");
+    PrintAndLogEx(NORMAL, "                 : 3 - as 1, the device reads until it has a clean frame (default)");
     PrintAndLogEx(NORMAL, "");
     PrintAndLogEx(NORMAL, "Example:");
     PrintAndLogEx(NORMAL, "        lf cotag read 0");
@@ -80,6 +81,7 @@ static int CmdCOTAGDemod(const char *Cmd) {
 // 0 = HIGH/LOW signal - maxlength bigbuff
 // 1 = translation for HI/LO into bytes with manchester 0,1 - length 300
 // 2 = raw signal -  maxlength bigbuff
+// 3 = as 1, ends on the first frame without Manchester errors. Firmware without it answers nothing, then 1
 static int CmdCOTAGRead(const char *Cmd) {
 
     if (tolower(Cmd[0]) == 'h')
@@ -88,7 +90,7 @@ static int CmdCOTAGRead(const char *Cmd) {
     struct p {
         uint8_t mode;
     } PACKED payload;
-    payload.mode = param_get8ex(Cmd, 0, 1, 10);
+    payload.mode = param_get8ex(Cmd, 0, 3, 10);
 
     PacketResponseNG resp;
     clearCommandBuffer();
@@ -120,6 +122,22 @@ static int CmdCOTAGRead(const char *Cmd) {
             DemodBufferLen = resp.length;
             return demodCOTAG();
         }
+        case 3: {
+            if (resp.status == PM3_SUCCESS && resp.length == 0)
+                return CmdCOTAGRead("1");
+
+            if (resp.status == PM3_ENODATA) {
+                PrintAndLogEx(DEBUG, "DEBUG: Error - COTAG no signal");
+                return PM3_ESOFT;
+            }
+
+            if (resp.status != PM3_SUCCESS && resp.status != PM3_ESOFT)
+                return resp.status;
+
+            memcpy(DemodBuffer, resp.data.asBytes, MIN(resp.length, COTAG_BITS));
+            DemodBufferLen = MIN(resp.length, COTAG_BITS);
+            return demodCOTAG();
+        }
     }
     return PM3_SUCCESS;
 }
@@ -100,13 +100,14 @@ static int usage_lf_em410x_sim(void) {
     return PM3_SUCCESS;
 }
 static int usage_lf_em410x_brute(void) {
-    PrintAndLogEx(NORMAL, "Bruteforcing by emulating EM410x tag");
+    PrintAndLogEx(NORMAL, "Bruteforcing by emulating EM410x tag, the device plays the ids of the file");
+    PrintAndLogEx(NORMAL, "Dwell time counts reader field time, the list waits while there is no field");
     PrintAndLogEx(NORMAL, "");
     PrintAndLogEx(NORMAL, "Usage:  lf em 410x_brute [h] ids.txt [d 2000] [c clock]");
     PrintAndLogEx(NORMAL, "Options:");
     PrintAndLogEx(NORMAL, "       h             - this help");
     PrintAndLogEx(NORMAL, "       ids.txt       - file with UIDs in HEX format, one per line");
-    PrintAndLogEx(NORMAL, "       d (2000)      - pause delay in milliseconds between UIDs simulation, default 1000 ms (optional)");
+    PrintAndLogEx(NORMAL, "       d (2000)      - dwell time per uid in milliseconds, default 1000 ms (optional)");
     PrintAndLogEx(NORMAL, "       c (32)        - clock (32|64), default 64 (optional)");
     PrintAndLogEx(NORMAL, "Examples:");
     PrintAndLogEx(NORMAL, _YELLOW_("      lf em 410x_brute ids.txt"));
@@ -115,6 +116,24 @@ static int usage_lf_em410x_brute(void) {
     PrintAndLogEx(NORMAL, _YELLOW_("      lf em 410x_brute ids.txt d 3000 c 32"));
     return PM3_SUCCESS;
 }
+static int usage_lf_em410x_sweep(void) {
+    PrintAndLogEx(NORMAL, "Bruteforcing a reader with a range of EM410x ids, the loop runs on the device");
+    PrintAndLogEx(NORMAL, "Dwell time counts reader field time, the sweep waits while there is no field");
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(NORMAL, "Usage:  lf em 410x_sweep [h] <uid> [n <count>] [s <step>] [d <ms>] [c <clock>]");
+    PrintAndLogEx(NORMAL, "Options:");
+    PrintAndLogEx(NORMAL, "       h             - this help");
+    PrintAndLogEx(NORMAL, "       uid           - first uid (10 HEX symbols)");
+    PrintAndLogEx(NORMAL, "       n <count>     - number of uids, default 256");
+    PrintAndLogEx(NORMAL, "       s <step>      - added to the uid for the next one, default 1");
+    PrintAndLogEx(NORMAL, "       d <ms>        - dwell time per uid in milliseconds, default 500");
+    PrintAndLogEx(NORMAL, "       c <clock>     - clock (32|64), default 64");
+    PrintAndLogEx(NORMAL, "Examples:");
+    PrintAndLogEx(NORMAL, _YELLOW_("      lf em 410x_sweep 0F03685600"));
+    PrintAndLogEx(NORMAL, _YELLOW_("      lf em 410x_sweep 0F03685600 n 1000 d 200"));
+    PrintAndLogEx(NORMAL, _YELLOW_("      lf em 410x_sweep 0F00000000 n 100 s 0x10000 c 32"));
+    return PM3_SUCCESS;
+}
 
 //////////////// 4205 / 4305 commands
 static int usage_lf_em4x05_dump(void) {
@@ -131,6 +150,29 @@ static int usage_lf_em4x05_dump(void) {
     PrintAndLogEx(NORMAL, "      lf em 4x05_dump f card1 11223344");
     return PM3_SUCCESS;
 }
+// position of `lf em 4x05_brute`, the arguments that go on from there
+#define EM4X05_BRUTE_CHECKPOINT "lf-4x05-brute.chk"
+
+static int usage_lf_em4x05_brute(void) {
+    PrintAndLogEx(NORMAL, "Bruteforce the EM4x05/EM4x69 password with a range or a dictionary, the device checks the login answers");
+    PrintAndLogEx(NORMAL, "a dictionary goes to the device " _YELLOW_("%u") " passwords at a time, hits are checked again", EM4X05_BRUTE_DICT_MAX);
+    PrintAndLogEx(NORMAL, "the position is saved to " _YELLOW_("%s") " while it runs, " _YELLOW_("r") " goes on from there", EM4X05_BRUTE_CHECKPOINT);
+    PrintAndLogEx(NORMAL, "press " _YELLOW_("'enter'") " to cancel the command");
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(NORMAL, "Usage:  lf em 4x05_brute [h] [s <start pwd>] [e <end pwd>] [f <*.dic> [o <offset>]] [r]");
+    PrintAndLogEx(NORMAL, "Options:");
+    PrintAndLogEx(NORMAL, "       h             - this help");
+    PrintAndLogEx(NORMAL, "       s <start pwd> - 4 byte hex value to start the search at, default 00000000");
+    PrintAndLogEx(NORMAL, "       e <end pwd>   - 4 byte hex value to end the search at, default FFFFFFFF");
+    PrintAndLogEx(NORMAL, "       f <*.dic>     - dictionary file instead of the range");
+    PrintAndLogEx(NORMAL, "       o <offset>    - first password of the dictionary to try, default 0");
+    PrintAndLogEx(NORMAL, "       r             - resume the last search");
+    PrintAndLogEx(NORMAL, "Examples:");
+    PrintAndLogEx(NORMAL, _YELLOW_("      lf em 4x05_brute s 00000000 e 0000FFFF"));
+    PrintAndLogEx(NORMAL, _YELLOW_("      lf em 4x05_brute f t55xx_default_pwds"));
+    PrintAndLogEx(NORMAL, _YELLOW_("      lf em 4x05_brute r"));
+    return PM3_SUCCESS;
+}
 static int usage_lf_em4x05_wipe(void) {
     PrintAndLogEx(NORMAL, "Wipe EM4x05/EM4x69.  Tag must be on antenna. ");
     PrintAndLogEx(NORMAL, "");
@@ -551,31 +593,95 @@ static int CmdEM410xBrute(const char *Cmd) {
         return PM3_ESOFT;
     }
 
-    PrintAndLogEx(SUCCESS, "Loaded "_YELLOW_("%d")" UIDs from "_YELLOW_("%s")", pause delay:"_YELLOW_("%d")" ms", uidcnt, filename, delay);
+    if (delay == 0 || delay > 0xFFFF) {
+        PrintAndLogEx(FAILED, "delay must be in range [1..65535] ms instead of: %u", delay);
+        free(uidBlock);
+        return PM3_EINVARG;
+    }
 
-    // loop
-    for (uint32_t c = 0; c < uidcnt; ++c) {
-        char testuid[11];
-        testuid[10] = 0;
+    PrintAndLogEx(SUCCESS, "Loaded "_YELLOW_("%d")" UIDs from "_YELLOW_("%s")", dwell:"_YELLOW_("%d")" ms, clock %d", uidcnt, filename, delay, clock1);
+    PrintAndLogEx(INFO, "Press pm3-button or " _GREEN_("Enter") " to abort");
 
-        if (kbd_enter_pressed()) {
-            PrintAndLogEx(WARNING, "\nAborted via keyboard!\n");
-            free(uidBlock);
-            return PM3_EOPABORTED;
-        }
+    // the device plays SIM_SWEEP_LIST_MAX ids per command
+    uint8_t data[PM3_CMD_DATA_SIZE] = {0};
+    sim_sweep_t *payload = (sim_sweep_t *)data;
+    payload->type = SIM_SWEEP_EM410X_LIST;
+    payload->clock = clock1;
+    payload->dwell = delay;
+    payload->step = uidcnt;
+
+    int res = PM3_SUCCESS;
+    for (uint32_t c = 0; c < uidcnt && res == PM3_SUCCESS; c += SIM_SWEEP_LIST_MAX) {
+        payload->count = MIN(SIM_SWEEP_LIST_MAX, uidcnt - c);
+        payload->start = c;
+        memcpy(data + sizeof(sim_sweep_t), uidBlock + 5 * c, payload->count * 5);
 
-        sprintf(testuid, "%010" PRIX64, bytes_to_num(uidBlock + 5 * c, 5));
-        PrintAndLogEx(NORMAL, "Bruteforce %d / %d: simulating UID  %s, clock %d", c + 1, uidcnt, testuid, clock1);
+        res = lf_sim_sweep_run(payload, sizeof(sim_sweep_t) + payload->count * 5);
+    }
+    free(uidBlock);
 
-        ConstructEM410xEmulGraph(testuid, clock1);
+    PrintAndLogEx(NORMAL, "");
+    if (res == PM3_EOPABORTED) {
+        PrintAndLogEx(WARNING, "Aborted");
+        return res;
+    }
+    if (res == PM3_SUCCESS)
+        PrintAndLogEx(SUCCESS, "Bruteforce done");
+    return res;
+}
 
-        CmdLFSim("0"); //240 start_gap.
+static int CmdEM410xSweep(const char *Cmd) {
+    char cmdp = tolower(param_getchar(Cmd, 0));
+    if (strlen(Cmd) == 0 || cmdp == 'h') return usage_lf_em410x_sweep();
 
-        msleep(delay);
+    uint8_t uid[5] = {0x00};
+    if (param_gethex(Cmd, 0, uid, 10)) {
+        PrintAndLogEx(FAILED, "UID must include 10 HEX symbols");
+        return PM3_EINVARG;
     }
 
-    free(uidBlock);
-    return PM3_SUCCESS;
+    sim_sweep_t payload = {
+        .type = SIM_SWEEP_EM410X,
+        .clock = 64,
+        .dwell = 500,
+        .step = 1,
+        .count = 256,
+        .start = bytes_to_num(uid, sizeof(uid)),
+    };
+
+    bool errors = false;
+    uint8_t idx = 1;
+    while (param_getchar(Cmd, idx) != 0x00 && errors == false) {
+        switch (tolower(param_getchar(Cmd, idx))) {
+            case 'n':
+                payload.count = param_get32ex(Cmd, idx + 1, 256, 0);
+                idx += 2;
+                break;
+            case 's':
+                payload.step = param_get32ex(Cmd, idx + 1, 1, 0);
+                idx += 2;
+                break;
+            case 'd':
+                payload.dwell = param_get32ex(Cmd, idx + 1, 500, 10);
+                idx += 2;
+                break;
+            case 'c':
+                payload.clock = param_get8ex(Cmd, idx + 1, 64, 10);
+                idx += 2;
+                break;
+            default:
+                PrintAndLogEx(WARNING, "Unknown parameter: " _YELLOW_("'%c'"), param_getchar(Cmd, idx));
+                errors = true;
+                break;
+        }
+    }
+
+    if (payload.count == 0 || payload.dwell == 0) errors = true;
+    if (errors) return usage_lf_em410x_sweep();
+
+    PrintAndLogEx(SUCCESS, "Sweeping " _YELLOW_("%u") " ids from " _YELLOW_("%010" PRIX64) ", step %u, %u ms each, clock %u"
+                  , payload.count, payload.start, payload.step, payload.dwell, payload.clock);
+    return lf_sim_sweep(&payload);
 }
 
 //currently only supports manchester modulations
@@ -882,6 +988,43 @@ static int EM4x05ReadWord_ext(uint8_t addr, uint32_t pwd, bool usePwd, uint32_t
     return demodEM4x05resp(word);
 }
 
+// Reads the words of mask with CMD_LF_EM4X_READ_ALL in one go, the words the device could not demodulate
+// are read again one by one with the client demodulators. ok gets a bit for each word read
+static int EM4x05ReadWords(uint16_t mask, uint32_t pwd, bool usePwd, uint32_t *words, uint16_t *ok) {
+
+    em4x05_read_all_req_t payload = {
+        .password = pwd,
+        .usepwd = usePwd,
+        .mask = mask,
+    };
+
+    *ok = 0;
+    clearCommandBuffer();
+    SendCommandNG(CMD_LF_EM4X_READ_ALL, (uint8_t *)&payload, sizeof(payload));
+    PacketResponseNG resp;
+    if (WaitForResponseTimeout(CMD_LF_EM4X_READ_ALL, &resp, 5000) && resp.length >= sizeof(em4x05_read_all_resp_t)) {
+        em4x05_read_all_resp_t *r = (em4x05_read_all_resp_t *)resp.data.asBytes;
+        *ok = r->ok & mask;
+        for (uint8_t addr = 0; addr < 16; addr++) {
+            if (*ok & (1 << addr))
+                words[addr] = r->words[addr];
+        }
+    }
+
+    int res = PM3_SUCCESS;
+    for (uint8_t addr = 0; addr < 16; addr++) {
+        if ((mask & (1 << addr)) == 0 || (*ok & (1 << addr)))
+            continue;
+
+        PrintAndLogEx(DEBUG, "word %u, client demod", addr);
+        if (EM4x05ReadWord_ext(addr, pwd, usePwd, &words[addr]) == PM3_SUCCESS)
+            *ok |= 1 << addr;
+        else
+            res = PM3_ESOFT;
+    }
+    return res;
+}
+
 static int CmdEM4x05Demod(const char *Cmd) {
 //    uint8_t ctmp = tolower(param_getchar(Cmd, 0));
 //   if (ctmp == 'h') return usage_lf_em4x05_demod();
@@ -921,32 +1064,26 @@ static int CmdEM4x05Dump(const char *Cmd) {
         };
     }
 
-    int success = PM3_SUCCESS;
-    int status;
     uint32_t lock_bits = 0x00; // no blocks locked
 
-    uint32_t word = 0;
     PrintAndLogEx(NORMAL, "Addr | data     | ascii |lck| info");
     PrintAndLogEx(NORMAL, "-----+----------+-------+---+-----");
 
-    // To flag any blocks locked we need to read blocks 14 and 15 first
-    // dont swap endin until we get block lock flags.
-    status = EM4x05ReadWord_ext(14, pwd, usePwd, &word);
-    if (status != PM3_SUCCESS)
-        success = PM3_ESOFT; // If any error ensure fail is set so not to save invalid data
-    if (word != 0x00)
-        lock_bits = word;
-    data[14] = word;
-
-    status = EM4x05ReadWord_ext(15, pwd, usePwd, &word);
-    if (status != PM3_SUCCESS)
-        success = PM3_ESOFT; // If any error ensure fail is set so not to save invalid data
-    if (word != 0x00) // assume block 15 is the current lock block
-        lock_bits = word;
-    data[15] = word;
-
-    // Now read blocks 0 - 13 as we have 14 and 15
-    for (; addr < 14; addr++) {
+    // all but the password in one go, dont swap endin until we get block lock flags.
+    uint32_t words[16] = {0};
+    uint16_t ok = 0;
+    int success = EM4x05ReadWords(0xFFFF & ~(1 << 2), pwd, usePwd, words, &ok);
+
+    // To flag any blocks locked we need blocks 14 and 15 first
+    data[14] = words[14];
+    if (words[14] != 0x00)
+        lock_bits = words[14];
+
+    data[15] = words[15];
+    if (words[15] != 0x00) // assume block 15 is the current lock block
+        lock_bits = words[15];
+
+    for (addr = 0; addr < 14; addr++) {
 
         if (addr == 2) {
             if (usePwd) {
@@ -958,21 +1095,19 @@ static int CmdEM4x05Dump(const char *Cmd) {
                 PrintAndLogEx(NORMAL, "  02 |          |       |   | " _RED_("cannot read"));
             }
         } else {
-            // success &= EM4x05ReadWord_ext(addr, pwd, usePwd, &word);
-            status = EM4x05ReadWord_ext(addr, pwd, usePwd, &word); // Get status for single read
-            if (status != PM3_SUCCESS)
-                success = PM3_ESOFT; // If any error ensure fail is set so not to save invalid data
-            data[addr] = BSWAP_32(word);
-            if (status == PM3_SUCCESS) {
-                num_to_bytes(word, 4, bytes);
-                PrintAndLogEx(NORMAL, "  %02d | %08X | %s  | %c |", addr, word, sprint_ascii(bytes, 4), ((lock_bits >> addr) & 1) ? 'x' : ' ');
+            data[addr] = BSWAP_32(words[addr]);
+            if (ok & (1 << addr)) {
+                num_to_bytes(words[addr], 4, bytes);
+                PrintAndLogEx(NORMAL, "  %02d | %08X | %s  | %c |", addr, words[addr], sprint_ascii(bytes, 4), ((lock_bits >> addr) & 1) ? 'x' : ' ');
             } else
                 PrintAndLogEx(NORMAL, "  %02d |          |       |   | " _RED_("Fail"), addr);
         }
     }
     // Print blocks 14 and 15
     // Both lock bits are protected with bit idx 14 (special case)
+    num_to_bytes(data[14], 4, bytes);
     PrintAndLogEx(NORMAL, "  %02d | %08X | %s  | %c | Lock", 14, data[14], sprint_ascii(bytes, 4), ((lock_bits >> 14) & 1) ? 'x' : ' ');
+    num_to_bytes(data[15], 4, bytes);
     PrintAndLogEx(NORMAL, "  %02d | %08X | %s  | %c | Lock", 15, data[15], sprint_ascii(bytes, 4), ((lock_bits >> 14) & 1) ? 'x' : ' ');
     // Update endian for files
     data[14] = BSWAP_32(data[14]);
@@ -991,6 +1126,227 @@ static int CmdEM4x05Dump(const char *Cmd) {
     return success;
 }
 
+// Runs a password search on the device, it only reports progress and hits. Every frame moves the checkpoint
+// on, the arguments that resume the search
+static int EM4x05BruteDevice(em4x05_brute_req_t *req, em4x05_brute_resp_t *out, const char *dict, uint32_t offset) {
+
+    memset(out, 0, sizeof(em4x05_brute_resp_t));
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_LF_EM4X_BRUTE, (uint8_t *)req, sizeof(em4x05_brute_req_t));
+
+    int res = PM3_SUCCESS;
+    uint8_t tries = 0;
+    for (;;) {
+        PacketResponseNG resp;
+        if (WaitForResponseTimeout(CMD_LF_EM4X_BRUTE, &resp, 1000) == false) {
+            tries++;
+            if (tries > 20) {
+                if (res == PM3_SUCCESS) {
+                    PrintAndLogEx(WARNING, "\ntimeout while waiting for reply.");
+                    SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+                    res = PM3_ETIMEOUT;
+                }
+                break;
+            }
+        } else {
+            tries = 0;
+            memcpy(out, resp.data.asBytes, sizeof(em4x05_brute_resp_t));
+
+            // the next one to try, a hit is tried again
+            uint32_t next = out->tried - ((out->found) ? 1 : 0);
+            FILE *f = fopen(EM4X05_BRUTE_CHECKPOINT, "w");
+            if (f) {
+                if (dict)
+                    fprintf(f, "f %s o %u\n", dict, offset + next);
+                else
+                    fprintf(f, "s %08X e %08X\n", req->start + next, req->end);
+                fclose(f);
+            }
+
+            if (out->final)
+                break;
+
+            PrintAndLogEx(INPLACE, "tried " _YELLOW_("%u") " passwords, last [ %08X ]", offset + out->tried, out->password);
+        }
+
+        if (res == PM3_SUCCESS && kbd_enter_pressed()) {
+            PrintAndLogEx(WARNING, "\naborted via keyboard.");
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            res = PM3_EOPABORTED;
+            // give the device a moment for its final frame
+            tries = 18;
+        }
+    }
+    PrintAndLogEx(NORMAL, "");
+    return res;
+}
+
+// a device side hit, the same login twice more
+static bool EM4x05BruteConfirm(uint32_t pwd) {
+    em4x05_brute_req_t req = { .start = pwd, .end = pwd };
+    em4x05_brute_resp_t resp;
+    for (uint8_t i = 0; i < 2; i++) {
+        clearCommandBuffer();
+        SendCommandNG(CMD_LF_EM4X_BRUTE, (uint8_t *)&req, sizeof(req));
+        PacketResponseNG pr;
+        if (WaitForResponseTimeout(CMD_LF_EM4X_BRUTE, &pr, 2000) == false)
+            return false;
+        memcpy(&resp, pr.data.asBytes, sizeof(resp));
+        if (resp.found == false)
+            return false;
+    }
+    return true;
+}
+
+static int CmdEM4x05Brute(const char *Cmd) {
+
+    uint32_t start_password = 0x00000000;
+    uint32_t end_password = 0xFFFFFFFF;
+    char filename[FILE_PATH_SIZE] = {0};
+    uint32_t offset = 0;
+    bool errors = false;
+    uint8_t cmdp = 0;
+
+    while (param_getchar(Cmd, cmdp) != 0x00 && !errors) {
+        switch (tolower(param_getchar(Cmd, cmdp))) {
+            case 'h':
+                return usage_lf_em4x05_brute();
+            case 's':
+                start_password = param_get32ex(Cmd, cmdp + 1, 0, 16);
+                cmdp += 2;
+                break;
+            case 'e':
+                end_password = param_get32ex(Cmd, cmdp + 1, 0, 16);
+                cmdp += 2;
+                break;
+            case 'f':
+                if (param_getstr(Cmd, cmdp + 1, filename, sizeof(filename)) == 0) {
+                    PrintAndLogEx(ERR, "Error, no filename after 'f' was found");
+                    errors = true;
+                }
+                cmdp += 2;
+                break;
+            case 'o':
+                offset = param_get32ex(Cmd, cmdp + 1, 0, 10);
+                cmdp += 2;
+                break;
+            case 'r': {
+                char line[FILE_PATH_SIZE + 32] = {0};
+                FILE *f = fopen(EM4X05_BRUTE_CHECKPOINT, "r");
+                if (f == NULL) {
+                    PrintAndLogEx(ERR, "Error, no search to resume in " _YELLOW_("%s"), EM4X05_BRUTE_CHECKPOINT);
+                    return PM3_EFILE;
+                }
+                if (fgets(line, sizeof(line), f) == NULL)
+                    line[0] = 0;
+                fclose(f);
+
+                line[strcspn(line, "\r\n")] = 0;
+                if (line[0] == 0 || tolower(line[0]) == 'r') {
+                    PrintAndLogEx(ERR, "Error, nothing to resume in " _YELLOW_("%s"), EM4X05_BRUTE_CHECKPOINT);
+                    return PM3_EFILE;
+                }
+                PrintAndLogEx(INFO, "Resuming " _YELLOW_("%s"), line);
+                return CmdEM4x05Brute(line);
+            }
+            default:
+                PrintAndLogEx(WARNING, "Unknown parameter '%c'", param_getchar(Cmd, cmdp));
+                errors = true;
+                break;
+        }
+    }
+
+    if (filename[0] == 0 && start_password > end_password)
+        errors = true;
+
+    if (errors) return usage_lf_em4x05_brute();
+
+    uint64_t t1 = msclock();
+    PrintAndLogEx(INFO, "press " _YELLOW_("`enter`") " to cancel");
+
+    em4x05_brute_req_t req = {
+        .start = start_password,
+        .end = end_password,
+    };
+    em4x05_brute_resp_t resp;
+    memset(&resp, 0, sizeof(resp));
+    bool found = false;
+    int res = PM3_SUCCESS;
+
+    if (filename[0]) {
+        uint8_t *keyBlock = NULL;
+        uint32_t keycount = 0;
+        res = loadFileDICTIONARY_safe(filename, (void **) &keyBlock, 4, &keycount);
+        if (res != PM3_SUCCESS || keycount == 0 || keyBlock == NULL) {
+            PrintAndLogEx(WARNING, "No keys found in file");
+            if (keyBlock != NULL)
+                free(keyBlock);
+            return PM3_ESOFT;
+        }
+
+        req.flags = EM4X05_BRUTE_DICT;
+
+        // the device takes as many passwords as fit in emulator memory at a time
+        for (uint32_t c = offset; c < keycount && found == false;) {
+
+            req.pwdcount = MIN(keycount - c, EM4X05_BRUTE_DICT_MAX);
+            PrintAndLogEx(INFO, "Testing passwords %u - %u of %u", c + 1, c + req.pwdcount, keycount);
+
+            if (SendToDeviceEML(keyBlock + 4 * c, 4 * req.pwdcount, 0) != PM3_SUCCESS) {
+                PrintAndLogEx(WARNING, "Failed to upload passwords");
+                free(keyBlock);
+                return PM3_ETIMEOUT;
+            }
+
+            res = EM4x05BruteDevice(&req, &resp, filename, c);
+            if (res != PM3_SUCCESS)
+                break;
+
+            if (resp.found) {
+                PrintAndLogEx(SUCCESS, "Found a candidate [ " _YELLOW_("%08X") " ]", resp.password);
+                found = EM4x05BruteConfirm(resp.password);
+                if (found == false)
+                    PrintAndLogEx(WARNING, "Candidate [ " _YELLOW_("%08X") " ] failed to verify", resp.password);
+            }
+
+            // on past a candidate that failed
+            c += (resp.found) ? resp.tried : req.pwdcount;
+        }
+        free(keyBlock);
+    } else {
+        PrintAndLogEx(INFO, "Search password range [%08X -> %08X]", start_password, end_password);
+
+        for (;;) {
+            res = EM4x05BruteDevice(&req, &resp, NULL, 0);
+            if (res != PM3_SUCCESS || resp.found == false)
+                break;
+
+            PrintAndLogEx(SUCCESS, "Found a candidate [ " _YELLOW_("%08X") " ]", resp.password);
+            found = EM4x05BruteConfirm(resp.password);
+            if (found || resp.password == end_password)
+                break;
+
+            PrintAndLogEx(WARNING, "Candidate [ " _YELLOW_("%08X") " ] failed to verify", resp.password);
+            req.start = resp.password + 1;
+        }
+    }
+
+    if (found) {
+        PrintAndLogEx(SUCCESS, "Found valid password: [ " _GREEN_("%08X") " ]", resp.password);
+        remove(EM4X05_BRUTE_CHECKPOINT);
+    } else if (res == PM3_SUCCESS) {
+        PrintAndLogEx(WARNING, "Bruteforce failed, last tried: [ " _YELLOW_("%08X") " ]", resp.password);
+        remove(EM4X05_BRUTE_CHECKPOINT);
+    } else {
+        PrintAndLogEx(INFO, "Resume with " _YELLOW_("`lf em 4x05_brute r`"));
+    }
+
+    t1 = msclock() - t1;
+    PrintAndLogEx(SUCCESS, "\ntime in bruteforce " _YELLOW_("%.0f") " seconds\n", (float)t1 / 1000.0);
+    return (res == PM3_EOPABORTED) ? PM3_SUCCESS : res;
+}
+
 static int CmdEM4x05Read(const char *Cmd) {
     uint8_t addr;
     uint32_t pwd;
@@ -1381,6 +1737,7 @@ static command_t CommandTable[] = {
     {"410x_read",   CmdEM410xRead,        IfPm3Lf,         "attempt to read and extract tag data"},
     {"410x_sim",    CmdEM410xSim,         IfPm3Lf,         "simulate EM410x tag"},
     {"410x_brute",  CmdEM410xBrute,       IfPm3Lf,         "reader bruteforce attack by simulating EM410x tags"},
+    {"410x_sweep",  CmdEM410xSweep,       IfPm3Lf,         "reader bruteforce attack with a device side range of EM410x ids"},
     {"410x_watch",  CmdEM410xWatch,       IfPm3Lf,         "watches for EM410x 125/134 kHz tags (option 'h' for 134)"},
     {"410x_spoof",  CmdEM410xWatchnSpoof, IfPm3Lf,         "watches for EM410x 125/134 kHz tags, and replays them. (option 'h' for 134)" },
     {"410x_write",  CmdEM410xWrite,       IfPm3Lf,         "write EM410x UID to T55x7 or Q5/T5555 tag"},
@@ -1391,6 +1748,7 @@ static command_t CommandTable[] = {
     {"4x05_info",   CmdEM4x05Info,        IfPm3Lf,         "tag information EM4x05/EM4x69"},
     {"4x05_read",   CmdEM4x05Read,        IfPm3Lf,         "read word data from EM4x05/EM4x69"},
     {"4x05_write",  CmdEM4x05Write,       IfPm3Lf,         "write word data to EM4x05/EM4x69"},
+    {"4x05_brute",  CmdEM4x05Brute,       IfPm3Lf,         "guess password of EM4x05/EM4x69 on the device"},
     {"----------",  CmdHelp,              AlwaysAvailable,         "----------------------- " _CYAN_("EM 4x50") " -----------------------"},
     {"4x50_dump",   CmdEM4x50Dump,        IfPm3EM4x50,     "dump EM4x50 tag"},
     {"4x50_info",   CmdEM4x50Info,        IfPm3EM4x50,     "tag information EM4x50"},
@@ -1398,6 +1756,7 @@ static command_t CommandTable[] = {
     {"4x50_write_password", CmdEM4x50WritePassword, IfPm3EM4x50, "change passwword of EM4x50 tag"},
     {"4x50_read",   CmdEM4x50Read,        IfPm3EM4x50,     "read word data from EM4x50"},
     {"4x50_wipe",   CmdEM4x50Wipe,        IfPm3EM4x50,     "wipe data from EM4x50"},
+    {"4x50_brute",  CmdEM4x50Brute,       IfPm3EM4x50,     "guess password of EM4x50 on the device"},
     {NULL, NULL, NULL, NULL}
 };
 
@@ -14,6 +14,8 @@
 #include "comms.h"
 #include "commonutil.h"
 #include "em4x50.h"
+#include "util.h"
+#include "util_posix.h"
 
 static int usage_lf_em4x50_info(void) {
     PrintAndLogEx(NORMAL, "Read all information of EM4x50. Tag nust be on antenna.");
@@ -60,14 +62,16 @@ static int usage_lf_em4x50_write_password(void) {
 static int usage_lf_em4x50_read(void) {
     PrintAndLogEx(NORMAL, "Read EM4x50 word(s). Tag must be on antenna.");
     PrintAndLogEx(NORMAL, "");
-    PrintAndLogEx(NORMAL, "Usage:  lf em 4x50_read [h] [a <address>] [p <pwd>]");
+    PrintAndLogEx(NORMAL, "Usage:  lf em 4x50_read [h] [a <address>] [e <address>] [p <pwd>]");
     PrintAndLogEx(NORMAL, "Options:");
     PrintAndLogEx(NORMAL, "       h         - this help");
     PrintAndLogEx(NORMAL, "       a <addr>  - memory address to read (dec) (optional)");
+    PrintAndLogEx(NORMAL, "       e <addr>  - last address, reads all words from a to e in one go (dec) (optional)");
     PrintAndLogEx(NORMAL, "       p <pwd>   - password (hex) (optional)");
     PrintAndLogEx(NORMAL, "Examples:");
     PrintAndLogEx(NORMAL, _YELLOW_("      lf em 4x50_read"));
     PrintAndLogEx(NORMAL, _YELLOW_("      lf em 4x50_read a 2 p 00000000"));
+    PrintAndLogEx(NORMAL, _YELLOW_("      lf em 4x50_read a 1 e 31 p 00000000"));
     PrintAndLogEx(NORMAL, "");
     return PM3_SUCCESS;
 }
@@ -98,6 +102,25 @@ static int usage_lf_em4x50_wipe(void) {
     return PM3_SUCCESS;
 }
 
+static int usage_lf_em4x50_brute(void) {
+    PrintAndLogEx(NORMAL, "Guess password of EM4x50 tag on the device. Tag must be on antenna.");
+    PrintAndLogEx(NORMAL, "When interrupted (button, enter) the command to resume the search is printed.");
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(NORMAL, "Usage:  lf em 4x50_brute [h] [b <pwd>] [e <pwd>] [s <spiffs file>] [r <index>]");
+    PrintAndLogEx(NORMAL, "Options:");
+    PrintAndLogEx(NORMAL, "       h         - this help");
+    PrintAndLogEx(NORMAL, "       b <pwd>   - first password of range (hex) (default 00000000)");
+    PrintAndLogEx(NORMAL, "       e <pwd>   - last password of range (hex) (default FFFFFFFF)");
+    PrintAndLogEx(NORMAL, "       s <file>  - use password dictionary in SPIFFS instead of range (s. `mem spiffs load p`)");
+    PrintAndLogEx(NORMAL, "       r <index> - resume dictionary at given index (dec)");
+    PrintAndLogEx(NORMAL, "Examples:");
+    PrintAndLogEx(NORMAL, _YELLOW_("      lf em 4x50_brute b 00000000 e 0000FFFF"));
+    PrintAndLogEx(NORMAL, _YELLOW_("      lf em 4x50_brute s em4x50_pwds.bin"));
+    PrintAndLogEx(NORMAL, _YELLOW_("      lf em 4x50_brute s em4x50_pwds.bin r 120"));
+    PrintAndLogEx(NORMAL, "");
+    return PM3_SUCCESS;
+}
+
 static void prepare_result(const uint8_t *byte, int fwr, int lwr, em4x50_word_t *words) {
 
     // restructure received result in "em4x50_word_t" structure and check all
@@ -539,8 +562,9 @@ int em4x50_read(em4x50_data_t *etd, em4x50_word_t *out, bool verbose) {
 
     uint8_t *data = resp.data.asBytes;
     em4x50_word_t words[EM4X50_NO_WORDS];
+    int lwr = MAX(edata.address, edata.addresses[2]);
     if (edata.addr_given) {
-        prepare_result(data, etd->address, etd->address, words);
+        prepare_result(data, edata.address, lwr, words);
     } else {
         int now = (resp.status & STATUS_NO_WORDS) >> 2;
         prepare_result(data, 0, now - 1, words);
@@ -550,16 +574,14 @@ int em4x50_read(em4x50_data_t *etd, em4x50_word_t *out, bool verbose) {
         memcpy(out, &words, sizeof(em4x50_word_t) * EM4X50_NO_WORDS);
     }
 
-    print_result(words, etd->address, etd->address);
+    print_result(words, edata.address, lwr);
     return PM3_SUCCESS;
 }
 
 int CmdEM4x50Read(const char *Cmd) {
 
-    em4x50_data_t etd;
-    etd.pwd_given = false;
-    etd.addr_given = false;
-    etd.newpwd_given = false;
+    em4x50_data_t etd = { .pwd_given = false, .addr_given = false, .newpwd_given = false };
+    uint8_t lwr = 0;
 
     bool errors = false;
     uint8_t cmdp = 0;
@@ -581,6 +603,17 @@ int CmdEM4x50Read(const char *Cmd) {
                 cmdp += 2;
                 break;
             }
+            case 'e': {
+                param_getdec(Cmd, cmdp + 1, &lwr);
+
+                // validation
+                if (lwr <= 0 || lwr >= EM4X50_NO_WORDS) {
+                    PrintAndLogEx(FAILED, "\n  error, last address has to be in range [1-33]\n");
+                    return PM3_EINVARG;
+                }
+                cmdp += 2;
+                break;
+            }
             case 'p': {
                 if (param_gethex(Cmd, cmdp + 1, etd.password, 8)) {
                     PrintAndLogEx(FAILED, "\n  password has to be 8 hex symbols\n");
@@ -601,6 +634,14 @@ int CmdEM4x50Read(const char *Cmd) {
     if (errors || strlen(Cmd) == 0 || etd.addr_given == false)
         return usage_lf_em4x50_read();
 
+    if (lwr != 0 && lwr < etd.address) {
+        PrintAndLogEx(FAILED, "\n  error, last address has to be greater or equal first address\n");
+        return PM3_EINVARG;
+    }
+
+    // selective read layout: addresses[2] = last word read
+    etd.addresses[2] = lwr;
+
     return em4x50_read(&etd, NULL, true);
 }
 
@@ -740,3 +781,124 @@ int CmdEM4x50Wipe(const char *Cmd) {
 
     return PM3_SUCCESS;
 }
+
+int CmdEM4x50Brute(const char *Cmd) {
+
+    // password search on the device, passwords are tried out of a range or
+    // a dictionary in SPIFFS; the device reports its position once a second
+
+    em4x50_brute_req_t req;
+    memset(&req, 0, sizeof(req));
+    req.last = 0xFFFFFFFF;
+
+    bool errors = false;
+    uint8_t cmdp = 0;
+    while (param_getchar(Cmd, cmdp) != 0x00 && !errors) {
+
+        switch (tolower(param_getchar(Cmd, cmdp))) {
+            case 'h':
+                return usage_lf_em4x50_brute();
+
+            case 'b':
+            case 'e': {
+                uint8_t pwd[4] = {0};
+                if (param_gethex(Cmd, cmdp + 1, pwd, 8)) {
+                    PrintAndLogEx(FAILED, "\n  password has to be 8 hex symbols\n");
+                    return PM3_EINVARG;
+                }
+                if (tolower(param_getchar(Cmd, cmdp)) == 'b')
+                    req.first = bytes_to_num(pwd, 4);
+                else
+                    req.last = bytes_to_num(pwd, 4);
+                cmdp += 2;
+                break;
+            }
+
+            case 's':
+                if (param_getstr(Cmd, cmdp + 1, (char *)req.filename, sizeof(req.filename)) == 0) {
+                    PrintAndLogEx(FAILED, "\n  SPIFFS filename missing or invalid\n");
+                    return PM3_EINVARG;
+                }
+                cmdp += 2;
+                break;
+
+            case 'r':
+                req.skip = param_get32ex(Cmd, cmdp + 1, 0, 10);
+                cmdp += 2;
+                break;
+
+            default:
+                PrintAndLogEx(WARNING, "\n  Unknown parameter '%c'\n", param_getchar(Cmd, cmdp));
+                errors = true;
+                break;
+        }
+    }
+
+    if (errors || req.first > req.last)
+        return usage_lf_em4x50_brute();
+
+    bool bdict = (req.filename[0] != 0);
+    if (bdict)
+        PrintAndLogEx(INFO, "trying passwords of " _YELLOW_("%s") " from index %u", req.filename, req.skip);
+    else
+        PrintAndLogEx(INFO, "trying passwords " _YELLOW_("%08X") " - " _YELLOW_("%08X"), req.first, req.last);
+    PrintAndLogEx(INFO, "press " _YELLOW_("pm3 button") " or " _YELLOW_("Enter") " to abort");
+
+    uint64_t start_time = msclock();
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_LF_EM4X50_BRUTE, (uint8_t *)&req, sizeof(req));
+
+    bool aborted = false;
+    PacketResponseNG resp;
+    em4x50_brute_resp_t *result = (em4x50_brute_resp_t *)resp.data.asBytes;
+    while (true) {
+        if (WaitForResponseTimeout(CMD_LF_EM4X50_BRUTE, &resp, 2 * TIMEOUT + 1000) == false) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            PrintAndLogEx(WARNING, "\ntimeout while waiting for reply.\n");
+            return PM3_ETIMEOUT;
+        }
+
+        // any command stops the device loop
+        if (aborted == false && kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            aborted = true;
+        }
+
+        if (result->final)
+            break;
+
+        float pwds_per_second = (float)result->checked / ((msclock() - start_time) / 1000.0);
+        PrintAndLogEx(INPLACE, "%8u passwords | %5.1f passwords/sec | next " _YELLOW_("%08X"), result->checked, pwds_per_second, result->next);
+    }
+    PrintAndLogEx(NORMAL, "");
+
+    if (resp.status == PM3_EFILE) {
+        PrintAndLogEx(FAILED, "no such file in SPIFFS, list with " _YELLOW_("`mem spiffs tree`"));
+        return resp.status;
+    }
+
+    if (resp.status != PM3_SUCCESS && resp.status != PM3_EOPABORTED) {
+        PrintAndLogEx(FAILED, "password search " _RED_("failed"));
+        return resp.status;
+    }
+
+    PrintAndLogEx(INFO, "tried " _YELLOW_("%u") " passwords in %.1fs", result->checked, (float)((msclock() - start_time) / 1000.0));
+
+    if (result->found) {
+        PrintAndLogEx(SUCCESS, "found valid password [ " _GREEN_("%s") " ]", sprint_hex_inrow(result->password, 4));
+        return PM3_SUCCESS;
+    }
+
+    if (resp.status == PM3_EOPABORTED) {
+        PrintAndLogEx(INFO, "aborted, resume with");
+        if (bdict)
+            PrintAndLogEx(INFO, _YELLOW_("      lf em 4x50_brute s %s r %u"), req.filename, result->next);
+        else
+            PrintAndLogEx(INFO, _YELLOW_("      lf em 4x50_brute b %08X e %08X"), result->next, req.last);
+        return PM3_EOPABORTED;
+    }
+
+    PrintAndLogEx(FAILED, "no valid password found");
+    return PM3_ESOFT;
+}
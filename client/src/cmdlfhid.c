@@ -21,6 +21,7 @@
 #include "cmdlfhid.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <ctype.h>
@@ -107,6 +108,26 @@ static int usage_lf_hid_brute(void) {
     return PM3_SUCCESS;
 }
 
+static int usage_lf_hid_sweep(void) {
+    PrintAndLogEx(NORMAL, "Bruteforce of HID readers with a range of H10301 26 bit card numbers, the loop runs on the device.");
+    PrintAndLogEx(NORMAL, "Dwell time counts reader field time, the sweep waits while there is no field");
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(NORMAL, "Usage:  lf hid sweep [h] f <facility-code> [c <cardnumber>] [n <count>] [s <step>] [d <ms>]");
+    PrintAndLogEx(NORMAL, "Options:");
+    PrintAndLogEx(NORMAL, "       h                 :  This help");
+    PrintAndLogEx(NORMAL, "       f <facility-code> :  facility code");
+    PrintAndLogEx(NORMAL, "       c <cardnumber>    :  card number to start with, default 0");
+    PrintAndLogEx(NORMAL, "       n <count>         :  number of card numbers, default 65536");
+    PrintAndLogEx(NORMAL, "       s <step>          :  added to the card number for the next one, default 1");
+    PrintAndLogEx(NORMAL, "       d <ms>            :  dwell time per card number in ms. Default 500ms");
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(NORMAL, "Examples:");
+    PrintAndLogEx(NORMAL, _YELLOW_("       lf hid sweep f 224"));
+    PrintAndLogEx(NORMAL, _YELLOW_("       lf hid sweep f 21 c 200 n 100 d 300"));
+    PrintAndLogEx(NORMAL, "");
+    return PM3_SUCCESS;
+}
+
 // sending three times.  Didn't seem to break the previous sim?
 static int sendPing(void) {
     SendCommandNG(CMD_PING, NULL, 0);
@@ -163,10 +184,15 @@ static int CmdHIDDemod(const char *Cmd) {
     //raw fsk demod no manchester decoding no start bit finding just get binary from wave
     uint32_t hi2 = 0, hi = 0, lo = 0;
 
-    uint8_t bits[GraphTraceLen];
+    uint8_t *bits = calloc(GraphTraceLen + 1, sizeof(uint8_t));
+    if (bits == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
     size_t size = getFromGraphBuf(bits);
     if (size == 0) {
         PrintAndLogEx(DEBUG, "DEBUG: Error - " _RED_("HID not enough samples"));
+        free(bits);
         return PM3_ESOFT;
     }
     //get binary from fsk wave
@@ -187,10 +213,12 @@ static int CmdHIDDemod(const char *Cmd) {
         else
             PrintAndLogEx(DEBUG, "DEBUG: Error - " _RED_("HID error demoding fsk %d"), idx);
 
+        free(bits);
         return PM3_ESOFT;
     }
 
     setDemodBuff(bits, size, idx);
+    free(bits);
     setClockGrid(50, waveIdx + (idx * 50));
 
     if (hi2 == 0 && hi == 0 && lo == 0) {
@@ -541,6 +569,58 @@ static int CmdHIDBrute(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+static int CmdHIDSweep(const char *Cmd) {
+
+    sim_sweep_t payload = {
+        .type = SIM_SWEEP_HID26,
+        .dwell = 500,
+        .step = 1,
+        .count = 0x10000,
+        .start = 0,
+    };
+
+    bool errors = false, has_fc = false;
+    uint8_t cmdp = 0;
+    while (param_getchar(Cmd, cmdp) != 0x00 && errors == false) {
+        switch (tolower(param_getchar(Cmd, cmdp))) {
+            case 'h':
+                return usage_lf_hid_sweep();
+            case 'f':
+                payload.fc = param_get8ex(Cmd, cmdp + 1, 0, 10);
+                has_fc = true;
+                cmdp += 2;
+                break;
+            case 'c':
+                payload.start = param_get32ex(Cmd, cmdp + 1, 0, 10) & 0xFFFF;
+                cmdp += 2;
+                break;
+            case 'n':
+                payload.count = param_get32ex(Cmd, cmdp + 1, 0x10000, 10);
+                cmdp += 2;
+                break;
+            case 's':
+                payload.step = param_get32ex(Cmd, cmdp + 1, 1, 10);
+                cmdp += 2;
+                break;
+            case 'd':
+                payload.dwell = param_get32ex(Cmd, cmdp + 1, 500, 10);
+                cmdp += 2;
+                break;
+            default:
+                PrintAndLogEx(WARNING, "Unknown parameter: " _YELLOW_("'%c'"), param_getchar(Cmd, cmdp));
+                errors = true;
+                break;
+        }
+    }
+
+    if (has_fc == false || payload.count == 0 || payload.dwell == 0) errors = true;
+    if (errors) return usage_lf_hid_sweep();
+
+    PrintAndLogEx(SUCCESS, "Sweeping " _YELLOW_("%u") " card numbers of facility " _YELLOW_("%u") " from " _YELLOW_("%" PRIu64) ", step %u, %u ms each"
+                  , payload.count, payload.fc, payload.start, payload.step, payload.dwell);
+    return lf_sim_sweep(&payload);
+}
+
 static command_t CommandTable[] = {
     {"help",    CmdHelp,        AlwaysAvailable, "this help"},
     {"demod",   CmdHIDDemod,    AlwaysAvailable, "demodulate HID Prox tag from the GraphBuffer"},
@@ -548,6 +628,7 @@ static command_t CommandTable[] = {
     {"clone",   CmdHIDClone,    IfPm3Lf,         "clone HID tag to T55x7"},
     {"sim",     CmdHIDSim,      IfPm3Lf,         "simulate HID tag"},
     {"brute",   CmdHIDBrute,    IfPm3Lf,         "bruteforce card number against reader"},
+    {"sweep",   CmdHIDSweep,    IfPm3Lf,         "device side card number sweep against reader"},
     {"watch",   CmdHIDWatch,    IfPm3Lf,         "continuously watch for cards.  Reader mode"},
     {NULL, NULL, NULL, NULL}
 };
@@ -19,6 +19,7 @@
 #include "hitag.h"
 #include "fileutils.h"  // savefile
 #include "protocols.h"  // defines
+#include "hitag2/hitag2_crack.h"
 
 static int CmdHelp(const char *Cmd);
 
@@ -126,6 +127,7 @@ static int usage_hitag_writer(void) {
     PrintAndLogEx(NORMAL, "   HitagS (0*)");
     PrintAndLogEx(NORMAL, "      03 <nr,ar> <page> <byte0...byte3>      Write page, challenge mode");
     PrintAndLogEx(NORMAL, "      04 <key> <page> <byte0...byte3>        Write page, crypto mode. Set key=0 for no auth");
+    PrintAndLogEx(NORMAL, "                                             More <byte0...byte3> go to the next pages in the same session");
     PrintAndLogEx(NORMAL, "   Hitag1 (1*)");
     PrintAndLogEx(NORMAL, "      Not implemented");
     PrintAndLogEx(NORMAL, "   Hitag2 (2*)");
@@ -480,6 +482,26 @@ static void printHitagConfiguration(uint8_t config) {
     PrintAndLogEx(INFO, "------------------------------------");
 }
 
+static int usage_hitag_crack(void) {
+    PrintAndLogEx(NORMAL, "Recover a Hitag2 key from reader authentications. The device simulates a Hitag2 tag and");
+    PrintAndLogEx(NORMAL, "collects the nR aR pairs a reader sends to it, the client then runs the ht2crack4 attack.");
+    PrintAndLogEx(NORMAL, "Hold the reader against the antenna until enough pairs are collected or press " _YELLOW_("`enter`"));
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(NORMAL, "Usage:   lf hitag crack [h] [u <uid>] [n <count>] [f <filename>] [t <table size>]");
+    PrintAndLogEx(NORMAL, "Options:");
+    PrintAndLogEx(NORMAL, "       h              This help");
+    PrintAndLogEx(NORMAL, "       u <uid>        UID to simulate, 4 hex bytes. Default: UID of the tag on the antenna");
+    PrintAndLogEx(NORMAL, "       n <count>      Number of nR aR pairs to collect, %u - %u. Default: %u", HT2_CRACK_MIN_NONCES, HT2_CRACK_MAX_NONCES, HT2_CRACK_MAX_NONCES);
+    PrintAndLogEx(NORMAL, "       f <filename>   Load nR aR pairs from a text file, one hex pair per line, instead of collecting (needs u)");
+    PrintAndLogEx(NORMAL, "       t <size>       Key guesses kept per round. Default: %u", HT2_CRACK_TABLE_SIZE);
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(NORMAL, "Examples:");
+    PrintAndLogEx(NORMAL, "         lf hitag crack");
+    PrintAndLogEx(NORMAL, "         lf hitag crack u 01020304 n 16");
+    PrintAndLogEx(NORMAL, "         lf hitag crack u 01020304 f nrar.txt");
+    return PM3_SUCCESS;
+}
+
 static bool getHitagUid(uint32_t *uid) {
     hitag_data htd;
     memset(&htd, 0, sizeof(htd));
@@ -599,6 +621,14 @@ static int CmdLFHitagReader(const char *Cmd) {
     uint8_t *data = resp.data.asBytes;
     PrintAndLogEx(SUCCESS, " UID: " _YELLOW_("%08x"), id);
 
+    // HitagS, all the pages of the session
+    if (cmd == CMD_LF_HITAGS_READ) {
+        uint32_t pages = MIN(resp.oldarg[1], 64);
+        for (uint32_t i = 0; i < pages; i++)
+            PrintAndLogEx(SUCCESS, "Page[%2u]: %s", i, sprint_hex(data + i * 4, 4));
+        return PM3_SUCCESS;
+    }
+
     if (htf != RHT2F_UID_ONLY) {
 
         // block3, 1 byte
@@ -660,12 +690,19 @@ static int CmdLFHitagWriter(const char *Cmd) {
     hitag_data htd;
     hitag_function htf = param_get32ex(Cmd, 0, 0, 10);
 
+    // HitagS, the pages after the first one follow hitag_data
+    uint8_t buf[sizeof(hitag_data) + 63 * 4] = {0};
+    uint32_t arg1 = 1;
     uint32_t arg2 = 0;
     switch (htf) {
         case WHTSF_CHALLENGE: {
             num_to_bytes(param_get64ex(Cmd, 1, 0, 16), 8, htd.auth.NrAr);
             arg2 = param_get32ex(Cmd, 2, 0, 10);
             num_to_bytes(param_get32ex(Cmd, 3, 0, 16), 4, htd.auth.data);
+            while (arg1 < 64 && param_getlength(Cmd, 3 + arg1)) {
+                num_to_bytes(param_get32ex(Cmd, 3 + arg1, 0, 16), 4, buf + sizeof(hitag_data) + (arg1 - 1) * 4);
+                arg1++;
+            }
             break;
         }
         case WHTSF_KEY:
@@ -673,6 +710,10 @@ static int CmdLFHitagWriter(const char *Cmd) {
             num_to_bytes(param_get64ex(Cmd, 1, 0, 16), 6, htd.crypto.key);
             arg2 = param_get32ex(Cmd, 2, 0, 10);
             num_to_bytes(param_get32ex(Cmd, 3, 0, 16), 4, htd.crypto.data);
+            while (htf == WHTSF_KEY && arg1 < 64 && param_getlength(Cmd, 3 + arg1)) {
+                num_to_bytes(param_get32ex(Cmd, 3 + arg1, 0, 16), 4, buf + sizeof(hitag_data) + (arg1 - 1) * 4);
+                arg1++;
+            }
             break;
         }
         case WHT2F_PASSWORD: {
@@ -694,10 +735,11 @@ static int CmdLFHitagWriter(const char *Cmd) {
             return usage_hitag_writer();
     }
 
+    memcpy(buf, &htd, sizeof(htd));
     clearCommandBuffer();
-    SendCommandMIX(CMD_LF_HITAGS_WRITE, htf, 0, arg2, &htd, sizeof(htd));
+    SendCommandMIX(CMD_LF_HITAGS_WRITE, htf, arg1, arg2, buf, sizeof(htd) + (arg1 - 1) * 4);
     PacketResponseNG resp;
-    if (!WaitForResponseTimeout(CMD_ACK, &resp, 4000)) {
+    if (!WaitForResponseTimeout(CMD_ACK, &resp, 4000 + (arg1 - 1) * 100)) {
         PrintAndLogEx(WARNING, "timeout while waiting for reply.");
         return PM3_ETIMEOUT;
     }
@@ -709,6 +751,195 @@ static int CmdLFHitagWriter(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// Collects reader authentications with the device acting as a Hitag2 tag with this uid
+static int hitag2_collect_nonces(uint32_t uid, uint8_t *nrar, uint32_t max, uint32_t *count) {
+
+    lf_hitag2_nonces_t payload;
+    num_to_bytes(uid, 4, payload.uid);
+
+    PrintAndLogEx(INFO, "Simulating Hitag2 UID " _YELLOW_("%08X") ", present the reader now", uid);
+    PrintAndLogEx(INFO, "press " _YELLOW_("`enter`") " to stop collecting");
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_LF_HITAG2_NONCES, (uint8_t *)&payload, sizeof(payload));
+
+    *count = 0;
+    int res = PM3_SUCCESS;
+    bool stopped = false;
+    uint8_t tries = 0;
+    for (;;) {
+        PacketResponseNG resp;
+        if (WaitForResponseTimeout(CMD_LF_HITAG2_NONCES, &resp, 1000) == false) {
+            // the reader may take its time, only a stopped device has to answer
+            if (stopped && ++tries > 3) {
+                PrintAndLogEx(WARNING, "\ntimeout while waiting for reply.");
+                break;
+            }
+        } else {
+            lf_hitag2_nonce_t *nonce = (lf_hitag2_nonce_t *)resp.data.asBytes;
+            if (nonce->final) {
+                if (resp.status == PM3_EOPABORTED && res == PM3_SUCCESS)
+                    res = PM3_EOPABORTED;
+                break;
+            }
+
+            // readers repeat a failed authentication, each pair only counts once
+            bool known = false;
+            for (uint32_t i = 0; i < *count; i++) {
+                if (memcmp(nrar + i * 8, nonce->nrar, 8) == 0) {
+                    known = true;
+                    break;
+                }
+            }
+            if (known == false && *count < max) {
+                memcpy(nrar + *count * 8, nonce->nrar, 8);
+                (*count)++;
+            }
+            PrintAndLogEx(INPLACE, "collected " _YELLOW_("%u") " / %u pairs, last nR aR [ %s]", *count, max, sprint_hex(nonce->nrar, 8));
+        }
+
+        if (stopped)
+            continue;
+
+        if (*count >= max) {
+            stopped = true;
+        } else if (kbd_enter_pressed()) {
+            PrintAndLogEx(WARNING, "\ncollecting stopped via keyboard.");
+            stopped = true;
+        }
+
+        if (stopped)
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+    }
+    PrintAndLogEx(NORMAL, "");
+
+    if (res == PM3_EOPABORTED)
+        PrintAndLogEx(WARNING, "aborted via button.");
+    return res;
+}
+
+// nR aR pairs as the ht2crack tools take them, two hex values per line
+static int hitag2_load_nonces(const char *filename, uint8_t *nrar, uint32_t max, uint32_t *count) {
+    FILE *f = fopen(filename, "r");
+    if (f == NULL) {
+        PrintAndLogEx(WARNING, "file not found or locked. '" _YELLOW_("%s") "'", filename);
+        return PM3_EFILE;
+    }
+
+    *count = 0;
+    char line[80];
+    while (*count < max && fgets(line, sizeof(line), f)) {
+        uint32_t nr, ar;
+        if (line[0] == '#' || sscanf(line, "%x %x", &nr, &ar) != 2)
+            continue;
+        num_to_bytes(nr, 4, nrar + *count * 8);
+        num_to_bytes(ar, 4, nrar + *count * 8 + 4);
+        (*count)++;
+    }
+    fclose(f);
+
+    PrintAndLogEx(SUCCESS, "loaded " _YELLOW_("%u") " nR aR pairs from " _YELLOW_("%s"), *count, filename);
+    return PM3_SUCCESS;
+}
+
+static int CmdLFHitagCrack(const char *Cmd) {
+
+    char filename[FILE_PATH_SIZE] = {0};
+    uint8_t uidbytes[4] = {0};
+    uint32_t uid = 0;
+    bool uid_given = false;
+    uint32_t max = HT2_CRACK_MAX_NONCES;
+    uint32_t table_size = HT2_CRACK_TABLE_SIZE;
+    bool errors = false;
+    uint8_t cmdp = 0;
+
+    while (param_getchar(Cmd, cmdp) != 0x00 && !errors) {
+        switch (tolower(param_getchar(Cmd, cmdp))) {
+            case 'h':
+                return usage_hitag_crack();
+            case 'u':
+                if (param_gethex(Cmd, cmdp + 1, uidbytes, 8)) {
+                    PrintAndLogEx(WARNING, "UID must be 4 hex bytes");
+                    errors = true;
+                    break;
+                }
+                uid = bytes_to_num(uidbytes, 4);
+                uid_given = true;
+                cmdp += 2;
+                break;
+            case 'n':
+                max = param_get32ex(Cmd, cmdp + 1, HT2_CRACK_MAX_NONCES, 10);
+                if (max < HT2_CRACK_MIN_NONCES || max > HT2_CRACK_MAX_NONCES) {
+                    PrintAndLogEx(WARNING, "count must be %u - %u", HT2_CRACK_MIN_NONCES, HT2_CRACK_MAX_NONCES);
+                    errors = true;
+                }
+                cmdp += 2;
+                break;
+            case 'f':
+                if (param_getstr(Cmd, cmdp + 1, filename, sizeof(filename)) == 0)
+                    errors = true;
+                cmdp += 2;
+                break;
+            case 't':
+                table_size = param_get32ex(Cmd, cmdp + 1, HT2_CRACK_TABLE_SIZE, 10);
+                if (table_size < 0x20000) {
+                    PrintAndLogEx(WARNING, "table size must be at least %u", 0x20000);
+                    errors = true;
+                }
+                cmdp += 2;
+                break;
+            default:
+                PrintAndLogEx(WARNING, "Unknown parameter '%c'", param_getchar(Cmd, cmdp));
+                errors = true;
+                break;
+        }
+    }
+
+    if (errors) return usage_hitag_crack();
+
+    bool from_file = (filename[0] != 0x00);
+    if (from_file && uid_given == false) {
+        PrintAndLogEx(WARNING, "loading pairs from a file needs the UID");
+        return usage_hitag_crack();
+    }
+
+    if (from_file == false && IfPm3Hitag() == false) {
+        PrintAndLogEx(WARNING, "collecting pairs needs a device with Hitag support, use " _YELLOW_("`f`") " for a file");
+        return PM3_ENOTTY;
+    }
+
+    if (uid_given == false && getHitagUid(&uid) == false) {
+        PrintAndLogEx(WARNING, "no tag found, give the UID to simulate with " _YELLOW_("`u`"));
+        return PM3_ESOFT;
+    }
+
+    uint8_t nrar[HT2_CRACK_MAX_NONCES * 8] = {0};
+    uint32_t count = 0;
+    int res;
+    if (from_file)
+        res = hitag2_load_nonces(filename, nrar, max, &count);
+    else
+        res = hitag2_collect_nonces(uid, nrar, max, &count);
+
+    if (res != PM3_SUCCESS)
+        return res;
+
+    if (count < HT2_CRACK_MIN_NONCES) {
+        PrintAndLogEx(FAILED, "only %u nR aR pairs, need at least %u", count, HT2_CRACK_MIN_NONCES);
+        return PM3_ENODATA;
+    }
+
+    uint64_t key = 0;
+    res = ht2_crack_nonces(uid, nrar, count, table_size, &key);
+    if (res == PM3_SUCCESS) {
+        PrintAndLogEx(SUCCESS, "found key [ " _GREEN_("%012" PRIX64) " ]", key);
+        PrintAndLogEx(HINT, "try " _YELLOW_("`lf hitag reader 23 %012" PRIX64 "`"), key);
+    } else if (res == PM3_ESOFT) {
+        PrintAndLogEx(FAILED, "key not found, try more pairs or a bigger table");
+    }
+    return res;
+}
+
 static int CmdLFHitag2Dump(const char *Cmd) {
     PrintAndLogEx(INFO, "Dumping of tag memory");
 
@@ -801,6 +1032,7 @@ static command_t CommandTable[] = {
     {"writer", CmdLFHitagWriter,      IfPm3Hitag,      "Act like a Hitag Writer" },
     {"dump",   CmdLFHitag2Dump,       IfPm3Hitag,      "Dump Hitag2 tag" },
     {"cc",     CmdLFHitagCheckChallenges, IfPm3Hitag,  "Test all challenges" },
+    {"crack",  CmdLFHitagCrack,       AlwaysAvailable, "Recover Hitag2 key from collected reader authentications" },
     { NULL, NULL, 0, NULL }
 };
 
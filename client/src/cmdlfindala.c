@@ -293,7 +293,11 @@ static int CmdIndalaDemodAlt(const char *Cmd) {
 
     // worst case with GraphTraceLen=40000 is < 4096
     // under normal conditions it's < 2048
-    uint8_t data[MAX_GRAPH_TRACE_LEN] = {0};
+    uint8_t *data = calloc(MAX(GraphTraceLen, MAX_GRAPH_TRACE_LEN), sizeof(uint8_t));
+    if (data == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
     size_t datasize = getFromGraphBuf(data);
 
     uint8_t rawbits[4096];
@@ -341,6 +345,7 @@ static int CmdIndalaDemodAlt(const char *Cmd) {
         PrintAndLogEx(INFO, "Recovered %d raw bits, expected: %zu", rawbit, GraphTraceLen / 32);
         PrintAndLogEx(INFO, "worst metric (0=best..7=worst): %d at pos %d", worst, worstPos);
     } else {
+        free(data);
         return PM3_ESOFT;
     }
 
@@ -370,6 +375,7 @@ static int CmdIndalaDemodAlt(const char *Cmd) {
 
     if (start == rawbit - uidlen + 1) {
         PrintAndLogEx(FAILED, "nothing to wait for");
+        free(data);
         return PM3_ESOFT;
     }
 
@@ -396,6 +402,7 @@ static int CmdIndalaDemodAlt(const char *Cmd) {
         }
         showbits[bit + 1] = '\0';
         PrintAndLogEx(SUCCESS, "Partial UID | %s", showbits);
+        free(data);
         return PM3_SUCCESS;
     } else {
         for (bit = 0; bit < uidlen; bit++) {
@@ -480,6 +487,7 @@ static int CmdIndalaDemodAlt(const char *Cmd) {
     }
 
     RepaintGraphWindow();
+    free(data);
     return PM3_SUCCESS;
 }
 
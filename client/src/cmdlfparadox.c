@@ -82,10 +82,15 @@ static int CmdParadoxDemod(const char *Cmd) {
 
 int demodParadox(void) {
     //raw fsk demod no manchester decoding no start bit finding just get binary from wave
-    uint8_t bits[MAX_GRAPH_TRACE_LEN] = {0};
+    uint8_t *bits = calloc(MAX(GraphTraceLen, MAX_GRAPH_TRACE_LEN), sizeof(uint8_t));
+    if (bits == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
     size_t size = getFromGraphBuf(bits);
     if (size == 0) {
         PrintAndLogEx(DEBUG, "DEBUG: Error - Paradox not enough samples");
+        free(bits);
         return PM3_ESOFT;
     }
 
@@ -104,6 +109,7 @@ int demodParadox(void) {
         else
             PrintAndLogEx(DEBUG, "DEBUG: Error - Paradox error demoding fsk %d", idx);
 
+        free(bits);
         return PM3_ESOFT;
     }
 
@@ -150,6 +156,7 @@ int demodParadox(void) {
 
     if (hi2 == 0 && hi == 0 && lo == 0) {
         PrintAndLogEx(DEBUG, "DEBUG: Error - Paradox no value found");
+        free(bits);
         return PM3_ESOFT;
     }
 
@@ -199,6 +206,7 @@ int demodParadox(void) {
     if (g_debugMode)
         printDemodBuff();
 
+    free(bits);
     return PM3_SUCCESS;
 }
 //by marshmellow
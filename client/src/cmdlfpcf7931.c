@@ -16,6 +16,8 @@
 #include "cmdparser.h"    // command_t
 #include "comms.h"
 #include "ui.h"
+#include "util.h"     // sprint_hex, kbd_enter_pressed
+#include "commonutil.h"  // ARRAYLEN
 
 static int CmdHelp(const char *Cmd);
 
@@ -99,11 +101,46 @@ static int CmdLFPCF7931Read(const char *Cmd) {
     PacketResponseNG resp;
     clearCommandBuffer();
     SendCommandNG(CMD_LF_PCF7931_READ, NULL, 0);
-    if (!WaitForResponseTimeout(CMD_ACK, &resp, 2500)) {
-        PrintAndLogEx(WARNING, "command execution time out");
-        return PM3_ETIMEOUT;
+
+    // the device reads until it has all the blocks, enter stops it
+    bool aborted = false;
+    for (;;) {
+        if (aborted == false && kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            PrintAndLogEx(WARNING, "aborted via keyboard!\n");
+            aborted = true;
+        }
+        if (WaitForResponseTimeout(CMD_LF_PCF7931_READ, &resp, 100))
+            break;
     }
-    return PM3_SUCCESS;
+
+    if (resp.status == PM3_ESOFT || resp.length < sizeof(lf_pcf7931_read_t)) {
+        PrintAndLogEx(WARNING, "no tag or bad tag");
+        return PM3_ESOFT;
+    }
+
+    lf_pcf7931_read_t *res = (lf_pcf7931_read_t *)resp.data.asBytes;
+    uint8_t max_blocks = MIN(res->max_blocks, ARRAYLEN(res->blocks));
+
+    PrintAndLogEx(NORMAL, "-----------------------------------------");
+    PrintAndLogEx(NORMAL, "Memory content:");
+    PrintAndLogEx(NORMAL, "-----------------------------------------");
+    for (uint8_t i = 0; i < max_blocks; ++i) {
+        if (res->mask & (1 << i))
+            PrintAndLogEx(SUCCESS, "Block %d: %s", i, sprint_hex(res->blocks[i], 16));
+        else
+            PrintAndLogEx(WARNING, "<missing block %d>", i);
+    }
+    PrintAndLogEx(NORMAL, "-----------------------------------------");
+
+    if (res->single_cnt) {
+        PrintAndLogEx(NORMAL, "Blocks with unknown position:");
+        PrintAndLogEx(NORMAL, "-----------------------------------------");
+        for (uint8_t i = 0; i < res->single_cnt && i < ARRAYLEN(res->single); ++i)
+            PrintAndLogEx(INFO, "Block: %s", sprint_hex(res->single[i], 16));
+        PrintAndLogEx(NORMAL, "-----------------------------------------");
+    }
+    return resp.status;
 }
 
 static int CmdLFPCF7931Config(const char *Cmd) {
@@ -251,6 +251,7 @@ static int usage_t55xx_wakup(void) {
 }
 static int usage_t55xx_chk(void) {
     PrintAndLogEx(NORMAL, "This command uses a dictionary attack");
+    PrintAndLogEx(NORMAL, "a dictionary file is checked by the device, " _YELLOW_("%u") " passwords at a time", T55XX_BRUTE_DICT_MAX);
     PrintAndLogEx(NORMAL, "press " _YELLOW_("'enter'") " to cancel the command");
     PrintAndLogEx(NORMAL,  _RED_("WARNING:") " this may brick non-password protected chips!");
     PrintAndLogEx(NORMAL, "Try to reading block 7 before\n");
@@ -269,6 +270,7 @@ static int usage_t55xx_chk(void) {
 }
 static int usage_t55xx_bruteforce(void) {
     PrintAndLogEx(NORMAL, "This command uses bruteforce to scan a number range");
+    PrintAndLogEx(NORMAL, "the device demodulates every attempt, hits are verified by the client");
     PrintAndLogEx(NORMAL, "press " _YELLOW_("'enter'") " to cancel the command");
     PrintAndLogEx(NORMAL, _RED_("WARNING:") " this may brick non-password protected chips!");
     PrintAndLogEx(NORMAL, "Try reading block 7 before\n");
@@ -436,43 +438,65 @@ static void T55x7_ClearAllBlockData(void) {
     }
 }
 
-int clone_t55xx_tag(uint32_t *blockdata, uint8_t numblocks) {
+// Writes a list of blocks in one device transaction. With verify, the device reads the blocks back
+// and sets a bit in verified for each good one, device_verified is false when it couldn't read back
+int t55xxWriteBlocks(t55xx_write_block_t *blocks, uint8_t count, uint32_t block0, bool verify, uint16_t *verified, bool *device_verified) {
 
-    if (blockdata == NULL)
-        return PM3_EINVARG;
-    if (numblocks < 1 || numblocks > 8)
+    if (blocks == NULL || count < 1 || count > T55XX_WRITE_BLOCKS_MAX)
         return PM3_EINVARG;
 
-    PacketResponseNG resp;
+    t55xx_write_blocks_t req;
+    memset(&req, 0, sizeof(req));
+    req.count = count;
+    req.flags = (verify) ? T55XX_WRITE_BLOCKS_VERIFY : 0;
+    req.block0 = block0;
+    memcpy(req.blocks, blocks, count * sizeof(t55xx_write_block_t));
 
-    // fast push mode
-    conn.block_after_ACK = true;
+    PacketResponseNG resp;
+    clearCommandBuffer();
+    SendCommandNG(CMD_LF_T55XX_WRITE_BLOCKS, (uint8_t *)&req, sizeof(req));
 
-    for (int8_t i = 0; i < numblocks; i++) {
+    // every block may be written twice and read back twice
+    if (!WaitForResponseTimeout(CMD_LF_T55XX_WRITE_BLOCKS, &resp, T55XX_WRITE_TIMEOUT + count * 500)) {
+        PrintAndLogEx(ERR, "Error occurred, device did not respond during write operation.");
+        return PM3_ETIMEOUT;
+    }
 
-        // Disable fast mode on last packet
-        if (i == numblocks - 1) {
-            conn.block_after_ACK = false;
-        }
+    t55xx_write_blocks_resp_t *r = (t55xx_write_blocks_resp_t *)resp.data.asBytes;
+    if (verified)
+        *verified = r->verified;
+    if (device_verified)
+        *device_verified = r->verify;
+    return resp.status;
+}
 
-        clearCommandBuffer();
+int clone_t55xx_tag(uint32_t *blockdata, uint8_t numblocks) {
 
-        t55xx_write_block_t ng;
-        ng.data = blockdata[i];
-        ng.pwd = 0;
-        ng.blockno = i;
-        ng.flags = 0;
+    if (blockdata == NULL)
+        return PM3_EINVARG;
+    if (numblocks < 1 || numblocks > 8)
+        return PM3_EINVARG;
 
-        SendCommandNG(CMD_LF_T55XX_WRITEBL, (uint8_t *)&ng, sizeof(ng));
-        if (!WaitForResponseTimeout(CMD_LF_T55XX_WRITEBL, &resp, T55XX_WRITE_TIMEOUT)) {
-            PrintAndLogEx(ERR, "Error occurred, device did not respond during write operation.");
-            return PM3_ETIMEOUT;
-        }
+    t55xx_write_block_t blocks[8];
+    memset(blocks, 0, sizeof(blocks));
+    for (uint8_t i = 0; i < numblocks; i++) {
+        blocks[i].data = blockdata[i];
+        blocks[i].blockno = i;
     }
 
-    uint8_t res = 0;
+    uint16_t verified = 0;
+    bool device_verified = false;
+    int res = t55xxWriteBlocks(blocks, numblocks, 0, true, &verified, &device_verified);
+    if (res != PM3_SUCCESS)
+        return res;
+
+    // blocks the device couldn't confirm get the client side check
+    uint8_t fails = 0;
     for (int8_t i = 0; i < numblocks; i++) {
 
+        if (device_verified && (verified & (1 << i)))
+            continue;
+
         if (i == 0) {
             SetConfigWithBlock0(blockdata[0]);
             if (t55xxAquireAndCompareBlock0(false, 0, blockdata[0], false))
@@ -480,10 +504,14 @@ int clone_t55xx_tag(uint32_t *blockdata, uint8_t numblocks) {
         }
 
         if (t55xxVerifyWrite(i, 0, false, false, 0, 0xFF, blockdata[i]) == false)
-            res++;
+            fails++;
     }
 
-    if (res == 0)
+    // keep the client config in line with what was written
+    if (device_verified && (verified & 1))
+        SetConfigWithBlock0(blockdata[0]);
+
+    if (fails == 0)
         PrintAndLogEx(SUCCESS, "Success writing to tag");
 
     return PM3_SUCCESS;
@@ -635,7 +663,7 @@ bool t55xxVerifyWrite(uint8_t block, bool page1, bool usepwd, uint8_t override,
     return (read_data == data);
 }
 
-int t55xxWrite(uint8_t block, bool page1, bool usepwd, bool testMode, uint32_t password, uint8_t downlink_mode, uint32_t data) {
+static void t55xxWritePayload(t55xx_write_block_t *ng, uint8_t block, bool page1, bool usepwd, bool testMode, uint32_t password, uint8_t downlink_mode, uint32_t data) {
 
     uint8_t flags;
     flags  = (usepwd)   ? 0x1 : 0;
@@ -653,11 +681,16 @@ int t55xxWrite(uint8_t block, bool page1, bool usepwd, bool testMode, uint32_t p
        new style
        uses struct in pm3_cmd.h
     */
+    ng->data    = data;
+    ng->pwd     = password;
+    ng->blockno = block;
+    ng->flags   = flags;
+}
+
+int t55xxWrite(uint8_t block, bool page1, bool usepwd, bool testMode, uint32_t password, uint8_t downlink_mode, uint32_t data) {
+
     t55xx_write_block_t ng;
-    ng.data    = data;
-    ng.pwd     = password;
-    ng.blockno = block;
-    ng.flags   = flags;
+    t55xxWritePayload(&ng, block, page1, usepwd, testMode, password, downlink_mode, data);
 
     PacketResponseNG resp;
     clearCommandBuffer();
@@ -669,6 +702,58 @@ int t55xxWrite(uint8_t block, bool page1, bool usepwd, bool testMode, uint32_t p
     return resp.status;
 }
 
+// Writes a block and reads it back in one USB transaction (CMD_BATCH). Not for block 0, whose
+// read back may need a new detect (see t55xxVerifyWrite)
+static int t55xxWriteAndVerify(uint8_t block, bool page1, bool usepwd, bool testMode, uint32_t password, uint8_t downlink_mode, uint32_t data, bool *verified) {
+
+    *verified = false;
+
+    t55xx_write_block_t wr;
+    t55xxWritePayload(&wr, block, page1, usepwd, testMode, password, downlink_mode, data);
+
+    t55xx_read_block_t rd = {
+        .password = password,
+        .blockno = block,
+        .page = page1 & 0x1,
+        .pwdmode = usepwd,
+        .downlink_mode = downlink_mode,
+    };
+
+    cmd_batch_t batch;
+    BatchInit(&batch);
+    BatchAddNG(&batch, CMD_LF_T55XX_WRITEBL, &wr, sizeof(wr));
+    BatchAddNG(&batch, CMD_LF_T55XX_READBL, &rd, sizeof(rd));
+
+    PacketResponseNG resp;
+    clearCommandBuffer();
+    SendCommandBatch(&batch);
+    if (!WaitForResponseTimeout(CMD_LF_T55XX_WRITEBL, &resp, 2000)) {
+        PrintAndLogEx(ERR, "Error occurred, device did not ACK write operation.");
+        return PM3_ETIMEOUT;
+    }
+    int res = resp.status;
+
+    bool read_ok = WaitForResponseTimeout(CMD_LF_T55XX_READBL, NULL, 2500);
+    WaitForResponseTimeout(CMD_BATCH, NULL, 1000);
+
+    if (res != PM3_SUCCESS)
+        return res;
+
+    if (read_ok == false) {
+        PrintAndLogEx(WARNING, "command execution time out");
+        return PM3_SUCCESS;
+    }
+
+    getSamples(12000, false);
+    config.usepwd = usepwd;
+
+    uint32_t read_data = 0;
+    if (getSignalProperties()->isnoise == false && DecodeT55xxBlock() && GetT55xxBlockData(&read_data))
+        *verified = (read_data == data);
+
+    return PM3_SUCCESS;
+}
+
 void printT5xxHeader(uint8_t page) {
     PrintAndLogEx(SUCCESS, "Reading Page %d:", page);
     PrintAndLogEx(SUCCESS, "blk | hex data | binary                           | ascii");
@@ -848,24 +933,33 @@ int T55xxReadBlock(uint8_t block, bool page1, bool usepwd, uint8_t override, uin
     return T55xxReadBlockEx(block, page1, usepwd, override, password, downlink_mode, true);
 }
 
+// try reading the config block and verify that PWD bit is set before reading with a password.
+// usepwd is cleared when the config block reads fine without one
+static int T55xxSafetyCheck(uint32_t password, uint8_t downlink_mode, bool *usepwd) {
+    if (AcquireData(T55x7_PAGE0, T55x7_CONFIGURATION_BLOCK, false, 0, downlink_mode) == false)
+        return PM3_ERFTRANS;
+
+    if (tryDetectModulationCached(downlink_mode, false, password) == false) {
+        PrintAndLogEx(WARNING, "Safety check: Could not detect if PWD bit is set in config block. Exits.");
+        return PM3_EWRONGANSWER;
+    }
+
+    PrintAndLogEx(WARNING, "Safety check: PWD bit is NOT set in config block. Reading without password...");
+    *usepwd = false;
+    return PM3_SUCCESS;
+}
+
 int T55xxReadBlockEx(uint8_t block, bool page1, bool usepwd, uint8_t override, uint32_t password, uint8_t downlink_mode, bool verbose) {
     //Password mode
     if (usepwd) {
-        // try reading the config block and verify that PWD bit is set before doing this!
         // override = 1 (override and display)
         // override = 2 (override and no display)
         if (override == 0) {
-            if (AcquireData(T55x7_PAGE0, T55x7_CONFIGURATION_BLOCK, false, 0, downlink_mode) == false)
-                return PM3_ERFTRANS;
+            int res = T55xxSafetyCheck(password, downlink_mode, &usepwd);
+            if (res != PM3_SUCCESS)
+                return res;
 
-            if (tryDetectModulationEx(downlink_mode, false, 0, password) == false) {
-                PrintAndLogEx(WARNING, "Safety check: Could not detect if PWD bit is set in config block. Exits.");
-                return PM3_EWRONGANSWER;
-            } else {
-                PrintAndLogEx(WARNING, "Safety check: PWD bit is NOT set in config block. Reading without password...");
-                usepwd = false;
-                page1 = false; // ??
-            }
+            page1 = false; // ??
         } else if (override == 1) {
             PrintAndLogEx(INFO, "Safety check overridden - proceeding despite risk");
         }
@@ -1123,6 +1217,69 @@ static int CmdT55xxDetect(const char *Cmd) {
 }
 
 // detect configuration?
+// Configs found by earlier detections in this session, most recently used first. A cached config is
+// tried against a new acquisition before the full modulation sweep, it is a hit when its own block 0
+// shows up in the demodulated data
+#define T55XX_CONF_CACHE_SIZE 8
+static t55xx_conf_block_t conf_cache[T55XX_CONF_CACHE_SIZE];
+static uint8_t conf_cache_count = 0;
+
+static void t55xx_conf_cache_store(const t55xx_conf_block_t *conf) {
+    uint8_t i = 0;
+    for (; i < conf_cache_count; i++) {
+        if (conf_cache[i].block0 == conf->block0 && conf_cache[i].downlink_mode == conf->downlink_mode)
+            break;
+    }
+    if (i == conf_cache_count) {
+        if (conf_cache_count < T55XX_CONF_CACHE_SIZE)
+            conf_cache_count++;
+        i = conf_cache_count - 1;
+    }
+
+    memmove(&conf_cache[1], &conf_cache[0], i * sizeof(t55xx_conf_block_t));
+    conf_cache[0] = *conf;
+}
+
+static bool t55xx_conf_cache_match(uint8_t downlink_mode, bool print_config, uint64_t pwd) {
+
+    t55xx_conf_block_t saved = config;
+
+    for (uint8_t i = 0; i < conf_cache_count; i++) {
+        if (conf_cache[i].downlink_mode != downlink_mode)
+            continue;
+
+        config = conf_cache[i];
+        if (DecodeT55xxBlock() == false || DemodBufferLen < 32)
+            continue;
+
+        for (size_t idx = 0; idx < MIN(DemodBufferLen - 32, 64); idx++) {
+            if (PackBits(idx, 32, DemodBuffer) != conf_cache[i].block0)
+                continue;
+
+            config.offset = idx;
+            if (pwd != -1) {
+                config.usepwd = true;
+                config.pwd = pwd & 0xffffffff;
+            }
+            t55xx_conf_cache_store(&config);
+
+            if (print_config)
+                printConfiguration(config);
+            return true;
+        }
+    }
+
+    config = saved;
+    return false;
+}
+
+// Same as tryDetectModulationEx, configs seen before are checked first
+bool tryDetectModulationCached(uint8_t downlink_mode, bool print_config, uint64_t pwd) {
+    if (t55xx_conf_cache_match(downlink_mode, print_config, pwd))
+        return true;
+    return tryDetectModulationEx(downlink_mode, print_config, 0, pwd);
+}
+
 bool tryDetectModulation(uint8_t downlink_mode, bool print_config) {
     return tryDetectModulationEx(downlink_mode, print_config, 0, -1);
 }
@@ -1304,6 +1461,8 @@ bool tryDetectModulationEx(uint8_t downlink_mode, bool print_config, uint32_t wa
             config.pwd = pwd & 0xffffffff;
         }
 
+        t55xx_conf_cache_store(&config);
+
         if (print_config)
             printConfiguration(config);
 
@@ -1335,6 +1494,7 @@ bool tryDetectModulationEx(uint8_t downlink_mode, bool print_config, uint32_t wa
                     config.usepwd = true;
                     config.pwd = pwd & 0xffffffff;
                 }
+                t55xx_conf_cache_store(&config);
             } else {
                 PrintAndLogEx(NORMAL, "--[%d]---------------", i + 1);
             }
@@ -1737,6 +1897,21 @@ static int CmdT55xxWriteBlock(const char *Cmd) {
 
     PrintAndLogEx(INFO, "Writing page %d  block: %02d  data: 0x%08X %s", page1, block, data, (usepwd) ? pwdStr : "");
 
+    // write and read back in one go, block 0 may need a detect in between
+    if (validate && (block != 0 || page1)) {
+        bool isOK = false;
+        if (t55xxWriteAndVerify(block, page1, usepwd, testMode, password, downlink_mode, data, &isOK) != PM3_SUCCESS) {
+            PrintAndLogEx(ERR, "Write failed");
+            return PM3_ESOFT;
+        }
+        if (isOK)
+            PrintAndLogEx(SUCCESS, "Write OK, validation successful");
+        else
+            PrintAndLogEx(WARNING, "Write could not validate the written data");
+
+        return PM3_SUCCESS;
+    }
+
     if (t55xxWrite(block, page1, usepwd, testMode, password, downlink_mode, data) != PM3_SUCCESS) {
         PrintAndLogEx(ERR, "Write failed");
         return PM3_ESOFT;
@@ -2320,6 +2495,15 @@ static int CmdT55xxDump(const char *Cmd) {
     }
     if (errors) return usage_t55xx_dump();
 
+    // one safety check for the whole dump, the blocks are read without repeating it
+    if (usepwd && override == 0) {
+        int res = T55xxSafetyCheck(password, downlink_mode, &usepwd);
+        if (res != PM3_SUCCESS)
+            return res;
+
+        override = 2;
+    }
+
     // Due to the few different T55xx cards and number of blocks supported
     // will save the dump file if ALL page 0 is OK
     printT5xxHeader(0);
@@ -2376,8 +2560,6 @@ static int CmdT55xxRestore(const char *Cmd) {
     size_t datalen = 0;
     uint8_t blockidx;
     uint8_t downlink_mode;
-    char writeCmdOpt[100];
-    char pwdOpt [11] = {0}; // p XXXXXXXX
 
     while (param_getchar(Cmd, cmdp) != 0x00 && !errors) {
         switch (tolower(param_getchar(Cmd, cmdp))) {
@@ -2431,9 +2613,6 @@ static int CmdT55xxRestore(const char *Cmd) {
 
     if (success == PM3_SUCCESS) { // Got data, so write to cards
         if (datalen == T55x7_BLOCK_COUNT * 4) { // 12 blocks * 4 bytes per block
-            if (usepwd)
-                snprintf(pwdOpt, sizeof(pwdOpt), "p %08X", password);
-
             // Restore endien for writing to card
             for (blockidx = 0; blockidx < 12; blockidx++)
                 data[blockidx] = BSWAP_32(data[blockidx]);
@@ -2447,33 +2626,45 @@ static int CmdT55xxRestore(const char *Cmd) {
             if ((((data[11] >> 28) & 0xf) == 6) || (((data[11] >> 28) & 0xf) == 9))
                 downlink_mode = (data[11] >> 10) & 3;
 
-            // write out blocks 1-7 page 0
-            for (blockidx = 1; blockidx <= 7; blockidx++) {
-                snprintf(writeCmdOpt, sizeof(writeCmdOpt), "b %d d %08X %s", blockidx, data[blockidx], pwdOpt);
+            uint8_t flags = (usepwd) ? 0x01 : 0;
+            t55xx_write_block_t blocks[T55x7_BLOCK_COUNT - 1];
+            uint8_t n = 0;
 
-                if (CmdT55xxWriteBlock(writeCmdOpt) != PM3_SUCCESS)
-                    PrintAndLogEx(WARNING, "Warning: error writing blk %d", blockidx);
+            // write out blocks 1-7 page 0
+            for (blockidx = 1; blockidx <= 7; blockidx++, n++) {
+                blocks[n].data = data[blockidx];
+                blocks[n].pwd = password;
+                blocks[n].blockno = blockidx;
+                blocks[n].flags = flags | (config.downlink_mode << 3);
             }
 
             // if password was set on the "blank" update as we may have just changed it
             if (usepwd)
-                snprintf(pwdOpt, sizeof(pwdOpt), "p %08X", data[7]);
+                password = data[7];
 
             // write out blocks 1-3 page 1
-            for (blockidx = 9; blockidx <= 11; blockidx++) {
-                snprintf(writeCmdOpt, sizeof(writeCmdOpt), "b %d 1 d %08X %s", blockidx - 8, data[blockidx], pwdOpt);
-
-                if (CmdT55xxWriteBlock(writeCmdOpt) != PM3_SUCCESS)
-                    PrintAndLogEx(WARNING, "Warning: error writing blk %d", blockidx);
+            for (blockidx = 9; blockidx <= 11; blockidx++, n++) {
+                blocks[n].data = data[blockidx];
+                blocks[n].pwd = password;
+                blocks[n].blockno = blockidx - 8;
+                blocks[n].flags = flags | 0x02 | (config.downlink_mode << 3);
             }
 
             // Update downlink mode for the page 0 config write.
             config.downlink_mode = downlink_mode;
 
             // Write the page 0 config
-            snprintf(writeCmdOpt, sizeof(writeCmdOpt), "b 0 d %08X %s", data[0], pwdOpt);
-            if (CmdT55xxWriteBlock(writeCmdOpt) != PM3_SUCCESS)
-                PrintAndLogEx(WARNING, "Warning: error writing blk 0");
+            blocks[n].data = data[0];
+            blocks[n].pwd = password;
+            blocks[n].blockno = 0;
+            blocks[n].flags = flags | (downlink_mode << 3);
+            n++;
+
+            for (uint8_t i = 0; i < n; i++)
+                PrintAndLogEx(INFO, "Writing page %d  block: %02d  data: 0x%08X", (blocks[i].flags & 0x02) ? 1 : 0, blocks[i].blockno, blocks[i].data);
+
+            if (t55xxWriteBlocks(blocks, n, 0, false, NULL, NULL) != PM3_SUCCESS)
+                PrintAndLogEx(WARNING, "Warning: error writing blocks");
         }
     }
 
@@ -2540,14 +2731,7 @@ bool AcquireData(uint8_t page, uint8_t block, bool pwdmode, uint32_t password, u
     //  b2 = brute_mem (armside function)
     // arg1: which block to read
     // arg2: password
-    struct p {
-        uint32_t password;
-        uint8_t  blockno;
-        uint8_t  page;
-        bool     pwdmode;
-        uint8_t  downlink_mode;
-    } PACKED;
-    struct p payload;
+    t55xx_read_block_t payload;
     payload.password      = password;
     payload.blockno       = block;
     payload.page          = page & 0x1;
@@ -2990,6 +3174,85 @@ static bool IsCancelled(void) {
 }
 
 // load a default pwd file.
+// Modulation hint for the device side search, only when a config was detected before
+static uint8_t t55xx_brute_modulation(void) {
+    if (config.block0 == 0)
+        return 0xFF;
+
+    switch (config.modulation) {
+        case DEMOD_FSK:
+        case DEMOD_FSK1:
+        case DEMOD_FSK1a:
+        case DEMOD_FSK2:
+        case DEMOD_FSK2a:
+            return DEMOD_FSK1;
+        case DEMOD_ASK:
+        case DEMOD_BI:
+        case DEMOD_BIa:
+        case DEMOD_NRZ:
+        case DEMOD_PSK1:
+        case DEMOD_PSK2:
+            return config.modulation;
+        case DEMOD_PSK3:
+        default:
+            return 0xFF;
+    }
+}
+
+// Runs a password search on the device, it only reports progress and hits
+static int t55xx_brute_device(t55xx_brute_req_t *req, t55xx_brute_resp_t *out) {
+
+    memset(out, 0, sizeof(t55xx_brute_resp_t));
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_LF_T55XX_BRUTE, (uint8_t *)req, sizeof(t55xx_brute_req_t));
+
+    int res = PM3_SUCCESS;
+    uint8_t tries = 0;
+    for (;;) {
+        PacketResponseNG resp;
+        if (WaitForResponseTimeout(CMD_LF_T55XX_BRUTE, &resp, 1000) == false) {
+            tries++;
+            if (tries > 20) {
+                if (res == PM3_SUCCESS) {
+                    PrintAndLogEx(WARNING, "\ntimeout while waiting for reply.");
+                    SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+                    res = PM3_ETIMEOUT;
+                }
+                break;
+            }
+        } else {
+            tries = 0;
+            memcpy(out, resp.data.asBytes, sizeof(t55xx_brute_resp_t));
+            if (out->final)
+                break;
+
+            PrintAndLogEx(INPLACE, "tried " _YELLOW_("%u") " passwords, last [ %08X ]", out->tried, out->password);
+        }
+
+        if (res == PM3_SUCCESS && kbd_enter_pressed()) {
+            PrintAndLogEx(WARNING, "\naborted via keyboard.");
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            res = PM3_EOPABORTED;
+            // give the device a moment for its final frame
+            tries = 18;
+        }
+    }
+    PrintAndLogEx(NORMAL, "");
+
+    if (res == PM3_SUCCESS && out->found == false && session.pm3_present == false)
+        res = PM3_ENODATA;
+
+    return res;
+}
+
+// Confirms a device side hit with the client demodulators and prints the config
+static bool t55xx_brute_confirm(uint32_t password, uint8_t downlink_mode) {
+    if (AcquireData(T55x7_PAGE0, T55x7_CONFIGURATION_BLOCK, true, password, downlink_mode) == false)
+        return false;
+    return tryDetectModulationEx(downlink_mode, T55XX_PrintConfig, 0, password);
+}
+
 static int CmdT55xxChkPwds(const char *Cmd) {
 
     char filename[FILE_PATH_SIZE] = {0};
@@ -3000,7 +3263,6 @@ static int CmdT55xxChkPwds(const char *Cmd) {
     bool try_all_dl_modes = false;
     uint8_t downlink_mode = 0;
     bool use_pwd_file = false;
-    int dl_mode; // to try each downlink mode for each password
     uint8_t cmdp = 0;
     bool errors = false;
 
@@ -3102,37 +3364,39 @@ static int CmdT55xxChkPwds(const char *Cmd) {
             return PM3_ESOFT;
         }
 
-        for (uint32_t c = 0; c < keycount; ++c) {
+        t55xx_brute_req_t req = {
+            .downlink_mode = downlink_mode,
+            .flags = T55XX_BRUTE_DICT | ((try_all_dl_modes) ? T55XX_BRUTE_ALL_DL : 0),
+            .modulation = t55xx_brute_modulation(),
+            .inverted = config.inverted,
+        };
+        t55xx_brute_resp_t bresp;
+
+        // the device takes as many passwords as fit in emulator memory at a time
+        for (uint32_t c = 0; c < keycount && found == false; c += T55XX_BRUTE_DICT_MAX) {
 
-            if (!session.pm3_present) {
-                PrintAndLogEx(WARNING, "Device offline\n");
+            req.pwdcount = MIN(keycount - c, T55XX_BRUTE_DICT_MAX);
+            PrintAndLogEx(INFO, "Testing passwords %u - %u of %u", c + 1, c + req.pwdcount, keycount);
+
+            if (SendToDeviceEML(keyBlock + 4 * c, 4 * req.pwdcount, 0) != PM3_SUCCESS) {
+                PrintAndLogEx(WARNING, "Failed to upload passwords");
                 free(keyBlock);
-                return PM3_ENODATA;
+                return PM3_ETIMEOUT;
             }
 
-            if (IsCancelled()) {
+            res = t55xx_brute_device(&req, &bresp);
+            if (res != PM3_SUCCESS) {
                 free(keyBlock);
-                return PM3_EOPABORTED;
+                return res;
             }
 
-            uint32_t curr_password = bytes_to_num(keyBlock + 4 * c, 4);
-
-            PrintAndLogEx(INFO, "Testing %08"PRIX32, curr_password);
-            for (dl_mode = downlink_mode; dl_mode <= 3; dl_mode++) {
-
-                if (!AcquireData(T55x7_PAGE0, T55x7_CONFIGURATION_BLOCK, true, curr_password, dl_mode)) {
-                    continue;
-                }
-
-                found = tryDetectModulationEx(dl_mode, T55XX_PrintConfig, 0, curr_password);
+            if (bresp.found) {
+                PrintAndLogEx(SUCCESS, "Found a candidate [ " _YELLOW_("%08"PRIX32) " ]", bresp.password);
+                found = t55xx_brute_confirm(bresp.password, bresp.downlink_mode);
                 if (found) {
-                    PrintAndLogEx(SUCCESS, "Found valid password: [ " _GREEN_("%08"PRIX32) " ]", curr_password);
-                    dl_mode = 4; // Exit other downlink mode checks
-                    c = keycount; // Exit loop
+                    PrintAndLogEx(SUCCESS, "Found valid password: [ " _GREEN_("%08"PRIX32) " ]", bresp.password);
+                    T55xx_Print_DownlinkMode(bresp.downlink_mode);
                 }
-
-                if (!try_all_dl_modes) // Exit loop if not trying all downlink modes
-                    dl_mode = 4;
             }
         }
         if (!found) PrintAndLogEx(WARNING, "Check pwd failed");
@@ -3151,9 +3415,7 @@ static int CmdT55xxBruteForce(const char *Cmd) {
 
     uint32_t start_password = 0x00000000; //start password
     uint32_t end_password = 0xFFFFFFFF; //end   password
-    uint32_t curr = 0;
     uint8_t downlink_mode = 0;
-    uint8_t found = 0; // > 0 if found xx1 xx downlink needed, 1 found
     uint8_t cmdp = 0;
     bool errors = false;
 
@@ -3190,34 +3452,32 @@ static int CmdT55xxBruteForce(const char *Cmd) {
 
     uint64_t t1 = msclock();
 
-    curr = start_password;
-
     PrintAndLogEx(INFO, "Search password range [%08X -> %08X]", start_password, end_password);
-
-    while (found == 0) {
-
-        PrintAndLogEx(NORMAL, "." NOLF);
-
-        if (IsCancelled()) {
-            return PM3_EOPABORTED;
-        }
-
-        found = tryOnePassword(curr, downlink_mode);
-
-        if (curr == end_password)
-            break;
-
-        curr++;
+    PrintAndLogEx(INFO, "press " _YELLOW_("`enter`") " to cancel");
+
+    t55xx_brute_req_t req = {
+        .start = start_password,
+        .end = end_password,
+        .downlink_mode = downlink_mode & 3,
+        .flags = (downlink_mode == 4) ? T55XX_BRUTE_ALL_DL : 0,
+        .modulation = t55xx_brute_modulation(),
+        .inverted = config.inverted,
+    };
+    t55xx_brute_resp_t resp;
+
+    int res = t55xx_brute_device(&req, &resp);
+    if (res != PM3_SUCCESS)
+        return res;
+
+    if (resp.found && t55xx_brute_confirm(resp.password, resp.downlink_mode)) {
+        PrintAndLogEx(SUCCESS, "Found valid password: [ " _GREEN_("%08X") " ]", resp.password);
+        T55xx_Print_DownlinkMode(resp.downlink_mode);
+    } else if (resp.found) {
+        PrintAndLogEx(WARNING, "Candidate [ " _YELLOW_("%08X") " ] failed to verify", resp.password);
+    } else {
+        PrintAndLogEx(WARNING, "Bruteforce failed, last tried: [ " _YELLOW_("%08X") " ]", start_password + ((resp.tried) ? resp.tried - 1 : 0));
     }
 
-    PrintAndLogEx(NORMAL, "");
-
-    if (found) {
-        PrintAndLogEx(SUCCESS, "Found valid password: [ " _GREEN_("%08X") " ]", curr - 1);
-        T55xx_Print_DownlinkMode((found >> 1) & 3);
-    } else
-        PrintAndLogEx(WARNING, "Bruteforce failed, last tried: [ " _YELLOW_("%08X") " ]", curr);
-
     t1 = msclock() - t1;
     PrintAndLogEx(SUCCESS, "\ntime in bruteforce " _YELLOW_("%.0f") " seconds\n", (float)t1 / 1000.0);
     return PM3_SUCCESS;
@@ -11,6 +11,7 @@
 #define CMDLFT55XX_H__
 
 #include "common.h"
+#include "pm3_cmd.h" // t55xx_write_block_t
 
 #define T55x7_CONFIGURATION_BLOCK 0x00
 #define T55x7_PWD_BLOCK 0x07
@@ -183,6 +184,7 @@ bool DecodeT55xxBlock(void);
 bool tryDetectModulation(uint8_t downlink_mode, bool print_config);
 //bool tryDetectModulationEx(uint8_t downlink_mode, bool print_config, uint32_t wanted_conf);
 bool tryDetectModulationEx(uint8_t downlink_mode, bool print_config, uint32_t wanted_conf, uint64_t pwd);
+bool tryDetectModulationCached(uint8_t downlink_mode, bool print_config, uint64_t pwd);
 bool testKnownConfigBlock(uint32_t block0);
 
 bool tryDetectP1(bool getData);
@@ -194,5 +196,6 @@ uint8_t  tryOnePassword(uint32_t password, uint8_t downlink_mode);
 void printT55x7Trace(t55x7_tracedata_t data, uint8_t repeat);
 void printT5555Trace(t5555_tracedata_t data, uint8_t repeat);
 
+int t55xxWriteBlocks(t55xx_write_block_t *blocks, uint8_t count, uint32_t block0, bool verify, uint16_t *verified, bool *device_verified);
 int clone_t55xx_tag(uint32_t *blockdata, uint8_t numblocks);
 #endif
@@ -272,7 +272,7 @@ static command_t CommandTable[] = {
     {"--------", CmdHelp,      AlwaysAvailable,         "----------------------- " _CYAN_("General") " -----------------------"},
     {"auto",    CmdAuto,      IfPm3Present,            "Automated detection process for unknown tags"},
     {"clear",   CmdClear,     AlwaysAvailable,         "clear screen"},
-    {"help",    CmdHelp,      AlwaysAvailable,         "This help. Use " _YELLOW_("'<command> help'") " for details of a particular command."},
+    {"help",    CmdHelp,      AlwaysAvailable,         "This help. Use " _YELLOW_("'<command> help'") " for details of a particular command, " _YELLOW_("'help <text>'") " to search"},
     {"hints",   CmdHints,     AlwaysAvailable,         "Turn hints on / off"},
     {"msleep",  CmdMsleep,    AlwaysAvailable,         "Add a pause in milliseconds"},
     {"pref",    CmdPref,      AlwaysAvailable,         "Edit preferences"},
@@ -283,8 +283,14 @@ static command_t CommandTable[] = {
 };
 
 static int CmdHelp(const char *Cmd) {
-    (void)Cmd; // Cmd is not used so far
-    CmdsHelp(CommandTable);
+    char text[64] = {0};
+    if (sscanf(Cmd, "%63s", text) != 1) {
+        CmdsHelp(CommandTable);
+        return PM3_SUCCESS;
+    }
+    // help <text>, search all command paths and descriptions
+    if (CmdsSearch(text) == 0)
+        PrintAndLogEx(INFO, "no command matches " _YELLOW_("%s"), text);
     return PM3_SUCCESS;
 }
 
@@ -11,10 +11,17 @@
 #include "cmdparser.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 
 #include "ui.h"
 #include "comms.h"
+#include "util.h"
+#include "cmdmain.h" // getTopLevelCommandTable
+#include "perf.h"
+
+static void indexCommandsRecursive(const command_t cmds[]);
 
 bool AlwaysAvailable(void) {
     return true;
@@ -175,6 +182,11 @@ void CmdsHelp(const command_t Commands[]) {
     }
 }
 
+// the command path being run, for the telemetry of `hw perf`
+static int cmds_depth = 0;
+static char cmds_path[128] = {0};
+static bool cmds_path_open = false;
+
 int CmdsParse(const command_t Commands[], const char *Cmd) {
     // Help dump children
     if (strcmp(Cmd, "XX_internal_command_dump_XX") == 0) {
@@ -186,6 +198,11 @@ int CmdsParse(const command_t Commands[], const char *Cmd) {
         dumpCommandsRecursive(Commands, 1);
         return PM3_SUCCESS;
     }
+    // command index, children
+    if (strcmp(Cmd, "XX_internal_command_index_XX") == 0) {
+        indexCommandsRecursive(Commands);
+        return PM3_SUCCESS;
+    }
     
     if (strcmp(Cmd, "coffee") == 0) {
         PrintAndLogEx(NORMAL, "");
@@ -237,7 +254,28 @@ int CmdsParse(const command_t Commands[], const char *Cmd) {
     if (Commands[i].Name) {
         while (Cmd[len] == ' ')
             ++len;
-        return Commands[i].Parse(Cmd + len);
+
+        // entering the top level table again, e.g. from a script, is a nested command
+        // and the outer one keeps its name
+        if (cmds_depth == 0) {
+            cmds_path[0] = '\0';
+            cmds_path_open = true;
+        } else if (Commands == getTopLevelCommandTable()) {
+            cmds_path_open = false;
+        }
+        if (cmds_path_open) {
+            size_t plen = strlen(cmds_path);
+            snprintf(cmds_path + plen, sizeof(cmds_path) - plen, "%s%s", plen ? " " : "", Commands[i].Name);
+        }
+
+        if (cmds_depth == 0)
+            perf_cmd_begin();
+        cmds_depth++;
+        int res = Commands[i].Parse(Cmd + len);
+        cmds_depth--;
+        if (cmds_depth == 0)
+            perf_cmd_end(cmds_path, res);
+        return res;
     } else {
         // show help for selected hierarchy or if command not recognised
         CmdsHelp(Commands);
@@ -249,6 +287,107 @@ int CmdsParse(const command_t Commands[], const char *Cmd) {
 static char pparent[512] = {0};
 static char *parent = pparent;
 
+static command_index_t *cmd_index = NULL;
+static size_t cmd_index_count = 0;
+static size_t cmd_index_size = 0;
+
+static void indexCommandsRecursive(const command_t cmds[]) {
+    for (int i = 0; cmds[i].Name; i++) {
+
+        if (cmds[i].Name[0] == '-' || strlen(cmds[i].Name) == 0) continue;
+
+        if (cmd_index_count == cmd_index_size) {
+            size_t size = cmd_index_size ? cmd_index_size * 2 : 512;
+            command_index_t *tmp = realloc(cmd_index, size * sizeof(command_index_t));
+            if (tmp == NULL) return;
+            cmd_index = tmp;
+            cmd_index_size = size;
+        }
+
+        command_index_t *c = &cmd_index[cmd_index_count];
+        size_t len = strlen(parent) + strlen(cmds[i].Name) + 1;
+        c->path = calloc(len, sizeof(char));
+        if (c->path == NULL) return;
+        snprintf(c->path, len, "%s%s", parent, cmds[i].Name);
+        c->help = cmds[i].Help;
+        c->IsAvailable = cmds[i].IsAvailable;
+        c->container = (cmds[i].Help[0] == '{');
+        cmd_index_count++;
+
+        if (c->container == false) continue;
+
+        char currentparent[512] = {0};
+        snprintf(currentparent, sizeof currentparent, "%s ", c->path);
+        char *old_parent = parent;
+        parent = currentparent;
+        cmds[i].Parse("XX_internal_command_index_XX");
+        parent = old_parent;
+    }
+}
+
+static int index_cmp(const void *a, const void *b) {
+    return strcmp(((const command_index_t *)a)->path, ((const command_index_t *)b)->path);
+}
+
+const command_index_t *CmdsIndex(size_t *count) {
+    if (cmd_index == NULL) {
+        // the containers which aren't CmdsParse based, e.g. reveng, run with the index
+        // argument as they do for the help dump. Keep them quiet
+        bool dump_mode = session.help_dump_mode;
+        uint8_t printandlog = g_printAndLog;
+        session.help_dump_mode = true;
+        g_printAndLog = 0;
+        indexCommandsRecursive(getTopLevelCommandTable());
+        g_printAndLog = printandlog;
+        session.help_dump_mode = dump_mode;
+
+        qsort(cmd_index, cmd_index_count, sizeof(command_index_t), index_cmp);
+    }
+    *count = cmd_index_count;
+    return cmd_index;
+}
+
+size_t CmdsIndexFind(const char *prefix) {
+    size_t count;
+    const command_index_t *cmds = CmdsIndex(&count);
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (strcmp(cmds[mid].path, prefix) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static bool contains_nocase(const char *s, const char *needle) {
+    size_t n = strlen(needle);
+    for (; *s; s++) {
+        size_t i = 0;
+        while (i < n && s[i] && tolower((uint8_t)s[i]) == tolower((uint8_t)needle[i]))
+            i++;
+        if (i == n)
+            return true;
+    }
+    return false;
+}
+
+int CmdsSearch(const char *text) {
+    size_t count;
+    const command_index_t *cmds = CmdsIndex(&count);
+    int found = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (contains_nocase(cmds[i].path, text) == false && contains_nocase(cmds[i].help, text) == false)
+            continue;
+        g_printAndLog = PRINTANDLOG_PRINT;
+        PrintAndLogEx(NORMAL, _GREEN_("%-28s") " %s%s", cmds[i].path, cmds[i].help, cmds[i].IsAvailable() ? "" : " (not available)");
+        g_printAndLog = PRINTANDLOG_PRINT | PRINTANDLOG_LOG;
+        found++;
+    }
+    return found;
+}
+
 void dumpCommandsRecursive(const command_t cmds[], int markdown) {
     if (cmds[0].Name == NULL) return;
 
@@ -54,4 +54,18 @@ void CmdsLS(const command_t Commands[]);
 int CmdsParse(const command_t Commands[], const char *Cmd);
 void dumpCommandsRecursive(const command_t cmds[], int markdown);
 
+// Every command path, e.g. "hf 14a sim", sorted. Built once on first use by walking the tables
+typedef struct {
+    char *path;
+    const char *help;
+    bool (*IsAvailable)(void);
+    bool container;
+} command_index_t;
+
+const command_index_t *CmdsIndex(size_t *count);
+// Position of the first path >= prefix, all paths starting with prefix follow it
+size_t CmdsIndexFind(const char *prefix);
+// Print the commands whose path or help contains text, returns how many
+int CmdsSearch(const char *text);
+
 #endif
@@ -43,6 +43,33 @@ static int usage_sm_raw(void) {
     PrintAndLogEx(NORMAL, "        smart raw 0 t d 00a4040007a0000000031010                - Visa");
     return PM3_SUCCESS;
 }
+static int usage_sm_bulk(void) {
+    PrintAndLogEx(NORMAL, "Sends a queue of APDUs in one go, the answers come back together");
+    PrintAndLogEx(NORMAL, "Usage: smart bulk [h|a|s|0|f] <apdu hex> [<apdu hex> ...]");
+    PrintAndLogEx(NORMAL, "       h          :  this help");
+    PrintAndLogEx(NORMAL, "       a          :  active smartcard without select (reset sc module)");
+    PrintAndLogEx(NORMAL, "       s          :  active smartcard with select (get ATR)");
+    PrintAndLogEx(NORMAL, "       0          :  use protocol T=0");
+    PrintAndLogEx(NORMAL, "       f          :  fast i2c timing, when the sim module keeps up");
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(NORMAL, "Examples:");
+    PrintAndLogEx(NORMAL, "        smart bulk s 0 00a404000e315041592e5359532e4444463031 00a4040007a0000000031010");
+    return PM3_SUCCESS;
+}
+static int usage_sm_relay(void) {
+    PrintAndLogEx(NORMAL, "Relays a 14a reader to the card in the smart card slot, on the device. The Proxmark3 answers");
+    PrintAndLogEx(NORMAL, "the activation as a 14a-4 tag and forwards the APDUs, a slow card keeps the reader waiting with WTX");
+    PrintAndLogEx(NORMAL, "Press the Proxmark3 button to stop");
+    PrintAndLogEx(NORMAL, "Usage: smart relay [h|0] [u <uid>]");
+    PrintAndLogEx(NORMAL, "       h          :  this help");
+    PrintAndLogEx(NORMAL, "       u <uid>    :  4 or 7 byte UID, default is 01020304");
+    PrintAndLogEx(NORMAL, "       0          :  use protocol T=0");
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(NORMAL, "Examples:");
+    PrintAndLogEx(NORMAL, "        smart relay");
+    PrintAndLogEx(NORMAL, "        smart relay u 04112233445566");
+    return PM3_SUCCESS;
+}
 static int usage_sm_reader(void) {
     PrintAndLogEx(NORMAL, "Usage: smart reader [h|s]");
     PrintAndLogEx(NORMAL, "       h          :  this help");
@@ -523,6 +550,152 @@ static int CmdSmartRaw(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+static int CmdSmartBulk(const char *Cmd) {
+
+    uint8_t flags = SC_LOG;
+    uint8_t count = 0;
+    uint8_t apdus[PM3_CMD_DATA_SIZE - 2] = {0};
+    size_t apduslen = 0;
+    uint8_t cmdp = 0;
+    bool errors = false;
+
+    while (param_getchar(Cmd, cmdp) != 0x00 && !errors) {
+
+        int slen = param_getlength(Cmd, cmdp);
+        if (slen > 2) {
+            int hexlen = slen >> 1;
+            if (hexlen < 4 || hexlen > 255 || count == 255) {
+                PrintAndLogEx(WARNING, "APDU %u, 4 to 255 bytes and 255 APDUs at most", count + 1);
+                return PM3_EINVARG;
+            }
+            if (apduslen + 1 + hexlen > sizeof(apdus)) {
+                PrintAndLogEx(WARNING, "Too many bytes.  Max %zu bytes", sizeof(apdus));
+                return PM3_EINVARG;
+            }
+            if (param_gethex_ex(Cmd, cmdp, apdus + apduslen + 1, &slen)) {
+                PrintAndLogEx(WARNING, "Invalid HEX value");
+                return PM3_EINVARG;
+            }
+            apdus[apduslen] = hexlen;
+            apduslen += 1 + hexlen;
+            count++;
+            cmdp++;
+            continue;
+        }
+
+        switch (tolower(param_getchar(Cmd, cmdp))) {
+            case 'h':
+                return usage_sm_bulk();
+            case 'a':
+                flags |= (SC_CONNECT | SC_CLEARLOG);
+                cmdp++;
+                break;
+            case 's':
+                flags |= (SC_CONNECT | SC_CLEARLOG | SC_SELECT);
+                cmdp++;
+                break;
+            case '0':
+                flags |= SC_RAW_T0;
+                cmdp++;
+                break;
+            case 'f':
+                flags |= SC_FAST;
+                cmdp++;
+                break;
+            default:
+                PrintAndLogEx(WARNING, "Unknown parameter '%c'", param_getchar(Cmd, cmdp));
+                errors = true;
+                break;
+        }
+    }
+
+    if (errors || count == 0) return usage_sm_bulk();
+
+    if ((flags & SC_RAW_T0) == 0)
+        flags |= SC_RAW;
+
+    uint8_t *buf = calloc(count, 1 + 255);
+    if (buf == NULL)
+        return PM3_EMALLOC;
+
+    size_t len = 0;
+    int res = ExchangeAPDUSCBulk(flags, apdus, apduslen, count, buf, count * (1 + 255), &len);
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(WARNING, "smart card bulk exchange failed (%d)", res);
+    }
+
+    size_t pos = 0;
+    for (uint8_t i = 0; i < count && pos < len; i++) {
+        uint8_t rlen = buf[pos++];
+        uint8_t *r = buf + pos;
+        pos += rlen;
+        if (rlen < 2) {
+            PrintAndLogEx(WARNING, "%3u | " _RED_("no answer"), i + 1);
+            continue;
+        }
+        PrintAndLogEx(SUCCESS, "%3u | %s", i + 1, sprint_hex_inrow(r, rlen));
+        PrintAndLogEx(SUCCESS, "    | %02X%02X | %s", r[rlen - 2], r[rlen - 1], GetAPDUCodeDescription(r[rlen - 2], r[rlen - 1]));
+    }
+
+    free(buf);
+    return res;
+}
+
+static int CmdSmartRelay(const char *Cmd) {
+
+    sc_relay_req_t payload = { .uidlen = 4, .uid = {0x01, 0x02, 0x03, 0x04} };
+    uint8_t cmdp = 0;
+    bool errors = false;
+
+    while (param_getchar(Cmd, cmdp) != 0x00 && !errors) {
+        switch (tolower(param_getchar(Cmd, cmdp))) {
+            case 'h':
+                return usage_sm_relay();
+            case 'u': {
+                int len = param_getlength(Cmd, cmdp + 1);
+                if ((len != 8 && len != 14) || param_gethex_ex(Cmd, cmdp + 1, payload.uid, &len)) {
+                    PrintAndLogEx(WARNING, "UID must be 4 or 7 bytes");
+                    errors = true;
+                }
+                payload.uidlen = len / 2;
+                cmdp += 2;
+                break;
+            }
+            case '0':
+                payload.flags |= SC_RAW_T0;
+                cmdp++;
+                break;
+            default:
+                PrintAndLogEx(WARNING, "Unknown parameter '%c'", param_getchar(Cmd, cmdp));
+                errors = true;
+                break;
+        }
+    }
+
+    if (errors) return usage_sm_relay();
+
+    PrintAndLogEx(INFO, "Relaying to the smart card, UID " _YELLOW_("%s"), sprint_hex_inrow(payload.uid, payload.uidlen));
+    PrintAndLogEx(INFO, "Press " _GREEN_("pm3 button") " to stop");
+
+    PacketResponseNG resp;
+    clearCommandBuffer();
+    SendCommandNG(CMD_SMART_RELAY, (uint8_t *)&payload, sizeof(payload));
+    WaitForResponse(CMD_SMART_RELAY, &resp);
+
+    if (resp.status == PM3_ECARDEXCHANGE) {
+        PrintAndLogEx(WARNING, "smart card select failed");
+        return resp.status;
+    }
+    if (resp.length < sizeof(sc_relay_resp_t)) {
+        PrintAndLogEx(WARNING, "relay failed (%d)", resp.status);
+        return resp.status;
+    }
+
+    const sc_relay_resp_t *stats = (const sc_relay_resp_t *)resp.data.asBytes;
+    PrintAndLogEx(SUCCESS, "relayed " _YELLOW_("%u") " APDUs, " _YELLOW_("%u") " WTX, slowest " _YELLOW_("%u") " ms", stats->apdus, stats->wtx, stats->max_ms);
+    return PM3_SUCCESS;
+}
+
 static int CmdSmartUpgrade(const char *Cmd) {
 
     PrintAndLogEx(WARNING, "WARNING - Sim module firmware upgrade.");
@@ -1112,6 +1285,8 @@ static command_t CommandTable[] = {
     {"info",     CmdSmartInfo,          IfPm3Smartcard,  "Tag information"},
     {"reader",   CmdSmartReader,        IfPm3Smartcard,  "Act like an IS07816 reader"},
     {"raw",      CmdSmartRaw,           IfPm3Smartcard,  "Send raw hex data to tag"},
+    {"bulk",     CmdSmartBulk,          IfPm3Smartcard,  "Send a queue of APDUs, one round trip"},
+    {"relay",    CmdSmartRelay,         IfPm3Smartcard,  "Relay a 14a reader to the smart card, on the device"},
     {"upgrade",  CmdSmartUpgrade,       AlwaysAvailable,  "Upgrade sim module firmware"},
     {"setclock", CmdSmartSetClock,      IfPm3Smartcard,  "Set clock speed"},
     {"brute",    CmdSmartBruteforceSFI, IfPm3Smartcard,  "Bruteforce SFI"},
@@ -1170,6 +1345,44 @@ int ExchangeAPDUSC(bool silent, uint8_t *datain, int datainlen, bool activateCar
     return 0;
 }
 
+int ExchangeAPDUSCBulk(uint8_t flags, const uint8_t *apdus, size_t apduslen, uint8_t count, uint8_t *dataout, size_t maxdataoutlen, size_t *dataoutlen) {
+
+    *dataoutlen = 0;
+
+    struct p {
+        uint8_t flags;
+        uint8_t count;
+        uint8_t apdus[PM3_CMD_DATA_SIZE - 2];
+    } PACKED payload;
+
+    if (apduslen > sizeof(payload.apdus))
+        return PM3_EINVARG;
+
+    payload.flags = flags;
+    payload.count = count;
+    memcpy(payload.apdus, apdus, apduslen);
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_SMART_RAW_BULK, (uint8_t *)&payload, 2 + apduslen);
+
+    // answers come in frames as the device fills them, up to 1.8s each
+    PacketResponseNG resp;
+    do {
+        if (WaitForResponseTimeout(CMD_SMART_RAW_BULK, &resp, 2500 * count) == false) {
+            PrintAndLogEx(WARNING, "smart card response timeout");
+            return PM3_ETIMEOUT;
+        }
+
+        if (*dataoutlen + resp.length > maxdataoutlen)
+            return PM3_EOVFLOW;
+
+        memcpy(dataout + *dataoutlen, resp.data.asBytes, resp.length);
+        *dataoutlen += resp.length;
+    } while (resp.status == PM3_EPARTIAL);
+
+    return resp.status;
+}
+
 bool smart_select(bool silent, smart_card_atr_t *atr) {
     if (atr)
         memset(atr, 0, sizeof(smart_card_atr_t));
@@ -18,5 +18,8 @@ int CmdSmartcard(const char *Cmd);
 
 bool smart_select(bool silent, smart_card_atr_t *atr);
 int ExchangeAPDUSC(bool silent, uint8_t *datain, int datainlen, bool activateCard, bool leaveSignalON, uint8_t *dataout, int maxdataoutlen, int *dataoutlen);
+// count APDUs packed as [len][APDU] in one host command, flags as for CMD_SMART_RAW.
+// Answers come back packed as [len][response], GET RESPONSE done on the device, len 0 when the exchange failed
+int ExchangeAPDUSCBulk(uint8_t flags, const uint8_t *apdus, size_t apduslen, uint8_t count, uint8_t *dataout, size_t maxdataoutlen, size_t *dataoutlen);
 
 #endif
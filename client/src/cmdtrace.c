@@ -19,16 +19,28 @@
 #include "fileutils.h"          // for saveFile
 #include "cmdlfhitag.h"         // annotate hitag
 #include "pm3_cmd.h"            // tracelog_hdr_t
+#include "commonutil.h"         // bytes_to_num
+#include "util_posix.h"         // msclock
+#include "crc16.h"              // Crc16ex
 
 static int CmdHelp(const char *Cmd);
 
-// trace pointer
+// trace pointer,  heap for a downloaded trace or a file mapping after trace load
 static uint8_t *g_trace;
 static long g_traceLen = 0;
+static bool g_trace_mapped = false;
+
+// offset of every record in the trace,  built once when the trace arrives
+static uint32_t *g_trace_index = NULL;
+static uint32_t g_trace_records = 0;
+static uint32_t g_trace_index_cap = 0;
+
+// live listing state
+static uint8_t g_live_protocol = 0;
 
 static int usage_trace_list(void) {
     PrintAndLogEx(NORMAL, "List protocol data in trace buffer.");
-    PrintAndLogEx(NORMAL, "Usage:  trace list <protocol> [f][c| <0|1>");
+    PrintAndLogEx(NORMAL, "Usage:  trace list <protocol> [f][c| <0|1> [s <rec>] [n <cnt>] [t <from> <to>] [d <r|t>] [k <dic>]");
     PrintAndLogEx(NORMAL, "    f      - show frame delay times as well");
     PrintAndLogEx(NORMAL, "    c      - mark CRC bytes");
     PrintAndLogEx(NORMAL, "    r      - show relative times (gap and duration)");
@@ -36,6 +48,11 @@ static int usage_trace_list(void) {
     PrintAndLogEx(NORMAL, "    x      - show hexdump to convert to pcap(ng) or to import into Wireshark using encapsulation type \"ISO 14443\"");
     PrintAndLogEx(NORMAL, "             syntax to use: `text2pcap -t \"%%S.\" -l 264 -n <input-text-file> <output-pcapng-file>`");
     PrintAndLogEx(NORMAL, "    <0|1>  - use data from Tracebuffer, if not set, try to collect a trace from Proxmark3 device.");
+    PrintAndLogEx(NORMAL, "    s <rec>        - start at record number <rec>");
+    PrintAndLogEx(NORMAL, "    n <cnt>        - show at most <cnt> records, use with s to page through large traces");
+    PrintAndLogEx(NORMAL, "    t <from> <to>  - only records starting in this time window, same units as the Start column");
+    PrintAndLogEx(NORMAL, "    d <r|t>        - only records sent by the reader (r) or the tag (t)");
+    PrintAndLogEx(NORMAL, "    k <dic>        - mf only, also try the keys of dictionary file <dic> on nested authentications");
     PrintAndLogEx(NORMAL, "Supported <protocol> values:");
     PrintAndLogEx(NORMAL, "    raw      - just show raw data without annotations");
     PrintAndLogEx(NORMAL, "    14a      - interpret data as iso14443a communications");
@@ -59,6 +76,9 @@ static int usage_trace_list(void) {
     PrintAndLogEx(NORMAL, _YELLOW_("        trace list 14a f"));
     PrintAndLogEx(NORMAL, _YELLOW_("        trace list iclass"));
     PrintAndLogEx(NORMAL, _YELLOW_("        trace list 14a 1"));
+    PrintAndLogEx(NORMAL, _YELLOW_("        trace list 14a 1 s 1000 n 50"));
+    PrintAndLogEx(NORMAL, _YELLOW_("        trace list 14a 1 d t t 100000 200000"));
+    PrintAndLogEx(NORMAL, _YELLOW_("        trace list mf 1 k mfc_default_keys"));
     return PM3_SUCCESS;
 }
 static int usage_trace_load(void) {
@@ -76,16 +96,34 @@ static int usage_trace_save(void) {
     return PM3_SUCCESS;
 }
 
-static bool is_last_record(uint16_t tracepos, uint16_t traceLen) {
+static int usage_trace_export(void) {
+    PrintAndLogEx(NORMAL, "Export protocol data to PCAP-NG or to a columnar binary file");
+    PrintAndLogEx(NORMAL, "Records are streamed, with " _YELLOW_("f") " the trace file is read piecewise and no device is needed");
+    PrintAndLogEx(NORMAL, "Usage:  trace export <p|c> <filename> [<protocol>] [f <tracefile>]");
+    PrintAndLogEx(NORMAL, "    p              - PCAP-NG, one interface with the link type of <protocol>, nanosecond timestamps");
+    PrintAndLogEx(NORMAL, "                     ISO14443 based protocols use link type 264 (ISO 14443) with its pseudo header");
+    PrintAndLogEx(NORMAL, "                     the others use the link types USER0..USER8, see doc/trace_notes.md");
+    PrintAndLogEx(NORMAL, "    c              - columnar binary file, see doc/trace_notes.md for the layout");
+    PrintAndLogEx(NORMAL, "    <filename>     - output file, " _YELLOW_(".pcapng") " or " _YELLOW_(".trcol") " is appended");
+    PrintAndLogEx(NORMAL, "    <protocol>     - protocol of the trace, same values as trace list, defaults to 14a");
+    PrintAndLogEx(NORMAL, "    f <tracefile>  - read the records from <tracefile> instead of the trace buffer");
+    PrintAndLogEx(NORMAL, "Examples:");
+    PrintAndLogEx(NORMAL, _YELLOW_("        trace export p mytrace 14a"));
+    PrintAndLogEx(NORMAL, _YELLOW_("        trace export p mytrace 15 f traces/hf_15_reader.trace"));
+    PrintAndLogEx(NORMAL, _YELLOW_("        trace export c mytrace mf f mytracefile.trace"));
+    return PM3_SUCCESS;
+}
+
+static bool is_last_record(uint32_t tracepos, uint32_t traceLen) {
     return ((tracepos + TRACELOG_HDR_LEN) >= traceLen);
 }
 
-static bool next_record_is_response(uint16_t tracepos, uint8_t *trace) {
+static bool next_record_is_response(uint32_t tracepos, uint8_t *trace) {
     tracelog_hdr_t *hdr = (tracelog_hdr_t *)(trace + tracepos);
     return (hdr->isResponse);
 }
 
-static bool merge_topaz_reader_frames(uint32_t timestamp, uint32_t *duration, uint16_t *tracepos, uint16_t traceLen,
+static bool merge_topaz_reader_frames(uint32_t timestamp, uint32_t *duration, uint32_t *tracepos, uint32_t traceLen,
                                       uint8_t *trace, uint8_t *frame, uint8_t *topaz_reader_command, uint16_t *data_len) {
 
 #define MAX_TOPAZ_READER_CMD_LEN 16
@@ -119,13 +157,13 @@ static bool merge_topaz_reader_frames(uint32_t timestamp, uint32_t *duration, ui
     return true;
 }
 
-static uint16_t printHexLine(uint16_t tracepos, uint16_t traceLen, uint8_t *trace, uint8_t protocol) {
+static uint32_t printHexLine(uint32_t tracepos, uint32_t traceLen, uint8_t *trace, uint8_t protocol) {
     // sanity check
     if (is_last_record(tracepos, traceLen)) return traceLen;
 
     tracelog_hdr_t *hdr = (tracelog_hdr_t *)(trace + tracepos);
 
-    if (TRACELOG_HDR_LEN + hdr->data_len + TRACELOG_PARITY_LEN(hdr) > traceLen) {
+    if (tracepos + TRACELOG_HDR_LEN + hdr->data_len + TRACELOG_PARITY_LEN(hdr) > traceLen) {
         return traceLen;
     }
 
@@ -137,7 +175,7 @@ static uint16_t printHexLine(uint16_t tracepos, uint16_t traceLen, uint8_t *trac
         return tracepos;
     }
 
-    uint16_t ret;
+    uint32_t ret;
 
     switch (protocol) {
         case ISO_14443A: {
@@ -182,7 +220,17 @@ static uint16_t printHexLine(uint16_t tracepos, uint16_t traceLen, uint8_t *trac
     return ret;
 }
 
-static uint16_t printTraceLine(uint16_t tracepos, uint16_t traceLen, uint8_t *trace, uint8_t protocol, bool showWaitCycles, bool markCRCBytes, uint32_t *prev_eot, bool use_us) {
+// same as sprintf(dst, "%02x! ") or "%02x  ", done for every listed byte
+static void put_hex_byte(char *dst, uint8_t b, bool parity_error) {
+    static const char hex[] = "0123456789abcdef";
+    dst[0] = hex[b >> 4];
+    dst[1] = hex[b & 0x0F];
+    dst[2] = (parity_error) ? '!' : ' ';
+    dst[3] = ' ';
+    dst[4] = 0;
+}
+
+static uint32_t printTraceLine(uint32_t tracepos, uint32_t traceLen, uint8_t *trace, uint8_t protocol, bool showWaitCycles, bool markCRCBytes, uint32_t *prev_eot, bool use_us) {
     // sanity check
     if (is_last_record(tracepos, traceLen)) {
         PrintAndLogEx(DEBUG, "last record triggered.  t-pos: %u  t-len %u", tracepos, traceLen);
@@ -303,20 +351,16 @@ static uint16_t printTraceLine(uint16_t tracepos, uint16_t traceLen, uint8_t *tr
                 && (hdr->isResponse || protocol == ISO_14443A)
                 && (oddparity8(frame[j]) != ((parityBits >> (7 - (j & 0x0007))) & 0x01))) {
 
-            snprintf(line[j / 18] + ((j % 18) * 4), 120, "%02x! ", frame[j]);
+            put_hex_byte(line[j / 18] + ((j % 18) * 4), frame[j], true);
         } else if (protocol == ICLASS  && hdr->isResponse == false) {
             uint8_t parity = 0;
             for (int i = 0; i < 6; i++) {
                 parity ^= ((frame[0] >> i) & 1);
             }
-            if (parity == ((frame[0] >> 7) & 1)) {
-                snprintf(line[j / 18] + ((j % 18) * 4), 120, "%02x  ", frame[j]);
-            } else {
-                snprintf(line[j / 18] + ((j % 18) * 4), 120, "%02x! ", frame[j]);
-            }
+            put_hex_byte(line[j / 18] + ((j % 18) * 4), frame[j], parity != ((frame[0] >> 7) & 1));
 
         } else {
-            snprintf(line[j / 18] + ((j % 18) * 4), 120, "%02x  ", frame[j]);
+            put_hex_byte(line[j / 18] + ((j % 18) * 4), frame[j], false);
         }
 
     }
@@ -505,6 +549,212 @@ static uint16_t printTraceLine(uint16_t tracepos, uint16_t traceLen, uint8_t *tr
     return tracepos;
 }
 
+static void trace_clear(void) {
+    if (g_trace_mapped)
+        unmapFile(g_trace, g_traceLen);
+    else
+        free(g_trace);
+
+    g_trace = NULL;
+    g_traceLen = 0;
+    g_trace_mapped = false;
+
+    free(g_trace_index);
+    g_trace_index = NULL;
+    g_trace_records = 0;
+}
+
+// one pass over the trace from tracepos on, recording where each record starts.
+// A truncated last record is left out, like the list loop does.
+static int trace_index_extend(uint32_t tracepos) {
+
+    if (g_trace_index == NULL) {
+        g_trace_index_cap = 1024;
+        g_trace_records = 0;
+        g_trace_index = calloc(g_trace_index_cap, sizeof(uint32_t));
+        if (g_trace_index == NULL) {
+            PrintAndLogEx(FAILED, "Cannot allocate memory for trace index");
+            return PM3_EMALLOC;
+        }
+    }
+
+    while (is_last_record(tracepos, g_traceLen) == false) {
+        tracelog_hdr_t *hdr = (tracelog_hdr_t *)(g_trace + tracepos);
+        uint32_t next = tracepos + TRACELOG_HDR_LEN + hdr->data_len + TRACELOG_PARITY_LEN(hdr);
+        if (next > g_traceLen)
+            break;
+
+        if (g_trace_records == g_trace_index_cap) {
+            uint32_t *tmp = realloc(g_trace_index, 2 * g_trace_index_cap * sizeof(uint32_t));
+            if (tmp == NULL) {
+                PrintAndLogEx(FAILED, "Cannot allocate memory for trace index");
+                free(g_trace_index);
+                g_trace_index = NULL;
+                g_trace_records = 0;
+                return PM3_EMALLOC;
+            }
+            g_trace_index = tmp;
+            g_trace_index_cap *= 2;
+        }
+        g_trace_index[g_trace_records++] = tracepos;
+        tracepos = next;
+    }
+    return PM3_SUCCESS;
+}
+
+static int trace_build_index(void) {
+    free(g_trace_index);
+    g_trace_index = NULL;
+    return trace_index_extend(0);
+}
+
+// first record starting at or after tracepos
+static uint32_t trace_record_at(uint32_t first, uint32_t tracepos) {
+    uint32_t lo = first, hi = g_trace_records;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (g_trace_index[mid] < tracepos)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// Collects the authentications of the whole trace and searches their keys
+// before the listing starts, DecodeMifareData picks the results up.
+static void trace_search_mf_keys(const char *dict_fn) {
+    ClearMifareKeyCache();
+
+    uint64_t *dict = NULL;
+    uint32_t dictcnt = 0;
+    if (dict_fn[0] != 0) {
+        uint8_t *keyblock = NULL;
+        if (loadFileDICTIONARY_safe(dict_fn, (void **)&keyblock, 6, &dictcnt) == PM3_SUCCESS && keyblock != NULL)
+            dict = calloc(dictcnt, sizeof(uint64_t));
+
+        if (dict == NULL) {
+            PrintAndLogEx(FAILED, "An error occurred while loading the dictionary! (we will use the default keys now)");
+            dictcnt = 0;
+        }
+        for (uint32_t i = 0; i < dictcnt; i++)
+            dict[i] = bytes_to_num(keyblock + i * 6, 6);
+
+        free(keyblock);
+    }
+
+    for (uint32_t i = 0; i < g_trace_records; i++) {
+        tracelog_hdr_t *hdr = (tracelog_hdr_t *)(g_trace + g_trace_index[i]);
+        CollectMifareAuth(hdr->frame, hdr->data_len, hdr->frame + hdr->data_len, hdr->isResponse);
+    }
+    SearchMifareKeys(dict, dictcnt);
+    free(dict);
+}
+
+static void print_list_header(bool use_relative) {
+    PrintAndLogEx(NORMAL, "");
+    if (use_relative) {
+        PrintAndLogEx(NORMAL, "        Gap |   Duration | Src | Data (! denotes parity error, ' denotes short bytes)                    | CRC | Annotation");
+    } else {
+        PrintAndLogEx(NORMAL, "      Start |        End | Src | Data (! denotes parity error)                                           | CRC | Annotation");
+    }
+    PrintAndLogEx(NORMAL, "------------+------------+-----+-------------------------------------------------------------------------+-----+--------------------");
+}
+
+int trace_live_begin(uint8_t protocol) {
+    trace_clear();
+
+    g_live_protocol = protocol;
+    if (protocol == ISO_14443A || protocol == PROTO_MIFARE)
+        ClearAuthData();
+    ClearMifareKeyCache();
+
+    print_list_header(false);
+    return PM3_SUCCESS;
+}
+
+int trace_live_add(const uint8_t *records, uint32_t len) {
+    if (len == 0)
+        return PM3_SUCCESS;
+
+    uint8_t *tmp = realloc(g_trace, g_traceLen + len);
+    if (tmp == NULL) {
+        PrintAndLogEx(FAILED, "Cannot allocate memory for trace");
+        return PM3_EMALLOC;
+    }
+    g_trace = tmp;
+
+    uint32_t tracepos = g_traceLen;
+    memcpy(g_trace + g_traceLen, records, len);
+    g_traceLen += len;
+
+    uint32_t first = g_trace_records;
+    int res = trace_index_extend(tracepos);
+    if (res != PM3_SUCCESS)
+        return res;
+
+    // frames only carry whole records
+    for (uint32_t rec = first; rec < g_trace_records; rec++) {
+        if (g_trace_index[rec] < tracepos)
+            continue;
+        tracepos = printTraceLine(g_trace_index[rec], g_traceLen, g_trace, g_live_protocol, false, false, NULL, false);
+    }
+    return PM3_SUCCESS;
+}
+
+int trace_live_sniff(uint16_t cmd, uint8_t protocol, const uint8_t *param, uint16_t paramlen) {
+
+    clearCommandBuffer();
+    SendCommandNG(cmd, (uint8_t *)param, paramlen);
+    PrintAndLogEx(INFO, "Sniffing live, press " _GREEN_("Enter") " to stop");
+
+    trace_live_begin(protocol);
+
+    PacketResponseNG resp;
+    hf14a_sniff_frame_t *frame = (hf14a_sniff_frame_t *)resp.data.asBytes;
+    uint64_t stopped = 0;
+    uint16_t seq = 0;
+    int status = PM3_SUCCESS;
+
+    for (;;) {
+        if (stopped == 0 && kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            stopped = msclock();
+        }
+
+        // a quiet field sends nothing, only give up once asked to stop
+        if (WaitForResponseTimeout(cmd, &resp, 100) == false) {
+            if (stopped == 0 || msclock() - stopped < 2500)
+                continue;
+
+            PrintAndLogEx(WARNING, "(trace_live_sniff) command execution time out");
+            status = PM3_ETIMEOUT;
+            break;
+        }
+
+        if (resp.length < sizeof(hf14a_sniff_frame_t) - HF14A_SNIFF_RECORDS) {
+            status = resp.status;
+            break;
+        }
+
+        if (frame->seq != seq)
+            PrintAndLogEx(WARNING, "lost " _YELLOW_("%u") " frames", (uint16_t)(frame->seq - seq));
+        seq = frame->seq + 1;
+
+        trace_live_add(frame->data, MIN(frame->len, HF14A_SNIFF_RECORDS));
+
+        if (frame->final) {
+            status = resp.status;
+            break;
+        }
+    }
+
+    if (status == PM3_EOVFLOW)
+        PrintAndLogEx(WARNING, "sniffing stopped, the device could not keep up");
+
+    return (status == PM3_EOPABORTED) ? PM3_SUCCESS : status;
+}
+
 static int download_trace(void) {
 
     if (IfPm3Present() == false) {
@@ -513,10 +763,7 @@ static int download_trace(void) {
     }
 
     // reserve some space.
-    if (g_trace)
-        free(g_trace);
-
-    g_traceLen = 0;
+    trace_clear();
 
     g_trace = calloc(PM3_CMD_DATA_SIZE, sizeof(uint8_t));
     if (g_trace == NULL) {
@@ -530,7 +777,7 @@ static int download_trace(void) {
     PacketResponseNG response;
     if (!GetFromDevice(BIG_BUF, g_trace, PM3_CMD_DATA_SIZE, 0, NULL, 0, &response, 4000, true)) {
         PrintAndLogEx(WARNING, "timeout while waiting for reply.");
-        free(g_trace);
+        trace_clear();
         return PM3_ETIMEOUT;
     }
 
@@ -543,16 +790,17 @@ static int download_trace(void) {
         g_trace = calloc(g_traceLen, sizeof(uint8_t));
         if (g_trace == NULL) {
             PrintAndLogEx(FAILED, "Cannot allocate memory for trace");
+            g_traceLen = 0;
             return PM3_EMALLOC;
         }
 
         if (!GetFromDevice(BIG_BUF, g_trace, g_traceLen, 0, NULL, 0, NULL, 2500, false)) {
             PrintAndLogEx(WARNING, "command execution time out");
-            free(g_trace);
+            trace_clear();
             return PM3_ETIMEOUT;
         }
     }
-    return PM3_SUCCESS;
+    return trace_build_index();
 }
 
 // sanity check. Don't use proxmark if it is offline and you didn't specify useTraceBuffer
@@ -566,6 +814,44 @@ static int SanityOfflineCheck( bool useTraceBuffer ){
 }
 */
 
+// Standalone sniffers write to flash in chunks, each one a spiffs_log_chunk_t then its payload.
+// Put the payloads back together, a chunk cut short by a power loss ends the trace there.
+// Returns false if the data doesn't start with a valid chunk
+static bool trace_unframe(const uint8_t *data, size_t len, uint8_t **out, size_t *outlen) {
+    const size_t hdr = sizeof(spiffs_log_chunk_t);
+    if (len < hdr)
+        return false;
+
+    *out = calloc(len, sizeof(uint8_t));
+    if (*out == NULL)
+        return false;
+
+    size_t pos = 0, n = 0, chunks = 0;
+    while (pos + hdr <= len) {
+        spiffs_log_chunk_t chunk;
+        memcpy(&chunk, data + pos, hdr);
+        if (chunk.magic != SPIFFS_LOG_MAGIC || chunk.len > len - pos - hdr || Crc16ex(CRC_CCITT, data + pos + hdr, chunk.len) != chunk.crc)
+            break;
+
+        memcpy(*out + n, data + pos + hdr, chunk.len);
+        n += chunk.len;
+        pos += hdr + chunk.len;
+        chunks++;
+    }
+
+    if (chunks == 0) {
+        free(*out);
+        *out = NULL;
+        return false;
+    }
+
+    if (pos < len)
+        PrintAndLogEx(WARNING, "Flash log damaged after chunk %zu, dropped the last " _YELLOW_("%zu") " bytes", chunks, len - pos);
+
+    *outlen = n;
+    return true;
+}
+
 static int CmdTraceLoad(const char *Cmd) {
 
     char cmdp = tolower(param_getchar(Cmd, 0));
@@ -574,18 +860,38 @@ static int CmdTraceLoad(const char *Cmd) {
     char filename[FILE_PATH_SIZE];
     param_getstr(Cmd, 0, filename, sizeof(filename));
 
-    if (g_trace)
-        free(g_trace);
+    trace_clear();
 
+    // mapped instead of read, multi megabyte flash sniffs only get paged in as they are listed
     size_t len = 0;
-    if (loadFile_safe(filename, ".trace", (void **)&g_trace, &len) != PM3_SUCCESS) {
+    // a name given with its extension is taken as is, e.g. what `mem spiffs dump` saved
+    const char *suffix = fileExists(filename) ? "" : ".trace";
+    if (mapFile_safe(filename, suffix, (void **)&g_trace, &len) != PM3_SUCCESS) {
         PrintAndLogEx(FAILED, "Could not open file " _YELLOW_("%s"), filename);
+        g_trace = NULL;
         return PM3_EIO;
     }
 
     g_traceLen = (long)len;
+    g_trace_mapped = true;
+
+    // from a standalone mode's flash log
+    uint8_t *unframed = NULL;
+    size_t unframed_len = 0;
+    if (trace_unframe(g_trace, len, &unframed, &unframed_len)) {
+        unmapFile(g_trace, len);
+        g_trace = unframed;
+        g_traceLen = (long)unframed_len;
+        g_trace_mapped = false;
+    }
 
-    PrintAndLogEx(SUCCESS, "Recorded Activity (TraceLen = " _YELLOW_("%lu") " bytes)", g_traceLen);
+    int res = trace_build_index();
+    if (res != PM3_SUCCESS) {
+        trace_clear();
+        return res;
+    }
+
+    PrintAndLogEx(SUCCESS, "Recorded Activity (TraceLen = " _YELLOW_("%lu") " bytes, " _YELLOW_("%u") " records)", g_traceLen, g_trace_records);
     return PM3_SUCCESS;
 }
 
@@ -609,6 +915,405 @@ static int CmdTraceSave(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// maps the <protocol> names of trace list / trace export
+static bool trace_get_protocol(const char *type, uint8_t *protocol) {
+    if (strcmp(type,      "iclass") == 0)   *protocol = ICLASS;
+    else if (strcmp(type, "14a") == 0)      *protocol = ISO_14443A;
+    else if (strcmp(type, "14b") == 0)      *protocol = ISO_14443B;
+    else if (strcmp(type, "topaz") == 0)    *protocol = TOPAZ;
+    else if (strcmp(type, "7816") == 0)     *protocol = ISO_7816_4;
+    else if (strcmp(type, "des") == 0)      *protocol = MFDES;
+    else if (strcmp(type, "legic") == 0)    *protocol = LEGIC;
+    else if (strcmp(type, "15") == 0)       *protocol = ISO_15693;
+    else if (strcmp(type, "felica") == 0)   *protocol = FELICA;
+    else if (strcmp(type, "mf") == 0)       *protocol = PROTO_MIFARE;
+    else if (strcmp(type, "hitag1") == 0)   *protocol = PROTO_HITAG1;
+    else if (strcmp(type, "hitag2") == 0)   *protocol = PROTO_HITAG2;
+    else if (strcmp(type, "hitags") == 0)   *protocol = PROTO_HITAGS;
+    else if (strcmp(type, "thinfilm") == 0) *protocol = THINFILM;
+    else if (strcmp(type, "lto") == 0)      *protocol = LTO;
+    else if (strcmp(type, "cryptorf") == 0) *protocol = PROTO_CRYPTORF;
+    else if (strcmp(type, "raw") == 0)      *protocol = -1; //No crc, no annotations
+    else return false;
+    return true;
+}
+
+// trace records from the trace buffer or streamed from a trace file,  one record in memory at a time
+typedef struct {
+    FILE *f;
+    uint32_t pos;
+    tracelog_hdr_t hdr;
+    uint8_t *frame;     // data_len bytes of data followed by the parity bytes
+    uint16_t frame_len;
+} trace_reader_t;
+
+static int trace_reader_open(trace_reader_t *rd, const char *filename) {
+    memset(rd, 0, sizeof(trace_reader_t));
+    if (filename[0] == 0)
+        return PM3_SUCCESS;
+
+    char *path;
+    if (searchFile(&path, RESOURCES_SUBDIR, filename, ".trace", false) != PM3_SUCCESS)
+        return PM3_EFILE;
+
+    rd->f = fopen(path, "rb");
+    if (rd->f == NULL) {
+        PrintAndLogEx(WARNING, "file not found or locked. '" _YELLOW_("%s")"'", path);
+        free(path);
+        return PM3_EFILE;
+    }
+    free(path);
+
+    // largest record,  15 bits of data and their parity
+    rd->frame = calloc(0x7FFF + 0x1000, sizeof(uint8_t));
+    if (rd->frame == NULL) {
+        fclose(rd->f);
+        rd->f = NULL;
+        return PM3_EMALLOC;
+    }
+    return PM3_SUCCESS;
+}
+
+static void trace_reader_close(trace_reader_t *rd) {
+    // frame points into the trace buffer unless streaming from a file
+    if (rd->f) {
+        fclose(rd->f);
+        free(rd->frame);
+    }
+    memset(rd, 0, sizeof(trace_reader_t));
+}
+
+static void trace_reader_rewind(trace_reader_t *rd) {
+    rd->pos = 0;
+    if (rd->f)
+        rewind(rd->f);
+}
+
+// next record,  with_frame == false only skips over the data
+static bool trace_reader_next(trace_reader_t *rd, bool with_frame) {
+    if (rd->f == NULL) {
+        if (is_last_record(rd->pos, g_traceLen))
+            return false;
+
+        tracelog_hdr_t *hdr = (tracelog_hdr_t *)(g_trace + rd->pos);
+        if (hdr->data_len == 0)
+            return false;
+
+        uint16_t len = hdr->data_len + TRACELOG_PARITY_LEN(hdr);
+        if (rd->pos + TRACELOG_HDR_LEN + len > g_traceLen)
+            return false;
+
+        rd->hdr = *hdr;
+        rd->frame = hdr->frame;
+        rd->frame_len = len;
+        rd->pos += TRACELOG_HDR_LEN + len;
+        return true;
+    }
+
+    if (fread(&rd->hdr, TRACELOG_HDR_LEN, 1, rd->f) != 1 || rd->hdr.data_len == 0)
+        return false;
+
+    rd->frame_len = rd->hdr.data_len + TRACELOG_PARITY_LEN(&rd->hdr);
+    if (with_frame) {
+        if (fread(rd->frame, rd->frame_len, 1, rd->f) != 1)
+            return false;
+    } else if (fseek(rd->f, rd->frame_len, SEEK_CUR) != 0) {
+        return false;
+    }
+    rd->pos += TRACELOG_HDR_LEN + rd->frame_len;
+    return true;
+}
+
+// timestamps wrap at 32 bits,  trace records start in time order
+static uint64_t trace_unwrap_timestamp(uint32_t ts, uint64_t *last) {
+    uint64_t t = (*last & ~(uint64_t)UINT32_MAX) | ts;
+    if (ts < (uint32_t)*last && (uint32_t)*last - ts > 0x80000000)
+        t += (uint64_t)UINT32_MAX + 1;
+    *last = t;
+    return t;
+}
+
+typedef struct {
+    uint16_t linktype;
+    const char *name;
+    uint32_t ts_num;    // nanoseconds = timestamp * ts_num / ts_den
+    uint32_t ts_den;
+    uint32_t dur_num;   // nanoseconds = duration * dur_num / dur_den
+    uint32_t dur_den;
+} trace_export_proto_t;
+
+#define LINKTYPE_USER0      147
+#define LINKTYPE_ISO_14443  264
+
+static trace_export_proto_t trace_export_proto(uint8_t protocol) {
+    switch (protocol) {
+        case ISO_14443A:
+        case PROTO_MIFARE:
+        case MFDES:
+        case TOPAZ:
+        case LTO:
+            return (trace_export_proto_t) {LINKTYPE_ISO_14443, "iso14443a", 25000, 339, 25000, 339};
+        case ISO_14443B:
+        case PROTO_CRYPTORF:
+            return (trace_export_proto_t) {LINKTYPE_ISO_14443, "iso14443b", 25000, 339, 25000, 339};
+        case ICLASS:
+            return (trace_export_proto_t) {LINKTYPE_USER0 + 0, "iclass", 25000, 339, 32 * 25000, 339};
+        case ISO_15693:
+            return (trace_export_proto_t) {LINKTYPE_USER0 + 1, "iso15693", 25000, 339, 32 * 25000, 339};
+        case LEGIC:
+            return (trace_export_proto_t) {LINKTYPE_USER0 + 2, "legic", 2000, 3, 2000, 3};
+        case FELICA:
+            return (trace_export_proto_t) {LINKTYPE_USER0 + 3, "felica", 25000, 339, 25000, 339};
+        case PROTO_HITAG1:
+            return (trace_export_proto_t) {LINKTYPE_USER0 + 4, "hitag1", 8000, 1, 8000, 1};
+        case PROTO_HITAG2:
+            return (trace_export_proto_t) {LINKTYPE_USER0 + 5, "hitag2", 8000, 1, 8000, 1};
+        case PROTO_HITAGS:
+            return (trace_export_proto_t) {LINKTYPE_USER0 + 6, "hitags", 8000, 1, 8000, 1};
+        case THINFILM:
+            return (trace_export_proto_t) {LINKTYPE_USER0 + 7, "thinfilm", 25000, 339, 25000, 339};
+        case ISO_7816_4:
+            return (trace_export_proto_t) {LINKTYPE_USER0 + 8, "iso7816", 1, 1, 1, 1};
+        default:
+            return (trace_export_proto_t) {LINKTYPE_USER0 + 9, "raw", 1, 1, 1, 1};
+    }
+}
+
+static void pcapng_write_block(FILE *f, uint32_t type, const uint8_t *body, uint32_t len) {
+    static const uint8_t pad[4] = {0};
+    uint32_t total = 12 + ((len + 3) & ~3);
+    fwrite(&type, sizeof(uint32_t), 1, f);
+    fwrite(&total, sizeof(uint32_t), 1, f);
+    fwrite(body, 1, len, f);
+    fwrite(pad, 1, (4 - (len & 3)) & 3, f);
+    fwrite(&total, sizeof(uint32_t), 1, f);
+}
+
+// adds a pcapng option,  padded to 32 bits
+static uint32_t pcapng_option(uint8_t *dst, uint16_t code, const void *value, uint16_t len) {
+    memcpy(dst, &code, sizeof(uint16_t));
+    memcpy(dst + 2, &len, sizeof(uint16_t));
+    memset(dst + 4, 0, (len + 3) & ~3);
+    memcpy(dst + 4, value, len);
+    return 4 + ((len + 3) & ~3);
+}
+
+static int trace_export_pcapng(trace_reader_t *rd, FILE *f, uint8_t protocol, uint32_t *records) {
+    trace_export_proto_t p = trace_export_proto(protocol);
+    uint8_t blk[64];
+    uint32_t n;
+
+    // section header,  byte order magic, version 1.0, unknown section length
+    uint32_t shb[4] = {0x1A2B3C4D, 0x00000001, 0xFFFFFFFF, 0xFFFFFFFF};
+    memcpy(blk, shb, sizeof(shb));
+    n = sizeof(shb);
+    n += pcapng_option(blk + n, 4, "proxmark3", 9);                 // shb_userappl
+    n += pcapng_option(blk + n, 0, NULL, 0);
+    pcapng_write_block(f, 0x0A0D0D0A, blk, n);
+
+    // interface description,  link type, no snap length
+    uint32_t idb[2] = {p.linktype, 0};
+    memcpy(blk, idb, sizeof(idb));
+    n = sizeof(idb);
+    n += pcapng_option(blk + n, 2, p.name, strlen(p.name));        // if_name
+    uint8_t tsresol = 9;
+    n += pcapng_option(blk + n, 9, &tsresol, 1);                    // if_tsresol, nanoseconds
+    n += pcapng_option(blk + n, 0, NULL, 0);
+    pcapng_write_block(f, 0x00000001, blk, n);
+
+    bool pseudo = (p.linktype == LINKTYPE_ISO_14443);
+    uint8_t *epb = calloc(20 + 4 + 0x7FFF + 4 + 12, sizeof(uint8_t));
+    if (epb == NULL)
+        return PM3_EMALLOC;
+
+    uint64_t last = 0;
+    *records = 0;
+    while (trace_reader_next(rd, true)) {
+        uint64_t ns = trace_unwrap_timestamp(rd->hdr.timestamp, &last) * p.ts_num / p.ts_den;
+        uint16_t len = rd->hdr.data_len;
+        uint32_t caplen = len + (pseudo ? 4 : 0);
+
+        // interface 0, timestamp high / low, captured and original length
+        uint32_t epbhdr[5] = {0, (uint32_t)(ns >> 32), (uint32_t)ns, caplen, caplen};
+        memcpy(epb, epbhdr, sizeof(epbhdr));
+        n = sizeof(epbhdr);
+        if (pseudo) {
+            // ISO 14443 pseudo header,  version 0, event PCD -> PICC (0xfe) or PICC -> PCD (0xff), big endian length
+            epb[n++] = 0x00;
+            epb[n++] = rd->hdr.isResponse ? 0xFF : 0xFE;
+            epb[n++] = len >> 8;
+            epb[n++] = len & 0xFF;
+        }
+        memcpy(epb + n, rd->frame, len);
+        n += len;
+        while (n & 3)
+            epb[n++] = 0;
+
+        // epb_flags direction,  tag to reader inbound, reader to tag outbound
+        uint32_t flags = rd->hdr.isResponse ? 0x1 : 0x2;
+        n += pcapng_option(epb + n, 2, &flags, sizeof(flags));
+        n += pcapng_option(epb + n, 0, NULL, 0);
+        pcapng_write_block(f, 0x00000006, epb, n);
+        (*records)++;
+    }
+    free(epb);
+    return PM3_SUCCESS;
+}
+
+// Columnar layout,  all little endian, every column starts 8 byte aligned
+//   header       "PM3TRCOL", version, protocol, records, payload length, timestamp and duration scale to ns
+//   timestamp    uint64_t per record, unwrapped
+//   offset       uint64_t per record, offset of the record data in the payload column
+//   duration     uint16_t per record
+//   data length  uint16_t per record
+//   direction    uint8_t per record, 0 = reader to tag, 1 = tag to reader
+//   payload      data followed by the parity bytes, record after record
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t protocol;
+    uint64_t records;
+    uint64_t payload_len;
+    uint32_t ts_num;
+    uint32_t ts_den;
+    uint32_t dur_num;
+    uint32_t dur_den;
+} PACKED trace_col_hdr_t;
+
+#define TRACE_COL_ALIGN(x) (((x) + 7) & ~(uint64_t)7)
+
+static int trace_export_columnar(trace_reader_t *rd, FILE *f, const char *filename, uint8_t protocol, uint32_t *records) {
+
+    // first pass only counts,  the column offsets depend on the number of records
+    trace_col_hdr_t hdr = {{'P', 'M', '3', 'T', 'R', 'C', 'O', 'L'}, 1, protocol, 0, 0, 0, 0, 0, 0};
+    while (trace_reader_next(rd, false)) {
+        hdr.records++;
+        hdr.payload_len += rd->frame_len;
+    }
+    trace_reader_rewind(rd);
+
+    trace_export_proto_t p = trace_export_proto(protocol);
+    hdr.ts_num = p.ts_num;
+    hdr.ts_den = p.ts_den;
+    hdr.dur_num = p.dur_num;
+    hdr.dur_den = p.dur_den;
+    fwrite(&hdr, sizeof(hdr), 1, f);
+    fflush(f);
+
+    // one stream per column,  each writes its own region of the file sequentially
+    enum { COL_TS, COL_OFFSET, COL_DURATION, COL_LEN, COL_DIR, COL_PAYLOAD, COL_CNT };
+    const uint8_t width[COL_CNT] = {8, 8, 2, 2, 1, 0};
+    FILE *col[COL_CNT] = {0};
+    uint64_t start = TRACE_COL_ALIGN(sizeof(hdr));
+    int res = PM3_SUCCESS;
+    for (int i = 0; i < COL_CNT; i++) {
+        col[i] = fopen(filename, "r+b");
+        if (col[i] == NULL || fseeko(col[i], start, SEEK_SET) != 0) {
+            res = PM3_EFILE;
+            goto out;
+        }
+        start = TRACE_COL_ALIGN(start + width[i] * hdr.records);
+    }
+
+    uint64_t last = 0, offset = 0;
+    *records = 0;
+    while (trace_reader_next(rd, true) && *records < hdr.records) {
+        uint64_t ts = trace_unwrap_timestamp(rd->hdr.timestamp, &last);
+        uint16_t duration = rd->hdr.duration;
+        uint16_t len = rd->hdr.data_len;
+        uint8_t dir = rd->hdr.isResponse;
+        fwrite(&ts, sizeof(ts), 1, col[COL_TS]);
+        fwrite(&offset, sizeof(offset), 1, col[COL_OFFSET]);
+        fwrite(&duration, sizeof(duration), 1, col[COL_DURATION]);
+        fwrite(&len, sizeof(len), 1, col[COL_LEN]);
+        fwrite(&dir, sizeof(dir), 1, col[COL_DIR]);
+        fwrite(rd->frame, 1, rd->frame_len, col[COL_PAYLOAD]);
+        offset += rd->frame_len;
+        (*records)++;
+    }
+
+out:
+    for (int i = 0; i < COL_CNT; i++) {
+        if (col[i] && fclose(col[i]) != 0)
+            res = PM3_EFILE;
+    }
+    return res;
+}
+
+static int CmdTraceExport(const char *Cmd) {
+
+    char fmt = tolower(param_getchar(Cmd, 0));
+    if (param_getlength(Cmd, 0) != 1 || (fmt != 'p' && fmt != 'c')) return usage_trace_export();
+
+    char preferred[FILE_PATH_SIZE] = {0};
+    char infile[FILE_PATH_SIZE] = {0};
+    if (param_getstr(Cmd, 1, preferred, sizeof(preferred)) == 0) return usage_trace_export();
+
+    uint8_t protocol = ISO_14443A;
+    char type[10] = {0};
+    for (uint8_t cmdp = 2; param_getchar(Cmd, cmdp) != 0x00;) {
+        param_getstr(Cmd, cmdp, type, sizeof(type));
+        str_lower(type);
+        if (strcmp(type, "f") == 0) {
+            if (param_getstr(Cmd, cmdp + 1, infile, sizeof(infile)) == 0) return usage_trace_export();
+            cmdp += 2;
+        } else if (trace_get_protocol(type, &protocol)) {
+            cmdp++;
+        } else {
+            PrintAndLogEx(WARNING, "Unknown parameter '%s'", type);
+            return usage_trace_export();
+        }
+    }
+
+    if (infile[0] == 0 && g_traceLen == 0) {
+        download_trace();
+    }
+
+    if (infile[0] == 0 && g_traceLen == 0) {
+        PrintAndLogEx(WARNING, "trace is empty, nothing to export");
+        return PM3_SUCCESS;
+    }
+
+    trace_reader_t rd;
+    int res = trace_reader_open(&rd, infile);
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(FAILED, "Could not open file " _YELLOW_("%s"), infile);
+        return res;
+    }
+
+    char *filename = newfilenamemcopy(preferred, fmt == 'p' ? ".pcapng" : ".trcol");
+    if (filename == NULL) {
+        trace_reader_close(&rd);
+        return PM3_EMALLOC;
+    }
+
+    FILE *f = fopen(filename, "wb");
+    if (f == NULL) {
+        PrintAndLogEx(WARNING, "file not found or locked. '" _YELLOW_("%s")"'", filename);
+        free(filename);
+        trace_reader_close(&rd);
+        return PM3_EFILE;
+    }
+
+    uint32_t records = 0;
+    if (fmt == 'p')
+        res = trace_export_pcapng(&rd, f, protocol, &records);
+    else
+        res = trace_export_columnar(&rd, f, filename, protocol, &records);
+
+    if (fclose(f) != 0 && res == PM3_SUCCESS)
+        res = PM3_EFILE;
+
+    if (res == PM3_SUCCESS)
+        PrintAndLogEx(SUCCESS, "exported " _YELLOW_("%u") " records to %s file " _YELLOW_("%s"), records, fmt == 'p' ? "PCAP-NG" : "columnar", filename);
+    else
+        PrintAndLogEx(FAILED, "error while writing " _YELLOW_("%s"), filename);
+
+    free(filename);
+    trace_reader_close(&rd);
+    return res;
+}
+
 int CmdTraceList(const char *Cmd) {
 
     clearCommandBuffer();
@@ -618,7 +1323,11 @@ int CmdTraceList(const char *Cmd) {
     bool use_us = false, use_relative = false;
     bool errors = false;
     uint8_t protocol = 0;
+    uint32_t first_rec = 0, max_recs = UINT32_MAX;
+    uint32_t t_from = 0, t_to = UINT32_MAX;
+    bool only_reader = false, only_tag = false;
     char type[10] = {0};
+    char dict_fn[FILE_PATH_SIZE] = {0};
     char cmdp = 0;
     while (param_getchar(Cmd, cmdp) != 0x00 && !errors) {
 
@@ -656,6 +1365,32 @@ int CmdTraceList(const char *Cmd) {
                     use_us = true;
                     cmdp++;
                     break;
+                case 's':
+                    first_rec = param_get32ex(Cmd, cmdp + 1, 0, 10);
+                    cmdp += 2;
+                    break;
+                case 'n':
+                    max_recs = param_get32ex(Cmd, cmdp + 1, 0, 10);
+                    cmdp += 2;
+                    break;
+                case 't':
+                    t_from = param_get32ex(Cmd, cmdp + 1, 0, 10);
+                    t_to = param_get32ex(Cmd, cmdp + 2, UINT32_MAX, 10);
+                    cmdp += 3;
+                    break;
+                case 'k':
+                    if (param_getstr(Cmd, cmdp + 1, dict_fn, sizeof(dict_fn)) == 0)
+                        errors = true;
+                    cmdp += 2;
+                    break;
+                case 'd': {
+                    char d = tolower(param_getchar(Cmd, cmdp + 1));
+                    only_reader = (d == 'r');
+                    only_tag = (d == 't');
+                    errors = (only_reader == false && only_tag == false);
+                    cmdp += 2;
+                    break;
+                }
                 default:
                     PrintAndLogEx(WARNING, "Unknown parameter '%c'", param_getchar(Cmd, cmdp));
                     errors = true;
@@ -667,24 +1402,8 @@ int CmdTraceList(const char *Cmd) {
             str_lower(type);
 
             // validate type of output
-            if (strcmp(type,      "iclass") == 0)   protocol = ICLASS;
-            else if (strcmp(type, "14a") == 0)      protocol = ISO_14443A;
-            else if (strcmp(type, "14b") == 0)      protocol = ISO_14443B;
-            else if (strcmp(type, "topaz") == 0)    protocol = TOPAZ;
-            else if (strcmp(type, "7816") == 0)     protocol = ISO_7816_4;
-            else if (strcmp(type, "des") == 0)      protocol = MFDES;
-            else if (strcmp(type, "legic") == 0)    protocol = LEGIC;
-            else if (strcmp(type, "15") == 0)       protocol = ISO_15693;
-            else if (strcmp(type, "felica") == 0)   protocol = FELICA;
-            else if (strcmp(type, "mf") == 0)       protocol = PROTO_MIFARE;
-            else if (strcmp(type, "hitag1") == 0)   protocol = PROTO_HITAG1;
-            else if (strcmp(type, "hitag2") == 0)   protocol = PROTO_HITAG2;
-            else if (strcmp(type, "hitags") == 0)   protocol = PROTO_HITAGS;
-            else if (strcmp(type, "thinfilm") == 0) protocol = THINFILM;
-            else if (strcmp(type, "lto") == 0)      protocol = LTO;
-            else if (strcmp(type, "cryptorf") == 0) protocol = PROTO_CRYPTORF;
-            else if (strcmp(type, "raw") == 0)      protocol = -1; //No crc, no annotations
-            else errors = true;
+            if (trace_get_protocol(type, &protocol) == false)
+                errors = true;
 
             cmdp++;
         }
@@ -699,12 +1418,13 @@ int CmdTraceList(const char *Cmd) {
         download_trace();
     }
 
-    PrintAndLogEx(SUCCESS, "Recorded activity (trace len = " _YELLOW_("%lu") " bytes)", g_traceLen);
-    if (g_traceLen == 0) {
+    PrintAndLogEx(SUCCESS, "Recorded activity (trace len = " _YELLOW_("%lu") " bytes, " _YELLOW_("%u") " records)", g_traceLen, g_trace_records);
+    if (g_traceLen == 0 || g_trace_index == NULL) {
         return PM3_SUCCESS;
     }
 
-    uint16_t tracepos = 0;
+    uint32_t tracepos = 0;
+    bool filtered = (first_rec || max_recs != UINT32_MAX || t_from || t_to != UINT32_MAX || only_reader || only_tag);
 
     /*
     if (protocol == FELICA) {
@@ -769,29 +1489,66 @@ int CmdTraceList(const char *Cmd) {
         }
 
 
-        PrintAndLogEx(NORMAL, "");
-        if (use_relative) {
-            PrintAndLogEx(NORMAL, "        Gap |   Duration | Src | Data (! denotes parity error, ' denotes short bytes)                    | CRC | Annotation");
-        } else {
-            PrintAndLogEx(NORMAL, "      Start |        End | Src | Data (! denotes parity error)                                           | CRC | Annotation");
-        }
-        PrintAndLogEx(NORMAL, "------------+------------+-----+-------------------------------------------------------------------------+-----+--------------------");
+        print_list_header(use_relative);
 
         // clean authentication data used with the mifare classic decrypt fct
         if (protocol == ISO_14443A || protocol == PROTO_MIFARE)
             ClearAuthData();
 
+        if (protocol == PROTO_MIFARE)
+            trace_search_mf_keys(dict_fn);
+
         uint32_t previous_EOT = 0;
         uint32_t *prev_EOT = NULL;
         if (use_relative) {
             prev_EOT = &previous_EOT;
         }
 
-        while (tracepos < g_traceLen) {
-            tracepos = printTraceLine(tracepos, g_traceLen, g_trace, protocol, showWaitCycles, markCRCBytes, prev_EOT, use_us);
+        if (filtered == false) {
+            while (tracepos < g_traceLen) {
+                tracepos = printTraceLine(tracepos, g_traceLen, g_trace, protocol, showWaitCycles, markCRCBytes, prev_EOT, use_us);
 
-            if (kbd_enter_pressed())
-                break;
+                if (kbd_enter_pressed())
+                    break;
+            }
+        } else {
+            // random access through the index.  A printed line may swallow several
+            // records (topaz), so the next record is looked up from the returned offset
+            uint32_t first_ts = ((tracelog_hdr_t *)g_trace)->timestamp;
+            uint32_t shown = 0;
+            uint32_t rec = first_rec;
+
+            // records are in time order, skip straight to the start of the window
+            if (t_from) {
+                uint32_t lo = rec, hi = g_trace_records;
+                while (lo < hi) {
+                    uint32_t mid = lo + (hi - lo) / 2;
+                    if (((tracelog_hdr_t *)(g_trace + g_trace_index[mid]))->timestamp - first_ts < t_from)
+                        lo = mid + 1;
+                    else
+                        hi = mid;
+                }
+                rec = lo;
+            }
+            while (rec < g_trace_records && shown < max_recs) {
+                tracelog_hdr_t *hdr = (tracelog_hdr_t *)(g_trace + g_trace_index[rec]);
+                uint32_t ts = hdr->timestamp - first_ts;
+                if (ts > t_to)
+                    break;
+
+                if (ts < t_from || (only_reader && hdr->isResponse) || (only_tag && hdr->isResponse == false)) {
+                    rec++;
+                    continue;
+                }
+
+                tracepos = printTraceLine(g_trace_index[rec], g_traceLen, g_trace, protocol, showWaitCycles, markCRCBytes, prev_EOT, use_us);
+                rec = trace_record_at(rec + 1, tracepos);
+                shown++;
+
+                if (kbd_enter_pressed())
+                    break;
+            }
+            PrintAndLogEx(INFO, "showed " _YELLOW_("%u") " records, next record " _YELLOW_("%u"), shown, rec);
         }
     }
     return PM3_SUCCESS;
@@ -802,6 +1559,7 @@ static command_t CommandTable[] = {
     {"list",    CmdTraceList,     AlwaysAvailable, "List protocol data in trace buffer"},
     {"load",    CmdTraceLoad,     AlwaysAvailable, "Load trace from file"},
     {"save",    CmdTraceSave,     AlwaysAvailable, "Save trace buffer to file"},
+    {"export",  CmdTraceExport,   AlwaysAvailable, "Export trace to PCAP-NG or columnar file"},
     {NULL, NULL, NULL, NULL}
 };
 
@@ -16,4 +16,10 @@
 int CmdTrace(const char *Cmd);
 int CmdTraceList(const char *Cmd);
 
+// live listing, records arriving from a streaming sniff are kept in the trace buffer and printed at once
+int trace_live_begin(uint8_t protocol);
+int trace_live_add(const uint8_t *records, uint32_t len);
+// runs a streaming sniff command until the final hf14a_sniff_frame_t, Enter stops it
+int trace_live_sniff(uint16_t cmd, uint8_t protocol, const uint8_t *param, uint16_t paramlen);
+
 #endif
@@ -45,10 +45,16 @@ static int usage_wiegand_encode(void) {
 static int usage_wiegand_decode(void) {
     PrintAndLogEx(NORMAL, "Decode raw hex to wiegand format");
     PrintAndLogEx(NORMAL, "Usage:  wiegand decode [id] <p>");
-    PrintAndLogEx(NORMAL, "        p         ignore invalid parity");
+    PrintAndLogEx(NORMAL, "        wiegand decode f <filename> [o <filename>] [c|j] <p>");
+    PrintAndLogEx(NORMAL, "        p             ignore invalid parity");
+    PrintAndLogEx(NORMAL, "        f <filename>  decode every raw hex line of the file, '#' comments");
+    PrintAndLogEx(NORMAL, "        o <filename>  write the results to this file, streamed");
+    PrintAndLogEx(NORMAL, "        c             CSV output, one row per matching format");
+    PrintAndLogEx(NORMAL, "        j             JSON output, one object per raw id");
     PrintAndLogEx(NORMAL, "");
     PrintAndLogEx(NORMAL, "Samples:");
     PrintAndLogEx(NORMAL, "          wiegand decode 2006f623ae");
+    PrintAndLogEx(NORMAL, "          wiegand decode f badges.txt o badges.csv c");
     return PM3_SUCCESS;
 }
 
@@ -147,6 +153,9 @@ int CmdWiegandDecode(const char *Cmd) {
 
     uint32_t top = 0, mid = 0, bot = 0;
     bool ignore_parity = false, gothex = false;
+    char filename[FILE_PATH_SIZE] = {0};
+    char outfile[FILE_PATH_SIZE] = {0};
+    wiegand_outfmt_t fmt = WIEGAND_OUT_TEXT;
     bool errors = false;
     char cmdp = 0;
     while (param_getchar(Cmd, cmdp) != 0x00 && !errors) {
@@ -168,17 +177,39 @@ int CmdWiegandDecode(const char *Cmd) {
                 ignore_parity = true;
                 cmdp++;
                 break;
+            case 'f':
+                if (param_getstr(Cmd, cmdp + 1, filename, sizeof(filename)) == 0)
+                    errors = true;
+                cmdp += 2;
+                break;
+            case 'o':
+                if (param_getstr(Cmd, cmdp + 1, outfile, sizeof(outfile)) == 0)
+                    errors = true;
+                cmdp += 2;
+                break;
+            case 'c':
+                fmt = WIEGAND_OUT_CSV;
+                cmdp++;
+                break;
+            case 'j':
+                fmt = WIEGAND_OUT_JSON;
+                cmdp++;
+                break;
             default:
                 PrintAndLogEx(WARNING, "Unknown parameter '%c'", param_getchar(Cmd, cmdp));
                 errors = true;
                 break;
         }
     }
-    if (gothex == false)
+    // one raw id or one file
+    if (gothex == (filename[0] != '\0'))
         errors = true;
 
     if (errors || cmdp < 1) return usage_wiegand_decode();
 
+    if (filename[0])
+        return HIDTryUnpackFile(filename, ignore_parity, fmt, (outfile[0]) ? outfile : NULL);
+
     wiegand_message_t packed = initialize_message_object(top, mid, bot);
 
     HIDTryUnpack(&packed, ignore_parity);
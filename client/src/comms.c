@@ -12,14 +12,19 @@
 #include "comms.h"
 
 #include <inttypes.h>
+#include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdio.h>
 
 #include "uart/uart.h"
 #include "ui.h"
 #include "crc16.h"
+#include "crc32.h"
+#include "lz4/lz4.h"
 #include "util.h" // g_pendingPrompt
 #include "util_posix.h" // msclock
+#include "perf.h"
 #include "util_darwin.h" // en/dis-ableNapp();
 
 //#define COMMS_DEBUG
@@ -34,26 +39,64 @@ capabilities_t pm3_capabilities;
 static pthread_t communication_thread;
 static bool comm_thread_dead = false;
 
-// Transmit buffer.
-static PacketCommandOLD txBuffer;
-static PacketCommandNGRaw txBufferNG;
-static size_t txBufferNGLen;
-static bool txBuffer_pending = false;
+// Transmit queue.
+// SendCommand* fill a slot with a ready-to-send frame, the communication thread drains the queue.
+// Every frame gets a sequence number, used to match replies of commands sent with SendCommandNGAsync.
+typedef struct {
+    uint32_t seq;
+    size_t ng_len;                      // 0 for OLD frames
+    union {
+        PacketCommandOLD old;
+        PacketCommandNGRaw ng;
+    } frame;
+} txSlot_t;
+
+static txSlot_t txQueue[CMD_TXQUEUE_SIZE];
+// Points to the next free slot to fill
+static uint16_t tx_head = 0;
+// Points to the oldest slot still to be sent
+static uint16_t tx_tail = 0;
+// Number of frames waiting to be sent
+static uint16_t tx_count = 0;
+static uint32_t tx_seq = 0;
 static pthread_mutex_t txBufferMutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t txBufferSig = PTHREAD_COND_INITIALIZER;
 
+// In-flight commands sent with SendCommandNGAsync.
+// The communication thread hands the first matching reply to the oldest sent command.
+typedef struct {
+    uint32_t seq;                       // 0 if slot is free
+    uint16_t reply_cmd;
+    uint32_t sent_order;                // 0 until the frame left the tx queue
+    bool done;
+    bool abandoned;                     // waiter gave up, drop the reply when it comes
+    PacketResponseNG resp;
+} asyncSlot_t;
+
+static asyncSlot_t asyncSlots[CMD_ASYNC_SLOTS];
+static uint32_t async_sent_order = 0;
+static pthread_mutex_t asyncMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t asyncSig = PTHREAD_COND_INITIALIZER;
+
 // Used by PacketResponseReceived as a ring buffer for messages that are yet to be
 // processed by a command handler (WaitForResponse{,Timeout})
+// Single producer (communication thread), single consumer (main thread), lock-free:
+// the communication thread decodes frames straight into the slot at cmd_head,
+// the consumer reads replies in place at cmd_tail.
 static PacketResponseNG rxBuffer[CMD_BUFFER_SIZE];
 
-// Points to the next empty position to write to
-static int cmd_head = 0;
+// Points to the next empty position to write to, only moved by the producer
+static uint32_t cmd_head = 0;
 
-// Points to the position of the last unread command
-static int cmd_tail = 0;
+// Points to the position of the last unread command, only moved by the consumer
+static uint32_t cmd_tail = 0;
 
-// to lock rxBuffer operations from different threads
+// Wakeup of a consumer waiting for a reply, or of the producer waiting for room in rxBuffer.
+// Only taken when the other side announced it is waiting.
+static bool rx_consumer_waiting = false;
+static bool rx_producer_waiting = false;
 static pthread_mutex_t rxBufferMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t rxBufferSig = PTHREAD_COND_INITIALIZER;
 
 // Global start time for WaitForResponseTimeout & dl_it, so we can reset timeout when we get packets
 // as sending lot of these packets can slow down things wuite a lot on slow links (e.g. hw status or lf read at 9600)
@@ -62,6 +105,101 @@ static uint64_t timeout_start_time;
 static uint64_t last_packet_time;
 
 static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, size_t ms_timeout, bool show_warning, uint32_t rec_cmd);
+static bool dl_stream(uint8_t memtype, uint8_t *dest, uint32_t bytes, uint32_t start_index, PacketResponseNG *response, size_t ms_timeout, bool show_warning);
+static void copyReply(PacketResponseNG *dst, const PacketResponseNG *src);
+
+static void cond_wait_ms(pthread_cond_t *cond, pthread_mutex_t *mutex, uint32_t ms) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += ms / 1000;
+    ts.tv_nsec += (long)(ms % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    pthread_cond_timedwait(cond, mutex, &ts);
+}
+
+static uint32_t txQueueNextSeq(void) {
+    uint32_t seq = __atomic_add_fetch(&tx_seq, 1, __ATOMIC_SEQ_CST);
+    // 0 means "no sequence", skip it on wrap
+    if (seq == 0)
+        seq = __atomic_add_fetch(&tx_seq, 1, __ATOMIC_SEQ_CST);
+    return seq;
+}
+
+// Returns a free slot of the tx queue, with txBufferMutex held until txQueueCommit
+static txSlot_t *txQueueAcquire(void) {
+    pthread_mutex_lock(&txBufferMutex);
+    /**
+    This causes hangups at times, when the pm3 unit is unresponsive or disconnected. The main console thread is alive,
+    but comm thread just spins here. Not good.../holiman
+    **/
+    while (tx_count == CMD_TXQUEUE_SIZE) {
+        // wait for communication thread to make room in the queue
+        pthread_cond_wait(&txBufferSig, &txBufferMutex);
+    }
+    return &txQueue[tx_head];
+}
+
+static uint32_t txQueueCommit(txSlot_t *slot, uint32_t seq) {
+    if (seq == 0)
+        seq = txQueueNextSeq();
+
+    slot->seq = seq;
+    tx_head = (tx_head + 1) % CMD_TXQUEUE_SIZE;
+    tx_count++;
+
+    // tell communication thread that a new command can be send
+    pthread_cond_broadcast(&txBufferSig);
+    uart_wakeup();
+
+    pthread_mutex_unlock(&txBufferMutex);
+    return seq;
+}
+
+static void asyncMarkSent(uint32_t seq) {
+    pthread_mutex_lock(&asyncMutex);
+    for (int i = 0; i < CMD_ASYNC_SLOTS; i++) {
+        if (asyncSlots[i].seq == seq) {
+            asyncSlots[i].sent_order = ++async_sent_order;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&asyncMutex);
+}
+
+// Gives the reply to the oldest in-flight async command waiting for it.
+// Returns false if nobody claimed it.
+static bool asyncClaimReply(PacketResponseNG *packet) {
+    pthread_mutex_lock(&asyncMutex);
+    asyncSlot_t *slot = NULL;
+    for (int i = 0; i < CMD_ASYNC_SLOTS; i++) {
+        asyncSlot_t *s = &asyncSlots[i];
+        if ((s->seq == 0) || (s->sent_order == 0) || s->done || (s->reply_cmd != packet->cmd))
+            continue;
+        if ((slot == NULL) || (s->sent_order < slot->sent_order))
+            slot = s;
+    }
+    if (slot) {
+        if (slot->abandoned) {
+            slot->seq = 0;
+        } else {
+            copyReply(&slot->resp, packet);
+            slot->done = true;
+            pthread_cond_broadcast(&asyncSig);
+        }
+    }
+    pthread_mutex_unlock(&asyncMutex);
+    return (slot != NULL);
+}
+
+static void asyncReset(void) {
+    pthread_mutex_lock(&asyncMutex);
+    memset(asyncSlots, 0, sizeof(asyncSlots));
+    pthread_cond_broadcast(&asyncSig);
+    pthread_mutex_unlock(&asyncMutex);
+}
 
 // Simple alias to track usages linked to the Bootloader, these commands must not be migrated.
 // - commands sent to enter bootloader mode as we might have to talk to old firmwares
@@ -93,92 +231,65 @@ void SendCommandOLD(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, v
         return;
     }
 
-    pthread_mutex_lock(&txBufferMutex);
-    /**
-    This causes hangups at times, when the pm3 unit is unresponsive or disconnected. The main console thread is alive,
-    but comm thread just spins here. Not good.../holiman
-    **/
-    while (txBuffer_pending) {
-        // wait for communication thread to complete sending a previous commmand
-        pthread_cond_wait(&txBufferSig, &txBufferMutex);
-    }
-
-    txBuffer = c;
-    txBuffer_pending = true;
-
-    // tell communication thread that a new command can be send
-    pthread_cond_signal(&txBufferSig);
-
-    pthread_mutex_unlock(&txBufferMutex);
-
-//__atomic_test_and_set(&txcmd_pending, __ATOMIC_SEQ_CST);
+    perf_sent(cmd, sizeof(PacketCommandOLD));
+    txSlot_t *slot = txQueueAcquire();
+    slot->frame.old = c;
+    slot->ng_len = 0;
+    txQueueCommit(slot, 0);
 }
 
-static void SendCommandNG_internal(uint16_t cmd, uint8_t *data, size_t len, bool ng) {
+// returns the sequence number of the queued frame, 0 if nothing was sent
+static uint32_t SendCommandNG_internal(uint16_t cmd, uint8_t *data, size_t len, bool ng, uint32_t seq) {
 #ifdef COMMS_DEBUG
     PrintAndLogEx(INFO, "Sending %s", ng ? "NG" : "MIX");
 #endif
 
     if (!session.pm3_present) {
         PrintAndLogEx(INFO, "Sending bytes to proxmark failed - offline");
-        return;
+        return 0;
     }
     if (len > PM3_CMD_DATA_SIZE) {
         PrintAndLogEx(WARNING, "Sending %zu bytes of payload is too much, abort", len);
-        return;
+        return 0;
     }
 
-    PacketCommandNGPostamble *tx_post = (PacketCommandNGPostamble *)((uint8_t *)&txBufferNG + sizeof(PacketCommandNGPreamble) + len);
+    txSlot_t *slot = txQueueAcquire();
+    PacketCommandNGRaw *txBufferNG = &slot->frame.ng;
+    PacketCommandNGPostamble *tx_post = (PacketCommandNGPostamble *)((uint8_t *)txBufferNG + sizeof(PacketCommandNGPreamble) + len);
 
-    pthread_mutex_lock(&txBufferMutex);
-    /**
-    This causes hangups at times, when the pm3 unit is unresponsive or disconnected. The main console thread is alive,
-    but comm thread just spins here. Not good.../holiman
-    **/
-    while (txBuffer_pending) {
-        // wait for communication thread to complete sending a previous commmand
-        pthread_cond_wait(&txBufferSig, &txBufferMutex);
-    }
-
-    txBufferNG.pre.magic = COMMANDNG_PREAMBLE_MAGIC;
-    txBufferNG.pre.ng = ng;
-    txBufferNG.pre.length = len;
-    txBufferNG.pre.cmd = cmd;
+    txBufferNG->pre.magic = COMMANDNG_PREAMBLE_MAGIC;
+    txBufferNG->pre.ng = ng;
+    txBufferNG->pre.length = len;
+    txBufferNG->pre.cmd = cmd;
     if (len > 0 && data)
-        memcpy(&txBufferNG.data, data, len);
+        memcpy(&txBufferNG->data, data, len);
 
     if ((conn.send_via_fpc_usart && conn.send_with_crc_on_fpc) || ((!conn.send_via_fpc_usart) && conn.send_with_crc_on_usb)) {
         uint8_t first, second;
-        compute_crc(CRC_14443_A, (uint8_t *)&txBufferNG, sizeof(PacketCommandNGPreamble) + len, &first, &second);
+        compute_crc(CRC_14443_A, (uint8_t *)txBufferNG, sizeof(PacketCommandNGPreamble) + len, &first, &second);
         tx_post->crc = (first << 8) + second;
     } else {
         tx_post->crc = COMMANDNG_POSTAMBLE_MAGIC;
     }
 
-    txBufferNGLen = sizeof(PacketCommandNGPreamble) + len + sizeof(PacketCommandNGPostamble);
+    slot->ng_len = sizeof(PacketCommandNGPreamble) + len + sizeof(PacketCommandNGPostamble);
 
 #ifdef COMMS_DEBUG_RAW
-    print_hex_break((uint8_t *)&txBufferNG.pre, sizeof(PacketCommandNGPreamble), 32);
+    print_hex_break((uint8_t *)&txBufferNG->pre, sizeof(PacketCommandNGPreamble), 32);
     if (ng) {
-        print_hex_break((uint8_t *)&txBufferNG.data, len, 32);
+        print_hex_break((uint8_t *)&txBufferNG->data, len, 32);
     } else {
-        print_hex_break((uint8_t *)&txBufferNG.data, 3 * sizeof(uint64_t), 32);
-        print_hex_break((uint8_t *)&txBufferNG.data + 3 * sizeof(uint64_t), len - 3 * sizeof(uint64_t), 32);
+        print_hex_break((uint8_t *)&txBufferNG->data, 3 * sizeof(uint64_t), 32);
+        print_hex_break((uint8_t *)&txBufferNG->data + 3 * sizeof(uint64_t), len - 3 * sizeof(uint64_t), 32);
     }
     print_hex_break((uint8_t *)tx_post, sizeof(PacketCommandNGPostamble), 32);
 #endif
-    txBuffer_pending = true;
-
-    // tell communication thread that a new command can be send
-    pthread_cond_signal(&txBufferSig);
-
-    pthread_mutex_unlock(&txBufferMutex);
-
-//__atomic_test_and_set(&txcmd_pending, __ATOMIC_SEQ_CST);
+    perf_sent(cmd, slot->ng_len);
+    return txQueueCommit(slot, seq);
 }
 
 void SendCommandNG(uint16_t cmd, uint8_t *data, size_t len) {
-    SendCommandNG_internal(cmd, data, len, true);
+    SendCommandNG_internal(cmd, data, len, true, 0);
 }
 
 void SendCommandMIX(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, void *data, size_t len) {
@@ -191,7 +302,111 @@ void SendCommandMIX(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, v
     memcpy(cmddata, arg, sizeof(arg));
     if (len && data)
         memcpy(cmddata + sizeof(arg), data, len);
-    SendCommandNG_internal(cmd, cmddata, len + sizeof(arg), false);
+    SendCommandNG_internal(cmd, cmddata, len + sizeof(arg), false, 0);
+}
+
+void BatchInit(cmd_batch_t *batch) {
+    memset(batch, 0, sizeof(cmd_batch_t));
+}
+
+static int BatchAdd(cmd_batch_t *batch, uint16_t cmd, bool ng, const uint64_t *arg, const void *data, size_t len) {
+    size_t arglen = (arg) ? 3 * sizeof(uint64_t) : 0;
+    if (batch->length + sizeof(PacketBatchEntry) + arglen + len > sizeof(batch->data))
+        return PM3_EOVFLOW;
+
+    PacketBatchEntry entry = { .cmd = cmd, .length = arglen + len, .ng = ng };
+    memcpy(batch->data + batch->length, &entry, sizeof(entry));
+    batch->length += sizeof(entry);
+    if (arglen) {
+        memcpy(batch->data + batch->length, arg, arglen);
+        batch->length += arglen;
+    }
+    if (len && data) {
+        memcpy(batch->data + batch->length, data, len);
+        batch->length += len;
+    }
+    batch->count++;
+    return PM3_SUCCESS;
+}
+
+/**
+ * @brief Appends a NG command to a batch.
+ * @return PM3_SUCCESS or PM3_EOVFLOW if the batch frame is full
+ */
+int BatchAddNG(cmd_batch_t *batch, uint16_t cmd, const void *data, size_t len) {
+    return BatchAdd(batch, cmd, true, NULL, data, len);
+}
+
+/**
+ * @brief Appends a MIX command to a batch.
+ * @return PM3_SUCCESS or PM3_EOVFLOW if the batch frame is full
+ */
+int BatchAddMIX(cmd_batch_t *batch, uint16_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, const void *data, size_t len) {
+    uint64_t arg[3] = {arg0, arg1, arg2};
+    return BatchAdd(batch, cmd, false, arg, data, len);
+}
+
+/**
+ * @brief Sends all commands of a batch in one USB transaction.
+ * The device runs them in order; each reply arrives as if the command had been sent alone,
+ * followed by a CMD_BATCH reply whose status and first data byte (count of commands run) tell
+ * how far it got. Wait for the replies in command order.
+ */
+void SendCommandBatch(cmd_batch_t *batch) {
+    SendCommandNG(CMD_BATCH, batch->data, batch->length);
+}
+
+/**
+ * @brief Queues a NG command without waiting for its reply.
+ * Several commands can be kept in flight this way, the device still processes them in order.
+ * The first reply with the same cmd received after the frame left the queue is kept aside
+ * for this command and must be fetched with WaitForResponseSeq().
+ * Don't mix with synchronous SendCommandNG/WaitForResponse calls for the same cmd
+ * while async commands are in flight, replies couldn't be told apart.
+ * @param seq  returned sequence number of the queued command
+ * @return PM3_SUCCESS, PM3_EOVFLOW if all async slots are busy, PM3_EINVARG or PM3_EIO
+ */
+int SendCommandNGAsync(uint16_t cmd, uint8_t *data, size_t len, uint32_t *seq) {
+
+    if (seq == NULL || len > PM3_CMD_DATA_SIZE)
+        return PM3_EINVARG;
+
+    *seq = 0;
+
+    if (!session.pm3_present) {
+        PrintAndLogEx(INFO, "Sending bytes to proxmark failed - offline");
+        return PM3_EIO;
+    }
+
+    uint32_t s = txQueueNextSeq();
+
+    pthread_mutex_lock(&asyncMutex);
+    asyncSlot_t *slot = NULL;
+    for (int i = 0; i < CMD_ASYNC_SLOTS; i++) {
+        if (asyncSlots[i].seq == 0) {
+            slot = &asyncSlots[i];
+            break;
+        }
+    }
+    if (slot == NULL) {
+        pthread_mutex_unlock(&asyncMutex);
+        return PM3_EOVFLOW;
+    }
+    slot->seq = s;
+    slot->reply_cmd = cmd;
+    slot->sent_order = 0;
+    slot->done = false;
+    slot->abandoned = false;
+    pthread_mutex_unlock(&asyncMutex);
+
+    if (SendCommandNG_internal(cmd, data, len, true, s) == 0) {
+        pthread_mutex_lock(&asyncMutex);
+        slot->seq = 0;
+        pthread_mutex_unlock(&asyncMutex);
+        return PM3_EIO;
+    }
+    *seq = s;
+    return PM3_SUCCESS;
 }
 
 
@@ -203,58 +418,102 @@ void SendCommandMIX(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, v
  */
 void clearCommandBuffer(void) {
     //This is a very simple operation
-    pthread_mutex_lock(&rxBufferMutex);
-    cmd_tail = cmd_head;
-    pthread_mutex_unlock(&rxBufferMutex);
+    __atomic_store_n(&cmd_tail, __atomic_load_n(&cmd_head, __ATOMIC_ACQUIRE), __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&rx_producer_waiting, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&rxBufferMutex);
+        pthread_cond_broadcast(&rxBufferSig);
+        pthread_mutex_unlock(&rxBufferMutex);
+    }
 }
+
+// Copies a reply, only the used part of the payload is meaningful
+static void copyReply(PacketResponseNG *dst, const PacketResponseNG *src) {
+    memcpy(dst, src, offsetof(PacketResponseNG, data));
+    memcpy(dst->data.asBytes, src->data.asBytes, MIN(src->length, PM3_CMD_DATA_SIZE));
+    dst->ng = src->ng;
+}
+
 /**
- * @brief storeCommand stores a USB command in a circular buffer
- * @param UC
+ * @brief Producer side: gets the slot where the next reply has to be decoded
+ * @return pointer into rxBuffer, NULL if the buffer is full
  */
-static void storeReply(PacketResponseNG *packet) {
-    pthread_mutex_lock(&rxBufferMutex);
-    if ((cmd_head + 1) % CMD_BUFFER_SIZE == cmd_tail) {
-        //If these two are equal, we're about to overwrite in the
-        // circular buffer.
-        PrintAndLogEx(FAILED, "WARNING: Command buffer about to overwrite command! This needs to be fixed!");
-        fflush(stdout);
+static PacketResponseNG *rxSlotAcquire(void) {
+    uint32_t head = __atomic_load_n(&cmd_head, __ATOMIC_RELAXED);
+    if ((head + 1) % CMD_BUFFER_SIZE == __atomic_load_n(&cmd_tail, __ATOMIC_ACQUIRE))
+        return NULL;
+    return &rxBuffer[head];
+}
+
+/**
+ * @brief Producer side: makes the reply decoded in the slot given by rxSlotAcquire visible to the consumer
+ */
+static void storeReply(void) {
+    uint32_t head = __atomic_load_n(&cmd_head, __ATOMIC_RELAXED);
+    __atomic_store_n(&cmd_head, (head + 1) % CMD_BUFFER_SIZE, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&rx_consumer_waiting, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&rxBufferMutex);
+        pthread_cond_broadcast(&rxBufferSig);
+        pthread_mutex_unlock(&rxBufferMutex);
     }
-    //Store the command at the 'head' location
-    PacketResponseNG *destination = &rxBuffer[cmd_head];
-    memcpy(destination, packet, sizeof(PacketResponseNG));
+}
 
-    //increment head and wrap
-    cmd_head = (cmd_head + 1) % CMD_BUFFER_SIZE;
+/**
+ * @brief Producer side: backpressure, waits at most ms milliseconds for the consumer to free a slot
+ */
+static void rxWaitForRoom(uint32_t ms) {
+    pthread_mutex_lock(&rxBufferMutex);
+    __atomic_store_n(&rx_producer_waiting, true, __ATOMIC_SEQ_CST);
+    if (rxSlotAcquire() == NULL)
+        cond_wait_ms(&rxBufferSig, &rxBufferMutex, ms);
+    __atomic_store_n(&rx_producer_waiting, false, __ATOMIC_SEQ_CST);
     pthread_mutex_unlock(&rxBufferMutex);
 }
+
 /**
- * @brief getCommand gets a command from an internal circular buffer.
- * @param response location to write command
- * @return 1 if response was returned, 0 if nothing has been received
+ * @brief Consumer side: gets the oldest unread reply, in place.
+ * @return pointer valid until releaseReply(), NULL if nothing has been received
  */
-static int getReply(PacketResponseNG *packet) {
-    pthread_mutex_lock(&rxBufferMutex);
+static PacketResponseNG *getReply(void) {
+    uint32_t tail = __atomic_load_n(&cmd_tail, __ATOMIC_RELAXED);
     //If head == tail, there's nothing to read, or if we just got initialized
-    if (cmd_head == cmd_tail)  {
-        pthread_mutex_unlock(&rxBufferMutex);
-        return 0;
-    }
-
-    //Pick out the next unread command
-    memcpy(packet, &rxBuffer[cmd_tail], sizeof(PacketResponseNG));
+    if (tail == __atomic_load_n(&cmd_head, __ATOMIC_ACQUIRE))
+        return NULL;
+    return &rxBuffer[tail];
+}
 
+/**
+ * @brief Consumer side: frees the slot returned by getReply()
+ */
+static void releaseReply(void) {
+    uint32_t tail = __atomic_load_n(&cmd_tail, __ATOMIC_RELAXED);
     //Increment tail - this is a circular buffer, so modulo buffer size
-    cmd_tail = (cmd_tail + 1) % CMD_BUFFER_SIZE;
+    __atomic_store_n(&cmd_tail, (tail + 1) % CMD_BUFFER_SIZE, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&rx_producer_waiting, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&rxBufferMutex);
+        pthread_cond_broadcast(&rxBufferSig);
+        pthread_mutex_unlock(&rxBufferMutex);
+    }
+}
 
+/**
+ * @brief Consumer side: waits at most ms milliseconds for a new reply.
+ * Returns as soon as the communication thread stored one.
+ */
+static void rxWaitForReply(uint32_t ms) {
+    pthread_mutex_lock(&rxBufferMutex);
+    __atomic_store_n(&rx_consumer_waiting, true, __ATOMIC_SEQ_CST);
+    if (getReply() == NULL)
+        cond_wait_ms(&rxBufferSig, &rxBufferMutex, ms);
+    __atomic_store_n(&rx_consumer_waiting, false, __ATOMIC_SEQ_CST);
     pthread_mutex_unlock(&rxBufferMutex);
-    return 1;
 }
 
 //-----------------------------------------------------------------------------
 // Entry point into our code: called whenever we received a packet over USB
 // that we weren't necessarily expecting, for example a debug print.
 //-----------------------------------------------------------------------------
-static void PacketResponseReceived(PacketResponseNG *packet) {
+// Returns true if the packet has to be kept in rxBuffer for a command handler
+static bool PacketResponseReceived(PacketResponseNG *packet) {
 
     // we got a packet, reset WaitForResponseTimeout timeout
     uint64_t prev_clk = __atomic_load_n(&last_packet_time, __ATOMIC_SEQ_CST);
@@ -262,6 +521,7 @@ static void PacketResponseReceived(PacketResponseNG *packet) {
     __atomic_store_n(&timeout_start_time,  clk, __ATOMIC_SEQ_CST);
     __atomic_store_n(&last_packet_time, clk, __ATOMIC_SEQ_CST);
     (void) prev_clk;
+    perf_received(packet->ng ? sizeof(PacketResponseNGPreamble) + packet->length + sizeof(PacketResponseNGPostamble) : sizeof(PacketResponseOLD));
 //    PrintAndLogEx(NORMAL, "[%07"PRIu64"] RECV %s magic %08x length %04x status %04x crc %04x cmd %04x",
 //                clk - prev_clk, packet->ng ? "NG" : "OLD", packet->magic, packet->length, packet->status, packet->crc, packet->cmd);
 
@@ -316,13 +576,51 @@ static void PacketResponseReceived(PacketResponseNG *packet) {
         // CMD_DOWNLOAD_BIGBUF packages which is not dealt with. I wonder if simply ignoring them will
         // work. lets try it.
         default: {
-            storeReply(packet);
-            break;
+            return (asyncClaimReply(packet) == false);
         }
     }
+    return false;
 }
 
 
+// Sends all queued frames, the device processes them in order.
+// Returns false if sending failed
+static bool txQueueDrain(void) {
+    bool ok = true;
+    pthread_mutex_lock(&txBufferMutex);
+
+    if (tx_count) {
+
+        while (tx_count) {
+            txSlot_t *slot = &txQueue[tx_tail];
+            int res;
+            if (slot->ng_len) { // NG packet
+                res = uart_send(sp, (uint8_t *) &slot->frame.ng, slot->ng_len);
+                conn.last_command = slot->frame.ng.pre.cmd;
+            } else {
+                res = uart_send(sp, (uint8_t *) &slot->frame.old, sizeof(PacketCommandOLD));
+                conn.last_command = slot->frame.old.cmd;
+            }
+            if (res == PM3_EIO) {
+                ok = false;
+            }
+
+            asyncMarkSent(slot->seq);
+
+            tx_tail = (tx_tail + 1) % CMD_TXQUEUE_SIZE;
+            tx_count--;
+        }
+
+        // main thread doesn't know send failed...
+
+        // tell main thread that the tx queue has room again
+        pthread_cond_broadcast(&txBufferSig);
+    }
+
+    pthread_mutex_unlock(&txBufferMutex);
+    return ok;
+}
+
 // The communications thread.
 // signals to main thread when a response is ready to process.
 //
@@ -336,7 +634,6 @@ __attribute__((force_align_arg_pointer))
     communication_arg_t *connection = (communication_arg_t *)targ;
     uint32_t rxlen;
     bool commfailed = false;
-    PacketResponseNG rx;
     PacketResponseNGRaw rx_raw;
 
 #if defined(__MACH__) && defined(__APPLE__)
@@ -360,30 +657,50 @@ __attribute__((force_align_arg_pointer))
             break;
         }
 
+        // Backpressure: don't read from the device as long as there is no room to store its replies,
+        // but keep sending queued commands so the main thread never stays blocked on them
+        PacketResponseNG *rx = rxSlotAcquire();
+        if (rx == NULL) {
+            if (txQueueDrain() == false) {
+                commfailed = true;
+            }
+            rxWaitForRoom(10);
+            continue;
+        }
+
+        // Sleep until the device sends something or a command is queued
+        if (uart_wait_rx(sp, UART_IDLE_WAIT_MS) == false) {
+            if (txQueueDrain() == false) {
+                commfailed = true;
+            }
+            continue;
+        }
+
         res = uart_receive(sp, (uint8_t *)&rx_raw.pre, sizeof(PacketResponseNGPreamble), &rxlen);
         if ((res == PM3_SUCCESS) && (rxlen == sizeof(PacketResponseNGPreamble))) {
-            rx.magic = rx_raw.pre.magic;
+            rx->magic = rx_raw.pre.magic;
             uint16_t length = rx_raw.pre.length;
-            rx.ng = rx_raw.pre.ng;
-            rx.status = rx_raw.pre.status;
-            rx.cmd = rx_raw.pre.cmd;
-            if (rx.magic == RESPONSENG_PREAMBLE_MAGIC) { // New style NG reply
+            rx->ng = rx_raw.pre.ng;
+            rx->status = rx_raw.pre.status;
+            rx->cmd = rx_raw.pre.cmd;
+            if (rx->magic == RESPONSENG_PREAMBLE_MAGIC) { // New style NG reply
                 if (length > PM3_CMD_DATA_SIZE) {
                     PrintAndLogEx(WARNING, "Received packet frame with incompatible length: 0x%04x", length);
                     error = true;
                 }
                 if ((!error) && (length > 0)) { // Get the variable length payload
 
-                    res = uart_receive(sp, (uint8_t *)&rx_raw.data, length, &rxlen);
+                    // NG payloads are read straight into the reply slot
+                    uint8_t *payload = (rx->ng) ? (uint8_t *)&rx->data : (uint8_t *)&rx_raw.data;
+                    res = uart_receive(sp, payload, length, &rxlen);
                     if ((res != PM3_SUCCESS) || (rxlen != length)) {
                         PrintAndLogEx(WARNING, "Received packet frame with variable part too short? %d/%d", rxlen, length);
                         error = true;
                     } else {
 
-                        if (rx.ng) {      // Received a valid NG frame
-                            memcpy(&rx.data, &rx_raw.data, length);
-                            rx.length = length;
-                            if ((rx.cmd == conn.last_command) && (rx.status == PM3_SUCCESS)) {
+                        if (rx->ng) {      // Received a valid NG frame
+                            rx->length = length;
+                            if ((rx->cmd == conn.last_command) && (rx->status == PM3_SUCCESS)) {
                                 ACK_received = true;
                             }
                         } else {
@@ -394,12 +711,12 @@ __attribute__((force_align_arg_pointer))
                             }
                             if (!error) { // Received a valid MIX frame
                                 memcpy(arg, &rx_raw.data, sizeof(arg));
-                                rx.oldarg[0] = arg[0];
-                                rx.oldarg[1] = arg[1];
-                                rx.oldarg[2] = arg[2];
-                                memcpy(&rx.data, ((uint8_t *)&rx_raw.data) + sizeof(arg), length - sizeof(arg));
-                                rx.length = length - sizeof(arg);
-                                if (rx.cmd == CMD_ACK) {
+                                rx->oldarg[0] = arg[0];
+                                rx->oldarg[1] = arg[1];
+                                rx->oldarg[2] = arg[2];
+                                memcpy(&rx->data, ((uint8_t *)&rx_raw.data) + sizeof(arg), length - sizeof(arg));
+                                rx->length = length - sizeof(arg);
+                                if (rx->cmd == CMD_ACK) {
                                     ACK_received = true;
                                 }
                             }
@@ -414,26 +731,31 @@ __attribute__((force_align_arg_pointer))
                     }
                 }
                 if (!error) {                        // Check CRC, accept MAGIC as placeholder
-                    rx.crc = rx_raw.foopost.crc;
-                    if (rx.crc != RESPONSENG_POSTAMBLE_MAGIC) {
+                    rx->crc = rx_raw.foopost.crc;
+                    if (rx->crc != RESPONSENG_POSTAMBLE_MAGIC) {
+                        // the CRC covers preamble and payload in one piece
+                        if (rx->ng && length)
+                            memcpy(&rx_raw.data, &rx->data, length);
                         uint8_t first, second;
                         compute_crc(CRC_14443_A, (uint8_t *)&rx_raw, sizeof(PacketResponseNGPreamble) + length, &first, &second);
-                        if ((first << 8) + second != rx.crc) {
-                            PrintAndLogEx(WARNING, "Received packet frame with invalid CRC %02X%02X <> %04X", first, second, rx.crc);
+                        if ((first << 8) + second != rx->crc) {
+                            PrintAndLogEx(WARNING, "Received packet frame with invalid CRC %02X%02X <> %04X", first, second, rx->crc);
                             error = true;
                         }
                     }
                 }
                 if (!error) {             // Received a valid OLD frame
 #ifdef COMMS_DEBUG
-                    PrintAndLogEx(NORMAL, "Receiving %s:", rx.ng ? "NG" : "MIX");
+                    PrintAndLogEx(NORMAL, "Receiving %s:", rx->ng ? "NG" : "MIX");
 #endif
 #ifdef COMMS_DEBUG_RAW
                     print_hex_break((uint8_t *)&rx_raw.pre, sizeof(PacketResponseNGPreamble), 32);
-                    print_hex_break((uint8_t *)&rx_raw.data, rx_raw.pre.length, 32);
+                    print_hex_break((rx->ng) ? (uint8_t *)&rx->data : (uint8_t *)&rx_raw.data, rx_raw.pre.length, 32);
                     print_hex_break((uint8_t *)&rx_raw.foopost, sizeof(PacketResponseNGPostamble), 32);
 #endif
-                    PacketResponseReceived(&rx);
+                    if (PacketResponseReceived(rx)) {
+                        storeReply();
+                    }
                 }
             } else {                               // Old style reply
                 PacketResponseOLD rx_old;
@@ -453,18 +775,20 @@ __attribute__((force_align_arg_pointer))
                     print_hex_break((uint8_t *)&rx_old.arg, sizeof(rx_old.arg), 32);
                     print_hex_break((uint8_t *)&rx_old.d, sizeof(rx_old.d), 32);
 #endif
-                    rx.ng = false;
-                    rx.magic = 0;
-                    rx.status = 0;
-                    rx.crc = 0;
-                    rx.cmd = rx_old.cmd;
-                    rx.oldarg[0] = rx_old.arg[0];
-                    rx.oldarg[1] = rx_old.arg[1];
-                    rx.oldarg[2] = rx_old.arg[2];
-                    rx.length = PM3_CMD_DATA_SIZE;
-                    memcpy(&rx.data, &rx_old.d, rx.length);
-                    PacketResponseReceived(&rx);
-                    if (rx.cmd == CMD_ACK) {
+                    rx->ng = false;
+                    rx->magic = 0;
+                    rx->status = 0;
+                    rx->crc = 0;
+                    rx->cmd = rx_old.cmd;
+                    rx->oldarg[0] = rx_old.arg[0];
+                    rx->oldarg[1] = rx_old.arg[1];
+                    rx->oldarg[2] = rx_old.arg[2];
+                    rx->length = PM3_CMD_DATA_SIZE;
+                    memcpy(&rx->data, &rx_old.d, rx->length);
+                    if (PacketResponseReceived(rx)) {
+                        storeReply();
+                    }
+                    if (rx->cmd == CMD_ACK) {
                         ACK_received = true;
                     }
                 }
@@ -490,38 +814,17 @@ __attribute__((force_align_arg_pointer))
 #ifdef COMMS_DEBUG
                 PrintAndLogEx(NORMAL, "Received ACK, fast TX mode: ignoring other RX till TX");
 #endif
-                while (!txBuffer_pending) {
+                while (tx_count == 0) {
                     pthread_cond_wait(&txBufferSig, &txBufferMutex);
                 }
             }
         }
 
-        if (txBuffer_pending) {
-
-            if (txBufferNGLen) { // NG packet
-                res = uart_send(sp, (uint8_t *) &txBufferNG, txBufferNGLen);
-                if (res == PM3_EIO) {
-                    commfailed = true;
-                }
-                conn.last_command = txBufferNG.pre.cmd;
-                txBufferNGLen = 0;
-            } else {
-                res = uart_send(sp, (uint8_t *) &txBuffer, sizeof(PacketCommandOLD));
-                if (res == PM3_EIO) {
-                    commfailed = true;
-                }
-                conn.last_command = txBuffer.cmd;
-            }
-
-            txBuffer_pending = false;
-
-            // main thread doesn't know send failed...
+        pthread_mutex_unlock(&txBufferMutex);
 
-            // tell main thread that txBuffer is empty
-            pthread_cond_signal(&txBufferSig);
+        if (txQueueDrain() == false) {
+            commfailed = true;
         }
-
-        pthread_mutex_unlock(&txBufferMutex);
     }
 
     // when thread dies, we close the serial port.
@@ -661,6 +964,7 @@ int TestProxmark(void) {
 
 void CloseProxmark(void) {
     conn.run = false;
+    uart_wakeup();
 
 #ifdef __BIONIC__
     if (communication_thread != 0) {
@@ -676,6 +980,11 @@ void CloseProxmark(void) {
 
     // Clean up our state
     sp = NULL;
+    pthread_mutex_lock(&txBufferMutex);
+    tx_head = tx_tail = tx_count = 0;
+    pthread_cond_broadcast(&txBufferSig);
+    pthread_mutex_unlock(&txBufferMutex);
+    asyncReset();
 #ifdef __BIONIC__
     if (communication_thread != 0) {
         memset(&communication_thread, 0, sizeof(pthread_t));
@@ -712,7 +1021,7 @@ static size_t communication_delay(void) {
  * @param show_warning display message after 3 seconds
  * @return true if command was returned, otherwise false
  */
-bool WaitForResponseTimeoutW(uint32_t cmd, PacketResponseNG *response, size_t ms_timeout, bool show_warning) {
+static bool WaitForResponseTimeoutW_internal(uint32_t cmd, PacketResponseNG *response, size_t ms_timeout, bool show_warning) {
 
     PacketResponseNG resp;
 
@@ -728,16 +1037,20 @@ bool WaitForResponseTimeoutW(uint32_t cmd, PacketResponseNG *response, size_t ms
     // Wait until the command is received
     while (true) {
 
-        while (getReply(response)) {
-            if (cmd == CMD_UNKNOWN || response->cmd == cmd) {
+        PacketResponseNG *reply;
+        while ((reply = getReply()) != NULL) {
+            if (cmd == CMD_UNKNOWN || reply->cmd == cmd) {
+                copyReply(response, reply);
+                releaseReply();
                 return true;
             }
-            if (response->cmd == CMD_WTX && response->length == sizeof(uint16_t)) {
-                uint16_t wtx = response->data.asDwords[0] & 0xFFFF;
+            if (reply->cmd == CMD_WTX && reply->length == sizeof(uint16_t)) {
+                uint16_t wtx = reply->data.asDwords[0] & 0xFFFF;
                 PrintAndLogEx(DEBUG, "Got Waiting Time eXtension request %i ms", wtx);
                 if (ms_timeout != (size_t) - 1)
                     ms_timeout += wtx;
             }
+            releaseReply();
         }
 
         uint64_t tmp_clk = __atomic_load_n(&timeout_start_time, __ATOMIC_SEQ_CST);
@@ -750,12 +1063,19 @@ bool WaitForResponseTimeoutW(uint32_t cmd, PacketResponseNG *response, size_t ms
             PrintAndLogEx(INFO, "You can cancel this operation by pressing the pm3 button");
             show_warning = false;
         }
-        // just to avoid CPU busy loop:
-        msleep(10);
+        // wake up as soon as a reply is stored, and anyway every 10ms to check timeouts
+        rxWaitForReply(10);
     }
     return false;
 }
 
+bool WaitForResponseTimeoutW(uint32_t cmd, PacketResponseNG *response, size_t ms_timeout, bool show_warning) {
+    uint64_t start = usclock();
+    bool res = WaitForResponseTimeoutW_internal(cmd, response, ms_timeout, show_warning);
+    perf_wait(usclock() - start);
+    return res;
+}
+
 bool WaitForResponseTimeout(uint32_t cmd, PacketResponseNG *response, size_t ms_timeout) {
     return WaitForResponseTimeoutW(cmd, response, ms_timeout, true);
 }
@@ -765,21 +1085,96 @@ bool WaitForResponse(uint32_t cmd, PacketResponseNG *response) {
 }
 
 /**
-* Data transfer from Proxmark to client. This method times out after
-* ms_timeout milliseconds.
-* @brief GetFromDevice
-* @param memtype Type of memory to download from proxmark
-* @param dest Destination address for transfer
-* @param bytes number of bytes to be transferred
-* @param start_index offset into Proxmark3 BigBuf[]
-* @param data used by SPIFFS to provide filename
-* @param datalen used by SPIFFS to provide filename length
-* @param response struct to copy last command (CMD_ACK) into
-* @param ms_timeout timeout in milliseconds
-* @param show_warning display message after 2 seconds
-* @return true if command was returned, otherwise false
-*/
-bool GetFromDevice(DeviceMemType_t memtype, uint8_t *dest, uint32_t bytes, uint32_t start_index, uint8_t *data, uint32_t datalen, PacketResponseNG *response, size_t ms_timeout, bool show_warning) {
+ * @brief Waits for the reply of a command sent with SendCommandNGAsync.
+ * Timeout is restarted whenever a packet is received from the device, like WaitForResponseTimeout.
+ * On timeout, a late reply will be silently dropped.
+ *
+ * @param seq sequence number returned by SendCommandNGAsync
+ * @param response struct to copy received command into.
+ * @param ms_timeout timeout in milliseconds, -1 to wait forever
+ * @return true if command was returned, otherwise false
+ */
+bool WaitForResponseSeq(uint32_t seq, PacketResponseNG *response, size_t ms_timeout) {
+
+    if (seq == 0)
+        return false;
+
+    if (ms_timeout != (size_t) - 1)
+        ms_timeout += communication_delay();
+
+    uint64_t start_us = usclock();
+    uint64_t start_clk = msclock();
+    bool res = false;
+
+    pthread_mutex_lock(&asyncMutex);
+
+    asyncSlot_t *slot = NULL;
+    for (int i = 0; i < CMD_ASYNC_SLOTS; i++) {
+        if (asyncSlots[i].seq == seq) {
+            slot = &asyncSlots[i];
+            break;
+        }
+    }
+
+    while (slot && (slot->seq == seq)) {
+
+        if (slot->done) {
+            if (response)
+                memcpy(response, &slot->resp, sizeof(PacketResponseNG));
+            slot->seq = 0;
+            res = true;
+            break;
+        }
+
+        uint64_t tmp_clk = __atomic_load_n(&last_packet_time, __ATOMIC_SEQ_CST);
+        if (tmp_clk > start_clk)
+            start_clk = tmp_clk;
+
+        if (IsCommunicationThreadDead() || ((ms_timeout != (size_t) - 1) && (msclock() - start_clk > ms_timeout))) {
+            slot->abandoned = true;
+            break;
+        }
+
+        cond_wait_ms(&asyncSig, &asyncMutex, 10);
+    }
+
+    pthread_mutex_unlock(&asyncMutex);
+    perf_wait(usclock() - start_us);
+    return res;
+}
+
+/**
+ * @brief Non blocking check for the reply of a command sent with SendCommandNGAsync.
+ * The command stays in flight as long as it returns false.
+ *
+ * @param seq sequence number returned by SendCommandNGAsync
+ * @param response struct to copy received command into.
+ * @return true if the reply was there and copied, otherwise false
+ */
+bool PollResponseSeq(uint32_t seq, PacketResponseNG *response) {
+
+    if (seq == 0)
+        return false;
+
+    bool res = false;
+    pthread_mutex_lock(&asyncMutex);
+    for (int i = 0; i < CMD_ASYNC_SLOTS; i++) {
+        asyncSlot_t *slot = &asyncSlots[i];
+        if (slot->seq == seq) {
+            if (slot->done) {
+                if (response)
+                    copyReply(response, &slot->resp);
+                slot->seq = 0;
+                res = true;
+            }
+            break;
+        }
+    }
+    pthread_mutex_unlock(&asyncMutex);
+    return res;
+}
+
+static bool GetFromDevice_internal(DeviceMemType_t memtype, uint8_t *dest, uint32_t bytes, uint32_t start_index, uint8_t *data, uint32_t datalen, PacketResponseNG *response, size_t ms_timeout, bool show_warning) {
 
     if (dest == NULL) return false;
     if (bytes == 0) return true;
@@ -793,20 +1188,17 @@ bool GetFromDevice(DeviceMemType_t memtype, uint8_t *dest, uint32_t bytes, uint3
 
     switch (memtype) {
         case BIG_BUF: {
-            SendCommandMIX(CMD_DOWNLOAD_BIGBUF, start_index, bytes, 0, NULL, 0);
-            return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_DOWNLOADED_BIGBUF);
+            return dl_stream(DL_STREAM_BIGBUF, dest, bytes, start_index, response, ms_timeout, show_warning);
         }
         case BIG_BUF_EML: {
-            SendCommandMIX(CMD_DOWNLOAD_EML_BIGBUF, start_index, bytes, 0, NULL, 0);
-            return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_DOWNLOADED_EML_BIGBUF);
+            return dl_stream(DL_STREAM_BIGBUF_EML, dest, bytes, start_index, response, ms_timeout, show_warning);
         }
         case SPIFFS: {
             SendCommandMIX(CMD_SPIFFS_DOWNLOAD, start_index, bytes, 0, data, datalen);
             return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_SPIFFS_DOWNLOADED);
         }
         case FLASH_MEM: {
-            SendCommandMIX(CMD_FLASHMEM_DOWNLOAD, start_index, bytes, 0, NULL, 0);
-            return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_FLASHMEM_DOWNLOADED);
+            return dl_stream(DL_STREAM_FLASHMEM, dest, bytes, start_index, response, ms_timeout, show_warning);
         }
         case SIM_MEM: {
             //SendCommandMIX(CMD_DOWNLOAD_SIM_MEM, start_index, bytes, 0, NULL, 0);
@@ -821,6 +1213,157 @@ bool GetFromDevice(DeviceMemType_t memtype, uint8_t *dest, uint32_t bytes, uint3
     return false;
 }
 
+/**
+* Data transfer from Proxmark to client. This method times out after
+* ms_timeout milliseconds.
+* @brief GetFromDevice
+* @param memtype Type of memory to download from proxmark
+* @param dest Destination address for transfer
+* @param bytes number of bytes to be transferred
+* @param start_index offset into Proxmark3 BigBuf[]
+* @param data used by SPIFFS to provide filename
+* @param datalen used by SPIFFS to provide filename length
+* @param response struct to copy last command (CMD_ACK) into
+* @param ms_timeout timeout in milliseconds
+* @param show_warning display message after 2 seconds
+* @return true if command was returned, otherwise false
+*/
+bool GetFromDevice(DeviceMemType_t memtype, uint8_t *dest, uint32_t bytes, uint32_t start_index, uint8_t *data, uint32_t datalen, PacketResponseNG *response, size_t ms_timeout, bool show_warning) {
+    uint64_t start = usclock();
+    bool res = GetFromDevice_internal(memtype, dest, bytes, start_index, data, datalen, response, ms_timeout, show_warning);
+    perf_wait(usclock() - start);
+    return res;
+}
+
+/**
+* Uploads data to the emulator memory with a window of chunks in flight. The device
+* answers every chunk, so a lost one or a slow device is noticed right away.
+* Over FPC USART there is only room for one packet in the device FIFO, no window then.
+* @brief SendToDeviceEML
+* @param src data to upload
+* @param bytes number of bytes to be transferred
+* @param start_index offset into emulator memory
+* @return PM3_SUCCESS when every chunk was acknowledged
+*/
+int SendToDeviceEML(uint8_t *src, uint32_t bytes, uint32_t start_index) {
+
+    uint32_t nchunks = (bytes + EML_UPLOAD_CHUNK_SIZE - 1) / EML_UPLOAD_CHUNK_SIZE;
+    uint32_t window = conn.send_via_fpc_usart ? 1 : EML_UPLOAD_WINDOW;
+    uint32_t sent = 0, acked = 0;
+    eml_upload_chunk_t chunk;
+    PacketResponseNG resp;
+
+    clearCommandBuffer();
+
+    while (acked < nchunks) {
+
+        while (sent < nchunks && sent - acked < window) {
+            uint32_t offset = sent * EML_UPLOAD_CHUNK_SIZE;
+            chunk.seq = sent;
+            chunk.offset = start_index + offset;
+            chunk.len = MIN(bytes - offset, EML_UPLOAD_CHUNK_SIZE);
+            memcpy(chunk.data, src + offset, chunk.len);
+            SendCommandNG(CMD_UPLOAD_EML_STREAM, (uint8_t *)&chunk, offsetof(eml_upload_chunk_t, data) + chunk.len);
+            sent++;
+        }
+
+        if (!WaitForResponseTimeout(CMD_UPLOAD_EML_STREAM, &resp, 2500)) {
+            return PM3_ETIMEOUT;
+        }
+        if (resp.status != PM3_SUCCESS) {
+            return resp.status;
+        }
+        uint16_t seq = 0;
+        memcpy(&seq, resp.data.asBytes, sizeof(seq));
+        if (resp.length < sizeof(seq) || seq != (uint16_t)acked) {
+            PrintAndLogEx(DEBUG, "Emulator upload, chunk %u acknowledged out of order", acked);
+            return PM3_ESOFT;
+        }
+        acked++;
+    }
+    return PM3_SUCCESS;
+}
+
+/**
+* Uploads data to flash memory with a window of chunks in flight, like SendToDeviceEML.
+* CMD_FLASHMEM_WRITE_STREAM writes at start_index, CMD_SPIFFS_WRITE_STREAM writes the file fn.
+* The device reads back what was written after the last chunk, its CRC32 must match.
+* @brief SendToDeviceFlash
+* @param cmd CMD_FLASHMEM_WRITE_STREAM or CMD_SPIFFS_WRITE_STREAM
+* @param fn SPIFFS file name, unused for flash memory
+* @param src data to upload
+* @param bytes number of bytes to be transferred
+* @param start_index offset into flash memory
+* @return PM3_SUCCESS when every chunk was acknowledged and the read back matches
+*/
+int SendToDeviceFlash(uint16_t cmd, const char *fn, const uint8_t *src, uint32_t bytes, uint32_t start_index) {
+
+    // the file name goes first, in a chunk of its own
+    uint32_t first = (cmd == CMD_SPIFFS_WRITE_STREAM) ? 1 : 0;
+    uint32_t nchunks = first + (bytes + FLASH_UPLOAD_CHUNK_SIZE - 1) / FLASH_UPLOAD_CHUNK_SIZE;
+    uint32_t window = conn.send_via_fpc_usart ? 1 : FLASH_UPLOAD_WINDOW;
+    uint32_t sent = 0, acked = 0;
+    flash_upload_chunk_t chunk;
+    PacketResponseNG resp;
+
+    if (nchunks == 0)
+        return PM3_SUCCESS;
+
+    if (nchunks > UINT16_MAX)
+        return PM3_EOVFLOW;
+
+    clearCommandBuffer();
+
+    while (acked < nchunks) {
+
+        while (sent < nchunks && sent - acked < window) {
+            memset(&chunk, 0, offsetof(flash_upload_chunk_t, data));
+            chunk.seq = sent;
+            if (sent < first) {
+                chunk.len = MIN(strlen(fn), FLASH_UPLOAD_CHUNK_SIZE);
+                memcpy(chunk.data, fn, chunk.len);
+            } else {
+                uint32_t offset = (sent - first) * FLASH_UPLOAD_CHUNK_SIZE;
+                chunk.offset = (first) ? offset : start_index + offset;
+                chunk.len = MIN(bytes - offset, FLASH_UPLOAD_CHUNK_SIZE);
+                memcpy(chunk.data, src + offset, chunk.len);
+            }
+            if (sent == nchunks - 1)
+                chunk.flags |= FLASH_UPLOAD_LAST;
+            SendCommandNG(cmd, (uint8_t *)&chunk, offsetof(flash_upload_chunk_t, data) + chunk.len);
+            sent++;
+        }
+
+        // the last answer waits for the read back
+        uint32_t timeout = 2500;
+        if (acked == nchunks - 1)
+            timeout += bytes / 100;
+
+        if (!WaitForResponseTimeout(cmd, &resp, timeout)) {
+            return PM3_ETIMEOUT;
+        }
+        if (resp.status != PM3_SUCCESS) {
+            return resp.status;
+        }
+        flash_upload_ack_t ack;
+        memset(&ack, 0, sizeof(ack));
+        memcpy(&ack, resp.data.asBytes, MIN(resp.length, sizeof(ack)));
+        if (resp.length < sizeof(ack.seq) || ack.seq != (uint16_t)acked) {
+            PrintAndLogEx(DEBUG, "Flash upload, chunk %u acknowledged out of order", acked);
+            return PM3_ESOFT;
+        }
+        acked++;
+
+        if (acked == nchunks) {
+            if (ack.length != bytes || ack.crc != crc32_update(CRC32_PRESET, src, bytes)) {
+                PrintAndLogEx(DEBUG, "Flash upload, read back %u bytes crc %08x", ack.length, ack.crc);
+                return PM3_EFLASH;
+            }
+        }
+    }
+    return PM3_SUCCESS;
+}
+
 static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, size_t ms_timeout, bool show_warning, uint32_t rec_cmd) {
 
     uint32_t bytes_completed = 0;
@@ -832,20 +1375,26 @@ static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, siz
 
     while (true) {
 
-        if (getReply(response)) {
+        PacketResponseNG *reply = getReply();
+        if (reply == NULL) {
+            rxWaitForReply(10);
+        } else {
 
-            if (response->cmd == CMD_ACK)
+            if (reply->cmd == CMD_ACK) {
+                copyReply(response, reply);
+                releaseReply();
                 return true;
+            }
 
             // sample_buf is a array pointer, located in data.c
             // arg0 = offset in transfer. Startindex of this chunk
             // arg1 = length bytes to transfer
             // arg2 = bigbuff tracelength (?)
-            if (response->cmd == rec_cmd) {
+            if (reply->cmd == rec_cmd) {
 
-                uint32_t offset = response->oldarg[0];
-                uint32_t copy_bytes = MIN(bytes - bytes_completed, response->oldarg[1]);
-                //uint32_t tracelen = response->oldarg[2];
+                uint32_t offset = reply->oldarg[0];
+                uint32_t copy_bytes = MIN(bytes - bytes_completed, reply->oldarg[1]);
+                //uint32_t tracelen = reply->oldarg[2];
 
                 // extended bounds check1.  upper limit is PM3_CMD_DATA_SIZE
                 // shouldn't happen
@@ -854,17 +1403,22 @@ static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, siz
                 // extended bounds check2.
                 if (offset + copy_bytes > bytes) {
                     PrintAndLogEx(FAILED, "ERROR: Out of bounds when downloading from device,  offset %u | len %u | total len %u > buf_size %u", offset, copy_bytes,  offset + copy_bytes,  bytes);
+                    copyReply(response, reply);
+                    releaseReply();
                     break;
                 }
 
-                memcpy(dest + offset, response->data.asBytes, copy_bytes);
+                // straight from rxBuffer to destination
+                memcpy(dest + offset, reply->data.asBytes, copy_bytes);
                 bytes_completed += copy_bytes;
-            } else if (response->cmd == CMD_WTX && response->length == sizeof(uint16_t)) {
-                uint16_t wtx = response->data.asDwords[0] & 0xFFFF;
+                copyReply(response, reply);
+            } else if (reply->cmd == CMD_WTX && reply->length == sizeof(uint16_t)) {
+                uint16_t wtx = reply->data.asDwords[0] & 0xFFFF;
                 PrintAndLogEx(DEBUG, "Got Waiting Time eXtension request %i ms", wtx);
                 if (ms_timeout != (size_t) - 1)
                     ms_timeout += wtx;
             }
+            releaseReply();
         }
 
         uint64_t tmp_clk = __atomic_load_n(&timeout_start_time, __ATOMIC_SEQ_CST);
@@ -882,3 +1436,182 @@ static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, siz
     }
     return false;
 }
+
+/**
+ * @brief One streamed download request, chunks are written (or LZ4 decompressed) straight to dest.
+ * @param flags DL_STREAM_LZ4 for compressed frames
+ * @param seen per chunk reception flags, (bytes / DL_STREAM_CHUNK_SIZE) + 1 entries, unused with DL_STREAM_LZ4
+ * @param end final frame of the stream
+ * @return PM3_SUCCESS, PM3_EPARTIAL if chunks are missing, PM3_ESOFT on CRC mismatch, or the device / timeout error
+ */
+static int dl_stream_range(uint8_t memtype, uint8_t flags, uint8_t *dest, uint32_t bytes, uint32_t start_index, uint8_t *seen, download_stream_end_t *end, size_t ms_timeout, bool show_warning) {
+
+    download_stream_req_t req = {
+        .memtype = memtype,
+        .flags = flags,
+        .start = start_index,
+        .length = bytes
+    };
+
+    uint32_t nchunks = (bytes + DL_STREAM_CHUNK_SIZE - 1) / DL_STREAM_CHUNK_SIZE;
+    memset(seen, 0, nchunks);
+    uint32_t lz4_frames = 0, lz4_bytes = 0;
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_DOWNLOAD_STREAM, (uint8_t *)&req, sizeof(req));
+
+    __atomic_store_n(&timeout_start_time,  msclock(), __ATOMIC_SEQ_CST);
+
+    while (true) {
+        PacketResponseNG *reply = getReply();
+        if (reply == NULL) {
+            uint64_t tmp_clk = __atomic_load_n(&timeout_start_time, __ATOMIC_SEQ_CST);
+            if (msclock() - tmp_clk > ms_timeout) {
+                PrintAndLogEx(FAILED, "Timed out while trying to download data from device");
+                return PM3_ETIMEOUT;
+            }
+
+            if (msclock() - tmp_clk > 3000 && show_warning) {
+                // 3 seconds elapsed (but this doesn't mean the timeout was exceeded)
+                PrintAndLogEx(INFO, "Waiting for a response from the Proxmark3...");
+                PrintAndLogEx(INFO, "You can cancel this operation by pressing the pm3 button");
+                show_warning = false;
+            }
+            rxWaitForReply(10);
+            continue;
+        }
+
+        if (reply->cmd == CMD_DOWNLOADED_STREAM && (flags & DL_STREAM_LZ4) && reply->length > offsetof(download_stream_lz4_chunk_t, data)) {
+            download_stream_lz4_chunk_t *lchunk = (download_stream_lz4_chunk_t *)reply->data.asBytes;
+            int clen = reply->length - offsetof(download_stream_lz4_chunk_t, data);
+
+            if ((lchunk->offset > bytes) || (lchunk->rawlen > bytes - lchunk->offset)) {
+                PrintAndLogEx(FAILED, "ERROR: Out of bounds when downloading from device,  offset %u | len %u | total len %u > buf_size %u", lchunk->offset, lchunk->rawlen, lchunk->offset + lchunk->rawlen, bytes);
+                releaseReply();
+                return PM3_EOUTOFBOUND;
+            }
+
+            // straight from rxBuffer to destination
+            int res = LZ4_decompress_safe((const char *)lchunk->data, (char *)dest + lchunk->offset, clen, lchunk->rawlen);
+            if (res == lchunk->rawlen) {
+                lz4_frames++;
+                lz4_bytes += lchunk->rawlen;
+            } else {
+                PrintAndLogEx(DEBUG, "Streamed download, LZ4 frame %u failed to decompress", lchunk->seq);
+            }
+
+        } else if (reply->cmd == CMD_DOWNLOADED_STREAM && reply->length > sizeof(uint16_t)) {
+            download_stream_chunk_t *chunk = (download_stream_chunk_t *)reply->data.asBytes;
+            uint32_t offset = chunk->seq * DL_STREAM_CHUNK_SIZE;
+            uint32_t len = reply->length - sizeof(chunk->seq);
+
+            if ((chunk->seq >= nchunks) || (offset + len > bytes)) {
+                PrintAndLogEx(FAILED, "ERROR: Out of bounds when downloading from device,  offset %u | len %u | total len %u > buf_size %u", offset, len,  offset + len,  bytes);
+                releaseReply();
+                return PM3_EOUTOFBOUND;
+            }
+
+            // straight from rxBuffer to destination
+            memcpy(dest + offset, chunk->data, len);
+            seen[chunk->seq] = 1;
+
+        } else if (reply->cmd == CMD_DOWNLOAD_STREAM) {
+            int16_t status = reply->status;
+            if (status == PM3_SUCCESS) {
+                memcpy(end, reply->data.asBytes, MIN(reply->length, sizeof(download_stream_end_t)));
+            }
+            releaseReply();
+            if (status != PM3_SUCCESS)
+                return status;
+            break;
+
+        } else if (reply->cmd == CMD_WTX && reply->length == sizeof(uint16_t)) {
+            uint16_t wtx = reply->data.asDwords[0] & 0xFFFF;
+            PrintAndLogEx(DEBUG, "Got Waiting Time eXtension request %i ms", wtx);
+            if (ms_timeout != (size_t) - 1)
+                ms_timeout += wtx;
+        }
+        releaseReply();
+    }
+
+    if (flags & DL_STREAM_LZ4) {
+        if ((lz4_frames != end->frames) || (lz4_bytes != bytes))
+            return PM3_EPARTIAL;
+    } else {
+        for (uint32_t i = 0; i < nchunks; i++) {
+            if (seen[i] == 0)
+                return PM3_EPARTIAL;
+        }
+    }
+
+    if (crc32_update(CRC32_PRESET, dest, bytes) != end->crc) {
+        PrintAndLogEx(DEBUG, "Streamed download CRC mismatch");
+        return PM3_ESOFT;
+    }
+    return PM3_SUCCESS;
+}
+
+// Streamed download, only the missing or corrupted part is requested again.
+// Slow links get LZ4 compressed frames, a failed compressed transfer falls back to plain frames
+static bool dl_stream(uint8_t memtype, uint8_t *dest, uint32_t bytes, uint32_t start_index, PacketResponseNG *response, size_t ms_timeout, bool show_warning) {
+
+    // Add delay depending on the communication channel & speed
+    if (ms_timeout != (size_t) - 1)
+        ms_timeout += communication_delay();
+
+    uint8_t *seen = calloc((bytes / DL_STREAM_CHUNK_SIZE) + 1, sizeof(uint8_t));
+    if (seen == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return false;
+    }
+
+    download_stream_end_t end;
+    memset(&end, 0, sizeof(end));
+
+    uint32_t offset = 0;
+    uint32_t len = bytes;
+    int res = PM3_EUNDEF;
+
+    uint8_t flags = 0;
+    if (conn.send_via_fpc_usart && (memtype != DL_STREAM_FLASHMEM))
+        flags |= DL_STREAM_LZ4;
+
+    for (uint8_t attempt = 0; attempt < 3; attempt++) {
+
+        res = dl_stream_range(memtype, flags, dest + offset, len, start_index + offset, seen, &end, ms_timeout, show_warning);
+        if ((res == PM3_EPARTIAL || res == PM3_ESOFT || res == PM3_ENOTIMPL) && (flags & DL_STREAM_LZ4)) {
+            PrintAndLogEx(DEBUG, "Compressed streamed download failed, falling back to plain frames");
+            flags &= ~DL_STREAM_LZ4;
+            continue;
+        }
+        if (res == PM3_EPARTIAL) {
+            uint32_t nchunks = (len + DL_STREAM_CHUNK_SIZE - 1) / DL_STREAM_CHUNK_SIZE;
+            uint32_t first = 0, last = nchunks - 1;
+            while (seen[first])
+                first++;
+            while (seen[last])
+                last--;
+
+            PrintAndLogEx(DEBUG, "Streamed download missed chunks %u..%u, requesting them again", first, last);
+            offset += first * DL_STREAM_CHUNK_SIZE;
+            len = MIN(len - first * DL_STREAM_CHUNK_SIZE, (last - first + 1) * DL_STREAM_CHUNK_SIZE);
+            continue;
+        }
+        if (res != PM3_ESOFT)
+            break;
+    }
+    free(seen);
+
+    if (res != PM3_SUCCESS)
+        return false;
+
+    // mimic the final ACK of the legacy download commands
+    memset(response, 0, offsetof(PacketResponseNG, data));
+    response->cmd = CMD_ACK;
+    response->ng = false;
+    response->oldarg[0] = 1;
+    response->oldarg[2] = end.tracelen;
+    response->length = sizeof(sample_config);
+    memcpy(response->data.asBytes, &end.config, sizeof(sample_config));
+    return true;
+}
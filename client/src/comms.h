@@ -39,6 +39,16 @@ extern "C" {
 #define CMD_BUFFER_SIZE 100
 #endif
 
+//For storing commands waiting to be sent to the device
+#ifndef CMD_TXQUEUE_SIZE
+#define CMD_TXQUEUE_SIZE 16
+#endif
+
+//Maximum number of commands sent with SendCommandNGAsync waiting for their reply
+#ifndef CMD_ASYNC_SLOTS
+#define CMD_ASYNC_SLOTS 16
+#endif
+
 typedef enum {
     BIG_BUF,
     BIG_BUF_EML,
@@ -49,6 +59,13 @@ typedef enum {
 } DeviceMemType_t;
 
 
+// Several commands sent to the device as one CMD_BATCH frame, see BatchAddNG/BatchAddMIX
+typedef struct {
+    uint16_t length;
+    uint8_t count;
+    uint8_t data[PM3_CMD_DATA_SIZE];
+} cmd_batch_t;
+
 typedef struct {
     bool run; // If TRUE, continue running the uart_communication thread
     bool block_after_ACK; // if true, block after receiving an ACK package
@@ -70,6 +87,11 @@ void SendCommandBL(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, vo
 void SendCommandOLD(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, void *data, size_t len);
 void SendCommandNG(uint16_t cmd, uint8_t *data, size_t len);
 void SendCommandMIX(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, void *data, size_t len);
+int SendCommandNGAsync(uint16_t cmd, uint8_t *data, size_t len, uint32_t *seq);
+void BatchInit(cmd_batch_t *batch);
+int BatchAddNG(cmd_batch_t *batch, uint16_t cmd, const void *data, size_t len);
+int BatchAddMIX(cmd_batch_t *batch, uint16_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, const void *data, size_t len);
+void SendCommandBatch(cmd_batch_t *batch);
 void clearCommandBuffer(void);
 
 #define FLASHMODE_SPEED 460800
@@ -81,9 +103,13 @@ void CloseProxmark(void);
 bool WaitForResponseTimeoutW(uint32_t cmd, PacketResponseNG *response, size_t ms_timeout, bool show_warning);
 bool WaitForResponseTimeout(uint32_t cmd, PacketResponseNG *response, size_t ms_timeout);
 bool WaitForResponse(uint32_t cmd, PacketResponseNG *response);
+bool WaitForResponseSeq(uint32_t seq, PacketResponseNG *response, size_t ms_timeout);
+bool PollResponseSeq(uint32_t seq, PacketResponseNG *response);
 
 //bool GetFromDevice(DeviceMemType_t memtype, uint8_t *dest, uint32_t bytes, uint32_t start_index, PacketResponseNG *response, size_t ms_timeout, bool show_warning);
 bool GetFromDevice(DeviceMemType_t memtype, uint8_t *dest, uint32_t bytes, uint32_t start_index, uint8_t *data, uint32_t datalen, PacketResponseNG *response, size_t ms_timeout, bool show_warning);
+int SendToDeviceEML(uint8_t *src, uint32_t bytes, uint32_t start_index);
+int SendToDeviceFlash(uint16_t cmd, const char *fn, const uint8_t *src, uint32_t bytes, uint32_t start_index);
 
 #ifdef __cplusplus
 }
@@ -234,11 +234,13 @@ static void asn1_tag_dump_integer(const struct tlv *tlv, const struct asn1_tag *
     fprintf(f, "\tvalue: %lu\n", asn1_value_integer(tlv, 0, tlv->len * 2));
 }
 
-static char *asn1_oid_description(const char *oid, bool with_group_desc) {
-    json_error_t error;
-    json_t *root = NULL;
-    static char res[300];
-    memset(res, 0x00, sizeof(res));
+// oids.json is loaded on the first OID of the client run and stays, a dump has many of them
+static json_t *asn1_oids_root(void) {
+    static json_t *root = NULL;
+    static bool loaded = false;
+    if (loaded)
+        return root;
+    loaded = true;
 
     char *path;
     if (searchFile(&path, RESOURCES_SUBDIR, "oids", ".json", false) != PM3_SUCCESS) {
@@ -246,20 +248,33 @@ static char *asn1_oid_description(const char *oid, bool with_group_desc) {
     }
 
     // load `oids.json`
+    json_error_t error;
     root = json_load_file(path, 0, &error);
     free(path);
 
-    if (!root || !json_is_object(root)) {
-        goto error;
+    if (root && !json_is_object(root)) {
+        json_decref(root);
+        root = NULL;
+    }
+    return root;
+}
+
+static char *asn1_oid_description(const char *oid, bool with_group_desc) {
+    static char res[300];
+    memset(res, 0x00, sizeof(res));
+
+    json_t *root = asn1_oids_root();
+    if (!root) {
+        return NULL;
     }
 
     json_t *elm = json_object_get(root, oid);
     if (!elm) {
-        goto error;
+        return NULL;
     }
 
     if (JsonLoadStr(elm, "$.d", res))
-        goto error;
+        return NULL;
 
     char strext[300] = {0};
     if (!JsonLoadStr(elm, "$.c", strext)) {
@@ -268,13 +283,7 @@ static char *asn1_oid_description(const char *oid, bool with_group_desc) {
         strcat(res, ")");
     }
 
-    json_decref(root);
     return res;
-
-error:
-    if (root)
-        json_decref(root);
-    return NULL;
 }
 
 static void asn1_tag_dump_object_id(const struct tlv *tlv, const struct asn1_tag *tag, FILE *f, int level) {
@@ -14,6 +14,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <pthread.h>
 #include <mbedtls/asn1.h>
 #include <mbedtls/aes.h>
 #include <mbedtls/cmac.h>
@@ -346,6 +347,31 @@ static int ecdsa_signature_verify_keystr(mbedtls_ecp_group_id curveid, const cha
     return res;
 }
 
+// The curves verified with are loaded once and kept. The first multiplication with the generator
+// leaves its precomputed table in the group, later verifications on the curve reuse it
+#define ECDSA_VERIFY_CURVES 4
+static mbedtls_ecdsa_context ecdsa_verify_ctx[ECDSA_VERIFY_CURVES];
+static mbedtls_ecp_group_id ecdsa_verify_curve[ECDSA_VERIFY_CURVES];
+static pthread_mutex_t ecdsa_verify_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// under ecdsa_verify_lock
+static mbedtls_ecdsa_context *ecdsa_verify_get_ctx(mbedtls_ecp_group_id curveid) {
+    for (int i = 0; i < ECDSA_VERIFY_CURVES; i++) {
+        if (ecdsa_verify_curve[i] == curveid)
+            return &ecdsa_verify_ctx[i];
+
+        if (ecdsa_verify_curve[i] == MBEDTLS_ECP_DP_NONE) {
+            if (ecdsa_init(&ecdsa_verify_ctx[i], curveid, NULL, NULL)) {
+                mbedtls_ecdsa_free(&ecdsa_verify_ctx[i]);
+                return NULL;
+            }
+            ecdsa_verify_curve[i] = curveid;
+            return &ecdsa_verify_ctx[i];
+        }
+    }
+    return NULL;
+}
+
 int ecdsa_signature_verify(mbedtls_ecp_group_id curveid, uint8_t *key_xy, uint8_t *input, int length, uint8_t *signature, size_t signaturelen, bool hash) {
     int res;
     uint8_t shahash[32] = {0};
@@ -355,6 +381,24 @@ int ecdsa_signature_verify(mbedtls_ecp_group_id curveid, uint8_t *key_xy, uint8_
             return res;
     }
 
+    pthread_mutex_lock(&ecdsa_verify_lock);
+    mbedtls_ecdsa_context *cached = ecdsa_verify_get_ctx(curveid);
+    if (cached != NULL) {
+        size_t keylen = (cached->grp.nbits + 7) / 8;
+        res = mbedtls_ecp_point_read_binary(&cached->grp, &cached->Q, key_xy, keylen * 2 + 1);
+        if (res == 0)
+            res = mbedtls_ecdsa_read_signature(
+                      cached,
+                      hash ? shahash : input,
+                      hash ? sizeof(shahash) : length,
+                      signature,
+                      signaturelen
+                  );
+        pthread_mutex_unlock(&ecdsa_verify_lock);
+        return res;
+    }
+    pthread_mutex_unlock(&ecdsa_verify_lock);
+
     mbedtls_ecdsa_context ctx;
     res = ecdsa_init(&ctx, curveid, NULL, key_xy);
     if (res)
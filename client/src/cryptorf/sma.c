@@ -0,0 +1,811 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) 2010, Flavio D. Garcia, Peter van Rossum, Roel Verdult
+// and Ronny Wichers Schreur. Radboud University Nijmegen
+//
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// SecureMemory key recovery, ported from tools/cryptorf/sma_multi.cpp
+//
+// The right cipher register (25 bits) is searched for the states that best
+// match the keystream, the best one gives the mask of keystream bits the left
+// register (35 bits) has to produce by itself. Both sides are rolled back to
+// the Gc bytes with a meet in the middle, the combinations that agree on the
+// shared Gc bits are tested with sm_auth.
+//
+// All searches run on one pool of worker threads that pick work units off a
+// shared counter. Candidates are kept in plain arrays sorted with qsort.
+//-----------------------------------------------------------------------------
+
+#include "sma.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include "commonutil.h"     // num_to_bytes
+#include "cryptorf/cryptolib.h"
+#include "pm3_cmd.h"
+#include "ui.h"
+#include "util.h"           // num_CPUs, kbd_enter_pressed
+#include "util_posix.h"     // msclock, msleep
+
+#define SMA_MAX_THREADS         64
+// right states with fewer correct keystream bits are ignored
+#define SMA_RIGHT_MIN_BITS      90
+#define SMA_RIGHT_WARN_BITS     96
+// states searched per work unit
+#define SMA_RIGHT_UNIT_BITS     16
+#define SMA_LEFT_UNIT_BITS      24
+#define SMA_COMPARE_UNIT        256
+
+#define BIT_ROL_MASK     ((1 << 5) - 1)
+#define BIT_ROL(a)       ((((a) << 1) | ((a) >> 4)) & BIT_ROL_MASK)
+#define BIT_ROR(a)       (((a) >> 1) | (((a) & 1) << 4))
+
+typedef struct {
+    uint8_t addition;
+    uint8_t out;
+} lookup_entry_t;
+
+// One side of the cipher state while rolling back to Gc, s is the left or the right register
+typedef struct {
+    uint64_t s;
+    uint8_t Gc[8];
+    bool invalid;
+} sma_state_t;
+
+typedef struct {
+    sma_state_t *items;
+    size_t count;
+    size_t size;
+} sma_states_t;
+
+typedef struct {
+    uint64_t *items;
+    size_t count;
+    size_t size;
+} sma_keys_t;
+
+// register state after the first four Gc bytes, for the 2^20 values of their 5 bits
+typedef struct {
+    uint64_t state;
+    uint32_t counter;
+} sma_match_t;
+
+typedef struct sma_ctx_s sma_ctx_t;
+typedef void (*sma_work_fn)(sma_ctx_t *ctx, uint64_t unit);
+
+struct sma_ctx_s {
+    // worker pool
+    pthread_t threads[SMA_MAX_THREADS];
+    int num_threads;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    uint32_t generation;
+    bool quit;
+
+    // current job
+    sma_work_fn work;
+    uint64_t units;
+    uint64_t next;
+    uint64_t done;
+    int busy;
+    bool stop;
+    bool abort;
+    bool failed;
+
+    // results of the workers
+    pthread_mutex_t result_lock;
+
+    // authentication
+    uint8_t Ci[8];
+    uint8_t Q[8];
+    uint8_t Ch[8];
+    uint8_t Ci_1[8];
+    uint8_t ks[16];
+    uint8_t mask[16];
+    uint64_t rstate_before_gc;
+    uint64_t lstate_before_gc;
+
+    sma_match_t *rmatch;
+    sma_match_t *lmatch;
+    size_t rmatch_count;
+    size_t lmatch_count;
+
+    uint32_t topbits;
+    sma_keys_t rbins;       // correct bits << 56 | right state
+    sma_keys_t lbins;       // correct bits << 56 | left state
+    sma_states_t rcand;
+    sma_states_t lcand;
+    sma_keys_t gc;
+    bool found;
+    uint64_t key;
+};
+
+static uint8_t lookup_left_subtraction[0x400];
+static uint8_t lookup_right_subtraction[0x400];
+static lookup_entry_t lookup_left[0x100000];
+static lookup_entry_t lookup_right[0x8000];
+static uint8_t left_addition[0x100000];
+static bool lookup_ready = false;
+
+static inline uint8_t mod(uint8_t a, uint8_t m) {
+    // Just return the input when this is less or equal than the modular value
+    if (a < m) return a;
+
+    // Compute the modular value
+    a %= m;
+
+    // Return the funny value, when the output was now zero, return the modular value
+    return (a == 0) ? m : a;
+}
+
+static void init_lookup_tables(void) {
+    if (lookup_ready)
+        return;
+
+    for (int i = 0; i < 0x400; i++) {
+        uint8_t b6 = i & 0x1f;
+        uint8_t b3 = (i >> 5) & 0x1f;
+        int index = (b3 << 15) | b6;
+
+        uint8_t temp = mod(b3 + BIT_ROL(b6), 0x1f);
+        left_addition[index] = temp;
+        lookup_left[index].addition = temp;
+        lookup_left[index].out = ((temp ^ b3) & 0x0f);
+
+        uint8_t b18 = i & 0x1f;
+        uint8_t b16 = (i >> 5) & 0x1f;
+        index = (b16 << 10) | b18;
+
+        temp = mod(b18 + b16, 0x1f);
+        lookup_right[index].addition = temp;
+        lookup_right[index].out = ((temp ^ b16) & 0x0f);
+
+        uint8_t bx = i & 0x1f;
+        lookup_left_subtraction[i] = BIT_ROR(mod((bx + 0x1F) - b3, 0x1F));
+        lookup_right_subtraction[i] = mod((bx + 0x1F) - b16, 0x1F);
+    }
+    lookup_ready = true;
+}
+
+static inline uint8_t next_left_fast(uint8_t in, uint64_t *left) {
+    if (in)
+        *left ^= ((in & 0x1f) << 20);
+
+    lookup_entry_t *lookup = &(lookup_left[((*left) & 0xf801f)]);
+    *left = (((*left) >> 5) | ((uint64_t)lookup->addition << 30));
+    return lookup->out;
+}
+
+static inline uint8_t next_right_fast(uint8_t in, uint64_t *right) {
+    if (in)
+        *right ^= ((in & 0xf8) << 12);
+
+    lookup_entry_t *lookup = &(lookup_right[((*right) & 0x7c1f)]);
+    *right = (((*right) >> 5) | (lookup->addition << 20));
+    return lookup->out;
+}
+
+// keystream byte of the right register, xored with the expected one
+static inline uint8_t right_ks_diff(uint64_t *rstate, uint8_t ks) {
+    next_right_fast(0, rstate);
+    uint8_t bt = next_right_fast(0, rstate) << 4;
+    next_right_fast(0, rstate);
+    bt |= next_right_fast(0, rstate);
+    return bt ^ ks;
+}
+
+static bool states_push(sma_states_t *a, const sma_state_t *s) {
+    if (a->count == a->size) {
+        size_t size = (a->size) ? a->size * 2 : 1024;
+        sma_state_t *items = realloc(a->items, size * sizeof(sma_state_t));
+        if (items == NULL)
+            return false;
+        a->items = items;
+        a->size = size;
+    }
+    a->items[a->count++] = *s;
+    return true;
+}
+
+static bool keys_push(sma_keys_t *a, uint64_t key) {
+    if (a->count == a->size) {
+        size_t size = (a->size) ? a->size * 2 : 1024;
+        uint64_t *items = realloc(a->items, size * sizeof(uint64_t));
+        if (items == NULL)
+            return false;
+        a->items = items;
+        a->size = size;
+    }
+    a->items[a->count++] = key;
+    return true;
+}
+
+static void states_free(sma_states_t *a) {
+    free(a->items);
+    memset(a, 0, sizeof(sma_states_t));
+}
+
+static void keys_free(sma_keys_t *a) {
+    free(a->items);
+    memset(a, 0, sizeof(sma_keys_t));
+}
+
+static int cmp_key_desc(const void *a, const void *b) {
+    uint64_t ka = *(const uint64_t *)a;
+    uint64_t kb = *(const uint64_t *)b;
+    return (ka < kb) - (ka > kb);
+}
+
+static int cmp_match(const void *a, const void *b) {
+    const sma_match_t *ma = (const sma_match_t *)a;
+    const sma_match_t *mb = (const sma_match_t *)b;
+    if (ma->state != mb->state)
+        return (ma->state > mb->state) - (ma->state < mb->state);
+    return (ma->counter > mb->counter) - (ma->counter < mb->counter);
+}
+
+static int cmp_match_state(const void *key, const void *m) {
+    uint64_t state = *(const uint64_t *)key;
+    uint64_t other = ((const sma_match_t *)m)->state;
+    return (state > other) - (state < other);
+}
+
+// Rolls back every state by one input byte, a state with two possible predecessors gets a copy
+static bool previous_state(sma_states_t *states, uint8_t in, bool right) {
+    size_t count = states->count;
+    for (size_t pos = 0; pos < count; pos++) {
+        sma_state_t *state = &states->items[pos];
+        uint8_t bx;
+        unsigned b;
+        uint64_t keep;
+
+        if (right) {
+            bx = (uint8_t)((state->s >> 20) & 0x1f);
+            b = (unsigned)(state->s & 0x3e0);
+            keep = 0x1ffffe0ull;
+        } else {
+            bx = (uint8_t)((state->s >> 30) & 0x1f);
+            b = (unsigned)(state->s >> 5) & 0x3e0;
+            keep = 0x7ffffffe0ull;
+        }
+        uint64_t feed = (right) ? (((uint64_t)in & 0xf8) << 12) : (((uint64_t)in & 0x1f) << 20);
+
+        state->s <<= 5;
+
+        // Ignore impossible states
+        if (bx == 0) {
+            if (b != 0) {
+                state->invalid = true;
+            } else {
+                // We only need to consider a zero for the dropped bits
+                state->s &= keep;
+                state->s ^= feed;
+            }
+            continue;
+        }
+
+        uint8_t prev = (right) ? lookup_right_subtraction[b | bx] : lookup_left_subtraction[b | bx];
+        state->s = (state->s & keep) | prev;
+        state->s ^= feed;
+
+        // Check if we have a second candidate
+        if (prev == 0x1f) {
+            sma_state_t nstate = *state;
+            nstate.s &= keep;
+            if (states_push(states, &nstate) == false)
+                return false;
+        }
+    }
+    return true;
+}
+
+// Rolls back over all 2^5 values of the unknown Gc byte at gc_index. With a matchbox only
+// the states that meet the forward states of the first four Gc bytes end up in out
+static bool previous_all_input(const sma_states_t *states, uint8_t gc_index, bool right,
+                               const sma_match_t *match, size_t match_count, sma_states_t *out) {
+    sma_states_t nstates = {0};
+    bool ok = true;
+
+    out->count = 0;
+    for (uint8_t btGc = 0; btGc < 0x20 && ok; btGc++) {
+        uint8_t in = (right) ? btGc << 3 : btGc;
+
+        nstates.count = 0;
+        for (size_t i = 0; i < states->count && ok; i++) {
+            ok = states_push(&nstates, &states->items[i]);
+        }
+        if (ok == false || previous_state(&nstates, in, right) == false) {
+            ok = false;
+            break;
+        }
+
+        for (size_t i = 0; i < nstates.count && ok; i++) {
+            sma_state_t *s = &nstates.items[i];
+            if (s->invalid)
+                continue;
+
+            s->Gc[gc_index] = in;
+
+            if (match) {
+                const sma_match_t *m = bsearch(&s->s, match, match_count, sizeof(sma_match_t), cmp_match_state);
+                if (m == NULL)
+                    continue;
+
+                if (right) {
+                    s->Gc[0] = (m->counter >> 12) & 0xf8;
+                    s->Gc[1] = (m->counter >>  7) & 0xf8;
+                    s->Gc[2] = (m->counter >>  2) & 0xf8;
+                    s->Gc[3] = (m->counter <<  3) & 0xf8;
+                } else {
+                    s->Gc[0] = (m->counter >> 15) & 0x1f;
+                    s->Gc[1] = (m->counter >> 10) & 0x1f;
+                    s->Gc[2] = (m->counter >>  5) & 0x1f;
+                    s->Gc[3] = m->counter & 0x1f;
+                }
+            }
+            ok = states_push(out, s);
+        }
+    }
+    states_free(&nstates);
+    return ok;
+}
+
+// Gc bytes 7..4 rolled back from state, out holds the ones meeting the matchbox
+static bool search_gc_candidates(uint64_t state, const uint8_t *Q, bool right,
+                                 const sma_match_t *match, size_t match_count, sma_states_t *out) {
+    sma_states_t a = {0};
+    sma_states_t b = {0};
+    sma_state_t start;
+    memset(&start, 0, sizeof(start));
+    start.s = state;
+
+    bool ok = states_push(&a, &start)
+              && previous_state(&a, Q[7], right)
+              && previous_all_input(&a, 7, right, NULL, 0, &b)
+              && previous_all_input(&b, 6, right, NULL, 0, &a)
+              && previous_state(&a, Q[6], right)
+              && previous_all_input(&a, 5, right, NULL, 0, &b)
+              && previous_all_input(&b, 4, right, match, match_count, out);
+
+    states_free(&a);
+    states_free(&b);
+    return ok;
+}
+
+// The 2^20 register states after the first four Gc bytes, sorted to be searched. Like
+// the map in sma_multi, the last counter wins for a state
+static sma_match_t *build_matchbox(uint64_t state_before_gc, const uint8_t *Q, bool right, size_t *count) {
+    sma_match_t *mb = calloc(0x100000, sizeof(sma_match_t));
+    if (mb == NULL)
+        return NULL;
+
+    for (uint32_t counter = 0; counter < 0x100000; counter++) {
+        uint64_t s = state_before_gc;
+        if (right) {
+            next_right_fast((counter >> 12) & 0xf8, &s);
+            next_right_fast((counter >> 7)  & 0xf8, &s);
+            next_right_fast(Q[4], &s);
+            next_right_fast((counter >> 2) & 0xf8, &s);
+            next_right_fast((counter << 3) & 0xf8, &s);
+            next_right_fast(Q[5], &s);
+        } else {
+            next_left_fast((counter >> 15) & 0x1f, &s);
+            next_left_fast((counter >> 10) & 0x1f, &s);
+            next_left_fast(Q[4], &s);
+            next_left_fast((counter >> 5) & 0x1f, &s);
+            next_left_fast(counter & 0x1f, &s);
+            next_left_fast(Q[5], &s);
+        }
+        mb[counter].state = s;
+        mb[counter].counter = counter;
+    }
+
+    qsort(mb, 0x100000, sizeof(sma_match_t), cmp_match);
+
+    size_t n = 0;
+    for (size_t i = 0; i < 0x100000; i++) {
+        if (n && mb[n - 1].state == mb[i].state)
+            n--;
+        mb[n++] = mb[i];
+    }
+    *count = n;
+    return mb;
+}
+
+static void *sma_worker(void *arg) {
+    sma_ctx_t *ctx = (sma_ctx_t *)arg;
+    uint32_t seen = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&ctx->lock);
+        while (ctx->quit == false && ctx->generation == seen)
+            pthread_cond_wait(&ctx->wake, &ctx->lock);
+        if (ctx->quit) {
+            pthread_mutex_unlock(&ctx->lock);
+            return NULL;
+        }
+        seen = ctx->generation;
+        pthread_mutex_unlock(&ctx->lock);
+
+        for (;;) {
+            if (__atomic_load_n(&ctx->abort, __ATOMIC_RELAXED) || __atomic_load_n(&ctx->stop, __ATOMIC_RELAXED))
+                break;
+
+            uint64_t unit = __atomic_fetch_add(&ctx->next, 1, __ATOMIC_SEQ_CST);
+            if (unit >= ctx->units)
+                break;
+
+            ctx->work(ctx, unit);
+            __atomic_add_fetch(&ctx->done, 1, __ATOMIC_SEQ_CST);
+        }
+        __atomic_sub_fetch(&ctx->busy, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+static void sma_fail(sma_ctx_t *ctx) {
+    __atomic_store_n(&ctx->failed, true, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&ctx->abort, true, __ATOMIC_SEQ_CST);
+}
+
+// Hands units work units to the pool and waits for them, with progress and enter to cancel
+static int sma_run(sma_ctx_t *ctx, sma_work_fn work, uint64_t units, const char *what) {
+    ctx->work = work;
+    ctx->units = units;
+    ctx->next = 0;
+    ctx->done = 0;
+    ctx->stop = false;
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->busy = ctx->num_threads;
+    ctx->generation++;
+    pthread_cond_broadcast(&ctx->wake);
+    pthread_mutex_unlock(&ctx->lock);
+
+    uint64_t t1 = msclock();
+    uint64_t last = t1;
+    bool progress = false;
+    while (__atomic_load_n(&ctx->busy, __ATOMIC_SEQ_CST) > 0) {
+        msleep(10);
+
+        if (__atomic_load_n(&ctx->abort, __ATOMIC_SEQ_CST) == false && kbd_enter_pressed()) {
+            __atomic_store_n(&ctx->abort, true, __ATOMIC_SEQ_CST);
+        }
+
+        uint64_t now = msclock();
+        if (now - last < 1000)
+            continue;
+
+        last = now;
+        uint64_t done = __atomic_load_n(&ctx->done, __ATOMIC_SEQ_CST);
+        uint64_t eta = (done) ? (now - t1) * (units - done) / done / 1000 : 0;
+        PrintAndLogEx(INPLACE, "%s " _YELLOW_("%3.1f%%") ", ETA %" PRIu64 " s   ", what, (float)done * 100 / units, eta);
+        progress = true;
+    }
+    if (progress)
+        PrintAndLogEx(NORMAL, "");
+
+    if (ctx->failed) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+    if (ctx->abort) {
+        PrintAndLogEx(WARNING, "\naborted via keyboard!");
+        return PM3_EOPABORTED;
+    }
+    return PM3_SUCCESS;
+}
+
+// right register states, bins of the ones with at least SMA_RIGHT_MIN_BITS correct keystream bits
+static void work_right(sma_ctx_t *ctx, uint64_t unit) {
+    uint32_t top = 0;
+    uint64_t start = unit << SMA_RIGHT_UNIT_BITS;
+
+    for (uint64_t counter = start; counter < start + (1ULL << SMA_RIGHT_UNIT_BITS); counter++) {
+        uint64_t rstate = counter;
+        uint32_t bits = 0;
+
+        // When a bit is xored away (=zero), it was the same, so correct ;)
+        for (uint8_t pos = 0; pos < 16; pos++) {
+            bits += 8 - __builtin_popcount(right_ks_diff(&rstate, ctx->ks[pos]));
+        }
+
+        if (bits > top)
+            top = bits;
+
+        if (bits >= SMA_RIGHT_MIN_BITS) {
+            pthread_mutex_lock(&ctx->result_lock);
+            if (keys_push(&ctx->rbins, ((uint64_t)bits << 56) | counter) == false)
+                sma_fail(ctx);
+            pthread_mutex_unlock(&ctx->result_lock);
+        }
+    }
+
+    pthread_mutex_lock(&ctx->result_lock);
+    if (top > ctx->topbits)
+        ctx->topbits = top;
+    pthread_mutex_unlock(&ctx->result_lock);
+}
+
+// left register states that produce all the keystream bits in the mask of the right state
+static void work_left(sma_ctx_t *ctx, uint64_t unit) {
+    uint8_t correct_bits[16];
+    uint64_t start = unit << SMA_LEFT_UNIT_BITS;
+
+    for (uint64_t counter = start; counter < start + (1ULL << SMA_LEFT_UNIT_BITS); counter++) {
+        uint64_t lstate = counter;
+        uint8_t pos;
+
+        for (pos = 0; pos < 16; pos++) {
+            lookup_entry_t *lookup;
+            lstate = ((lstate >> 5) | ((uint64_t)left_addition[lstate & 0xf801f] << 30));
+            lookup = &(lookup_left[lstate & 0xf801f]);
+            lstate = ((lstate >> 5) | ((uint64_t)lookup->addition << 30));
+            uint8_t bt = lookup->out << 4;
+            lstate = ((lstate >> 5) | ((uint64_t)left_addition[lstate & 0xf801f] << 30));
+            lookup = &(lookup_left[lstate & 0xf801f]);
+            lstate = ((lstate >> 5) | ((uint64_t)lookup->addition << 30));
+            bt |= lookup->out;
+
+            // xor the bits with the keystream and count the "correct" bits
+            bt ^= ctx->ks[pos];
+
+            // When the REQUIRED bits are NOT xored away (=zero), ignore this wrong state
+            if ((bt & ctx->mask[pos]) != 0)
+                break;
+
+            correct_bits[pos] = bt;
+        }
+
+        // If we have parsed all 16 bytes of keystream, we have a valid CANDIDATE!
+        if (pos < 16)
+            continue;
+
+        uint32_t bits = 0;
+        for (pos = 0; pos < 16; pos++) {
+            bits += 8 - __builtin_popcount(correct_bits[pos]);
+        }
+
+        pthread_mutex_lock(&ctx->result_lock);
+        if (keys_push(&ctx->lbins, ((uint64_t)bits << 56) | counter) == false)
+            sma_fail(ctx);
+        pthread_mutex_unlock(&ctx->result_lock);
+    }
+}
+
+// meet in the middle for one left state
+static void work_left_gc(sma_ctx_t *ctx, uint64_t unit) {
+    sma_states_t found = {0};
+    uint64_t lstate = ctx->lbins.items[unit] & 0x7ffffffffULL;
+
+    bool ok = search_gc_candidates(lstate, ctx->Q, false, ctx->lmatch, ctx->lmatch_count, &found);
+
+    pthread_mutex_lock(&ctx->result_lock);
+    for (size_t i = 0; i < found.count && ok; i++) {
+        ok = states_push(&ctx->lcand, &found.items[i]);
+    }
+    pthread_mutex_unlock(&ctx->result_lock);
+
+    if (ok == false)
+        sma_fail(ctx);
+    states_free(&found);
+}
+
+// left and right candidates that share the overlapping bits (8 x 2bits of Gc)
+static void work_combine(sma_ctx_t *ctx, uint64_t unit) {
+    const sma_state_t *l = &ctx->lcand.items[unit];
+
+    for (size_t i = 0; i < ctx->rcand.count; i++) {
+        const sma_state_t *r = &ctx->rcand.items[i];
+        uint8_t pos;
+        for (pos = 0; pos < 8; pos++) {
+            if ((l->Gc[pos] & 0x18) != (r->Gc[pos] & 0x18))
+                break;
+        }
+        if (pos < 8)
+            continue;
+
+        uint64_t gc = 0;
+        for (pos = 0; pos < 8; pos++) {
+            gc <<= 8;
+            gc |= (l->Gc[pos] | r->Gc[pos]);
+        }
+
+        pthread_mutex_lock(&ctx->result_lock);
+        if (keys_push(&ctx->gc, gc) == false)
+            sma_fail(ctx);
+        pthread_mutex_unlock(&ctx->result_lock);
+    }
+}
+
+// filter the correct one using the middle part
+static void work_compare(sma_ctx_t *ctx, uint64_t unit) {
+    crypto_state_t ostate;
+    uint8_t Gc_chk[8];
+    uint8_t Ch_chk[8];
+    uint8_t Ci_1_chk[8];
+
+    size_t end = MIN(ctx->gc.count, (unit + 1) * SMA_COMPARE_UNIT);
+    for (size_t i = unit * SMA_COMPARE_UNIT; i < end; i++) {
+        num_to_bytes(ctx->gc.items[i], 8, Gc_chk);
+
+        sm_auth(Gc_chk, ctx->Ci, ctx->Q, Ch_chk, Ci_1_chk, &ostate);
+        if ((memcmp(Ch_chk, ctx->Ch, 8) == 0) && (memcmp(Ci_1_chk, ctx->Ci_1, 8) == 0)) {
+            pthread_mutex_lock(&ctx->result_lock);
+            ctx->found = true;
+            ctx->key = ctx->gc.items[i];
+            pthread_mutex_unlock(&ctx->result_lock);
+            __atomic_store_n(&ctx->stop, true, __ATOMIC_SEQ_CST);
+            return;
+        }
+    }
+}
+
+// Left side, combination and test for one right state
+static int sma_try_right_state(sma_ctx_t *ctx, uint64_t rstate_after_gc) {
+
+    // the keystream bits the right state gets wrong, the left one has to fix them
+    uint64_t rstate = rstate_after_gc;
+    for (uint8_t pos = 0; pos < 16; pos++) {
+        ctx->mask[pos] = right_ks_diff(&rstate, ctx->ks[pos]);
+    }
+
+    PrintAndLogEx(INFO, "Using the state from the top-right bin: " _YELLOW_("0x%07" PRIx64), rstate_after_gc);
+
+    if (search_gc_candidates(rstate_after_gc, ctx->Q, true, ctx->rmatch, ctx->rmatch_count, &ctx->rcand) == false) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+    PrintAndLogEx(INFO, "Found " _YELLOW_("%zu") " right candidates using the meet-in-the-middle attack", ctx->rcand.count);
+    if (ctx->rcand.count == 0)
+        return PM3_ESOFT;
+
+    ctx->lbins.count = 0;
+    int res = sma_run(ctx, work_left, 1ULL << (35 - SMA_LEFT_UNIT_BITS), "left states");
+    if (res != PM3_SUCCESS)
+        return res;
+
+    // the highest bin first
+    qsort(ctx->lbins.items, ctx->lbins.count, sizeof(uint64_t), cmp_key_desc);
+    PrintAndLogEx(INFO, "Found a total of " _YELLOW_("%zu") " left cipher states, recovering left candidates...", ctx->lbins.count);
+    if (ctx->lbins.count == 0)
+        return PM3_ESOFT;
+
+    ctx->lcand.count = 0;
+    res = sma_run(ctx, work_left_gc, ctx->lbins.count, "left candidates");
+    if (res != PM3_SUCCESS)
+        return res;
+
+    PrintAndLogEx(INFO, "The meet-in-the-middle attack returned " _YELLOW_("%zu") " left cipher candidates", ctx->lcand.count);
+    if (ctx->lcand.count == 0)
+        return PM3_ESOFT;
+
+    ctx->gc.count = 0;
+    res = sma_run(ctx, work_combine, ctx->lcand.count, "combining");
+    if (res != PM3_SUCCESS)
+        return res;
+
+    PrintAndLogEx(INFO, "Found a total of " _YELLOW_("%" PRIu64) " combinations, but only " _GREEN_("%zu") " were valid!"
+                  , (uint64_t)ctx->lcand.count * ctx->rcand.count, ctx->gc.count);
+
+    res = sma_run(ctx, work_compare, (ctx->gc.count + SMA_COMPARE_UNIT - 1) / SMA_COMPARE_UNIT, "testing");
+    if (res != PM3_SUCCESS)
+        return res;
+
+    if (ctx->found == false) {
+        PrintAndLogEx(INFO, _RED_("Could not find key using this right cipher state."));
+        return PM3_ESOFT;
+    }
+    return PM3_SUCCESS;
+}
+
+int sma_recover_key(const uint8_t *Ci, const uint8_t *Q, const uint8_t *Ch, const uint8_t *Ci_1, uint64_t *key) {
+
+    sma_ctx_t *ctx = calloc(1, sizeof(sma_ctx_t));
+    if (ctx == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+
+    memcpy(ctx->Ci, Ci, 8);
+    memcpy(ctx->Q, Q, 8);
+    memcpy(ctx->Ch, Ch, 8);
+    memcpy(ctx->Ci_1, Ci_1, 8);
+    for (uint8_t pos = 0; pos < 8; pos++) {
+        ctx->ks[2 * pos] = Ci_1[pos];
+        ctx->ks[(2 * pos) + 1] = Ch[pos];
+    }
+    PrintAndLogEx(INFO, "  Ks: %s", sprint_hex_inrow(ctx->ks, 16));
+
+    init_lookup_tables();
+
+    // Load in the ci (tag-nonce), together with the first half of Q (reader-nonce)
+    for (uint8_t pos = 0; pos < 4; pos++) {
+        next_right_fast(Ci[2 * pos], &ctx->rstate_before_gc);
+        next_right_fast(Ci[2 * pos + 1], &ctx->rstate_before_gc);
+        next_right_fast(Q[pos], &ctx->rstate_before_gc);
+
+        next_left_fast(Ci[2 * pos], &ctx->lstate_before_gc);
+        next_left_fast(Ci[2 * pos + 1], &ctx->lstate_before_gc);
+        next_left_fast(Q[pos], &ctx->lstate_before_gc);
+    }
+
+    int res = PM3_SUCCESS;
+    ctx->rmatch = build_matchbox(ctx->rstate_before_gc, Q, true, &ctx->rmatch_count);
+    ctx->lmatch = build_matchbox(ctx->lstate_before_gc, Q, false, &ctx->lmatch_count);
+    if (ctx->rmatch == NULL || ctx->lmatch == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        res = PM3_EMALLOC;
+        goto out;
+    }
+
+    pthread_mutex_init(&ctx->lock, NULL);
+    pthread_mutex_init(&ctx->result_lock, NULL);
+    pthread_cond_init(&ctx->wake, NULL);
+
+    int num_threads = MIN(num_CPUs(), SMA_MAX_THREADS);
+    for (; ctx->num_threads < num_threads; ctx->num_threads++) {
+        if (pthread_create(&ctx->threads[ctx->num_threads], NULL, sma_worker, ctx) != 0)
+            break;
+    }
+    if (ctx->num_threads == 0) {
+        PrintAndLogEx(WARNING, "Failed to start threads");
+        res = PM3_ESOFT;
+        goto out_pool;
+    }
+
+    PrintAndLogEx(INFO, "Multithreaded, will use " _YELLOW_("%d") " threads", ctx->num_threads);
+    PrintAndLogEx(INFO, "press " _YELLOW_("`enter`") " to cancel");
+
+    uint64_t t1 = msclock();
+    res = sma_run(ctx, work_right, 1ULL << (25 - SMA_RIGHT_UNIT_BITS), "right states");
+    if (res != PM3_SUCCESS)
+        goto out_pool;
+
+    // the highest bin first
+    qsort(ctx->rbins.items, ctx->rbins.count, sizeof(uint64_t), cmp_key_desc);
+
+    PrintAndLogEx(INFO, "Top-bin for the right state contains " _GREEN_("%u") " correct bits", ctx->topbits);
+    PrintAndLogEx(INFO, "Total count of right bins: " _YELLOW_("%zu"), ctx->rbins.count);
+    if (ctx->topbits < SMA_RIGHT_WARN_BITS) {
+        PrintAndLogEx(WARNING, "Better find another trace, the right top-bin is < %u bits", SMA_RIGHT_WARN_BITS);
+    }
+
+    res = PM3_ESOFT;
+    for (size_t i = 0; i < ctx->rbins.count; i++) {
+        res = sma_try_right_state(ctx, ctx->rbins.items[i] & 0x1ffffffULL);
+        if (res == PM3_SUCCESS || res == PM3_EOPABORTED || res == PM3_EMALLOC)
+            break;
+    }
+
+    if (res == PM3_SUCCESS)
+        *key = ctx->key;
+
+    PrintAndLogEx(INFO, "time in recovery: %" PRIu64 " seconds", (msclock() - t1) / 1000);
+
+out_pool:
+    pthread_mutex_lock(&ctx->lock);
+    ctx->quit = true;
+    pthread_cond_broadcast(&ctx->wake);
+    pthread_mutex_unlock(&ctx->lock);
+    for (int i = 0; i < ctx->num_threads; i++) {
+        pthread_join(ctx->threads[i], NULL);
+    }
+    pthread_cond_destroy(&ctx->wake);
+    pthread_mutex_destroy(&ctx->result_lock);
+    pthread_mutex_destroy(&ctx->lock);
+
+out:
+    free(ctx->rmatch);
+    free(ctx->lmatch);
+    keys_free(&ctx->rbins);
+    keys_free(&ctx->lbins);
+    keys_free(&ctx->gc);
+    states_free(&ctx->rcand);
+    states_free(&ctx->lcand);
+    free(ctx);
+    return res;
+}
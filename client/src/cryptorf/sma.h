@@ -0,0 +1,20 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// SecureMemory key recovery from one authentication, in process version of
+// tools/cryptorf/sma_multi
+//-----------------------------------------------------------------------------
+
+#ifndef SMA_H__
+#define SMA_H__
+
+#include "common.h"
+
+// Recovers the 64 bit Gc of a SecureMemory tag from one authentication, tag nonce Ci, reader nonce Q,
+// reader challenge Ch and tag answer Ci+1 (8 bytes each). Runs on all cores, prints progress and
+// stops on enter with PM3_EOPABORTED. PM3_ESOFT when the trace doesn't give the key
+int sma_recover_key(const uint8_t *Ci, const uint8_t *Q, const uint8_t *Ch, const uint8_t *Ci_1, uint64_t *key);
+
+#endif
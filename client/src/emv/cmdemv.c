@@ -27,6 +27,7 @@
 #include "ui.h"
 #include "emv_tags.h"
 #include "fileutils.h"
+#include "util_posix.h"  // msclock
 
 static int CmdHelp(const char *Cmd);
 
@@ -778,6 +779,52 @@ static void ProcessACResponseFormat1(struct tlvdb *tlvRoot, uint8_t *buf, size_t
     }
 }
 
+// Application Selection, the PPSE, or the AID list when there is none or when forced
+// https://www.openscdp.org/scripts/tutorial/emv/applicationselection.html
+static int EMVSelectCardApplication(EMVCommandChannel channel, bool activateField, bool forceSearch, bool showAPDU, bool decodeTLV, struct tlvdb *tlvSelect, uint8_t *AID, size_t *AIDlen) {
+    uint8_t psenum = (channel == ECC_CONTACT) ? 1 : 2;
+    int res;
+
+    if (!forceSearch) {
+        // PPSE
+        PrintAndLogEx(NORMAL, "\n* PPSE.");
+        SetAPDULogging(showAPDU);
+        res = EMVSearchPSE(channel, activateField, true, psenum, decodeTLV, tlvSelect);
+
+        // check PPSE instead of PSE and vice versa
+        if (res) {
+            PrintAndLogEx(NORMAL, "Check PPSE instead of PSE and vice versa...");
+            res = EMVSearchPSE(channel, false, true, psenum == 1 ? 2 : 1, decodeTLV, tlvSelect);
+        }
+
+        // check PPSE and select application id
+        if (!res) {
+            TLVPrintAIDlistFromSelectTLV(tlvSelect);
+            EMVSelectApplication(tlvSelect, AID, AIDlen);
+        }
+    }
+
+    // Search
+    if (!*AIDlen) {
+        PrintAndLogEx(NORMAL, "\n* Search AID in list.");
+        SetAPDULogging(false);
+        if (EMVSearch(channel, activateField, true, decodeTLV, tlvSelect)) {
+            return PM3_ERFTRANS;
+        }
+
+        // check search and select application id
+        TLVPrintAIDlistFromSelectTLV(tlvSelect);
+        EMVSelectApplication(tlvSelect, AID, AIDlen);
+    }
+
+    // check if we found EMV application on card
+    if (!*AIDlen) {
+        PrintAndLogEx(WARNING, "Can't select AID. EMV AID not found");
+        return PM3_ERFTRANS;
+    }
+    return PM3_SUCCESS;
+}
+
 static int CmdEMVExec(const char *Cmd) {
     uint8_t buf[APDU_RES_LEN] = {0};
     size_t len = 0;
@@ -836,7 +883,6 @@ static int CmdEMVExec(const char *Cmd) {
     if (arg_get_lit(ctx, 11))
         channel = ECC_CONTACT;
     PrintChannel(channel);
-    uint8_t psenum = (channel == ECC_CONTACT) ? 1 : 2;
     CLIParserFree(ctx);
 
     if (!IfPm3Smartcard()) {
@@ -852,50 +898,14 @@ static int CmdEMVExec(const char *Cmd) {
     const char *al = "Applets list";
     tlvSelect = tlvdb_fixed(1, strlen(al), (const unsigned char *)al);
 
-    // Application Selection
-    // https://www.openscdp.org/scripts/tutorial/emv/applicationselection.html
-    if (!forceSearch) {
-        // PPSE
-        PrintAndLogEx(NORMAL, "\n* PPSE.");
-        SetAPDULogging(showAPDU);
-        res = EMVSearchPSE(channel, activateField, true, psenum, decodeTLV, tlvSelect);
-
-        // check PPSE instead of PSE and vice versa
-        if (res) {
-            PrintAndLogEx(NORMAL, "Check PPSE instead of PSE and vice versa...");
-            res = EMVSearchPSE(channel, false, true, psenum == 1 ? 2 : 1, decodeTLV, tlvSelect);
-        }
-
-        // check PPSE and select application id
-        if (!res) {
-            TLVPrintAIDlistFromSelectTLV(tlvSelect);
-            EMVSelectApplication(tlvSelect, AID, &AIDlen);
-        }
-    }
-
-    // Search
-    if (!AIDlen) {
-        PrintAndLogEx(NORMAL, "\n* Search AID in list.");
-        SetAPDULogging(false);
-        if (EMVSearch(channel, activateField, true, decodeTLV, tlvSelect)) {
-            dreturn(PM3_ERFTRANS);
-        }
-
-        // check search and select application id
-        TLVPrintAIDlistFromSelectTLV(tlvSelect);
-        EMVSelectApplication(tlvSelect, AID, &AIDlen);
+    if (EMVSelectCardApplication(channel, activateField, forceSearch, showAPDU, decodeTLV, tlvSelect, AID, &AIDlen)) {
+        dreturn(PM3_ERFTRANS);
     }
 
     // Init TLV tree
     const char *alr = "Root terminal TLV tree";
     tlvRoot = tlvdb_fixed(1, strlen(alr), (const unsigned char *)alr);
 
-    // check if we found EMV application on card
-    if (!AIDlen) {
-        PrintAndLogEx(WARNING, "Can't select AID. EMV AID not found");
-        dreturn(PM3_ERFTRANS);
-    }
-
     // Select
     PrintAndLogEx(NORMAL, "\n* Selecting AID:%s", sprint_hex_inrow(AID, AIDlen));
     SetAPDULogging(showAPDU);
@@ -1375,6 +1385,505 @@ static int CmdEMVExec(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+//-----------------------------------------------------------------------------
+// emv batch
+//
+// One card session for all the transactions. The terminal parameters are set
+// up once, the DOLs are parsed once and filled for each transaction, and the
+// READ RECORD answers of the first transaction are reused by the next ones
+// as long as the card gives the same AFL.
+//-----------------------------------------------------------------------------
+typedef struct {
+    EMVCommandChannel channel;
+    enum TransactionType TrType;
+    bool readRecords;       // in every transaction
+    uint8_t AID[APDU_AID_LEN];
+    size_t AIDlen;
+    uint8_t *params;        // terminal parameters, TLV encoded
+    size_t params_len;
+    uint8_t *afl;           // the records are cached for
+    size_t afl_len;
+    uint8_t *records;       // READ RECORD answers, one after the other
+    size_t records_len;
+    struct dol_layout *pdol;
+    struct dol_layout *cdol1;
+    struct dol_layout *udol;
+} emv_batch_t;
+
+typedef struct {
+    uint32_t n;
+    uint64_t amount;
+    int res;
+    uint16_t sw;
+    bool selected;
+    bool records_cached;
+    uint8_t cid;
+    uint16_t atc;
+    uint8_t ac[8];
+    size_t ac_len;
+    uint32_t ms_select;
+    uint32_t ms_gpo;
+    uint32_t ms_records;
+    uint32_t ms_ac;
+    uint32_t ms_total;
+} emv_batch_result_t;
+
+static bool emv_batch_append(uint8_t **buf, size_t *len, const uint8_t *data, size_t datalen) {
+    uint8_t *tmp = realloc(*buf, *len + datalen);
+    if (tmp == NULL)
+        return false;
+    memcpy(tmp + *len, data, datalen);
+    *buf = tmp;
+    *len += datalen;
+    return true;
+}
+
+static void emv_batch_params_cb(void *data, const struct tlv *tlv, int level, bool is_leaf) {
+    emv_batch_t *b = (emv_batch_t *)data;
+    // the tree names
+    if (is_leaf == false || tlv->tag == 0x01)
+        return;
+
+    size_t len = 0;
+    unsigned char *enc = tlv_encode(tlv, &len);
+    if (enc) {
+        emv_batch_append(&b->params, &b->params_len, enc, len);
+        free(enc);
+    }
+}
+
+// the layout for the DOL, made again when the card sends another one
+static const struct tlv *emv_batch_dol(struct dol_layout **layout, const struct tlv *dol, tlv_tag_t tag, struct tlvdb *tlvRoot) {
+    if (*layout == NULL || dol_layout_is(*layout, dol) == false) {
+        dol_layout_free(*layout);
+        *layout = dol_layout_new(dol, tag);
+        if (*layout == NULL)
+            return NULL;
+    }
+    return dol_layout_fill(*layout, tlvRoot);
+}
+
+static void emv_batch_amount(struct tlvdb *tlvRoot, uint64_t amount) {
+    // 9F02:(Amount, authorized (Numeric)) len:6
+    uint8_t bcd[6] = {0};
+    for (int i = sizeof(bcd) - 1; i >= 0 && amount; i--) {
+        bcd[i] = (amount % 10) | (((amount / 10) % 10) << 4);
+        amount /= 100;
+    }
+    tlvdb_change_or_add_node(tlvRoot, 0x9f02, sizeof(bcd), bcd);
+}
+
+static int emv_batch_read_records(emv_batch_t *b, const struct tlv *AFL, struct tlvdb *tlvRoot) {
+    uint8_t buf[APDU_RES_LEN] = {0};
+    size_t len = 0;
+    uint16_t sw = 0;
+
+    if (AFL->len % 4) {
+        PrintAndLogEx(WARNING, "Warning: Wrong AFL length: %zu", AFL->len);
+        return PM3_ESOFT;
+    }
+
+    free(b->records);
+    b->records = NULL;
+    b->records_len = 0;
+    b->afl_len = 0;
+
+    bool complete = true;
+    for (int i = 0; i < AFL->len / 4; i++) {
+        uint8_t SFI = AFL->value[i * 4 + 0] >> 3;
+        uint8_t SFIstart = AFL->value[i * 4 + 1];
+        uint8_t SFIend = AFL->value[i * 4 + 2];
+
+        if (SFI == 0 || SFI == 31 || SFIstart == 0 || SFIstart > SFIend) {
+            PrintAndLogEx(WARNING, "SFI[%02x] start:%02x end:%02x ERROR! Skipped...", SFI, SFIstart, SFIend);
+            continue;
+        }
+
+        for (int n = SFIstart; n <= SFIend; n++) {
+            int res = EMVReadRecord(b->channel, true, SFI, n, buf, sizeof(buf), &len, &sw, tlvRoot);
+            if (res) {
+                PrintAndLogEx(WARNING, "Error SFI[%02x]. APDU error %4x", SFI, sw);
+                complete = false;
+                continue;
+            }
+            complete &= emv_batch_append(&b->records, &b->records_len, buf, len);
+        }
+    }
+
+    // only a full set of records is cached
+    if (complete && b->records_len) {
+        uint8_t *afl = realloc(b->afl, AFL->len);
+        if (afl) {
+            memcpy(afl, AFL->value, AFL->len);
+            b->afl = afl;
+            b->afl_len = AFL->len;
+        }
+    }
+    return PM3_SUCCESS;
+}
+
+static int emv_batch_transaction(emv_batch_t *b, uint32_t n, uint64_t amount, emv_batch_result_t *r) {
+    uint8_t buf[APDU_RES_LEN] = {0};
+    size_t len = 0;
+    uint16_t sw = 0;
+    int res;
+
+    memset(r, 0, sizeof(emv_batch_result_t));
+    r->n = n;
+    r->amount = amount;
+
+    uint64_t t0 = msclock();
+    uint64_t t = t0;
+
+    const char *alr = "Root terminal TLV tree";
+    struct tlvdb *tlvRoot = tlvdb_fixed(1, strlen(alr), (const unsigned char *)alr);
+    tlvdb_add(tlvRoot, tlvdb_parse_multi(b->params, b->params_len));
+
+    // what changes from one transaction to the next
+    emv_batch_amount(tlvRoot, amount);
+    // 9F37 Unpredictable Number len:4
+    uint8_t un[4];
+    for (int i = 0; i < sizeof(un); i++)
+        un[i] = rand() & 0xFF;
+    tlvdb_change_or_add_node(tlvRoot, 0x9f37, sizeof(un), un);
+
+    // a new transaction starts with the selection of the application
+    res = EMVSelect(b->channel, false, true, b->AID, b->AIDlen, buf, sizeof(buf), &len, &sw, tlvRoot);
+    r->ms_select = msclock() - t;
+    if (res) {
+        res = PM3_ERFTRANS;
+        goto out;
+    }
+    r->selected = true;
+
+    // GPO
+    t = msclock();
+    const struct tlv *pdol_data_tlv = emv_batch_dol(&b->pdol, tlvdb_get(tlvRoot, 0x9f38, NULL), 0x83, tlvRoot);
+    if (!pdol_data_tlv) {
+        PrintAndLogEx(ERR, "Error: can't create PDOL TLV.");
+        res = PM3_ESOFT;
+        goto out;
+    }
+
+    size_t pdol_data_tlv_data_len;
+    unsigned char *pdol_data_tlv_data = tlv_encode(pdol_data_tlv, &pdol_data_tlv_data_len);
+    if (!pdol_data_tlv_data) {
+        PrintAndLogEx(ERR, "Error: can't create PDOL data.");
+        res = PM3_ESOFT;
+        goto out;
+    }
+
+    res = EMVGPO(b->channel, true, pdol_data_tlv_data, pdol_data_tlv_data_len, buf, sizeof(buf), &len, &sw, tlvRoot);
+    free(pdol_data_tlv_data);
+    r->ms_gpo = msclock() - t;
+    if (res) {
+        res = PM3_ERFTRANS;
+        goto out;
+    }
+
+    // process response template format 1 [id:80  2b AIP + x4b AFL] and format 2 [id:77 TLV]
+    ProcessGPOResponseFormat1(tlvRoot, buf, len, false);
+
+    // records, the ones of the last transaction when the AFL is the same
+    t = msclock();
+    const struct tlv *AFL = tlvdb_get(tlvRoot, 0x94, NULL);
+    if (AFL && AFL->len) {
+        if (b->readRecords == false && b->afl_len == AFL->len && memcmp(b->afl, AFL->value, AFL->len) == 0) {
+            tlvdb_add(tlvRoot, tlvdb_parse_multi(b->records, b->records_len));
+            r->records_cached = true;
+        } else {
+            res = emv_batch_read_records(b, AFL, tlvRoot);
+            if (res)
+                goto out;
+        }
+    }
+    r->ms_records = msclock() - t;
+
+    // the cryptogram
+    t = msclock();
+    enum CardPSVendor vendor = GetCardPSVendor(b->AID, b->AIDlen);
+    if ((b->TrType == TT_QVSDCMCHIP || b->TrType == TT_CDA) && tlvdb_get(tlvRoot, 0x9f26, NULL)) {
+        // qVSDC, the AC came with the GPO
+    } else if (b->TrType == TT_MSD) {
+        if (vendor == CV_MASTERCARD) {
+            // UDOL(9F69) default: 9F6A (Unpredictable number) 4 bytes
+            const struct tlv defUDOL = {
+                .tag = 0x01,
+                .len = 3,
+                .value = (uint8_t *)"\x9f\x6a\x04",
+            };
+            const struct tlv *UDOL = tlvdb_get(tlvRoot, 0x9f69, NULL);
+            const struct tlv *udol_data_tlv = emv_batch_dol(&b->udol, UDOL ? UDOL : &defUDOL, 0x01, tlvRoot);
+            if (!udol_data_tlv) {
+                PrintAndLogEx(ERR, "Error: can't create UDOL TLV.");
+                res = PM3_ESOFT;
+                goto out;
+            }
+            res = MSCComputeCryptoChecksum(b->channel, true, (uint8_t *)udol_data_tlv->value, udol_data_tlv->len, buf, sizeof(buf), &len, &sw, tlvRoot);
+        }
+    } else {
+        const struct tlv *CDOL1 = tlvdb_get(tlvRoot, 0x8c, NULL);
+        if (!CDOL1) {
+            PrintAndLogEx(ERR, "Error: CDOL1(8C) not found.");
+            res = PM3_ESOFT;
+            goto out;
+        }
+
+        // M/Chip, ICC Dynamic Number
+        if (vendor == CV_MASTERCARD) {
+            res = EMVGenerateChallenge(b->channel, true, buf, sizeof(buf), &len, &sw, tlvRoot);
+            if (res == 0 && len >= 4)
+                tlvdb_change_or_add_node(tlvRoot, 0x9f4c, len, buf);
+        }
+
+        const struct tlv *cdol_data_tlv = emv_batch_dol(&b->cdol1, CDOL1, 0x01, tlvRoot); // 0x01 - dummy tag
+        if (!cdol_data_tlv) {
+            PrintAndLogEx(ERR, "Error: can't create CDOL1 TLV.");
+            res = PM3_ESOFT;
+            goto out;
+        }
+
+        // EMVAC_TC + EMVAC_CDAREQ --- to get SDAD
+        res = EMVAC(b->channel, true, (b->TrType == TT_CDA) ? EMVAC_TC + EMVAC_CDAREQ : EMVAC_TC, (uint8_t *)cdol_data_tlv->value, cdol_data_tlv->len, buf, sizeof(buf), &len, &sw, tlvRoot);
+        if (res == 0)
+            ProcessACResponseFormat1(tlvRoot, buf, len, false);
+    }
+    r->ms_ac = msclock() - t;
+    if (res) {
+        res = PM3_ERFTRANS;
+        goto out;
+    }
+
+    tlvdb_get_uint8(tlvRoot, 0x9f27, &r->cid);
+    const struct tlv *ATC = tlvdb_get(tlvRoot, 0x9f36, NULL);
+    if (ATC && ATC->len == 2)
+        r->atc = (ATC->value[0] << 8) | ATC->value[1];
+    const struct tlv *AC = tlvdb_get(tlvRoot, 0x9f26, NULL);
+    if (AC) {
+        r->ac_len = MIN(AC->len, sizeof(r->ac));
+        memcpy(r->ac, AC->value, r->ac_len);
+    }
+
+out:
+    r->res = res;
+    r->sw = sw;
+    r->ms_total = msclock() - t0;
+    tlvdb_free(tlvRoot);
+    return res;
+}
+
+static void emv_batch_free(emv_batch_t *b) {
+    free(b->params);
+    free(b->afl);
+    free(b->records);
+    dol_layout_free(b->pdol);
+    dol_layout_free(b->cdol1);
+    dol_layout_free(b->udol);
+}
+
+static json_t *emv_batch_json(const emv_batch_result_t *r) {
+    json_t *elm = json_object();
+    JsonSaveInt(elm, "$.Transaction", r->n);
+    JsonSaveInt(elm, "$.Amount", r->amount);
+    JsonSaveBoolean(elm, "$.Success", r->res == PM3_SUCCESS);
+    JsonSaveHex(elm, "$.SW", r->sw, 2);
+    JsonSaveHex(elm, "$.ATC", r->atc, 2);
+    JsonSaveHex(elm, "$.CID", r->cid, 1);
+    JsonSaveBufAsHexCompact(elm, "$.AC", (uint8_t *)r->ac, r->ac_len);
+    JsonSaveBoolean(elm, "$.RecordsCached", r->records_cached);
+    JsonSaveInt(elm, "$.Time.Select", r->ms_select);
+    JsonSaveInt(elm, "$.Time.GPO", r->ms_gpo);
+    JsonSaveInt(elm, "$.Time.Records", r->ms_records);
+    JsonSaveInt(elm, "$.Time.AC", r->ms_ac);
+    JsonSaveInt(elm, "$.Time.Total", r->ms_total);
+    return elm;
+}
+
+static int CmdEMVBatch(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "emv batch",
+                  "Executes EMV contactless transactions one after the other, in one card session.\n"
+                  "The terminal parameters and the DOLs are set up once, the records of the first transaction are reused while the AFL stays the same.\n"
+                  "Each transaction has its own unpredictable number, the amount is changed by the step.",
+                  "Usage:\n"
+                  "\temv batch -n 1000 -> 1000 MSD transactions\n"
+                  "\temv batch -vn 100 --amount 100 --step 5 results.json -> 100 qVSDC / M/Chip transactions from 1.00 by 0.05, results saved in results.json\n");
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_lit0("aA",  "apdu",     "show APDU reqests and responses."),
+        arg_lit0("jJ",  "jload",    "Load transaction parameters from `emv_defparams.json` file."),
+        arg_lit0("fF",  "forceaid", "Force search AID. Search AID instead of execute PPSE."),
+        arg_rem("By default:",      "Transaction type - MSD"),
+        arg_lit0("vV",  "qvsdc",    "Transaction type - qVSDC or M/Chip."),
+        arg_lit0("cC",  "qvsdccda", "Transaction type - qVSDC or M/Chip plus CDA (SDAD generation)."),
+        arg_lit0("xX",  "vsdc",     "Transaction type - VSDC. For test only. Not a standard behavior."),
+        arg_lit0("gG",  "acgpo",    "VISA. generate AC from GPO."),
+        arg_lit0("wW",  "wired",    "Send data via contact (iso7816) interface. Contactless interface set by default."),
+        arg_int0("nN",  "count",    "<dec>", "transactions to execute (default 10)"),
+        arg_int0(NULL,  "amount",   "<dec>", "amount authorized of the first transaction (default 100)"),
+        arg_int0(NULL,  "step",     "<dec>", "added to the amount for each transaction (default 0)"),
+        arg_lit0("rR",  "records",  "read the records in every transaction."),
+        arg_str0(NULL,  NULL,       "output.json", "JSON output file name for the results"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+
+    bool showAPDU = arg_get_lit(ctx, 1);
+    bool paramLoadJSON = arg_get_lit(ctx, 2);
+    bool forceSearch = arg_get_lit(ctx, 3);
+
+    enum TransactionType TrType = TT_MSD;
+    if (arg_get_lit(ctx, 5))
+        TrType = TT_QVSDCMCHIP;
+    if (arg_get_lit(ctx, 6))
+        TrType = TT_CDA;
+    if (arg_get_lit(ctx, 7))
+        TrType = TT_VSDC;
+
+    bool GenACGPO = arg_get_lit(ctx, 8);
+    EMVCommandChannel channel = ECC_CONTACTLESS;
+    if (arg_get_lit(ctx, 9))
+        channel = ECC_CONTACT;
+
+    int count = arg_get_int_def(ctx, 10, 10);
+    int amount = arg_get_int_def(ctx, 11, 100);
+    int step = arg_get_int_def(ctx, 12, 0);
+    bool readRecords = arg_get_lit(ctx, 13);
+
+    uint8_t filename[FILE_PATH_SIZE] = {0};
+    int filenamelen = 0;
+    CLIGetStrWithReturn(ctx, 14, filename, &filenamelen);
+    CLIParserFree(ctx);
+
+    if (count < 1 || amount < 0 || step < 0) {
+        PrintAndLogEx(ERR, "count must be 1 or more, amount and step can't be negative.");
+        return PM3_EINVARG;
+    }
+
+    PrintChannel(channel);
+    if (!IfPm3Smartcard()) {
+        if (channel == ECC_CONTACT) {
+            PrintAndLogEx(WARNING, "PM3 does not have SMARTCARD support. Exiting.");
+            return PM3_EDEVNOTSUPP;
+        }
+    }
+
+    emv_batch_t b;
+    memset(&b, 0, sizeof(b));
+    b.channel = channel;
+    b.TrType = TrType;
+    b.readRecords = readRecords;
+
+    SetAPDULogging(showAPDU);
+
+    // init applets list tree
+    const char *al = "Applets list";
+    struct tlvdb *tlvSelect = tlvdb_fixed(1, strlen(al), (const unsigned char *)al);
+    int res = EMVSelectCardApplication(channel, true, forceSearch, showAPDU, false, tlvSelect, b.AID, &b.AIDlen);
+    tlvdb_free(tlvSelect);
+    if (res) {
+        DropFieldEx(channel);
+        return PM3_ERFTRANS;
+    }
+    SetAPDULogging(showAPDU);
+
+    // the terminal parameters, once for all the transactions
+    PrintAndLogEx(NORMAL, "\n* Init transaction parameters.");
+    const char *alp = "Terminal parameters";
+    struct tlvdb *tlvParams = tlvdb_fixed(1, strlen(alp), (const unsigned char *)alp);
+    InitTransactionParameters(tlvParams, paramLoadJSON, TrType, GenACGPO);
+    tlvdb_visit(tlvParams, emv_batch_params_cb, &b, 0);
+    tlvdb_free(tlvParams);
+
+    json_t *root = NULL;
+    json_t *transactions = NULL;
+    if (filenamelen) {
+        root = json_object();
+        JsonSaveStr(root, "$.File.Created", "proxmark3 `emv batch`");
+        JsonSaveBufAsHex(root, "$.Application.AID", b.AID, b.AIDlen);
+        JsonSaveStr(root, "$.Application.Mode", TransactionTypeStr[TrType]);
+        transactions = json_array();
+        json_object_set_new(root, "Transactions", transactions);
+    }
+
+    PrintAndLogEx(NORMAL, "\n* %s transactions, AID %s", TransactionTypeStr[TrType], sprint_hex_inrow(b.AID, b.AIDlen));
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "    # |       amount | ATC  | CID | AC               | select |  gpo | records |   ac | total ms");
+    PrintAndLogEx(INFO, "------+--------------+------+-----+------------------+--------+------+---------+------+---------");
+
+    uint32_t done = 0, failed = 0;
+    uint64_t ms_sum = 0;
+    uint32_t ms_min = UINT32_MAX, ms_max = 0;
+
+    for (int i = 0; i < count; i++) {
+        if (kbd_enter_pressed()) {
+            PrintAndLogEx(WARNING, "\naborted via keyboard!\n");
+            break;
+        }
+
+        emv_batch_result_t r;
+        res = emv_batch_transaction(&b, i + 1, (uint64_t)amount + (uint64_t)step * i, &r);
+        if (transactions)
+            json_array_append_new(transactions, emv_batch_json(&r));
+
+        if (res) {
+            failed++;
+            PrintAndLogEx(INFO, "%5u | %12" PRIu64 " | " _RED_("failed, sw %04x - %s"), r.n, r.amount, r.sw, GetAPDUCodeDescription(r.sw >> 8, r.sw & 0xff));
+            // without an answer to the select the card is gone
+            if (r.selected == false)
+                break;
+            continue;
+        }
+
+        done++;
+        ms_sum += r.ms_total;
+        ms_min = MIN(ms_min, r.ms_total);
+        ms_max = MAX(ms_max, r.ms_total);
+        PrintAndLogEx(INFO, "%5u | %12" PRIu64 " | %04x |  %02x | %-16s | %6u | %4u | %7u%s| %4u | %8u",
+                      r.n,
+                      r.amount,
+                      r.atc,
+                      r.cid,
+                      sprint_hex_inrow(r.ac, r.ac_len),
+                      r.ms_select,
+                      r.ms_gpo,
+                      r.ms_records,
+                      r.records_cached ? "c" : " ",
+                      r.ms_ac,
+                      r.ms_total
+                     );
+    }
+
+    DropFieldEx(channel);
+    emv_batch_free(&b);
+
+    PrintAndLogEx(NORMAL, "");
+    if (done)
+        PrintAndLogEx(SUCCESS, "transactions " _GREEN_("%u") " ok, %u failed. total ms min %u, avg %" PRIu64 ", max %u (c: records cached)", done, failed, ms_min, ms_sum / done, ms_max);
+    else
+        PrintAndLogEx(FAILED, "transactions 0 ok, %u failed", failed);
+
+    if (root) {
+        char *fname = newfilenamemcopy((char *)filename, ".json");
+        if (fname == NULL) {
+            json_decref(root);
+            return PM3_EMALLOC;
+        }
+        res = json_dump_file(root, fname, JSON_INDENT(2));
+        json_decref(root);
+        if (res) {
+            PrintAndLogEx(ERR, "Can't save the file: %s", fname);
+            free(fname);
+            return PM3_EFILE;
+        }
+        PrintAndLogEx(SUCCESS, "File " _YELLOW_("`%s`") " saved.", fname);
+        free(fname);
+    }
+
+    return (done) ? PM3_SUCCESS : PM3_ERFTRANS;
+}
+
 static int CmdEMVScan(const char *Cmd) {
     uint8_t AID[APDU_AID_LEN] = {0};
     size_t AIDlen = 0;
@@ -1797,6 +2306,91 @@ static int CmdEMVTest(const char *Cmd) {
     return ExecuteCryptoTests(true, ignoreTimeTest, runSlowTests);
 }
 
+// ROCA audit of a list of moduli, all checked at once on all cores
+static int emv_roca_file(const char *filename) {
+    FILE *f = fopen(filename, "r");
+    if (f == NULL) {
+        PrintAndLogEx(ERR, "Error: can't open file %s.", filename);
+        return PM3_EFILE;
+    }
+
+    size_t count = 0;
+    size_t size = 0;
+    unsigned char **moduli = NULL;
+    size_t *lens = NULL;
+    size_t *lines = NULL;
+    int ret = PM3_SUCCESS;
+
+    char buf[1024];
+    for (size_t line = 1; fgets(buf, sizeof(buf), f); line++) {
+        buf[strcspn(buf, "\r\n")] = 0;
+        if (buf[strspn(buf, " \t")] == 0 || buf[0] == '#')
+            continue;
+
+        uint8_t modulus[512];
+        int mlen = hex_to_bytes(buf, modulus, sizeof(modulus));
+        if (mlen <= 0) {
+            PrintAndLogEx(WARNING, "line %zu: not a hex modulus, skipped", line);
+            continue;
+        }
+
+        if (count == size) {
+            size = (size) ? size * 2 : 256;
+            unsigned char **m = realloc(moduli, size * sizeof(*moduli));
+            if (m)
+                moduli = m;
+            size_t *l = realloc(lens, size * sizeof(*lens));
+            if (l)
+                lens = l;
+            size_t *n = realloc(lines, size * sizeof(*lines));
+            if (n)
+                lines = n;
+            if (m == NULL || l == NULL || n == NULL) {
+                ret = PM3_EMALLOC;
+                goto out;
+            }
+        }
+
+        moduli[count] = malloc(mlen);
+        if (moduli[count] == NULL) {
+            ret = PM3_EMALLOC;
+            goto out;
+        }
+        memcpy(moduli[count], modulus, mlen);
+        lens[count] = mlen;
+        lines[count] = line;
+        count++;
+    }
+
+    bool *results = calloc(MAX(count, 1), sizeof(bool));
+    if (results == NULL) {
+        ret = PM3_EMALLOC;
+        goto out;
+    }
+
+    uint64_t t1 = msclock();
+    size_t found = emv_rocacheck_bulk((const unsigned char *const *)moduli, lens, results, count);
+    t1 = msclock() - t1;
+
+    for (size_t i = 0; i < count; i++) {
+        if (results[i])
+            PrintAndLogEx(WARNING, "line %zu: %zu bits modulus " _RED_("ROCA fingerprint found"), lines[i], lens[i] * 8);
+    }
+    PrintAndLogEx(SUCCESS, "Checked " _YELLOW_("%zu") " moduli in %" PRIu64 " ms, " _YELLOW_("%zu") " with ROCA fingerprint", count, t1, found);
+    free(results);
+
+out:
+    if (ret == PM3_EMALLOC)
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+    fclose(f);
+    for (size_t i = 0; i < count; i++)
+        free(moduli[i]);
+    free(moduli);
+    free(lens);
+    free(lines);
+    return ret;
+}
+
 static int CmdEMVRoca(const char *Cmd) {
     uint8_t AID[APDU_AID_LEN] = {0};
     size_t AIDlen = 0;
@@ -1813,6 +2407,8 @@ static int CmdEMVRoca(const char *Cmd) {
                   "Usage:\n"
                   "\temv roca -w -> select --CONTACT-- card and run test\n"
                   "\temv roca -> select --CONTACTLESS-- card and run test\n"
+                  "\temv roca -f moduli.txt -> test the hex moduli of the file, one per line\n"
+                  "\temv roca --bench 100000 -> benchmark the checker\n"
                  );
 
     void *argtable[] = {
@@ -1820,6 +2416,8 @@ static int CmdEMVRoca(const char *Cmd) {
         arg_lit0("tT",  "selftest",   "self test"),
         arg_lit0("aA",  "apdu",    "show APDU reqests and responses"),
         arg_lit0("wW",  "wired",   "Send data via contact (iso7816) interface. Contactless interface set by default"),
+        arg_str0("fF",  "file",    "<filename>", "test the moduli of a text file, one hex modulus per line"),
+        arg_int0(NULL,  "bench",   "<count>", "benchmark the checker with <count> moduli"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -1829,6 +2427,27 @@ static int CmdEMVRoca(const char *Cmd) {
         return roca_self_test();
     }
 
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 4), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+    if (fnlen) {
+        CLIParserFree(ctx);
+        return emv_roca_file(filename);
+    }
+
+    int bench = arg_get_int_def(ctx, 5, 0);
+    if (bench > 0) {
+        CLIParserFree(ctx);
+        return roca_bench(bench);
+    }
+
+    // the offline checks above work without a device
+    if (IfPm3Iso14443() == false) {
+        PrintAndLogEx(WARNING, "This command is not available in this mode");
+        CLIParserFree(ctx);
+        return PM3_ENOTIMPL;
+    }
+
     bool show_apdu = arg_get_lit(ctx, 2);
 
     EMVCommandChannel channel = ECC_CONTACTLESS;
@@ -2071,6 +2690,7 @@ out:
 static command_t CommandTable[] =  {
     {"help",        CmdHelp,                        AlwaysAvailable, "This help"},
     {"exec",        CmdEMVExec,                     IfPm3Iso14443,   "Executes EMV contactless transaction."},
+    {"batch",       CmdEMVBatch,                    IfPm3Iso14443,   "Executes EMV contactless transactions in one card session, with the time of each."},
     {"pse",         CmdEMVPPSE,                     IfPm3Iso14443,   "Execute PPSE. It selects 2PAY.SYS.DDF01 or 1PAY.SYS.DDF01 directory."},
     {"search",      CmdEMVSearch,                   IfPm3Iso14443,   "Try to select all applets from applets list and print installed applets."},
     {"select",      CmdEMVSelect,                   IfPm3Iso14443,   "Select applet."},
@@ -2089,7 +2709,7 @@ static command_t CommandTable[] =  {
     {"clone",       CmdEmvClone,                    IfPm3Iso14443,   "clone an EMV tag"},
     */
     {"list",        CmdEMVList,                     AlwaysAvailable,   "List ISO7816 history"},
-    {"roca",        CmdEMVRoca,                     IfPm3Iso14443,   "Extract public keys and run ROCA test"},
+    {"roca",        CmdEMVRoca,                     AlwaysAvailable, "Extract public keys and run ROCA test"},
     {NULL, NULL, NULL, NULL}
 };
 
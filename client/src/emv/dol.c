@@ -130,3 +130,87 @@ struct tlvdb *dol_parse(const struct tlv *tlv, const unsigned char *data, size_t
 
     return db;
 }
+
+/* A DOL parsed once, for the transactions that fill it again and again */
+struct dol_layout {
+    size_t count;
+    size_t *lens;
+    tlv_tag_t *tags;
+    size_t dol_len;
+    unsigned char *dol;
+    struct tlv res;
+};
+
+struct dol_layout *dol_layout_new(const struct tlv *tlv, tlv_tag_t tag) {
+    size_t res_len = tlv ? dol_calculate_len(tlv, 0) : 0;
+    size_t dol_len = res_len ? tlv->len : 0;
+
+    /* as many entries as bytes in the DOL at the most */
+    struct dol_layout *layout = calloc(1, sizeof(*layout) + dol_len * (sizeof(size_t) + sizeof(tlv_tag_t)) + dol_len + res_len);
+    if (!layout)
+        return NULL;
+
+    layout->lens = (size_t *)(layout + 1);
+    layout->tags = (tlv_tag_t *)(layout->lens + dol_len);
+    layout->dol = (unsigned char *)(layout->tags + dol_len);
+    layout->dol_len = dol_len;
+    layout->res.tag = tag;
+    layout->res.len = res_len;
+    layout->res.value = res_len ? layout->dol + dol_len : NULL;
+
+    if (!res_len)
+        return layout;
+
+    memcpy(layout->dol, tlv->value, dol_len);
+
+    const unsigned char *buf = tlv->value;
+    size_t left = tlv->len;
+    size_t pos = 0;
+    while (left) {
+        struct tlv cur_tlv;
+        if (!tlv_parse_tl(&buf, &left, &cur_tlv) || pos + cur_tlv.len > res_len) {
+            free(layout);
+            return NULL;
+        }
+
+        layout->tags[layout->count] = cur_tlv.tag;
+        layout->lens[layout->count] = cur_tlv.len;
+        layout->count++;
+        pos += cur_tlv.len;
+    }
+
+    return layout;
+}
+
+bool dol_layout_is(const struct dol_layout *layout, const struct tlv *tlv) {
+    if (!tlv || !dol_calculate_len(tlv, 0))
+        return layout->dol_len == 0;
+
+    return layout->dol_len == tlv->len && !memcmp(layout->dol, tlv->value, tlv->len);
+}
+
+/* The same data as dol_process() would give, owned by the layout */
+const struct tlv *dol_layout_fill(struct dol_layout *layout, const struct tlvdb *tlvdb) {
+    unsigned char *res = (unsigned char *)layout->res.value;
+    size_t pos = 0;
+
+    for (size_t i = 0; i < layout->count; i++) {
+        size_t len = layout->lens[i];
+        const struct tlv *tag_tlv = tlvdb_get(tlvdb, layout->tags[i], NULL);
+        if (!tag_tlv) {
+            memset(res + pos, 0, len);
+        } else if (tag_tlv->len > len) {
+            memcpy(res + pos, tag_tlv->value, len);
+        } else {
+            memcpy(res + pos, tag_tlv->value, tag_tlv->len);
+            memset(res + pos + tag_tlv->len, 0, len - tag_tlv->len);
+        }
+        pos += len;
+    }
+
+    return &layout->res;
+}
+
+void dol_layout_free(struct dol_layout *layout) {
+    free(layout);
+}
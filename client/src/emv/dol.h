@@ -21,4 +21,10 @@
 struct tlv *dol_process(const struct tlv *tlv, const struct tlvdb *tlvdb, tlv_tag_t tag);
 struct tlvdb *dol_parse(const struct tlv *tlv, const unsigned char *data, size_t data_len);
 
+struct dol_layout;
+struct dol_layout *dol_layout_new(const struct tlv *tlv, tlv_tag_t tag);
+bool dol_layout_is(const struct dol_layout *layout, const struct tlv *tlv);
+const struct tlv *dol_layout_fill(struct dol_layout *layout, const struct tlvdb *tlvdb);
+void dol_layout_free(struct dol_layout *layout);
+
 #endif
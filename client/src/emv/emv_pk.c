@@ -399,19 +399,37 @@ void emv_pk_free(struct emv_pk *pk) {
     free(pk);
 }
 
-static struct emv_pk *emv_pk_get_ca_pk_from_file(const char *fname,
-                                                 const unsigned char *rid,
-                                                 unsigned char idx) {
-    if (!fname)
-        return NULL;
+// capk.txt is parsed once per client run into a list sorted by RID and index, a lookup copies
+// the key out of it
+typedef struct {
+    struct emv_pk *pk;
+    size_t line;
+} emv_ca_pk_t;
+
+static emv_ca_pk_t *ca_pks = NULL;
+static size_t ca_pks_len = 0;
+
+static int emv_ca_pk_cmp(const void *a, const void *b) {
+    const emv_ca_pk_t *pa = a;
+    const emv_ca_pk_t *pb = b;
+    int res = memcmp(pa->pk->rid, pb->pk->rid, 5);
+    if (res)
+        return res;
+    if (pa->pk->index != pb->pk->index)
+        return (pa->pk->index < pb->pk->index) ? -1 : 1;
+    // the first key of the file wins, like the old line by line search
+    return (pa->line > pb->line) - (pa->line < pb->line);
+}
 
+static bool emv_pk_load_ca_pks(const char *fname) {
     FILE *f = fopen(fname, "r");
     if (!f) {
         PrintAndLogEx(ERR, "Error: can't open file %s.", fname);
-        return NULL;
+        return false;
     }
 
-    while (!feof(f)) {
+    size_t size = 0;
+    for (size_t line = 0; !feof(f); line++) {
         char buf[2048];
         if (fgets(buf, sizeof(buf), f) == NULL)
             break;
@@ -420,17 +438,56 @@ static struct emv_pk *emv_pk_get_ca_pk_from_file(const char *fname,
         if (!pk)
             continue;
 
-        if (memcmp(pk->rid, rid, 5) || pk->index != idx) {
-            emv_pk_free(pk);
-            continue;
+        if (ca_pks_len == size) {
+            size = (size) ? size * 2 : 64;
+            emv_ca_pk_t *tmp = realloc(ca_pks, size * sizeof(emv_ca_pk_t));
+            if (!tmp) {
+                emv_pk_free(pk);
+                break;
+            }
+            ca_pks = tmp;
         }
+        ca_pks[ca_pks_len].pk = pk;
+        ca_pks[ca_pks_len].line = line;
+        ca_pks_len++;
+    }
+    fclose(f);
 
-        fclose(f);
-        return pk;
+    qsort(ca_pks, ca_pks_len, sizeof(emv_ca_pk_t), emv_ca_pk_cmp);
+    return true;
+}
+
+static struct emv_pk *emv_pk_copy(const struct emv_pk *pk) {
+    struct emv_pk *r = calloc(1, sizeof(*r));
+    if (!r)
+        return NULL;
+
+    memcpy(r, pk, sizeof(*r));
+    r->modulus = malloc(pk->mlen);
+    if (!r->modulus) {
+        free(r);
+        return NULL;
     }
+    memcpy(r->modulus, pk->modulus, pk->mlen);
+    return r;
+}
 
-    fclose(f);
-    return NULL;
+static struct emv_pk *emv_pk_get_ca_pk_from_list(const unsigned char *rid, unsigned char idx) {
+    size_t lo = 0;
+    size_t hi = ca_pks_len;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int res = memcmp(ca_pks[mid].pk->rid, rid, 5);
+        if (res < 0 || (res == 0 && ca_pks[mid].pk->index < idx))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo == ca_pks_len || memcmp(ca_pks[lo].pk->rid, rid, 5) || ca_pks[lo].pk->index != idx)
+        return NULL;
+
+    return emv_pk_copy(ca_pks[lo].pk);
 }
 
 char *emv_pk_get_ca_pk_file(const char *dirname, const unsigned char *rid, unsigned char idx) {
@@ -491,12 +548,16 @@ struct emv_pk *emv_pk_get_ca_pk(const unsigned char *rid, unsigned char idx) {
             }
         }
     */
-    char *path;
-    if (searchFile(&path, RESOURCES_SUBDIR, "capk", ".txt", false) != PM3_SUCCESS) {
-        return NULL;
+    static bool loaded = false;
+    if (loaded == false) {
+        char *path;
+        if (searchFile(&path, RESOURCES_SUBDIR, "capk", ".txt", false) != PM3_SUCCESS) {
+            return NULL;
+        }
+        loaded = emv_pk_load_ca_pks(path);
+        free(path);
     }
-    pk = emv_pk_get_ca_pk_from_file(path, rid, idx);
-    free(path);
+    pk = emv_pk_get_ca_pk_from_list(rid, idx);
 
     if (!pk)
         return NULL;
@@ -23,9 +23,26 @@
 
 #include "emv_roca.h"
 
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include "pm3_cmd.h"
 #include "ui.h"  // Print...
+#include "util.h"  // num_CPUs
+#include "util_posix.h"  // msclock
 #include "bignum.h"
 
+#define ROCA_MAX_THREADS    64
+
+static const uint8_t roca_primes[ROCA_PRINTS_LENGTH] = {
+    11, 13, 17, 19, 37, 53, 61, 71, 73, 79, 97, 103, 107, 109, 127, 151, 157
+};
+
+// residues mod roca_primes[i] a ROCA modulus can have, bit r of roca_masks[i] set for residue r
+static uint64_t roca_masks[ROCA_PRINTS_LENGTH][3];
+static pthread_once_t roca_masks_once = PTHREAD_ONCE_INIT;
+
 static void rocacheck_init(mbedtls_mpi *prints) {
 
     for (int i = 0; i < ROCA_PRINTS_LENGTH; i++)
@@ -55,89 +72,169 @@ static void rocacheck_cleanup(mbedtls_mpi *prints) {
         mbedtls_mpi_free(&prints[i]);
 }
 
-static int bitand_is_zero(mbedtls_mpi *a, mbedtls_mpi *b) {
-
-    for (int i = 0; i < mbedtls_mpi_bitlen(a); i++) {
+// the fingerprints turned into plain bit masks once, a check needs no bignum after that
+static void roca_masks_init(void) {
+    mbedtls_mpi prints[ROCA_PRINTS_LENGTH];
+    rocacheck_init(prints);
 
-        if (mbedtls_mpi_get_bit(a, i) && mbedtls_mpi_get_bit(b, i))
-            return 0;
+    for (int i = 0; i < ROCA_PRINTS_LENGTH; i++) {
+        for (int r = 0; r < roca_primes[i]; r++) {
+            if (mbedtls_mpi_get_bit(&prints[i], r))
+                roca_masks[i][r / 64] |= 1ULL << (r % 64);
+        }
     }
-    return 1;
-}
 
+    rocacheck_cleanup(prints);
+}
 
-static mbedtls_mpi_uint mpi_get_uint(const mbedtls_mpi *X) {
+// modulus is ROCA when its residue mod every prime is one of the fingerprint
+static bool roca_check(const unsigned char *buf, size_t buflen) {
+    for (int i = 0; i < ROCA_PRINTS_LENGTH; i++) {
+        uint32_t r = 0;
+        for (size_t j = 0; j < buflen; j++)
+            r = ((r << 8) | buf[j]) % roca_primes[i];
 
-    if (X->n == 1 && X->s > 0) {
-        return X->p[0];
+        if ((roca_masks[i][r / 64] & (1ULL << (r % 64))) == 0)
+            return false;
     }
-
-    PrintAndLogEx(WARNING, "ZERRRRO!!!\n");
-    return 0;
+    return true;
 }
 
-/*
-static void print_mpi(const char *msg, int radix, const mbedtls_mpi *X) {
+bool emv_rocacheck(const unsigned char *buf, size_t buflen, bool verbose) {
+    pthread_once(&roca_masks_once, roca_masks_init);
+
+    bool ret = roca_check(buf, buflen);
+    if (verbose) {
+        if (ret)
+            PrintAndLogEx(SUCCESS, "Fingerprint found!\n");
+        else
+            PrintAndLogEx(FAILED, "No fingerprint found.\n");
+    }
+    return ret;
+}
 
-    char Xchar[400] = {0};
-    size_t len = 0;
+typedef struct {
+    const unsigned char *const *moduli;
+    const size_t *lens;
+    bool *results;
+    size_t count;
+    size_t next;
+    size_t found;
+} roca_bulk_t;
+
+#define ROCA_BULK_CHUNK     256
+
+static void *roca_bulk_worker(void *arg) {
+    roca_bulk_t *bulk = (roca_bulk_t *)arg;
+    size_t found = 0;
+
+    for (;;) {
+        size_t start = __atomic_fetch_add(&bulk->next, ROCA_BULK_CHUNK, __ATOMIC_SEQ_CST);
+        if (start >= bulk->count)
+            break;
+
+        size_t end = MIN(start + ROCA_BULK_CHUNK, bulk->count);
+        for (size_t i = start; i < end; i++) {
+            bulk->results[i] = roca_check(bulk->moduli[i], bulk->lens[i]);
+            if (bulk->results[i])
+                found++;
+        }
+    }
 
-    mbedtls_mpi_write_string(X, radix, Xchar, sizeof(Xchar), &len);
-    PrintAndLogEx(INFO, "%s[%zu] %s\n", msg, len, Xchar);
+    __atomic_add_fetch(&bulk->found, found, __ATOMIC_SEQ_CST);
+    return NULL;
 }
-*/
-bool emv_rocacheck(const unsigned char *buf, size_t buflen, bool verbose) {
 
-    mbedtls_mpi t_modulus;
-    mbedtls_mpi_init(&t_modulus);
+size_t emv_rocacheck_bulk(const unsigned char *const *moduli, const size_t *lens, bool *results, size_t count) {
+    pthread_once(&roca_masks_once, roca_masks_init);
 
-    bool ret = false;
-    mbedtls_mpi prints[ROCA_PRINTS_LENGTH];
-    uint8_t primes[ROCA_PRINTS_LENGTH] = {
-        11, 13, 17, 19, 37, 53, 61, 71, 73, 79, 97, 103, 107, 109, 127, 151, 157
+    roca_bulk_t bulk = {
+        .moduli = moduli,
+        .lens = lens,
+        .results = results,
+        .count = count,
+        .next = 0,
+        .found = 0,
     };
 
-    rocacheck_init(prints);
-
-    MBEDTLS_MPI_CHK(mbedtls_mpi_read_binary(&t_modulus, buf, buflen));
-
-    for (int i = 0; i < ROCA_PRINTS_LENGTH; i++) {
-
-        mbedtls_mpi t_temp;
-        mbedtls_mpi t_prime;
-        mbedtls_mpi g_one;
+    int num_threads = MIN(num_CPUs(), ROCA_MAX_THREADS);
+    if ((size_t)num_threads > (count + ROCA_BULK_CHUNK - 1) / ROCA_BULK_CHUNK)
+        num_threads = (count + ROCA_BULK_CHUNK - 1) / ROCA_BULK_CHUNK;
 
-        mbedtls_mpi_init(&t_temp);
-        mbedtls_mpi_init(&t_prime);
-        mbedtls_mpi_init(&g_one);
+    pthread_t threads[ROCA_MAX_THREADS];
+    int started = 0;
+    for (; started < num_threads; started++) {
+        if (pthread_create(&threads[started], NULL, roca_bulk_worker, &bulk))
+            break;
+    }
 
-        MBEDTLS_MPI_CHK(mbedtls_mpi_read_string(&g_one, 10, "1"));
+    // no thread at all, the caller's one does the work
+    if (started == 0)
+        roca_bulk_worker(&bulk);
 
-        MBEDTLS_MPI_CHK(mbedtls_mpi_add_int(&t_prime, &t_prime, primes[i]));
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
 
-        MBEDTLS_MPI_CHK(mbedtls_mpi_mod_mpi(&t_temp, &t_modulus, &t_prime));
+    return bulk.found;
+}
 
-        MBEDTLS_MPI_CHK(mbedtls_mpi_shift_l(&g_one, mpi_get_uint(&t_temp)));
+int roca_bench(size_t count) {
+    if (count == 0)
+        return PM3_EINVARG;
+
+    unsigned char *keys = calloc(count, 256);
+    const unsigned char **moduli = calloc(count, sizeof(unsigned char *));
+    size_t *lens = calloc(count, sizeof(size_t));
+    bool *results = calloc(count, sizeof(bool));
+    if (keys == NULL || moduli == NULL || lens == NULL || results == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(keys);
+        free(moduli);
+        free(lens);
+        free(results);
+        return PM3_EMALLOC;
+    }
 
-        if (bitand_is_zero(&g_one, &prints[i])) {
-            if (verbose)
-                PrintAndLogEx(FAILED, "No fingerprint found.\n");
-            goto cleanup;
+    // 2048 bit moduli, xorshift filled
+    uint64_t x = 0x9E3779B97F4A7C15ULL;
+    for (size_t i = 0; i < count; i++) {
+        for (size_t j = 0; j < 256; j++) {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            keys[i * 256 + j] = x & 0xFF;
         }
+        keys[i * 256] |= 0x80;
+        keys[i * 256 + 255] |= 0x01;
+        moduli[i] = keys + i * 256;
+        lens[i] = 256;
+    }
+
+    PrintAndLogEx(INFO, "ROCA check of " _YELLOW_("%zu") " 2048 bit moduli", count);
 
-        mbedtls_mpi_free(&g_one);
-        mbedtls_mpi_free(&t_temp);
-        mbedtls_mpi_free(&t_prime);
+    uint64_t t1 = msclock();
+    size_t found_single = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (emv_rocacheck(moduli[i], lens[i], false))
+            found_single++;
     }
+    uint64_t t2 = msclock();
+    size_t found_bulk = emv_rocacheck_bulk(moduli, lens, results, count);
+    uint64_t t3 = msclock();
 
-    ret = true;
-    if (verbose)
-        PrintAndLogEx(SUCCESS, "Fingerprint found!\n");
+    PrintAndLogEx(SUCCESS, "single thread  %6" PRIu64 " ms  %8.0f moduli/s", t2 - t1, count * 1000.0 / MAX(t2 - t1, 1));
+    PrintAndLogEx(SUCCESS, "bulk %2d threads %6" PRIu64 " ms  %8.0f moduli/s", MIN(num_CPUs(), ROCA_MAX_THREADS), t3 - t2, count * 1000.0 / MAX(t3 - t2, 1));
 
-cleanup:
-    mbedtls_mpi_free(&t_modulus);
+    int ret = PM3_SUCCESS;
+    if (found_single != found_bulk) {
+        PrintAndLogEx(FAILED, "bulk found %zu, single thread %zu", found_bulk, found_single);
+        ret = PM3_ESOFT;
+    }
 
-    rocacheck_cleanup(prints);
+    free(keys);
+    free(moduli);
+    free(lens);
+    free(results);
     return ret;
 }
 
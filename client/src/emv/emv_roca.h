@@ -29,7 +29,10 @@
 #define ROCA_PRINTS_LENGTH 17
 
 bool emv_rocacheck(const unsigned char *buf, size_t buflen, bool verbose);
+// checks count moduli on all cores, results[i] is set for the ROCA ones. Returns how many are
+size_t emv_rocacheck_bulk(const unsigned char *const *moduli, const size_t *lens, bool *results, size_t count);
 int roca_self_test(void);
+int roca_bench(size_t count);
 
 #endif
 
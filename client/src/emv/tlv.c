@@ -44,6 +44,7 @@ struct tlvdb {
     struct tlvdb *next;
     struct tlvdb *parent;
     struct tlvdb *children;
+    bool pooled;        // lives in the allocation of its parse root, freed with it
 };
 
 struct tlvdb_root {
@@ -52,6 +53,12 @@ struct tlvdb_root {
     unsigned char buf[0];
 };
 
+// nodes of one parse, carved from the allocation of the root after the copy of the data
+struct tlvdb_pool {
+    struct tlvdb *nodes;
+    size_t left;
+};
+
 static tlv_tag_t tlv_parse_tag(const unsigned char **buf, size_t *len) {
     tlv_tag_t tag;
 
@@ -115,12 +122,60 @@ bool tlv_parse_tl(const unsigned char **buf, size_t *len, struct tlv *tlv) {
     return true;
 }
 
-static struct tlvdb *tlvdb_parse_children(struct tlvdb *parent);
+static struct tlvdb *tlvdb_parse_children(struct tlvdb *parent, struct tlvdb_pool *pool);
+
+static struct tlvdb *tlvdb_pool_get(struct tlvdb_pool *pool) {
+    if (pool->left == 0)
+        return NULL;
+    pool->left--;
+    struct tlvdb *tlvdb = pool->nodes++;
+    tlvdb->pooled = true;
+    return tlvdb;
+}
+
+// nodes the parse of buf allocates, the failing one of broken data included
+static size_t tlvdb_count(const unsigned char *buf, size_t len) {
+    size_t count = 0;
+
+    while (len != 0) {
+        count++;
+
+        struct tlv tlv;
+        if (!tlv_parse_tl(&buf, &len, &tlv) || tlv.len > len)
+            break;
+
+        if (tlv_is_constructed(&tlv) && tlv.len != 0)
+            count += tlvdb_count(buf, tlv.len);
+
+        buf += tlv.len;
+        len -= tlv.len;
+    }
+    return count;
+}
+
+// one allocation for the root, the copy of the data and all nodes of the parse
+static struct tlvdb_root *tlvdb_root_new(const unsigned char *buf, size_t len, struct tlvdb_pool *pool) {
+    size_t nodes = tlvdb_count(buf, len);
+    size_t bufsize = (len + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+
+    struct tlvdb_root *root = malloc(sizeof(*root) + bufsize + nodes * sizeof(struct tlvdb));
+    if (!root)
+        return NULL;
+
+    root->db.pooled = false;
+    root->len = len;
+    memcpy(root->buf, buf, len);
+
+    pool->nodes = (struct tlvdb *)(root->buf + bufsize);
+    pool->left = nodes;
+    return root;
+}
 
 static bool tlvdb_parse_one(struct tlvdb *tlvdb,
                             struct tlvdb *parent,
                             const unsigned char **tmp,
-                            size_t *left) {
+                            size_t *left,
+                            struct tlvdb_pool *pool) {
     tlvdb->next = tlvdb->children = NULL;
     tlvdb->parent = parent;
 
@@ -141,7 +196,7 @@ static bool tlvdb_parse_one(struct tlvdb *tlvdb,
     *left -= tlvdb->tag.len;
 
     if (tlv_is_constructed(&tlvdb->tag) && (tlvdb->tag.len != 0)) {
-        tlvdb->children = tlvdb_parse_children(tlvdb);
+        tlvdb->children = tlvdb_parse_children(tlvdb, pool);
         if (!tlvdb->children)
             goto err;
     } else {
@@ -154,20 +209,22 @@ err:
     return false;
 }
 
-static struct tlvdb *tlvdb_parse_children(struct tlvdb *parent) {
+static struct tlvdb *tlvdb_parse_children(struct tlvdb *parent, struct tlvdb_pool *pool) {
     const unsigned char *tmp = parent->tag.value;
     size_t left = parent->tag.len;
     struct tlvdb *tlvdb, *first = NULL, *prev = NULL;
 
     while (left != 0) {
-        tlvdb = malloc(sizeof(*tlvdb));
+        tlvdb = tlvdb_pool_get(pool);
+        if (!tlvdb)
+            goto err;
         if (prev)
             prev->next = tlvdb;
         else
             first = tlvdb;
         prev = tlvdb;
 
-        if (!tlvdb_parse_one(tlvdb, parent, &tmp, &left))
+        if (!tlvdb_parse_one(tlvdb, parent, &tmp, &left, pool))
             goto err;
 
         tlvdb->parent = parent;
@@ -189,14 +246,15 @@ struct tlvdb *tlvdb_parse(const unsigned char *buf, size_t len) {
     if (!len || !buf)
         return NULL;
 
-    root = malloc(sizeof(*root) + len);
-    root->len = len;
-    memcpy(root->buf, buf, len);
+    struct tlvdb_pool pool;
+    root = tlvdb_root_new(buf, len, &pool);
+    if (!root)
+        return NULL;
 
     tmp = root->buf;
     left = len;
 
-    if (!tlvdb_parse_one(&root->db, NULL, &tmp, &left))
+    if (!tlvdb_parse_one(&root->db, NULL, &tmp, &left, &pool))
         goto err;
 
     if (left)
@@ -218,22 +276,21 @@ struct tlvdb *tlvdb_parse_multi(const unsigned char *buf, size_t len) {
     if (!len || !buf)
         return NULL;
 
-    root = malloc(sizeof(*root) + len);
-    root->len = len;
-    memcpy(root->buf, buf, len);
+    struct tlvdb_pool pool;
+    root = tlvdb_root_new(buf, len, &pool);
+    if (!root)
+        return NULL;
 
     tmp = root->buf;
     left = len;
 
-    if (!tlvdb_parse_one(&root->db, NULL, &tmp, &left))
+    if (!tlvdb_parse_one(&root->db, NULL, &tmp, &left, &pool))
         goto err;
 
     while (left != 0) {
-        struct tlvdb *db = malloc(sizeof(*db));
-        if (!tlvdb_parse_one(db, NULL, &tmp, &left)) {
-            free(db);
+        struct tlvdb *db = tlvdb_pool_get(&pool);
+        if (!db || !tlvdb_parse_one(db, NULL, &tmp, &left, &pool))
             goto err;
-        }
 
         tlvdb_add(&root->db, db);
     }
@@ -252,6 +309,7 @@ struct tlvdb *tlvdb_fixed(tlv_tag_t tag, size_t len, const unsigned char *value)
     root->len = len;
     memcpy(root->buf, value, len);
 
+    root->db.pooled = false;
     root->db.parent = root->db.next = root->db.children = NULL;
     root->db.tag.tag = tag;
     root->db.tag.len = len;
@@ -265,6 +323,7 @@ struct tlvdb *tlvdb_external(tlv_tag_t tag, size_t len, const unsigned char *val
 
     root->len = 0;
 
+    root->db.pooled = false;
     root->db.parent = root->db.next = root->db.children = NULL;
     root->db.tag.tag = tag;
     root->db.tag.len = len;
@@ -275,14 +334,25 @@ struct tlvdb *tlvdb_external(tlv_tag_t tag, size_t len, const unsigned char *val
 
 void tlvdb_free(struct tlvdb *tlvdb) {
     struct tlvdb *next = NULL;
+    struct tlvdb *roots = NULL;
 
     if (!tlvdb)
         return;
 
+    // pooled nodes go with their root. The roots are freed after the walk, the nodes of a
+    // multi parse follow their root in the chain
     for (; tlvdb; tlvdb = next) {
         next = tlvdb->next;
         tlvdb_free(tlvdb->children);
-        free(tlvdb);
+        if (tlvdb->pooled)
+            continue;
+        tlvdb->next = roots;
+        roots = tlvdb;
+    }
+
+    for (; roots; roots = next) {
+        next = roots->next;
+        free(roots);
     }
 }
 
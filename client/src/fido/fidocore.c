@@ -221,18 +221,42 @@ int FIDO2GetAssertion(uint8_t *params, uint8_t paramslen, uint8_t *Result, size_
     return FIDOExchange((sAPDU) {0x80, 0x10, 0x00, 0x00, sizeof(data), data}, Result, MaxResultLen, ResultLen, sw);
 }
 
+// The CAs are parsed on the first certificate check and kept for the session
+static mbedtls_x509_crt fido_ca;
+static int fido_ca_res = 0;
+static bool fido_ca_loaded = false;
+
+static mbedtls_x509_crt *FIDOGetCA(void) {
+    if (fido_ca_loaded == false) {
+        mbedtls_x509_crt_init(&fido_ca);
+        fido_ca_res = mbedtls_x509_crt_parse(&fido_ca, (const unsigned char *) additional_ca_pem, additional_ca_pem_len);
+        if (fido_ca_res < 0) {
+            PrintAndLogEx(ERR, "ERROR: CA parse certificate returned -0x%x - %s", -fido_ca_res, ecdsa_get_error(fido_ca_res));
+        }
+        fido_ca_loaded = true;
+    }
+    return &fido_ca;
+}
+
+int FIDOVerifyDER(uint8_t *der, size_t derLen, uint32_t *verifyflags) {
+    *verifyflags = 0;
+
+    mbedtls_x509_crt cert;
+    mbedtls_x509_crt_init(&cert);
+    int res = mbedtls_x509_crt_parse_der(&cert, der, derLen);
+    if (res == 0)
+        res = mbedtls_x509_crt_verify(&cert, FIDOGetCA(), NULL, NULL, verifyflags, NULL, NULL);
+    mbedtls_x509_crt_free(&cert);
+    return res;
+}
+
 int FIDOCheckDERAndGetKey(uint8_t *der, size_t derLen, bool verbose, uint8_t *publicKey, size_t publicKeyMaxLen) {
     int res;
 
     // load CA's
-    mbedtls_x509_crt cacert;
-    mbedtls_x509_crt_init(&cacert);
-    res = mbedtls_x509_crt_parse(&cacert, (const unsigned char *) additional_ca_pem, additional_ca_pem_len);
-    if (res < 0) {
-        PrintAndLogEx(ERR, "ERROR: CA parse certificate returned -0x%x - %s", -res, ecdsa_get_error(res));
-    }
+    mbedtls_x509_crt *cacert = FIDOGetCA();
     if (verbose)
-        PrintAndLogEx(SUCCESS, "CA load OK. %d skipped", res);
+        PrintAndLogEx(SUCCESS, "CA load OK. %d skipped", fido_ca_res);
 
     // load DER certificate from authenticator's data
     mbedtls_x509_crt cert;
@@ -251,7 +275,7 @@ int FIDOCheckDERAndGetKey(uint8_t *der, size_t derLen, bool verbose, uint8_t *pu
 
     // verify certificate
     uint32_t verifyflags = 0;
-    res = mbedtls_x509_crt_verify(&cert, &cacert, NULL, NULL, &verifyflags, NULL, NULL);
+    res = mbedtls_x509_crt_verify(&cert, cacert, NULL, NULL, &verifyflags, NULL, NULL);
     if (res) {
         PrintAndLogEx(ERR, "ERROR: DER verify returned 0x%x - %s\n", (res < 0) ? -res : res, ecdsa_get_error(res));
     } else {
@@ -277,7 +301,6 @@ int FIDOCheckDERAndGetKey(uint8_t *der, size_t derLen, bool verbose, uint8_t *pu
         PrintAndLogEx(NORMAL, "------------------DER-------------------");
 
     mbedtls_x509_crt_free(&cert);
-    mbedtls_x509_crt_free(&cacert);
 
     return 0;
 }
@@ -44,6 +44,8 @@ int FIDO2MakeCredential(uint8_t *params, uint8_t paramslen, uint8_t *Result, siz
 int FIDO2GetAssertion(uint8_t *params, uint8_t paramslen, uint8_t *Result, size_t MaxResultLen, size_t *ResultLen, uint16_t *sw);
 
 int FIDOCheckDERAndGetKey(uint8_t *der, size_t derLen, bool verbose, uint8_t *publicKey, size_t publicKeyMaxLen);
+// the attestation certificate against the CAs we know, quietly. 0 or the mbedtls error, flags of the check
+int FIDOVerifyDER(uint8_t *der, size_t derLen, uint32_t *verifyflags);
 
 const char *fido2GetCmdMemberDescription(uint8_t cmdCode, bool isResponse, int memberNum);
 const char *fido2GetCmdErrorDescription(uint8_t errorCode);
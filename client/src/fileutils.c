@@ -41,6 +41,7 @@
 #include "preferences.h"
 
 #include <dirent.h>
+#include <pthread.h>
 #include <ctype.h>
 
 #include "pm3_cmd.h"
@@ -53,6 +54,11 @@
 #ifdef _WIN32
 #include "scandir.h"
 #include <direct.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #endif
 
 #define PATH_MAX_LENGTH 200
@@ -251,6 +257,10 @@ char *newfilenamemcopy(const char *preferredName, const char *suffix) {
 }
 
 int saveFile(const char *preferredName, const char *suffix, const void *data, size_t datalen) {
+    return saveFileEx(preferredName, suffix, data, datalen, true);
+}
+
+int saveFileEx(const char *preferredName, const char *suffix, const void *data, size_t datalen, bool verbose) {
 
     if (data == NULL) return PM3_EINVARG;
     char *fileName = newfilenamemcopy(preferredName, suffix);
@@ -268,12 +278,18 @@ int saveFile(const char *preferredName, const char *suffix, const void *data, si
     fwrite(data, 1, datalen, f);
     fflush(f);
     fclose(f);
-    PrintAndLogEx(SUCCESS, "saved " _YELLOW_("%zu") " bytes to binary file " _YELLOW_("%s"), datalen, fileName);
+    if (verbose) {
+        PrintAndLogEx(SUCCESS, "saved " _YELLOW_("%zu") " bytes to binary file " _YELLOW_("%s"), datalen, fileName);
+    }
     free(fileName);
     return PM3_SUCCESS;
 }
 
 int saveFileEML(const char *preferredName, uint8_t *data, size_t datalen, size_t blocksize) {
+    return saveFileEMLex(preferredName, data, datalen, blocksize, true);
+}
+
+int saveFileEMLex(const char *preferredName, uint8_t *data, size_t datalen, size_t blocksize, bool verbose) {
 
     if (data == NULL) return PM3_EINVARG;
     char *fileName = newfilenamemcopy(preferredName, ".eml");
@@ -311,189 +327,124 @@ int saveFileEML(const char *preferredName, uint8_t *data, size_t datalen, size_t
     }
     fflush(f);
     fclose(f);
-    PrintAndLogEx(SUCCESS, "saved " _YELLOW_("%" PRId32) " blocks to text file " _YELLOW_("%s"), blocks, fileName);
+    if (verbose) {
+        PrintAndLogEx(SUCCESS, "saved " _YELLOW_("%" PRId32) " blocks to text file " _YELLOW_("%s"), blocks, fileName);
+    }
 
 out:
     free(fileName);
     return retval;
 }
 
-int saveFileJSON(const char *preferredName, JSONFileType ftype, uint8_t *data, size_t datalen, void (*callback)(json_t *)) {
-    return saveFileJSONex(preferredName, ftype, data, datalen, true, callback);
-}
-int saveFileJSONex(const char *preferredName, JSONFileType ftype, uint8_t *data, size_t datalen, bool verbose, void (*callback)(json_t *)) {
-
-    if (data == NULL) return PM3_EINVARG;
-
-    char *fileName = newfilenamemcopy(preferredName, ".json");
-    if (fileName == NULL) return PM3_EMALLOC;
-
-    int retval = PM3_SUCCESS;
-
-    json_t *root = json_object();
-    JsonSaveStr(root, "Created", "proxmark3");
-    switch (ftype) {
-        case jsfRaw: {
-            JsonSaveStr(root, "FileType", "raw");
-            JsonSaveBufAsHexCompact(root, "raw", data, datalen);
-            break;
-        }
-        case jsfCardMemory: {
-            JsonSaveStr(root, "FileType", "mfcard");
-            for (size_t i = 0; i < (datalen / 16); i++) {
-                char path[PATH_MAX_LENGTH] = {0};
-                sprintf(path, "$.blocks.%zu", i);
-                JsonSaveBufAsHexCompact(root, path, &data[i * 16], 16);
-
-                if (i == 0) {
-                    JsonSaveBufAsHexCompact(root, "$.Card.UID", &data[0], 4);
-                    JsonSaveBufAsHexCompact(root, "$.Card.SAK", &data[5], 1);
-                    JsonSaveBufAsHexCompact(root, "$.Card.ATQA", &data[6], 2);
-                }
-
-                if (mfIsSectorTrailer(i)) {
-
-                    snprintf(path, sizeof(path), "$.SectorKeys.%d.KeyA", mfSectorNum(i));
-                    JsonSaveBufAsHexCompact(root, path, &data[i * 16], 6);
-
-                    snprintf(path, sizeof(path), "$.SectorKeys.%d.KeyB", mfSectorNum(i));
-                    JsonSaveBufAsHexCompact(root, path, &data[i * 16 + 10], 6);
-
-                    uint8_t *adata = &data[i * 16 + 6];
-                    snprintf(path, sizeof(path), "$.SectorKeys.%d.AccessConditions", mfSectorNum(i));
-                    JsonSaveBufAsHexCompact(root, path, &data[i * 16 + 6], 4);
-
-                    snprintf(path, sizeof(path), "$.SectorKeys.%d.AccessConditionsText.block%zu", mfSectorNum(i), i - 3);
-                    JsonSaveStr(root, path, mfGetAccessConditionsDesc(0, adata));
-
-                    snprintf(path, sizeof(path), "$.SectorKeys.%d.AccessConditionsText.block%zu", mfSectorNum(i), i - 2);
-                    JsonSaveStr(root, path, mfGetAccessConditionsDesc(1, adata));
-
-                    snprintf(path, sizeof(path), "$.SectorKeys.%d.AccessConditionsText.block%zu", mfSectorNum(i), i - 1);
-                    JsonSaveStr(root, path, mfGetAccessConditionsDesc(2, adata));
-
-                    snprintf(path, sizeof(path), "$.SectorKeys.%d.AccessConditionsText.block%zu", mfSectorNum(i), i);
-                    JsonSaveStr(root, path, mfGetAccessConditionsDesc(3, adata));
-
-                    snprintf(path, sizeof(path), "$.SectorKeys.%d.AccessConditionsText.UserData", mfSectorNum(i));
-                    JsonSaveBufAsHexCompact(root, path, &adata[3], 1);
-                }
-            }
-            break;
+// Dumps are written straight to the file, without a jansson tree, in the layout json_dump_file
+// with JSON_INDENT(2) gives and with the members in the order the tree had them
+#define JSON_STREAM_DEPTH   8
+
+typedef struct {
+    FILE *f;
+    int depth;
+    bool members[JSON_STREAM_DEPTH];    // of the object open at each depth
+} json_stream_t;
+
+static void jsonStreamString(json_stream_t *js, const char *str) {
+    fputc('"', js->f);
+    for (; *str; str++) {
+        switch (*str) {
+            case '"':
+                fputs("\\\"", js->f);
+                break;
+            case '\\':
+                fputs("\\\\", js->f);
+                break;
+            case '\b':
+                fputs("\\b", js->f);
+                break;
+            case '\f':
+                fputs("\\f", js->f);
+                break;
+            case '\n':
+                fputs("\\n", js->f);
+                break;
+            case '\r':
+                fputs("\\r", js->f);
+                break;
+            case '\t':
+                fputs("\\t", js->f);
+                break;
+            default:
+                if ((uint8_t)*str < 0x20)
+                    fprintf(js->f, "\\u%04X", (uint8_t)*str);
+                else
+                    fputc(*str, js->f);
+                break;
         }
-        case jsfMfuMemory: {
-            JsonSaveStr(root, "FileType", "mfu");
-
-            mfu_dump_t *tmp = (mfu_dump_t *)data;
-
-            uint8_t uid[7] = {0};
-            memcpy(uid, tmp->data, 3);
-            memcpy(uid + 3, tmp->data + 4, 4);
+    }
+    fputc('"', js->f);
+}
 
-            char path[PATH_MAX_LENGTH] = {0};
+static void jsonStreamKey(json_stream_t *js, const char *key) {
+    if (js->members[js->depth])
+        fputc(',', js->f);
+    js->members[js->depth] = true;
 
-            JsonSaveBufAsHexCompact(root, "$.Card.UID", uid, sizeof(uid));
-            JsonSaveBufAsHexCompact(root, "$.Card.Version", tmp->version, sizeof(tmp->version));
-            JsonSaveBufAsHexCompact(root, "$.Card.TBO_0", tmp->tbo, sizeof(tmp->tbo));
-            JsonSaveBufAsHexCompact(root, "$.Card.TBO_1", tmp->tbo1, sizeof(tmp->tbo1));
-            JsonSaveBufAsHexCompact(root, "$.Card.Signature", tmp->signature, sizeof(tmp->signature));
-            for (uint8_t i = 0; i < 3; i ++) {
-                sprintf(path, "$.Card.Counter%d", i);
-                JsonSaveBufAsHexCompact(root, path, tmp->counter_tearing[i], 3);
-                sprintf(path, "$.Card.Tearing%d", i);
-                JsonSaveBufAsHexCompact(root, path, tmp->counter_tearing[i] + 3, 1);
-            }
+    fputc('\n', js->f);
+    fprintf(js->f, "%*s", js->depth * 2, "");
+    jsonStreamString(js, key);
+    fputs(": ", js->f);
+}
 
-            // size of header 56b
-            size_t len = (datalen - MFU_DUMP_PREFIX_LENGTH) / 4;
+static void jsonStreamBegin(json_stream_t *js, const char *key) {
+    if (key)
+        jsonStreamKey(js, key);
 
-            for (size_t i = 0; i < len; i++) {
-                sprintf(path, "$.blocks.%zu", i);
-                JsonSaveBufAsHexCompact(root, path, tmp->data + (i * 4), 4);
-            }
-            break;
-        }
-        case jsfHitag: {
-            JsonSaveStr(root, "FileType", "hitag");
-            uint8_t uid[4] = {0};
-            memcpy(uid, data, 4);
-
-            JsonSaveBufAsHexCompact(root, "$.Card.UID", uid, sizeof(uid));
+    fputc('{', js->f);
+    js->depth++;
+    js->members[js->depth] = false;
+}
 
-            for (size_t i = 0; i < (datalen / 4); i++) {
-                char path[PATH_MAX_LENGTH] = {0};
-                sprintf(path, "$.blocks.%zu", i);
-                JsonSaveBufAsHexCompact(root, path, data + (i * 4), 4);
-            }
-            break;
-        }
-        case jsfIclass: {
-            JsonSaveStr(root, "FileType", "iclass");
+static void jsonStreamEnd(json_stream_t *js) {
+    bool members = js->members[js->depth];
+    js->depth--;
+    if (members) {
+        fputc('\n', js->f);
+        fprintf(js->f, "%*s", js->depth * 2, "");
+    }
+    fputc('}', js->f);
+}
 
-            picopass_hdr *hdr = (picopass_hdr *)data;
-            JsonSaveBufAsHexCompact(root, "$.Card.CSN", hdr->csn, sizeof(hdr->csn));
-            JsonSaveBufAsHexCompact(root, "$.Card.Configuration", (uint8_t *)&hdr->conf, sizeof(hdr->conf));
+static void jsonStreamStr(json_stream_t *js, const char *key, const char *value) {
+    jsonStreamKey(js, key);
+    jsonStreamString(js, value);
+}
 
-            uint8_t pagemap = get_pagemap(hdr);
-            if (pagemap == PICOPASS_NON_SECURE_PAGEMODE) {
-                picopass_ns_hdr *ns_hdr = (picopass_ns_hdr *)data;
-                JsonSaveBufAsHexCompact(root, "$.Card.AIA", ns_hdr->app_issuer_area, sizeof(ns_hdr->app_issuer_area));
-            } else {
-                JsonSaveBufAsHexCompact(root, "$.Card.Epurse", hdr->epurse, sizeof(hdr->epurse));
-                JsonSaveBufAsHexCompact(root, "$.Card.Kd", hdr->key_d, sizeof(hdr->key_d));
-                JsonSaveBufAsHexCompact(root, "$.Card.Kc", hdr->key_c, sizeof(hdr->key_c));
-                JsonSaveBufAsHexCompact(root, "$.Card.AIA", hdr->app_issuer_area, sizeof(hdr->app_issuer_area));
-            }
+// like JsonSaveBufAsHexCompact
+static void jsonStreamHex(json_stream_t *js, const char *key, const uint8_t *data, size_t datalen) {
+    jsonStreamKey(js, key);
+    fputc('"', js->f);
+    for (size_t i = 0; i < datalen; i++)
+        fprintf(js->f, "%02X", data[i]);
+    fputc('"', js->f);
+}
 
-            for (size_t i = 0; i < (datalen / 8); i++) {
-                char path[PATH_MAX_LENGTH] = {0};
-                sprintf(path, "$.blocks.%zu", i);
-                JsonSaveBufAsHexCompact(root, path, data + (i * 8), 8);
-            }
+static void jsonStreamBlocks(json_stream_t *js, const uint8_t *data, size_t count, size_t blocksize) {
+    if (count == 0)
+        return;
 
-            break;
-        }
-        case jsfT55x7: {
-            JsonSaveStr(root, "FileType", "t55x7");
-            uint8_t conf[4] = {0};
-            memcpy(conf, data, 4);
-            JsonSaveBufAsHexCompact(root, "$.Card.ConfigBlock", conf, sizeof(conf));
+    jsonStreamBegin(js, "blocks");
+    for (size_t i = 0; i < count; i++) {
+        char key[24];
+        snprintf(key, sizeof(key), "%zu", i);
+        jsonStreamHex(js, key, data + (i * blocksize), blocksize);
+    }
+    jsonStreamEnd(js);
+}
 
-            for (size_t i = 0; i < (datalen / 4); i++) {
-                char path[PATH_MAX_LENGTH] = {0};
-                sprintf(path, "$.blocks.%zu", i);
-                JsonSaveBufAsHexCompact(root, path, data + (i * 4), 4);
-            }
-            break;
-        }
-        case jsf14b: {
-            JsonSaveStr(root, "FileType", "14b");
-            JsonSaveBufAsHexCompact(root, "raw", data, datalen);
-            break;
-        }
-        case jsf15: {
-            JsonSaveStr(root, "FileType", "15693");
-            JsonSaveBufAsHexCompact(root, "raw", data, datalen);
-            break;
-        }
-        case jsfLegic: {
-            JsonSaveStr(root, "FileType", "legic");
-            JsonSaveBufAsHexCompact(root, "raw", data, datalen);
-            break;
-        }
-        case jsfT5555: {
-            JsonSaveStr(root, "FileType", "t5555");
-            uint8_t conf[4] = {0};
-            memcpy(conf, data, 4);
-            JsonSaveBufAsHexCompact(root, "$.Card.ConfigBlock", conf, sizeof(conf));
+static int saveFileJSONtree(const char *fileName, JSONFileType ftype, uint8_t *data, size_t datalen, void (*callback)(json_t *)) {
+    int retval = PM3_SUCCESS;
 
-            for (size_t i = 0; i < (datalen / 4); i++) {
-                char path[PATH_MAX_LENGTH] = {0};
-                sprintf(path, "$.blocks.%zu", i);
-                JsonSaveBufAsHexCompact(root, path, data + (i * 4), 4);
-            }
-            break;
-        }
+    json_t *root = json_object();
+    JsonSaveStr(root, "Created", "proxmark3");
+    switch (ftype) {
         case jsfMfPlusKeys: {
             JsonSaveStr(root, "FileType", "mfp");
             JsonSaveBufAsHexCompact(root, "$.Card.UID", &data[0], 7);
@@ -511,13 +462,13 @@ int saveFileJSONex(const char *preferredName, JSONFileType ftype, uint8_t *data,
 
                 if (vdata[0][i][0]) {
                     memset(path, 0x00, sizeof(path));
-                    sprintf(path, "$.SectorKeys.%d.KeyA", mfSectorNum(i));
+                    sprintf(path, "$.SectorKeys.%zu.KeyA", i);
                     JsonSaveBufAsHexCompact(root, path, &vdata[0][i][1], 16);
                 }
 
                 if (vdata[1][i][0]) {
                     memset(path, 0x00, sizeof(path));
-                    sprintf(path, "$.SectorKeys.%d.KeyB", mfSectorNum(i));
+                    sprintf(path, "$.SectorKeys.%zu.KeyB", i);
                     JsonSaveBufAsHexCompact(root, path, &vdata[1][i][1], 16);
                 }
             }
@@ -577,12 +528,184 @@ int saveFileJSONex(const char *preferredName, JSONFileType ftype, uint8_t *data,
         retval = 200;
         goto out;
     }
-    if (verbose)
-        PrintAndLogEx(SUCCESS, "saved to json file " _YELLOW_("%s"), fileName);
-
     json_decref(root);
 
 out:
+    return retval;
+}
+
+int saveFileJSON(const char *preferredName, JSONFileType ftype, uint8_t *data, size_t datalen, void (*callback)(json_t *)) {
+    return saveFileJSONex(preferredName, ftype, data, datalen, true, callback);
+}
+int saveFileJSONex(const char *preferredName, JSONFileType ftype, uint8_t *data, size_t datalen, bool verbose, void (*callback)(json_t *)) {
+
+    if (data == NULL) return PM3_EINVARG;
+
+    char *fileName = newfilenamemcopy(preferredName, ".json");
+    if (fileName == NULL) return PM3_EMALLOC;
+
+    int retval = PM3_SUCCESS;
+
+    // key files may set a path twice and custom ones fill in a tree, both are small
+    if (ftype == jsfMfPlusKeys || ftype == jsfMfDesfireKeys || ftype == jsfCustom) {
+        retval = saveFileJSONtree(fileName, ftype, data, datalen, callback);
+        goto out;
+    }
+
+    FILE *f = fopen(fileName, "w");
+    if (f == NULL) {
+        PrintAndLogEx(FAILED, "error: can't save the file: " _YELLOW_("%s"), fileName);
+        retval = 200;
+        goto out;
+    }
+
+    json_stream_t js = { .f = f };
+    jsonStreamBegin(&js, NULL);
+    jsonStreamStr(&js, "Created", "proxmark3");
+    switch (ftype) {
+        case jsfRaw:
+        case jsf14b:
+        case jsf15:
+        case jsfLegic: {
+            jsonStreamStr(&js, "FileType", (ftype == jsfRaw) ? "raw" : (ftype == jsf14b) ? "14b" : (ftype == jsf15) ? "15693" : "legic");
+            jsonStreamHex(&js, "raw", data, datalen);
+            break;
+        }
+        case jsfCardMemory: {
+            jsonStreamStr(&js, "FileType", "mfcard");
+            size_t count = datalen / 16;
+            jsonStreamBlocks(&js, data, count, 16);
+            if (count == 0)
+                break;
+
+            jsonStreamBegin(&js, "Card");
+            jsonStreamHex(&js, "UID", &data[0], 4);
+            jsonStreamHex(&js, "SAK", &data[5], 1);
+            jsonStreamHex(&js, "ATQA", &data[6], 2);
+            jsonStreamEnd(&js);
+
+            bool sectorkeys = false;
+            for (size_t i = 0; i < count; i++) {
+                if (mfIsSectorTrailer(i) == false)
+                    continue;
+
+                if (sectorkeys == false)
+                    jsonStreamBegin(&js, "SectorKeys");
+                sectorkeys = true;
+
+                char path[PATH_MAX_LENGTH] = {0};
+                snprintf(path, sizeof(path), "%d", mfSectorNum(i));
+                jsonStreamBegin(&js, path);
+
+                jsonStreamHex(&js, "KeyA", &data[i * 16], 6);
+                jsonStreamHex(&js, "KeyB", &data[i * 16 + 10], 6);
+
+                uint8_t *adata = &data[i * 16 + 6];
+                jsonStreamHex(&js, "AccessConditions", adata, 4);
+
+                jsonStreamBegin(&js, "AccessConditionsText");
+                for (uint8_t j = 0; j < 4; j++) {
+                    snprintf(path, sizeof(path), "block%zu", i - 3 + j);
+                    jsonStreamStr(&js, path, mfGetAccessConditionsDesc(j, adata));
+                }
+                jsonStreamHex(&js, "UserData", &adata[3], 1);
+                jsonStreamEnd(&js);
+
+                jsonStreamEnd(&js);
+            }
+            if (sectorkeys)
+                jsonStreamEnd(&js);
+            break;
+        }
+        case jsfMfuMemory: {
+            jsonStreamStr(&js, "FileType", "mfu");
+
+            mfu_dump_t *tmp = (mfu_dump_t *)data;
+
+            uint8_t uid[7] = {0};
+            memcpy(uid, tmp->data, 3);
+            memcpy(uid + 3, tmp->data + 4, 4);
+
+            jsonStreamBegin(&js, "Card");
+            jsonStreamHex(&js, "UID", uid, sizeof(uid));
+            jsonStreamHex(&js, "Version", tmp->version, sizeof(tmp->version));
+            jsonStreamHex(&js, "TBO_0", tmp->tbo, sizeof(tmp->tbo));
+            jsonStreamHex(&js, "TBO_1", tmp->tbo1, sizeof(tmp->tbo1));
+            jsonStreamHex(&js, "Signature", tmp->signature, sizeof(tmp->signature));
+            for (uint8_t i = 0; i < 3; i ++) {
+                char path[PATH_MAX_LENGTH] = {0};
+                sprintf(path, "Counter%d", i);
+                jsonStreamHex(&js, path, tmp->counter_tearing[i], 3);
+                sprintf(path, "Tearing%d", i);
+                jsonStreamHex(&js, path, tmp->counter_tearing[i] + 3, 1);
+            }
+            jsonStreamEnd(&js);
+
+            // size of header 56b
+            size_t len = (datalen > MFU_DUMP_PREFIX_LENGTH) ? (datalen - MFU_DUMP_PREFIX_LENGTH) / 4 : 0;
+            jsonStreamBlocks(&js, tmp->data, len, 4);
+            break;
+        }
+        case jsfHitag: {
+            jsonStreamStr(&js, "FileType", "hitag");
+            jsonStreamBegin(&js, "Card");
+            jsonStreamHex(&js, "UID", data, 4);
+            jsonStreamEnd(&js);
+
+            jsonStreamBlocks(&js, data, datalen / 4, 4);
+            break;
+        }
+        case jsfIclass: {
+            jsonStreamStr(&js, "FileType", "iclass");
+
+            picopass_hdr *hdr = (picopass_hdr *)data;
+            jsonStreamBegin(&js, "Card");
+            jsonStreamHex(&js, "CSN", hdr->csn, sizeof(hdr->csn));
+            jsonStreamHex(&js, "Configuration", (uint8_t *)&hdr->conf, sizeof(hdr->conf));
+
+            uint8_t pagemap = get_pagemap(hdr);
+            if (pagemap == PICOPASS_NON_SECURE_PAGEMODE) {
+                picopass_ns_hdr *ns_hdr = (picopass_ns_hdr *)data;
+                jsonStreamHex(&js, "AIA", ns_hdr->app_issuer_area, sizeof(ns_hdr->app_issuer_area));
+            } else {
+                jsonStreamHex(&js, "Epurse", hdr->epurse, sizeof(hdr->epurse));
+                jsonStreamHex(&js, "Kd", hdr->key_d, sizeof(hdr->key_d));
+                jsonStreamHex(&js, "Kc", hdr->key_c, sizeof(hdr->key_c));
+                jsonStreamHex(&js, "AIA", hdr->app_issuer_area, sizeof(hdr->app_issuer_area));
+            }
+            jsonStreamEnd(&js);
+
+            jsonStreamBlocks(&js, data, datalen / 8, 8);
+            break;
+        }
+        case jsfT55x7:
+        case jsfT5555: {
+            jsonStreamStr(&js, "FileType", (ftype == jsfT55x7) ? "t55x7" : "t5555");
+            jsonStreamBegin(&js, "Card");
+            jsonStreamHex(&js, "ConfigBlock", data, 4);
+            jsonStreamEnd(&js);
+
+            jsonStreamBlocks(&js, data, datalen / 4, 4);
+            break;
+        }
+        default:
+            break;
+    }
+    jsonStreamEnd(&js);
+
+    bool failed = ferror(f);
+    if (fclose(f))
+        failed = true;
+
+    if (failed) {
+        PrintAndLogEx(FAILED, "error: can't save the file: " _YELLOW_("%s"), fileName);
+        retval = 200;
+    }
+
+out:
+    if (verbose && retval == PM3_SUCCESS)
+        PrintAndLogEx(SUCCESS, "saved to json file " _YELLOW_("%s"), fileName);
+
     free(fileName);
     return retval;
 }
@@ -761,10 +884,16 @@ out:
 int loadFile_safe(const char *preferredName, const char *suffix, void **pdata, size_t *datalen) {
     return loadFile_safeEx(preferredName, suffix, pdata, datalen, true);
 }
+static int load_file_from(const char *subdir, const char *preferredName, const char *suffix, void **pdata, size_t *datalen, bool verbose);
+
 int loadFile_safeEx(const char *preferredName, const char *suffix, void **pdata, size_t *datalen, bool verbose) {
+    return load_file_from(RESOURCES_SUBDIR, preferredName, suffix, pdata, datalen, verbose);
+}
+
+static int load_file_from(const char *subdir, const char *preferredName, const char *suffix, void **pdata, size_t *datalen, bool verbose) {
 
     char *path;
-    int res = searchFile(&path, RESOURCES_SUBDIR, preferredName, suffix, false);
+    int res = searchFile(&path, subdir, preferredName, suffix, false);
     if (res != PM3_SUCCESS) {
         return PM3_EFILE;
     }
@@ -812,6 +941,70 @@ int loadFile_safeEx(const char *preferredName, const char *suffix, void **pdata,
     return PM3_SUCCESS;
 }
 
+int mapFile_safe(const char *preferredName, const char *suffix, void **pdata, size_t *datalen) {
+    return mapFile_safeEx(preferredName, suffix, pdata, datalen, true);
+}
+static int map_file_from(const char *subdir, const char *preferredName, const char *suffix, void **pdata, size_t *datalen, bool verbose) {
+#ifdef _WIN32
+    return load_file_from(subdir, preferredName, suffix, pdata, datalen, verbose);
+#else
+    char *path;
+    int res = searchFile(&path, subdir, preferredName, suffix, false);
+    if (res != PM3_SUCCESS) {
+        return PM3_EFILE;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        PrintAndLogEx(WARNING, "file not found or locked. '" _YELLOW_("%s")"'", path);
+        free(path);
+        return PM3_EFILE;
+    }
+    free(path);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        PrintAndLogEx(FAILED, "error, when getting filesize");
+        close(fd);
+        return PM3_EFILE;
+    }
+
+    // private copy on write mapping,  pages are only read in when touched
+    // and callers may scribble on the data without touching the file
+    void *map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        PrintAndLogEx(FAILED, "error, cannot map file");
+        return PM3_EFILE;
+    }
+
+    *pdata = map;
+    *datalen = st.st_size;
+    if (verbose)
+        PrintAndLogEx(SUCCESS, "mapped " _YELLOW_("%zu") " bytes from binary file " _YELLOW_("%s"), *datalen, preferredName);
+    return PM3_SUCCESS;
+#endif
+}
+
+int mapFile_safeEx(const char *preferredName, const char *suffix, void **pdata, size_t *datalen, bool verbose) {
+    return map_file_from(RESOURCES_SUBDIR, preferredName, suffix, pdata, datalen, verbose);
+}
+
+int mapFileDICTIONARY_safe(const char *preferredName, void **pdata, size_t *datalen) {
+    return map_file_from(DICTIONARIES_SUBDIR, preferredName, ".dic", pdata, datalen, false);
+}
+
+void unmapFile(void *data, size_t datalen) {
+    if (data == NULL)
+        return;
+#ifdef _WIN32
+    (void)datalen;
+    free(data);
+#else
+    munmap(data, datalen);
+#endif
+}
+
 int loadFileEML(const char *preferredName, void *data, size_t *datalen) {
 
     if (data == NULL) return PM3_EINVARG;
@@ -960,6 +1153,201 @@ int loadFileEML_safe(const char *preferredName, void **pdata, size_t *datalen) {
     return retval;
 }
 
+// Reads the dumps saveFileJSONex writes from the file text as it is, without a jansson tree.
+// Anything it doesn't expect gives PM3_ENOTIMPL, loadFileJSONex then falls back on jansson
+typedef struct {
+    const char *p;
+    const char *end;
+} json_scan_t;
+
+static bool jsonScanChar(json_scan_t *js, char c) {
+    while (js->p < js->end && isspace((uint8_t)*js->p))
+        js->p++;
+
+    if (js->p >= js->end || *js->p != c)
+        return false;
+
+    js->p++;
+    return true;
+}
+
+// a string without escapes, str points into the file text
+static bool jsonScanString(json_scan_t *js, const char **str, size_t *len) {
+    if (jsonScanChar(js, '"') == false)
+        return false;
+
+    const char *start = js->p;
+    while (js->p < js->end && *js->p != '"') {
+        if (*js->p == '\\')
+            return false;
+        js->p++;
+    }
+    if (js->p >= js->end)
+        return false;
+
+    *str = start;
+    *len = js->p - start;
+    js->p++;
+    return true;
+}
+
+static bool jsonScanSkipValue(json_scan_t *js) {
+    while (js->p < js->end && isspace((uint8_t)*js->p))
+        js->p++;
+
+    int depth = 0;
+    while (js->p < js->end) {
+        char c = *js->p++;
+        if (c == '"') {
+            while (js->p < js->end && *js->p != '"') {
+                if (*js->p == '\\')
+                    js->p++;
+                js->p++;
+            }
+            if (js->p >= js->end)
+                return false;
+            js->p++;
+        } else if (c == '{' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ']') {
+            if (--depth < 0)
+                return false;
+        } else if (depth == 0 && (js->p >= js->end || strchr(",}] \t\r\n", *js->p))) {
+            // number or literal
+            return true;
+        }
+
+        if (depth == 0 && (c == '"' || c == '}' || c == ']'))
+            return true;
+    }
+    return false;
+}
+
+// hex digits only, like JsonLoadBufAsHex the value may be shorter than maxlen
+static bool jsonScanHex(json_scan_t *js, uint8_t *data, size_t maxlen, size_t *len) {
+    const char *str;
+    size_t slen;
+    if (jsonScanString(js, &str, &slen) == false || (slen & 1) || slen / 2 > maxlen)
+        return false;
+
+    for (size_t i = 0; i < slen; i++) {
+        if (isxdigit((uint8_t)str[i]) == false)
+            return false;
+    }
+
+    for (size_t i = 0; i < slen; i += 2) {
+        char hex[3] = { str[i], str[i + 1], 0 };
+        data[i / 2] = strtoul(hex, NULL, 16);
+    }
+
+    *len = slen / 2;
+    return true;
+}
+
+// the blocks object, keys "0", "1" ... in order. Stops at an empty block, at limit blocks or when
+// the next one wouldn't fit, the way loadFileJSONex reads the tree
+static int jsonScanBlocks(json_scan_t *js, uint8_t *udata, size_t maxdatalen, size_t blocksize, size_t limit, size_t *datalen) {
+    if (jsonScanChar(js, '{') == false)
+        return PM3_ENOTIMPL;
+
+    size_t sptr = 0;
+    size_t i = 0;
+    bool stopped = false;
+    bool first = true;
+    while (jsonScanChar(js, '}') == false) {
+        if (first == false && jsonScanChar(js, ',') == false)
+            return PM3_ENOTIMPL;
+        first = false;
+
+        const char *key;
+        size_t keylen;
+        if (jsonScanString(js, &key, &keylen) == false || jsonScanChar(js, ':') == false)
+            return PM3_ENOTIMPL;
+
+        char expected[24];
+        snprintf(expected, sizeof(expected), "%zu", i);
+        if (keylen != strlen(expected) || strncmp(key, expected, keylen))
+            return PM3_ENOTIMPL;
+        i++;
+
+        if (stopped || i > limit) {
+            stopped = true;
+            if (jsonScanSkipValue(js) == false)
+                return PM3_ENOTIMPL;
+            continue;
+        }
+
+        if (sptr + blocksize > maxdatalen)
+            return PM3_EMALLOC;
+
+        size_t len = 0;
+        if (jsonScanHex(js, &udata[sptr], blocksize, &len) == false)
+            return PM3_ENOTIMPL;
+
+        if (len == 0)
+            stopped = true;
+        sptr += len;
+    }
+
+    if (stopped == false && i < limit && sptr + blocksize > maxdatalen)
+        return PM3_EMALLOC;
+
+    *datalen = sptr;
+    return PM3_SUCCESS;
+}
+
+static int loadFileJSONfast(const char *text, size_t textlen, uint8_t *udata, size_t maxdatalen, size_t *datalen) {
+    json_scan_t js = { .p = text, .end = text + textlen };
+    if (jsonScanChar(&js, '{') == false)
+        return PM3_ENOTIMPL;
+
+    char ctype[16] = {0};
+    size_t blocksize = 0;
+    bool loaded = false;
+    bool first = true;
+    while (jsonScanChar(&js, '}') == false) {
+        if (first == false && jsonScanChar(&js, ',') == false)
+            return PM3_ENOTIMPL;
+        first = false;
+
+        const char *key;
+        size_t keylen;
+        if (jsonScanString(&js, &key, &keylen) == false || jsonScanChar(&js, ':') == false)
+            return PM3_ENOTIMPL;
+
+        if (keylen == 8 && strncmp(key, "FileType", 8) == 0) {
+            const char *str;
+            size_t len;
+            if (ctype[0] || jsonScanString(&js, &str, &len) == false || len >= sizeof(ctype))
+                return PM3_ENOTIMPL;
+
+            memcpy(ctype, str, len);
+            if (!strcmp(ctype, "mfcard"))
+                blocksize = 16;
+            else if (!strcmp(ctype, "iclass"))
+                blocksize = 8;
+            else if (!strcmp(ctype, "mfu") || !strcmp(ctype, "hitag") || !strcmp(ctype, "t55x7"))
+                blocksize = 4;
+            else if (strcmp(ctype, "raw"))
+                return PM3_ENOTIMPL;
+        } else if (keylen == 3 && strncmp(key, "raw", 3) == 0 && !strcmp(ctype, "raw") && loaded == false) {
+            if (jsonScanHex(&js, udata, maxdatalen, datalen) == false)
+                return PM3_ENOTIMPL;
+            loaded = true;
+        } else if (keylen == 6 && strncmp(key, "blocks", 6) == 0 && blocksize && loaded == false) {
+            size_t limit = (blocksize == 16 || !strcmp(ctype, "mfu")) ? 256 : maxdatalen / blocksize;
+            int res = jsonScanBlocks(&js, udata, maxdatalen, blocksize, limit, datalen);
+            if (res != PM3_SUCCESS)
+                return res;
+            loaded = true;
+        } else if (jsonScanSkipValue(&js) == false) {
+            return PM3_ENOTIMPL;
+        }
+    }
+
+    return loaded ? PM3_SUCCESS : PM3_ENOTIMPL;
+}
+
 int loadFileJSON(const char *preferredName, void *data, size_t maxdatalen, size_t *datalen, void (*callback)(json_t *)) {
     return loadFileJSONex(preferredName, data, maxdatalen, datalen, true, callback);
 }
@@ -976,6 +1364,25 @@ int loadFileJSONex(const char *preferredName, void *data, size_t maxdatalen, siz
         return PM3_EFILE;
     }
 
+    // the dumps we wrote ourselves are read straight from the mapped file
+    if (callback == NULL) {
+        void *text = NULL;
+        size_t textlen = 0;
+        if (mapFile_safeEx(path, "", &text, &textlen, false) == PM3_SUCCESS) {
+            res = loadFileJSONfast(text, textlen, data, maxdatalen, datalen);
+            unmapFile(text, textlen);
+            if (res != PM3_ENOTIMPL) {
+                if (verbose)
+                    PrintAndLogEx(SUCCESS, "loaded from JSON file " _YELLOW_("%s"), path);
+                free(path);
+                if (res == PM3_EMALLOC)
+                    *datalen = 0;
+                return res;
+            }
+            *datalen = 0;
+        }
+    }
+
     json_error_t error;
     json_t *root = json_load_file(path, 0, &error);
     if (verbose)
@@ -1512,6 +1919,33 @@ static int filelist(const char *path, const char *ext, uint8_t last, bool tentat
     return PM3_SUCCESS;
 }
 
+int listDirFiles(const char *path, const char *ext, char ***names) {
+    struct dirent **namelist;
+    int n = scandir(path, &namelist, NULL, alphasort);
+    if (n < 0)
+        return -1;
+
+    *names = calloc(n + 1, sizeof(char *));
+    if (*names == NULL) {
+        for (int i = 0; i < n; i++)
+            free(namelist[i]);
+        free(namelist);
+        return -1;
+    }
+
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+        char fullpath[1024];
+        snprintf(fullpath, sizeof(fullpath), "%s" PATHSEP "%s", path, namelist[i]->d_name);
+        if (is_directory(fullpath) == false && ((ext == NULL) || str_endswith(namelist[i]->d_name, ext)))
+            (*names)[count++] = strdup(namelist[i]->d_name);
+
+        free(namelist[i]);
+    }
+    free(namelist);
+    return count;
+}
+
 int searchAndList(const char *pm3dir, const char *ext) {
     // display in same order as searched by searchFile
     // try pm3 dirs in current workdir (dev mode)
@@ -1542,6 +1976,138 @@ int searchAndList(const char *pm3dir, const char *ext) {
     return PM3_SUCCESS;
 }
 
+// Index of the files in the pm3 directories searchFinalFile probes, built on the first search.
+// A name found in it costs one stat to make sure it is still there instead of probing every
+// directory, a name not in it is probed as before. Reset when the preferences are loaded
+typedef struct {
+    const char *pm3dir;
+    char *name;
+    char *path;
+    int order;                  // of the search, the lowest one wins
+} search_index_entry_t;
+
+static const char *search_index_dirs[] = {
+    DICTIONARIES_SUBDIR, LUA_LIBRARIES_SUBDIR, LUA_SCRIPTS_SUBDIR, CMD_SCRIPTS_SUBDIR, PYTHON_SCRIPTS_SUBDIR, RESOURCES_SUBDIR
+};
+
+static pthread_mutex_t search_index_lock = PTHREAD_MUTEX_INITIALIZER;
+static search_index_entry_t *search_index = NULL;
+static size_t search_index_count = 0;
+static bool search_index_built = false;
+
+static int search_index_cmp(const void *a, const void *b) {
+    const search_index_entry_t *ea = a, *eb = b;
+    int res = strcmp(ea->pm3dir, eb->pm3dir);
+    if (res == 0)
+        res = strcmp(ea->name, eb->name);
+    if (res == 0)
+        res = ea->order - eb->order;
+    return res;
+}
+
+static void search_index_add_dir(const char *root, const char *suffix, int order, size_t *capacity) {
+    for (size_t d = 0; d < ARRAYLEN(search_index_dirs); d++) {
+        const char *pm3dir = search_index_dirs[d];
+        char base[FILE_PATH_SIZE];
+        snprintf(base, sizeof(base), "%s%s%s", root, suffix, pm3dir);
+
+        char **names = NULL;
+        int n = listDirFiles(base, NULL, &names);
+        for (int i = 0; i < n; i++) {
+            if (search_index_count == *capacity) {
+                size_t newcap = *capacity ? *capacity * 2 : 256;
+                search_index_entry_t *tmp = realloc(search_index, newcap * sizeof(search_index_entry_t));
+                if (tmp == NULL) {
+                    free(names[i]);
+                    continue;
+                }
+                search_index = tmp;
+                *capacity = newcap;
+            }
+            char *path = calloc(strlen(base) + strlen(names[i]) + 1, sizeof(char));
+            if (path == NULL) {
+                free(names[i]);
+                continue;
+            }
+            strcpy(path, base);
+            strcat(path, names[i]);
+            search_index[search_index_count++] = (search_index_entry_t) {pm3dir, names[i], path, order};
+        }
+        if (n >= 0)
+            free(names);
+    }
+}
+
+// under search_index_lock
+static void search_index_build(void) {
+    size_t capacity = 0;
+    const char *user_path = get_my_user_directory();
+    if (user_path != NULL)
+        search_index_add_dir(user_path, PM3_USER_DIRECTORY, 0, &capacity);
+
+    const char *exec_path = get_my_executable_directory();
+    if (exec_path != NULL) {
+        search_index_add_dir(exec_path, "", 1, &capacity);
+        search_index_add_dir(exec_path, PM3_SHARE_RELPATH, 2, &capacity);
+    }
+
+    // one entry per name, the one the search would find first
+    qsort(search_index, search_index_count, sizeof(search_index_entry_t), search_index_cmp);
+    size_t n = 0;
+    for (size_t i = 0; i < search_index_count; i++) {
+        if (n && strcmp(search_index[n - 1].pm3dir, search_index[i].pm3dir) == 0 && strcmp(search_index[n - 1].name, search_index[i].name) == 0) {
+            free(search_index[i].name);
+            free(search_index[i].path);
+            continue;
+        }
+        search_index[n++] = search_index[i];
+    }
+    search_index_count = n;
+    search_index_built = true;
+}
+
+// a copy of the indexed path of filename in pm3dir, or NULL
+static char *search_index_find(const char *pm3dir, const char *filename) {
+    char *found = NULL;
+    pthread_mutex_lock(&search_index_lock);
+    if (search_index_built == false)
+        search_index_build();
+
+    size_t lo = 0, hi = search_index_count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        search_index_entry_t *e = &search_index[mid];
+        int res = strcmp(e->pm3dir, pm3dir);
+        if (res == 0)
+            res = strcmp(e->name, filename);
+        if (res == 0) {
+            found = calloc(strlen(e->path) + 1, sizeof(char));
+            if (found != NULL)
+                strcpy(found, e->path);
+            break;
+        }
+        if (res < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    pthread_mutex_unlock(&search_index_lock);
+    return found;
+}
+
+void searchFileIndexReset(void) {
+    pthread_mutex_lock(&search_index_lock);
+    for (size_t i = 0; i < search_index_count; i++) {
+        free(search_index[i].name);
+        free(search_index[i].path);
+    }
+    free(search_index);
+    search_index = NULL;
+    search_index_count = 0;
+    search_index_built = false;
+    pthread_mutex_unlock(&search_index_lock);
+}
+
 static int searchFinalFile(char **foundpath, const char *pm3dir, const char *searchname, bool silent) {
     if ((foundpath == NULL) || (pm3dir == NULL) || (searchname == NULL)) return PM3_ESOFT;
     // explicit absolute (/) or relative path (./) => try only to match it directly
@@ -1575,6 +2141,21 @@ static int searchFinalFile(char **foundpath, const char *pm3dir, const char *sea
             return PM3_SUCCESS;
         }
     }
+    // the files of the pm3 dirs we know of
+    char *indexed = search_index_find(pm3dir, filename);
+    if (indexed != NULL) {
+        if (fileExists(indexed)) {
+            free(filename);
+            *foundpath = indexed;
+            if ((g_debugMode == 2) && (!silent)) {
+                PrintAndLogEx(INFO, "Found %s (indexed)", *foundpath);
+            }
+            return PM3_SUCCESS;
+        }
+        // gone since, look again everywhere
+        free(indexed);
+        searchFileIndexReset();
+    }
     // try pm3 dirs in user .proxmark3 (user mode)
     const char *user_path = get_my_user_directory();
     if (user_path != NULL) {
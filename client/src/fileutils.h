@@ -91,6 +91,7 @@ char *newfilenamemcopy(const char *preferredName, const char *suffix);
  * @return 0 for ok, 1 for failz
  */
 int saveFile(const char *preferredName, const char *suffix, const void *data, size_t datalen);
+int saveFileEx(const char *preferredName, const char *suffix, const void *data, size_t datalen, bool verbose);
 
 /**
  * @brief Utility function to save data to a textfile (EML). This method takes a preferred name, but if that
@@ -104,6 +105,7 @@ int saveFile(const char *preferredName, const char *suffix, const void *data, si
  * @return 0 for ok, 1 for failz
 */
 int saveFileEML(const char *preferredName, uint8_t *data, size_t datalen, size_t blocksize);
+int saveFileEMLex(const char *preferredName, uint8_t *data, size_t datalen, size_t blocksize, bool verbose);
 
 /** STUB
  * @brief Utility function to save JSON data to a file. This method takes a preferred name, but if that
@@ -179,6 +181,30 @@ int loadFile(const char *preferredName, const char *suffix, void *data, size_t m
 */
 int loadFile_safe(const char *preferredName, const char *suffix, void **pdata, size_t *datalen);
 int loadFile_safeEx(const char *preferredName, const char *suffix, void **pdata, size_t *datalen, bool verbose);
+
+/**
+ * @brief Utility function to map a binary file read only. Same search rules as loadFile_safe,
+ * but the file is not read into memory up front. The mapping is copy on write. Falls back to loadFile_safe where mmap is missing.
+ *
+ * @param preferredName
+ * @param suffix the file suffix. Including the ".".
+ * @param pdata The mapped file, release with unmapFile
+ * @param datalen the size of the mapping
+ * @return PM3_SUCCESS for ok, PM3_E* for failz
+*/
+int mapFile_safe(const char *preferredName, const char *suffix, void **pdata, size_t *datalen);
+int mapFile_safeEx(const char *preferredName, const char *suffix, void **pdata, size_t *datalen, bool verbose);
+void unmapFile(void *data, size_t datalen);
+/**
+ * @brief Utility function to map a dictionary file, the text as it is. Same search rules as loadFileDICTIONARY_safe.
+ * Release with unmapFile
+ *
+ * @param preferredName
+ * @param pdata The mapped file
+ * @param datalen the size of the mapping
+ * @return PM3_SUCCESS for ok, PM3_E* for failz
+*/
+int mapFileDICTIONARY_safe(const char *preferredName, void **pdata, size_t *datalen);
 /**
  * @brief  Utility function to load data from a textfile (EML). This method takes a preferred name.
  * E.g. dumpdata-15.txt
@@ -267,6 +293,11 @@ int convert_mfu_dump_format(uint8_t **dump, size_t *dumplen, bool verbose);
 mfu_df_e detect_mfu_dump_format(uint8_t **dump, size_t *dumplen, bool verbose);
 
 int searchAndList(const char *pm3dir, const char *ext);
+// Sorted names of the files in path, not directories, ending with ext if not NULL. The list ends
+// with a NULL, free every name and the list. Returns how many or -1 if path can't be read
+int listDirFiles(const char *path, const char *ext, char ***names);
 int searchFile(char **foundpath, const char *pm3dir, const char *searchname, const char *suffix, bool silent);
+// searchFile keeps an index of the pm3 directories, forget it so they are read again
+void searchFileIndexReset(void);
 
 #endif // FILEUTILS_H
@@ -21,6 +21,7 @@
 #include "at91sam7s512.h"
 #include "util_posix.h"
 #include "comms.h"
+#include "crc32.h"
 
 #define FLASH_START            0x100000
 
@@ -29,7 +30,11 @@
 
 #define BLOCK_SIZE             0x200
 
-#define FLASHER_VERSION        BL_VERSION_1_0_0
+#define FLASHER_VERSION        BL_VERSION_1_2_0
+
+// bootloader can report block checksums, only changed blocks get written
+static bool bl_block_crc = false;
+static bool bl_fast_write = false;
 
 static const uint8_t elf_ident[] = {
     0x7f, 'E', 'L', 'F',
@@ -423,6 +428,9 @@ int flash_start_flashing(int enable_bl_writes, char *serial_port_name, uint32_t
     if (ret != PM3_SUCCESS)
         return ret;
 
+    bl_block_crc = (state & DEVICE_INFO_FLAG_UNDERSTANDS_BLOCK_CRC);
+    bl_fast_write = (state & DEVICE_INFO_FLAG_UNDERSTANDS_FAST_WRITE);
+
     if (state & DEVICE_INFO_FLAG_UNDERSTANDS_CHIP_INFO) {
         SendCommandBL(CMD_CHIP_INFO, 0, 0, 0, NULL, 0);
         PacketResponseNG resp;
@@ -503,13 +511,39 @@ int flash_start_flashing(int enable_bl_writes, char *serial_port_name, uint32_t
     return PM3_SUCCESS;
 }
 
-static int write_block(uint32_t address, uint8_t *data, uint32_t length) {
+// checksums of count blocks as they are in flash now
+static int read_block_crcs(uint32_t address, uint32_t count, uint32_t *crcs) {
+    const uint32_t max = PM3_CMD_DATA_SIZE / sizeof(uint32_t);
+    while (count) {
+        uint32_t n = MIN(count, max);
+        PacketResponseNG resp;
+        SendCommandBL(CMD_BL_BLOCK_CRC, address, n, 0, NULL, 0);
+        if (WaitForResponseTimeout(CMD_UNKNOWN, &resp, 2000) == false) {
+            return PM3_ETIMEOUT;
+        }
+        if (resp.cmd != CMD_BL_BLOCK_CRC || resp.oldarg[1] != n) {
+            return PM3_ESOFT;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            crcs[i] = le32(resp.data.asDwords[i]);
+        }
+        crcs += n;
+        count -= n;
+        address += n * BLOCK_SIZE;
+    }
+    return PM3_SUCCESS;
+}
+
+static void send_block(uint32_t address, uint8_t *data, uint32_t length) {
     uint8_t block_buf[BLOCK_SIZE];
     memset(block_buf, 0xFF, BLOCK_SIZE);
     memcpy(block_buf, data, length);
-    PacketResponseNG resp;
     // SendCommandBL(CMD_FINISH_WRITE, address, 0, 0, block_buf, length);
-    SendCommandBL(CMD_FINISH_WRITE, address, CMD_ACK, CMD_ACK + CMD_NACK, block_buf, length);
+    SendCommandBL(CMD_FINISH_WRITE, address, CMD_ACK, (bl_fast_write) ? FINISH_WRITE_FAST_MAGIC : CMD_ACK + CMD_NACK, block_buf, length);
+}
+
+static int wait_block_ack(void) {
+    PacketResponseNG resp;
     int ret = wait_for_ack(&resp);
     if (ret && resp.oldarg[0]) {
         uint32_t lock_bits = resp.oldarg[0] >> 16;
@@ -524,6 +558,21 @@ static int write_block(uint32_t address, uint8_t *data, uint32_t length) {
     return ret;
 }
 
+// a fast write leaves the last page programming, any command waits for it and NACKs if it failed
+static int wait_last_page(void) {
+    PacketResponseNG resp;
+    SendCommandBL(CMD_BL_VERSION, 0, 0, 0, NULL, 0);
+    WaitForResponse(CMD_UNKNOWN, &resp);
+    if (resp.cmd != CMD_BL_VERSION) {
+        PrintAndLogEx(ERR, "Error: Unexpected reply 0x%04x %s (expected BL_VERSION)",
+                      resp.cmd,
+                      (resp.cmd == CMD_NACK) ? "NACK" : ""
+                     );
+        return PM3_ESOFT;
+    }
+    return PM3_SUCCESS;
+}
+
 const char ice[] =
     "...................................................................\n        @@@  @@@@@@@ @@@@@@@@ @@@@@@@@@@   @@@@@@  @@@  @@@\n"
     "        @@! !@@      @@!      @@! @@! @@! @@!  @@@ @@!@!@@@\n        !!@ !@!      @!!!:!   @!! !!@ @!@ @!@!@!@! @!@@!!@!\n"
@@ -533,7 +582,9 @@ const char ice[] =
     ;
 
 // Write a file's segments to Flash
-int flash_write(flash_file_t *ctx) {
+// unless force is set, blocks whose checksum matches what is in flash are skipped. An interrupted
+// flash resumes this way, a second run only writes what is still missing
+int flash_write(flash_file_t *ctx, bool force) {
     int len = 0;
 
     PrintAndLogEx(SUCCESS, "Writing segments for file: %s", ctx->filename);
@@ -550,17 +601,51 @@ int flash_write(flash_file_t *ctx) {
         PrintAndLogEx(SUCCESS, " 0x%08x..0x%08x [0x%x / %u blocks]", seg->start, end - 1, length, blocks);
         fflush(stdout);
         int block = 0;
+        uint32_t skipped = 0;
         uint8_t *data = seg->data;
         uint32_t baddr = seg->start;
 
+        // fast writes keep a window of blocks in flight, the answers come in order
+        uint32_t window = (bl_fast_write) ? BL_FAST_WRITE_WINDOW : 1;
+        int inflight[BL_FAST_WRITE_WINDOW];
+        uint32_t sent = 0, acked = 0;
+
+        uint32_t *crcs = NULL;
+        if (bl_block_crc && force == false) {
+            crcs = calloc(blocks, sizeof(uint32_t));
+            if (crcs && read_block_crcs(seg->start, blocks, crcs) != PM3_SUCCESS) {
+                PrintAndLogEx(WARNING, "Could not read block checksums, writing all blocks");
+                free(crcs);
+                crcs = NULL;
+            }
+        }
+
         while (length) {
             uint32_t block_size = length;
             if (block_size > BLOCK_SIZE)
                 block_size = BLOCK_SIZE;
 
-            if (write_block(baddr, data, block_size) < 0) {
-                PrintAndLogEx(ERR, "Error writing block %d of %u", block, blocks);
-                return PM3_EFATAL;
+            bool same = false;
+            if (crcs) {
+                uint8_t block_buf[BLOCK_SIZE];
+                memset(block_buf, 0xFF, BLOCK_SIZE);
+                memcpy(block_buf, data, block_size);
+                same = (crc32_update(CRC32_PRESET, block_buf, BLOCK_SIZE) == crcs[block]);
+            }
+
+            if (same) {
+                skipped++;
+            } else {
+                send_block(baddr, data, block_size);
+                inflight[sent++ % window] = block;
+                if (sent - acked == window) {
+                    if (wait_block_ack() < 0) {
+                        PrintAndLogEx(ERR, "Error writing block %d of %u", inflight[acked % window], blocks);
+                        free(crcs);
+                        return PM3_EFATAL;
+                    }
+                    acked++;
+                }
             }
 
             data += block_size;
@@ -578,7 +663,25 @@ int flash_write(flash_file_t *ctx) {
             }
             fflush(stdout);
         }
-        PrintAndLogEx(NORMAL, " " _GREEN_("OK"));
+        free(crcs);
+
+        while (acked < sent) {
+            if (wait_block_ack() < 0) {
+                PrintAndLogEx(ERR, "Error writing block %d of %u", inflight[acked % window], blocks);
+                return PM3_EFATAL;
+            }
+            acked++;
+        }
+        if (bl_fast_write && sent && wait_last_page() != PM3_SUCCESS) {
+            PrintAndLogEx(ERR, "Error writing block %d of %u", inflight[(sent - 1) % window], blocks);
+            return PM3_EFATAL;
+        }
+
+        if (skipped) {
+            PrintAndLogEx(NORMAL, " " _GREEN_("OK") " ( %u unchanged blocks skipped )", skipped);
+        } else {
+            PrintAndLogEx(NORMAL, " " _GREEN_("OK"));
+        }
         fflush(stdout);
     }
     return PM3_SUCCESS;
@@ -10,6 +10,7 @@
 #include "graph.h"
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #include "ui.h"
 #include "proxgui.h"
 #include "util.h"    //param_get32ex
@@ -17,15 +18,45 @@
 #include "cmddata.h" //for g_debugmode
 
 
-int GraphBuffer[MAX_GRAPH_TRACE_LEN];
+// starts out static, moves to the heap once a trace needs more
+static int GraphStorage[MAX_GRAPH_TRACE_LEN];
+static size_t GraphCapacity = MAX_GRAPH_TRACE_LEN;
+int *GraphBuffer = GraphStorage;
 size_t GraphTraceLen;
 
-/* write a manchester bit to the graph
-TODO,  verfy that this doesn't overflow buffer  (iceman)
-*/
+// make room for len samples, keeps the current ones
+bool GraphReserve(size_t len) {
+    if (len <= GraphCapacity)
+        return true;
+
+    size_t cap = GraphCapacity;
+    while (cap < len)
+        cap *= 2;
+
+    int *p;
+    if (GraphBuffer == GraphStorage) {
+        p = calloc(cap, sizeof(int));
+        if (p)
+            memcpy(p, GraphStorage, GraphTraceLen * sizeof(int));
+    } else {
+        p = realloc(GraphBuffer, cap * sizeof(int));
+    }
+    if (p == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory for %zu samples", len);
+        return false;
+    }
+    GraphBuffer = p;
+    GraphCapacity = cap;
+    return true;
+}
+
+/* write a manchester bit to the graph */
 void AppendGraph(bool redraw, uint16_t clock, int bit) {
     uint8_t half = clock / 2;
     uint8_t i;
+    if (GraphReserve(GraphTraceLen + clock) == false)
+        return;
+
     //set first half the clock bit (all 1's or 0's for a 0 or 1 bit)
     for (i = 0; i < half; ++i)
         GraphBuffer[GraphTraceLen++] = bit;
@@ -47,22 +78,126 @@ size_t ClearGraph(bool redraw) {
         RepaintGraphWindow();
     return gtl;
 }
+// Snapshots. Taking one costs a copy of the trace, into the spare buffer when
+// there is one. Restoring the last reference swaps the buffers instead of
+// copying back, the old GraphBuffer becomes the spare for the next snapshot.
+static int *GraphSpare = NULL;
+static size_t GraphSpareCap = 0;
+static pthread_mutex_t GraphSpareLock = PTHREAD_MUTEX_INITIALIZER;
+
+static void graph_spare_put(int *buf, size_t cap) {
+    pthread_mutex_lock(&GraphSpareLock);
+    if (cap > GraphSpareCap) {
+        if (GraphSpare != GraphStorage)
+            free(GraphSpare);
+        GraphSpare = buf;
+        GraphSpareCap = cap;
+        buf = NULL;
+    }
+    pthread_mutex_unlock(&GraphSpareLock);
+    if (buf != GraphStorage)
+        free(buf);
+}
+
+graph_snapshot_t *graph_snapshot_take(void) {
+    graph_snapshot_t *s = calloc(1, sizeof(graph_snapshot_t));
+    if (s == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return NULL;
+    }
+
+    // same capacity as GraphBuffer, so the two can trade places on restore
+    pthread_mutex_lock(&GraphSpareLock);
+    if (GraphSpareCap >= GraphCapacity) {
+        s->buf = GraphSpare;
+        s->cap = GraphSpareCap;
+        GraphSpare = NULL;
+        GraphSpareCap = 0;
+    }
+    pthread_mutex_unlock(&GraphSpareLock);
+
+    if (s->buf == NULL) {
+        s->buf = malloc(GraphCapacity * sizeof(int));
+        s->cap = GraphCapacity;
+        if (s->buf == NULL) {
+            PrintAndLogEx(WARNING, "Failed to allocate memory");
+            free(s);
+            return NULL;
+        }
+    }
+
+    memcpy(s->buf, GraphBuffer, GraphTraceLen * sizeof(int));
+    s->len = GraphTraceLen;
+    s->grid_offset = GridOffset;
+    s->refs = 1;
+    return s;
+}
+
+graph_snapshot_t *graph_snapshot_hold(graph_snapshot_t *s) {
+    if (s)
+        __atomic_add_fetch(&s->refs, 1, __ATOMIC_RELAXED);
+    return s;
+}
+
+void graph_snapshot_release(graph_snapshot_t *s) {
+    if (s == NULL)
+        return;
+    if (__atomic_sub_fetch(&s->refs, 1, __ATOMIC_ACQ_REL) != 0)
+        return;
+    graph_spare_put(s->buf, s->cap);
+    free(s);
+}
+
+bool graph_snapshot_restore(graph_snapshot_t *s) {
+    if (s == NULL)
+        return false;
+
+    // someone else still reads it, copy
+    if (__atomic_load_n(&s->refs, __ATOMIC_ACQUIRE) != 1 || s->cap < GraphCapacity) {
+        bool res = GraphReserve(s->len);
+        if (res) {
+            memcpy(GraphBuffer, s->buf, s->len * sizeof(int));
+            GraphTraceLen = s->len;
+            GridOffset = s->grid_offset;
+        }
+        graph_snapshot_release(s);
+        return res;
+    }
+
+    int *old = GraphBuffer;
+    size_t old_cap = GraphCapacity;
+    GraphBuffer = s->buf;
+    GraphCapacity = s->cap;
+    GraphTraceLen = s->len;
+    GridOffset = s->grid_offset;
+    // the static storage is not freed by GraphReserve, it has to stay GraphBuffer
+    // or a spare, nothing else points to it
+    s->buf = old;
+    s->cap = old_cap;
+    graph_snapshot_release(s);
+    return true;
+}
+
+graph_view_t graph_snapshot_view(const graph_snapshot_t *s, size_t offset, size_t len) {
+    graph_view_t v = { NULL, 0 };
+    if (s == NULL || offset >= s->len)
+        return v;
+    v.samples = s->buf + offset;
+    v.len = (len > s->len - offset) ? s->len - offset : len;
+    return v;
+}
+
 // option '1' to save GraphBuffer any other to restore
+// A restore uses up the save, a second one without a save in between does nothing
 void save_restoreGB(uint8_t saveOpt) {
-    static int SavedGB[MAX_GRAPH_TRACE_LEN];
-    static size_t SavedGBlen = 0;
-    static bool GB_Saved = false;
-    static int SavedGridOffsetAdj = 0;
+    static graph_snapshot_t *SavedGB = NULL;
 
     if (saveOpt == GRAPH_SAVE) { //save
-        memcpy(SavedGB, GraphBuffer, sizeof(GraphBuffer));
-        SavedGBlen = GraphTraceLen;
-        GB_Saved = true;
-        SavedGridOffsetAdj = GridOffset;
-    } else if (GB_Saved) { //restore
-        memcpy(GraphBuffer, SavedGB, sizeof(GraphBuffer));
-        GraphTraceLen = SavedGBlen;
-        GridOffset = SavedGridOffsetAdj;
+        graph_snapshot_release(SavedGB);
+        SavedGB = graph_snapshot_take();
+    } else if (SavedGB) { //restore
+        graph_snapshot_restore(SavedGB);
+        SavedGB = NULL;
         RepaintGraphWindow();
     }
 }
@@ -72,8 +207,8 @@ void setGraphBuf(uint8_t *buff, size_t size) {
 
     ClearGraph(false);
 
-    if (size > MAX_GRAPH_TRACE_LEN)
-        size = MAX_GRAPH_TRACE_LEN;
+    if (GraphReserve(size) == false)
+        return;
 
     for (size_t i = 0; i < size; ++i)
         GraphBuffer[i] = buff[i] - 128;
@@ -86,14 +221,47 @@ size_t getFromGraphBuf(uint8_t *buff) {
     if (buff == NULL) return 0;
     if (GraphTraceLen == 0) return 0;
 
-    size_t i;
-    for (i = 0; i < GraphTraceLen; ++i) {
+    // branch free, so it vectorizes. Every demod starts with this. The globals go in locals, else
+    // the stores to buff could change them and they are reloaded on every sample
+    int *graph = GraphBuffer;
+    size_t len = GraphTraceLen;
+    for (size_t i = 0; i < len; ++i) {
         //trim
-        if (GraphBuffer[i] > 127) GraphBuffer[i] = 127;
-        if (GraphBuffer[i] < -127) GraphBuffer[i] = -127;
-        buff[i] = (uint8_t)(GraphBuffer[i] + 128);
+        int v = graph[i];
+        v = (v > 127) ? 127 : v;
+        v = (v < -127) ? -127 : v;
+        graph[i] = v;
+        buff[i] = (uint8_t)(v + 128);
     }
-    return i;
+    return len;
+}
+
+// same as getFromGraphBuf(), of a window of a snapshot. The snapshot is not
+// written to, so views of it can be demodulated by several threads at once
+size_t getFromGraphView(graph_view_t view, uint8_t *buff) {
+    if (buff == NULL) return 0;
+
+    const int *graph = view.samples;
+    size_t len = view.len;
+    for (size_t i = 0; i < len; ++i) {
+        int v = graph[i];
+        v = (v > 127) ? 127 : v;
+        v = (v < -127) ? -127 : v;
+        buff[i] = (uint8_t)(v + 128);
+    }
+    return len;
+}
+
+// set signal properties low/high/mean/amplitude and is_noise detection from the graph
+void computeGraphSignalProperties(void) {
+    uint8_t *bits = calloc(GraphTraceLen + 1, sizeof(uint8_t));
+    if (bits == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return;
+    }
+    size_t size = getFromGraphBuf(bits);
+    computeSignalProperties(bits, size);
+    free(bits);
 }
 
 // A simple test to see if there is any data inside Graphbuffer.
@@ -159,7 +327,7 @@ int GetAskClock(const char *str, bool printAns) {
 
     // Auto-detect clock
 
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN,  sizeof(uint8_t));
+    uint8_t *bits = calloc(MAX(GraphTraceLen, MAX_GRAPH_TRACE_LEN), sizeof(uint8_t));
     if (bits == NULL) {
         PrintAndLogEx(WARNING, "Failed to allocate memory");
         return -1;
@@ -196,7 +364,7 @@ uint8_t GetPskCarrier(const char *str, bool printAns) {
 
     uint8_t carrier = 0;
 
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN,  sizeof(uint8_t));
+    uint8_t *bits = calloc(MAX(GraphTraceLen, MAX_GRAPH_TRACE_LEN), sizeof(uint8_t));
     if (bits == NULL) {
         PrintAndLogEx(WARNING, "Failed to allocate memory");
         return -1;
@@ -230,7 +398,7 @@ int GetPskClock(const char *str, bool printAns) {
         return clock1;
 
     // Auto-detect clock
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN,  sizeof(uint8_t));
+    uint8_t *bits = calloc(MAX(GraphTraceLen, MAX_GRAPH_TRACE_LEN), sizeof(uint8_t));
     if (bits == NULL) {
         PrintAndLogEx(WARNING, "Failed to allocate memory");
         return -1;
@@ -268,7 +436,7 @@ int GetNrzClock(const char *str, bool printAns) {
         return clock1;
 
     // Auto-detect clock
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN,  sizeof(uint8_t));
+    uint8_t *bits = calloc(MAX(GraphTraceLen, MAX_GRAPH_TRACE_LEN), sizeof(uint8_t));
     if (bits == NULL) {
         PrintAndLogEx(WARNING, "Failed to allocate memory");
         return -1;
@@ -324,7 +492,7 @@ bool fskClocks(uint8_t *fc1, uint8_t *fc2, uint8_t *rf1, int *firstClockEdge) {
     if (getSignalProperties()->isnoise)
         return false;
 
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN,  sizeof(uint8_t));
+    uint8_t *bits = calloc(MAX(GraphTraceLen, MAX_GRAPH_TRACE_LEN), sizeof(uint8_t));
     if (bits == NULL) {
         PrintAndLogEx(WARNING, "Failed to allocate memory");
         return false;
@@ -358,3 +526,29 @@ bool fskClocks(uint8_t *fc1, uint8_t *fc2, uint8_t *rf1, int *firstClockEdge) {
     return true;
 }
 
+void graph_ring_push(graph_ring_t *ring, const uint8_t *samples, uint16_t len) {
+    for (uint16_t i = 0; i < len; i++) {
+        ring->buf[ring->head++] = samples[i];
+        if (ring->head == ring->size)
+            ring->head = 0;
+    }
+    ring->total += len;
+}
+
+// the last n samples of the ring to the graph buffer, same scaling as getSamples
+void graph_ring_to_graph(graph_ring_t *ring, uint32_t n) {
+    n = MIN(n, MIN(ring->total, ring->size));
+    uint32_t pos = (ring->head + ring->size - n) % ring->size;
+    for (uint32_t i = 0; i < n; i++) {
+        GraphBuffer[i] = ((int)ring->buf[pos]) - 127;
+        if (++pos == ring->size)
+            pos = 0;
+    }
+    GraphTraceLen = n;
+
+    // set signal properties low/high/mean/amplitude and is_noise detection
+    computeGraphSignalProperties();
+
+    setClockGrid(0, 0);
+    DemodBufferLen = 0;
+}
@@ -23,10 +23,46 @@ bool HasGraphData(void);
 void setGraphBuf(uint8_t *buff, size_t size);
 void save_restoreGB(uint8_t saveOpt);
 size_t getFromGraphBuf(uint8_t *buff);
+void computeGraphSignalProperties(void);
+bool GraphReserve(size_t len);
 void convertGraphFromBitstream(void);
 void convertGraphFromBitstreamEx(int hi, int low);
 bool isGraphBitstream(void);
 
+// ring of the last size 8 bit samples of a streamed capture, for the graph buffer
+typedef struct {
+    uint8_t *buf;
+    uint32_t size;
+    uint32_t head;      // next write position
+    uint64_t total;     // samples received
+} graph_ring_t;
+
+void graph_ring_push(graph_ring_t *ring, const uint8_t *samples, uint16_t len);
+void graph_ring_to_graph(graph_ring_t *ring, uint32_t n);
+
+// read only copy of the graph, shared by reference. Released by the last holder
+typedef struct {
+    int *buf;
+    size_t cap;
+    size_t len;
+    int grid_offset;
+    uint32_t refs;
+} graph_snapshot_t;
+
+// window of the samples of a snapshot
+typedef struct {
+    const int *samples;
+    size_t len;
+} graph_view_t;
+
+graph_snapshot_t *graph_snapshot_take(void);
+graph_snapshot_t *graph_snapshot_hold(graph_snapshot_t *s);
+void graph_snapshot_release(graph_snapshot_t *s);
+// back to GraphBuffer, gives up the reference of the caller
+bool graph_snapshot_restore(graph_snapshot_t *s);
+graph_view_t graph_snapshot_view(const graph_snapshot_t *s, size_t offset, size_t len);
+size_t getFromGraphView(graph_view_t view, uint8_t *buff);
+
 int GetAskClock(const char *str, bool printAns);
 int GetPskClock(const char *str, bool printAns);
 uint8_t GetPskCarrier(const char *str, bool printAns);
@@ -34,11 +70,13 @@ int GetNrzClock(const char *str, bool printAns);
 int GetFskClock(const char *str, bool printAns);
 bool fskClocks(uint8_t *fc1, uint8_t *fc2, uint8_t *rf1, int *firstClockEdge);
 
+// GraphBuffer grows on demand, with GraphReserve(). This is what it starts with
+// and the least size of the buffers handed to getFromGraphBuf()
 #define MAX_GRAPH_TRACE_LEN (40000 * 8)
 #define GRAPH_SAVE 1
 #define GRAPH_RESTORE 0
 
-extern int GraphBuffer[MAX_GRAPH_TRACE_LEN];
+extern int *GraphBuffer;
 extern size_t GraphTraceLen;
 
 #ifdef __cplusplus
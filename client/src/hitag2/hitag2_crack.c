@@ -0,0 +1,413 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Hitag2 key recovery from reader authentications
+//
+// Fast correlation attack of Garcia et al, as in tools/hitag2crack/crack4 by
+// Kevin Sheldrake. The lower 16 key bits are guessed, then every round scores
+// each guess on how likely it produces the keystream of all authentications,
+// keeps the better half and extends it by one key bit. The surviving 48 bit
+// guesses are tested with the bitsliced HiTag2 core.
+//-----------------------------------------------------------------------------
+
+#include "hitag2_crack.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include "commonutil.h"     // reflect8
+#include "pm3_cmd.h"
+#include "ht2bitslice.h"
+#include "ui.h"
+#include "util.h"           // num_CPUs, kbd_enter_pressed
+#include "util_posix.h"     // msclock
+
+// macros to select bits from lfsr states - from RFIDler code
+#define pickbits2_2(S, A, B)       ( ((S >> A) & 3) | ((S >> (B - 2)) & 0xC) )
+#define pickbits1x4(S, A, B, C, D) ( ((S >> A) & 1) | ((S >> (B - 1)) & 2) | \
+                                   ((S >> (C - 2)) & 4) | ((S >> (D - 3)) & 8) )
+#define pickbits1_1_2(S, A, B, C)  ( ((S >> A) & 1) | ((S >> (B - 1)) & 2) | \
+                                   ((S >> (C - 2)) & 0xC) )
+#define pickbits2_1_1(S, A, B, C)  ( ((S >> A) & 3) | ((S >> (B - 2)) & 4) | \
+                                   ((S >> (C - 3)) & 8) )
+#define pickbits1_2_1(S, A, B, C)  ( ((S >> A) & 1) | ((S >> (B - 1)) & 6) | \
+                                   ((S >> (C - 3)) & 8) )
+
+// boolean tables for fns a, b and c - from RFIDler code
+static const uint64_t ht2_function4a = 0x2C79; // 0010 1100 0111 1001
+static const uint64_t ht2_function4b = 0x6671; // 0110 0110 0111 0001
+static const uint64_t ht2_function5c = 0x7907287B; // 0111 1001 0000 0111 0010 1000 0111 1011
+
+// probabilities of getting a 1 from each function, given a known least-sig pattern.
+// first index is num bits in known part, second is the bit pattern of the known part
+static const double pfna[][8] = {
+    {0.50000, 0.50000, },
+    {0.50000, 0.50000, 0.50000, 0.50000, },
+    {0.50000, 0.00000, 0.50000, 1.00000, 0.50000, 1.00000, 0.50000, 0.00000, },
+};
+static const double pfnb[][8] = {
+    {0.62500, 0.37500, },
+    {0.50000, 0.75000, 0.75000, 0.00000, },
+    {0.50000, 0.50000, 0.50000, 0.00000, 0.50000, 1.00000, 1.00000, 0.00000, },
+};
+static const double pfnc[][16] = {
+    {0.50000, 0.50000, },
+    {0.62500, 0.62500, 0.37500, 0.37500, },
+    {0.75000, 0.50000, 0.25000, 0.75000, 0.50000, 0.75000, 0.50000, 0.00000, },
+    {1.00000, 1.00000, 0.50000, 0.50000, 0.50000, 0.50000, 0.50000, 0.00000, 0.50000, 0.00000, 0.00000, 1.00000, 0.50000, 1.00000, 0.50000, 0.00000, },
+};
+
+// number of relevant bits for a number of confirmed bits in a pre-shifted state
+static const uint8_t packed_size[] = { 0,  0,  0,  1,  2,  2,  3,  4,  4,  5,  5,  5,  5,  6,  6,  7,  8,
+                                       8,  9,  9,  9,  9, 10, 10, 11, 11, 11, 12, 12, 13, 14, 14, 15,
+                                       15, 16, 17, 17, 17, 17, 17, 17, 17, 17, 17, 18, 19, 19, 20, 20
+                                     };
+
+// one key guess, b0to31 holds the keystream of the init phase per authentication
+typedef struct {
+    uint64_t key;
+    double score;
+    uint32_t b0to31[];
+} ht2_guess_t;
+
+typedef struct {
+    uint64_t uid;
+    uint32_t enc_nR[HT2_CRACK_MAX_NONCES];
+    uint32_t ks[HT2_CRACK_MAX_NONCES];
+    uint32_t count;
+    uint64_t *table;
+    size_t words;           // size of one guess in the table, in uint64_t
+    uint32_t num_guesses;
+} ht2_crack_t;
+
+typedef struct {
+    ht2_crack_t *ctx;
+    uint32_t start;
+    uint32_t end;
+    uint32_t size;
+} ht2_score_job_t;
+
+static inline ht2_guess_t *guess_at(const ht2_crack_t *ctx, uint32_t i) {
+    return (ht2_guess_t *)(ctx->table + (size_t)i * ctx->words);
+}
+
+uint32_t ht2_air_to_bits(const uint8_t *data) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++) {
+        v |= (uint32_t)reflect8(data[i]) << (i * 8);
+    }
+    return v;
+}
+
+// ht2crypt works on the pre-shifted form of the lfsr
+static uint64_t ht2crypt(uint64_t s) {
+    uint64_t bitindex;
+
+    bitindex = (ht2_function4a >> pickbits2_2(s, 2, 5)) & 1;
+    bitindex |= ((ht2_function4b << 1) >> pickbits1_1_2(s, 8, 12, 14)) & 0x02;
+    bitindex |= ((ht2_function4b << 2) >> pickbits1x4(s, 17, 21, 23, 26)) & 0x04;
+    bitindex |= ((ht2_function4b << 3) >> pickbits2_1_1(s, 28, 31, 33)) & 0x08;
+    bitindex |= ((ht2_function4a << 4) >> pickbits1_2_1(s, 34, 43, 46)) & 0x10;
+
+    return (ht2_function5c >> bitindex) & 1;
+}
+
+// same as ht2crypt on the 20 relevant bits of the state squashed together
+static uint64_t f20(uint64_t y) {
+    uint64_t bitindex;
+
+    bitindex = (ht2_function4a >> (y & 0xf)) & 1;
+    bitindex |= ((ht2_function4b << 1) >> ((y >> 4) & 0xf)) & 0x02;
+    bitindex |= ((ht2_function4b << 2) >> ((y >> 8) & 0xf)) & 0x04;
+    bitindex |= ((ht2_function4b << 3) >> ((y >> 12) & 0xf)) & 0x08;
+    bitindex |= ((ht2_function4a << 4) >> ((y >> 16) & 0xf)) & 0x10;
+
+    return (ht2_function5c >> bitindex) & 1;
+}
+
+static uint64_t packstate(uint64_t s) {
+    uint64_t packed;
+
+    packed =  pickbits2_2(s, 2, 5);
+    packed |= (pickbits1_1_2(s, 8, 12, 14) << 4);
+    packed |= (pickbits1x4(s, 17, 21, 23, 26) << 8);
+    packed |= (pickbits2_1_1(s, 28, 31, 33) << 12);
+    packed |= (pickbits1_2_1(s, 34, 43, 46) << 16);
+
+    return packed;
+}
+
+// ratio of the partial states with size confirmed bits that generate the bit b
+static double bit_score(uint64_t s, uint32_t size, uint64_t b) {
+    double nibprob1, nibprob0, prob;
+
+    uint64_t packed = packstate(s & ((1ULL << size) - 1));
+    uint32_t n = packed_size[size];
+
+    if (n == 0) {
+        // no relevant bits, default probability
+        return 0.5;
+    } else if (n < 4) {
+        // incomplete first nibble
+        nibprob1 = pfna[n - 1][packed];
+        nibprob0 = 1.0 - nibprob1;
+        prob = (nibprob0 * pfnc[0][0]) + (nibprob1 * pfnc[0][1]);
+    } else if (n < 20) {
+        uint32_t fncinput;
+        fncinput = (ht2_function4a >> (packed & 0xf)) & 1;
+        fncinput |= ((ht2_function4b << 1) >> ((packed >> 4) & 0xf)) & 0x02;
+        fncinput |= ((ht2_function4b << 2) >> ((packed >> 8) & 0xf)) & 0x04;
+        fncinput |= ((ht2_function4b << 3) >> ((packed >> 12) & 0xf)) & 0x08;
+        fncinput |= ((ht2_function4a << 4) >> ((packed >> 16) & 0xf)) & 0x10;
+
+        // keep the full nibble bits
+        fncinput &= (1U << (n / 4)) - 1;
+
+        if ((n % 4) == 0) {
+            prob = pfnc[(n / 4) - 1][fncinput];
+        } else if (n <= 16) {
+            // incomplete nibble in the fnb area
+            nibprob1 = pfnb[(n % 4) - 1][packed >> ((n / 4) * 4)];
+            nibprob0 = 1.0 - nibprob1;
+            prob = (nibprob0 * pfnc[n / 4][fncinput]) + (nibprob1 * pfnc[n / 4][fncinput | (1U << (n / 4))]);
+        } else {
+            // incomplete final fna
+            nibprob1 = pfna[(n % 4) - 1][packed >> 16];
+            nibprob0 = 1.0 - nibprob1;
+            prob = (nibprob0 * ((ht2_function5c >> fncinput) & 0x1)) + (nibprob1 * ((ht2_function5c >> (fncinput | 0x10)) & 0x1));
+        }
+    } else {
+        prob = f20(packed);
+    }
+
+    return (b & 1) ? prob : (1.0 - prob);
+}
+
+// bit_score over the keystream, shifting the state along. Scores are weighted
+// with the number of relevant bits, a zero means the guess can't be right
+static double score(uint64_t s, uint32_t size, uint64_t ks, uint32_t kssize) {
+    double total = 0.0;
+
+    for (;;) {
+        double sc = bit_score(s, size, ks);
+        if (sc == 0.0)
+            return 0.0;
+
+        total += sc * (packed_size[size] + 1);
+
+        if (size == 1 || kssize == 1)
+            return total;
+
+        s >>= 1;
+        size--;
+        ks >>= 1;
+        kssize--;
+    }
+}
+
+static void score_traces(const ht2_crack_t *ctx, ht2_guess_t *g, uint32_t size) {
+    double total_score = 0.0;
+
+    // don't bother scoring traces that are already losers
+    if (g->score == 0.0)
+        return;
+
+    for (uint32_t i = 0; i < ctx->count; i++) {
+        // lower 32 bits uid, upper 16 bits the lower 16 key bits, shifted by size - 16 with the
+        // upper key bits xor nonce xor keystream inserted, gives the next keystream bit
+        uint64_t x = ctx->enc_nR[i] ^ g->b0to31[i];
+        if (size < 48) {
+            uint64_t lfsr = (ctx->uid >> (size - 16)) | ((g->key << (48 - size)) ^ (x << (64 - size)));
+            g->b0to31[i] |= (uint32_t)ht2crypt(lfsr) << (size - 16);
+            x = ctx->enc_nR[i] ^ g->b0to31[i];
+        }
+
+        // lower 16 bits of key, then upper key bits xor nonce xor keystream
+        uint64_t lfsr = g->key ^ (x << 16);
+
+        double sc = score(lfsr, size, ctx->ks[i], 32);
+        if (sc == 0.0) {
+            g->score = 0.0;
+            return;
+        }
+        total_score += sc;
+    }
+
+    g->score = total_score / ctx->count;
+}
+
+static void *score_thread(void *arg) {
+    ht2_score_job_t *job = (ht2_score_job_t *)arg;
+    for (uint32_t i = job->start; i < job->end; i++) {
+        score_traces(job->ctx, guess_at(job->ctx, i), job->size);
+    }
+    return NULL;
+}
+
+static void score_all(ht2_crack_t *ctx, uint32_t size, int num_threads) {
+    pthread_t threads[num_threads];
+    ht2_score_job_t jobs[num_threads];
+    uint32_t chunk = ctx->num_guesses / num_threads;
+
+    int started = 0;
+    for (int i = 0; i < num_threads; i++) {
+        jobs[i].ctx = ctx;
+        jobs[i].start = i * chunk;
+        jobs[i].end = (i == num_threads - 1) ? ctx->num_guesses : (i + 1) * chunk;
+        jobs[i].size = size;
+        if (pthread_create(&threads[i], NULL, score_thread, &jobs[i]) != 0) {
+            // do it here instead
+            score_thread(&jobs[i]);
+            continue;
+        }
+        started |= 1 << i;
+    }
+
+    for (int i = 0; i < num_threads; i++) {
+        if (started & (1 << i))
+            pthread_join(threads[i], NULL);
+    }
+}
+
+static int cmp_guess(const void *a, const void *b) {
+    const ht2_guess_t *a1 = (const ht2_guess_t *)a;
+    const ht2_guess_t *b1 = (const ht2_guess_t *)b;
+
+    if (a1->score < b1->score)
+        return 1;
+    if (a1->score > b1->score)
+        return -1;
+    return 0;
+}
+
+// copy the sorted first half into the second half, extended with a 1 bit
+static void expand_guesses(ht2_crack_t *ctx, uint32_t halfsize, uint32_t size) {
+    for (uint32_t i = 0; i < halfsize; i++) {
+        ht2_guess_t *g = guess_at(ctx, i + halfsize);
+        memcpy(g, guess_at(ctx, i), ctx->words * sizeof(uint64_t));
+        g->key |= 1ULL << size;
+    }
+}
+
+// tests the guesses against two authentications, returns the index of the right key or -1
+static int64_t find_key(const ht2_crack_t *ctx) {
+    uint64_t keys[HT2BS_LANES];
+    ht2bs_t key[48];
+
+    for (uint32_t i = 0; i < ctx->num_guesses; i += HT2BS_LANES) {
+        uint32_t n = MIN(ctx->num_guesses - i, HT2BS_LANES);
+        for (uint32_t j = 0; j < n; j++) {
+            keys[j] = guess_at(ctx, i + j)->key;
+        }
+        ht2bs_transpose(key, keys, n, 48);
+
+        ht2bs_t match = ht2bs_check_keys(key, ctx->uid, ctx->enc_nR[0], ctx->ks[0]);
+        if (ht2bs_any(match) == false)
+            continue;
+
+        match &= ht2bs_check_keys(key, ctx->uid, ctx->enc_nR[1], ctx->ks[1]);
+        for (uint32_t j = 0; j < n; j++) {
+            if (ht2bs_get(match, j))
+                return i + j;
+        }
+    }
+    return -1;
+}
+
+// internal key bit order to the byte order `lf hitag reader 23` takes
+static uint64_t key_to_reader(uint64_t k) {
+    uint64_t key = 0;
+    for (int i = 0; i < 6; i++) {
+        key |= (uint64_t)reflect8((k >> (i * 8)) & 0xFF) << ((5 - i) * 8);
+    }
+    return key;
+}
+
+int ht2_crack_nonces(uint32_t uid, const uint8_t *nrar, uint32_t count, uint32_t table_size, uint64_t *key) {
+
+    if (count < 2 || count > HT2_CRACK_MAX_NONCES || table_size < 0x20000) {
+        return PM3_EINVARG;
+    }
+
+    ht2_crack_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+
+    uint8_t uidbytes[4];
+    num_to_bytes(uid, 4, uidbytes);
+    ctx.uid = ht2_air_to_bits(uidbytes);
+    ctx.count = count;
+    for (uint32_t i = 0; i < count; i++) {
+        ctx.enc_nR[i] = ht2_air_to_bits(nrar + i * 8);
+        ctx.ks[i] = ~ht2_air_to_bits(nrar + i * 8 + 4);
+    }
+
+    ctx.words = (sizeof(ht2_guess_t) + count * sizeof(uint32_t) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+    ctx.table = calloc((size_t)table_size * ctx.words, sizeof(uint64_t));
+    if (ctx.table == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+
+    // all guesses of the lower 16 key bits, score -1.0 tells them from 0 scores
+    for (uint32_t i = 0; i < 0x10000; i++) {
+        ht2_guess_t *g = guess_at(&ctx, i);
+        g->key = i;
+        g->score = -1.0;
+    }
+    ctx.num_guesses = 0x10000;
+
+    int num_threads = MIN(num_CPUs(), 32);
+    PrintAndLogEx(INFO, "Cracking with " _YELLOW_("%u") " authentications, %u guesses per round, %d threads", count, table_size, num_threads);
+    PrintAndLogEx(INFO, "press " _YELLOW_("`enter`") " to cancel");
+
+    uint64_t t1 = msclock();
+    uint64_t work = 0;
+    int res = PM3_SUCCESS;
+
+    for (uint32_t size = 16; size <= 48; size++) {
+        score_all(&ctx, size, num_threads);
+        work += ctx.num_guesses;
+
+        qsort(ctx.table, ctx.num_guesses, ctx.words * sizeof(uint64_t), cmp_guess);
+
+        if (size < 48) {
+            uint32_t halfsize = MIN(ctx.num_guesses, table_size / 2);
+            expand_guesses(&ctx, halfsize, size);
+            ctx.num_guesses = halfsize * 2;
+        }
+
+        // the rounds to come score a full table each, once it is reached
+        uint64_t elapsed = msclock() - t1;
+        uint64_t todo = 0;
+        uint64_t n = ctx.num_guesses;
+        for (uint32_t s = size + 1; s <= 48; s++) {
+            todo += n;
+            n = MIN(n * 2, table_size - (table_size & 1));
+        }
+        PrintAndLogEx(INPLACE, "round %2u / 33, top score %1.6f, ETA %" PRIu64 " s   ", size - 15, guess_at(&ctx, 0)->score, elapsed * todo / work / 1000);
+
+        if (kbd_enter_pressed()) {
+            res = PM3_EOPABORTED;
+            break;
+        }
+    }
+    PrintAndLogEx(NORMAL, "");
+
+    if (res == PM3_EOPABORTED) {
+        PrintAndLogEx(WARNING, "aborted via keyboard!");
+    } else {
+        int64_t found = find_key(&ctx);
+        if (found < 0) {
+            res = PM3_ESOFT;
+        } else {
+            *key = key_to_reader(guess_at(&ctx, found)->key & 0xFFFFFFFFFFFFULL);
+        }
+        PrintAndLogEx(INFO, "time in crack: %.0f seconds", (float)(msclock() - t1) / 1000.0);
+    }
+
+    free(ctx.table);
+    return res;
+}
@@ -0,0 +1,26 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Hitag2 key recovery from reader authentications, in process version of ht2crack4
+//-----------------------------------------------------------------------------
+
+#ifndef HITAG2_CRACK_H__
+#define HITAG2_CRACK_H__
+
+#include "common.h"
+
+#define HT2_CRACK_MAX_NONCES    32
+#define HT2_CRACK_MIN_NONCES    8
+#define HT2_CRACK_TABLE_SIZE    800000
+
+// First 32 bits sent over the air, the first bit in bit 0. This is the internal format of the ht2crack tools
+uint32_t ht2_air_to_bits(const uint8_t *data);
+
+// Fast correlation attack on count (max HT2_CRACK_MAX_NONCES) authentications of a reader, 8 bytes nR aR
+// each as they were sent to the tag with this uid. Keeps the table_size best key guesses per round, prints
+// progress and stops on enter. On success key holds the 48 bit key as `lf hitag reader 23` takes it
+int ht2_crack_nonces(uint32_t uid, const uint8_t *nrar, uint32_t count, uint32_t table_size, uint64_t *key);
+
+#endif
@@ -280,6 +280,135 @@ void doMAC_N(uint8_t *address_data_p, uint8_t address_data_size, uint8_t *div_ke
     free(address_data);
 }
 
+/**
+ * Bitsliced MAC. Bit n of every word belongs to lane n, so one pass over the cipher steps
+ * calculates the MACs of MAC_BATCH_SIZE lanes. Same state update as the optimized cipher
+ * of the device (armsrc/optimized_cipher.c), written in boolean operations only.
+ **/
+typedef uint64_t mac_slice_t;
+
+typedef struct {
+    mac_slice_t k[8][8];    // key byte, bit
+    mac_slice_t l[8];
+    mac_slice_t r[8];
+    mac_slice_t b[8];
+    mac_slice_t t[16];
+} SlicedState;
+
+// a or b, picked by s
+#define SLICE_MUX(a, b, s) ((a) ^ (((a) ^ (b)) & (s)))
+
+static inline void sliced_add(const mac_slice_t *x, const mac_slice_t *y, mac_slice_t *sum) {
+    mac_slice_t carry = 0;
+    for (uint8_t j = 0; j < 8; j++) {
+        mac_slice_t xy = x[j] ^ y[j];
+        sum[j] = xy ^ carry;
+        carry = (x[j] & y[j]) | (carry & xy);
+    }
+}
+
+static inline void sliced_successor(SlicedState *s, mac_slice_t y) {
+    mac_slice_t *r = s->r;
+    mac_slice_t *t = s->t;
+    mac_slice_t *b = s->b;
+
+    mac_slice_t Tt = t[0] ^ t[1] ^ t[4] ^ t[5] ^ t[8] ^ t[10] ^ t[14] ^ t[15];
+
+    // select(Tt, y, r)
+    mac_slice_t z0 = (r[7] & r[5]) ^ (r[6] & ~r[4]) ^ (r[5] | r[3]);
+    mac_slice_t z1 = (r[7] | r[5]) ^ (r[2] | r[0]) ^ r[6] ^ r[1];
+    mac_slice_t z2 = (r[4] & ~r[2]) ^ (r[3] & r[1]) ^ r[0];
+    mac_slice_t s0 = z2 ^ Tt;
+    mac_slice_t s1 = z1 ^ Tt ^ y;
+    mac_slice_t s2 = z0;
+
+    mac_slice_t t15 = Tt ^ r[7] ^ r[3];
+    memmove(t, t + 1, 15 * sizeof(mac_slice_t));
+    t[15] = t15;
+
+    mac_slice_t b7 = b[0] ^ b[6] ^ b[5] ^ b[4] ^ r[0];
+    memmove(b, b + 1, 7 * sizeof(mac_slice_t));
+    b[7] = b7;
+
+    // k[select] ^ b
+    mac_slice_t x[8];
+    for (uint8_t j = 0; j < 8; j++) {
+        mac_slice_t a0 = SLICE_MUX(s->k[0][j], s->k[1][j], s0);
+        mac_slice_t a1 = SLICE_MUX(s->k[2][j], s->k[3][j], s0);
+        mac_slice_t a2 = SLICE_MUX(s->k[4][j], s->k[5][j], s0);
+        mac_slice_t a3 = SLICE_MUX(s->k[6][j], s->k[7][j], s0);
+        mac_slice_t c0 = SLICE_MUX(a0, a1, s1);
+        mac_slice_t c1 = SLICE_MUX(a2, a3, s1);
+        x[j] = SLICE_MUX(c0, c1, s2) ^ b[j];
+    }
+
+    // r' = (k[select] ^ b') + l,  l' = r' + r
+    mac_slice_t r_old[8];
+    memcpy(r_old, r, sizeof(r_old));
+    sliced_add(x, s->l, r);
+    sliced_add(r, r_old, s->l);
+}
+
+void doMAC_batch(const uint8_t *cc_nr, size_t cc_nr_stride, const uint8_t *div_keys, uint8_t *macs, size_t count) {
+
+    if (count > MAC_BATCH_SIZE)
+        count = MAC_BATCH_SIZE;
+
+    SlicedState s;
+    memset(&s, 0, sizeof(s));
+    mac_slice_t in[12 * 8] = {0};
+
+    for (size_t n = 0; n < count; n++) {
+        const uint8_t *key = div_keys + n * 8;
+        const uint8_t *input = cc_nr + n * cc_nr_stride;
+        mac_slice_t lane = (mac_slice_t)1 << n;
+
+        uint8_t l = ((key[0] ^ 0x4c) + 0xEC) & 0xFF;
+        uint8_t r = ((key[0] ^ 0x4c) + 0x21) & 0xFF;
+
+        for (uint8_t j = 0; j < 8; j++) {
+            for (uint8_t i = 0; i < 8; i++) {
+                if ((key[i] >> j) & 1)
+                    s.k[i][j] |= lane;
+            }
+            if ((l >> j) & 1)
+                s.l[j] |= lane;
+            if ((r >> j) & 1)
+                s.r[j] |= lane;
+        }
+
+        // input bits go in lsb first
+        for (uint8_t i = 0; i < sizeof(in) / sizeof(in[0]); i++) {
+            if ((input[i / 8] >> (i % 8)) & 1)
+                in[i] |= lane;
+        }
+    }
+
+    // same b and t in every lane
+    for (uint8_t j = 0; j < 8; j++)
+        s.b[j] = ((0x4c >> j) & 1) ? ~(mac_slice_t)0 : 0;
+    for (uint8_t j = 0; j < 16; j++)
+        s.t[j] = ((0xE012 >> j) & 1) ? ~(mac_slice_t)0 : 0;
+
+    for (uint8_t i = 0; i < sizeof(in) / sizeof(in[0]); i++)
+        sliced_successor(&s, in[i]);
+
+    // the output is r2 before each of 32 more steps
+    mac_slice_t out[32];
+    for (uint8_t i = 0; i < 32; i++) {
+        out[i] = s.r[2];
+        sliced_successor(&s, 0);
+    }
+
+    memset(macs, 0, count * 4);
+    for (size_t n = 0; n < count; n++) {
+        for (uint8_t i = 0; i < 32; i++) {
+            if ((out[i] >> n) & 1)
+                macs[n * 4 + i / 8] |= 1 << (i % 8);
+        }
+    }
+}
+
 #ifndef ON_DEVICE
 int testMAC(void) {
     PrintAndLogEx(SUCCESS, "Testing MAC calculation...");
@@ -301,6 +430,29 @@ int testMAC(void) {
         printarr("    Correct_MAC   ", correct_MAC, 4);
         return PM3_ESOFT;
     }
+
+    // batch, every lane with its own key and input, against the single MAC
+    uint8_t keys[MAC_BATCH_SIZE * 8];
+    uint8_t inputs[MAC_BATCH_SIZE * 12];
+    uint8_t macs[MAC_BATCH_SIZE * 4];
+    for (size_t i = 0; i < sizeof(keys); i++)
+        keys[i] = (i * 0x9D + 0x37) ^ (i >> 3);
+    for (size_t i = 0; i < sizeof(inputs); i++)
+        inputs[i] = (i * 0x6B + 0x11) ^ (i >> 2);
+    memcpy(keys, div_key, 8);
+    memcpy(inputs, cc_nr, 12);
+
+    doMAC_batch(inputs, 12, keys, macs, MAC_BATCH_SIZE);
+    for (size_t n = 0; n < MAC_BATCH_SIZE; n++) {
+        doMAC(inputs + n * 12, keys + n * 8, calculated_mac);
+        if (memcmp(calculated_mac, macs + n * 4, 4) != 0) {
+            PrintAndLogEx(FAILED, "    Batch MAC calculation (%s)", _RED_("failed"));
+            printarr("    Calculated_MAC", macs + n * 4, 4);
+            printarr("    Correct_MAC   ", calculated_mac, 4);
+            return PM3_ESOFT;
+        }
+    }
+    PrintAndLogEx(SUCCESS, "    Batch MAC calculation (%s)", _GREEN_("ok"));
     return PM3_SUCCESS;
 }
 #endif
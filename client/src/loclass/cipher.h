@@ -39,11 +39,17 @@
 #ifndef CIPHER_H
 #define CIPHER_H
 #include <stdint.h>
+#include <stddef.h>
 #include "pm3_cmd.h"
 
 void doMAC(uint8_t *cc_nr_p, uint8_t *div_key_p, uint8_t mac[4]);
 void doMAC_N(uint8_t *address_data_p, uint8_t address_data_size, uint8_t *div_key_p, uint8_t mac[4]);
 
+// MACs of up to MAC_BATCH_SIZE reader challenges at once, bitsliced. div_keys holds count 8 byte keys and macs
+// gets count 4 byte MACs. The 12 byte cc_nr inputs are cc_nr_stride apart, a stride of 0 uses one input for all keys
+#define MAC_BATCH_SIZE  64
+void doMAC_batch(const uint8_t *cc_nr, size_t cc_nr_stride, const uint8_t *div_keys, uint8_t *macs, size_t count);
+
 #ifndef ON_DEVICE
 int testMAC(void);
 #endif
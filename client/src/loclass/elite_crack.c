@@ -40,6 +40,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <time.h>
+#include <pthread.h>
 #include "cipherutils.h"
 #include "cipher.h"
 #include "ikeys.h"
@@ -47,6 +48,7 @@
 #include "fileutils.h"
 #include "des.h"
 #include "util_posix.h"
+#include "util.h"           // num_CPUs
 
 /**
  * @brief Permutes a key from standard NIST format to Iclass specific format
@@ -281,12 +283,93 @@ static int _readFromDump(uint8_t dump[], dumpdata *item, uint8_t i) {
 }
 */
 //static uint32_t startvalue = 0;
+// Candidates handed out to a bruteforce thread at a time
+#define BRUTEFORCE_CHUNK    0x1000
+
+// One dump item, bruteforced by several threads which take chunks of the candidate space
+typedef struct {
+    dumpdata item;
+    uint8_t key_sel[8];         // key bytes already known
+    int8_t brute_byte[8];       // which byte of the candidate goes into key_sel, -1 for known ones
+    uint32_t endmask;
+    uint32_t next;              // first candidate of the next chunk
+    bool found;
+    uint32_t brute;             // the candidate matching the mac
+    pthread_mutex_t lock;
+} bruteforce_item_t;
+
+static void *bruteforce_thread(void *arg) {
+    bruteforce_item_t *bf = (bruteforce_item_t *)arg;
+
+    uint8_t key_sel[8];
+    uint8_t key_sel_p[8] = {0};
+    uint8_t div_keys[MAC_BATCH_SIZE * 8] = {0};
+    uint8_t calculated_MACs[MAC_BATCH_SIZE * 4] = {0};
+    memcpy(key_sel, bf->key_sel, sizeof(key_sel));
+
+    for (;;) {
+        pthread_mutex_lock(&bf->lock);
+        if (bf->found || bf->next >= bf->endmask) {
+            pthread_mutex_unlock(&bf->lock);
+            break;
+        }
+        uint32_t brute = bf->next;
+        bf->next += BRUTEFORCE_CHUNK;
+        if (brute && (brute & 0xFFFF) == 0) {
+            PrintAndLogEx(NORMAL, "%3d," NOLF, (brute >> 16) & 0xFF);
+            if (((brute >> 16) % 0x10) == 0)
+                PrintAndLogEx(NORMAL, "");
+        }
+        pthread_mutex_unlock(&bf->lock);
+
+        uint32_t end = MIN(brute + BRUTEFORCE_CHUNK, bf->endmask);
+        bool found = false;
+        while (brute < end && found == false) {
+
+            uint32_t n = MIN(end - brute, MAC_BATCH_SIZE);
+            for (uint32_t lane = 0; lane < n; lane++) {
+
+                // Piece together the key
+                for (uint8_t i = 0; i < 8; i++) {
+                    if (bf->brute_byte[i] >= 0)
+                        key_sel[i] = ((brute + lane) >> (bf->brute_byte[i] * 8)) & 0xFF;
+                }
+
+                //Permute from iclass format to standard format
+                permutekey_rev(key_sel, key_sel_p);
+                //Diversify
+                diversifyKey(bf->item.csn, key_sel_p, div_keys + lane * 8);
+            }
+
+            //Calc macs, all with the same cc_nr
+            doMAC_batch(bf->item.cc_nr, 0, div_keys, calculated_MACs, n);
+
+            for (uint32_t lane = 0; lane < n; lane++) {
+                // success, the lowest match wins like in a sequential run. Chunks below it run to their end
+                if (memcmp(calculated_MACs + lane * 4, bf->item.mac, 4) == 0) {
+                    pthread_mutex_lock(&bf->lock);
+                    if (bf->found == false || brute + lane < bf->brute) {
+                        bf->found = true;
+                        bf->brute = brute + lane;
+                    }
+                    pthread_mutex_unlock(&bf->lock);
+                    found = true;
+                    break;
+                }
+            }
+            brute += n;
+        }
+    }
+    return NULL;
+}
+
 /**
  * @brief Performs brute force attack against a dump-data item, containing csn, cc_nr and mac.
  *This method calculates the hash1 for the CSN, and determines what bytes need to be bruteforced
  *on the fly. If it finds that more than three bytes need to be bruteforced, it aborts.
  *It updates the keytable with the findings, also using the upper half of the 16-bit ints
  *to signal if the particular byte has been cracked or not.
+ *The candidates are split over num_CPUs() threads.
  *
  * @param dump The dumpdata from iclass reader attack.
  * @param keytable where to write found values.
@@ -294,12 +377,6 @@ static int _readFromDump(uint8_t dump[], dumpdata *item, uint8_t i) {
  */
 int bruteforceItem(dumpdata item, uint16_t keytable[]) {
 
-    int found = false;
-    uint8_t key_sel_p[8] = {0};
-    uint8_t div_key[8] = {0};
-    uint8_t key_sel[8] = {0};
-    uint8_t calculated_MAC[4] = {0};
-
     //Get the key index (hash1)
     uint8_t key_index[8] = {0};
     hash1(item.csn, key_index);
@@ -338,11 +415,20 @@ int bruteforceItem(dumpdata item, uint16_t keytable[]) {
         }
     }
 
-    /*
-     *A uint32 has room for 4 bytes, we'll only need 24 of those bits to bruteforce up to three bytes,
-     */
-    //uint32_t brute = startvalue;
-    uint32_t brute = 0;
+    bruteforce_item_t bf;
+    memset(&bf, 0, sizeof(bf));
+    bf.item = item;
+
+    // Known bytes come from the keytable, the others from the candidate
+    for (i = 0; i < 8; i++) {
+        bf.key_sel[i] = keytable[key_index[i]] & 0xFF;
+        bf.brute_byte[i] = -1;
+        for (uint8_t j = 0; j < numbytes_to_recover; j++) {
+            if (key_index[i] == bytes_to_recover[j])
+                bf.brute_byte[i] = j;
+        }
+    }
+
     /*
        Determine where to stop the bruteforce. A 1-byte attack stops after 256 tries,
        (when brute reaches 0x100). And so on...
@@ -350,58 +436,47 @@ int bruteforceItem(dumpdata item, uint16_t keytable[]) {
        bytes_to_recover = 2 --> endmask = 0x000010000
        bytes_to_recover = 3 --> endmask = 0x001000000
     */
-
-    uint32_t endmask =  1 << 8 * numbytes_to_recover;
+    bf.endmask =  1 << 8 * numbytes_to_recover;
     PrintAndLogEx(NORMAL, "----------------------------");
     for (i = 0 ; i < numbytes_to_recover && numbytes_to_recover > 1; i++)
         PrintAndLogEx(INFO, "Bruteforcing byte %d", bytes_to_recover[i]);
 
-    while (!found && !(brute & endmask)) {
+    int num_threads = MIN(num_CPUs(), (int)((bf.endmask + BRUTEFORCE_CHUNK - 1) / BRUTEFORCE_CHUNK));
+    pthread_mutex_init(&bf.lock, NULL);
+    if (num_threads > 1) {
+        pthread_t thread_id[num_threads];
+        int started = 0;
+        for (; started < num_threads; started++) {
+            if (pthread_create(&thread_id[started], NULL, bruteforce_thread, &bf) != 0)
+                break;
+        }
+        // no thread at all, do it here
+        if (started == 0)
+            bruteforce_thread(&bf);
+
+        for (i = 0; i < started; i++)
+            pthread_join(thread_id[i], NULL);
+    } else {
+        bruteforce_thread(&bf);
+    }
+    pthread_mutex_destroy(&bf.lock);
 
-        //Update the keytable with the brute-values
+    //Update the keytable with the found values
+    if (bf.found) {
         for (i = 0; i < numbytes_to_recover; i++) {
             keytable[bytes_to_recover[i]] &= 0xFF00;
-            keytable[bytes_to_recover[i]] |= (brute >> (i * 8) & 0xFF);
-        }
-
-        // Piece together the key
-        key_sel[0] = keytable[key_index[0]] & 0xFF;
-        key_sel[1] = keytable[key_index[1]] & 0xFF;
-        key_sel[2] = keytable[key_index[2]] & 0xFF;
-        key_sel[3] = keytable[key_index[3]] & 0xFF;
-        key_sel[4] = keytable[key_index[4]] & 0xFF;
-        key_sel[5] = keytable[key_index[5]] & 0xFF;
-        key_sel[6] = keytable[key_index[6]] & 0xFF;
-        key_sel[7] = keytable[key_index[7]] & 0xFF;
-
-        //Permute from iclass format to standard format
-        permutekey_rev(key_sel, key_sel_p);
-        //Diversify
-        diversifyKey(item.csn, key_sel_p, div_key);
-        //Calc mac
-        doMAC(item.cc_nr, div_key, calculated_MAC);
-
-        // success
-        if (memcmp(calculated_MAC, item.mac, 4) == 0) {
-            PrintAndLogEx(NORMAL, "");
-            for (i = 0 ; i < numbytes_to_recover; i++) {
-                PrintAndLogEx(INFO, "%d: 0x%02x", bytes_to_recover[i], 0xFF & keytable[bytes_to_recover[i]]);
-            }
-            found = true;
-            break;
+            keytable[bytes_to_recover[i]] |= (bf.brute >> (i * 8) & 0xFF);
         }
 
-        brute++;
-        if ((brute & 0xFFFF) == 0) {
-            PrintAndLogEx(NORMAL, "%3d," NOLF, (brute >> 16) & 0xFF);
-            if (((brute >> 16) % 0x10) == 0)
-                PrintAndLogEx(NORMAL, "");
+        PrintAndLogEx(NORMAL, "");
+        for (i = 0 ; i < numbytes_to_recover; i++) {
+            PrintAndLogEx(INFO, "%d: 0x%02x", bytes_to_recover[i], 0xFF & keytable[bytes_to_recover[i]]);
         }
     }
 
     int errors = PM3_SUCCESS;
 
-    if (found == false) {
+    if (bf.found == false) {
         PrintAndLogEx(NORMAL, "");
         PrintAndLogEx(WARNING, "Failed to recover %d bytes using the following CSN", numbytes_to_recover);
         PrintAndLogEx(INFO, "CSN  %s", sprint_hex(item.csn, 8));
@@ -519,6 +594,16 @@ int bruteforceDump(uint8_t dump[], size_t dumpsize, uint16_t keytable[]) {
         return PM3_ESOFT;
     }
 
+    return calculateMasterKeyFromTable(keytable, NULL);
+}
+/**
+ * @brief Calculates the master key out of a keytable filled by bruteforceItem
+ * @param keytable
+ * @param master_key where to put the master key
+ * @return
+ */
+int calculateMasterKeyFromTable(uint16_t keytable[], uint64_t master_key[]) {
+    uint8_t i;
     // Pick out the first 16 bytes of the keytable.
     // The keytable is now in 16-bit ints, where the upper 8 bits
     // indicate crack-status. Those must be discarded for the
@@ -533,7 +618,7 @@ int bruteforceDump(uint8_t dump[], size_t dumpsize, uint16_t keytable[]) {
             return PM3_ESOFT;
         }
     }
-    return calculateMasterKey(first16bytes, NULL);
+    return calculateMasterKey(first16bytes, master_key);
 }
 /**
  * Perform a bruteforce against a file which has been saved by pm3
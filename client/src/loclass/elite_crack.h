@@ -120,6 +120,14 @@ void hash2(uint8_t *key64, uint8_t *outp_keytable);
  */
 int calculateMasterKey(uint8_t first16bytes[], uint64_t master_key[]);
 
+/**
+ * @brief Calculates the master key out of the first 16 bytes of a keytable filled by bruteforceItem
+ * @param keytable
+ * @param master_key where to put the master key
+ * @return 0 for ok, 1 for failz
+ */
+int calculateMasterKeyFromTable(uint16_t keytable[], uint64_t master_key[]);
+
 /**
  * @brief Test function
  * @return
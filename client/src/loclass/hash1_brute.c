@@ -6,8 +6,15 @@
 #include <string.h>
 #include <unistd.h>
 #include <ctype.h>
+#include <inttypes.h>
+#include <pthread.h>
 #include "elite_crack.h"
 #include "ui.h"
+#include "util.h"           // num_CPUs, kbd_enter_pressed
+#include "util_posix.h"     // msclock, msleep
+
+// seconds between two progress lines
+#define HASH1_PROGRESS_INTERVAL 10
 
 static void calc_score(uint8_t *csn, uint8_t *k) {
     uint8_t score = 0 ;
@@ -42,46 +49,170 @@ static void calc_score(uint8_t *csn, uint8_t *k) {
     }
 
     if (score >= 2 && badscore < 2) {
-        PrintAndLogEx(NORMAL, "CSN\t%02x%02x%02x%02x%02x%02x%02x%02x\t%02x %02x %02x %02x %02x %02x %02x %02x\t" NOLF
-                      , csn[0], csn[1], csn[2], csn[3], csn[4], csn[5], csn[6], csn[7]
-                      , k[0], k[1], k[2], k[3], k[4], k[5], k[6], k[7]
-                     );
+        // one line per call, the search threads print concurrently
+        char line[120] = {0};
+        int n = snprintf(line, sizeof(line), "CSN\t%02x%02x%02x%02x%02x%02x%02x%02x\t%02x %02x %02x %02x %02x %02x %02x %02x\t"
+                         , csn[0], csn[1], csn[2], csn[3], csn[4], csn[5], csn[6], csn[7]
+                         , k[0], k[1], k[2], k[3], k[4], k[5], k[6], k[7]
+                        );
 
         for (i = 0 ; i < score; i++) {
-            PrintAndLogEx(NORMAL, "%d," NOLF, uniq_vals[i]);
+            n += snprintf(line + n, sizeof(line) - n, "%d,", uniq_vals[i]);
         }
-        PrintAndLogEx(NORMAL, "\tbadscore: %d (%02x)" NOLF, badscore, badval);
-        PrintAndLogEx(NORMAL, "");
+        snprintf(line + n, sizeof(line) - n, "\tbadscore: %d (%02x)", badscore, badval);
+        PrintAndLogEx(NORMAL, "%s", line);
+    }
+}
+
+// same as in elite_crack.c
+static inline uint8_t rr(uint8_t val) {
+    return val >> 1 | ((val & 1) << 7);
+}
+
+static inline uint8_t rl(uint8_t val) {
+    return val << 1 | ((val & 0x80) >> 7);
+}
+
+static inline uint8_t swap(uint8_t val) {
+    return ((val >> 4) & 0xFF) | ((val & 0xFF) << 4);
+}
+
+/**
+ * @brief hash1 and calc_score in one go. The key index bytes are scored as soon as they are
+ * known, two bad ones give up on the CSN before the rest of the hash is calculated.
+ * @return true when calc_score would print the CSN
+ */
+static inline bool hash1_candidate(const uint8_t *csn) {
+    uint16_t good = 0;
+    uint8_t bad = 0;
+
+#define HASH1_SCORE(x) { \
+        uint8_t v = (x) & 0x7F; \
+        if (v > 1 && v != 0x45) { \
+            if (v < 16) good |= 1 << v; \
+            else if (++bad > 1) return false; \
+        } \
     }
+
+    uint8_t k0 = csn[0] ^ csn[1] ^ csn[2] ^ csn[3] ^ csn[4] ^ csn[5] ^ csn[6] ^ csn[7];
+    HASH1_SCORE(k0);
+    uint8_t k1 = csn[0] + csn[1] + csn[2] + csn[3] + csn[4] + csn[5] + csn[6] + csn[7];
+    HASH1_SCORE(k1);
+    uint8_t k2 = rr(swap(csn[2] + k1));
+    HASH1_SCORE(k2);
+    uint8_t k3 = rl(swap(csn[3] + k0));
+    HASH1_SCORE(k3);
+    uint8_t k4 = ~rr(csn[4] + k2) + 1;
+    HASH1_SCORE(k4);
+    uint8_t k5 = ~rl(csn[5] + k3) + 1;
+    HASH1_SCORE(k5);
+    uint8_t k6 = rr(csn[6] + (k4 ^ 0x3c));
+    HASH1_SCORE(k6);
+    uint8_t k7 = rl(csn[7] + (k5 ^ 0xc3));
+    HASH1_SCORE(k7);
+
+#undef HASH1_SCORE
+
+    // at least two different good values
+    return (good & (good - 1)) != 0;
 }
 
-void brute_hash1(void) {
+// The search space is handed out one first CSN byte at a time
+typedef struct {
+    uint32_t next;
+    uint32_t done;
+    uint32_t found;
+    bool abort;
+} hash1_search_t;
+
+static void *brute_hash1_thread(void *arg) {
+    hash1_search_t *search = (hash1_search_t *)arg;
 
     uint8_t csn[8] = {0, 0, 0, 0, 0xf7, 0xff, 0x12, 0xe0};
-    uint8_t k[8] = {0, 0, 0, 0, 0, 0, 0, 0};
-    uint8_t testcsn[8] = {0x00, 0x0d, 0x0f, 0xfd, 0xf7, 0xff, 0x12, 0xe0} ;
-    uint8_t testkey[8] = {0x05, 0x01, 0x00, 0x10, 0x45, 0x08, 0x45, 0x56} ;
-    calc_score(testcsn, testkey);
+    uint8_t k[8] = {0};
 
-    PrintAndLogEx(INFO, "Brute forcing hashones");
+    for (;;) {
+        uint32_t a = __atomic_fetch_add(&search->next, 1, __ATOMIC_SEQ_CST);
+        if (a > 0xFF)
+            break;
 
-    for (uint16_t a = 0; a < 256; a++) {
+        csn[0] = a;
         for (uint16_t b = 0; b < 256; b++) {
+            if (__atomic_load_n(&search->abort, __ATOMIC_RELAXED))
+                return NULL;
+
+            csn[1] = b;
             for (uint16_t c = 0; c < 256; c++) {
+                csn[2] = c;
                 for (uint16_t d = 0; d < 256; d++) {
-                    csn[0] = a;
-                    csn[1] = b;
-                    csn[2] = c;
                     csn[3] = d;
-                    csn[4] = 0xf7;
-                    csn[5] = 0xff;
-                    csn[6] = 0x12;
-                    csn[7] = 0xe0;
+                    if (hash1_candidate(csn) == false)
+                        continue;
+
                     hash1(csn, k);
                     calc_score(csn, k);
+                    __atomic_add_fetch(&search->found, 1, __ATOMIC_RELAXED);
                 }
             }
         }
+        __atomic_add_fetch(&search->done, 1, __ATOMIC_SEQ_CST);
     }
+    return NULL;
 }
 
+int brute_hash1(void) {
+
+    uint8_t testcsn[8] = {0x00, 0x0d, 0x0f, 0xfd, 0xf7, 0xff, 0x12, 0xe0} ;
+    uint8_t testkey[8] = {0x05, 0x01, 0x00, 0x10, 0x45, 0x08, 0x45, 0x56} ;
+    calc_score(testcsn, testkey);
+
+    int num_threads = num_CPUs();
+    PrintAndLogEx(INFO, "Brute forcing hashones, %d threads", num_threads);
+    PrintAndLogEx(INFO, "press " _YELLOW_("`enter`") " to cancel");
+
+    hash1_search_t search;
+    memset(&search, 0, sizeof(search));
+
+    pthread_t thread_id[num_threads];
+    int started = 0;
+    for (; started < num_threads; started++) {
+        if (pthread_create(&thread_id[started], NULL, brute_hash1_thread, &search) != 0)
+            break;
+    }
+    if (started == 0) {
+        PrintAndLogEx(WARNING, "Failed to start threads");
+        return PM3_ESOFT;
+    }
+
+    uint64_t t1 = msclock();
+    uint64_t last = t1;
+    while (__atomic_load_n(&search.done, __ATOMIC_SEQ_CST) < 256) {
+        msleep(100);
+
+        if (kbd_enter_pressed()) {
+            __atomic_store_n(&search.abort, true, __ATOMIC_SEQ_CST);
+            break;
+        }
+
+        uint64_t now = msclock();
+        if (now - last < HASH1_PROGRESS_INTERVAL * 1000)
+            continue;
+
+        last = now;
+        uint32_t done = __atomic_load_n(&search.done, __ATOMIC_SEQ_CST);
+        uint64_t eta = (done) ? (now - t1) * (256 - done) / done / 1000 : 0;
+        PrintAndLogEx(INFO, "%3u / 256 done, %u CSN found, ETA %" PRIu64 " s", done, __atomic_load_n(&search.found, __ATOMIC_RELAXED), eta);
+    }
+
+    for (int i = 0; i < started; i++)
+        pthread_join(thread_id[i], NULL);
+
+    PrintAndLogEx(NORMAL, "");
+    if (search.abort) {
+        PrintAndLogEx(WARNING, "aborted via keyboard, %u / 256 done", search.done);
+        return PM3_EOPABORTED;
+    }
+
+    PrintAndLogEx(SUCCESS, "%u CSN found, time: %" PRIu64 " seconds", search.found, (msclock() - t1) / 1000);
+    return PM3_SUCCESS;
+}
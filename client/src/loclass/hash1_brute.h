@@ -1,5 +1,12 @@
 #ifndef HASH1_BRUTE_H
 #define HASH1_BRUTE_H
-void brute_hash1(void);
+#include "common.h"
+
+/**
+ * @brief Searches all CSNs ending in f7ff12e0 for few distinct key index values in hash1, on all cores.
+ * Prints matches and progress, `enter` cancels
+ * @return
+ */
+int brute_hash1(void);
 
 #endif // HASH1_BRUTE_H
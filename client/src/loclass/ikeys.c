@@ -354,13 +354,14 @@ void hash0(uint64_t c, uint8_t k[8]) {
  * @param div_key
  */
 void diversifyKey(uint8_t *csn, uint8_t *key, uint8_t *div_key) {
-    // Prepare the DES key
-    mbedtls_des_setkey_enc(&ctx_enc, key);
+    // Prepare the DES key, own context since loclass bruteforces from several threads
+    mbedtls_des_context ctx_div;
+    mbedtls_des_setkey_enc(&ctx_div, key);
 
     uint8_t crypted_csn[8] = {0};
 
     // Calculate DES(CSN, KEY)
-    mbedtls_des_crypt_ecb(&ctx_enc, csn, crypted_csn);
+    mbedtls_des_crypt_ecb(&ctx_div, csn, crypted_csn);
 
     //Calculate HASH0(DES))
     uint64_t c_csn = x_bytes_to_num(crypted_csn, sizeof(crypted_csn));
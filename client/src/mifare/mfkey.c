@@ -11,7 +11,10 @@
 //-----------------------------------------------------------------------------
 #include "mfkey.h"
 
+#include "commonutil.h"  // ARRAYLEN
 #include "crapto1/crapto1.h"
+#include "crapto1/crypto1_bs.h"
+#include "statecache.h"
 
 // MIFARE
 int inline compare_uint64(const void *a, const void *b) {
@@ -29,13 +32,15 @@ uint32_t intersection(uint64_t *listA, uint64_t *listB) {
     p1 = p3 = listA;
     p2 = listB;
 
+    // plain compares, this runs over the full nested candidate lists
     while (*p1 != UINT64_C(-1) && *p2 != UINT64_C(-1)) {
-        if (compare_uint64(p1, p2) == 0) {
+        if (*p1 == *p2) {
             *p3++ = *p1++;
             p2++;
+        } else if (*p1 < *p2) {
+            p1++;
         } else {
-            while (compare_uint64(p1, p2) < 0) ++p1;
-            while (compare_uint64(p1, p2) > 0) ++p2;
+            p2++;
         }
     }
     *p3 = UINT64_C(-1);
@@ -89,31 +94,55 @@ uint32_t nonce2key(uint32_t uid, uint32_t nt, uint32_t nr, uint32_t ar, uint64_t
     return i;
 }
 
+// Count the states which also give the second reader response, up to 20.
+// All states are clocked bitsliced, only the hits are rolled back to a key.
+static int mfkey32_verify(struct Crypto1State *s, nonces_t *data, uint32_t nonce2, uint32_t p64b, uint64_t *outkey) {
+
+    uint32_t count = 0;
+    while (s[count].odd | s[count].even)
+        count++;
+
+    const crypto1_bs_op_t ops[] = {
+        { CRYPTO1_BS_ROLLBACK, 0, 0, 0, 0 },
+        { CRYPTO1_BS_ROLLBACK, 1, 0, data->nr, 0 },
+        { CRYPTO1_BS_ROLLBACK, 0, 0, data->cuid ^ data->nonce, 0 },
+        { CRYPTO1_BS_FORWARD, 0, 0, data->cuid ^ nonce2, 0 },
+        { CRYPTO1_BS_FORWARD, 1, 0, data->nr2, 0 },
+        { CRYPTO1_BS_FORWARD, 0, 1, 0, data->ar2 ^ p64b },
+    };
+
+    int counter = 0;
+    uint32_t pos = 0;
+    while (pos < count && counter < 20) {
+        int32_t i = crypto1_bs_find(s + pos, count - pos, ops, ARRAYLEN(ops));
+        if (i < 0)
+            break;
+
+        struct Crypto1State *t = s + pos + i;
+        lfsr_rollback_word(t, 0, 0);
+        lfsr_rollback_word(t, data->nr, 1);
+        lfsr_rollback_word(t, data->cuid ^ data->nonce, 0);
+        crypto1_get_lfsr(t, outkey);
+
+        counter++;
+        pos += i + 1;
+    }
+    return counter;
+}
+
 // recover key from 2 different reader responses on same tag challenge
 bool mfkey32(nonces_t *data, uint64_t *outputkey) {
-    struct Crypto1State *s, *t;
+    struct Crypto1State *s;
     uint64_t outkey = 0;
-    uint64_t key = 0;     // recovered key
     bool isSuccess = false;
-    uint8_t counter = 0;
+    int counter = 0;
 
     uint32_t p640 = prng_successor(data->nonce, 64);
 
-    s = lfsr_recovery32(data->ar ^ p640, 0);
+    s = lfsr_recovery32_cached(data->ar ^ p640, 0);
+
+    counter = mfkey32_verify(s, data, data->nonce, p640, &outkey);
 
-    for (t = s; t->odd | t->even; ++t) {
-        lfsr_rollback_word(t, 0, 0);
-        lfsr_rollback_word(t, data->nr, 1);
-        lfsr_rollback_word(t, data->cuid ^ data->nonce, 0);
-        crypto1_get_lfsr(t, &key);
-        crypto1_word(t, data->cuid ^ data->nonce, 0);
-        crypto1_word(t, data->nr2, 1);
-        if (data->ar2 == (crypto1_word(t, 0, 0) ^ p640)) {
-            outkey = key;
-            counter++;
-            if (counter == 20) break;
-        }
-    }
     isSuccess = (counter == 1);
     *outputkey = (isSuccess) ? outkey : 0;
     crypto1_destroy(s);
@@ -123,30 +152,17 @@ bool mfkey32(nonces_t *data, uint64_t *outputkey) {
 // recover key from 2 reader responses on 2 different tag challenges
 // skip "several found keys".  Only return true if ONE key is found
 bool mfkey32_moebius(nonces_t *data, uint64_t *outputkey) {
-    struct Crypto1State *s, *t;
+    struct Crypto1State *s;
     uint64_t outkey  = 0;
-    uint64_t key     = 0; // recovered key
     bool isSuccess = false;
     int counter = 0;
     uint32_t p640 = prng_successor(data->nonce, 64);
     uint32_t p641 = prng_successor(data->nonce2, 64);
 
-    s = lfsr_recovery32(data->ar ^ p640, 0);
+    s = lfsr_recovery32_cached(data->ar ^ p640, 0);
+
+    counter = mfkey32_verify(s, data, data->nonce2, p641, &outkey);
 
-    for (t = s; t->odd | t->even; ++t) {
-        lfsr_rollback_word(t, 0, 0);
-        lfsr_rollback_word(t, data->nr, 1);
-        lfsr_rollback_word(t, data->cuid ^ data->nonce, 0);
-        crypto1_get_lfsr(t, &key);
-
-        crypto1_word(t, data->cuid ^ data->nonce2, 0);
-        crypto1_word(t, data->nr2, 1);
-        if (data->ar2 == (crypto1_word(t, 0, 0) ^ p641)) {
-            outkey = key;
-            ++counter;
-            if (counter == 20) break;
-        }
-    }
     isSuccess  = (counter == 1);
     *outputkey = (isSuccess) ? outkey : 0;
     crypto1_destroy(s);
@@ -163,7 +179,7 @@ int mfkey64(nonces_t *data, uint64_t *outputkey) {
     // Extract the keystream from the messages
     ks2 = data->ar ^ prng_successor(data->nonce, 64);
     ks3 = data->at ^ prng_successor(data->nonce, 96);
-    revstate = lfsr_recovery64(ks2, ks3);
+    revstate = lfsr_recovery64_cached(ks2, ks3);
     lfsr_rollback_word(revstate, 0, 0);
     lfsr_rollback_word(revstate, 0, 0);
     lfsr_rollback_word(revstate, data->nr, 1);
@@ -0,0 +1,371 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// MIFARE Classic key cache, hit ordered candidate keys for chk / fchk
+//
+// Every key found by chk / fchk is counted in ~/.proxmark3/mfc_key_cache.txt,
+// one line per profile and key:  <atqa> <sak> <manufacturer> <key> <hits>
+// Fleets of the same cards mostly share keys, so keys that hit on the same
+// kind of card before are tried first.
+//-----------------------------------------------------------------------------
+
+#include "mfkeycache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "pm3_cmd.h"
+#include "comms.h"          // SendCommandMIX
+#include "fileutils.h"      // loadFileDICTIONARY_safe
+#include "commonutil.h"     // bytes_to_num
+#include "ui.h"
+
+#define KEYCACHE_FILENAME   "mfc_key_cache.txt"
+#define KEYCACHE_DICTIONARY "mfc_default_keys"
+
+typedef struct {
+    mfkc_profile_t profile;
+    uint64_t key;
+    uint32_t hits;
+} mfkc_entry_t;
+
+typedef struct {
+    uint64_t key;
+    uint32_t exact;     // hits on the same profile
+    uint32_t similar;   // hits on the same ATQA / SAK
+    uint32_t any;       // hits on any card
+    uint32_t pos;       // first position in the merged list
+} mfkc_candidate_t;
+
+// open addressing, a slot holds the candidate index + 1, 0 is empty
+typedef struct {
+    uint32_t *slots;
+    uint32_t mask;
+} mfkc_keyset_t;
+
+static bool keyset_init(mfkc_keyset_t *set, uint32_t cnt) {
+    uint32_t size = 16;
+    while (size < cnt * 2)
+        size <<= 1;
+    set->mask = size - 1;
+    set->slots = calloc(size, sizeof(uint32_t));
+    return set->slots != NULL;
+}
+
+static uint32_t keyset_hash(uint64_t key) {
+    key ^= key >> 29;
+    key *= 0xBF58476D1CE4E5B9ULL;
+    key ^= key >> 32;
+    return (uint32_t)key;
+}
+
+// index of key in cands, or where to put it in *slot
+static int64_t keyset_find(const mfkc_keyset_t *set, const mfkc_candidate_t *cands, uint64_t key, uint32_t *slot) {
+    uint32_t i = keyset_hash(key) & set->mask;
+    while (set->slots[i]) {
+        if (cands[set->slots[i] - 1].key == key)
+            return set->slots[i] - 1;
+        i = (i + 1) & set->mask;
+    }
+    *slot = i;
+    return -1;
+}
+
+static char *keycache_path(bool create_home) {
+    char *path = NULL;
+    if (searchHomeFilePath(&path, NULL, KEYCACHE_FILENAME, create_home) != PM3_SUCCESS)
+        return NULL;
+    return path;
+}
+
+static bool profile_equal(const mfkc_profile_t *a, const mfkc_profile_t *b) {
+    return a->atqa == b->atqa && a->sak == b->sak && a->mfr == b->mfr;
+}
+
+static int keycache_load(mfkc_entry_t **entries, uint32_t *cnt) {
+    *entries = NULL;
+    *cnt = 0;
+
+    char *path = keycache_path(false);
+    if (path == NULL)
+        return PM3_SUCCESS;
+
+    FILE *f = fopen(path, "r");
+    free(path);
+    if (f == NULL)
+        return PM3_SUCCESS;
+
+    uint32_t cap = 0;
+    char line[80];
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#')
+            continue;
+
+        unsigned int atqa, sak, mfr, hits;
+        uint64_t key;
+        if (sscanf(line, "%x %x %x %" SCNx64 " %u", &atqa, &sak, &mfr, &key, &hits) != 5)
+            continue;
+
+        if (*cnt == cap) {
+            cap = cap ? cap * 2 : 64;
+            mfkc_entry_t *tmp = realloc(*entries, cap * sizeof(mfkc_entry_t));
+            if (tmp == NULL) {
+                fclose(f);
+                free(*entries);
+                *entries = NULL;
+                *cnt = 0;
+                return PM3_EMALLOC;
+            }
+            *entries = tmp;
+        }
+        mfkc_entry_t *e = &(*entries)[(*cnt)++];
+        e->profile.atqa = atqa & 0xFFFF;
+        e->profile.sak = sak & 0xFF;
+        e->profile.mfr = mfr & 0xFF;
+        e->key = key & 0xFFFFFFFFFFFF;
+        e->hits = hits;
+    }
+    fclose(f);
+    return PM3_SUCCESS;
+}
+
+static int keycache_save(const mfkc_entry_t *entries, uint32_t cnt) {
+
+    char *path = keycache_path(true);
+    if (path == NULL)
+        return PM3_EFILE;
+
+    // write aside and rename, another client may be reading it
+    size_t len = strlen(path) + 5;
+    char *tmp = calloc(len, sizeof(char));
+    if (tmp == NULL) {
+        free(path);
+        return PM3_EMALLOC;
+    }
+    snprintf(tmp, len, "%s.tmp", path);
+
+    int res = PM3_SUCCESS;
+    FILE *f = fopen(tmp, "w");
+    if (f == NULL) {
+        PrintAndLogEx(DEBUG, "keycache: could not write %s", tmp);
+        res = PM3_EFILE;
+        goto out;
+    }
+
+    bool ok = (fprintf(f, "# atqa sak manufacturer key hits\n") > 0);
+    for (uint32_t i = 0; i < cnt && ok; i++) {
+        const mfkc_entry_t *e = &entries[i];
+        ok = (fprintf(f, "%04x %02x %02x %012" PRIx64 " %u\n", e->profile.atqa, e->profile.sak, e->profile.mfr, e->key, e->hits) > 0);
+    }
+    ok &= (fclose(f) == 0);
+
+    if (ok == false || rename(tmp, path) != 0) {
+        remove(tmp);
+        res = PM3_EFILE;
+    }
+
+out:
+    free(tmp);
+    free(path);
+    return res;
+}
+
+int mfKeyCacheGetProfile(mfkc_profile_t *profile) {
+    memset(profile, 0, sizeof(mfkc_profile_t));
+
+    clearCommandBuffer();
+    SendCommandMIX(CMD_HF_ISO14443A_READER, ISO14A_CONNECT, 0, 0, NULL, 0);
+    PacketResponseNG resp;
+    if (WaitForResponseTimeout(CMD_ACK, &resp, 2500) == false) {
+        DropField();
+        return PM3_ETIMEOUT;
+    }
+    DropField();
+
+    // 0 card select failed, 1 all ok, 2 ok no ATS, 3 was proxmark3 answer
+    if (resp.oldarg[0] == 0 || resp.oldarg[0] == 3)
+        return PM3_ECARDEXCHANGE;
+
+    iso14a_card_select_t card;
+    memcpy(&card, (iso14a_card_select_t *)resp.data.asBytes, sizeof(iso14a_card_select_t));
+    profile->atqa = (card.atqa[1] << 8) | card.atqa[0];
+    profile->sak = card.sak;
+    profile->mfr = (card.uidlen > 4) ? card.uid[0] : 0;
+    return PM3_SUCCESS;
+}
+
+uint32_t mfKeyCacheDedup(uint8_t *keys, uint32_t keycnt) {
+
+    mfkc_keyset_t set;
+    mfkc_candidate_t *cands = calloc(keycnt, sizeof(mfkc_candidate_t));
+    if (cands == NULL || keyset_init(&set, keycnt) == false) {
+        free(cands);
+        return keycnt;
+    }
+
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < keycnt; i++) {
+        uint64_t key = bytes_to_num(keys + i * 6, 6);
+        uint32_t slot;
+        if (keyset_find(&set, cands, key, &slot) >= 0)
+            continue;
+
+        cands[n].key = key;
+        set.slots[slot] = n + 1;
+        memmove(keys + n * 6, keys + i * 6, 6);
+        n++;
+    }
+
+    free(set.slots);
+    free(cands);
+    return n;
+}
+
+static int candidate_cmp(const void *a, const void *b) {
+    const mfkc_candidate_t *x = a, *y = b;
+    if (x->exact != y->exact)
+        return (x->exact > y->exact) ? -1 : 1;
+    if (x->similar != y->similar)
+        return (x->similar > y->similar) ? -1 : 1;
+    if (x->any != y->any)
+        return (x->any > y->any) ? -1 : 1;
+    return (x->pos < y->pos) ? -1 : (x->pos > y->pos);
+}
+
+int mfKeyCacheBuild(const mfkc_profile_t *profile, const uint8_t *keys, uint32_t keycnt, uint8_t **out, uint32_t *outcnt) {
+    *out = NULL;
+    *outcnt = 0;
+
+    mfkc_entry_t *entries = NULL;
+    uint32_t entrycnt = 0;
+    int res = keycache_load(&entries, &entrycnt);
+    if (res != PM3_SUCCESS)
+        return res;
+
+    uint8_t *dict = NULL;
+    uint32_t dictcnt = 0;
+    if (loadFileDICTIONARY_safe(KEYCACHE_DICTIONARY, (void **)&dict, 6, &dictcnt) != PM3_SUCCESS)
+        dictcnt = 0;
+
+    uint32_t total = keycnt + dictcnt + entrycnt;
+    mfkc_keyset_t set = {0};
+    mfkc_candidate_t *cands = calloc(total + 1, sizeof(mfkc_candidate_t));
+    if (cands == NULL || keyset_init(&set, total) == false) {
+        res = PM3_EMALLOC;
+        goto out;
+    }
+
+    // given keys first, then the dictionary, then keys only known from earlier sessions
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < total; i++) {
+        uint64_t key;
+        if (i < keycnt)
+            key = bytes_to_num((uint8_t *)keys + i * 6, 6);
+        else if (i < keycnt + dictcnt)
+            key = bytes_to_num(dict + (i - keycnt) * 6, 6);
+        else
+            key = entries[i - keycnt - dictcnt].key;
+
+        uint32_t slot;
+        int64_t idx = keyset_find(&set, cands, key, &slot);
+        if (idx < 0) {
+            idx = n++;
+            cands[idx].key = key;
+            cands[idx].pos = i;
+            set.slots[slot] = idx + 1;
+        }
+
+        if (i >= keycnt + dictcnt) {
+            const mfkc_entry_t *e = &entries[i - keycnt - dictcnt];
+            cands[idx].any += e->hits;
+            if (e->profile.atqa == profile->atqa && e->profile.sak == profile->sak) {
+                cands[idx].similar += e->hits;
+                if (e->profile.mfr == profile->mfr)
+                    cands[idx].exact += e->hits;
+            }
+        }
+    }
+
+    qsort(cands, n, sizeof(mfkc_candidate_t), candidate_cmp);
+
+    *out = calloc(n, 6);
+    if (*out == NULL) {
+        res = PM3_EMALLOC;
+        goto out;
+    }
+
+    uint32_t hit = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        num_to_bytes(cands[i].key, 6, *out + i * 6);
+        if (cands[i].any)
+            hit++;
+    }
+    *outcnt = n;
+
+    PrintAndLogEx(INFO, "key cache: " _YELLOW_("%u") " unique keys, " _YELLOW_("%u") " with earlier hits go first", n, hit);
+
+out:
+    free(set.slots);
+    free(cands);
+    free(dict);
+    free(entries);
+    return res;
+}
+
+int mfKeyCacheRecord(const mfkc_profile_t *profile, const sector_t *e_sector, uint8_t sectorcnt) {
+
+    mfkc_entry_t *entries = NULL;
+    uint32_t entrycnt = 0;
+    int res = keycache_load(&entries, &entrycnt);
+    if (res != PM3_SUCCESS)
+        return res;
+
+    // room for every key of this card
+    mfkc_entry_t *tmp = realloc(entries, (entrycnt + sectorcnt * 2 + 1) * sizeof(mfkc_entry_t));
+    if (tmp == NULL) {
+        free(entries);
+        return PM3_EMALLOC;
+    }
+    entries = tmp;
+
+    uint64_t seen[80];
+    uint8_t seencnt = 0;
+    bool changed = false;
+    for (uint8_t s = 0; s < sectorcnt; s++) {
+        for (uint8_t j = 0; j < 2; j++) {
+            if (e_sector[s].foundKey[j] == 0)
+                continue;
+
+            uint64_t key = e_sector[s].Key[j];
+            bool dup = false;
+            for (uint8_t k = 0; k < seencnt && dup == false; k++)
+                dup = (seen[k] == key);
+            if (dup || seencnt == ARRAYLEN(seen))
+                continue;
+            seen[seencnt++] = key;
+
+            uint32_t i = 0;
+            while (i < entrycnt && (entries[i].key != key || profile_equal(&entries[i].profile, profile) == false))
+                i++;
+
+            if (i == entrycnt) {
+                entries[i].profile = *profile;
+                entries[i].key = key;
+                entries[i].hits = 0;
+                entrycnt++;
+            }
+            entries[i].hits++;
+            changed = true;
+        }
+    }
+
+    if (changed)
+        res = keycache_save(entries, entrycnt);
+
+    free(entries);
+    return res;
+}
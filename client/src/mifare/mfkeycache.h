@@ -0,0 +1,36 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// MIFARE Classic key cache, hit ordered candidate keys for chk / fchk
+//-----------------------------------------------------------------------------
+
+#ifndef MFKEYCACHE_H__
+#define MFKEYCACHE_H__
+
+#include "common.h"
+#include "mifarehost.h"   // sector_t
+
+// Cards are told apart by what anticollision gives away
+typedef struct {
+    uint16_t atqa;
+    uint8_t sak;
+    uint8_t mfr;        // first uid byte of 7 and 10 byte uids, 0 for 4 byte nuids
+} mfkc_profile_t;
+
+// Selects the card in the field and fills its profile
+int mfKeyCacheGetProfile(mfkc_profile_t *profile);
+
+// Removes duplicate 6 byte keys in place, the first occurrence stays. Returns the new key count
+uint32_t mfKeyCacheDedup(uint8_t *keys, uint32_t keycnt);
+
+// Candidate list for one card, owned by the caller. Merges keys with mfc_default_keys.dic and every
+// key found in earlier sessions, without duplicates. Ordered by hits on cards of the same profile,
+// then hits on cards with the same ATQA / SAK, then hits on any card, then the order of keys
+int mfKeyCacheBuild(const mfkc_profile_t *profile, const uint8_t *keys, uint32_t keycnt, uint8_t **out, uint32_t *outcnt);
+
+// Counts every distinct found key once as a hit for this profile
+int mfKeyCacheRecord(const mfkc_profile_t *profile, const sector_t *e_sector, uint8_t sectorcnt);
+
+#endif
@@ -367,68 +367,87 @@ int MFPWriteBlock(mf4Session_t *mf4session, uint8_t blockNum, uint8_t *data, boo
     return 0;
 }
 
-int mfpReadSector(uint8_t sectorNo, uint8_t keyType, uint8_t *key, uint8_t *dataout, bool verbose) {
-    uint8_t keyn[2] = {0};
-    bool plain = false;
-
-    uint16_t uKeyNum = 0x4000 + sectorNo * 2 + (keyType ? 1 : 0);
-    keyn[0] = uKeyNum >> 8;
-    keyn[1] = uKeyNum & 0xff;
-    if (verbose)
-        PrintAndLogEx(INFO, "--sector[%d]:%02x key:%04x", mfNumBlocksPerSector(sectorNo), sectorNo, uKeyNum);
-
-    mf4Session_t _session;
-    int res = MifareAuth4(&_session, keyn, key, true, true, true, verbose, false);
-    if (res) {
-        PrintAndLogEx(ERR, "Sector %d authentication error: %d", sectorNo, res);
-        return res;
-    }
-
+int MFPReadBlocks(mf4Session_t *mf4session, bool plain, uint8_t blockNum, uint8_t blockCount, uint8_t *dataout, bool verbose) {
     uint8_t data[250] = {0};
     int datalen = 0;
     uint8_t mac[8] = {0};
-    uint8_t firstBlockNo = mfFirstBlockOfSector(sectorNo);
-    for (int n = firstBlockNo; n < firstBlockNo + mfNumBlocksPerSector(sectorNo); n++) {
-        res = MFPReadBlock(&_session, plain, n & 0xff, 1, false, true, data, sizeof(data), &datalen, mac);
+
+    for (uint8_t done = 0; done < blockCount;) {
+        uint8_t n = blockNum + done;
+        // no data block run over a sector trailer, the trailer goes alone
+        uint8_t count = 1;
+        if (mfIsSectorTrailer(n) == false) {
+            while (count < MIN(blockCount - done, MFP_READ_BLOCKS_MAX) && mfIsSectorTrailer(n + count) == false)
+                count++;
+        }
+
+        int res = MFPReadBlock(mf4session, plain, n, count, false, true, data, sizeof(data), &datalen, mac);
         if (res) {
-            PrintAndLogEx(ERR, "Sector %d read error: %d", sectorNo, res);
-            DropField();
+            PrintAndLogEx(ERR, "Block %d read error: %d", n, res);
             return res;
         }
 
         if (datalen && data[0] != 0x90) {
-            PrintAndLogEx(ERR, "Sector %d card read error: %02x %s", sectorNo, data[0], mfpGetErrorDescription(data[0]));
-            DropField();
+            PrintAndLogEx(ERR, "Block %d card read error: %02x %s", n, data[0], mfpGetErrorDescription(data[0]));
             return 5;
         }
-        if (datalen != 1 + 16 + 8 + 2) {
-            PrintAndLogEx(ERR, "Sector %d error returned data length:%d", sectorNo, datalen);
-            DropField();
+        if (datalen != 1 + count * 16 + 8 + 2) {
+            PrintAndLogEx(ERR, "Block %d error returned data length:%d", n, datalen);
             return 6;
         }
 
-        memcpy(&dataout[(n - firstBlockNo) * 16], &data[1], 16);
+        memcpy(&dataout[done * 16], &data[1], count * 16);
 
-        if (verbose)
-            PrintAndLogEx(INFO, "data[%03d]: %s", n, sprint_hex(&data[1], 16));
+        if (verbose) {
+            for (uint8_t i = 0; i < count; i++)
+                PrintAndLogEx(INFO, "data[%03d]: %s", n + i, sprint_hex(&data[1 + i * 16], 16));
+        }
 
-        if (memcmp(&data[1 + 16], mac, 8)) {
+        if (memcmp(&data[1 + count * 16], mac, 8)) {
             PrintAndLogEx(WARNING, "WARNING: mac on block %d not equal...", n);
-            PrintAndLogEx(WARNING, "MAC   card: %s", sprint_hex(&data[1 + 16], 8));
+            PrintAndLogEx(WARNING, "MAC   card: %s", sprint_hex(&data[1 + count * 16], 8));
             PrintAndLogEx(WARNING, "MAC reader: %s", sprint_hex(mac, 8));
 
             if (!verbose)
                 return 7;
         } else {
             if (verbose)
-                PrintAndLogEx(INFO, "MAC: %s", sprint_hex(&data[1 + 16], 8));
+                PrintAndLogEx(INFO, "MAC: %s", sprint_hex(&data[1 + count * 16], 8));
         }
+
+        done += count;
     }
-    DropField();
 
     return 0;
 }
 
+int mfpReadSectorEx(uint8_t sectorNo, uint8_t keyType, uint8_t *key, uint8_t *dataout, bool activateField, bool leaveSignalON, bool verbose) {
+    uint8_t keyn[2] = {0};
+
+    uint16_t uKeyNum = 0x4000 + sectorNo * 2 + (keyType ? 1 : 0);
+    keyn[0] = uKeyNum >> 8;
+    keyn[1] = uKeyNum & 0xff;
+    if (verbose)
+        PrintAndLogEx(INFO, "--sector[%d]:%02x key:%04x", mfNumBlocksPerSector(sectorNo), sectorNo, uKeyNum);
+
+    mf4Session_t _session;
+    int res = MifareAuth4(&_session, keyn, key, activateField, true, true, verbose, false);
+    if (res) {
+        PrintAndLogEx(ERR, "Sector %d authentication error: %d", sectorNo, res);
+        return res;
+    }
+
+    res = MFPReadBlocks(&_session, false, mfFirstBlockOfSector(sectorNo), mfNumBlocksPerSector(sectorNo), dataout, verbose);
+    if (res || leaveSignalON == false)
+        DropField();
+
+    return res;
+}
+
+int mfpReadSector(uint8_t sectorNo, uint8_t keyType, uint8_t *key, uint8_t *dataout, bool verbose) {
+    return mfpReadSectorEx(sectorNo, keyType, key, dataout, true, false, verbose);
+}
+
 int MFPGetSignature(bool activateField, bool leaveSignalON, uint8_t *dataout, int maxdataoutlen, int *dataoutlen) {
     uint8_t c[] = {0x3c, 0x00};
     return intExchangeRAW14aPlus(c, sizeof(c), activateField, leaveSignalON, dataout, maxdataoutlen, dataoutlen);
@@ -57,7 +57,14 @@ int MFPWritePerso(uint8_t *keyNum, uint8_t *key, bool activateField, bool leaveS
 int MFPCommitPerso(bool activateField, bool leaveSignalON, uint8_t *dataout, int maxdataoutlen, int *dataoutlen);
 int MFPReadBlock(mf4Session_t *mf4session, bool plain, uint8_t blockNum, uint8_t blockCount, bool activateField, bool leaveSignalON, uint8_t *dataout, int maxdataoutlen, int *dataoutlen, uint8_t *mac);
 int MFPWriteBlock(mf4Session_t *mf4session, uint8_t blockNum, uint8_t *data, bool activateField, bool leaveSignalON, uint8_t *dataout, int maxdataoutlen, int *dataoutlen, uint8_t *mac);
+// blocks per read command without iso14443-4 chaining
+#define MFP_READ_BLOCKS_MAX 3
+// Reads blockCount blocks in an authenticated session, MFP_READ_BLOCKS_MAX per command. A sector trailer
+// is read alone. Checks the MAC of every response, the field stays on
+int MFPReadBlocks(mf4Session_t *mf4session, bool plain, uint8_t blockNum, uint8_t blockCount, uint8_t *dataout, bool verbose);
 int mfpReadSector(uint8_t sectorNo, uint8_t keyType, uint8_t *key, uint8_t *dataout, bool verbose);
+// with activateField false the sector is authenticated in the running ISO14443-4 session
+int mfpReadSectorEx(uint8_t sectorNo, uint8_t keyType, uint8_t *key, uint8_t *dataout, bool activateField, bool leaveSignalON, bool verbose);
 
 int MFPGetSignature(bool activateField, bool leaveSignalON, uint8_t *dataout, int maxdataoutlen, int *dataoutlen);
 int MFPGetVersion(bool activateField, bool leaveSignalON, uint8_t *dataout, int maxdataoutlen, int *dataoutlen);
@@ -10,6 +10,7 @@
 #include "mifarehost.h"
 
 #include <inttypes.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -20,18 +21,135 @@
 #include "ui.h"                 // PrintAndLog...
 #include "crapto1/crapto1.h"
 #include "crc16.h"
+#include "lz4/lz4.h"
 #include "protocols.h"
 #include "mfkey.h"
+#include "radixsort.h"
+#include "statecache.h"
 #include "util_posix.h"         // msclock
-#include "cmdparser.h"          // detection of flash capabilities
-#include "cmdflashmemspiffs.h"  // upload to flash mem
+
+// Darkside
+//
+// The device keeps collecting (nt, par, ks) tuples, one per reader nonce, while
+// a few workers turn the tuples already received into key candidates. As soon
+// as there are candidates the device is stopped and all of them are checked in
+// one batch.
+#define DARKSIDE_MAX_WORKERS    4   // lfsr_common_prefix() allocates 128MB per call
+
+typedef struct darkside_tuple {
+    uint32_t uid;
+    uint32_t nt;
+    uint32_t nr;
+    uint32_t ar;
+    uint64_t par_list;
+    uint64_t ks_list;
+    uint64_t *keylist;      // sorted, -1 terminated. Set by the worker
+    uint32_t keycount;
+    struct darkside_tuple *next;
+} darkside_tuple_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    darkside_tuple_t *todo;
+    darkside_tuple_t *todo_last;
+    darkside_tuple_t *done;
+    uint32_t busy;
+    bool stop;
+} darkside_pool_t;
+
+static void *darkside_worker_thread(void *arg) {
+    darkside_pool_t *pool = (darkside_pool_t *)arg;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->todo == NULL && pool->stop == false)
+            pthread_cond_wait(&pool->cond, &pool->lock);
+        if (pool->stop)
+            break;
+
+        darkside_tuple_t *t = pool->todo;
+        pool->todo = t->next;
+        if (pool->todo == NULL)
+            pool->todo_last = NULL;
+        pool->busy++;
+        pthread_mutex_unlock(&pool->lock);
+
+        t->keycount = nonce2key(t->uid, t->nt, t->nr, t->ar, t->par_list, t->ks_list, &t->keylist);
+        if (t->keycount) {
+            if (radixSort(t->keylist, t->keycount) == NULL)
+                qsort(t->keylist, t->keycount, sizeof(*t->keylist), compare_uint64);
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        pool->busy--;
+        t->next = pool->done;
+        pool->done = t;
+        pthread_cond_broadcast(&pool->cond);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+static void darkside_free_tuples(darkside_tuple_t *t) {
+    while (t) {
+        darkside_tuple_t *next = t->next;
+        free(t->keylist);
+        free(t);
+        t = next;
+    }
+}
+
+// stops the device stream and waits for its final frame
+static void darkside_stop_device(void) {
+    PacketResponseNG resp;
+    SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+    while (WaitForResponseTimeout(CMD_HF_MIFARE_READER_STREAM, &resp, 2000)) {
+        mf_darkside_stream_frame_t *frame = (mf_darkside_stream_frame_t *)resp.data.asBytes;
+        if (frame->final)
+            return;
+    }
+    clearCommandBuffer();
+    SendCommandNG(CMD_FPGA_MAJOR_MODE_OFF, NULL, 0);
+}
+
+// merges the finished parity lists into one sorted list without duplicates. Every list holds the key.
+static uint32_t darkside_merge(darkside_tuple_t *t, uint64_t **out) {
+    uint32_t cnt = 0;
+    for (darkside_tuple_t *p = t; p; p = p->next) {
+        if (p->par_list)
+            cnt += p->keycount;
+    }
+
+    *out = calloc(cnt + 1, sizeof(uint64_t));
+    if (*out == NULL)
+        return 0;
+
+    uint32_t n = 0;
+    for (darkside_tuple_t *p = t; p; p = p->next) {
+        if (p->par_list && p->keycount) {
+            memcpy(*out + n, p->keylist, p->keycount * sizeof(uint64_t));
+            n += p->keycount;
+        }
+    }
+
+    if (radixSort(*out, n) == NULL)
+        qsort(*out, n, sizeof(uint64_t), compare_uint64);
+
+    uint32_t u = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if (u == 0 || (*out)[u - 1] != (*out)[i])
+            (*out)[u++] = (*out)[i];
+    }
+    (*out)[u] = UINT64_C(-1);
+    return u;
+}
 
 int mfDarkside(uint8_t blockno, uint8_t key_type, uint64_t *key) {
-    uint32_t uid = 0;
-    uint32_t nt = 0, nr = 0, ar = 0;
-    uint64_t par_list = 0, ks_list = 0;
-    uint64_t *keylist = NULL, *last_keylist = NULL;
+    uint64_t *keylist = NULL, *common_keylist = NULL;
     bool first_run = true;
+    bool reported_no_par = false;
+    int res = PM3_SUCCESS;
 
     // message
     PrintAndLogEx(INFO, "--------------------------------------------------------------------------------");
@@ -39,128 +157,228 @@ int mfDarkside(uint8_t blockno, uint8_t key_type, uint64_t *key) {
     PrintAndLogEx(INFO, "press pm3-button on the Proxmark3 device to abort both Proxmark3 and client");
     PrintAndLogEx(INFO, "--------------------------------------------------------------------------------");
 
+    darkside_pool_t pool = {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .cond = PTHREAD_COND_INITIALIZER,
+    };
+
+    int num_workers = MAX(1, MIN(num_CPUs(), DARKSIDE_MAX_WORKERS));
+    pthread_t workers[DARKSIDE_MAX_WORKERS];
+    for (int i = 0; i < num_workers; i++) {
+        if (pthread_create(&workers[i], NULL, darkside_worker_thread, &pool) != 0) {
+            num_workers = i;
+            break;
+        }
+    }
+    if (num_workers == 0)
+        return PM3_EMALLOC;
+
     while (true) {
         clearCommandBuffer();
-        struct {
-            uint8_t first_run;
-            uint8_t blockno;
-            uint8_t key_type;
-        } PACKED payload;
-        payload.first_run = first_run;
-        payload.blockno = blockno;
-        payload.key_type = key_type;
-        SendCommandNG(CMD_HF_MIFARE_READER, (uint8_t *)&payload, sizeof(payload));
+        mf_darkside_stream_req_t payload = {
+            .first_run = first_run,
+            .blockno = blockno,
+            .key_type = key_type,
+        };
+        SendCommandNG(CMD_HF_MIFARE_READER_STREAM, (uint8_t *)&payload, sizeof(payload));
 
         //flush queue
         while (kbd_enter_pressed()) {
-            return PM3_EOPABORTED;
+            darkside_stop_device();
+            res = PM3_EOPABORTED;
+            goto out;
         }
 
-        // wait cycle
-        while (true) {
-            PrintAndLogEx(NORMAL, "." NOLF);
+        uint32_t keycount = 0;
+        bool device_stopped = false;
+
+        // collect tuples until the workers came up with candidates
+        while (keycount == 0) {
 
             if (kbd_enter_pressed()) {
-                return PM3_EOPABORTED;
+                darkside_stop_device();
+                res = PM3_EOPABORTED;
+                goto out;
             }
 
             PacketResponseNG resp;
-            if (WaitForResponseTimeout(CMD_HF_MIFARE_READER, &resp, 2000)) {
-                if (resp.status == PM3_EOPABORTED) {
-                    return -1;
+            if (WaitForResponseTimeout(CMD_HF_MIFARE_READER_STREAM, &resp, 1000)) {
+                mf_darkside_stream_frame_t *frame = (mf_darkside_stream_frame_t *)resp.data.asBytes;
+
+                if (frame->final) {
+                    device_stopped = true;
+                    if (resp.status == PM3_EOPABORTED) {
+                        res = -1;
+                        goto out;
+                    }
+                    if (frame->isOK == -6) {
+                        *key = 0101;
+                        res = 1;
+                        goto out;
+                    }
+                    if (frame->isOK < 0) {
+                        res = frame->isOK;
+                        goto out;
+                    }
+                    res = PM3_ESOFT;
+                    goto out;
                 }
 
-                struct p {
-                    int32_t isOK;
-                    uint8_t cuid[4];
-                    uint8_t nt[4];
-                    uint8_t par_list[8];
-                    uint8_t ks_list[8];
-                    uint8_t nr[4];
-                    uint8_t ar[4];
-                } PACKED;
-
-                struct p *package = (struct p *) resp.data.asBytes;
-
-                if (package->isOK == -6) {
-                    *key = 0101;
-                    return 1;
+                darkside_tuple_t *t = calloc(1, sizeof(darkside_tuple_t));
+                if (t == NULL) {
+                    darkside_stop_device();
+                    res = PM3_EMALLOC;
+                    goto out;
+                }
+                t->uid = (uint32_t)bytes_to_num(frame->cuid, sizeof(frame->cuid));
+                t->nt = (uint32_t)bytes_to_num(frame->nt, sizeof(frame->nt));
+                t->par_list = bytes_to_num(frame->par_list, sizeof(frame->par_list));
+                t->ks_list = bytes_to_num(frame->ks_list, sizeof(frame->ks_list));
+                t->nr = (uint32_t)bytes_to_num(frame->nr, sizeof(frame->nr));
+                t->ar = (uint32_t)bytes_to_num(frame->ar, sizeof(frame->ar));
+
+                if (t->par_list == 0 && first_run && reported_no_par == false) {
+                    PrintAndLogEx(NORMAL, "");
+                    PrintAndLogEx(SUCCESS, "Parity is all zero. Most likely this card sends NACK on every authentication.");
+                    reported_no_par = true;
                 }
 
-                if (package->isOK < 0)
-                    return package->isOK;
+                pthread_mutex_lock(&pool.lock);
+                if (pool.todo_last)
+                    pool.todo_last->next = t;
+                else
+                    pool.todo = t;
+                pool.todo_last = t;
+                pthread_cond_signal(&pool.cond);
+                pthread_mutex_unlock(&pool.lock);
+            } else {
+                PrintAndLogEx(NORMAL, "." NOLF);
+            }
+
+            // look at what the workers finished meanwhile
+            pthread_mutex_lock(&pool.lock);
+            darkside_tuple_t *done = pool.done;
+            pool.done = NULL;
+            pthread_mutex_unlock(&pool.lock);
 
+            for (darkside_tuple_t *t = done; t; t = t->next) {
 
-                uid = (uint32_t)bytes_to_num(package->cuid, sizeof(package->cuid));
-                nt = (uint32_t)bytes_to_num(package->nt, sizeof(package->nr));
-                par_list = bytes_to_num(package->par_list, sizeof(package->par_list));
-                ks_list = bytes_to_num(package->ks_list, sizeof(package->ks_list));
-                nr = (uint32_t)bytes_to_num(package->nr, 4);
-                ar = (uint32_t)bytes_to_num(package->ar, 4);
-                break;
+                if (t->keycount == 0) {
+                    PrintAndLogEx(NORMAL, "");
+                    PrintAndLogEx(FAILED, "key not found (lfsr_common_prefix list is null). Nt=%08x", t->nt);
+                    PrintAndLogEx(FAILED, "this is expected to happen in 25%% of all cases. Trying again with a different reader nonce...");
+                    continue;
+                }
+
+                // only parity zero attack
+                if (t->par_list == 0) {
+                    if (common_keylist == NULL) {
+                        common_keylist = t->keylist;
+                        t->keylist = NULL;
+                        continue;
+                    }
+                    uint32_t cnt = intersection(common_keylist, t->keylist);
+                    if (cnt == 0) {
+                        free(common_keylist);
+                        common_keylist = t->keylist;
+                        t->keylist = NULL;
+                        PrintAndLogEx(NORMAL, "");
+                        PrintAndLogEx(FAILED, "no candidates found, trying again");
+                        continue;
+                    }
+                    free(keylist);
+                    keylist = common_keylist;
+                    common_keylist = NULL;
+                    keycount = cnt;
+                    break;
+                }
+
+                keycount = t->keycount;
             }
+
+            // lists of tuples with parity, merged below
+            if (keycount && keylist == NULL) {
+                pthread_mutex_lock(&pool.lock);
+                darkside_tuple_t *last = done;
+                while (last->next)
+                    last = last->next;
+                last->next = pool.done;
+                pool.done = done;
+                pthread_mutex_unlock(&pool.lock);
+                done = NULL;
+            }
+            darkside_free_tuples(done);
         }
         PrintAndLogEx(NORMAL, "\n");
 
-        if (par_list == 0 && first_run == true) {
-            PrintAndLogEx(SUCCESS, "Parity is all zero. Most likely this card sends NACK on every authentication.");
-        }
+        if (device_stopped == false)
+            darkside_stop_device();
+
+        // drop the tuples not started yet, the ones in flight may add candidates
+        pthread_mutex_lock(&pool.lock);
+        darkside_free_tuples(pool.todo);
+        pool.todo = pool.todo_last = NULL;
+        while (pool.busy)
+            pthread_cond_wait(&pool.cond, &pool.lock);
+        darkside_tuple_t *done = pool.done;
+        pool.done = NULL;
+        pthread_mutex_unlock(&pool.lock);
+
+        if (keylist == NULL)
+            keycount = darkside_merge(done, &keylist);
+        darkside_free_tuples(done);
         first_run = false;
 
-        uint32_t keycount = nonce2key(uid, nt, nr, ar, par_list, ks_list, &keylist);
-
         if (keycount == 0) {
-            PrintAndLogEx(FAILED, "key not found (lfsr_common_prefix list is null). Nt=%08x", nt);
-            PrintAndLogEx(FAILED, "this is expected to happen in 25%% of all cases. Trying again with a different reader nonce...");
-            continue;
-        }
-
-        // only parity zero attack
-        if (par_list == 0) {
-            qsort(keylist, keycount, sizeof(*keylist), compare_uint64);
-            keycount = intersection(last_keylist, keylist);
-            if (keycount == 0) {
-                free(last_keylist);
-                last_keylist = keylist;
-                PrintAndLogEx(FAILED, "no candidates found, trying again");
-                continue;
-            }
+            res = PM3_EMALLOC;
+            goto out;
         }
 
         PrintAndLogEx(SUCCESS, "found " _YELLOW_("%u") " candidate key%s", keycount, (keycount > 1) ? "s." : ".");
 
-        *key = UINT64_C(-1);
-        uint8_t keyBlock[PM3_CMD_DATA_SIZE];
-        uint32_t max_keys = KEYS_IN_BLOCK;
-        for (uint32_t i = 0; i < keycount; i += max_keys) {
-
-            uint8_t size = keycount - i > max_keys ? max_keys : keycount - i;
-            register uint8_t j;
-            for (j = 0; j < size; j++) {
-                if (par_list == 0) {
-                    num_to_bytes(last_keylist[i * max_keys + j], 6, keyBlock + (j * 6));
-                } else {
-                    num_to_bytes(keylist[i * max_keys + j], 6, keyBlock + (j * 6));
-                }
-            }
-
-            if (mfCheckKeys(blockno, key_type - 0x60, false, size, keyBlock, key) == PM3_SUCCESS) {
-                break;
-            }
+        uint8_t *keyBlock = calloc(keycount, 6);
+        if (keyBlock == NULL) {
+            res = PM3_EMALLOC;
+            goto out;
         }
+        for (uint32_t i = 0; i < keycount; i++) {
+            num_to_bytes(keylist[i], 6, keyBlock + (i * 6));
+        }
+
+        *key = UINT64_C(-1);
+        int check = mfCheckKeys_batch(blockno, key_type - 0x60, keycount, keyBlock, key);
+        free(keyBlock);
+        free(keylist);
+        keylist = NULL;
 
-        if (*key != UINT64_C(-1)) {
+        if (check == PM3_SUCCESS) {
             break;
-        } else {
-            PrintAndLogEx(FAILED, "all key candidates failed. Restarting darkside attack");
-            free(last_keylist);
-            last_keylist = keylist;
-            first_run = true;
         }
+        if (check == PM3_EOPABORTED) {
+            res = PM3_EOPABORTED;
+            goto out;
+        }
+
+        PrintAndLogEx(FAILED, "all key candidates failed. Restarting darkside attack");
+        free(common_keylist);
+        common_keylist = NULL;
+        first_run = true;
+        reported_no_par = false;
     }
-    free(last_keylist);
+
+out:
+    pthread_mutex_lock(&pool.lock);
+    pool.stop = true;
+    pthread_cond_broadcast(&pool.cond);
+    pthread_mutex_unlock(&pool.lock);
+    for (int i = 0; i < num_workers; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    darkside_free_tuples(pool.todo);
+    darkside_free_tuples(pool.done);
+    free(common_keylist);
     free(keylist);
-    return PM3_SUCCESS;
+    return res;
 }
 
 int mfCheckKeys(uint8_t blockNo, uint8_t keyType, bool clear_trace, uint8_t keycnt, uint8_t *keyBlock, uint64_t *key) {
@@ -315,6 +533,189 @@ int mfCheckKeys_file(uint8_t *destfn, uint64_t *key) {
     return PM3_SUCCESS;
 }
 
+// Loads a candidate key list into device memory. Frames are pipelined and LZ4 compressed when it pays off
+#define MF_CHKKEYS_LOAD_WINDOW 8
+static int mfLoadKeys_batch(uint8_t *keyBlock, uint32_t keycnt) {
+
+    uint32_t len = keycnt * 6;
+    uint32_t offset = 0;
+    uint32_t seq[MF_CHKKEYS_LOAD_WINDOW] = {0};
+    uint32_t sent = 0, acked = 0;
+    int res = PM3_SUCCESS;
+    PacketResponseNG resp;
+    mf_chkkeys_load_t payload;
+
+    clearCommandBuffer();
+
+    while (offset < len || acked < sent) {
+
+        if (offset < len && sent - acked < MF_CHKKEYS_LOAD_WINDOW) {
+            payload.flags = 0;
+            payload.offset = offset;
+
+            uint16_t datalen;
+            int srclen = MIN(len - offset, UINT16_MAX);
+            int clen = LZ4_compress_destSize((const char *)keyBlock + offset, (char *)payload.data, &srclen, sizeof(payload.data));
+            if (clen > 0 && srclen > (int)sizeof(payload.data)) {
+                payload.flags |= MF_CHKKEYS_LOAD_LZ4;
+                payload.rawlen = srclen;
+                datalen = clen;
+            } else {
+                payload.rawlen = MIN(len - offset, sizeof(payload.data));
+                memcpy(payload.data, keyBlock + offset, payload.rawlen);
+                datalen = payload.rawlen;
+            }
+
+            res = SendCommandNGAsync(CMD_HF_MIFARE_CHKKEYS_LOAD, (uint8_t *)&payload, offsetof(mf_chkkeys_load_t, data) + datalen, &seq[sent % MF_CHKKEYS_LOAD_WINDOW]);
+            if (res != PM3_SUCCESS)
+                break;
+
+            sent++;
+            offset += payload.rawlen;
+            continue;
+        }
+
+        if (WaitForResponseSeq(seq[acked % MF_CHKKEYS_LOAD_WINDOW], &resp, 2000) == false) {
+            res = PM3_ETIMEOUT;
+            break;
+        }
+        acked++;
+
+        if (resp.status != PM3_SUCCESS) {
+            res = resp.status;
+            break;
+        }
+    }
+
+    // don't leave replies behind for the next command
+    for (; acked < sent; acked++)
+        WaitForResponseSeq(seq[acked % MF_CHKKEYS_LOAD_WINDOW], NULL, 2000);
+
+    return res;
+}
+
+// Checks a candidate key list of any size, in batches of MF_CHKKEYS_BATCH_MAX_KEYS keys loaded into device memory.
+// The device stops at the first valid key
+int mfCheckKeys_batch(uint8_t blockNo, uint8_t keyType, uint32_t keycnt, uint8_t *keyBlock, uint64_t *key) {
+    *key = -1;
+
+    uint64_t start_time = msclock();
+
+    for (uint32_t i = 0; i < keycnt; i += MF_CHKKEYS_BATCH_MAX_KEYS) {
+
+        uint32_t size = MIN(keycnt - i, MF_CHKKEYS_BATCH_MAX_KEYS);
+
+        int res = mfLoadKeys_batch(keyBlock + i * 6, size);
+        if (res != PM3_SUCCESS) {
+            PrintAndLogEx(WARNING, "\nFailed to load candidate keys to device (%d)", res);
+            return res;
+        }
+
+        mf_chkkeys_batch_req_t req = {
+            .keytype = keyType,
+            .blockno = blockNo,
+            .keycnt = size
+        };
+
+        clearCommandBuffer();
+        SendCommandNG(CMD_HF_MIFARE_CHKKEYS_BATCH, (uint8_t *)&req, sizeof(req));
+
+        bool aborted = false;
+        while (true) {
+            PacketResponseNG resp;
+            if (WaitForResponseTimeout(CMD_HF_MIFARE_CHKKEYS_BATCH, &resp, 2500) == false) {
+                SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+                return PM3_ETIMEOUT;
+            }
+
+            // any command stops the device loop
+            if (aborted == false && kbd_enter_pressed()) {
+                SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+                aborted = true;
+            }
+
+            mf_chkkeys_batch_resp_t *result = (mf_chkkeys_batch_resp_t *)resp.data.asBytes;
+
+            if (result->final == false) {
+                uint32_t done = i + result->checked;
+                float bruteforce_per_second = (float)done / ((msclock() - start_time) / 1000.0);
+                if (bruteforce_per_second > 0)
+                    PrintAndLogEx(INPLACE, "%6u/%u keys | %5.1f keys/sec | worst case %6.1f seconds remaining", done, keycnt, bruteforce_per_second, (keycnt - done) / bruteforce_per_second);
+                continue;
+            }
+
+            if (resp.status != PM3_SUCCESS)
+                return resp.status;
+
+            if (result->found) {
+                *key = bytes_to_num(result->key, sizeof(result->key));
+                return PM3_SUCCESS;
+            }
+            break;
+        }
+    }
+    return PM3_ESOFT;
+}
+
+// Checks all sectors against a dictionary file in the device SPIFFS. The device reads the keys itself,
+// only progress frames and the result cross the link
+int mfCheckKeys_spiffs(uint8_t sectorsCnt, const char *filename, sector_t *e_sector) {
+
+    mf_chkkeys_spiffs_req_t req;
+    memset(&req, 0, sizeof(req));
+    req.sectorcnt = sectorsCnt;
+    strncpy((char *)req.filename, filename, sizeof(req.filename) - 1);
+
+    uint64_t start_time = msclock();
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_MIFARE_CHKKEYS_SPIFFS, (uint8_t *)&req, sizeof(req));
+
+    bool aborted = false;
+    PacketResponseNG resp;
+    mf_chkkeys_spiffs_resp_t *result = (mf_chkkeys_spiffs_resp_t *)resp.data.asBytes;
+    while (true) {
+        if (WaitForResponseTimeout(CMD_HF_MIFARE_CHKKEYS_SPIFFS, &resp, 2500) == false) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            return PM3_ETIMEOUT;
+        }
+
+        // any command stops the device loop
+        if (aborted == false && kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            aborted = true;
+        }
+
+        if (result->final)
+            break;
+
+        float keys_per_second = (float)result->checked / ((msclock() - start_time) / 1000.0);
+        PrintAndLogEx(INPLACE, "%6u keys | %5.1f keys/sec | found %u/%u keys", result->checked, keys_per_second, result->foundkeys, sectorsCnt << 1);
+    }
+    PrintAndLogEx(NORMAL, "");
+
+    if (resp.status != PM3_SUCCESS && resp.status != PM3_EOPABORTED)
+        return resp.status;
+
+    PrintAndLogEx(INFO, "checked " _YELLOW_("%u") " keys in %.1fs | found %u/%u keys", result->checked, (float)((msclock() - start_time) / 1000.0), result->foundkeys, sectorsCnt << 1);
+
+    icesector_t *keys = (icesector_t *)result->keys;
+    for (int i = 0; i < sectorsCnt; i++) {
+        for (int j = 0; j < 2; j++) {
+            uint8_t m = i * 2 + j;
+            if (e_sector[i].foundKey[j] || ((result->found[m >> 3] >> (m & 7)) & 1) == 0)
+                continue;
+            e_sector[i].Key[j] = bytes_to_num(j ? keys[i].keyB : keys[i].keyA, 6);
+            e_sector[i].foundKey[j] = 1;
+        }
+    }
+
+    if (resp.status == PM3_EOPABORTED)
+        return PM3_EOPABORTED;
+
+    return (result->foundkeys == sectorsCnt * 2) ? PM3_SUCCESS : PM3_ESOFT;
+}
+
 // PM3 imp of J-Run mf_key_brute (part 2)
 // ref: https://github.com/J-Run/mf_key_brute
 int mfKeyBrute(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint64_t *resultkey) {
@@ -366,6 +767,38 @@ inline static int Compare16Bits(const void *a, const void *b) {
     return -1;
 }
 
+// Same order as qsort with Compare16Bits (descending), as two counting passes over the bytes it looks at
+static bool sort16bits(uint64_t *list, uint32_t len) {
+    uint64_t *cpy = calloc(len + 1, sizeof(uint64_t));
+    if (cpy == NULL)
+        return false;
+
+    uint32_t lo[256] = {0}, hi[256] = {0};
+    for (uint32_t i = 0; i < len; i++) {
+        lo[(list[i] >> 16) & 0xff]++;
+        hi[(list[i] >> 48) & 0xff]++;
+    }
+
+    // descending offsets
+    uint32_t olo = 0, ohi = 0;
+    for (int i = 0xff; i >= 0; i--) {
+        uint32_t t = lo[i];
+        lo[i] = olo;
+        olo += t;
+        t = hi[i];
+        hi[i] = ohi;
+        ohi += t;
+    }
+
+    for (uint32_t i = 0; i < len; i++)
+        cpy[lo[(list[i] >> 16) & 0xff]++] = list[i];
+    for (uint32_t i = 0; i < len; i++)
+        list[hi[(cpy[i] >> 48) & 0xff]++] = cpy[i];
+
+    free(cpy);
+    return true;
+}
+
 // wrapper function for multi-threaded lfsr_recovery32
 static void
 #ifdef __has_attribute
@@ -376,23 +809,39 @@ __attribute__((force_align_arg_pointer))
 *nested_worker_thread(void *arg) {
     struct Crypto1State *p1;
     StateList_t *statelist = arg;
-    statelist->head.slhead = lfsr_recovery32(statelist->ks1, statelist->nt_enc ^ statelist->uid);
+    statelist->head.slhead = lfsr_recovery32_cached(statelist->ks1, statelist->nt_enc ^ statelist->uid);
 
     for (p1 = statelist->head.slhead; p1->odd | p1->even; p1++) {};
 
     statelist->len = p1 - statelist->head.slhead;
     statelist->tail.sltail = --p1;
 
-    qsort(statelist->head.slhead, statelist->len, sizeof(uint64_t), Compare16Bits);
+    if (sort16bits(statelist->head.keyhead, statelist->len) == false)
+        qsort(statelist->head.slhead, statelist->len, sizeof(uint64_t), Compare16Bits);
 
     return statelist->head.slhead;
 }
 
-int mfnested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *resultKey, bool calibrate) {
+// wrapper function for multi-threaded rollback and sort of the 16 bit intersected statelists
+static void
+#ifdef __has_attribute
+#if __has_attribute(force_align_arg_pointer)
+__attribute__((force_align_arg_pointer))
+#endif
+#endif
+*nested_rollback_thread(void *arg) {
+    StateList_t *statelist = arg;
 
-    uint32_t uid;
-    StateList_t statelists[2];
-    struct Crypto1State *p1, *p2, *p3, *p4;
+    for (struct Crypto1State *p1 = statelist->head.slhead; p1 <= statelist->tail.sltail; p1++)
+        lfsr_rollback_word(p1, statelist->nt_enc ^ statelist->uid, 0);
+
+    if (radixSort(statelist->head.keyhead, statelist->len) == NULL)
+        qsort(statelist->head.keyhead, statelist->len, sizeof(uint64_t), compare_uint64);
+
+    return statelist->head.slhead;
+}
+
+int mfnested_collect(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, bool calibrate, nested_nonces_t *nn) {
 
     struct {
         uint8_t block;
@@ -434,19 +883,32 @@ int mfnested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo,
     if (package->isOK != PM3_SUCCESS)
         return package->isOK;
 
+    memset(nn, 0, sizeof(nested_nonces_t));
+
+    uint32_t uid;
     memcpy(&uid, package->cuid, sizeof(package->cuid));
 
     for (uint8_t i = 0; i < 2; i++) {
-        statelists[i].blockNo = package->block;
-        statelists[i].keyType = package->keytype;
-        statelists[i].uid = uid;
+        nn->statelists[i].blockNo = package->block;
+        nn->statelists[i].keyType = package->keytype;
+        nn->statelists[i].uid = uid;
     }
 
-    memcpy(&statelists[0].nt_enc,  package->nt_a, sizeof(package->nt_a));
-    memcpy(&statelists[0].ks1, package->ks_a, sizeof(package->ks_a));
+    memcpy(&nn->statelists[0].nt_enc,  package->nt_a, sizeof(package->nt_a));
+    memcpy(&nn->statelists[0].ks1, package->ks_a, sizeof(package->ks_a));
+
+    memcpy(&nn->statelists[1].nt_enc,  package->nt_b, sizeof(package->nt_b));
+    memcpy(&nn->statelists[1].ks1, package->ks_b, sizeof(package->ks_b));
+    return PM3_SUCCESS;
+}
+
+int mfnested_recover(nested_nonces_t *nn) {
+
+    StateList_t *statelists = nn->statelists;
+    struct Crypto1State *p1, *p2, *p3, *p4;
 
-    memcpy(&statelists[1].nt_enc,  package->nt_b, sizeof(package->nt_b));
-    memcpy(&statelists[1].ks1, package->ks_b, sizeof(package->ks_b));
+    nn->keys = NULL;
+    nn->keycnt = 0;
 
     // calc keys
     pthread_t thread_id[2];
@@ -460,8 +922,8 @@ int mfnested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo,
         pthread_join(thread_id[i], (void *)&statelists[i].head.slhead);
 
     // the first 16 Bits of the cryptostate already contain part of our key.
-    // Create the intersection of the two lists based on these 16 Bits and
-    // roll back the cryptostate
+    // Create the intersection of the two lists based on these 16 Bits,
+    // the cryptostates are rolled back afterwards, one thread per list
     p1 = p3 = statelists[0].head.slhead;
     p2 = p4 = statelists[1].head.slhead;
 
@@ -471,17 +933,11 @@ int mfnested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo,
             struct Crypto1State savestate;
             savestate = *p1;
             while (Compare16Bits(p1, &savestate) == 0 && p1 <= statelists[0].tail.sltail) {
-                *p3 = *p1;
-                lfsr_rollback_word(p3, statelists[0].nt_enc ^ statelists[0].uid, 0);
-                p3++;
-                p1++;
+                *p3++ = *p1++;
             }
             savestate = *p2;
             while (Compare16Bits(p2, &savestate) == 0 && p2 <= statelists[1].tail.sltail) {
-                *p4 = *p2;
-                lfsr_rollback_word(p4, statelists[1].nt_enc ^ statelists[1].uid, 0);
-                p4++;
-                p2++;
+                *p4++ = *p2++;
             }
         } else {
             while (Compare16Bits(p1, p2) == -1) p1++;
@@ -498,72 +954,128 @@ int mfnested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo,
     statelists[0].tail.sltail = --p3;
     statelists[1].tail.sltail = --p4;
 
+    // roll back and sort both lists
+    for (uint8_t i = 0; i < 2; i++)
+        pthread_create(thread_id + i, NULL, nested_rollback_thread, &statelists[i]);
+
+    for (uint8_t i = 0; i < 2; i++)
+        pthread_join(thread_id[i], (void *)&statelists[i].head.slhead);
+
     // the statelists now contain possible keys. The key we are searching for must be in the
     // intersection of both lists
-    qsort(statelists[0].head.keyhead, statelists[0].len, sizeof(uint64_t), compare_uint64);
-    qsort(statelists[1].head.keyhead, statelists[1].len, sizeof(uint64_t), compare_uint64);
     // Create the intersection
     statelists[0].len = intersection(statelists[0].head.keyhead, statelists[1].head.keyhead);
 
-    //statelists[0].tail.keytail = --p7;
+    int res = PM3_ESOFT;
     uint32_t keycnt = statelists[0].len;
-    if (keycnt == 0) goto out;
+    if (keycnt == 0)
+        goto out;
 
-    PrintAndLogEx(SUCCESS, "Found " _YELLOW_("%u") " key candidates", keycnt);
+    nn->keys = calloc(keycnt, sizeof(uint64_t));
+    if (nn->keys == NULL) {
+        res = PM3_EMALLOC;
+        goto out;
+    }
+
+    for (uint32_t i = 0; i < keycnt; i++)
+        crypto1_get_lfsr(statelists[0].head.slhead + i, &nn->keys[i]);
+
+    nn->keycnt = keycnt;
+    res = PM3_SUCCESS;
+
+out:
+    free(statelists[0].head.slhead);
+    free(statelists[1].head.slhead);
+    return res;
+}
+
+int mfnested_check(nested_nonces_t *nn, uint8_t *resultKey) {
 
     memset(resultKey, 0, 6);
     uint64_t key64 = -1;
 
-    // The list may still contain several key candidates. Test each of them with mfCheckKeys
-    uint32_t max_keys = keycnt > KEYS_IN_BLOCK ? KEYS_IN_BLOCK : keycnt;
-    uint8_t keyBlock[PM3_CMD_DATA_SIZE] = {0x00};
+    // The list may still contain several key candidates. Test all of them on the device in one go
+    uint8_t *keyBlock = calloc(nn->keycnt, 6);
+    if (keyBlock == NULL) {
+        free(nn->keys);
+        nn->keys = NULL;
+        return PM3_EMALLOC;
+    }
 
-    for (uint32_t i = 0; i < keycnt; i += max_keys) {
+    for (uint32_t i = 0; i < nn->keycnt; i++)
+        num_to_bytes(nn->keys[i], 6, keyBlock + i * 6);
 
-        uint64_t start_time = msclock();
+    int res = mfCheckKeys_batch(nn->statelists[0].blockNo, nn->statelists[0].keyType, nn->keycnt, keyBlock, &key64);
+    free(keyBlock);
+    free(nn->keys);
+    nn->keys = NULL;
 
-        uint8_t size = keycnt - i > max_keys ? max_keys : keycnt - i;
+    if (res != PM3_SUCCESS)
+        return PM3_ESOFT;
 
-        register uint8_t j;
-        for (j = 0; j < size; j++) {
-            crypto1_get_lfsr(statelists[0].head.slhead + i, &key64);
-            num_to_bytes(key64, 6, keyBlock + j * 6);
-        }
+    num_to_bytes(key64, 6, resultKey);
+    return PM3_SUCCESS;
+}
+
+int mfnested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *resultKey, bool calibrate) {
+
+    nested_nonces_t nn;
+    int res = mfnested_collect(blockNo, keyType, key, trgBlockNo, trgKeyType, calibrate, &nn);
+    if (res != PM3_SUCCESS)
+        return res;
+
+    res = mfnested_recover(&nn);
+    if (res == PM3_EMALLOC)
+        return res;
 
-        if (mfCheckKeys(statelists[0].blockNo, statelists[0].keyType, false, size, keyBlock, &key64) == PM3_SUCCESS) {
-            free(statelists[0].head.slhead);
-            free(statelists[1].head.slhead);
-            num_to_bytes(key64, 6, resultKey);
+    if (res == PM3_SUCCESS) {
+        PrintAndLogEx(SUCCESS, "Found " _YELLOW_("%u") " key candidates", nn.keycnt);
 
+        res = mfnested_check(&nn, resultKey);
+        if (res == PM3_EMALLOC)
+            return res;
+
+        if (res == PM3_SUCCESS) {
             PrintAndLogEx(SUCCESS, "\ntarget block:%3u key type: %c  -- found valid key [ " _GREEN_("%s") "]",
-                          package->block,
-                          package->keytype ? 'B' : 'A',
+                          nn.statelists[0].blockNo,
+                          nn.statelists[0].keyType ? 'B' : 'A',
                           sprint_hex(resultKey, 6)
                          );
             return PM3_SUCCESS;
         }
-
-        float bruteforce_per_second = (float)(i + max_keys) / ((msclock() - start_time) / 1000.0);
-        PrintAndLogEx(INPLACE, "%6d/%u keys | %5.1f keys/sec | worst case %6.1f seconds remaining", i, keycnt, bruteforce_per_second, (keycnt - i) / bruteforce_per_second);
     }
 
-out:
     PrintAndLogEx(SUCCESS, "\ntarget block:%3u key type: %c",
-                  package->block,
-                  package->keytype ? 'B' : 'A'
+                  nn.statelists[0].blockNo,
+                  nn.statelists[0].keyType ? 'B' : 'A'
                  );
-
-    free(statelists[0].head.slhead);
-    free(statelists[1].head.slhead);
     return PM3_ESOFT;
 }
 
 
+// the keys of a and b both have, into out. a and b are sorted
+static uint32_t intersect_sorted(const uint64_t *a, uint32_t alen, const uint64_t *b, uint32_t blen, uint64_t *out) {
+    uint32_t i = 0, j = 0, n = 0;
+    while (i < alen && j < blen) {
+        if (a[i] < b[j]) {
+            i++;
+        } else if (a[i] > b[j]) {
+            j++;
+        } else {
+            uint64_t v = a[i];
+            if (n == 0 || out[n - 1] != v)
+                out[n++] = v;
+            i++;
+            j++;
+        }
+    }
+    return n;
+}
+
 int mfStaticNested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *resultKey) {
 
     uint32_t uid;
-    StateList_t statelists[1];
-    struct Crypto1State *p1, *p3;
+    StateList_t statelists[MF_STATIC_NESTED_NONCES];
 
     struct {
         uint8_t block;
@@ -588,151 +1100,105 @@ int mfStaticNested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBl
     if (resp.status != PM3_SUCCESS)
         return resp.status;
 
-    struct p {
-        int16_t isOK;
-        uint8_t block;
-        uint8_t keytype;
-        uint8_t cuid[4];
-        uint8_t nt[4];
-        uint8_t ks[4];
-    } PACKED;
-    struct p *package = (struct p *)resp.data.asBytes;
+    mf_static_nested_resp_t *package = (mf_static_nested_resp_t *)resp.data.asBytes;
 
     // error during collecting static nested information
-    if (package->isOK == 0) return PM3_EUNDEF;
+    if (package->isOK == 0 || package->count == 0) return PM3_EUNDEF;
 
+    uint8_t count = MIN(package->count, MF_STATIC_NESTED_NONCES);
     memcpy(&uid, package->cuid, sizeof(package->cuid));
 
-    statelists[0].blockNo = package->block;
-    statelists[0].keyType = package->keytype;
-    statelists[0].uid = uid;
+    for (uint8_t i = 0; i < count; i++) {
+        statelists[i].blockNo = package->block;
+        statelists[i].keyType = package->keytype;
+        statelists[i].uid = uid;
+        memcpy(&statelists[i].nt_enc, package->nonces[i].nt, sizeof(package->nonces[i].nt));
+        memcpy(&statelists[i].ks1, package->nonces[i].ks, sizeof(package->nonces[i].ks));
+    }
 
-    memcpy(&statelists[0].nt_enc, package->nt, sizeof(package->nt));
-    memcpy(&statelists[0].ks1, package->ks, sizeof(package->ks));
+    // calc keys, a thread per nonce
+    pthread_t thread_id[MF_STATIC_NESTED_NONCES];
 
-    // calc keys
-    pthread_t t;
+    for (uint8_t i = 0; i < count; i++)
+        pthread_create(thread_id + i, NULL, nested_worker_thread, &statelists[i]);
 
-    // create and run worker thread
-    pthread_create(&t, NULL, nested_worker_thread, &statelists[0]);
+    for (uint8_t i = 0; i < count; i++)
+        pthread_join(thread_id[i], (void *)&statelists[i].head.slhead);
 
-    // wait for thread to terminate:
-    pthread_join(t, (void *)&statelists[0].head.slhead);
+    // roll all the states back to the key and sort them, again a thread per list
+    for (uint8_t i = 0; i < count; i++) {
+        statelists[i].head.slhead[statelists[i].len].odd = -1;
+        statelists[i].head.slhead[statelists[i].len].even = -1;
+        pthread_create(thread_id + i, NULL, nested_rollback_thread, &statelists[i]);
+    }
 
-    // the first 16 Bits of the cryptostate already contain part of our key.
-    p1 = p3 = statelists[0].head.slhead;
+    for (uint8_t i = 0; i < count; i++)
+        pthread_join(thread_id[i], (void *)&statelists[i].head.slhead);
+
+    // The key is in all the lists. A nonce whose list has nothing in common with
+    // the others didn't keep to the static prng after all, it is left out
+    uint64_t *keys = statelists[0].head.keyhead;
+    uint32_t keycnt = statelists[0].len;
+    uint64_t *tmp = calloc(keycnt + 1, sizeof(uint64_t));
+    if (tmp == NULL) {
+        for (uint8_t i = 0; i < count; i++)
+            free(statelists[i].head.slhead);
+        return PM3_EMALLOC;
+    }
 
-    // create key candidates.
-    while (p1 <= statelists[0].tail.sltail) {
-        struct Crypto1State savestate;
-        savestate = *p1;
-        while (Compare16Bits(p1, &savestate) == 0 && p1 <= statelists[0].tail.sltail) {
-            *p3 = *p1;
-            lfsr_rollback_word(p3, statelists[0].nt_enc ^ statelists[0].uid, 0);
-            p3++;
-            p1++;
+    for (uint8_t i = 1; i < count; i++) {
+        uint32_t n = intersect_sorted(keys, keycnt, statelists[i].head.keyhead, statelists[i].len, tmp);
+        if (n == 0) {
+            PrintAndLogEx(DEBUG, "nonce %u has no candidate in common, skipped", i + 1);
+            continue;
         }
+        memcpy(keys, tmp, n * sizeof(uint64_t));
+        keycnt = n;
     }
+    free(tmp);
 
-    p3->odd = -1;
-    p3->even = -1;
-    statelists[0].len = p3 - statelists[0].head.slhead;
-    statelists[0].tail.sltail = --p3;
+    for (uint8_t i = 1; i < count; i++)
+        free(statelists[i].head.slhead);
 
-    uint32_t keycnt = statelists[0].len;
     if (keycnt == 0) goto out;
 
-    PrintAndLogEx(SUCCESS, "Found " _YELLOW_("%u") " key candidates", keycnt);
+    PrintAndLogEx(SUCCESS, "Found " _YELLOW_("%u") " key candidates from %u nonces", keycnt, count);
 
     memset(resultKey, 0, 6);
     uint64_t key64 = -1;
 
-    // The list may still contain several key candidates. Test each of them with mfCheckKeys
-    uint32_t maxkeysinblock = IfPm3Flash() ? 1000 : KEYS_IN_BLOCK;
-    uint32_t max_keys_chunk = keycnt > maxkeysinblock ? maxkeysinblock : keycnt;
-
-    uint8_t *mem = calloc((maxkeysinblock * 6) + 5, sizeof(uint8_t));
-    if (mem == NULL) {
+    // The list may still contain several key candidates. Test all of them on the device in one go
+    uint8_t *keyBlock = calloc(keycnt, 6);
+    if (keyBlock == NULL) {
         free(statelists[0].head.slhead);
         return PM3_EMALLOC;
     }
 
-    uint8_t *p_keyblock = mem + 5;
-    mem[0] = statelists[0].keyType;
-    mem[1] = statelists[0].blockNo;
-    mem[2] = 1;
-    mem[3] = ((max_keys_chunk >> 8) & 0xFF);
-    mem[4] = (max_keys_chunk & 0xFF);
-
-    uint8_t destfn[32];
-    strncpy((char *)destfn, "static_nested_000.bin", sizeof(destfn) - 1);
-
-    uint64_t start_time = msclock();
-    for (uint32_t i = 0; i < keycnt; i += max_keys_chunk) {
-
-        //flush queue
-        while (kbd_enter_pressed()) {
-            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
-            PrintAndLogEx(NORMAL, "");
-            free(mem);
-            return PM3_EOPABORTED;
-        }
-
-        int res = 0;
-        key64 = 0;
-        uint32_t chunk = keycnt - i > max_keys_chunk ? max_keys_chunk : keycnt - i;
-
-        // copy x keys to device.
-        for (uint32_t j = 0; j < chunk; j++) {
-            crypto1_get_lfsr(statelists[0].head.slhead + i + j, &key64);
-            num_to_bytes(key64, 6, p_keyblock + j * 6);
-        }
-
-        // check a block of generated key candidates.
-        if (IfPm3Flash()) {
-
-            mem[3] = ((chunk >> 8) & 0xFF);
-            mem[4] = (chunk & 0xFF);
-
-            // upload to flash.
-            res = flashmem_spiffs_load(destfn, mem, 5 + (chunk * 6));
-            if (res != PM3_SUCCESS) {
-                PrintAndLogEx(WARNING, "\nSPIFFS upload failed");
-                free(mem);
-                return res;
-            }
-            res = mfCheckKeys_file(destfn, &key64);
-        } else {
-            res = mfCheckKeys(statelists[0].blockNo, statelists[0].keyType, false, chunk, mem, &key64);
-        }
-
-        if (res == PM3_SUCCESS) {
-            p_keyblock = NULL;
-            free(statelists[0].head.slhead);
-            free(mem);
-
-            num_to_bytes(key64, 6, resultKey);
+    for (uint32_t i = 0; i < keycnt; i++) {
+        crypto1_get_lfsr(statelists[0].head.slhead + i, &key64);
+        num_to_bytes(key64, 6, keyBlock + i * 6);
+    }
 
-            PrintAndLogEx(NORMAL, "");
-            PrintAndLogEx(SUCCESS, "target block:%3u key type: %c  -- found valid key [ " _GREEN_("%s") "]",
-                          package->block,
-                          package->keytype ? 'B' : 'A',
-                          sprint_hex(resultKey, 6)
-                         );
-            return PM3_SUCCESS;
-        } else if (res == PM3_ETIMEOUT || res == PM3_EOPABORTED) {
-            PrintAndLogEx(NORMAL, "");
-            free(mem);
-            return res;
-        }
+    int res = mfCheckKeys_batch(statelists[0].blockNo, statelists[0].keyType, keycnt, keyBlock, &key64);
+    free(keyBlock);
 
-        float bruteforce_per_second = (float)(i + max_keys_chunk) / ((msclock() - start_time) / 1000.0);
-        PrintAndLogEx(INPLACE, "%6u/%u keys | %5.1f keys/sec | worst case %6.1f seconds", i, keycnt, bruteforce_per_second, (keycnt - i) / bruteforce_per_second);
+    if (res == PM3_SUCCESS) {
+        free(statelists[0].head.slhead);
+        num_to_bytes(key64, 6, resultKey);
+
+        PrintAndLogEx(NORMAL, "");
+        PrintAndLogEx(SUCCESS, "target block:%3u key type: %c  -- found valid key [ " _GREEN_("%s") "]",
+                      package->block,
+                      package->keytype ? 'B' : 'A',
+                      sprint_hex(resultKey, 6)
+                     );
+        return PM3_SUCCESS;
+    } else if (res == PM3_ETIMEOUT || res == PM3_EOPABORTED) {
+        PrintAndLogEx(NORMAL, "");
+        free(statelists[0].head.slhead);
+        return res;
     }
 
-    p_keyblock = NULL;
-    free(mem);
-
 out:
     PrintAndLogEx(SUCCESS, "\ntarget block:%3u key type: %c",
                   package->block,
@@ -767,12 +1233,105 @@ int mfReadSector(uint8_t sectorNo, uint8_t keyType, uint8_t *key, uint8_t *data)
     return PM3_SUCCESS;
 }
 
+// Reads sectors 0..sectorcnt-1 in one exchange. data is the card image, 16 bytes per block,
+// bit n of readmask[sector] is set when block n of the sector was read. Trailers come as
+// the card sends them, without keys.
+int mfReadSectorsBulk(uint8_t sectorcnt, uint8_t keyA[][6], uint8_t keyB[][6], uint8_t *data, uint16_t *readmask) {
+
+    mf_readsc_bulk_req_t req = {0};
+    req.sectorcnt = MIN(sectorcnt, ARRAYLEN(req.keyA));
+    memset(readmask, 0, req.sectorcnt * sizeof(uint16_t));
+
+    for (uint8_t i = 0; i < req.sectorcnt; i++) {
+        memcpy(req.keyA[i], keyA[i], 6);
+        memcpy(req.keyB[i], keyB[i], 6);
+    }
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_MIFARE_READSC_BULK, (uint8_t *)&req, sizeof(req));
+
+    PacketResponseNG resp;
+    mf_readsc_bulk_frame_t *frame = (mf_readsc_bulk_frame_t *)resp.data.asBytes;
+    while (true) {
+        if (!WaitForResponseTimeout(CMD_HF_MIFARE_READSC_BULK, &resp, 1500)) {
+            return PM3_ETIMEOUT;
+        }
+
+        if (frame->final) {
+            return resp.status;
+        }
+
+        if (frame->sector >= req.sectorcnt)
+            continue;
+
+        uint8_t blocks = mfNumBlocksPerSector(frame->sector);
+        memcpy(data + 16 * mfFirstBlockOfSector(frame->sector), frame->data, 16 * blocks);
+        readmask[frame->sector] = frame->readmask;
+    }
+}
+
+// Writes sectors 0..sectorcnt-1 from the card image in data, as many sectors per exchange
+// as fit. bit n of writemask[sector] is set when block n of the sector was written
+int mfWriteSectorsBulk(uint8_t sectorcnt, uint8_t keyType, uint8_t *key, uint8_t *data, uint16_t *writemask) {
+
+    memset(writemask, 0, sectorcnt * sizeof(uint16_t));
+
+    uint8_t sectorNo = 0;
+    while (sectorNo < sectorcnt) {
+
+        uint8_t buf[PM3_CMD_DATA_SIZE] = {0};
+        mf_writesc_bulk_req_t *req = (mf_writesc_bulk_req_t *)buf;
+        uint16_t pos = 0;
+        uint8_t first = sectorNo;
+
+        while (sectorNo < sectorcnt && req->count < MF_WRITESC_BULK_MAX) {
+            uint8_t blocks = mfNumBlocksPerSector(sectorNo);
+            uint16_t len = sizeof(mf_writesc_bulk_entry_t) + 16 * blocks;
+            if (sizeof(mf_writesc_bulk_req_t) + pos + len > sizeof(buf))
+                break;
+
+            mf_writesc_bulk_entry_t *e = (mf_writesc_bulk_entry_t *)(req->data + pos);
+            e->sector = sectorNo;
+            e->keytype = keyType;
+            memcpy(e->key, key, sizeof(e->key));
+            memcpy(e->data, data + 16 * mfFirstBlockOfSector(sectorNo), 16 * blocks);
+
+            pos += len;
+            req->count++;
+            sectorNo++;
+        }
+
+        clearCommandBuffer();
+        SendCommandNG(CMD_HF_MIFARE_WRITESC_BULK, buf, sizeof(mf_writesc_bulk_req_t) + pos);
+
+        PacketResponseNG resp;
+        if (!WaitForResponseTimeout(CMD_HF_MIFARE_WRITESC_BULK, &resp, 2500)) {
+            return PM3_ETIMEOUT;
+        }
+        if (resp.status != PM3_SUCCESS) {
+            return resp.status;
+        }
+
+        mf_writesc_bulk_resp_t *r = (mf_writesc_bulk_resp_t *)resp.data.asBytes;
+        for (uint8_t i = 0; i < r->count && i < req->count; i++) {
+            writemask[first + i] = r->writemask[i];
+        }
+    }
+    return PM3_SUCCESS;
+}
+
 // EMULATOR
 int mfEmlGetMem(uint8_t *data, int blockNum, int blocksCount) {
 
     size_t size = blocksCount * 16;
+
+    // more than one reply, streamed
     if (size > PM3_CMD_DATA_SIZE) {
-        return PM3_ESOFT;
+        if (!GetFromDevice(BIG_BUF_EML, data, size, blockNum * 16, NULL, 0, NULL, 2500, false)) {
+            PrintAndLogEx(WARNING, "Fail, transfer from device time-out");
+            return PM3_ETIMEOUT;
+        }
+        return PM3_SUCCESS;
     }
 
     struct {
@@ -944,6 +1503,21 @@ int mfCGetBlock(uint8_t blockNo, uint8_t *data, uint8_t params) {
     return PM3_SUCCESS;
 }
 
+// writes blocks of the emulator memory to a magic gen1 card in one go
+int mfCLoad(uint16_t blocks, bool verify, uint16_t *written) {
+    mifare_cload_req_t req = { .blocks = blocks, .verify = verify };
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_MIFARE_CLOAD, (uint8_t *)&req, sizeof(req));
+    PacketResponseNG resp;
+    if (WaitForResponseTimeout(CMD_HF_MIFARE_CLOAD, &resp, 10000) == false) {
+        PrintAndLogEx(WARNING, "command execute timeout");
+        return PM3_ETIMEOUT;
+    }
+    if (written != NULL && resp.length >= sizeof(uint16_t))
+        memcpy(written, resp.data.asBytes, sizeof(uint16_t));
+    return resp.status;
+}
+
 int mfGen3UID(uint8_t *uid, uint8_t uidlen, uint8_t *oldUid) {
     clearCommandBuffer();
     SendCommandMIX(CMD_HF_MIFARE_GEN3UID, uidlen, 0, 0, uid, uidlen);
@@ -1055,6 +1629,43 @@ int detect_classic_prng(void) {
     uint32_t nonce = bytes_to_num(respA.data.asBytes, respA.oldarg[0]);
     return validate_prng_nonce(nonce);
 }
+
+// the result of CMD_HF_MIFARE_NACK_DETECT
+int print_classic_nackbug(uint8_t ok, uint8_t nacks, uint16_t auths, bool verbose) {
+    if (verbose) {
+        PrintAndLogEx(SUCCESS, "num of auth requests  : %u", auths);
+        PrintAndLogEx(SUCCESS, "num of received NACK  : %u", nacks);
+    }
+    switch (ok) {
+        case 96 :
+        case 98 : {
+            if (verbose)
+                PrintAndLogEx(FAILED, "card random number generator is not predictable.");
+            PrintAndLogEx(WARNING, "detection failed");
+            return PM3_SUCCESS;
+        }
+        case 97 : {
+            if (verbose) {
+                PrintAndLogEx(FAILED, "card random number generator seems to be based on the well-known generating polynomial");
+                PrintAndLogEx(FAILED, "with 16 effective bits only, but shows unexpected behavior, try again.");
+            }
+            return PM3_SUCCESS;
+        }
+        case  2 :
+            PrintAndLogEx(SUCCESS, "NACK test: " _GREEN_("always leak NACK"));
+            return PM3_SUCCESS;
+        case  1 :
+            PrintAndLogEx(SUCCESS, "NACK test: " _GREEN_("detected"));
+            return PM3_SUCCESS;
+        case  0 :
+            PrintAndLogEx(SUCCESS, "NACK test: " _GREEN_("no bug"));
+            return PM3_SUCCESS;
+        default :
+            PrintAndLogEx(ERR, "errorcode from device " _RED_("[%i]"), ok);
+            return PM3_EUNDEF;
+    }
+}
+
 /* Detect Mifare Classic NACK bug
 
 returns:
@@ -1093,40 +1704,7 @@ int detect_classic_nackbug(bool verbose) {
             uint8_t ok = resp.data.asBytes[0];
             uint8_t nacks = resp.data.asBytes[1];
             uint16_t auths = bytes_to_num(resp.data.asBytes + 2, 2);
-
-            if (verbose) {
-                PrintAndLogEx(SUCCESS, "num of auth requests  : %u", auths);
-                PrintAndLogEx(SUCCESS, "num of received NACK  : %u", nacks);
-            }
-            switch (ok) {
-                case 96 :
-                case 98 : {
-                    if (verbose)
-                        PrintAndLogEx(FAILED, "card random number generator is not predictable.");
-                    PrintAndLogEx(WARNING, "detection failed");
-                    return PM3_SUCCESS;
-                }
-                case 97 : {
-                    if (verbose) {
-                        PrintAndLogEx(FAILED, "card random number generator seems to be based on the well-known generating polynomial");
-                        PrintAndLogEx(FAILED, "with 16 effective bits only, but shows unexpected behavior, try again.");
-                    }
-                    return PM3_SUCCESS;
-                }
-                case  2 :
-                    PrintAndLogEx(SUCCESS, "NACK test: " _GREEN_("always leak NACK"));
-                    return PM3_SUCCESS;
-                case  1 :
-                    PrintAndLogEx(SUCCESS, "NACK test: " _GREEN_("detected"));
-                    return PM3_SUCCESS;
-                case  0 :
-                    PrintAndLogEx(SUCCESS, "NACK test: " _GREEN_("no bug"));
-                    return PM3_SUCCESS;
-                default :
-                    PrintAndLogEx(ERR, "errorcode from device " _RED_("[%i]"), ok);
-                    return PM3_EUNDEF;
-            }
-            break;
+            return print_classic_nackbug(ok, nacks, auths, verbose);
         }
     }
     return PM3_SUCCESS;
@@ -1166,6 +1744,11 @@ int detect_classic_magic(void) {
             isGeneration = resp.data.asBytes[0];
     }
 
+    print_classic_magic(isGeneration);
+    return isGeneration;
+}
+
+void print_classic_magic(int isGeneration) {
     switch (isGeneration) {
         case MAGIC_GEN_1A:
             PrintAndLogEx(SUCCESS, "Magic capabilities : " _GREEN_("Gen 1a"));
@@ -1191,5 +1774,43 @@ int detect_classic_magic(void) {
         default:
             break;
     }
-    return isGeneration;
+}
+
+/* All of the detections above in one call to the device, flags MF_FINGERPRINT_*.
+the static nonce and prng tests always run, then fp holds what the functions above get,
+print_classic_nackbug() prints the nack bug result like detect_classic_nackbug() does
+returns PM3_SUCCESS, PM3_ETIMEOUT or PM3_EOPABORTED
+*/
+int detect_classic_fingerprint(uint8_t flags, mf_fingerprint_resp_t *fp) {
+
+    mf_fingerprint_req_t req = { flags };
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_MIFARE_FINGERPRINT, (uint8_t *)&req, sizeof(req));
+
+    if (flags & MF_FINGERPRINT_NACK)
+        PrintAndLogEx(INFO, "Checking for NACK bug");
+
+    // a card without the nack test is done in well under this, the test waits for the key
+    uint64_t t1 = msclock();
+    PacketResponseNG resp;
+    while (WaitForResponseTimeout(CMD_HF_MIFARE_FINGERPRINT, &resp, 500) == false) {
+        if (flags & MF_FINGERPRINT_NACK) {
+            PrintAndLogEx(NORMAL, "." NOLF);
+            if (kbd_enter_pressed())
+                return PM3_EOPABORTED;
+        } else if (msclock() - t1 > 4000) {
+            PrintAndLogEx(WARNING, "Fingerprint: Reply timeout.");
+            return PM3_ETIMEOUT;
+        }
+    }
+    if (flags & MF_FINGERPRINT_NACK)
+        PrintAndLogEx(NORMAL, "");
+
+    if (resp.status == PM3_EOPABORTED) {
+        PrintAndLogEx(WARNING, "button pressed. Aborted.");
+        return PM3_EOPABORTED;
+    }
+
+    memcpy(fp, resp.data.asBytes, sizeof(mf_fingerprint_resp_t));
+    return PM3_SUCCESS;
 }
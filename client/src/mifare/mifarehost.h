@@ -13,6 +13,7 @@
 #include "common.h"
 
 #include "util.h"       // FILE_PATH_SIZE
+#include "pm3_cmd.h"    // mf_fingerprint_resp_t
 
 #define MIFARE_SECTOR_RETRY     10
 
@@ -43,6 +44,13 @@ typedef struct {
     uint32_t ks1;
 } StateList_t;
 
+// the nonces of one nested run on the device, and the key candidates the host recovers from them
+typedef struct {
+    StateList_t statelists[2];
+    uint64_t *keys;
+    uint32_t keycnt;
+} nested_nonces_t;
+
 typedef struct {
     uint64_t Key[2];
     uint8_t foundKey[2];
@@ -60,16 +68,24 @@ typedef struct {
 
 int mfDarkside(uint8_t blockno, uint8_t key_type, uint64_t *key);
 int mfnested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *resultKey, bool calibrate);
+// mfnested in its three steps, on the device, on the host only (thread safe) and on the device again
+int mfnested_collect(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, bool calibrate, nested_nonces_t *nn);
+int mfnested_recover(nested_nonces_t *nn);
+int mfnested_check(nested_nonces_t *nn, uint8_t *resultKey);
 int mfStaticNested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *resultKey);
 int mfCheckKeys(uint8_t blockNo, uint8_t keyType, bool clear_trace, uint8_t keycnt, uint8_t *keyBlock, uint64_t *key);
 int mfCheckKeys_fast(uint8_t sectorsCnt, uint8_t firstChunk, uint8_t lastChunk,
                      uint8_t strategy, uint32_t size, uint8_t *keyBlock, sector_t *e_sector, bool use_flashmemory);
 
 int mfCheckKeys_file(uint8_t *destfn, uint64_t *key);
+int mfCheckKeys_batch(uint8_t blockNo, uint8_t keyType, uint32_t keycnt, uint8_t *keyBlock, uint64_t *key);
+int mfCheckKeys_spiffs(uint8_t sectorsCnt, const char *filename, sector_t *e_sector);
 
 int mfKeyBrute(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint64_t *resultkey);
 
 int mfReadSector(uint8_t sectorNo, uint8_t keyType, uint8_t *key, uint8_t *data);
+int mfReadSectorsBulk(uint8_t sectorcnt, uint8_t keyA[][6], uint8_t keyB[][6], uint8_t *data, uint16_t *readmask);
+int mfWriteSectorsBulk(uint8_t sectorcnt, uint8_t keyType, uint8_t *key, uint8_t *data, uint16_t *writemask);
 
 int mfEmlGetMem(uint8_t *data, int blockNum, int blocksCount);
 int mfEmlSetMem(uint8_t *data, int blockNum, int blocksCount);
@@ -79,6 +95,7 @@ int mfCSetUID(uint8_t *uid, uint8_t *atqa, uint8_t *sak, uint8_t *oldUID, uint8_
 int mfCWipe(uint8_t *uid, uint8_t *atqa, uint8_t *sak);
 int mfCSetBlock(uint8_t blockNo, uint8_t *data, uint8_t *uid, uint8_t params);
 int mfCGetBlock(uint8_t blockNo, uint8_t *data, uint8_t params);
+int mfCLoad(uint16_t blocks, bool verify, uint16_t *written);
 
 int mfGen3UID(uint8_t *uid, uint8_t uidlen, uint8_t *oldUid);
 int mfGen3Block(uint8_t *block, int blockLen, uint8_t *newBlock);
@@ -90,5 +107,8 @@ int detect_classic_prng(void);
 int detect_classic_nackbug(bool verbose);
 int detect_classic_magic(void);
 int detect_classic_static_nonce(void);
+void print_classic_magic(int isGeneration);
+int print_classic_nackbug(uint8_t ok, uint8_t nacks, uint16_t auths, bool verbose);
+int detect_classic_fingerprint(uint8_t flags, mf_fingerprint_resp_t *fp);
 void mf_crypto1_decrypt(struct Crypto1State *pcs, uint8_t *data, int len, bool isEncrypted);
 #endif
@@ -92,20 +92,7 @@ static const char *URI_s[] = {
     "urn:nfc:"                    // 0x23
 };
 
-static uint16_t ndefTLVGetLength(uint8_t *data, size_t *indx) {
-    uint16_t len = 0;
-    if (data[0] == 0xff) {
-        len = (data[1] << 8) + data[2];
-        *indx += 3;
-    } else {
-        len = data[0];
-        *indx += 1;
-    }
-
-    return len;
-}
-
-static int ndefDecodeHeader(uint8_t *data, size_t datalen, NDEFHeader_t *header) {
+static int ndefParseHeader(uint8_t *data, size_t datalen, NDEFHeader_t *header) {
     header->Type = NULL;
     header->Payload = NULL;
     header->ID = NULL;
@@ -135,6 +122,13 @@ static int ndefDecodeHeader(uint8_t *data, size_t datalen, NDEFHeader_t *header)
     header->Payload = header->Type + header->TypeLen + header->IDLen;
 
     header->RecLen = header->len + header->TypeLen + header->PayloadLen + header->IDLen;
+    return PM3_SUCCESS;
+}
+
+static int ndefDecodeHeader(uint8_t *data, size_t datalen, NDEFHeader_t *header) {
+    int res = ndefParseHeader(data, datalen, header);
+    if (res != PM3_SUCCESS)
+        return res;
 
     if (header->RecLen > datalen)
         return PM3_ESOFT;
@@ -391,143 +385,300 @@ static int ndefRecordDecodeAndPrint(uint8_t *ndefRecord, size_t ndefRecordLen) {
     return PM3_SUCCESS;
 }
 
-int NDEFRecordsDecodeAndPrint(uint8_t *ndefRecord, size_t ndefRecordLen) {
-    bool firstRec = true;
-    size_t len = 0;
-    size_t counter = 0;
+enum {
+    ndefsTLVType = 0,
+    ndefsTLVLength,
+    ndefsTLVValue,
+    ndefsMessage,
+    ndefsError,
+};
 
-    while (len < ndefRecordLen) {
-        counter++;
+// bytes of the record at buf needed before it can go on: its header, then the whole record,
+// or for a record too big to keep, up to its payload
+static size_t ndefStreamNeed(uint8_t *buf, size_t buflen) {
+    if (buflen == 0)
+        return 1;
 
-        NDEFHeader_t NDEFHeader = {0};
-        int res = ndefDecodeHeader(&ndefRecord[len], ndefRecordLen - len, &NDEFHeader);
-        if (res != PM3_SUCCESS)
-            return res;
+    NDEFHeader_t header = {0};
+    if (ndefParseHeader(buf, buflen, &header) != PM3_SUCCESS)
+        return header.len;
 
-        if (firstRec) {
-            if (!NDEFHeader.MessageBegin) {
-                PrintAndLogEx(ERR, "NDEF first record have MessageBegin = false!");
-                return PM3_ESOFT;
+    if (header.RecLen <= NDEF_STREAM_RECORD_MAX)
+        return header.RecLen;
+
+    return header.len + header.TypeLen + header.IDLen;
+}
+
+// left: bytes of the message from the start of the record on
+static int ndefStreamRecordStart(ndef_stream_t *s, NDEFHeader_t *header, size_t left) {
+    if (s->records == 0 && header->MessageBegin == false) {
+        PrintAndLogEx(ERR, "NDEF first record have MessageBegin = false!");
+        return PM3_ESOFT;
+    }
+
+    if (header->RecLen > left || (header->MessageEnd && header->RecLen != left)) {
+        PrintAndLogEx(ERR, "NDEF records have wrong length. Must be %zu, calculated %zu", s->msglen, s->msglen - left + header->RecLen);
+        return PM3_ESOFT;
+    }
+
+    s->records++;
+    s->last = header->MessageEnd;
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(SUCCESS, _CYAN_("Record") " " _YELLOW_("%zu"), s->records);
+    PrintAndLogEx(INFO, "-----------------------------------------------------");
+    return PM3_SUCCESS;
+}
+
+// Takes len bytes of the message. A record found whole in data is decoded where it is, one split over
+// several calls is gathered in s->buf first. Of a record bigger than that only the payload length is checked
+static int ndefStreamRecords(ndef_stream_t *s, uint8_t *data, size_t len) {
+    len = MIN(len, s->msgleft);
+
+    while (len) {
+        size_t n = len;
+
+        if (s->last) {
+            // after the last record, like NDEFRecordsDecodeAndPrint
+        } else if (s->payloadleft) {
+            n = MIN(n, s->payloadleft);
+            s->payloadleft -= n;
+        } else {
+            NDEFHeader_t header = {0};
+            if (s->buflen == 0 && ndefDecodeHeader(data, len, &header) == PM3_SUCCESS) {
+                int res = ndefStreamRecordStart(s, &header, s->msgleft);
+                if (res != PM3_SUCCESS)
+                    return res;
+
+                ndefRecordDecodeAndPrint(data, header.RecLen);
+                n = header.RecLen;
+            } else {
+                size_t need = ndefStreamNeed(s->buf, s->buflen);
+                if (need > s->buflen + s->msgleft) {
+                    PrintAndLogEx(ERR, "NDEF records have wrong length. Must be %zu, calculated %zu", s->msglen, s->msglen - s->msgleft - s->buflen + need);
+                    return PM3_ESOFT;
+                }
+
+                n = MIN(n, need - s->buflen);
+                memcpy(s->buf + s->buflen, data, n);
+                s->buflen += n;
+
+                if (s->buflen == need && need == ndefStreamNeed(s->buf, s->buflen)) {
+                    ndefParseHeader(s->buf, s->buflen, &header);
+                    int res = ndefStreamRecordStart(s, &header, s->msgleft + s->buflen - n);
+                    if (res != PM3_SUCCESS)
+                        return res;
+
+                    if (header.RecLen == s->buflen) {
+                        ndefRecordDecodeAndPrint(s->buf, s->buflen);
+                    } else {
+                        ndefPrintHeader(&header);
+                        if (header.TypeLen) {
+                            PrintAndLogEx(INFO, "Type data:");
+                            dump_buffer(header.Type, header.TypeLen, stdout, 1);
+                        }
+                        if (header.IDLen) {
+                            PrintAndLogEx(INFO, "ID data:");
+                            dump_buffer(header.ID, header.IDLen, stdout, 1);
+                        }
+                        PrintAndLogEx(INFO, "Payload data: %zu bytes, not kept", header.PayloadLen);
+                        s->payloadleft = header.PayloadLen;
+                    }
+                    s->buflen = 0;
+                }
             }
-            firstRec = false;
         }
 
-        if (NDEFHeader.MessageEnd && len + NDEFHeader.RecLen != ndefRecordLen) {
-            PrintAndLogEx(ERR, "NDEF records have wrong length. Must be %zu, calculated %zu", ndefRecordLen, len + NDEFHeader.RecLen);
-            return PM3_ESOFT;
-        }
+        data += n;
+        len -= n;
+        s->msgleft -= n;
+    }
+    return PM3_SUCCESS;
+}
+
+int NDEFRecordsDecodeAndPrint(uint8_t *ndefRecord, size_t ndefRecordLen) {
+    ndef_stream_t s = {0};
+    s.msglen = ndefRecordLen;
+    s.msgleft = ndefRecordLen;
 
-        PrintAndLogEx(NORMAL, "");
-        PrintAndLogEx(SUCCESS, _CYAN_("Record") " " _YELLOW_("%zu"), counter);
-        PrintAndLogEx(INFO, "-----------------------------------------------------");
-        ndefRecordDecodeAndPrint(&ndefRecord[len], NDEFHeader.RecLen);
+    int res = ndefStreamRecords(&s, ndefRecord, ndefRecordLen);
+    if (res != PM3_SUCCESS)
+        return res;
 
-        len += NDEFHeader.RecLen;
+    return (s.buflen || s.payloadleft) ? PM3_ESOFT : PM3_SUCCESS;
+}
 
-        if (NDEFHeader.MessageEnd)
+static void ndefStreamTLVStart(ndef_stream_t *s) {
+    switch (s->tlv) {
+        case 0x00:
+            PrintAndLogEx(SUCCESS, "--- " _CYAN_("NDEF NULL block") " ---");
+            if (s->left)
+                PrintAndLogEx(WARNING, "NDEF NULL block size must be 0, got %zu bytes", s->left);
+            break;
+        case 0x01:
+            PrintAndLogEx(SUCCESS, "--- " _CYAN_("NDEF Lock Control") " ---");
+            if (s->left != 3)
+                PrintAndLogEx(WARNING, "NDEF Lock Control block size must be 3 instead of %zu.", s->left);
+            break;
+        case 0x02:
+            PrintAndLogEx(SUCCESS, "--- " _CYAN_("NDEF Memory Control") " ---");
+            if (s->left != 3)
+                PrintAndLogEx(WARNING, "NDEF Memory Control block size must be 3 instead of %zu.", s->left);
+            break;
+        case 0x03:
+            PrintAndLogEx(SUCCESS, "--- " _CYAN_("NDEF Message") " ---");
+            if (s->left == 0) {
+                PrintAndLogEx(SUCCESS, "Found NDEF message w zero length");
+            } else {
+                PrintAndLogEx(SUCCESS, "Found NDEF message (%zu bytes)", s->left);
+                s->msglen = s->left;
+                s->msgleft = s->left;
+                s->records = 0;
+                s->last = false;
+                s->state = ndefsMessage;
+                return;
+            }
+            break;
+        case 0xfd:
+            PrintAndLogEx(SUCCESS, "--- " _CYAN_("Proprietary info") " ---");
+            PrintAndLogEx(SUCCESS, "  Can't decode, skipping %zu bytes", s->left);
             break;
     }
 
-    return PM3_SUCCESS;
+    s->valuelen = 0;
+    s->state = (s->left) ? ndefsTLVValue : ndefsTLVType;
 }
 
-// http://apps4android.org/nfc-specifications/NFCForum-TS-Type-2-Tag_1.1.pdf
-int NDEFDecodeAndPrint(uint8_t *ndef, size_t ndefLen, bool verbose) {
+static void ndefStreamTLVEnd(ndef_stream_t *s) {
+    if (s->valuelen != 3)
+        return;
+
+    uint8_t *value = s->value;
+    if (s->tlv == 0x01) {
+        uint8_t pages_addr = (value[0] >> 4) & 0x0f;
+        uint8_t byte_offset = value[0] & 0x0f;
+        uint8_t Size = value[1];
+        uint8_t BytesLockedPerLockBit = (value[2] >> 4) & 0x0f;
+        uint8_t bytes_per_page = value[2] & 0x0f;
+        PrintAndLogEx(SUCCESS, " Pages addr (number of pages) : %d", pages_addr);
+        PrintAndLogEx(SUCCESS, "Byte offset (number of bytes) : %d", byte_offset);
+        PrintAndLogEx(SUCCESS, "Size in bits of the lock area : %d. bytes approx: %d", Size, Size / 8);
+        PrintAndLogEx(SUCCESS, "       Number of bytes / page : %d", bytes_per_page);
+        PrintAndLogEx(SUCCESS, "Bytes Locked Per LockBit.");
+        PrintAndLogEx(SUCCESS, "   number of bytes that each dynamic lock bit is able to lock: %d", BytesLockedPerLockBit);
+    } else if (s->tlv == 0x02) {
+        uint8_t pages_addr = (value[0] >> 4) & 0x0f;
+        uint8_t byte_offset = value[0] & 0x0f;
+        uint8_t Size = value[1];
+        uint8_t bytes_per_page = value[2] & 0x0f;
+        PrintAndLogEx(SUCCESS, " Pages addr (number of pages) : %d", pages_addr);
+        PrintAndLogEx(SUCCESS, "Byte offset (number of bytes) : %d", byte_offset);
+        PrintAndLogEx(SUCCESS, "Size in bits of the reserved area : %d. bytes approx: %d", Size, Size / 8);
+        PrintAndLogEx(SUCCESS, "       Number of bytes / page : %d", bytes_per_page);
+    }
+}
 
-    size_t indx = 0;
+void NDEFStreamInit(ndef_stream_t *s, bool verbose) {
+    memset(s, 0, sizeof(*s));
+    s->verbose = verbose;
 
     PrintAndLogEx(NORMAL, "");
     PrintAndLogEx(INFO, "--- " _CYAN_("NDEF parsing") " ----------------");
-    while (indx < ndefLen) {
-
-        PrintAndLogEx(INFO, "-----------------------------------------------------");
-        switch (ndef[indx]) {
-            case 0x00: {
-                indx++;
-                uint16_t len = ndefTLVGetLength(&ndef[indx], &indx);
-                PrintAndLogEx(SUCCESS, "--- " _CYAN_("NDEF NULL block") " ---");
-                if (len)
-                    PrintAndLogEx(WARNING, "NDEF NULL block size must be 0, got %d bytes", len);
-                indx += len;
-                break;
-            }
-            case 0x01: {
-                indx++;
-                uint16_t len = ndefTLVGetLength(&ndef[indx], &indx);
-                PrintAndLogEx(SUCCESS, "--- " _CYAN_("NDEF Lock Control") " ---");
-                if (len != 3) {
-                    PrintAndLogEx(WARNING, "NDEF Lock Control block size must be 3 instead of %d.", len);
-                } else {
-                    uint8_t pages_addr = (ndef[indx] >> 4) & 0x0f;
-                    uint8_t byte_offset = ndef[indx] & 0x0f;
-                    uint8_t Size = ndef[indx + 1];
-                    uint8_t BytesLockedPerLockBit = (ndef[indx + 2] >> 4) & 0x0f;
-                    uint8_t bytes_per_page = ndef[indx + 2] & 0x0f;
-                    PrintAndLogEx(SUCCESS, " Pages addr (number of pages) : %d", pages_addr);
-                    PrintAndLogEx(SUCCESS, "Byte offset (number of bytes) : %d", byte_offset);
-                    PrintAndLogEx(SUCCESS, "Size in bits of the lock area : %d. bytes approx: %d", Size, Size / 8);
-                    PrintAndLogEx(SUCCESS, "       Number of bytes / page : %d", bytes_per_page);
-                    PrintAndLogEx(SUCCESS, "Bytes Locked Per LockBit.");
-                    PrintAndLogEx(SUCCESS, "   number of bytes that each dynamic lock bit is able to lock: %d", BytesLockedPerLockBit);
+}
+
+// http://apps4android.org/nfc-specifications/NFCForum-TS-Type-2-Tag_1.1.pdf
+int NDEFStreamFeed(ndef_stream_t *s, uint8_t *data, size_t len) {
+    size_t indx = 0;
+
+    while (indx < len && s->done == false) {
+        switch (s->state) {
+            case ndefsTLVType: {
+                s->tlv = data[indx++];
+                PrintAndLogEx(INFO, "-----------------------------------------------------");
+                switch (s->tlv) {
+                    case 0x00:
+                    case 0x01:
+                    case 0x02:
+                    case 0x03:
+                    case 0xfd:
+                        s->lenlen = 0;
+                        s->state = ndefsTLVLength;
+                        break;
+                    case 0xfe:
+                        PrintAndLogEx(SUCCESS, "NDEF Terminator detected");
+                        s->done = true;
+                        break;
+                    default:
+                        if (s->verbose)
+                            PrintAndLogEx(ERR, "unknown tag 0x%02x", s->tlv);
+
+                        s->state = ndefsError;
+                        return PM3_ESOFT;
                 }
-                indx += len;
                 break;
             }
-            case 0x02: {
-                indx++;
-                uint16_t len = ndefTLVGetLength(&ndef[indx], &indx);
-                PrintAndLogEx(SUCCESS, "--- " _CYAN_("NDEF Memory Control") " ---");
-                if (len != 3) {
-                    PrintAndLogEx(WARNING, "NDEF Memory Control block size must be 3 instead of %d.", len);
-                } else {
-                    uint8_t pages_addr = (ndef[indx] >> 4) & 0x0f;
-                    uint8_t byte_offset = ndef[indx] & 0x0f;
-                    uint8_t Size = ndef[indx + 1];
-                    uint8_t bytes_per_page = ndef[indx + 2] & 0x0f;
-                    PrintAndLogEx(SUCCESS, " Pages addr (number of pages) : %d", pages_addr);
-                    PrintAndLogEx(SUCCESS, "Byte offset (number of bytes) : %d", byte_offset);
-                    PrintAndLogEx(SUCCESS, "Size in bits of the reserved area : %d. bytes approx: %d", Size, Size / 8);
-                    PrintAndLogEx(SUCCESS, "       Number of bytes / page : %d", bytes_per_page);
-                }
-                indx += len;
+            case ndefsTLVLength: {
+                s->lenbuf[s->lenlen++] = data[indx++];
+                if (s->lenbuf[0] == 0xff && s->lenlen < 3)
+                    break;
+
+                s->left = (s->lenbuf[0] == 0xff) ? (s->lenbuf[1] << 8) + s->lenbuf[2] : s->lenbuf[0];
+                ndefStreamTLVStart(s);
                 break;
             }
-            case 0x03: {
-                indx++;
-                uint16_t len = ndefTLVGetLength(&ndef[indx], &indx);
-                PrintAndLogEx(SUCCESS, "--- " _CYAN_("NDEF Message") " ---");
-                if (len == 0) {
-                    PrintAndLogEx(SUCCESS, "Found NDEF message w zero length");
-                } else {
-                    PrintAndLogEx(SUCCESS, "Found NDEF message (%d bytes)", len);
-
-                    int res = NDEFRecordsDecodeAndPrint(&ndef[indx], len);
-                    if (res != PM3_SUCCESS)
-                        return res;
+            case ndefsTLVValue: {
+                size_t n = MIN(len - indx, s->left);
+                if (s->valuelen < sizeof(s->value)) {
+                    size_t m = MIN(n, sizeof(s->value) - s->valuelen);
+                    memcpy(s->value + s->valuelen, data + indx, m);
+                    s->valuelen += m;
+                }
+                indx += n;
+                s->left -= n;
+                if (s->left == 0) {
+                    ndefStreamTLVEnd(s);
+                    s->state = ndefsTLVType;
                 }
-
-                indx += len;
                 break;
             }
-            case 0xfd: {
-                indx++;
-                uint16_t len = ndefTLVGetLength(&ndef[indx], &indx);
-                PrintAndLogEx(SUCCESS, "--- " _CYAN_("Proprietary info") " ---");
-                PrintAndLogEx(SUCCESS, "  Can't decode, skipping %d bytes", len);
-                indx += len;
+            case ndefsMessage: {
+                size_t n = MIN(len - indx, s->msgleft);
+                int res = ndefStreamRecords(s, data + indx, n);
+                if (res != PM3_SUCCESS) {
+                    s->state = ndefsError;
+                    return res;
+                }
+                indx += n;
+                if (s->msgleft == 0)
+                    s->state = ndefsTLVType;
                 break;
             }
-            case 0xfe: {
-                PrintAndLogEx(SUCCESS, "NDEF Terminator detected");
-                return PM3_SUCCESS;
-            }
-            default: {
-                if (verbose)
-                    PrintAndLogEx(ERR, "unknown tag 0x%02x", ndef[indx]);
-
+            case ndefsError:
+            default:
                 return PM3_ESOFT;
-            }
         }
     }
     return PM3_SUCCESS;
 }
+
+int NDEFStreamFinish(ndef_stream_t *s) {
+    if (s->state == ndefsError)
+        return PM3_ESOFT;
+
+    if (s->state == ndefsMessage) {
+        PrintAndLogEx(ERR, "NDEF message cut off, %zu of %zu bytes missing", s->msgleft, s->msglen);
+        return PM3_ESOFT;
+    }
+    return PM3_SUCCESS;
+}
+
+int NDEFDecodeAndPrint(uint8_t *ndef, size_t ndefLen, bool verbose) {
+    ndef_stream_t s;
+    NDEFStreamInit(&s, verbose);
+
+    int res = NDEFStreamFeed(&s, ndef, ndefLen);
+    if (res != PM3_SUCCESS)
+        return res;
+
+    return NDEFStreamFinish(&s);
+}
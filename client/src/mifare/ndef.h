@@ -62,6 +62,38 @@ typedef struct {
     uint8_t *ID;
 } NDEFHeader_t;
 
+// records up to this size are decoded whole even when they come in over several NDEFStreamFeed
+#define NDEF_STREAM_RECORD_MAX  1024
+
+// Decoder of NDEF TLVs fed with the data as it is read from the tag, nothing is copied unless a
+// record is split between two feeds. Bigger records than NDEF_STREAM_RECORD_MAX are checked, not kept
+typedef struct {
+    bool verbose;
+    bool done;              // terminator TLV seen, no need to read on
+    uint8_t state;
+    uint8_t tlv;            // type of the current TLV
+    uint8_t lenbuf[3];
+    uint8_t lenlen;
+    size_t left;            // bytes of its value still to come
+    uint8_t value[3];       // lock / memory control
+    size_t valuelen;
+    // NDEF message TLV
+    size_t msglen;
+    size_t msgleft;
+    size_t records;
+    bool last;              // record with MessageEnd seen
+    size_t payloadleft;     // of a record too big to keep
+    size_t buflen;
+    uint8_t buf[NDEF_STREAM_RECORD_MAX];
+} ndef_stream_t;
+
+// prints the title of NDEFDecodeAndPrint
+void NDEFStreamInit(ndef_stream_t *s, bool verbose);
+// PM3_SUCCESS, or PM3_ESOFT on an unknown TLV or bad records. s->done when the terminator was seen
+int NDEFStreamFeed(ndef_stream_t *s, uint8_t *data, size_t len);
+// PM3_ESOFT if the data ended inside a NDEF message
+int NDEFStreamFinish(ndef_stream_t *s);
+
 int NDEFDecodeAndPrint(uint8_t *ndef, size_t ndefLen, bool verbose);
 int NDEFRecordsDecodeAndPrint(uint8_t *ndefRecord, size_t ndefRecordLen);
 
@@ -0,0 +1,150 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// On-disk cache of crapto1 recovered state lists
+//
+// A state list only depends on the two lfsr_recovery inputs, for nested that is
+// the keystream and uid ^ nt. Each list goes to its own file in
+// ~/.proxmark3/statecache/, so concurrent clients never share a write.
+//-----------------------------------------------------------------------------
+
+#include "statecache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pm3_cmd.h"
+#include "ui.h"
+
+#define STATECACHE_MAGIC    0x53334d50 // "PM3S"
+#define STATECACHE_VERSION  1
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t kind;      // 32 or 64, the lfsr_recovery variant
+    uint32_t count;     // states, without the terminating {0, 0}
+} PACKED statecache_hdr_t;
+
+static char *statecache_path(uint16_t kind, uint32_t a, uint32_t b) {
+    char fn[40];
+    snprintf(fn, sizeof(fn), "r%u_%08x_%08x.bin", kind, a, b);
+
+    char *path = NULL;
+    if (searchHomeFilePath(&path, STATECACHE_SUBDIR, fn, true) != PM3_SUCCESS)
+        return NULL;
+    return path;
+}
+
+static struct Crypto1State *statecache_load(uint16_t kind, uint32_t a, uint32_t b) {
+
+    char *path = statecache_path(kind, a, b);
+    if (path == NULL)
+        return NULL;
+
+    FILE *f = fopen(path, "rb");
+    free(path);
+    if (f == NULL)
+        return NULL;
+
+    struct Crypto1State *sl = NULL;
+    statecache_hdr_t hdr;
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1)
+        goto out;
+
+    if (hdr.magic != STATECACHE_MAGIC || hdr.version != STATECACHE_VERSION || hdr.kind != kind || hdr.count > (1 << 24))
+        goto out;
+
+    sl = calloc(hdr.count + 1, sizeof(struct Crypto1State));
+    if (sl == NULL)
+        goto out;
+
+    // a short file is an interrupted write, recompute
+    if (fread(sl, sizeof(struct Crypto1State), hdr.count, f) != hdr.count) {
+        free(sl);
+        sl = NULL;
+    }
+
+out:
+    fclose(f);
+    return sl;
+}
+
+static void statecache_store(uint16_t kind, uint32_t a, uint32_t b, struct Crypto1State *sl) {
+
+    char *path = statecache_path(kind, a, b);
+    if (path == NULL)
+        return;
+
+    statecache_hdr_t hdr = {
+        .magic = STATECACHE_MAGIC,
+        .version = STATECACHE_VERSION,
+        .kind = kind,
+        .count = 0
+    };
+    while (sl[hdr.count].odd | sl[hdr.count].even)
+        hdr.count++;
+
+    // write aside and rename, readers never see a partial list
+    size_t len = strlen(path) + 5;
+    char *tmp = calloc(len, sizeof(char));
+    if (tmp == NULL) {
+        free(path);
+        return;
+    }
+    snprintf(tmp, len, "%s.tmp", path);
+
+    FILE *f = fopen(tmp, "wb");
+    if (f == NULL) {
+        PrintAndLogEx(DEBUG, "statecache: could not write %s", tmp);
+        goto out;
+    }
+
+    bool ok = (fwrite(&hdr, sizeof(hdr), 1, f) == 1);
+    ok &= (fwrite(sl, sizeof(struct Crypto1State), hdr.count, f) == hdr.count);
+    ok &= (fclose(f) == 0);
+
+    if (ok == false || rename(tmp, path) != 0)
+        remove(tmp);
+
+out:
+    free(tmp);
+    free(path);
+}
+
+struct Crypto1State *lfsr_recovery32_cached(uint32_t ks2, uint32_t in) {
+
+    if (session.statecache == false)
+        return lfsr_recovery32(ks2, in);
+
+    struct Crypto1State *sl = statecache_load(32, ks2, in);
+    if (sl) {
+        PrintAndLogEx(DEBUG, "statecache: hit for %08x %08x", ks2, in);
+        return sl;
+    }
+
+    sl = lfsr_recovery32(ks2, in);
+    if (sl)
+        statecache_store(32, ks2, in, sl);
+    return sl;
+}
+
+struct Crypto1State *lfsr_recovery64_cached(uint32_t ks2, uint32_t ks3) {
+
+    if (session.statecache == false)
+        return lfsr_recovery64(ks2, ks3);
+
+    struct Crypto1State *sl = statecache_load(64, ks2, ks3);
+    if (sl) {
+        PrintAndLogEx(DEBUG, "statecache: hit for %08x %08x", ks2, ks3);
+        return sl;
+    }
+
+    sl = lfsr_recovery64(ks2, ks3);
+    if (sl)
+        statecache_store(64, ks2, ks3, sl);
+    return sl;
+}
@@ -0,0 +1,21 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// On-disk cache of crapto1 recovered state lists
+//-----------------------------------------------------------------------------
+
+#ifndef STATECACHE_H__
+#define STATECACHE_H__
+
+#include "common.h"
+#include "crapto1/crapto1.h"
+
+// Same as lfsr_recovery32 / lfsr_recovery64, the state lists are kept in the
+// user directory when the statecache preference is on.
+// Returned lists are owned by the caller, free with crypto1_destroy.
+struct Crypto1State *lfsr_recovery32_cached(uint32_t ks2, uint32_t in);
+struct Crypto1State *lfsr_recovery64_cached(uint32_t ks2, uint32_t ks3);
+
+#endif
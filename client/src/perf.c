@@ -0,0 +1,435 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Opt-in client telemetry, latency histograms per command: round trip, time
+// waiting for the device, host compute and bytes moved. `hw perf`
+//-----------------------------------------------------------------------------
+
+#include "perf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "jansson.h"
+#include "comms.h"
+#include "ui.h"
+#include "util_posix.h"   // usclock
+#include "commonutil.h"   // version_information
+#include "pm3_cmd.h"
+
+typedef struct {
+    uint64_t sum_us;
+    uint64_t max_us;
+    uint32_t hist[PERF_HIST_BUCKETS];
+} perf_metric_t;
+
+typedef struct {
+    char path[64];
+    uint32_t calls;
+    uint32_t failures;
+    perf_metric_t rtt;
+    perf_metric_t wait;
+    perf_metric_t host;
+    uint64_t tx_bytes;
+    uint64_t rx_bytes;
+    // firmware commands sent, for the device time estimate
+    uint16_t fw_cmd[PERF_MAX_FW_IDS];
+    uint32_t fw_calls[PERF_MAX_FW_IDS];
+} perf_cmd_t;
+
+static const uint64_t perf_bucket_us[PERF_HIST_BUCKETS - 1] = {
+    100, 200, 500,
+    1000, 2000, 5000,
+    10000, 20000, 50000,
+    100000, 200000, 500000,
+    1000000, 2000000, 5000000,
+    10000000
+};
+
+static bool perf_on = false;
+static perf_cmd_t perf_cmds[PERF_MAX_CMDS];
+static uint32_t perf_cmds_count = 0;
+static uint32_t perf_dropped = 0;
+
+// running totals, the reply side is bumped by the communication thread
+static uint64_t perf_tx_total = 0;
+static uint64_t perf_rx_total = 0;
+static uint64_t perf_wait_total = 0;
+
+// the command being timed
+static bool perf_running = false;
+static uint64_t perf_start_us, perf_start_tx, perf_start_rx, perf_start_wait;
+static uint16_t perf_cur_cmd[PERF_MAX_FW_IDS];
+static uint32_t perf_cur_calls[PERF_MAX_FW_IDS];
+
+// firmware counters when the window started
+static profile_t perf_fw_base;
+static bool perf_fw_base_valid = false;
+
+static bool perf_fw_fetch(profile_t *p) {
+    if (session.pm3_present == false)
+        return false;
+
+    uint8_t reset = 0;
+    PacketResponseNG resp;
+    clearCommandBuffer();
+    SendCommandNG(CMD_PROFILE, &reset, sizeof(reset));
+    if (WaitForResponseTimeout(CMD_PROFILE, &resp, 2000) == false)
+        return false;
+    if (resp.status != PM3_SUCCESS || resp.length != sizeof(profile_t))
+        return false;
+
+    memcpy(p, resp.data.asBytes, sizeof(profile_t));
+    p->count = MIN(p->count, PROFILE_MAX_CMDS);
+    return true;
+}
+
+bool perf_enabled(void) {
+    return perf_on;
+}
+
+void perf_reset(void) {
+    memset(perf_cmds, 0, sizeof(perf_cmds));
+    perf_cmds_count = 0;
+    perf_dropped = 0;
+    perf_fw_base_valid = perf_fw_fetch(&perf_fw_base);
+}
+
+void perf_enable(bool enable) {
+    if (enable && perf_on == false)
+        perf_reset();
+    perf_on = enable;
+}
+
+void perf_sent(uint16_t cmd, size_t bytes) {
+    if (perf_on == false)
+        return;
+
+    __atomic_add_fetch(&perf_tx_total, bytes, __ATOMIC_SEQ_CST);
+    if (perf_running == false)
+        return;
+
+    for (int i = 0; i < PERF_MAX_FW_IDS; i++) {
+        if (perf_cur_calls[i] == 0 || perf_cur_cmd[i] == cmd) {
+            perf_cur_cmd[i] = cmd;
+            perf_cur_calls[i]++;
+            return;
+        }
+    }
+}
+
+void perf_received(size_t bytes) {
+    if (perf_on)
+        __atomic_add_fetch(&perf_rx_total, bytes, __ATOMIC_SEQ_CST);
+}
+
+void perf_wait(uint64_t us) {
+    if (perf_on)
+        __atomic_add_fetch(&perf_wait_total, us, __ATOMIC_SEQ_CST);
+}
+
+void perf_cmd_begin(void) {
+    if (perf_on == false)
+        return;
+
+    memset(perf_cur_cmd, 0, sizeof(perf_cur_cmd));
+    memset(perf_cur_calls, 0, sizeof(perf_cur_calls));
+    perf_start_tx = __atomic_load_n(&perf_tx_total, __ATOMIC_SEQ_CST);
+    perf_start_rx = __atomic_load_n(&perf_rx_total, __ATOMIC_SEQ_CST);
+    perf_start_wait = __atomic_load_n(&perf_wait_total, __ATOMIC_SEQ_CST);
+    perf_start_us = usclock();
+    perf_running = true;
+}
+
+static void perf_metric_add(perf_metric_t *m, uint64_t us) {
+    m->sum_us += us;
+    if (us > m->max_us)
+        m->max_us = us;
+
+    int b = 0;
+    while ((b < PERF_HIST_BUCKETS - 1) && (us >= perf_bucket_us[b]))
+        b++;
+    m->hist[b]++;
+}
+
+static perf_cmd_t *perf_cmd_lookup(const char *path) {
+    for (uint32_t i = 0; i < perf_cmds_count; i++) {
+        if (strcmp(perf_cmds[i].path, path) == 0)
+            return &perf_cmds[i];
+    }
+    if (perf_cmds_count == PERF_MAX_CMDS)
+        return NULL;
+
+    perf_cmd_t *c = &perf_cmds[perf_cmds_count++];
+    strncpy(c->path, path, sizeof(c->path) - 1);
+    return c;
+}
+
+void perf_cmd_end(const char *path, int status) {
+    if (perf_running == false)
+        return;
+    perf_running = false;
+
+    // `hw perf` reading its own numbers would only add noise
+    if (perf_on == false || strncmp(path, "hw perf", 7) == 0)
+        return;
+
+    uint64_t rtt = usclock() - perf_start_us;
+    uint64_t wait = __atomic_load_n(&perf_wait_total, __ATOMIC_SEQ_CST) - perf_start_wait;
+    if (wait > rtt)
+        wait = rtt;
+
+    perf_cmd_t *c = perf_cmd_lookup(path);
+    if (c == NULL) {
+        perf_dropped++;
+        return;
+    }
+
+    c->calls++;
+    if (status != PM3_SUCCESS)
+        c->failures++;
+    perf_metric_add(&c->rtt, rtt);
+    perf_metric_add(&c->wait, wait);
+    perf_metric_add(&c->host, rtt - wait);
+    c->tx_bytes += __atomic_load_n(&perf_tx_total, __ATOMIC_SEQ_CST) - perf_start_tx;
+    c->rx_bytes += __atomic_load_n(&perf_rx_total, __ATOMIC_SEQ_CST) - perf_start_rx;
+
+    for (int i = 0; i < PERF_MAX_FW_IDS && perf_cur_calls[i]; i++) {
+        for (int j = 0; j < PERF_MAX_FW_IDS; j++) {
+            if (c->fw_calls[j] == 0 || c->fw_cmd[j] == perf_cur_cmd[i]) {
+                c->fw_cmd[j] = perf_cur_cmd[i];
+                c->fw_calls[j] += perf_cur_calls[i];
+                break;
+            }
+        }
+    }
+}
+
+// firmware time per handler call since the window started, 0 when unknown
+static uint64_t perf_fw_avg(const profile_t *now, uint16_t cmd) {
+    for (int i = 0; i < now->count; i++) {
+        const profile_cmd_t *n = &now->cmds[i];
+        if (n->cmd != cmd)
+            continue;
+
+        uint64_t total = n->total_us;
+        uint32_t calls = n->calls;
+        for (int j = 0; perf_fw_base_valid && j < perf_fw_base.count; j++) {
+            const profile_cmd_t *b = &perf_fw_base.cmds[j];
+            // a `hw profile r` in between leaves smaller numbers, keep them as they are
+            if (b->cmd == cmd && b->calls <= calls && b->total_us <= total) {
+                total -= b->total_us;
+                calls -= b->calls;
+            }
+        }
+        return calls ? total / calls : 0;
+    }
+    return 0;
+}
+
+// estimated device time of all calls of c, false when a command wasn't in the firmware table
+static bool perf_device_us(const perf_cmd_t *c, const profile_t *now, uint64_t *us) {
+    bool complete = true;
+    *us = 0;
+    for (int i = 0; i < PERF_MAX_FW_IDS && c->fw_calls[i]; i++) {
+        uint64_t avg = perf_fw_avg(now, c->fw_cmd[i]);
+        if (avg == 0)
+            complete = false;
+        *us += avg * c->fw_calls[i];
+    }
+    return complete;
+}
+
+// upper bound of the bucket holding the given percentile, in us, at most the max seen
+static uint64_t perf_percentile(const perf_metric_t *m, uint32_t calls, uint32_t pct) {
+    uint32_t want = (calls * pct + 99) / 100;
+    uint32_t seen = 0;
+    for (int b = 0; b < PERF_HIST_BUCKETS - 1; b++) {
+        seen += m->hist[b];
+        if (seen >= want)
+            return MIN(perf_bucket_us[b], m->max_us);
+    }
+    return m->max_us;
+}
+
+static const char *perf_bucket_label(int b) {
+    static const char *labels[PERF_HIST_BUCKETS] = {
+        "< 100us", "< 200us", "< 500us",
+        "<   1ms", "<   2ms", "<   5ms",
+        "<  10ms", "<  20ms", "<  50ms",
+        "< 100ms", "< 200ms", "< 500ms",
+        "<    1s", "<    2s", "<    5s",
+        "<   10s", ">=  10s"
+    };
+    return labels[b];
+}
+
+static void perf_print_hist(const char *name, const perf_metric_t *m) {
+    uint32_t most = 0;
+    for (int b = 0; b < PERF_HIST_BUCKETS; b++)
+        most = MAX(most, m->hist[b]);
+    if (most == 0)
+        return;
+
+    PrintAndLogEx(INFO, "   %s", name);
+    for (int b = 0; b < PERF_HIST_BUCKETS; b++) {
+        if (m->hist[b] == 0)
+            continue;
+        char bar[41] = {0};
+        memset(bar, '#', MAX(1, (m->hist[b] * 40) / most));
+        PrintAndLogEx(INFO, "     %s %6u %s", perf_bucket_label(b), m->hist[b], bar);
+    }
+}
+
+void perf_print(bool histograms) {
+    PrintAndLogEx(INFO, "client telemetry is %s", perf_on ? _GREEN_("on") : _YELLOW_("off"));
+    if (perf_cmds_count == 0) {
+        PrintAndLogEx(INFO, "no commands recorded yet");
+        return;
+    }
+
+    profile_t now;
+    bool have_fw = perf_fw_fetch(&now);
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "                                       round trip ms          |    avg ms of    |");
+    PrintAndLogEx(INFO, " command                  | calls |   avg    p50    p95    max |  usb  host  dev |    tx kB    rx kB");
+    PrintAndLogEx(INFO, "--------------------------+-------+----------------------------+-----------------+------------------");
+    for (uint32_t i = 0; i < perf_cmds_count; i++) {
+        const perf_cmd_t *c = &perf_cmds[i];
+
+        char dev[8] = "    -";
+        uint64_t dev_us;
+        if (have_fw && c->fw_calls[0] && perf_device_us(c, &now, &dev_us))
+            snprintf(dev, sizeof(dev), "%5.1f", (double)dev_us / c->calls / 1000);
+
+        uint64_t p50 = perf_percentile(&c->rtt, c->calls, 50);
+        uint64_t p95 = perf_percentile(&c->rtt, c->calls, 95);
+        PrintAndLogEx(INFO, " %-24.24s | %5u | %6.1f %6.1f %6.1f %6.1f | %4.1f %5.1f %s | %8.1f %8.1f%s",
+                      c->path, c->calls,
+                      (double)c->rtt.sum_us / c->calls / 1000,
+                      (double)p50 / 1000,
+                      (double)p95 / 1000,
+                      (double)c->rtt.max_us / 1000,
+                      (double)c->wait.sum_us / c->calls / 1000,
+                      (double)c->host.sum_us / c->calls / 1000,
+                      dev,
+                      (double)c->tx_bytes / 1024, (double)c->rx_bytes / 1024,
+                      c->failures ? " ( " _RED_("failures") " )" : "");
+    }
+    if (perf_dropped)
+        PrintAndLogEx(WARNING, "%u calls of further commands not recorded, table is full", perf_dropped);
+    if (have_fw == false)
+        PrintAndLogEx(INFO, "no firmware counters, `dev` needs a device with `hw profile` support");
+    PrintAndLogEx(INFO, "p50/p95 are histogram bucket bounds. `dev` is estimated from the firmware handler averages");
+
+    if (histograms == false)
+        return;
+
+    for (uint32_t i = 0; i < perf_cmds_count; i++) {
+        const perf_cmd_t *c = &perf_cmds[i];
+        PrintAndLogEx(NORMAL, "");
+        PrintAndLogEx(INFO, _YELLOW_("%s") " - %u calls, %u failed", c->path, c->calls, c->failures);
+        perf_print_hist("round trip", &c->rtt);
+        perf_print_hist("usb wait", &c->wait);
+        perf_print_hist("host compute", &c->host);
+    }
+}
+
+static json_t *perf_metric_json(const perf_metric_t *m) {
+    json_t *hist = json_array();
+    for (int b = 0; b < PERF_HIST_BUCKETS; b++)
+        json_array_append_new(hist, json_integer(m->hist[b]));
+
+    json_t *o = json_object();
+    json_object_set_new(o, "sum_us", json_integer(m->sum_us));
+    json_object_set_new(o, "max_us", json_integer(m->max_us));
+    json_object_set_new(o, "histogram", hist);
+    return o;
+}
+
+// firmware version text without the color escapes
+static void perf_strip_ansi(char *s) {
+    char *d = s;
+    while (*s) {
+        if (*s == '\x1b') {
+            while (*s && *s != 'm')
+                s++;
+            if (*s)
+                s++;
+            continue;
+        }
+        *d++ = *s++;
+    }
+    *d = '\0';
+}
+
+int perf_save_json(const char *fn) {
+
+    profile_t now;
+    bool have_fw = perf_fw_fetch(&now);
+
+    json_t *root = json_object();
+    json_object_set_new(root, "Created", json_string("proxmark3"));
+    json_object_set_new(root, "FileType", json_string("perf"));
+    json_object_set_new(root, "client", json_string(version_information.gitversion));
+
+    if (session.pm3_present) {
+        PacketResponseNG resp;
+        clearCommandBuffer();
+        SendCommandNG(CMD_VERSION, NULL, 0);
+        if (WaitForResponseTimeout(CMD_VERSION, &resp, 1000) && resp.length > 12) {
+            char fw[PM3_CMD_DATA_SIZE - 12 + 1] = {0};
+            memcpy(fw, resp.data.asBytes + 12, MIN(resp.length - 12, sizeof(fw) - 1));
+            perf_strip_ansi(fw);
+            json_object_set_new(root, "firmware", json_string(fw));
+        }
+    }
+
+    json_t *buckets = json_array();
+    for (int b = 0; b < PERF_HIST_BUCKETS - 1; b++)
+        json_array_append_new(buckets, json_integer(perf_bucket_us[b]));
+    json_object_set_new(root, "buckets_us", buckets);
+
+    json_t *cmds = json_array();
+    for (uint32_t i = 0; i < perf_cmds_count; i++) {
+        const perf_cmd_t *c = &perf_cmds[i];
+        json_t *o = json_object();
+        json_object_set_new(o, "command", json_string(c->path));
+        json_object_set_new(o, "calls", json_integer(c->calls));
+        json_object_set_new(o, "failures", json_integer(c->failures));
+        json_object_set_new(o, "round_trip", perf_metric_json(&c->rtt));
+        json_object_set_new(o, "usb_wait", perf_metric_json(&c->wait));
+        json_object_set_new(o, "host", perf_metric_json(&c->host));
+        json_object_set_new(o, "tx_bytes", json_integer(c->tx_bytes));
+        json_object_set_new(o, "rx_bytes", json_integer(c->rx_bytes));
+
+        uint64_t dev_us;
+        if (have_fw && c->fw_calls[0] && perf_device_us(c, &now, &dev_us))
+            json_object_set_new(o, "device_us_est", json_integer(dev_us));
+
+        json_t *fw = json_object();
+        for (int j = 0; j < PERF_MAX_FW_IDS && c->fw_calls[j]; j++) {
+            char id[8];
+            snprintf(id, sizeof(id), "0x%04x", c->fw_cmd[j]);
+            json_object_set_new(fw, id, json_integer(c->fw_calls[j]));
+        }
+        json_object_set_new(o, "firmware_cmds", fw);
+        json_array_append_new(cmds, o);
+    }
+    json_object_set_new(root, "commands", cmds);
+    json_object_set_new(root, "dropped", json_integer(perf_dropped));
+
+    int res = json_dump_file(root, fn, JSON_INDENT(2));
+    json_decref(root);
+    if (res) {
+        PrintAndLogEx(FAILED, "error: can't save the file: " _YELLOW_("%s"), fn);
+        return PM3_EFILE;
+    }
+    PrintAndLogEx(SUCCESS, "saved %u commands to " _YELLOW_("%s"), perf_cmds_count, fn);
+    return PM3_SUCCESS;
+}
@@ -0,0 +1,39 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Opt-in client telemetry, latency histograms per command: round trip, time
+// waiting for the device, host compute and bytes moved. `hw perf`
+//-----------------------------------------------------------------------------
+
+#ifndef PERF_H__
+#define PERF_H__
+
+#include "common.h"
+
+// distinct command paths kept, later ones are counted as dropped
+#define PERF_MAX_CMDS       64
+// firmware command ids remembered per client command
+#define PERF_MAX_FW_IDS     6
+// <100us, <200us, <500us, <1ms ... <5s, <10s, >= 10s
+#define PERF_HIST_BUCKETS   17
+
+bool perf_enabled(void);
+void perf_enable(bool enable);
+void perf_reset(void);
+
+// hooks for comms.c, cheap no-ops when telemetry is off
+void perf_sent(uint16_t cmd, size_t bytes);
+void perf_received(size_t bytes);
+void perf_wait(uint64_t us);
+
+// around one top level command of cmdparser.c, path is like "hf 14a info"
+void perf_cmd_begin(void);
+void perf_cmd_end(const char *path, int status);
+
+// fetches the firmware counters for the device time estimates, then prints / writes
+void perf_print(bool histograms);
+int perf_save_json(const char *fn);
+
+#endif
@@ -5,9 +5,15 @@
 #include <lua.h>
 #include <lauxlib.h>
 #include <limits.h>
+#include <string.h>
 
 #include "pm3_bit_limits.h"
 #include "pm3_bitlib.h"
+#include "crc16.h"
+#include "crc32.h"
+#include "crc.h"
+#include "parity.h"
+#include "commonutil.h"
 
 
 /* FIXME: Assumes lua_Integer is ptrdiff_t */
@@ -116,6 +122,168 @@ ARITHMETIC_SHIFT(lshift,  <<)
 LOGICAL_SHIFT(rshift,     >>)
 ARITHMETIC_SHIFT(arshift, >>)
 
+/* Byte string operations
+
+   Whole buffers in one call, the scripts used to do them a byte at a
+   time in Lua. A byte string is a Lua string of raw bytes, as bin.pack
+   and core.console give them.
+   */
+
+static int hexval(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/* tohex(bytes [, lower]) -> hex string, upper case by default */
+static int bit_tohex(lua_State *L) {
+    size_t len;
+    const uint8_t *d = (const uint8_t *)luaL_checklstring(L, 1, &len);
+    const char *digits = lua_toboolean(L, 2) ? "0123456789abcdef" : "0123456789ABCDEF";
+    luaL_Buffer b;
+    char *out = luaL_buffinitsize(L, &b, len * 2);
+    for (size_t i = 0; i < len; i++) {
+        out[i * 2] = digits[d[i] >> 4];
+        out[i * 2 + 1] = digits[d[i] & 0x0F];
+    }
+    luaL_pushresultsize(&b, len * 2);
+    return 1;
+}
+
+/* fromhex(hex [, safechars]) -> bytes, of each pair of hex digits, anything else
+   between them is skipped. With safechars, control chars come back as '.' */
+static int bit_fromhex(lua_State *L) {
+    size_t len;
+    const char *s = luaL_checklstring(L, 1, &len);
+    int safe = lua_toboolean(L, 2);
+    luaL_Buffer b;
+    char *out = luaL_buffinitsize(L, &b, len / 2);
+    size_t n = 0;
+    for (size_t i = 0; i + 1 < len;) {
+        int hi = hexval(s[i]);
+        int lo = hexval(s[i + 1]);
+        if (hi < 0 || lo < 0) {
+            i++;
+            continue;
+        }
+        uint8_t c = hi << 4 | lo;
+        if (safe && (c < 32 || c == 127))
+            c = '.';
+        out[n++] = c;
+        i += 2;
+    }
+    luaL_pushresultsize(&b, n);
+    return 1;
+}
+
+/* xor(bytes, key) -> bytes, the key is repeated over the data */
+static int bit_xor(lua_State *L) {
+    size_t len, klen;
+    const uint8_t *d = (const uint8_t *)luaL_checklstring(L, 1, &len);
+    const uint8_t *k = (const uint8_t *)luaL_checklstring(L, 2, &klen);
+    luaL_argcheck(L, klen > 0, 2, "empty key");
+    luaL_Buffer b;
+    uint8_t *out = (uint8_t *)luaL_buffinitsize(L, &b, len);
+    for (size_t i = 0; i < len; i++)
+        out[i] = d[i] ^ k[i % klen];
+    luaL_pushresultsize(&b, len);
+    return 1;
+}
+
+/* reverse(bytes) -> bytes, bit order of each byte reversed */
+static int bit_reverse(lua_State *L) {
+    size_t len;
+    const uint8_t *d = (const uint8_t *)luaL_checklstring(L, 1, &len);
+    luaL_Buffer b;
+    uint8_t *out = (uint8_t *)luaL_buffinitsize(L, &b, len);
+    for (size_t i = 0; i < len; i++)
+        out[i] = reflect8(d[i]);
+    luaL_pushresultsize(&b, len);
+    return 1;
+}
+
+/* invert(bytes) -> bytes, all bits flipped */
+static int bit_invert(lua_State *L) {
+    size_t len;
+    const uint8_t *d = (const uint8_t *)luaL_checklstring(L, 1, &len);
+    luaL_Buffer b;
+    uint8_t *out = (uint8_t *)luaL_buffinitsize(L, &b, len);
+    for (size_t i = 0; i < len; i++)
+        out[i] = ~d[i];
+    luaL_pushresultsize(&b, len);
+    return 1;
+}
+
+/* parity(bytes) -> bytes, the odd parity bit of each byte packed msb first,
+   as the parity of a trace */
+static int bit_parity(lua_State *L) {
+    size_t len;
+    const uint8_t *d = (const uint8_t *)luaL_checklstring(L, 1, &len);
+    size_t plen = (len + 7) / 8;
+    luaL_Buffer b;
+    uint8_t *out = (uint8_t *)luaL_buffinitsize(L, &b, plen);
+    memset(out, 0, plen);
+    for (size_t i = 0; i < len; i++)
+        out[i / 8] |= oddparity8(d[i]) << (7 - (i % 8));
+    luaL_pushresultsize(&b, plen);
+    return 1;
+}
+
+static const struct {
+    const char *name;
+    CrcType_t type;
+} crc16_types[] = {
+    {"14a",      CRC_14443_A},
+    {"14b",      CRC_14443_B},
+    {"15",       CRC_15693},
+    {"iclass",   CRC_ICLASS},
+    {"felica",   CRC_FELICA},
+    {"ccitt",    CRC_CCITT},
+    {"kermit",   CRC_KERMIT},
+    {"xmodem",   CRC_XMODEM},
+    {"cryptorf", CRC_CRYPTORF},
+    {"fdx",      CRC_11784},
+};
+
+/* crc(name, bytes) -> crc bytes as they are appended to the frame.
+   The crc16 of crc16.c by the name of crc16_types, or crc32 (crc32_ex, DESFire), crc8mad, crc8maxim,
+   crc8legic, crc8cardx */
+static int bit_crc(lua_State *L) {
+    const char *name = luaL_checkstring(L, 1);
+    size_t len;
+    const uint8_t *d = (const uint8_t *)luaL_checklstring(L, 2, &len);
+    uint8_t out[4];
+
+    for (size_t i = 0; i < sizeof(crc16_types) / sizeof(crc16_types[0]); i++) {
+        if (strcmp(name, crc16_types[i].name) == 0) {
+            compute_crc(crc16_types[i].type, d, len, &out[0], &out[1]);
+            lua_pushlstring(L, (const char *)out, 2);
+            return 1;
+        }
+    }
+
+    uint32_t (*crc8)(uint8_t *, size_t) = NULL;
+    if (strcmp(name, "crc32") == 0) {
+        crc32_ex(d, len, out);
+        lua_pushlstring(L, (const char *)out, 4);
+        return 1;
+    } else if (strcmp(name, "crc8mad") == 0) {
+        crc8 = CRC8Mad;
+    } else if (strcmp(name, "crc8maxim") == 0) {
+        crc8 = CRC8Maxim;
+    } else if (strcmp(name, "crc8legic") == 0) {
+        crc8 = CRC8Legic;
+    } else if (strcmp(name, "crc8cardx") == 0) {
+        crc8 = CRC8Cardx;
+    } else {
+        return luaL_argerror(L, 1, "unknown crc");
+    }
+    out[0] = crc8((uint8_t *)d, len);
+    lua_pushlstring(L, (const char *)out, 1);
+    return 1;
+}
+
 static const struct luaL_Reg bitlib[] = {
     {"cast",    bit_cast},
     {"bnot",    bit_bnot},
@@ -125,6 +293,13 @@ static const struct luaL_Reg bitlib[] = {
     {"lshift",  bit_lshift},
     {"rshift",  bit_rshift},
     {"arshift", bit_arshift},
+    {"tohex",   bit_tohex},
+    {"fromhex", bit_fromhex},
+    {"xor",     bit_xor},
+    {"reverse", bit_reverse},
+    {"invert",  bit_invert},
+    {"parity",  bit_parity},
+    {"crc",     bit_crc},
     {NULL, NULL}
 };
 
@@ -0,0 +1,441 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Daemon mode, one client keeps the device connection and runs the commands
+// of short lived `-c` invocations sent over a local socket.
+//
+// A request is the command line, ';' separated, ended by '\n'. The daemon runs it
+// with stdin / stdout / stderr on the socket, so output and Enter for the long
+// running commands pass through. A 0x00 byte and the int32 status of the last
+// command end the answer.
+//-----------------------------------------------------------------------------
+#include "pm3daemon.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "ui.h"
+#include "cmdmain.h"
+#include "comms.h"
+#include "cmdhw.h"   // pm3_version
+#include "util_posix.h" // msclock
+
+#if defined(_WIN32)
+
+int pm3_daemon_serve(const char *path) {
+    (void)path;
+    PrintAndLogEx(ERR, "daemon mode is not available on Windows");
+    return PM3_ENOTIMPL;
+}
+
+int pm3_daemon_request(const char *path, const char *cmds) {
+    (void)path;
+    (void)cmds;
+    PrintAndLogEx(ERR, "daemon mode is not available on Windows");
+    return PM3_ENOTIMPL;
+}
+
+int pm3_daemon_pool(char *const *paths, int npaths, char *const *jobs, int njobs, bool broadcast) {
+    (void)paths;
+    (void)npaths;
+    (void)jobs;
+    (void)njobs;
+    (void)broadcast;
+    PrintAndLogEx(ERR, "daemon mode is not available on Windows");
+    return PM3_ENOTIMPL;
+}
+
+#else
+
+#include <unistd.h>
+#include <signal.h>
+#include <poll.h>
+#include <pthread.h>
+#include <inttypes.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#define PM3_DAEMON_MAX_REQUEST  4096
+
+static int daemon_address(const char *path, struct sockaddr_un *addr) {
+    memset(addr, 0, sizeof(struct sockaddr_un));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        PrintAndLogEx(ERR, "socket path too long " _YELLOW_("%s"), path);
+        return PM3_EINVARG;
+    }
+    strcpy(addr->sun_path, path);
+    return PM3_SUCCESS;
+}
+
+// byte by byte, whatever follows the line stays in the socket for stdin
+static int daemon_read_request(int fd, char *buf, size_t size) {
+    size_t n = 0;
+    while (n < size - 1) {
+        char c;
+        if (read(fd, &c, 1) != 1)
+            return -1;
+        if (c == '\n')
+            break;
+        buf[n++] = c;
+    }
+    buf[n] = '\0';
+    return n;
+}
+
+static int daemon_run(char *cmds) {
+    int ret = PM3_SUCCESS;
+    char *save = NULL;
+    for (char *cmd = strtok_r(cmds, ";", &save); cmd; cmd = strtok_r(NULL, ";", &save)) {
+
+        while (isspace((uint8_t)*cmd))
+            cmd++;
+        size_t l = strlen(cmd);
+        while (l > 0 && isspace((uint8_t)cmd[l - 1]))
+            cmd[--l] = '\0';
+        if (l == 0)
+            continue;
+
+        PrintAndLogEx(NORMAL, "[%s|daemon] pm3 --> %s", session.pm3_present ? "usb" : "offline", cmd);
+        ret = CommandReceived(cmd);
+        PrintAndLogEx(NORMAL, "\nNikola.D: %d", ret);
+        if (ret == PM3_EFATAL)
+            break;
+    }
+    return ret;
+}
+
+static int daemon_serve_one(int client) {
+    char request[PM3_DAEMON_MAX_REQUEST];
+    if (daemon_read_request(client, request, sizeof(request)) < 0)
+        return PM3_EIO;
+
+    fflush(stdout);
+    fflush(stderr);
+    int saved[3] = { dup(STDIN_FILENO), dup(STDOUT_FILENO), dup(STDERR_FILENO) };
+    for (int i = 0; i < 3; i++)
+        dup2(client, i);
+    clearerr(stdin);
+
+    int ret = daemon_run(request);
+
+    fflush(stdout);
+    fflush(stderr);
+    for (int i = 0; i < 3; i++) {
+        dup2(saved[i], i);
+        close(saved[i]);
+    }
+    clearerr(stdin);
+
+    uint8_t trailer[1 + sizeof(int32_t)] = {0};
+    int32_t status = ret;
+    memcpy(trailer + 1, &status, sizeof(status));
+    if (write(client, trailer, sizeof(trailer)) != sizeof(trailer))
+        PrintAndLogEx(DEBUG, "daemon client left early");
+    return ret;
+}
+
+int pm3_daemon_serve(const char *path) {
+    struct sockaddr_un addr;
+    if (daemon_address(path, &addr) != PM3_SUCCESS)
+        return PM3_EINVARG;
+
+    // a socket left by a daemon which didn't stop cleanly
+    struct stat st;
+    if (lstat(path, &st) == 0) {
+        if (S_ISSOCK(st.st_mode) == false) {
+            PrintAndLogEx(ERR, _YELLOW_("%s") " exists and is not a socket", path);
+            return PM3_EFILE;
+        }
+        unlink(path);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        PrintAndLogEx(ERR, "could not create socket");
+        return PM3_EIO;
+    }
+
+    // only the user may connect
+    mode_t mask = umask(0177);
+    int res = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    umask(mask);
+    if (res < 0 || listen(fd, 8) < 0) {
+        PrintAndLogEx(ERR, "could not listen on " _YELLOW_("%s"), path);
+        close(fd);
+        return PM3_EIO;
+    }
+
+    // clients which go away while their output is written, must not take the daemon along
+    signal(SIGPIPE, SIG_IGN);
+
+    // the answers go to scripts, as they are printed
+    session.supports_colors = false;
+    session.emoji_mode = ALTTEXT;
+    SetFlushAfterWrite(true);
+
+    if (session.pm3_present)
+        pm3_version(false, false);
+
+    PrintAndLogEx(SUCCESS, "daemon listening on " _YELLOW_("%s"), path);
+
+    for (;;) {
+        int client = accept(fd, NULL, NULL);
+        if (client < 0)
+            continue;
+        res = daemon_serve_one(client);
+        close(client);
+        if (res == PM3_EFATAL)
+            break;
+    }
+
+    PrintAndLogEx(INFO, "daemon stopped");
+    close(fd);
+    unlink(path);
+    return PM3_SUCCESS;
+}
+
+// one request, the answer goes to out. Enter on the terminal is forwarded when forward_stdin,
+// e.g. to stop `hf 14a sniff l`
+static int daemon_exchange(const char *path, const char *cmds, FILE *out, bool forward_stdin) {
+    struct sockaddr_un addr;
+    if (daemon_address(path, &addr) != PM3_SUCCESS)
+        return PM3_EINVARG;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        PrintAndLogEx(ERR, "no daemon at " _YELLOW_("%s"), path);
+        if (fd >= 0)
+            close(fd);
+        return PM3_EIO;
+    }
+
+    size_t len = strlen(cmds);
+    char *request = calloc(len + 2, sizeof(char));
+    if (request == NULL) {
+        close(fd);
+        return PM3_EMALLOC;
+    }
+    for (size_t i = 0; i < len; i++)
+        request[i] = (cmds[i] == '\n' || cmds[i] == '\r') ? ';' : cmds[i];
+    request[len] = '\n';
+    bool sent = (write(fd, request, len + 1) == (ssize_t)(len + 1));
+    free(request);
+    if (sent == false) {
+        close(fd);
+        return PM3_EIO;
+    }
+
+    struct pollfd fds[2] = {
+        { .fd = fd, .events = POLLIN },
+        { .fd = STDIN_FILENO, .events = POLLIN },
+    };
+
+    uint8_t buf[4096];
+    uint8_t status[sizeof(int32_t)];
+    int status_len = -1;
+
+    while (status_len < (int)sizeof(status)) {
+        if (poll(fds, forward_stdin ? 2 : 1, -1) < 0)
+            break;
+
+        if (forward_stdin && (fds[1].revents & POLLIN)) {
+            ssize_t n = read(STDIN_FILENO, buf, sizeof(buf));
+            if (n > 0 && write(fd, buf, n) != n)
+                break;
+            if (n <= 0)
+                forward_stdin = false;
+        }
+
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if (n <= 0)
+                break;
+
+            ssize_t i = 0;
+            if (status_len < 0) {
+                uint8_t *end = memchr(buf, 0x00, n);
+                i = (end) ? end - buf : n;
+                fwrite(buf, 1, i, out);
+                if (end) {
+                    status_len = 0;
+                    i++;
+                }
+            }
+            for (; status_len >= 0 && i < n && status_len < (int)sizeof(status); i++)
+                status[status_len++] = buf[i];
+        }
+    }
+    fflush(out);
+    close(fd);
+
+    if (status_len != sizeof(status)) {
+        PrintAndLogEx(ERR, "daemon connection lost " _YELLOW_("%s"), path);
+        return PM3_EIO;
+    }
+
+    int32_t ret;
+    memcpy(&ret, status, sizeof(ret));
+    return ret;
+}
+
+int pm3_daemon_request(const char *path, const char *cmds) {
+    return daemon_exchange(path, cmds, stdout, isatty(STDIN_FILENO));
+}
+
+// One worker thread per daemon. Jobs are taken from the queue by whichever device is free,
+// a device which goes away puts its job back for the others
+typedef struct {
+    pthread_mutex_t lock;
+    char *const *paths;
+    char *const *jobs;
+    int njobs;
+    bool broadcast;
+    int *queue;         // job indexes still to run
+    int queued;
+    int *status;        // per job, or per device when broadcast
+    int *device;        // device which ran the job
+    uint64_t *ms;
+} daemon_pool_t;
+
+typedef struct {
+    daemon_pool_t *pool;
+    int idx;
+} daemon_worker_t;
+
+static void *daemon_pool_worker(void *arg) {
+    daemon_worker_t *w = (daemon_worker_t *)arg;
+    daemon_pool_t *p = w->pool;
+    const char *path = p->paths[w->idx];
+
+    for (int round = 0; ; round++) {
+
+        int job;
+        if (p->broadcast) {
+            if (round > 0)
+                break;
+            job = 0;
+        } else {
+            pthread_mutex_lock(&p->lock);
+            job = (p->queued) ? p->queue[--p->queued] : -1;
+            pthread_mutex_unlock(&p->lock);
+            if (job < 0)
+                break;
+        }
+
+        char *text = NULL;
+        size_t len = 0;
+        FILE *out = open_memstream(&text, &len);
+        if (out == NULL)
+            break;
+
+        uint64_t t = msclock();
+        int res = daemon_exchange(path, p->jobs[job], out, false);
+        t = msclock() - t;
+        fclose(out);
+
+        pthread_mutex_lock(&p->lock);
+        PrintAndLogEx(INFO, "--- device " _YELLOW_("%d") " (%s) job " _YELLOW_("%d") "  %s", w->idx, path, job, p->jobs[job]);
+        fwrite(text, 1, len, stdout);
+        fflush(stdout);
+
+        int slot = (p->broadcast) ? w->idx : job;
+        p->status[slot] = res;
+        p->device[slot] = w->idx;
+        p->ms[slot] = t;
+
+        bool lost = (res == PM3_EIO);
+        if (lost && p->broadcast == false) {
+            p->queue[p->queued++] = job;
+            p->status[slot] = PM3_EUNDEF;
+        }
+        pthread_mutex_unlock(&p->lock);
+        free(text);
+
+        if (lost)
+            break;
+    }
+    return NULL;
+}
+
+int pm3_daemon_pool(char *const *paths, int npaths, char *const *jobs, int njobs, bool broadcast) {
+
+    if (npaths == 0 || njobs == 0) {
+        PrintAndLogEx(WARNING, "no %s", (npaths == 0) ? "devices" : "jobs");
+        return PM3_EINVARG;
+    }
+
+    int slots = (broadcast) ? npaths : njobs;
+    daemon_pool_t p = {
+        .paths = paths,
+        .jobs = jobs,
+        .njobs = njobs,
+        .broadcast = broadcast,
+        .queue = calloc(njobs, sizeof(int)),
+        .status = calloc(slots, sizeof(int)),
+        .device = calloc(slots, sizeof(int)),
+        .ms = calloc(slots, sizeof(uint64_t)),
+    };
+    daemon_worker_t *workers = calloc(npaths, sizeof(daemon_worker_t));
+    pthread_t *threads = calloc(npaths, sizeof(pthread_t));
+
+    int res = PM3_SUCCESS;
+    if (p.queue == NULL || p.status == NULL || p.device == NULL || p.ms == NULL || workers == NULL || threads == NULL) {
+        res = PM3_EMALLOC;
+        goto out;
+    }
+
+    pthread_mutex_init(&p.lock, NULL);
+
+    // the queue is taken from the end, first job first
+    for (int i = 0; i < njobs; i++)
+        p.queue[i] = njobs - 1 - i;
+    p.queued = (broadcast) ? 0 : njobs;
+
+    for (int i = 0; i < slots; i++) {
+        p.status[i] = PM3_EUNDEF;
+        p.device[i] = -1;
+    }
+
+    for (int i = 0; i < npaths; i++) {
+        workers[i].pool = &p;
+        workers[i].idx = i;
+        pthread_create(&threads[i], NULL, daemon_pool_worker, &workers[i]);
+    }
+    for (int i = 0; i < npaths; i++)
+        pthread_join(threads[i], NULL);
+
+    pthread_mutex_destroy(&p.lock);
+
+    int ok = 0;
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "---- %s ----", (broadcast) ? "device | status |    ms" : "   job | device | status |    ms");
+    for (int i = 0; i < slots; i++) {
+        if (p.status[i] == PM3_SUCCESS)
+            ok++;
+        if (broadcast)
+            PrintAndLogEx(INFO, "  %6d | %6d | %5" PRIu64 " %s", i, p.status[i], p.ms[i], paths[i]);
+        else if (p.device[i] < 0)
+            PrintAndLogEx(INFO, "  %6d |      - | not run", i);
+        else
+            PrintAndLogEx(INFO, "  %6d | %6d | %6d | %5" PRIu64, i, p.device[i], p.status[i], p.ms[i]);
+    }
+    PrintAndLogEx((ok == slots) ? SUCCESS : WARNING, "%d of %d %s ok", ok, slots, (broadcast) ? "devices" : "jobs");
+    res = (ok == slots) ? PM3_SUCCESS : PM3_ESOFT;
+
+out:
+    free(p.queue);
+    free(p.status);
+    free(p.device);
+    free(p.ms);
+    free(workers);
+    free(threads);
+    return res;
+}
+
+#endif
@@ -0,0 +1,28 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Daemon mode, one client keeps the device connection and runs the commands
+// of short lived `-c` invocations sent over a local socket
+//-----------------------------------------------------------------------------
+
+#ifndef PM3DAEMON_H__
+#define PM3DAEMON_H__
+
+#include "common.h"
+
+// Serves requests on the unix socket at path until a `quit` comes in. Each request runs like
+// `-c`, its output and the status of the last command go back on the socket
+int pm3_daemon_serve(const char *path);
+
+// Runs cmds (';' separated) in the daemon at path, prints what they print. Returns the status
+// of the last command, PM3_EIO when there is no daemon
+int pm3_daemon_request(const char *path, const char *cmds);
+
+// Drives the daemons of paths in parallel, one thread each. broadcast runs jobs[0] on every
+// device, else every job runs once on the first free device. Prints each answer as a block
+// and a summary, PM3_ESOFT when a job failed or could not run
+int pm3_daemon_pool(char *const *paths, int npaths, char *const *jobs, int njobs, bool broadcast);
+
+#endif
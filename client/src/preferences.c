@@ -40,6 +40,10 @@ static char *prefGetFilename(void) {
 
 int preferences_load(void) {
 
+    // the paths searched may change with them
+    searchHomeFilePathReset();
+    searchFileIndexReset();
+
     // Set all defaults
     session.client_debug_level = cdbOFF;
     //  session.device_debug_level = ddbOFF;
@@ -53,6 +57,9 @@ int preferences_load(void) {
     session.overlay.h = 200;
     session.overlay.w = session.plot.w;
     session.show_hints = false;
+    session.statecache = false;
+    session.keycache = false;
+    session.session_log = slOFF;
 
 //    setDefaultPath (spDefault, "");
 //    setDefaultPath (spDump, "");
@@ -168,6 +175,21 @@ void preferences_save_callback(json_t *root) {
 
     JsonSaveBoolean(root, "show.hints", session.show_hints);
 
+    JsonSaveBoolean(root, "client.statecache", session.statecache);
+    JsonSaveBoolean(root, "client.keycache", session.keycache);
+
+    switch (session.session_log) {
+        case slLINE:
+            JsonSaveStr(root, "client.sessionlog", "line");
+            break;
+        case slBATCH:
+            JsonSaveStr(root, "client.sessionlog", "batch");
+            break;
+        case slOFF:
+        default:
+            JsonSaveStr(root, "client.sessionlog", "off");
+    }
+
     JsonSaveBoolean(root, "os.supports.colors", session.supports_colors);
 
 //   JsonSaveStr(root, "file.default.savepath", session.defaultPaths[spDefault]);
@@ -284,6 +306,20 @@ void preferences_load_callback(json_t *root) {
     if (json_unpack_ex(root, &up_error, 0, "{s:b}", "show.hints", &b1) == 0)
         session.show_hints = b1;
 
+    if (json_unpack_ex(root, &up_error, 0, "{s:b}", "client.statecache", &b1) == 0)
+        session.statecache = b1;
+
+    if (json_unpack_ex(root, &up_error, 0, "{s:b}", "client.keycache", &b1) == 0)
+        session.keycache = b1;
+
+    if (json_unpack_ex(root, &up_error, 0, "{s:s}", "client.sessionlog", &s1) == 0) {
+        strncpy(tempStr, s1, sizeof(tempStr) - 1);
+        str_lower(tempStr);
+        if (strncmp(tempStr, "off", 3) == 0) session.session_log = slOFF;
+        if (strncmp(tempStr, "line", 4) == 0) session.session_log = slLINE;
+        if (strncmp(tempStr, "batch", 5) == 0) session.session_log = slBATCH;
+    }
+
     if (json_unpack_ex(root, &up_error, 0, "{s:b}", "os.supports.colors", &b1) == 0)
         session.supports_colors = b1;
     /*
@@ -353,6 +389,31 @@ static int usage_set_hints(void) {
     PrintAndLogEx(NORMAL, "     "_GREEN_("on")"          - Display hints");
     return PM3_SUCCESS;
 }
+static int usage_set_statecache(void) {
+    PrintAndLogEx(NORMAL, "Usage: pref set statecache <off | on>");
+    PrintAndLogEx(NORMAL, "Options:");
+    PrintAndLogEx(NORMAL, "     "_GREEN_("help")"        - This help");
+    PrintAndLogEx(NORMAL, "     "_GREEN_("off")"         - Recover crapto1 state lists every time");
+    PrintAndLogEx(NORMAL, "     "_GREEN_("on")"          - Keep recovered crapto1 state lists in " PM3_USER_DIRECTORY STATECACHE_SUBDIR);
+    return PM3_SUCCESS;
+}
+static int usage_set_keycache(void) {
+    PrintAndLogEx(NORMAL, "Usage: pref set keycache <off | on>");
+    PrintAndLogEx(NORMAL, "Options:");
+    PrintAndLogEx(NORMAL, "     "_GREEN_("help")"        - This help");
+    PrintAndLogEx(NORMAL, "     "_GREEN_("off")"         - hf mf chk / fchk try keys in the given order");
+    PrintAndLogEx(NORMAL, "     "_GREEN_("on")"          - Count found keys in " PM3_USER_DIRECTORY "mfc_key_cache.txt and try the most hit ones first");
+    return PM3_SUCCESS;
+}
+static int usage_set_sessionlog(void) {
+    PrintAndLogEx(NORMAL, "Usage: pref set sessionlog <off | line | batch>");
+    PrintAndLogEx(NORMAL, "Options:");
+    PrintAndLogEx(NORMAL, "     "_GREEN_("help")"        - This help");
+    PrintAndLogEx(NORMAL, "     "_GREEN_("off")"         - No session log");
+    PrintAndLogEx(NORMAL, "     "_GREEN_("line")"        - Log to " PM3_USER_DIRECTORY LOGS_SUBDIR ", flushed after every line");
+    PrintAndLogEx(NORMAL, "     "_GREEN_("batch")"       - Log to " PM3_USER_DIRECTORY LOGS_SUBDIR ", written and flushed in the background");
+    return PM3_SUCCESS;
+}
 /*
 static int usage_set_savePaths(void) {
     PrintAndLogEx(NORMAL, "Usage: pref set savepaths [help] [create] [default <path>] [dump <path>] [trace <path>]");
@@ -492,6 +553,37 @@ static void showHintsState(prefShowOpt_t opt) {
         PrintAndLogEx(INFO, "   %s hints.................. "_WHITE_("off"), prefShowMsg(opt));
 }
 
+static void showStatecacheState(prefShowOpt_t opt) {
+    if (session.statecache)
+        PrintAndLogEx(INFO, "   %s statecache............. "_GREEN_("on"), prefShowMsg(opt));
+    else
+        PrintAndLogEx(INFO, "   %s statecache............. "_WHITE_("off"), prefShowMsg(opt));
+}
+
+static void showSessionlogState(prefShowOpt_t opt) {
+
+    switch (session.session_log) {
+        case slOFF:
+            PrintAndLogEx(INFO, "   %s sessionlog............. "_WHITE_("off"), prefShowMsg(opt));
+            break;
+        case slLINE:
+            PrintAndLogEx(INFO, "   %s sessionlog............. "_GREEN_("line"), prefShowMsg(opt));
+            break;
+        case slBATCH:
+            PrintAndLogEx(INFO, "   %s sessionlog............. "_GREEN_("batch"), prefShowMsg(opt));
+            break;
+        default:
+            PrintAndLogEx(INFO, "   %s sessionlog............. "_RED_("unknown"), prefShowMsg(opt));
+    }
+}
+
+static void showKeycacheState(prefShowOpt_t opt) {
+    if (session.keycache)
+        PrintAndLogEx(INFO, "   %s keycache............... "_GREEN_("on"), prefShowMsg(opt));
+    else
+        PrintAndLogEx(INFO, "   %s keycache............... "_WHITE_("off"), prefShowMsg(opt));
+}
+
 
 static int setCmdEmoji(const char *Cmd) {
     uint8_t cmdp = 0;
@@ -547,6 +639,56 @@ static int setCmdEmoji(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+static int setCmdSessionlog(const char *Cmd) {
+    uint8_t cmdp = 0;
+    bool errors = false;
+    bool validValue = false;
+    char strOpt[50];
+    sessionLog_t newValue = session.session_log;
+
+    if (param_getchar(Cmd, cmdp) == 0x00)
+        return usage_set_sessionlog();
+
+    while ((param_getchar(Cmd, cmdp) != 0x00) && !errors) {
+
+        if (param_getstr(Cmd, cmdp++, strOpt, sizeof(strOpt)) != 0) {
+            str_lower(strOpt); // convert to lowercase
+
+            if (strncmp(strOpt, "help", 4) == 0)
+                return usage_set_sessionlog();
+            if (strncmp(strOpt, "off", 3) == 0) {
+                validValue = true;
+                newValue = slOFF;
+            }
+            if (strncmp(strOpt, "line", 4) == 0) {
+                validValue = true;
+                newValue = slLINE;
+            }
+            if (strncmp(strOpt, "batch", 5) == 0) {
+                validValue = true;
+                newValue = slBATCH;
+            }
+
+            if (validValue) {
+                if (session.session_log != newValue) {// changed
+                    showSessionlogState(prefShowOLD);
+                    session.session_log = newValue;
+                    showSessionlogState(prefShowNEW);
+                    preferences_save();
+                } else {
+                    PrintAndLogEx(INFO, "nothing changed");
+                    showSessionlogState(prefShowNone);
+                }
+            } else {
+                PrintAndLogEx(ERR, "invalid option");
+                return usage_set_sessionlog();
+            }
+        }
+    }
+
+    return PM3_SUCCESS;
+}
+
 static int setCmdColor(const char *Cmd) {
     uint8_t cmdp = 0;
     bool errors = false;
@@ -755,6 +897,96 @@ static int setCmdHint(const char *Cmd) {
 
     return PM3_SUCCESS;
 }
+static int setCmdStatecache(const char *Cmd) {
+    uint8_t cmdp = 0;
+    bool errors = false;
+    bool validValue = false;
+    char strOpt[50];
+    bool newValue = session.statecache;
+
+    if (param_getchar(Cmd, cmdp) == 0x00)
+        return usage_set_statecache();
+
+    while ((param_getchar(Cmd, cmdp) != 0x00) && !errors) {
+
+        if (param_getstr(Cmd, cmdp++, strOpt, sizeof(strOpt)) != 0) {
+            str_lower(strOpt); // convert to lowercase
+
+            if (strncmp(strOpt, "help", 4) == 0)
+                return usage_set_statecache();
+            if (strncmp(strOpt, "off", 3) == 0) {
+                validValue = true;
+                newValue = false;
+            }
+            if (strncmp(strOpt, "on", 2) == 0) {
+                validValue = true;
+                newValue = true;
+            }
+
+            if (validValue) {
+                if (session.statecache != newValue) {// changed
+                    showStatecacheState(prefShowOLD);
+                    session.statecache = newValue;
+                    showStatecacheState(prefShowNEW);
+                    preferences_save();
+                } else {
+                    PrintAndLogEx(INFO, "nothing changed");
+                    showStatecacheState(prefShowNone);
+                }
+            } else {
+                PrintAndLogEx(ERR, "invalid option");
+                return usage_set_statecache();
+            }
+        }
+    }
+
+    return PM3_SUCCESS;
+}
+static int setCmdKeycache(const char *Cmd) {
+    uint8_t cmdp = 0;
+    bool errors = false;
+    bool validValue = false;
+    char strOpt[50];
+    bool newValue = session.keycache;
+
+    if (param_getchar(Cmd, cmdp) == 0x00)
+        return usage_set_keycache();
+
+    while ((param_getchar(Cmd, cmdp) != 0x00) && !errors) {
+
+        if (param_getstr(Cmd, cmdp++, strOpt, sizeof(strOpt)) != 0) {
+            str_lower(strOpt); // convert to lowercase
+
+            if (strncmp(strOpt, "help", 4) == 0)
+                return usage_set_keycache();
+            if (strncmp(strOpt, "off", 3) == 0) {
+                validValue = true;
+                newValue = false;
+            }
+            if (strncmp(strOpt, "on", 2) == 0) {
+                validValue = true;
+                newValue = true;
+            }
+
+            if (validValue) {
+                if (session.keycache != newValue) {// changed
+                    showKeycacheState(prefShowOLD);
+                    session.keycache = newValue;
+                    showKeycacheState(prefShowNEW);
+                    preferences_save();
+                } else {
+                    PrintAndLogEx(INFO, "nothing changed");
+                    showKeycacheState(prefShowNone);
+                }
+            } else {
+                PrintAndLogEx(ERR, "invalid option");
+                return usage_set_keycache();
+            }
+        }
+    }
+
+    return PM3_SUCCESS;
+}
 /*
 static int setCmdSavePaths (const char *Cmd) {
     uint8_t cmdp = 0;
@@ -856,6 +1088,21 @@ static int getCmdHint(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+static int getCmdStatecache(const char *Cmd) {
+    showStatecacheState(prefShowNone);
+    return PM3_SUCCESS;
+}
+
+static int getCmdKeycache(const char *Cmd) {
+    showKeycacheState(prefShowNone);
+    return PM3_SUCCESS;
+}
+
+static int getCmdSessionlog(const char *Cmd) {
+    showSessionlogState(prefShowNone);
+    return PM3_SUCCESS;
+}
+
 static int getCmdColor(const char *Cmd) {
     showColorState(prefShowNone);
     return PM3_SUCCESS;
@@ -870,6 +1117,9 @@ static command_t getCommandTable[] = {
 //     {"help",             getCmdHelp,          AlwaysAvailable, "This help"},
     {"emoji",            getCmdEmoji,         AlwaysAvailable, "Get emoji display preference"},
     {"hints",            getCmdHint,          AlwaysAvailable, "Get hint display preference"},
+    {"statecache",       getCmdStatecache,    AlwaysAvailable, "Get crapto1 state list cache preference"},
+    {"keycache",         getCmdKeycache,      AlwaysAvailable, "Get MIFARE Classic key cache preference"},
+    {"sessionlog",       getCmdSessionlog,    AlwaysAvailable, "Get session log preference"},
     {"color",            getCmdColor,         AlwaysAvailable, "Get color support preference"},
     //  {"defaultsavepaths", getCmdSavePaths,     AlwaysAvailable, "... to be adjusted next ... "},
     {"clientdebug",      getCmdDebug,         AlwaysAvailable, "Get client debug level preference"},
@@ -881,6 +1131,9 @@ static command_t setCommandTable[] = {
     {"help",             setCmdHelp,          AlwaysAvailable, "This help"},
     {"emoji",            setCmdEmoji,         AlwaysAvailable, "Set emoji display"},
     {"hints",            setCmdHint,          AlwaysAvailable, "Set hint display"},
+    {"statecache",       setCmdStatecache,    AlwaysAvailable, "Set crapto1 state list cache"},
+    {"keycache",         setCmdKeycache,      AlwaysAvailable, "Set MIFARE Classic key cache"},
+    {"sessionlog",       setCmdSessionlog,    AlwaysAvailable, "Set session log"},
     {"color",            setCmdColor,         AlwaysAvailable, "Set color support"},
     //  {"defaultsavepaths", setCmdSavePaths,     AlwaysAvailable, "... to be adjusted next ... "},
     {"clientdebug",      setCmdDebug,         AlwaysAvailable, "Set client debug level"},
@@ -919,6 +1172,9 @@ static int CmdPrefShow(const char *Cmd) {
     PrintAndLogEx(INFO, "Current settings");
     showEmojiState(prefShowNone);
     showHintsState(prefShowNone);
+    showStatecacheState(prefShowNone);
+    showKeycacheState(prefShowNone);
+    showSessionlogState(prefShowNone);
     showColorState(prefShowNone);
     // showPlotPosState ();
     // showOverlayPosState ();
@@ -21,9 +21,11 @@
 #include <math.h>
 #include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <QSlider>
 #include <QHBoxLayout>
 #include <string.h>
+#include <vector>
 #include <QtGui>
 #include "proxgui.h"
 #include "ui.h"
@@ -34,13 +36,104 @@
 
 extern "C" int preferences_save(void);
 
-static int s_Buff[MAX_GRAPH_TRACE_LEN];
+static int *s_Buff = NULL;            // overlay, as long as the graph
+static size_t s_BuffLen = 0;
 static bool g_useOverlays = false;
 static int g_absVMax = 0;
 static uint32_t startMax; // Maximum offset in the graph (right side of graph)
 static uint32_t PageWidth; // How many samples are currently visible on this 'page' / graph
 static int unlockStart = 0;
 
+// Min / max pyramid over a sample buffer, for the zoomed out plot. Level k holds
+// the min, max and sum of every full block of 2^(k+1) samples, so any range of
+// the buffer is summed up with O(log n) entries instead of a scan of its samples.
+// Rebuilt when the buffer changes, RepaintGraphWindow() bumps s_graphGeneration
+struct lod_entry_t {
+    int min;
+    int max;
+    int64_t sum;
+};
+
+class PlotLOD {
+  public:
+    void update(const int *buffer, size_t len, uint32_t generation) {
+        if (buffer == buf && len == buflen && generation == gen)
+            return;
+        buf = buffer;
+        buflen = len;
+        gen = generation;
+        levels.clear();
+        size_t n = len >> 1;
+        for (size_t k = 0; n > 0; k++, n >>= 1) {
+            levels.push_back(std::vector<lod_entry_t>(n));
+            std::vector<lod_entry_t> &cur = levels.back();
+            for (size_t i = 0; i < n; i++) {
+                if (k == 0) {
+                    int a = buffer[2 * i], b = buffer[2 * i + 1];
+                    cur[i].min = (a < b) ? a : b;
+                    cur[i].max = (a > b) ? a : b;
+                    cur[i].sum = (int64_t)a + b;
+                } else {
+                    const lod_entry_t &a = levels[k - 1][2 * i], &b = levels[k - 1][2 * i + 1];
+                    cur[i].min = (a.min < b.min) ? a.min : b.min;
+                    cur[i].max = (a.max > b.max) ? a.max : b.max;
+                    cur[i].sum = a.sum + b.sum;
+                }
+            }
+        }
+    }
+
+    // min, max and sum of the samples [from, to)
+    void range(size_t from, size_t to, int *vMin, int *vMax, int64_t *sum) const {
+        int mn = INT_MAX, mx = INT_MIN;
+        int64_t s = 0;
+        if (to > buflen) to = buflen;
+        // level 0 is the buffer itself, level k + 1 is levels[k]
+        for (size_t k = 0; from < to; k++, from >>= 1, to >>= 1) {
+            if (from & 1) {
+                take(k, from++, &mn, &mx, &s);
+            }
+            if (to & 1) {
+                take(k, --to, &mn, &mx, &s);
+            }
+        }
+        *vMin = mn;
+        *vMax = mx;
+        if (sum) *sum = s;
+    }
+
+  private:
+    const int *buf = NULL;
+    size_t buflen = 0;
+    uint32_t gen = 0;
+    std::vector<std::vector<lod_entry_t>> levels;
+
+    void take(size_t k, size_t i, int *mn, int *mx, int64_t *s) const {
+        int lo, hi;
+        if (k == 0) {
+            lo = hi = buf[i];
+            *s += lo;
+        } else {
+            const lod_entry_t &e = levels[k - 1][i];
+            lo = e.min;
+            hi = e.max;
+            *s += e.sum;
+        }
+        if (lo < *mn) *mn = lo;
+        if (hi > *mx) *mx = hi;
+    }
+};
+
+static uint32_t s_graphGeneration = 0;
+static PlotLOD s_lodGraph;
+static PlotLOD s_lodOverlay;
+
+static PlotLOD *lodOf(const int *buffer, size_t len) {
+    PlotLOD *lod = (buffer == GraphBuffer) ? &s_lodGraph : &s_lodOverlay;
+    lod->update(buffer, len, s_graphGeneration);
+    return lod;
+}
+
 void ProxGuiQT::ShowGraphWindow(void) {
     emit ShowGraphWindowSignal();
 }
@@ -69,6 +162,7 @@ void ProxGuiQT::_ShowGraphWindow(void) {
 
         plotwidget = new ProxWidget();
     }
+    s_graphGeneration++;
     plotwidget->show();
 }
 
@@ -76,6 +170,7 @@ void ProxGuiQT::_RepaintGraphWindow(void) {
     if (!plotapp || !plotwidget)
         return;
 
+    s_graphGeneration++;
     plotwidget->update();
 }
 
@@ -158,10 +253,122 @@ void SliderWidget::moveEvent(QMoveEvent *event) {
     session.window_changed = true;
 }
 
+// make the overlay as long as the graph
+static bool ReserveOverlay(void) {
+    if (s_BuffLen >= GraphTraceLen)
+        return true;
+    int *p = (int *)realloc(s_Buff, GraphTraceLen * sizeof(int));
+    if (p == NULL)
+        return false;
+    memset(p + s_BuffLen, 0, (GraphTraceLen - s_BuffLen) * sizeof(int));
+    s_Buff = p;
+    s_BuffLen = GraphTraceLen;
+    return true;
+}
+
+// -------------------------------------------------
+// Overlay operations, on a worker thread
+// -------------------------------------------------
+
+OverlayWorker::OverlayWorker(QObject *parent) : QThread(parent), stopping(false), pending(false),
+    running(false), hasResult(false), op(OP_ASKEDGE), v1(0), v2(0) {
+}
+
+OverlayWorker::~OverlayWorker() {
+    lock.lock();
+    stopping = true;
+    wake.wakeAll();
+    lock.unlock();
+    wait();
+}
+
+void OverlayWorker::request(Operation operation, int value1, int value2, const int *in, const int *out, size_t len) {
+    if (len == 0)
+        return;
+    QMutexLocker locker(&lock);
+    op = operation;
+    v1 = value1;
+    v2 = value2;
+    graph.assign(in, in + len);
+    if (out)
+        overlay.assign(out, out + len);
+    else
+        overlay.assign(len, 0);
+    pending = true;
+    hasResult = false;
+    wake.wakeAll();
+    if (isRunning() == false)
+        start();
+}
+
+bool OverlayWorker::busy(void) {
+    QMutexLocker locker(&lock);
+    return pending || running;
+}
+
+bool OverlayWorker::takeResult(std::vector<int> &out) {
+    QMutexLocker locker(&lock);
+    if (hasResult == false)
+        return false;
+    out.swap(result);
+    hasResult = false;
+    return true;
+}
+
+void OverlayWorker::run() {
+    lock.lock();
+    while (stopping == false) {
+        if (pending == false) {
+            wake.wait(&lock);
+            continue;
+        }
+        // take the request, the next slider move may queue another one meanwhile
+        Operation o = op;
+        int a = v1, b = v2;
+        std::vector<int> in, out;
+        in.swap(graph);
+        out.swap(overlay);
+        pending = false;
+        running = true;
+        lock.unlock();
+
+        int ans = PM3_SUCCESS;
+        switch (o) {
+            case OP_AUTOCORR:
+                ans = AutoCorrelate(in.data(), out.data(), in.size(), a, true, false);
+                break;
+            case OP_ASKEDGE:
+                ans = AskEdgeDetect(in.data(), out.data(), (int)in.size(), a);
+                break;
+            case OP_DIRTHRESHOLD:
+                ans = directionalThreshold(in.data(), out.data(), in.size(), a, b);
+                break;
+        }
+        if (g_debugMode) printf("overlay op %d (%d, %d): %d\n", o, a, b, ans);
+
+        lock.lock();
+        running = false;
+        // a newer request supersedes this result
+        if (pending == false && stopping == false) {
+            result.swap(out);
+            hasResult = true;
+            emit resultReady();
+        }
+    }
+    lock.unlock();
+}
+
 //--------------------
 void ProxWidget::applyOperation() {
     //printf("ApplyOperation()");
+    // apply the latest slider position, not the one on screen
+    if (overlayWorker->busy()) {
+        applyPending = true;
+        return;
+    }
     save_restoreGB(GRAPH_SAVE);
+    if (s_BuffLen < GraphTraceLen)
+        return;
     memcpy(GraphBuffer, s_Buff, sizeof(int) * GraphTraceLen);
     RepaintGraphWindow();
 }
@@ -170,31 +377,35 @@ void ProxWidget::stickOperation() {
     //printf("stickOperation()");
 }
 void ProxWidget::vchange_autocorr(int v) {
-    int ans = AutoCorrelate(GraphBuffer, s_Buff, GraphTraceLen, v, true, false);
-    if (g_debugMode) printf("vchange_autocorr(w:%d): %d\n", v, ans);
-    g_useOverlays = true;
-    RepaintGraphWindow();
+    overlayWorker->request(OverlayWorker::OP_AUTOCORR, v, 0, GraphBuffer, NULL, GraphTraceLen);
 }
 void ProxWidget::vchange_askedge(int v) {
-    //extern int AskEdgeDetect(const int *in, int *out, int len, int threshold);
-    int ans = AskEdgeDetect(GraphBuffer, s_Buff, GraphTraceLen, v);
-    if (g_debugMode) printf("vchange_askedge(w:%d)%d\n", v, ans);
-    g_useOverlays = true;
-    RepaintGraphWindow();
+    overlayWorker->request(OverlayWorker::OP_ASKEDGE, v, 0, GraphBuffer, NULL, GraphTraceLen);
 }
 void ProxWidget::vchange_dthr_up(int v) {
     int down = opsController->horizontalSlider_dirthr_down->value();
-    directionalThreshold(GraphBuffer, s_Buff, GraphTraceLen, v, down);
-    //printf("vchange_dthr_up(%d)", v);
-    g_useOverlays = true;
-    RepaintGraphWindow();
+    // the threshold starts from the overlay there is
+    overlayWorker->request(OverlayWorker::OP_DIRTHRESHOLD, v, down, GraphBuffer, (s_BuffLen >= GraphTraceLen) ? s_Buff : NULL, GraphTraceLen);
 }
 void ProxWidget::vchange_dthr_down(int v) {
-    //printf("vchange_dthr_down(%d)", v);
     int up = opsController->horizontalSlider_dirthr_up->value();
-    directionalThreshold(GraphBuffer, s_Buff, GraphTraceLen, v, up);
+    overlayWorker->request(OverlayWorker::OP_DIRTHRESHOLD, v, up, GraphBuffer, (s_BuffLen >= GraphTraceLen) ? s_Buff : NULL, GraphTraceLen);
+}
+// the worker finished the latest request, show it
+void ProxWidget::overlayReady(void) {
+    std::vector<int> out;
+    if (overlayWorker->takeResult(out) == false)
+        return;
+    // the graph may have changed length in the meantime
+    if (out.size() < GraphTraceLen || !ReserveOverlay())
+        return;
+    memcpy(s_Buff, out.data(), sizeof(int) * GraphTraceLen);
     g_useOverlays = true;
     RepaintGraphWindow();
+    if (applyPending && overlayWorker->busy() == false) {
+        applyPending = false;
+        applyOperation();
+    }
 }
 ProxWidget::ProxWidget(QWidget *parent, ProxGuiQT *master) : QWidget(parent) {
     this->master = master;
@@ -218,6 +429,10 @@ ProxWidget::ProxWidget(QWidget *parent, ProxGuiQT *master) : QWidget(parent) {
     opsController->horizontalSlider_askedge->setValue(25);
     opsController->horizontalSlider_window->setValue(4000);
 
+    overlayWorker = new OverlayWorker();
+    applyPending = false;
+    QObject::connect(overlayWorker, SIGNAL(resultReady()), this, SLOT(overlayReady()));
+
     QObject::connect(opsController->pushButton_apply, SIGNAL(clicked()), this, SLOT(applyOperation()));
     QObject::connect(opsController->pushButton_sticky, SIGNAL(clicked()), this, SLOT(stickOperation()));
     QObject::connect(opsController->horizontalSlider_window, SIGNAL(valueChanged(int)), this, SLOT(vchange_autocorr(int)));
@@ -272,6 +487,11 @@ ProxWidget::~ProxWidget(void) {
         opsController = NULL;
     }
 
+    if (overlayWorker) {
+        delete overlayWorker;
+        overlayWorker = NULL;
+    }
+
     if (plot) {
         plot->close();
         delete plot;
@@ -309,6 +529,15 @@ int Plot::xCoordOf(int i, QRect r) {
     return r.left() + (int)((i - GraphStart) * GraphPixelsPerPoint);
 }
 
+// first sample from GraphStart on at px pixels or more right of the plot left side
+uint32_t Plot::sampleAtX(int px) {
+    if (px <= 0) return GraphStart;
+    int k = (int)ceil(px / GraphPixelsPerPoint);
+    while (k > 0 && (int)((k - 1) * GraphPixelsPerPoint) >= px) k--;
+    while ((int)(k * GraphPixelsPerPoint) < px) k++;
+    return GraphStart + k;
+}
+
 int Plot::yCoordOf(int v, QRect r, int maxVal) {
     int z = (r.bottom() - r.top()) / 2;
     if (maxVal == 0) ++maxVal;
@@ -350,14 +579,10 @@ void Plot::setMaxAndStart(int *buffer, size_t len, QRect plotRect) {
         GraphStart = startMax;
     }
     if (GraphStart > len) return;
-    int vMin = INT_MAX, vMax = INT_MIN;
-    uint32_t sample_index = GraphStart ;
-    for (; sample_index < len && xCoordOf(sample_index, plotRect) < plotRect.right() ; sample_index++) {
-
-        int v = buffer[sample_index];
-        if (v < vMin) vMin = v;
-        if (v > vMax) vMax = v;
-    }
+    int vMin, vMax;
+    uint32_t end = sampleAtX(plotRect.right() - plotRect.left());
+    if (end > len) end = len;
+    lodOf(buffer, len)->range(GraphStart, end, &vMin, &vMax, NULL);
 
     g_absVMax = 0;
     if (fabs((double) vMin) > g_absVMax) g_absVMax = (int)fabs((double) vMin);
@@ -393,7 +618,24 @@ void Plot::PlotDemod(uint8_t *buffer, size_t len, QRect plotRect, QRect annotati
     penPath.moveTo(x, y);
     delta_x = 0;
     int clk = first_delta_x;
+    uint32_t end = sampleAtX(plotRect.right() - plotRect.left());
     for (int i = BitStart; i < (int)len && xCoordOf(delta_x + DemodStart, plotRect) < plotRect.right(); i++) {
+        if (GraphPixelsPerPoint < 1) {
+            // zoomed out, a bit is a flat line from its first to its last visible sample
+            int last = clk;
+            if (DemodStart + delta_x + last > (int)end) last = (int)end - DemodStart - delta_x;
+            y = yCoordOf(buffer[i] * 200 - 100, plotRect, absVMax);
+            penPath.lineTo(xCoordOf(DemodStart + delta_x, plotRect), y);
+            penPath.lineTo(xCoordOf(DemodStart + delta_x + last - 1, plotRect), y);
+            // label only the bits wide enough for it
+            if (clk * GraphPixelsPerPoint >= 16 && clk / 2 < last) {
+                sprintf(str, "%u", buffer[i]);
+                painter->drawText(xCoordOf(DemodStart + delta_x + clk / 2, plotRect) - 8, y + ((buffer[i] > 0) ? 18 : -6), str);
+            }
+            delta_x += clk;
+            clk = grid_delta_x;
+            continue;
+        }
         for (int j = 0; j < (clk) && i < (int)len && xCoordOf(DemodStart + delta_x + j, plotRect) < plotRect.right() ; j++) {
             x = xCoordOf(DemodStart + delta_x + j, plotRect);
             int v = buffer[i] * 200 - 100;
@@ -429,25 +671,52 @@ void Plot::PlotGraph(int *buffer, size_t len, QRect plotRect, QRect annotationRe
     int x = xCoordOf(GraphStart, plotRect);
     int y = yCoordOf(buffer[GraphStart], plotRect, g_absVMax);
     penPath.moveTo(x, y);
-    for (i = GraphStart; i < len && xCoordOf(i, plotRect) < plotRect.right(); i++) {
+    if (GraphPixelsPerPoint < 1) {
+        // more samples than pixels, one min to max segment per pixel column
+        PlotLOD *lod = lodOf(buffer, len);
+        int width = plotRect.right() - plotRect.left();
+        uint32_t end = sampleAtX(width);
+        if (end > len) end = len;
+        uint32_t from = GraphStart;
+        for (int px = 0; px < width && from < end; px++) {
+            uint32_t to = sampleAtX(px + 1);
+            if (to > end) to = end;
+            if (to <= from) continue;
+            int cMin, cMax;
+            lod->range(from, to, &cMin, &cMax, NULL);
+            x = plotRect.left() + px;
+            penPath.lineTo(x, yCoordOf(buffer[from], plotRect, g_absVMax));
+            penPath.lineTo(x, yCoordOf(cMax, plotRect, g_absVMax));
+            penPath.lineTo(x, yCoordOf(cMin, plotRect, g_absVMax));
+            penPath.lineTo(x, yCoordOf(buffer[to - 1], plotRect, g_absVMax));
+            from = to;
+        }
+        int64_t sum = 0;
+        lod->range(GraphStart, end, &vMin, &vMax, &sum);
+        i = end;
+        if (end > GraphStart)
+            vMean = (int)(sum / (end - GraphStart));
+    } else {
+        for (i = GraphStart; i < len && xCoordOf(i, plotRect) < plotRect.right(); i++) {
 
-        x = xCoordOf(i, plotRect);
-        v = buffer[i];
+            x = xCoordOf(i, plotRect);
+            v = buffer[i];
 
-        y = yCoordOf(v, plotRect, g_absVMax);
+            y = yCoordOf(v, plotRect, g_absVMax);
 
-        penPath.lineTo(x, y);
+            penPath.lineTo(x, y);
 
-        if (GraphPixelsPerPoint > 10) {
-            QRect f(QPoint(x - 3, y - 3), QPoint(x + 3, y + 3));
-            painter->fillRect(f, QColor(100, 255, 100));
+            if (GraphPixelsPerPoint > 10) {
+                QRect f(QPoint(x - 3, y - 3), QPoint(x + 3, y + 3));
+                painter->fillRect(f, QColor(100, 255, 100));
+            }
+            // catch stats
+            if (v < vMin) vMin = v;
+            if (v > vMax) vMax = v;
+            vMean += v;
         }
-        // catch stats
-        if (v < vMin) vMin = v;
-        if (v > vMax) vMax = v;
-        vMean += v;
+        vMean /= (i - GraphStart);
     }
-    vMean /= (i - GraphStart);
 
     painter->setPen(getColor(graphNum));
 
@@ -569,7 +838,7 @@ void Plot::paintEvent(QPaintEvent *event) {
     if (showDemod && DemodBufferLen > 8) {
         PlotDemod(DemodBuffer, DemodBufferLen, plotRect, infoRect, &painter, 2, g_DemodStartIdx);
     }
-    if (g_useOverlays) {
+    if (g_useOverlays && s_BuffLen >= GraphTraceLen) {
         //init graph variables
         setMaxAndStart(s_Buff, GraphTraceLen, plotRect);
         PlotGraph(s_Buff, GraphTraceLen, plotRect, infoRect, &painter, 1);
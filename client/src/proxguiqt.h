@@ -19,7 +19,11 @@
 #include <QObject>
 #include <QWidget>
 #include <QPainter>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
 #include <QtGui>
+#include <vector>
 
 #include "ui/ui_overlays.h"
 
@@ -39,6 +43,7 @@ class Plot: public QWidget {
     void PlotDemod(uint8_t *buffer, size_t len, QRect plotRect, QRect annotationRect, QPainter *painter, int graphNum, uint32_t plotOffset);
     void plotGridLines(QPainter *painter, QRect r);
     int xCoordOf(int i, QRect r);
+    uint32_t sampleAtX(int px);
     int yCoordOf(int v, QRect r, int maxVal);
     int valueOf_yCoord(int y, QRect r, int maxVal);
     void setMaxAndStart(int *buffer, size_t len, QRect plotRect);
@@ -65,6 +70,45 @@ class SliderWidget : public QWidget {
     SliderWidget();
 };
 
+/**
+ * Runs the overlay operations of the sliders off the UI thread on a copy of
+ * the graph. A new request supersedes the one running, whose result is dropped,
+ * so only the latest slider position gets published with resultReady()
+ */
+class OverlayWorker : public QThread {
+    Q_OBJECT;
+
+  public:
+    enum Operation { OP_AUTOCORR, OP_ASKEDGE, OP_DIRTHRESHOLD };
+
+    OverlayWorker(QObject *parent = 0);
+    ~OverlayWorker();
+    // graph and overlay are copied, overlay may be NULL
+    void request(Operation op, int v1, int v2, const int *graph, const int *overlay, size_t len);
+    // a request is waiting or running
+    bool busy(void);
+    // moves the latest result to out, false if there is none
+    bool takeResult(std::vector<int> &out);
+    void run();
+
+  signals:
+    void resultReady(void);
+
+  private:
+    QMutex lock;
+    QWaitCondition wake;
+    bool stopping;
+    bool pending;
+    bool running;
+    bool hasResult;
+    Operation op;
+    int v1;
+    int v2;
+    std::vector<int> graph;
+    std::vector<int> overlay;
+    std::vector<int> result;
+};
+
 /**
  * The window with plot and controls
  */
@@ -78,6 +122,8 @@ class ProxWidget : public QWidget {
     Ui::Form *opsController;
 //    QWidget *controlWidget;
     SliderWidget *controlWidget;
+    OverlayWorker *overlayWorker;
+    bool applyPending;
   public:
     ProxWidget(QWidget *parent = 0, ProxGuiQT *master = NULL);
     ~ProxWidget(void);
@@ -100,6 +146,7 @@ class ProxWidget : public QWidget {
     void vchange_askedge(int v);
     void vchange_dthr_up(int v);
     void vchange_dthr_down(int v);
+    void overlayReady(void);
 };
 
 class WorkerThread : public QThread {
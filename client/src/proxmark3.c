@@ -33,6 +33,7 @@
 #include "fileutils.h"
 #include "flash.h"
 #include "preferences.h"
+#include "pm3daemon.h"
 
 #define BANNERMSG1 ""
 #define BANNERMSG2 "  :snowflake: bleeding edge :coffee:"
@@ -166,6 +167,54 @@ static void terminate_handler(int signum) {
 }
 #endif
 
+// tab completion of the word under the cursor, from the command index
+static char completion_prefix[512];
+static size_t completion_prefix_len;
+static size_t completion_word;
+
+static char *command_generator(const char *text, int state) {
+    (void)text;
+    static size_t idx;
+    size_t count;
+    const command_index_t *cmds = CmdsIndex(&count);
+
+    if (state == 0)
+        idx = CmdsIndexFind(completion_prefix);
+
+    while (idx < count) {
+        const command_index_t *c = &cmds[idx++];
+        if (strncmp(c->path, completion_prefix, completion_prefix_len) != 0)
+            break;
+        // only the next level
+        const char *name = c->path + completion_word;
+        if (strchr(name, ' ') || c->IsAvailable() == false)
+            continue;
+        return strdup(name);
+    }
+    return NULL;
+}
+
+static char **command_completion(const char *text, int start, int end) {
+    (void)end;
+    rl_attempted_completion_over = 1;
+
+    // the words before the cursor word, with single spaces, then the partial word
+    size_t n = 0;
+    for (int i = 0; i < start && n < sizeof(completion_prefix) - 1; i++) {
+        char c = tolower(rl_line_buffer[i]);
+        if (c == ' ' && (n == 0 || completion_prefix[n - 1] == ' '))
+            continue;
+        completion_prefix[n++] = c;
+    }
+    completion_word = n;
+    for (const char *t = text; *t && n < sizeof(completion_prefix) - 1; t++)
+        completion_prefix[n++] = tolower(*t);
+    completion_prefix[n] = '\0';
+    completion_prefix_len = n;
+
+    return rl_completion_matches(text, command_generator);
+}
+
 #endif
 
 // first slot is always NULL, indicating absence of script when idx=0
@@ -543,11 +592,78 @@ static void set_my_user_directory(void) {
     }
 }
 
+#define POOL_MAX_DEVICES   32
+
+// --pool, -c/-l goes to every daemon, the lines of -s are shared between them
+static int pool_main(char *paths, const char *script_cmd, const char *script_cmds_file, bool lua) {
+
+    char *devices[POOL_MAX_DEVICES];
+    int ndevices = 0;
+    for (char *tok = strtok(paths, ","); tok != NULL; tok = strtok(NULL, ",")) {
+        if (ndevices == POOL_MAX_DEVICES) {
+            PrintAndLogEx(ERR, "too many devices, max %d", POOL_MAX_DEVICES);
+            return PM3_EINVARG;
+        }
+        devices[ndevices++] = tok;
+    }
+
+    if (script_cmd) {
+        char request[1024] = {0};
+        snprintf(request, sizeof(request), "%s%s", lua ? "script run " : "", script_cmd);
+        char *jobs[] = { request };
+        return pm3_daemon_pool(devices, ndevices, jobs, 1, true);
+    }
+
+    char *path;
+    if (searchFile(&path, CMD_SCRIPTS_SUBDIR, script_cmds_file, ".cmd", false) != PM3_SUCCESS)
+        return PM3_EFILE;
+
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        PrintAndLogEx(ERR, "could not open " _YELLOW_("%s") "...", path);
+        free(path);
+        return PM3_EFILE;
+    }
+    free(path);
+
+    char **jobs = NULL;
+    int njobs = 0;
+    char line[1024];
+    int res = PM3_SUCCESS;
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#')
+            continue;
+
+        char **tmp = realloc(jobs, (njobs + 1) * sizeof(char *));
+        if (tmp == NULL) {
+            res = PM3_EMALLOC;
+            break;
+        }
+        jobs = tmp;
+        jobs[njobs] = str_dup(line);
+        if (jobs[njobs] == NULL) {
+            res = PM3_EMALLOC;
+            break;
+        }
+        njobs++;
+    }
+    fclose(f);
+
+    if (res == PM3_SUCCESS)
+        res = pm3_daemon_pool(devices, ndevices, jobs, njobs, false);
+
+    for (int i = 0; i < njobs; i++)
+        free(jobs[i]);
+    free(jobs);
+    return res;
+}
+
 static void show_help(bool showFullHelp, char *exec_name) {
 
     PrintAndLogEx(NORMAL, "\nsyntax: %s [-h|-t|-m]", exec_name);
     PrintAndLogEx(NORMAL, "        %s [[-p] <port>] [-b] [-w] [-f] [-c <command>]|[-l <lua_script_file>]|[-s <cmd_script_file>] [-i] [-d <0|1|2>]", exec_name);
-    PrintAndLogEx(NORMAL, "        %s [-p] <port> --flash [--unlock-bootloader] [--image <imagefile>]+ [-w] [-f] [-d <0|1|2>]", exec_name);
+    PrintAndLogEx(NORMAL, "        %s [-p] <port> --flash [--unlock-bootloader] [--force] [--image <imagefile>]+ [-w] [-f] [-d <0|1|2>]", exec_name);
 
     if (showFullHelp) {
 
@@ -566,9 +682,13 @@ static void show_help(bool showFullHelp, char *exec_name) {
         PrintAndLogEx(NORMAL, "      -l/--lua <lua script file>          execute lua script.");
         PrintAndLogEx(NORMAL, "      -s/--script-file <cmd_script_file>  script file with one Proxmark3 command per line");
         PrintAndLogEx(NORMAL, "      -i/--interactive                    enter interactive mode after executing the script or the command");
+        PrintAndLogEx(NORMAL, "      --daemon <socket>                   keep the connection and run the commands sent with --connect");
+        PrintAndLogEx(NORMAL, "      --connect <socket>                  run -c or -l in the daemon listening on socket");
+        PrintAndLogEx(NORMAL, "      --pool <socket>[,<socket>...]       run -c or -l on all the daemons, or share the lines of -s between them");
         PrintAndLogEx(NORMAL, "\nOptions in flasher mode:");
         PrintAndLogEx(NORMAL, "      --flash                             flash Proxmark3, requires at least one --image");
         PrintAndLogEx(NORMAL, "      --unlock-bootloader                 Enable flashing of bootloader area *DANGEROUS* (need --flash or --flash-info)");
+        PrintAndLogEx(NORMAL, "      --force                             write every block, also the ones the bootloader reports unchanged");
         PrintAndLogEx(NORMAL, "      --image <imagefile>                 image to flash. Can be specified several times.");
         PrintAndLogEx(NORMAL, "\nExamples:");
         PrintAndLogEx(NORMAL, "\n  to run Proxmark3 client:\n");
@@ -580,6 +700,13 @@ static void show_help(bool showFullHelp, char *exec_name) {
         PrintAndLogEx(NORMAL, "      %s "SERIAL_PORT_EXAMPLE_H" -c \"hf mf chk 1* ?\"   -- execute cmd and quit client", exec_name);
         PrintAndLogEx(NORMAL, "      %s "SERIAL_PORT_EXAMPLE_H" -l hf_read            -- execute lua script " _YELLOW_("`hf_read`")" and quit client", exec_name);
         PrintAndLogEx(NORMAL, "      %s "SERIAL_PORT_EXAMPLE_H" -s mycmds.txt         -- execute each pm3 cmd in file and quit client", exec_name);
+        PrintAndLogEx(NORMAL, "\n  to serve many short runs from one connection:\n");
+        PrintAndLogEx(NORMAL, "      %s "SERIAL_PORT_EXAMPLE_H" --daemon /tmp/pm3.sock &", exec_name);
+        PrintAndLogEx(NORMAL, "      %s --connect /tmp/pm3.sock -c \"hw version\"", exec_name);
+        PrintAndLogEx(NORMAL, "      %s --connect /tmp/pm3.sock -c quit       -- stops the daemon", exec_name);
+        PrintAndLogEx(NORMAL, "\n  to drive several devices, one daemon each:\n");
+        PrintAndLogEx(NORMAL, "      %s --pool /tmp/pm3a.sock,/tmp/pm3b.sock -c \"hw version\"   -- on every device", exec_name);
+        PrintAndLogEx(NORMAL, "      %s --pool /tmp/pm3a.sock,/tmp/pm3b.sock -s jobs.cmd         -- each line on the next free device", exec_name);
         PrintAndLogEx(NORMAL, "\n  to flash fullimage and bootloader:\n");
         PrintAndLogEx(NORMAL, "      %s "SERIAL_PORT_EXAMPLE_H" --flash --unlock-bootloader --image bootrom.elf --image fullimage.elf", exec_name);
 #ifdef __linux__
@@ -594,7 +721,7 @@ static void show_help(bool showFullHelp, char *exec_name) {
     }
 }
 
-static int flash_pm3(char *serial_port_name, uint8_t num_files, char *filenames[FLASH_MAX_FILES], bool can_write_bl) {
+static int flash_pm3(char *serial_port_name, uint8_t num_files, char *filenames[FLASH_MAX_FILES], bool can_write_bl, bool force) {
 
     int ret = PM3_EUNDEF;
     flash_file_t files[FLASH_MAX_FILES];
@@ -655,7 +782,7 @@ static int flash_pm3(char *serial_port_name, uint8_t num_files, char *filenames[
     PrintAndLogEx(SUCCESS, _CYAN_("Flashing..."));
 
     for (int i = 0; i < num_files; i++) {
-        ret = flash_write(&files[i]);
+        ret = flash_write(&files[i], force);
         if (ret != PM3_SUCCESS) {
             goto finish;
         }
@@ -705,11 +832,15 @@ int main(int argc, char *argv[]) {
     char *script_cmds_file = NULL;
     char *script_cmd = NULL;
     char *port = NULL;
+    char *daemon_path = NULL;
+    char *connect_path = NULL;
+    char *pool_paths = NULL;
     uint32_t speed = 0;
 
 #ifdef HAVE_READLINE
     /* initialize history */
     using_history();
+    rl_attempted_completion_function = command_completion;
 
 #ifdef RL_STATE_READCMD
     rl_extend_line_buffer(1024);
@@ -728,6 +859,7 @@ int main(int argc, char *argv[]) {
 
     bool flash_mode = false;
     bool flash_can_write_bl = false;
+    bool flash_force = false;
     bool debug_mode_forced = false;
     int flash_num_files = 0;
     char *flash_filenames[FLASH_MAX_FILES];
@@ -904,6 +1036,39 @@ int main(int argc, char *argv[]) {
             continue;
         }
 
+        // keep the device connection and serve -c invocations on a socket
+        if (strcmp(argv[i], "--daemon") == 0) {
+            if (i + 1 == argc) {
+                PrintAndLogEx(ERR, _RED_("ERROR:") " missing socket specification after --daemon\n");
+                show_help(false, exec_name);
+                return 1;
+            }
+            daemon_path = argv[++i];
+            continue;
+        }
+
+        // send -c to a daemon instead of opening the device
+        if (strcmp(argv[i], "--connect") == 0) {
+            if (i + 1 == argc) {
+                PrintAndLogEx(ERR, _RED_("ERROR:") " missing socket specification after --connect\n");
+                show_help(false, exec_name);
+                return 1;
+            }
+            connect_path = argv[++i];
+            continue;
+        }
+
+        // several daemons, one per device
+        if (strcmp(argv[i], "--pool") == 0) {
+            if (i + 1 == argc) {
+                PrintAndLogEx(ERR, _RED_("ERROR:") " missing socket specification after --pool\n");
+                show_help(false, exec_name);
+                return 1;
+            }
+            pool_paths = argv[++i];
+            continue;
+        }
+
         // go to flash mode
         if (strcmp(argv[i], "--flash") == 0) {
             flash_mode = true;
@@ -916,6 +1081,12 @@ int main(int argc, char *argv[]) {
             continue;
         }
 
+        // write all blocks, no checksum compare
+        if (strcmp(argv[i], "--force") == 0) {
+            flash_force = true;
+            continue;
+        }
+
         // flash file
         if (strcmp(argv[i], "--image") == 0) {
             if (flash_num_files == FLASH_MAX_FILES) {
@@ -937,6 +1108,25 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    // the daemon has the device and the settings, nothing to set up here
+    if (connect_path) {
+        if (script_cmd == NULL || port != NULL || script_cmds_file != NULL) {
+            PrintAndLogEx(ERR, _RED_("ERROR:") " --connect takes -c or -l, and no port\n");
+            return 1;
+        }
+        char request[1024] = {0};
+        snprintf(request, sizeof(request), "%s%s", addLuaExec ? "script run " : "", script_cmd);
+        return (pm3_daemon_request(connect_path, request) == PM3_EIO) ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    if (pool_paths) {
+        if ((script_cmd == NULL) == (script_cmds_file == NULL) || port != NULL) {
+            PrintAndLogEx(ERR, _RED_("ERROR:") " --pool takes -c, -l or -s, and no port\n");
+            return 1;
+        }
+        return (pool_main(pool_paths, script_cmd, script_cmds_file, addLuaExec) == PM3_SUCCESS) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     // Load Settings and assign
     // This will allow the command line to override the settings.json values
     preferences_load();
@@ -957,7 +1147,7 @@ int main(int argc, char *argv[]) {
         speed = USART_BAUD_RATE;
 
     if (flash_mode) {
-        flash_pm3(port, flash_num_files, flash_filenames, flash_can_write_bl);
+        flash_pm3(port, flash_num_files, flash_filenames, flash_can_write_bl, flash_force);
         exit(EXIT_SUCCESS);
     }
 
@@ -1027,25 +1217,36 @@ int main(int argc, char *argv[]) {
     }
     */
 
-#ifdef HAVE_GUI
+    if (daemon_path) {
+        int res = pm3_daemon_serve(daemon_path);
+        if (session.pm3_present)
+            CloseProxmark();
+        exit((res == PM3_SUCCESS) ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
 
+    // one shot -c / -s / -l runs quit before anything could be plotted, keep Qt out of them
+    if ((script_cmd || script_cmds_file) && stayInCommandLoop == false) {
+        main_loop(script_cmds_file, script_cmd, stayInCommandLoop);
+    } else {
+#ifdef HAVE_GUI
 #  if defined(_WIN32)
-    InitGraphics(argc, argv, script_cmds_file, script_cmd, stayInCommandLoop);
-    MainGraphics();
-#  else
-    // for *nix distro's,  check enviroment variable to verify a display
-    char *display = getenv("DISPLAY");
-    if (display && strlen(display) > 1) {
         InitGraphics(argc, argv, script_cmds_file, script_cmd, stayInCommandLoop);
         MainGraphics();
-    } else {
-        main_loop(script_cmds_file, script_cmd, stayInCommandLoop);
-    }
+#  else
+        // for *nix distro's,  check enviroment variable to verify a display
+        char *display = getenv("DISPLAY");
+        if (display && strlen(display) > 1) {
+            InitGraphics(argc, argv, script_cmds_file, script_cmd, stayInCommandLoop);
+            MainGraphics();
+        } else {
+            main_loop(script_cmds_file, script_cmd, stayInCommandLoop);
+        }
 #  endif
 
 #else
-    main_loop(script_cmds_file, script_cmd, stayInCommandLoop);
+        main_loop(script_cmds_file, script_cmd, stayInCommandLoop);
 #endif
+    }
 
     // Clean up the port
     if (session.pm3_present) {
@@ -36,6 +36,7 @@
 #include "fileutils.h"    // searchfile
 #include "cmdlf.h"        // lf_config
 #include "generator.h"
+#include "cliparser.h"    // preset args
 
 static int returnToLuaWithError(lua_State *L, const char *fmt, ...) {
     char buffer[200];
@@ -84,6 +85,274 @@ static int l_fast_push_mode(lua_State *L) {
     return 1;
 }
 
+/*
+ * Binary buffers for the scripts. A pm3.buffer userdata holds the payload of a command or of
+ * a reply, so bulk scripts send and receive without hex strings or a new lua string per packet
+ *
+ *  local b = core.buffer('3000')           -- or core.buffer() for an empty one
+ *  core.SendCommandNG(cmd, b)              -- any data param takes a buffer instead of hex
+ *  core.WaitForResponseTimeout(cmd, ms, b) -- fills b, returns true
+ *  local seq = core.SendCommandNGAsync(cmd, b)
+ *  core.poll_response(seq, b)              -- true once the reply is in b, never blocks
+ *  core.WaitForResponseSeq(seq, ms, b)
+ *
+ *  b:sethex(hex)  b:set(bin)  b:setbyte(i, v)  b:clear()
+ *  b:byte(i [, j])  b:uint(i, n)  b:get([i [, j]])  b:hex([i [, j]])  #b
+ *  b:cmd()  b:status()  b:arg(0..2)           -- of the last reply
+ */
+#define LUA_PM3_BUFFER "pm3.buffer"
+
+typedef struct {
+    uint16_t cmd;
+    int16_t status;
+    uint64_t oldarg[3];
+    uint16_t len;
+    uint8_t data[PM3_CMD_DATA_SIZE];
+} lua_pm3_buffer_t;
+
+static lua_pm3_buffer_t *check_buffer(lua_State *L, int idx) {
+    return (lua_pm3_buffer_t *)luaL_checkudata(L, idx, LUA_PM3_BUFFER);
+}
+
+static int hex_nibble(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// spaces allowed between digits. false on a bad digit, an odd count or too many bytes
+static bool buffer_sethex(lua_pm3_buffer_t *b, const char *hex, size_t size) {
+    uint16_t n = 0;
+    int hi = -1;
+    for (size_t i = 0; i < size; i++) {
+        if (hex[i] == ' ')
+            continue;
+
+        int v = hex_nibble(hex[i]);
+        if (v < 0)
+            return false;
+
+        if (hi < 0) {
+            hi = v;
+            continue;
+        }
+        if (n == PM3_CMD_DATA_SIZE)
+            return false;
+
+        b->data[n++] = (hi << 4) | v;
+        hi = -1;
+    }
+    if (hi >= 0)
+        return false;
+
+    b->len = n;
+    return true;
+}
+
+static void buffer_setreply(lua_pm3_buffer_t *b, PacketResponseNG *resp) {
+    b->cmd = resp->cmd;
+    b->status = resp->status;
+    memcpy(b->oldarg, resp->oldarg, sizeof(b->oldarg));
+    b->len = MIN(resp->length, PM3_CMD_DATA_SIZE);
+    memcpy(b->data, resp->data.asBytes, b->len);
+}
+
+// 1 based inclusive range, negative from the end, like string.sub
+static void buffer_range(lua_State *L, lua_pm3_buffer_t *b, int idx, int *from, int *to) {
+    int i = luaL_optint(L, idx, 1);
+    int j = luaL_optint(L, idx + 1, b->len);
+    if (i < 0) i += b->len + 1;
+    if (j < 0) j += b->len + 1;
+    if (i < 1) i = 1;
+    if (j > b->len) j = b->len;
+    *from = i - 1;
+    *to = j;
+}
+
+static int l_buffer_new(lua_State *L) {
+    size_t size = 0;
+    const char *hex = luaL_optlstring(L, 1, NULL, &size);
+
+    lua_pm3_buffer_t *b = (lua_pm3_buffer_t *)lua_newuserdata(L, sizeof(lua_pm3_buffer_t));
+    memset(b, 0, offsetof(lua_pm3_buffer_t, data));
+    luaL_setmetatable(L, LUA_PM3_BUFFER);
+
+    if (hex && buffer_sethex(b, hex, size) == false)
+        return returnToLuaWithError(L, "Invalid hex string or more than %d bytes", PM3_CMD_DATA_SIZE);
+    return 1;
+}
+
+static int l_buffer_len(lua_State *L) {
+    lua_pushinteger(L, check_buffer(L, 1)->len);
+    return 1;
+}
+
+static int l_buffer_clear(lua_State *L) {
+    check_buffer(L, 1)->len = 0;
+    lua_settop(L, 1);
+    return 1;
+}
+
+static int l_buffer_sethex(lua_State *L) {
+    lua_pm3_buffer_t *b = check_buffer(L, 1);
+    size_t size;
+    const char *hex = luaL_checklstring(L, 2, &size);
+    if (buffer_sethex(b, hex, size) == false)
+        return luaL_error(L, "Invalid hex string or more than %d bytes", PM3_CMD_DATA_SIZE);
+    lua_settop(L, 1);
+    return 1;
+}
+
+static int l_buffer_set(lua_State *L) {
+    lua_pm3_buffer_t *b = check_buffer(L, 1);
+    size_t size;
+    const char *bin = luaL_checklstring(L, 2, &size);
+    luaL_argcheck(L, size <= PM3_CMD_DATA_SIZE, 2, "too many bytes");
+    memcpy(b->data, bin, size);
+    b->len = size;
+    lua_settop(L, 1);
+    return 1;
+}
+
+static int l_buffer_setbyte(lua_State *L) {
+    lua_pm3_buffer_t *b = check_buffer(L, 1);
+    int i = luaL_checkint(L, 2);
+    luaL_argcheck(L, i >= 1 && i <= PM3_CMD_DATA_SIZE, 2, "out of range");
+    // growing the buffer zeroes the gap
+    if (i > b->len) {
+        memset(b->data + b->len, 0, i - b->len);
+        b->len = i;
+    }
+    b->data[i - 1] = luaL_checkint(L, 3) & 0xFF;
+    lua_settop(L, 1);
+    return 1;
+}
+
+static int l_buffer_byte(lua_State *L) {
+    lua_pm3_buffer_t *b = check_buffer(L, 1);
+    int i = luaL_optint(L, 2, 1);
+    lua_settop(L, 3);
+    if (lua_isnil(L, 3)) {
+        lua_pushinteger(L, i);
+        lua_replace(L, 3);
+    }
+    int from, to;
+    buffer_range(L, b, 2, &from, &to);
+    if (from >= to)
+        return 0;
+    luaL_checkstack(L, to - from, "too many results");
+    for (int k = from; k < to; k++)
+        lua_pushinteger(L, b->data[k]);
+    return to - from;
+}
+
+// little endian, n bytes from i
+static int l_buffer_uint(lua_State *L) {
+    lua_pm3_buffer_t *b = check_buffer(L, 1);
+    int i = luaL_checkint(L, 2);
+    int n = luaL_optint(L, 3, 4);
+    luaL_argcheck(L, n >= 1 && n <= 4, 3, "1 to 4 bytes");
+    luaL_argcheck(L, i >= 1 && i + n - 1 <= b->len, 2, "out of range");
+    uint32_t v = 0;
+    for (int k = n - 1; k >= 0; k--)
+        v = (v << 8) | b->data[i - 1 + k];
+    lua_pushunsigned(L, v);
+    return 1;
+}
+
+static int l_buffer_get(lua_State *L) {
+    lua_pm3_buffer_t *b = check_buffer(L, 1);
+    int from, to;
+    buffer_range(L, b, 2, &from, &to);
+    lua_pushlstring(L, (const char *)b->data + from, (from < to) ? to - from : 0);
+    return 1;
+}
+
+static int l_buffer_hex(lua_State *L) {
+    lua_pm3_buffer_t *b = check_buffer(L, 1);
+    int from, to;
+    buffer_range(L, b, 2, &from, &to);
+    char hex[PM3_CMD_DATA_SIZE * 2];
+    int n = 0;
+    for (int k = from; k < to; k++) {
+        hex[n++] = "0123456789ABCDEF"[b->data[k] >> 4];
+        hex[n++] = "0123456789ABCDEF"[b->data[k] & 0x0F];
+    }
+    lua_pushlstring(L, hex, n);
+    return 1;
+}
+
+static int l_buffer_cmd(lua_State *L) {
+    lua_pushunsigned(L, check_buffer(L, 1)->cmd);
+    return 1;
+}
+
+static int l_buffer_status(lua_State *L) {
+    lua_pushinteger(L, check_buffer(L, 1)->status);
+    return 1;
+}
+
+static int l_buffer_arg(lua_State *L) {
+    lua_pm3_buffer_t *b = check_buffer(L, 1);
+    int i = luaL_checkint(L, 2);
+    luaL_argcheck(L, i >= 0 && i <= 2, 2, "0 to 2");
+    lua_pushnumber(L, (lua_Number)b->oldarg[i]);
+    return 1;
+}
+
+static void set_pm3_buffer(lua_State *L) {
+    static const luaL_Reg methods[] = {
+        {"len",      l_buffer_len},
+        {"clear",    l_buffer_clear},
+        {"sethex",   l_buffer_sethex},
+        {"set",      l_buffer_set},
+        {"setbyte",  l_buffer_setbyte},
+        {"byte",     l_buffer_byte},
+        {"uint",     l_buffer_uint},
+        {"get",      l_buffer_get},
+        {"hex",      l_buffer_hex},
+        {"cmd",      l_buffer_cmd},
+        {"status",   l_buffer_status},
+        {"arg",      l_buffer_arg},
+        {NULL, NULL}
+    };
+
+    luaL_newmetatable(L, LUA_PM3_BUFFER);
+    luaL_newlib(L, methods);
+    lua_setfield(L, -2, "__index");
+    lua_pushcfunction(L, l_buffer_len);
+    lua_setfield(L, -2, "__len");
+    lua_pushcfunction(L, l_buffer_hex);
+    lua_setfield(L, -2, "__tostring");
+    lua_pop(L, 1);
+}
+
+// the data param of the SendCommand* functions, a pm3.buffer used in place or a hex string decoded into tmp
+static uint8_t *get_payload(lua_State *L, int idx, uint8_t *tmp, size_t *len) {
+    lua_pm3_buffer_t *b = (lua_pm3_buffer_t *)luaL_testudata(L, idx, LUA_PM3_BUFFER);
+    if (b) {
+        *len = b->len;
+        return b->data;
+    }
+
+    size_t size;
+    const char *p_data = luaL_checklstring(L, idx, &size);
+    *len = 0;
+    if (size) {
+        if (size > 1024)
+            size = 1024;
+
+        uint32_t tmp32;
+        for (int i = 0; i < size; i += 2) {
+            sscanf(&p_data[i], "%02x", &tmp32);
+            tmp[i >> 1] = tmp32 & 0xFF;
+            (*len)++;
+        }
+    }
+    return tmp;
+}
+
 /**
  * The following params expected:
  * @brief l_SendCommandOLD
@@ -101,7 +370,7 @@ static int l_SendCommandOLD(lua_State *L) {
 
     uint64_t cmd, arg0, arg1, arg2;
     uint8_t data[PM3_CMD_DATA_SIZE] = {0};
-    size_t len = 0, size;
+    size_t len = 0;
 
     //Check number of arguments
     int n = lua_gettop(L);
@@ -115,21 +384,10 @@ static int l_SendCommandOLD(lua_State *L) {
     arg1 = luaL_checknumber(L, 3);
     arg2 = luaL_checknumber(L, 4);
 
-    // data
-    const char *p_data = luaL_checklstring(L, 5, &size);
-    if (size) {
-        if (size > 1024)
-            size = 1024;
-
-        uint32_t tmp;
-        for (int i = 0; i < size; i += 2) {
-            sscanf(&p_data[i], "%02x", &tmp);
-            data[i >> 1] = tmp & 0xFF;
-            len++;
-        }
-    }
+    // data, hex string or pm3.buffer
+    uint8_t *p = get_payload(L, 5, data, &len);
 
-    SendCommandOLD(cmd, arg0, arg1, arg2, data, len);
+    SendCommandOLD(cmd, arg0, arg1, arg2, p, len);
     lua_pushboolean(L, true);
     return 1;
 }
@@ -149,7 +407,7 @@ static int l_SendCommandMIX(lua_State *L) {
 
     uint64_t cmd, arg0, arg1, arg2;
     uint8_t data[PM3_CMD_DATA_SIZE] = {0};
-    size_t len = 0, size;
+    size_t len = 0;
 
     // check number of arguments
     int n = lua_gettop(L);
@@ -162,21 +420,10 @@ static int l_SendCommandMIX(lua_State *L) {
     arg1 = luaL_checknumber(L, 3);
     arg2 = luaL_checknumber(L, 4);
 
-    // data
-    const char *p_data = luaL_checklstring(L, 5, &size);
-    if (size) {
-        if (size > 1024)
-            size = 1024;
-
-        uint32_t tmp;
-        for (int i = 0; i < size; i += 2) {
-            sscanf(&p_data[i], "%02x", &tmp);
-            data[i >> 1] = tmp & 0xFF;
-            len++;
-        }
-    }
+    // data, hex string or pm3.buffer
+    uint8_t *p = get_payload(L, 5, data, &len);
 
-    SendCommandMIX(cmd, arg0, arg1, arg2, data, len);
+    SendCommandMIX(cmd, arg0, arg1, arg2, p, len);
     lua_pushboolean(L, true);
     return 1;
 }
@@ -191,7 +438,7 @@ static int l_SendCommandMIX(lua_State *L) {
 static int l_SendCommandNG(lua_State *L) {
 
     uint8_t data[PM3_CMD_DATA_SIZE] = {0};
-    size_t len = 0, size;
+    size_t len = 0;
 
     // check number of arguments
     int n = lua_gettop(L);
@@ -201,25 +448,40 @@ static int l_SendCommandNG(lua_State *L) {
     // parse input
     uint16_t cmd = luaL_checknumber(L, 1);
 
-    // data
-    const char *p_data = luaL_checklstring(L, 2, &size);
-    if (size) {
-        if (size > 1024)
-            size = 1024;
-
-        uint32_t tmp;
-        for (int i = 0; i < size; i += 2) {
-            sscanf(&p_data[i], "%02x", &tmp);
-            data[i >> 1] = tmp & 0xFF;
-            len++;
-        }
-    }
+    // data, hex string or pm3.buffer
+    uint8_t *p = get_payload(L, 2, data, &len);
 
-    SendCommandNG(cmd, data, len);
+    SendCommandNG(cmd, p, len);
     lua_pushboolean(L, true);
     return 1;
 }
 
+/**
+ * @brief Queues a NG command without waiting, see SendCommandNGAsync
+ * @param cmd
+ * @param data  hexstring or pm3.buffer
+ * @return sequence number for poll_response / WaitForResponseSeq
+ */
+static int l_SendCommandNGAsync(lua_State *L) {
+
+    uint8_t data[PM3_CMD_DATA_SIZE] = {0};
+    size_t len = 0;
+
+    if (lua_gettop(L) != 2)
+        return returnToLuaWithError(L, "You need to supply two parameters");
+
+    uint16_t cmd = luaL_checknumber(L, 1);
+    uint8_t *p = get_payload(L, 2, data, &len);
+
+    uint32_t seq = 0;
+    int res = SendCommandNGAsync(cmd, p, len, &seq);
+    if (res != PM3_SUCCESS)
+        return returnToLuaWithError(L, "Command not queued (%d)", res);
+
+    lua_pushunsigned(L, seq);
+    return 1;
+}
+
 
 /**
  * @brief The following params expected:
@@ -390,6 +652,13 @@ static int l_WaitForResponseTimeout(lua_State *L) {
     if (WaitForResponseTimeout(cmd, &resp, ms_timeout) == false)
         return returnToLuaWithError(L, "No response from the device");
 
+    // third param, the reply goes into the pm3.buffer instead of a new string
+    if (n >= 3) {
+        buffer_setreply(check_buffer(L, 3), &resp);
+        lua_pushboolean(L, true);
+        return 1;
+    }
+
     char foo[sizeof(PacketResponseNG)];
     n = 0;
 
@@ -430,6 +699,48 @@ static int l_WaitForResponseTimeout(lua_State *L) {
     return 1;
 }
 
+/**
+ * @brief Waits for the reply of a command queued with SendCommandNGAsync
+ * @param seq
+ * @param ms_timeout
+ * @param buffer pm3.buffer getting the reply
+ * @return true
+ */
+static int l_WaitForResponseSeq(lua_State *L) {
+
+    uint32_t seq = luaL_checkunsigned(L, 1);
+    size_t ms_timeout = luaL_checkunsigned(L, 2);
+    lua_pm3_buffer_t *b = check_buffer(L, 3);
+
+    PacketResponseNG resp;
+    if (WaitForResponseSeq(seq, &resp, ms_timeout) == false)
+        return returnToLuaWithError(L, "No response from the device");
+
+    buffer_setreply(b, &resp);
+    lua_pushboolean(L, true);
+    return 1;
+}
+
+/**
+ * @brief Non blocking check of a command queued with SendCommandNGAsync
+ * @param seq
+ * @param buffer pm3.buffer getting the reply
+ * @return true once the reply is in the buffer, false while still in flight
+ */
+static int l_poll_response(lua_State *L) {
+
+    uint32_t seq = luaL_checkunsigned(L, 1);
+    lua_pm3_buffer_t *b = check_buffer(L, 2);
+
+    PacketResponseNG resp;
+    bool res = PollResponseSeq(seq, &resp);
+    if (res)
+        buffer_setreply(b, &resp);
+
+    lua_pushboolean(L, res);
+    return 1;
+}
+
 static int l_mfDarkside(lua_State *L) {
 
     uint32_t blockno = 0;
@@ -511,6 +822,35 @@ static int l_CmdConsole(lua_State *L) {
     return 0;
 }
 
+/**
+ * @brief Same as console, with the arguments as separate strings. They go to the
+ * command parser as they are, no splitting, no quoting "core.console_args('hf mfp rdbl', '0', '-v')".
+ * A command without the cliparser gets them joined by spaces.
+ * @param L
+ * @return
+ */
+static int l_CmdConsoleArgs(lua_State *L) {
+    const char *argv[100] = {NULL};
+    const char *cmd = luaL_checkstring(L, 1);
+    int argc = lua_gettop(L) - 1;
+    if (argc > (int)ARRAYLEN(argv))
+        return returnToLuaWithError(L, "Too many arguments, max %d", ARRAYLEN(argv));
+
+    char line[PM3_CMD_DATA_SIZE * 4 + 1] = {0};
+    snprintf(line, sizeof(line), "%s", cmd);
+    for (int i = 0; i < argc; i++) {
+        argv[i] = luaL_checkstring(L, i + 2);
+        size_t len = strlen(line);
+        snprintf(line + len, sizeof(line) - len, " %s", argv[i]);
+    }
+
+    CLIParserPresetArgs(argc, argv);
+    CommandReceived(line);
+    // not taken by a command without the cliparser
+    CLIParserPresetArgs(-1, NULL);
+    return 0;
+}
+
 static int l_iso15693_crc(lua_State *L) {
     uint32_t tmp;
     unsigned char buf[PM3_CMD_DATA_SIZE] = {0x00};
@@ -998,7 +1338,7 @@ static int l_T55xx_readblock(lua_State *L) {
                 return returnToLuaWithError(L, "Failed to read config block");
             }
 
-            if (!tryDetectModulation(0, true)) { // Default to prev. behaviour (default dl mode and print config)
+            if (!tryDetectModulationCached(0, true, -1)) { // Default to prev. behaviour (default dl mode and print config)
                 PrintAndLogEx(NORMAL, "Safety Check: Could not detect if PWD bit is set in config block. Exits.");
                 return 0;
             } else {
@@ -1238,15 +1578,20 @@ int set_pm3_libraries(lua_State *L) {
         {"SendCommandOLD",              l_SendCommandOLD},
         {"SendCommandMIX",              l_SendCommandMIX},
         {"SendCommandNG",               l_SendCommandNG},
+        {"SendCommandNGAsync",          l_SendCommandNGAsync},
         {"GetFromBigBuf",               l_GetFromBigBuf},
         {"GetFromFlashMem",             l_GetFromFlashMem},
         {"GetFromFlashMemSpiffs",       l_GetFromFlashMemSpiffs},
         {"WaitForResponseTimeout",      l_WaitForResponseTimeout},
+        {"WaitForResponseSeq",          l_WaitForResponseSeq},
+        {"poll_response",               l_poll_response},
+        {"buffer",                      l_buffer_new},
         {"mfDarkside",                  l_mfDarkside},
         {"foobar",                      l_foobar},
         {"kbd_enter_pressed",               l_kbd_enter_pressed},
         {"clearCommandBuffer",          l_clearCommandBuffer},
         {"console",                     l_CmdConsole},
+        {"console_args",                l_CmdConsoleArgs},
         {"iso15693_crc",                l_iso15693_crc},
         {"iso14443b_crc",               l_iso14443b_crc},
         {"aes128_decrypt",              l_aes128decrypt_cbc},
@@ -1278,6 +1623,8 @@ int set_pm3_libraries(lua_State *L) {
         {NULL, NULL}
     };
 
+    set_pm3_buffer(L);
+
     lua_pushglobaltable(L);
     // Core library is in this table. Contains '
     // this is 'pm3' table
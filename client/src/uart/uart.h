@@ -90,5 +90,14 @@ uint32_t uart_get_speed(const serial_port sp);
 /* Reconfigure timeouts
  */
 int uart_reconfigure_timeouts(uint32_t value);
+
+/* Waits up to ms for data to read, or for a uart_wakeup.
+ * Returns TRUE if there is data (or an error uart_receive will report), FALSE otherwise.
+ */
+bool uart_wait_rx(const serial_port sp, uint32_t ms);
+
+/* Makes a uart_wait_rx return now, e.g. when a command is to be sent.
+ */
+void uart_wakeup(void);
 #endif // _UART_H_
 
@@ -64,11 +64,18 @@
 # define SOL_TCP IPPROTO_TCP
 #endif
 
+// bytes read beyond what was asked for, kept for the next uart_receive. Frames are read
+// field by field, over a slow link most land in one read this way
+#define UART_RX_BUFFER_SIZE  (2 * sizeof(PacketResponseNGRaw))
+
 typedef struct termios term_info;
 typedef struct {
     int fd;           // Serial port file descriptor
     term_info tiOld;  // Terminal info before using the port
     term_info tiNew;  // Terminal info during the transaction
+    uint8_t rxbuf[UART_RX_BUFFER_SIZE];
+    uint32_t rxbuf_low;
+    uint32_t rxbuf_high;
 } serial_port_unix;
 
 // see pm3_cmd.h
@@ -86,6 +93,54 @@ int uart_reconfigure_timeouts(uint32_t value) {
     return PM3_SUCCESS;
 }
 
+// Self pipe for uart_wakeup. One for all ports and never closed,
+// so a wakeup can't race with the communication thread closing its port
+static int wakeup_pipe[2] = { -1, -1 };
+
+static void wakeup_pipe_init(void) {
+    if (wakeup_pipe[0] >= 0)
+        return;
+    if (pipe(wakeup_pipe) != 0) {
+        wakeup_pipe[0] = wakeup_pipe[1] = -1;
+        return;
+    }
+    fcntl(wakeup_pipe[0], F_SETFL, fcntl(wakeup_pipe[0], F_GETFL) | O_NONBLOCK);
+    fcntl(wakeup_pipe[1], F_SETFL, fcntl(wakeup_pipe[1], F_GETFL) | O_NONBLOCK);
+}
+
+void uart_wakeup(void) {
+    if (wakeup_pipe[1] < 0)
+        return;
+    uint8_t b = 0;
+    // a full pipe already wakes up
+    if (write(wakeup_pipe[1], &b, sizeof(b)) < 0) {}
+}
+
+bool uart_wait_rx(const serial_port sp, uint32_t ms) {
+    serial_port_unix *spu = (serial_port_unix *)sp;
+    if (spu->rxbuf_high > spu->rxbuf_low)
+        return true;
+
+    fd_set rfds;
+    FD_ZERO(&rfds);
+    FD_SET(spu->fd, &rfds);
+    int maxfd = spu->fd;
+    if (wakeup_pipe[0] >= 0) {
+        FD_SET(wakeup_pipe[0], &rfds);
+        maxfd = MAX(maxfd, wakeup_pipe[0]);
+    }
+    struct timeval tv = { .tv_sec = ms / 1000, .tv_usec = (ms % 1000) * 1000 };
+    int res = select(maxfd + 1, &rfds, NULL, NULL, &tv);
+    if (res <= 0)
+        return (res < 0);
+
+    if (wakeup_pipe[0] >= 0 && FD_ISSET(wakeup_pipe[0], &rfds)) {
+        uint8_t buf[32];
+        while (read(wakeup_pipe[0], buf, sizeof(buf)) > 0) {};
+    }
+    return FD_ISSET(spu->fd, &rfds);
+}
+
 serial_port uart_open(const char *pcPortName, uint32_t speed) {
     serial_port_unix *sp = calloc(sizeof(serial_port_unix), sizeof(uint8_t));
 
@@ -97,6 +152,8 @@ serial_port uart_open(const char *pcPortName, uint32_t speed) {
     // init timeouts
     timeout.tv_usec = UART_FPC_CLIENT_RX_TIMEOUT_MS * 1000;
 
+    wakeup_pipe_init();
+
     char *prefix = strdup(pcPortName);
     if (prefix == NULL) {
         PrintAndLogEx(ERR, "error: malloc");
@@ -366,6 +423,7 @@ void uart_close(const serial_port sp) {
 }
 
 int uart_receive(const serial_port sp, uint8_t *pbtRx, uint32_t pszMaxRxLen, uint32_t *pszRxLen) {
+    serial_port_unix *spu = (serial_port_unix *)sp;
     uint32_t byteCount;  // FIONREAD returns size on 32b
     fd_set rfds;
     struct timeval tv;
@@ -376,6 +434,20 @@ int uart_receive(const serial_port sp, uint8_t *pbtRx, uint32_t pszMaxRxLen, uin
     }
     // Reset the output count
     *pszRxLen = 0;
+
+    // What the last read brought in goes first
+    if (spu->rxbuf_high > spu->rxbuf_low) {
+        uint32_t n = MIN(spu->rxbuf_high - spu->rxbuf_low, pszMaxRxLen);
+        memcpy(pbtRx, spu->rxbuf + spu->rxbuf_low, n);
+        spu->rxbuf_low += n;
+        *pszRxLen = n;
+        if (*pszRxLen == pszMaxRxLen) {
+            return PM3_SUCCESS;
+        }
+    }
+    // the buffer is empty from here on
+    spu->rxbuf_low = spu->rxbuf_high = 0;
+
     do {
         // Reset file descriptor
         FD_ZERO(&rfds);
@@ -404,14 +476,26 @@ int uart_receive(const serial_port sp, uint8_t *pbtRx, uint32_t pszMaxRxLen, uin
 //        PrintAndLogEx(ERR, "UART:: RX ioctl res %d byteCount %u", res, byteCount);
         if (res < 0) return PM3_ENOTTY;
 
-        // Cap the number of bytes, so we don't overrun the buffer
-        if (pszMaxRxLen - (*pszRxLen) < byteCount) {
-//            PrintAndLogEx(ERR, "UART:: RX prevent overrun (have %u, need %u)", pszMaxRxLen - (*pszRxLen), byteCount);
-            byteCount = pszMaxRxLen - (*pszRxLen);
+        // More than asked for, read it all in one go and keep the rest
+        uint32_t want = pszMaxRxLen - (*pszRxLen);
+        if (want < byteCount) {
+            res = read(spu->fd, spu->rxbuf, MIN(byteCount, sizeof(spu->rxbuf)));
+            if (res <= 0) {
+                return PM3_EIO;
+            }
+            uint32_t n = MIN((uint32_t)res, want);
+            memcpy(pbtRx + (*pszRxLen), spu->rxbuf, n);
+            spu->rxbuf_low = n;
+            spu->rxbuf_high = res;
+            *pszRxLen += n;
+            if (*pszRxLen == pszMaxRxLen) {
+                return PM3_SUCCESS;
+            }
+            continue;
         }
 
         // There is something available, read the data
-        res = read(((serial_port_unix *)sp)->fd, pbtRx + (*pszRxLen), byteCount);
+        res = read(spu->fd, pbtRx + (*pszRxLen), byteCount);
 
         // Stop if the OS has some troubles reading the data
         if (res <= 0) {
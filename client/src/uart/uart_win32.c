@@ -182,6 +182,16 @@ uint32_t uart_get_speed(const serial_port sp) {
     return 0;
 }
 
+// no wakeup here, uart_receive keeps waiting with its own timeouts
+bool uart_wait_rx(const serial_port sp, uint32_t ms) {
+    (void)sp;
+    (void)ms;
+    return true;
+}
+
+void uart_wakeup(void) {
+}
+
 int uart_receive(const serial_port sp, uint8_t *pbtRx, uint32_t pszMaxRxLen, uint32_t *pszRxLen) {
     uart_reconfigure_timeouts_polling(sp);
     int res = ReadFile(((serial_port_windows *)sp)->hPort, pbtRx, pszMaxRxLen, (LPDWORD)pszRxLen, NULL);
@@ -24,6 +24,7 @@
 
 #include <complex.h>
 #include "util.h"
+#include "util_posix.h"  // msclock
 #include "proxmark3.h"  // PROXLOG
 #include "fileutils.h"
 #include "pm3_cmd.h"
@@ -42,6 +43,7 @@ int PlotGridX = 0, PlotGridY = 0, PlotGridXdefault = 64, PlotGridYdefault = 64;
 uint32_t CursorCPos = 0, CursorDPos = 0;
 double GraphPixelsPerPoint = 1.f; // How many visual pixels are between each sample point (x axis)
 static bool flushAfterWrite = 0;
+static bool printQuiet = false;
 int GridOffset = 0;
 bool GridLocked = false;
 bool showDemod = true;
@@ -50,6 +52,42 @@ pthread_mutex_t print_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static void fPrintAndLog(FILE *stream, const char *fmt, ...);
 
+// directories searchHomeFilePath found or made, they are not looked at again
+#define HOME_DIRS_KNOWN 8
+static char *home_dirs_known[HOME_DIRS_KNOWN];
+static pthread_mutex_t home_dirs_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static bool home_dir_known(const char *path) {
+    bool known = false;
+    pthread_mutex_lock(&home_dirs_lock);
+    for (int i = 0; i < HOME_DIRS_KNOWN && home_dirs_known[i] && known == false; i++)
+        known = (strcmp(home_dirs_known[i], path) == 0);
+    pthread_mutex_unlock(&home_dirs_lock);
+    return known;
+}
+
+static void home_dir_remember(const char *path) {
+    pthread_mutex_lock(&home_dirs_lock);
+    for (int i = 0; i < HOME_DIRS_KNOWN; i++) {
+        if (home_dirs_known[i] == NULL) {
+            home_dirs_known[i] = calloc(strlen(path) + 1, sizeof(char));
+            if (home_dirs_known[i] != NULL)
+                strcpy(home_dirs_known[i], path);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&home_dirs_lock);
+}
+
+void searchHomeFilePathReset(void) {
+    pthread_mutex_lock(&home_dirs_lock);
+    for (int i = 0; i < HOME_DIRS_KNOWN; i++) {
+        free(home_dirs_known[i]);
+        home_dirs_known[i] = NULL;
+    }
+    pthread_mutex_unlock(&home_dirs_lock);
+}
+
 // needed by flasher, so let's put it here instead of fileutils.c
 int searchHomeFilePath(char **foundpath, const char *subdir, const char *filename, bool create_home) {
     if (foundpath == NULL)
@@ -69,11 +107,13 @@ int searchHomeFilePath(char **foundpath, const char *subdir, const char *filenam
     strcpy(path, user_path);
     strcat(path, PM3_USER_DIRECTORY);
 
-    int result;
+    bool known = home_dir_known(path);
+    int result = 0;
 #ifdef _WIN32
     struct _stat st;
     // Mingw _stat fails if path ends with /, so let's use a stripped path
-    if (path[strlen(path) - 1] == '/') {
+    if (known) {
+    } else if (path[strlen(path) - 1] == '/') {
         path[strlen(path) - 1] = '\0';
         result = _stat(path, &st);
         path[strlen(path)] = '/';
@@ -82,7 +122,8 @@ int searchHomeFilePath(char **foundpath, const char *subdir, const char *filenam
     }
 #else
     struct stat st;
-    result = stat(path, &st);
+    if (known == false)
+        result = stat(path, &st);
 #endif
     if ((result != 0) && create_home) {
 
@@ -97,6 +138,9 @@ int searchHomeFilePath(char **foundpath, const char *subdir, const char *filenam
             return PM3_EFILE;
         }
     }
+    if (known == false && (result == 0 || create_home))
+        home_dir_remember(path);
+
     if (subdir != NULL) {
         pathlen += strlen(subdir);
         char *tmp = realloc(path, pathlen * sizeof(char));
@@ -107,9 +151,12 @@ int searchHomeFilePath(char **foundpath, const char *subdir, const char *filenam
         path = tmp;
         strcat(path, subdir);
 
+        known = home_dir_known(path);
+        result = 0;
 #ifdef _WIN32
         // Mingw _stat fails if path ends with /, so let's use a stripped path
-        if (path[strlen(path) - 1] == '/') {
+        if (known) {
+        } else if (path[strlen(path) - 1] == '/') {
             path[strlen(path) - 1] = '\0';
             result = _stat(path, &st);
             path[strlen(path)] = '/';
@@ -117,7 +164,8 @@ int searchHomeFilePath(char **foundpath, const char *subdir, const char *filenam
             result = _stat(path, &st);
         }
 #else
-        result = stat(path, &st);
+        if (known == false)
+            result = stat(path, &st);
 #endif
         if ((result != 0) && create_home) {
 
@@ -132,6 +180,8 @@ int searchHomeFilePath(char **foundpath, const char *subdir, const char *filenam
                 return PM3_EFILE;
             }
         }
+        if (known == false && (result == 0 || create_home))
+            home_dir_remember(path);
     }
 
     if (filename == NULL) {
@@ -177,6 +227,10 @@ static uint8_t PrintAndLogEx_spinidx = 0;
 
 void PrintAndLogEx(logLevel_t level, const char *fmt, ...) {
 
+    // everything is dropped while a benchmark times commands, see `lf bench`
+    if (printQuiet)
+        return;
+
     // skip debug messages if client debugging is turned off i.e. 'DATA SETDEBUG 0'
     if (g_debugMode == 0 && level == DEBUG)
         return;
@@ -293,46 +347,188 @@ void PrintAndLogEx(logLevel_t level, const char *fmt, ...) {
     }
 }
 
-static void fPrintAndLog(FILE *stream, const char *fmt, ...) {
-    va_list argptr;
-    static FILE *logfile = NULL;
-    static int logging = 0;  // close the log file output
-    char buffer[MAX_PRINT_BUFFER] = {0};
-    char buffer2[MAX_PRINT_BUFFER] = {0};
-    char buffer3[MAX_PRINT_BUFFER] = {0};
-    // lock this section to avoid interlacing prints from different threads
-    pthread_mutex_lock(&print_lock);
-    bool linefeed = true;
+// Session log. The printing thread only filters the line and appends it to log_queue, a single
+// producer (print_lock is held) single consumer ring. log_writer drains it in batches to the file
+// and flushes per line or every LOG_FLUSH_MS, as set with `pref set sessionlog`
+#define LOG_QUEUE_SIZE  (256 * 1024)
+#define LOG_FLUSH_MS    500
+
+static char log_queue[LOG_QUEUE_SIZE];
+static uint32_t log_head = 0;
+static uint32_t log_tail = 0;
+static bool log_writer_waiting = false;
+static bool log_producer_waiting = false;
+static bool log_stop = false;
+static bool log_running = false;
+static FILE *logfile = NULL;
+static pthread_t log_thread;
+static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_sig = PTHREAD_COND_INITIALIZER;
+
+static void log_cond_wait_ms(uint32_t ms) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += ms / 1000;
+    ts.tv_nsec += (long)(ms % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    pthread_cond_timedwait(&log_sig, &log_mutex, &ts);
+}
 
-    if ((g_printAndLog & PRINTANDLOG_LOG) && logging && !logfile) {
-        char *my_logfile_path = NULL;
-        char filename[40];
-        struct tm *timenow;
-        time_t now = time(NULL);
-        timenow = gmtime(&now);
-        strftime(filename, sizeof(filename), PROXLOG, timenow);
-        if (searchHomeFilePath(&my_logfile_path, LOGS_SUBDIR, filename, true) != PM3_SUCCESS) {
-            printf(_YELLOW_("[-]") " Logging disabled!\n");
-            my_logfile_path = NULL;
-            logging = 0;
-        } else {
-            logfile = fopen(my_logfile_path, "a");
-            if (logfile == NULL) {
-                printf(_YELLOW_("[-]") " Can't open logfile %s, logging disabled!\n", my_logfile_path);
-                logging = 0;
-            } else {
+static void log_wake(void) {
+    pthread_mutex_lock(&log_mutex);
+    pthread_cond_broadcast(&log_sig);
+    pthread_mutex_unlock(&log_mutex);
+}
 
-                if (session.supports_colors) {
-                    printf("["_YELLOW_("=")"] Session log " _YELLOW_("%s") "\n", my_logfile_path);
-                } else {
-                    printf("[=] Session log %s\n", my_logfile_path);
-                }
+static void *log_writer(void *arg) {
+    (void)arg;
+    uint64_t last_flush = msclock();
+    bool dirty = false;
+
+    for (;;) {
+        uint32_t tail = __atomic_load_n(&log_tail, __ATOMIC_RELAXED);
+        uint32_t head = __atomic_load_n(&log_head, __ATOMIC_ACQUIRE);
+        if (head != tail) {
+            // contiguous part up to the end of the ring, the wrapped part goes on the next pass
+            uint32_t len = (head > tail) ? head - tail : LOG_QUEUE_SIZE - tail;
+            fwrite(log_queue + tail, 1, len, logfile);
+            __atomic_store_n(&log_tail, (tail + len) % LOG_QUEUE_SIZE, __ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&log_producer_waiting, __ATOMIC_SEQ_CST))
+                log_wake();
+            dirty = true;
+            continue;
+        }
 
-            }
-            free(my_logfile_path);
+        bool stop = __atomic_load_n(&log_stop, __ATOMIC_SEQ_CST);
+        uint64_t now = msclock();
+        if (dirty && (stop || session.session_log == slLINE || now - last_flush >= LOG_FLUSH_MS)) {
+            fflush(logfile);
+            dirty = false;
+            last_flush = now;
         }
+        if (stop)
+            break;
+
+        pthread_mutex_lock(&log_mutex);
+        __atomic_store_n(&log_writer_waiting, true, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&log_head, __ATOMIC_SEQ_CST) == tail && !__atomic_load_n(&log_stop, __ATOMIC_SEQ_CST))
+            log_cond_wait_ms(LOG_FLUSH_MS);
+        __atomic_store_n(&log_writer_waiting, false, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&log_mutex);
     }
+    return NULL;
+}
 
+// Producer side, print_lock held. Waits for the writer when the ring is full, drops the rest once it is stopping
+static void log_push(const char *s, size_t len) {
+    while (len) {
+        uint32_t head = __atomic_load_n(&log_head, __ATOMIC_RELAXED);
+        uint32_t tail = __atomic_load_n(&log_tail, __ATOMIC_ACQUIRE);
+        uint32_t room = (tail + LOG_QUEUE_SIZE - head - 1) % LOG_QUEUE_SIZE;
+        if (room == 0) {
+            if (__atomic_load_n(&log_stop, __ATOMIC_SEQ_CST))
+                return;
+            pthread_mutex_lock(&log_mutex);
+            __atomic_store_n(&log_producer_waiting, true, __ATOMIC_SEQ_CST);
+            pthread_cond_broadcast(&log_sig);
+            if (__atomic_load_n(&log_tail, __ATOMIC_SEQ_CST) == tail)
+                log_cond_wait_ms(100);
+            __atomic_store_n(&log_producer_waiting, false, __ATOMIC_SEQ_CST);
+            pthread_mutex_unlock(&log_mutex);
+            continue;
+        }
+        uint32_t n = MIN(len, MIN(room, LOG_QUEUE_SIZE - head));
+        memcpy(log_queue + head, s, n);
+        __atomic_store_n(&log_head, (head + n) % LOG_QUEUE_SIZE, __ATOMIC_SEQ_CST);
+        s += n;
+        len -= n;
+    }
+}
+
+// Producer side, end of a line. In batch mode the writer only gets woken up when the ring fills up
+static void log_commit(void) {
+    if (__atomic_load_n(&log_writer_waiting, __ATOMIC_SEQ_CST) == false)
+        return;
+    uint32_t used = (__atomic_load_n(&log_head, __ATOMIC_RELAXED) + LOG_QUEUE_SIZE - __atomic_load_n(&log_tail, __ATOMIC_ACQUIRE)) % LOG_QUEUE_SIZE;
+    if (session.session_log == slLINE || used >= LOG_QUEUE_SIZE / 2)
+        log_wake();
+}
+
+// Drains the queue, flushes and closes the session log
+static void log_close(void) {
+    if (log_running == false)
+        return;
+    __atomic_store_n(&log_stop, true, __ATOMIC_SEQ_CST);
+    log_wake();
+    pthread_join(log_thread, NULL);
+    fclose(logfile);
+    logfile = NULL;
+    log_head = 0;
+    log_tail = 0;
+    __atomic_store_n(&log_stop, false, __ATOMIC_SEQ_CST);
+    log_running = false;
+}
+
+static void log_open(void) {
+    static bool atexit_set = false;
+    char *my_logfile_path = NULL;
+    char filename[40];
+    struct tm *timenow;
+    time_t now = time(NULL);
+    timenow = gmtime(&now);
+    strftime(filename, sizeof(filename), PROXLOG, timenow);
+    if (searchHomeFilePath(&my_logfile_path, LOGS_SUBDIR, filename, true) != PM3_SUCCESS) {
+        printf(_YELLOW_("[-]") " Logging disabled!\n");
+        session.session_log = slOFF;
+        return;
+    }
+
+    logfile = fopen(my_logfile_path, "a");
+    if (logfile == NULL) {
+        printf(_YELLOW_("[-]") " Can't open logfile %s, logging disabled!\n", my_logfile_path);
+        session.session_log = slOFF;
+        free(my_logfile_path);
+        return;
+    }
+
+    if (pthread_create(&log_thread, NULL, log_writer, NULL) != 0) {
+        printf(_YELLOW_("[-]") " Can't start log writer, logging disabled!\n");
+        fclose(logfile);
+        logfile = NULL;
+        session.session_log = slOFF;
+        free(my_logfile_path);
+        return;
+    }
+    log_running = true;
+    if (atexit_set == false) {
+        atexit(log_close);
+        atexit_set = true;
+    }
+
+    if (session.supports_colors) {
+        printf("["_YELLOW_("=")"] Session log " _YELLOW_("%s") "\n", my_logfile_path);
+    } else {
+        printf("[=] Session log %s\n", my_logfile_path);
+    }
+    free(my_logfile_path);
+}
+
+static void fPrintAndLog(FILE *stream, const char *fmt, ...) {
+    va_list argptr;
+    char buffer[MAX_PRINT_BUFFER];
+    char buffer2[MAX_PRINT_BUFFER];
+    char buffer3[MAX_PRINT_BUFFER];
+    // lock this section to avoid interlacing prints from different threads
+    pthread_mutex_lock(&print_lock);
+    bool linefeed = true;
+
+    if ((g_printAndLog & PRINTANDLOG_LOG) && session.session_log != slOFF && log_running == false)
+        log_open();
+    else if (session.session_log == slOFF && log_running)
+        log_close();
 
 // If there is an incoming message from the hardware (eg: lf hid read) in
 // the background (while the prompt is displayed and accepting user input),
@@ -355,14 +551,16 @@ static void fPrintAndLog(FILE *stream, const char *fmt, ...) {
     va_start(argptr, fmt);
     vsnprintf(buffer, sizeof(buffer), fmt, argptr);
     va_end(argptr);
-    if (buffer[strlen(buffer) - 1] == NOLF[0]) {
+    size_t len = strlen(buffer);
+    if (len && buffer[len - 1] == NOLF[0]) {
         linefeed = false;
-        buffer[strlen(buffer) - 1] = 0;
+        buffer[--len] = 0;
     }
+    // the filters only need to see the string and its terminator
     bool filter_ansi = !session.supports_colors;
-    memcpy_filter_ansi(buffer2, buffer, sizeof(buffer), filter_ansi);
+    memcpy_filter_ansi(buffer2, buffer, len + 1, filter_ansi);
     if (g_printAndLog & PRINTANDLOG_PRINT) {
-        memcpy_filter_emoji(buffer3, buffer2, sizeof(buffer2), session.emoji_mode);
+        memcpy_filter_emoji(buffer3, buffer2, strlen(buffer2) + 1, session.emoji_mode);
         fprintf(stream, "%s", buffer3);
         if (linefeed)
             fprintf(stream, "\n");
@@ -379,17 +577,17 @@ static void fPrintAndLog(FILE *stream, const char *fmt, ...) {
     }
 #endif
 
-    if ((g_printAndLog & PRINTANDLOG_LOG) && logging && logfile) {
-        memcpy_filter_emoji(buffer3, buffer2, sizeof(buffer2), ALTTEXT);
+    if ((g_printAndLog & PRINTANDLOG_LOG) && log_running) {
+        memcpy_filter_emoji(buffer3, buffer2, strlen(buffer2) + 1, ALTTEXT);
         if (filter_ansi) { // already done
-            fprintf(logfile, "%s", buffer3);
+            log_push(buffer3, strlen(buffer3));
         } else {
-            memcpy_filter_ansi(buffer, buffer3, sizeof(buffer3), true);
-            fprintf(logfile, "%s", buffer);
+            memcpy_filter_ansi(buffer, buffer3, strlen(buffer3) + 1, true);
+            log_push(buffer, strlen(buffer));
         }
         if (linefeed)
-            fprintf(logfile, "\n");
-        fflush(logfile);
+            log_push("\n", 1);
+        log_commit();
     }
 
     if (flushAfterWrite)
@@ -403,6 +601,10 @@ void SetFlushAfterWrite(bool value) {
     flushAfterWrite = value;
 }
 
+void SetPrintAndLogQuiet(bool value) {
+    printQuiet = value;
+}
+
 void memcpy_filter_rlmarkers(void *dest, const void *src, size_t n) {
     uint8_t *rdest = (uint8_t *)dest;
     uint8_t *rsrc = (uint8_t *)src;
@@ -24,6 +24,7 @@ extern "C" {
 typedef enum logLevel {NORMAL, SUCCESS, INFO, FAILED, WARNING, ERR, DEBUG, INPLACE, HINT} logLevel_t;
 typedef enum emojiMode {ALIAS, EMOJI, ALTTEXT, ERASE} emojiMode_t;
 typedef enum clientdebugLevel {cdbOFF, cdbSIMPLE, cdbFULL} clientdebugLevel_t;
+typedef enum sessionLog {slOFF, slLINE, slBATCH} sessionLog_t;
 // typedef enum devicedebugLevel {ddbOFF, ddbERROR, ddbINFO, ddbDEBUG, ddbEXTENDED} devicedebugLevel_t;
 //typedef enum savePaths {spDefault, spDump, spTrace, spItemCount} savePaths_t; // last item spItemCount used to auto map to number of files
 typedef struct {int x; int y; int h; int w;} qtWindow_t;
@@ -37,6 +38,9 @@ typedef struct {
     bool pm3_present;
     bool help_dump_mode;
     bool show_hints;
+    bool statecache; // keep crapto1 state lists on disk
+    bool keycache; // order mifare classic keys by earlier hits
+    sessionLog_t session_log; // session log file, flushed per line or in batches
     bool window_changed; // track if plot/overlay pos/size changed to save on exit
     qtWindow_t plot;
     qtWindow_t overlay;
@@ -57,11 +61,15 @@ extern bool showDemod;
 void PrintAndLogOptions(const char *str[][2], size_t size, size_t space);
 void PrintAndLogEx(logLevel_t level, const char *fmt, ...);
 void SetFlushAfterWrite(bool value);
+// drops all PrintAndLogEx output while true
+void SetPrintAndLogQuiet(bool value);
 void memcpy_filter_ansi(void *dest, const void *src, size_t n, bool filter);
 void memcpy_filter_rlmarkers(void *dest, const void *src, size_t n);
 void memcpy_filter_emoji(void *dest, const void *src, size_t n, emojiMode_t mode);
 
 int searchHomeFilePath(char **foundpath, const char *subdir, const char *filename, bool create_home);
+// forget the directories searchHomeFilePath knows are there
+void searchHomeFilePathReset(void);
 
 extern pthread_mutex_t print_lock;
 
@@ -807,8 +807,17 @@ uint64_t HornerScheme(uint64_t num, uint64_t divider, uint64_t factor) {
     return result;
 }
 
+static int num_CPUs_limit = 0;
+
+// limit num_CPUs(), e.g. for benchmarks. 0 = no limit
+void set_num_CPUs(int count) {
+    num_CPUs_limit = count;
+}
+
 // determine number of logical CPU cores (use for multithreaded functions)
 int num_CPUs(void) {
+    if (num_CPUs_limit > 0)
+        return num_CPUs_limit;
 #if defined(_WIN32)
 #include <sysinfoapi.h>
     SYSTEM_INFO sysinfo;
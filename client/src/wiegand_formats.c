@@ -8,7 +8,10 @@
 // HID card format packing/unpacking routines
 //-----------------------------------------------------------------------------
 #include "wiegand_formats.h"
+
+#include <stdlib.h>
 #include "commonutil.h"
+#include "pm3_cmd.h"
 
 static bool Pack_H10301(wiegand_card_t *card, wiegand_message_t *packed) {
     memset(packed, 0, sizeof(wiegand_message_t));
@@ -581,25 +584,25 @@ static bool Unpack_C1k48s(wiegand_message_t *packed, wiegand_card_t *card) {
 }
 
 static const cardformat_t FormatTable[] = {
-    {"H10301",  Pack_H10301,  Unpack_H10301,  "HID H10301 26-bit",          {1, 1, 0, 0, 1}}, // imported from old pack/unpack
-    {"Tecom27", Pack_Tecom27, Unpack_Tecom27, "Tecom 27-bit",               {1, 1, 0, 0, 1}}, // from cardinfo.barkweb.com.au
-    {"2804W",   Pack_2804W,   Unpack_2804W,   "2804 Wiegand",               {1, 1, 0, 0, 1}}, // from cardinfo.barkweb.com.au
-    {"ATSW30",  Pack_ATSW30,  Unpack_ATSW30,  "ATS Wiegand 30-bit",         {1, 1, 0, 0, 1}}, // from cardinfo.barkweb.com.au
-    {"ADT31",   Pack_ADT31,   Unpack_ADT31,   "HID ADT 31-bit",             {1, 1, 0, 0, 1}}, // from cardinfo.barkweb.com.au
-    {"Kastle",  Pack_Kastle,  Unpack_Kastle,  "Kastle 32-bit",              {1, 1, 1, 0, 1}}, // from @xilni; PR #23 on RfidResearchGroup/proxmark3
-    {"D10202",  Pack_D10202,  Unpack_D10202,  "HID D10202 33-bit",          {1, 1, 0, 0, 1}}, // from cardinfo.barkweb.com.au
-    {"H10306",  Pack_H10306,  Unpack_H10306,  "HID H10306 34-bit",          {1, 1, 0, 0, 1}}, // imported from old pack/unpack
-    {"N10002",  Pack_N10002,  Unpack_N10002,  "HID N10002 34-bit",          {1, 1, 0, 0, 1}}, // from cardinfo.barkweb.com.au
-    {"C1k35s",  Pack_C1k35s,  Unpack_C1k35s,  "HID Corporate 1000 35-bit standard layout", {1, 1, 0, 0, 1}}, // imported from old pack/unpack
-    {"C15001",  Pack_C15001,  Unpack_C15001,  "HID KeyScan 36-bit",         {1, 1, 0, 1, 1}}, // from Proxmark forums
-    {"S12906",  Pack_S12906,  Unpack_S12906,  "HID Simplex 36-bit",         {1, 1, 1, 0, 1}}, // from cardinfo.barkweb.com.au
-    {"Sie36",   Pack_Sie36,   Unpack_Sie36,   "HID 36-bit Siemens",         {1, 1, 0, 0, 1}}, // from cardinfo.barkweb.com.au
-    {"H10320",  Pack_H10320,  Unpack_H10320,  "HID H10320 36-bit BCD",      {1, 0, 0, 0, 1}}, // from Proxmark forums
-    {"H10302",  Pack_H10302,  Unpack_H10302,  "HID H10302 37-bit huge ID",  {1, 0, 0, 0, 1}}, // from Proxmark forums
-    {"H10304",  Pack_H10304,  Unpack_H10304,  "HID H10304 37-bit",          {1, 1, 0, 0, 1}}, // imported from old pack/unpack
-    {"P10001",  Pack_P10001,  Unpack_P10001,  "HID P10001 Honeywell 40-bit", {1, 1, 0, 1, 0}}, // from cardinfo.barkweb.com.au
-    {"C1k48s",  Pack_C1k48s,  Unpack_C1k48s,  "HID Corporate 1000 48-bit standard layout", {1, 1, 0, 0, 1}}, // imported from old pack/unpack
-    {NULL, NULL, NULL, NULL, {0, 0, 0, 0, 0}} // Must null terminate array
+    {"H10301",  Pack_H10301,  Unpack_H10301,  "HID H10301 26-bit",          {1, 1, 0, 0, 1}, 26}, // imported from old pack/unpack
+    {"Tecom27", Pack_Tecom27, Unpack_Tecom27, "Tecom 27-bit",               {1, 1, 0, 0, 1}, 27}, // from cardinfo.barkweb.com.au
+    {"2804W",   Pack_2804W,   Unpack_2804W,   "2804 Wiegand",               {1, 1, 0, 0, 1}, 28}, // from cardinfo.barkweb.com.au
+    {"ATSW30",  Pack_ATSW30,  Unpack_ATSW30,  "ATS Wiegand 30-bit",         {1, 1, 0, 0, 1}, 30}, // from cardinfo.barkweb.com.au
+    {"ADT31",   Pack_ADT31,   Unpack_ADT31,   "HID ADT 31-bit",             {1, 1, 0, 0, 1}, 31}, // from cardinfo.barkweb.com.au
+    {"Kastle",  Pack_Kastle,  Unpack_Kastle,  "Kastle 32-bit",              {1, 1, 1, 0, 1}, 32}, // from @xilni; PR #23 on RfidResearchGroup/proxmark3
+    {"D10202",  Pack_D10202,  Unpack_D10202,  "HID D10202 33-bit",          {1, 1, 0, 0, 1}, 33}, // from cardinfo.barkweb.com.au
+    {"H10306",  Pack_H10306,  Unpack_H10306,  "HID H10306 34-bit",          {1, 1, 0, 0, 1}, 34}, // imported from old pack/unpack
+    {"N10002",  Pack_N10002,  Unpack_N10002,  "HID N10002 34-bit",          {1, 1, 0, 0, 1}, 34}, // from cardinfo.barkweb.com.au
+    {"C1k35s",  Pack_C1k35s,  Unpack_C1k35s,  "HID Corporate 1000 35-bit standard layout", {1, 1, 0, 0, 1}, 35}, // imported from old pack/unpack
+    {"C15001",  Pack_C15001,  Unpack_C15001,  "HID KeyScan 36-bit",         {1, 1, 0, 1, 1}, 36}, // from Proxmark forums
+    {"S12906",  Pack_S12906,  Unpack_S12906,  "HID Simplex 36-bit",         {1, 1, 1, 0, 1}, 36}, // from cardinfo.barkweb.com.au
+    {"Sie36",   Pack_Sie36,   Unpack_Sie36,   "HID 36-bit Siemens",         {1, 1, 0, 0, 1}, 36}, // from cardinfo.barkweb.com.au
+    {"H10320",  Pack_H10320,  Unpack_H10320,  "HID H10320 36-bit BCD",      {1, 0, 0, 0, 1}, 36}, // from Proxmark forums
+    {"H10302",  Pack_H10302,  Unpack_H10302,  "HID H10302 37-bit huge ID",  {1, 0, 0, 0, 1}, 37}, // from Proxmark forums
+    {"H10304",  Pack_H10304,  Unpack_H10304,  "HID H10304 37-bit",          {1, 1, 0, 0, 1}, 37}, // imported from old pack/unpack
+    {"P10001",  Pack_P10001,  Unpack_P10001,  "HID P10001 Honeywell 40-bit", {1, 1, 0, 1, 0}, 40}, // from cardinfo.barkweb.com.au
+    {"C1k48s",  Pack_C1k48s,  Unpack_C1k48s,  "HID Corporate 1000 48-bit standard layout", {1, 1, 0, 0, 1}, 48}, // imported from old pack/unpack
+    {NULL, NULL, NULL, NULL, {0, 0, 0, 0, 0}, 0} // Must null terminate array
 };
 
 void HIDListFormats(void) {
@@ -690,27 +693,285 @@ static void HIDDisplayUnpackedCard(wiegand_card_t *card, const cardformat_t form
     PrintAndLogEx(SUCCESS, "[%s] - %s;  %s", format.Name, format.Descrp, s);
 }
 
+// FormatTable indices grouped by bit length, in table order. Formats of length n are
+// fmt_by_len[fmt_len_start[n]] up to fmt_len_start[n + 1]
+static uint8_t fmt_by_len[ARRAYLEN(FormatTable)];
+static uint8_t fmt_len_start[UINT8_MAX + 2];
+static bool fmt_index_done = false;
+
+static void HIDBuildIndex(void) {
+    if (fmt_index_done)
+        return;
+
+    uint8_t count[UINT8_MAX + 1] = {0};
+    for (int i = 0; FormatTable[i].Name; i++)
+        count[FormatTable[i].Bits]++;
+
+    fmt_len_start[0] = 0;
+    for (int n = 0; n <= UINT8_MAX; n++)
+        fmt_len_start[n + 1] = fmt_len_start[n] + count[n];
+
+    uint8_t fill[UINT8_MAX + 1];
+    memcpy(fill, fmt_len_start, sizeof(fill));
+    for (int i = 0; FormatTable[i].Name; i++)
+        fmt_by_len[fill[FormatTable[i].Bits]++] = i;
+
+    fmt_index_done = true;
+}
+
+int HIDUnpackMatches(wiegand_message_t *packed, bool ignore_parity, wiegand_match_t *matches, int max) {
+    HIDBuildIndex();
+
+    int n = 0;
+    for (int j = fmt_len_start[packed->Length]; j < fmt_len_start[packed->Length + 1] && n < max; j++) {
+        int i = fmt_by_len[j];
+        wiegand_card_t *card = &matches[n].card;
+        if (FormatTable[i].Unpack(packed, card) == false)
+            continue;
+
+        if (ignore_parity || !FormatTable[i].Fields.hasParity || card->ParityValid) {
+            matches[n].format_idx = i;
+            n++;
+        }
+    }
+    return n;
+}
+
 bool HIDTryUnpack(wiegand_message_t *packed, bool ignore_parity) {
     if (FormatTable[0].Name == NULL)
         return false;
 
-    bool result = false;
-    int i = 0;
-    wiegand_card_t card;
-    memset(&card, 0, sizeof(wiegand_card_t));
+    wiegand_match_t matches[WIEGAND_MAX_MATCHES];
+    int n = HIDUnpackMatches(packed, ignore_parity, matches, ARRAYLEN(matches));
+    for (int i = 0; i < n; i++) {
+        HIDDisplayUnpackedCard(&matches[i].card, FormatTable[matches[i].format_idx]);
+    }
 
-    while (FormatTable[i].Name) {
-        if (FormatTable[i].Unpack(packed, &card)) {
-            if (ignore_parity || !FormatTable[i].Fields.hasParity || card.ParityValid) {
-                result = true;
-                HIDDisplayUnpackedCard(&card, FormatTable[i]);
+    if (n == 0) {
+        PrintAndLogEx(SUCCESS, "Unknown. Bit len %d", packed->Length);
+    }
+    return (n > 0);
+}
+
+static void HIDRawHex(wiegand_message_t *packed, char *s, size_t n) {
+    if (packed->Top != 0)
+        snprintf(s, n, "%X%08X%08X", packed->Top, packed->Mid, packed->Bot);
+    else if (packed->Mid != 0)
+        snprintf(s, n, "%X%08X", packed->Mid, packed->Bot);
+    else
+        snprintf(s, n, "%X", packed->Bot);
+}
+
+static void HIDWriteLine(wiegand_writer_t *w, const char *line) {
+    if (w->out)
+        fprintf(w->out, "%s\n", line);
+    else
+        PrintAndLogEx(NORMAL, "%s", line);
+}
+
+// one line per message. CSV, one row per format so it filters on any column
+static void HIDWriteRecord(wiegand_writer_t *w, wiegand_message_t *packed, wiegand_match_t *matches, int n) {
+    char raw[32];
+    HIDRawHex(packed, raw, sizeof(raw));
+
+    char line[160 + WIEGAND_MAX_MATCHES * 100];
+    size_t pos = 0;
+
+    switch (w->fmt) {
+        case WIEGAND_OUT_CSV: {
+            if (n == 0) {
+                snprintf(line, sizeof(line), "%s,%u,,,,,,", raw, packed->Length);
+                HIDWriteLine(w, line);
+            }
+            for (int i = 0; i < n; i++) {
+                const cardformat_t *f = &FormatTable[matches[i].format_idx];
+                wiegand_card_t *c = &matches[i].card;
+                pos = snprintf(line, sizeof(line), "%s,%u,%s,", raw, packed->Length, f->Name);
+                if (f->Fields.hasFacilityCode)
+                    pos += snprintf(line + pos, sizeof(line) - pos, "%u", c->FacilityCode);
+                pos += snprintf(line + pos, sizeof(line) - pos, ",");
+                if (f->Fields.hasCardNumber)
+                    pos += snprintf(line + pos, sizeof(line) - pos, "%" PRIu64, c->CardNumber);
+                pos += snprintf(line + pos, sizeof(line) - pos, ",");
+                if (f->Fields.hasIssueLevel)
+                    pos += snprintf(line + pos, sizeof(line) - pos, "%u", c->IssueLevel);
+                pos += snprintf(line + pos, sizeof(line) - pos, ",");
+                if (f->Fields.hasOEMCode)
+                    pos += snprintf(line + pos, sizeof(line) - pos, "%u", c->OEM);
+                pos += snprintf(line + pos, sizeof(line) - pos, ",");
+                if (f->Fields.hasParity)
+                    snprintf(line + pos, sizeof(line) - pos, "%s", c->ParityValid ? "valid" : "invalid");
+                HIDWriteLine(w, line);
             }
+            break;
+        }
+        case WIEGAND_OUT_JSON: {
+            pos = snprintf(line, sizeof(line), "%s{\"raw\": \"%s\", \"bits\": %u, \"formats\": [", (w->records) ? "," : " ", raw, packed->Length);
+            for (int i = 0; i < n; i++) {
+                const cardformat_t *f = &FormatTable[matches[i].format_idx];
+                wiegand_card_t *c = &matches[i].card;
+                pos += snprintf(line + pos, sizeof(line) - pos, "%s{\"format\": \"%s\"", (i) ? ", " : "", f->Name);
+                if (f->Fields.hasFacilityCode)
+                    pos += snprintf(line + pos, sizeof(line) - pos, ", \"fc\": %u", c->FacilityCode);
+                if (f->Fields.hasCardNumber)
+                    pos += snprintf(line + pos, sizeof(line) - pos, ", \"cn\": %" PRIu64, c->CardNumber);
+                if (f->Fields.hasIssueLevel)
+                    pos += snprintf(line + pos, sizeof(line) - pos, ", \"issue\": %u", c->IssueLevel);
+                if (f->Fields.hasOEMCode)
+                    pos += snprintf(line + pos, sizeof(line) - pos, ", \"oem\": %u", c->OEM);
+                if (f->Fields.hasParity)
+                    pos += snprintf(line + pos, sizeof(line) - pos, ", \"parity\": %s", c->ParityValid ? "true" : "false");
+                pos += snprintf(line + pos, sizeof(line) - pos, "}");
+            }
+            snprintf(line + pos, sizeof(line) - pos, "]}");
+            HIDWriteLine(w, line);
+            break;
+        }
+        case WIEGAND_OUT_TEXT:
+        default: {
+            if (n == 0) {
+                snprintf(line, sizeof(line), "%s  unknown, bit len %u", raw, packed->Length);
+                HIDWriteLine(w, line);
+            }
+            for (int i = 0; i < n; i++) {
+                const cardformat_t *f = &FormatTable[matches[i].format_idx];
+                wiegand_card_t *c = &matches[i].card;
+                pos = snprintf(line, sizeof(line), "%s  [%s]", raw, f->Name);
+                if (f->Fields.hasFacilityCode)
+                    pos += snprintf(line + pos, sizeof(line) - pos, "  FC: %u", c->FacilityCode);
+                if (f->Fields.hasCardNumber)
+                    pos += snprintf(line + pos, sizeof(line) - pos, "  CN: %" PRIu64, c->CardNumber);
+                if (f->Fields.hasIssueLevel)
+                    pos += snprintf(line + pos, sizeof(line) - pos, "  Issue: %u", c->IssueLevel);
+                if (f->Fields.hasOEMCode)
+                    pos += snprintf(line + pos, sizeof(line) - pos, "  OEM: %u", c->OEM);
+                if (f->Fields.hasParity)
+                    snprintf(line + pos, sizeof(line) - pos, "  parity: %s", c->ParityValid ? "valid" : "invalid");
+                HIDWriteLine(w, line);
+            }
+            break;
         }
-        ++i;
     }
-    if (result == false) {
-        PrintAndLogEx(SUCCESS, "Unknown. Bit len %d", packed->Length);
+    w->records++;
+}
+
+size_t HIDTryUnpackBatch(wiegand_message_t *packed, size_t count, bool ignore_parity, wiegand_writer_t *w) {
+    size_t decoded = 0;
+    wiegand_match_t matches[WIEGAND_MAX_MATCHES];
+    for (size_t i = 0; i < count; i++) {
+        int n = HIDUnpackMatches(&packed[i], ignore_parity, matches, ARRAYLEN(matches));
+        if (n)
+            decoded++;
+        HIDWriteRecord(w, &packed[i], matches, n);
+    }
+    return decoded;
+}
+
+#define WIEGAND_BATCH 1024
+
+// hexstring_to_u96 without a sscanf per digit, stops on the first non hex character
+static int HIDParseHex(const char *s, uint32_t *top, uint32_t *mid, uint32_t *bot) {
+    int i = 0;
+    for (; ; i++) {
+        uint32_t v;
+        char c = s[i];
+        if (c >= '0' && c <= '9')
+            v = c - '0';
+        else if (c >= 'a' && c <= 'f')
+            v = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            v = c - 'A' + 10;
+        else
+            break;
+
+        *top = (*top << 4) | (*mid >> 28);
+        *mid = (*mid << 4) | (*bot >> 28);
+        *bot = (*bot << 4) | v;
+    }
+    return i;
+}
+
+int HIDTryUnpackFile(const char *filename, bool ignore_parity, wiegand_outfmt_t fmt, const char *outfile) {
+
+    FILE *f = fopen(filename, "r");
+    if (f == NULL) {
+        PrintAndLogEx(ERR, "Error: Could not open file [" _YELLOW_("%s") "]", filename);
+        return PM3_EFILE;
+    }
+
+    wiegand_writer_t w = { .fmt = fmt, .out = NULL, .records = 0 };
+    if (outfile) {
+        w.out = fopen(outfile, "w");
+        if (w.out == NULL) {
+            PrintAndLogEx(ERR, "Error: Could not create file [" _YELLOW_("%s") "]", outfile);
+            fclose(f);
+            return PM3_EFILE;
+        }
+    }
+
+    wiegand_message_t *batch = calloc(WIEGAND_BATCH, sizeof(wiegand_message_t));
+    if (batch == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        if (w.out)
+            fclose(w.out);
+        fclose(f);
+        return PM3_EMALLOC;
+    }
+
+    if (fmt == WIEGAND_OUT_CSV)
+        HIDWriteLine(&w, "raw,bits,format,fc,cn,issue,oem,parity");
+    else if (fmt == WIEGAND_OUT_JSON)
+        HIDWriteLine(&w, "[");
+
+    size_t n = 0, total = 0, decoded = 0, skipped = 0;
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+
+        // overlong line, drop the rest of it
+        if (strchr(line, '\n') == NULL && feof(f) == 0) {
+            int c;
+            while ((c = fgetc(f)) != '\n' && c != EOF) {};
+            skipped++;
+            continue;
+        }
+
+        char *p = line;
+        while (*p == ' ' || *p == '\t')
+            p++;
+
+        if (*p == '#' || *p == '\r' || *p == '\n' || *p == '\0')
+            continue;
+
+        if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+            p += 2;
+
+        uint32_t top = 0, mid = 0, bot = 0;
+        int digits = HIDParseHex(p, &top, &mid, &bot);
+        if (digits == 0 || digits > 24) {
+            skipped++;
+            continue;
+        }
+
+        batch[n++] = initialize_message_object(top, mid, bot);
+        if (n == WIEGAND_BATCH) {
+            decoded += HIDTryUnpackBatch(batch, n, ignore_parity, &w);
+            total += n;
+            n = 0;
+        }
+    }
+    decoded += HIDTryUnpackBatch(batch, n, ignore_parity, &w);
+    total += n;
+
+    if (fmt == WIEGAND_OUT_JSON)
+        HIDWriteLine(&w, "]");
+
+    free(batch);
+    fclose(f);
+    if (w.out) {
+        fclose(w.out);
+        PrintAndLogEx(SUCCESS, "saved to " _YELLOW_("%s"), outfile);
     }
 
-    return result;
+    PrintAndLogEx(SUCCESS, "records " _YELLOW_("%zu") ", decoded " _GREEN_("%zu") ", unknown %zu, skipped lines %zu", total, decoded, total - decoded, skipped);
+    return PM3_SUCCESS;
 }
@@ -37,12 +37,43 @@ typedef struct {
     bool (*Unpack)(wiegand_message_t *packed, wiegand_card_t *card);
     const char *Descrp;
     cardformatdescriptor_t Fields;
+    uint8_t Bits;      // message length the Unpack function accepts
 } cardformat_t;
 
+// One format a raw credential decodes to
+typedef struct {
+    int format_idx;
+    wiegand_card_t card;
+} wiegand_match_t;
+
+typedef enum {
+    WIEGAND_OUT_TEXT,
+    WIEGAND_OUT_CSV,
+    WIEGAND_OUT_JSON,
+} wiegand_outfmt_t;
+
+// Streaming output of the batch decode
+typedef struct {
+    wiegand_outfmt_t fmt;
+    FILE *out;          // NULL, the console
+    size_t records;     // written so far
+} wiegand_writer_t;
+
+// most formats sharing one bit length
+#define WIEGAND_MAX_MATCHES 8
+
 void HIDListFormats(void);
 int HIDFindCardFormat(const char *format);
 cardformat_t HIDGetCardFormat(int idx);
 bool HIDPack(int format_idx, wiegand_card_t *card, wiegand_message_t *packed);
 bool HIDTryUnpack(wiegand_message_t *packed, bool ignore_parity);
 
+// Only the formats of the message bit length are tried. Fills up to max matches, returns how many
+int HIDUnpackMatches(wiegand_message_t *packed, bool ignore_parity, wiegand_match_t *matches, int max);
+// Decodes count messages in one call and streams the results to the writer. Returns how many decoded.
+// The CSV header and the JSON brackets are up to the caller, see HIDTryUnpackFile
+size_t HIDTryUnpackBatch(wiegand_message_t *packed, size_t count, bool ignore_parity, wiegand_writer_t *w);
+// One raw credential in hex per line, '#' comments. outfile NULL prints to the console
+int HIDTryUnpackFile(const char *filename, bool ignore_parity, wiegand_outfmt_t fmt, const char *outfile);
+
 #endif
@@ -73,6 +73,109 @@ void crypto1_get_lfsr(struct Crypto1State *state, uint64_t *lfsr) {
         *lfsr = *lfsr << 1 | BIT(state->even, i ^ 3);
     }
 }
+#ifdef WITH_CRYPTO1_TABLES
+/* Table driven stepping, WITH_CRYPTO1_TABLES
+ * filter() with its five nibble lookups merged into three: bits 4..3 of the index into
+ * 0xEC57E80A come from odd bits 0..7, bits 2..1 from bits 8..15, bit 0 from bits 16..19.
+ * The feedback parity folds to a byte for the OddByteParity table, and the state stays in
+ * locals for a whole byte or word: two clocks take turns on odd and even, no swap.
+ * 528 bytes of flash, no RAM.
+ */
+static const uint8_t crypto1_filter_lo[256] = {
+    0x00, 0x00, 0x10, 0x10, 0x00, 0x10, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x10, 0x10, 0x10, 0x10,
+    0x00, 0x00, 0x10, 0x10, 0x00, 0x10, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x10, 0x10, 0x10, 0x10,
+    0x00, 0x00, 0x10, 0x10, 0x00, 0x10, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x10, 0x10, 0x10, 0x10,
+    0x08, 0x08, 0x18, 0x18, 0x08, 0x18, 0x08, 0x08, 0x08, 0x18, 0x08, 0x08, 0x18, 0x18, 0x18, 0x18,
+    0x08, 0x08, 0x18, 0x18, 0x08, 0x18, 0x08, 0x08, 0x08, 0x18, 0x08, 0x08, 0x18, 0x18, 0x18, 0x18,
+    0x08, 0x08, 0x18, 0x18, 0x08, 0x18, 0x08, 0x08, 0x08, 0x18, 0x08, 0x08, 0x18, 0x18, 0x18, 0x18,
+    0x00, 0x00, 0x10, 0x10, 0x00, 0x10, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x10, 0x10, 0x10, 0x10,
+    0x00, 0x00, 0x10, 0x10, 0x00, 0x10, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x10, 0x10, 0x10, 0x10,
+    0x08, 0x08, 0x18, 0x18, 0x08, 0x18, 0x08, 0x08, 0x08, 0x18, 0x08, 0x08, 0x18, 0x18, 0x18, 0x18,
+    0x00, 0x00, 0x10, 0x10, 0x00, 0x10, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x10, 0x10, 0x10, 0x10,
+    0x00, 0x00, 0x10, 0x10, 0x00, 0x10, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x10, 0x10, 0x10, 0x10,
+    0x08, 0x08, 0x18, 0x18, 0x08, 0x18, 0x08, 0x08, 0x08, 0x18, 0x08, 0x08, 0x18, 0x18, 0x18, 0x18,
+    0x08, 0x08, 0x18, 0x18, 0x08, 0x18, 0x08, 0x08, 0x08, 0x18, 0x08, 0x08, 0x18, 0x18, 0x18, 0x18,
+    0x00, 0x00, 0x10, 0x10, 0x00, 0x10, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x10, 0x10, 0x10, 0x10,
+    0x08, 0x08, 0x18, 0x18, 0x08, 0x18, 0x08, 0x08, 0x08, 0x18, 0x08, 0x08, 0x18, 0x18, 0x18, 0x18,
+    0x08, 0x08, 0x18, 0x18, 0x08, 0x18, 0x08, 0x08, 0x08, 0x18, 0x08, 0x08, 0x18, 0x18, 0x18, 0x18
+};
+
+static const uint8_t crypto1_filter_mid[256] = {
+    0x00, 0x00, 0x04, 0x04, 0x00, 0x04, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x04, 0x04, 0x04, 0x04,
+    0x00, 0x00, 0x04, 0x04, 0x00, 0x04, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x04, 0x04, 0x04, 0x04,
+    0x02, 0x02, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x02, 0x06, 0x02, 0x02, 0x06, 0x06, 0x06, 0x06,
+    0x02, 0x02, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x02, 0x06, 0x02, 0x02, 0x06, 0x06, 0x06, 0x06,
+    0x00, 0x00, 0x04, 0x04, 0x00, 0x04, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x04, 0x04, 0x04, 0x04,
+    0x02, 0x02, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x02, 0x06, 0x02, 0x02, 0x06, 0x06, 0x06, 0x06,
+    0x00, 0x00, 0x04, 0x04, 0x00, 0x04, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x04, 0x04, 0x04, 0x04,
+    0x00, 0x00, 0x04, 0x04, 0x00, 0x04, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x04, 0x04, 0x04, 0x04,
+    0x00, 0x00, 0x04, 0x04, 0x00, 0x04, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x04, 0x04, 0x04, 0x04,
+    0x02, 0x02, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x02, 0x06, 0x02, 0x02, 0x06, 0x06, 0x06, 0x06,
+    0x00, 0x00, 0x04, 0x04, 0x00, 0x04, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x04, 0x04, 0x04, 0x04,
+    0x00, 0x00, 0x04, 0x04, 0x00, 0x04, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x04, 0x04, 0x04, 0x04,
+    0x02, 0x02, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x02, 0x06, 0x02, 0x02, 0x06, 0x06, 0x06, 0x06,
+    0x02, 0x02, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x02, 0x06, 0x02, 0x02, 0x06, 0x06, 0x06, 0x06,
+    0x02, 0x02, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x02, 0x06, 0x02, 0x02, 0x06, 0x06, 0x06, 0x06,
+    0x02, 0x02, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x02, 0x06, 0x02, 0x02, 0x06, 0x06, 0x06, 0x06
+};
+
+static const uint8_t crypto1_filter_hi[16] = {
+    0x00, 0x00, 0x00, 0x01, 0x01, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x01, 0x01, 0x00, 0x01, 0x01
+};
+
+#define FILTER_TAB(x) BIT(0xEC57E80A, crypto1_filter_lo[(x) & 0xff] | crypto1_filter_mid[(x) >> 8 & 0xff] | crypto1_filter_hi[(x) >> 16 & 0xf])
+
+static inline uint32_t feedback_parity(uint32_t x) {
+    x ^= x >> 16;
+    x ^= x >> 8;
+    return evenparity8(x);
+}
+
+// one clock, the keystream bit of odd o goes to ret, the feedback into even e
+#define CRYPTO1_STEP(o, e, in, enc, ret) { \
+    ret = FILTER_TAB(o); \
+    uint32_t fb_ = (ret & (enc)) ^ (in) ^ (o & LF_POLY_ODD) ^ (e & LF_POLY_EVEN); \
+    e = e << 1 | feedback_parity(fb_); \
+}
+
+uint8_t crypto1_bit(struct Crypto1State *s, uint8_t in, int is_encrypted) {
+    uint32_t o = s->odd, e = s->even;
+    uint8_t ret;
+    CRYPTO1_STEP(o, e, !!in, !!is_encrypted, ret);
+    s->odd = e;
+    s->even = o;
+    return ret;
+}
+uint8_t crypto1_byte(struct Crypto1State *s, uint8_t in, int is_encrypted) {
+    uint32_t o = s->odd, e = s->even;
+    uint8_t enc = !!is_encrypted;
+    uint8_t ret = 0, b;
+    for (uint8_t i = 0; i < 8; i += 2) {
+        CRYPTO1_STEP(o, e, BIT(in, i), enc, b);
+        ret |= b << i;
+        CRYPTO1_STEP(e, o, BIT(in, i + 1), enc, b);
+        ret |= b << (i + 1);
+    }
+    s->odd = o;
+    s->even = e;
+    return ret;
+}
+uint32_t crypto1_word(struct Crypto1State *s, uint32_t in, int is_encrypted) {
+    uint32_t o = s->odd, e = s->even;
+    uint8_t enc = !!is_encrypted;
+    uint32_t ret = 0;
+    uint8_t b;
+    for (uint8_t i = 0; i < 32; i += 2) {
+        CRYPTO1_STEP(o, e, BEBIT(in, i), enc, b);
+        ret |= (uint32_t)b << (24 ^ i);
+        CRYPTO1_STEP(e, o, BEBIT(in, i + 1), enc, b);
+        ret |= (uint32_t)b << (24 ^ (i + 1));
+    }
+    s->odd = o;
+    s->even = e;
+    return ret;
+}
+#else
 uint8_t crypto1_bit(struct Crypto1State *s, uint8_t in, int is_encrypted) {
     uint32_t feedin, t;
     uint8_t ret = filter(s->odd);
@@ -143,6 +246,8 @@ uint32_t crypto1_word(struct Crypto1State *s, uint32_t in, int is_encrypted) {
     return ret;
 }
 
+#endif
+
 /* prng_successor
  * helper used to obscure the keystream during authentication
  */
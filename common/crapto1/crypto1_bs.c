@@ -0,0 +1,147 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Bitsliced crypto1, clocks a whole list of states with the same inputs
+//
+// The state is kept as a stream of bit planes, plane i holds lfsr bit i of
+// every state. Odd bit j of the scalar state is the newest bit minus 2j, even
+// bit j the newest bit minus 2j + 1, so clocking forward or rolling back only
+// writes one plane.
+//
+// Filter subfunctions are the same as in the hardnested brute forcer, sourced
+// from ``Wirelessly Pickpocketing a Mifare Classic Card'' by Flavio Garcia,
+// Peter van Rossum, Roel Verdult and Ronny Wichers Schreur
+//-----------------------------------------------------------------------------
+
+#include "crypto1_bs.h"
+
+#include <string.h>
+
+#if ( defined (__i386__) || defined (__x86_64__) ) && \
+    ( !defined(__APPLE__) || \
+      (defined(__APPLE__) && (__clang_major__ > 8 || __clang_major__ == 8 && __clang_minor__ >= 1)) )
+#  define CRYPTO1_BS_X86
+#  if ((__GNUC__ >= 5) && (__GNUC__ > 5 || __GNUC_MINOR__ > 2))
+#    define CRYPTO1_BS_AVX512
+#  endif
+#endif
+
+#define f20a(a,b,c,d) (((a|b)^(a&d))^(c&((a^b)|d)))
+#define f20b(a,b,c,d) (((a&b)|c)^((a^b)&(c|d)))
+#define f20c(a,b,c,d,e) ((a|((b|e)&(d^e)))^((a^(b&d))&((c^d)|(b&e))))
+
+// filter() of the state whose newest bit is X(b)
+#define BS_FILTER(out, b) do { \
+        vec_t g4_ = f20a(X(b + 38), X(b + 36), X(b + 34), X(b + 32)); \
+        vec_t g3_ = f20b(X(b + 30), X(b + 28), X(b + 26), X(b + 24)); \
+        vec_t g2_ = f20b(X(b + 22), X(b + 20), X(b + 18), X(b + 16)); \
+        vec_t g1_ = f20a(X(b + 14), X(b + 12), X(b + 10), X(b +  8)); \
+        vec_t g0_ = f20b(X(b +  6), X(b +  4), X(b +  2), X(b +  0)); \
+        out = f20c(g4_, g3_, g2_, g1_, g0_); \
+    } while (0)
+
+// LF_POLY_ODD and LF_POLY_EVEN taps, without the oldest bit (even bit 23)
+#define BS_FEEDBACK(b) ( \
+        X(b +  4) ^ X(b +  6) ^ X(b +  8) ^ X(b + 12) ^ X(b + 18) ^ X(b + 20) ^ \
+        X(b + 22) ^ X(b + 28) ^ X(b + 30) ^ X(b + 32) ^ X(b + 38) ^ X(b + 42) ^ \
+        X(b +  5) ^ X(b + 23) ^ X(b + 33) ^ X(b + 35) ^ X(b + 37))
+
+typedef int32_t crypto1_bs_kernel_t(const struct Crypto1State *, uint32_t, const crypto1_bs_op_t *, uint8_t, uint32_t *);
+
+#if defined(CRYPTO1_BS_X86)
+
+#if defined(CRYPTO1_BS_AVX512)
+#define BS_BYTES 64
+#define BS_NAME(x) x##_AVX512
+#define BS_TARGET __attribute__((target("avx512f")))
+#include "crypto1_bs_kernel.h"
+#undef BS_BYTES
+#undef BS_NAME
+#undef BS_TARGET
+#endif
+
+#define BS_BYTES 32
+#define BS_NAME(x) x##_AVX2
+#define BS_TARGET __attribute__((target("avx2")))
+#include "crypto1_bs_kernel.h"
+#undef BS_BYTES
+#undef BS_NAME
+#undef BS_TARGET
+
+#define BS_BYTES 16
+#define BS_NAME(x) x##_SSE2
+#define BS_TARGET __attribute__((target("sse2")))
+#include "crypto1_bs_kernel.h"
+#undef BS_BYTES
+#undef BS_NAME
+#undef BS_TARGET
+
+#define BS_BYTES 8
+#define BS_NAME(x) x##_NOSIMD
+#define BS_TARGET
+#include "crypto1_bs_kernel.h"
+#undef BS_BYTES
+#undef BS_NAME
+#undef BS_TARGET
+
+#else
+
+// NEON on arm64, whatever the compiler makes of it elsewhere
+#define BS_BYTES 16
+#define BS_NAME(x) x##_GENERIC
+#define BS_TARGET
+#include "crypto1_bs_kernel.h"
+#undef BS_BYTES
+#undef BS_NAME
+#undef BS_TARGET
+
+#endif
+
+static crypto1_bs_kernel_t *kernel_p = NULL;
+static const char *kernel_name = NULL;
+
+// determine the available instruction set at runtime, once
+static crypto1_bs_kernel_t *crypto1_bs_get_kernel(void) {
+
+    if (kernel_p)
+        return kernel_p;
+
+#if defined(CRYPTO1_BS_X86)
+#if defined(CRYPTO1_BS_AVX512)
+    if (__builtin_cpu_supports("avx512f")) {
+        kernel_name = "AVX512";
+        kernel_p = crypto1_bs_kernel_AVX512;
+    } else
+#endif
+        if (__builtin_cpu_supports("avx2")) {
+            kernel_name = "AVX2";
+            kernel_p = crypto1_bs_kernel_AVX2;
+        } else if (__builtin_cpu_supports("sse2")) {
+            kernel_name = "SSE2";
+            kernel_p = crypto1_bs_kernel_SSE2;
+        } else {
+            kernel_name = "no SIMD";
+            kernel_p = crypto1_bs_kernel_NOSIMD;
+        }
+#else
+    kernel_name = "generic";
+    kernel_p = crypto1_bs_kernel_GENERIC;
+#endif
+    return kernel_p;
+}
+
+int32_t crypto1_bs_find(const struct Crypto1State *states, uint32_t count, const crypto1_bs_op_t *ops, uint8_t n_ops) {
+    return crypto1_bs_get_kernel()(states, count, ops, n_ops, NULL);
+}
+
+void crypto1_bs_run(const struct Crypto1State *states, uint32_t count, const crypto1_bs_op_t *ops, uint8_t n_ops, uint32_t *ks) {
+    memset(ks, 0, (size_t)count * n_ops * sizeof(uint32_t));
+    crypto1_bs_get_kernel()(states, count, ops, n_ops, ks);
+}
+
+const char *crypto1_bs_simd(void) {
+    crypto1_bs_get_kernel();
+    return kernel_name;
+}
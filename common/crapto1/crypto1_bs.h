@@ -0,0 +1,40 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Bitsliced crypto1, clocks a whole list of states with the same inputs
+//
+// Every bit of a vector is one state, the width is picked at runtime
+// (AVX512, AVX2, SSE2 on x86, 128 bit generic vectors, i.e. NEON, elsewhere).
+//-----------------------------------------------------------------------------
+
+#ifndef CRYPTO1_BS_H__
+#define CRYPTO1_BS_H__
+
+#include <stdint.h>
+#include "crapto1.h"
+
+#define CRYPTO1_BS_FORWARD  0   // crypto1_word()
+#define CRYPTO1_BS_ROLLBACK 1   // lfsr_rollback_word()
+
+// one 32 bit word of the program run over every state
+typedef struct {
+    uint8_t dir;        // CRYPTO1_BS_FORWARD or CRYPTO1_BS_ROLLBACK
+    uint8_t fb;         // is_encrypted
+    uint8_t check;      // keystream word must be equal to ks
+    uint32_t in;
+    uint32_t ks;
+} crypto1_bs_op_t;
+
+// Returns the index of the first state whose keystream matches every checked
+// word, -1 if none does. The states are left untouched.
+int32_t crypto1_bs_find(const struct Crypto1State *states, uint32_t count, const crypto1_bs_op_t *ops, uint8_t n_ops);
+
+// Stores the keystream of every word for every state, ks[i * n_ops + op].
+void crypto1_bs_run(const struct Crypto1State *states, uint32_t count, const crypto1_bs_op_t *ops, uint8_t n_ops, uint32_t *ks);
+
+// name of the instruction set in use
+const char *crypto1_bs_simd(void);
+
+#endif
@@ -0,0 +1,103 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Bitsliced crypto1 kernel, included by crypto1_bs.c once per instruction set
+// with BS_BYTES (vector size), BS_NAME(x) (suffixed identifier) and BS_TARGET
+// (function attribute) defined.
+//-----------------------------------------------------------------------------
+
+#define BS_LANES (BS_BYTES * 8)
+
+typedef uint32_t BS_NAME(bs_vec_t) __attribute__((vector_size(BS_BYTES)));
+typedef union {
+    BS_NAME(bs_vec_t) v;
+    uint64_t w[BS_BYTES / 8];
+} BS_NAME(bs_t);
+
+BS_TARGET
+static int32_t BS_NAME(crypto1_bs_kernel)(const struct Crypto1State *states, uint32_t count, const crypto1_bs_op_t *ops, uint8_t n_ops, uint32_t *ks) {
+
+    typedef BS_NAME(bs_vec_t) vec_t;
+    const vec_t zero = {0};
+    const vec_t ones = ~zero;
+
+    // the last 64 bits of the lfsr stream, x[n & 63] is the newest bit
+    BS_NAME(bs_t) x[64];
+    BS_NAME(bs_t) alive;
+
+    for (uint32_t base = 0; base < count; base += BS_LANES) {
+
+        uint32_t lanes = (count - base < BS_LANES) ? count - base : BS_LANES;
+        uint32_t n = 47;
+
+        memset(x, 0, sizeof(x));
+        memset(&alive, 0, sizeof(alive));
+        for (uint32_t i = 0; i < lanes; i++) {
+            uint64_t odd = states[base + i].odd;
+            uint64_t even = states[base + i].even;
+            for (uint32_t j = 0; j < 24; j++) {
+                x[(n - 2 * j) & 63].w[i >> 6] |= BIT(odd, j) << (i & 63);
+                x[(n - 2 * j - 1) & 63].w[i >> 6] |= BIT(even, j) << (i & 63);
+            }
+            alive.w[i >> 6] |= 1ULL << (i & 63);
+        }
+
+        for (uint8_t k = 0; k < n_ops; k++) {
+            const crypto1_bs_op_t *op = &ops[k];
+            const vec_t fb = op->fb ? ones : zero;
+
+            for (int i = 0; i < 32; i++) {
+                // crypto1_word and lfsr_rollback_word walk the word in opposite order
+                int bit = ((op->dir == CRYPTO1_BS_FORWARD) ? i : 31 - i) ^ 24;
+                const vec_t in = BIT(op->in, bit) ? ones : zero;
+                BS_NAME(bs_t) out;
+
+#define X(k) (x[(n - (k)) & 63].v)
+                if (op->dir == CRYPTO1_BS_FORWARD) {
+                    BS_FILTER(out.v, 0);
+                    x[(n + 1) & 63].v = BS_FEEDBACK(0) ^ X(47) ^ in ^ (out.v & fb);
+                    n++;
+                } else {
+                    BS_FILTER(out.v, 1);
+                    x[(n - 48) & 63].v = BS_FEEDBACK(1) ^ X(0) ^ in ^ (out.v & fb);
+                    n--;
+                }
+#undef X
+
+                if (ks) {
+                    for (uint32_t l = 0; l < lanes; l++) {
+                        if (BIT(out.w[l >> 6], l & 63))
+                            ks[(base + l) * n_ops + k] |= 1U << bit;
+                    }
+                }
+
+                if (op->check) {
+                    alive.v &= ~(out.v ^ (BIT(op->ks, bit) ? ones : zero));
+
+                    // all states out, next batch
+                    if ((i & 3) == 3 && ks == NULL) {
+                        uint64_t any = 0;
+                        for (int w = 0; w < BS_BYTES / 8; w++)
+                            any |= alive.w[w];
+                        if (any == 0)
+                            goto next;
+                    }
+                }
+            }
+        }
+
+        if (ks == NULL) {
+            for (uint32_t l = 0; l < lanes; l++) {
+                if (BIT(alive.w[l >> 6], l & 63))
+                    return base + l;
+            }
+        }
+next:
+        ;
+    }
+    return -1;
+}
+
+#undef BS_LANES
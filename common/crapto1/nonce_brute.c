@@ -0,0 +1,285 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Key recovery of a sniffed nested authentication of a card with a weak prng
+//
+// The parity bit of a byte is encrypted with the keystream bit of the first
+// bit of the next byte, so with the encrypted bits known, every parity bit
+// sniffed tells one bit of the plain text nt, ar and at. 10 of them for a
+// real nonce, it leaves 1 / 1024 of the 65536 nonces to recover the state for.
+//-----------------------------------------------------------------------------
+
+#include "nonce_brute.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#include "crapto1.h"
+#include "crypto1_bs.h"
+#include "parity.h"
+
+#define NONCE_BRUTE_CHUNK_SIZE  (0x10000 / (NONCE_BRUTE_CHUNKS / 2))
+#define NONCE_BRUTE_MAGIC       0x3142524E  // "NRB1"
+
+// the checkpoint file
+typedef struct {
+    uint32_t magic;
+    uint32_t params[8];
+    uint8_t done[NONCE_BRUTE_CHUNKS / 8];
+} nonce_brute_checkpoint_t;
+
+typedef struct {
+    const nonce_brute_params_t *p;
+    const char *checkpoint;
+    nonce_brute_cb_t cb;
+    void *arg;
+    pthread_mutex_t lock;
+    nonce_brute_checkpoint_t cp;
+    uint8_t resumed[NONCE_BRUTE_CHUNKS / 8];    // done before this run
+    uint32_t next;
+    uint32_t searched;
+    bool stop;
+} nonce_brute_ctx_t;
+
+uint8_t nonce_brute_parity(uint32_t data, uint16_t par_err) {
+    uint8_t par = 0;
+    for (int i = 0; i < 4; i++) {
+        par <<= 1;
+        par |= oddparity8(data >> (24 - 8 * i)) ^ ((par_err >> (12 - 4 * i)) & 1);
+    }
+    return par << 4;
+}
+
+// byte i of plain, its parity bit and the first bit of the next byte went out
+// with the same keystream bit
+static bool parity_ok(uint8_t byte, uint8_t next, uint8_t par, int i, uint32_t enc_next) {
+    return (oddparity8(byte) ^ (next & 1) ^ ((par >> (7 - i)) & 1) ^ (enc_next & 1)) == 0;
+}
+
+static bool check_word(uint32_t plain, uint32_t enc, uint8_t par, int from) {
+    for (int i = from; i < 3; i++) {
+        if (parity_ok(plain >> (24 - 8 * i), plain >> (16 - 8 * i), par, i, enc >> (16 - 8 * i)) == false)
+            return false;
+    }
+    return true;
+}
+
+// 0 not a candidate, 1 candidate, 2 candidate with the whole nt parity right
+static int candidate_nonce(const nonce_brute_params_t *p, uint32_t nt) {
+    uint32_t ar = prng_successor(nt, 64);
+    uint32_t at = prng_successor(nt, 96);
+
+    if (check_word(nt, p->nt_enc, p->nt_par, 2) == false)
+        return 0;
+    if (check_word(ar, p->ar_enc, p->ar_par, 0) == false)
+        return 0;
+    if (parity_ok(ar, at >> 24, p->ar_par, 3, p->at_enc >> 24) == false)
+        return 0;
+    if (check_word(at, p->at_enc, p->at_par, 0) == false)
+        return 0;
+
+    return check_word(nt, p->nt_enc, p->nt_par, 0) ? 2 : 1;
+}
+
+// cmd + arg of the 4 bytes, followed by their crc_a
+static bool check_cmd_crc(uint32_t dec) {
+    uint16_t crc = 0x6363;
+    for (int i = 0; i < 2; i++) {
+        uint8_t b = (dec >> (24 - 8 * i)) ^ (crc & 0xFF);
+        b ^= b << 4;
+        crc = (crc >> 8) ^ ((uint16_t)b << 8) ^ ((uint16_t)b << 3) ^ (b >> 4);
+    }
+    return (crc & 0xFF) == ((dec >> 8) & 0xFF) && (crc >> 8) == (dec & 0xFF);
+}
+
+static void save_checkpoint(const nonce_brute_ctx_t *ctx) {
+    FILE *f = fopen(ctx->checkpoint, "wb");
+    if (f == NULL)
+        return;
+    fwrite(&ctx->cp, sizeof(ctx->cp), 1, f);
+    fclose(f);
+}
+
+static void load_checkpoint(nonce_brute_ctx_t *ctx) {
+    FILE *f = fopen(ctx->checkpoint, "rb");
+    if (f == NULL)
+        return;
+
+    nonce_brute_checkpoint_t cp;
+    if (fread(&cp, sizeof(cp), 1, f) == 1 && cp.magic == ctx->cp.magic && memcmp(cp.params, ctx->cp.params, sizeof(cp.params)) == 0)
+        memcpy(ctx->cp.done, cp.done, sizeof(cp.done));
+    fclose(f);
+}
+
+static bool chunk_done(const uint8_t *done, uint32_t chunk) {
+    return (done[chunk / 8] >> (chunk % 8)) & 1;
+}
+
+static void search_chunk(nonce_brute_ctx_t *ctx, uint32_t chunk, struct Crypto1State *states, uint32_t *nts, uint32_t *ks4s) {
+    const nonce_brute_params_t *p = ctx->p;
+    uint32_t n = 0;
+
+    // a chunk of the first half takes the whole nt parity, one of the second the others
+    int kind = (chunk < NONCE_BRUTE_CHUNKS / 2) ? 2 : 1;
+    uint32_t first = (chunk % (NONCE_BRUTE_CHUNKS / 2)) * NONCE_BRUTE_CHUNK_SIZE;
+
+    for (uint32_t i = 0; i < NONCE_BRUTE_CHUNK_SIZE; i++) {
+        uint32_t count = first + i;
+        uint32_t nt = count << 16 | prng_successor(count, 16);
+
+        if (candidate_nonce(p, nt) != kind)
+            continue;
+
+        uint32_t p64 = prng_successor(nt, 64);
+        struct Crypto1State *revstate = lfsr_recovery64(p->ar_enc ^ p64, p->at_enc ^ prng_successor(p64, 32));
+        if (revstate == NULL)
+            continue;
+        // ks2 and ks3 of a wrong nonce are not a keystream at all, no state gives them
+        bool recovered = (revstate->odd || revstate->even);
+        states[n] = *revstate;
+        free(revstate);
+        if (recovered == false)
+            continue;
+        nts[n] = nt;
+        n++;
+    }
+
+    // keystream of the next command for all candidates at once
+    if (p->has_cmd && n) {
+        const crypto1_bs_op_t ks4_op = { CRYPTO1_BS_FORWARD, 0, 0, 0, 0 };
+        crypto1_bs_run(states, n, &ks4_op, 1, ks4s);
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+        if (p->has_cmd) {
+            if (check_cmd_crc(ks4s[i] ^ p->cmd_enc) == false)
+                continue;
+        }
+
+        nonce_brute_result_t res;
+        res.cmd = (p->has_cmd) ? ks4s[i] ^ p->cmd_enc : 0;
+        res.nt = nts[i];
+        res.ev1 = (kind != 2);
+        uint32_t p64 = prng_successor(res.nt, 64);
+        res.ks2 = p->ar_enc ^ p64;
+        res.ks3 = p->at_enc ^ prng_successor(p64, 32);
+
+        // the state is at the end of at, roll it back to the key
+        struct Crypto1State *s = &states[i];
+        lfsr_rollback_word(s, 0, 0);
+        lfsr_rollback_word(s, 0, 0);
+        lfsr_rollback_word(s, p->nr_enc, 1);
+        lfsr_rollback_word(s, p->uid ^ res.nt, 0);
+        crypto1_get_lfsr(s, &res.key);
+
+        pthread_mutex_lock(&ctx->lock);
+        if (ctx->stop == false && ctx->cb(&res, ctx->arg))
+            ctx->stop = true;
+        pthread_mutex_unlock(&ctx->lock);
+    }
+}
+
+static void *nonce_brute_thread(void *arg) {
+    nonce_brute_ctx_t *ctx = (nonce_brute_ctx_t *)arg;
+
+    struct Crypto1State states[NONCE_BRUTE_CHUNK_SIZE];
+    uint32_t nts[NONCE_BRUTE_CHUNK_SIZE];
+    uint32_t ks4s[NONCE_BRUTE_CHUNK_SIZE];
+
+    for (;;) {
+        uint32_t chunk = __atomic_fetch_add(&ctx->next, 1, __ATOMIC_RELAXED);
+        if (chunk >= NONCE_BRUTE_CHUNKS || __atomic_load_n(&ctx->stop, __ATOMIC_RELAXED))
+            break;
+        if (chunk_done(ctx->resumed, chunk))
+            continue;
+
+        search_chunk(ctx, chunk, states, nts, ks4s);
+
+        pthread_mutex_lock(&ctx->lock);
+        ctx->cp.done[chunk / 8] |= 1 << (chunk % 8);
+        ctx->searched++;
+        if (ctx->checkpoint)
+            save_checkpoint(ctx);
+        pthread_mutex_unlock(&ctx->lock);
+    }
+    return NULL;
+}
+
+static int cpu_count(void) {
+#if defined(_WIN32)
+    SYSTEM_INFO sysinfo;
+    GetSystemInfo(&sysinfo);
+    return sysinfo.dwNumberOfProcessors;
+#else
+    return sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+}
+
+int nonce_brute_run(const nonce_brute_params_t *p, int threads, const char *checkpoint, nonce_brute_cb_t cb, void *arg) {
+    nonce_brute_ctx_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.p = p;
+    ctx.checkpoint = checkpoint;
+    ctx.cb = cb;
+    ctx.arg = arg;
+
+    ctx.cp.magic = NONCE_BRUTE_MAGIC;
+    const uint32_t params[] = { p->uid, p->nt_enc, p->nr_enc, p->ar_enc, p->at_enc,
+                                p->nt_par << 16 | p->ar_par << 8 | p->at_par, p->has_cmd, p->cmd_enc
+                              };
+    memcpy(ctx.cp.params, params, sizeof(ctx.cp.params));
+    if (checkpoint)
+        load_checkpoint(&ctx);
+    memcpy(ctx.resumed, ctx.cp.done, sizeof(ctx.resumed));
+
+    if (threads <= 0)
+        threads = cpu_count();
+    if (threads < 1)
+        threads = 1;
+    if (threads > NONCE_BRUTE_CHUNKS)
+        threads = NONCE_BRUTE_CHUNKS;
+
+    // the bitsliced kernel is picked on first use, do it before the threads start
+    crypto1_bs_simd();
+
+    if (pthread_mutex_init(&ctx.lock, NULL) != 0)
+        return -1;
+
+    pthread_t *thread_id = calloc(threads, sizeof(pthread_t));
+    if (thread_id == NULL) {
+        pthread_mutex_destroy(&ctx.lock);
+        return -1;
+    }
+
+    int started = 0;
+    for (; started < threads; started++) {
+        if (pthread_create(&thread_id[started], NULL, nonce_brute_thread, &ctx) != 0)
+            break;
+    }
+    // no thread at all, do it here
+    if (started == 0)
+        nonce_brute_thread(&ctx);
+
+    for (int i = 0; i < started; i++)
+        pthread_join(thread_id[i], NULL);
+
+    free(thread_id);
+    pthread_mutex_destroy(&ctx.lock);
+
+    if (checkpoint) {
+        bool all = true;
+        for (uint32_t i = 0; i < NONCE_BRUTE_CHUNKS && all; i++)
+            all = chunk_done(ctx.cp.done, i);
+        if (all)
+            remove(checkpoint);
+    }
+    return ctx.searched;
+}
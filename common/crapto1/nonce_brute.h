@@ -0,0 +1,64 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Key recovery of a sniffed nested authentication of a card with a weak prng
+//
+// The tag nonce is one of the 65536 the prng gives out. Each one is checked
+// against the parity bits of the encrypted nt, ar and at, the state at the
+// end of the auth is recovered for the few left, and rolled back to the key.
+// Threads pull chunks of nonces as they go, done chunks can be kept in a
+// checkpoint file to resume a run later.
+//-----------------------------------------------------------------------------
+
+#ifndef NONCE_BRUTE_H__
+#define NONCE_BRUTE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// the search is split in this many chunks, the nonces with the whole nt parity
+// right in the first half, the possible Ev1 ones in the second
+#define NONCE_BRUTE_CHUNKS  512
+
+typedef struct {
+    uint32_t uid;
+    uint32_t nt_enc;    // encrypted tag nonce
+    uint32_t nr_enc;    // encrypted reader challenge
+    uint32_t ar_enc;    // encrypted reader response
+    uint32_t at_enc;    // encrypted tag response
+    // parity bits as sniffed, first byte in bit 7 like the trace
+    uint8_t nt_par;
+    uint8_t ar_par;
+    uint8_t at_par;
+    // the 4 bytes of the next command, cmd + arg + crc, must decrypt to a valid crc
+    bool has_cmd;
+    uint32_t cmd_enc;
+} nonce_brute_params_t;
+
+typedef struct {
+    uint64_t key;
+    uint32_t nt;
+    uint32_t ks2;       // keystream of ar
+    uint32_t ks3;       // keystream of at
+    uint32_t cmd;       // the next command decrypted, when has_cmd
+    // parity of the first 2 bytes of nt don't fit, a card like the Ev1 which
+    // sends them wrong, the key is only a candidate
+    bool ev1;
+} nonce_brute_result_t;
+
+// Called under a lock for each key, return true to stop the search
+typedef bool (*nonce_brute_cb_t)(const nonce_brute_result_t *res, void *arg);
+
+// parity of the 4 bytes of data in the trace format, par_err has a 1 for each
+// wrong parity bit, one hex digit per byte (e.g. 0x1011)
+uint8_t nonce_brute_parity(uint32_t data, uint16_t par_err);
+
+// Runs the search with threads threads (0 = one per cpu). checkpoint is the
+// file the done chunks are kept in, or NULL. A checkpoint of the same params
+// is resumed, the file is deleted once the whole nonce space is done.
+// Returns the number of chunks searched in this run, -1 on error
+int nonce_brute_run(const nonce_brute_params_t *p, int threads, const char *checkpoint, nonce_brute_cb_t cb, void *arg);
+
+#endif
@@ -10,7 +10,24 @@
 #include <string.h>
 #include "commonutil.h"
 
+#ifdef ON_DEVICE
 static uint16_t crc_table[256];
+#else
+// On the host every polynomial / refin pair keeps its own slice-by-8 tables, so switching
+// between CRC types, ie trace annotation of mixed protocols, doesn't regenerate anything.
+// crc_table points at the byte table of the current pair
+#define CRC16_TABLE_SLOTS   4
+typedef struct {
+    bool used;
+    uint16_t polynomial;
+    bool refin;
+    uint16_t t[8][256];
+} crc16_tables_t;
+
+static crc16_tables_t crc16_tables[CRC16_TABLE_SLOTS];
+static crc16_tables_t *crc_tables = NULL;
+static uint16_t *crc_table = NULL;
+#endif
 static bool crc_table_init = false;
 static CrcType_t current_crc_type = CRC_NONE;
 
@@ -57,8 +74,42 @@ void init_table(CrcType_t crctype) {
     }
 }
 
+#ifndef ON_DEVICE
+static void generate_slices(crc16_tables_t *ct) {
+    for (int t = 1; t < 8; t++) {
+        for (int i = 0; i < 256; i++) {
+            uint16_t c = ct->t[t - 1][i];
+            if (ct->refin)
+                ct->t[t][i] = (c >> 8) ^ ct->t[0][c & 0xFF];
+            else
+                ct->t[t][i] = (c << 8) ^ ct->t[0][c >> 8];
+        }
+    }
+}
+#endif
+
 void generate_table(uint16_t polynomial, bool refin) {
 
+#ifndef ON_DEVICE
+    crc16_tables_t *slot = NULL;
+    for (int i = 0; i < CRC16_TABLE_SLOTS; i++) {
+        if (crc16_tables[i].used && crc16_tables[i].polynomial == polynomial && crc16_tables[i].refin == refin) {
+            crc_tables = &crc16_tables[i];
+            crc_table = crc_tables->t[0];
+            crc_table_init = true;
+            return;
+        }
+        if (slot == NULL && crc16_tables[i].used == false)
+            slot = &crc16_tables[i];
+    }
+    // all slots taken, recycle the last one
+    if (slot == NULL)
+        slot = &crc16_tables[CRC16_TABLE_SLOTS - 1];
+    slot->used = false;
+    crc_tables = slot;
+    crc_table = slot->t[0];
+#endif
+
     for (uint16_t i = 0; i < 256; i++) {
         uint16_t c, crc = 0;
         if (refin)
@@ -80,11 +131,23 @@ void generate_table(uint16_t polynomial, bool refin) {
 
         crc_table[i] = crc;
     }
+#ifndef ON_DEVICE
+    slot->polynomial = polynomial;
+    slot->refin = refin;
+    generate_slices(slot);
+    slot->used = true;
+#endif
     crc_table_init = true;
 }
 
 void reset_table(void) {
+#ifdef ON_DEVICE
     memset(crc_table, 0, sizeof(crc_table));
+#else
+    // the cached tables stay valid, only forget which one is current
+    crc_tables = NULL;
+    crc_table = NULL;
+#endif
     crc_table_init = false;
     current_crc_type = CRC_NONE;
 }
@@ -102,6 +165,30 @@ uint16_t crc16_fast(uint8_t const *d, size_t n, uint16_t initval, bool refin, bo
     if (refin)
         crc = reflect16(crc);
 
+#ifndef ON_DEVICE
+    // the crc16_xxx helpers can be called before any init_table()
+    if (crc_tables == NULL)
+        generate_table(CRC16_POLY_CCITT, refin);
+
+    const uint16_t (*t)[256] = (const uint16_t (*)[256])crc_tables->t;
+    // slice-by-8, the 16 bit register only overlaps the first two bytes of every block.
+    // A table of the other direction stays on the byte loop, as before
+    bool sliced = (refin == crc_tables->refin);
+    if (sliced && !refin) {
+        for (; n >= 8; n -= 8, d += 8) {
+            uint8_t b0 = d[0] ^ (crc >> 8);
+            uint8_t b1 = d[1] ^ (crc & 0xFF);
+            crc = t[7][b0] ^ t[6][b1] ^ t[5][d[2]] ^ t[4][d[3]] ^ t[3][d[4]] ^ t[2][d[5]] ^ t[1][d[6]] ^ t[0][d[7]];
+        }
+    } else if (sliced) {
+        for (; n >= 8; n -= 8, d += 8) {
+            uint8_t b0 = d[0] ^ (crc & 0xFF);
+            uint8_t b1 = d[1] ^ (crc >> 8);
+            crc = t[7][b0] ^ t[6][b1] ^ t[5][d[2]] ^ t[4][d[3]] ^ t[3][d[4]] ^ t[2][d[5]] ^ t[1][d[6]] ^ t[0][d[7]];
+        }
+    }
+#endif
+
     if (!refin)
         while (n--) crc = (crc << 8) ^ crc_table[((crc >> 8) ^ *d++) & 0xFF ];
     else
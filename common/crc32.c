@@ -1,7 +1,6 @@
 #include "crc32.h"
 
 #define htole32(x) (x)
-#define CRC32_PRESET 0xFFFFFFFF
 
 static void crc32_byte(uint32_t *crc, const uint8_t value);
 
@@ -18,17 +17,253 @@ static void crc32_byte(uint32_t *crc, const uint8_t value) {
     }
 }
 
-void crc32_ex(const uint8_t *data, const size_t len, uint8_t *crc) {
-    uint32_t desfire_crc = CRC32_PRESET;
+#ifndef ON_DEVICE
+// Host only. The device keeps the bit loop, it only ever runs it on a few bytes and has no RAM to spare.
+// crc32_update() goes through the fastest kernel of the cpu: carry-less multiply folding on x86-64,
+// the crc32 instructions on ARMv8, slice-by-8 tables otherwise. All of them work on the raw register,
+// no pre or post inversion, like crc32_byte()
+
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+# include <immintrin.h>
+# define CRC32_HAVE_PCLMUL
+#endif
+
+#if defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__)) && (defined(__linux__) || defined(__APPLE__))
+# include <arm_acle.h>
+# if defined(__linux__)
+#  include <sys/auxv.h>
+#  ifndef HWCAP_CRC32
+#   define HWCAP_CRC32 (1 << 7)
+#  endif
+# endif
+# define CRC32_HAVE_ARMV8
+# if defined(__clang__)
+#  define CRC32_ARMV8_TARGET __attribute__((target("crc")))
+# else
+#  define CRC32_ARMV8_TARGET __attribute__((target("+crc")))
+# endif
+#endif
+
+static uint32_t crc32_tables[8][256];
+static bool crc32_tables_init = false;
+
+static void crc32_slice8_init(void) {
+    if (__atomic_load_n(&crc32_tables_init, __ATOMIC_ACQUIRE))
+        return;
+
+    for (int i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int j = 0; j < 8; j++)
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+        crc32_tables[0][i] = crc;
+    }
+    for (int t = 1; t < 8; t++) {
+        for (int i = 0; i < 256; i++) {
+            uint32_t crc = crc32_tables[t - 1][i];
+            crc32_tables[t][i] = (crc >> 8) ^ crc32_tables[0][crc & 0xFF];
+        }
+    }
+    __atomic_store_n(&crc32_tables_init, true, __ATOMIC_RELEASE);
+}
+
+static uint32_t crc32_bitwise(uint32_t crc, const uint8_t *data, size_t len) {
     for (size_t i = 0; i < len; i++) {
-        crc32_byte(&desfire_crc, data[i]);
+        crc32_byte(&crc, data[i]);
+    }
+    return crc;
+}
+
+static uint32_t crc32_slice8(uint32_t crc, const uint8_t *data, size_t len) {
+    crc32_slice8_init();
+
+    const uint32_t (*t)[256] = (const uint32_t (*)[256])crc32_tables;
+    for (; len >= 8; len -= 8, data += 8) {
+        uint32_t lo = crc ^ ((uint32_t)data[0] | (uint32_t)data[1] << 8 | (uint32_t)data[2] << 16 | (uint32_t)data[3] << 24);
+        uint32_t hi = (uint32_t)data[4] | (uint32_t)data[5] << 8 | (uint32_t)data[6] << 16 | (uint32_t)data[7] << 24;
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+    }
+    while (len--)
+        crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xFF];
+    return crc;
+}
+
+#ifdef CRC32_HAVE_PCLMUL
+// folding constants of the reflected 0x04C11DB7 polynomial, Intel "Fast CRC Computation Using PCLMULQDQ"
+static const uint64_t crc32_k1k2[] __attribute__((aligned(16))) = { 0x0154442bd4, 0x01c6e41596 };
+static const uint64_t crc32_k3k4[] __attribute__((aligned(16))) = { 0x01751997d0, 0x00ccaa009e };
+static const uint64_t crc32_k5k0[] __attribute__((aligned(16))) = { 0x0163cd6124, 0x0000000000 };
+static const uint64_t crc32_poly[] __attribute__((aligned(16))) = { 0x01db710641, 0x01f7011641 };
+
+// 64 bytes at least, folds four 128 bit lanes then reduces with Barrett. The tail goes on the tables
+__attribute__((target("pclmul,sse2")))
+static uint32_t crc32_pclmul(uint32_t crc, const uint8_t *data, size_t len) {
+    if (len < 64)
+        return crc32_slice8(crc, data, len);
+
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+    x1 = _mm_loadu_si128((const __m128i *)(data + 0x00));
+    x2 = _mm_loadu_si128((const __m128i *)(data + 0x10));
+    x3 = _mm_loadu_si128((const __m128i *)(data + 0x20));
+    x4 = _mm_loadu_si128((const __m128i *)(data + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    x0 = _mm_load_si128((const __m128i *)crc32_k1k2);
+    data += 64;
+    len -= 64;
+
+    while (len >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *)(data + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *)(data + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *)(data + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *)(data + 0x30)));
+        data += 64;
+        len -= 64;
+    }
+
+    // four lanes into one
+    x0 = _mm_load_si128((const __m128i *)crc32_k3k4);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    while (len >= 16) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i *)data)), x5);
+        data += 16;
+        len -= 16;
+    }
+
+    // 128 to 64 bits
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+    x0 = _mm_loadl_epi64((const __m128i *)crc32_k5k0);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bits
+    x0 = _mm_load_si128((const __m128i *)crc32_poly);
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    crc = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+
+    return crc32_slice8(crc, data, len);
+}
+
+static bool crc32_hw_supported(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse2");
+}
+#define CRC32_HW_NAME   "pclmul"
+#define crc32_hw        crc32_pclmul
+
+#elif defined(CRC32_HAVE_ARMV8)
+CRC32_ARMV8_TARGET
+static uint32_t crc32_armv8(uint32_t crc, const uint8_t *data, size_t len) {
+    for (; len >= 8; len -= 8, data += 8) {
+        uint64_t v;
+        memcpy(&v, data, sizeof(v));
+        crc = __crc32d(crc, v);
+    }
+    while (len--)
+        crc = __crc32b(crc, *data++);
+    return crc;
+}
+
+static bool crc32_hw_supported(void) {
+# if defined(__APPLE__)
+    return true;
+# else
+    return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+# endif
+}
+#define CRC32_HW_NAME   "armv8"
+#define crc32_hw        crc32_armv8
+
+#else
+static bool crc32_hw_supported(void) {
+    return false;
+}
+#define CRC32_HW_NAME   NULL
+#define crc32_hw        crc32_slice8
+#endif
+
+typedef uint32_t (*crc32_fn_t)(uint32_t crc, const uint8_t *data, size_t len);
+static crc32_fn_t crc32_fn = NULL;
+
+static crc32_fn_t crc32_select(void) {
+    crc32_fn_t fn = __atomic_load_n(&crc32_fn, __ATOMIC_ACQUIRE);
+    if (fn == NULL) {
+        fn = crc32_hw_supported() ? crc32_hw : crc32_slice8;
+        __atomic_store_n(&crc32_fn, fn, __ATOMIC_RELEASE);
     }
+    return fn;
+}
+
+const char *crc32_hw_kernel(void) {
+    return crc32_hw_supported() ? CRC32_HW_NAME : NULL;
+}
+
+bool crc32_update_kernel(crc32_kernel_t kernel, uint32_t *crc, const uint8_t *data, const size_t len) {
+    switch (kernel) {
+        case CRC32_BITWISE:
+            *crc = crc32_bitwise(*crc, data, len);
+            return true;
+        case CRC32_SLICE8:
+            *crc = crc32_slice8(*crc, data, len);
+            return true;
+        case CRC32_HW:
+            if (crc32_hw_supported() == false)
+                return false;
+            *crc = crc32_hw(*crc, data, len);
+            return true;
+    }
+    return false;
+}
+#endif
+
+void crc32_ex(const uint8_t *data, const size_t len, uint8_t *crc) {
+    uint32_t desfire_crc = crc32_update(CRC32_PRESET, data, len);
     uint32_t crctmp = htole32(desfire_crc);
     for (size_t i = 0; i < sizeof(uint32_t); i++) {
         crc[i] = ((uint8_t *) &crctmp)[i];
     }
 }
 
+uint32_t crc32_update(uint32_t crc, const uint8_t *data, const size_t len) {
+#ifndef ON_DEVICE
+    return crc32_select()(crc, data, len);
+#else
+    for (size_t i = 0; i < len; i++) {
+        crc32_byte(&crc, data[i]);
+    }
+    return crc;
+#endif
+}
+
 void crc32_append(uint8_t *data, const size_t len) {
     crc32_ex(data, len, data + len);
 }
@@ -11,7 +11,24 @@
 
 #include "common.h"
 
+#define CRC32_PRESET 0xFFFFFFFF
+
 void crc32_ex(const uint8_t *data, const size_t len, uint8_t *crc);
 void crc32_append(uint8_t *data, const size_t len);
+// Incremental version of crc32_ex, start with crc = CRC32_PRESET
+uint32_t crc32_update(uint32_t crc, const uint8_t *data, const size_t len);
+
+#ifndef ON_DEVICE
+typedef enum {
+    CRC32_BITWISE,
+    CRC32_SLICE8,
+    CRC32_HW,
+} crc32_kernel_t;
+
+// crc32_update on a given kernel, for benchmarks. false when the cpu doesn't have it
+bool crc32_update_kernel(crc32_kernel_t kernel, uint32_t *crc, const uint8_t *data, const size_t len);
+// name of the hardware kernel crc32_update runs on, NULL when it runs on the tables
+const char *crc32_hw_kernel(void);
+#endif
 
 #endif
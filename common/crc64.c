@@ -70,12 +70,45 @@ const uint64_t crc64_table[] = {
     0x5DEDC41A34BBEEB2, 0x1F1D25F19D51D821, 0xD80C07CD676F8394, 0x9AFCE626CE85B507
 };
 
+// slice-by-8, crc64_table and the tables of one to seven extra zero bytes
+static uint64_t crc64_slices[7][256];
+static bool crc64_slices_init = false;
+
+static void crc64_slice8_init(void) {
+    if (__atomic_load_n(&crc64_slices_init, __ATOMIC_ACQUIRE))
+        return;
+
+    for (int i = 0; i < 256; i++) {
+        uint64_t c = crc64_table[i];
+        for (int t = 0; t < 7; t++) {
+            c = (c << 8) ^ crc64_table[c >> 56];
+            crc64_slices[t][i] = c;
+        }
+    }
+    __atomic_store_n(&crc64_slices_init, true, __ATOMIC_RELEASE);
+}
+
 void crc64(const uint8_t *data, const size_t len, uint64_t *crc) {
 
-    for (size_t i = 0; i < len; i++) {
-        uint8_t tableIndex = (((uint8_t)(*crc >> 56)) ^ data[i]) & 0xff;
-        *crc = crc64_table[tableIndex] ^ (*crc << 8);
+    size_t n = len;
+    uint64_t c = *crc;
+
+    if (n >= 8) {
+        crc64_slice8_init();
+        for (; n >= 8; n -= 8, data += 8) {
+            c ^= (uint64_t)data[0] << 56 | (uint64_t)data[1] << 48 | (uint64_t)data[2] << 40 | (uint64_t)data[3] << 32 |
+                 (uint64_t)data[4] << 24 | (uint64_t)data[5] << 16 | (uint64_t)data[6] << 8 | (uint64_t)data[7];
+            c = crc64_slices[6][c >> 56] ^ crc64_slices[5][(c >> 48) & 0xff] ^ crc64_slices[4][(c >> 40) & 0xff] ^
+                crc64_slices[3][(c >> 32) & 0xff] ^ crc64_slices[2][(c >> 24) & 0xff] ^ crc64_slices[1][(c >> 16) & 0xff] ^
+                crc64_slices[0][(c >> 8) & 0xff] ^ crc64_table[c & 0xff];
+        }
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        uint8_t tableIndex = (((uint8_t)(c >> 56)) ^ data[i]) & 0xff;
+        c = crc64_table[tableIndex] ^ (c << 8);
     }
+    *crc = c;
 }
 
 //suint8_t x = (c & 0xFF00000000000000 ) >> 56;
@@ -11,6 +11,8 @@
 
 #include "common.h"
 
+extern const uint64_t crc64_table[];
+
 void crc64(const uint8_t *data, const size_t len, uint64_t *crc) ;
 
 #endif
@@ -0,0 +1,63 @@
+#include <string.h>
+#include "ht2bitslice.h"
+
+// lane patterns of the lowest 6 counter bits inside one 64 bit word
+static const uint64_t lane_pattern[6] = {
+    0xAAAAAAAAAAAAAAAAull, 0xCCCCCCCCCCCCCCCCull, 0xF0F0F0F0F0F0F0F0ull,
+    0xFF00FF00FF00FF00ull, 0xFFFF0000FFFF0000ull, 0xFFFFFFFF00000000ull
+};
+
+void ht2bs_counter(ht2bs_t *slices, uint64_t base, unsigned int bits) {
+    for (unsigned int i = 0; i < bits; i++) {
+        if (i < 6) {
+            slices[i] = ht2bs_fill(0) + lane_pattern[i];
+        } else if ((1ull << i) < HT2BS_LANES) {
+            for (unsigned int w = 0; w < HT2BS_WORDS; w++)
+                slices[i][w] = ((w >> (i - 6)) & 1) ? ~0ull : 0;
+        } else {
+            slices[i] = ht2bs_fill(base >> i);
+        }
+    }
+}
+
+void ht2bs_transpose(ht2bs_t *slices, const uint64_t *values, unsigned int count, unsigned int bits) {
+    memset(slices, 0, sizeof(ht2bs_t) * bits);
+
+    for (unsigned int n = 0; n < count; n++) {
+        uint64_t v = values[n];
+        for (unsigned int i = 0; i < bits; i++)
+            slices[i][n / 64] |= ((v >> i) & 1) << (n % 64);
+    }
+}
+
+uint64_t ht2bs_unslice(const ht2bs_t *slices, unsigned int lane, unsigned int bits) {
+    uint64_t v = 0;
+    for (unsigned int i = 0; i < bits; i++)
+        v |= ht2bs_get(slices[i], lane) << i;
+    return v;
+}
+
+ht2bs_t ht2bs_check_keys(const ht2bs_t *key, uint32_t uid, uint32_t nonce, uint32_t ks) {
+    ht2bs_t s[48 + 64];
+
+    // uid, then the lower 16 key bits
+    for (int i = 0; i < 32; i++)
+        s[i] = ht2bs_fill(uid >> i);
+    for (int i = 0; i < 16; i++)
+        s[32 + i] = key[i];
+
+    // shift in the upper 32 key bits xor the nonce xor the keystream
+    for (int t = 0; t < 32; t++)
+        s[48 + t] = ht2bs_filter(&s[t]) ^ key[16 + t] ^ ht2bs_fill(nonce >> t);
+
+    // the lanes drop out at their first wrong keystream bit
+    ht2bs_t match = ht2bs_fill(1);
+    for (int t = 32; t < 64; t++) {
+        match &= ~(ht2bs_filter(&s[t]) ^ ht2bs_fill(ks >> (t - 32)));
+        if (ht2bs_any(match) == false)
+            break;
+
+        s[48 + t] = ht2bs_lfsr(&s[t]);
+    }
+    return match;
+}
@@ -0,0 +1,81 @@
+/*
+ * Bitsliced HiTag2 core, shared by tools/hitag2crack and the client
+ *
+ * Every ht2bs_t holds the same state bit of HT2BS_LANES independent
+ * lanes, lane n being bit (n % 64) of element (n / 64).  The width is
+ * picked from the instruction set the compiler targets, build with
+ * make EXTRACFLAGS=-march=native to get AVX2 / AVX512 wide slices.
+ *
+ * States follow the pre-shifted form of the lfsr, as in the paper and
+ * ht2crack5: slice s[i] is state bit i, the rfidler hitag2_crypt(x)
+ * equals the filter applied to the state one bit further down.
+ */
+#ifndef HT2BITSLICE_H
+#define HT2BITSLICE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(__AVX512F__)
+#define HT2BS_BYTES 64
+#elif defined(__AVX2__)
+#define HT2BS_BYTES 32
+#elif defined(__SSE2__) || defined(__ARM_NEON)
+#define HT2BS_BYTES 16
+#else
+#define HT2BS_BYTES 8
+#endif
+
+#define HT2BS_WORDS (HT2BS_BYTES / 8)
+#define HT2BS_LANES (HT2BS_BYTES * 8)
+
+typedef uint64_t ht2bs_t __attribute__((vector_size(HT2BS_BYTES)));
+
+// the three non linear functions, inputs in ascending state bit order
+#define f_a_bs(a,b,c,d)       (~(((a|b)&c)^(a|d)^b)) // 6 ops
+#define f_b_bs(a,b,c,d)       (~(((d|c)&(a^b))^(d|a|b))) // 7 ops
+#define f_c_bs(a,b,c,d,e)     (~((((((c^e)|d)&a)^b)&(c^b))^(((d^e)|a)&((d^b)|c)))) // 13 ops
+
+static inline ht2bs_t ht2bs_fill(uint64_t bit) {
+    return (ht2bs_t){0} - (bit & 1);
+}
+
+static inline bool ht2bs_any(ht2bs_t v) {
+    uint64_t r = 0;
+    for (int i = 0; i < HT2BS_WORDS; i++)
+        r |= v[i];
+    return r != 0;
+}
+
+static inline uint64_t ht2bs_get(ht2bs_t v, unsigned int lane) {
+    return (v[lane / 64] >> (lane % 64)) & 1;
+}
+
+// output bit of the state in s[0] .. s[47]
+static inline ht2bs_t ht2bs_filter(const ht2bs_t *s) {
+    return f_c_bs(f_a_bs(s[2], s[3], s[5], s[6]),
+                  f_b_bs(s[8], s[12], s[14], s[15]),
+                  f_b_bs(s[17], s[21], s[23], s[26]),
+                  f_b_bs(s[28], s[29], s[31], s[33]),
+                  f_a_bs(s[34], s[43], s[44], s[46]));
+}
+
+// feedback bit of the state in s[0] .. s[47], it becomes s[48]
+static inline ht2bs_t ht2bs_lfsr(const ht2bs_t *s) {
+    return s[0] ^ s[2] ^ s[3] ^ s[6] ^ s[7] ^ s[8] ^ s[16] ^ s[22] ^
+           s[23] ^ s[26] ^ s[30] ^ s[41] ^ s[42] ^ s[43] ^ s[46] ^ s[47];
+}
+
+// bits slices of (base + lane), base has to be a multiple of HT2BS_LANES
+void ht2bs_counter(ht2bs_t *slices, uint64_t base, unsigned int bits);
+// bits slices of count values, missing lanes stay zero
+void ht2bs_transpose(ht2bs_t *slices, const uint64_t *values, unsigned int count, unsigned int bits);
+// value of one lane, gathered from bits slices
+uint64_t ht2bs_unslice(const ht2bs_t *slices, unsigned int lane, unsigned int bits);
+
+// Tests 48 key slices against one authentication, uid and nonce in the internal
+// format of hitag2_init. Keystream bit n (first bit generated is n = 0) is bit n of ks.
+// Returns the lanes whose 32 keystream bits all match
+ht2bs_t ht2bs_check_keys(const ht2bs_t *key, uint32_t uid, uint32_t nonce, uint32_t ks);
+
+#endif /* HT2BITSLICE_H */
@@ -38,8 +38,8 @@
 
 #include "lfdemod.h"
 #include <string.h>  // for memset, memcmp and size_t
-#include <stdlib.h>  // qsort
 #include "parity.h"  // for parity test
+#include "commonutil.h"  // ARRAYLEN
 #include "pm3_cmd.h" // error codes
 // **********************************************************************************************
 // ---------------------------------Utilities Section--------------------------------------------
@@ -83,14 +83,31 @@ static void printSignal(void) {
     prnt("  THRESHOLD noise amplitude......%d", NOISE_AMPLITUDE_THRESHOLD);
 }
 
-#ifndef ON_DEVICE
-static int cmp_uint8(const void *a, const void *b) {
-    if (*(const uint8_t *)a < * (const uint8_t *)b)
-        return -1;
-    else
-        return *(const uint8_t *)a > *(const uint8_t *)b;
+// Sample statistics come from a histogram: one pass, no copy and no sorting,
+// the same on the client and on the device
+
+// sample histogram, ignoring the first SIGNAL_IGNORE_FIRST_SAMPLES samples
+static void signalHistogram(const uint8_t *samples, uint32_t size, uint32_t *hist) {
+    memset(hist, 0, 256 * sizeof(uint32_t));
+    for (uint32_t i = SIGNAL_IGNORE_FIRST_SAMPLES; i < size; i++)
+        hist[samples[i]]++;
+}
+
+// value at position idx of the sorted samples
+static uint8_t histogramNth(const uint32_t *hist, uint32_t idx) {
+    uint32_t cnt = 0;
+    for (int v = 0; v < 256; v++) {
+        cnt += hist[v];
+        if (cnt > idx)
+            return v;
+    }
+    return 255;
+}
+
+// pct percentile of cnt samples, integer only for the device
+static uint8_t histogramPercentile(const uint32_t *hist, uint32_t cnt, uint32_t pct) {
+    return (histogramNth(hist, cnt * pct / 100) + histogramNth(hist, (cnt - 1) * pct / 100)) / 2;
 }
-#endif
 
 void computeSignalProperties(uint8_t *samples, uint32_t size) {
     resetSignal();
@@ -100,37 +117,30 @@ void computeSignalProperties(uint8_t *samples, uint32_t size) {
     uint32_t sum = 0;
     uint32_t offset_size = size - SIGNAL_IGNORE_FIRST_SAMPLES;
 
-#ifndef ON_DEVICE
-    uint8_t tmp[offset_size];
-    memcpy(tmp, samples + SIGNAL_IGNORE_FIRST_SAMPLES, sizeof(tmp));
-    qsort(tmp, sizeof(tmp), sizeof(uint8_t), cmp_uint8);
+    uint32_t hist[256];
+    signalHistogram(samples, size, hist);
 
-    uint8_t low10 = 0.5 * (tmp[(int)(offset_size * 0.1)] + tmp[(int)((offset_size - 1) * 0.1)]);
-    uint8_t hi90 =  0.5 * (tmp[(int)(offset_size * 0.9)] + tmp[(int)((offset_size - 1) * 0.9)]);
+    // mean without the outliers
+    uint8_t low10 = histogramPercentile(hist, offset_size, 10);
+    uint8_t hi90 = histogramPercentile(hist, offset_size, 90);
     uint32_t cnt = 0;
-    for (uint32_t i = SIGNAL_IGNORE_FIRST_SAMPLES; i < size; i++) {
+    for (int v = 0; v < 256; v++) {
+        if (hist[v] == 0)
+            continue;
 
-        if (samples[i] < signalprop.low) signalprop.low = samples[i];
-        if (samples[i] > signalprop.high) signalprop.high = samples[i];
+        if (v < signalprop.low) signalprop.low = v;
+        if (v > signalprop.high) signalprop.high = v;
 
-        if (samples[i] < low10 || samples[i] > hi90)
+        if (v < low10 || v > hi90)
             continue;
 
-        sum += samples[i];
-        cnt++;
+        sum += v * hist[v];
+        cnt += hist[v];
     }
     if (cnt > 0)
         signalprop.mean = sum / cnt;
     else
         signalprop.mean = 0;
-#else
-    for (uint32_t i =  SIGNAL_IGNORE_FIRST_SAMPLES; i < size; i++) {
-        if (samples[i] < signalprop.low) signalprop.low = samples[i];
-        if (samples[i] > signalprop.high) signalprop.high = samples[i];
-        sum += samples[i];
-    }
-    signalprop.mean = sum / offset_size;
-#endif
 
     // measure amplitude of signal
     signalprop.amplitude = signalprop.high - signalprop.mean;
@@ -148,33 +158,21 @@ void removeSignalOffset(uint8_t *samples, uint32_t size) {
     int acc_off = 0;
     uint32_t offset_size = size - SIGNAL_IGNORE_FIRST_SAMPLES;
 
-#ifndef ON_DEVICE
-
-    uint8_t tmp[offset_size];
-    memcpy(tmp, samples + SIGNAL_IGNORE_FIRST_SAMPLES, sizeof(tmp));
-    qsort(tmp, sizeof(tmp), sizeof(uint8_t), cmp_uint8);
+    uint32_t hist[256];
+    signalHistogram(samples, size, hist);
 
-    uint8_t low10 = 0.5 * (tmp[(int)(offset_size * 0.05)] + tmp[(int)((offset_size - 1) * 0.05)]);
-    uint8_t hi90 =  0.5 * (tmp[(int)(offset_size * 0.95)] + tmp[(int)((offset_size - 1) * 0.95)]);
+    // offset of the mean without the outliers
+    uint8_t low5 = histogramPercentile(hist, offset_size, 5);
+    uint8_t hi95 = histogramPercentile(hist, offset_size, 95);
     int32_t cnt = 0;
-    for (uint32_t i = SIGNAL_IGNORE_FIRST_SAMPLES; i < size; i++) {
-
-        if (samples[i] < low10 || samples[i] > hi90)
-            continue;
-
-        acc_off += samples[i] - 128;
-        cnt++;
+    for (int v = low5; v <= hi95; v++) {
+        acc_off += (v - 128) * (int)hist[v];
+        cnt += hist[v];
     }
     if (cnt > 0)
         acc_off /= cnt;
     else
         acc_off = 0;
-#else
-    for (uint32_t i = SIGNAL_IGNORE_FIRST_SAMPLES; i < size; i++)
-        acc_off += samples[i] - 128;
-
-    acc_off /= (int)offset_size;
-#endif
 
     // shift and saturate samples to center the mean
     for (uint32_t i = 0; i < size; i++) {
@@ -549,6 +547,102 @@ bool DetectCleanAskWave(uint8_t *dest, size_t size, uint8_t high, uint8_t low) {
 // -------------------Clock / Bitrate Detection Section------------------------------------------
 // **********************************************************************************************
 
+#ifndef ON_DEVICE
+// lf search runs the same clock detections over the same samples for every
+// protocol it tries. The client keeps the last results, keyed on the samples,
+// the signal properties and the arguments, so only the first one pays for them.
+#define DETECT_CACHE_SIZE 16
+
+typedef enum {
+    DETECT_ASK,
+    DETECT_NRZ,
+    DETECT_FC,
+    DETECT_PSK,
+    DETECT_FSK,
+    DETECT_ST,
+} detect_type_t;
+
+typedef struct {
+    uint64_t hash;
+    size_t size;
+    int low;
+    int high;
+    int mean;
+    int amplitude;
+    int isnoise;
+    detect_type_t type;
+    int64_t args[4];
+} detect_key_t;
+
+typedef struct {
+    detect_key_t key;
+    int64_t res[4];
+} detect_cache_t;
+
+static detect_cache_t detect_cache[DETECT_CACHE_SIZE];
+static uint8_t detect_cache_cnt = 0;
+static uint8_t detect_cache_next = 0;
+
+// FNV-1a over 64 bit words, every lookup hashes the whole buffer
+static uint64_t samplesHash(const uint8_t *samples, size_t size) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t w;
+        memcpy(&w, samples + i, sizeof(w));
+        hash ^= w;
+        hash *= 0x100000001b3ULL;
+        hash ^= hash >> 32;
+    }
+    for (; i < size; i++) {
+        hash ^= samples[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static void detectKey(detect_key_t *key, detect_type_t type, const uint8_t *samples, size_t size, int64_t a0, int64_t a1, int64_t a2, int64_t a3) {
+    // keys are compared with memcmp, padding included
+    memset(key, 0, sizeof(detect_key_t));
+    key->hash = samplesHash(samples, size);
+    key->size = size;
+    key->low = signalprop.low;
+    key->high = signalprop.high;
+    key->mean = signalprop.mean;
+    key->amplitude = signalprop.amplitude;
+    key->isnoise = signalprop.isnoise;
+    key->type = type;
+    key->args[0] = a0;
+    key->args[1] = a1;
+    key->args[2] = a2;
+    key->args[3] = a3;
+}
+
+static const int64_t *detectCacheGet(const detect_key_t *key) {
+    // debug output of every detection run is wanted
+    if (g_debugMode)
+        return NULL;
+
+    for (uint8_t i = 0; i < detect_cache_cnt; i++) {
+        if (memcmp(&detect_cache[i].key, key, sizeof(detect_key_t)) == 0)
+            return detect_cache[i].res;
+    }
+    return NULL;
+}
+
+static void detectCachePut(const detect_key_t *key, int64_t r0, int64_t r1, int64_t r2, int64_t r3) {
+    detect_cache_t *e = &detect_cache[detect_cache_next];
+    memcpy(&e->key, key, sizeof(detect_key_t));
+    e->res[0] = r0;
+    e->res[1] = r1;
+    e->res[2] = r2;
+    e->res[3] = r3;
+    detect_cache_next = (detect_cache_next + 1) % DETECT_CACHE_SIZE;
+    if (detect_cache_cnt < DETECT_CACHE_SIZE)
+        detect_cache_cnt++;
+}
+#endif
+
 
 // by marshmellow
 // to help detect clocks on heavily clipped samples
@@ -633,11 +727,18 @@ int DetectStrongAskClock(uint8_t *dest, size_t size, int high, int low, int *clo
     return shortestWaveIdx;
 }
 
+// peak at idx, or within tol of it
+static inline bool askPeakAt(const uint8_t *dest, size_t idx, uint8_t tol, int peak_hi, int peak_low) {
+    return (dest[idx] >= peak_hi || dest[idx] <= peak_low) ||
+           (dest[idx - tol] >= peak_hi || dest[idx - tol] <= peak_low) ||
+           (dest[idx + tol] >= peak_hi || dest[idx + tol] <= peak_low);
+}
+
 // by marshmellow
 // not perfect especially with lower clocks or VERY good antennas (heavy wave clipping)
 // maybe somehow adjust peak trimming value based on samples to fix?
 // return start index of best starting position for that clock and return clock (by reference)
-int DetectASKClock(uint8_t *dest, size_t size, int *clock, int maxErr) {
+static int DetectASKClock_uncached(uint8_t *dest, size_t size, int *clock, int maxErr) {
 
     //don't need to loop through entire array. (cotag has clock of 384)
     uint16_t loopCnt = 2000;
@@ -698,6 +799,7 @@ int DetectASKClock(uint8_t *dest, size_t size, int *clock, int maxErr) {
 
     uint8_t clkCnt, tol;
     size_t j = 0;
+    uint32_t startErr[256];
     uint16_t bestErr[] = {1000, 1000, 1000, 1000, 1000, 1000, 1000, 1000, 1000};
     uint8_t bestStart[] = {0, 0, 0, 0, 0, 0, 0, 0, 0};
     size_t errCnt, arrLoc, loopEnd;
@@ -728,18 +830,26 @@ int DetectASKClock(uint8_t *dest, size_t size, int *clock, int maxErr) {
         getNextHigh(dest, size, peak_hi, &j);
         getNextLow(dest, size, peak_low, &j);
 
+        size_t firstStart = j;
         for (; j < loopCnt; j++) {
-            errCnt = 0;
-            // now that we have the first one lined up test rest of wave array
-            loopEnd = ((size - j - tol) / clk[clkCnt]) - 1;
-            for (i = 0; i < loopEnd; ++i) {
-                arrLoc = j + (i * clk[clkCnt]);
-                if (dest[arrLoc] >= peak_hi || dest[arrLoc] <= peak_low) {
-                } else if (dest[arrLoc - tol] >= peak_hi || dest[arrLoc - tol] <= peak_low) {
-                } else if (dest[arrLoc + tol] >= peak_hi || dest[arrLoc + tol] <= peak_low) {
-                } else {  //error no peak detected
-                    errCnt++;
+            // start j tests the same positions as start j - clk, minus j - clk itself.
+            // So only the first clock worth of start positions needs a full pass
+            if (j >= firstStart + clk[clkCnt] && clk[clkCnt] <= ARRAYLEN(startErr) && size - j - tol >= clk[clkCnt]) {
+                errCnt = startErr[j % clk[clkCnt]] - (askPeakAt(dest, j - clk[clkCnt], tol, peak_hi, peak_low) ? 0 : 1);
+                startErr[j % clk[clkCnt]] = errCnt;
+            } else {
+                errCnt = 0;
+                // now that we have the first one lined up test rest of wave array
+                loopEnd = ((size - j - tol) / clk[clkCnt]) - 1;
+                for (i = 0; i < loopEnd; ++i) {
+                    arrLoc = j + (i * clk[clkCnt]);
+                    if (askPeakAt(dest, arrLoc, tol, peak_hi, peak_low) == false) {
+                        //error no peak detected
+                        errCnt++;
+                    }
                 }
+                if (clk[clkCnt] <= ARRAYLEN(startErr))
+                    startErr[j % clk[clkCnt]] = errCnt;
             }
             // if we found no errors then we can stop here and a low clock (common clocks)
             //  this is correct one - return this clock
@@ -821,7 +931,7 @@ int DetectStrongNRZClk(uint8_t *dest, size_t size, int peak, int low, bool *stro
 
 //by marshmellow
 //detect nrz clock by reading #peaks vs no peaks(or errors)
-int DetectNRZClock(uint8_t *dest, size_t size, int clock, size_t *clockStartIdx) {
+static int DetectNRZClock_uncached(uint8_t *dest, size_t size, int clock, size_t *clockStartIdx) {
     size_t i = 0;
     uint8_t clk[] = {8, 16, 32, 40, 50, 64, 100, 128, 255};
     size_t loopCnt = 4096;  //don't need to loop through entire array...
@@ -951,7 +1061,7 @@ int DetectNRZClock(uint8_t *dest, size_t size, int clock, size_t *clockStartIdx)
 //countFC is to detect the field clock lengths.
 //counts and returns the 2 most common wave lengths
 //mainly used for FSK field clock detection
-uint16_t countFC(uint8_t *bits, size_t size, bool fskAdj) {
+static uint16_t countFC_uncached(uint8_t *bits, size_t size, bool fskAdj) {
     uint8_t fcLens[] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint16_t fcCnts[] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t fcLensFnd = 0;
@@ -1041,7 +1151,7 @@ uint16_t countFC(uint8_t *bits, size_t size, bool fskAdj) {
 //by marshmellow
 //detect psk clock by reading each phase shift
 // a phase shift is determined by measuring the sample length of each wave
-int DetectPSKClock(uint8_t *dest, size_t size, int clock, size_t *firstPhaseShift, uint8_t *curPhase, uint8_t *fc) {
+static int DetectPSKClock_uncached(uint8_t *dest, size_t size, int clock, size_t *firstPhaseShift, uint8_t *curPhase, uint8_t *fc) {
     uint8_t clk[] = {255, 16, 32, 40, 50, 64, 100, 128, 255}; //255 is not a valid clock
     uint16_t loopCnt = 4096;  //don't need to loop through entire array...
 
@@ -1060,12 +1170,8 @@ int DetectPSKClock(uint8_t *dest, size_t size, int clock, size_t *firstPhaseShif
     if (*fc != 2 && *fc != 4 && *fc != 8) return 0;
 
 
-    size_t waveEnd, firstFullWave = 0;
-
-    uint8_t clkCnt;
-    uint16_t waveLenCnt, fullWaveLen = 0;
-    uint16_t bestErr[] = {1000, 1000, 1000, 1000, 1000, 1000, 1000, 1000, 1000};
-    uint16_t peaksdet[] = {0, 0, 0, 0, 0, 0, 0, 0, 0};
+    size_t firstFullWave = 0;
+    uint16_t fullWaveLen = 0;
 
     //find start of modulating data in trace
     size_t i = findModStart(dest, size, *fc);
@@ -1081,60 +1187,66 @@ int DetectPSKClock(uint8_t *dest, size_t size, int clock, size_t *firstPhaseShif
     *firstPhaseShift = firstFullWave;
     if (g_debugMode == 2) prnt("DEBUG PSK: firstFullWave: %zu, waveLen: %d", firstFullWave, fullWaveLen);
 
-    //test each valid clock from greatest to smallest to see which lines up
-    for (clkCnt = 7; clkCnt >= 1 ; clkCnt--) {
-        uint8_t tol = *fc / 2;
-        size_t lastClkBit = firstFullWave; //set end of wave as clock align
-        size_t waveStart = 0;
-        uint16_t errCnt = 0;
-        uint16_t peakcnt = 0;
-        if (g_debugMode == 2) prnt("DEBUG PSK: clk: %d, lastClkBit: %zu", clk[clkCnt], lastClkBit);
-
-        for (i = firstFullWave + fullWaveLen - 1; i < loopCnt - 2; i++) {
-            //top edge of wave = start of new wave
-            if (dest[i] < dest[i + 1] && dest[i + 1] >= dest[i + 2]) {
-                if (waveStart == 0) {
-                    waveStart = i + 1;
-                } else { //waveEnd
-                    waveEnd = i + 1;
-                    waveLenCnt = waveEnd - waveStart;
-                    if (waveLenCnt > *fc) {
-                        //if this wave is a phase shift
-                        if (g_debugMode == 2) prnt("DEBUG PSK: phase shift at: %zu, len: %d, nextClk: %zu, i: %zu, fc: %d", waveStart, waveLenCnt, lastClkBit + clk[clkCnt] - tol, i + 1, *fc);
-                        if (i + 1 >= lastClkBit + clk[clkCnt] - tol) { //should be a clock bit
-                            peakcnt++;
-                            lastClkBit += clk[clkCnt];
-                        } else if (i < lastClkBit + 8) {
-                            //noise after a phase shift - ignore
-                        } else { //phase shift before supposed to based on clock
-                            errCnt++;
-                        }
-                    } else if (i + 1 > lastClkBit + clk[clkCnt] + tol + *fc) {
-                        lastClkBit += clk[clkCnt]; //no phase shift but clock bit
-                    }
-                    waveStart = i + 1;
+    // test each valid clock to see which lines up. The waves do not depend on the clock, so one pass
+    // over the samples finds them and every clock follows its own next clock bit along
+    uint8_t tol = *fc / 2;
+    size_t lastClkBit[9];
+    uint16_t errCnt[9] = {0};
+    uint16_t peakcnt[9] = {0};
+    for (uint8_t c = 1; c <= 7; c++)
+        lastClkBit[c] = firstFullWave; //set end of wave as clock align
+
+    size_t waveStart = 0;
+    for (i = firstFullWave + fullWaveLen - 1; i < loopCnt - 2; i++) {
+        //top edge of wave = start of new wave
+        if (dest[i] >= dest[i + 1] || dest[i + 1] < dest[i + 2])
+            continue;
+
+        if (waveStart == 0) {
+            waveStart = i + 1;
+            continue;
+        }
+
+        //waveEnd, if this wave is longer than a field clock it is a phase shift
+        bool phaseShift = (i + 1 - waveStart) > *fc;
+        if (g_debugMode == 2 && phaseShift) prnt("DEBUG PSK: phase shift at: %zu, len: %zu, i: %zu, fc: %d", waveStart, i + 1 - waveStart, i + 1, *fc);
+
+        for (uint8_t c = 1; c <= 7; c++) {
+            if (phaseShift) {
+                if (i + 1 >= lastClkBit[c] + clk[c] - tol) { //should be a clock bit
+                    peakcnt[c]++;
+                    lastClkBit[c] += clk[c];
+                } else if (i < lastClkBit[c] + 8) {
+                    //noise after a phase shift - ignore
+                } else { //phase shift before supposed to based on clock
+                    errCnt[c]++;
                 }
+            } else if (i + 1 > lastClkBit[c] + clk[c] + tol + *fc) {
+                lastClkBit[c] += clk[c]; //no phase shift but clock bit
             }
         }
-        if (errCnt == 0) return clk[clkCnt];
-        if (errCnt <= bestErr[clkCnt]) bestErr[clkCnt] = errCnt;
-        if (peakcnt > peaksdet[clkCnt]) peaksdet[clkCnt] = peakcnt;
+        waveStart = i + 1;
+    }
+
+    //the greatest clock without errors
+    for (uint8_t c = 7; c >= 1; c--) {
+        if (errCnt[c] == 0) return clk[c];
     }
     //all tested with errors
     //return the highest clk with the most peaks found
     uint8_t best = 7;
-    for (i = 7; i >= 1; i--) {
-        if (peaksdet[i] > peaksdet[best])
-            best = i;
+    for (uint8_t c = 7; c >= 1; c--) {
+        if (peakcnt[c] > peakcnt[best])
+            best = c;
 
-        if (g_debugMode == 2) prnt("DEBUG PSK: Clk: %d, peaks: %d, errs: %d, bestClk: %d", clk[i], peaksdet[i], bestErr[i], clk[best]);
+        if (g_debugMode == 2) prnt("DEBUG PSK: Clk: %d, peaks: %d, errs: %d, bestClk: %d", clk[c], peakcnt[c], errCnt[c], clk[best]);
     }
     return clk[best];
 }
 
 //by marshmellow
 //detects the bit clock for FSK given the high and low Field Clocks
-uint8_t detectFSKClk(uint8_t *bits, size_t size, uint8_t fcHigh, uint8_t fcLow, int *firstClockEdge) {
+static uint8_t detectFSKClk_uncached(uint8_t *bits, size_t size, uint8_t fcHigh, uint8_t fcLow, int *firstClockEdge) {
 
     if (size == 0)
         return 0;
@@ -1242,6 +1354,93 @@ uint8_t detectFSKClk(uint8_t *bits, size_t size, uint8_t fcHigh, uint8_t fcLow,
 }
 
 
+// cached versions of the detections above, none of them changes the samples
+int DetectASKClock(uint8_t *dest, size_t size, int *clock, int maxErr) {
+#ifndef ON_DEVICE
+    detect_key_t key;
+    detectKey(&key, DETECT_ASK, dest, size, *clock, maxErr, 0, 0);
+    const int64_t *res = detectCacheGet(&key);
+    if (res) {
+        *clock = (int)res[1];
+        return (int)res[0];
+    }
+    int idx = DetectASKClock_uncached(dest, size, clock, maxErr);
+    detectCachePut(&key, idx, *clock, 0, 0);
+    return idx;
+#else
+    return DetectASKClock_uncached(dest, size, clock, maxErr);
+#endif
+}
+
+int DetectNRZClock(uint8_t *dest, size_t size, int clock, size_t *clockStartIdx) {
+#ifndef ON_DEVICE
+    detect_key_t key;
+    detectKey(&key, DETECT_NRZ, dest, size, clock, *clockStartIdx, 0, 0);
+    const int64_t *res = detectCacheGet(&key);
+    if (res) {
+        *clockStartIdx = (size_t)res[1];
+        return (int)res[0];
+    }
+    int clk = DetectNRZClock_uncached(dest, size, clock, clockStartIdx);
+    detectCachePut(&key, clk, *clockStartIdx, 0, 0);
+    return clk;
+#else
+    return DetectNRZClock_uncached(dest, size, clock, clockStartIdx);
+#endif
+}
+
+uint16_t countFC(uint8_t *bits, size_t size, bool fskAdj) {
+#ifndef ON_DEVICE
+    detect_key_t key;
+    detectKey(&key, DETECT_FC, bits, size, fskAdj, 0, 0, 0);
+    const int64_t *res = detectCacheGet(&key);
+    if (res)
+        return (uint16_t)res[0];
+
+    uint16_t fcs = countFC_uncached(bits, size, fskAdj);
+    detectCachePut(&key, fcs, 0, 0, 0);
+    return fcs;
+#else
+    return countFC_uncached(bits, size, fskAdj);
+#endif
+}
+
+int DetectPSKClock(uint8_t *dest, size_t size, int clock, size_t *firstPhaseShift, uint8_t *curPhase, uint8_t *fc) {
+#ifndef ON_DEVICE
+    detect_key_t key;
+    detectKey(&key, DETECT_PSK, dest, size, clock, *firstPhaseShift, *curPhase, *fc);
+    const int64_t *res = detectCacheGet(&key);
+    if (res) {
+        *firstPhaseShift = (size_t)res[1];
+        *curPhase = (uint8_t)res[2];
+        *fc = (uint8_t)res[3];
+        return (int)res[0];
+    }
+    int clk = DetectPSKClock_uncached(dest, size, clock, firstPhaseShift, curPhase, fc);
+    detectCachePut(&key, clk, *firstPhaseShift, *curPhase, *fc);
+    return clk;
+#else
+    return DetectPSKClock_uncached(dest, size, clock, firstPhaseShift, curPhase, fc);
+#endif
+}
+
+uint8_t detectFSKClk(uint8_t *bits, size_t size, uint8_t fcHigh, uint8_t fcLow, int *firstClockEdge) {
+#ifndef ON_DEVICE
+    detect_key_t key;
+    detectKey(&key, DETECT_FSK, bits, size, fcHigh, fcLow, *firstClockEdge, 0);
+    const int64_t *res = detectCacheGet(&key);
+    if (res) {
+        *firstClockEdge = (int)res[1];
+        return (uint8_t)res[0];
+    }
+    uint8_t clk = detectFSKClk_uncached(bits, size, fcHigh, fcLow, firstClockEdge);
+    detectCachePut(&key, clk, *firstClockEdge, 0, 0);
+    return clk;
+#else
+    return detectFSKClk_uncached(bits, size, fcHigh, fcLow, firstClockEdge);
+#endif
+}
+
 // **********************************************************************************************
 // --------------------Modulation Demods &/or Decoding Section-----------------------------------
 // **********************************************************************************************
@@ -1268,7 +1467,7 @@ static bool findST(int *stStopLoc, int *stStartIdx, int lowToLowWaveLen[], int h
 }
 //by marshmellow
 //attempt to identify a Sequence Terminator in ASK modulated raw wave
-bool DetectST(uint8_t *buffer, size_t *size, int *foundclock, size_t *ststart, size_t *stend) {
+static bool DetectST_uncached(uint8_t *buffer, size_t *size, int *foundclock, size_t *ststart, size_t *stend) {
     size_t bufsize = *size;
     //need to loop through all samples and identify our clock, look for the ST pattern
     int clk = 0;
@@ -1390,6 +1589,25 @@ bool DetectST(uint8_t *buffer, size_t *size, int *foundclock, size_t *ststart, s
     return true;
 }
 
+bool DetectST(uint8_t *buffer, size_t *size, int *foundclock, size_t *ststart, size_t *stend) {
+#ifndef ON_DEVICE
+    detect_key_t key;
+    detectKey(&key, DETECT_ST, buffer, *size, *foundclock, *ststart, *stend, 0);
+    const int64_t *res = detectCacheGet(&key);
+    if (res) {
+        *foundclock = (int)res[1];
+        return false;
+    }
+    bool st = DetectST_uncached(buffer, size, foundclock, ststart, stend);
+    // a found ST is cut out of the samples, only remember the misses
+    if (st == false)
+        detectCachePut(&key, 0, *foundclock, 0, 0);
+    return st;
+#else
+    return DetectST_uncached(buffer, size, foundclock, ststart, stend);
+#endif
+}
+
 //by marshmellow
 //take 11 10 01 11 00 and make 01100 ... miller decoding
 //check for phase errors - should never have half a 1 or 0 by itself and should never exceed 1111 or 0000 in a row
@@ -1758,23 +1976,144 @@ int nrzRawDemod(uint8_t *dest, size_t *size, int *clk, int *invert, int *startId
     return 0;
 }
 
-//translate wave to 11111100000 (1 for each short wave [higher freq] 0 for each long wave [lower freq])
-static size_t fsk_wave_demod(uint8_t *dest, size_t size, uint8_t fchigh, uint8_t fclow, int *startIdx) {
+// Single pass FSK demod. The waves between two 0->1 transitions are classified by
+// their width (fsk_wave_demod), the run of waves of the same frequency is turned into
+// bits on the fly (aggregate_bits). The last wave is held back, the next one may
+// still correct it, the first three as a garbage start may still reset them.
+
+// class of a wave width, see fsk_wave_class
+enum {
+    FSK_WAVE_NOISE,     // 0-5 = garbage noise (or 0-3)
+    FSK_WAVE_SHORT,     // 6-8 = 8 sample waves  (or 3-6 = 5)
+    FSK_WAVE_OVER,      // 12+, garbage if in the first two bits, else a long wave
+    FSK_WAVE_SPLIT,     // a 9, two 8's if after a 7 (or 6 after 4, two 5's), else a long wave
+    FSK_WAVE_LONG,      // 9+ = 10 sample waves (or 6+ = 7)
+};
+
+#define FSK_WAVE_TABLE  256
+
+typedef struct {
+    uint8_t *dest;
+    uint8_t clk;
+    uint8_t hclk;
+    uint8_t invert;
+    uint8_t fchigh;
+    uint8_t fclow;
+    // waves
+    size_t waves;
+    uint8_t held[3];
+    // aggregated bits
+    size_t fed;
+    size_t numBits;
+    uint32_t n;
+    uint8_t lastval;
+    uint8_t prev;
+    uint8_t prev2;
+    int startAdj;
+} fsk_demod_t;
+
+static uint8_t fsk_wave_class(size_t width, uint8_t fchigh, uint8_t fclow) {
+    if (width < (size_t)(fclow - 2)) return FSK_WAVE_NOISE;
+    if (width < (size_t)(fchigh - 1)) return FSK_WAVE_SHORT;
+    if (width > (size_t)(fchigh + 1)) return FSK_WAVE_OVER;
+    if (width == (size_t)(fclow + 1)) return FSK_WAVE_SPLIT;
+    return FSK_WAVE_LONG;
+}
 
-    if (size < 1024) return 0;   // not enough samples
+//translate 11111100000 to 10, one wave at a time
+//rfLen = clock, fchigh = larger field clock, fclow = smaller field clock
+static void aggregate_bits(fsk_demod_t *d, uint8_t val) {
 
-    if (fchigh == 0) fchigh = 10;
-    if (fclow == 0) fclow = 8;
+    if (d->fed == 0) {
+        d->lastval = val;
+        d->n = 1;
+    } else {
+        d->n++;
+        if (val != d->lastval) {
+            uint32_t n = d->n;
+            //find out how many bits (n) we collected (use 1/2 clk tolerance)
+            if (d->lastval == 1)
+                //if lastval was 1, we have a 1->0 crossing
+                n = (n * d->fclow + d->hclk) / d->clk;
+            else
+                // 0->1 crossing
+                n = (n * d->fchigh + d->hclk) / d->clk;
+
+            if (n == 0)
+                n = 1;
+
+            //first transition - save startidx
+            if (d->numBits == 0) {
+                if (d->lastval == 1) {  //high to low
+                    d->startAdj = (d->fclow * d->fed) - (n * d->clk);
+                    if (g_debugMode == 2) prnt("DEBUG (aggregate_bits) FSK startIdx adj %i, fclow*idx %zu, n*clk %u", d->startAdj, d->fclow * d->fed, n * d->clk);
+                } else {
+                    d->startAdj = (d->fchigh * d->fed) - (n * d->clk);
+                    if (g_debugMode == 2) prnt("DEBUG (aggregate_bits) FSK startIdx adj %i, fchigh*idx %zu, n*clk %u", d->startAdj, d->fchigh * d->fed, n * d->clk);
+                }
+            }
+
+            //add to our destination the bits we collected
+            memset(d->dest + d->numBits, d->lastval ^ d->invert, n);
+            d->numBits += n;
+            d->n = 0;
+            d->lastval = val;
+        }
+    }
+    d->prev2 = d->prev;
+    d->prev = val;
+    d->fed++;
+}
+
+// if valid extra bits at the end were all the same frequency - add them in
+static void aggregate_bits_end(fsk_demod_t *d) {
+    uint32_t n = (d->fed) ? d->n : 1;
+    if (n > d->clk / d->fchigh) {
+        if (d->prev2 == 1) {
+            n = (n * d->fclow + d->clk / 2) / d->clk;
+        } else {
+            n = (n * d->fchigh + d->clk / 2) / d->clk;
+        }
+        memset(d->dest + d->numBits, d->prev ^ d->invert, n);
+        d->numBits += n;
+        if (g_debugMode == 2) prnt("DEBUG (aggregate_bits) extra bits in the end");
+    }
+}
+
+// a wave demodulated, 1 for each short wave [higher freq] 0 for each long wave [lower freq]
+static void fsk_wave_put(fsk_demod_t *d, uint8_t bit) {
+    if (d->waves < 3) {
+        d->held[d->waves++] = bit;
+        if (d->waves == 3) {
+            aggregate_bits(d, d->held[0]);
+            aggregate_bits(d, d->held[1]);
+        }
+        return;
+    }
+    aggregate_bits(d, d->held[2]);
+    d->held[2] = bit;
+    d->waves++;
+}
+
+static size_t fsk_wave_demod(fsk_demod_t *d, size_t size, int *startIdx) {
+
+    uint8_t *dest = d->dest;
+    uint8_t fchigh = d->fchigh;
+    uint8_t fclow = d->fclow;
+
+    uint8_t wave_class[FSK_WAVE_TABLE];
+    for (size_t w = 0; w < FSK_WAVE_TABLE; w++)
+        wave_class[w] = fsk_wave_class(w, fchigh, fclow);
 
     //set the threshold close to 0 (graph) or 128 std to avoid static
     size_t preLastSample, LastSample = 0;
     size_t currSample = 0, last_transition = 0;
-    size_t idx, numBits = 0;
+    size_t idx;
 
     //find start of modulating data in trace
     idx = findModStart(dest, size, fchigh);
     // Need to threshold first sample
-    dest[idx] = (dest[idx] < signalprop.mean) ? 0 : 1;
+    uint8_t last = (dest[idx] < signalprop.mean) ? 0 : 1;
 
     last_transition = idx;
     idx++;
@@ -1812,116 +2151,90 @@ static size_t fsk_wave_demod(uint8_t *dest, size_t size, uint8_t fchigh, uint8_t
     for (; idx < size - 20; idx++) {
 
         // threshold current value
-        dest[idx] = (dest[idx] < signalprop.mean) ? 0 : 1;
+        uint8_t cur = (dest[idx] < signalprop.mean) ? 0 : 1;
 
         // Check for 0->1 transition
-        if (dest[idx - 1] < dest[idx]) {
+        if (last < cur) {
             preLastSample = LastSample;
             LastSample = currSample;
             currSample = idx - last_transition;
-            if (currSample < (fclow - 2)) {         //0-5 = garbage noise (or 0-3)
-                //do nothing with extra garbage
-            } else if (currSample < (fchigh - 1)) {         //6-8 = 8 sample waves  (or 3-6 = 5)
-                //correct previous 9 wave surrounded by 8 waves (or 6 surrounded by 5)
-                if (numBits > 1 && LastSample > (fchigh - 2) && (preLastSample < (fchigh - 1))) {
-                    dest[numBits - 1] = 1;
-                }
-                dest[numBits++] = 1;
-
 
-                if (numBits > 0 && *startIdx == 0)
-                    *startIdx = idx - fclow;
+            uint8_t c = (currSample < FSK_WAVE_TABLE) ? wave_class[currSample] : fsk_wave_class(currSample, fchigh, fclow);
+            if (c == FSK_WAVE_OVER && d->waves >= 3)
+                c = FSK_WAVE_LONG;
+            if (c == FSK_WAVE_SPLIT && LastSample != (size_t)(fclow - 1))
+                c = FSK_WAVE_LONG;
 
-            } else if (currSample > (fchigh + 1) && numBits < 3) { //12 + and first two bit = unusable garbage
-                //do nothing with beginning garbage and reset..  should be rare..
-                numBits = 0;
-            } else if (currSample == (fclow + 1) && LastSample == (fclow - 1)) { // had a 7 then a 9 should be two 8's (or 4 then a 6 should be two 5's)
-                dest[numBits++] = 1;
-                if (numBits > 0 && *startIdx == 0) {
-                    *startIdx = idx - fclow;
-                }
-            } else {                                        //9+ = 10 sample waves (or 6+ = 7)
-                dest[numBits++] = 0;
-                if (numBits > 0 && *startIdx == 0) {
-                    *startIdx = idx - fchigh;
-                }
+            switch (c) {
+                case FSK_WAVE_NOISE:
+                    //do nothing with extra garbage
+                    break;
+                case FSK_WAVE_SHORT:
+                    //correct previous 9 wave surrounded by 8 waves (or 6 surrounded by 5)
+                    if (d->waves > 1 && LastSample > (size_t)(fchigh - 2) && (preLastSample < (size_t)(fchigh - 1))) {
+                        d->held[(d->waves < 3) ? d->waves - 1 : 2] = 1;
+                    }
+                    fsk_wave_put(d, 1);
+                    if (*startIdx == 0)
+                        *startIdx = idx - fclow;
+                    break;
+                case FSK_WAVE_OVER:
+                    //do nothing with beginning garbage and reset..  should be rare..
+                    d->waves = 0;
+                    break;
+                case FSK_WAVE_SPLIT:
+                    // had a 7 then a 9 should be two 8's (or 4 then a 6 should be two 5's)
+                    fsk_wave_put(d, 1);
+                    if (*startIdx == 0)
+                        *startIdx = idx - fclow;
+                    break;
+                default:
+                    fsk_wave_put(d, 0);
+                    if (*startIdx == 0)
+                        *startIdx = idx - fchigh;
+                    break;
             }
             last_transition = idx;
         }
+        last = cur;
     }
-    return numBits; //Actually, it returns the number of bytes, but each byte represents a bit: 1 or 0
+    return d->waves; //Actually, it returns the number of bytes, but each byte represents a bit: 1 or 0
 }
 
-//translate 11111100000 to 10
-//rfLen = clock, fchigh = larger field clock, fclow = smaller field clock
-static size_t aggregate_bits(uint8_t *dest, size_t size, uint8_t clk, uint8_t invert, uint8_t fchigh, uint8_t fclow, int *startIdx) {
-
-    uint8_t lastval = dest[0];
-    size_t i = 0;
-    size_t numBits = 0;
-    uint32_t n = 1;
-    uint8_t hclk = clk / 2;
-
-    for (i = 1; i < size; i++) {
-        n++;
-        if (dest[i] == lastval) continue; //skip until we hit a transition
-
-        //find out how many bits (n) we collected (use 1/2 clk tolerance)
-
-        if (dest[i - 1] == 1)
-            //if lastval was 1, we have a 1->0 crossing
-            n = (n * fclow + hclk) / clk;
-        else
-            // 0->1 crossing
-            n = (n * fchigh + hclk) / clk;
-
-        if (n == 0)
-            n = 1;
-
-        //first transition - save startidx
-        if (numBits == 0) {
-            if (lastval == 1) {  //high to low
-                *startIdx += (fclow * i) - (n * clk);
-                if (g_debugMode == 2) prnt("DEBUG (aggregate_bits) FSK startIdx %i, fclow*idx %zu, n*clk %u", *startIdx, fclow * i, n * clk);
-            } else {
-                *startIdx += (fchigh * i) - (n * clk);
-                if (g_debugMode == 2) prnt("DEBUG (aggregate_bits) FSK startIdx %i, fchigh*idx %zu, n*clk %u", *startIdx, fchigh * i, n * clk);
-            }
-        }
+//by marshmellow  (from holiman's base)
+// full fsk demod from GraphBuffer wave to decoded 1s and 0s (no mandemod)
+size_t fskdemod(uint8_t *dest, size_t size, uint8_t rfLen, uint8_t invert, uint8_t fchigh, uint8_t fclow, int *start_idx) {
+    if (signalprop.isnoise) return 0;
+    if (size < 1024) return 0;   // not enough samples
 
-        //add to our destination the bits we collected
-        memset(dest + numBits, dest[i - 1] ^ invert, n);
+    if (fchigh == 0) fchigh = 10;
+    if (fclow == 0) fclow = 8;
 
-        numBits += n;
-        n = 0;
-        lastval = dest[i];
+    fsk_demod_t d;
+    memset(&d, 0, sizeof(d));
+    d.dest = dest;
+    d.clk = rfLen;
+    d.hclk = rfLen / 2;
+    d.invert = invert;
+    d.fchigh = fchigh;
+    d.fclow = fclow;
 
-    }//end for
+    // FSK demodulator
+    size_t waves = fsk_wave_demod(&d, size, start_idx);
+    if (g_debugMode == 2) prnt("DEBUG (fskdemod) got %zu bits", waves);
 
-    // if valid extra bits at the end were all the same frequency - add them in
-    if (n > clk / fchigh) {
-        if (dest[i - 2] == 1) {
-            n = (n * fclow + clk / 2) / clk;
-        } else {
-            n = (n * fchigh + clk / 2) / clk;
-        }
-        memset(dest + numBits, dest[i - 1] ^ invert, n);
-        numBits += n;
-        if (g_debugMode == 2) prnt("DEBUG (aggregate_bits) extra bits in the end");
+    // the waves held back
+    if (waves < 3) {
+        for (size_t i = 0; i < waves; i++)
+            aggregate_bits(&d, d.held[i]);
+    } else {
+        aggregate_bits(&d, d.held[2]);
     }
-    return numBits;
-}
+    aggregate_bits_end(&d);
+    *start_idx += d.startAdj;
 
-//by marshmellow  (from holiman's base)
-// full fsk demod from GraphBuffer wave to decoded 1s and 0s (no mandemod)
-size_t fskdemod(uint8_t *dest, size_t size, uint8_t rfLen, uint8_t invert, uint8_t fchigh, uint8_t fclow, int *start_idx) {
-    if (signalprop.isnoise) return 0;
-    // FSK demodulator
-    size = fsk_wave_demod(dest, size, fchigh, fclow, start_idx);
-    if (g_debugMode == 2) prnt("DEBUG (fskdemod) got %zu bits", size);
-    size = aggregate_bits(dest, size, rfLen, invert, fchigh, fclow, start_idx);
-    if (g_debugMode == 2) prnt("DEBUG (fskdemod) got %zu bits", size);
-    return size;
+    if (g_debugMode == 2) prnt("DEBUG (fskdemod) got %zu bits", d.numBits);
+    return d.numBits;
 }
 
 // by marshmellow
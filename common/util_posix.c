@@ -135,3 +135,14 @@ uint64_t msclock(void) {
 #endif
 }
 
+// a microseconds timer, same clock as msclock
+uint64_t usclock(void) {
+#if defined(_WIN32)
+    return 1000 * msclock();
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (1000000 * (uint64_t)t.tv_sec + t.tv_nsec / 1000);
+#endif
+}
+
@@ -133,6 +133,8 @@ AT91PS_UDP pUdp = AT91C_BASE_UDP;
 static uint8_t btConfiguration = 0;
 static uint8_t btConnection    = 0;
 static uint8_t btReceiveBank   = AT91C_UDP_RX_DATA_BK0;
+// last packet of usb_write still in one of the two IN banks, its TXCOMP is taken by the next usb_write
+static bool btTransmitPending   = false;
 
 static const char devDescriptor[] = {
     /* Device descriptor */
@@ -482,6 +484,7 @@ static void SpinDelayUs(int us) {
 void usb_disable(void) {
     // Disconnect the USB device
     AT91C_BASE_PIOA->PIO_ODR = GPIO_USB_PU;
+    btTransmitPending = false;
 
     // Clear all lingering interrupts
     if (pUdp->UDP_ISR & AT91C_UDP_ENDBUSRES) {
@@ -581,6 +584,7 @@ bool usb_check(void) {
         // reset all endpoints
         pUdp->UDP_RSTEP  = (unsigned int) - 1;
         pUdp->UDP_RSTEP  = 0;
+        btTransmitPending = false;
         // Enable the function
         pUdp->UDP_FADDR = AT91C_UDP_FEN;
         // Configure endpoint 0  (enable control endpoint)
@@ -721,67 +725,72 @@ uint32_t usb_read_ng(uint8_t *data, size_t len) {
  *----------------------------------------------------------------------------
  * \fn    usb_write
  * \brief Send through endpoint 2 (device to host)
+ *        Endpoint 2 is dual bank: a packet is written into the free bank while
+ *        the other one is on the bus. The last packet isn't waited for, its
+ *        TXCOMP is taken by the next call, so the caller goes on while it drains
  *----------------------------------------------------------------------------
 */
+#define USB_TX_STALL_SPINS  2000
+
+static uint32_t usb_tx_stall_count = 0;
+
+// writes that found the host had not taken the previous packet yet
+uint32_t usb_tx_stalls(void) {
+    return usb_tx_stall_count;
+}
+
+void usb_tx_stalls_reset(void) {
+    usb_tx_stall_count = 0;
+}
+
 int usb_write(const uint8_t *data, const size_t len) {
 
     if (!len) return PM3_EINVARG;
     if (!usb_check()) return PM3_EIO;
 
     // can we write?
-    if ((pUdp->UDP_CSR[AT91C_EP_IN] & AT91C_UDP_TXPKTRDY) != 0) return PM3_EIO;
+    if ((pUdp->UDP_CSR[AT91C_EP_IN] & AT91C_UDP_TXPKTRDY) != 0) {
+        usb_tx_stall_count++;
+        return PM3_EIO;
+    }
 
     size_t length = len;
-    uint32_t cpt = 0;
 
+    // a transfer of full packets is ended by a zero length packet
+    bool zlp = (len % AT91C_EP_IN_SIZE == 0);
 
-    // send first chunk
-    cpt = MIN(length, AT91C_EP_IN_SIZE);
-    length -= cpt;
-    while (cpt--) {
-        pUdp->UDP_FDR[AT91C_EP_IN] = *data++;
-    }
+    while (length || zlp) {
 
-    UDP_SET_EP_FLAGS(AT91C_EP_IN, AT91C_UDP_TXPKTRDY);
-    while (pUdp->UDP_CSR[AT91C_EP_IN] & AT91C_UDP_TXPKTRDY) {};
+        // fill the free bank
+        uint32_t cpt = MIN(length, AT91C_EP_IN_SIZE);
+        if (cpt == 0)
+            zlp = false;
 
-    while (length) {
-        // Send next chunk
-        cpt = MIN(length, AT91C_EP_IN_SIZE);
         length -= cpt;
         while (cpt--) {
             pUdp->UDP_FDR[AT91C_EP_IN] = *data++;
         }
 
-        // Wait for previous chunk to be sent
-        // (iceman) when is the bankswapping done?
-        while (!(pUdp->UDP_CSR[AT91C_EP_IN] & AT91C_UDP_TXCOMP)) {
-            if (!usb_check()) return PM3_EIO;
-        }
+        // Wait for previous packet to be sent, possibly the last one of the previous call
+        if (btTransmitPending) {
+            uint32_t spins = 0;
+            while (!(pUdp->UDP_CSR[AT91C_EP_IN] & AT91C_UDP_TXCOMP)) {
+                if (!usb_check()) {
+                    btTransmitPending = false;
+                    return PM3_EIO;
+                }
+                // far more than a packet takes on the bus, the host isn't reading
+                if (++spins == USB_TX_STALL_SPINS)
+                    usb_tx_stall_count++;
+            }
 
-        UDP_CLEAR_EP_FLAGS(AT91C_EP_IN, AT91C_UDP_TXCOMP);
-        while (pUdp->UDP_CSR[AT91C_EP_IN] & AT91C_UDP_TXCOMP) {};
+            UDP_CLEAR_EP_FLAGS(AT91C_EP_IN, AT91C_UDP_TXCOMP);
+            while (pUdp->UDP_CSR[AT91C_EP_IN] & AT91C_UDP_TXCOMP) {};
+        }
 
         UDP_SET_EP_FLAGS(AT91C_EP_IN, AT91C_UDP_TXPKTRDY);
         while (pUdp->UDP_CSR[AT91C_EP_IN] & AT91C_UDP_TXPKTRDY) {};
-    }
-
-    // Wait for the end of transfer
-    while (!(pUdp->UDP_CSR[AT91C_EP_IN] & AT91C_UDP_TXCOMP)) {
-        if (!usb_check()) return PM3_EIO;
-    }
-
-    UDP_CLEAR_EP_FLAGS(AT91C_EP_IN, AT91C_UDP_TXCOMP);
-    while (pUdp->UDP_CSR[AT91C_EP_IN] & AT91C_UDP_TXCOMP) {};
-
-
-    if (len % AT91C_EP_IN_SIZE == 0) {
-
-        UDP_SET_EP_FLAGS(AT91C_EP_IN, AT91C_UDP_TXPKTRDY);
-        while (!(pUdp->UDP_CSR[AT91C_EP_IN] & AT91C_UDP_TXCOMP)) {};
-
-        UDP_CLEAR_EP_FLAGS(AT91C_EP_IN, AT91C_UDP_TXCOMP);
-        while (pUdp->UDP_CSR[AT91C_EP_IN] & AT91C_UDP_TXCOMP) {};
+        btTransmitPending = true;
     }
 
     return PM3_SUCCESS;
@@ -951,6 +960,7 @@ void AT91F_CDC_Enumerate(void) {
             pUdp->UDP_CSR[AT91C_EP_OUT]    = (wValue) ? (AT91C_UDP_EPEDS | AT91C_UDP_EPTYPE_BULK_OUT) : 0;
             pUdp->UDP_CSR[AT91C_EP_IN]     = (wValue) ? (AT91C_UDP_EPEDS | AT91C_UDP_EPTYPE_BULK_IN)  : 0;
             pUdp->UDP_CSR[AT91C_EP_NOTIFY] = (wValue) ? (AT91C_UDP_EPEDS | AT91C_UDP_EPTYPE_INT_IN)   : 0;
+            btTransmitPending = false;
             break;
         case STD_GET_CONFIGURATION:
             AT91F_USB_SendData(pUdp, (char *) & (btConfiguration), sizeof(btConfiguration));
@@ -1002,7 +1012,10 @@ void AT91F_CDC_Enumerate(void) {
             if ((wValue == 0) && (wIndex >= AT91C_EP_OUT) && (wIndex <= AT91C_EP_NOTIFY)) {
 
                 if (wIndex == AT91C_EP_OUT)         pUdp->UDP_CSR[AT91C_EP_OUT] = (AT91C_UDP_EPEDS | AT91C_UDP_EPTYPE_BULK_OUT);
-                else if (wIndex == AT91C_EP_IN)     pUdp->UDP_CSR[AT91C_EP_IN] = (AT91C_UDP_EPEDS | AT91C_UDP_EPTYPE_BULK_IN);
+                else if (wIndex == AT91C_EP_IN) {
+                    pUdp->UDP_CSR[AT91C_EP_IN] = (AT91C_UDP_EPEDS | AT91C_UDP_EPTYPE_BULK_IN);
+                    btTransmitPending = false;
+                }
                 else if (wIndex == AT91C_EP_NOTIFY) pUdp->UDP_CSR[AT91C_EP_NOTIFY] = (AT91C_UDP_EPEDS | AT91C_UDP_EPTYPE_INT_IN);
 
                 AT91F_USB_SendZlp(pUdp);
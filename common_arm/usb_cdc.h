@@ -45,6 +45,8 @@ bool usb_poll(void);
 bool usb_poll_validate_length(void);
 uint32_t usb_read(uint8_t *data, size_t len);
 int usb_write(const uint8_t *data, const size_t len);
+uint32_t usb_tx_stalls(void);
+void usb_tx_stalls_reset(void);
 uint32_t usb_read_ng(uint8_t *data, size_t len);
 
 void SetUSBreconnect(int value);
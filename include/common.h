@@ -32,6 +32,8 @@
 #define RESOURCES_SUBDIR     "resources" PATHSEP
 #define TRACES_SUBDIR        "traces" PATHSEP
 #define LOGS_SUBDIR          "logs" PATHSEP
+#define STATECACHE_SUBDIR    "statecache" PATHSEP
+#define HARDNESTED_CACHE_SUBDIR "hardnested_cache" PATHSEP
 #define FIRMWARES_SUBDIR     "firmware" PATHSEP
 #define BOOTROM_SUBDIR       "bootrom" PATHSEP "obj" PATHSEP
 #define FULLIMAGE_SUBDIR     "armsrc" PATHSEP "obj" PATHSEP
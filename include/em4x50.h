@@ -51,6 +51,23 @@ typedef struct {
     uint8_t word[4];
 } em4x50_data_t;
 
+// Password search on the device, either <first> to <last> or the 4 byte binary passwords of <filename> in
+// SPIFFS, skipping the first <skip>. Progress frames carry <next>, which resumes an interrupted search
+typedef struct {
+    uint32_t first;
+    uint32_t last;
+    uint32_t skip;
+    uint8_t filename[32];                   // empty -> range
+} PACKED em4x50_brute_req_t;
+
+typedef struct {
+    bool final;
+    bool found;
+    uint32_t checked;                       // passwords tried so far
+    uint32_t next;                          // next password (range) or file index (dictionary) to try
+    uint8_t password[4];
+} PACKED em4x50_brute_resp_t;
+
 typedef struct {
     uint8_t byte[4];
     uint8_t row_parity[4];
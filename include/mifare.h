@@ -59,7 +59,8 @@ typedef enum ISO14A_COMMAND {
     ISO14A_NO_SELECT = (1 << 7),
     ISO14A_TOPAZMODE = (1 << 8),
     ISO14A_NO_RATS = (1 << 9),
-    ISO14A_SEND_CHAINING = (1 << 10)
+    ISO14A_SEND_CHAINING = (1 << 10),
+    ISO14A_TEAROFF = (1 << 11)          // RAW: cut the field at the uint32 ssp clock offset after the frame bytes
 } iso14a_command_t;
 
 typedef struct {
@@ -164,6 +165,7 @@ typedef enum SMARTCARD_COMMAND {
     SC_RAW_T0 = (1 << 4),
     SC_CLEARLOG = (1 << 5),
     SC_LOG = (1 << 6),
+    SC_FAST = (1 << 7),
 } smartcard_command_t;
 
 //-----------------------------------------------------------------------------
@@ -37,6 +37,15 @@ typedef struct {
     uint16_t cmd;
 } PACKED PacketCommandNGPreamble;
 
+// CMD_BATCH payload: entries back to back, each this header followed by <length> bytes of data, MIX
+// entries start with their three 64 bit args. The device runs them in order as if they had come one by
+// one, their replies are sent as usual and followed by a CMD_BATCH reply with the number of entries run
+typedef struct {
+    uint16_t cmd;
+    uint16_t length : 15;
+    bool ng : 1;
+} PACKED PacketBatchEntry;
+
 #define COMMANDNG_PREAMBLE_MAGIC  0x61334d50 // PM3a
 #define COMMANDNG_POSTAMBLE_MAGIC 0x3361     // a3
 
@@ -122,6 +131,886 @@ typedef struct {
     bool verbose;
 } PACKED sample_config;
 
+// Streamed LF acquisition, CMD_LF_ACQ_RAW_ADC_STREAM
+// The device samples with the current LF config (8 bits/sample, decimation and averaging apply) and pushes
+// frames while sampling continues, until the sample count is reached, CMD_BREAK_LOOP or button press.
+// The last frame has final set, its status is PM3_EOVFLOW if the host did not keep up.
+#define LF_STREAM_READER_FIELD      0x01    // field on, as 'lf read'. Without it, sniff as 'lf sniff'
+#define LF_STREAM_SAMPLES           (PM3_CMD_DATA_SIZE - 8)
+
+typedef struct {
+    uint8_t flags;
+    uint32_t samples;                       // 0 runs until stopped
+} PACKED lf_stream_req_t;
+
+typedef struct {
+    uint16_t seq;
+    bool final;
+    uint8_t decimation;                     // of the samples, as in the LF config
+    uint16_t len;                           // samples in this frame
+    uint16_t reserved;
+    uint8_t data[LF_STREAM_SAMPLES];
+} PACKED lf_stream_frame_t;
+
+// Streamed antenna tuning, CMD_MEASURE_ANTENNA_TUNING_STREAM
+// The device keeps measuring the antenna voltage and pushes a frame every interval ms with the average,
+// minimum and maximum of the readings in it, until CMD_BREAK_LOOP or button press. A reading is the
+// 32 sample average of CMD_MEASURE_ANTENNA_TUNING_LF / _HF. The last frame has final set and no readings.
+#define ANTENNA_TUNING_STREAM_HF    0x01    // HF antenna, else LF at divisor
+#define ANTENNA_TUNING_STREAM_MIN_MS    10
+#define ANTENNA_TUNING_STREAM_MAX_MS    1000
+
+typedef struct {
+    uint8_t flags;
+    uint8_t divisor;                        // LF, 19-255
+    uint16_t interval;                      // ms between frames
+} PACKED antenna_tuning_stream_req_t;
+
+typedef struct {
+    uint16_t seq;
+    bool final;
+    uint8_t reserved;
+    uint16_t count;                         // readings in this frame
+    uint16_t reserved2;
+    uint32_t avg;                           // mV
+    uint32_t min;
+    uint32_t max;
+} PACKED antenna_tuning_stream_frame_t;
+
+// Streamed HF sniff, CMD_HF_SNIFF_STREAM
+// Waits for the trigger as CMD_HF_SNIFF, then pushes the samples while sniffing continues, until the sample
+// count is reached, CMD_BREAK_LOOP or button press. Each output sample is the peak of decimation raw ones.
+// The last frame has final set, its status is PM3_EOVFLOW if the host did not keep up.
+#define HF_SNIFF_STREAM_SAMPLES     (PM3_CMD_DATA_SIZE - 8)
+
+typedef struct {
+    uint32_t samplesToSkip;                 // sample pairs, as CMD_HF_SNIFF
+    uint32_t triggersToSkip;
+    uint32_t samples;                       // after decimation, 0 runs until stopped
+    uint8_t decimation;
+} PACKED hf_sniff_stream_req_t;
+
+typedef struct {
+    uint16_t seq;
+    bool final;
+    uint8_t decimation;
+    uint16_t len;                           // samples in this frame
+    uint16_t reserved;
+    uint8_t data[HF_SNIFF_STREAM_SAMPLES];
+} PACKED hf_sniff_stream_frame_t;
+
+// Live ISO14443A sniff, CMD_HF_ISO14443A_SNIFF_STREAM, takes the same param byte as CMD_HF_ISO14443A_SNIFF.
+// Completed tracelog_hdr_t records are pushed while sniffing continues. Frames only go out while reader
+// and tag are both quiet, so the DMA loop keeps up. Runs until CMD_BREAK_LOOP or button press,
+// the last frame has final set. CMD_HF_ISO15693_SNIFF_STREAM, CMD_HF_ISO14443B_SNIFF_STREAM and
+// CMD_HF_FELICA_SNIFF_STREAM ship their records in the same frames.
+#define HF14A_SNIFF_RECORDS         (PM3_CMD_DATA_SIZE - 6)
+
+typedef struct {
+    uint16_t seq;
+    bool final;
+    uint8_t reserved;
+    uint16_t len;                           // bytes of whole records in data
+    uint8_t data[HF14A_SNIFF_RECORDS];
+} PACKED hf14a_sniff_frame_t;
+
+// On device ISO15693 dump, CMD_HF_ISO15693_DUMP. The field stays up for the whole dump, blocks are read
+// with READ MULTIPLE BLOCKS in groups of ISO15_DUMP_MULTI_BLOCKS, a tag that refuses it gets
+// single block reads for the rest. Frames carry the security status bytes of count blocks
+// followed by their data, the last frame has final set
+#define ISO15_DUMP_SINGLE           0x01    // flags, only READ SINGLE BLOCK
+#define ISO15_DUMP_MULTI_BLOCKS     16
+#define ISO15_DUMP_FRAME_DATA       (PM3_CMD_DATA_SIZE - 4)
+
+typedef struct {
+    uint8_t uid[8];
+    uint8_t flags;
+} PACKED iso15_dump_req_t;
+
+typedef struct {
+    bool final;
+    uint8_t blocksize;
+    uint8_t first;                          // block number of the first block in this frame
+    uint8_t count;
+    uint8_t data[ISO15_DUMP_FRAME_DATA];    // count security bytes, then count * blocksize data
+} PACKED iso15_dump_frame_t;
+
+// ISO15693 16 slot inventory with anticollision, CMD_HF_ISO15693_INVENTORY and CMD_HF_ISO15693_FINDAFI.
+// Slots that collide are split again on the next four UID bits until every tag answered alone.
+// findafi runs one inventory without AFI, then polls every AFI with a short 1 slot window and only
+// runs the full anticollision for the values that got an answer. afi is the most specific AFI value
+// a tag answered to, 0 when it answered none
+#define ISO15_INVENTORY_MAX_TAGS    32
+#define ISO15_INVENTORY_TRUNCATED   0x01    // flags, more tags or collisions than fit
+
+typedef struct {
+    uint8_t uid[8];
+    uint8_t dsfid;
+    uint8_t afi;
+} PACKED iso15_inventory_tag_t;
+
+typedef struct {
+    uint8_t count;
+    uint8_t flags;
+    iso15_inventory_tag_t tags[ISO15_INVENTORY_MAX_TAGS];
+} PACKED iso15_inventory_resp_t;
+
+// FeliCa polling with time slots, CMD_HF_FELICA_INVENTORY. Request is the number of slots
+// (1, 2, 4, 8 or 16), the answer lists every card seen, deduplicated by IDm
+#define FELICA_INVENTORY_MAX_CARDS  16
+#define FELICA_INVENTORY_TRUNCATED  0x01    // flags, more cards than fit
+
+typedef struct {
+    uint8_t IDm[8];
+    uint8_t PMm[8];
+} PACKED felica_inventory_card_t;
+
+typedef struct {
+    uint8_t count;
+    uint8_t flags;
+    felica_inventory_card_t cards[FELICA_INVENTORY_MAX_CARDS];
+} PACKED felica_inventory_resp_t;
+
+// DESFire command with the additional frames fetched on the device, CMD_HF_DESFIRE_CHAINED. The card
+// is selected already, the apdu is ISO wrapped (90 INS P1 P2 [Lc data] Le) and goes out in one
+// ISO14443-4 block of the session CMD_HF_ISO14443A_READER uses. Every card answer lands in data as one
+// length byte and the answer without its SW, sw is the status of the last one. Answers that don't fit
+// go in more frames, the last one has final set
+#define DESFIRE_CHAIN_ALL           0x01    // flags, keep asking while the card answers 91AF
+#define DESFIRE_CHAIN_MAX_APDU      56      // fits one block at the 64 byte FSC of DESFire cards
+#define DESFIRE_CHAIN_DATA          (PM3_CMD_DATA_SIZE - 6)
+
+typedef struct {
+    uint8_t flags;
+    uint8_t len;
+    uint8_t apdu[DESFIRE_CHAIN_MAX_APDU];
+} PACKED desfire_chain_req_t;
+
+typedef struct {
+    uint16_t sw;
+    bool final;
+    uint8_t frames;                         // card answers in data
+    uint16_t len;
+    uint8_t data[DESFIRE_CHAIN_DATA];
+} PACKED desfire_chain_resp_t;
+
+// Dictionary check on the device, CMD_HF_DESFIRE_CHKKEYS. The keys are tried on one key slot one after
+// the other, a wrong key costs the two exchanges of the first authentication step and the card stays
+// selected for the next one. DESFire: the application is selected already, mode and algo are
+// MFDES_AUTH_x / MFDES_ALGO_x, keyno is the key number. MIFARE Plus SL3: mode DESFIRE_CHK_MFP, keyno is
+// the key address, AES keys
+#define DESFIRE_CHK_MFP             0x80    // mode, MIFARE Plus first authentication
+#define DESFIRE_CHK_SELECT          0x01    // flags, select the card before the first key
+#define DESFIRE_CHK_KEYS_DATA       (PM3_CMD_DATA_SIZE - 7)
+
+typedef struct {
+    uint8_t mode;
+    uint8_t algo;
+    uint16_t keyno;
+    uint8_t flags;
+    uint8_t keylen;
+    uint8_t count;
+    uint8_t keys[DESFIRE_CHK_KEYS_DATA];
+} PACKED desfire_chk_req_t;
+
+typedef struct {
+    bool found;
+    uint8_t index;                          // key that authenticated
+    uint8_t tried;
+    uint16_t sw;                            // DESFire status when the card refused the key slot
+} PACKED desfire_chk_resp_t;
+
+// MIFARE Plus SL3 dictionary check over many key addresses at once, CMD_HF_MFP_CHKKEYS. The keys are tried on
+// slots key addresses keyno, keyno + stride, ... one after the other. Slots set in done are skipped, a slot the
+// card refuses is given up. The card is selected at the start and again after every hit, the field is off at the
+// end. Only the hits come back. Runs until done, CMD_BREAK_LOOP or button press, the hits so far come with
+// PM3_EOPABORTED
+#define MFP_CHK_MAX_SLOTS           128
+#define MFP_CHK_KEYS_DATA           (PM3_CMD_DATA_SIZE - 6 - MFP_CHK_MAX_SLOTS / 8)
+
+typedef struct {
+    uint16_t keyno;
+    uint8_t stride;
+    uint8_t slots;
+    uint8_t reserved;
+    uint8_t count;                          // 16 byte AES keys in keys
+    uint8_t done[MFP_CHK_MAX_SLOTS / 8];    // bit per slot
+    uint8_t keys[MFP_CHK_KEYS_DATA];
+} PACKED mfp_chk_req_t;
+
+typedef struct {
+    uint8_t found[MFP_CHK_MAX_SLOTS / 8];   // bit per slot
+    uint8_t refused[MFP_CHK_MAX_SLOTS / 8]; // the card does not know the key address
+    uint8_t index[MFP_CHK_MAX_SLOTS];       // of the key that authenticated
+    uint16_t tried;
+} PACKED mfp_chk_resp_t;
+
+// Password check on the device, CMD_HF_MIFAREU_CHKPWD. EV1 / NTAG PWD_AUTH passwords, 4 bytes each, or with
+// MFU_CHK_ULC UL-C 3DES keys, 16 bytes each. The card is selected with anticollision once and woken up by its
+// UID after every refused key. Stops at the first key that fits, the field is off afterwards
+#define MFU_CHK_ULC                 0x01    // flags, UL-C 3DES keys
+#define MFU_CHK_KEYS_DATA           (PM3_CMD_DATA_SIZE - 2)
+
+typedef struct {
+    uint8_t flags;
+    uint8_t count;
+    uint8_t keys[MFU_CHK_KEYS_DATA];
+} PACKED mfu_chk_req_t;
+
+typedef struct {
+    bool found;
+    uint8_t index;                          // key that authenticated
+    uint8_t tried;
+    uint8_t pack[2];                        // EV1 / NTAG answer to the password
+} PACKED mfu_chk_resp_t;
+
+// Ultralight / NTAG dump in one session, CMD_HF_MIFAREU_DUMP. Pages go to BigBuf, with MFU_DUMP_FAST_READ in
+// FAST_READ ranges of MFU_FAST_READ_PAGES, else with READ 4 pages at a time. Version, counters, tearing flags
+// and signature are read in the same session, a command the tag refuses costs a reselect by UID
+#define MFU_DUMP_FAST_READ          0x01    // flags, EV1 / NTAG21x
+#define MFU_DUMP_VERSION            0x02
+#define MFU_DUMP_SIGNATURE          0x04
+// 63 pages + CRC fill a 256 byte frame
+#define MFU_FAST_READ_PAGES         63
+
+typedef struct {
+    uint8_t flags;
+    uint8_t startpage;
+    uint16_t pages;
+    uint8_t keytype;                        // 0 none, 1 UL-C 3DES, 2 EV1 / NTAG password
+    uint8_t counters;                       // bit n: read counter n
+    uint8_t tearing;                        // bit n: read the tearing flag of counter n
+    uint8_t key[16];
+} PACKED mfu_dump_req_t;
+
+typedef struct {
+    uint16_t pages;                         // read, from startpage
+    uint32_t offset;                        // of the pages in BigBuf
+    uint8_t pack[2];                        // answer to the EV1 / NTAG password
+    uint8_t version[8];
+    uint8_t counter_tearing[3][4];          // like mfu_dump_t
+    uint8_t signature[32];
+} PACKED mfu_dump_resp_t;
+
+// OTP tear-off sweep, CMD_HF_MFU_OTP_TEAROFF_SWEEP. For each block of block..block + blocks - 1, each delay of
+// start, start + step .. end and repeat times: full write of data, WRITE of tear cut off delay ns after the
+// frame, power cycle and read back. Attempts are logged in BigBuf and sent in frames while the sweep runs,
+// the final frame carries the status. Delays are timed in 1 / 48MHz steps
+#define MFU_TEAROFF_NO_RESTORE      0x01    // flags, no full write of data before an attempt
+#define MFU_TEAROFF_STOP_PARTIAL    0x02    // stop at the first MFU_TEAROFF_PARTIAL
+#define MFU_TEAROFF_LOG_ENTRIES     1024
+
+// mfu_tearoff_entry_t status
+#define MFU_TEAROFF_UNCHANGED       0
+#define MFU_TEAROFF_WRITTEN         1       // the block reads tear, or before | tear on the OTP block
+#define MFU_TEAROFF_PARTIAL         2       // neither
+#define MFU_TEAROFF_NO_TAG          3       // select, restore or read failed
+
+typedef struct {
+    uint8_t block;
+    uint8_t blocks;
+    uint8_t flags;
+    uint8_t repeat;
+    uint32_t start;                         // ns
+    uint32_t end;
+    uint32_t step;
+    uint8_t data[4];
+    uint8_t tear[4];
+} PACKED mfu_tearoff_sweep_req_t;
+
+typedef struct {
+    uint32_t delay;                         // ns
+    uint8_t block;
+    uint8_t status;
+    uint8_t before[4];
+    uint8_t after[4];
+} PACKED mfu_tearoff_entry_t;
+
+#define MFU_TEAROFF_FRAME_ENTRIES   ((PM3_CMD_DATA_SIZE - 4) / sizeof(mfu_tearoff_entry_t))
+
+typedef struct {
+    bool final;
+    uint8_t count;
+    uint16_t first;                         // index in the log of entries[0]
+    mfu_tearoff_entry_t entries[MFU_TEAROFF_FRAME_ENTRIES];
+} PACKED mfu_tearoff_frame_t;
+
+// Tear-off sweep of a raw 14a frame, CMD_HF_ISO14443A_TEAROFF_SWEEP. For each offset of start, start + step .. end
+// in ssp clocks (16 / fc, ~1.18us) after the end of the frame and repeat times: power up, select, setup frames,
+// readback frame, the frame cut off at the offset, power up, select, setup frames and readback again. The two
+// readback answers are logged in BigBuf and sent in frames while the sweep runs, the final one carries the status
+#define ISO14A_TEAROFF_CRC          0x01    // flags, append a CRC to every frame
+#define ISO14A_TEAROFF_RATS         0x02    // select with RATS
+#define ISO14A_TEAROFF_STOP_CHANGED 0x04    // stop at the first ISO14A_TEAROFF_CHANGED
+#define ISO14A_TEAROFF_LOG_ENTRIES  512
+#define ISO14A_TEAROFF_ANSWER       18      // readback bytes kept, a READ with its CRC
+#define ISO14A_TEAROFF_FRAME_MAX    254     // bytes of a frame, a 256 byte frame with the CRC
+
+// iso14a_tearoff_entry_t status
+#define ISO14A_TEAROFF_UNCHANGED    0
+#define ISO14A_TEAROFF_CHANGED      1       // readback after differs from before
+#define ISO14A_TEAROFF_NO_TAG       2       // no select / setup / readback before
+#define ISO14A_TEAROFF_LOST         3       // no select / setup / readback after
+
+typedef struct {
+    uint8_t flags;
+    uint8_t repeat;
+    uint16_t setup_len;                     // setup frames, each a length byte and the frame
+    uint8_t frame_len;                      // the frame that is cut off
+    uint8_t readback_len;                   // 0 no readback, just select and setup
+    uint8_t reserved[2];
+    uint32_t start;
+    uint32_t end;
+    uint32_t step;
+    uint8_t data[PM3_CMD_DATA_SIZE - 20];   // setup frames, frame, readback
+} PACKED iso14a_tearoff_sweep_req_t;
+
+typedef struct {
+    uint32_t offset;
+    uint8_t status;
+    uint8_t before_len;
+    uint8_t after_len;
+    uint8_t before[ISO14A_TEAROFF_ANSWER];
+    uint8_t after[ISO14A_TEAROFF_ANSWER];
+} PACKED iso14a_tearoff_entry_t;
+
+#define ISO14A_TEAROFF_FRAME_ENTRIES ((PM3_CMD_DATA_SIZE - 4) / sizeof(iso14a_tearoff_entry_t))
+
+typedef struct {
+    bool final;
+    uint8_t count;
+    uint16_t first;                         // index in the log of entries[0]
+    iso14a_tearoff_entry_t entries[ISO14A_TEAROFF_FRAME_ENTRIES];
+} PACKED iso14a_tearoff_frame_t;
+
+// Final reply of CMD_HF_ISO14443A_SIMULATE, how fast the simulated tag answered. fdt is the frame delay of an
+// answer in carrier periods on the 128 * n + 20 / 84 grid, late counts the answers after n = 9 (1172 / 1236),
+// the delay ISO14443-3 wants for REQA, WUPA and anticollision
+typedef struct {
+    uint32_t answers;
+    uint32_t late;
+    uint16_t fdt_max;
+} PACKED iso14a_sim_stats_t;
+
+// A whole APDU to the selected ISO14443-4 card, CMD_HF_ISO14443A_APDU. The device sends it in I-blocks of
+// fsc bytes, PCB and CRC included (0: one I-block), gets the chained answer with R(ACK) and answers WTX.
+// The answer goes back in frames as it comes, the final one carries the error
+#define ISO14A_APDU_MAX             (PM3_CMD_DATA_SIZE - 4)
+#define ISO14A_APDU_DATA            (PM3_CMD_DATA_SIZE - 4)
+
+// iso14a_apdu_resp_t error
+#define ISO14A_APDU_OK              0
+#define ISO14A_APDU_NO_ANSWER       1
+#define ISO14A_APDU_SHORT           2       // an answer block without data or not an I-block
+#define ISO14A_APDU_CRC             3
+#define ISO14A_APDU_CHAIN           4       // a block of the command was not acknowledged
+
+typedef struct {
+    uint16_t fsc;
+    uint16_t len;
+    uint8_t apdu[ISO14A_APDU_MAX];
+} PACKED iso14a_apdu_req_t;
+
+typedef struct {
+    bool final;
+    uint8_t error;
+    uint16_t len;
+    uint8_t data[ISO14A_APDU_DATA];
+} PACKED iso14a_apdu_resp_t;
+
+// UIDs in a loop, CMD_HF_ISO14443A_CUIDS. Every one is a field cycle of off_ms and an anticollision without
+// RATS, the failed ones are only counted. count 0 collects until the button or a command from the client
+// stops it. The UIDs come back in PM3_EPARTIAL frames as they fill up, the final frame has the status
+#define ISO14A_CUIDS_FRAME          ((PM3_CMD_DATA_SIZE - 10) / 11)
+
+typedef struct {
+    uint32_t count;
+    uint16_t off_ms;
+} PACKED iso14a_cuids_req_t;
+
+typedef struct {
+    uint8_t uidlen;
+    uint8_t uid[10];
+} PACKED iso14a_cuid_t;
+
+typedef struct {
+    bool final;
+    uint8_t n;                              // UIDs in this frame
+    uint32_t collected;                     // so far, this frame included
+    uint32_t failed;
+    iso14a_cuid_t uids[ISO14A_CUIDS_FRAME];
+} PACKED iso14a_cuids_frame_t;
+
+// Every card in the field, CMD_HF_ISO14443A_INVENTORY. REQA, anticollision taking the 1 branch of each collision,
+// select and RATS unless no_rats for the ISO14443-4 ones, then HLTA or DESELECT so the card keeps quiet on the
+// next REQA. Until nothing answers. Each card comes back in a PM3_EPARTIAL iso14a_card_select_t reply, the final
+// reply has the number of cards. PM3_ESOFT when a card doesn't halt
+#define ISO14A_INVENTORY_MAX        32
+
+typedef struct {
+    bool no_rats;
+} PACKED iso14a_inventory_req_t;
+
+// Magic gen1 card written from the emulator memory in one backdoor session, CMD_HF_MIFARE_CLOAD.
+// The reply has the number of blocks written (and read back the same with verify)
+typedef struct {
+    uint16_t blocks;
+    bool verify;
+} PACKED mifare_cload_req_t;
+
+// Answer of CMD_HF_MIFARE_STATIC_NESTED, up to MF_STATIC_NESTED_NONCES tag nonces of the target
+// and their keystream, all with the key of the target
+#define MF_STATIC_NESTED_NONCES     3
+
+typedef struct {
+    int16_t isOK;
+    uint8_t block;
+    uint8_t keytype;
+    uint8_t cuid[4];
+    uint8_t count;
+    struct {
+        uint8_t nt[4];
+        uint8_t ks[4];
+    } PACKED nonces[MF_STATIC_NESTED_NONCES];
+} PACKED mf_static_nested_resp_t;
+
+// Answer of CMD_LF_PCF7931_READ, the blocks in the order of the memory, bit n of mask is set when
+// block n was found. Blocks seen without knowing where they go are in single
+typedef struct {
+    uint8_t max_blocks;
+    uint8_t mask;
+    uint8_t blocks[8][16];
+    uint8_t single_cnt;
+    uint8_t single[8][16];
+} PACKED lf_pcf7931_read_t;
+
+// Final answer of CMD_HF_LEGIC_SIMULATE, how well the simulation kept the tag timeslots
+typedef struct {
+    uint32_t frames;        // tag frames and write acks sent
+    uint32_t late_frames;   // computed after their timeslot started
+    uint32_t late_bits;     // bits that went out late within a frame
+} PACKED legic_sim_stats_t;
+
+// Windowed flash memory uploads, CMD_FLASHMEM_WRITE_STREAM and CMD_SPIFFS_WRITE_STREAM
+// The client keeps up to FLASH_UPLOAD_WINDOW chunks in flight, the device answers each one with its seq.
+// For SPIFFS the data of seq 0 is the file name, it opens the file. The answer to the chunk flagged
+// FLASH_UPLOAD_LAST holds the CRC32 of the whole upload, read back from the flash or the file
+#define FLASH_UPLOAD_WINDOW         4
+#define FLASH_UPLOAD_LAST           0x01
+#define FLASH_UPLOAD_CHUNK_SIZE     (PM3_CMD_DATA_SIZE - sizeof(uint8_t) - sizeof(uint16_t) - sizeof(uint32_t) - sizeof(uint16_t))
+
+typedef struct {
+    uint8_t flags;
+    uint16_t seq;
+    uint32_t offset;                        // in flash memory, in the file for SPIFFS
+    uint16_t len;
+    uint8_t data[FLASH_UPLOAD_CHUNK_SIZE];
+} PACKED flash_upload_chunk_t;
+
+typedef struct {
+    uint16_t seq;
+    uint32_t length;                        // with FLASH_UPLOAD_LAST, bytes read back
+    uint32_t crc;
+} PACKED flash_upload_ack_t;
+
+// On device demodulation of an LF read, CMD_LF_READ_DEMOD. The device samples as 'lf read' with the LF config
+// and runs the lfdemod.c demodulators itself, only the bits come back, packed msb first. modulation takes the
+// T55xx config block values (DEMOD_* of cmdlft55xx.h). With LF_DEMOD_AUTO the 'lf watch' tag demodulators are
+// tried instead, the first tag found comes back in tag_type, hi2, hi, lo and desc. PM3_ESOFT when nothing demods
+#define LF_DEMOD_AUTO               0xFF
+#define LF_DEMOD_SAMPLES            16385   // the most any of the tag demodulators looks at
+
+typedef struct {
+    uint32_t samples;                       // 0 for LF_DEMOD_SAMPLES
+    uint8_t modulation;
+    uint8_t invert;
+} PACKED lf_demod_req_t;
+
+typedef struct {
+    uint32_t samples;                       // read
+    uint8_t modulation;
+    uint8_t invert;
+    uint16_t clock;
+    uint16_t len;                           // bits
+    uint8_t tag_type;                       // LF_WATCH_*
+    uint32_t hi2;
+    uint32_t hi;
+    uint64_t lo;
+    char desc[128];
+} PACKED lf_demod_info_t;
+
+typedef struct {
+    lf_demod_info_t info;
+    uint8_t bits[PM3_CMD_DATA_SIZE - sizeof(lf_demod_info_t)];
+} PACKED lf_demod_resp_t;
+
+// Whole memory of a Topaz / NFC Type 1 tag, CMD_HF_TOPAZ_READALL. WUPA, RID and RALL, then for a dynamic tag with
+// a CC READ8 of block 0x0F and RSEG of segment 1 on, as far as the memory size of the CC goes. The memory comes
+// back in order, in PM3_EPARTIAL replies of at most TOPAZ_READALL_CHUNK bytes but the last one. PM3_ESOFT without
+// a tag, PM3_ECARDEXCHANGE when it stopped answering
+#define TOPAZ_MAX_MEMORY            512
+#define TOPAZ_READALL_CHUNK         256
+
+typedef struct {
+    uint8_t hr[2];                          // HR0 HR1 of RID
+    uint16_t size;                          // memory of the tag
+    uint16_t offset;
+    uint16_t len;
+    uint8_t data[TOPAZ_READALL_CHUNK];
+} PACKED topaz_readall_resp_t;
+
+// A whole file of the selected ISO14443-4 card, CMD_HF_ISO14443A_READ_BINARY. SELECT of fid first unless it is 0,
+// then READ BINARY of at most le bytes (0: 256) from offset on, each through the block protocol of
+// CMD_HF_ISO14443A_APDU, until len bytes or the end of the file. With nlen the file starts with its length,
+// the NLEN of an NDEF file, and len is only the most to read. The data comes back in frames as it is read,
+// the final one carries the error and sw, the status word of the last APDU
+#define ISO14A_READ_BINARY_DATA     (PM3_CMD_DATA_SIZE - 8)
+
+typedef struct {
+    uint16_t fsc;
+    uint16_t fid;
+    uint16_t offset;
+    uint16_t len;
+    uint16_t le;
+    bool nlen;
+} PACKED iso14a_read_binary_req_t;
+
+typedef struct {
+    bool final;
+    uint8_t error;                          // ISO14A_APDU_
+    uint16_t sw;
+    uint16_t read;                          // the whole file so far
+    uint16_t len;
+    uint8_t data[ISO14A_READ_BINARY_DATA];
+} PACKED iso14a_read_binary_resp_t;
+
+// ISO15693 simulation, CMD_HF_ISO15693_SIMULATE. With block_count set the tag memory is the first
+// block_count * block_size bytes of emulator memory, the answers to reads are coded from it beforehand
+#define ISO15_SIM_MAX_BLOCK_SIZE    32
+#define ISO15_SIM_MAX_MEMORY        4096    // emulator memory
+#define ISO15_SIM_MAX_READ          1024    // bytes of a READ MULTIPLE BLOCKS answer
+
+typedef struct {
+    uint8_t uid[8];
+    uint8_t block_size;
+    uint16_t block_count;
+} PACKED iso15_sim_req_t;
+
+// On device relay of a 14a reader to the card in the smart card slot, CMD_SMART_RELAY. The device answers
+// the activation itself and forwards the APDUs, a slow card keeps the reader waiting with WTX requests.
+// The relay runs until the button is pressed, it replies with the numbers of the session
+typedef struct {
+    uint8_t flags;                          // SC_RAW_T0
+    uint8_t uidlen;                         // 4 or 7
+    uint8_t uid[7];
+} PACKED sc_relay_req_t;
+
+typedef struct {
+    uint32_t apdus;
+    uint32_t wtx;
+    uint32_t max_ms;                        // slowest APDU, WTX included
+} PACKED sc_relay_resp_t;
+
+// MIFARE Classic fingerprint, CMD_HF_MIFARE_FINGERPRINT. The magic, static nonce, prng and nack bug tests of
+// the client in one call. prng is only set with NONCE_NORMAL, and the nack bug test only runs then
+#define MF_FINGERPRINT_MAGIC        0x01
+#define MF_FINGERPRINT_NACK         0x02
+#define MF_FINGERPRINT_NOT_TESTED   0xFF    // nack, the test didn't run
+
+typedef struct {
+    uint8_t flags;
+} PACKED mf_fingerprint_req_t;
+
+typedef struct {
+    uint8_t magic;                          // MAGIC_* of CMD_HF_MIFARE_CIDENT
+    uint8_t nonce;                          // NONCE_* of CMD_HF_MIFARE_STATIC_NONCE
+    uint8_t prng;                           // 1 weak, 0 hard
+    uint32_t nt;                            // last tag nonce
+    uint8_t nack;                           // the data of CMD_HF_MIFARE_NACK_DETECT
+    uint8_t nacks;
+    uint16_t auths;
+} PACKED mf_fingerprint_resp_t;
+
+// Anticollision fuzzing, CMD_HF_ISO14443A_ANTIFUZZ. The device answers as a tag with one variation of the spec
+// after the other: each uid length of the flags, with each atqa, each sak of the last cascade level and each
+// delay, the answers all precoded before the field is listened to. A delay adds that many bit times of
+// 128/fc to the frame delay of every answer. A variation is kept for activations REQA / WUPA of the reader,
+// rounds times over the whole spec, 0 until the button. Every reader frame and answer goes to the trace.
+// PM3_EPARTIAL frames of iso14a_antifuzz_resp_t about once a second, the last one has the status
+#define ANTIFUZZ_UID4           0x01
+#define ANTIFUZZ_UID7           0x02
+#define ANTIFUZZ_UID10          0x04
+#define ANTIFUZZ_COLLIDE        0x08    // the uid bits all collide and nothing gets selected, the original antifuzz
+#define ANTIFUZZ_BADBCC         0x10    // each variation once more with the BCCs inverted
+#define ANTIFUZZ_MAX_VALUES     8
+
+typedef struct {
+    uint8_t flags;
+    uint8_t atqa_n;
+    uint8_t sak_n;
+    uint8_t delay_n;
+    uint8_t activations;
+    uint32_t rounds;
+    uint8_t uid[10];                        // the first 4, 7 or 10 bytes for each length
+    uint8_t atqa[ANTIFUZZ_MAX_VALUES][2];
+    uint8_t sak[ANTIFUZZ_MAX_VALUES];
+    uint8_t delay[ANTIFUZZ_MAX_VALUES];
+} PACKED iso14a_antifuzz_t;
+
+typedef struct {
+    uint32_t variations;                    // in the spec
+    uint32_t round;
+    uint32_t variation;                     // the current one
+    uint32_t activations;                   // REQA / WUPA of the reader so far
+    uint32_t selects;                       // selects up to the last cascade level
+} PACKED iso14a_antifuzz_resp_t;
+
+// Image data of a Waveshare e-paper tag, CMD_HF_WAVESHARE_UPLOAD. The client selects and sets up the tag with
+// CMD_HF_ISO14443A_READER, the device then sends count frames `cd <cmd> <len> <len image bytes>` with CRC,
+// each one again until the tag answers 00 00, and waits delay ms after each. The reply status is
+// PM3_ECARDEXCHANGE when a frame failed, data holds the number of frames the tag took
+#define WSHARE_UPLOAD_DATA          (PM3_CMD_DATA_SIZE - 4)
+#define WSHARE_UPLOAD_RETRIES       10
+
+typedef struct {
+    uint8_t cmd;                            // 0x05, 0x08 or 0x19
+    uint8_t len;                            // image bytes per frame
+    uint8_t count;
+    uint8_t delay;
+    uint8_t data[WSHARE_UPLOAD_DATA];
+} PACKED wshare_upload_req_t;
+
+// LTO-CM cartridge memory, CMD_HF_LTO_DUMP / CMD_HF_LTO_RESTORE. The device wakes up and selects the tag once,
+// then reads blocks first..last with READ BLOCK / READ BLOCK CONTINUE, or writes count blocks from first on.
+// The dump comes back in frames as it is read, the final one carries the status
+#define LTO_BLOCK_SIZE              32
+#define LTO_FRAME_BLOCKS            ((PM3_CMD_DATA_SIZE - 8) / LTO_BLOCK_SIZE)
+
+typedef struct {
+    uint8_t first;
+    uint8_t last;
+} PACKED lto_dump_req_t;
+
+typedef struct {
+    bool final;
+    uint8_t first;                          // block number of data[0]
+    uint8_t count;
+    uint8_t uid[5];
+    uint8_t data[LTO_FRAME_BLOCKS * LTO_BLOCK_SIZE];
+} PACKED lto_dump_frame_t;
+
+// the reply data is the number of blocks written
+typedef struct {
+    uint8_t first;
+    uint8_t count;
+    uint8_t data[LTO_FRAME_BLOCKS * LTO_BLOCK_SIZE];
+} PACKED lto_restore_req_t;
+
+// PACE nonces in a loop, CMD_HF_EPA_COLLECT_NONCE_STREAM. The card is selected and its CardAccess parsed once,
+// every nonce is then an MSE:Set AT and a Get Nonce, the session is set up again when one of them fails.
+// count 0 collects until the button or a command from the client stops it. The nonces come back in
+// PM3_EPARTIAL frames, one length byte before each, the final frame has the status and the failing step
+#define EPA_NONCE_FRAME_DATA        (PM3_CMD_DATA_SIZE - 12)
+#define EPA_NONCE_RETRIES           3       // set ups in a row without a nonce before giving up
+
+typedef struct {
+    uint8_t m;                              // nonce size
+    uint32_t count;
+} PACKED epa_nonce_stream_req_t;
+
+typedef struct {
+    bool final;
+    uint8_t step;                           // as CMD_HF_EPA_COLLECT_NONCE, 0 when not failed
+    int16_t func_return;
+    uint32_t collected;                     // nonces so far, data included
+    uint16_t len;
+    uint8_t data[EPA_NONCE_FRAME_DATA];
+} PACKED epa_nonce_frame_t;
+
+// SRI512 / SRIX4K memory dump, CMD_HF_SRI_READ. The tag is selected once, every block is read with a short
+// answer window and a few retries. Blocks 0..blocks follow in frames, the final one also carries the
+// system block 0xFF
+#define SRX_DUMP_FRAME_BLOCKS       ((PM3_CMD_DATA_SIZE - 8) / 4)
+
+typedef struct {
+    uint8_t blocks;                         // last block number, 0x0F SRI512, 0x7F SRIX4K
+} PACKED srx_dump_req_t;
+
+typedef struct {
+    bool final;
+    uint8_t first;
+    uint8_t count;
+    uint8_t reserved;
+    uint8_t system[4];                      // block 0xFF, final frame only
+    uint8_t data[SRX_DUMP_FRAME_BLOCKS * 4];
+} PACKED srx_dump_frame_t;
+
+// HF pre-filter for `hf search`, CMD_HF_SEARCH. One pass on the device with the field kept up measures
+// the antenna and polls a REQA/WUPA, 15693 inventory, iCLASS ACTALL, WUPB and SRx INITIATE with the
+// short reader timeouts. The client then only runs the full info command for protocols seen here
+#define HF_SEARCH_14A               0x0001
+#define HF_SEARCH_TOPAZ             0x0002  // ATQA without anticollision
+#define HF_SEARCH_15693             0x0004
+#define HF_SEARCH_ICLASS            0x0008
+#define HF_SEARCH_14B               0x0010
+#define HF_SEARCH_SRX               0x0020
+#define HF_SEARCH_NO_FIELD          0x8000  // antenna below HF_SEARCH_UNUSABLE_V, nothing was polled
+
+#define HF_SEARCH_UNUSABLE_V        3000
+
+typedef struct {
+    uint16_t found;                         // HF_SEARCH_ flags
+    uint16_t v_hf;                          // antenna voltage in mV with the reader field on
+} PACKED hf_search_resp_t;
+
+// Streamed downloads, CMD_DOWNLOAD_STREAM
+// The device pushes the whole range as CMD_DOWNLOADED_STREAM frames with a sequence number,
+// then replies to CMD_DOWNLOAD_STREAM with the CRC32 (crc32_ex style) over the whole range.
+#define DL_STREAM_BIGBUF       0
+#define DL_STREAM_BIGBUF_EML   1
+#define DL_STREAM_FLASHMEM     2
+
+// flags
+#define DL_STREAM_LZ4          0x01         // LZ4 compressed frames, BigBuf memtypes only
+
+typedef struct {
+    uint8_t memtype;
+    uint8_t flags;
+    uint32_t start;
+    uint32_t length;
+} PACKED download_stream_req_t;
+
+#define DL_STREAM_CHUNK_SIZE   (PM3_CMD_DATA_SIZE - sizeof(uint16_t))
+
+typedef struct {
+    uint16_t seq;                           // chunk offset = seq * DL_STREAM_CHUNK_SIZE
+    uint8_t data[DL_STREAM_CHUNK_SIZE];
+} PACKED download_stream_chunk_t;
+
+// With DL_STREAM_LZ4, each frame is an independent LZ4 block covering rawlen bytes at offset
+#define DL_STREAM_LZ4_DATA_SIZE (PM3_CMD_DATA_SIZE - sizeof(uint16_t) - sizeof(uint32_t) - sizeof(uint16_t))
+#define DL_STREAM_LZ4_MAX_RAW   4096
+
+typedef struct {
+    uint16_t seq;
+    uint32_t offset;                        // relative to start of the requested range
+    uint16_t rawlen;
+    uint8_t data[DL_STREAM_LZ4_DATA_SIZE];
+} PACKED download_stream_lz4_chunk_t;
+
+typedef struct {
+    uint32_t length;                        // bytes pushed
+    uint32_t crc;
+    uint16_t frames;                        // CMD_DOWNLOADED_STREAM frames pushed
+    uint32_t tracelen;                      // BigBuf tracelen, as arg2 of legacy CMD_DOWNLOAD_BIGBUF
+    sample_config config;                   // LF sampling config, as payload of legacy CMD_DOWNLOAD_BIGBUF ACK
+} PACKED download_stream_end_t;
+
+// Streamed emulator memory uploads, CMD_UPLOAD_EML_STREAM
+// The client keeps up to EML_UPLOAD_WINDOW chunks in flight, the device answers each one
+// with its seq in order. The first chunk (seq 0) loads the HF FPGA image like iCLASS eload did
+#define EML_UPLOAD_WINDOW      4
+#define EML_UPLOAD_CHUNK_SIZE  (PM3_CMD_DATA_SIZE - sizeof(uint16_t) - sizeof(uint32_t) - sizeof(uint16_t))
+
+typedef struct {
+    uint16_t seq;
+    uint32_t offset;                        // in emulator memory
+    uint16_t len;
+    uint8_t data[EML_UPLOAD_CHUNK_SIZE];
+} PACKED eml_upload_chunk_t;
+
+// Batched key checks. CMD_HF_MIFARE_CHKKEYS_LOAD fills a candidate key list in BigBuf,
+// CMD_HF_MIFARE_CHKKEYS_BATCH checks all of it, sending progress frames until the final one
+#define MF_CHKKEYS_BATCH_MAX_KEYS   4096
+#define MF_CHKKEYS_LOAD_LZ4         0x01    // data is a LZ4 block
+
+typedef struct {
+    uint8_t flags;
+    uint16_t offset;                        // byte offset in the key list, 0 starts a new list
+    uint16_t rawlen;                        // bytes written at offset, after decompression
+    uint8_t data[PM3_CMD_DATA_SIZE - 5];
+} PACKED mf_chkkeys_load_t;
+
+typedef struct {
+    uint8_t keytype;
+    uint8_t blockno;
+    uint16_t keycnt;
+} PACKED mf_chkkeys_batch_req_t;
+
+typedef struct {
+    bool final;
+    bool found;
+    uint16_t checked;                       // keys tried so far, index of the key if found
+    uint8_t key[6];
+} PACKED mf_chkkeys_batch_resp_t;
+
+// Key checks against a dictionary file in SPIFFS, 6 byte binary keys as written by `mem spiffs load d`.
+// The device streams the file through the auth loop, progress frames (up to found) until the final one
+typedef struct {
+    uint8_t sectorcnt;
+    uint8_t filename[32];
+} PACKED mf_chkkeys_spiffs_req_t;
+
+typedef struct {
+    bool final;
+    uint8_t foundkeys;
+    uint32_t checked;                       // keys read from the file so far
+    uint8_t found[10];                      // one bit per key, sector * 2 + keytype
+    uint8_t keys[40 * 12];                  // key A, key B of each sector
+} PACKED mf_chkkeys_spiffs_resp_t;
+
+// Framed log files the standalone modes write to SPIFFS: every flush is one chunk, this header then len
+// bytes of payload. A chunk cut short by a power loss fails its length or crc and is dropped on reading
+#define SPIFFS_LOG_MAGIC    0x4C53                  // "SL"
+typedef struct {
+    uint16_t magic;
+    uint16_t len;
+    uint16_t crc;                           // crc16_ccitt of the payload
+} PACKED spiffs_log_chunk_t;
+
+// Continuous darkside. The device keeps recovering (nt, par, ks) tuples, each with a new reader nonce, and
+// pushes one CMD_HF_MIFARE_READER_STREAM frame per tuple until CMD_BREAK_LOOP or button. The last one has
+// final set, isOK tells why it ended (see CMD_HF_MIFARE_READER)
+typedef struct {
+    uint8_t first_run;
+    uint8_t blockno;
+    uint8_t key_type;
+} PACKED mf_darkside_stream_req_t;
+
+typedef struct {
+    int32_t isOK;
+    uint16_t seq;
+    bool final;
+    uint8_t cuid[4];
+    uint8_t nt[4];
+    uint8_t par_list[8];
+    uint8_t ks_list[8];
+    uint8_t nr[4];
+    uint8_t ar[4];
+} PACKED mf_darkside_stream_frame_t;
+
+// Continuous encrypted nonce acquisition for hardnested. The device keeps authenticating and pushes
+// CMD_HF_MIFARE_ACQ_NONCES_STREAM frames until CMD_BREAK_LOOP or button press, the last one has final set.
+#define MF_ACQ_STREAM_SLOW          0x01    // pause before authentication, for some non standard cards
+#define MF_ACQ_STREAM_PAIRS         ((PM3_CMD_DATA_SIZE - 8) / 9)
+
+typedef struct {
+    uint8_t blockno;
+    uint8_t keytype;
+    uint8_t target_blockno;
+    uint8_t target_keytype;
+    uint8_t flags;
+    uint8_t key[6];
+} PACKED mf_acq_stream_req_t;
+
+typedef struct {
+    uint32_t cuid;
+    uint16_t seq;
+    bool final;
+    uint8_t pairs;                          // records of nt_enc1 (4), nt_enc2 (4), par_enc1 << 4 | par_enc2 (1)
+    uint8_t data[MF_ACQ_STREAM_PAIRS * 9];
+} PACKED mf_acq_stream_frame_t;
+
 // A struct used to send hf14a-configs over USB
 typedef struct {
     int8_t forceanticol; // 0:auto 1:force executing anticol 2:force skipping anticol
@@ -129,6 +1018,8 @@ typedef struct {
     int8_t forcecl2;     // 0:auto 1:force executing CL2 2:force skipping CL2
     int8_t forcecl3;     // 0:auto 1:force executing CL3 2:force skipping CL3
     int8_t forcerats;    // 0:auto 1:force executing RATS 2:force skipping RATS
+    int8_t adaptive;     // 0:fixed timeouts 1:learn the answer latency of the card, wait shorter for missing answers
+    uint16_t latency;    // learned answer latency of the selected card in carrier periods, 0 = none. Read only
 } PACKED hf14a_config;
 
 // Tracelog Header struct
@@ -218,6 +1109,15 @@ typedef struct {
 #define CAPABILITIES_VERSION 5
 extern capabilities_t pm3_capabilities;
 
+// For CMD_LF_T55XX_READBL
+typedef struct {
+    uint32_t password;
+    uint8_t  blockno;
+    uint8_t  page;
+    bool     pwdmode;
+    uint8_t  downlink_mode;
+} PACKED t55xx_read_block_t;
+
 // For CMD_LF_T55XX_WRITEBL
 typedef struct {
     uint32_t data;
@@ -226,12 +1126,100 @@ typedef struct {
     uint8_t flags;
 } PACKED t55xx_write_block_t;
 
+// For CMD_LF_T55XX_WRITE_BLOCKS
+#define T55XX_WRITE_BLOCKS_MAX      12
+#define T55XX_WRITE_BLOCKS_VERIFY   0x01
+typedef struct {
+    uint8_t count;
+    uint8_t flags;
+    uint32_t block0;            // config to read back with when block 0 isn't in the list
+    t55xx_write_block_t blocks[T55XX_WRITE_BLOCKS_MAX];
+} PACKED t55xx_write_blocks_t;
+
+typedef struct {
+    uint8_t count;
+    bool verify;                // false when the device couldn't read back
+    uint16_t verified;          // one bit per list entry
+} PACKED t55xx_write_blocks_resp_t;
+
+// For CMD_LF_T55XX_BRUTE
+#define T55XX_BRUTE_DICT        0x01    // passwords from emulator memory instead of the start / end range
+#define T55XX_BRUTE_ALL_DL      0x02    // try every downlink mode for each password
+#define T55XX_BRUTE_DICT_MAX    1024    // passwords per emulator memory load, 4 bytes each
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+    uint16_t pwdcount;          // dictionary mode, passwords in emulator memory
+    uint8_t downlink_mode;
+    uint8_t flags;
+    uint8_t modulation;         // t55xx config block modulation, 0xFF tries them all
+    uint8_t inverted;
+} PACKED t55xx_brute_req_t;
+
+// progress and result frames, the device sends one every T55XX_BRUTE_REPORT passwords
+#define T55XX_BRUTE_REPORT      256
+typedef struct {
+    bool final;
+    bool found;
+    uint8_t downlink_mode;
+    uint8_t modulation;
+    uint32_t password;
+    uint32_t block0;
+    uint32_t tried;
+} PACKED t55xx_brute_resp_t;
+
+// For CMD_LF_EM4X_READ_ALL. Reads the words of mask in one field, with a login before each when usepwd.
+// The device demodulates the answers, ok has a bit for each word that came out, the others are left
+// for the client demodulators
+typedef struct {
+    uint32_t password;
+    uint8_t usepwd;
+    uint16_t mask;
+} PACKED em4x05_read_all_req_t;
+
+typedef struct {
+    uint16_t ok;
+    uint32_t words[16];
+} PACKED em4x05_read_all_resp_t;
+
+// For CMD_LF_EM4X_BRUTE. Logs in with the passwords start .. end, or pwdcount passwords of emulator
+// memory, and looks for the preamble of the answer to a login that worked. Stops at the first hit
+#define EM4X05_BRUTE_DICT       0x01    // passwords from emulator memory instead of the start / end range
+#define EM4X05_BRUTE_DICT_MAX   1024    // passwords per emulator memory load, 4 bytes each
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+    uint16_t pwdcount;
+    uint8_t flags;
+} PACKED em4x05_brute_req_t;
+
+// progress and result frames, the device sends one every EM4X05_BRUTE_REPORT passwords
+#define EM4X05_BRUTE_REPORT     16
+typedef struct {
+    bool final;
+    bool found;
+    uint32_t password;
+    uint32_t tried;
+} PACKED em4x05_brute_resp_t;
+
 typedef struct {
     uint8_t data[128];
     uint8_t bitlen;
     uint32_t time;
 } PACKED t55xx_test_block_t;
 
+// For CMD_LF_HITAG2_NONCES, the device simulates a Hitag2 tag with this uid and
+// streams every reader authentication to the client until CMD_BREAK_LOOP or the button
+typedef struct {
+    uint8_t uid[4];
+} PACKED lf_hitag2_nonces_t;
+
+typedef struct {
+    bool final;
+    uint16_t count;             // authentications seen so far
+    uint8_t nrar[8];            // encrypted nR, aR as received
+} PACKED lf_hitag2_nonce_t;
+
 // For CMD_LF_HID_SIMULATE (FSK)
 typedef struct {
     uint32_t hi2;
@@ -274,12 +1262,113 @@ typedef struct {
     uint8_t data[];
 } PACKED lf_nrzsim_t;
 
+// For CMD_PROFILE, request one byte: 1 = reset the counters after the reply. The handlers are the
+// ones that took the most time since the last reset, times in us
+#define PROFILE_MAX_CMDS    16
+typedef struct {
+    uint16_t cmd;
+    uint32_t calls;
+    uint32_t max_us;
+    uint64_t total_us;
+} PACKED profile_cmd_t;
+
+typedef struct {
+    uint32_t uptime_ms;     // since the last reset
+    uint32_t dma_overruns;  // sniffers that fell behind their DMA buffer
+    uint32_t usb_tx_stalls; // USB writes that waited for the host
+    uint32_t bigbuf_size;
+    uint32_t bigbuf_used;
+    uint32_t bigbuf_peak;
+    uint32_t stack_used;
+    uint32_t stack_size;
+    uint8_t count;
+    profile_cmd_t cmds[PROFILE_MAX_CMDS];
+} PACKED profile_t;
+
+// For CMD_FPGA_BENCH, no request. Times of decompressing the bitstream alone and of a full
+// reconfiguration of the FPGA, which decompresses and clocks it in
+typedef struct {
+    uint32_t bytes;         // of the bitstream
+    uint32_t decode_ms;
+    uint32_t load_ms;
+} PACKED fpga_bench_t;
+
+// For CMD_LF_WATCH, one byte of the types to demodulate on the same capture
+#define LF_WATCH_HID            0x01
+#define LF_WATCH_AWID           0x02
+#define LF_WATCH_IO             0x04
+#define LF_WATCH_EM410X         0x08
+#define LF_WATCH_ALL            0x0F
+
+// For CMD_LF_SIM_SWEEP and CMD_HF_ISO14443A_SIM_SWEEP. Simulates count ids from start on,
+// dwell ms each. LF dwell counts reader field clocks, so without a field the sweep waits.
+// PM3_EPARTIAL frames of sim_sweep_resp_t about once a second, the last one has the status.
+// The button or any command from the client ends the sweep with PM3_EOPABORTED
+#define SIM_SWEEP_EM410X    1   // start is the 40 bit id
+#define SIM_SWEEP_HID26     2   // start is the card number, fc the facility code (H10301)
+#define SIM_SWEEP_14A       3   // start is the 4 or 7 byte uid, tagtype and flags as hf 14a sim
+// count 5 byte EM410x ids follow the struct. start and step are the position of the first one and
+// the length of the whole list, only for the progress
+#define SIM_SWEEP_EM410X_LIST   4
+#define SIM_SWEEP_LIST_MAX  ((PM3_CMD_DATA_SIZE - sizeof(sim_sweep_t)) / 5)
+typedef struct {
+    uint8_t type;
+    uint8_t tagtype;
+    uint8_t flags;
+    uint8_t fc;
+    uint8_t clock;
+    uint16_t dwell;
+    uint32_t step;
+    uint32_t count;
+    uint64_t start;
+} PACKED sim_sweep_t;
+
+typedef struct {
+    uint32_t index;
+    uint64_t value;
+} PACKED sim_sweep_resp_t;
+
 typedef struct {
     uint8_t blockno;
     uint8_t keytype;
     uint8_t key[6];
 } PACKED mf_readblock_t;
 
+// For CMD_HF_MIFARE_READSC_BULK. Sectors 0..sectorcnt-1 in one exchange, selected once and
+// chained with nested authentications. The trailer is read with key A, its access bits pick
+// the key of the data blocks. One frame per sector, then a final one with the status
+typedef struct {
+    uint8_t sectorcnt;
+    uint8_t keyA[40][6];
+    uint8_t keyB[40][6];
+} PACKED mf_readsc_bulk_req_t;
+
+typedef struct {
+    uint8_t sector;
+    bool final;
+    uint16_t readmask;          // bit n set: block n of the sector is in data
+    uint8_t data[16 * 16];      // only the blocks of the sector are sent
+} PACKED mf_readsc_bulk_frame_t;
+
+// For CMD_HF_MIFARE_WRITESC_BULK. count entries, each followed by 16 bytes per block of its sector
+#define MF_WRITESC_BULK_MAX     8
+typedef struct {
+    uint8_t sector;
+    uint8_t keytype;
+    uint8_t key[6];
+    uint8_t data[];
+} PACKED mf_writesc_bulk_entry_t;
+
+typedef struct {
+    uint8_t count;
+    uint8_t data[];
+} PACKED mf_writesc_bulk_req_t;
+
+typedef struct {
+    uint8_t count;
+    uint16_t writemask[MF_WRITESC_BULK_MAX];    // bit n set: block n of the entry's sector was written
+} PACKED mf_writesc_bulk_resp_t;
+
 typedef struct {
     uint8_t sectorcnt;
     uint8_t keytype;
@@ -378,6 +1467,7 @@ typedef struct {
 #define CMD_START_FLASH                                                   0x0005
 #define CMD_CHIP_INFO                                                     0x0006
 #define CMD_BL_VERSION                                                    0x0007
+#define CMD_BL_BLOCK_CRC                                                  0x0008
 #define CMD_NACK                                                          0x00fe
 #define CMD_ACK                                                           0x00ff
 
@@ -401,6 +1491,12 @@ typedef struct {
 #define CMD_WTX                                                           0x0116
 #define CMD_TIA                                                           0x0117
 #define CMD_BREAK_LOOP                                                    0x0118
+#define CMD_DOWNLOAD_STREAM                                               0x0119
+#define CMD_DOWNLOADED_STREAM                                             0x011A
+#define CMD_UPLOAD_EML_STREAM                                             0x011B
+#define CMD_BATCH                                                         0x011C
+#define CMD_PROFILE                                                       0x011D
+#define CMD_FPGA_BENCH                                                    0x011E
 
 // RDV40, Flash memory operations
 #define CMD_FLASHMEM_WRITE                                                0x0121
@@ -409,6 +1505,7 @@ typedef struct {
 #define CMD_FLASHMEM_DOWNLOADED                                           0x0124
 #define CMD_FLASHMEM_INFO                                                 0x0125
 #define CMD_FLASHMEM_SET_SPIBAUDRATE                                      0x0126
+#define CMD_FLASHMEM_WRITE_STREAM                                         0x0127
 
 // RDV40, High level flashmem SPIFFS Manipulation
 // ALL function will have a lazy or Safe version
@@ -436,6 +1533,7 @@ typedef struct {
 #define CMD_SPIFFS_FORMAT                                                 CMD_FLASHMEM_WIPE
 
 #define CMD_SPIFFS_WIPE                                                   0x013A
+#define CMD_SPIFFS_WRITE_STREAM                                           0x013B
 
 // This take a +0x2000 as they are high level helper and special functions
 // As the others, they may have safety level argument if it makkes sense
@@ -456,6 +1554,8 @@ typedef struct {
 #define CMD_SMART_ATR                                                     0x0143
 #define CMD_SMART_SETBAUD                                                 0x0144
 #define CMD_SMART_SETCLOCK                                                0x0145
+#define CMD_SMART_RAW_BULK                                                0x0146
+#define CMD_SMART_RELAY                                                   0x0147
 
 // RDV40,  FPC USART
 #define CMD_USART_RX                                                      0x0160
@@ -493,6 +1593,7 @@ typedef struct {
 #define CMD_LF_EM4X50_WRITE_PASSWORD                                      0x0242
 #define CMD_LF_EM4X50_READ                                                0x0243
 #define CMD_LF_EM4X50_WIPE                                                0x0244
+#define CMD_LF_EM4X50_BRUTE                                               0x0245
 // Sampling configuration for LF reader/sniffer
 #define CMD_LF_SAMPLING_SET_CONFIG                                        0x021D
 #define CMD_LF_FSK_SIMULATE                                               0x021E
@@ -506,9 +1607,17 @@ typedef struct {
 #define CMD_LF_T55XX_SET_CONFIG                                           0x0226
 #define CMD_LF_SAMPLING_PRINT_CONFIG                                      0x0227
 #define CMD_LF_SAMPLING_GET_CONFIG                                        0x0228
+#define CMD_LF_ACQ_RAW_ADC_STREAM                                         0x0229
 
 #define CMD_LF_T55XX_CHK_PWDS                                             0x0230
 #define CMD_LF_T55XX_DANGERRAW                                            0x0231
+#define CMD_LF_T55XX_BRUTE                                                0x0233
+#define CMD_LF_T55XX_WRITE_BLOCKS                                         0x0234
+#define CMD_LF_SIM_SWEEP                                                  0x0235
+#define CMD_LF_WATCH                                                      0x0236
+#define CMD_LF_EM4X_READ_ALL                                              0x0237
+#define CMD_LF_EM4X_BRUTE                                                 0x0238
+#define CMD_LF_READ_DEMOD                                                 0x0239
 
 /* CMD_SET_ADC_MUX: ext1 is 0 for lopkd, 1 for loraw, 2 for hipkd, 3 for hiraw */
 
@@ -516,12 +1625,16 @@ typedef struct {
 #define CMD_HF_ISO15693_ACQ_RAW_ADC                                       0x0300
 #define CMD_HF_SRI_READ                                                   0x0303
 #define CMD_HF_ISO14443B_COMMAND                                          0x0305
+#define CMD_HF_ISO14443B_SNIFF_STREAM                                     0x0306
 #define CMD_HF_ISO15693_READER                                            0x0310
 #define CMD_HF_ISO15693_SIMULATE                                          0x0311
 #define CMD_HF_ISO15693_SNIFF                                             0x0312
 #define CMD_HF_ISO15693_COMMAND                                           0x0313
 #define CMD_HF_ISO15693_FINDAFI                                           0x0315
 #define CMD_HF_ISO15693_CSETUID                                           0x0316
+#define CMD_HF_ISO15693_DUMP                                              0x0317
+#define CMD_HF_ISO15693_INVENTORY                                         0x0318
+#define CMD_HF_ISO15693_SNIFF_STREAM                                      0x0319
 
 #define CMD_LF_SNIFF_RAW_ADC                                              0x0360
 
@@ -535,6 +1648,7 @@ typedef struct {
 #define CMD_LF_HITAGS_SIMULATE                                            0x0368
 #define CMD_LF_HITAGS_READ                                                0x0373
 #define CMD_LF_HITAGS_WRITE                                               0x0375
+#define CMD_LF_HITAG2_NONCES                                              0x0376
 
 #define CMD_HF_ISO14443A_ANTIFUZZ                                         0x0380
 #define CMD_HF_ISO14443B_SIMULATE                                         0x0381
@@ -544,6 +1658,7 @@ typedef struct {
 #define CMD_HF_ISO14443A_SIMULATE                                         0x0384
 
 #define CMD_HF_ISO14443A_READER                                           0x0385
+#define CMD_HF_ISO14443A_SNIFF_STREAM                                     0x0386
 
 #define CMD_HF_LEGIC_SIMULATE                                             0x0387
 #define CMD_HF_LEGIC_READER                                               0x0388
@@ -551,6 +1666,10 @@ typedef struct {
 
 #define CMD_HF_EPA_COLLECT_NONCE                                          0x038A
 #define CMD_HF_EPA_REPLAY                                                 0x038B
+#define CMD_HF_ISO14443A_SIM_SWEEP                                        0x038C
+#define CMD_HF_ISO14443A_TEAROFF_SWEEP                                    0x038D
+#define CMD_HF_ISO14443A_APDU                                             0x038E
+#define CMD_HF_ISO14443A_READ_BINARY                                      0x03A7
 
 #define CMD_HF_LEGIC_INFO                                                 0x03BC
 #define CMD_HF_LEGIC_ESET                                                 0x03BD
@@ -569,11 +1688,24 @@ typedef struct {
 #define CMD_HF_ICLASS_AUTH                                                0x0399
 #define CMD_HF_ICLASS_CHKKEYS                                             0x039A
 #define CMD_HF_ICLASS_RESTORE                                             0x039B
+#define CMD_HF_ICLASS_SIMULATE_STREAM                                     0x039C
+
+// For Waveshare e-paper tags
+#define CMD_HF_WAVESHARE_UPLOAD                                           0x039D
+
+// For the German eID card
+#define CMD_HF_EPA_COLLECT_NONCE_STREAM                                   0x039E
+
+#define CMD_HF_ISO14443A_CUIDS                                            0x039F
+#define CMD_HF_ISO14443A_INVENTORY                                        0x03A5
+#define CMD_HF_TOPAZ_READALL                                              0x03A6
 
 // For ISO1092 / FeliCa
 #define CMD_HF_FELICA_SIMULATE                                            0x03A0
 #define CMD_HF_FELICA_SNIFF                                               0x03A1
 #define CMD_HF_FELICA_COMMAND                                             0x03A2
+#define CMD_HF_FELICA_INVENTORY                                           0x03A3
+#define CMD_HF_FELICA_SNIFF_STREAM                                        0x03A4
 //temp
 #define CMD_HF_FELICALITE_DUMP                                            0x03AA
 #define CMD_HF_FELICALITE_SIMULATE                                        0x03AB
@@ -587,8 +1719,10 @@ typedef struct {
 #define CMD_MEASURE_ANTENNA_TUNING                                        0x0400
 #define CMD_MEASURE_ANTENNA_TUNING_HF                                     0x0401
 #define CMD_MEASURE_ANTENNA_TUNING_LF                                     0x0402
+#define CMD_MEASURE_ANTENNA_TUNING_STREAM                                 0x0403
 #define CMD_LISTEN_READER_FIELD                                           0x0420
 #define CMD_HF_DROPFIELD                                                  0x0430
+#define CMD_HF_SEARCH                                                     0x0431
 
 // For direct FPGA control
 #define CMD_FPGA_MAJOR_MODE_OFF                                           0x0500
@@ -603,6 +1737,7 @@ typedef struct {
 #define CMD_HF_MIFARE_CSETBL                                              0x0605
 #define CMD_HF_MIFARE_CGETBL                                              0x0606
 #define CMD_HF_MIFARE_CIDENT                                              0x0607
+#define CMD_HF_MIFARE_CLOAD                                               0x0608
 
 #define CMD_HF_MIFARE_SIMULATE                                            0x0610
 
@@ -611,6 +1746,8 @@ typedef struct {
 #define CMD_HF_MIFARE_ACQ_ENCRYPTED_NONCES                                0x0613
 #define CMD_HF_MIFARE_ACQ_NONCES                                          0x0614
 #define CMD_HF_MIFARE_STATIC_NESTED                                       0x0615
+#define CMD_HF_MIFARE_ACQ_NONCES_STREAM                                   0x0616
+#define CMD_HF_MIFARE_READER_STREAM                                       0x0617
 
 #define CMD_HF_MIFARE_READBL                                              0x0620
 #define CMD_HF_MIFAREU_READBL                                             0x0720
@@ -619,11 +1756,16 @@ typedef struct {
 #define CMD_HF_MIFARE_WRITEBL                                             0x0622
 #define CMD_HF_MIFAREU_WRITEBL                                            0x0722
 #define CMD_HF_MIFAREU_WRITEBL_COMPAT                                     0x0723
+#define CMD_HF_MIFARE_READSC_BULK                                         0x062A
+#define CMD_HF_MIFARE_WRITESC_BULK                                        0x062B
 
 #define CMD_HF_MIFARE_CHKKEYS                                             0x0623
 #define CMD_HF_MIFARE_SETMOD                                              0x0624
 #define CMD_HF_MIFARE_CHKKEYS_FAST                                        0x0625
 #define CMD_HF_MIFARE_CHKKEYS_FILE                                        0x0626
+#define CMD_HF_MIFARE_CHKKEYS_LOAD                                        0x0627
+#define CMD_HF_MIFARE_CHKKEYS_BATCH                                       0x0628
+#define CMD_HF_MIFARE_CHKKEYS_SPIFFS                                      0x0629
 
 #define CMD_HF_MIFARE_SNIFF                                               0x0630
 #define CMD_HF_MIFARE_MFKEY                                               0x0631
@@ -642,15 +1784,23 @@ typedef struct {
 #define CMD_HF_DESFIRE_READER                                             0x072c
 #define CMD_HF_DESFIRE_INFO                                               0x072d
 #define CMD_HF_DESFIRE_COMMAND                                            0x072e
+#define CMD_HF_DESFIRE_CHAINED                                            0x072f
+#define CMD_HF_DESFIRE_CHKKEYS                                            0x0732
+#define CMD_HF_MFP_CHKKEYS                                                0x0733
 
 #define CMD_HF_MIFARE_NACK_DETECT                                         0x0730
 #define CMD_HF_MIFARE_STATIC_NONCE                                        0x0731
+#define CMD_HF_MIFARE_FINGERPRINT                                         0x0734
 
 // MFU OTP TearOff
 #define CMD_HF_MFU_OTP_TEAROFF                                            0x0740
+#define CMD_HF_MIFAREU_CHKPWD                                             0x0741
+#define CMD_HF_MIFAREU_DUMP                                               0x0742
+#define CMD_HF_MFU_OTP_TEAROFF_SWEEP                                      0x0743
 
 #define CMD_HF_SNIFF                                                      0x0800
 #define CMD_HF_PLOT                                                       0x0801
+#define CMD_HF_SNIFF_STREAM                                               0x0804
 
 // Fpga plot download
 #define CMD_FPGAMEM_DOWNLOAD                                              0x0802
@@ -663,6 +1813,10 @@ typedef struct {
 //For Atmel CryptoRF
 #define CMD_HF_CRYPTORF_SIM                                               0x0820
 
+// For LTO-CM cartridge memory
+#define CMD_HF_LTO_DUMP                                                   0x0830
+#define CMD_HF_LTO_RESTORE                                                0x0831
+
 // Gen 3 magic cards
 #define CMD_HF_MIFARE_GEN3UID                                             0x0850
 #define CMD_HF_MIFARE_GEN3BLK                                             0x0851
@@ -677,6 +1831,7 @@ typedef struct {
 #define FLAG_10B_UID_IN_DATA    0x08
 #define FLAG_UID_IN_EMUL        0x10
 #define FLAG_NR_AR_ATTACK       0x20
+#define FLAG_NO_TRACE           0x40    // hf 14a sim without the trace
 #define FLAG_MF_MINI            0x80
 #define FLAG_MF_1K              0x100
 #define FLAG_MF_2K              0x200
@@ -706,6 +1861,18 @@ typedef struct {
 #define ICLASS_SIM_MODE_EXIT_AFTER_MAC        5  // note: device internal only
 #define ICLASS_SIM_MODE_CONFIG_CARD           6
 
+// Streamed reader attack, sim 2 / 4. CMD_HF_ICLASS_SIMULATE_STREAM takes the same args as CMD_HF_ICLASS_SIMULATE
+// but the device pushes one frame per captured MAC instead of one blob at the end. The last one has final set,
+// count holds the number of MACs captured. The simulation stops on CMD_BREAK_LOOP or button press
+typedef struct {
+    uint8_t index;          // csn index
+    uint8_t keyroll;        // 0 first key, 1 second key (sim 4 only)
+    bool final;
+    uint8_t count;
+    uint8_t csn[8];
+    uint8_t cc_nr_mac[16];  // <8b epurse><4b nr><4b mac>
+} PACKED iclass_sim_stream_frame_t;
+
 #define MODE_SIM_CSN        0
 #define MODE_EXIT_AFTER_MAC 1
 #define MODE_FULLSIM        2
@@ -800,6 +1967,8 @@ typedef struct {
 // uart_windows.c & uart_posix.c
 # define UART_FPC_CLIENT_RX_TIMEOUT_MS  200
 # define UART_USB_CLIENT_RX_TIMEOUT_MS  20
+// longest sleep of an idle communication thread, queued commands wake it up earlier
+# define UART_IDLE_WAIT_MS              500
 # define UART_TCP_CLIENT_RX_TIMEOUT_MS  500
 
 
@@ -825,6 +1994,12 @@ typedef struct {
 /* Set if this device understands the version command */
 #define DEVICE_INFO_FLAG_UNDERSTANDS_VERSION         (1<<6)
 
+/* Set if this device understands the block checksum command */
+#define DEVICE_INFO_FLAG_UNDERSTANDS_BLOCK_CRC       (1<<7)
+
+/* Set if this device understands fast block writes */
+#define DEVICE_INFO_FLAG_UNDERSTANDS_FAST_WRITE      (1<<8)
+
 #define BL_VERSION_MAJOR(version) ((uint32_t)(version) >> 22)
 #define BL_VERSION_MINOR(version) (((uint32_t)(version) >> 12) & 0x3ff)
 #define BL_VERSION_PATCH(version) ((uint32_t)(version) & 0xfff)
@@ -835,6 +2010,8 @@ typedef struct {
 #define BL_VERSION_INVALID  0
 // Different versions here. Each version should increase the numbers
 #define BL_VERSION_1_0_0    BL_MAKE_VERSION(1, 0, 0)
+#define BL_VERSION_1_1_0    BL_MAKE_VERSION(1, 1, 0)
+#define BL_VERSION_1_2_0    BL_MAKE_VERSION(1, 2, 0)
 
 
 /* CMD_START_FLASH may have three arguments: start of area to flash,
@@ -844,4 +2021,15 @@ typedef struct {
 
 #define START_FLASH_MAGIC 0x54494f44 // 'DOIT'
 
+/* CMD_BL_BLOCK_CRC takes the address of the first block in arg0 and the number of blocks in arg1,
+   at most PM3_CMD_DATA_SIZE / 4. The bootrom answers with the CRC32 (preset 0xFFFFFFFF, no final xor)
+   of each BL_CRC_BLOCK_SIZE block as it is in flash, so the flasher only writes blocks that differ */
+#define BL_CRC_BLOCK_SIZE 0x200
+
+/* CMD_FINISH_WRITE with this magic as third parameter is a fast write. The bootrom answers as soon as
+   the last page of the block is programming, the next command waits for it. A failed page is reported
+   by the NACK of the next command, so the flasher can keep BL_FAST_WRITE_WINDOW blocks in flight */
+#define FINISH_WRITE_FAST_MAGIC 0x54534146 // 'FAST'
+#define BL_FAST_WRITE_WINDOW    2
+
 #endif
@@ -338,6 +338,9 @@ ISO 7816-4 Basic interindustry commands. For command APDU's.
 #define TOPAZ_WRITE_E8                0x54 // Write-with-erase (eight bytes)
 #define TOPAZ_WRITE_NE8               0x1B // Write-no-erase (eight bytes)
 
+#define TOPAZ_STATIC_MEMORY           (0x0F * 8) // 15 blocks with 8 Bytes each
+#define TOPAZ_SEGMENT_SIZE            128        // RSEG, 16 blocks
+
 // Definitions of which protocol annotations there are available
 #define ISO_14443A       0
 #define ICLASS           1
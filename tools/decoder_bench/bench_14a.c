@@ -0,0 +1,65 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// MillerDecoding and ManchesterDecoding of armsrc/iso14443a.c on the host,
+// fed like SniffIso14443a does
+//-----------------------------------------------------------------------------
+
+#include "bench_arm.h"
+#include "iso14443a.c"
+
+#include "decoder_bench.h"
+
+// only asked for when the timestamp of the first sample is 0
+uint32_t GetCountSspClk(void) {
+    return 0;
+}
+
+void bench_replay_14a(const uint8_t *samples, size_t count, bench_frame_cb_t cb, void *arg) {
+    uint8_t cmd[MAX_FRAME_SIZE], cmd_par[MAX_PARITY_SIZE];
+    uint8_t resp[MAX_FRAME_SIZE], resp_par[MAX_PARITY_SIZE];
+    Uart14aInit(cmd, cmd_par);
+    Demod14aInit(resp, resp_par);
+
+    bool TagIsActive = false;
+    bool ReaderIsActive = false;
+    uint8_t previous_data = 0;
+
+    for (size_t rx_samples = 0; rx_samples < count; rx_samples++) {
+        uint8_t data = samples[rx_samples];
+
+        // Need two samples to feed Miller and Manchester-Decoder
+        if (rx_samples & 0x01) {
+
+            if (TagIsActive == false) {
+                uint8_t readerdata = (previous_data & 0xF0) | (data >> 4);
+                if (MillerDecoding(readerdata, (rx_samples - 1) * 4)) {
+                    if (cb) {
+                        bench_frame_t f = { true, rx_samples, Uart.len, Uart.output };
+                        cb(&f, arg);
+                    }
+                    Uart14aReset();
+                    Demod14aReset();
+                }
+                ReaderIsActive = (Uart.state != STATE_14A_UNSYNCD);
+            }
+
+            if (ReaderIsActive == false) {
+                uint8_t tagdata = (previous_data << 4) | (data & 0x0F);
+                if (ManchesterDecoding(tagdata, 0, (rx_samples - 1) * 4)) {
+                    if (cb) {
+                        bench_frame_t f = { false, rx_samples, Demod.len, Demod.output };
+                        cb(&f, arg);
+                    }
+                    Demod14aReset();
+                    Uart14aReset();
+                }
+                TagIsActive = (Demod.state != DEMOD_14A_UNSYNCD);
+            }
+        }
+
+        previous_data = data;
+    }
+}
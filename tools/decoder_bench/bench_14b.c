@@ -0,0 +1,67 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Handle14443bSampleFromReader and Handle14443bSamplesFromTag of
+// armsrc/iso14443b.c on the host, fed like SniffIso14443b does
+//-----------------------------------------------------------------------------
+
+#include "bench_arm.h"
+#include "iso14443b.c"
+
+#include "decoder_bench.h"
+
+void bench_replay_14b(const uint16_t *samples, size_t count, bench_frame_cb_t cb, void *arg) {
+    uint8_t dm_buf[MAX_FRAME_SIZE];
+    Demod14bInit(dm_buf, sizeof(dm_buf));
+    uint8_t ua_buf[MAX_FRAME_SIZE];
+    Uart14bInit(ua_buf);
+
+    bool tag_is_active = false;
+    bool reader_is_active = false;
+    bool expect_tag_answer = false;
+
+    for (size_t i = 0; i < count; i++) {
+        int8_t ci = samples[i] >> 8;
+        int8_t cq = samples[i];
+
+        // no need to try decoding reader data if the tag is sending
+        if (tag_is_active == false) {
+
+            // ci then cq, a frame ending on ci leaves cq to a fresh uart
+            const uint8_t bits[] = { ci & 0x01, cq & 0x01 };
+            for (int b = 0; b < 2; b++) {
+                if (Handle14443bSampleFromReader(bits[b])) {
+                    if (cb && Uart.byteCnt > 0) {
+                        bench_frame_t f = { true, i, Uart.byteCnt, Uart.output };
+                        cb(&f, arg);
+                    }
+                    Uart14bReset();
+                    Demod14bReset();
+                    reader_is_active = false;
+                    expect_tag_answer = true;
+                }
+            }
+
+            reader_is_active = (Uart.state > STATE_14B_GOT_FALLING_EDGE_OF_SOF);
+        }
+
+        // no need to try decoding tag data if the reader is sending
+        if (reader_is_active == false && expect_tag_answer) {
+
+            if (Handle14443bSamplesFromTag((ci >> 1), (cq >> 1))) {
+                if (cb) {
+                    bench_frame_t f = { false, i, Demod.len, Demod.output };
+                    cb(&f, arg);
+                }
+                Uart14bReset();
+                Demod14bReset();
+                expect_tag_answer = false;
+                tag_is_active = false;
+            } else {
+                tag_is_active = (Demod.state > DEMOD_GOT_FALLING_EDGE_OF_SOF);
+            }
+        }
+    }
+}
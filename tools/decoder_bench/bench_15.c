@@ -0,0 +1,70 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Handle15693SampleFromReader and Handle15693SamplesFromTag of
+// armsrc/iso15693.c on the host, fed like SniffIso15693 does
+//-----------------------------------------------------------------------------
+
+#include "bench_arm.h"
+#include "iso15693.c"
+
+#include "decoder_bench.h"
+
+// the reader decoder jams with it, it isn't asked to
+void FpgaWriteConfWord(uint16_t v) {
+    (void)v;
+}
+
+void bench_replay_15(const uint16_t *samples, size_t count, bench_frame_cb_t cb, void *arg) {
+    DecodeTag_t dtag = {0};
+    uint8_t response[ISO15693_MAX_RESPONSE_LENGTH] = {0};
+    DecodeTagInit(&dtag, response, sizeof(response));
+
+    DecodeReader_t dreader = {0};
+    uint8_t cmd[ISO15693_MAX_COMMAND_LENGTH] = {0};
+    DecodeReaderInit(&dreader, cmd, sizeof(cmd), 0, NULL);
+
+    bool tag_is_active = false;
+    bool reader_is_active = false;
+    bool expect_tag_answer = false;
+
+    for (size_t i = 0; i < count; i++) {
+        uint16_t sniffdata = samples[i];
+
+        // no need to try decoding reader data if the tag is sending
+        if (tag_is_active == false) {
+
+            if (Handle15693SampleFromReader((sniffdata & 0x02) >> 1, &dreader)
+                    || Handle15693SampleFromReader(sniffdata & 0x01, &dreader)) {
+                if (cb && dreader.byteCount > 0) {
+                    bench_frame_t f = { true, i, dreader.byteCount, dreader.output };
+                    cb(&f, arg);
+                }
+                DecodeReaderReset(&dreader);
+                DecodeTagReset(&dtag);
+                reader_is_active = false;
+                expect_tag_answer = true;
+            } else {
+                reader_is_active = (dreader.state >= STATE_READER_RECEIVE_DATA_1_OUT_OF_4);
+            }
+        }
+
+        if (reader_is_active == false && expect_tag_answer) {
+
+            if (Handle15693SamplesFromTag(sniffdata >> 2, &dtag)) {
+                if (cb) {
+                    bench_frame_t f = { false, i, dtag.len, dtag.output };
+                    cb(&f, arg);
+                }
+                DecodeTagReset(&dtag);
+                DecodeReaderReset(&dreader);
+                expect_tag_answer = false;
+                tag_is_active = false;
+            } else {
+                tag_is_active = (dtag.state >= STATE_TAG_RECEIVING_DATA);
+            }
+        }
+    }
+}
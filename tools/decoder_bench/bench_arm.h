@@ -0,0 +1,27 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Included by the bench_*.c files before the armsrc file they build
+//
+// The whole armsrc file gets compiled, only the decoders and what they call
+// get linked, see the Makefile. They are left with the LEDs to drive and the
+// ram functions of the arm, none of it exists on the host.
+//-----------------------------------------------------------------------------
+
+#ifndef BENCH_ARM_H__
+#define BENCH_ARM_H__
+
+#include "common.h"
+#include "proxmark3_arm.h"
+
+#undef RAMFUNC
+#define RAMFUNC
+
+#undef LOW
+#undef HIGH
+#define LOW(x)      ((void)(x))
+#define HIGH(x)     ((void)(x))
+
+#endif
@@ -0,0 +1,274 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Replay of raw sniff samples through the firmware decoders, on the host
+//
+// The samples are what the FPGA puts in the DMA buffer in the sniff mode of
+// the protocol. The frames decoded are printed with a crc32 over all of them,
+// so a decoder change can be checked against the output before it, and the
+// replay is timed, run it several times for a steady figure.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <time.h>
+#include "crc16.h"
+#include "crc32.h"
+#include "parity.h"
+#include "decoder_bench.h"
+
+typedef struct {
+    bool quiet;
+    uint32_t reader;
+    uint32_t tag;
+    uint32_t crc;
+} bench_stats_t;
+
+static void usage(void) {
+    fprintf(stdout, "Usage: decoder_bench [-q] [-n <runs>] <14a|14b|15> <infile>\n");
+    fprintf(stdout, "          Replay the raw sniff samples of <infile> through the firmware decoders.\n");
+    fprintf(stdout, "          14a: 1 byte a sample like the 14a sniffer, 14b: 16 bit little endian iq samples,\n");
+    fprintf(stdout, "          15: 16 bit little endian amplitude samples, both like the reader sniff modes\n");
+    fprintf(stdout, "          -q: don't print the frames, -n: replay <runs> times, for the timing\n\n");
+    fprintf(stdout, "       decoder_bench -g <count> <outfile>\n");
+    fprintf(stdout, "          Write a 14a sample file of <count> anticollisions and selects, with a halt\n\n");
+}
+
+static void bench_frame(const bench_frame_t *frame, void *arg) {
+    bench_stats_t *stats = (bench_stats_t *)arg;
+    if (frame->reader)
+        stats->reader++;
+    else
+        stats->tag++;
+
+    const uint8_t hdr[] = { frame->reader, frame->len & 0xFF, frame->len >> 8 };
+    stats->crc = crc32_update(stats->crc, hdr, sizeof(hdr));
+    stats->crc = crc32_update(stats->crc, frame->data, frame->len);
+
+    if (stats->quiet)
+        return;
+    printf("%10u  %s ", frame->sample, frame->reader ? "R" : "T");
+    for (uint16_t i = 0; i < frame->len; i++)
+        printf(" %02X", frame->data[i]);
+    printf("\n");
+}
+
+static uint8_t *read_file(const char *fn, size_t *len) {
+    FILE *f = fopen(fn, "rb");
+    if (f == NULL) {
+        fprintf(stderr, "Error opening %s\n", fn);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    uint8_t *data = (size > 0) ? malloc(size) : NULL;
+    if (data == NULL || fread(data, 1, size, f) != (size_t)size) {
+        fprintf(stderr, "Error reading %s\n", fn);
+        free(data);
+        fclose(f);
+        return NULL;
+    }
+    fclose(f);
+    *len = size;
+    return data;
+}
+
+//-----------------------------------------------------------------------------
+// 14a sample file generator
+//
+// A sample pair holds 8 ticks of each side, a reader Miller sequence in the
+// high nibbles and a tag Manchester one in the low ones
+//-----------------------------------------------------------------------------
+#define MILLER_X    0xF3    // pause in the second half, a "1"
+#define MILLER_Y    0xFF    // no pause, a "0" after a "1", or idle
+#define MILLER_Z    0x3F    // pause in the first half, a "0" otherwise
+#define MANCH_D     0xF0    // modulated first half, a "1"
+#define MANCH_E     0x0F    // modulated second half, a "0"
+#define MANCH_F     0x00    // not modulated, end or idle
+
+#define GEN_IDLE    8       // pairs between two frames
+
+typedef struct {
+    FILE *f;
+    size_t samples;
+} gen_t;
+
+static void gen_ticks(gen_t *g, uint8_t reader, uint8_t tag) {
+    const uint8_t pair[] = { (reader & 0xF0) | (tag >> 4), (reader << 4) | (tag & 0x0F) };
+    fwrite(pair, 1, sizeof(pair), g->f);
+    g->samples += sizeof(pair);
+}
+
+static void gen_idle(gen_t *g) {
+    for (int i = 0; i < GEN_IDLE; i++)
+        gen_ticks(g, MILLER_Y, MANCH_F);
+}
+
+// lsb first, an odd parity bit after each byte. A short frame is the 7 bits only
+static int gen_bits(const uint8_t *data, int len, bool short_frame, uint8_t *bits) {
+    if (short_frame) {
+        for (int i = 0; i < 7; i++)
+            bits[i] = (data[0] >> i) & 1;
+        return 7;
+    }
+    int n = 0;
+    for (int i = 0; i < len; i++) {
+        for (int j = 0; j < 8; j++)
+            bits[n++] = (data[i] >> j) & 1;
+        bits[n++] = oddparity8(data[i]);
+    }
+    return n;
+}
+
+static void gen_reader(gen_t *g, const uint8_t *data, int len, bool short_frame) {
+    uint8_t bits[9 * 32];
+    int n = gen_bits(data, len, short_frame, bits);
+
+    gen_idle(g);
+    // start of communication is a "0"
+    gen_ticks(g, MILLER_Z, MANCH_F);
+    bool one = false;
+    for (int i = 0; i < n; i++) {
+        if (bits[i])
+            gen_ticks(g, MILLER_X, MANCH_F);
+        else
+            gen_ticks(g, one ? MILLER_Y : MILLER_Z, MANCH_F);
+        one = bits[i];
+    }
+    // end of communication is a "0" followed by a Y
+    gen_ticks(g, one ? MILLER_Y : MILLER_Z, MANCH_F);
+    gen_ticks(g, MILLER_Y, MANCH_F);
+}
+
+static void gen_tag(gen_t *g, const uint8_t *data, int len) {
+    uint8_t bits[9 * 32];
+    int n = gen_bits(data, len, false, bits);
+
+    gen_idle(g);
+    // start of communication is a "1"
+    gen_ticks(g, MILLER_Y, MANCH_D);
+    for (int i = 0; i < n; i++)
+        gen_ticks(g, MILLER_Y, bits[i] ? MANCH_D : MANCH_E);
+    gen_ticks(g, MILLER_Y, MANCH_F);
+}
+
+static void add_crc_a(uint8_t *data, int len) {
+    compute_crc(CRC_14443_A, data, len, data + len, data + len + 1);
+}
+
+static int generate_14a(uint32_t count, const char *fn) {
+    gen_t g = { fopen(fn, "wb"), 0 };
+    if (g.f == NULL) {
+        fprintf(stderr, "Error opening %s\n", fn);
+        return EXIT_FAILURE;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint8_t uid[5] = { 0x01, 0x02, i >> 8, i };
+        uid[4] = uid[0] ^ uid[1] ^ uid[2] ^ uid[3];
+
+        uint8_t reqa[] = { 0x26 };
+        uint8_t atqa[] = { 0x04, 0x00 };
+        uint8_t anticoll[] = { 0x93, 0x20 };
+        uint8_t select[9] = { 0x93, 0x70 };
+        memcpy(select + 2, uid, sizeof(uid));
+        add_crc_a(select, 7);
+        uint8_t sak[3] = { 0x08 };
+        add_crc_a(sak, 1);
+        uint8_t hlta[4] = { 0x50, 0x00 };
+        add_crc_a(hlta, 2);
+
+        gen_reader(&g, reqa, sizeof(reqa), true);
+        gen_tag(&g, atqa, sizeof(atqa));
+        gen_reader(&g, anticoll, sizeof(anticoll), false);
+        gen_tag(&g, uid, sizeof(uid));
+        gen_reader(&g, select, sizeof(select), false);
+        gen_tag(&g, sak, sizeof(sak));
+        gen_reader(&g, hlta, sizeof(hlta), false);
+    }
+    gen_idle(&g);
+    fclose(g.f);
+
+    printf("wrote %zu samples, %u frames\n", g.samples, count * 7);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv) {
+
+    bool quiet = false;
+    uint32_t runs = 1;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (strcmp(argv[arg], "-q") == 0) {
+            quiet = true;
+        } else if (strcmp(argv[arg], "-n") == 0 && arg + 1 < argc) {
+            runs = strtoul(argv[++arg], NULL, 0);
+        } else if (strcmp(argv[arg], "-g") == 0 && arg + 2 < argc) {
+            return generate_14a(strtoul(argv[arg + 1], NULL, 0), argv[arg + 2]);
+        } else {
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (argc - arg != 2 || runs == 0) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    const char *proto = argv[arg];
+    if (strcmp(proto, "14a") && strcmp(proto, "14b") && strcmp(proto, "15")) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    size_t len = 0;
+    uint8_t *raw = read_file(argv[arg + 1], &len);
+    if (raw == NULL)
+        return EXIT_FAILURE;
+
+    // the 16 bit samples, in the byte order of the device
+    size_t count = len;
+    uint16_t *samples = NULL;
+    if (strcmp(proto, "14a")) {
+        count = len / 2;
+        samples = calloc(count + 1, sizeof(uint16_t));
+        if (samples == NULL) {
+            free(raw);
+            return EXIT_FAILURE;
+        }
+        for (size_t i = 0; i < count; i++)
+            samples[i] = raw[2 * i] | (raw[2 * i + 1] << 8);
+    }
+
+    bench_stats_t stats = { quiet, 0, 0, CRC32_PRESET };
+    clock_t start = clock();
+    for (uint32_t i = 0; i < runs; i++) {
+        // frames of the first run only
+        bench_frame_cb_t cb = (i == 0) ? bench_frame : NULL;
+        if (samples == NULL)
+            bench_replay_14a(raw, count, cb, &stats);
+        else if (strcmp(proto, "14b") == 0)
+            bench_replay_14b(samples, count, cb, &stats);
+        else
+            bench_replay_15(samples, count, cb, &stats);
+    }
+    double secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    printf("samples %zu, %u reader frames, %u tag frames, crc32 %08x\n", count, stats.reader, stats.tag, stats.crc ^ CRC32_PRESET);
+    if (secs > 0)
+        printf("%u run(s) in %.3f s, %.1f Msamples/s\n", runs, secs, (double)count * runs / secs / 1e6);
+    else
+        printf("%u run(s) in less than the clock resolution\n", runs);
+
+    free(samples);
+    free(raw);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,37 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Host replay of the firmware sniff decoders
+//
+// The bench_*.c files build the decoders of armsrc for the host, each one
+// feeds them a raw sample file the way the sniff loop of its protocol feeds
+// them the DMA buffer.
+//-----------------------------------------------------------------------------
+
+#ifndef DECODER_BENCH_H__
+#define DECODER_BENCH_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct {
+    bool reader;
+    uint32_t sample;        // sample the frame was completed on
+    uint16_t len;
+    const uint8_t *data;
+} bench_frame_t;
+
+// called for each decoded frame, NULL to only decode
+typedef void (*bench_frame_cb_t)(const bench_frame_t *frame, void *arg);
+
+// 14a sniffer, one byte a sample, 4 reader ticks in the high nibble and 4 tag ticks in the low one
+void bench_replay_14a(const uint8_t *samples, size_t count, bench_frame_cb_t cb, void *arg);
+// 14b sniff iq, 16 bit samples, ci in the high byte and cq in the low one, the reader bits in bit 0
+void bench_replay_14b(const uint16_t *samples, size_t count, bench_frame_cb_t cb, void *arg);
+// 15 sniff amplitude, 16 bit samples, the tag amplitude from bit 2, the reader bits in bit 1 and 0
+void bench_replay_15(const uint16_t *samples, size_t count, bench_frame_cb_t cb, void *arg);
+
+#endif
@@ -2,6 +2,10 @@
 #include <stdio.h>
 #include "ht2crackutils.h"
 
+#if defined(_WIN32)
+#include <sysinfoapi.h>
+#endif
+
 // writes a value into a buffer as a series of bytes
 void writebuf(unsigned char *buf, uint64_t val, unsigned int len) {
     int i;
@@ -204,3 +208,17 @@ unsigned long long hexreversetoulonglong(char *hex) {
     ret += hexreversetoulong(tmp);
     return ret;
 }
+
+// determine number of logical CPU cores (use for multithreaded functions)
+int num_CPUs(void) {
+#if defined(_WIN32)
+    SYSTEM_INFO sysinfo;
+    GetSystemInfo(&sysinfo);
+    return sysinfo.dwNumberOfProcessors;
+#else
+    int count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (count < 2)
+        count = 2;
+    return count;
+#endif
+}
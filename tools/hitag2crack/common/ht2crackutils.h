@@ -30,6 +30,7 @@ int fb(unsigned int i);
 int fc(unsigned int i);
 int fnf(uint64_t s);
 void buildlfsr(Hitag_State *hstate);
+int num_CPUs(void);
 
 /*
  * Hitag Crypto support macros
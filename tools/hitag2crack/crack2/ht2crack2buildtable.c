@@ -12,19 +12,19 @@
 // to a power of 10; DATAMAX = 196600.
 #define DATAMAX 196600 // around 192K rounded down to a power of 10
 
-// NUM_BUILD_THREADS and NUM_SORT_THREADS are the number of threads to run concurrently.  These should
-// ideally be equal to the number of virtual cores you have available.  A quad-core machine will
-// likely have 8 virtual cores, so set them to 8.
+// The number of build and sort threads is the number of virtual cores rounded down to a power of 2
+// (the maths needs a power of 2), or the first argument.  MAX_THREADS caps it.
 //
 // If sorting fails with a 'bus error' then that is likely because your disk I/O can't keep up with
-// the read/write demands of the multi-threaded sorting.  In this case, reduce the number of sorting
-// threads.  This will most likely only be a problem with network disks; SATA should be okay;
-// USB2/3 should keep up.
-//
-// These MUST be a power of 2 for the maths to work - you have been warned!
-// Also, sort threads MUST be <= build threads or a horrible buffer overflow will happen!
-#define NUM_BUILD_THREADS 8
-#define NUM_SORT_THREADS 8
+// the read/write demands of the multi-threaded sorting.  In this case, give a lower thread count.
+// This will most likely only be a problem with network disks; SATA should be okay; USB2/3 should
+// keep up.
+#define MAX_THREADS 256
+
+// Each build thread collects STAGE_ENTRIES entries per bucket before it takes the bucket lock, so
+// the shared buckets are locked once per STAGE_ENTRIES entries instead of once per entry.
+// This costs 65536 * STAGE_ENTRIES * DATASIZE bytes of RAM per build thread (20MB for 32).
+#define STAGE_ENTRIES 32
 
 // DATASIZE is the number of bytes in an entry.  This is 10; 4 bytes of keystream (2 are in the filepath) +
 // 6 bytes of PRNG state.
@@ -32,6 +32,8 @@
 
 int debug = 0;
 
+int num_threads = 1;
+
 // table entry for a bucket
 struct table {
     char path[32];
@@ -141,60 +143,70 @@ static void writetable(struct table *t1) {
 }
 
 
-// store value in table
-static void store(unsigned char *data) {
-    unsigned char d_1, d_2;
-    int offset;
-    struct table *t1;
+// per thread staging of entries, one slot per bucket
+struct stage {
+    unsigned char data[0x10000][STAGE_ENTRIES * DATASIZE];
+    unsigned char count[0x10000];
+};
 
-    // use the first two bytes as an index
-    d_1 = data[0];
-    d_2 = data[1];
-    offset = (d_1 * 0x100) + d_2;
+// move staged entries into their shared bucket
+static void flush_stage(struct stage *st, int offset) {
+    struct table *t1;
+    unsigned int len = st->count[offset] * DATASIZE;
 
-    if (debug) printf("store, d1=%02X, d2=%02X, offset = %d\n", d_1, d_2, offset);
+    if (len == 0)
+        return;
 
     // get pointer to table entry
     t1 = t + offset;
 
     // wait for a lock on this entry
     if (pthread_mutex_lock(&(t1->mutex))) {
-        printf("store: cannot lock mutex at offset %d\n", offset);
+        printf("flush_stage: cannot lock mutex at offset %d\n", offset);
         exit(1);
     }
 
-    if (debug) printf("store, offset = %d, got lock\n", offset);
-
-    // store the entry
-    memcpy(t1->ptr, data + 2, 10);
+    if (debug) printf("flush_stage, offset = %d, got lock\n", offset);
 
-    if (debug) printf("store, offset = %d, copied data\n", offset);
-
-    // update the ptr
-    t1->ptr += 10;
-
-    // check if table is full
-    if ((t1->ptr - t1->data) >= DATAMAX) {
-        // write the table to disk
+    // write the table to disk first if the entries don't fit
+    if ((t1->ptr - t1->data) + len > DATAMAX) {
         writetable(t1);
         // reset ptr
         t1->ptr = t1->data;
     }
 
-    if (debug) printf("store, offset = %d, after possible write\n", offset);
+    // store the entries
+    memcpy(t1->ptr, st->data[offset], len);
+    t1->ptr += len;
 
     // release the lock
     if (pthread_mutex_unlock(&(t1->mutex))) {
-        printf("store: cannot unlock mutex at offset %d\n", offset);
+        printf("flush_stage: cannot unlock mutex at offset %d\n", offset);
         exit(1);
     }
 
-    if (debug) printf("store, offset = %d, unlocked\n", offset);
+    st->count[offset] = 0;
+}
+
+// store value in table
+static void store(struct stage *st, unsigned char *data) {
+    int offset;
+
+    // use the first two bytes as an index
+    offset = (data[0] * 0x100) + data[1];
+
+    if (debug) printf("store, d1=%02X, d2=%02X, offset = %d\n", data[0], data[1], offset);
+
+    // stage the entry
+    memcpy(st->data[offset] + (st->count[offset] * DATASIZE), data + 2, DATASIZE);
+    st->count[offset]++;
 
+    if (st->count[offset] == STAGE_ENTRIES)
+        flush_stage(st, offset);
 }
 
 // writes the ks (keystream) and s (state)
-static void write_ks_s(uint32_t ks1, uint32_t ks2, uint64_t shiftreg) {
+static void write_ks_s(struct stage *st, uint32_t ks1, uint32_t ks2, uint64_t shiftreg) {
     unsigned char buf[16];
 
     // create buffer
@@ -203,7 +215,7 @@ static void write_ks_s(uint32_t ks1, uint32_t ks2, uint64_t shiftreg) {
     writebuf(buf + 6, shiftreg, 6);
 
     // store buffer
-    store(buf);
+    store(st, buf);
 }
 
 
@@ -284,7 +296,13 @@ static void *buildtable(void *dd) {
     uint32_t ks1;
     uint32_t ks2;
     int index = (int)(long)dd;
-    int tnum = NUM_BUILD_THREADS;
+    int tnum = num_threads;
+
+    struct stage *st = (struct stage *)calloc(1, sizeof(struct stage));
+    if (!st) {
+        printf("buildtable: cannot malloc stage\n");
+        exit(1);
+    }
 
     /* set random state */
     hstate.shiftreg = 0x123456789abc;
@@ -320,14 +338,20 @@ static void *buildtable(void *dd) {
         ks1 = hitag2_nstep(&hstate2, 24);
         ks2 = hitag2_nstep(&hstate2, 24);
 
-        write_ks_s(ks1, ks2, hstate.shiftreg);
+        write_ks_s(st, ks1, ks2, hstate.shiftreg);
 
-        // jump hstate forward 2048 * NUM_BUILD_THREADS states using di table
-        // this is because we're running NUM_BUILD_THREADS threads at once, from NUM_BUILD_THREADS
+        // jump hstate forward 2048 * num_threads states using di table
+        // this is because we're running num_threads threads at once, from num_threads
         // different offsets that are 2048 states apart.
         jumpnsteps(&hstate, 1);
     }
 
+    // hand over what is left in the stage
+    for (i = 0; i < 0x10000; i++) {
+        flush_stage(st, i);
+    }
+
+    free(st);
     return NULL;
 }
 
@@ -360,11 +384,41 @@ static void makedirs(void) {
     }
 }
 
-static int datacmp(const void *p1, const void *p2, void *dummy) {
-    unsigned char *d_1 = (unsigned char *)p1;
-    unsigned char *d_2 = (unsigned char *)p2;
+// The search only compares the 4 keystream bytes of an entry, so sorting on those is enough.
+// LSD radix sort, one pass per byte, from the last byte to the first.
+static void radixsort(unsigned char *table, unsigned char *tmp, uint64_t numentries) {
+    uint64_t count[0x100];
+    uint64_t i;
+    int b, v;
+    unsigned char *src = table;
+    unsigned char *dst = tmp;
+    unsigned char *swap;
+
+    for (b = 3; b >= 0; b--) {
+        memset(count, 0, sizeof(count));
+        for (i = 0; i < numentries; i++) {
+            count[src[(i * DATASIZE) + b]]++;
+        }
 
-    return memcmp(d_1, d_2, DATASIZE);
+        // turn the counts into start positions
+        uint64_t pos = 0;
+        for (v = 0; v < 0x100; v++) {
+            uint64_t c = count[v];
+            count[v] = pos;
+            pos += c;
+        }
+
+        for (i = 0; i < numentries; i++) {
+            unsigned char *e = src + (i * DATASIZE);
+            memcpy(dst + (count[e[b]]++ * DATASIZE), e, DATASIZE);
+        }
+
+        swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    // four passes, the sorted data is back in table
 }
 
 static void *sorttable(void *dd) {
@@ -377,11 +431,13 @@ static void *sorttable(void *dd) {
     struct stat filestat;
     uint64_t numentries = 0;
     int index = (int)(long)dd;
-    int space = 0x100 / NUM_SORT_THREADS;
+    int space = 0x100 / num_threads;
 
-    // create table - 50MB should be enough
-    unsigned char *table = (unsigned char *)malloc(50UL * 1024UL * 1024UL);
-    if (!table) {
+    // create table and radix sort space - 50MB should be enough, grows if not
+    size_t tablesize = 50UL * 1024UL * 1024UL;
+    unsigned char *table = (unsigned char *)malloc(tablesize);
+    unsigned char *tmp = (unsigned char *)malloc(tablesize);
+    if (!table || !tmp) {
         printf("sorttable: cannot malloc table\n");
         exit(1);
     }
@@ -413,6 +469,18 @@ static void *sorttable(void *dd) {
                 exit(1);
             }
 
+            if ((size_t)filestat.st_size > tablesize) {
+                tablesize = filestat.st_size;
+                free(table);
+                free(tmp);
+                table = (unsigned char *)malloc(tablesize);
+                tmp = (unsigned char *)malloc(tablesize);
+                if (!table || !tmp) {
+                    printf("sorttable: cannot malloc table\n");
+                    exit(1);
+                }
+            }
+
             // copy data into table
             memcpy(table, data, filestat.st_size);
 
@@ -427,7 +495,7 @@ static void *sorttable(void *dd) {
             close(fdin);
 
             // sort it
-            qsort_r(table, numentries, DATASIZE, datacmp, NULL);
+            radixsort(table, tmp, numentries);
 
             // write to file
             sprintf(outfile, "sorted/%02x/%02x.bin", i, j);
@@ -436,7 +504,7 @@ static void *sorttable(void *dd) {
                 printf("cannot create outfile %s\n", outfile);
                 exit(1);
             }
-            if (write(fdout, table, numentries * DATASIZE)) {
+            if (write(fdout, table, numentries * DATASIZE) != (ssize_t)(numentries * DATASIZE)) {
                 printf("writetable cannot write all of the data\n");
                 exit(1);
             }
@@ -450,16 +518,30 @@ static void *sorttable(void *dd) {
         }
     }
 
+    free(table);
+    free(tmp);
     return NULL;
 }
 
 int main(int argc, char *argv[]) {
-    pthread_t threads[NUM_BUILD_THREADS];
+    pthread_t threads[MAX_THREADS];
     void *status;
     long i;
     int ret;
     struct table *t1;
+    int wanted;
 
+    if (argc > 1) {
+        wanted = atoi(argv[1]);
+    } else {
+        wanted = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+
+    // largest power of 2 that isn't more than wanted
+    while ((num_threads << 1) <= wanted && (num_threads << 1) <= MAX_THREADS) {
+        num_threads = num_threads << 1;
+    }
+    printf("using %d threads\n", num_threads);
 
     // make the table of tables
     t = (struct table *)malloc(sizeof(struct table) * 65536);
@@ -475,13 +557,13 @@ int main(int argc, char *argv[]) {
     makedirs();
 
     // build the jump table for incremental steps
-    builddi(2048 * NUM_BUILD_THREADS, 1);
+    builddi(2048 * num_threads, 1);
 
     // build the jump table for setting the offset
     builddi(2048, 2);
 
     // start the threads
-    for (i = 0; i < NUM_BUILD_THREADS; i++) {
+    for (i = 0; i < num_threads; i++) {
         ret = pthread_create(&(threads[i]), NULL, buildtable, (void *)(i));
         if (ret) {
             printf("cannot start buildtable thread %ld\n", i);
@@ -492,7 +574,7 @@ int main(int argc, char *argv[]) {
     if (debug) printf("main, started buildtable threads\n");
 
     // wait for threads to finish
-    for (i = 0; i < NUM_BUILD_THREADS; i++) {
+    for (i = 0; i < num_threads; i++) {
         ret = pthread_join(threads[i], &status);
         if (ret) {
             printf("cannot join buildtable thread %ld\n", i);
@@ -519,7 +601,7 @@ int main(int argc, char *argv[]) {
 
 
     // start the threads
-    for (i = 0; i < NUM_SORT_THREADS; i++) {
+    for (i = 0; i < num_threads; i++) {
         ret = pthread_create(&(threads[i]), NULL, sorttable, (void *)(i));
         if (ret) {
             printf("cannot start sorttable thread %ld\n", i);
@@ -530,7 +612,7 @@ int main(int argc, char *argv[]) {
     if (debug) printf("main, started sorttable threads\n");
 
     // wait for threads to finish
-    for (i = 0; i < NUM_SORT_THREADS; i++) {
+    for (i = 0; i < num_threads; i++) {
         ret = pthread_join(threads[i], &status);
         if (ret) {
             printf("cannot join sorttable thread %ld\n", i);
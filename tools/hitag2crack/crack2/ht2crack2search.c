@@ -16,11 +16,59 @@ struct rngdata {
 
 
 
-static int datacmp(const void *p1, const void *p2) {
-    unsigned char *d1 = (unsigned char *)p1;
-    unsigned char *d2 = (unsigned char *)p2;
+// number of bit offsets searched at once
+#define MAX_THREADS 64
 
-    return memcmp(d1, d2, DATASIZE - 6);
+// the 4 keystream bytes of an entry as a number, the tables are sorted on them
+static inline uint32_t entrykey(const unsigned char *e) {
+    return ((uint32_t)e[0] << 24) | ((uint32_t)e[1] << 16) | ((uint32_t)e[2] << 8) | e[3];
+}
+
+// Finds the first entry with the given keystream bytes. The keystream is uniformly distributed,
+// so interpolation search gets close in a couple of probes, which matters when every probe is a
+// page fault on the mapped table. After a few guesses it falls back to halving the range.
+static unsigned char *lookup(unsigned char *data, uint64_t numentries, uint32_t key) {
+    uint64_t lo = 0;
+    uint64_t hi;
+    uint64_t mid;
+    int probes = 0;
+
+    if (numentries == 0)
+        return NULL;
+
+    hi = numentries - 1;
+    if (entrykey(data + (hi * DATASIZE)) < key)
+        return NULL;
+
+    // the first entry >= key is in [lo, hi]
+    while (lo < hi) {
+        uint32_t klo = entrykey(data + (lo * DATASIZE));
+        uint32_t khi = entrykey(data + (hi * DATASIZE));
+
+        if (klo >= key) {
+            hi = lo;
+            break;
+        }
+
+        // klo < key <= khi
+        if (probes++ < 4) {
+            mid = lo + (((uint64_t)(key - klo) * (hi - lo)) / (khi - klo));
+        } else {
+            mid = lo + ((hi - lo) / 2);
+        }
+        if (mid >= hi)
+            mid = hi - 1;
+
+        if (entrykey(data + (mid * DATASIZE)) < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if (entrykey(data + (hi * DATASIZE)) == key)
+        return data + (hi * DATASIZE);
+    return NULL;
 }
 
 static int loadrngdata(struct rngdata *r, char *file) {
@@ -189,15 +237,12 @@ static int searchcand(unsigned char *c, unsigned char *rt, int fwd, unsigned cha
 
     memcpy(item, c + 2, 4);
 
-    found = (unsigned char *)bsearch(item, data, filestat.st_size / DATASIZE, DATASIZE, datacmp);
+    // probes land anywhere in the table, read ahead would only waste I/O
+    madvise(data, filestat.st_size, MADV_RANDOM);
 
-    if (found) {
+    found = lookup(data, filestat.st_size / DATASIZE, entrykey(item));
 
-        // our candidate is in the table
-        // go backwards and see if there are other matches
-        while (((found - data) >= DATASIZE) && (!memcmp(found - DATASIZE, item, 4))) {
-            found = found - DATASIZE;
-        }
+    if (found) {
 
         // now test all matches
         while (((found - data) <= (filestat.st_size - DATASIZE)) && (!memcmp(found, item, 4))) {
@@ -222,55 +267,131 @@ static int searchcand(unsigned char *c, unsigned char *rt, int fwd, unsigned cha
 
 }
 
-static int findmatch(struct rngdata *r, unsigned char *outmatch, unsigned char *outstate, int *bitoffset) {
-    int i;
+// bit offsets are handed out to the search threads in order, the lowest matching offset wins
+struct search {
+    struct rngdata *r;
     int bitlen;
+    int next;
+    int found;
+    int error;
+    unsigned char match[6];
+    unsigned char state[6];
+    pthread_mutex_t mutex;
+};
+
+static int searchoffset(struct rngdata *r, int bitlen, int i, unsigned char *outmatch, unsigned char *outstate) {
     unsigned char cand[6];
     unsigned char rngtest[6];
     int fwd;
 
-    if (!r || !outmatch || !outstate || !bitoffset) {
-        printf("findmatch: invalid params\n");
-        return 0;
+    if (!makecand(cand, r, i)) {
+        printf("cannot makecand, %d\n", i);
+        return -1;
+    }
+//        printf("cand: %02x %02x %02x %02x %02x %02x : ", cand[0], cand[1], cand[2], cand[3], cand[4], cand[5]);
+//        printbin(cand);
+
+    /* make following or preceding RNG test data to confirm match */
+    if (i < (bitlen - 96)) {
+        if (!makecand(rngtest, r, i + 48)) {
+            printf("cannot makecand rngtest %d + 48\n", i);
+            return -1;
+        }
+        fwd = 1;
+    } else {
+        if (!makecand(rngtest, r, i - 48)) {
+            printf("cannot makecand rngtest %d - 48\n", i);
+            return -1;
+        }
+        fwd = 0;
     }
 
-    bitlen = r->len * 8;
+    return searchcand(cand, rngtest, fwd, outmatch, outstate);
+}
+
+static void *searchthread(void *arg) {
+    struct search *sr = (struct search *)arg;
+    unsigned char match[6];
+    unsigned char state[6];
+    int i;
+
+    for (;;) {
+        pthread_mutex_lock(&(sr->mutex));
+        i = sr->next++;
+        // offsets past a match can't win any more
+        if (sr->error || (i > sr->bitlen - 48) || ((sr->found >= 0) && (i > sr->found))) {
+            pthread_mutex_unlock(&(sr->mutex));
+            break;
+        }
+        pthread_mutex_unlock(&(sr->mutex));
 
-    for (i = 0; i <= bitlen - 48; i++) {
         // print progress
         if ((i % 100) == 0) {
             printf("searching on bit %d\n", i);
         }
 
-        if (!makecand(cand, r, i)) {
-            printf("cannot makecand, %d\n", i);
-            return 0;
+        int res = searchoffset(sr->r, sr->bitlen, i, match, state);
+        if (res == 0)
+            continue;
+
+        pthread_mutex_lock(&(sr->mutex));
+        if (res < 0) {
+            sr->error = 1;
+        } else if ((sr->found < 0) || (i < sr->found)) {
+            sr->found = i;
+            memcpy(sr->match, match, 6);
+            memcpy(sr->state, state, 6);
         }
-//        printf("cand: %02x %02x %02x %02x %02x %02x : ", cand[0], cand[1], cand[2], cand[3], cand[4], cand[5]);
-//        printbin(cand);
+        pthread_mutex_unlock(&(sr->mutex));
+    }
 
-        /* make following or preceding RNG test data to confirm match */
-        if (i < (bitlen - 96)) {
-            if (!makecand(rngtest, r, i + 48)) {
-                printf("cannot makecand rngtest %d + 48\n", i);
-                return 0;
-            }
-            fwd = 1;
-        } else {
-            if (!makecand(rngtest, r, i - 48)) {
-                printf("cannot makecand rngtest %d - 48\n", i);
-                return 0;
-            }
-            fwd = 0;
-        }
+    return NULL;
+}
+
+static int findmatch(struct rngdata *r, unsigned char *outmatch, unsigned char *outstate, int *bitoffset) {
+    pthread_t threads[MAX_THREADS];
+    struct search sr;
+    int num_threads;
+    int i;
+
+    if (!r || !outmatch || !outstate || !bitoffset) {
+        printf("findmatch: invalid params\n");
+        return 0;
+    }
 
-        if (searchcand(cand, rngtest, fwd, outmatch, outstate)) {
-            *bitoffset = i;
-            return 1;
+    memset(&sr, 0, sizeof(sr));
+    sr.r = r;
+    sr.bitlen = r->len * 8;
+    sr.found = -1;
+    pthread_mutex_init(&(sr.mutex), NULL);
+
+    // the table lookups wait on the disk most of the time, so more threads than cores pay off
+    num_threads = sysconf(_SC_NPROCESSORS_ONLN) * 4;
+    if (num_threads < 1)
+        num_threads = 1;
+    if (num_threads > MAX_THREADS)
+        num_threads = MAX_THREADS;
+
+    for (i = 0; i < num_threads; i++) {
+        if (pthread_create(&(threads[i]), NULL, searchthread, &sr)) {
+            printf("cannot start search thread %d\n", i);
+            exit(1);
         }
     }
 
-    return 0;
+    for (i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&(sr.mutex));
+
+    if (sr.error || (sr.found < 0))
+        return 0;
+
+    memcpy(outmatch, sr.match, 6);
+    memcpy(outstate, sr.state, 6);
+    *bitoffset = sr.found;
+    return 1;
 }
 
 
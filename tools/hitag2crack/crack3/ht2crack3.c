@@ -6,11 +6,11 @@
 
 #include "hitagcrypto.h"
 #include "ht2crackutils.h"
+#include "ht2bitslice.h"
 
 // max number of NrAr pairs to load - you only need 136 good pairs, but this
 // is the max
 #define NUM_NRAR 1024
-#define NUM_THREADS 8
 
 // table entry for Tkleft
 struct Tklower {
@@ -25,17 +25,17 @@ struct nRaR {
     uint64_t aR;
 };
 
-// struct to hold data for thread
+// data shared by the threads, they take the next klower from klowernext
 struct threaddata {
     uint64_t uid;
     struct nRaR *TnRaR;
     unsigned int numnrar;
-    uint64_t klowerstart;
-    uint64_t klowerrange;
+    uint64_t klowernext;
+    uint64_t klowerend;
 };
 
 // macros to pick out 4 bits in various patterns of 1s & 2s & make a new number
-// these and the following hitag2_crypt function taken from Rfidler
+// these are taken from Rfidler
 #define pickbits2_2(S, A, B)       ( ((S >> A) & 3) | ((S >> (B - 2)) & 0xC) )
 #define pickbits1x4(S, A, B, C, D) ( ((S >> A) & 1) | ((S >> (B - 1)) & 2) | \
                                    ((S >> (C - 2)) & 4) | ((S >> (D - 3)) & 8) )
@@ -47,22 +47,6 @@ struct threaddata {
                                    ((S >> (C - 3)) & 8) )
 
 
-static uint32_t hitag2_crypt(uint64_t s) {
-    const uint32_t ht2_function4a = 0x2C79; // 0010 1100 0111 1001
-    const uint32_t ht2_function4b = 0x6671; // 0110 0110 0111 0001
-    const uint32_t ht2_function5c = 0x7907287B; // 0111 1001 0000 0111 0010 1000 0111 1011
-    uint32_t bitindex;
-
-    bitindex = (ht2_function4a >> pickbits2_2(s, 1, 4)) & 1;
-    bitindex |= ((ht2_function4b << 1) >> pickbits1_1_2(s, 7, 11, 13)) & 0x02;
-    bitindex |= ((ht2_function4b << 2) >> pickbits1x4(s, 16, 20, 22, 25)) & 0x04;
-    bitindex |= ((ht2_function4b << 3) >> pickbits2_1_1(s, 27, 30, 32)) & 0x08;
-    bitindex |= ((ht2_function4a << 4) >> pickbits1_2_1(s, 33, 42, 45)) & 0x10;
-
-    return (ht2_function5c >> bitindex) & 1;
-}
-
-
 // this function is a modification of the filter function f, based heavily
 // on the hitag2_crypt function in Rfidler
 static int fnP(uint64_t klowery) {
@@ -124,24 +108,38 @@ static int is_kmiddle_badguess(uint64_t z, struct Tklower *Tk, int max, int aR0)
 // function to test if a partial key is valid
 static int testkey(uint64_t *out, uint64_t uid, uint64_t pkey, uint64_t nR, uint64_t aR) {
     uint64_t kupper;
-    uint64_t key;
-    Hitag_State hstate;
-    uint64_t b;
     uint32_t revaR;
     uint32_t normaR;
+    uint32_t ks;
+    ht2bs_t key[48];
+    ht2bs_t match;
+    unsigned int i;
 
     // normalise aR
     revaR = rev32(aR);
     normaR = ((revaR >> 24) | ((revaR >> 8) & 0xff00) | ((revaR << 8) & 0xff0000) | (revaR << 24));
 
-    // search for remaining 14 bits
-    for (kupper = 0; kupper < 0x3fff; kupper++) {
-        key = (kupper << 34) | pkey;
-        hitag2_init(&hstate, key, uid, nR);
-        b = hitag2_nstep(&hstate, 32);
-        if ((normaR ^ b) == 0xffffffff) {
-            *out = key;
-            return 1;
+    // expected keystream, first bit in bit 0
+    ks = 0;
+    for (i = 0; i < 32; i++) {
+        ks |= ((~normaR >> (31 - i)) & 1) << i;
+    }
+
+    // search for remaining 14 bits, HT2BS_LANES at a time
+    for (i = 0; i < 34; i++) {
+        key[i] = ht2bs_fill(pkey >> i);
+    }
+    for (kupper = 0; kupper < 0x4000; kupper += HT2BS_LANES) {
+        ht2bs_counter(key + 34, kupper, 14);
+        match = ht2bs_check_keys(key, uid, nR, ks);
+        if (ht2bs_any(match) == false) {
+            continue;
+        }
+        for (i = 0; i < HT2BS_LANES; i++) {
+            if (ht2bs_get(match, i)) {
+                *out = ((kupper + i) << 34) | pkey;
+                return 1;
+            }
         }
     }
     return 0;
@@ -177,12 +175,11 @@ static void *crack(void *d) {
     struct nRaR *TnRaR;
     unsigned int numnrar;
 
-    Hitag_State hstate;
     int i, j;
 
     uint64_t klower, kmiddle, klowery;
-    uint64_t y, b, z, bit;
-    uint64_t ytmp;
+    uint64_t y, z;
+    ht2bs_t seq[80], b[18], notb32;
     unsigned int count;
     uint64_t foundkey, revkey;
     int ret;
@@ -207,46 +204,41 @@ static void *crack(void *d) {
     }
 
     // find keys
-    for (klower = data->klowerstart; klower < (data->klowerstart + data->klowerrange); klower++) {
+    while ((klower = __atomic_fetch_add(&data->klowernext, 1, __ATOMIC_SEQ_CST)) < data->klowerend) {
         printf("trying klower = 0x%05"PRIx64"\n", klower);
         // build table
+        // seq[t] is bit t of the prng input stream: the initial state, then y, then zeros.
+        // After t shifts the state is seq[t] .. seq[t + 47], so keystream bit k is the
+        // filter on seq[k] and b32 the filter on seq[32]
+        for (i = 0; i < 48; i++) {
+            seq[i] = ht2bs_fill(((klower << 32) | uid) >> i);
+        }
+        for (i = 48 + 18; i < 80; i++) {
+            seq[i] = ht2bs_fill(0);
+        }
         count = 0;
-        for (y = 0; y < 0x40000; y++) {
-            // create klowery
-            klowery = (y << 16) | klower;
-            // check for cases where right most bit of fc doesn't matter
-
-            if (fnP(klowery)) {
-                // store klowery
-                Tk[count].klowery = klowery;
-                // build the initial prng state
-                hstate.shiftreg = (klower << 32) | uid;
-                // zero the lfsr so only 0s are inserted
-                hstate.lfsr = 0;
-                // insert y into shiftreg and extract keystream, reversed order
-                b = 0;
-                ytmp = y;
-                for (j = 0; j < 2; j++) {
-                    hstate.shiftreg = hstate.shiftreg | ((ytmp & 0xffff) << 48);
-                    for (i = 0; i < 16; i++) {
-                        hstate.shiftreg = hstate.shiftreg >> 1;
-                        bit = hitag2_crypt(hstate.shiftreg);
-                        b = (b >> 1) | (bit << 31);
-                    }
-                    ytmp = ytmp >> 16;
+        for (y = 0; y < 0x40000; y += HT2BS_LANES) {
+            // y of lane j is y + j
+            ht2bs_counter(seq + 48, y, 18);
+            for (j = 0; j < 18; j++) {
+                b[j] = ht2bs_filter(seq + j);
+            }
+            notb32 = ~ht2bs_filter(seq + 32);
+
+            for (j = 0; j < HT2BS_LANES; j++) {
+                // create klowery
+                klowery = ((y + j) << 16) | klower;
+                // check for cases where right most bit of fc doesn't matter
+                if (fnP(klowery)) {
+                    // store klowery
+                    Tk[count].klowery = klowery;
+                    // store the xor of y and b0-17
+                    Tk[count].yxorb = (y + j) ^ ht2bs_unslice(b, j, 18);
+                    // store inverse of next bit from prng
+                    Tk[count].notb32 = ht2bs_get(notb32, j);
+                    // increase count
+                    count++;
                 }
-
-                // store the xor of y and b0-17
-                Tk[count].yxorb = y ^ (b & 0x3ffff);
-
-                // get and store inverse of next bit from prng
-                // don't need to worry about shifting in the new bit because
-                // it doesn't affect the filter function anyway
-                hstate.shiftreg = hstate.shiftreg >> 1;
-                Tk[count].notb32 = hitag2_crypt(hstate.shiftreg) ^ 0x1;
-
-                // increase count
-                count++;
             }
         }
 
@@ -293,7 +285,8 @@ static void *crack(void *d) {
 int main(int argc, char *argv[]) {
     FILE *fp;
     int i;
-    pthread_t threads[NUM_THREADS];
+    int num_threads;
+    pthread_t *threads = NULL;
     void *status;
 
     uint64_t uid;
@@ -305,7 +298,7 @@ int main(int argc, char *argv[]) {
     size_t lenbuf = 64;
 
     struct nRaR *TnRaR = NULL;
-    struct threaddata *tdata = NULL;
+    struct threaddata tdata;
 
     if (argc < 3) {
         printf("%s uid nRaRfile\n", argv[0]);
@@ -373,37 +366,37 @@ int main(int argc, char *argv[]) {
 
     printf("Loaded %u NrAr pairs\n", numnrar);
 
-    // create table of thread data
-    tdata = (struct threaddata *)malloc(sizeof(struct threaddata) * NUM_THREADS);
-    if (!tdata) {
-        printf("cannot malloc threaddata\n");
+    tdata.uid = uid;
+    tdata.TnRaR = TnRaR;
+    tdata.numnrar = numnrar;
+    tdata.klowernext = klowerstart;
+    tdata.klowerend = 0x10000;
+
+    if (klowerstart) {
+        // debug mode only runs one thread from klowerstart
+        crack(&tdata);
+        printf("Did not find key :(\n");
         exit(1);
     }
 
-    for (i = 0; i < NUM_THREADS; i++) {
-        tdata[i].uid = uid;
-        tdata[i].TnRaR = TnRaR;
-        tdata[i].numnrar = numnrar;
-        tdata[i].klowerrange = 0x10000 / NUM_THREADS;
-        tdata[i].klowerstart = i * tdata[i].klowerrange;
+    // run full threaded mode, one thread per core
+    num_threads = num_CPUs();
+    threads = (pthread_t *)malloc(sizeof(pthread_t) * num_threads);
+    if (!threads) {
+        printf("cannot malloc threads\n");
+        exit(1);
     }
+    printf("Using %d threads, %d bitslice lanes\n", num_threads, HT2BS_LANES);
 
-    if (klowerstart) {
-        // debug mode only runs one thread from klowerstart
-        tdata[0].klowerstart = klowerstart;
-        crack(tdata);
-    } else {
-        // run full threaded mode
-        for (i = 0; i < NUM_THREADS; i++) {
-            if (pthread_create(&(threads[i]), NULL, crack, (void *)(tdata + i))) {
-                printf("cannot start thread %d\n", i);
-                exit(1);
-            }
+    for (i = 0; i < num_threads; i++) {
+        if (pthread_create(&(threads[i]), NULL, crack, (void *)&tdata)) {
+            printf("cannot start thread %d\n", i);
+            exit(1);
         }
     }
 
     // wait for threads to finish
-    for (i = 0; i < NUM_THREADS; i++) {
+    for (i = 0; i < num_threads; i++) {
         if (pthread_join(threads[i], &status)) {
             printf("cannot join thread %d\n", i);
             exit(1);
@@ -420,4 +413,3 @@ int main(int argc, char *argv[]) {
 
     return 0;
 }
-
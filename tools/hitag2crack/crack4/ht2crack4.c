@@ -50,14 +50,12 @@
 #include <math.h>
 #include <pthread.h>
 #include "ht2crackutils.h"
+#include "ht2bitslice.h"
 
 /* you could have more than 32 traces, but you shouldn't really need
  * more than 16.  You can still win with 8 if you're lucky. */
 #define MAX_NONCES 32
 
-/* set this to the number of virtual cores you have */
-#define NUM_THREADS 8
-
 /* encrypted nonce and keystream storage
  * ks is ~enc_aR */
 struct nonce {
@@ -91,6 +89,7 @@ struct nonce nonces[MAX_NONCES];
 unsigned int num_nRaR;
 uint64_t uid;
 int maxtablesize = 800000;
+unsigned int num_threads;
 uint64_t supplied_testkey = 0;
 
 static void usage(void) {
@@ -496,26 +495,26 @@ static void *score_some_traces(void *data) {
 
 /* score_all_traces runs score_traces for every key guess in the table */
 static void score_all_traces(unsigned int size) {
-    pthread_t threads[NUM_THREADS];
+    pthread_t threads[num_threads];
     void *status;
-    struct thread_data tdata[NUM_THREADS];
+    struct thread_data tdata[num_threads];
     unsigned int i;
     unsigned int chunk_size;
 
-    chunk_size = num_guesses / NUM_THREADS;
+    chunk_size = num_guesses / num_threads;
 
     // create thread data
-    for (i = 0; i < NUM_THREADS; i++) {
+    for (i = 0; i < num_threads; i++) {
         tdata[i].start = i * chunk_size;
         tdata[i].end = (i + 1) * chunk_size;
         tdata[i].size = size;
     }
 
     // fix last chunk
-    tdata[NUM_THREADS - 1].end = num_guesses;
+    tdata[num_threads - 1].end = num_guesses;
 
     // start the threads
-    for (i = 0; i < NUM_THREADS; i++) {
+    for (i = 0; i < num_threads; i++) {
         if (pthread_create(&(threads[i]), NULL, score_some_traces, (void *)(tdata + i))) {
             printf("cannot start thread %u\n", i);
             exit(1);
@@ -523,7 +522,7 @@ static void score_all_traces(unsigned int size) {
     }
 
     // wait for threads to end
-    for (i = 0; i < NUM_THREADS; i++) {
+    for (i = 0; i < num_threads; i++) {
         if (pthread_join(threads[i], &status)) {
             printf("cannot join thread %u\n", i);
             exit(1);
@@ -756,28 +755,43 @@ static void test(void) {
 }
 */
 
-/* check_key tests the potential key against an encrypted nonce, ks pair */
-static int check_key(uint64_t key, uint64_t enc_nR, uint64_t ks) {
-    Hitag_State hstate;
-    uint64_t bits;
-    int i;
+/* find_key tests the key guesses against the first two encrypted nonce, ks pairs,
+ * HT2BS_LANES keys at a time. returns the index of the first good key or -1 */
+static int find_key(void) {
+    uint64_t keys[HT2BS_LANES];
+    ht2bs_t key[48];
+    ht2bs_t match;
+    unsigned int i, j, n;
+
+    for (i = 0; i < num_guesses; i += n) {
+        n = num_guesses - i;
+        if (n > HT2BS_LANES) {
+            n = HT2BS_LANES;
+        }
+        for (j = 0; j < n; j++) {
+            keys[j] = guesses[i + j].key;
+        }
+        ht2bs_transpose(key, keys, n, 48);
 
-    hitag2_init(&hstate, key, uid, enc_nR);
-    bits = 0;
-    for (i = 0; i < 32; i++) {
-        bits = (bits >> 1) | (hitag2_nstep(&hstate, 1) << 31);
-    }
-    if (ks == bits) {
-        return 1;
-    } else {
-        return 0;
+        match = ht2bs_check_keys(key, uid, nonces[0].enc_nR, nonces[0].ks);
+        if (ht2bs_any(match) == false) {
+            continue;
+        }
+        match &= ht2bs_check_keys(key, uid, nonces[1].enc_nR, nonces[1].ks);
+
+        for (j = 0; j < n; j++) {
+            if (ht2bs_get(match, j)) {
+                return i + j;
+            }
+        }
     }
+    return -1;
 }
 
 
 /* start up */
 int main(int argc, char *argv[]) {
-    unsigned int i;
+    int found;
     uint64_t revkey;
     uint64_t foundkey;
     int tot_nRaR = 0;
@@ -817,6 +831,9 @@ int main(int argc, char *argv[]) {
         usage();
     }
 
+    num_threads = num_CPUs();
+    fprintf(stderr, "Using %u threads\n", num_threads);
+
     create_guess_table();
 
     init_guess_table(noncefilestr, uidstr);
@@ -829,15 +846,13 @@ int main(int argc, char *argv[]) {
     crack();
 
     // test all key guesses and stop if one works
-    for (i = 0; i < num_guesses; i++) {
-        if (check_key(guesses[i].key, nonces[0].enc_nR, nonces[0].ks) &&
-                check_key(guesses[i].key, nonces[1].enc_nR, nonces[1].ks)) {
-            printf("WIN!!! :)\n");
-            revkey = rev64(guesses[i].key);
-            foundkey = ((revkey >> 40) & 0xff) | ((revkey >> 24) & 0xff00) | ((revkey >> 8) & 0xff0000) | ((revkey << 8) & 0xff000000) | ((revkey << 24) & 0xff00000000) | ((revkey << 40) & 0xff0000000000);
-            printf("key = %012" PRIX64 "\n", foundkey);
-            exit(0);
-        }
+    found = find_key();
+    if (found >= 0) {
+        printf("WIN!!! :)\n");
+        revkey = rev64(guesses[found].key);
+        foundkey = ((revkey >> 40) & 0xff) | ((revkey >> 24) & 0xff00) | ((revkey >> 8) & 0xff0000) | ((revkey << 8) & 0xff000000) | ((revkey << 24) & 0xff00000000) | ((revkey << 40) & 0xff0000000000);
+        printf("key = %012" PRIX64 "\n", foundkey);
+        exit(0);
     }
 
     printf("FAIL :( - none of the potential keys in the table are correct.\n");
@@ -19,6 +19,7 @@
 #include <inttypes.h>
 #include <pthread.h>
 #include "ht2crackutils.h"
+#include "ht2bitslice.h"
 
 const uint8_t bits[9] = {20, 14, 4, 3, 1, 1, 1, 1, 1};
 #define lfsr_inv(state) (((state)<<1) | (__builtin_parityll((state) & ((0xce0044c101cd>>1)|(1ull<<(47))))))
@@ -45,9 +46,6 @@ __thread bitslice_t state[-2 + 32 + 48];
 bitslice_t keystream[32];
 bitslice_t bs_zeroes, bs_ones;
 
-#define f_a_bs(a,b,c,d)       (~(((a|b)&c)^(a|d)^b)) // 6 ops
-#define f_b_bs(a,b,c,d)       (~(((d|c)&(a^b))^(d|a|b))) // 7 ops
-#define f_c_bs(a,b,c,d,e)     (~((((((c^e)|d)&a)^b)&(c^b))^(((d^e)|a)&((d^b)|c)))) // 13 ops
 #define lfsr_bs(i) (state[-2+i+ 0].value ^ state[-2+i+ 2].value ^ state[-2+i+ 3].value ^ state[-2+i+ 6].value ^ \
                     state[-2+i+ 7].value ^ state[-2+i+ 8].value ^ state[-2+i+16].value ^ state[-2+i+22].value ^ \
                     state[-2+i+23].value ^ state[-2+i+26].value ^ state[-2+i+30].value ^ state[-2+i+41].value ^ \
@@ -94,23 +92,6 @@ static uint64_t unbitslice(const bitslice_t *restrict b, const uint8_t s, const
 }
 
 
-// determine number of logical CPU cores (use for multithreaded functions)
-static int num_CPUs(void) {
-#if defined(_WIN32)
-#include <sysinfoapi.h>
-    SYSTEM_INFO sysinfo;
-    GetSystemInfo(&sysinfo);
-    return sysinfo.dwNumberOfProcessors;
-#else
-#include <unistd.h>
-    int count = sysconf(_SC_NPROCESSORS_ONLN);
-    if (count < 2)
-        count = 2;
-    return count;
-#endif
-}
-
-
 uint32_t uid, nR1, aR1, nR2, aR2;
 
 uint64_t candidates[(1 << 20)];
@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "crapto1/crapto1.h"
+#include "crapto1/crypto1_bs.h"
 #include "util_posix.h"
 
 int main(int argc, char *argv[]) {
@@ -53,17 +54,27 @@ int main(int argc, char *argv[]) {
 
     s = lfsr_recovery32(ar0_enc ^ p64, 0);
 
-    for (t = s; t->odd | t->even; ++t) {
+    uint32_t count = 0;
+    while (s[count].odd | s[count].even)
+        count++;
+
+    const crypto1_bs_op_t ops[] = {
+        { CRYPTO1_BS_ROLLBACK, 0, 0, 0, 0 },
+        { CRYPTO1_BS_ROLLBACK, 1, 0, nr0_enc, 0 },
+        { CRYPTO1_BS_ROLLBACK, 0, 0, uid ^ nt, 0 },
+        { CRYPTO1_BS_FORWARD, 0, 0, uid ^ nt, 0 },
+        { CRYPTO1_BS_FORWARD, 1, 0, nr1_enc, 0 },
+        { CRYPTO1_BS_FORWARD, 0, 1, 0, ar1_enc ^ p64 },
+    };
+
+    int32_t i = crypto1_bs_find(s, count, ops, sizeof(ops) / sizeof(ops[0]));
+    if (i >= 0) {
+        t = s + i;
         lfsr_rollback_word(t, 0, 0);
         lfsr_rollback_word(t, nr0_enc, 1);
         lfsr_rollback_word(t, uid ^ nt, 0);
         crypto1_get_lfsr(t, &key);
-        crypto1_word(t, uid ^ nt, 0);
-        crypto1_word(t, nr1_enc, 1);
-        if (ar1_enc == (crypto1_word(t, 0, 0) ^ p64)) {
-            printf("\nFound Key: [%012" PRIx64 "]\n\n", key);
-            break;
-        }
+        printf("\nFound Key: [%012" PRIx64 "]\n\n", key);
     }
     free(s);
     return 0;
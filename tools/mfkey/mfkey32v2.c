@@ -3,8 +3,35 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "crapto1/crapto1.h"
+#include "crapto1/crypto1_bs.h"
 #include "util_posix.h"
+#include "mfkey.h"
+#include "mfkey_batch.h"
+
+static bool solve(const uint32_t *v, uint64_t *key) {
+    nonces_t data = {
+        .cuid = v[0],
+        .nonce = v[1],
+        .nr = v[2],
+        .ar = v[3],
+        .nonce2 = v[4],
+        .nr2 = v[5],
+        .ar2 = v[6],
+    };
+    return mfkey32_moebius(&data, key);
+}
+
+static int batch(int argc, char *argv[]) {
+    static const char *const names[] = { "uid", "nt0", "nr0", "ar0", "nt1", "nr1", "ar1" };
+    int threads = (argc > 4 && strcmp(argv[3], "-t") == 0) ? atoi(argv[4]) : 0;
+    if (mfkey_batch(argv[2], threads, names, 7, solve) < 0) {
+        fprintf(stderr, "can't read %s\n", argv[2]);
+        return 1;
+    }
+    return 0;
+}
 
 int main(int argc, char *argv[]) {
     struct Crypto1State *s, *t;
@@ -18,12 +45,17 @@ int main(int argc, char *argv[]) {
     uint32_t ar1_enc; // second encrypted reader response
     uint32_t ks2;     // keystream used to encrypt reader response
 
+    if (argc > 2 && strcmp(argv[1], "-f") == 0)
+        return batch(argc, argv);
+
     printf("MIFARE Classic key recovery - based 32 bits of keystream  VERSION2\n");
     printf("Recover key from two 32-bit reader authentication answers only\n");
     printf("This version implements Moebius two different nonce solution (like the supercard)\n\n");
 
     if (argc < 8) {
-        printf("syntax: %s <uid> <nt> <nr_0> <ar_0> <nt1> <nr_1> <ar_1>\n\n", argv[0]);
+        printf("syntax: %s <uid> <nt> <nr_0> <ar_0> <nt1> <nr_1> <ar_1>\n", argv[0]);
+        printf("        %s -f <file> [-t <threads>]\n\n", argv[0]);
+        printf("   -f  records of the same 7 hex words, one per line, - for stdin, a JSON line per record goes out\n\n");
         return 1;
     }
 
@@ -59,18 +91,27 @@ int main(int argc, char *argv[]) {
 
     s = lfsr_recovery32(ar0_enc ^ p64, 0);
 
-    for (t = s; t->odd | t->even; ++t) {
+    uint32_t count = 0;
+    while (s[count].odd | s[count].even)
+        count++;
+
+    const crypto1_bs_op_t ops[] = {
+        { CRYPTO1_BS_ROLLBACK, 0, 0, 0, 0 },
+        { CRYPTO1_BS_ROLLBACK, 1, 0, nr0_enc, 0 },
+        { CRYPTO1_BS_ROLLBACK, 0, 0, uid ^ nt0, 0 },
+        { CRYPTO1_BS_FORWARD, 0, 0, uid ^ nt1, 0 },
+        { CRYPTO1_BS_FORWARD, 1, 0, nr1_enc, 0 },
+        { CRYPTO1_BS_FORWARD, 0, 1, 0, ar1_enc ^ p64b },
+    };
+
+    int32_t i = crypto1_bs_find(s, count, ops, sizeof(ops) / sizeof(ops[0]));
+    if (i >= 0) {
+        t = s + i;
         lfsr_rollback_word(t, 0, 0);
         lfsr_rollback_word(t, nr0_enc, 1);
         lfsr_rollback_word(t, uid ^ nt0, 0);
         crypto1_get_lfsr(t, &key);
-
-        crypto1_word(t, uid ^ nt1, 0);
-        crypto1_word(t, nr1_enc, 1);
-        if (ar1_enc == (crypto1_word(t, 0, 0) ^ p64b)) {
-            printf("\nFound Key: [%012" PRIx64 "]\n\n", key);
-            break;
-        }
+        printf("\nFound Key: [%012" PRIx64 "]\n\n", key);
     }
     free(s);
     return 0;
@@ -6,6 +6,30 @@
 #include <stdlib.h>
 #include "crapto1/crapto1.h"
 #include "util_posix.h"
+#include "mfkey.h"
+#include "mfkey_batch.h"
+
+static bool solve(const uint32_t *v, uint64_t *key) {
+    nonces_t data = {
+        .cuid = v[0],
+        .nonce = v[1],
+        .nr = v[2],
+        .ar = v[3],
+        .at = v[4],
+    };
+    mfkey64(&data, key);
+    return true;
+}
+
+static int batch(int argc, char *argv[]) {
+    static const char *const names[] = { "uid", "nt", "nr", "ar", "at" };
+    int threads = (argc > 4 && strcmp(argv[3], "-t") == 0) ? atoi(argv[4]) : 0;
+    if (mfkey_batch(argv[2], threads, names, 5, solve) < 0) {
+        fprintf(stderr, "can't read %s\n", argv[2]);
+        return 1;
+    }
+    return 0;
+}
 
 int main(int argc, char *argv[]) {
     struct Crypto1State *revstate;
@@ -18,11 +42,16 @@ int main(int argc, char *argv[]) {
     uint32_t ks2;     // keystream used to encrypt reader response
     uint32_t ks3;     // keystream used to encrypt tag response
 
+    if (argc > 2 && strcmp(argv[1], "-f") == 0)
+        return batch(argc, argv);
+
     printf("MIFARE Classic key recovery - based 64 bits of keystream\n");
     printf("Recover key from only one complete authentication!\n\n");
 
     if (argc < 6) {
-        printf(" syntax: %s <uid> <nt> <{nr}> <{ar}> <{at}> [enc...]\n\n", argv[0]);
+        printf(" syntax: %s <uid> <nt> <{nr}> <{ar}> <{at}> [enc...]\n", argv[0]);
+        printf("         %s -f <file> [-t <threads>]\n\n", argv[0]);
+        printf("   -f  records of the same 5 hex words, one per line, - for stdin, a JSON line per record goes out\n\n");
         return 1;
     }
 
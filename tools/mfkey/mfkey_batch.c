@@ -0,0 +1,182 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Batch mode of the mfkey tools, many records solved in threads
+//
+// Records are read MFKEY_BATCH_RECORDS at a time, the threads pull them one
+// by one, then the results are printed in the order of the input before the
+// next ones are read, so a pipe gets its answers as it goes.
+//-----------------------------------------------------------------------------
+#define __STDC_FORMAT_MACROS
+#include "mfkey_batch.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#include "crapto1/crypto1_bs.h"
+
+#define MFKEY_BATCH_RECORDS     1024
+
+typedef struct {
+    uint32_t line;
+    int fields;         // read from the line, the record is solved only if all are there
+    uint32_t v[MFKEY_BATCH_MAX_FIELDS];
+    bool found;
+    uint64_t key;
+} mfkey_record_t;
+
+typedef struct {
+    mfkey_record_t *records;
+    uint32_t count;
+    uint32_t next;
+    int fields;
+    mfkey_batch_solve_t solve;
+} mfkey_batch_ctx_t;
+
+static void *mfkey_batch_thread(void *arg) {
+    mfkey_batch_ctx_t *ctx = (mfkey_batch_ctx_t *)arg;
+    for (;;) {
+        uint32_t i = __atomic_fetch_add(&ctx->next, 1, __ATOMIC_RELAXED);
+        if (i >= ctx->count)
+            break;
+        mfkey_record_t *r = &ctx->records[i];
+        if (r->fields == ctx->fields)
+            r->found = ctx->solve(r->v, &r->key);
+    }
+    return NULL;
+}
+
+static void run_threads(mfkey_batch_ctx_t *ctx, pthread_t *thread_id, int threads) {
+    ctx->next = 0;
+    int started = 0;
+    for (; started < threads; started++) {
+        if (pthread_create(&thread_id[started], NULL, mfkey_batch_thread, ctx) != 0)
+            break;
+    }
+    // no thread at all, do it here
+    if (started == 0)
+        mfkey_batch_thread(ctx);
+
+    for (int i = 0; i < started; i++)
+        pthread_join(thread_id[i], NULL);
+}
+
+// the hex words of a line, up to max
+static int parse_line(char *line, uint32_t *v, int max) {
+    char *hash = strchr(line, '#');
+    if (hash)
+        *hash = '\0';
+
+    int n = 0;
+    char *p = line;
+    for (;;) {
+        p += strspn(p, " \t\r\n,");
+        if (*p == '\0')
+            break;
+        char *end;
+        unsigned long x = strtoul(p, &end, 16);
+        if (end == p || n == max || (*end != '\0' && strchr(" \t\r\n,", *end) == NULL))
+            return -1;
+        v[n++] = x;
+        p = end;
+    }
+    return n;
+}
+
+static void print_record(const mfkey_record_t *r, const char *const *names, int fields) {
+    printf("{\"line\":%u", r->line);
+    if (r->fields != fields) {
+        printf(",\"error\":\"expected %d hex words\"}\n", fields);
+        return;
+    }
+    for (int i = 0; i < fields; i++)
+        printf(",\"%s\":\"%08x\"", names[i], r->v[i]);
+    if (r->found)
+        printf(",\"key\":\"%012" PRIx64 "\"}\n", r->key);
+    else
+        printf(",\"key\":null}\n");
+}
+
+static int cpu_count(void) {
+#if defined(_WIN32)
+    SYSTEM_INFO sysinfo;
+    GetSystemInfo(&sysinfo);
+    return sysinfo.dwNumberOfProcessors;
+#else
+    return sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+}
+
+int mfkey_batch(const char *fn, int threads, const char *const *names, int fields, mfkey_batch_solve_t solve) {
+
+    FILE *f = (strcmp(fn, "-") == 0) ? stdin : fopen(fn, "r");
+    if (f == NULL)
+        return -1;
+
+    if (threads <= 0)
+        threads = cpu_count();
+    if (threads < 1)
+        threads = 1;
+
+    mfkey_batch_ctx_t ctx = { .fields = fields, .solve = solve };
+    ctx.records = calloc(MFKEY_BATCH_RECORDS, sizeof(mfkey_record_t));
+    pthread_t *thread_id = calloc(threads, sizeof(pthread_t));
+    if (ctx.records == NULL || thread_id == NULL) {
+        free(ctx.records);
+        free(thread_id);
+        if (f != stdin)
+            fclose(f);
+        return -1;
+    }
+
+    // the bitsliced kernel is picked on first use, do it before the threads start
+    crypto1_bs_simd();
+
+    int found = 0;
+    uint32_t line = 0;
+    char buf[256];
+    bool eof = false;
+    while (eof == false) {
+        ctx.count = 0;
+        while (ctx.count < MFKEY_BATCH_RECORDS) {
+            if (fgets(buf, sizeof(buf), f) == NULL) {
+                eof = true;
+                break;
+            }
+            line++;
+
+            mfkey_record_t *r = &ctx.records[ctx.count];
+            memset(r, 0, sizeof(mfkey_record_t));
+            r->line = line;
+            r->fields = parse_line(buf, r->v, MFKEY_BATCH_MAX_FIELDS);
+            // blank or comment
+            if (r->fields == 0)
+                continue;
+            ctx.count++;
+        }
+
+        run_threads(&ctx, thread_id, (ctx.count < (uint32_t)threads) ? (int)ctx.count : threads);
+
+        for (uint32_t i = 0; i < ctx.count; i++) {
+            print_record(&ctx.records[i], names, fields);
+            if (ctx.records[i].found)
+                found++;
+        }
+        fflush(stdout);
+    }
+
+    free(ctx.records);
+    free(thread_id);
+    if (f != stdin)
+        fclose(f);
+    return found;
+}
@@ -0,0 +1,26 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Batch mode of the mfkey tools, many records solved in threads
+//-----------------------------------------------------------------------------
+
+#ifndef MFKEY_BATCH_H__
+#define MFKEY_BATCH_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MFKEY_BATCH_MAX_FIELDS  8
+
+// solves one record, v holds the fields in the order of the command line
+typedef bool (*mfkey_batch_solve_t)(const uint32_t *v, uint64_t *key);
+
+// Reads records from fn ("-" for stdin), one per line as the hex words of the command
+// line, '#' starts a comment. They are solved with threads threads (0 = one per cpu),
+// a JSON line per record goes to stdout in the order of the input, names are the
+// JSON names of the fields. Returns the number of keys found, -1 if fn can't be opened
+int mfkey_batch(const char *fn, int threads, const char *const *names, int fields, mfkey_batch_solve_t solve);
+
+#endif
@@ -0,0 +1,81 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// statecache.h of the client for the mfkey tools, the state lists are kept in
+// memory and shared by the batch threads
+//
+// Nonces collected by a simulation come again and again with the same nt and
+// key, so the same keystream, the list is copied instead of recovered again.
+//-----------------------------------------------------------------------------
+
+#include "statecache.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define MFKEY_CACHE_SLOTS   16
+
+typedef struct {
+    uint32_t ks2;
+    uint32_t in;
+    uint32_t count;     // states, with the terminating {0, 0}
+    struct Crypto1State *sl;
+} mfkey_cache_slot_t;
+
+static mfkey_cache_slot_t mfkey_cache[MFKEY_CACHE_SLOTS];
+static uint32_t mfkey_cache_next;
+static pthread_mutex_t mfkey_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct Crypto1State *sl_copy(const struct Crypto1State *sl, uint32_t count) {
+    struct Crypto1State *copy = malloc(count * sizeof(struct Crypto1State));
+    if (copy)
+        memcpy(copy, sl, count * sizeof(struct Crypto1State));
+    return copy;
+}
+
+struct Crypto1State *lfsr_recovery32_cached(uint32_t ks2, uint32_t in) {
+
+    struct Crypto1State *sl = NULL;
+
+    pthread_mutex_lock(&mfkey_cache_lock);
+    for (int i = 0; i < MFKEY_CACHE_SLOTS; i++) {
+        mfkey_cache_slot_t *c = &mfkey_cache[i];
+        if (c->sl && c->ks2 == ks2 && c->in == in) {
+            sl = sl_copy(c->sl, c->count);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mfkey_cache_lock);
+    if (sl)
+        return sl;
+
+    sl = lfsr_recovery32(ks2, in);
+    if (sl == NULL)
+        return NULL;
+
+    uint32_t count = 1;
+    while (sl[count - 1].odd | sl[count - 1].even)
+        count++;
+
+    struct Crypto1State *keep = sl_copy(sl, count);
+    if (keep == NULL)
+        return sl;
+
+    pthread_mutex_lock(&mfkey_cache_lock);
+    mfkey_cache_slot_t *c = &mfkey_cache[mfkey_cache_next++ % MFKEY_CACHE_SLOTS];
+    free(c->sl);
+    c->ks2 = ks2;
+    c->in = in;
+    c->count = count;
+    c->sl = keep;
+    pthread_mutex_unlock(&mfkey_cache_lock);
+    return sl;
+}
+
+// a single state, nothing worth keeping
+struct Crypto1State *lfsr_recovery64_cached(uint32_t ks2, uint32_t ks3) {
+    return lfsr_recovery64(ks2, ks3);
+}
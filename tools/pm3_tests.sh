@@ -10,6 +10,7 @@ TESTMFKEY=false
 TESTNONCE2KEY=false
 TESTMFNONCEBRUTE=false
 TESTHITAG2CRACK=false
+TESTDECODERBENCH=false
 TESTFPGACOMPRESS=false
 TESTBOOTROM=false
 TESTARMSRC=false
@@ -73,6 +74,11 @@ Usage: $0 [--long] [--gpu] [--clientbin /path/to/proxmark3] [mfkey|nonce2key|mf_
       TESTHITAG2CRACK=true
       shift
       ;;
+    decoder_bench)
+      TESTALL=false
+      TESTDECODERBENCH=true
+      shift
+      ;;
     bootrom)
       TESTALL=false
       TESTBOOTROM=true
@@ -252,6 +258,7 @@ while true; do
       # Need a decent example for mfkey32...
       if ! CheckExecute "mfkey32v2 test"                   "$MFKEY32V2BIN 12345678 1AD8DF2B 1D316024 620EF048 30D6CB07 C52077E2 837AC61A" "Found Key: \[a0a1a2a3a4a5\]"; then break; fi
       if ! CheckExecute "mfkey64 test"                     "$MFKEY64BIN 9c599b32 82a4166c a1e458ce 6eea41e0 5cadf439" "Found Key: \[ffffffffffff\]"; then break; fi
+      if ! CheckExecute "mfkey32v2 batch test"             "echo '12345678 1AD8DF2B 1D316024 620EF048 30D6CB07 C52077E2 837AC61A' | $MFKEY32V2BIN -f -" "\"key\":\"a0a1a2a3a4a5\""; then break; fi
       if ! CheckExecute "mfkey64 long trace test"          "$MFKEY64BIN 14579f69 ce844261 f8049ccb 0525c84f 9431cc40 7093df99 9972428ce2e8523f456b99c831e769dced09 8ca6827b ab797fd369e8b93a86776b40dae3ef686efd c3c381ba 49e2c9def4868d1777670e584c27230286f4 fbdcd7c1 4abd964b07d3563aa066ed0a2eac7f6312bf 9f9149ea" "Found Key: \[091e639cb715\]"; then break; fi
     fi
     if $TESTALL || $TESTNONCE2KEY; then
@@ -318,6 +325,16 @@ while true; do
       # Order of magnitude to crack it: ~15s -> tagged as "slow"
       if ! CheckExecute slow gpu "ht2crack5gpu test"        "cd $HT2CRACK5GPUPATH; ./ht2crack5gpu $HT2CRACK5GPUUID $HT2CRACK5GPUNRAR" "Key: $HT2CRACK5GPUKEY"; then break; fi
     fi
+    # decoder_bench not yet part of "all"
+    if $TESTDECODERBENCH; then
+      echo -e "\n${C_BLUE}Testing decoder_bench:${C_NC} ${DECODERBENCHPATH:=./tools/decoder_bench/}"
+      if ! CheckFileExist "decoder_bench exists"           "$DECODERBENCHPATH/decoder_bench"; then break; fi
+      DECODERBENCH14A=decoder_bench_14a.raw
+      if ! CheckExecute "decoder_bench gen 14a"            "cd $DECODERBENCHPATH; ./decoder_bench -g 2 $DECODERBENCH14A" "wrote 1240 samples, 14 frames"; then break; fi
+      if ! CheckExecute "decoder_bench 14a select"         "cd $DECODERBENCHPATH; ./decoder_bench 14a $DECODERBENCH14A" "R  93 70 01 02 00 01 02 64 D1"; then break; fi
+      if ! CheckExecute "decoder_bench 14a all frames"     "cd $DECODERBENCHPATH; ./decoder_bench -q -n 10 14a $DECODERBENCH14A" "8 reader frames, 6 tag frames, crc32 160350aa"; then break; fi
+      if ! CheckExecute "decoder_bench rm testfile"        "cd $DECODERBENCHPATH; rm $DECODERBENCH14A && echo SUCCESS" "SUCCESS"; then break; fi
+    fi
     if $TESTALL || $TESTCLIENT; then
       echo -e "\n${C_BLUE}Testing client:${C_NC} ${CLIENTBIN:=./client/proxmark3}"
       if ! CheckFileExist "proxmark3 exists"               "$CLIENTBIN"; then break; fi
@@ -329,10 +346,24 @@ while true; do
       echo -e "\n${C_BLUE}Testing data manipulation:${C_NC}"
       if ! CheckExecute "reveng readline test"    "$CLIENTBIN -c 'reveng -h;reveng -D'" "CRC-64/GO-ISO"; then break; fi
       if ! CheckExecute "reveng -g test"          "$CLIENTBIN -c 'reveng -g abda202c'" "CRC-16/ISO-IEC-14443-3-A"; then break; fi
+      if ! CheckExecute "reveng -g long frame test" "$CLIENTBIN -c 'reveng -g 31323334353637383931323334353637383931323334353637383931323334353637383931323334353637383931323334353637383931323334353637383931323334353637383940a41188'" "CRC-32/ISO-HDLC"; then break; fi
+      if ! CheckExecute "analyse crcbench test" "$CLIENTBIN -c 'analyse crcbench 64'" "CRC kernels ( ok )"; then break; fi
+      if ! CheckExecute "analyse cryptobench test" "$CLIENTBIN -c 'analyse cryptobench'" "crypto primitives ( ok )"; then break; fi
+      if ! CheckExecute "analyse nuid search test" "$CLIENTBIN -c 'analyse nuid t; analyse nuid s 8F430FEF 040D681AB5'" "found 1 UIDs with NUID 8F430FEF"; then break; fi
+      if ! CheckExecute "wiegand decode test" "$CLIENTBIN -c 'wiegand decode 2006f623ae'" "\[H10301\] - HID H10301 26-bit;  FC: 123  CN: 4567"; then break; fi
+      if ! CheckExecute "help search test" "$CLIENTBIN -c 'help crcbench'" "analyse crcbench"; then break; fi
+      if ! CheckExecute "daemon mode test" "$CLIENTBIN --daemon /tmp/pm3_tests.sock >/dev/null 2>&1 & sleep 1; $CLIENTBIN --connect /tmp/pm3_tests.sock -c 'analyse lcr 04 04 00 00; quit'" "requires final LRC XOR byte value: 0x00"; then break; fi
+      if ! CheckExecute "daemon pool test"  "$CLIENTBIN --daemon /tmp/pm3_tests_a.sock >/dev/null 2>&1 & $CLIENTBIN --daemon /tmp/pm3_tests_b.sock >/dev/null 2>&1 & sleep 1; $CLIENTBIN --pool /tmp/pm3_tests_a.sock,/tmp/pm3_tests_b.sock -c 'analyse lcr 04 04 00 00'; $CLIENTBIN --pool /tmp/pm3_tests_a.sock,/tmp/pm3_tests_b.sock -c quit >/dev/null" "2 of 2 devices ok"; then break; fi
+      if ! CheckExecute "client perf test"  "$CLIENTBIN -c 'hw perf on; analyse lcr 04 04 00 00; hw perf'" "analyse lcr              |     1"; then break; fi
       if ! CheckExecute "reveng -w test"          "$CLIENTBIN -c 'reveng -w 8 -s 01020304e3 010204039d'" "CRC-8/SMBUS"; then break; fi
       if ! CheckExecute "mfu pwdgen test"         "$CLIENTBIN -c 'hf mfu pwdgen t'" "Selftest OK"; then break; fi
+      if ! CheckExecute "mfu pwdgen algos"        "$CLIENTBIN -c 'hf mfu pwdgen 04112233445566'" "XYZ  | 350EA09B"; then break; fi
+      if ! CheckExecute "data ndef test"          "$CLIENTBIN -c 'data ndef -d 0312d1010e5402656e48656c6c6f20576f726c64fe'" "NDEF Terminator detected"; then break; fi
       if ! CheckExecute "trace load/list 14a"     "$CLIENTBIN -c 'trace load traces/hf_mfu.trace; trace list 1;'" "READBLOCK(8)"; then break; fi
       if ! CheckExecute "trace load/list x"       "$CLIENTBIN -c 'trace load traces/hf_mfu.trace; trace list x 1;'" "0.0101840425"; then break; fi
+      if ! CheckExecute "trace list paging"       "$CLIENTBIN -c 'trace load traces/hf_mfu.trace; trace list 14a 1 d r s 10 n 2;'" "showed 2 records, next record 13"; then break; fi
+      if ! CheckExecute "trace load flash log"     "$CLIENTBIN -c 'trace load traces/hf_14asniff.trc; trace list 14a 1;'" "dropped the last 46 bytes"; then break; fi
+      if ! CheckExecute "trace export pcapng"     "$CLIENTBIN -c 'trace export p /tmp/pm3_tests_export 14a f traces/hf_mfu.trace;'" "exported 22 records to PCAP-NG"; then break; fi
 
       echo -e "\n${C_BLUE}Testing LF:${C_NC}"
       if ! CheckExecute "lf EM4x05 test"        "$CLIENTBIN -c 'data load traces/em4x05.pm3;lf search 1'" "FDX-B ID found"; then break; fi
@@ -351,14 +382,22 @@ while true; do
       if ! CheckExecute "lf FDX/BioThermo test" "$CLIENTBIN -c 'data load traces/lf_fdx_biothermo.pm3; lf fdx demod'" "95.2 F / 35.1 C"; then break; fi
       if ! CheckExecute "lf GPROXII test"       "$CLIENTBIN -c 'data load traces/lf_gprox_36_30_14489.pm3; lf search 1'" "Guardall G-Prox II ID found"; then break; fi
       if ! CheckExecute "lf IDTECK test"        "$CLIENTBIN -c 'data load traces/lf_idteck_4944544BAC40E069.pm3; lf search 1'" "Idteck ID found"; then break; fi
+      if ! CheckExecute "lf bench test"         "$CLIENTBIN -c 'lf bench n 1 j /tmp/pm3_tests_lfbench.json'" "found the expected tag in"; then break; fi
+      # Same probabilistic attack as ht2crack4, a fresh random nRaR file for each run
+      if ! CheckExecute slow retry ignore "lf hitag crack test" "python3 ./tools/hitag2crack/hitag2_gen_nRaR.py AABBCCDDEEFF 12345678 32 > /tmp/pm3_tests_ht2nrar.txt; \
+                                                            $CLIENTBIN -c 'lf hitag crack u 12345678 f /tmp/pm3_tests_ht2nrar.txt n 16 t 500000'; \
+                                                            rm /tmp/pm3_tests_ht2nrar.txt" "found key \[ AABBCCDDEEFF \]"; then break; fi
 
       echo -e "\n${C_BLUE}Testing HF:${C_NC}"
       if ! CheckExecute "hf mf offline text"               "$CLIENTBIN -c 'hf mf'" "at_enc"; then break; fi
       if ! CheckExecute slow retry ignore "hf mf hardnested long test"  "$CLIENTBIN -c 'hf mf hardnested t 1 000000000000'" "found:"; then break; fi
       if ! CheckExecute slow "hf iclass long test"         "$CLIENTBIN -c 'hf iclass loclass t l'" "verified ok"; then break; fi
+      if ! CheckExecute slow "hf cryptorf crack test"      "$CLIENTBIN -c 'hf cryptorf crack ffffffffffffffff 1234567812345678 88c9d4466a501a87 dec2ee1b1c9276e9'" "Found valid key: 4F794A463FF81D81"; then break; fi
       if ! CheckExecute slow "emv long test"               "$CLIENTBIN -c 'emv test -l'" "Test(s) \[ ok"; then break; fi
       if ! $SLOWTESTS; then
         if ! CheckExecute "hf iclass test"                 "$CLIENTBIN -c 'hf iclass loclass t'" "key diversification (ok)"; then break; fi
+        if ! CheckExecute "hf iclass batch mac test"       "$CLIENTBIN -c 'hf iclass loclass t'" "Batch MAC calculation (ok)"; then break; fi
+        if ! CheckExecute "hf iclass lookup test"          "$CLIENTBIN -c 'hf iclass lookup u 9655a400f8ff12e0 p f0ffffffffffffff m 0000000089cb984b f iclass_default_keys'" "Found valid key AE A6 84 A6 DA B2 32 78"; then break; fi
         if ! CheckExecute "emv test"                       "$CLIENTBIN -c 'emv test'" "Test(s) \[ ok"; then break; fi
       fi
     fi